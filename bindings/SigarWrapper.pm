@@ -41,7 +41,8 @@ my %platforms = (
 
 my %has_name_arg = map { $_, 1 } qw(FileSystemUsage DiskUsage
                                     FileAttrs DirStat DirUsage
-                                    NetInterfaceConfig NetInterfaceStat);
+                                    NetInterfaceConfig NetInterfaceStat
+                                    CacheStats InstrumentationStats);
 
 
 my %proc_no_arg = map { $_, 1 } qw(stat);
@@ -49,6 +50,18 @@ my %proc_no_arg = map { $_, 1 } qw(stat);
 my %get_not_impl = map { $_, 1 } qw(net_address net_route net_connection net_stat cpu_perc
                                     arp who cpu_info file_system); #list funcs only
 
+#list types with generated *_columns bulk accessors:
+#one native call, one array of primitives per field
+my %list_types = (
+    Cpu           => {},
+    CpuInfo       => {},
+    FileSystem    => {},
+    NetRoute      => {},
+    NetConnection => { arg => 'flags' },
+    Arp           => {},
+    Who           => {},
+);
+
 sub supported_platforms {
     my $p = shift;
     return 'Undocumented' unless $p;
@@ -667,10 +680,111 @@ use vars qw(%classes %cmds);
 
     DumpPidCache => [
       {
-         name => 'dummy', type => 'Long',
-         desc => 'Dummy',
-         plat => 'LWAHS'
-      }
+         name => 'proc_cpu_count', type => 'Long',
+         desc => 'Number of pids in the process cpu cache',
+         plat => '*'
+      },
+      {
+         name => 'proc_cpu_evictions', type => 'Long',
+         desc => 'Number of expired pids evicted from the process cpu cache',
+         plat => '*'
+      },
+      {
+         name => 'proc_io_count', type => 'Long',
+         desc => 'Number of pids in the process disk io cache',
+         plat => '*'
+      },
+      {
+         name => 'proc_io_evictions', type => 'Long',
+         desc => 'Number of expired pids evicted from the process disk io cache',
+         plat => '*'
+      },
+    ],
+
+    CacheStats => [
+      {
+         name => 'size', type => 'Long',
+         desc => 'Number of buckets or slots in the cache table',
+         plat => '*'
+      },
+      {
+         name => 'count', type => 'Long',
+         desc => 'Number of entries in the cache',
+         plat => '*'
+      },
+      {
+         name => 'max_probe', type => 'Long',
+         desc => 'Longest chain or probe sequence in the cache table',
+         plat => '*'
+      },
+      {
+         name => 'hits', type => 'Long',
+         desc => 'Number of lookups which found an existing entry',
+         plat => '*'
+      },
+      {
+         name => 'misses', type => 'Long',
+         desc => 'Number of lookups which did not find an entry',
+         plat => '*'
+      },
+      {
+         name => 'evictions', type => 'Long',
+         desc => 'Number of expired entries evicted from the cache',
+         plat => '*'
+      },
+      {
+         name => 'bytes', type => 'Long',
+         desc => 'Bytes allocated by the cache table and its entries',
+         plat => '*'
+      },
+    ],
+
+    InstrumentationStats => [
+      {
+         name => 'calls', type => 'Long',
+         desc => 'Number of calls to the getter',
+         plat => '*'
+      },
+      {
+         name => 'errors', type => 'Long',
+         desc => 'Number of calls which did not return SIGAR_OK',
+         plat => '*'
+      },
+      {
+         name => 'total_time', type => 'Long',
+         desc => 'Nanoseconds spent in the getter',
+         plat => '*'
+      },
+      {
+         name => 'max_time', type => 'Long',
+         desc => 'Nanoseconds taken by the slowest call',
+         plat => '*'
+      },
+      {
+         name => 'p50', type => 'Long',
+         desc => 'Median call time in nanoseconds',
+         plat => '*'
+      },
+      {
+         name => 'p90', type => 'Long',
+         desc => '90th percentile call time in nanoseconds',
+         plat => '*'
+      },
+      {
+         name => 'p99', type => 'Long',
+         desc => '99th percentile call time in nanoseconds',
+         plat => '*'
+      },
+      {
+         name => 'opens', type => 'Long',
+         desc => 'Number of files opened by the getter',
+         plat => '*'
+      },
+      {
+         name => 'reads', type => 'Long',
+         desc => 'Number of unbuffered file reads made by the getter',
+         plat => '*'
+      },
     ],
 
 
@@ -1856,6 +1970,72 @@ sub get_mappings {
     return \@mappings;
 }
 
+my @list_mappings;
+
+sub get_list_mappings {
+    if (@list_mappings != 0) {
+        return \@list_mappings;
+    }
+
+    my %funcs = map { $_->{name}, $_ } @{ get_mappings() };
+
+    for my $name (sort keys %list_types) {
+        my $func = $funcs{$name};
+        my $cname = $func->{cname};
+        my $arg = $list_types{$name}->{arg};
+        my $prefix = "sigar_${cname}_list";
+
+        push @list_mappings, {
+            name => $name,
+            cname => $cname,
+            entry_type => $func->{sigar_type},
+            list_type => "${prefix}_t",
+            destroy => "${prefix}_destroy",
+            call => $arg ?
+              "${prefix}_get(sigar, &list, %s)" : "${prefix}_get(sigar, &list)",
+            num_args => $arg ? 1 : 0,
+            arg => $arg,
+            columns => [ map {
+                { name => $_->{name}, type => $_->{type}, member => $_->{name} }
+            } @{ $func->{fields} } ],
+        };
+    }
+
+    #sigar_proc_snapshot_get, entries nest state, mem and cpu
+    my @columns = (
+        { name => 'pid', type => 'Long', member => 'pid' },
+        { name => 'flags', type => 'Int', member => 'flags' },
+    );
+    for my $nested ([ProcState => 'state'], [ProcMem => 'mem'],
+                    [ProcTime => 'cpu'])
+    {
+        my($class, $member) = @$nested;
+        for my $field (@{ $funcs{$class}->{fields} }) {
+            push @columns, {
+                name => $field->{name}, type => $field->{type},
+                member => "$member.$field->{name}",
+            };
+        }
+    }
+    push @columns, { name => 'percent', type => 'Double',
+                     member => 'cpu.percent' };
+
+    push @list_mappings, {
+        name => 'ProcSnapshot',
+        cname => 'proc_snapshot',
+        entry_type => 'sigar_proc_snapshot_entry_t',
+        list_type => 'sigar_proc_snapshot_t',
+        destroy => 'sigar_proc_snapshot_destroy',
+        call => 'sigar_proc_snapshot_get(sigar, %s, &list)',
+        num_args => 1,
+        arg => 'flags',
+        arg_default => 'SIGAR_PROC_SNAPSHOT_ALL',
+        columns => \@columns,
+    };
+
+    return \@list_mappings;
+}
+
 package SigarWrapper::File;
 
 use vars qw(@ISA);
@@ -2075,7 +2255,6 @@ $proto
 {
     $func->{sigar_type} s;
     int status;
-    jclass cls = JENV->GetObjectClass(env, obj);
     $decl_string
     dSIGAR_VOID;
 
@@ -2249,9 +2428,14 @@ EOF
 
     push @init_fields, "    }";
 
+    #GetObjectClass only happens the first time, in the INIT macro
+    my $cls = $cache_field_ids ?
+      "NULL" : "JENV->GetObjectClass(env, obj)";
+
     if ($cache_field_ids) {
         print $hfh join(' \\' . "\n", @init_fields), "\n\n";
-        print $cfh "\n\n    $init_define(cls);\n\n" if $func->{has_get};
+        print $cfh "\n\n    $init_define(JENV->GetObjectClass(env, obj));\n\n"
+          if $func->{has_get};
     }
     else {
         print $hfh "#define $init_define(cls)\n";
@@ -2259,7 +2443,7 @@ EOF
 
     print $hfh join(' \\' . "\n", @setter), "\n\n";
     print $hfh join(' \\' . "\n", @getter), "\n\n";
-    print $cfh "\n\n    $setter(cls, obj, s);" if $func->{has_get};
+    print $cfh "\n\n    $setter($cls, obj, s);" if $func->{has_get};
 
     print $cfh "\n}\n" if $func->{has_get};
     print $jfh "\n}\n";
@@ -2298,6 +2482,15 @@ my %field_types = (
     NetAddress => "Sigar::NetAddress",
 );
 
+my %column_types = (
+    Long   => "newSVuv(%s)",
+    Double => "newSVnv(%s)",
+    Int    => "newSViv(%s)",
+    Char   => "newSVpvn(&%s, 1)",
+    String => "newSVpv(%s, 0)",
+    NetAddress => "convert_netaddr_2sv(&%s)",
+);
+
 my $xs_file = 'Sigar_generated.xs';
 
 sub sources {
@@ -2382,8 +2575,88 @@ EOF
     }
 }
 
+sub generate_columns {
+    my($self, $list) = @_;
+
+    my $fh = $self->{xfh};
+    my $name = "$list->{cname}_columns";
+    my $columns = $list->{columns};
+    my $ncols = @$columns;
+    my $args = 'sigar';
+    my $params = "    Sigar sigar\n";
+    my $call = $list->{call};
+
+    if ($list->{arg}) {
+        $args .= ", $list->{arg}";
+        $args .= "=$list->{arg_default}" if $list->{arg_default};
+        $params .= "    int $list->{arg}\n";
+        $call = sprintf $call, $list->{arg};
+    }
+
+    print $fh <<EOF;
+
+MODULE = Sigar   PACKAGE = Sigar   PREFIX = sigar_
+
+SV *
+$name($args)
+$params
+    PREINIT:
+    int status;
+    unsigned long i;
+    $list->{list_type} list;
+    HV *hv;
+    AV *cols[$ncols];
+
+    CODE:
+    if ((status = $call) != SIGAR_OK) {
+        SIGAR_CROAK(sigar, "$name");
+    }
+
+    hv = newHV();
+EOF
+
+    my $i = 0;
+    for my $col (@$columns) {
+        my $len = length $col->{name};
+        print $fh <<EOF;
+    cols[$i] = newAV();
+    av_extend(cols[$i], list.number);
+    hv_store(hv, "$col->{name}", $len, newRV_noinc((SV *)cols[$i]), 0);
+EOF
+        $i++;
+    }
+
+    print $fh <<EOF;
+
+    for (i=0; i<list.number; i++) {
+        $list->{entry_type} *entry = &list.data[i];
+EOF
+
+    $i = 0;
+    for my $col (@$columns) {
+        my $value = sprintf $column_types{ $col->{type} }, "entry->$col->{member}";
+        print $fh "        av_push(cols[$i], $value);\n";
+        $i++;
+    }
+
+    print $fh <<EOF;
+    }
+
+    $list->{destroy}(sigar, &list);
+    RETVAL = newRV_noinc((SV *)hv);
+
+    OUTPUT:
+    RETVAL
+EOF
+}
+
 sub finish {
     my $self = shift;
+
+    for my $list (@{ $self->get_list_mappings }) {
+        $self->generate_columns($list);
+    }
+
     $self->SUPER::finish;
 }
 
@@ -2477,11 +2750,89 @@ EOF
     }
 }
 
+sub generate_columns {
+    my($self, $list) = @_;
+
+    my $fh = $self->{cfh};
+    my $name = "$list->{cname}_columns";
+    my $columns = $list->{columns};
+    my $ncols = @$columns;
+    my $proto = 'VALUE obj';
+    my $scan_args = '';
+    my $call = $list->{call};
+
+    if ($list->{arg_default}) {
+        $proto = 'int argc, VALUE *argv, VALUE obj';
+        $scan_args = qq{VALUE $list->{arg};\n\n    rb_scan_args(argc, argv, "01", &$list->{arg});};
+        $call = sprintf $call,
+          "NIL_P($list->{arg}) ? $list->{arg_default} : NUM2INT($list->{arg})";
+    }
+    elsif ($list->{arg}) {
+        $proto .= ", VALUE $list->{arg}";
+        $call = sprintf $call, "NUM2INT($list->{arg})";
+    }
+
+    print $fh <<EOF;
+static VALUE rb_sigar_$name($proto)
+{
+    SIGAR_GET;
+
+    int status;
+    unsigned long i;
+    $list->{list_type} list;
+    VALUE RETVAL, cols[$ncols];
+    $scan_args
+
+    if ((status = $call) != SIGAR_OK) {
+        RB_SIGAR_CROAK;
+    }
+
+    RETVAL = rb_hash_new();
+EOF
+
+    my $i = 0;
+    for my $col (@$columns) {
+        print $fh <<EOF;
+    cols[$i] = rb_ary_new2(list.number);
+    rb_hash_aset(RETVAL, ID2SYM(rb_intern("$col->{name}")), cols[$i]);
+EOF
+        $i++;
+    }
+
+    print $fh <<EOF;
+
+    for (i=0; i<list.number; i++) {
+        $list->{entry_type} *entry = &list.data[i];
+EOF
+
+    $i = 0;
+    for my $col (@$columns) {
+        my $type = $field_types{ $col->{type} };
+        print $fh "        rb_ary_push(cols[$i], $type(entry->$col->{member}));\n";
+        $i++;
+    }
+
+    print $fh <<EOF;
+    }
+
+    $list->{destroy}(sigar, &list);
+
+    return RETVAL;
+}
+EOF
+}
+
 sub finish {
     my $self = shift;
 
     my $fh = $self->{cfh};
 
+    my $lists = SigarWrapper::get_list_mappings();
+
+    for my $list (@$lists) {
+        $self->generate_columns($list);
+    }
+
     print $fh "static void rb_sigar_define_module_methods(VALUE rclass)\n{\n";
 
     my $mappings = SigarWrapper::get_mappings();
@@ -2493,6 +2844,12 @@ sub finish {
         print $fh qq{    rb_define_method(rclass, "$name", rb_sigar_$name, $args);\n};
     }
 
+    for my $list (@$lists) {
+        my $name = "$list->{cname}_columns";
+        my $args = $list->{arg_default} ? -1 : $list->{num_args};
+        print $fh qq{    rb_define_method(rclass, "$name", rb_sigar_$name, $args);\n};
+    }
+
     for my $class (sort keys %{ $self->{methods} }) {
         my $rclass = "rb_cSigar$class";
         print $fh qq{    $rclass = rb_define_class_under(rclass, "$class", rb_cObject);\n};
@@ -2520,6 +2877,15 @@ my %field_types = (
     NetAddress => "PHP_SIGAR_RETURN_NETADDR",
 );
 
+my %column_types = (
+    Long   => "add_next_index_long(%s, %s)",
+    Double => "add_next_index_double(%s, %s)",
+    Int    => "add_next_index_long(%s, %s)",
+    Char   => "add_next_index_long(%s, %s)",
+    String => "add_next_index_string(%s, %s, 1)",
+    NetAddress => "add_next_index_string(%s, php_sigar_net_address_to_string(%s), 0)",
+);
+
 my $php_file = 'php_sigar_generated.c';
 
 sub sources {
@@ -2638,26 +3004,107 @@ static PHP_FUNCTION($func->{sigar_function})
 EOF
 }
 
+sub generate_columns {
+    my($self, $list) = @_;
+
+    my $cfh = $self->{cfh};
+    my $function = "sigar_$list->{cname}_columns";
+    my $columns = $list->{columns};
+    my $ncols = @$columns;
+    my $vars = '';
+    my $parse_args = '';
+    my $call = $list->{call};
+
+    if ($list->{arg}) {
+        my $spec = $list->{arg_default} ? '|l' : 'l';
+        my $init = $list->{arg_default} ? " = $list->{arg_default}" : '';
+        $vars = "long $list->{arg}$init;";
+        $parse_args = <<EOF;
+if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "$spec", &$list->{arg}) == FAILURE) {
+        RETURN_FALSE;
+    }
+EOF
+        $call = sprintf $call, $list->{arg};
+    }
+
+    print $cfh <<EOF;
+static PHP_FUNCTION($function)
+{
+    int status;
+    unsigned long i;
+    $list->{list_type} list;
+    zval *cols[$ncols];
+    $vars
+    zSIGAR;
+
+    $parse_args
+    if ((status = $call) != SIGAR_OK) {
+        RETURN_FALSE;
+    }
+
+    array_init(return_value);
+EOF
+
+    my $i = 0;
+    for my $col (@$columns) {
+        print $cfh <<EOF;
+    MAKE_STD_ZVAL(cols[$i]);
+    array_init(cols[$i]);
+    add_assoc_zval(return_value, "$col->{name}", cols[$i]);
+EOF
+        $i++;
+    }
+
+    print $cfh <<EOF;
+
+    for (i=0; i<list.number; i++) {
+        $list->{entry_type} *entry = &list.data[i];
+EOF
+
+    $i = 0;
+    for my $col (@$columns) {
+        my $add = sprintf $column_types{ $col->{type} },
+          "cols[$i]", "entry->$col->{member}";
+        print $cfh "        $add;\n";
+        $i++;
+    }
+
+    print $cfh <<EOF;
+    }
+
+    $list->{destroy}(sigar, &list);
+}
+EOF
+}
+
 sub finish {
     my $self = shift;
 
     my $mappings = $self->get_mappings;
+    my $lists = $self->get_list_mappings;
     my $cfh = $self->{cfh};
     my $nl = '\\' . "\n";
+    my(@functions);
+
+    for my $list (@$lists) {
+        $self->generate_columns($list);
+    }
 
-    print $cfh "#define PHP_SIGAR_FUNCTIONS $nl";
     for my $func (@$mappings) {
         next unless $func->{has_get};
         #XXX PHP_ME_MAPPING has another arg in 5.2
-        print $cfh "    PHP_ME_MAPPING($func->{cname}, $func->{sigar_function}, NULL)";
-        if ($func == $mappings->[-1]) {
-            print $cfh "\n";
-        }
-        else {
-            print $cfh $nl;
-        }
+        push @functions,
+          "    PHP_ME_MAPPING($func->{cname}, $func->{sigar_function}, NULL)";
     }
 
+    for my $list (@$lists) {
+        push @functions,
+          "    PHP_ME_MAPPING($list->{cname}_columns, sigar_$list->{cname}_columns, NULL)";
+    }
+
+    print $cfh "#define PHP_SIGAR_FUNCTIONS $nl";
+    print $cfh join($nl, @functions), "\n";
+
     print $cfh "#define PHP_SIGAR_INIT $nl";
     for my $func (@$mappings) {
         print $cfh "    php_$func->{sigar_prefix}_init()";
@@ -2930,7 +3377,7 @@ EOF
     print $cfh "    ei_x_encode_empty_list(x);\n}\n\n";
 
     print $cfh <<EOF if $func->{has_get};
-static int e$func->{sigar_function}(ErlDrvPort port, sigar_t *sigar, char *bytes)
+static int e$func->{sigar_function}(esigar_job_t *job, sigar_t *sigar, char *bytes)
 {
     int status;
     ei_x_buff x;
@@ -2943,12 +3390,13 @@ static int e$func->{sigar_function}(ErlDrvPort port, sigar_t *sigar, char *bytes
         ESIGAR_OK(&x);
 
         $encoder(&x, &$cname);
-
-        ESIGAR_SEND(port, &x);
     }
     else {
         ESIGAR_ERROR(&x, sigar, status);
     }
+
+    ESIGAR_SEND(job, &x);
+
     return status;
 }
 EOF
@@ -2957,7 +3405,7 @@ EOF
 my(@nongens) =
     qw{net_interface_list net_route_list net_connection_list
        file_system_list cpu_info_list arp_list who_list
-       loadavg};
+       loadavg proc_snapshot};
 
 sub finish {
     my $self = shift;
@@ -2988,7 +3436,7 @@ sub finish {
 
     print $cfh <<EOF;
 
-static int esigar_dispatch(ErlDrvPort port, sigar_t *sigar, int cmd, char *bytes) {
+static int esigar_dispatch(esigar_job_t *job, sigar_t *sigar, int cmd, char *bytes) {
     switch (cmd) {
 EOF
     for my $func (@$mappings) {
@@ -3007,12 +3455,12 @@ $name({sigar, S}$arg) ->
 EOF
         print $cfh <<EOF
         case ESIGAR_$cmd:
-          return e$func->{sigar_function}(port, sigar, bytes);
+          return e$func->{sigar_function}(job, sigar, bytes);
 EOF
     }
     print $cfh <<EOF;
      default:
-     esigar_notimpl(port, sigar, cmd);
+     esigar_notimpl(job, sigar, cmd);
      return SIGAR_ENOTIMPL;
     }
 }
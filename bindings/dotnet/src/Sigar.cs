@@ -19,9 +19,10 @@ using System.IO;
 using System.Collections;
 using System.Runtime.InteropServices;
 using System.Text;
+using System.Threading;
 
 namespace Hyperic.Sigar {
-    public class Sigar {
+    public class Sigar : IDisposable {
         internal const int OK = 0;
         internal const int SIGAR_START_ERROR = 20000;
         internal const int SIGAR_ENOTIMPL = (SIGAR_START_ERROR + 1);
@@ -42,6 +43,12 @@ namespace Hyperic.Sigar {
 
         internal const int FS_NAME_LEN = 64;
 
+        public const int PROC_SNAPSHOT_STATE = 0x01;
+        public const int PROC_SNAPSHOT_MEM   = 0x02;
+        public const int PROC_SNAPSHOT_TIME  = 0x04;
+        public const int PROC_SNAPSHOT_CPU   = 0x08;
+        public const int PROC_SNAPSHOT_ALL   = 0x0f;
+
         //cp sigar-x86-winnt.dll sigar.dll
         //ln -s libsigar-x86-linux.so libsigar.so
         //XXX can we determine the real name at runtime?
@@ -107,14 +114,47 @@ namespace Hyperic.Sigar {
             return Hyperic.Sigar.NetInterfaceStat.NativeGet(this, name);
         }
 
+        //Fill pids from one native call, returns the number of
+        //processes, which may be more than pids.Length
+        public int ProcList(long[] pids) {
+            return Hyperic.Sigar.ProcList.NativeGet(this, pids);
+        }
+
+        //Fill entries from one native snapshot of every process,
+        //returns the number of processes, which may be more than
+        //entries.Length.  Reuse entries between calls, nothing is
+        //allocated on the managed heap.
+        public int ProcSnapshot(ProcSnapshotEntry[] entries, int flags) {
+            return ProcSnapshotEntry.NativeGet(this, entries, flags);
+        }
+
+        //Stats for every interface from one native call, names may
+        //be null, returns the number of interfaces
+        public int NetInterfaceStatList(NetInterfaceStat[] stats,
+                                        String[] names) {
+            return NetInterfaceStatEntry.NativeGet(this, stats, names);
+        }
+
+        public void Close() {
+            if (this.sigar.Handle != IntPtr.Zero) {
+                sigar_close(this.sigar.Handle);
+                this.sigar = new HandleRef(this, IntPtr.Zero);
+            }
+            GC.SuppressFinalize(this);
+        }
+
+        public void Dispose() {
+            Close();
+        }
+
         ~Sigar() {
-            sigar_close(this.sigar.Handle);
+            if (this.sigar.Handle != IntPtr.Zero) {
+                sigar_close(this.sigar.Handle);
+            }
         }
 
         internal static IntPtr incrementIntPtr(IntPtr ptr, int size) {
-            Int32 x = (Int32)ptr;
-            x += size;
-            return (IntPtr)x;
+            return new IntPtr(ptr.ToInt64() + size);
         }
 
         internal static SigarException FindException(Sigar sigar, int errno) {
@@ -599,6 +639,24 @@ namespace Hyperic.Sigar {
         public readonly long TxOverruns;
         public readonly long TxCollisions;
         public readonly long TxCarrier;
+        public readonly long Speed;
+
+        internal NetInterfaceStat(IntPtr ptr) {
+            this.RxPackets    = Marshal.ReadInt64(ptr, 0*8);
+            this.RxBytes      = Marshal.ReadInt64(ptr, 1*8);
+            this.RxErrors     = Marshal.ReadInt64(ptr, 2*8);
+            this.RxDropped    = Marshal.ReadInt64(ptr, 3*8);
+            this.RxOverruns   = Marshal.ReadInt64(ptr, 4*8);
+            this.RxFrame      = Marshal.ReadInt64(ptr, 5*8);
+            this.TxPackets    = Marshal.ReadInt64(ptr, 6*8);
+            this.TxBytes      = Marshal.ReadInt64(ptr, 7*8);
+            this.TxErrors     = Marshal.ReadInt64(ptr, 8*8);
+            this.TxDropped    = Marshal.ReadInt64(ptr, 9*8);
+            this.TxOverruns   = Marshal.ReadInt64(ptr, 10*8);
+            this.TxCollisions = Marshal.ReadInt64(ptr, 11*8);
+            this.TxCarrier    = Marshal.ReadInt64(ptr, 12*8);
+            this.Speed        = Marshal.ReadInt64(ptr, 13*8);
+        }
 
         [DllImport(Sigar.LIBSIGAR)]
         private static extern int
@@ -626,4 +684,362 @@ namespace Hyperic.Sigar {
             return ifstat;
         }
     }
+
+    //sizes and alignment of the native types which differ by
+    //platform, used to walk native lists without PtrToStructure
+    internal sealed class NativeLayout {
+        private NativeLayout() { }
+
+        internal static readonly bool IsWindows =
+            (Environment.OSVersion.Platform == PlatformID.Win32NT) ||
+            (Environment.OSVersion.Platform == PlatformID.Win32Windows);
+
+        //sigar_pid_t is pid_t on unix
+        internal static readonly int PidSize = IsWindows ? 8 : 4;
+        //unsigned long is 32-bit on windows
+        internal static readonly int ULongSize =
+            IsWindows ? 4 : IntPtr.Size;
+        //64-bit fields are 4 byte aligned on 32-bit unix
+        internal static readonly int Align64 =
+            (IntPtr.Size == 4 && !IsWindows) ? 4 : 8;
+        internal static readonly int PidAlign =
+            (PidSize == 8) ? Align64 : 4;
+
+        internal static int Align(int offset, int align) {
+            return (offset + align - 1) & ~(align - 1);
+        }
+
+        internal static long ReadULong(IntPtr ptr, int offset) {
+            if (ULongSize == 8) {
+                return Marshal.ReadInt64(ptr, offset);
+            }
+            return (long)(uint)Marshal.ReadInt32(ptr, offset);
+        }
+
+        internal static long ReadPid(IntPtr ptr, int offset) {
+            if (PidSize == 8) {
+                return Marshal.ReadInt64(ptr, offset);
+            }
+            return Marshal.ReadInt32(ptr, offset);
+        }
+
+        //{ unsigned long number; unsigned long size; T *data; }
+        internal static readonly int ListSize =
+            Align(2 * ULongSize, IntPtr.Size) + IntPtr.Size;
+
+        internal static long ListNumber(IntPtr list) {
+            return ReadULong(list, 0);
+        }
+
+        internal static IntPtr ListData(IntPtr list) {
+            return Marshal.ReadIntPtr(list,
+                                      Align(2 * ULongSize, IntPtr.Size));
+        }
+    }
+
+    internal sealed class ProcList {
+        private ProcList() { }
+
+        [DllImport(Sigar.LIBSIGAR)]
+        private static extern int
+        sigar_proc_list_get(IntPtr sigar, IntPtr proclist);
+
+        [DllImport(Sigar.LIBSIGAR)]
+        private static extern int
+        sigar_proc_list_destroy(IntPtr sigar, IntPtr proclist);
+
+        internal static int NativeGet(Sigar sigar, long[] pids) {
+            IntPtr ptr = Marshal.AllocHGlobal(NativeLayout.ListSize);
+
+            int status = sigar_proc_list_get(sigar.sigar.Handle, ptr);
+
+            if (status != Sigar.OK) {
+                Marshal.FreeHGlobal(ptr);
+                throw Sigar.FindException(sigar, status);
+            }
+
+            int number = (int)NativeLayout.ListNumber(ptr);
+            IntPtr data = NativeLayout.ListData(ptr);
+            int max = Math.Min(number, pids.Length);
+
+            for (int i=0; i<max; i++) {
+                pids[i] =
+                    NativeLayout.ReadPid(data, i * NativeLayout.PidSize);
+            }
+
+            sigar_proc_list_destroy(sigar.sigar.Handle, ptr);
+
+            Marshal.FreeHGlobal(ptr);
+
+            return number;
+        }
+    }
+
+    //one process of a sigar_proc_snapshot_t, blittable, the name
+    //is left out so filling an array does not allocate
+    [StructLayout(LayoutKind.Sequential)]
+    public struct ProcSnapshotEntry {
+        public readonly long Pid;
+        public readonly int Flags; //Sigar.PROC_SNAPSHOT_* valid fields
+        public readonly int State;
+        public readonly long Ppid;
+        public readonly int Tty;
+        public readonly int Priority;
+        public readonly int Nice;
+        public readonly int Processor;
+        public readonly long Threads;
+        public readonly long MemSize;
+        public readonly long MemResident;
+        public readonly long MemShare;
+        public readonly long MemMinorFaults;
+        public readonly long MemMajorFaults;
+        public readonly long MemPageFaults;
+        public readonly long StartTime;
+        public readonly long User;
+        public readonly long Sys;
+        public readonly long Total;
+        public readonly double Percent;
+
+        //offsets into sigar_proc_snapshot_entry_t
+        private static readonly int PID, FLAGS, STATE, NAME_LEN = 128,
+            PPID, TTY, PRIORITY, NICE, PROCESSOR, THREADS, MEM, CPU, SIZE;
+
+        static ProcSnapshotEntry() {
+            int a64 = NativeLayout.Align64;
+            int off = 0;
+
+            PID = off;
+            off += NativeLayout.PidSize;
+            FLAGS = off = NativeLayout.Align(off, 4);
+            off += 4;
+
+            //sigar_proc_state_t
+            off = NativeLayout.Align(off, a64);
+            STATE = off + NAME_LEN; //char state follows char name[]
+            off = STATE + 1;
+            PPID = off = NativeLayout.Align(off, NativeLayout.PidAlign);
+            off += NativeLayout.PidSize;
+            TTY = off = NativeLayout.Align(off, 4);
+            PRIORITY = TTY + 4;
+            NICE = TTY + 8;
+            PROCESSOR = TTY + 12;
+            off = TTY + 16;
+            THREADS = off = NativeLayout.Align(off, a64);
+            off += 8;
+
+            //sigar_proc_mem_t
+            MEM = off = NativeLayout.Align(off, a64);
+            off += 6 * 8;
+
+            //sigar_proc_cpu_t, then sigar_uint64_t cgroup
+            CPU = off;
+            off += 6 * 8 + 8;
+
+            SIZE = NativeLayout.Align(off, a64);
+        }
+
+        private ProcSnapshotEntry(IntPtr ptr) {
+            this.Pid            = NativeLayout.ReadPid(ptr, PID);
+            this.Flags          = Marshal.ReadInt32(ptr, FLAGS);
+            this.State          = Marshal.ReadByte(ptr, STATE);
+            this.Ppid           = NativeLayout.ReadPid(ptr, PPID);
+            this.Tty            = Marshal.ReadInt32(ptr, TTY);
+            this.Priority       = Marshal.ReadInt32(ptr, PRIORITY);
+            this.Nice           = Marshal.ReadInt32(ptr, NICE);
+            this.Processor      = Marshal.ReadInt32(ptr, PROCESSOR);
+            this.Threads        = Marshal.ReadInt64(ptr, THREADS);
+            this.MemSize        = Marshal.ReadInt64(ptr, MEM + 0*8);
+            this.MemResident    = Marshal.ReadInt64(ptr, MEM + 1*8);
+            this.MemShare       = Marshal.ReadInt64(ptr, MEM + 2*8);
+            this.MemMinorFaults = Marshal.ReadInt64(ptr, MEM + 3*8);
+            this.MemMajorFaults = Marshal.ReadInt64(ptr, MEM + 4*8);
+            this.MemPageFaults  = Marshal.ReadInt64(ptr, MEM + 5*8);
+            this.StartTime      = Marshal.ReadInt64(ptr, CPU + 0*8);
+            this.User           = Marshal.ReadInt64(ptr, CPU + 1*8);
+            this.Sys            = Marshal.ReadInt64(ptr, CPU + 2*8);
+            this.Total          = Marshal.ReadInt64(ptr, CPU + 3*8);
+            this.Percent        =
+                BitConverter.Int64BitsToDouble(Marshal.ReadInt64(ptr,
+                                                                 CPU + 5*8));
+        }
+
+        [DllImport(Sigar.LIBSIGAR)]
+        private static extern int
+        sigar_proc_snapshot_get(IntPtr sigar, int flags, IntPtr snapshot);
+
+        [DllImport(Sigar.LIBSIGAR)]
+        private static extern int
+        sigar_proc_snapshot_destroy(IntPtr sigar, IntPtr snapshot);
+
+        internal static int NativeGet(Sigar sigar,
+                                      ProcSnapshotEntry[] entries,
+                                      int flags) {
+            IntPtr ptr = Marshal.AllocHGlobal(NativeLayout.ListSize);
+
+            int status =
+                sigar_proc_snapshot_get(sigar.sigar.Handle, flags, ptr);
+
+            if (status != Sigar.OK) {
+                Marshal.FreeHGlobal(ptr);
+                throw Sigar.FindException(sigar, status);
+            }
+
+            int number = (int)NativeLayout.ListNumber(ptr);
+            IntPtr eptr = NativeLayout.ListData(ptr);
+            int max = Math.Min(number, entries.Length);
+
+            for (int i=0; i<max; i++) {
+                entries[i] = new ProcSnapshotEntry(eptr);
+                eptr = Sigar.incrementIntPtr(eptr, SIZE);
+            }
+
+            sigar_proc_snapshot_destroy(sigar.sigar.Handle, ptr);
+
+            Marshal.FreeHGlobal(ptr);
+
+            return number;
+        }
+    }
+
+    internal sealed class NetInterfaceStatEntry {
+        private NetInterfaceStatEntry() { }
+
+        //char name[MAX_INTERFACE_NAME_LEN]; sigar_net_interface_stat_t stat;
+        private const int NAME_LEN = 256;
+        private const int SIZE = NAME_LEN + 14 * 8;
+
+        [DllImport(Sigar.LIBSIGAR)]
+        private static extern int
+        sigar_net_interface_stat_list_get(IntPtr sigar, IntPtr iflist);
+
+        [DllImport(Sigar.LIBSIGAR)]
+        private static extern int
+        sigar_net_interface_stat_list_destroy(IntPtr sigar, IntPtr iflist);
+
+        internal static int NativeGet(Sigar sigar,
+                                      NetInterfaceStat[] stats,
+                                      String[] names) {
+            IntPtr ptr = Marshal.AllocHGlobal(NativeLayout.ListSize);
+
+            int status =
+                sigar_net_interface_stat_list_get(sigar.sigar.Handle, ptr);
+
+            if (status != Sigar.OK) {
+                Marshal.FreeHGlobal(ptr);
+                throw Sigar.FindException(sigar, status);
+            }
+
+            int number = (int)NativeLayout.ListNumber(ptr);
+            IntPtr eptr = NativeLayout.ListData(ptr);
+            int max = Math.Min(number, stats.Length);
+
+            for (int i=0; i<max; i++) {
+                stats[i] =
+                    new NetInterfaceStat(Sigar.incrementIntPtr(eptr,
+                                                               NAME_LEN));
+                if ((names != null) && (i < names.Length)) {
+                    names[i] = Marshal.PtrToStringAnsi(eptr);
+                }
+                eptr = Sigar.incrementIntPtr(eptr, SIZE);
+            }
+
+            sigar_net_interface_stat_list_destroy(sigar.sigar.Handle, ptr);
+
+            Marshal.FreeHGlobal(ptr);
+
+            return number;
+        }
+    }
+
+    //Sigar handles for concurrent callers, a handle is used by one
+    //thread at a time:
+    //  using (SigarPool.Lease lease = pool.Get()) {
+    //      lease.Sigar.ProcSnapshot(entries, Sigar.PROC_SNAPSHOT_ALL);
+    //  }
+    public class SigarPool : IDisposable {
+        private readonly Stack idle = new Stack();
+        private readonly int size;
+        private int open = 0;
+        private bool closed = false;
+
+        public SigarPool(int size) {
+            this.size = (size < 1) ? 1 : size;
+        }
+
+        public class Lease : IDisposable {
+            private SigarPool pool;
+            private Sigar sigar;
+
+            internal Lease(SigarPool pool, Sigar sigar) {
+                this.pool = pool;
+                this.sigar = sigar;
+            }
+
+            public Sigar Sigar {
+                get {
+                    return this.sigar;
+                }
+            }
+
+            public void Dispose() {
+                if (this.sigar != null) {
+                    this.pool.Put(this.sigar);
+                    this.sigar = null;
+                }
+            }
+        }
+
+        //blocks until a handle is idle or one more may be opened
+        public Lease Get() {
+            lock (this.idle) {
+                while (true) {
+                    if (this.closed) {
+                        throw new ObjectDisposedException("SigarPool");
+                    }
+                    if (this.idle.Count > 0) {
+                        return new Lease(this, (Sigar)this.idle.Pop());
+                    }
+                    if (this.open < this.size) {
+                        this.open++;
+                        break;
+                    }
+                    Monitor.Wait(this.idle);
+                }
+            }
+
+            try {
+                return new Lease(this, new Sigar());
+            } catch {
+                lock (this.idle) {
+                    this.open--;
+                    Monitor.Pulse(this.idle);
+                }
+                throw;
+            }
+        }
+
+        internal void Put(Sigar sigar) {
+            lock (this.idle) {
+                if (!this.closed) {
+                    this.idle.Push(sigar);
+                    Monitor.Pulse(this.idle);
+                    return;
+                }
+                this.open--;
+            }
+            sigar.Close();
+        }
+
+        //closes idle handles now, leased ones when they come back
+        public void Dispose() {
+            lock (this.idle) {
+                this.closed = true;
+                while (this.idle.Count > 0) {
+                    ((Sigar)this.idle.Pop()).Close();
+                    this.open--;
+                }
+                Monitor.PulseAll(this.idle);
+            }
+        }
+    }
 }
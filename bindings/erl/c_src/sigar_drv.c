@@ -18,6 +18,7 @@
 #include <erl_driver.h>
 #include <ei.h>
 #include <ctype.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "sigar.h"
@@ -25,11 +26,28 @@
 #include "sigar_format.h"
 #include "sigar_ptql.h"
 
+/*
+ * commands run on the emulator async thread pool (erl +A) so that
+ * slow calls such as ps or df never block a scheduler.  every job
+ * of a port is queued with the same key, pinning it to one async
+ * thread: sigar_t is not thread safe and replies must come back in
+ * request order.  with the pool disabled the emulator runs the job
+ * inline, as before.
+ */
 typedef struct {
     ErlDrvPort port;
     sigar_t *sigar;
+    unsigned int key;
+    int jobs;     /* queued or running */
+    int stopped;
 } sigar_drv_t;
 
+typedef struct {
+    sigar_drv_t *sd;
+    char *buf;    /* command byte followed by nul terminated args */
+    ei_x_buff x;  /* encoded reply */
+} esigar_job_t;
+
 static ErlDrvData start(ErlDrvPort port, char *cmd) {
     sigar_drv_t *sd = (sigar_drv_t *)driver_alloc(sizeof(*sd));
     int status;
@@ -41,14 +59,28 @@ static ErlDrvData start(ErlDrvPort port, char *cmd) {
     }
 
     sd->port = port;
+    sd->key = (unsigned int)(unsigned long)port;
+    sd->jobs = 0;
+    sd->stopped = 0;
 
     return (ErlDrvData)sd;
 }
 
+static void esigar_drv_free(sigar_drv_t *sd)
+{
+    if (sd->sigar) {
+        sigar_close(sd->sigar);
+    }
+    driver_free(sd);
+}
+
 static void stop(ErlDrvData handle) {
-    sigar_drv_t *driver_data = (sigar_drv_t *)handle;
-    if (driver_data->sigar) {
-        sigar_close(driver_data->sigar);
+    sigar_drv_t *sd = (sigar_drv_t *)handle;
+
+    /* an async thread may still be using sd->sigar */
+    sd->stopped = 1;
+    if (sd->jobs == 0) {
+        esigar_drv_free(sd);
     }
 }
 
@@ -125,9 +157,9 @@ static void esigar_to_list(ei_x_buff *x,
     ei_x_encode_atom(x, "error"); \
     ei_x_encode_string(x, sigar_strerror(sigar, status))
 
-#define ESIGAR_SEND(p, x) \
-    driver_output(port, (x)->buff, (x)->index); \
-    ei_x_free(x)
+/* hand the reply to the job, ready_async does the driver_output */
+#define ESIGAR_SEND(j, buf) \
+    (j)->x = *(buf)
 
 #define esigar_encode_long(x, k, v) \
     ei_x_encode_tuple_header(x, 2); \
@@ -165,18 +197,18 @@ static void esigar_encode_net_address(ei_x_buff *x, const char *key,
 #define esigar_encode_netaddr(x, k, v) \
     esigar_encode_net_address(x, k, &v)
 
-static void esigar_notimpl(ErlDrvPort port, sigar_t *sigar, int cmd)
+static void esigar_notimpl(esigar_job_t *job, sigar_t *sigar, int cmd)
 {
     ei_x_buff x;
 
     ESIGAR_NEW(&x);
     ESIGAR_ERROR(&x, sigar, SIGAR_ENOTIMPL);
-    ESIGAR_SEND(port, &x);
+    ESIGAR_SEND(job, &x);
 }
 
 #include "../priv/gen/sigar_drv_gen.c"
 
-static void esigar_loadavg_get(ErlDrvPort port, sigar_t *sigar)
+static void esigar_loadavg_get(esigar_job_t *job, sigar_t *sigar)
 {
     int status;
     ei_x_buff x;
@@ -197,10 +229,10 @@ static void esigar_loadavg_get(ErlDrvPort port, sigar_t *sigar)
         ESIGAR_ERROR(&x, sigar, status);
     }
 
-    ESIGAR_SEND(port, &x);
+    ESIGAR_SEND(job, &x);
 }
 
-static void esigar_net_connection_list_get(ErlDrvPort port, sigar_t *sigar,
+static void esigar_net_connection_list_get(esigar_job_t *job, sigar_t *sigar,
                                            unsigned int flags)
 {
     int status;
@@ -223,10 +255,10 @@ static void esigar_net_connection_list_get(ErlDrvPort port, sigar_t *sigar,
         ESIGAR_ERROR(&x, sigar, status);
     }
 
-    ESIGAR_SEND(port, &x);
+    ESIGAR_SEND(job, &x);
 }
 
-static void esigar_net_interface_list_get(ErlDrvPort port, sigar_t *sigar)
+static void esigar_net_interface_list_get(esigar_job_t *job, sigar_t *sigar)
 {
     int status;
     ei_x_buff x;
@@ -244,10 +276,10 @@ static void esigar_net_interface_list_get(ErlDrvPort port, sigar_t *sigar)
         ESIGAR_ERROR(&x, sigar, status);
     }
 
-    ESIGAR_SEND(port, &x);
+    ESIGAR_SEND(job, &x);
 }
 
-static void esigar_file_system_list_get(ErlDrvPort port, sigar_t *sigar)
+static void esigar_file_system_list_get(esigar_job_t *job, sigar_t *sigar)
 {
     int status;
     ei_x_buff x;
@@ -269,10 +301,10 @@ static void esigar_file_system_list_get(ErlDrvPort port, sigar_t *sigar)
         ESIGAR_ERROR(&x, sigar, status);
     }
 
-    ESIGAR_SEND(port, &x);
+    ESIGAR_SEND(job, &x);
 }
 
-static void esigar_net_route_list_get(ErlDrvPort port, sigar_t *sigar)
+static void esigar_net_route_list_get(esigar_job_t *job, sigar_t *sigar)
 {
     int status;
     ei_x_buff x;
@@ -294,10 +326,10 @@ static void esigar_net_route_list_get(ErlDrvPort port, sigar_t *sigar)
         ESIGAR_ERROR(&x, sigar, status);
     }
 
-    ESIGAR_SEND(port, &x);
+    ESIGAR_SEND(job, &x);
 }
 
-static void esigar_cpu_info_list_get(ErlDrvPort port, sigar_t *sigar)
+static void esigar_cpu_info_list_get(esigar_job_t *job, sigar_t *sigar)
 {
     int status;
     ei_x_buff x;
@@ -319,10 +351,10 @@ static void esigar_cpu_info_list_get(ErlDrvPort port, sigar_t *sigar)
         ESIGAR_ERROR(&x, sigar, status);
     }
 
-    ESIGAR_SEND(port, &x);
+    ESIGAR_SEND(job, &x);
 }
 
-static void esigar_arp_list_get(ErlDrvPort port, sigar_t *sigar)
+static void esigar_arp_list_get(esigar_job_t *job, sigar_t *sigar)
 {
     int status;
     ei_x_buff x;
@@ -344,10 +376,10 @@ static void esigar_arp_list_get(ErlDrvPort port, sigar_t *sigar)
         ESIGAR_ERROR(&x, sigar, status);
     }
 
-    ESIGAR_SEND(port, &x);
+    ESIGAR_SEND(job, &x);
 }
 
-static void esigar_who_list_get(ErlDrvPort port, sigar_t *sigar)
+static void esigar_who_list_get(esigar_job_t *job, sigar_t *sigar)
 {
     int status;
     ei_x_buff x;
@@ -369,48 +401,184 @@ static void esigar_who_list_get(ErlDrvPort port, sigar_t *sigar)
         ESIGAR_ERROR(&x, sigar, status);
     }
 
-    ESIGAR_SEND(port, &x);
+    ESIGAR_SEND(job, &x);
 }
 
-static void outputv(ErlDrvData handle, ErlIOVec *ev) {
-    sigar_drv_t *sd = (sigar_drv_t *)handle;
-    sigar_t *sigar = sd->sigar;
-    ErlDrvPort port = sd->port;
-    ErlDrvBinary *data = ev->binv[1];
-    int cmd = data->orig_bytes[0];
+static void esigar_be64_put(unsigned char *ptr, sigar_uint64_t val)
+{
+    int i;
+
+    for (i=7; i>=0; i--) {
+        ptr[i] = (unsigned char)(val & 0xff);
+        val >>= 8;
+    }
+}
+
+#define ESIGAR_PROC_SNAPSHOT_FIELDS 13
+
+/*
+ * {ok, {Records, Names}}: Records is one binary of fixed width big-endian
+ * rows decoded by sigar:proc_snapshot/1, Names is nul separated.
+ * a couple of binaries instead of a term per field keeps encoding and
+ * binary_to_term cheap for a few thousand processes.
+ */
+static void esigar_proc_snapshot_get(esigar_job_t *job, sigar_t *sigar)
+{
+    int status;
+    ei_x_buff x;
+    sigar_proc_snapshot_t snapshot;
+
+    ei_x_new_with_version(&x);
+
+    if ((status = sigar_proc_snapshot_get(sigar, SIGAR_PROC_SNAPSHOT_ALL,
+                                          &snapshot)) == SIGAR_OK)
+    {
+        unsigned long i, namelen = 0;
+        size_t rowlen = ESIGAR_PROC_SNAPSHOT_FIELDS * 8;
+        unsigned char *rows, *ptr;
+        char *names, *nptr;
+
+        for (i=0; i<snapshot.number; i++) {
+            namelen += strlen(snapshot.data[i].state.name) + 1;
+        }
+
+        rows = malloc(snapshot.number * rowlen + 1);
+        names = nptr = malloc(namelen + 1);
+
+        for (i=0, ptr=rows; i<snapshot.number; i++) {
+            sigar_proc_snapshot_entry_t *entry = &snapshot.data[i];
+            union {
+                double d;
+                sigar_uint64_t u;
+            } percent;
+            size_t len = strlen(entry->state.name) + 1;
+
+            percent.d = entry->cpu.percent;
+
+            esigar_be64_put(ptr, entry->pid); ptr += 8;
+            esigar_be64_put(ptr, entry->flags); ptr += 8;
+            esigar_be64_put(ptr, entry->state.state); ptr += 8;
+            esigar_be64_put(ptr, entry->state.ppid); ptr += 8;
+            esigar_be64_put(ptr, entry->state.threads); ptr += 8;
+            esigar_be64_put(ptr, entry->mem.size); ptr += 8;
+            esigar_be64_put(ptr, entry->mem.resident); ptr += 8;
+            esigar_be64_put(ptr, entry->mem.share); ptr += 8;
+            esigar_be64_put(ptr, entry->cpu.start_time); ptr += 8;
+            esigar_be64_put(ptr, entry->cpu.user); ptr += 8;
+            esigar_be64_put(ptr, entry->cpu.sys); ptr += 8;
+            esigar_be64_put(ptr, entry->cpu.total); ptr += 8;
+            esigar_be64_put(ptr, percent.u); ptr += 8;
+
+            memcpy(nptr, entry->state.name, len);
+            nptr += len;
+        }
+
+        ESIGAR_OK(&x);
+        ei_x_encode_tuple_header(&x, 2);
+        ei_x_encode_binary(&x, rows, snapshot.number * rowlen);
+        ei_x_encode_binary(&x, names, namelen);
+
+        free(rows);
+        free(names);
+        sigar_proc_snapshot_destroy(sigar, &snapshot);
+    }
+    else {
+        ESIGAR_ERROR(&x, sigar, status);
+    }
+
+    ESIGAR_SEND(job, &x);
+}
+
+/* async thread */
+static void esigar_invoke(void *data)
+{
+    esigar_job_t *job = (esigar_job_t *)data;
+    sigar_t *sigar = job->sd->sigar;
+    int cmd = job->buf[0];
+    char *bytes = &job->buf[1];
 
     switch(cmd) {
     case ESIGAR_NET_CONNECTION_LIST:
-        esigar_net_connection_list_get(port, sigar,
-                                       data->orig_bytes[1]);
+        esigar_net_connection_list_get(job, sigar, bytes[0]);
         break;
     case ESIGAR_NET_INTERFACE_LIST:
-        esigar_net_interface_list_get(port, sigar);
+        esigar_net_interface_list_get(job, sigar);
         break;
     case ESIGAR_NET_ROUTE_LIST:
-        esigar_net_route_list_get(port, sigar);
+        esigar_net_route_list_get(job, sigar);
         break;
     case ESIGAR_FILE_SYSTEM_LIST:
-        esigar_file_system_list_get(port, sigar);
+        esigar_file_system_list_get(job, sigar);
         break;
     case ESIGAR_CPU_INFO_LIST:
-        esigar_cpu_info_list_get(port, sigar);
+        esigar_cpu_info_list_get(job, sigar);
         break;
     case ESIGAR_ARP_LIST:
-        esigar_arp_list_get(port, sigar);
+        esigar_arp_list_get(job, sigar);
         break;
     case ESIGAR_WHO_LIST:
-        esigar_who_list_get(port, sigar);
+        esigar_who_list_get(job, sigar);
         break;
     case ESIGAR_LOADAVG:
-        esigar_loadavg_get(port, sigar);
+        esigar_loadavg_get(job, sigar);
+        break;
+    case ESIGAR_PROC_SNAPSHOT:
+        esigar_proc_snapshot_get(job, sigar);
         break;
     default:
-        esigar_dispatch(port, sigar, cmd, &data->orig_bytes[1]);
+        esigar_dispatch(job, sigar, cmd, bytes);
         break;
     }
 }
 
+/* scheduler thread, called once per job either from ready_async
+ * or by the emulator when the port closed before the job finished */
+static void esigar_job_free(void *data)
+{
+    esigar_job_t *job = (esigar_job_t *)data;
+    sigar_drv_t *sd = job->sd;
+
+    if (job->x.buff) {
+        ei_x_free(&job->x);
+    }
+    driver_free(job->buf);
+    driver_free(job);
+
+    if ((--sd->jobs == 0) && sd->stopped) {
+        esigar_drv_free(sd);
+    }
+}
+
+static void ready_async(ErlDrvData handle, ErlDrvThreadData data)
+{
+    sigar_drv_t *sd = (sigar_drv_t *)handle;
+    esigar_job_t *job = (esigar_job_t *)data;
+
+    if (job->x.buff) {
+        driver_output(sd->port, job->x.buff, job->x.index);
+    }
+    esigar_job_free(job);
+}
+
+static void outputv(ErlDrvData handle, ErlIOVec *ev) {
+    sigar_drv_t *sd = (sigar_drv_t *)handle;
+    esigar_job_t *job;
+
+    if ((ev->size < 1) || !sd->sigar) {
+        return;
+    }
+
+    job = (esigar_job_t *)driver_alloc(sizeof(*job));
+    job->sd = sd;
+    job->buf = driver_alloc(ev->size + 1);
+    driver_vec_to_buf(ev, job->buf, ev->size);
+    job->buf[ev->size] = '\0';
+    memset(&job->x, 0, sizeof(job->x));
+
+    sd->jobs++;
+    driver_async(sd->port, &sd->key, esigar_invoke, job, esigar_job_free);
+}
+
 static ErlDrvEntry sigar_driver_entry = {
     NULL,                             /* init */
     start,                            /* startup */
@@ -424,7 +592,7 @@ static ErlDrvEntry sigar_driver_entry = {
     NULL,                             /* control */
     NULL,                             /* timeout */
     outputv,                          /* outputv */
-    NULL,                             /* ready_async */
+    ready_async,                      /* ready_async */
     NULL,                             /* flush */
     NULL,                             /* call */
     NULL,                             /* event */
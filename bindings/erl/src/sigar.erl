@@ -30,7 +30,8 @@
          file_system_list/1,
          cpu_info_list/1,
          arp_list/1,
-         who_list/1]).
+         who_list/1,
+         proc_snapshot/1]).
 
 -define(NETCONN_CLIENT, 0x01).
 -define(NETCONN_SERVER, 0x02).
@@ -75,6 +76,28 @@ arp_list({sigar, S}) ->
 who_list({sigar, S}) ->
     do_command(S, ?WHO_LIST).
 
+% state, mem and cpu of every process in one call,
+% rows are {Pid, Name, Flags, State, Ppid, Threads,
+%           Size, Resident, Share, StartTime, User, Sys, Total, Percent}
+proc_snapshot({sigar, S}) ->
+    case do_command(S, ?PROC_SNAPSHOT) of
+        {ok, {Rows, Names}} ->
+            {ok, proc_snapshot_rows(Rows, binary:split(Names, <<0>>, [global]))};
+        Error ->
+            Error
+    end.
+
+proc_snapshot_rows(<<Pid:64, Flags:64, State:64, Ppid:64/signed, Threads:64/signed,
+                     Size:64/signed, Resident:64/signed, Share:64/signed,
+                     StartTime:64/signed, User:64/signed, Sys:64/signed,
+                     Total:64/signed, Percent:64/float, Rest/binary>>,
+                   [Name | Names]) ->
+    [{Pid, binary_to_list(Name), Flags, State, Ppid, Threads,
+      Size, Resident, Share, StartTime, User, Sys, Total, Percent} |
+     proc_snapshot_rows(Rest, Names)];
+proc_snapshot_rows(<<>>, _) ->
+    [].
+
 % generated by SigarWrapper.pm
 -include("../priv/gen/sigar_gen.hrl").
 
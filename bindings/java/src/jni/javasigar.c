@@ -25,6 +25,7 @@
 #include "sigar_util.h"
 #include "sigar_os.h"
 #include "sigar_format.h"
+#include "sigar_sampler.h"
 
 #include <string.h>
 
@@ -63,8 +64,15 @@ typedef struct {
     jobject logger;
     sigar_t *sigar;
     jsigar_field_cache_t *fields[JSIGAR_FIELDS_MAX];
+    /* hand written classes, same lifetime as the generated ones */
+    jsigar_field_cache_t *fs_fields;
+    jclass nfs_classref;
+    jsigar_field_cache_t *snapshot_fields;
     int open_status;
     jthrowable not_impl;
+    sigar_cpu_sampler_t *cpu_sampler;      /* CpuPerc.sample */
+    sigar_cpu_sampler_t *cpu_list_sampler; /* getCpuPercListNative */
+    sigar_cpu_perc_list_t cpu_percs;
 } jni_sigar_t;
 
 #define dSIGAR_GET \
@@ -183,22 +191,38 @@ static void sigar_throw_error(JNIEnv *env, jni_sigar_t *jsigar, int err)
                    sigar_strerror(jsigar->sigar, err));
 }
 
-static void *sigar_get_pointer(JNIEnv *env, jobject obj) {
-    jfieldID pointer_field;
+static jfieldID sigar_pointer_field_get(JNIEnv *env, jobject obj) {
     jclass cls = JENV->GetObjectClass(env, obj);
 
 #ifdef SIGAR_POINTER_LONG
-    pointer_field = JENV->GetFieldID(env, cls, "longSigarWrapper", "J");
+    return JENV->GetFieldID(env, cls, "longSigarWrapper", "J");
+#else
+    return JENV->GetFieldID(env, cls, "sigarWrapper", "I");
+#endif
+}
+
+static void *sigar_pointer_field_read(JNIEnv *env, jobject obj,
+                                      jfieldID pointer_field) {
+#ifdef SIGAR_POINTER_LONG
     return (void *)JENV->GetLongField(env, obj, pointer_field);
 #else
-    pointer_field = JENV->GetFieldID(env, cls, "sigarWrapper", "I");
     return (void *)JENV->GetIntField(env, obj, pointer_field);
 #endif
 }
 
+static void *sigar_get_pointer(JNIEnv *env, jobject obj) {
+    return sigar_pointer_field_read(env, obj,
+                                    sigar_pointer_field_get(env, obj));
+}
+
+/* Sigar.{long}sigarWrapper, looked up once by open */
+static jfieldID jsigar_pointer_field = NULL;
+
 static jni_sigar_t *sigar_get_jpointer(JNIEnv *env, jobject obj) {
-    jni_sigar_t *jsigar =
-        (jni_sigar_t *)sigar_get_pointer(env, obj);
+    jni_sigar_t *jsigar = (jni_sigar_t *)
+        (jsigar_pointer_field ?
+         sigar_pointer_field_read(env, obj, jsigar_pointer_field) :
+         sigar_get_pointer(env, obj));
 
     if (!jsigar) {
         sigar_throw_exception(env, "sigar has been closed");
@@ -215,14 +239,11 @@ static jni_sigar_t *sigar_get_jpointer(JNIEnv *env, jobject obj) {
 }
 
 static void sigar_set_pointer(JNIEnv *env, jobject obj, const void *ptr) {
-    jfieldID pointer_field;
-    jclass cls = JENV->GetObjectClass(env, obj);
+    jfieldID pointer_field = sigar_pointer_field_get(env, obj);
 
 #ifdef SIGAR_POINTER_LONG
-    pointer_field = JENV->GetFieldID(env, cls, "longSigarWrapper", "J");
     JENV->SetLongField(env, obj, pointer_field, (jlong)ptr);
 #else
-    pointer_field = JENV->GetFieldID(env, cls, "sigarWrapper", "I");
     JENV->SetIntField(env, obj, pointer_field, (int)ptr);
 #endif
 }
@@ -292,6 +313,27 @@ JNIEXPORT jstring SIGAR_JNIx(getNativeScmRevision)
     return JENV->NewStringUTF(env, version->scm_revision);
 }
 
+static jsigar_field_cache_t *jsigar_field_cache_new(JNIEnv *env,
+                                                    jclass cls, int num)
+{
+    jsigar_field_cache_t *cache = malloc(sizeof(*cache));
+
+    cache->classref = (jclass)JENV->NewGlobalRef(env, cls);
+    cache->ids = malloc(num * sizeof(*cache->ids));
+
+    return cache;
+}
+
+static void jsigar_field_cache_free(JNIEnv *env,
+                                    jsigar_field_cache_t *cache)
+{
+    if (cache) {
+        JENV->DeleteGlobalRef(env, cache->classref);
+        free(cache->ids);
+        free(cache);
+    }
+}
+
 JNIEXPORT void SIGAR_JNIx(open)
 (JNIEnv *env, jobject obj)
 {
@@ -299,6 +341,10 @@ JNIEXPORT void SIGAR_JNIx(open)
 
     memset(jsigar, '\0', sizeof(*jsigar));
 
+    if (!jsigar_pointer_field) {
+        jsigar_pointer_field = sigar_pointer_field_get(env, obj);
+    }
+
     sigar_set_pointer(env, obj, jsigar);
         
     /* this method is called by the constructor.
@@ -332,13 +378,21 @@ JNIEXPORT jint SIGAR_JNIx(nativeClose)
         JENV->DeleteGlobalRef(env, jsigar->not_impl);
     }
 
+    if (jsigar->cpu_sampler) {
+        sigar_cpu_sampler_destroy(jsigar->cpu_sampler);
+    }
+    if (jsigar->cpu_list_sampler) {
+        sigar_cpu_sampler_destroy(jsigar->cpu_list_sampler);
+    }
+    sigar_cpu_perc_list_destroy(&jsigar->cpu_percs);
+
     for (i=0; i<JSIGAR_FIELDS_MAX; i++) {
-        if (jsigar->fields[i]) {
-            JENV->DeleteGlobalRef(env,
-                                  jsigar->fields[i]->classref);
-            free(jsigar->fields[i]->ids);
-            free(jsigar->fields[i]);
-        }
+        jsigar_field_cache_free(env, jsigar->fields[i]);
+    }
+    jsigar_field_cache_free(env, jsigar->fs_fields);
+    jsigar_field_cache_free(env, jsigar->snapshot_fields);
+    if (jsigar->nfs_classref) {
+        JENV->DeleteGlobalRef(env, jsigar->nfs_classref);
     }
 
     free(jsigar);
@@ -417,8 +471,8 @@ JNIEXPORT jobjectArray SIGAR_JNIx(getFileSystemListNative)
     unsigned int i;
     sigar_file_system_list_t fslist;
     jobjectArray fsarray;
-    jfieldID ids[FS_FIELD_MAX];
-    jclass nfs_cls=NULL, cls = SIGAR_FIND_CLASS("FileSystem");
+    jfieldID *ids;
+    jclass cls;
     dSIGAR(NULL);
 
     if ((status = sigar_file_system_list_get(sigar, &fslist)) != SIGAR_OK) {
@@ -426,23 +480,34 @@ JNIEXPORT jobjectArray SIGAR_JNIx(getFileSystemListNative)
         return NULL;
     }
 
-    ids[FS_FIELD_DIRNAME] =
-        JENV->GetFieldID(env, cls, "dirName", STRING_SIG);
+    if (!jsigar->fs_fields) {
+        cls = SIGAR_FIND_CLASS("FileSystem");
+        SIGAR_CHEX;
 
-    ids[FS_FIELD_DEVNAME] =
-        JENV->GetFieldID(env, cls, "devName", STRING_SIG);
+        jsigar->fs_fields = jsigar_field_cache_new(env, cls, FS_FIELD_MAX);
+        ids = jsigar->fs_fields->ids;
 
-    ids[FS_FIELD_TYPENAME] =
-        JENV->GetFieldID(env, cls, "typeName", STRING_SIG);
+        ids[FS_FIELD_DIRNAME] =
+            JENV->GetFieldID(env, cls, "dirName", STRING_SIG);
 
-    ids[FS_FIELD_SYS_TYPENAME] =
-        JENV->GetFieldID(env, cls, "sysTypeName", STRING_SIG);
+        ids[FS_FIELD_DEVNAME] =
+            JENV->GetFieldID(env, cls, "devName", STRING_SIG);
 
-    ids[FS_FIELD_OPTIONS] =
-        JENV->GetFieldID(env, cls, "options", STRING_SIG);
+        ids[FS_FIELD_TYPENAME] =
+            JENV->GetFieldID(env, cls, "typeName", STRING_SIG);
 
-    ids[FS_FIELD_TYPE] =
-        JENV->GetFieldID(env, cls, "type", "I");
+        ids[FS_FIELD_SYS_TYPENAME] =
+            JENV->GetFieldID(env, cls, "sysTypeName", STRING_SIG);
+
+        ids[FS_FIELD_OPTIONS] =
+            JENV->GetFieldID(env, cls, "options", STRING_SIG);
+
+        ids[FS_FIELD_TYPE] =
+            JENV->GetFieldID(env, cls, "type", "I");
+    }
+
+    cls = jsigar->fs_fields->classref;
+    ids = jsigar->fs_fields->ids;
 
     fsarray = JENV->NewObjectArray(env, fslist.number, cls, 0);
     SIGAR_CHEX;
@@ -459,10 +524,13 @@ JNIEXPORT jobjectArray SIGAR_JNIx(getFileSystemListNative)
             (strcmp(fs->sys_type_name, "nfs") == 0) &&
             strstr(fs->dev_name, ":/"))
         {
-            if (!nfs_cls) {
-                nfs_cls = SIGAR_FIND_CLASS("NfsFileSystem");
+            if (!jsigar->nfs_classref) {
+                jclass nfs_cls = SIGAR_FIND_CLASS("NfsFileSystem");
+                SIGAR_CHEX;
+                jsigar->nfs_classref =
+                    (jclass)JENV->NewGlobalRef(env, nfs_cls);
             }
-            obj_cls = nfs_cls;
+            obj_cls = jsigar->nfs_classref;
         }
         else {
             obj_cls = cls;
@@ -612,6 +680,87 @@ JNIEXPORT jobjectArray SIGAR_JNIx(getCpuListNative)
     return cpuarray;
 }
 
+/* the previous tick stays native, nothing is kept on the java side */
+static int jsigar_cpu_sample(sigar_t *sigar,
+                             sigar_cpu_sampler_t **sampler, int flags)
+{
+    int status;
+
+    if (!*sampler) {
+        if ((status = sigar_cpu_sampler_create(sampler, flags, 2))) {
+            return status;
+        }
+    }
+
+    return sigar_cpu_sampler_update(sigar, *sampler);
+}
+
+JNIEXPORT jboolean SIGAR_JNI(CpuPerc_sample)
+(JNIEnv *env, jobject jperc, jobject sigar_obj)
+{
+    int status;
+    sigar_cpu_perc_t perc;
+    dSIGAR(JNI_FALSE);
+
+    status = jsigar_cpu_sample(sigar, &jsigar->cpu_sampler,
+                               SIGAR_SAMPLER_CPU);
+    if (status != SIGAR_OK) {
+        sigar_throw_error(env, jsigar, status);
+        return JNI_FALSE;
+    }
+
+    if (sigar_cpu_sampler_perc_get(jsigar->cpu_sampler, 0,
+                                   &perc, NULL) != SIGAR_OK)
+    {
+        return JNI_FALSE; /* first tick */
+    }
+
+    JAVA_SIGAR_INIT_FIELDS_CPUPERC(JENV->GetObjectClass(env, jperc));
+    JAVA_SIGAR_SET_FIELDS_CPUPERC(NULL, jperc, perc);
+
+    return JNI_TRUE;
+}
+
+JNIEXPORT jobjectArray SIGAR_JNIx(getCpuPercListNative)
+(JNIEnv *env, jobject sigar_obj)
+{
+    int status;
+    unsigned int i;
+    jobjectArray percarray;
+    jclass cls = SIGAR_FIND_CLASS("CpuPerc");
+    sigar_cpu_perc_list_t *percs;
+    dSIGAR(NULL);
+
+    status = jsigar_cpu_sample(sigar, &jsigar->cpu_list_sampler,
+                               SIGAR_SAMPLER_CPU_LIST);
+    if (status != SIGAR_OK) {
+        sigar_throw_error(env, jsigar, status);
+        return NULL;
+    }
+
+    percs = &jsigar->cpu_percs;
+    if (sigar_cpu_sampler_perc_get(jsigar->cpu_list_sampler, 0,
+                                   NULL, percs) != SIGAR_OK)
+    {
+        return NULL; /* first tick */
+    }
+
+    JAVA_SIGAR_INIT_FIELDS_CPUPERC(cls);
+
+    percarray = JENV->NewObjectArray(env, percs->number, cls, 0);
+    SIGAR_CHEX;
+
+    for (i=0; i<percs->number; i++) {
+        jobject perc_obj = JENV->AllocObject(env, cls);
+        SIGAR_CHEX;
+        JAVA_SIGAR_SET_FIELDS_CPUPERC(cls, perc_obj, percs->data[i]);
+        JENV->SetObjectArrayElement(env, percarray, i, perc_obj);
+        SIGAR_CHEX;
+    }
+
+    return percarray;
+}
+
 JNIEXPORT void SIGAR_JNI(CpuPerc_gather)
 (JNIEnv *env, jobject jperc, jobject sigar_obj, jobject jprev, jobject jcurr)
 {
@@ -667,6 +816,184 @@ JNIEXPORT jlongArray SIGAR_JNIx(getProcList)
     return procarray;
 }
 
+/* must match the column constants in ProcSnapshot.java */
+enum {
+    PROC_SNAPSHOT_COL_PID,
+    PROC_SNAPSHOT_COL_FLAGS,
+    PROC_SNAPSHOT_COL_STATE,
+    PROC_SNAPSHOT_COL_PPID,
+    PROC_SNAPSHOT_COL_TTY,
+    PROC_SNAPSHOT_COL_PRIORITY,
+    PROC_SNAPSHOT_COL_NICE,
+    PROC_SNAPSHOT_COL_PROCESSOR,
+    PROC_SNAPSHOT_COL_THREADS,
+    PROC_SNAPSHOT_COL_MEM_SIZE,
+    PROC_SNAPSHOT_COL_MEM_RESIDENT,
+    PROC_SNAPSHOT_COL_MEM_SHARE,
+    PROC_SNAPSHOT_COL_MEM_MINOR_FAULTS,
+    PROC_SNAPSHOT_COL_MEM_MAJOR_FAULTS,
+    PROC_SNAPSHOT_COL_MEM_PAGE_FAULTS,
+    PROC_SNAPSHOT_COL_START_TIME,
+    PROC_SNAPSHOT_COL_USER,
+    PROC_SNAPSHOT_COL_SYS,
+    PROC_SNAPSHOT_COL_TOTAL,
+    PROC_SNAPSHOT_COL_MAX
+};
+
+enum {
+    PROC_SNAPSHOT_FIELD_NUMBER,
+    PROC_SNAPSHOT_FIELD_VALUES,
+    PROC_SNAPSHOT_FIELD_PERCENT,
+    PROC_SNAPSHOT_FIELD_NAMES,
+    PROC_SNAPSHOT_FIELD_MAX
+};
+
+/*
+ * the whole snapshot crosses JNI as one long[] (+ double[] percent
+ * and String[] names when asked for), rather than as an object per
+ * process with a Set*Field per value.
+ */
+JNIEXPORT void SIGAR_JNI(ProcSnapshot_gather)
+(JNIEnv *env, jobject obj, jobject sigar_obj, jint flags)
+{
+    int status;
+    unsigned long i, n;
+    sigar_proc_snapshot_t snapshot;
+    jlong *values;
+    jlongArray jvalues;
+    jfieldID *ids;
+    dSIGAR_VOID;
+
+    if ((status = sigar_proc_snapshot_get(sigar, flags,
+                                          &snapshot)) != SIGAR_OK)
+    {
+        sigar_throw_error(env, jsigar, status);
+        return;
+    }
+
+    if (!jsigar->snapshot_fields) {
+        jclass cls = JENV->GetObjectClass(env, obj);
+
+        jsigar->snapshot_fields =
+            jsigar_field_cache_new(env, cls, PROC_SNAPSHOT_FIELD_MAX);
+        ids = jsigar->snapshot_fields->ids;
+
+        ids[PROC_SNAPSHOT_FIELD_NUMBER] =
+            JENV->GetFieldID(env, cls, "number", "I");
+        ids[PROC_SNAPSHOT_FIELD_VALUES] =
+            JENV->GetFieldID(env, cls, "values", "[J");
+        ids[PROC_SNAPSHOT_FIELD_PERCENT] =
+            JENV->GetFieldID(env, cls, "percent", "[D");
+        ids[PROC_SNAPSHOT_FIELD_NAMES] =
+            JENV->GetFieldID(env, cls, "names", "[" STRING_SIG);
+    }
+
+    ids = jsigar->snapshot_fields->ids;
+    n = snapshot.number;
+
+    values = malloc(sizeof(*values) * PROC_SNAPSHOT_COL_MAX * (n ? n : 1));
+
+#define PROC_SNAPSHOT_COL(col) values[(PROC_SNAPSHOT_COL_##col * n) + i]
+
+    for (i=0; i<n; i++) {
+        sigar_proc_snapshot_entry_t *entry = &snapshot.data[i];
+        int col;
+
+        for (col=PROC_SNAPSHOT_COL_STATE; col<PROC_SNAPSHOT_COL_MAX; col++) {
+            values[(col * n) + i] = -1;
+        }
+
+        PROC_SNAPSHOT_COL(PID)   = entry->pid;
+        PROC_SNAPSHOT_COL(FLAGS) = entry->flags;
+
+        if (entry->flags & SIGAR_PROC_SNAPSHOT_STATE) {
+            PROC_SNAPSHOT_COL(STATE)     = entry->state.state;
+            PROC_SNAPSHOT_COL(PPID)      = entry->state.ppid;
+            PROC_SNAPSHOT_COL(TTY)       = entry->state.tty;
+            PROC_SNAPSHOT_COL(PRIORITY)  = entry->state.priority;
+            PROC_SNAPSHOT_COL(NICE)      = entry->state.nice;
+            PROC_SNAPSHOT_COL(PROCESSOR) = entry->state.processor;
+            PROC_SNAPSHOT_COL(THREADS)   = entry->state.threads;
+        }
+
+        if (entry->flags & SIGAR_PROC_SNAPSHOT_MEM) {
+            PROC_SNAPSHOT_COL(MEM_SIZE)         = entry->mem.size;
+            PROC_SNAPSHOT_COL(MEM_RESIDENT)     = entry->mem.resident;
+            PROC_SNAPSHOT_COL(MEM_SHARE)        = entry->mem.share;
+            PROC_SNAPSHOT_COL(MEM_MINOR_FAULTS) = entry->mem.minor_faults;
+            PROC_SNAPSHOT_COL(MEM_MAJOR_FAULTS) = entry->mem.major_faults;
+            PROC_SNAPSHOT_COL(MEM_PAGE_FAULTS)  = entry->mem.page_faults;
+        }
+
+        if (entry->flags & SIGAR_PROC_SNAPSHOT_TIME) {
+            PROC_SNAPSHOT_COL(START_TIME) = entry->cpu.start_time;
+            PROC_SNAPSHOT_COL(USER)       = entry->cpu.user;
+            PROC_SNAPSHOT_COL(SYS)        = entry->cpu.sys;
+            PROC_SNAPSHOT_COL(TOTAL)      = entry->cpu.total;
+        }
+    }
+
+#undef PROC_SNAPSHOT_COL
+
+    jvalues = JENV->NewLongArray(env, PROC_SNAPSHOT_COL_MAX * n);
+    if (jvalues) {
+        JENV->SetLongArrayRegion(env, jvalues, 0,
+                                 PROC_SNAPSHOT_COL_MAX * n, values);
+    }
+    free(values);
+
+    if (!jvalues) {
+        sigar_proc_snapshot_destroy(sigar, &snapshot);
+        return; /* OutOfMemoryError pending */
+    }
+
+    JENV->SetIntField(env, obj, ids[PROC_SNAPSHOT_FIELD_NUMBER], n);
+    JENV->SetObjectField(env, obj, ids[PROC_SNAPSHOT_FIELD_VALUES], jvalues);
+
+    if (flags & SIGAR_PROC_SNAPSHOT_CPU) {
+        jdoubleArray jpercent = JENV->NewDoubleArray(env, n);
+        jdouble *percent = malloc(sizeof(*percent) * (n ? n : 1));
+
+        for (i=0; i<n; i++) {
+            sigar_proc_snapshot_entry_t *entry = &snapshot.data[i];
+            percent[i] = (entry->flags & SIGAR_PROC_SNAPSHOT_CPU) ?
+                entry->cpu.percent : -1;
+        }
+
+        if (jpercent) {
+            JENV->SetDoubleArrayRegion(env, jpercent, 0, n, percent);
+            JENV->SetObjectField(env, obj,
+                                 ids[PROC_SNAPSHOT_FIELD_PERCENT], jpercent);
+        }
+        free(percent);
+    }
+
+    if ((flags & SIGAR_PROC_SNAPSHOT_STATE) && !JENV->ExceptionCheck(env)) {
+        jclass stringclass = JENV->FindClass(env, "java/lang/String");
+        jobjectArray names =
+            JENV->NewObjectArray(env, n, stringclass, 0);
+
+        for (i=0; names && (i<n); i++) {
+            sigar_proc_snapshot_entry_t *entry = &snapshot.data[i];
+            jstring name;
+
+            if (!(entry->flags & SIGAR_PROC_SNAPSHOT_STATE)) {
+                continue;
+            }
+            name = JENV->NewStringUTF(env, entry->state.name);
+            JENV->SetObjectArrayElement(env, names, i, name);
+            JENV->DeleteLocalRef(env, name);
+        }
+
+        if (names) {
+            JENV->SetObjectField(env, obj,
+                                 ids[PROC_SNAPSHOT_FIELD_NAMES], names);
+        }
+    }
+
+    sigar_proc_snapshot_destroy(sigar, &snapshot);
+}
+
 JNIEXPORT jobjectArray SIGAR_JNIx(getProcArgs)
 (JNIEnv *env, jobject sigar_obj, jlong pid)
 {
@@ -1189,6 +1516,213 @@ JNIEXPORT void SIGAR_JNI(FileInfo_gatherLink)
     JAVA_SIGAR_SET_FIELDS_FILEATTRS(cls, obj, s);
 }
 
+/* FileWatch has no Sigar to hand, and outlives any one of them */
+static void file_watch_throw(JNIEnv *env, int status)
+{
+    if (status == SIGAR_ENOTIMPL) {
+        sigar_throw_notimpl(env, "file watching is not implemented");
+    }
+    else if (status == ENOENT) {
+        JENV->ThrowNew(env, SIGAR_FIND_CLASS("SigarFileNotFoundException"),
+                       strerror(status));
+    }
+    else {
+        sigar_throw_exception(env, strerror(status));
+    }
+}
+
+JNIEXPORT void SIGAR_JNI(FileWatch_create)
+(JNIEnv *env, jobject obj)
+{
+    sigar_file_watch_t *watch;
+    int status = sigar_file_watch_create(&watch);
+
+    if (status != SIGAR_OK) {
+        file_watch_throw(env, status);
+        return;
+    }
+
+    sigar_set_pointer(env, obj, watch);
+}
+
+JNIEXPORT void SIGAR_JNI(FileWatch_destroy)
+(JNIEnv *env, jobject obj)
+{
+    sigar_file_watch_t *watch =
+        (sigar_file_watch_t *)sigar_get_pointer(env, obj);
+
+    if (watch) {
+        sigar_file_watch_destroy(watch);
+        sigar_set_pointer(env, obj, 0);
+    }
+}
+
+JNIEXPORT jint SIGAR_JNI(FileWatch_add)
+(JNIEnv *env, jobject obj, jstring name)
+{
+    int status, id = -1;
+    const char *utf;
+    sigar_file_watch_t *watch =
+        (sigar_file_watch_t *)sigar_get_pointer(env, obj);
+
+    if (!watch) {
+        sigar_throw_exception(env, "watch has been closed");
+        return -1;
+    }
+
+    utf = JENV->GetStringUTFChars(env, name, 0);
+
+    status = sigar_file_watch_add(watch, utf, &id);
+
+    JENV->ReleaseStringUTFChars(env, name, utf);
+
+    if (status != SIGAR_OK) {
+        file_watch_throw(env, status);
+    }
+
+    return id;
+}
+
+JNIEXPORT void SIGAR_JNI(FileWatch_remove)
+(JNIEnv *env, jobject obj, jint id)
+{
+    int status;
+    sigar_file_watch_t *watch =
+        (sigar_file_watch_t *)sigar_get_pointer(env, obj);
+
+    if (!watch) {
+        return;
+    }
+
+    if ((status = sigar_file_watch_remove(watch, id)) != SIGAR_OK) {
+        file_watch_throw(env, status);
+    }
+}
+
+JNIEXPORT jintArray SIGAR_JNI(FileWatch_waitEvents)
+(JNIEnv *env, jobject obj, jint timeout)
+{
+    int status;
+    unsigned long i;
+    jint *pairs;
+    jintArray array;
+    sigar_file_watch_event_list_t events;
+    sigar_file_watch_t *watch =
+        (sigar_file_watch_t *)sigar_get_pointer(env, obj);
+
+    if (!watch) {
+        sigar_throw_exception(env, "watch has been closed");
+        return NULL;
+    }
+
+    if ((status = sigar_file_watch_wait(watch, timeout,
+                                        &events)) != SIGAR_OK)
+    {
+        file_watch_throw(env, status);
+        return NULL;
+    }
+
+    /* id, flags pairs */
+    array = JENV->NewIntArray(env, events.number * 2);
+    if (JENV->ExceptionCheck(env)) {
+        sigar_file_watch_event_list_destroy(&events);
+        return NULL;
+    }
+
+    if (events.number) {
+        pairs = malloc(sizeof(*pairs) * events.number * 2);
+        for (i=0; i<events.number; i++) {
+            pairs[i*2] = events.data[i].id;
+            pairs[i*2+1] = events.data[i].flags;
+        }
+        JENV->SetIntArrayRegion(env, array, 0, events.number * 2, pairs);
+        free(pairs);
+    }
+
+    sigar_file_watch_event_list_destroy(&events);
+
+    return array;
+}
+
+JNIEXPORT void SIGAR_JNI(NativeFileTail_open)
+(JNIEnv *env, jobject obj, jobject sigar_obj, jstring name, jlong offset)
+{
+    int status;
+    const char *utf;
+    sigar_file_tail_t *tail;
+    dSIGAR_VOID;
+
+    utf = JENV->GetStringUTFChars(env, name, 0);
+
+    status = sigar_file_tail_open(sigar, utf, offset, &tail);
+
+    JENV->ReleaseStringUTFChars(env, name, utf);
+
+    if (status != SIGAR_OK) {
+        sigar_throw_error(env, jsigar, status);
+        return;
+    }
+
+    sigar_set_pointer(env, obj, tail);
+}
+
+JNIEXPORT jint SIGAR_JNI(NativeFileTail_read)
+(JNIEnv *env, jobject obj, jobject sigar_obj,
+ jobject buffer, jint position, jint length)
+{
+    int status, flags;
+    size_t nread;
+    char *data;
+    jfieldID id;
+    sigar_file_tail_t *tail =
+        (sigar_file_tail_t *)sigar_get_pointer(env, obj);
+    dSIGAR(0);
+
+    if (!tail) {
+        sigar_throw_exception(env, "tail has been closed");
+        return 0;
+    }
+
+    /* the bytes land in the java buffer itself */
+    if (!(data = JENV->GetDirectBufferAddress(env, buffer))) {
+        sigar_throw_exception(env, "not a direct ByteBuffer");
+        return 0;
+    }
+
+    status = sigar_file_tail_read(sigar, tail, data + position, length,
+                                  &nread, &flags);
+    if (status != SIGAR_OK) {
+        sigar_throw_error(env, jsigar, status);
+        return 0;
+    }
+
+    id = JENV->GetFieldID(env, JENV->GetObjectClass(env, obj), "flags", "I");
+    JENV->SetIntField(env, obj, id, flags);
+
+    return (jint)nread;
+}
+
+JNIEXPORT jlong SIGAR_JNI(NativeFileTail_getOffset)
+(JNIEnv *env, jobject obj)
+{
+    sigar_file_tail_t *tail =
+        (sigar_file_tail_t *)sigar_get_pointer(env, obj);
+
+    return tail ? (jlong)sigar_file_tail_offset(tail) : -1;
+}
+
+JNIEXPORT void SIGAR_JNI(NativeFileTail_nativeClose)
+(JNIEnv *env, jobject obj)
+{
+    sigar_file_tail_t *tail =
+        (sigar_file_tail_t *)sigar_get_pointer(env, obj);
+
+    if (tail) {
+        sigar_file_tail_close(tail);
+        sigar_set_pointer(env, obj, 0);
+    }
+}
+
 JNIEXPORT jlong SIGAR_JNIx(getProcPort)
 (JNIEnv *env, jobject sigar_obj, jint protocol, jlong port)
 {
@@ -1235,6 +1769,46 @@ JNIEXPORT jobjectArray SIGAR_JNIx(getNetInterfaceList)
     return ifarray;
 }
 
+JNIEXPORT void SIGAR_JNIx(setInstrumentation)
+(JNIEnv *env, jobject sigar_obj, jboolean enable)
+{
+    int status;
+    dSIGAR_VOID;
+
+    if ((status = sigar_instrumentation_set(sigar, enable)) != SIGAR_OK) {
+        sigar_throw_error(env, jsigar, status);
+    }
+}
+
+JNIEXPORT jobjectArray SIGAR_JNIx(getInstrumentationList)
+(JNIEnv *env, jobject sigar_obj)
+{
+    int status;
+    unsigned int i;
+    sigar_instrumentation_list_t list;
+    jobjectArray names;
+    jclass stringclass = JENV->FindClass(env, "java/lang/String");
+    dSIGAR(NULL);
+
+    if ((status = sigar_instrumentation_get(sigar, &list)) != SIGAR_OK) {
+        sigar_throw_error(env, jsigar, status);
+        return NULL;
+    }
+
+    names = JENV->NewObjectArray(env, list.number, stringclass, 0);
+    SIGAR_CHEX;
+
+    for (i=0; i<list.number; i++) {
+        jstring s = JENV->NewStringUTF(env, list.data[i].name);
+        JENV->SetObjectArrayElement(env, names, i, s);
+        SIGAR_CHEX;
+    }
+
+    sigar_instrumentation_list_destroy(sigar, &list);
+
+    return names;
+}
+
 JNIEXPORT jstring SIGAR_JNIx(getPasswordNative)
 (JNIEnv *env, jclass classinstance, jstring prompt)
 {
@@ -1447,6 +2021,52 @@ JNIEXPORT jlongArray SIGAR_JNI(ptql_SigarProcessQuery_find)
     return procarray;
 }
 
+JNIEXPORT jint SIGAR_JNI(ptql_SigarProcessQuery_aggregate)
+(JNIEnv *env, jobject obj, jobject sigar_obj, jint flags,
+ jobject jcpu, jobject jmem)
+{
+    int status;
+    jni_ptql_re_data_t re;
+    sigar_ptql_aggregate_t agg;
+    sigar_ptql_query_t *query =
+        (sigar_ptql_query_t *)sigar_get_pointer(env, obj);
+    dSIGAR(0);
+
+    if (!jcpu) {
+        flags &= ~SIGAR_AGG_CPU;
+    }
+    if (!jmem) {
+        flags &= ~SIGAR_AGG_MEM;
+    }
+
+    re_impl_set(env, sigar, obj, &re);
+
+    status = sigar_ptql_query_aggregate(sigar, query, flags, &agg);
+
+    sigar_ptql_re_impl_set(sigar, NULL, NULL);
+
+    if (status < 0) {
+        sigar_throw_exception(env, sigar->errbuf);
+        return 0;
+    }
+    else if (status != SIGAR_OK) {
+        sigar_throw_error(env, jsigar, status);
+        return 0;
+    }
+
+    /* ProcCpu and ProcMem field ids, also valid for subclasses */
+    if (flags & SIGAR_AGG_CPU) {
+        JAVA_SIGAR_INIT_FIELDS_PROCCPU(SIGAR_FIND_CLASS("ProcCpu"));
+        JAVA_SIGAR_SET_FIELDS_PROCCPU(NULL, jcpu, agg.cpu);
+    }
+    if (flags & SIGAR_AGG_MEM) {
+        JAVA_SIGAR_INIT_FIELDS_PROCMEM(SIGAR_FIND_CLASS("ProcMem"));
+        JAVA_SIGAR_SET_FIELDS_PROCMEM(NULL, jmem, agg.mem);
+    }
+
+    return (jint)agg.processes;
+}
+
 #include "sigar_getline.h"
 
 JNIEXPORT jboolean SIGAR_JNI(util_Getline_isatty)
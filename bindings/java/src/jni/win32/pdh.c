@@ -24,6 +24,8 @@
 
 #include "win32bindings.h"
 #include "javasigar.h"
+#include "sigar.h"
+#include "sigar_pdh.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -537,6 +539,165 @@ JNIEXPORT jint SIGAR_JNI(win32_Pdh_pdhLookupPerfIndex)
     }
 }
 
+/* PdhQuery: the C query plus a formatted array buffer reused per tick */
+typedef struct {
+    sigar_pdh_query_t *query;
+    PDH_FMT_COUNTERVALUE_ITEM_W *items;
+    DWORD size;
+} jni_pdh_query_t;
+
+static PDH_STATUS jni_pdh_query_items(jni_pdh_query_t *jq, jint counter,
+                                      DWORD *count)
+{
+    PDH_STATUS status;
+
+    while ((status =
+            sigar_pdh_query_array_get(jq->query, counter,
+                                      jq->items, &jq->size,
+                                      count)) == PDH_MORE_DATA)
+    {
+        jq->items = realloc(jq->items, jq->size);
+    }
+
+    return status;
+}
+
+JNIEXPORT jlong SIGAR_JNI(win32_PdhQuery_open)
+(JNIEnv *env, jclass cur)
+{
+    jni_pdh_query_t *jq;
+    sigar_pdh_query_t *query;
+    PDH_STATUS status;
+
+    if ((status = sigar_pdh_query_open(&query)) != SIGAR_OK) {
+        win32_throw_exception(env, get_error_message(status));
+        return 0;
+    }
+
+    jq = malloc(sizeof(*jq));
+    jq->query = query;
+    jq->items = NULL;
+    jq->size = 0;
+
+    return (jlong)jq;
+}
+
+JNIEXPORT void SIGAR_JNI(win32_PdhQuery_close)
+(JNIEnv *env, jclass cur, jlong query)
+{
+    jni_pdh_query_t *jq = (jni_pdh_query_t *)query;
+    PDH_STATUS status = sigar_pdh_query_close(jq->query);
+
+    free(jq->items);
+    free(jq);
+
+    if (status != ERROR_SUCCESS) {
+        win32_throw_exception(env, get_error_message(status));
+    }
+}
+
+JNIEXPORT jint SIGAR_JNI(win32_PdhQuery_add)
+(JNIEnv *env, jclass cur, jlong query, jstring jpath)
+{
+    jni_pdh_query_t *jq = (jni_pdh_query_t *)query;
+    LPCTSTR path = JENV->GetStringChars(env, jpath, NULL);
+    PDH_STATUS status;
+    int index = -1;
+
+    status = sigar_pdh_query_add(jq->query, path, &index);
+    JENV->ReleaseStringChars(env, jpath, path);
+
+    if (status != SIGAR_OK) {
+        win32_throw_exception(env, get_error_message(status));
+        return -1;
+    }
+
+    return index;
+}
+
+JNIEXPORT void SIGAR_JNI(win32_PdhQuery_collect)
+(JNIEnv *env, jclass cur, jlong query)
+{
+    jni_pdh_query_t *jq = (jni_pdh_query_t *)query;
+    PDH_STATUS status = sigar_pdh_query_collect(jq->query);
+
+    if (status != ERROR_SUCCESS) {
+        win32_throw_exception(env, get_error_message(status));
+    }
+}
+
+JNIEXPORT jdouble SIGAR_JNI(win32_PdhQuery_getValue)
+(JNIEnv *env, jclass cur, jlong query, jint counter)
+{
+    jni_pdh_query_t *jq = (jni_pdh_query_t *)query;
+    PDH_STATUS status;
+    double value;
+
+    status = sigar_pdh_query_value_get(jq->query, counter, &value);
+    if (status != SIGAR_OK) {
+        win32_throw_exception(env, get_error_message(status));
+        return 0;
+    }
+
+    return value;
+}
+
+/* fills as many as fit, returns the instance count */
+JNIEXPORT jint SIGAR_JNI(win32_PdhQuery_getValues)
+(JNIEnv *env, jclass cur, jlong query, jint counter, jdoubleArray jvalues)
+{
+    jni_pdh_query_t *jq = (jni_pdh_query_t *)query;
+    jsize len = JENV->GetArrayLength(env, jvalues);
+    PDH_STATUS status;
+    DWORD i, count;
+    jdouble *values;
+
+    if ((status = jni_pdh_query_items(jq, counter, &count)) != SIGAR_OK) {
+        win32_throw_exception(env, get_error_message(status));
+        return -1;
+    }
+
+    values = JENV->GetPrimitiveArrayCritical(env, jvalues, NULL);
+    for (i=0; (i<count) && (i<(DWORD)len); i++) {
+        values[i] = jq->items[i].FmtValue.doubleValue;
+    }
+    JENV->ReleasePrimitiveArrayCritical(env, jvalues, values, 0);
+
+    return count;
+}
+
+JNIEXPORT jobjectArray SIGAR_JNI(win32_PdhQuery_getInstances)
+(JNIEnv *env, jclass cur, jlong query, jint counter)
+{
+    jni_pdh_query_t *jq = (jni_pdh_query_t *)query;
+    PDH_STATUS status;
+    DWORD i, count;
+    jobjectArray array;
+
+    if ((status = jni_pdh_query_items(jq, counter, &count)) != SIGAR_OK) {
+        win32_throw_exception(env, get_error_message(status));
+        return NULL;
+    }
+
+    array = JENV->NewObjectArray(env, count,
+                                 JENV->FindClass(env, "java/lang/String"),
+                                 NULL);
+    if (JENV->ExceptionCheck(env)) {
+        return NULL;
+    }
+
+    for (i=0; i<count; i++) {
+        LPWSTR name = jq->items[i].szName;
+        jstring s = JENV->NewString(env, (const jchar *)name, lstrlen(name));
+        JENV->SetObjectArrayElement(env, array, i, s);
+        if (JENV->ExceptionCheck(env)) {
+            return NULL;
+        }
+    }
+
+    return array;
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -37,6 +37,12 @@ public class CpuPerc implements java.io.Serializable {
 
     native void gather(Sigar sigar, Cpu oldCpu, Cpu curCpu);
 
+    /**
+     * Take a cpu sample, filling in usage since the previous one.
+     * @return false on the first sample for this Sigar.
+     */
+    native boolean sample(Sigar sigar) throws SigarException;
+
     static CpuPerc fetch(Sigar sigar, Cpu oldCpu, Cpu curCpu) {
         CpuPerc perc = new CpuPerc();
         perc.gather(sigar, oldCpu, curCpu);
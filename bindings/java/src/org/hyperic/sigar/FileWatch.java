@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2006-2007 Hyperic, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package org.hyperic.sigar;
+
+/**
+ * Kernel change notification for a set of files, inotify on Linux and
+ * kqueue on Darwin and the BSDs.  Other platforms throw
+ * SigarNotImplementedException from the constructor.
+ * add and remove may be called while another thread is in waitEvents.
+ */
+public class FileWatch {
+
+    public static final int MODIFY   = 0x01;
+    public static final int ATTRIB   = 0x02;
+    public static final int DELETE   = 0x04;
+    public static final int CREATE   = 0x08;
+    /** Events were lost, the id is -1 and every file should be checked */
+    public static final int OVERFLOW = 0x10;
+
+    int sigarWrapper = 0; //holds the sigar_file_watch_t *
+    long longSigarWrapper = 0; //same, but where sizeof(void*) > sizeof(int)
+
+    private native void create() throws SigarException;
+
+    private native void destroy();
+
+    public FileWatch() throws SigarException {
+        Sigar.load();
+        create();
+    }
+
+    /**
+     * @return the id events for this file are reported under
+     */
+    public native int add(String file) throws SigarException;
+
+    public native void remove(int id) throws SigarException;
+
+    /**
+     * Waits up to timeout milliseconds for changes.
+     * @return id, flags pairs with one pair per file, empty on timeout
+     */
+    public native int[] waitEvents(int timeout) throws SigarException;
+
+    public synchronized void close() {
+        destroy();
+    }
+
+    protected void finalize() {
+        close();
+    }
+}
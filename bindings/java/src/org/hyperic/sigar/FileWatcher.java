@@ -18,9 +18,12 @@ package org.hyperic.sigar;
 
 import java.io.File;
 
+import java.util.ArrayList;
 import java.util.Collections;
+import java.util.HashMap;
 import java.util.HashSet;
 import java.util.Iterator;
+import java.util.Map;
 import java.util.Set;
 
 import org.apache.log4j.Logger;
@@ -32,6 +35,11 @@ public abstract class FileWatcher {
     private long lastTime = 0;
     private Set files =
         Collections.synchronizedSet(new HashSet());
+    //set by FileWatcherThread where the platform has one
+    private FileWatch watch = null;
+    //FileWatch id -> FileInfo and file name -> id, locked by files
+    private Map watched = new HashMap();
+    private Map ids = new HashMap();
 
     private static final Logger log =
         SigarLog.getLogger(FileWatcher.class.getName());
@@ -64,7 +72,10 @@ public abstract class FileWatcher {
     public FileInfo add(String file)
         throws SigarException {
         FileInfo info = this.sigar.getFileInfo(file);
-        this.files.add(info);
+        synchronized (this.files) {
+            this.files.add(info);
+            watch(info);
+        }
         return info;
     }
 
@@ -97,11 +108,93 @@ public abstract class FileWatcher {
     public void remove(String file) {
         FileInfo info = new FileInfo();
         info.name = file;
-        this.files.remove(info);
+        synchronized (this.files) {
+            this.files.remove(info);
+            unwatch(file);
+        }
     }
 
     public void clear() {
-        this.files.clear();
+        synchronized (this.files) {
+            this.files.clear();
+            unwatchAll();
+        }
+    }
+
+    //called locked
+    private void watch(FileInfo info) {
+        if ((this.watch == null) || this.ids.containsKey(info.getName())) {
+            return;
+        }
+        try {
+            Integer id = new Integer(this.watch.add(info.getName()));
+            this.watched.put(id, info);
+            this.ids.put(info.getName(), id);
+        } catch (SigarException e) {
+            //stays on the interval check
+            log.debug("Cannot watch file: " + info.getName(), e);
+        }
+    }
+
+    //called locked
+    private void unwatch(String file) {
+        Integer id = (Integer)this.ids.remove(file);
+        if (id == null) {
+            return;
+        }
+        this.watched.remove(id);
+        try {
+            this.watch.remove(id.intValue());
+        } catch (SigarException e) {
+        }
+    }
+
+    //called locked
+    private void unwatchAll() {
+        for (Iterator it = new ArrayList(this.ids.keySet()).iterator();
+             it.hasNext();)
+        {
+            unwatch((String)it.next());
+        }
+    }
+
+    /**
+     * Files in a FileWatch are checked when it reports a change
+     * instead of on every interval, null to go back to the interval.
+     */
+    void setFileWatch(FileWatch watch) {
+        synchronized (this.files) {
+            unwatchAll();
+            this.watch = watch;
+            for (Iterator it = this.files.iterator(); it.hasNext();) {
+                watch((FileInfo)it.next());
+            }
+        }
+    }
+
+    /**
+     * Checks the files named by FileWatch.waitEvents id, flags pairs,
+     * ids of other watchers are skipped.
+     */
+    void dispatch(int[] events) {
+        synchronized (this.files) {
+            for (int i=0; i<events.length; i+=2) {
+                if ((events[i+1] & FileWatch.OVERFLOW) != 0) {
+                    for (Iterator it = this.watched.values().iterator();
+                         it.hasNext();)
+                    {
+                        check((FileInfo)it.next());
+                    }
+                    continue;
+                }
+
+                FileInfo info =
+                    (FileInfo)this.watched.get(new Integer(events[i]));
+                if (info != null) {
+                    check(info);
+                }
+            }
+        }
     }
 
     public Set getFiles() {
@@ -133,16 +226,23 @@ public abstract class FileWatcher {
             {
                 FileInfo info = (FileInfo)it.next();
 
-                try {
-                    if (changed(info)) {
-                        this.onChange(info);
-                    }
-                } catch (SigarFileNotFoundException e) {
-                    this.onNotFound(info);
-                } catch (SigarException e) {
-                    this.onException(info, e);
+                if (this.ids.containsKey(info.getName())) {
+                    continue; //dispatch will tell
                 }
+                check(info);
+            }
+        }
+    }
+
+    private void check(FileInfo info) {
+        try {
+            if (changed(info)) {
+                this.onChange(info);
             }
+        } catch (SigarFileNotFoundException e) {
+            this.onNotFound(info);
+        } catch (SigarException e) {
+            this.onException(info, e);
         }
     }
 }
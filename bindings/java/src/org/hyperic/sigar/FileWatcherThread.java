@@ -25,12 +25,26 @@ public class FileWatcherThread implements Runnable {
 
     public static final int DEFAULT_INTERVAL = 60 * 5 * 1000;
 
+    //longest block in FileWatch.waitEvents, bounds how long die() takes
+    private static final int WAIT_SLICE = 1000;
+
     private Thread thread = null;
     private static FileWatcherThread instance = null;
     private boolean shouldDie = false;
     private long interval = DEFAULT_INTERVAL;
     private Set watchers =
         Collections.synchronizedSet(new HashSet());
+    private FileWatch watch = null;
+
+    public FileWatcherThread() {
+        try {
+            this.watch = new FileWatch();
+        } catch (SigarException e) {
+            //not on this platform, every file is checked on the interval
+        } catch (LinkageError e) {
+            //native library without FileWatch
+        }
+    }
 
     public static synchronized FileWatcherThread getInstance() {
         if (instance == null) {
@@ -68,19 +82,67 @@ public class FileWatcherThread implements Runnable {
     }
 
     public void add(FileWatcher watcher) {
+        if (this.watch != null) {
+            watcher.setFileWatch(this.watch);
+        }
         this.watchers.add(watcher);
     }
 
     public void remove(FileWatcher watcher) {
-        this.watchers.remove(watcher);
+        if (this.watchers.remove(watcher) && (this.watch != null)) {
+            watcher.setFileWatch(null);
+        }
     }
 
     public void run() {
+        long lastCheck = 0;
+
         while (!shouldDie) {
-            check();
+            long timeNow = System.currentTimeMillis();
+            long wait = this.interval - (timeNow - lastCheck);
+
+            if (wait <= 0) {
+                //files that could not be watched
+                check();
+                lastCheck = timeNow;
+                wait = this.interval;
+            }
+
+            if (this.watch == null) {
+                try {
+                    Thread.sleep(wait);
+                } catch (InterruptedException e) {
+                }
+                continue;
+            }
+
             try {
-                Thread.sleep(this.interval);
-            } catch (InterruptedException e) {
+                dispatch(this.watch.waitEvents((int)Math.min(wait, WAIT_SLICE)));
+            } catch (SigarException e) {
+                FileTail.error("FileWatch", e);
+                try {
+                    Thread.sleep(WAIT_SLICE);
+                } catch (InterruptedException ie) {
+                }
+            }
+        }
+    }
+
+    private void dispatch(int[] events) {
+        if (events.length == 0) {
+            return;
+        }
+        synchronized (this.watchers) {
+            for (Iterator it = this.watchers.iterator();
+                 it.hasNext();)
+            {
+                FileWatcher watcher = (FileWatcher)it.next();
+                try {
+                    watcher.dispatch(events);
+                } catch (Exception e) {
+                    FileTail.error("Unexpected exception: " +
+                                   e.getMessage(), e);
+                }
             }
         }
     }
@@ -17,6 +17,9 @@
 package org.hyperic.sigar;
 
 import org.hyperic.sigar.ptql.ProcessFinder;
+import org.hyperic.sigar.ptql.ProcessQuery;
+import org.hyperic.sigar.ptql.ProcessQueryFactory;
+import org.hyperic.sigar.ptql.SigarProcessQuery;
 
 /**
  * Provide multi process cpu metrics.
@@ -27,7 +30,17 @@ public class MultiProcCpu extends ProcCpu {
     private int nproc = 0;
 
 
-    static synchronized MultiProcCpu get(Sigar sigar, String query)
+    static MultiProcCpu get(Sigar sigar, String query)
+                throws SigarException {
+
+        return get(sigar, query, null);
+    }
+
+    /**
+     * @param mem If not null, also filled in with the memory
+     * summed over the same matches.
+     */
+    static MultiProcCpu get(Sigar sigar, String query, ProcMem mem)
                 throws SigarException {
 
         MultiProcCpu cpu = new MultiProcCpu();
@@ -38,6 +51,20 @@ public class MultiProcCpu extends ProcCpu {
         cpu.sys   = 0;
         cpu.percent = 0.0D;
 
+        ProcessQuery pq =
+            ProcessQueryFactory.getInstance().getQuery(query);
+
+        if (pq instanceof SigarProcessQuery) {
+            //match and sum in a single native scan
+            int flags = SigarProcessQuery.AGG_CPU;
+            if (mem != null) {
+                flags |= SigarProcessQuery.AGG_MEM;
+            }
+            cpu.nproc =
+                ((SigarProcessQuery)pq).aggregate(sigar, flags, cpu, mem);
+            return cpu;
+        }
+
         long[] pids = ProcessFinder.find(sigar, query);
         cpu.nproc = pids.length;
 
@@ -54,6 +81,11 @@ public class MultiProcCpu extends ProcCpu {
             }
         }
 
+        if (mem != null) {
+            ProcMem pmem = MultiProcMem.get(sigar, query);
+            pmem.copyTo(mem);
+        }
+
         return cpu;
     }
 
@@ -17,6 +17,9 @@
 package org.hyperic.sigar;
 
 import org.hyperic.sigar.ptql.ProcessFinder;
+import org.hyperic.sigar.ptql.ProcessQuery;
+import org.hyperic.sigar.ptql.ProcessQueryFactory;
+import org.hyperic.sigar.ptql.SigarProcessQuery;
 
 public class MultiProcMem extends ProcMem {
 
@@ -24,6 +27,18 @@ public class MultiProcMem extends ProcMem {
         throws SigarException {
 
         ProcMem mem = new ProcMem();
+
+        ProcessQuery pq =
+            ProcessQueryFactory.getInstance().getQuery(query);
+
+        if (pq instanceof SigarProcessQuery) {
+            //match and sum in a single native scan
+            ((SigarProcessQuery)pq).aggregate(sigar,
+                                              SigarProcessQuery.AGG_MEM,
+                                              null, mem);
+            return mem;
+        }
+
         mem.share = Sigar.FIELD_NOTIMPL;
 
         long[] pids = ProcessFinder.find(sigar, query);
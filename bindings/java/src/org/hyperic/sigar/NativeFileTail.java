@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2006-2007 Hyperic, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package org.hyperic.sigar;
+
+import java.nio.ByteBuffer;
+
+/**
+ * Follows a growing file from a native fd that stays open, reading new
+ * bytes straight into direct ByteBuffers.  A rotated file is read to
+ * its end before the new one under the same name is opened.
+ * Not implemented on Win32.
+ */
+public class NativeFileTail {
+
+    /** The file was replaced, reading went on from the new one */
+    public static final int ROTATED   = 0x01;
+    /** The file shrank, reading went on from its start */
+    public static final int TRUNCATED = 0x02;
+
+    int sigarWrapper = 0; //holds the sigar_file_tail_t *
+    long longSigarWrapper = 0; //same, but where sizeof(void*) > sizeof(int)
+
+    private int flags = 0; //set by the native read
+    private Sigar sigar;
+
+    private native void open(Sigar sigar, String file, long offset)
+        throws SigarException;
+
+    private native int read(Sigar sigar, ByteBuffer buffer,
+                            int position, int length)
+        throws SigarException;
+
+    private native void nativeClose();
+
+    /**
+     * @param offset where to start, -1 for the current end of the file
+     */
+    public NativeFileTail(Sigar sigar, String file, long offset)
+        throws SigarException {
+        this.sigar = sigar;
+        open(sigar, file, offset);
+    }
+
+    public NativeFileTail(Sigar sigar, String file)
+        throws SigarException {
+        this(sigar, file, -1);
+    }
+
+    /**
+     * Reads appended bytes between the buffer's position and limit,
+     * and moves its position past them.
+     * @return the number of bytes read, 0 when there is nothing new
+     */
+    public int read(ByteBuffer buffer)
+        throws SigarException {
+        if (!buffer.isDirect()) {
+            throw new IllegalArgumentException("direct ByteBuffer required");
+        }
+        int nread = read(this.sigar, buffer,
+                         buffer.position(), buffer.remaining());
+        buffer.position(buffer.position() + nread);
+        return nread;
+    }
+
+    /**
+     * @return ROTATED and TRUNCATED as found by the last read
+     */
+    public int getFlags() {
+        return this.flags;
+    }
+
+    /**
+     * @return the offset of the next byte, to resume from later
+     */
+    public native long getOffset();
+
+    public synchronized void close() {
+        nativeClose();
+    }
+
+    protected void finalize() {
+        close();
+    }
+}
@@ -0,0 +1,111 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package org.hyperic.sigar;
+
+/**
+ * State, memory and cpu time of every process, gathered in a single
+ * native call.  Values are stored in struct-of-arrays layout,
+ * column <code>c</code> of process <code>i</code> is at
+ * <code>values[c * number + i]</code>.
+ * @see Sigar#getProcSnapshot
+ */
+public class ProcSnapshot {
+
+    /* must match SIGAR_PROC_SNAPSHOT_* in sigar.h */
+    public static final int STATE = 0x01;
+    public static final int MEM   = 0x02;
+    public static final int TIME  = 0x04;
+    public static final int CPU   = 0x08;
+    public static final int ALL   = STATE | MEM | TIME | CPU;
+
+    /* must match the PROC_SNAPSHOT_COL_* enum in javasigar.c */
+    public static final int PID              = 0;
+    public static final int FLAGS            = 1;
+    public static final int STATE_STATE      = 2;
+    public static final int STATE_PPID       = 3;
+    public static final int STATE_TTY        = 4;
+    public static final int STATE_PRIORITY   = 5;
+    public static final int STATE_NICE       = 6;
+    public static final int STATE_PROCESSOR  = 7;
+    public static final int STATE_THREADS    = 8;
+    public static final int MEM_SIZE         = 9;
+    public static final int MEM_RESIDENT     = 10;
+    public static final int MEM_SHARE        = 11;
+    public static final int MEM_MINOR_FAULTS = 12;
+    public static final int MEM_MAJOR_FAULTS = 13;
+    public static final int MEM_PAGE_FAULTS  = 14;
+    public static final int TIME_START_TIME  = 15;
+    public static final int TIME_USER        = 16;
+    public static final int TIME_SYS         = 17;
+    public static final int TIME_TOTAL       = 18;
+    public static final int COLUMNS          = 19;
+
+    int number = 0;
+    long[] values;
+    double[] percent; //valid with CPU
+    String[] names;   //valid with STATE
+
+    ProcSnapshot() { }
+
+    native void gather(Sigar sigar, int flags) throws SigarException;
+
+    static ProcSnapshot fetch(Sigar sigar, int flags)
+        throws SigarException {
+
+        ProcSnapshot snapshot = new ProcSnapshot();
+        snapshot.gather(sigar, flags);
+        return snapshot;
+    }
+
+    /**
+     * @return Number of processes in this snapshot.
+     */
+    public int getNumber() {
+        return this.number;
+    }
+
+    /**
+     * @param column One of the column constants, e.g. MEM_RESIDENT.
+     * @param i Process index, 0 to getNumber()-1.
+     * @return The raw column value, -1 if not gathered.
+     */
+    public long getValue(int column, int i) {
+        return this.values[column * this.number + i];
+    }
+
+    public long getPid(int i) {
+        return getValue(PID, i);
+    }
+
+    /**
+     * @return The STATE, MEM, TIME and CPU bits which are valid
+     * for process i.
+     */
+    public int getFlags(int i) {
+        return (int)getValue(FLAGS, i);
+    }
+
+    public char getState(int i) {
+        return (char)getValue(STATE_STATE, i);
+    }
+
+    public String getName(int i) {
+        return this.names == null ? null : this.names[i];
+    }
+
+    public double getPercent(int i) {
+        return this.percent == null ? -1 : this.percent[i];
+    }
+}
@@ -88,9 +88,6 @@ public class Sigar implements SigarProxy {
     int sigarWrapper = 0; //holds the sigar_t *
     long longSigarWrapper = 0; //same, but where sizeof(void*) > sizeof(int)
 
-    // lastCpu is used to calculate the cpuPerc;
-    private Cpu lastCpu;
-    private Cpu[] lastCpuList;
 
     private ProcessFinder processFinder = null;
 
@@ -342,48 +339,29 @@ public class Sigar implements SigarProxy {
      * @exception SigarException on failure.
      */
     public CpuPerc getCpuPerc() throws SigarException {
-        Cpu oldCpu;
+        // the previous sample is kept natively
+        CpuPerc perc = new CpuPerc();
 
-        if (this.lastCpu == null){
-            oldCpu = getCpu();
+        if (!perc.sample(this)) {
             pause();
+            perc.sample(this);
         }
-        else {
-            oldCpu = this.lastCpu;
-        }
-
-        this.lastCpu = getCpu();
 
-        return CpuPerc.fetch(this, oldCpu, this.lastCpu);
+        return perc;
     }
 
+    private native CpuPerc[] getCpuPercListNative() throws SigarException;
+
     /**
      * Get system per-CPU info in percentage format. (i.e. fraction of 1)
      * @exception SigarException on failure.
      */
     public CpuPerc[] getCpuPercList() throws SigarException {
-        Cpu[] oldCpuList;
+        CpuPerc[] perc = getCpuPercListNative();
 
-        if (this.lastCpuList == null){
-            oldCpuList = getCpuList();
+        if (perc == null) {
             pause();
-        }
-        else {
-            oldCpuList = this.lastCpuList;
-        }
-
-        this.lastCpuList = getCpuList();
-
-        int curLen = this.lastCpuList.length;
-        int oldLen = oldCpuList.length;
-
-        CpuPerc[] perc =
-            new CpuPerc[curLen < oldLen ? curLen : oldLen];
-        
-        for (int i=0; i<perc.length; i++) {
-            perc[i] =
-                CpuPerc.fetch(this, oldCpuList[i],
-                              this.lastCpuList[i]);
+            perc = getCpuPercListNative();
         }
 
         return perc;
@@ -443,6 +421,16 @@ public class Sigar implements SigarProxy {
         }
     }
     
+    /**
+     * Get state, memory and cpu time of every process
+     * with a single native call.
+     * @param flags ProcSnapshot.STATE, MEM, TIME and/or CPU.
+     * @exception SigarException on failure.
+     */
+    public ProcSnapshot getProcSnapshot(int flags) throws SigarException {
+        return ProcSnapshot.fetch(this, flags);
+    }
+
     /**
      * Get process memory info.
      * @param pid The process id.
@@ -503,6 +491,17 @@ public class Sigar implements SigarProxy {
         return MultiProcCpu.get(this, query);
     }
 
+    /**
+     * Get multi process cpu and memory info in a single process scan.
+     * @param query The process query.
+     * @param mem Filled in with the summed process memory.
+     * @exception SigarException on failure.
+     */
+    public MultiProcCpu getMultiProcCpu(String query, ProcMem mem)
+        throws SigarException {
+        return MultiProcCpu.get(this, query, mem);
+    }
+
     /**
      * Get process credential info.
      * @param pid The process id.
@@ -690,6 +689,42 @@ public class Sigar implements SigarProxy {
        return DumpPidCache.fetch(this);
   }
 
+    /**
+     * Get statistics for one of the internal caches.
+     * @param name proc_cpu, proc_io, fsdev, net_listen,
+     * net_services_tcp or net_services_udp
+     * @exception SigarException if the cache name is unknown.
+     */
+    public CacheStats getCacheStats(String name) throws SigarException {
+        return CacheStats.fetch(this, name);
+    }
+
+    /**
+     * Turn the per-getter call counters on or off, turning them
+     * on starts them from zero.
+     * @exception SigarNotImplementedException if the native
+     * library was not built with instrumentation.
+     */
+    public native void setInstrumentation(boolean enable)
+        throws SigarException;
+
+    /**
+     * Get the call counters of one native getter.
+     * @param name the getter without the sigar_ prefix, e.g. mem_get
+     * @exception SigarException if the getter is unknown.
+     */
+    public InstrumentationStats getInstrumentationStats(String name)
+        throws SigarException {
+        return InstrumentationStats.fetch(this, name);
+    }
+
+    /**
+     * Get the names of the instrumented native getters.
+     * @exception SigarNotImplementedException if the native
+     * library was not built with instrumentation.
+     */
+    public native String[] getInstrumentationList() throws SigarException;
+
 
     /**
      * Get the cumulative cpu time for the calling thread.
@@ -222,7 +222,57 @@ public class SigarInvoker {
                SigarNotImplementedException,
                SigarPermissionDeniedException {
 
-        Method typeGetter, attrGetter;
+        Object typeObject = getTypeObject(args);
+
+        if (attr == null) {
+            return typeObject;
+        }
+
+        return getAttributeValue(typeObject, attr);
+    }
+
+    /**
+     * Invoke several attribute methods on the same type object,
+     * fetched with a single call, so the values are consistent
+     * with each other.
+     * @param arg Argument for the type getter, may be null.
+     * @param attrs The attribute names (e.g. Total, Free)
+     * @return Values in the order of attrs, null where an
+     * attribute could not be resolved.
+     * @exception SigarException If the type invocation fails.
+     */
+    public Object[] invoke(Object arg, String[] attrs)
+        throws SigarException,
+               SigarNotImplementedException,
+               SigarPermissionDeniedException {
+
+        Object[] args = null;
+
+        if (arg != null) {
+            args = ARG_ARGS;
+            args[0] = arg;
+        }
+
+        Object typeObject = getTypeObject(args);
+        Object[] values = new Object[attrs.length];
+
+        for (int i=0; i<attrs.length; i++) {
+            try {
+                values[i] = getAttributeValue(typeObject, attrs[i]);
+            } catch (SigarException e) {
+                values[i] = null;
+            }
+        }
+
+        return values;
+    }
+
+    private Object getTypeObject(Object[] args)
+        throws SigarException,
+               SigarNotImplementedException,
+               SigarPermissionDeniedException {
+
+        Method typeGetter;
         Object typeObject;
 
         typeGetter = getTypeMethod(args);
@@ -248,9 +298,13 @@ public class SigarInvoker {
             throw new SigarException(msg);
         }
 
-        if (attr == null) {
-            return typeObject;
-        }
+        return typeObject;
+    }
+
+    private Object getAttributeValue(Object typeObject, String attr)
+        throws SigarException {
+
+        Method attrGetter;
 
         /*
          * if the return type is an array and we've been given
@@ -116,6 +116,13 @@ public interface SigarProxy {
 
     public DumpPidCache dumpPidCache() throws SigarException;
 
+    public CacheStats getCacheStats(String name) throws SigarException;
+
+    public InstrumentationStats getInstrumentationStats(String name)
+        throws SigarException;
+
+    public String[] getInstrumentationList() throws SigarException;
+
     public FileSystem[] getFileSystemList() throws SigarException;
 
     public FileSystemMap getFileSystemMap() throws SigarException;
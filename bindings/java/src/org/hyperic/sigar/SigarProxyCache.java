@@ -85,6 +85,10 @@ public class SigarProxyCache
     }
 
     public static void clear(Object proxy) {
+        if (proxy instanceof SigarStripedCache) {
+            ((SigarStripedCache)proxy).clear();
+            return;
+        }
         getHandler(proxy).cache.clear();
     }
 
@@ -92,6 +96,9 @@ public class SigarProxyCache
         if (proxy.getClass() == Sigar.class) {
             return (Sigar)proxy;
         }
+        else if (proxy instanceof SigarStripedCache) {
+            return ((SigarStripedCache)proxy).getSigar();
+        }
         else {
             return getHandler(proxy).sigar;
         }
@@ -0,0 +1,965 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package org.hyperic.sigar;
+
+import java.util.ArrayList;
+import java.util.HashMap;
+import java.util.Iterator;
+import java.util.List;
+import java.util.Map;
+
+/**
+ * A SigarProxy cache for many threads, in place of SigarProxyCache.
+ * <ul>
+ * <li>methods dispatch through a switch, not java.lang.reflect.Proxy
+ * <li>expire times can be set per method and per method argument
+ * <li>entries live in lock stripes by key, a cache hit only locks
+ *     its stripe and its own entry
+ * <li>with setRefreshAhead, a daemon thread renews entries which are
+ *     about to expire, so callers find them fresh
+ * </ul>
+ * Calls into the native Sigar are serialized, as the Sigar instance
+ * is not safe for concurrent use.
+ */
+public class SigarStripedCache implements SigarProxy {
+
+    public static final int EXPIRE_DEFAULT = SigarProxyCache.EXPIRE_DEFAULT;
+
+    //entries not used within this many expire periods are dropped
+    private static final int IDLE_EXPIRES = 4;
+
+    private static final int STRIPES = 16; //power of 2
+
+    private static final int
+        SERVICE_PID          = 0,
+        MEM                  = 1,
+        SWAP                 = 2,
+        CPU                  = 3,
+        CPU_PERC             = 4,
+        UPTIME               = 5,
+        RESOURCE_LIMIT       = 6,
+        LOAD_AVERAGE         = 7,
+        PROC_LIST            = 8,
+        PROC_STAT            = 9,
+        PROC_MEM             = 10,
+        MULTI_PROC_MEM       = 11,
+        PROC_STATE           = 12,
+        PROC_TIME            = 13,
+        PROC_CPU             = 14,
+        MULTI_PROC_CPU       = 15,
+        PROC_CRED            = 16,
+        PROC_CRED_NAME       = 17,
+        PROC_FD              = 18,
+        PROC_EXE             = 19,
+        PROC_ARGS            = 20,
+        PROC_ENV             = 21,
+        PROC_ENV_VALUE       = 22,
+        PROC_MODULES         = 23,
+        PROC_PORT            = 24,
+        PROC_DISK_IO         = 25,
+        PROC_CUMULATIVE_DISK_IO = 26,
+        DUMP_PID_CACHE       = 27,
+        CACHE_STATS          = 28,
+        FILE_SYSTEM_LIST     = 29,
+        FILE_SYSTEM_MAP      = 30,
+        MOUNTED_FS_USAGE     = 31,
+        FILE_SYSTEM_USAGE    = 32,
+        DISK_USAGE           = 33,
+        FILE_INFO            = 34,
+        LINK_INFO            = 35,
+        DIR_STAT             = 36,
+        DIR_USAGE            = 37,
+        CPU_INFO_LIST        = 38,
+        CPU_LIST             = 39,
+        CPU_PERC_LIST        = 40,
+        NET_ROUTE_LIST       = 41,
+        NET_INTERFACE_CONFIG = 42,
+        NET_INTERFACE_STAT   = 43,
+        NET_INTERFACE_LIST   = 44,
+        NET_CONNECTION_LIST  = 45,
+        NET_LISTEN_ADDRESS   = 46,
+        NET_STAT             = 47,
+        NET_SERVICES_NAME    = 48,
+        WHO_LIST             = 49,
+        TCP                  = 50,
+        NFS_CLIENT_V2        = 51,
+        NFS_SERVER_V2        = 52,
+        NFS_CLIENT_V3        = 53,
+        NFS_SERVER_V3        = 54,
+        NET_INFO             = 55,
+        FQDN                 = 56,
+        INSTRUMENTATION_STATS = 57,
+        INSTRUMENTATION_LIST = 58,
+        METHODS              = 59;
+
+    //SigarProxy method names, by the ids above
+    private static final String[] NAMES = {
+        "getServicePid",
+        "getMem",
+        "getSwap",
+        "getCpu",
+        "getCpuPerc",
+        "getUptime",
+        "getResourceLimit",
+        "getLoadAverage",
+        "getProcList",
+        "getProcStat",
+        "getProcMem",
+        "getMultiProcMem",
+        "getProcState",
+        "getProcTime",
+        "getProcCpu",
+        "getMultiProcCpu",
+        "getProcCred",
+        "getProcCredName",
+        "getProcFd",
+        "getProcExe",
+        "getProcArgs",
+        "getProcEnv",
+        "getProcEnv",
+        "getProcModules",
+        "getProcPort",
+        "getProcDiskIO",
+        "getProcCumulativeDiskIO",
+        "dumpPidCache",
+        "getCacheStats",
+        "getFileSystemList",
+        "getFileSystemMap",
+        "getMountedFileSystemUsage",
+        "getFileSystemUsage",
+        "getDiskUsage",
+        "getFileInfo",
+        "getLinkInfo",
+        "getDirStat",
+        "getDirUsage",
+        "getCpuInfoList",
+        "getCpuList",
+        "getCpuPercList",
+        "getNetRouteList",
+        "getNetInterfaceConfig",
+        "getNetInterfaceStat",
+        "getNetInterfaceList",
+        "getNetConnectionList",
+        "getNetListenAddress",
+        "getNetStat",
+        "getNetServicesName",
+        "getWhoList",
+        "getTcp",
+        "getNfsClientV2",
+        "getNfsServerV2",
+        "getNfsClientV3",
+        "getNfsServerV3",
+        "getNetInfo",
+        "getFQDN",
+        "getInstrumentationStats",
+        "getInstrumentationList",
+    };
+
+    private static final class Key {
+        final int method;
+        final Object arg1, arg2;
+        final int hash;
+
+        Key(int method, Object arg1, Object arg2) {
+            this.method = method;
+            this.arg1 = arg1;
+            this.arg2 = arg2;
+            int hash = method * 31;
+            if (arg1 != null) {
+                hash ^= arg1.hashCode();
+            }
+            if (arg2 != null) {
+                hash = (hash * 31) ^ arg2.hashCode();
+            }
+            this.hash = hash;
+        }
+
+        public int hashCode() {
+            return this.hash;
+        }
+
+        private static boolean eq(Object a, Object b) {
+            return (a == null) ? (b == null) : a.equals(b);
+        }
+
+        public boolean equals(Object obj) {
+            if (!(obj instanceof Key)) {
+                return false;
+            }
+            Key key = (Key)obj;
+            return
+                (key.method == this.method) &&
+                eq(key.arg1, this.arg1) &&
+                eq(key.arg2, this.arg2);
+        }
+    }
+
+    private static final class Entry {
+        final Key key;
+        final int expire;
+        Object value = null;
+        long timestamp = 0;
+        long accessed = 0;
+
+        Entry(Key key, int expire) {
+            this.key = key;
+            this.expire = expire;
+        }
+    }
+
+    private final Sigar sigar;
+    private final Object sigarLock = new Object();
+    private final Map[] stripes = new Map[STRIPES];
+    private final int expire;
+    private final int[] methodExpire = new int[METHODS];
+    private final Map argExpire = new HashMap(); //Key -> Integer
+    private Refresher refresher = null;
+
+    public SigarStripedCache(Sigar sigar) {
+        this(sigar, EXPIRE_DEFAULT);
+    }
+
+    public SigarStripedCache(Sigar sigar, int expire) {
+        this.sigar = sigar;
+        this.expire = expire;
+        for (int i=0; i<STRIPES; i++) {
+            this.stripes[i] = new HashMap();
+        }
+        for (int i=0; i<METHODS; i++) {
+            this.methodExpire[i] = -1;
+        }
+    }
+
+    public Sigar getSigar() {
+        return this.sigar;
+    }
+
+    private boolean setMethodExpire(String method, Object arg, int expire) {
+        boolean found = false;
+
+        synchronized (this.argExpire) {
+            for (int i=0; i<METHODS; i++) {
+                if (!NAMES[i].equals(method)) {
+                    continue;
+                }
+                found = true;
+                if (arg == null) {
+                    this.methodExpire[i] = expire;
+                }
+                else {
+                    this.argExpire.put(new Key(i, arg, null),
+                                       new Integer(expire));
+                }
+            }
+        }
+
+        return found;
+    }
+
+    /**
+     * Expire time for every call of a method, overrides the default.
+     * Entries already cached keep the expire time they were made with.
+     * @param method SigarProxy method name, e.g. "getProcCpu".
+     * @param expire Millis, 0 to disable caching of the method.
+     * @exception IllegalArgumentException if method is not cached.
+     */
+    public void setExpire(String method, int expire) {
+        if (!setMethodExpire(method, null, expire)) {
+            throw new IllegalArgumentException(method);
+        }
+    }
+
+    /**
+     * Expire time for a method called with one argument, overrides
+     * the method expire time.  Pids are matched as Long,
+     * e.g. setExpire("getProcCpu", new Long(pid), 1000).
+     */
+    public void setExpire(String method, Object arg, int expire) {
+        if (!setMethodExpire(method, arg, expire)) {
+            throw new IllegalArgumentException(method);
+        }
+    }
+
+    private int getExpire(Key key) {
+        synchronized (this.argExpire) {
+            if ((key.arg1 != null) && (key.arg2 == null) &&
+                !this.argExpire.isEmpty())
+            {
+                Integer val = (Integer)this.argExpire.get(key);
+                if (val != null) {
+                    return val.intValue();
+                }
+            }
+            int expire = this.methodExpire[key.method];
+            return (expire == -1) ? this.expire : expire;
+        }
+    }
+
+    private Map getStripe(Key key) {
+        int hash = key.hash;
+        hash ^= (hash >>> 16);
+        return this.stripes[hash & (STRIPES-1)];
+    }
+
+    public void clear() {
+        for (int i=0; i<STRIPES; i++) {
+            synchronized (this.stripes[i]) {
+                this.stripes[i].clear();
+            }
+        }
+    }
+
+    private Object get(int method, Object arg1, Object arg2)
+        throws SigarException {
+
+        Key key = new Key(method, arg1, arg2);
+        Map stripe = getStripe(key);
+        Entry entry;
+
+        synchronized (stripe) {
+            entry = (Entry)stripe.get(key);
+            if (entry == null) {
+                entry = new Entry(key, getExpire(key));
+                if (entry.expire <= 0) {
+                    return fetch(key); //not cached
+                }
+                stripe.put(key, entry);
+            }
+        }
+
+        //only callers of the same key wait on each other here
+        synchronized (entry) {
+            long timeNow = System.currentTimeMillis();
+            entry.accessed = timeNow;
+            if ((entry.value != null) &&
+                ((timeNow - entry.timestamp) <= entry.expire))
+            {
+                return entry.value;
+            }
+            entry.value = fetch(key);
+            entry.timestamp = timeNow;
+            return entry.value;
+        }
+    }
+
+    private Object get(int method) throws SigarException {
+        return get(method, null, null);
+    }
+
+    private Object get(int method, Object arg) throws SigarException {
+        return get(method, arg, null);
+    }
+
+    private Object get(int method, long arg) throws SigarException {
+        return get(method, new Long(arg), null);
+    }
+
+    private static long lv(Object arg) {
+        return ((Long)arg).longValue();
+    }
+
+    private Object fetch(Key key) throws SigarException {
+        synchronized (this.sigarLock) {
+            return fetch(key.method, key.arg1, key.arg2);
+        }
+    }
+
+    private Object fetch(int method, Object arg, Object arg2)
+        throws SigarException {
+
+        Sigar sigar = this.sigar;
+        boolean isPid = (arg instanceof Long);
+
+        switch (method) {
+          case SERVICE_PID:
+            return new Long(sigar.getServicePid((String)arg));
+          case MEM:
+            return sigar.getMem();
+          case SWAP:
+            return sigar.getSwap();
+          case CPU:
+            return sigar.getCpu();
+          case CPU_PERC:
+            return sigar.getCpuPerc();
+          case UPTIME:
+            return sigar.getUptime();
+          case RESOURCE_LIMIT:
+            return sigar.getResourceLimit();
+          case LOAD_AVERAGE:
+            return sigar.getLoadAverage();
+          case PROC_LIST:
+            return sigar.getProcList();
+          case PROC_STAT:
+            return sigar.getProcStat();
+          case PROC_MEM:
+            return isPid ?
+                sigar.getProcMem(lv(arg)) : sigar.getProcMem((String)arg);
+          case MULTI_PROC_MEM:
+            return sigar.getMultiProcMem((String)arg);
+          case PROC_STATE:
+            return isPid ?
+                sigar.getProcState(lv(arg)) : sigar.getProcState((String)arg);
+          case PROC_TIME:
+            return isPid ?
+                sigar.getProcTime(lv(arg)) : sigar.getProcTime((String)arg);
+          case PROC_CPU:
+            return isPid ?
+                sigar.getProcCpu(lv(arg)) : sigar.getProcCpu((String)arg);
+          case MULTI_PROC_CPU:
+            return sigar.getMultiProcCpu((String)arg);
+          case PROC_CRED:
+            return isPid ?
+                sigar.getProcCred(lv(arg)) : sigar.getProcCred((String)arg);
+          case PROC_CRED_NAME:
+            return isPid ?
+                sigar.getProcCredName(lv(arg)) :
+                sigar.getProcCredName((String)arg);
+          case PROC_FD:
+            return isPid ?
+                sigar.getProcFd(lv(arg)) : sigar.getProcFd((String)arg);
+          case PROC_EXE:
+            return isPid ?
+                sigar.getProcExe(lv(arg)) : sigar.getProcExe((String)arg);
+          case PROC_ARGS:
+            return isPid ?
+                sigar.getProcArgs(lv(arg)) : sigar.getProcArgs((String)arg);
+          case PROC_ENV:
+            return isPid ?
+                sigar.getProcEnv(lv(arg)) : sigar.getProcEnv((String)arg);
+          case PROC_ENV_VALUE:
+            return isPid ?
+                sigar.getProcEnv(lv(arg), (String)arg2) :
+                sigar.getProcEnv((String)arg, (String)arg2);
+          case PROC_MODULES:
+            return isPid ?
+                sigar.getProcModules(lv(arg)) :
+                sigar.getProcModules((String)arg);
+          case PROC_PORT:
+            if (arg instanceof Integer) {
+                return new Long(sigar.getProcPort(((Integer)arg).intValue(),
+                                                  lv(arg2)));
+            }
+            return new Long(sigar.getProcPort((String)arg, (String)arg2));
+          case PROC_DISK_IO:
+            return isPid ?
+                sigar.getProcDiskIO(lv(arg)) :
+                sigar.getProcDiskIO((String)arg);
+          case PROC_CUMULATIVE_DISK_IO:
+            return isPid ?
+                sigar.getProcCumulativeDiskIO(lv(arg)) :
+                sigar.getProcCumulativeDiskIO((String)arg);
+          case DUMP_PID_CACHE:
+            return sigar.dumpPidCache();
+          case CACHE_STATS:
+            return sigar.getCacheStats((String)arg);
+          case FILE_SYSTEM_LIST:
+            return sigar.getFileSystemList();
+          case FILE_SYSTEM_MAP:
+            return sigar.getFileSystemMap();
+          case MOUNTED_FS_USAGE:
+            return sigar.getMountedFileSystemUsage((String)arg);
+          case FILE_SYSTEM_USAGE:
+            return sigar.getFileSystemUsage((String)arg);
+          case DISK_USAGE:
+            return sigar.getDiskUsage((String)arg);
+          case FILE_INFO:
+            return sigar.getFileInfo((String)arg);
+          case LINK_INFO:
+            return sigar.getLinkInfo((String)arg);
+          case DIR_STAT:
+            return sigar.getDirStat((String)arg);
+          case DIR_USAGE:
+            return sigar.getDirUsage((String)arg);
+          case CPU_INFO_LIST:
+            return sigar.getCpuInfoList();
+          case CPU_LIST:
+            return sigar.getCpuList();
+          case CPU_PERC_LIST:
+            return sigar.getCpuPercList();
+          case NET_ROUTE_LIST:
+            return sigar.getNetRouteList();
+          case NET_INTERFACE_CONFIG:
+            return (arg == null) ?
+                sigar.getNetInterfaceConfig() :
+                sigar.getNetInterfaceConfig((String)arg);
+          case NET_INTERFACE_STAT:
+            return sigar.getNetInterfaceStat((String)arg);
+          case NET_INTERFACE_LIST:
+            return sigar.getNetInterfaceList();
+          case NET_CONNECTION_LIST:
+            return sigar.getNetConnectionList(((Integer)arg).intValue());
+          case NET_LISTEN_ADDRESS:
+            return isPid ?
+                sigar.getNetListenAddress(lv(arg)) :
+                sigar.getNetListenAddress((String)arg);
+          case NET_STAT:
+            return sigar.getNetStat();
+          case NET_SERVICES_NAME:
+            return sigar.getNetServicesName(((Integer)arg).intValue(),
+                                            lv(arg2));
+          case WHO_LIST:
+            return sigar.getWhoList();
+          case TCP:
+            return sigar.getTcp();
+          case NFS_CLIENT_V2:
+            return sigar.getNfsClientV2();
+          case NFS_SERVER_V2:
+            return sigar.getNfsServerV2();
+          case NFS_CLIENT_V3:
+            return sigar.getNfsClientV3();
+          case NFS_SERVER_V3:
+            return sigar.getNfsServerV3();
+          case NET_INFO:
+            return sigar.getNetInfo();
+          case FQDN:
+            return sigar.getFQDN();
+          case INSTRUMENTATION_STATS:
+            return sigar.getInstrumentationStats((String)arg);
+          case INSTRUMENTATION_LIST:
+            return sigar.getInstrumentationList();
+          default:
+            throw new SigarException("unknown method " + method);
+        }
+    }
+
+    private class Refresher extends Thread {
+        private final int ahead;
+        private boolean running = true;
+
+        Refresher(int ahead) {
+            super("SigarStripedCache refresh");
+            this.ahead = ahead;
+            setDaemon(true);
+        }
+
+        synchronized void shutdown() {
+            this.running = false;
+            notifyAll();
+        }
+
+        private synchronized boolean pause(long millis) {
+            if (this.running) {
+                try {
+                    wait(millis);
+                } catch (InterruptedException e) {
+                    this.running = false;
+                }
+            }
+            return this.running;
+        }
+
+        //collect under the stripe locks, renew after releasing them
+        private List due(long timeNow) {
+            List due = new ArrayList();
+
+            for (int i=0; i<STRIPES; i++) {
+                Map stripe = stripes[i];
+                synchronized (stripe) {
+                    for (Iterator it=stripe.values().iterator();
+                         it.hasNext();)
+                    {
+                        Entry entry = (Entry)it.next();
+                        long idle = timeNow - entry.accessed;
+                        if (idle > (long)entry.expire * IDLE_EXPIRES) {
+                            it.remove();
+                        }
+                        else if ((entry.value != null) &&
+                                 ((timeNow - entry.timestamp) >=
+                                  (entry.expire - this.ahead)))
+                        {
+                            due.add(entry);
+                        }
+                    }
+                }
+            }
+
+            return due;
+        }
+
+        public void run() {
+            while (pause(this.ahead)) {
+                List due = due(System.currentTimeMillis());
+
+                for (int i=0; i<due.size(); i++) {
+                    Entry entry = (Entry)due.get(i);
+                    Object value;
+                    try {
+                        //entry is not locked, callers keep the old value
+                        value = fetch(entry.key);
+                    } catch (SigarException e) {
+                        continue; //callers fetch and get the error
+                    }
+                    synchronized (entry) {
+                        entry.value = value;
+                        entry.timestamp = System.currentTimeMillis();
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     * Renew entries in a background thread when they are within
+     * ahead millis of expiring.  Entries idle for several expire
+     * periods are dropped instead.
+     * @param ahead Millis, 0 to stop the refresh thread.
+     */
+    public synchronized void setRefreshAhead(int ahead) {
+        if (this.refresher != null) {
+            this.refresher.shutdown();
+            this.refresher = null;
+        }
+        if (ahead > 0) {
+            this.refresher = new Refresher(ahead);
+            this.refresher.start();
+        }
+    }
+
+    /**
+     * Stop the refresh thread, if any.  The Sigar instance is not closed.
+     */
+    public void close() {
+        setRefreshAhead(0);
+        clear();
+    }
+
+    public long getPid() {
+        return this.sigar.getPid();
+    }
+
+    public long getServicePid(String name) throws SigarException {
+        return ((Long)get(SERVICE_PID, name)).longValue();
+    }
+
+    public Mem getMem() throws SigarException {
+        return (Mem)get(MEM);
+    }
+
+    public Swap getSwap() throws SigarException {
+        return (Swap)get(SWAP);
+    }
+
+    public Cpu getCpu() throws SigarException {
+        return (Cpu)get(CPU);
+    }
+
+    public CpuPerc getCpuPerc() throws SigarException {
+        return (CpuPerc)get(CPU_PERC);
+    }
+
+    public Uptime getUptime() throws SigarException {
+        return (Uptime)get(UPTIME);
+    }
+
+    public ResourceLimit getResourceLimit() throws SigarException {
+        return (ResourceLimit)get(RESOURCE_LIMIT);
+    }
+
+    public double[] getLoadAverage() throws SigarException {
+        return (double[])get(LOAD_AVERAGE);
+    }
+
+    public long[] getProcList() throws SigarException {
+        return (long[])get(PROC_LIST);
+    }
+
+    public ProcStat getProcStat() throws SigarException {
+        return (ProcStat)get(PROC_STAT);
+    }
+
+    public ProcMem getProcMem(long pid) throws SigarException {
+        return (ProcMem)get(PROC_MEM, pid);
+    }
+
+    public ProcMem getProcMem(String pid) throws SigarException {
+        return (ProcMem)get(PROC_MEM, pid);
+    }
+
+    public ProcMem getMultiProcMem(String query) throws SigarException {
+        return (ProcMem)get(MULTI_PROC_MEM, query);
+    }
+
+    public ProcState getProcState(long pid) throws SigarException {
+        return (ProcState)get(PROC_STATE, pid);
+    }
+
+    public ProcState getProcState(String pid) throws SigarException {
+        return (ProcState)get(PROC_STATE, pid);
+    }
+
+    public ProcTime getProcTime(long pid) throws SigarException {
+        return (ProcTime)get(PROC_TIME, pid);
+    }
+
+    public ProcTime getProcTime(String pid) throws SigarException {
+        return (ProcTime)get(PROC_TIME, pid);
+    }
+
+    public ProcCpu getProcCpu(long pid) throws SigarException {
+        return (ProcCpu)get(PROC_CPU, pid);
+    }
+
+    public ProcCpu getProcCpu(String pid) throws SigarException {
+        return (ProcCpu)get(PROC_CPU, pid);
+    }
+
+    public MultiProcCpu getMultiProcCpu(String query) throws SigarException {
+        return (MultiProcCpu)get(MULTI_PROC_CPU, query);
+    }
+
+    public ProcCred getProcCred(long pid) throws SigarException {
+        return (ProcCred)get(PROC_CRED, pid);
+    }
+
+    public ProcCred getProcCred(String pid) throws SigarException {
+        return (ProcCred)get(PROC_CRED, pid);
+    }
+
+    public ProcCredName getProcCredName(long pid) throws SigarException {
+        return (ProcCredName)get(PROC_CRED_NAME, pid);
+    }
+
+    public ProcCredName getProcCredName(String pid) throws SigarException {
+        return (ProcCredName)get(PROC_CRED_NAME, pid);
+    }
+
+    public ProcFd getProcFd(long pid) throws SigarException {
+        return (ProcFd)get(PROC_FD, pid);
+    }
+
+    public ProcFd getProcFd(String pid) throws SigarException {
+        return (ProcFd)get(PROC_FD, pid);
+    }
+
+    public ProcExe getProcExe(long pid) throws SigarException {
+        return (ProcExe)get(PROC_EXE, pid);
+    }
+
+    public ProcExe getProcExe(String pid) throws SigarException {
+        return (ProcExe)get(PROC_EXE, pid);
+    }
+
+    public String[] getProcArgs(long pid) throws SigarException {
+        return (String[])get(PROC_ARGS, pid);
+    }
+
+    public String[] getProcArgs(String pid) throws SigarException {
+        return (String[])get(PROC_ARGS, pid);
+    }
+
+    public Map getProcEnv(long pid) throws SigarException {
+        return (Map)get(PROC_ENV, pid);
+    }
+
+    public Map getProcEnv(String pid) throws SigarException {
+        return (Map)get(PROC_ENV, pid);
+    }
+
+    public String getProcEnv(long pid, String key) throws SigarException {
+        return (String)get(PROC_ENV_VALUE, new Long(pid), key);
+    }
+
+    public String getProcEnv(String pid, String key) throws SigarException {
+        return (String)get(PROC_ENV_VALUE, pid, key);
+    }
+
+    public List getProcModules(long pid) throws SigarException {
+        return (List)get(PROC_MODULES, pid);
+    }
+
+    public List getProcModules(String pid) throws SigarException {
+        return (List)get(PROC_MODULES, pid);
+    }
+
+    public long getProcPort(int protocol, long port) throws SigarException {
+        Object val = get(PROC_PORT, new Integer(protocol), new Long(port));
+        return ((Long)val).longValue();
+    }
+
+    public long getProcPort(String protocol, String port)
+        throws SigarException {
+        return ((Long)get(PROC_PORT, protocol, port)).longValue();
+    }
+
+    public ProcDiskIO getProcDiskIO(long pid) throws SigarException {
+        return (ProcDiskIO)get(PROC_DISK_IO, pid);
+    }
+
+    public ProcDiskIO getProcDiskIO(String pid) throws SigarException {
+        return (ProcDiskIO)get(PROC_DISK_IO, pid);
+    }
+
+    public ProcCumulativeDiskIO getProcCumulativeDiskIO(long pid)
+        throws SigarException {
+        return (ProcCumulativeDiskIO)get(PROC_CUMULATIVE_DISK_IO, pid);
+    }
+
+    public ProcCumulativeDiskIO getProcCumulativeDiskIO(String pid)
+        throws SigarException {
+        return (ProcCumulativeDiskIO)get(PROC_CUMULATIVE_DISK_IO, pid);
+    }
+
+    public DumpPidCache dumpPidCache() throws SigarException {
+        return (DumpPidCache)get(DUMP_PID_CACHE);
+    }
+
+    public CacheStats getCacheStats(String name) throws SigarException {
+        return (CacheStats)get(CACHE_STATS, name);
+    }
+
+    public FileSystem[] getFileSystemList() throws SigarException {
+        return (FileSystem[])get(FILE_SYSTEM_LIST);
+    }
+
+    public FileSystemMap getFileSystemMap() throws SigarException {
+        return (FileSystemMap)get(FILE_SYSTEM_MAP);
+    }
+
+    public FileSystemUsage getMountedFileSystemUsage(String name)
+        throws SigarException {
+        return (FileSystemUsage)get(MOUNTED_FS_USAGE, name);
+    }
+
+    public FileSystemUsage getFileSystemUsage(String name)
+        throws SigarException {
+        return (FileSystemUsage)get(FILE_SYSTEM_USAGE, name);
+    }
+
+    public DiskUsage getDiskUsage(String name) throws SigarException {
+        return (DiskUsage)get(DISK_USAGE, name);
+    }
+
+    public FileInfo getFileInfo(String name) throws SigarException {
+        return (FileInfo)get(FILE_INFO, name);
+    }
+
+    public FileInfo getLinkInfo(String name) throws SigarException {
+        return (FileInfo)get(LINK_INFO, name);
+    }
+
+    public DirStat getDirStat(String name) throws SigarException {
+        return (DirStat)get(DIR_STAT, name);
+    }
+
+    public DirUsage getDirUsage(String name) throws SigarException {
+        return (DirUsage)get(DIR_USAGE, name);
+    }
+
+    public CpuInfo[] getCpuInfoList() throws SigarException {
+        return (CpuInfo[])get(CPU_INFO_LIST);
+    }
+
+    public Cpu[] getCpuList() throws SigarException {
+        return (Cpu[])get(CPU_LIST);
+    }
+
+    public CpuPerc[] getCpuPercList() throws SigarException {
+        return (CpuPerc[])get(CPU_PERC_LIST);
+    }
+
+    public NetRoute[] getNetRouteList() throws SigarException {
+        return (NetRoute[])get(NET_ROUTE_LIST);
+    }
+
+    public NetInterfaceConfig getNetInterfaceConfig(String name)
+        throws SigarException {
+        return (NetInterfaceConfig)get(NET_INTERFACE_CONFIG, name);
+    }
+
+    public NetInterfaceConfig getNetInterfaceConfig()
+        throws SigarException {
+        return (NetInterfaceConfig)get(NET_INTERFACE_CONFIG);
+    }
+
+    public NetInterfaceStat getNetInterfaceStat(String name)
+        throws SigarException {
+        return (NetInterfaceStat)get(NET_INTERFACE_STAT, name);
+    }
+
+    public String[] getNetInterfaceList() throws SigarException {
+        return (String[])get(NET_INTERFACE_LIST);
+    }
+
+    public NetConnection[] getNetConnectionList(int flags)
+        throws SigarException {
+        return (NetConnection[])get(NET_CONNECTION_LIST, new Integer(flags));
+    }
+
+    public String getNetListenAddress(long port) throws SigarException {
+        return (String)get(NET_LISTEN_ADDRESS, port);
+    }
+
+    public String getNetListenAddress(String port) throws SigarException {
+        return (String)get(NET_LISTEN_ADDRESS, port);
+    }
+
+    public NetStat getNetStat() throws SigarException {
+        return (NetStat)get(NET_STAT);
+    }
+
+    public String getNetServicesName(int protocol, long port) {
+        try {
+            return (String)get(NET_SERVICES_NAME,
+                               new Integer(protocol), new Long(port));
+        } catch (SigarException e) {
+            return null;
+        }
+    }
+
+    public Who[] getWhoList() throws SigarException {
+        return (Who[])get(WHO_LIST);
+    }
+
+    public Tcp getTcp() throws SigarException {
+        return (Tcp)get(TCP);
+    }
+
+    public NfsClientV2 getNfsClientV2() throws SigarException {
+        return (NfsClientV2)get(NFS_CLIENT_V2);
+    }
+
+    public NfsServerV2 getNfsServerV2() throws SigarException {
+        return (NfsServerV2)get(NFS_SERVER_V2);
+    }
+
+    public NfsClientV3 getNfsClientV3() throws SigarException {
+        return (NfsClientV3)get(NFS_CLIENT_V3);
+    }
+
+    public NfsServerV3 getNfsServerV3() throws SigarException {
+        return (NfsServerV3)get(NFS_SERVER_V3);
+    }
+
+    public NetInfo getNetInfo() throws SigarException {
+        return (NetInfo)get(NET_INFO);
+    }
+
+    public SigarVersion getSigarVersion() {
+        return this.sigar.getSigarVersion();
+    }
+
+    public String getFQDN() throws SigarException {
+        return (String)get(FQDN);
+    }
+
+    public InstrumentationStats getInstrumentationStats(String name)
+        throws SigarException {
+        return (InstrumentationStats)get(INSTRUMENTATION_STATS, name);
+    }
+
+    public String[] getInstrumentationList() throws SigarException {
+        return (String[])get(INSTRUMENTATION_LIST);
+    }
+}
@@ -53,12 +53,12 @@ public class MultiPs extends SigarCommandBase {
 
     public void output(String[] args) throws SigarException {
         String query = args[0];
-        MultiProcCpu cpu = this.proxy.getMultiProcCpu(query);
+        ProcMem mem = new ProcMem();
+        MultiProcCpu cpu = this.sigar.getMultiProcCpu(query, mem);
         println("Number of processes: " + cpu.getProcesses());
         println("Cpu usage: " + CpuPerc.format(cpu.getPercent()));
         println("Cpu time: "  + Ps.getCpuTime(cpu.getTotal()));
 
-        ProcMem mem = this.proxy.getMultiProcMem(query);
         println("Size: " + Sigar.formatSize(mem.getSize()));
         println("Resident: " + Sigar.formatSize(mem.getResident()));
         println("Share: " + Sigar.formatSize(mem.getShare()));
@@ -34,11 +34,15 @@
 package org.hyperic.sigar.jmx;
 
 import java.lang.reflect.Method;
+import java.util.ArrayList;
 import java.util.HashMap;
 import java.util.Iterator;
 import java.util.LinkedHashMap;
+import java.util.List;
 import java.util.Map;
 
+import javax.management.Attribute;
+import javax.management.AttributeList;
 import javax.management.AttributeNotFoundException;
 import javax.management.MBeanAttributeInfo;
 import javax.management.MBeanException;
@@ -157,6 +161,46 @@ public class ReflectedMBean extends AbstractMBean {
         }
     }
 
+    /**
+     * Static attributes are served from the map, the rest are read
+     * from a single fetch of the Sigar type, so the values returned
+     * together come from the same native call.
+     */
+    public AttributeList getAttributes(String[] names) {
+        AttributeList result = new AttributeList();
+        List dynamic = new ArrayList();
+
+        for (int i=0; i<names.length; i++) {
+            if (!this.attrs.containsKey(names[i])) {
+                dynamic.add(names[i]);
+            }
+        }
+
+        Object[] values = null;
+        if (dynamic.size() != 0) {
+            String[] attrs =
+                (String[])dynamic.toArray(new String[dynamic.size()]);
+            try {
+                values = getInvoker().invoke(attrs);
+            } catch (Exception e) {
+                e.printStackTrace();
+            }
+        }
+
+        for (int i=0, j=0; i<names.length; i++) {
+            Object val = this.attrs.get(names[i]);
+            if (val == null) {
+                val = (values == null) ? null : values[j];
+                j++;
+            }
+            if (val != null) {
+                result.add(new Attribute(names[i], val));
+            }
+        }
+
+        return result;
+    }
+
     private Map getMethods() {
         if (this.methods != null) {
             return this.methods;
@@ -203,4 +203,16 @@ public class SigarInvokerJMX extends SigarInvoker {
 
         return super.invoke(getArg(), attr);
     }
+
+    /**
+     * Invoke several attribute methods from a single type fetch.
+     * @param attrs The attribute names (e.g. Total, Free)
+     * @exception SigarException If invocation fails.
+     * @see SigarInvoker#invoke(Object, String[])
+     */
+    public Object[] invoke(String[] attrs)
+        throws SigarException, SigarNotImplementedException {
+
+        return super.invoke(getArg(), attrs);
+    }
 }
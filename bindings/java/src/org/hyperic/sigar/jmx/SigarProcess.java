@@ -61,29 +61,59 @@ public class SigarProcess implements SigarProcessMBean {
         return new IllegalArgumentException(msg);
     }
                                    
+    //attributes read within this window share one sample,
+    //so an MBeanServer getAttributes sees consistent values
+    private static final int SAMPLE_EXPIRE = 1000;
+    private long sampleTime = 0;
+    private ProcMem mem;
+    private ProcCpu cpu;
+    private ProcDiskIO diskIO;
+
+    private void expireSample() {
+        long timeNow = System.currentTimeMillis();
+        if ((timeNow - this.sampleTime) > SAMPLE_EXPIRE) {
+            this.mem = null;
+            this.cpu = null;
+            this.diskIO = null;
+            this.sampleTime = timeNow;
+        }
+    }
+
     private synchronized ProcMem getMem() {
-        try {
-            return this.sigar.getProcMem(getPid());
-        } catch (SigarException e) {
-            throw unexpectedError("Mem", e);
+        expireSample();
+        if (this.mem == null) {
+            try {
+                this.mem = this.sigar.getProcMem(getPid());
+            } catch (SigarException e) {
+                throw unexpectedError("Mem", e);
+            }
         }
+        return this.mem;
     }
 
     private synchronized ProcCpu getCpu() {
-        try {
-            return this.sigar.getProcCpu(getPid());
-        } catch (SigarException e) {
-            throw unexpectedError("Cpu", e);
-        }   
+        expireSample();
+        if (this.cpu == null) {
+            try {
+                this.cpu = this.sigar.getProcCpu(getPid());
+            } catch (SigarException e) {
+                throw unexpectedError("Cpu", e);
+            }
+        }
+        return this.cpu;
     }
 
 
     private synchronized ProcDiskIO getDiskIO() {
-	try {
-            return this.sigar.getProcDiskIO(getPid());
-        } catch (SigarException e) {
-            throw unexpectedError("DiskIO", e);
+        expireSample();
+        if (this.diskIO == null) {
+            try {
+                this.diskIO = this.sigar.getProcDiskIO(getPid());
+            } catch (SigarException e) {
+                throw unexpectedError("DiskIO", e);
+            }
         }
+        return this.diskIO;
     }
 
 
@@ -117,8 +147,9 @@ public class SigarProcess implements SigarProcessMBean {
         }
     }
 
-    public void setPid(long pid) {
+    public synchronized void setPid(long pid) {
         this.pid = pid;
+        this.sampleTime = 0;
     }
 
     public Long getMemSize() {
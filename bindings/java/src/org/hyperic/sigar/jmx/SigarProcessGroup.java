@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2006-2009 Hyperic, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+
+package org.hyperic.sigar.jmx;
+
+import javax.management.ObjectName;
+
+import org.hyperic.sigar.MultiProcCpu;
+import org.hyperic.sigar.ProcMem;
+import org.hyperic.sigar.Sigar;
+import org.hyperic.sigar.SigarException;
+import org.hyperic.sigar.SigarProxy;
+import org.hyperic.sigar.SigarProxyCache;
+
+/**
+ * Cpu and memory summed over the processes matching a PTQL query,
+ * e.g. "State.Name.eq=httpd".  Matching and summing is done in one
+ * native scan, the pids are never passed to Java.
+ */
+public class SigarProcessGroup implements SigarProcessGroupMBean {
+
+    //attributes read within this window share one aggregate
+    private static final int SAMPLE_EXPIRE = 1000;
+
+    private Sigar sigarImpl;
+    private Sigar sigar;
+    private String query;
+    private long sampleTime = 0;
+    private MultiProcCpu cpu;
+    private ProcMem mem;
+
+    public SigarProcessGroup(String query) {
+        this.sigarImpl = new Sigar();
+        this.sigar = this.sigarImpl;
+        this.query = query;
+    }
+
+    public SigarProcessGroup(SigarProxy sigar, String query) {
+        this.sigar = SigarProxyCache.getSigar(sigar);
+        this.query = query;
+    }
+
+    public void close() {
+        if (this.sigarImpl != null) {
+            this.sigarImpl.close();
+        }
+    }
+
+    private synchronized void sample() {
+        long timeNow = System.currentTimeMillis();
+        if ((this.cpu != null) &&
+            ((timeNow - this.sampleTime) <= SAMPLE_EXPIRE))
+        {
+            return;
+        }
+        ProcMem mem = new ProcMem();
+        try {
+            this.cpu = this.sigar.getMultiProcCpu(this.query, mem);
+        } catch (SigarException e) {
+            String msg =
+                "Unexected error in Sigar.getMultiProcCpu" +
+                ": " + e.getMessage();
+            throw new IllegalArgumentException(msg);
+        }
+        this.mem = mem;
+        this.sampleTime = timeNow;
+    }
+
+    private synchronized MultiProcCpu getCpu() {
+        sample();
+        return this.cpu;
+    }
+
+    private synchronized ProcMem getMem() {
+        sample();
+        return this.mem;
+    }
+
+    public String getObjectName() {
+        return
+            AbstractMBean.MBEAN_DOMAIN + ":" +
+            AbstractMBean.MBEAN_ATTR_TYPE + "=" + "ProcessGroup" + "," +
+            "Query" + "=" + ObjectName.quote(this.query);
+    }
+
+    public String getQuery() {
+        return this.query;
+    }
+
+    public Integer getProcesses() {
+        return new Integer(getCpu().getProcesses());
+    }
+
+    public Long getMemSize() {
+        return new Long(getMem().getSize());
+    }
+
+    public Long getMemResident() {
+        return new Long(getMem().getResident());
+    }
+
+    public Long getMemShare() {
+        return new Long(getMem().getShare());
+    }
+
+    public Long getMemPageFaults() {
+        return new Long(getMem().getPageFaults());
+    }
+
+    public Long getTimeUser() {
+        return new Long(getCpu().getUser());
+    }
+
+    public Long getTimeSys() {
+        return new Long(getCpu().getSys());
+    }
+
+    public Long getTimeTotal() {
+        return new Long(getCpu().getTotal());
+    }
+
+    public Double getCpuUsage() {
+        return new Double(getCpu().getPercent());
+    }
+}
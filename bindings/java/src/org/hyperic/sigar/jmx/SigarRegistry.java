@@ -218,6 +218,17 @@ public class SigarRegistry implements MBeanRegistration, SigarRegistryMBean {
         registerMBean(new ReflectedMBean(this.sigar, "ProcStat"));
         //sigar version
         registerMBean(new ReflectedMBean(this.sigar, "SigarVersion"));
+
+        //per-getter call counters, if the native library has them
+        try {
+            String[] getters = this.sigar.getInstrumentationList();
+            for (int i=0; i<getters.length; i++) {
+                registerMBean(new ReflectedMBean(this.sigar,
+                                                 "InstrumentationStats",
+                                                 getters[i]));
+            }
+        } catch (SigarException e) {
+        }
     }
 
     /**
@@ -28,7 +28,7 @@ public class ProcessQueryFactory {
 
     public ProcessQueryFactory() {}
 
-    public void clear() {
+    public synchronized void clear() {
         for (Iterator it=this.cache.values().iterator();
              it.hasNext();)
         {
@@ -38,14 +38,14 @@ public class ProcessQueryFactory {
         this.cache.clear();
     }
 
-    public static ProcessQueryFactory getInstance() {
+    public static synchronized ProcessQueryFactory getInstance() {
         if (instance == null) {
             instance = new ProcessQueryFactory();
         }
         return instance;
     }
 
-    public ProcessQuery getQuery(String query)
+    public synchronized ProcessQuery getQuery(String query)
         throws MalformedQueryException {
 
         if (query == null) {
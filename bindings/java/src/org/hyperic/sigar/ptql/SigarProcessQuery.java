@@ -16,6 +16,8 @@
 
 package org.hyperic.sigar.ptql;
 
+import org.hyperic.sigar.ProcCpu;
+import org.hyperic.sigar.ProcMem;
 import org.hyperic.sigar.Sigar;
 import org.hyperic.sigar.SigarException;
 
@@ -41,6 +43,21 @@ public class SigarProcessQuery implements ProcessQuery {
     public native long[] find(Sigar sigar)
         throws SigarException;
 
+    /* must match SIGAR_AGG_* in sigar_ptql.h */
+    public static final int AGG_CPU = 0x01;
+    public static final int AGG_MEM = 0x02;
+
+    /**
+     * Find the matching processes and sum their cpu and/or memory
+     * in a single native call.
+     * @param cpu Filled in with AGG_CPU, may be null.
+     * @param mem Filled in with AGG_MEM, may be null.
+     * @return Number of processes matched.
+     */
+    public native int aggregate(Sigar sigar, int flags,
+                                ProcCpu cpu, ProcMem mem)
+        throws SigarException;
+
     static boolean re(String haystack, String needle) {
         if (haystack == null) {
             return false;
@@ -0,0 +1,95 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package org.hyperic.sigar.win32;
+
+/**
+ * A PDH query kept open across samples.  Unlike {@link Pdh}, which
+ * adds and removes a counter for every value, counters are added
+ * once and each sample costs one {@link #collect}.
+ * Rate counters need two collects before they have a value.
+ */
+public class PdhQuery extends Win32 {
+
+    private long query;
+
+    public PdhQuery() throws Win32Exception {
+        this.query = open();
+    }
+
+    protected void finalize() throws Throwable {
+        try {
+            this.close();
+        } finally {
+            super.finalize();
+        }
+    }
+
+    public synchronized void close() throws Win32Exception {
+        if (this.query != 0) {
+            close(this.query);
+            this.query = 0;
+        }
+    }
+
+    /**
+     * @param path counter path, "*" instance wildcards are read
+     * with {@link #getValues}
+     * @return index of the counter for the getters
+     */
+    public int addCounter(String path) throws Win32Exception {
+        return add(this.query, Pdh.translate(path));
+    }
+
+    public void collect() throws Win32Exception {
+        collect(this.query);
+    }
+
+    public double getValue(int counter) throws Win32Exception {
+        return getValue(this.query, counter);
+    }
+
+    /**
+     * Values of every instance of a wildcard counter from the
+     * last collect, in the order of {@link #getInstances}.
+     * @return the number of instances, which may exceed values.length
+     */
+    public int getValues(int counter, double[] values)
+        throws Win32Exception {
+        return getValues(this.query, counter, values);
+    }
+
+    public String[] getInstances(int counter) throws Win32Exception {
+        return getInstances(this.query, counter);
+    }
+
+    private static native long open() throws Win32Exception;
+
+    private static native void close(long query) throws Win32Exception;
+
+    private static native int add(long query, String path)
+        throws Win32Exception;
+
+    private static native void collect(long query) throws Win32Exception;
+
+    private static native double getValue(long query, int counter)
+        throws Win32Exception;
+
+    private static native int getValues(long query, int counter,
+                                        double[] values)
+        throws Win32Exception;
+
+    private static native String[] getInstances(long query, int counter)
+        throws Win32Exception;
+}
@@ -57,6 +57,7 @@ int lua_sigar_swap_get(lua_State *L);
 int lua_sigar_procs_get(lua_State *L);
 int lua_sigar_proc_get(lua_State *L);
 int lua_sigar_pid_get(lua_State *L);
+int lua_sigar_snapshot_get(lua_State *L);
 int lua_sigar_fses_get(lua_State *L);
 int lua_sigar_disk_get(lua_State *L);
 int lua_sigar_disks_get(lua_State *L);
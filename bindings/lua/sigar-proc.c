@@ -243,4 +243,60 @@ int lua_sigar_pid_get(lua_State *L) {
 	return 1;
 }
 
+#define LUA_SIGAR_PUSH_NUMBER(L, v) \
+	lua_pushnumber(L, v)
 
+#define LUA_SIGAR_PUSH_CHAR(L, v) \
+	lua_pushlstring(L, &(v), 1)
+
+#define LUA_SIGAR_PUSH_STR(L, v) \
+	lua_pushstring(L, v)
+
+/* one array per field, indexed like the snapshot, no per process table */
+#define LUA_SIGAR_COLUMN(x, field, name, push) \
+	lua_createtable(L, (x)->number, 0); \
+	for (i = 0; i < (x)->number; i++) { \
+		push(L, (x)->data[i].field); \
+		lua_rawseti(L, -2, i + 1); \
+	} \
+	lua_setfield(L, -2, name);
+
+int lua_sigar_snapshot_get(lua_State *L) {
+	sigar_t *s = *(sigar_t **)luaL_checkudata(L, 1, "sigar");
+	int flags = luaL_optint(L, 2, SIGAR_PROC_SNAPSHOT_ALL);
+	sigar_proc_snapshot_t snapshot;
+	unsigned long i;
+	int err;
+
+	if (SIGAR_OK != (err = sigar_proc_snapshot_get(s, flags, &snapshot))) {
+		lua_pushnil(L);
+		lua_pushstring(L, strerror(err));
+		return 2;
+	}
+
+	lua_newtable(L);
+#define DATA \
+	(&(snapshot))
+
+	LUA_SIGAR_COLUMN(DATA, pid, "pid", LUA_SIGAR_PUSH_NUMBER);
+	LUA_SIGAR_COLUMN(DATA, flags, "flags", LUA_SIGAR_PUSH_NUMBER);
+	LUA_SIGAR_COLUMN(DATA, state.state, "state", LUA_SIGAR_PUSH_CHAR);
+	LUA_SIGAR_COLUMN(DATA, state.name, "name", LUA_SIGAR_PUSH_STR);
+	LUA_SIGAR_COLUMN(DATA, state.ppid, "ppid", LUA_SIGAR_PUSH_NUMBER);
+	LUA_SIGAR_COLUMN(DATA, state.threads, "threads", LUA_SIGAR_PUSH_NUMBER);
+	LUA_SIGAR_COLUMN(DATA, mem.size, "size", LUA_SIGAR_PUSH_NUMBER);
+	LUA_SIGAR_COLUMN(DATA, mem.resident, "resident", LUA_SIGAR_PUSH_NUMBER);
+	LUA_SIGAR_COLUMN(DATA, mem.share, "share", LUA_SIGAR_PUSH_NUMBER);
+	LUA_SIGAR_COLUMN(DATA, mem.page_faults, "page_faults", LUA_SIGAR_PUSH_NUMBER);
+	LUA_SIGAR_COLUMN(DATA, cpu.start_time, "start_time", LUA_SIGAR_PUSH_NUMBER);
+	LUA_SIGAR_COLUMN(DATA, cpu.user, "user", LUA_SIGAR_PUSH_NUMBER);
+	LUA_SIGAR_COLUMN(DATA, cpu.sys, "sys", LUA_SIGAR_PUSH_NUMBER);
+	LUA_SIGAR_COLUMN(DATA, cpu.total, "total", LUA_SIGAR_PUSH_NUMBER);
+	LUA_SIGAR_COLUMN(DATA, cpu.percent, "percent", LUA_SIGAR_PUSH_NUMBER);
+
+#undef DATA
+
+	sigar_proc_snapshot_destroy(s, &snapshot);
+
+	return 1;
+}
@@ -83,6 +83,18 @@ for i = 1, #procs do
 	end
 end
 
+print("-- snapshot")
+local snap, msg = s:snapshot()
+if snap then
+	for i = 1, #snap.pid do
+		if snap.pid[i] == s:pid() then
+			print(snap.pid[i], snap.name[i], snap.resident[i], snap.total[i])
+		end
+	end
+else
+	print("  -- no snapshot: " .. msg)
+end
+
 print("-- filesystems")
 local fses = s:filesystems()
 
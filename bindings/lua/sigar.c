@@ -134,6 +134,8 @@ static int lua_sigar_new(lua_State *L) {
 		lua_setfield(L, -2, "proc");
 		lua_pushcfunction(L, lua_sigar_pid_get);
 		lua_setfield(L, -2, "pid");
+		lua_pushcfunction(L, lua_sigar_snapshot_get);
+		lua_setfield(L, -2, "snapshot");
 		lua_pushcfunction(L, lua_sigar_mem_get);
 		lua_setfield(L, -2, "mem");
 		lua_pushcfunction(L, lua_sigar_swap_get);
@@ -64,6 +64,10 @@ typedef sigar_nfs_client_v2_t * Sigar__NfsClientV2;
 typedef sigar_nfs_server_v2_t * Sigar__NfsServerV2;
 typedef sigar_nfs_client_v3_t * Sigar__NfsClientV3;
 typedef sigar_nfs_server_v3_t * Sigar__NfsServerV3;
+typedef sigar_proc_disk_io_t * Sigar__ProcDiskIO;
+typedef sigar_proc_cumulative_disk_io_t * Sigar__ProcCumulativeDiskIO;
+typedef sigar_dump_pid_cache_t * Sigar__DumpPidCache;
+typedef sigar_cache_stats_t * Sigar__CacheStats;
 
 /* Perl < 5.6 */
 #ifndef aTHX_
@@ -105,6 +109,13 @@ static SV *convert_2strav(char **data, unsigned long number)
     return newRV_noinc((SV*)av);
 }
 
+static SV *convert_netaddr_2sv(sigar_net_address_t *address)
+{
+    char addr_str[SIGAR_INET6_ADDRSTRLEN];
+    sigar_net_address_to_string(NULL, address, addr_str);
+    return newSVpv(addr_str, 0);
+}
+
 static int proc_env_getall(void *data,
                            const char *key, int klen,
                            char *val, int vlen)
@@ -164,6 +175,12 @@ static void boot_Sigar_constants(pTHX)
     XS_SIGAR_CONST_IV(NETCONN_RAW);
     XS_SIGAR_CONST_IV(NETCONN_UNIX);
 
+    XS_SIGAR_CONST_IV(PROC_SNAPSHOT_STATE);
+    XS_SIGAR_CONST_IV(PROC_SNAPSHOT_MEM);
+    XS_SIGAR_CONST_IV(PROC_SNAPSHOT_TIME);
+    XS_SIGAR_CONST_IV(PROC_SNAPSHOT_CPU);
+    XS_SIGAR_CONST_IV(PROC_SNAPSHOT_ALL);
+
     XS_SIGAR_CONST_IV(TCP_ESTABLISHED);
     XS_SIGAR_CONST_IV(TCP_SYN_SENT);
     XS_SIGAR_CONST_IV(TCP_SYN_RECV);
@@ -16,6 +16,7 @@
  */
 
 #include <Python.h>
+#include <pythread.h>
 #include "sigar.h"
 #include "sigar_fileinfo.h"
 #include "sigar_format.h"
@@ -52,10 +53,36 @@ typedef struct {
     void *ptr;
 } PySigarObject;
 
+/* the Sigar type, same layout as PySigarObject up to ptr */
+typedef struct {
+    PyObject_HEAD
+    void *ptr;
+    sigar_t *snapshot_sigar; /* only used with snapshot_lock held */
+    PyThread_type_lock snapshot_lock;
+} PySigarHandleObject;
+
+#define PySIGAR_HANDLE ((PySigarHandleObject *)self)
+
 static PyTypeObject pysigar_PySigarType;
 
+static void pysigar_snapshot_close(PyObject *self)
+{
+    if (PySIGAR_HANDLE->snapshot_sigar) {
+        sigar_close(PySIGAR_HANDLE->snapshot_sigar);
+        PySIGAR_HANDLE->snapshot_sigar = NULL;
+    }
+}
+
 static void pysigar_free(PyObject *self)
 {
+    if (self->ob_type == &pysigar_PySigarType) {
+        pysigar_snapshot_close(self);
+        if (PySIGAR_HANDLE->snapshot_lock) {
+            PyThread_free_lock(PySIGAR_HANDLE->snapshot_lock);
+            PySIGAR_HANDLE->snapshot_lock = NULL;
+        }
+    }
+
     if (PySIGAR_OBJ->ptr) {
         if (self->ob_type == &pysigar_PySigarType) {
             sigar_close(PySIGAR);
@@ -184,6 +211,15 @@ static PyObject *pysigar_open(PyObject *pyself, PyObject *args)
 
 static PyObject *pysigar_close(PyObject *self, PyObject *args)
 {
+    if (PySIGAR_HANDLE->snapshot_lock) {
+        /* wait for a snapshot in progress on another thread */
+        Py_BEGIN_ALLOW_THREADS
+        PyThread_acquire_lock(PySIGAR_HANDLE->snapshot_lock, WAIT_LOCK);
+        Py_END_ALLOW_THREADS
+        pysigar_snapshot_close(self);
+        PyThread_release_lock(PySIGAR_HANDLE->snapshot_lock);
+    }
+
     if (PySIGAR_OBJ->ptr) {
         sigar_close(PySIGAR);
         PySIGAR_OBJ->ptr = NULL;
@@ -611,6 +647,494 @@ static PyObject *pysigar_proc_env(PyObject *self, PyObject *args)
     return RETVAL;
 }
 
+/*
+ * sigar.snapshot() gathers every process with the GIL released, using
+ * a second sigar_t so other threads may keep calling this Sigar.
+ * the result is stored as struct-of-arrays, one int64 column per
+ * field, each column exported with the buffer protocol so e.g.
+ * numpy.frombuffer(snap.rss(), numpy.int64) does not copy.
+ */
+
+enum {
+    PYSIGAR_SNAP_PID,
+    PYSIGAR_SNAP_FLAGS,
+    PYSIGAR_SNAP_STATE,
+    PYSIGAR_SNAP_PPID,
+    PYSIGAR_SNAP_TTY,
+    PYSIGAR_SNAP_PRIORITY,
+    PYSIGAR_SNAP_NICE,
+    PYSIGAR_SNAP_PROCESSOR,
+    PYSIGAR_SNAP_THREADS,
+    PYSIGAR_SNAP_SIZE,
+    PYSIGAR_SNAP_RSS,
+    PYSIGAR_SNAP_SHARE,
+    PYSIGAR_SNAP_MINOR_FAULTS,
+    PYSIGAR_SNAP_MAJOR_FAULTS,
+    PYSIGAR_SNAP_PAGE_FAULTS,
+    PYSIGAR_SNAP_START_TIME,
+    PYSIGAR_SNAP_UTIME,
+    PYSIGAR_SNAP_STIME,
+    PYSIGAR_SNAP_TOTAL,
+    PYSIGAR_SNAP_PERCENT, /* double */
+    PYSIGAR_SNAP_COLUMNS
+};
+
+typedef struct {
+    unsigned long number;
+    int flags;
+    sigar_int64_t *values; /* PYSIGAR_SNAP_COLUMNS * number */
+    char *names;           /* SIGAR_PROC_NAME_LEN * number, with STATE */
+} pysigar_snapshot_t;
+
+typedef struct {
+    PyObject_HEAD
+    pysigar_snapshot_t *ptr;
+} PySigarSnapshotObject;
+
+typedef struct {
+    PyObject_HEAD
+    char *ptr;
+    PyObject *owner; /* the ProcSnapshot holding ptr */
+    Py_ssize_t number;
+    Py_ssize_t itemsize;
+    char *format;
+} PySigarColumnObject;
+
+#define PySIGAR_SNAPSHOT (((PySigarSnapshotObject *)self)->ptr)
+
+#define PySIGAR_COLUMN ((PySigarColumnObject *)self)
+
+static PyTypeObject pysigar_PySigarProcSnapshotType;
+static PyTypeObject pysigar_PySigarSnapshotColumnType;
+
+static void pysigar_snapshot_data_free(pysigar_snapshot_t *data)
+{
+    if (data) {
+        free(data->values);
+        free(data->names);
+        free(data);
+    }
+}
+
+/* no Python API in here, called with the GIL released */
+static int pysigar_snapshot_gather(PySigarHandleObject *handle, int flags,
+                                   pysigar_snapshot_t **result)
+{
+    sigar_proc_snapshot_t snapshot;
+    pysigar_snapshot_t *data;
+    sigar_int64_t *col;
+    double *percent;
+    unsigned long i, n;
+    int status;
+
+    if (!handle->snapshot_sigar) {
+        if ((status = sigar_open(&handle->snapshot_sigar)) != SIGAR_OK) {
+            handle->snapshot_sigar = NULL;
+            return status;
+        }
+    }
+
+    status = sigar_proc_snapshot_get(handle->snapshot_sigar, flags, &snapshot);
+    if (status != SIGAR_OK) {
+        return status;
+    }
+
+    n = snapshot.number;
+    data = calloc(1, sizeof(*data));
+    if (data) {
+        data->values = malloc(sizeof(*data->values) *
+                              PYSIGAR_SNAP_COLUMNS * (n ? n : 1));
+        if (flags & SIGAR_PROC_SNAPSHOT_STATE) {
+            data->names = malloc(SIGAR_PROC_NAME_LEN * (n ? n : 1));
+        }
+    }
+    if (!data || !data->values ||
+        ((flags & SIGAR_PROC_SNAPSHOT_STATE) && !data->names))
+    {
+        pysigar_snapshot_data_free(data);
+        sigar_proc_snapshot_destroy(handle->snapshot_sigar, &snapshot);
+        return ENOMEM;
+    }
+
+    data->number = n;
+    data->flags = flags;
+    col = data->values;
+    percent = (double *)&col[PYSIGAR_SNAP_PERCENT * n];
+
+#define PYSIGAR_SNAP_SET(c, v) col[(PYSIGAR_SNAP_##c * n) + i] = (v)
+
+    for (i=0; i<n; i++) {
+        sigar_proc_snapshot_entry_t *entry = &snapshot.data[i];
+
+        PYSIGAR_SNAP_SET(PID, entry->pid);
+        PYSIGAR_SNAP_SET(FLAGS, entry->flags);
+        PYSIGAR_SNAP_SET(STATE, entry->state.state);
+        PYSIGAR_SNAP_SET(PPID, entry->state.ppid);
+        PYSIGAR_SNAP_SET(TTY, entry->state.tty);
+        PYSIGAR_SNAP_SET(PRIORITY, entry->state.priority);
+        PYSIGAR_SNAP_SET(NICE, entry->state.nice);
+        PYSIGAR_SNAP_SET(PROCESSOR, entry->state.processor);
+        PYSIGAR_SNAP_SET(THREADS, entry->state.threads);
+        PYSIGAR_SNAP_SET(SIZE, entry->mem.size);
+        PYSIGAR_SNAP_SET(RSS, entry->mem.resident);
+        PYSIGAR_SNAP_SET(SHARE, entry->mem.share);
+        PYSIGAR_SNAP_SET(MINOR_FAULTS, entry->mem.minor_faults);
+        PYSIGAR_SNAP_SET(MAJOR_FAULTS, entry->mem.major_faults);
+        PYSIGAR_SNAP_SET(PAGE_FAULTS, entry->mem.page_faults);
+        PYSIGAR_SNAP_SET(START_TIME, entry->cpu.start_time);
+        PYSIGAR_SNAP_SET(UTIME, entry->cpu.user);
+        PYSIGAR_SNAP_SET(STIME, entry->cpu.sys);
+        PYSIGAR_SNAP_SET(TOTAL, entry->cpu.total);
+        percent[i] = entry->cpu.percent;
+
+        if (data->names) {
+            memcpy(&data->names[i * SIGAR_PROC_NAME_LEN],
+                   entry->state.name, SIGAR_PROC_NAME_LEN);
+        }
+    }
+
+#undef PYSIGAR_SNAP_SET
+
+    sigar_proc_snapshot_destroy(handle->snapshot_sigar, &snapshot);
+
+    *result = data;
+
+    return SIGAR_OK;
+}
+
+static PyObject *pysigar_snapshot(PyObject *self, PyObject *args)
+{
+    int status;
+    sigar_t *sigar = PySIGAR;
+    int flags = SIGAR_PROC_SNAPSHOT_ALL;
+    pysigar_snapshot_t *data = NULL;
+    PyObject *RETVAL;
+
+    if (!PyArg_ParseTuple(args, "|i", &flags)) {
+        return NULL;
+    }
+
+    if (!sigar) {
+        PyErr_SetString(PyExc_ValueError, "sigar is closed");
+        return NULL;
+    }
+
+    if (!PySIGAR_HANDLE->snapshot_lock) {
+        if (!(PySIGAR_HANDLE->snapshot_lock = PyThread_allocate_lock())) {
+            return PyErr_NoMemory();
+        }
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    PyThread_acquire_lock(PySIGAR_HANDLE->snapshot_lock, WAIT_LOCK);
+    status = pysigar_snapshot_gather(PySIGAR_HANDLE, flags, &data);
+    PyThread_release_lock(PySIGAR_HANDLE->snapshot_lock);
+    Py_END_ALLOW_THREADS
+
+    if (status != SIGAR_OK) {
+        PySigar_Croak();
+        return NULL;
+    }
+
+    RETVAL = PySigar_new(pysigar_PySigarProcSnapshotType);
+    if (!RETVAL) {
+        pysigar_snapshot_data_free(data);
+        return NULL;
+    }
+    ((PySigarSnapshotObject *)RETVAL)->ptr = data;
+
+    return RETVAL;
+}
+
+static void pysigar_snapshot_free(PyObject *self)
+{
+    pysigar_snapshot_data_free(PySIGAR_SNAPSHOT);
+    PySIGAR_SNAPSHOT = NULL;
+    self->ob_type->tp_free((PyObject *)self);
+}
+
+static PyObject *pysigar_snapshot_column(PyObject *self, int column)
+{
+    pysigar_snapshot_t *data = PySIGAR_SNAPSHOT;
+    PyObject *obj = PySigar_new(pysigar_PySigarSnapshotColumnType);
+    PySigarColumnObject *col = (PySigarColumnObject *)obj;
+
+    if (!obj) {
+        return NULL;
+    }
+
+    Py_INCREF(self);
+    col->owner = self;
+    col->ptr = (char *)&data->values[column * data->number];
+    col->number = data->number;
+    col->itemsize = sizeof(sigar_int64_t);
+    col->format = (column == PYSIGAR_SNAP_PERCENT) ? "d" : "q";
+
+    return obj;
+}
+
+#define PYSIGAR_SNAP_COLUMN(name, c) \
+static PyObject *pysigar_snapshot_##name(PyObject *self, PyObject *args) \
+{ \
+    return pysigar_snapshot_column(self, PYSIGAR_SNAP_##c); \
+}
+
+PYSIGAR_SNAP_COLUMN(pid, PID)
+PYSIGAR_SNAP_COLUMN(flags, FLAGS)
+PYSIGAR_SNAP_COLUMN(state, STATE)
+PYSIGAR_SNAP_COLUMN(ppid, PPID)
+PYSIGAR_SNAP_COLUMN(tty, TTY)
+PYSIGAR_SNAP_COLUMN(priority, PRIORITY)
+PYSIGAR_SNAP_COLUMN(nice, NICE)
+PYSIGAR_SNAP_COLUMN(processor, PROCESSOR)
+PYSIGAR_SNAP_COLUMN(threads, THREADS)
+PYSIGAR_SNAP_COLUMN(size, SIZE)
+PYSIGAR_SNAP_COLUMN(rss, RSS)
+PYSIGAR_SNAP_COLUMN(share, SHARE)
+PYSIGAR_SNAP_COLUMN(minor_faults, MINOR_FAULTS)
+PYSIGAR_SNAP_COLUMN(major_faults, MAJOR_FAULTS)
+PYSIGAR_SNAP_COLUMN(page_faults, PAGE_FAULTS)
+PYSIGAR_SNAP_COLUMN(start_time, START_TIME)
+PYSIGAR_SNAP_COLUMN(utime, UTIME)
+PYSIGAR_SNAP_COLUMN(stime, STIME)
+PYSIGAR_SNAP_COLUMN(total, TOTAL)
+PYSIGAR_SNAP_COLUMN(percent, PERCENT)
+
+static PyObject *pysigar_snapshot_number(PyObject *self, PyObject *args)
+{
+    return PyInt_FromLong(PySIGAR_SNAPSHOT->number);
+}
+
+static PyObject *pysigar_snapshot_names(PyObject *self, PyObject *args)
+{
+    pysigar_snapshot_t *data = PySIGAR_SNAPSHOT;
+    unsigned long i;
+    PyObject *av;
+
+    if (!data->names) {
+        Py_INCREF(Py_None);
+        return Py_None;
+    }
+
+    av = PyTuple_New(data->number);
+    for (i=0; i<data->number; i++) {
+        PyTuple_SET_ITEM(av, i,
+                         PyString_FromString(&data->names[i * SIGAR_PROC_NAME_LEN]));
+    }
+
+    return av;
+}
+
+static PyMethodDef pysigar_snapshot_methods[] = {
+    { "number", pysigar_snapshot_number, METH_NOARGS, "number" },
+    { "names", pysigar_snapshot_names, METH_NOARGS, "names" },
+    { "pid", pysigar_snapshot_pid, METH_NOARGS, "pid" },
+    { "flags", pysigar_snapshot_flags, METH_NOARGS, "flags" },
+    { "state", pysigar_snapshot_state, METH_NOARGS, "state" },
+    { "ppid", pysigar_snapshot_ppid, METH_NOARGS, "ppid" },
+    { "tty", pysigar_snapshot_tty, METH_NOARGS, "tty" },
+    { "priority", pysigar_snapshot_priority, METH_NOARGS, "priority" },
+    { "nice", pysigar_snapshot_nice, METH_NOARGS, "nice" },
+    { "processor", pysigar_snapshot_processor, METH_NOARGS, "processor" },
+    { "threads", pysigar_snapshot_threads, METH_NOARGS, "threads" },
+    { "size", pysigar_snapshot_size, METH_NOARGS, "size" },
+    { "rss", pysigar_snapshot_rss, METH_NOARGS, "rss" },
+    { "share", pysigar_snapshot_share, METH_NOARGS, "share" },
+    { "minor_faults", pysigar_snapshot_minor_faults, METH_NOARGS, "minor_faults" },
+    { "major_faults", pysigar_snapshot_major_faults, METH_NOARGS, "major_faults" },
+    { "page_faults", pysigar_snapshot_page_faults, METH_NOARGS, "page_faults" },
+    { "start_time", pysigar_snapshot_start_time, METH_NOARGS, "start_time" },
+    { "utime", pysigar_snapshot_utime, METH_NOARGS, "utime" },
+    { "stime", pysigar_snapshot_stime, METH_NOARGS, "stime" },
+    { "total", pysigar_snapshot_total, METH_NOARGS, "total" },
+    { "percent", pysigar_snapshot_percent, METH_NOARGS, "percent" },
+    {NULL}
+};
+
+static PyTypeObject pysigar_PySigarProcSnapshotType = {
+    PyObject_HEAD_INIT(NULL)
+    0,                         /*ob_size*/
+    "Sigar.ProcSnapshot",      /*tp_name*/
+    sizeof(PySigarSnapshotObject), /*tp_basicsize*/
+    0,                         /*tp_itemsize*/
+    pysigar_snapshot_free,     /*tp_dealloc*/
+    0,                         /*tp_print*/
+    0,                         /*tp_getattr*/
+    0,                         /*tp_setattr*/
+    0,                         /*tp_compare*/
+    0,                         /*tp_repr*/
+    0,                         /*tp_as_number*/
+    0,                         /*tp_as_sequence*/
+    0,                         /*tp_as_mapping*/
+    0,                         /*tp_hash */
+    0,                         /*tp_call*/
+    0,                         /*tp_str*/
+    0,                         /*tp_getattro*/
+    0,                         /*tp_setattro*/
+    0,                         /*tp_as_buffer*/
+    PySigar_TPFLAGS,           /*tp_flags*/
+    0,                         /*tp_doc*/
+    0,                         /*tp_traverse*/
+    0,                         /*tp_clear*/
+    0,                         /*tp_richcompare*/
+    0,                         /*tp_weaklistoffset*/
+    0,                         /*tp_iter*/
+    0,                         /*tp_iternext*/
+    pysigar_snapshot_methods,  /*tp_methods*/
+    0,                         /*tp_members*/
+    0,                         /*tp_getset*/
+    0,                         /*tp_base*/
+    0,                         /*tp_dict*/
+    0,                         /*tp_descr_get*/
+    0,                         /*tp_descr_set*/
+    0,                         /*tp_dictoffset*/
+    0,                         /*tp_init*/
+    0,                         /*tp_alloc*/
+    0                          /*tp_new*/
+};
+
+static void pysigar_column_free(PyObject *self)
+{
+    Py_XDECREF(PySIGAR_COLUMN->owner);
+    PySIGAR_COLUMN->owner = NULL;
+    PySIGAR_COLUMN->ptr = NULL;
+    self->ob_type->tp_free((PyObject *)self);
+}
+
+static Py_ssize_t pysigar_column_length(PyObject *self)
+{
+    return PySIGAR_COLUMN->number;
+}
+
+static PyObject *pysigar_column_item(PyObject *self, Py_ssize_t i)
+{
+    PySigarColumnObject *col = PySIGAR_COLUMN;
+
+    if ((i < 0) || (i >= col->number)) {
+        PyErr_SetString(PyExc_IndexError, "column index out of range");
+        return NULL;
+    }
+
+    if (*col->format == 'd') {
+        return PyFloat_FromDouble(((double *)col->ptr)[i]);
+    }
+    else {
+        return PyLong_FromLongLong(((sigar_int64_t *)col->ptr)[i]);
+    }
+}
+
+static PySequenceMethods pysigar_column_as_sequence = {
+    pysigar_column_length,     /*sq_length*/
+    0,                         /*sq_concat*/
+    0,                         /*sq_repeat*/
+    pysigar_column_item,       /*sq_item*/
+};
+
+/* old style buffer, used by numpy.frombuffer and buffer() */
+static Py_ssize_t pysigar_column_readbuffer(PyObject *self, Py_ssize_t segment,
+                                            void **ptr)
+{
+    if (segment != 0) {
+        PyErr_SetString(PyExc_SystemError, "accessing non-existent segment");
+        return -1;
+    }
+    *ptr = PySIGAR_COLUMN->ptr;
+    return PySIGAR_COLUMN->number * PySIGAR_COLUMN->itemsize;
+}
+
+static Py_ssize_t pysigar_column_segcount(PyObject *self, Py_ssize_t *len)
+{
+    if (len) {
+        *len = PySIGAR_COLUMN->number * PySIGAR_COLUMN->itemsize;
+    }
+    return 1;
+}
+
+#ifdef Py_TPFLAGS_HAVE_NEWBUFFER
+/* PEP 3118 buffer, used by memoryview, carries the item format */
+static int pysigar_column_getbuffer(PyObject *self, Py_buffer *view, int flags)
+{
+    PySigarColumnObject *col = PySIGAR_COLUMN;
+
+    if (flags & PyBUF_WRITABLE) {
+        PyErr_SetString(PyExc_BufferError, "snapshot columns are read-only");
+        return -1;
+    }
+
+    view->buf = col->ptr;
+    view->obj = self;
+    Py_INCREF(self);
+    view->len = col->number * col->itemsize;
+    view->readonly = 1;
+    view->itemsize = col->itemsize;
+    view->format = (flags & PyBUF_FORMAT) ? col->format : NULL;
+    view->ndim = 1;
+    view->shape = (flags & PyBUF_ND) ? &col->number : NULL;
+    view->strides = (flags & PyBUF_STRIDES) ? &col->itemsize : NULL;
+    view->suboffsets = NULL;
+    view->internal = NULL;
+
+    return 0;
+}
+
+#define PySigar_COLUMN_TPFLAGS (PySigar_TPFLAGS | Py_TPFLAGS_HAVE_NEWBUFFER)
+#else
+#define PySigar_COLUMN_TPFLAGS PySigar_TPFLAGS
+#endif
+
+static PyBufferProcs pysigar_column_as_buffer = {
+    (readbufferproc)pysigar_column_readbuffer, /*bf_getreadbuffer*/
+    0,                                         /*bf_getwritebuffer*/
+    (segcountproc)pysigar_column_segcount,     /*bf_getsegcount*/
+    0,                                         /*bf_getcharbuffer*/
+#ifdef Py_TPFLAGS_HAVE_NEWBUFFER
+    (getbufferproc)pysigar_column_getbuffer,   /*bf_getbuffer*/
+    0,                                         /*bf_releasebuffer*/
+#endif
+};
+
+static PyTypeObject pysigar_PySigarSnapshotColumnType = {
+    PyObject_HEAD_INIT(NULL)
+    0,                         /*ob_size*/
+    "Sigar.SnapshotColumn",    /*tp_name*/
+    sizeof(PySigarColumnObject), /*tp_basicsize*/
+    0,                         /*tp_itemsize*/
+    pysigar_column_free,       /*tp_dealloc*/
+    0,                         /*tp_print*/
+    0,                         /*tp_getattr*/
+    0,                         /*tp_setattr*/
+    0,                         /*tp_compare*/
+    0,                         /*tp_repr*/
+    0,                         /*tp_as_number*/
+    &pysigar_column_as_sequence, /*tp_as_sequence*/
+    0,                         /*tp_as_mapping*/
+    0,                         /*tp_hash */
+    0,                         /*tp_call*/
+    0,                         /*tp_str*/
+    0,                         /*tp_getattro*/
+    0,                         /*tp_setattro*/
+    &pysigar_column_as_buffer, /*tp_as_buffer*/
+    PySigar_COLUMN_TPFLAGS,    /*tp_flags*/
+    0,                         /*tp_doc*/
+    0,                         /*tp_traverse*/
+    0,                         /*tp_clear*/
+    0,                         /*tp_richcompare*/
+    0,                         /*tp_weaklistoffset*/
+    0,                         /*tp_iter*/
+    0,                         /*tp_iternext*/
+    0,                         /*tp_methods*/
+    0,                         /*tp_members*/
+    0,                         /*tp_getset*/
+    0,                         /*tp_base*/
+    0,                         /*tp_dict*/
+    0,                         /*tp_descr_get*/
+    0,                         /*tp_descr_set*/
+    0,                         /*tp_dictoffset*/
+    0,                         /*tp_init*/
+    0,                         /*tp_alloc*/
+    0                          /*tp_new*/
+};
+
 static PyObject *pysigar_format_size(PyObject *self, PyObject *args)
 {
     char buffer[56];
@@ -639,6 +1163,7 @@ static PyMethodDef pysigar_methods[] = {
     { "proc_list", pysigar_proc_list, METH_VARARGS, NULL },
     { "proc_args", pysigar_proc_args, METH_VARARGS, NULL },
     { "proc_env", pysigar_proc_env, METH_VARARGS, NULL },
+    { "snapshot", pysigar_snapshot, METH_VARARGS, NULL },
     PY_SIGAR_METHODS
     {NULL}
 };
@@ -647,7 +1172,7 @@ static PyTypeObject pysigar_PySigarType = {
     PyObject_HEAD_INIT(NULL)
     0,                         /*ob_size*/
     "Sigar",                   /*tp_name*/
-    sizeof(PySigarObject),     /*tp_basicsize*/
+    sizeof(PySigarHandleObject), /*tp_basicsize*/
     0,                         /*tp_itemsize*/
     pysigar_free,              /*tp_dealloc*/
     0,                         /*tp_print*/
@@ -717,6 +1242,12 @@ static void init_pysigar_constants(PyObject *dict)
 
     PY_SIGAR_CONST_INT(FIELD_NOTIMPL);
 
+    PY_SIGAR_CONST_INT(PROC_SNAPSHOT_STATE);
+    PY_SIGAR_CONST_INT(PROC_SNAPSHOT_MEM);
+    PY_SIGAR_CONST_INT(PROC_SNAPSHOT_TIME);
+    PY_SIGAR_CONST_INT(PROC_SNAPSHOT_CPU);
+    PY_SIGAR_CONST_INT(PROC_SNAPSHOT_ALL);
+
     PY_SIGAR_CONST_INT(IFF_UP);
     PY_SIGAR_CONST_INT(IFF_BROADCAST);
     PY_SIGAR_CONST_INT(IFF_DEBUG);
@@ -739,6 +1270,8 @@ init_sigar(void)
         Py_InitModule("_sigar", pysigar_module_methods);
 
     PySigar_AddType("Sigar", pysigar_PySigarType);
+    PySigar_AddType("ProcSnapshot", pysigar_PySigarProcSnapshotType);
+    PySigar_AddType("SnapshotColumn", pysigar_PySigarSnapshotColumnType);
 
     PY_SIGAR_ADD_TYPES;
 
@@ -108,6 +108,21 @@ class SigarTest(unittest.TestCase):
         except ValueError:
             self.assertTrue(True)
 
+    def testSnapshot(self):
+        snap = self.sigar.snapshot()
+        self.assertTrue(self.is_type(snap, "ProcSnapshot"))
+        number = snap.number()
+        self.assertTrue(number > 1)
+        pids = snap.pid()
+        self.assertEquals(len(pids), number)
+        self.assertTrue(os.getpid() in list(pids))
+        self.assertEquals(len(buffer(snap.rss())), number * 8)
+        self.assertEquals(memoryview(snap.utime()).format, "q")
+        self.assertEquals(memoryview(snap.percent()).format, "d")
+        self.assertEquals(len(snap.names()), number)
+        snap = self.sigar.snapshot(sigar.PROC_SNAPSHOT_MEM)
+        self.assertEquals(snap.names(), None)
+
     def testPtql(self):
         try:
             self.sigar.proc_args("Invalid.Query.xe=.*ython")
@@ -162,6 +162,7 @@ static VALUE rb_sigar_new(VALUE module)
 {
     rb_sigar_t *rbsigar;
     rbsigar = ALLOC(rb_sigar_t);
+    rbsigar->logger = Qnil;
     sigar_open(&(rbsigar->sigar));
     return Data_Wrap_Struct(module, rb_sigar_mark, rb_sigar_close, rbsigar);
 }
@@ -803,6 +804,12 @@ static void Init_rbsigar_constants(VALUE rclass)
     RB_SIGAR_CONST_INT(NETCONN_RAW);
     RB_SIGAR_CONST_INT(NETCONN_UNIX);
 
+    RB_SIGAR_CONST_INT(PROC_SNAPSHOT_STATE);
+    RB_SIGAR_CONST_INT(PROC_SNAPSHOT_MEM);
+    RB_SIGAR_CONST_INT(PROC_SNAPSHOT_TIME);
+    RB_SIGAR_CONST_INT(PROC_SNAPSHOT_CPU);
+    RB_SIGAR_CONST_INT(PROC_SNAPSHOT_ALL);
+
     RB_SIGAR_CONST_INT(TCP_ESTABLISHED);
     RB_SIGAR_CONST_INT(TCP_SYN_SENT);
     RB_SIGAR_CONST_INT(TCP_SYN_RECV);
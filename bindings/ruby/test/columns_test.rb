@@ -0,0 +1,54 @@
+#
+# Copyright (c) 2009 VMware, Inc.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+$LOAD_PATH.unshift File.dirname(__FILE__)
+require 'helper'
+
+class ColumnsTest < Test::Unit::TestCase
+
+  def assert_columns(columns, message)
+    number = columns.values.first.length
+    columns.each do |name, values|
+      assert_eq number, values.length, "#{message} #{name}"
+    end
+  end
+
+  def test_proc_snapshot_columns
+    sigar = Sigar.new
+    columns = sigar.proc_snapshot_columns
+    assert_columns columns, "proc_snapshot"
+    assert columns[:pid].include?(Process.pid), "pid"
+
+    columns = sigar.proc_snapshot_columns Sigar::PROC_SNAPSHOT_STATE
+    assert_columns columns, "proc_snapshot state"
+  end
+
+  def test_file_system_columns
+    sigar = Sigar.new
+    columns = sigar.file_system_columns
+    assert_columns columns, "file_system"
+    assert_eq sigar.file_system_list.length, columns[:dir_name].length,
+              "dir_name"
+  end
+
+  def test_cpu_columns
+    sigar = Sigar.new
+    columns = sigar.cpu_columns
+    assert_columns columns, "cpu"
+    assert_gt_zero columns[:total].length, "cpu number"
+  end
+
+end
@@ -0,0 +1,217 @@
+package gotoc
+
+import (
+	"fmt"
+	"unsafe"
+)
+
+/*
+#include "../../../../../Include/sigar.h"
+#include "gotoc_rows.h"
+
+// one crossing per poll: snapshot every process and copy up to max
+// rows, *number is set to the process count so the caller can grow
+static int gotoc_proc_rows_get(sigar_t *sigar, int flags,
+                               gotoc_proc_row_t *rows, int max,
+                               int *number)
+{
+	sigar_proc_snapshot_t snapshot;
+	int status;
+
+	if ((status = sigar_proc_snapshot_get(sigar, flags, &snapshot)) != SIGAR_OK) {
+		return status;
+	}
+
+	*number = gotoc_proc_rows_copy(&snapshot, rows, max);
+
+	sigar_proc_snapshot_destroy(sigar, &snapshot);
+
+	return SIGAR_OK;
+}
+
+typedef struct {
+	sigar_cpu_t cpu;
+	sigar_mem_t mem;
+	sigar_swap_t swap;
+	sigar_loadavg_t loadavg;
+	sigar_proc_stat_t procstat;
+	int status[5];
+} gotoc_sys_sample_t;
+
+// cpu, mem, swap, load average and proc stat in one crossing
+static void gotoc_sys_sample_get(sigar_t *sigar, gotoc_sys_sample_t *sample)
+{
+	sample->status[0] = sigar_cpu_get(sigar, &sample->cpu);
+	sample->status[1] = sigar_mem_get(sigar, &sample->mem);
+	sample->status[2] = sigar_swap_get(sigar, &sample->swap);
+	sample->status[3] = sigar_loadavg_get(sigar, &sample->loadavg);
+	sample->status[4] = sigar_proc_stat_get(sigar, &sample->procstat);
+}
+*/
+import "C"
+
+const (
+	SNAPSHOT_STATE = C.SIGAR_PROC_SNAPSHOT_STATE
+	SNAPSHOT_MEM = C.SIGAR_PROC_SNAPSHOT_MEM
+	SNAPSHOT_TIME = C.SIGAR_PROC_SNAPSHOT_TIME
+	SNAPSHOT_CPU = C.SIGAR_PROC_SNAPSHOT_CPU
+	SNAPSHOT_ALL = C.SIGAR_PROC_SNAPSHOT_ALL
+)
+
+//ProcRow must match gotoc_proc_row_t field for field
+type ProcRow struct {
+	Pid int64
+	Flags int64 //SNAPSHOT_* fields which are valid
+	State int64
+	Ppid int64
+	Tty int64
+	Priority int64
+	Nice int64
+	Processor int64
+	Threads uint64
+	MemSize uint64
+	MemResident uint64
+	MemShare uint64
+	MemMinorFaults uint64
+	MemMajorFaults uint64
+	MemPageFaults uint64
+	StartTime uint64
+	User uint64
+	Sys uint64
+	Total uint64
+	LastTime uint64
+	Percent float64
+	Name [C.SIGAR_PROC_NAME_LEN]byte
+}
+
+//compile time check that both layouts have the same size
+var _ [unsafe.Sizeof(ProcRow{}) - unsafe.Sizeof(C.gotoc_proc_row_t{})]byte
+var _ [unsafe.Sizeof(C.gotoc_proc_row_t{}) - unsafe.Sizeof(ProcRow{})]byte
+
+//NameString allocates, compare Name in place to avoid it
+func (this *ProcRow) NameString() string {
+	n := 0
+	for n < len(this.Name) && this.Name[n] != 0 {
+		n++
+	}
+	return string(this.Name[:n])
+}
+
+func procRowsGet(sigar *C.sigar_t, flags int, rows []ProcRow) ([]ProcRow, error) {
+	for {
+		var number C.int
+		var ptr *C.gotoc_proc_row_t
+		rows = rows[:cap(rows)]
+		if len(rows) > 0 {
+			ptr = (*C.gotoc_proc_row_t)(unsafe.Pointer(&rows[0]))
+		}
+		status := int(C.gotoc_proc_rows_get(sigar, C.int(flags), ptr, C.int(len(rows)), &number))
+		if status != SIGAR_OK {
+			return rows[:0], fmt.Errorf("Failed to retrieve proc snapshot with error: %v", status)
+		}
+		if int(number) <= len(rows) {
+			return rows[:number], nil
+		}
+		//grow with some headroom so the next poll fits
+		rows = make([]ProcRow, int(number)+int(number)/8)
+	}
+}
+
+//GetProcRows decodes one snapshot of every process into rows, reusing
+//its capacity.  Pass the returned slice back in on the next poll, it
+//only allocates when the process count outgrows the capacity.
+//Percent is against the previous poll on the same handle, and any free
+//handle of pool may be the one used: for percents, poll through a pool
+//of its own made with NewHandlePool(1), not DefaultHandlePool.
+func GetProcRows(pool *HandlePool, flags int, rows []ProcRow) ([]ProcRow, error) {
+	if pool == nil {
+		pool = DefaultHandlePool()
+	}
+	sigar, err := pool.Get()
+	if err != nil {
+		return rows[:0], err
+	}
+	defer pool.Put(sigar)
+	return procRowsGet(sigar, flags, rows)
+}
+
+//SysSample is filled with one cgo crossing, see GetSysSample
+type SysSample struct {
+	Cpu CpuUsageInfo
+	Mem Mem
+	Swap Swap
+	LoadAvg [3]float64
+	ProcStat ProcStatInfo
+}
+
+//GetSysSample refills sample in place, nothing is allocated
+func GetSysSample(pool *HandlePool, sample *SysSample) error {
+	if pool == nil {
+		pool = DefaultHandlePool()
+	}
+	sigar, err := pool.Get()
+	if err != nil {
+		return err
+	}
+	defer pool.Put(sigar)
+
+	var c_sample C.gotoc_sys_sample_t
+	C.gotoc_sys_sample_get(sigar, &c_sample)
+
+	for i := 0; i < len(c_sample.status); i++ {
+		if status := int(c_sample.status[i]) ; status != SIGAR_OK {
+			return fmt.Errorf("Failed to retrieve sys sample (%v) with error: %v", i, status)
+		}
+	}
+
+	cpu := &c_sample.cpu
+	sample.Cpu = CpuUsageInfo{
+		User : uint64(cpu.user),
+		Sys : uint64(cpu.sys),
+		Nice : uint64(cpu.nice),
+		Idle : uint64(cpu.idle),
+		Wait : uint64(cpu.wait),
+		Irq : uint64(cpu.irq),
+		SoftIrq : uint64(cpu.soft_irq),
+		Stolen : uint64(cpu.stolen),
+		Total : uint64(cpu.total),
+	}
+
+	mem := &c_sample.mem
+	sample.Mem = Mem{
+		Ram : uint64(mem.ram),
+		Total : uint64(mem.total),
+		Used : uint64(mem.used),
+		Free : uint64(mem.free),
+		ActualUsed : uint64(mem.actual_used),
+		ActualFree : uint64(mem.actual_free),
+		UsedPerecent : float64(mem.used_percent),
+		FreePerecent : float64(mem.free_percent),
+	}
+
+	swap := &c_sample.swap
+	sample.Swap = Swap{
+		Total : uint64(swap.total),
+		Used : uint64(swap.used),
+		Free : uint64(swap.free),
+		PageIn : uint64(swap.page_in),
+		PageOut : uint64(swap.page_out),
+	}
+
+	for i := 0; i < 3; i++ {
+		sample.LoadAvg[i] = float64(c_sample.loadavg.loadavg[i])
+	}
+
+	procstat := &c_sample.procstat
+	sample.ProcStat = ProcStatInfo{
+		Total : uint64(procstat.total),
+		Sleeping : uint64(procstat.sleeping),
+		Running : uint64(procstat.running),
+		Zombie : uint64(procstat.zombie),
+		Stopped : uint64(procstat.stopped),
+		Idle : uint64(procstat.idle),
+		Threads : uint64(procstat.threads),
+	}
+
+	return nil
+}
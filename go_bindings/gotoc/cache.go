@@ -0,0 +1,72 @@
+package gotoc
+
+import (
+	"fmt"
+	"unsafe"
+	"github.com/vmware/leap/util"
+)
+/*
+#include <stdlib.h>
+#include "../../../../../Include/sigar.h"
+*/
+import "C"
+
+var CacheNames = []string{
+	"proc_cpu",
+	"proc_io",
+	"fsdev",
+	"net_listen",
+	"net_services_tcp",
+	"net_services_udp",
+}
+
+type CacheStats struct {
+	Name string
+	Size uint64
+	Count uint64
+	MaxProbe uint64
+	Hits uint64
+	Misses uint64
+	Evictions uint64
+	Bytes uint64
+}
+func (this *CacheStats) String() string {
+	return fmt.Sprintf("%s: %v/%v used, max probe %v, %v hits, %v misses, %v evictions, %v bytes",
+		this.Name, this.Count, this.Size, this.MaxProbe,
+		this.Hits, this.Misses, this.Evictions, this.Bytes)
+}
+
+func GetCacheStats(name string) (result *CacheStats, err error) {
+	defer util.Panic2Error(&err)
+	var sigar *C.sigar_t=GetSigarHandle()
+	var stats C.sigar_cache_stats_t
+
+	c_name := C.CString(name)
+	status := int(C.sigar_cache_stats_get(sigar, c_name, &stats))
+	C.free(unsafe.Pointer(c_name))
+	if status != SIGAR_OK {
+		return nil,fmt.Errorf("Failed to rertieve cache stats for %v with error: %v", name, status)
+	}
+
+	return &CacheStats{
+		Name : name,
+		Size : uint64(stats.size),
+		Count : uint64(stats.count),
+		MaxProbe : uint64(stats.max_probe),
+		Hits : uint64(stats.hits),
+		Misses : uint64(stats.misses),
+		Evictions : uint64(stats.evictions),
+		Bytes : uint64(stats.bytes),
+	},nil
+}
+
+func GetCacheStatsList() (result []*CacheStats, err error) {
+	for _,name := range CacheNames {
+		stats, err := GetCacheStats(name)
+		if err != nil {
+			return nil,err
+		}
+		result = append(result, stats)
+	}
+	return result,nil
+}
@@ -7,15 +7,17 @@ import (
 	"fmt"
 	"time"
 	"strconv"
+	"sync"
 )
 
 
 //#include "../../../../../Include/sigar.h"
 //#include "../../../../../Include/sigar_format.h"
+//#include "../../../../../Include/sigar_sampler.h"
 import "C" 
 
-var _prevCpuUsage C.sigar_cpu_t //usged for percentage calculation 
-var prevSampleTs int64
+var _cpuSampler *C.sigar_cpu_sampler_t //keeps the previous sample for percentage calculation 
+var _cpuSamplerLock sync.Mutex //guards _cpuSampler, it is created and updated in place
     
 type CpuUsageInfo struct { 
 	User uint64
@@ -56,26 +58,25 @@ func GetCpuPctUsageInfo() (result *CpuPctUsageInfo, err error) {
 	defer util.Panic2Error(&err)
 	
 	sigar := GetSigarHandle()
-	cur_c_cpu_t, err := _getCpu(sigar) 
-	if err != nil { 
-		return nil,err 
+	_cpuSamplerLock.Lock()
+	defer _cpuSamplerLock.Unlock()
+	if _cpuSampler == nil { 
+		if status := int(C.sigar_cpu_sampler_create(&_cpuSampler, C.SIGAR_SAMPLER_CPU, 2)) ; status != SIGAR_OK { 
+			return nil,fmt.Errorf("Failed to create cpu sampler with error: %v", status)
+		}
 	}
 
-	if prevSampleTs == 0 { 
-		
-		_prevCpuUsage = *cur_c_cpu_t
-		time.Sleep(500*time.Millisecond) 
-		
-		cur_c_cpu_t, err = _getCpu(sigar) 
-		if err != nil { 
-			return nil,err 
+	var c_pct_cpu_t C.sigar_cpu_perc_t
+	for i := 0; ; i++ { 
+		if status := int(C.sigar_cpu_sampler_update(sigar, _cpuSampler)) ; status != SIGAR_OK { 
+			return nil,fmt.Errorf("Failed to retrieve cpu usage info with error: %v", status)
+		}
+		if int(C.sigar_cpu_sampler_perc_get(_cpuSampler, 0, &c_pct_cpu_t, nil)) == SIGAR_OK || i > 0 { 
+			break
 		}
+		//first sample, nothing to compare with yet
+		time.Sleep(500*time.Millisecond) 
 	}
-	
-	var c_pct_cpu_t C.sigar_cpu_perc_t
-	C.sigar_cpu_perc_calculate(&_prevCpuUsage, cur_c_cpu_t, &c_pct_cpu_t) 
-	_prevCpuUsage = *cur_c_cpu_t
-	prevSampleTs = util.NowEpoch()
 		
 	return &CpuPctUsageInfo{ 
 		User : float64(c_pct_cpu_t.user), 
@@ -0,0 +1,73 @@
+// shared by the cgo preambles of batch.go and sampler.go, which
+// cannot see each other's static helpers
+
+#ifndef GOTOC_ROWS_H
+#define GOTOC_ROWS_H
+
+#include <string.h>
+
+// rows are laid out with 8 byte fields only, so ProcRow in
+// batch.go has the same layout and Go slices can be filled in place
+typedef struct {
+	sigar_int64_t pid;
+	sigar_int64_t flags;
+	sigar_int64_t state;
+	sigar_int64_t ppid;
+	sigar_int64_t tty;
+	sigar_int64_t priority;
+	sigar_int64_t nice;
+	sigar_int64_t processor;
+	sigar_uint64_t threads;
+	sigar_uint64_t mem_size;
+	sigar_uint64_t mem_resident;
+	sigar_uint64_t mem_share;
+	sigar_uint64_t mem_minor_faults;
+	sigar_uint64_t mem_major_faults;
+	sigar_uint64_t mem_page_faults;
+	sigar_uint64_t start_time;
+	sigar_uint64_t user;
+	sigar_uint64_t sys;
+	sigar_uint64_t total;
+	sigar_uint64_t last_time;
+	double percent;
+	char name[SIGAR_PROC_NAME_LEN];
+} gotoc_proc_row_t;
+
+// copies up to max rows, returns the process count so the caller can grow
+static int gotoc_proc_rows_copy(sigar_proc_snapshot_t *snapshot,
+                                gotoc_proc_row_t *rows, int max)
+{
+	unsigned long i;
+
+	for (i=0; i<snapshot->number && (int)i<max; i++) {
+		sigar_proc_snapshot_entry_t *entry = &snapshot->data[i];
+		gotoc_proc_row_t *row = &rows[i];
+
+		row->pid = entry->pid;
+		row->flags = entry->flags;
+		row->state = entry->state.state;
+		row->ppid = entry->state.ppid;
+		row->tty = entry->state.tty;
+		row->priority = entry->state.priority;
+		row->nice = entry->state.nice;
+		row->processor = entry->state.processor;
+		row->threads = entry->state.threads;
+		row->mem_size = entry->mem.size;
+		row->mem_resident = entry->mem.resident;
+		row->mem_share = entry->mem.share;
+		row->mem_minor_faults = entry->mem.minor_faults;
+		row->mem_major_faults = entry->mem.major_faults;
+		row->mem_page_faults = entry->mem.page_faults;
+		row->start_time = entry->cpu.start_time;
+		row->user = entry->cpu.user;
+		row->sys = entry->cpu.sys;
+		row->total = entry->cpu.total;
+		row->last_time = entry->cpu.last_time;
+		row->percent = entry->cpu.percent;
+		memcpy(row->name, entry->state.name, sizeof(row->name));
+	}
+
+	return (int)snapshot->number;
+}
+
+#endif
@@ -4,6 +4,7 @@ import (
 
 	"fmt"
 	"reflect"
+	"sync"
 	"unsafe"
 
 )
@@ -15,16 +16,24 @@ import (
 import "C"
 
 var sigar *C.sigar_t=nil
+var sigarLock sync.Mutex
+
+//the shared handle is opened once, callers on several goroutines
+//should use a HandlePool instead as a sigar_t is not thread-safe
 func GetSigarHandle()*C.sigar_t{
 
+	sigarLock.Lock()
+	defer sigarLock.Unlock()
+
 	if(sigar!=nil){
 		return sigar
 	}
-	sigar=new (C.sigar_t)
-	ret:=C.sigar_open(&sigar)
+	var handle *C.sigar_t
+	ret:=C.sigar_open(&handle)
 	if(ret!=C.SIGAR_OK){
 		return nil
 	}
+	sigar=handle
 	return sigar
 
 }
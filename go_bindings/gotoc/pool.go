@@ -0,0 +1,116 @@
+package gotoc
+
+import (
+	"fmt"
+	"sync"
+)
+
+/*
+#include "../../../../../Include/sigar.h"
+*/
+import "C"
+
+//HandlePool hands out sigar_t handles to one goroutine at a time.
+//Handles are opened on first use, up to size, and kept open, so the
+//per-handle caches (proc times, cpu samples) survive between polls.
+type HandlePool struct {
+	handles chan *C.sigar_t
+	lock sync.Mutex
+	open int
+	size int
+	closed bool
+}
+
+func NewHandlePool(size int) *HandlePool {
+	if size < 1 {
+		size = 1
+	}
+	return &HandlePool{
+		handles : make(chan *C.sigar_t, size),
+		size : size,
+	}
+}
+
+var defaultPool *HandlePool
+var defaultPoolOnce sync.Once
+
+//DefaultHandlePool is shared by the batched getters in this package
+func DefaultHandlePool() *HandlePool {
+	defaultPoolOnce.Do(func() {
+		defaultPool = NewHandlePool(4)
+	})
+	return defaultPool
+}
+
+//Get blocks until a handle is free, or opens a new one below size
+func (this *HandlePool) Get() (*C.sigar_t, error) {
+	select {
+	case handle, ok := <-this.handles:
+		if !ok {
+			return nil, fmt.Errorf("sigar handle pool is closed")
+		}
+		return handle, nil
+	default:
+	}
+
+	this.lock.Lock()
+	if this.closed {
+		this.lock.Unlock()
+		return nil, fmt.Errorf("sigar handle pool is closed")
+	}
+	if this.open < this.size {
+		this.open = this.open+1
+		this.lock.Unlock()
+		var handle *C.sigar_t
+		if status := int(C.sigar_open(&handle)) ; status != SIGAR_OK {
+			this.lock.Lock()
+			this.open = this.open-1
+			this.lock.Unlock()
+			return nil, fmt.Errorf("Failed to open sigar handle with error: %v", status)
+		}
+		return handle, nil
+	}
+	this.lock.Unlock()
+
+	handle := <-this.handles
+	if handle == nil {
+		return nil, fmt.Errorf("sigar handle pool is closed")
+	}
+	return handle, nil
+}
+
+func (this *HandlePool) Put(handle *C.sigar_t) {
+	this.lock.Lock()
+	defer this.lock.Unlock()
+	if this.closed {
+		C.sigar_close(handle)
+		return
+	}
+	//never blocks, at most size handles are open
+	this.handles <- handle
+}
+
+//With runs fn with a handle held exclusively for its duration
+func (this *HandlePool) With(fn func(sigar *C.sigar_t) error) error {
+	handle, err := this.Get()
+	if err != nil {
+		return err
+	}
+	defer this.Put(handle)
+	return fn(handle)
+}
+
+//Close closes the idle handles, handles still in use are closed by Put
+func (this *HandlePool) Close() {
+	this.lock.Lock()
+	if this.closed {
+		this.lock.Unlock()
+		return
+	}
+	this.closed = true
+	close(this.handles)
+	this.lock.Unlock()
+	for handle := range this.handles {
+		C.sigar_close(handle)
+	}
+}
@@ -0,0 +1,357 @@
+package gotoc
+
+import (
+	"fmt"
+	"sync"
+	"sync/atomic"
+	"time"
+	"unsafe"
+)
+
+/*
+#include <errno.h>
+#include "../../../../../Include/sigar.h"
+#include "../../../../../Include/sigar_sampler.h"
+#include "gotoc_rows.h"
+
+// same fields as CpuUsageInfo, so CpuList is filled in place
+typedef struct {
+	sigar_uint64_t user;
+	sigar_uint64_t sys;
+	sigar_uint64_t nice;
+	sigar_uint64_t idle;
+	sigar_uint64_t wait;
+	sigar_uint64_t irq;
+	sigar_uint64_t soft_irq;
+	sigar_uint64_t stolen;
+	sigar_uint64_t total;
+} gotoc_cpu_row_t;
+
+typedef struct {
+	sigar_uint64_t generation;
+	sigar_int64_t timestamp;
+	int flags;
+	int cpus;  // in the round, more than were copied if the rows were short
+	int procs;
+	gotoc_cpu_row_t cpu;
+	sigar_mem_t mem;
+	sigar_swap_t swap;
+} gotoc_sampler_head_t;
+
+static void gotoc_cpu_row_copy(sigar_cpu_t *cpu, gotoc_cpu_row_t *row)
+{
+	row->user = cpu->user;
+	row->sys = cpu->sys;
+	row->nice = cpu->nice;
+	row->idle = cpu->idle;
+	row->wait = cpu->wait;
+	row->irq = cpu->irq;
+	row->soft_irq = cpu->soft_irq;
+	row->stolen = cpu->stolen;
+	row->total = cpu->total;
+}
+
+// the latest round in one crossing, held only while it is copied
+static int gotoc_sampler_decode(sigar_sampler_t *sampler,
+                                gotoc_sampler_head_t *head,
+                                gotoc_cpu_row_t *cpus, int cpus_max,
+                                gotoc_proc_row_t *procs, int procs_max)
+{
+	sigar_sampler_snapshot_t *snapshot = sigar_sampler_snapshot_acquire(sampler);
+	unsigned long i;
+
+	if (!snapshot) {
+		return ENOENT;
+	}
+
+	head->generation = snapshot->generation;
+	head->timestamp = snapshot->timestamp;
+	head->flags = snapshot->flags;
+	head->cpus = head->procs = 0;
+
+	if (snapshot->flags & SIGAR_SAMPLER_CPU) {
+		gotoc_cpu_row_copy(&snapshot->cpu, &head->cpu);
+	}
+	if (snapshot->flags & SIGAR_SAMPLER_CPU_LIST) {
+		head->cpus = (int)snapshot->cpulist.number;
+		for (i=0; i<snapshot->cpulist.number && (int)i<cpus_max; i++) {
+			gotoc_cpu_row_copy(&snapshot->cpulist.data[i], &cpus[i]);
+		}
+	}
+	if (snapshot->flags & SIGAR_SAMPLER_MEM) {
+		head->mem = snapshot->mem;
+	}
+	if (snapshot->flags & SIGAR_SAMPLER_SWAP) {
+		head->swap = snapshot->swap;
+	}
+	if (snapshot->flags & SIGAR_SAMPLER_PROC) {
+		head->procs = gotoc_proc_rows_copy(&snapshot->procs, procs, procs_max);
+	}
+
+	sigar_sampler_snapshot_release(sampler, snapshot);
+
+	return SIGAR_OK;
+}
+*/
+import "C"
+
+const (
+	SAMPLER_CPU = C.SIGAR_SAMPLER_CPU
+	SAMPLER_CPU_LIST = C.SIGAR_SAMPLER_CPU_LIST
+	SAMPLER_MEM = C.SIGAR_SAMPLER_MEM
+	SAMPLER_SWAP = C.SIGAR_SAMPLER_SWAP
+	SAMPLER_PROC = C.SIGAR_SAMPLER_PROC
+	//what Snapshot has fields for
+	SAMPLER_METRICS = SAMPLER_CPU | SAMPLER_CPU_LIST | SAMPLER_MEM |
+		SAMPLER_SWAP | SAMPLER_PROC
+)
+
+//compile time check that CpuUsageInfo matches gotoc_cpu_row_t
+var _ [unsafe.Sizeof(CpuUsageInfo{}) - unsafe.Sizeof(C.gotoc_cpu_row_t{})]byte
+var _ [unsafe.Sizeof(C.gotoc_cpu_row_t{}) - unsafe.Sizeof(CpuUsageInfo{})]byte
+
+//Snapshot is one sampler round, decoded once and handed to every
+//subscriber as is: read it, do not modify it.  Release gives it back
+//for the decode of a later round once all of them are done with it,
+//a snapshot never released is simply left to the GC.
+type Snapshot struct {
+	Generation uint64
+	Timestamp int64 //millis, when the round started
+	Flags int //SAMPLER_* collected this round
+	Cpu CpuUsageInfo
+	CpuList []CpuUsageInfo
+	Mem Mem
+	Swap Swap
+	Procs []ProcRow
+	refs int32
+	feed *samplerFeed
+}
+
+func (this *Snapshot) Release() {
+	if atomic.AddInt32(&this.refs, -1) == 0 {
+		this.feed.pool.Put(this)
+	}
+}
+
+type samplerKey struct {
+	metrics int
+	interval time.Duration
+}
+
+//one native sampler and one collector goroutine per metrics and
+//interval, whatever the number of subscribers
+type samplerFeed struct {
+	key samplerKey
+	sampler *C.sigar_sampler_t
+	subs map[<-chan *Snapshot]chan *Snapshot
+	pool sync.Pool
+	stop chan struct{}
+	done chan struct{}
+}
+
+//samplerLock guards samplerFeeds and the subs of each feed
+var samplerLock sync.Mutex
+var samplerFeeds = make(map[samplerKey]*samplerFeed)
+
+//Subscribe delivers every round of a sampler collecting metrics, a
+//mask of SAMPLER_*, each interval.  Subscribers of the same metrics
+//and interval share the sampler thread and the decode of each round,
+//so a tick costs the same for one of them as for a thousand.  The
+//channel holds one round: a subscriber still on the previous one
+//misses the next rather than holding up the others.
+func Subscribe(metrics int, interval time.Duration) (<-chan *Snapshot, error) {
+	if metrics == 0 || (metrics & ^SAMPLER_METRICS) != 0 {
+		return nil, fmt.Errorf("Unsupported sampler metrics: %#x", metrics)
+	}
+	if interval < time.Millisecond {
+		return nil, fmt.Errorf("Sampler interval too short: %v", interval)
+	}
+
+	samplerLock.Lock()
+	defer samplerLock.Unlock()
+
+	key := samplerKey{ metrics : metrics, interval : interval }
+	feed := samplerFeeds[key]
+	if feed == nil {
+		var err error
+		if feed, err = newSamplerFeed(key); err != nil {
+			return nil, err
+		}
+		samplerFeeds[key] = feed
+	}
+
+	ch := make(chan *Snapshot, 1)
+	feed.subs[ch] = ch
+	return ch, nil
+}
+
+//Unsubscribe closes ch, the last subscriber of a sampler stops it
+func Unsubscribe(ch <-chan *Snapshot) {
+	samplerLock.Lock()
+	var feed *samplerFeed
+	for _, f := range samplerFeeds {
+		if sub, ok := f.subs[ch] ; ok {
+			delete(f.subs, ch)
+			close(sub)
+			feed = f
+			break
+		}
+	}
+	if feed == nil || len(feed.subs) > 0 {
+		samplerLock.Unlock()
+		return
+	}
+	delete(samplerFeeds, feed.key)
+	samplerLock.Unlock()
+
+	close(feed.stop)
+	<-feed.done
+	C.sigar_sampler_destroy(feed.sampler)
+}
+
+func newSamplerFeed(key samplerKey) (*samplerFeed, error) {
+	var sampler *C.sigar_sampler_t
+	millis := C.sigar_uint64_t(key.interval / time.Millisecond)
+
+	if status := int(C.sigar_sampler_create(&sampler, C.int(key.metrics), millis)) ; status != SIGAR_OK {
+		return nil, fmt.Errorf("Failed to create sampler with error: %v", status)
+	}
+	if status := int(C.sigar_sampler_start(sampler)) ; status != SIGAR_OK {
+		C.sigar_sampler_destroy(sampler)
+		return nil, fmt.Errorf("Failed to start sampler with error: %v", status)
+	}
+
+	feed := &samplerFeed{
+		key : key,
+		sampler : sampler,
+		subs : make(map[<-chan *Snapshot]chan *Snapshot),
+		stop : make(chan struct{}),
+		done : make(chan struct{}),
+	}
+	go feed.run()
+	return feed, nil
+}
+
+func (this *samplerFeed) run() {
+	defer close(this.done)
+
+	var generation uint64
+	//bounds how long Unsubscribe waits for the goroutine to notice,
+	//clamped before the conversion so long intervals cannot overflow
+	timeout := 2 * this.key.interval
+	if timeout > time.Second {
+		timeout = time.Second
+	}
+	wait := C.int(timeout / time.Millisecond)
+
+	for {
+		select {
+		case <-this.stop:
+			return
+		default:
+		}
+
+		status := int(C.sigar_sampler_wait(this.sampler, C.sigar_uint64_t(generation), wait))
+		if status == C.ETIMEDOUT {
+			continue
+		}
+		if status != SIGAR_OK {
+			time.Sleep(this.key.interval)
+			continue
+		}
+
+		snapshot, err := this.decode()
+		if err != nil {
+			continue
+		}
+		generation = snapshot.Generation
+		this.publish(snapshot)
+	}
+}
+
+//decode fills a pooled Snapshot, reusing the capacity of its slices
+func (this *samplerFeed) decode() (*Snapshot, error) {
+	snapshot, _ := this.pool.Get().(*Snapshot)
+	if snapshot == nil {
+		snapshot = &Snapshot{ feed : this }
+	}
+
+	var head C.gotoc_sampler_head_t
+	for {
+		cpus := snapshot.CpuList[:cap(snapshot.CpuList)]
+		procs := snapshot.Procs[:cap(snapshot.Procs)]
+		var cpuPtr *C.gotoc_cpu_row_t
+		var procPtr *C.gotoc_proc_row_t
+		if len(cpus) > 0 {
+			cpuPtr = (*C.gotoc_cpu_row_t)(unsafe.Pointer(&cpus[0]))
+		}
+		if len(procs) > 0 {
+			procPtr = (*C.gotoc_proc_row_t)(unsafe.Pointer(&procs[0]))
+		}
+
+		status := int(C.gotoc_sampler_decode(this.sampler, &head,
+			cpuPtr, C.int(len(cpus)), procPtr, C.int(len(procs))))
+		if status != SIGAR_OK {
+			this.pool.Put(snapshot)
+			return nil, fmt.Errorf("Failed to decode sampler snapshot with error: %v", status)
+		}
+
+		number := int(head.procs)
+		if int(head.cpus) <= len(cpus) && number <= len(procs) {
+			snapshot.CpuList = cpus[:head.cpus]
+			snapshot.Procs = procs[:number]
+			break
+		}
+		//decoded again, by then maybe from a newer round
+		if int(head.cpus) > len(cpus) {
+			snapshot.CpuList = make([]CpuUsageInfo, int(head.cpus))
+		}
+		if number > len(procs) {
+			snapshot.Procs = make([]ProcRow, number+number/8)
+		}
+	}
+
+	snapshot.Generation = uint64(head.generation)
+	snapshot.Timestamp = int64(head.timestamp)
+	snapshot.Flags = int(head.flags)
+	snapshot.Cpu = *(*CpuUsageInfo)(unsafe.Pointer(&head.cpu))
+
+	mem := &head.mem
+	snapshot.Mem = Mem{
+		Ram : uint64(mem.ram),
+		Total : uint64(mem.total),
+		Used : uint64(mem.used),
+		Free : uint64(mem.free),
+		ActualUsed : uint64(mem.actual_used),
+		ActualFree : uint64(mem.actual_free),
+		UsedPerecent : float64(mem.used_percent),
+		FreePerecent : float64(mem.free_percent),
+	}
+
+	swap := &head.swap
+	snapshot.Swap = Swap{
+		Total : uint64(swap.total),
+		Used : uint64(swap.used),
+		Free : uint64(swap.free),
+		PageIn : uint64(swap.page_in),
+		PageOut : uint64(swap.page_out),
+	}
+
+	return snapshot, nil
+}
+
+//publish holds a reference of its own until every subscriber has had
+//the chance to take theirs
+func (this *samplerFeed) publish(snapshot *Snapshot) {
+	samplerLock.Lock()
+	atomic.StoreInt32(&snapshot.refs, int32(len(this.subs))+1)
+	for _, sub := range this.subs {
+		select {
+		case sub <- snapshot:
+		default:
+			atomic.AddInt32(&snapshot.refs, -1)
+		}
+	}
+	samplerLock.Unlock()
+	snapshot.Release()
+}
@@ -125,8 +125,65 @@ typedef struct sigar_t sigar_t;
 
 SIGAR_DECLARE(int) sigar_open(sigar_t **sigar);
 
+/*
+ * sigar_open probes what the platform supports on first use of each
+ * subsystem.  sigar_open_ex does it up front for the subsystems in
+ * flags, moving that cost out of the first sample.
+ */
+#define SIGAR_OPEN_PROC 0x01
+#define SIGAR_OPEN_DISK 0x02
+#define SIGAR_OPEN_NET  0x04
+#define SIGAR_OPEN_ALL  (SIGAR_OPEN_PROC|SIGAR_OPEN_DISK|SIGAR_OPEN_NET)
+
+SIGAR_DECLARE(int) sigar_open_ex(sigar_t **sigar, int flags);
+
 SIGAR_DECLARE(int) sigar_close(sigar_t *sigar);
 
+/*
+ * which implementation each subsystem with a choice of them resolved
+ * to on this handle, probing those not used yet.  "none" where the
+ * host has nothing to read, NULL where the platform has no choice.
+ */
+typedef struct {
+    const char *disk_io;   /* diskstats, sysfs, partitions; perflib */
+    const char *net_conn;  /* sock_diag, procfs, mirror; iphlpapi_owner, iphlpapi */
+    const char *net_iface; /* rtnetlink, ioctl */
+    const char *proc_list; /* ntquery, perflib */
+    const char *proc_time; /* taskstats, procfs */
+    const char *proc_read; /* io_uring, pread */
+} sigar_capabilities_t;
+
+SIGAR_DECLARE(int) sigar_capabilities_get(sigar_t *sigar,
+                                          sigar_capabilities_t *caps);
+
+/*
+ * a sigar_t keeps its caches and scratch buffers unlocked and must
+ * only be used by one thread at a time.  worker pools share a handle
+ * pool instead: each get hands out an idle handle, preferring the one
+ * the calling thread returned last so its caches stay warm, and opens
+ * a new one while fewer than max are in use, otherwise waits for a put.
+ */
+typedef struct sigar_handle_pool_t sigar_handle_pool_t;
+
+SIGAR_DECLARE(int) sigar_handle_pool_create(sigar_handle_pool_t **pool,
+                                            int max);
+
+/* every handle must have been put back */
+SIGAR_DECLARE(int) sigar_handle_pool_destroy(sigar_handle_pool_t *pool);
+
+SIGAR_DECLARE(int) sigar_handle_pool_get(sigar_handle_pool_t *pool,
+                                         sigar_t **sigar);
+
+SIGAR_DECLARE(void) sigar_handle_pool_put(sigar_handle_pool_t *pool,
+                                          sigar_t *sigar);
+
+/*
+ * split sigar_proc_snapshot_get and sigar_ptql_query_find across this
+ * many threads, each parsing with a handle of its own.  0 or 1 scans
+ * on the calling thread, which is the default.
+ */
+SIGAR_DECLARE(int) sigar_proc_scan_threads_set(sigar_t *sigar, int threads);
+
 SIGAR_DECLARE(sigar_pid_t) sigar_pid_get(sigar_t *sigar);
 
 SIGAR_DECLARE(int) sigar_proc_kill(sigar_pid_t pid, int signum);
@@ -162,6 +219,39 @@ typedef struct {
 
 SIGAR_DECLARE(int) sigar_swap_get(sigar_t *sigar, sigar_swap_t *swap);
 
+/* everything the kernel says about memory, in bytes unless noted */
+typedef struct {
+    sigar_uint64_t
+        total,
+        free,
+        available, /* estimate of what can be had without swapping */
+        buffers,
+        cached,
+        swap_cached,
+        active,
+        inactive,
+        shmem,
+        slab,
+        slab_reclaimable,
+        slab_unreclaimable,
+        dirty,
+        writeback,
+        anon_pages,
+        mapped,
+        page_tables,
+        commit_limit,
+        committed_as,
+        swap_total,
+        swap_free,
+        huge_pages_total, /* pages */
+        huge_pages_free,  /* pages */
+        huge_pages_rsvd,  /* pages */
+        huge_pages_surp,  /* pages */
+        huge_page_size;
+} sigar_mem_ext_t;
+
+SIGAR_DECLARE(int) sigar_mem_ext_get(sigar_t *sigar, sigar_mem_ext_t *memext);
+
 typedef struct {
     sigar_uint64_t
         user, 
@@ -188,6 +278,57 @@ SIGAR_DECLARE(int) sigar_cpu_list_get(sigar_t *sigar, sigar_cpu_list_t *cpulist)
 SIGAR_DECLARE(int) sigar_cpu_list_destroy(sigar_t *sigar,
                                           sigar_cpu_list_t *cpulist);
 
+/* one consistent read of the kernel's system wide counters */
+typedef struct {
+    sigar_cpu_t cpu;
+    sigar_cpu_list_t cpulist; /* per logical cpu, never rolled up */
+    sigar_uint64_t
+        ctxt,
+        intr,
+        soft_irq,
+        processes,
+        procs_running,
+        procs_blocked,
+        boot_time;
+} sigar_system_stat_t;
+
+SIGAR_DECLARE(int) sigar_system_stat_get(sigar_t *sigar,
+                                         sigar_system_stat_t *systemstat);
+
+SIGAR_DECLARE(int) sigar_system_stat_destroy(sigar_t *sigar,
+                                             sigar_system_stat_t *systemstat);
+
+/* a row of /proc/interrupts or /proc/softirqs */
+typedef struct {
+    char name[16];        /* "24", "NMI", "LOC", "NET_RX" */
+    char description[64]; /* "IR-PCI-MSI 524288-edge eth0-TxRx-0", or "" */
+    sigar_uint64_t total; /* over every cpu */
+} sigar_interrupt_t;
+
+/*
+ * ncpu columns per row, the count of row i on column j is
+ * counts[i * ncpu + j] and cpus[j] is that column's cpu number.  rows
+ * with one system wide count (ERR, MIS) have it in total only.
+ */
+typedef struct {
+    unsigned long number;
+    unsigned long size;
+    sigar_interrupt_t *data;
+    unsigned long ncpu;
+    int *cpus;
+    sigar_uint64_t *counts;
+} sigar_interrupt_list_t;
+
+SIGAR_DECLARE(int) sigar_interrupts_get(sigar_t *sigar,
+                                        sigar_interrupt_list_t *interrupts);
+
+SIGAR_DECLARE(int) sigar_softirqs_get(sigar_t *sigar,
+                                      sigar_interrupt_list_t *softirqs);
+
+SIGAR_DECLARE(int)
+sigar_interrupt_list_destroy(sigar_t *sigar,
+                             sigar_interrupt_list_t *interrupts);
+
 typedef struct {
     char vendor[128];
     char model[128];
@@ -214,6 +355,58 @@ SIGAR_DECLARE(int)
 sigar_cpu_info_list_destroy(sigar_t *sigar,
                             sigar_cpu_info_list_t *cpu_infos);
 
+typedef struct {
+    int cpu;    /* logical cpu number */
+    int node;   /* numa node, 0 when the kernel has none */
+    int socket; /* physical package */
+    int core;   /* core within the socket */
+    int thread; /* smt sibling within the core, 0 for the first */
+} sigar_cpu_topology_t;
+
+typedef struct {
+    unsigned long number;
+    unsigned long size;
+    sigar_cpu_topology_t *data; /* online cpus, by cpu number */
+} sigar_numa_topology_t;
+
+SIGAR_DECLARE(int)
+sigar_numa_topology_get(sigar_t *sigar,
+                        sigar_numa_topology_t *topology);
+
+SIGAR_DECLARE(int)
+sigar_numa_topology_destroy(sigar_t *sigar,
+                            sigar_numa_topology_t *topology);
+
+typedef struct {
+    int node;
+    sigar_uint64_t
+        total,
+        used,
+        free;
+} sigar_numa_mem_t;
+
+typedef struct {
+    unsigned long number;
+    unsigned long size;
+    sigar_numa_mem_t *data; /* online nodes, by node number */
+} sigar_numa_mem_list_t;
+
+SIGAR_DECLARE(int)
+sigar_numa_mem_list_get(sigar_t *sigar,
+                        sigar_numa_mem_list_t *memlist);
+
+SIGAR_DECLARE(int)
+sigar_numa_mem_list_destroy(sigar_t *sigar,
+                            sigar_numa_mem_list_t *memlist);
+
+/*
+ * cpu times summed per numa node, data[n] is node n; a node
+ * without online cpus is all zero. free with sigar_cpu_list_destroy.
+ */
+SIGAR_DECLARE(int)
+sigar_numa_cpu_list_get(sigar_t *sigar,
+                        sigar_cpu_list_t *cpulist);
+
 typedef struct {
     double uptime;
 } sigar_uptime_t;
@@ -228,6 +421,33 @@ typedef struct {
 SIGAR_DECLARE(int) sigar_loadavg_get(sigar_t *sigar,
                                      sigar_loadavg_t *loadavg);
 
+/*
+ * pressure stall information, linux 4.20+: the share of time some
+ * (or, for full, all) non-idle tasks were stalled on a resource.
+ * avgs are percents over the last 10, 60 and 300 seconds, total the
+ * microseconds stalled since boot.  fields the kernel does not have,
+ * e.g. cpu full before 5.13, are SIGAR_FIELD_NOTIMPL.
+ */
+typedef struct {
+    double avg10, avg60, avg300;
+    sigar_uint64_t total;
+} sigar_pressure_stall_t;
+
+typedef struct {
+    sigar_pressure_stall_t some;
+    sigar_pressure_stall_t full;
+} sigar_pressure_resource_t;
+
+typedef struct {
+    sigar_pressure_resource_t cpu;
+    sigar_pressure_resource_t memory;
+    sigar_pressure_resource_t io;
+} sigar_pressure_t;
+
+/* SIGAR_ENOTIMPL without psi, e.g. booted with psi=0 */
+SIGAR_DECLARE(int) sigar_pressure_get(sigar_t *sigar,
+                                      sigar_pressure_t *pressure);
+
 typedef struct {
     unsigned long number;
     unsigned long size;
@@ -266,6 +486,73 @@ SIGAR_DECLARE(int) sigar_proc_list_get(sigar_t *sigar,
 SIGAR_DECLARE(int) sigar_proc_list_destroy(sigar_t *sigar,
                                            sigar_proc_list_t *proclist);
 
+/*
+ * pids one at a time, read from the os as they are asked for where
+ * the backend can (/proc on linux) instead of a sigar_proc_list_t.
+ * next returns ENOENT once every pid has been returned.
+ */
+typedef struct sigar_proc_iter_t sigar_proc_iter_t;
+
+SIGAR_DECLARE(int) sigar_proc_iter_open(sigar_t *sigar,
+                                        sigar_proc_iter_t **iter);
+
+SIGAR_DECLARE(int) sigar_proc_iter_next(sigar_proc_iter_t *iter,
+                                        sigar_pid_t *pid);
+
+SIGAR_DECLARE(int) sigar_proc_iter_close(sigar_proc_iter_t *iter);
+
+/** A new process, ppid is its parent */
+#define SIGAR_PROC_EVENT_FORK     0x01
+/** The process is running a new program */
+#define SIGAR_PROC_EVENT_EXEC     0x02
+/** Gone, exit_code is the wait(2) status */
+#define SIGAR_PROC_EVENT_EXIT     0x04
+/** Events were lost, pid is -1 and every process should be checked */
+#define SIGAR_PROC_EVENT_OVERFLOW 0x08
+
+typedef struct sigar_proc_events_t sigar_proc_events_t;
+
+typedef struct {
+    int type;
+    sigar_pid_t pid;   /* -1 for a fork whose child is not known */
+    sigar_pid_t ppid;  /* -1 unless FORK */
+    int exit_code;
+} sigar_proc_event_t;
+
+typedef struct {
+    unsigned long number;
+    unsigned long size;
+    sigar_proc_event_t *data;
+} sigar_proc_event_list_t;
+
+/*
+ * fork, exec and exit of every process: the netlink proc connector on
+ * linux, which needs CAP_NET_ADMIN, kqueue EVFILT_PROC on darwin and
+ * the bsds, the kernel trace of sigar_proc_etw_set on win32 (a start
+ * is a fork and an exec), SIGAR_ENOTIMPL elsewhere.  one per sigar_t;
+ * while it is open sigar_proc_list_get is kept up from the events
+ * instead of a scan, exited pids leave the proc_cpu and proc_io caches
+ * and cached ptql results are matched again after an exec.
+ * sigar_close destroys one that is still open.  like the rest of
+ * sigar_t, not to be used from two threads at once.
+ */
+SIGAR_DECLARE(int) sigar_proc_events_create(sigar_t *sigar,
+                                            sigar_proc_events_t **events);
+
+SIGAR_DECLARE(int) sigar_proc_events_destroy(sigar_proc_events_t *events);
+
+/*
+ * waits up to timeout milliseconds, -1 for no limit, and returns the
+ * events since the last wait in the order they happened, including
+ * those taken in by sigar_proc_list_get.  no events is a timeout.
+ */
+SIGAR_DECLARE(int)
+sigar_proc_events_wait(sigar_proc_events_t *events, int timeout,
+                       sigar_proc_event_list_t *list);
+
+SIGAR_DECLARE(int)
+sigar_proc_event_list_destroy(sigar_proc_event_list_t *list);
+
 typedef struct {
     sigar_uint64_t total;
     sigar_uint64_t sleeping;
@@ -279,6 +566,15 @@ typedef struct {
 SIGAR_DECLARE(int) sigar_proc_stat_get(sigar_t *sigar,
                                        sigar_proc_stat_t *procstat);
 
+/*
+ * by default sigar_proc_stat_get uses counters the kernel keeps where
+ * it has them: on linux running and idle are the runnable and blocked
+ * tasks of /proc/stat and threads comes from /proc/loadavg, fields
+ * without a counter are SIGAR_FIELD_NOTIMPL.  enable to read the state
+ * of every process instead.
+ */
+SIGAR_DECLARE(int) sigar_proc_stat_census_set(sigar_t *sigar, int enable);
+
 typedef struct {
     sigar_uint64_t
         size,
@@ -292,6 +588,40 @@ typedef struct {
 SIGAR_DECLARE(int) sigar_proc_mem_get(sigar_t *sigar, sigar_pid_t pid,
                                       sigar_proc_mem_t *procmem);
 
+/*
+ * field masks for the *_get_ex getters and sigar_proc_snapshot_get,
+ * backends skip the reads only unmasked fields need.  fields left out
+ * of the mask may or may not be written.
+ */
+#define SIGAR_PROC_MEM_F_SIZE         0x01
+#define SIGAR_PROC_MEM_F_RESIDENT     0x02
+#define SIGAR_PROC_MEM_F_SHARE        0x04
+#define SIGAR_PROC_MEM_F_MINOR_FAULTS 0x08
+#define SIGAR_PROC_MEM_F_MAJOR_FAULTS 0x10
+#define SIGAR_PROC_MEM_F_PAGE_FAULTS  0x20
+#define SIGAR_PROC_MEM_F_ALL          0x3f
+
+SIGAR_DECLARE(int) sigar_proc_mem_get_ex(sigar_t *sigar, sigar_pid_t pid,
+                                         int fields,
+                                         sigar_proc_mem_t *procmem);
+
+/* bytes, from /proc/<pid>/smaps_rollup or a pass over smaps */
+typedef struct {
+    sigar_uint64_t
+        rss,
+        pss,      /* shared pages divided among their users */
+        uss,      /* private clean + dirty, freed when it exits */
+        shared,   /* shared clean + dirty */
+        anon,     /* anonymous part of rss */
+        file,     /* file backed part of rss */
+        swap,
+        swap_pss;
+} sigar_proc_mem_ext_t;
+
+/* linux only, SIGAR_ENOTIMPL elsewhere */
+SIGAR_DECLARE(int) sigar_proc_mem_ext_get(sigar_t *sigar, sigar_pid_t pid,
+                                          sigar_proc_mem_ext_t *procmemext);
+
 typedef struct {
      sigar_uint64_t 
         bytes_read,
@@ -325,13 +655,196 @@ typedef struct {
 SIGAR_DECLARE(int) sigar_proc_cumulative_disk_io_get(sigar_t *sigar, sigar_pid_t pid,
                                           sigar_proc_cumulative_disk_io_t *proc_cumulative_disk_io);
 
+/*
+ * bytes moved by the tcp sockets pid has open, from the tcp_info of a
+ * NETLINK_SOCK_DIAG dump (linux 4.2+).  connections already closed are
+ * not counted so the totals can go down, and a socket shared after a
+ * fork counts for every holder.  on win32 the tcp bytes the kernel
+ * trace of sigar_proc_etw_set saw pid move since it started, with
+ * sockets SIGAR_FIELD_NOTIMPL.  SIGAR_ENOTIMPL elsewhere.
+ */
+typedef struct {
+    sigar_uint64_t
+        bytes_sent,     /* acked by the peer */
+        bytes_received,
+        bytes_total,
+        sockets;
+} sigar_proc_net_io_t;
+
+SIGAR_DECLARE(int) sigar_proc_net_io_get(sigar_t *sigar, sigar_pid_t pid,
+                                         sigar_proc_net_io_t *procnetio);
+
 
 typedef struct  { 
-    sigar_uint64_t dummy;
+    sigar_uint64_t
+        proc_cpu_count,
+        proc_cpu_evictions,
+        proc_io_count,
+        proc_io_evictions;
 }sigar_dump_pid_cache_t;
 
 SIGAR_DECLARE(int) sigar_dump_pid_cache_get(sigar_t *sigar, sigar_dump_pid_cache_t *info);
 
+/*
+ * keep the /proc/<pid>/ files of a frequently polled process open
+ * and re-read them in place; linux and solaris only, SIGAR_ENOTIMPL
+ * elsewhere.
+ */
+SIGAR_DECLARE(int) sigar_proc_pin(sigar_t *sigar, sigar_pid_t pid);
+
+SIGAR_DECLARE(int) sigar_proc_unpin(sigar_t *sigar, sigar_pid_t pid);
+
+/*
+ * a process held by more than its pid: a pidfd on linux, an
+ * EVFILT_PROC kqueue on darwin, a process HANDLE on win32.  the
+ * waitable is readable (signaled) once it exits, add it to an epoll,
+ * kqueue or WaitForMultipleObjects set to watch many without polling.
+ * on linux the handle also pins the process, opened after the pidfd:
+ * the pid getters of sigar_proc_handle_pid_get read its files until
+ * it exits, then ESRCH instead of whatever has the pid next.
+ * SIGAR_ENOTIMPL elsewhere or before linux 5.3.
+ */
+typedef struct sigar_proc_handle_t sigar_proc_handle_t;
+
+#ifdef WIN32
+typedef void *sigar_proc_waitable_t;
+#else
+typedef int sigar_proc_waitable_t;
+#endif
+
+SIGAR_DECLARE(int) sigar_proc_handle_open(sigar_t *sigar, sigar_pid_t pid,
+                                          sigar_proc_handle_t **handle);
+
+SIGAR_DECLARE(int) sigar_proc_handle_close(sigar_t *sigar,
+                                           sigar_proc_handle_t *handle);
+
+SIGAR_DECLARE(sigar_pid_t)
+sigar_proc_handle_pid_get(sigar_proc_handle_t *handle);
+
+SIGAR_DECLARE(sigar_proc_waitable_t)
+sigar_proc_handle_waitable_get(sigar_proc_handle_t *handle);
+
+/* SIGAR_OK once exited, ETIMEDOUT after timeout millis, -1 waits on */
+SIGAR_DECLARE(int) sigar_proc_handle_wait(sigar_proc_handle_t *handle,
+                                          int timeout);
+
+/* ESRCH after it exited, never a signal to a reused pid */
+SIGAR_DECLARE(int) sigar_proc_handle_kill(sigar_proc_handle_t *handle,
+                                          int signum);
+
+/*
+ * hardware counters of a process, all of its threads and those it
+ * starts later, or of a cgroup, from perf_event_open.  the counters
+ * of a thread (of a cpu for a cgroup) are one group, read at once;
+ * time_running falls behind time_enabled while the kernel has more
+ * groups than the pmu has counters.  both are summed over the groups,
+ * scale by their ratio for an estimate.  counters the cpu or vm does
+ * not have are SIGAR_FIELD_NOTIMPL.  linux only, SIGAR_ENOTIMPL
+ * elsewhere; perf_event_paranoid may make it EACCES.
+ */
+typedef struct {
+    sigar_uint64_t
+        cycles,
+        instructions,
+        cache_misses, /* last level, as the cpu counts them */
+        context_switches,
+        time_enabled, /* nanoseconds */
+        time_running;
+} sigar_proc_perf_t;
+
+/* counting starts here and goes on until closed, like a pin */
+SIGAR_DECLARE(int) sigar_proc_perf_open(sigar_t *sigar, sigar_pid_t pid);
+
+SIGAR_DECLARE(int) sigar_proc_perf_close(sigar_t *sigar, sigar_pid_t pid);
+
+/* totals since the open, ENOENT if not open */
+SIGAR_DECLARE(int) sigar_proc_perf_get(sigar_t *sigar, sigar_pid_t pid,
+                                       sigar_proc_perf_t *procperf);
+
+/* path as in sigar_cgroup_list_t, counted on every cpu */
+SIGAR_DECLARE(int) sigar_proc_perf_cgroup_open(sigar_t *sigar,
+                                               const char *path);
+
+SIGAR_DECLARE(int) sigar_proc_perf_cgroup_close(sigar_t *sigar,
+                                                const char *path);
+
+SIGAR_DECLARE(int) sigar_proc_perf_cgroup_get(sigar_t *sigar,
+                                              const char *path,
+                                              sigar_proc_perf_t *procperf);
+
+typedef struct {
+    sigar_uint64_t
+        size,
+        count,
+        max_probe,
+        hits,
+        misses,
+        evictions,
+        bytes;
+} sigar_cache_stats_t;
+
+/*
+ * name is one of proc_cpu, proc_io, fsdev, net_listen,
+ * net_services_tcp, net_services_udp, user_names or group_names.
+ * caches which have not been used yet report all zeros.
+ */
+SIGAR_DECLARE(int) sigar_cache_stats_get(sigar_t *sigar,
+                                         const char *name,
+                                         sigar_cache_stats_t *stats);
+
+/*
+ * per-getter counters of a library built with -DSIGAR_INSTRUMENT,
+ * SIGAR_ENOTIMPL otherwise.  times are in nanoseconds, the
+ * percentiles come from a log-linear histogram and are within 1/8th
+ * of the real value.  opens and reads count the files the getter
+ * went through in /proc and friends.
+ */
+typedef struct {
+    sigar_uint64_t
+        calls,
+        errors,
+        total_time,
+        max_time,
+        p50,
+        p90,
+        p99,
+        opens,
+        reads;
+} sigar_instrumentation_stats_t;
+
+typedef struct {
+    char name[32];
+    sigar_instrumentation_stats_t stats;
+} sigar_instrumentation_t;
+
+typedef struct {
+    unsigned long number;
+    unsigned long size;
+    sigar_instrumentation_t *data;
+} sigar_instrumentation_list_t;
+
+/* off by default; turning it on starts the counters from zero */
+SIGAR_DECLARE(int) sigar_instrumentation_set(sigar_t *sigar, int enable);
+
+/* every instrumented getter, including the ones not called yet */
+SIGAR_DECLARE(int)
+sigar_instrumentation_get(sigar_t *sigar,
+                          sigar_instrumentation_list_t *instrumentation);
+
+SIGAR_DECLARE(int)
+sigar_instrumentation_list_destroy(sigar_t *sigar,
+                                   sigar_instrumentation_list_t *instrumentation);
+
+/* name is the getter without the sigar_ prefix, e.g. proc_state_get */
+SIGAR_DECLARE(int)
+sigar_instrumentation_stats_get(sigar_t *sigar,
+                                const char *name,
+                                sigar_instrumentation_stats_t *stats);
+
+/* how long parsed per-process data is reused, 0 to always re-read */
+SIGAR_DECLARE(int) sigar_proc_cache_expire_set(sigar_t *sigar,
+                                               sigar_uint64_t millis);
+
 
 typedef struct {
     sigar_uid_t uid;
@@ -354,6 +867,15 @@ SIGAR_DECLARE(int)
 sigar_proc_cred_name_get(sigar_t *sigar, sigar_pid_t pid,
                          sigar_proc_cred_name_t *proccredname);
 
+/* how long uid and gid names, and failed lookups, are reused.
+ * 0 to always ask the name service */
+SIGAR_DECLARE(int) sigar_cred_name_expire_set(sigar_t *sigar,
+                                              sigar_uint64_t millis);
+
+/* fill the name caches from /etc/passwd and /etc/group up front,
+ * ids served by ldap/nis are still looked up on first use */
+SIGAR_DECLARE(int) sigar_cred_name_preload(sigar_t *sigar);
+
 typedef struct {
     sigar_uint64_t
         start_time,
@@ -401,6 +923,355 @@ typedef struct {
 SIGAR_DECLARE(int) sigar_proc_state_get(sigar_t *sigar, sigar_pid_t pid,
                                         sigar_proc_state_t *procstate);
 
+#define SIGAR_PROC_STATE_F_NAME      0x01
+#define SIGAR_PROC_STATE_F_STATE     0x02
+#define SIGAR_PROC_STATE_F_PPID      0x04
+#define SIGAR_PROC_STATE_F_TTY       0x08
+#define SIGAR_PROC_STATE_F_PRIORITY  0x10
+#define SIGAR_PROC_STATE_F_NICE      0x20
+#define SIGAR_PROC_STATE_F_PROCESSOR 0x40
+#define SIGAR_PROC_STATE_F_THREADS   0x80
+#define SIGAR_PROC_STATE_F_ALL       0xff
+
+SIGAR_DECLARE(int) sigar_proc_state_get_ex(sigar_t *sigar, sigar_pid_t pid,
+                                           int fields,
+                                           sigar_proc_state_t *procstate);
+
+/*
+ * linux /proc/<pid>/schedstat summed over the threads, so totals
+ * drop by what a thread had once it exits.  nanoseconds.
+ */
+typedef struct {
+    sigar_uint64_t
+        run_time,   /* on a cpu */
+        wait_time,  /* runnable, waiting on a run queue */
+        timeslices; /* times it was switched in */
+} sigar_proc_sched_t;
+
+SIGAR_DECLARE(int) sigar_proc_sched_get(sigar_t *sigar, sigar_pid_t pid,
+                                        sigar_proc_sched_t *procsched);
+
+#define SIGAR_PROC_SNAPSHOT_STATE 0x01
+#define SIGAR_PROC_SNAPSHOT_MEM   0x02
+#define SIGAR_PROC_SNAPSHOT_TIME  0x04
+#define SIGAR_PROC_SNAPSHOT_CPU   0x08 /* implies TIME */
+
+#define SIGAR_PROC_SNAPSHOT_ALL \
+    (SIGAR_PROC_SNAPSHOT_STATE | \
+     SIGAR_PROC_SNAPSHOT_MEM   | \
+     SIGAR_PROC_SNAPSHOT_TIME  | \
+     SIGAR_PROC_SNAPSHOT_CPU)
+
+/* not in ALL, one more small read per pid */
+#define SIGAR_PROC_SNAPSHOT_CGROUP 0x10
+
+/* not in ALL, the kernel walks every mapping of each pid for it */
+#define SIGAR_PROC_SNAPSHOT_MEM_EXT 0x20
+
+/* not in ALL, one socket dump plus the fds of each pid */
+#define SIGAR_PROC_SNAPSHOT_NET_IO 0x40
+
+/* not in ALL, sigar_proc_cumulative_disk_io_get for each pid */
+#define SIGAR_PROC_SNAPSHOT_DISK_IO 0x80
+
+/* not in ALL, sigar_proc_sched_get for each pid */
+#define SIGAR_PROC_SNAPSHOT_SCHED 0x100
+
+/*
+ * or'd into the flags to narrow the STATE and MEM columns to those
+ * SIGAR_PROC_STATE_F_* and SIGAR_PROC_MEM_F_* fields, 0 is every one.
+ * fields left out are SIGAR_FIELD_NOTIMPL where they would need a
+ * read of their own, else filled anyway.
+ */
+#define SIGAR_PROC_SNAPSHOT_STATE_FIELDS(fields) \
+    (((fields) & SIGAR_PROC_STATE_F_ALL) << 16)
+#define SIGAR_PROC_SNAPSHOT_MEM_FIELDS(fields) \
+    (((fields) & SIGAR_PROC_MEM_F_ALL) << 24)
+
+typedef struct {
+    sigar_pid_t pid;
+    int flags; /* SIGAR_PROC_SNAPSHOT_* fields which are valid */
+    sigar_proc_state_t state;
+    sigar_proc_mem_t mem;
+    /* time fields are valid with either TIME or CPU */
+    sigar_proc_cpu_t cpu;
+    sigar_uint64_t cgroup; /* sigar_proc_cgroup_t id */
+    sigar_proc_mem_ext_t mem_ext;
+    sigar_proc_net_io_t net_io;
+    sigar_proc_cumulative_disk_io_t disk_io;
+    sigar_proc_sched_t sched;
+} sigar_proc_snapshot_entry_t;
+
+typedef struct {
+    unsigned long number;
+    unsigned long size;
+    sigar_proc_snapshot_entry_t *data;
+} sigar_proc_snapshot_t;
+
+/* cgroup resource accounting, linux only */
+
+typedef struct {
+    sigar_uint64_t id; /* inode of the cgroup directory */
+    char path[SIGAR_PATH_MAX+1]; /* within the hierarchy, "/" is the root */
+} sigar_proc_cgroup_t;
+
+SIGAR_DECLARE(int) sigar_proc_cgroup_get(sigar_t *sigar, sigar_pid_t pid,
+                                         sigar_proc_cgroup_t *proccgroup);
+
+typedef struct {
+    unsigned long number;
+    unsigned long size;
+    char **data; /* paths, parents before their children */
+} sigar_cgroup_list_t;
+
+SIGAR_DECLARE(int) sigar_cgroup_list_get(sigar_t *sigar,
+                                         sigar_cgroup_list_t *cgroups);
+
+SIGAR_DECLARE(int) sigar_cgroup_list_destroy(sigar_t *sigar,
+                                             sigar_cgroup_list_t *cgroups);
+
+typedef struct {
+    sigar_uint64_t id;
+    /* cpu, in milliseconds */
+    sigar_uint64_t
+        cpu_total,
+        cpu_user,
+        cpu_sys,
+        cpu_periods,
+        cpu_throttled,
+        cpu_throttled_time;
+    /* memory, in bytes; a limit of SIGAR_FIELD_NOTIMPL is unlimited */
+    sigar_uint64_t
+        mem_current,
+        mem_limit,
+        mem_anon,
+        mem_file;
+    /* block io, summed over devices */
+    sigar_uint64_t
+        io_read_bytes,
+        io_write_bytes,
+        io_reads,
+        io_writes;
+    sigar_uint64_t
+        pids_current,
+        pids_limit;
+} sigar_cgroup_stat_t;
+
+/* path as in sigar_proc_cgroup_t or sigar_cgroup_list_t */
+SIGAR_DECLARE(int) sigar_cgroup_stat_get(sigar_t *sigar, const char *path,
+                                         sigar_cgroup_stat_t *cgroupstat);
+
+/* the cgroup's *.pressure files, from the cgroup2 hierarchy */
+SIGAR_DECLARE(int) sigar_cgroup_pressure_get(sigar_t *sigar,
+                                             const char *path,
+                                             sigar_pressure_t *pressure);
+
+SIGAR_DECLARE(int) sigar_proc_snapshot_get(sigar_t *sigar, int flags,
+                                           sigar_proc_snapshot_t *snapshot);
+
+SIGAR_DECLARE(int) sigar_proc_snapshot_destroy(sigar_t *sigar,
+                                               sigar_proc_snapshot_t *snapshot);
+
+/*
+ * top(1) style sampling: each call takes one snapshot of every process,
+ * diffs it against the previous call on this sigar_t and returns the n
+ * busiest by sort_key.  rates are per second over the interval between
+ * the two calls, 0 on the first call.
+ */
+#define SIGAR_PROC_TOP_CPU      0 /* cpu.percent */
+#define SIGAR_PROC_TOP_IO       1 /* bytes read + written */
+#define SIGAR_PROC_TOP_FAULTS   2 /* page faults */
+#define SIGAR_PROC_TOP_RESIDENT 3 /* not a rate, mem.resident */
+
+typedef struct {
+    sigar_pid_t pid;
+    char state;
+    char name[SIGAR_PROC_NAME_LEN];
+    sigar_uint64_t size;
+    sigar_uint64_t resident;
+    sigar_uint64_t cpu_total; /* millis */
+    double cpu_percent;
+    double io_rate;           /* -1 where io counters are unreadable */
+    double fault_rate;
+} sigar_proc_top_entry_t;
+
+typedef struct {
+    unsigned long number;
+    unsigned long size;
+    unsigned long procs;      /* processes sampled */
+    sigar_uint64_t interval;  /* millis since the previous call */
+    sigar_proc_top_entry_t *data;
+} sigar_proc_top_t;
+
+SIGAR_DECLARE(int) sigar_proc_top_get(sigar_t *sigar, unsigned long n,
+                                      int sort_key,
+                                      sigar_proc_top_t *top);
+
+SIGAR_DECLARE(int) sigar_proc_top_destroy(sigar_t *sigar,
+                                          sigar_proc_top_t *top);
+
+/*
+ * parents and children of every process from one snapshot of state,
+ * mem and cpu, with the open fds of each pid too given
+ * SIGAR_PROC_TREE_FD.  entries are sorted by pid; one whose ppid is
+ * not in the snapshot, or would close a loop, is a root.  subtree
+ * sums count the entry itself.
+ */
+#define SIGAR_PROC_TREE_FD 0x01
+
+#define SIGAR_PROC_TREE_NONE ((unsigned long)-1)
+
+typedef struct {
+    sigar_uint64_t processes;
+    sigar_uint64_t cpu_total; /* millis */
+    double cpu_percent;       /* since the previous cpu read of each pid */
+    sigar_uint64_t resident;
+    sigar_uint64_t fds;       /* SIGAR_FIELD_NOTIMPL w/o SIGAR_PROC_TREE_FD */
+} sigar_proc_tree_usage_t;
+
+typedef struct {
+    sigar_pid_t pid;
+    sigar_pid_t ppid;
+    unsigned long parent;  /* indexes into data, or SIGAR_PROC_TREE_NONE */
+    unsigned long child;   /* first, lowest pid */
+    unsigned long sibling; /* next child of parent */
+    sigar_proc_tree_usage_t self;
+    sigar_proc_tree_usage_t subtree;
+} sigar_proc_tree_entry_t;
+
+typedef struct {
+    unsigned long number;
+    unsigned long size;
+    sigar_proc_tree_entry_t *data;
+} sigar_proc_tree_t;
+
+SIGAR_DECLARE(int) sigar_proc_tree_get(sigar_t *sigar, int flags,
+                                       sigar_proc_tree_t *tree);
+
+SIGAR_DECLARE(int) sigar_proc_tree_destroy(sigar_t *sigar,
+                                           sigar_proc_tree_t *tree);
+
+/* index of pid in tree, SIGAR_PROC_TREE_NONE if it is not there */
+SIGAR_DECLARE(unsigned long) sigar_proc_tree_find(sigar_proc_tree_t *tree,
+                                                  sigar_pid_t pid);
+
+/* pid and all of its descendants, parents before children; ESRCH w/o pid */
+SIGAR_DECLARE(int) sigar_proc_tree_pids_get(sigar_proc_tree_t *tree,
+                                            sigar_pid_t pid,
+                                            sigar_proc_list_t *proclist);
+
+/*
+ * a process snapshot laid out one array per field, each aligned to
+ * SIGAR_PROC_COLUMNS_ALIGN, for scans over a field or two of every
+ * row.  CPU_PERCENT is in f64, every other column in u64; columns not
+ * asked for are NULL in both.  rows without a value are 0, but
+ * SIGAR_FIELD_NOTIMPL for UID, where 0 is root.  UID and FDS are a
+ * sigar_proc_cred_get or sigar_proc_fd_get per pid, the rest come
+ * from the snapshot flags they need.
+ */
+#define SIGAR_PROC_COL_PID              0
+#define SIGAR_PROC_COL_PPID             1  /* STATE */
+#define SIGAR_PROC_COL_THREADS          2  /* STATE */
+#define SIGAR_PROC_COL_SIZE             3  /* MEM */
+#define SIGAR_PROC_COL_RESIDENT         4  /* MEM */
+#define SIGAR_PROC_COL_SHARE            5  /* MEM */
+#define SIGAR_PROC_COL_PAGE_FAULTS      6  /* MEM */
+#define SIGAR_PROC_COL_START_TIME       7  /* TIME */
+#define SIGAR_PROC_COL_CPU_USER         8  /* TIME */
+#define SIGAR_PROC_COL_CPU_SYS          9  /* TIME */
+#define SIGAR_PROC_COL_CPU_TOTAL        10 /* TIME */
+#define SIGAR_PROC_COL_CPU_PERCENT      11 /* CPU */
+#define SIGAR_PROC_COL_CGROUP           12 /* CGROUP */
+#define SIGAR_PROC_COL_DISK_READ_BYTES  13 /* DISK_IO */
+#define SIGAR_PROC_COL_DISK_WRITE_BYTES 14 /* DISK_IO */
+#define SIGAR_PROC_COL_UID              15
+#define SIGAR_PROC_COL_FDS              16
+#define SIGAR_PROC_COL_MAX              17
+
+#define SIGAR_PROC_COL(column) (1 << (column))
+
+#define SIGAR_PROC_COLUMNS_ALIGN 64
+
+typedef struct {
+    unsigned long number; /* rows */
+    int columns;          /* SIGAR_PROC_COL() of those filled */
+    sigar_uint64_t *u64[SIGAR_PROC_COL_MAX];
+    double *f64[SIGAR_PROC_COL_MAX];
+    void *block;
+} sigar_proc_columns_t;
+
+/* takes a snapshot with the flags columns need */
+SIGAR_DECLARE(int) sigar_proc_columns_get(sigar_t *sigar, int columns,
+                                          sigar_proc_columns_t *cols);
+
+/* from a snapshot the caller already has, which may be destroyed after */
+SIGAR_DECLARE(int)
+sigar_proc_columns_snapshot_get(sigar_t *sigar,
+                                sigar_proc_snapshot_t *snapshot,
+                                int columns,
+                                sigar_proc_columns_t *cols);
+
+SIGAR_DECLARE(int) sigar_proc_columns_destroy(sigar_t *sigar,
+                                              sigar_proc_columns_t *cols);
+
+/*
+ * kernels over one column, written for the compiler to vectorise.
+ * mask is NULL for every row, else one byte per row, 1 to count the
+ * row and 0 to skip it.  EINVAL for a column that was not filled.
+ */
+
+SIGAR_DECLARE(int) sigar_proc_columns_sum(sigar_proc_columns_t *cols,
+                                          int column,
+                                          const unsigned char *mask,
+                                          double *sum);
+
+/* row of the largest value, the first of equal ones; ENOENT w/o rows */
+SIGAR_DECLARE(int) sigar_proc_columns_max(sigar_proc_columns_t *cols,
+                                          int column,
+                                          const unsigned char *mask,
+                                          unsigned long *row);
+
+/* clears mask for rows not above threshold, so filters chain */
+SIGAR_DECLARE(int) sigar_proc_columns_filter_gt(sigar_proc_columns_t *cols,
+                                                int column,
+                                                double threshold,
+                                                unsigned char *mask);
+
+/*
+ * the rows of the k largest values into rows, which has room for k,
+ * largest first and equal values in row order.  number is how many,
+ * fewer than k when fewer rows are counted.
+ */
+SIGAR_DECLARE(int) sigar_proc_columns_top_k(sigar_proc_columns_t *cols,
+                                            int column,
+                                            const unsigned char *mask,
+                                            unsigned long k,
+                                            unsigned long *rows,
+                                            unsigned long *number);
+
+typedef struct {
+    sigar_uint64_t key;
+    sigar_uint64_t count;
+    double sum;
+} sigar_proc_columns_group_t;
+
+typedef struct {
+    unsigned long number;
+    unsigned long size;
+    sigar_proc_columns_group_t *data; /* in order of first row */
+} sigar_proc_columns_group_list_t;
+
+/* sums of column per value of key, a u64 column such as UID or CGROUP */
+SIGAR_DECLARE(int)
+sigar_proc_columns_group_sum(sigar_proc_columns_t *cols,
+                             int key,
+                             int column,
+                             const unsigned char *mask,
+                             sigar_proc_columns_group_list_t *groups);
+
+SIGAR_DECLARE(int)
+sigar_proc_columns_group_list_destroy(sigar_proc_columns_group_list_t *groups);
+
 typedef struct {
     unsigned long number;
     unsigned long size;
@@ -413,6 +1284,25 @@ SIGAR_DECLARE(int) sigar_proc_args_get(sigar_t *sigar, sigar_pid_t pid,
 SIGAR_DECLARE(int) sigar_proc_args_destroy(sigar_t *sigar,
                                            sigar_proc_args_t *procargs);
 
+/*
+ * win32 only, SIGAR_ENOTIMPL elsewhere: when args or exe have to come
+ * from WMI, serve them from the last bulk Win32_Process query and
+ * refresh it in the background; pids it does not know yet return
+ * ERROR_IO_PENDING instead of waiting on WMI.
+ */
+SIGAR_DECLARE(int) sigar_proc_wmi_async_set(sigar_t *sigar, int enable);
+
+/*
+ * win32 only, SIGAR_ENOTIMPL elsewhere: a real-time kernel trace of
+ * process, thread, disk and tcp events, read on a thread of its own.
+ * while on, sigar_proc_cumulative_disk_io_get of processes started
+ * since comes from the trace instead of perflib, sigar_proc_net_io_get
+ * and SIGAR_NETCONN_GROUP_PID work, none of them opening the process.
+ * needs administrator or Performance Log Users rights.
+ * sigar_proc_events_create starts the trace by itself.
+ */
+SIGAR_DECLARE(int) sigar_proc_etw_set(sigar_t *sigar, int enable);
+
 typedef struct {
     void *data; /* user data */
 
@@ -448,6 +1338,18 @@ typedef struct {
 SIGAR_DECLARE(int) sigar_proc_exe_get(sigar_t *sigar, sigar_pid_t pid,
                                       sigar_proc_exe_t *procexe);
 
+/*
+ * keeps the args, exe name and root of up to max_bytes worth of
+ * processes, least recently used going first; 0, the default, not to.
+ * entries are keyed by pid and start time and dropped on exec, seen
+ * through an open sigar_proc_events_t or else by the inode of
+ * /proc/<pid>/exe checked on every hit.  cwd is always read.  a
+ * process which rewrites its argv in place keeps the args first seen.
+ * linux only.
+ */
+SIGAR_DECLARE(int) sigar_proc_attr_cache_set(sigar_t *sigar,
+                                             sigar_uint64_t max_bytes);
+
 typedef struct {
     void *data; /* user data */
 
@@ -466,6 +1368,31 @@ typedef struct {
 SIGAR_DECLARE(int) sigar_thread_cpu_get(sigar_t *sigar,
                                         sigar_uint64_t id,
                                         sigar_thread_cpu_t *cpu);
+
+typedef struct {
+    sigar_pid_t tid;
+    char state;    /* SIGAR_PROC_STATE_* */
+    int processor; /* last cpu it ran on, -1 if unknown */
+    /* millis; percent uses the sigar_proc_cpu_get delta cache */
+    sigar_proc_cpu_t cpu;
+} sigar_proc_thread_t;
+
+typedef struct {
+    unsigned long number;
+    unsigned long size;
+    sigar_proc_thread_t *data;
+} sigar_proc_thread_list_t;
+
+/*
+ * every thread of pid in one pass: /proc/<pid>/task on linux,
+ * task_threads on darwin, SystemProcessInformation on win32.
+ * percent is 0.0 the first time a thread is seen.
+ */
+SIGAR_DECLARE(int) sigar_proc_thread_list_get(sigar_t *sigar, sigar_pid_t pid,
+                                              sigar_proc_thread_list_t *threads);
+
+SIGAR_DECLARE(int) sigar_proc_thread_list_destroy(sigar_t *sigar,
+                                                  sigar_proc_thread_list_t *threads);
                                             
 typedef enum {
     SIGAR_FSTYPE_UNKNOWN,
@@ -545,14 +1472,80 @@ sigar_file_system_usage_get(sigar_t *sigar,
                             const char *dirname,
                             sigar_file_system_usage_t *fsusage);
 
+typedef struct {
+    int status; /* SIGAR_OK, ETIMEDOUT or the statvfs errno */
+    sigar_file_system_usage_t usage;
+} sigar_file_system_usage_entry_t;
+
+typedef struct {
+    unsigned long number;
+    unsigned long size;
+    sigar_file_system_usage_entry_t *data;
+} sigar_file_system_usage_list_t;
+
+/*
+ * usage of every mount in fslist, data[i] is fslist->data[i].
+ * statvfs (GetDiskFreeSpaceEx on windows) runs on a few threads, a
+ * mount that does not answer within timeout milliseconds is left to
+ * finish in the background and gets ETIMEDOUT, as it does in later
+ * calls until that statvfs returns.
+ * disk stats are only filled in for local disks.
+ */
+SIGAR_DECLARE(int)
+sigar_file_system_usage_list_get(sigar_t *sigar,
+                                 sigar_file_system_list_t *fslist,
+                                 int timeout,
+                                 sigar_file_system_usage_list_t *usagelist);
+
+SIGAR_DECLARE(int)
+sigar_file_system_usage_list_destroy(sigar_t *sigar,
+                                     sigar_file_system_usage_list_t *usagelist);
+
 SIGAR_DECLARE(int) sigar_disk_usage_get(sigar_t *sigar,
                                         const char *name,
                                         sigar_disk_usage_t *disk);
 
+typedef struct {
+    char name[SIGAR_FS_INFO_LEN]; /* e.g. "sda1", no /dev/ prefix */
+    unsigned long major;
+    unsigned long minor;
+    sigar_disk_usage_t disk;
+} sigar_disk_usage_entry_t;
+
+typedef struct {
+    unsigned long number;
+    unsigned long size;
+    sigar_disk_usage_entry_t *data;
+} sigar_disk_usage_list_t;
+
+/*
+ * every block device, service_time and queue are since the last call.
+ * on windows every PhysicalDisk and LogicalDisk instance, see
+ * win32_sigar.c for their names and numbers.
+ */
+SIGAR_DECLARE(int)
+sigar_disk_usage_list_get(sigar_t *sigar,
+                          sigar_disk_usage_list_t *disklist);
+
+SIGAR_DECLARE(int)
+sigar_disk_usage_list_destroy(sigar_t *sigar,
+                              sigar_disk_usage_list_t *disklist);
+
 SIGAR_DECLARE(int)
 sigar_file_system_ping(sigar_t *sigar,
                        sigar_file_system_t *fs);
 
+/*
+ * sigar_file_system_ping for every nfs mount of fslist at once, within
+ * timeout millis in all.  results[i] is the status of fslist->data[i],
+ * SIGAR_OK for the mounts that are not nfs.
+ */
+SIGAR_DECLARE(int)
+sigar_file_system_ping_list(sigar_t *sigar,
+                            sigar_file_system_list_t *fslist,
+                            int timeout,
+                            int *results);
+
 typedef struct {
     enum {
         SIGAR_AF_UNSPEC,
@@ -674,6 +1667,21 @@ SIGAR_DECLARE(int)
 sigar_net_interface_config_primary_get(sigar_t *sigar,
                                        sigar_net_interface_config_t *ifconfig);
 
+typedef struct {
+    unsigned long number;
+    unsigned long size;
+    sigar_net_interface_config_t *data;
+} sigar_net_interface_config_list_t;
+
+/* config of every interface, on linux from a single rtnetlink dump */
+SIGAR_DECLARE(int)
+sigar_net_interface_config_list_get(sigar_t *sigar,
+                                    sigar_net_interface_config_list_t *iflist);
+
+SIGAR_DECLARE(int)
+sigar_net_interface_config_list_destroy(sigar_t *sigar,
+                                        sigar_net_interface_config_list_t *iflist);
+
 typedef struct {
     sigar_uint64_t
         /* received */
@@ -699,6 +1707,32 @@ sigar_net_interface_stat_get(sigar_t *sigar,
                              const char *name,
                              sigar_net_interface_stat_t *ifstat);
 
+typedef struct {
+    char name[MAX_INTERFACE_NAME_LEN];
+    sigar_net_interface_stat_t stat;
+} sigar_net_interface_stat_entry_t;
+
+typedef struct {
+    unsigned long number;
+    unsigned long size;
+    sigar_net_interface_stat_entry_t *data;
+} sigar_net_interface_stat_list_t;
+
+/* stats for every interface, on linux from a single /proc/net/dev read */
+SIGAR_DECLARE(int)
+sigar_net_interface_stat_list_get(sigar_t *sigar,
+                                  sigar_net_interface_stat_list_t *iflist);
+
+SIGAR_DECLARE(int)
+sigar_net_interface_stat_list_destroy(sigar_t *sigar,
+                                      sigar_net_interface_stat_list_t *iflist);
+
+/* how long sigar_net_interface_stat_get, and on linux
+ * sigar_net_interface_config_get, may answer from the last
+ * full read, 0 to always re-read */
+SIGAR_DECLARE(int)
+sigar_net_interface_stat_expire_set(sigar_t *sigar, sigar_uint64_t millis);
+
 typedef struct {
     unsigned long number;
     unsigned long size;
@@ -788,11 +1822,21 @@ typedef struct {
     sigar_uint32_t all_outbound_total;
 } sigar_net_stat_t;
 
+/*
+ * where the kernel can hand out just the states (NETLINK_SOCK_DIAG on
+ * linux) no connection is parsed or passed around for these counts.
+ */
 SIGAR_DECLARE(int)
 sigar_net_stat_get(sigar_t *sigar,
                    sigar_net_stat_t *netstat,
                    int flags);
 
+/*
+ * enable to always count through sigar_net_connection_walk, as on
+ * platforms without a summary source.
+ */
+SIGAR_DECLARE(int) sigar_net_stat_walk_set(sigar_t *sigar, int enable);
+
 SIGAR_DECLARE(int)
 sigar_net_stat_port_get(sigar_t *sigar,
                         sigar_net_stat_t *netstat,
@@ -800,6 +1844,86 @@ sigar_net_stat_port_get(sigar_t *sigar,
                         sigar_net_address_t *address,
                         unsigned long port);
 
+#define SIGAR_NETCONN_GROUP_REMOTE_ADDRESS 1
+#define SIGAR_NETCONN_GROUP_LOCAL_PORT     2
+#define SIGAR_NETCONN_GROUP_STATE          3
+#define SIGAR_NETCONN_GROUP_UID            4
+/*
+ * linux: the socket index of sigar_proc_port_get rebuilt per call.
+ * win32: the pid the sigar_proc_etw_set trace last saw use the
+ * connection, 0 for those idle since it started.
+ */
+#define SIGAR_NETCONN_GROUP_PID            5
+
+typedef struct {
+    /* only the member grouped by is set */
+    sigar_net_address_t remote_address;
+    unsigned long local_port;
+    int state;
+    sigar_uid_t uid;
+    sigar_pid_t pid; /* 0 for sockets no process we can see holds */
+    unsigned long count;
+    sigar_uint64_t send_queue;
+    sigar_uint64_t receive_queue;
+} sigar_net_connection_group_t;
+
+typedef struct {
+    unsigned long number;
+    unsigned long size;
+    sigar_net_connection_group_t *data;
+} sigar_net_connection_aggregate_t;
+
+/*
+ * counts and queue sums of the connections sigar_net_connection_list_get
+ * would return for flags, one group per distinct group_by value, in the
+ * order first seen.  grouped as they are walked, no list is built.
+ */
+SIGAR_DECLARE(int)
+sigar_net_connection_aggregate_get(sigar_t *sigar,
+                                   int flags,
+                                   int group_by,
+                                   sigar_net_connection_aggregate_t *aggregate);
+
+SIGAR_DECLARE(int)
+sigar_net_connection_aggregate_destroy(sigar_t *sigar,
+                                       sigar_net_connection_aggregate_t *aggregate);
+
+/* network namespaces, linux only */
+
+typedef struct {
+    sigar_uint64_t inode;    /* of /proc/<pid>/ns/net */
+    sigar_pid_t pid;         /* the lowest in it, whose net/ is read */
+    unsigned long processes;
+} sigar_netns_t;
+
+typedef struct {
+    unsigned long number;
+    unsigned long size;
+    sigar_netns_t *data;
+} sigar_netns_list_t;
+
+/* processes whose ns/net cannot be read (not ours, without root) are skipped */
+SIGAR_DECLARE(int) sigar_netns_list_get(sigar_t *sigar,
+                                        sigar_netns_list_t *netnslist);
+
+SIGAR_DECLARE(int) sigar_netns_list_destroy(sigar_t *sigar,
+                                            sigar_netns_list_t *netnslist);
+
+/*
+ * as sigar_net_interface_stat_list_get and sigar_net_stat_get within
+ * netns, one read of its pid's /proc/<pid>/net files per call.  ESRCH
+ * once that pid is gone or no longer in netns.
+ */
+SIGAR_DECLARE(int)
+sigar_netns_net_interface_stat_list_get(sigar_t *sigar,
+                                        sigar_netns_t *netns,
+                                        sigar_net_interface_stat_list_t *iflist);
+
+SIGAR_DECLARE(int) sigar_netns_net_stat_get(sigar_t *sigar,
+                                            sigar_netns_t *netns,
+                                            sigar_net_stat_t *netstat,
+                                            int flags);
+
 /* TCP-MIB */
 typedef struct {
     sigar_uint64_t active_opens;
@@ -886,11 +2010,112 @@ SIGAR_DECLARE(int)
 sigar_nfs_server_v3_get(sigar_t *sigar,
                         sigar_nfs_server_v3_t *nfs);
 
+#define SIGAR_NFS_V2 0x01
+#define SIGAR_NFS_V3 0x02
+#define SIGAR_NFS_V4 0x04
+
+#define SIGAR_NFS_V4_OPS_MAX 96
+
+typedef struct {
+    int versions; /* SIGAR_NFS_V* counters found */
+    sigar_nfs_v2_t v2;
+    sigar_nfs_v3_t v3;
+    /*
+     * client: the NFSPROC4_CLNT_* procedures in kernel order,
+     * server: per operation, indexed by nfsv4 operation number
+     */
+    unsigned long v4_number;
+    sigar_uint64_t v4[SIGAR_NFS_V4_OPS_MAX];
+} sigar_nfs_rpc_t;
+
+typedef struct {
+    sigar_nfs_rpc_t client;
+    sigar_nfs_rpc_t server;
+} sigar_nfs_stats_t;
+
+/*
+ * every version of the client and server counters, each side read
+ * once.  a side that is not running has no versions set.
+ */
+SIGAR_DECLARE(int)
+sigar_nfs_stats_get(sigar_t *sigar,
+                    sigar_nfs_stats_t *nfs);
+
+#define SIGAR_NFS_OP_NAME_LEN 32
+
+typedef struct {
+    char name[SIGAR_NFS_OP_NAME_LEN]; /* READ, GETATTR, ... */
+    sigar_uint64_t
+        ops,
+        transmissions,
+        timeouts,
+        bytes_sent,
+        bytes_received,
+        /* millis, summed over all ops */
+        queue_time,
+        rtt,
+        execute_time,
+        errors; /* SIGAR_FIELD_NOTIMPL on older kernels */
+} sigar_nfs_mount_op_t;
+
+typedef struct {
+    char dev_name[SIGAR_FS_NAME_LEN];  /* server:/export */
+    char dir_name[SIGAR_FS_NAME_LEN];
+    char sys_type_name[SIGAR_FS_INFO_LEN]; /* nfs, nfs4 */
+    sigar_uint64_t age; /* seconds mounted */
+    unsigned long number;
+    unsigned long size;
+    sigar_nfs_mount_op_t *ops;
+} sigar_nfs_mount_t;
+
+typedef struct {
+    unsigned long number;
+    unsigned long size;
+    sigar_nfs_mount_t *data;
+} sigar_nfs_mount_list_t;
+
+/* per-op counters of each nfs mount, linux only */
+SIGAR_DECLARE(int)
+sigar_nfs_mount_list_get(sigar_t *sigar,
+                         sigar_nfs_mount_list_t *mounts);
+
+SIGAR_DECLARE(int)
+sigar_nfs_mount_list_destroy(sigar_t *sigar,
+                             sigar_nfs_mount_list_t *mounts);
+
+/*
+ * answered from a table of every tcp listener, rebuilt by one walk
+ * once it is older than sigar_net_listen_expire_set; a port missing
+ * from it is ENOENT without another walk.
+ */
 SIGAR_DECLARE(int)
 sigar_net_listen_address_get(sigar_t *sigar,
                              unsigned long port,
                              sigar_net_address_t *address);
 
+/* 0 to walk on every call */
+SIGAR_DECLARE(int) sigar_net_listen_expire_set(sigar_t *sigar,
+                                               sigar_uint64_t millis);
+
+typedef struct {
+    unsigned long port;
+    sigar_net_address_t address;
+} sigar_net_listen_t;
+
+typedef struct {
+    unsigned long number;
+    unsigned long size;
+    sigar_net_listen_t *data;
+} sigar_net_listen_list_t;
+
+/* the same table, by port */
+SIGAR_DECLARE(int) sigar_net_listen_list_get(sigar_t *sigar,
+                                             sigar_net_listen_list_t *listens);
+
+SIGAR_DECLARE(int)
+sigar_net_listen_list_destroy(sigar_t *sigar,
+                              sigar_net_listen_list_t *listens);
+
 typedef struct {
     char ifname[MAX_INTERFACE_NAME_LEN];
     char type[64];
@@ -930,10 +2155,65 @@ SIGAR_DECLARE(int) sigar_who_list_get(sigar_t *sigar,
 SIGAR_DECLARE(int) sigar_who_list_destroy(sigar_t *sigar,
                                           sigar_who_list_t *wholist);
 
+/*
+ * the parsed utmp is reused until the file's stat changes.  with watch
+ * set the kernel reports writes instead, an unchanged list then costs
+ * no stat at all.  SIGAR_ENOTIMPL where there is no sigar_file_watch.
+ */
+SIGAR_DECLARE(int) sigar_who_list_watch_set(sigar_t *sigar, int watch);
+
 SIGAR_DECLARE(int) sigar_proc_port_get(sigar_t *sigar, 
                                        int protocol, unsigned long port,
                                        sigar_pid_t *pid);
 
+/* pids[i] is the owner of ports[i] or 0, one connection walk for all */
+SIGAR_DECLARE(int) sigar_proc_port_list_get(sigar_t *sigar,
+                                            int protocol,
+                                            unsigned long *ports, int num,
+                                            sigar_pid_t *pids);
+
+/*
+ * list memory kept from one poll to the next.  every *_get_ex call
+ * after a reset takes the arena's next slot, in call order, and fills
+ * the buffer that slot's list had last time, so a poll making the same
+ * calls each cycle only reallocs when a list outgrows its last size.
+ * the lists belong to the arena: no *_destroy, and they are valid until
+ * the next sigar_arena_reset of it.
+ */
+typedef struct sigar_arena_t sigar_arena_t;
+
+SIGAR_DECLARE(int) sigar_arena_create(sigar_arena_t **arena);
+
+SIGAR_DECLARE(int) sigar_arena_reset(sigar_arena_t *arena);
+
+SIGAR_DECLARE(int) sigar_arena_destroy(sigar_arena_t *arena);
+
+/* held across resets */
+SIGAR_DECLARE(sigar_uint64_t) sigar_arena_bytes(sigar_arena_t *arena);
+
+SIGAR_DECLARE(int) sigar_proc_list_get_ex(sigar_t *sigar,
+                                          sigar_arena_t *arena,
+                                          sigar_proc_list_t *proclist);
+
+SIGAR_DECLARE(int)
+sigar_file_system_list_get_ex(sigar_t *sigar,
+                              sigar_arena_t *arena,
+                              sigar_file_system_list_t *fslist);
+
+SIGAR_DECLARE(int) sigar_net_route_list_get_ex(sigar_t *sigar,
+                                               sigar_arena_t *arena,
+                                               sigar_net_route_list_t *routelist);
+
+SIGAR_DECLARE(int)
+sigar_net_connection_list_get_ex(sigar_t *sigar,
+                                 sigar_arena_t *arena,
+                                 sigar_net_connection_list_t *connlist,
+                                 int flags);
+
+SIGAR_DECLARE(int) sigar_arp_list_get_ex(sigar_t *sigar,
+                                         sigar_arena_t *arena,
+                                         sigar_arp_list_t *arplist);
+
 typedef struct {
     const char *build_date;
     const char *scm_revision;
@@ -968,11 +2248,37 @@ SIGAR_DECLARE(int) sigar_sys_info_get(sigar_t *sigar, sigar_sys_info_t *sysinfo)
 
 SIGAR_DECLARE(int) sigar_fqdn_get(sigar_t *sigar, char *name, int namelen);
 
+/* how long sigar_fqdn_get and sigar_net_info_get answers are reused,
+ * 0 to always look again */
+SIGAR_DECLARE(int) sigar_net_info_expire_set(sigar_t *sigar,
+                                             sigar_uint64_t millis);
+
+/*
+ * with async set, sigar_fqdn_get never waits on the name service:
+ * an expired answer is returned as is while a fresh lookup runs on
+ * a thread of its own, and until the first one is done the name
+ * comes from gethostname alone.
+ */
+SIGAR_DECLARE(int) sigar_fqdn_async_set(sigar_t *sigar, int async);
+
 SIGAR_DECLARE(int) sigar_rpc_ping(char *hostname,
                                   int protocol,
                                   unsigned long program,
                                   unsigned long version);
 
+/*
+ * sigar_rpc_ping of num hosts concurrently, all of them done within
+ * timeout millis.  results[i] is the enum clnt_stat for hosts[i],
+ * RPC_TIMEDOUT for the ones that did not answer in time.
+ */
+SIGAR_DECLARE(int) sigar_rpc_ping_list(char **hosts,
+                                       int num,
+                                       int protocol,
+                                       unsigned long program,
+                                       unsigned long version,
+                                       int timeout,
+                                       int *results);
+
 SIGAR_DECLARE(char *) sigar_rpc_strerror(int err);
 
 SIGAR_DECLARE(char *) sigar_password_get(const char *prompt);
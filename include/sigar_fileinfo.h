@@ -142,6 +142,45 @@ SIGAR_DECLARE(int) sigar_link_attrs_get(sigar_t *sigar,
                                         const char *file,
                                         sigar_file_attrs_t *fileattrs);
 
+/** sigar_file_attrs_t fields for sigar_file_attrs_list_get */
+#define SIGAR_FILE_ATTR_PERMISSIONS 0x0001
+#define SIGAR_FILE_ATTR_TYPE        0x0002
+#define SIGAR_FILE_ATTR_UID         0x0004
+#define SIGAR_FILE_ATTR_GID         0x0008
+#define SIGAR_FILE_ATTR_INODE       0x0010
+#define SIGAR_FILE_ATTR_DEVICE      0x0020
+#define SIGAR_FILE_ATTR_NLINK       0x0040
+#define SIGAR_FILE_ATTR_SIZE        0x0080
+#define SIGAR_FILE_ATTR_ATIME       0x0100
+#define SIGAR_FILE_ATTR_MTIME       0x0200
+#define SIGAR_FILE_ATTR_CTIME       0x0400
+#define SIGAR_FILE_ATTR_ALL         0x07ff
+/** Or'd in: the link itself rather than what it points at */
+#define SIGAR_FILE_ATTR_LINK        0x1000
+/** Or'd in: cached attributes of network filesystems will do */
+#define SIGAR_FILE_ATTR_NOSYNC      0x2000
+
+typedef struct {
+    /** SIGAR_OK, or why the path could not be looked at */
+    int status;
+    /** Fields not asked for are 0 */
+    sigar_file_attrs_t attrs;
+} sigar_file_attrs_result_t;
+
+/*
+ * the attributes of n paths into results, which has room for n.  only
+ * the fields in mask are fetched where the platform can tell it what
+ * to leave out: statx on linux, no acl lookup on win32 without
+ * PERMISSIONS.  paths sharing a directory are looked up relative to
+ * it, opened once per call.
+ */
+SIGAR_DECLARE(int)
+sigar_file_attrs_list_get(sigar_t *sigar,
+                          const char **paths,
+                          unsigned long n,
+                          int mask,
+                          sigar_file_attrs_result_t *results);
+
 SIGAR_DECLARE(int)sigar_file_attrs_mode_get(sigar_uint64_t permissions);
 
 SIGAR_DECLARE(char *)
@@ -155,3 +194,108 @@ SIGAR_DECLARE(int) sigar_dir_stat_get(sigar_t *sigar,
 SIGAR_DECLARE(int) sigar_dir_usage_get(sigar_t *sigar,
                                        const char *dir,
                                        sigar_dir_usage_t *dirusage);
+
+typedef struct {
+    /** Walker threads, the caller included */
+    int threads;
+    /** Reuse the counts of directories whose mtime has not changed */
+    int incremental;
+    /** Stop after this many entries, 0 for no limit */
+    sigar_uint64_t max_entries;
+    /** Stop after this many milliseconds, 0 for no limit */
+    sigar_uint64_t max_time;
+} sigar_dir_usage_opts_t;
+
+/*
+ * sigar_dir_usage_get on several threads.  incremental walks take the
+ * files of an unchanged directory from the last walk, so growth of an
+ * existing file shows once its directory changes.  the budget is
+ * checked between directories, when it runs out ETIMEDOUT is returned
+ * with what was counted so far in dirusage.
+ */
+SIGAR_DECLARE(int) sigar_dir_usage_walk(sigar_t *sigar,
+                                        const char *dir,
+                                        sigar_dir_usage_opts_t *opts,
+                                        sigar_dir_usage_t *dirusage);
+
+/** Written to */
+#define SIGAR_FILE_WATCH_MODIFY   0x01
+/** Ownership, permissions or times changed */
+#define SIGAR_FILE_WATCH_ATTRIB   0x02
+/** Deleted or renamed away */
+#define SIGAR_FILE_WATCH_DELETE   0x04
+/** There again after a delete */
+#define SIGAR_FILE_WATCH_CREATE   0x08
+/** Events were lost, id is -1 and every file should be checked */
+#define SIGAR_FILE_WATCH_OVERFLOW 0x10
+
+typedef struct sigar_file_watch_t sigar_file_watch_t;
+
+typedef struct {
+    int id;
+    int flags;
+} sigar_file_watch_event_t;
+
+typedef struct {
+    unsigned long number;
+    unsigned long size;
+    sigar_file_watch_event_t *data;
+} sigar_file_watch_event_list_t;
+
+/*
+ * inotify on linux, kqueue on darwin and the bsds,
+ * SIGAR_ENOTIMPL elsewhere.  add and remove may be called while
+ * another thread waits, one thread at a time may wait.
+ */
+SIGAR_DECLARE(int) sigar_file_watch_create(sigar_file_watch_t **watch);
+
+SIGAR_DECLARE(int) sigar_file_watch_destroy(sigar_file_watch_t *watch);
+
+SIGAR_DECLARE(int) sigar_file_watch_add(sigar_file_watch_t *watch,
+                                        const char *file, int *id);
+
+SIGAR_DECLARE(int) sigar_file_watch_remove(sigar_file_watch_t *watch,
+                                           int id);
+
+/*
+ * waits up to timeout milliseconds, -1 for no limit, for changes and
+ * returns them batched with one event per file.  no events is a timeout.
+ */
+SIGAR_DECLARE(int)
+sigar_file_watch_wait(sigar_file_watch_t *watch, int timeout,
+                      sigar_file_watch_event_list_t *events);
+
+SIGAR_DECLARE(int)
+sigar_file_watch_event_list_destroy(sigar_file_watch_event_list_t *events);
+
+/** The file was replaced, reading went on from the start of the new one */
+#define SIGAR_FILE_TAIL_ROTATED   0x01
+/** The file shrank, reading went on from its start */
+#define SIGAR_FILE_TAIL_TRUNCATED 0x02
+
+typedef struct sigar_file_tail_t sigar_file_tail_t;
+
+/*
+ * follows a growing file, offset -1 starts at its current end.
+ * SIGAR_ENOTIMPL on win32.
+ */
+SIGAR_DECLARE(int) sigar_file_tail_open(sigar_t *sigar,
+                                        const char *file,
+                                        sigar_int64_t offset,
+                                        sigar_file_tail_t **tail);
+
+SIGAR_DECLARE(int) sigar_file_tail_close(sigar_file_tail_t *tail);
+
+/* offset of the next byte to be read, to resume a tail later */
+SIGAR_DECLARE(sigar_uint64_t)
+sigar_file_tail_offset(sigar_file_tail_t *tail);
+
+/*
+ * reads up to len appended bytes straight into buf, nread is 0 when
+ * there is nothing new.  flags tell of a rotation or truncation found
+ * on the way, the bytes in buf are all from the file now open.
+ */
+SIGAR_DECLARE(int) sigar_file_tail_read(sigar_t *sigar,
+                                        sigar_file_tail_t *tail,
+                                        char *buf, size_t len,
+                                        size_t *nread, int *flags);
@@ -34,6 +34,48 @@ SIGAR_DECLARE(int) sigar_cpu_perc_calculate(sigar_cpu_t *prev,
                                             sigar_cpu_t *curr,
                                             sigar_cpu_perc_t *perc);
 
+typedef struct {
+    unsigned long number;
+    unsigned long size;
+    sigar_cpu_perc_t *data;
+} sigar_cpu_perc_list_t;
+
+SIGAR_DECLARE(int) sigar_cpu_perc_list_destroy(sigar_cpu_perc_list_t *percs);
+
+/*
+ * keeps the last depth cpu samples so percentages over a window of
+ * up to depth ticks come from one call, with no previous sample kept
+ * by the caller.  samples are stored in place once the ring is full.
+ * flags are SIGAR_SAMPLER_CPU and/or SIGAR_SAMPLER_CPU_LIST.
+ */
+typedef struct sigar_cpu_sampler_t sigar_cpu_sampler_t;
+
+SIGAR_DECLARE(int) sigar_cpu_sampler_create(sigar_cpu_sampler_t **sampler,
+                                            int flags, int depth);
+
+SIGAR_DECLARE(int) sigar_cpu_sampler_destroy(sigar_cpu_sampler_t *sampler);
+
+/* sigar_cpu_get and/or sigar_cpu_list_get as the newest sample */
+SIGAR_DECLARE(int) sigar_cpu_sampler_update(sigar_t *sigar,
+                                            sigar_cpu_sampler_t *sampler);
+
+/* a sample read elsewhere, e.g. from a sigar_sampler_snapshot_t */
+SIGAR_DECLARE(int) sigar_cpu_sampler_add(sigar_cpu_sampler_t *sampler,
+                                         sigar_int64_t timestamp,
+                                         sigar_cpu_t *cpu,
+                                         sigar_cpu_list_t *cpulist);
+
+/*
+ * percentages from the newest sample back to the newest one at least
+ * window millis older, or the oldest held; 0 is the last tick.
+ * total and percs (zeroed before first use, reused after) may be
+ * NULL.  ENOENT until two samples have been added.
+ */
+SIGAR_DECLARE(int) sigar_cpu_sampler_perc_get(sigar_cpu_sampler_t *sampler,
+                                              sigar_uint64_t window,
+                                              sigar_cpu_perc_t *total,
+                                              sigar_cpu_perc_list_t *percs);
+
 SIGAR_DECLARE(int) sigar_uptime_string(sigar_t *sigar, 
                                        sigar_uptime_t *uptime,
                                        char *buffer,
@@ -0,0 +1,211 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIGAR_INSTRUMENT_DOT_H
+#define SIGAR_INSTRUMENT_DOT_H
+
+/*
+ * only included by sigar_private.h when the library is built with
+ * -DSIGAR_INSTRUMENT.  inside the library each getter below is
+ * renamed to <getter>_uninstrumented, sigar_instrument.c defines the
+ * public symbol as a wrapper which times the call.  calls between
+ * getters inside the library are not counted twice.
+ */
+
+/* name, parameters, arguments; every backend defines these */
+#define SIGAR_INSTRUMENT_GETTERS \
+    SIGAR_INSTRUMENT_GETTER(cpu_get, \
+        (sigar_t *sigar, sigar_cpu_t *cpu), (sigar, cpu)) \
+    SIGAR_INSTRUMENT_GETTER(cpu_list_get, \
+        (sigar_t *sigar, sigar_cpu_list_t *cpulist), (sigar, cpulist)) \
+    SIGAR_INSTRUMENT_GETTER(cpu_info_list_get, \
+        (sigar_t *sigar, sigar_cpu_info_list_t *cpu_infos), \
+        (sigar, cpu_infos)) \
+    SIGAR_INSTRUMENT_GETTER(mem_get, \
+        (sigar_t *sigar, sigar_mem_t *mem), (sigar, mem)) \
+    SIGAR_INSTRUMENT_GETTER(swap_get, \
+        (sigar_t *sigar, sigar_swap_t *swap), (sigar, swap)) \
+    SIGAR_INSTRUMENT_GETTER(uptime_get, \
+        (sigar_t *sigar, sigar_uptime_t *uptime), (sigar, uptime)) \
+    SIGAR_INSTRUMENT_GETTER(loadavg_get, \
+        (sigar_t *sigar, sigar_loadavg_t *loadavg), (sigar, loadavg)) \
+    SIGAR_INSTRUMENT_GETTER(resource_limit_get, \
+        (sigar_t *sigar, sigar_resource_limit_t *rlimit), (sigar, rlimit)) \
+    SIGAR_INSTRUMENT_GETTER(sys_info_get, \
+        (sigar_t *sigar, sigar_sys_info_t *sysinfo), (sigar, sysinfo)) \
+    SIGAR_INSTRUMENT_GETTER(proc_list_get, \
+        (sigar_t *sigar, sigar_proc_list_t *proclist), (sigar, proclist)) \
+    SIGAR_INSTRUMENT_GETTER(proc_stat_get, \
+        (sigar_t *sigar, sigar_proc_stat_t *procstat), (sigar, procstat)) \
+    SIGAR_INSTRUMENT_GETTER(proc_mem_get, \
+        (sigar_t *sigar, sigar_pid_t pid, sigar_proc_mem_t *procmem), \
+        (sigar, pid, procmem)) \
+    SIGAR_INSTRUMENT_GETTER(proc_cred_get, \
+        (sigar_t *sigar, sigar_pid_t pid, sigar_proc_cred_t *proccred), \
+        (sigar, pid, proccred)) \
+    SIGAR_INSTRUMENT_GETTER(proc_time_get, \
+        (sigar_t *sigar, sigar_pid_t pid, sigar_proc_time_t *proctime), \
+        (sigar, pid, proctime)) \
+    SIGAR_INSTRUMENT_GETTER(proc_cpu_get, \
+        (sigar_t *sigar, sigar_pid_t pid, sigar_proc_cpu_t *proccpu), \
+        (sigar, pid, proccpu)) \
+    SIGAR_INSTRUMENT_GETTER(proc_state_get, \
+        (sigar_t *sigar, sigar_pid_t pid, sigar_proc_state_t *procstate), \
+        (sigar, pid, procstate)) \
+    SIGAR_INSTRUMENT_GETTER(proc_args_get, \
+        (sigar_t *sigar, sigar_pid_t pid, sigar_proc_args_t *procargs), \
+        (sigar, pid, procargs)) \
+    SIGAR_INSTRUMENT_GETTER(proc_env_get, \
+        (sigar_t *sigar, sigar_pid_t pid, sigar_proc_env_t *procenv), \
+        (sigar, pid, procenv)) \
+    SIGAR_INSTRUMENT_GETTER(proc_fd_get, \
+        (sigar_t *sigar, sigar_pid_t pid, sigar_proc_fd_t *procfd), \
+        (sigar, pid, procfd)) \
+    SIGAR_INSTRUMENT_GETTER(proc_exe_get, \
+        (sigar_t *sigar, sigar_pid_t pid, sigar_proc_exe_t *procexe), \
+        (sigar, pid, procexe)) \
+    SIGAR_INSTRUMENT_GETTER(proc_modules_get, \
+        (sigar_t *sigar, sigar_pid_t pid, sigar_proc_modules_t *procmods), \
+        (sigar, pid, procmods)) \
+    SIGAR_INSTRUMENT_GETTER(proc_disk_io_get, \
+        (sigar_t *sigar, sigar_pid_t pid, \
+         sigar_proc_disk_io_t *proc_disk_io), \
+        (sigar, pid, proc_disk_io)) \
+    SIGAR_INSTRUMENT_GETTER(thread_cpu_get, \
+        (sigar_t *sigar, sigar_uint64_t id, sigar_thread_cpu_t *cpu), \
+        (sigar, id, cpu)) \
+    SIGAR_INSTRUMENT_GETTER(file_system_list_get, \
+        (sigar_t *sigar, sigar_file_system_list_t *fslist), \
+        (sigar, fslist)) \
+    SIGAR_INSTRUMENT_GETTER(file_system_usage_get, \
+        (sigar_t *sigar, const char *dirname, \
+         sigar_file_system_usage_t *fsusage), \
+        (sigar, dirname, fsusage)) \
+    SIGAR_INSTRUMENT_GETTER(disk_usage_get, \
+        (sigar_t *sigar, const char *name, sigar_disk_usage_t *disk), \
+        (sigar, name, disk)) \
+    SIGAR_INSTRUMENT_GETTER(net_info_get, \
+        (sigar_t *sigar, sigar_net_info_t *netinfo), (sigar, netinfo)) \
+    SIGAR_INSTRUMENT_GETTER(net_route_list_get, \
+        (sigar_t *sigar, sigar_net_route_list_t *routelist), \
+        (sigar, routelist)) \
+    SIGAR_INSTRUMENT_GETTER(net_interface_list_get, \
+        (sigar_t *sigar, sigar_net_interface_list_t *iflist), \
+        (sigar, iflist)) \
+    SIGAR_INSTRUMENT_GETTER(net_interface_config_get, \
+        (sigar_t *sigar, const char *name, \
+         sigar_net_interface_config_t *ifconfig), \
+        (sigar, name, ifconfig)) \
+    SIGAR_INSTRUMENT_GETTER(net_interface_stat_get, \
+        (sigar_t *sigar, const char *name, \
+         sigar_net_interface_stat_t *ifstat), \
+        (sigar, name, ifstat)) \
+    SIGAR_INSTRUMENT_GETTER(net_connection_list_get, \
+        (sigar_t *sigar, sigar_net_connection_list_t *connlist, int flags), \
+        (sigar, connlist, flags)) \
+    SIGAR_INSTRUMENT_GETTER(net_stat_get, \
+        (sigar_t *sigar, sigar_net_stat_t *netstat, int flags), \
+        (sigar, netstat, flags)) \
+    SIGAR_INSTRUMENT_GETTER(tcp_get, \
+        (sigar_t *sigar, sigar_tcp_t *tcp), (sigar, tcp)) \
+    SIGAR_INSTRUMENT_GETTER(arp_list_get, \
+        (sigar_t *sigar, sigar_arp_list_t *arplist), (sigar, arplist)) \
+    SIGAR_INSTRUMENT_GETTER(who_list_get, \
+        (sigar_t *sigar, sigar_who_list_t *wholist), (sigar, wholist)) \
+    SIGAR_INSTRUMENT_GETTER(fqdn_get, \
+        (sigar_t *sigar, char *name, int namelen), (sigar, name, namelen))
+
+#define SIGAR_INSTRUMENT_GETTER(name, params, args) \
+    SIGAR_INSTRUMENT_ID_##name,
+
+enum {
+    SIGAR_INSTRUMENT_GETTERS
+    SIGAR_INSTRUMENT_MAX
+};
+
+#undef SIGAR_INSTRUMENT_GETTER
+
+#define SIGAR_INSTRUMENT_GETTER(name, params, args) \
+    SIGAR_DECLARE(int) sigar_##name##_uninstrumented params;
+
+SIGAR_INSTRUMENT_GETTERS
+
+#undef SIGAR_INSTRUMENT_GETTER
+
+/* sigar_instrument.c defines the real names */
+#ifndef SIGAR_INSTRUMENT_WRAPPERS
+#define sigar_cpu_get sigar_cpu_get_uninstrumented
+#define sigar_cpu_list_get sigar_cpu_list_get_uninstrumented
+#define sigar_cpu_info_list_get sigar_cpu_info_list_get_uninstrumented
+#define sigar_mem_get sigar_mem_get_uninstrumented
+#define sigar_swap_get sigar_swap_get_uninstrumented
+#define sigar_uptime_get sigar_uptime_get_uninstrumented
+#define sigar_loadavg_get sigar_loadavg_get_uninstrumented
+#define sigar_resource_limit_get sigar_resource_limit_get_uninstrumented
+#define sigar_sys_info_get sigar_sys_info_get_uninstrumented
+#define sigar_proc_list_get sigar_proc_list_get_uninstrumented
+#define sigar_proc_stat_get sigar_proc_stat_get_uninstrumented
+#define sigar_proc_mem_get sigar_proc_mem_get_uninstrumented
+#define sigar_proc_cred_get sigar_proc_cred_get_uninstrumented
+#define sigar_proc_time_get sigar_proc_time_get_uninstrumented
+#define sigar_proc_cpu_get sigar_proc_cpu_get_uninstrumented
+#define sigar_proc_state_get sigar_proc_state_get_uninstrumented
+#define sigar_proc_args_get sigar_proc_args_get_uninstrumented
+#define sigar_proc_env_get sigar_proc_env_get_uninstrumented
+#define sigar_proc_fd_get sigar_proc_fd_get_uninstrumented
+#define sigar_proc_exe_get sigar_proc_exe_get_uninstrumented
+#define sigar_proc_modules_get sigar_proc_modules_get_uninstrumented
+#define sigar_proc_disk_io_get sigar_proc_disk_io_get_uninstrumented
+#define sigar_thread_cpu_get sigar_thread_cpu_get_uninstrumented
+#define sigar_file_system_list_get sigar_file_system_list_get_uninstrumented
+#define sigar_file_system_usage_get sigar_file_system_usage_get_uninstrumented
+#define sigar_disk_usage_get sigar_disk_usage_get_uninstrumented
+#define sigar_net_info_get sigar_net_info_get_uninstrumented
+#define sigar_net_route_list_get sigar_net_route_list_get_uninstrumented
+#define sigar_net_interface_list_get sigar_net_interface_list_get_uninstrumented
+#define sigar_net_interface_config_get sigar_net_interface_config_get_uninstrumented
+#define sigar_net_interface_stat_get sigar_net_interface_stat_get_uninstrumented
+#define sigar_net_connection_list_get sigar_net_connection_list_get_uninstrumented
+#define sigar_net_stat_get sigar_net_stat_get_uninstrumented
+#define sigar_tcp_get sigar_tcp_get_uninstrumented
+#define sigar_arp_list_get sigar_arp_list_get_uninstrumented
+#define sigar_who_list_get sigar_who_list_get_uninstrumented
+#define sigar_fqdn_get sigar_fqdn_get_uninstrumented
+#endif
+
+/* file opens and reads made by the getter running on this thread */
+typedef struct {
+    sigar_uint64_t opens;
+    sigar_uint64_t reads;
+} sigar_instrument_frame_t;
+
+#if defined(WIN32)
+#   define SIGAR_INSTRUMENT_TLS __declspec(thread)
+#else
+#   define SIGAR_INSTRUMENT_TLS __thread
+#endif
+
+extern SIGAR_INSTRUMENT_TLS sigar_instrument_frame_t *sigar_instrument_frame;
+
+#define SIGAR_INSTRUMENT_OPEN() \
+    do { \
+        if (sigar_instrument_frame) sigar_instrument_frame->opens++; \
+    } while (0)
+
+#define SIGAR_INSTRUMENT_READ() \
+    do { \
+        if (sigar_instrument_frame) sigar_instrument_frame->reads++; \
+    } while (0)
+
+#endif
@@ -26,23 +26,38 @@
 #define	SIGAR_LOG_DEBUG  4
 #define	SIGAR_LOG_TRACE  5
 
+/*
+ * messages above this level are compiled out of the library,
+ * e.g. -DSIGAR_LOG_MAX_LEVEL=SIGAR_LOG_INFO drops debug and trace
+ * along with the SIGAR_LOG_IS_DEBUG blocks in the collection loops.
+ */
+#ifndef SIGAR_LOG_MAX_LEVEL
+#define SIGAR_LOG_MAX_LEVEL SIGAR_LOG_TRACE
+#endif
+
 #define SIGAR_LOG_IS_FATAL(sigar) \
-    (sigar->log_level >= SIGAR_LOG_FATAL)
+    ((SIGAR_LOG_MAX_LEVEL >= SIGAR_LOG_FATAL) && \
+     (sigar->log_level >= SIGAR_LOG_FATAL))
 
 #define SIGAR_LOG_IS_ERROR(sigar) \
-    (sigar->log_level >= SIGAR_LOG_ERROR)
+    ((SIGAR_LOG_MAX_LEVEL >= SIGAR_LOG_ERROR) && \
+     (sigar->log_level >= SIGAR_LOG_ERROR))
 
 #define SIGAR_LOG_IS_WARN(sigar) \
-    (sigar->log_level >= SIGAR_LOG_WARN)
+    ((SIGAR_LOG_MAX_LEVEL >= SIGAR_LOG_WARN) && \
+     (sigar->log_level >= SIGAR_LOG_WARN))
 
 #define SIGAR_LOG_IS_INFO(sigar) \
-    (sigar->log_level >= SIGAR_LOG_INFO)
+    ((SIGAR_LOG_MAX_LEVEL >= SIGAR_LOG_INFO) && \
+     (sigar->log_level >= SIGAR_LOG_INFO))
 
 #define SIGAR_LOG_IS_DEBUG(sigar) \
-    (sigar->log_level >= SIGAR_LOG_DEBUG)
+    ((SIGAR_LOG_MAX_LEVEL >= SIGAR_LOG_DEBUG) && \
+     (sigar->log_level >= SIGAR_LOG_DEBUG))
 
 #define SIGAR_LOG_IS_TRACE(sigar) \
-    (sigar->log_level >= SIGAR_LOG_TRACE)
+    ((SIGAR_LOG_MAX_LEVEL >= SIGAR_LOG_TRACE) && \
+     (sigar->log_level >= SIGAR_LOG_TRACE))
 
 #define SIGAR_STRINGIFY(n) #n
 
@@ -72,6 +87,33 @@ SIGAR_DECLARE(void) sigar_log_impl_set(sigar_t *sigar, void *data,
 SIGAR_DECLARE(void) sigar_log_impl_file(sigar_t *sigar, void *data,
                                         int level, char *message);
 
+/*
+ * keeps messages in memory instead of writing them out: with
+ * sigar_log_impl_set(sigar, ring, sigar_log_impl_ring),
+ * sigar_log_printf stores the format and its arguments, and the
+ * message is only formatted by sigar_log_ring_drain, which may run
+ * on another thread.  once the ring is full new messages are dropped.
+ */
+typedef struct sigar_log_ring_t sigar_log_ring_t;
+
+/* size is rounded up to a power of two */
+SIGAR_DECLARE(int) sigar_log_ring_create(sigar_log_ring_t **ring,
+                                         unsigned int size);
+
+SIGAR_DECLARE(void) sigar_log_ring_destroy(sigar_log_ring_t *ring);
+
+SIGAR_DECLARE(void) sigar_log_impl_ring(sigar_t *sigar, void *data,
+                                        int level, char *message);
+
+/* hands every message waiting in the ring to impl, returns the count */
+SIGAR_DECLARE(int) sigar_log_ring_drain(sigar_log_ring_t *ring,
+                                        sigar_t *sigar,
+                                        sigar_log_impl_t impl,
+                                        void *data);
+
+/* messages lost to a full ring */
+SIGAR_DECLARE(sigar_uint64_t) sigar_log_ring_dropped(sigar_log_ring_t *ring);
+
 SIGAR_DECLARE(int) sigar_log_level_get(sigar_t *sigar);
 
 SIGAR_DECLARE(void) sigar_log_level_set(sigar_t *sigar, int level);
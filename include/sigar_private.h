@@ -40,6 +40,36 @@
 #include <dmalloc.h>
 #endif
 
+/* previous sigar_proc_top_get round */
+typedef struct {
+    sigar_pid_t pid;
+    sigar_uint64_t start_time;
+    sigar_uint64_t cpu_total;
+    sigar_uint64_t faults;
+    sigar_uint64_t io; /* SIGAR_FIELD_NOTIMPL if unreadable */
+} sigar_proc_top_sample_t;
+
+typedef struct {
+    unsigned long number;
+    sigar_int64_t timestamp;
+    sigar_proc_top_sample_t *data; /* sorted by pid */
+} sigar_proc_top_samples_t;
+
+/* per-getter counters, see sigar_instrument.c */
+typedef struct sigar_instrument_t sigar_instrument_t;
+
+/* recorded frame served by sigar_snapshot_replay_set */
+typedef struct sigar_replay_t sigar_replay_t;
+
+/* cached fqdn and net info, see sigar_resolver.c */
+typedef struct sigar_resolver_t sigar_resolver_t;
+
+/* last parsed utmp, see sigar_who_list_get */
+typedef struct sigar_who_cache_t sigar_who_cache_t;
+
+/* pids by State.Name and Exe.Name, see sigar_ptql.c */
+typedef struct sigar_ptql_names_t sigar_ptql_names_t;
+
 /* common to all os sigar_t's */
 /* XXX: this is ugly; but don't want the same stuffs
  * duplicated on 4 platforms and am too lazy to change
@@ -63,13 +93,38 @@
    char *ifconf_buf; \
    int ifconf_len; \
    char *self_path; \
+   char *procfs_buf; \
+   int procfs_len; \
    sigar_proc_list_t *pids; \
    sigar_cache_t *fsdev; \
    sigar_cache_t *proc_cpu; \
    sigar_cache_t *net_listen; \
-   sigar_cache_t *net_services_tcp; \
-   sigar_cache_t *net_services_udp;\
-   sigar_cache_t *proc_io
+   sigar_cache_t *proc_io; \
+   sigar_pool_t *proc_cpu_pool; \
+   sigar_pool_t *proc_io_pool; \
+   sigar_uint64_t proc_cache_expire; \
+   sigar_uint64_t net_ifstat_expire; \
+   sigar_uint64_t net_listen_time; \
+   sigar_uint64_t net_listen_expire; \
+   int ptql_cache; \
+   int proc_stat_census; \
+   int net_stat_walk; \
+   int proc_scan_threads; \
+   sigar_handle_pool_t *proc_scan_pool; \
+   void *fs_usage_hung; \
+   sigar_cache_t *dir_usage; \
+   sigar_proc_top_samples_t *proc_top; \
+   sigar_cache_t *user_names; \
+   sigar_cache_t *group_names; \
+   sigar_uint64_t cred_name_expire; \
+   sigar_proc_events_t *proc_events; \
+   sigar_instrument_t *instrument; \
+   sigar_replay_t *replay; \
+   sigar_uint64_t net_info_expire; \
+   sigar_resolver_t *resolver; \
+   sigar_who_cache_t *who_cache; \
+   sigar_ptql_names_t *ptql_names; \
+   void *list_preset
 
 #if defined(WIN32)
 #   define SIGAR_INLINE __inline
@@ -153,16 +208,44 @@
 
 #define SIGAR_LAST_PROC_EXPIRE 2
 
+#define SIGAR_PROC_CACHE_EXPIRE (SIGAR_LAST_PROC_EXPIRE * SIGAR_MSEC)
+
 #define SIGAR_BUFFER_EXPIRE 1000
 
+/* long enough to serve a loop over every interface from one read */
+#define SIGAR_NET_IFSTAT_EXPIRE 500
+
+/* a port missing from a table this young is taken as not listening */
+#define SIGAR_NET_LISTEN_EXPIRE (5 * SIGAR_MSEC)
+
+/* uid/gid names rarely change, lookups may go over the network */
+#define SIGAR_CRED_NAME_EXPIRE (10 * 60 * SIGAR_MSEC)
+
+/* same for the fqdn, and the net info it is usually asked along with */
+#define SIGAR_NET_INFO_EXPIRE (60 * SIGAR_MSEC)
+
 #define SIGAR_FS_MAX 10
 
 #define SIGAR_CPU_INFO_MAX 4
 
 #define SIGAR_CPU_LIST_MAX 4
 
+#define SIGAR_INTERRUPT_LIST_MAX 64
+
+#define SIGAR_NUMA_TOPOLOGY_MAX 16
+
+#define SIGAR_NUMA_MEM_LIST_MAX 4
+
+#define SIGAR_CGROUP_LIST_MAX 32
+
+#define SIGAR_NETNS_LIST_MAX 16
+
 #define SIGAR_PROC_LIST_MAX 256
 
+#define SIGAR_PROC_SNAPSHOT_MAX 256
+
+#define SIGAR_PROC_THREAD_LIST_MAX 32
+
 #define SIGAR_PROC_ARGS_MAX 12
 
 #define SIGAR_NET_ROUTE_LIST_MAX 6
@@ -177,6 +260,13 @@
 
 int sigar_os_open(sigar_t **sigar);
 
+/* backends with capability probes sigar_open_ex can run early */
+#if defined(__linux__) || defined(WIN32)
+#define SIGAR_HAS_OS_OPEN_PROBE
+int sigar_os_open_probe(sigar_t *sigar, int flags);
+int sigar_os_capabilities_get(sigar_t *sigar, sigar_capabilities_t *caps);
+#endif
+
 int sigar_os_close(sigar_t *sigar);
 
 char *sigar_os_error_string(sigar_t *sigar, int err);
@@ -198,11 +288,292 @@ int sigar_proc_list_create(sigar_proc_list_t *proclist);
 
 int sigar_proc_list_grow(sigar_proc_list_t *proclist);
 
+/* the pid list kept by sigar_proc_events, ENOTIMPL while none is open */
+int sigar_proc_events_list_get(sigar_t *sigar, sigar_proc_list_t *proclist);
+
+/* changes when pid forks or execs, 0 while no sigar_proc_events is open */
+sigar_uint64_t sigar_proc_events_serial(sigar_t *sigar, sigar_pid_t pid);
+
 #define SIGAR_PROC_LIST_GROW(proclist) \
     if (proclist->number >= proclist->size) { \
         sigar_proc_list_grow(proclist); \
     }
 
+int sigar_proc_snapshot_create(sigar_proc_snapshot_t *snapshot);
+
+int sigar_proc_snapshot_grow(sigar_proc_snapshot_t *snapshot);
+
+#define SIGAR_PROC_SNAPSHOT_GROW(snapshot) \
+    if (snapshot->number >= snapshot->size) { \
+        sigar_proc_snapshot_grow(snapshot); \
+    }
+
+/* sigar_proc_tree_get over a snapshot of snapshot_flags */
+int sigar_proc_tree_build(sigar_t *sigar, int snapshot_flags, int flags,
+                          sigar_proc_tree_t *tree);
+
+/* backends with a native bulk implementation */
+#if defined(__linux__) || defined(DARWIN) || defined(WIN32) || \
+    defined(__hpux) || defined(SOLARIS)
+#define SIGAR_HAS_OS_PROC_SNAPSHOT
+#endif
+
+#ifdef SIGAR_HAS_OS_PROC_SNAPSHOT
+/* may return SIGAR_ENOTIMPL to use the per-pid getters instead */
+int sigar_os_proc_snapshot_get(sigar_t *sigar, int flags,
+                               sigar_proc_snapshot_t *snapshot);
+#endif
+
+int sigar_proc_thread_list_create(sigar_proc_thread_list_t *threads);
+
+int sigar_proc_thread_list_grow(sigar_proc_thread_list_t *threads);
+
+#define SIGAR_PROC_THREAD_LIST_GROW(threads) \
+    if (threads->number >= threads->size) { \
+        sigar_proc_thread_list_grow(threads); \
+    }
+
+/* backends that can list threads, sigar.c says ENOTIMPL otherwise */
+#if defined(__linux__) || defined(DARWIN) || defined(WIN32)
+#define SIGAR_HAS_OS_PROC_THREAD_LIST
+/* fills everything but cpu.last_time and cpu.percent */
+int sigar_os_proc_thread_list_get(sigar_t *sigar, sigar_pid_t pid,
+                                  sigar_proc_thread_list_t *threads);
+#endif
+
+/* backends whose bulk snapshot reads SIGAR_PROC_SNAPSHOT_DISK_IO itself */
+#if defined(__linux__) || defined(DARWIN) || defined(SOLARIS)
+#define SIGAR_HAS_OS_PROC_SNAPSHOT_DISK_IO
+#endif
+
+/* backends that can fill one entry at a time, for parallel scans */
+#if defined(__linux__)
+#define SIGAR_HAS_OS_PROC_SNAPSHOT_ENTRY
+/* returns !SIGAR_OK if the process went away */
+int sigar_os_proc_snapshot_entry_get(sigar_t *sigar, int flags,
+                                     sigar_proc_snapshot_entry_t *entry);
+#endif
+
+/* backends with kernel counters for sigar_proc_stat_get */
+#if defined(__linux__) || defined(DARWIN) || defined(__FreeBSD__) || \
+    defined(SOLARIS)
+#define SIGAR_HAS_OS_PROC_STAT
+/* may return SIGAR_ENOTIMPL to count process states instead */
+int sigar_os_proc_stat_get(sigar_t *sigar, sigar_proc_stat_t *procstat);
+#endif
+
+/* backends that know the numa layout, sigar.c says ENOTIMPL otherwise */
+#if defined(__linux__)
+#define SIGAR_HAS_OS_NUMA
+#endif
+
+/* backends with a sigar_cgroup_* implementation */
+#if defined(__linux__)
+#define SIGAR_HAS_OS_CGROUP
+#endif
+
+/* backends with sigar_interrupts_get and sigar_softirqs_get */
+#if defined(__linux__)
+#define SIGAR_HAS_OS_INTERRUPTS
+#endif
+
+/* backends with sigar_pressure_get and sigar_proc_sched_get */
+#if defined(__linux__)
+#define SIGAR_HAS_OS_PRESSURE
+#endif
+
+/* backends with a sigar_proc_perf_* implementation */
+#if defined(__linux__)
+#define SIGAR_HAS_OS_PROC_PERF
+#endif
+
+/* backends with a sigar_proc_attr_cache_set implementation */
+#if defined(__linux__)
+#define SIGAR_HAS_OS_PROC_ATTR
+#endif
+
+#ifdef SIGAR_HAS_OS_PROC_ATTR
+/* drops what is cached for pid, every pid if -1 */
+void sigar_os_proc_attr_forget(sigar_t *sigar, sigar_pid_t pid);
+#endif
+
+/* backends with sigar_proc_{state,mem}_get_ex honouring the fields */
+#if defined(__linux__)
+#define SIGAR_HAS_OS_PROC_FIELDS
+#endif
+
+/* backends with a sigar_netns_* implementation */
+#if defined(__linux__)
+#define SIGAR_HAS_OS_NETNS
+#endif
+
+int sigar_cgroup_list_create(sigar_cgroup_list_t *cgroups);
+
+int sigar_cgroup_list_grow(sigar_cgroup_list_t *cgroups);
+
+#define SIGAR_CGROUP_LIST_GROW(cgroups) \
+    if (cgroups->number >= cgroups->size) { \
+        sigar_cgroup_list_grow(cgroups); \
+    }
+
+int sigar_netns_list_create(sigar_netns_list_t *netnslist);
+
+int sigar_netns_list_grow(sigar_netns_list_t *netnslist);
+
+#define SIGAR_NETNS_LIST_GROW(netnslist) \
+    if (netnslist->number >= netnslist->size) { \
+        sigar_netns_list_grow(netnslist); \
+    }
+
+/* backends with a native sigar_mem_ext_get */
+#if defined(__linux__)
+#define SIGAR_HAS_OS_MEM_EXT
+#endif
+
+/* backends with a sigar_proc_mem_ext_get implementation */
+#if defined(__linux__)
+#define SIGAR_HAS_OS_PROC_MEM_EXT
+#endif
+
+/* backends with a sigar_proc_net_io_get implementation */
+#if defined(__linux__) || defined(WIN32)
+#define SIGAR_HAS_OS_PROC_NET_IO
+#endif
+
+/* backends that read all of sigar_system_stat_t in one go */
+#if defined(__linux__)
+#define SIGAR_HAS_OS_SYSTEM_STAT
+#endif
+
+struct sigar_proc_iter_t {
+    sigar_t *sigar;
+    void *os;               /* backend cursor, e.g. the /proc DIR */
+    sigar_proc_list_t pids; /* otherwise listed up front */
+    unsigned long next;
+};
+
+/* backends that can read pids as they go */
+#if defined(__linux__)
+#define SIGAR_HAS_OS_PROC_ITER
+int sigar_os_proc_iter_open(sigar_proc_iter_t *iter);
+/* ENOENT after the last pid */
+int sigar_os_proc_iter_next(sigar_proc_iter_t *iter, sigar_pid_t *pid);
+void sigar_os_proc_iter_close(sigar_proc_iter_t *iter);
+#endif
+
+/*
+ * runs func over [0, number) in SIGAR_PARALLEL_CHUNK slices, which
+ * up to sigar->proc_scan_threads workers take from a shared cursor as
+ * they finish the last one.  worker 0 is the caller on sigar, the
+ * rest each use a handle of their own from sigar->proc_scan_pool.
+ * the first error stops the walk and is returned.
+ */
+#define SIGAR_PARALLEL_CHUNK 32
+
+typedef int (*sigar_parallel_func_t)(sigar_t *sigar, void *data, int worker,
+                                     unsigned long start, unsigned long end);
+
+int sigar_parallel_walk(sigar_t *sigar, unsigned long number,
+                        sigar_parallel_func_t func, void *data);
+
+#define SIGAR_PARALLEL_SCAN(sigar, number) \
+    (((sigar)->proc_scan_threads > 1) && \
+     ((number) > SIGAR_PARALLEL_CHUNK))
+
+/* statvfs threads per sigar_file_system_usage_list_get call */
+#define SIGAR_FS_USAGE_THREADS 4
+
+/*
+ * the statvfs of every fslist entry into the preallocated usagelist,
+ * status ETIMEDOUT for those not back within timeout ms
+ */
+int sigar_fs_usage_batch_get(sigar_t *sigar,
+                             sigar_file_system_list_t *fslist,
+                             int timeout,
+                             sigar_file_system_usage_list_t *usagelist);
+
+/* drops the statvfs calls earlier lists gave up on, see sigar_close */
+void sigar_fs_usage_hung_free(sigar_t *sigar);
+
+/* -DSIGAR_INSTRUMENT wraps the public getters, see sigar_instrument.h */
+#ifdef SIGAR_INSTRUMENT
+#include "sigar_instrument.h"
+#else
+#define SIGAR_INSTRUMENT_OPEN()
+#define SIGAR_INSTRUMENT_READ()
+#endif
+
+void sigar_instrument_free(sigar_t *sigar);
+
+/* sigar_resolver.c caches what these look up */
+int sigar_fqdn_resolve(sigar_t *sigar, char *name, int namelen);
+
+int sigar_os_net_info_get(sigar_t *sigar, sigar_net_info_t *netinfo);
+
+void sigar_resolver_free(sigar_t *sigar);
+
+void sigar_who_cache_free(sigar_t *sigar);
+
+void sigar_ptql_names_free(sigar_t *sigar);
+
+/* sigar_snapshot.c, the getters below check sigar->replay first */
+void sigar_replay_free(sigar_t *sigar);
+
+int sigar_replay_proc_list_get(sigar_t *sigar, sigar_proc_list_t *proclist);
+
+int sigar_replay_proc_snapshot_get(sigar_t *sigar, int flags,
+                                   sigar_proc_snapshot_t *snapshot);
+
+int sigar_replay_net_connection_list_get(sigar_t *sigar,
+                                         sigar_net_connection_list_t *connlist,
+                                         int flags);
+
+int sigar_replay_disk_usage_list_get(sigar_t *sigar,
+                                     sigar_disk_usage_list_t *disklist);
+
+#ifdef __linux__
+#define SIGAR_HAS_NET_CONNECTION_PORT_WALK
+#endif
+
+#ifdef SIGAR_HAS_NET_CONNECTION_PORT_WALK
+/* walker may be handed only the connections whose local port,
+ * or with remote set either port, is port; it must still check */
+int sigar_net_connection_port_walk(sigar_net_connection_walker_t *walker,
+                                   unsigned long port, int remote);
+#endif
+
+#ifdef __linux__
+#define SIGAR_HAS_OS_NET_STAT
+#endif
+
+#ifdef SIGAR_HAS_OS_NET_STAT
+/* counts straight from the kernel, no connection is handed out;
+ * anything but SIGAR_OK means the walk should be used */
+int sigar_os_net_stat_get(sigar_t *sigar, sigar_net_stat_t *netstat,
+                          int flags);
+#endif
+
+#if defined(__linux__) || defined(WIN32)
+#define SIGAR_HAS_OS_NET_CONNECTION_PID
+#endif
+
+#ifdef SIGAR_HAS_OS_NET_CONNECTION_PID
+/*
+ * brings what connection_pid_get answers from up to date, on linux
+ * a rescan of every process' fds for sockets newer than the index
+ */
+int sigar_os_net_connection_pid_refresh(sigar_t *sigar);
+
+/* the process holding the socket, 0 if none we can see does */
+int sigar_os_net_connection_pid_get(sigar_t *sigar,
+                                    sigar_net_connection_t *conn,
+                                    sigar_pid_t *pid);
+#endif
+
+/* remembers a listening socket for sigar_net_listen_address_get */
+void sigar_net_listen_address_add(sigar_t *sigar,
+                                  sigar_net_connection_t *conn);
+
 int sigar_proc_args_create(sigar_proc_args_t *proclist);
 
 int sigar_proc_args_grow(sigar_proc_args_t *procargs);
@@ -224,6 +595,17 @@ int sigar_file_system_list_grow(sigar_file_system_list_t *fslist);
         sigar_file_system_list_grow(fslist); \
     }
 
+#define SIGAR_NFS_MOUNT_MAX 8
+
+int sigar_nfs_mount_list_create(sigar_nfs_mount_list_t *mounts);
+
+int sigar_nfs_mount_list_grow(sigar_nfs_mount_list_t *mounts);
+
+#define SIGAR_NFS_MOUNT_LIST_GROW(mounts) \
+    if (mounts->number >= mounts->size) { \
+        sigar_nfs_mount_list_grow(mounts); \
+    }
+
 int sigar_os_fs_type_get(sigar_file_system_t *fsp);
 
 /* os plugins that set fsp->type call fs_type_get directly */
@@ -251,6 +633,56 @@ int sigar_cpu_list_grow(sigar_cpu_list_t *cpulist);
         sigar_cpu_list_grow(cpulist); \
     }
 
+/* the fields sigar_proc_snapshot_get flags ask of STATE and MEM */
+#define SIGAR_PROC_SNAPSHOT_STATE_FIELDS_OF(flags) \
+    ((((flags) >> 16) & SIGAR_PROC_STATE_F_ALL) ? \
+     (((flags) >> 16) & SIGAR_PROC_STATE_F_ALL) : SIGAR_PROC_STATE_F_ALL)
+#define SIGAR_PROC_SNAPSHOT_MEM_FIELDS_OF(flags) \
+    ((((flags) >> 24) & SIGAR_PROC_MEM_F_ALL) ? \
+     (((flags) >> 24) & SIGAR_PROC_MEM_F_ALL) : SIGAR_PROC_MEM_F_ALL)
+
+/*
+ * a *_get_ex call hands its list in already sized from the arena, the
+ * getters then fill it instead of creating one.  *_GROW still reallocs
+ * it, sigar_arena.c keeps whatever the list ends up with.
+ */
+#define SIGAR_LIST_PRESET(sigar, list) \
+    ((void *)(list) == (sigar)->list_preset)
+
+#define SIGAR_LIST_CREATE(sigar, list, create) \
+    if (!SIGAR_LIST_PRESET(sigar, list)) { \
+        create(list); \
+    }
+
+int sigar_interrupt_list_create(sigar_interrupt_list_t *interrupts,
+                                unsigned long ncpu);
+
+/* rows, and their ncpu counts */
+int sigar_interrupt_list_grow(sigar_interrupt_list_t *interrupts);
+
+#define SIGAR_INTERRUPT_LIST_GROW(interrupts) \
+    if (interrupts->number >= interrupts->size) { \
+        sigar_interrupt_list_grow(interrupts); \
+    }
+
+int sigar_numa_topology_create(sigar_numa_topology_t *topology);
+
+int sigar_numa_topology_grow(sigar_numa_topology_t *topology);
+
+#define SIGAR_NUMA_TOPOLOGY_GROW(topology) \
+    if (topology->number >= topology->size) { \
+        sigar_numa_topology_grow(topology); \
+    }
+
+int sigar_numa_mem_list_create(sigar_numa_mem_list_t *memlist);
+
+int sigar_numa_mem_list_grow(sigar_numa_mem_list_t *memlist);
+
+#define SIGAR_NUMA_MEM_LIST_GROW(memlist) \
+    if (memlist->number >= memlist->size) { \
+        sigar_numa_mem_list_grow(memlist); \
+    }
+
 int sigar_net_route_list_create(sigar_net_route_list_t *routelist);
 
 int sigar_net_route_list_grow(sigar_net_route_list_t *net_routelist);
@@ -269,6 +701,33 @@ int sigar_net_interface_list_grow(sigar_net_interface_list_t *iflist);
         sigar_net_interface_list_grow(iflist); \
     }
 
+int sigar_disk_usage_list_create(sigar_disk_usage_list_t *disklist);
+
+int sigar_disk_usage_list_grow(sigar_disk_usage_list_t *disklist);
+
+#define SIGAR_DISK_USAGE_LIST_GROW(disklist) \
+    if (disklist->number >= disklist->size) { \
+        sigar_disk_usage_list_grow(disklist); \
+    }
+
+int sigar_net_interface_config_list_create(sigar_net_interface_config_list_t *iflist);
+
+int sigar_net_interface_config_list_grow(sigar_net_interface_config_list_t *iflist);
+
+#define SIGAR_NET_IFCONFIG_LIST_GROW(iflist) \
+    if (iflist->number >= iflist->size) { \
+        sigar_net_interface_config_list_grow(iflist); \
+    }
+
+int sigar_net_interface_stat_list_create(sigar_net_interface_stat_list_t *iflist);
+
+int sigar_net_interface_stat_list_grow(sigar_net_interface_stat_list_t *iflist);
+
+#define SIGAR_NET_IFSTAT_LIST_GROW(iflist) \
+    if (iflist->number >= iflist->size) { \
+        sigar_net_interface_stat_list_grow(iflist); \
+    }
+
 int sigar_net_connection_list_create(sigar_net_connection_list_t *connlist);
 
 int sigar_net_connection_list_grow(sigar_net_connection_list_t *connlist);
@@ -304,6 +763,29 @@ int sigar_net_interface_ipv6_config_get(sigar_t *sigar, const char *name,
     ifconfig->prefix6_length = 0; \
     ifconfig->scope6 = 0
 
+/* IFF_* as returned by SIOCGIFFLAGS into SIGAR_IFF_* */
+sigar_uint64_t sigar_net_interface_flags_get(sigar_uint64_t flags);
+
+#ifdef __linux__
+/* ARPHRD_* into ifconfig->type */
+void sigar_net_interface_type_set(sigar_net_interface_config_t *ifconfig,
+                                  int family);
+
+#define SIGAR_HAS_OS_NET_IFCONFIG_LIST
+#endif
+
+#ifdef SIGAR_HAS_OS_NET_IFCONFIG_LIST
+/* SIGAR_ENOTIMPL means use the ioctls, one interface at a time */
+int sigar_os_net_interface_config_list_get(sigar_t *sigar,
+                                           sigar_net_interface_config_list_t *iflist);
+
+int sigar_os_net_interface_config_get(sigar_t *sigar, const char *name,
+                                      sigar_net_interface_config_t *ifconfig);
+
+int sigar_os_net_interface_list_get(sigar_t *sigar,
+                                    sigar_net_interface_list_t *iflist);
+#endif
+
 #define SIGAR_SIN6(s) ((struct sockaddr_in6 *)(s))
 
 #define SIGAR_SIN6_ADDR(s) &SIGAR_SIN6(s)->sin6_addr
@@ -346,6 +828,10 @@ int sigar_user_name_get(sigar_t *sigar, int uid, char *buf, int buflen);
 
 int sigar_group_name_get(sigar_t *sigar, int gid, char *buf, int buflen);
 
+/* the process wide services table, for sigar_cache_stats_get */
+int sigar_net_services_stats(sigar_t *sigar, int protocol,
+                             sigar_cache_stats_t *stats);
+
 #define SIGAR_PROC_ENV_KEY_LOOKUP() \
     if ((procenv->type == SIGAR_PROC_ENV_KEY) && \
         (pid == sigar->pid)) \
@@ -403,6 +889,15 @@ int sigar_get_iftype(const char *name, int *type, int *inst);
 #define SIGAR_NIC_EC       "Econet"
 #define PID_CACHE_CLEANUP_PERIOD 1000*60*10 /* 10 minutes */
 #define PID_CACHE_ENTRY_EXPIRE_PERIOD 1000*60*20 /* 20 minutes */
+/* pid caches expire a few slots per lookup, no sweep spike on pid churn */
+#define PID_CACHE_FLAGS \
+    (SIGAR_CACHE_OPEN_ADDRESSING | SIGAR_CACHE_INCREMENTAL_CLEANUP)
+/* per-pid values are carved out of slabs of this many */
+#define PID_CACHE_POOL_SLAB 128
+
+/* parsed /proc/<pid>/ data, drop pids nobody asked about for a minute */
+#define PROC_STAT_CACHE_CLEANUP_PERIOD 1000*30
+#define PROC_STAT_CACHE_ENTRY_EXPIRE_PERIOD 1000*60
 #ifndef WIN32
 #include <netdb.h>
 #endif
@@ -426,4 +921,26 @@ typedef struct {
 #endif
 } sigar_hostent_t;
 
+/* eq, ne, gt, ge, lt or le, -1 for the rest */
+int sigar_ptql_op_code(char *op);
+
+int sigar_ptql_op_dbl_match(int op, double haystack, double needle);
+
+#ifdef SIGAR_SAMPLER_H
+/* sigar_shm.c, the publishing side of sigar_sampler_shm_set */
+int sigar_shm_create(sigar_shm_t **shm, const char *name,
+                     sigar_uint64_t size);
+
+int sigar_shm_publish(sigar_shm_t *shm, sigar_sampler_snapshot_t *snapshot);
+
+/* unlinks the segment, readers keep what they have mapped */
+void sigar_shm_destroy(sigar_shm_t *shm);
+#endif
+
+#ifdef SIGAR_RULES_H
+/* sigar_rules.c, queues what changed for sigar_rules_events_take */
+void sigar_rules_sampler_eval(sigar_t *sigar, sigar_rules_t *rules,
+                              sigar_sampler_snapshot_t *snapshot);
+#endif
+
 #endif
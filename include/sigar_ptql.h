@@ -32,6 +32,16 @@ typedef int (*sigar_ptql_re_impl_t)(void *, char *, char *);
 SIGAR_DECLARE(void) sigar_ptql_re_impl_set(sigar_t *sigar, void *data,
                                            sigar_ptql_re_impl_t impl);
 
+/*
+ * remember per-pid results of sigar_ptql_query_find between calls,
+ * for queries that only test attributes fixed once a process has
+ * exec'd; only pids new since the previous call are matched again.
+ * also keeps an index of pids by State.Name and Exe.Name, so queries
+ * with a State.Name.eq or Exe.Name.eq branch only match the pids
+ * carrying that name.
+ */
+SIGAR_DECLARE(int) sigar_ptql_cache_set(sigar_t *sigar, int enable);
+
 SIGAR_DECLARE(int) sigar_ptql_query_create(sigar_ptql_query_t **query,
                                            char *ptql,
                                            sigar_ptql_error_t *error);
@@ -50,4 +60,42 @@ SIGAR_DECLARE(int) sigar_ptql_query_find(sigar_t *sigar,
                                          sigar_ptql_query_t *query,
                                          sigar_proc_list_t *proclist);
 
+#define SIGAR_AGG_CPU 0x01
+#define SIGAR_AGG_MEM 0x02
+
+typedef struct {
+    sigar_uint64_t processes; /* number of pids matched */
+    sigar_proc_cpu_t cpu;     /* SIGAR_AGG_CPU, percent is summed too */
+    sigar_proc_mem_t mem;     /* SIGAR_AGG_MEM */
+} sigar_ptql_aggregate_t;
+
+/*
+ * sigar_ptql_query_find and the sum of proc cpu and/or mem of every
+ * match, without handing the pids back to the caller.  pids which go
+ * away or cannot be read in between are counted but not summed.
+ */
+SIGAR_DECLARE(int) sigar_ptql_query_aggregate(sigar_t *sigar,
+                                              sigar_ptql_query_t *query,
+                                              int flags,
+                                              sigar_ptql_aggregate_t *result);
+
+/*
+ * many queries evaluated in one pass over the process list; branches
+ * and proc data the queries have in common are matched and fetched
+ * once per pid.  queries are not owned by the set and must outlive it.
+ */
+typedef struct sigar_ptql_query_set_t sigar_ptql_query_set_t;
+
+SIGAR_DECLARE(int) sigar_ptql_query_set_create(sigar_ptql_query_set_t **set);
+
+SIGAR_DECLARE(int) sigar_ptql_query_set_add(sigar_ptql_query_set_t *set,
+                                            sigar_ptql_query_t *query);
+
+/* proclists has one entry per query, in the order they were added */
+SIGAR_DECLARE(int) sigar_ptql_query_set_find(sigar_t *sigar,
+                                             sigar_ptql_query_set_t *set,
+                                             sigar_proc_list_t *proclists);
+
+SIGAR_DECLARE(int) sigar_ptql_query_set_destroy(sigar_ptql_query_set_t *set);
+
 #endif /*SIGAR_PTQL_H*/
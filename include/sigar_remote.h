@@ -0,0 +1,118 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIGAR_REMOTE_H
+#define SIGAR_REMOTE_H
+
+#include "sigar_snapshot.h"
+
+/*
+ * batched collection from another host, served by sigard.  a request
+ * is a list of getters answered together in one response, so a
+ * caller wanting cpu, mem, a few interfaces and a ptql match pays one
+ * round trip for all of them.  requests may be pipelined: send as
+ * many as wanted before receiving, responses come back in order.
+ */
+
+#define SIGAR_REMOTE_PORT 7279
+
+#define SIGAR_REMOTE_CPU          1  /* sigar_cpu_get */
+#define SIGAR_REMOTE_CPU_LIST     2  /* sigar_cpu_list_get */
+#define SIGAR_REMOTE_MEM          3  /* sigar_mem_get */
+#define SIGAR_REMOTE_SWAP         4  /* sigar_swap_get */
+#define SIGAR_REMOTE_LOADAVG      5  /* sigar_loadavg_get */
+#define SIGAR_REMOTE_UPTIME       6  /* sigar_uptime_get */
+#define SIGAR_REMOTE_NETIF_STAT   7  /* sigar_net_interface_stat_get, arg */
+#define SIGAR_REMOTE_FS_USAGE     8  /* sigar_file_system_usage_get, arg */
+#define SIGAR_REMOTE_PTQL_FIND    9  /* sigar_ptql_query_find, arg */
+#define SIGAR_REMOTE_SNAPSHOT     10 /* sigar_snapshot_get, num flags */
+
+typedef struct {
+    int type;         /* SIGAR_REMOTE_* */
+    char *arg;        /* name, dir or ptql query */
+    sigar_uint64_t num;
+} sigar_remote_item_t;
+
+typedef struct {
+    unsigned long number;
+    unsigned long size;
+    sigar_remote_item_t *data;
+} sigar_remote_request_t;
+
+typedef struct {
+    int type;
+    int status;       /* of the getter on the remote host */
+    union {
+        sigar_cpu_t cpu;
+        sigar_cpu_list_t cpulist;
+        sigar_mem_t mem;
+        sigar_swap_t swap;
+        sigar_loadavg_t loadavg;
+        sigar_uptime_t uptime;
+        sigar_net_interface_stat_t ifstat;
+        sigar_file_system_usage_t fsusage;
+        sigar_proc_list_t proclist;
+        sigar_snapshot_t snapshot;
+    } value;          /* when status is SIGAR_OK */
+} sigar_remote_result_t;
+
+typedef struct {
+    sigar_uint32_t id; /* from sigar_remote_send */
+    unsigned long number;
+    unsigned long size;
+    sigar_remote_result_t *data; /* one per request item, same order */
+} sigar_remote_response_t;
+
+SIGAR_DECLARE(int)
+sigar_remote_request_create(sigar_remote_request_t *request);
+
+/* arg is copied, NULL for getters without one */
+SIGAR_DECLARE(int)
+sigar_remote_request_add(sigar_remote_request_t *request,
+                         int type, const char *arg, sigar_uint64_t num);
+
+SIGAR_DECLARE(int)
+sigar_remote_request_destroy(sigar_remote_request_t *request);
+
+SIGAR_DECLARE(int)
+sigar_remote_response_destroy(sigar_remote_response_t *response);
+
+typedef struct sigar_remote_t sigar_remote_t;
+
+/* port 0 for SIGAR_REMOTE_PORT */
+SIGAR_DECLARE(int) sigar_remote_open(sigar_remote_t **remote,
+                                     const char *host, int port);
+
+/* over a connected socket or pipe, closed by sigar_remote_close */
+SIGAR_DECLARE(int) sigar_remote_fdopen(sigar_remote_t **remote, int fd);
+
+SIGAR_DECLARE(int) sigar_remote_close(sigar_remote_t *remote);
+
+/* does not wait for the response, id is what it will carry */
+SIGAR_DECLARE(int) sigar_remote_send(sigar_remote_t *remote,
+                                     sigar_remote_request_t *request,
+                                     sigar_uint32_t *id);
+
+/* the response to the oldest request not yet received */
+SIGAR_DECLARE(int) sigar_remote_recv(sigar_remote_t *remote,
+                                     sigar_remote_response_t *response);
+
+/*
+ * answers requests read from fd until the other end closes it.
+ * responses to requests already read are written together, so a
+ * pipelining client gets them in as few writes as it sent requests.
+ */
+SIGAR_DECLARE(int) sigar_remote_serve(sigar_t *sigar, int fd);
+
+#endif /* SIGAR_REMOTE_H */
@@ -0,0 +1,93 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIGAR_RULES_H
+#define SIGAR_RULES_H
+
+#include "sigar_ptql.h"
+#include "sigar_sampler.h"
+
+/*
+ * threshold rules checked against sampler snapshots, handing back
+ * only the rules whose outcome changed.  a rule reads like a ptql
+ * branch, Class.Attr.op=value with eq, ne, gt, ge, lt or le and a
+ * number which may end in K, M, G or T (powers of 1024):
+ *
+ *   Cpu.{User,Sys,Nice,Idle,Wait,Irq,SoftIrq,Stolen}  percent
+ *   Mem.{Used,Free,ActualUsed,ActualFree}  bytes
+ *   Mem.{UsedPercent,FreePercent}
+ *   Swap.{Used,Free}  bytes
+ *   NetIf.{RxBytes,RxPackets,RxErrors,RxDropped,
+ *          TxBytes,TxPackets,TxErrors,TxDropped},Name.eq=eth0  per second
+ *   Disk.{Reads,Writes,ReadBytes,WriteBytes},Name.eq=sda  per second
+ *   Disk.{Queue,ServiceTime},Name.eq=sda
+ *   FileSystem.{UsePercent,Used,Free,Avail,FreeFiles},Dir.eq=/var
+ *   Tcp.{Established,SynSent,SynRecv,FinWait1,FinWait2,TimeWait,
+ *        Close,CloseWait,LastAck,Listen,Closing,Inbound,Outbound}
+ *   Proc.{Processes,Rss,Size,Cpu},<ptql>  summed over the matches
+ *
+ * Cpu, Mem, Swap, NetIf and Disk are read from the snapshot, the
+ * rates and percents against the one before.  FileSystem, Tcp and
+ * Proc are looked up with the sigar_t handed to sigar_rules_eval,
+ * once per evaluation however many rules use them.
+ */
+
+typedef struct sigar_rules_t sigar_rules_t;
+
+typedef struct {
+    int id;                  /* from sigar_rules_add */
+    int firing;              /* 1 when the rule became true, 0 cleared */
+    double value;            /* what was compared */
+    sigar_int64_t timestamp; /* of the snapshot */
+} sigar_rule_event_t;
+
+typedef struct {
+    unsigned long number;
+    unsigned long size;
+    sigar_rule_event_t *data;
+} sigar_rule_event_list_t;
+
+SIGAR_DECLARE(int) sigar_rules_create(sigar_rules_t **rules);
+
+SIGAR_DECLARE(int) sigar_rules_destroy(sigar_rules_t *rules);
+
+/* SIGAR_PTQL_MALFORMED_QUERY with error filled for a bad rule */
+SIGAR_DECLARE(int) sigar_rules_add(sigar_rules_t *rules,
+                                   const char *rule,
+                                   int *id,
+                                   sigar_ptql_error_t *error);
+
+/* sigar may be NULL, rules needing it are then left as they were */
+SIGAR_DECLARE(int) sigar_rules_eval(sigar_t *sigar,
+                                    sigar_rules_t *rules,
+                                    sigar_sampler_snapshot_t *snapshot,
+                                    sigar_rule_event_list_t *events);
+
+SIGAR_DECLARE(int)
+sigar_rule_event_list_destroy(sigar_rule_event_list_t *events);
+
+/*
+ * evaluates rules on the sampler thread after every round, events
+ * pile up until sigar_rules_events_take.  rules are not owned by the
+ * sampler, must outlive it and not be added to once it has started.
+ * NULL rules to stop, before start.
+ */
+SIGAR_DECLARE(int) sigar_sampler_rules_set(sigar_sampler_t *sampler,
+                                           sigar_rules_t *rules);
+
+/* every event since the last take, oldest first */
+SIGAR_DECLARE(int) sigar_rules_events_take(sigar_rules_t *rules,
+                                           sigar_rule_event_list_t *events);
+
+#endif /* SIGAR_RULES_H */
@@ -0,0 +1,283 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIGAR_SAMPLER_H
+#define SIGAR_SAMPLER_H
+
+/*
+ * a sampler owns its own sigar_t and collects a fixed set of metrics
+ * from a background thread every interval.  each round is published
+ * as an immutable snapshot; readers on any thread take the latest one
+ * with sigar_sampler_snapshot_acquire and hand it back with
+ * sigar_sampler_snapshot_release, neither of which locks or enters
+ * the kernel.
+ */
+
+#define SIGAR_SAMPLER_CPU      0x01
+#define SIGAR_SAMPLER_CPU_LIST 0x02
+#define SIGAR_SAMPLER_MEM      0x04
+#define SIGAR_SAMPLER_SWAP     0x08
+#define SIGAR_SAMPLER_NETIF    0x10
+#define SIGAR_SAMPLER_DISK     0x20
+#define SIGAR_SAMPLER_PROC     0x40
+#define SIGAR_SAMPLER_PERF     0x80
+/* opt-in, not in ALL: the tables are large on big boxes */
+#define SIGAR_SAMPLER_INTERRUPTS 0x100
+#define SIGAR_SAMPLER_SOFTIRQS   0x200
+
+#define SIGAR_SAMPLER_ALL \
+    (SIGAR_SAMPLER_CPU      | \
+     SIGAR_SAMPLER_CPU_LIST | \
+     SIGAR_SAMPLER_MEM      | \
+     SIGAR_SAMPLER_SWAP     | \
+     SIGAR_SAMPLER_NETIF    | \
+     SIGAR_SAMPLER_DISK     | \
+     SIGAR_SAMPLER_PROC     | \
+     SIGAR_SAMPLER_PERF)
+
+typedef struct sigar_sampler_t sigar_sampler_t;
+
+/* what a sigar_sampler_perf_add target counted since the round before */
+typedef struct {
+    sigar_uint64_t id; /* pid, or the cgroup id of sigar_cgroup_stat_t */
+    int cgroup;        /* 1 when id is a cgroup */
+    sigar_proc_perf_t perf;
+} sigar_proc_perf_entry_t;
+
+typedef struct {
+    unsigned long number;
+    unsigned long size;
+    sigar_proc_perf_entry_t *data;
+} sigar_proc_perf_list_t;
+
+typedef struct {
+    sigar_uint64_t generation; /* 1 for the first round */
+    sigar_int64_t timestamp;   /* millis, when the round started */
+    int flags;                 /* SIGAR_SAMPLER_* collected this round */
+    sigar_cpu_t cpu;
+    sigar_cpu_list_t cpulist;
+    sigar_mem_t mem;
+    sigar_swap_t swap;
+    sigar_net_interface_stat_list_t iflist;
+    sigar_disk_usage_list_t disklist;
+    sigar_proc_snapshot_t procs;
+    sigar_proc_perf_list_t perfs;
+    /*
+     * counts since the round before.  on the first round, for rows new
+     * since then and for every row after the cpus changed, since boot.
+     * not copied to the shm segment.
+     */
+    sigar_interrupt_list_t interrupts;
+    sigar_interrupt_list_t softirqs;
+} sigar_sampler_snapshot_t;
+
+SIGAR_DECLARE(int) sigar_sampler_create(sigar_sampler_t **sampler,
+                                        int flags,
+                                        sigar_uint64_t interval);
+
+/* SIGAR_PROC_SNAPSHOT_* used for SIGAR_SAMPLER_PROC, before start */
+SIGAR_DECLARE(int) sigar_sampler_proc_flags_set(sigar_sampler_t *sampler,
+                                                int flags);
+
+/*
+ * opens the hardware counters of pid, or of the cgroup at path, which
+ * SIGAR_SAMPLER_PERF then reads every round.  before start.
+ */
+SIGAR_DECLARE(int) sigar_sampler_perf_add(sigar_sampler_t *sampler,
+                                          sigar_pid_t pid);
+
+SIGAR_DECLARE(int) sigar_sampler_perf_cgroup_add(sigar_sampler_t *sampler,
+                                                 const char *path);
+
+/*
+ * caps the cpu time the sampler thread spends collecting at percent
+ * of one cpu per interval, 0 (the default) to collect everything
+ * every round.  each collector's cost is measured as it runs; over
+ * budget the one costing the most per round is collected every other
+ * time it was due, under budget the least often collected one is
+ * brought back, a step per round.  a due collector that would take
+ * the round over budget waits for the next unless it is already a
+ * period late, which staggers the expensive ones.  rounds a collector
+ * sat out leave it out of the snapshot flags.  before start.
+ */
+SIGAR_DECLARE(int) sigar_sampler_budget_set(sigar_sampler_t *sampler,
+                                            double percent);
+
+typedef struct {
+    sigar_uint64_t cost;      /* nanos of cpu time per run, smoothed */
+    sigar_uint64_t runs;
+    unsigned long period;     /* rounds between runs, 1 for every round */
+    sigar_int64_t collected;  /* millis, of the last round it was in */
+    sigar_uint64_t staleness; /* millis since then, NOTIMPL before it */
+} sigar_sampler_schedule_t;
+
+/* EINVAL unless collector is one SIGAR_SAMPLER_* flag of the sampler */
+SIGAR_DECLARE(int)
+sigar_sampler_schedule_get(sigar_sampler_t *sampler,
+                           int collector,
+                           sigar_sampler_schedule_t *schedule);
+
+/* collects the first round before returning, then starts the thread */
+SIGAR_DECLARE(int) sigar_sampler_start(sigar_sampler_t *sampler);
+
+SIGAR_DECLARE(int) sigar_sampler_stop(sigar_sampler_t *sampler);
+
+/* stops the sampler, no snapshot may still be held */
+SIGAR_DECLARE(int) sigar_sampler_destroy(sigar_sampler_t *sampler);
+
+/* NULL until the first round is published */
+SIGAR_DECLARE(sigar_sampler_snapshot_t *)
+sigar_sampler_snapshot_acquire(sigar_sampler_t *sampler);
+
+SIGAR_DECLARE(void)
+sigar_sampler_snapshot_release(sigar_sampler_t *sampler,
+                               sigar_sampler_snapshot_t *snapshot);
+
+/*
+ * blocks until a round newer than generation is published, ETIMEDOUT
+ * on every platform once timeout millis went by without one
+ */
+SIGAR_DECLARE(int) sigar_sampler_wait(sigar_sampler_t *sampler,
+                                      sigar_uint64_t generation,
+                                      int timeout);
+
+/*
+ * with a name set, each round is also copied into a shared memory
+ * segment of that size (0 for the default), which other processes
+ * attach read only to get the same snapshots without a sigar_t of
+ * their own.  sections which do not fit are left out of the round
+ * and its flags.  set before start; the segment goes with the sampler.
+ */
+#define SIGAR_SHM_SIZE_DEFAULT (4 * 1024 * 1024)
+
+SIGAR_DECLARE(int) sigar_sampler_shm_set(sigar_sampler_t *sampler,
+                                         const char *name,
+                                         sigar_uint64_t size);
+
+typedef struct sigar_shm_t sigar_shm_t;
+
+/* EAGAIN while the publisher is still setting the segment up */
+SIGAR_DECLARE(int) sigar_shm_attach(sigar_shm_t **shm, const char *name);
+
+SIGAR_DECLARE(int) sigar_shm_detach(sigar_shm_t *shm);
+
+/*
+ * copies the latest round into snapshot, ENOENT before the first
+ * one is published.  the lists are the caller's until
+ * sigar_shm_snapshot_destroy.
+ */
+SIGAR_DECLARE(int) sigar_shm_snapshot_get(sigar_shm_t *shm,
+                                          sigar_sampler_snapshot_t *snapshot);
+
+SIGAR_DECLARE(int)
+sigar_shm_snapshot_destroy(sigar_shm_t *shm,
+                           sigar_sampler_snapshot_t *snapshot);
+
+/*
+ * a tsdb keeps a bounded history of one value per series and round:
+ * cpu time as a percent of the round, memory in bytes, and netif and
+ * disk counters as per second rates.  each tier folds step rounds
+ * into one min, max and avg point and keeps the latest points of
+ * those, e.g. 1/10/60 for 1s, 10s and 1m points with a 1s sampler.
+ * the first ifaces_max interfaces and disks_max disks seen get series
+ * of their own, the rest are left out.
+ */
+#define SIGAR_TSDB_CPU_USER         0
+#define SIGAR_TSDB_CPU_SYS          1
+#define SIGAR_TSDB_CPU_NICE         2
+#define SIGAR_TSDB_CPU_IDLE         3
+#define SIGAR_TSDB_CPU_WAIT         4
+#define SIGAR_TSDB_CPU_IRQ          5
+#define SIGAR_TSDB_CPU_SOFT_IRQ     6
+#define SIGAR_TSDB_CPU_STOLEN       7
+#define SIGAR_TSDB_MEM_USED         8
+#define SIGAR_TSDB_MEM_ACTUAL_USED  9
+#define SIGAR_TSDB_MEM_ACTUAL_FREE  10
+#define SIGAR_TSDB_SWAP_USED        11
+/* per interface name */
+#define SIGAR_TSDB_NETIF_RX_BYTES   12
+#define SIGAR_TSDB_NETIF_RX_PACKETS 13
+#define SIGAR_TSDB_NETIF_TX_BYTES   14
+#define SIGAR_TSDB_NETIF_TX_PACKETS 15
+#define SIGAR_TSDB_NETIF_RX_ERRORS  16
+#define SIGAR_TSDB_NETIF_TX_ERRORS  17
+/* per disk name */
+#define SIGAR_TSDB_DISK_READS       18
+#define SIGAR_TSDB_DISK_WRITES      19
+#define SIGAR_TSDB_DISK_READ_BYTES  20
+#define SIGAR_TSDB_DISK_WRITE_BYTES 21
+#define SIGAR_TSDB_SERIES_MAX       22
+
+#define SIGAR_TSDB_TIERS_MAX 4
+
+typedef struct {
+    unsigned long step;   /* rounds folded into one point */
+    unsigned long points; /* points kept */
+} sigar_tsdb_tier_t;
+
+typedef struct {
+    int ntiers;
+    sigar_tsdb_tier_t tiers[SIGAR_TSDB_TIERS_MAX];
+    int ifaces_max;
+    int disks_max;
+} sigar_tsdb_opts_t;
+
+typedef struct sigar_tsdb_t sigar_tsdb_t;
+
+typedef struct {
+    unsigned long number;
+    sigar_int64_t *timestamp; /* millis, of the last round in the point */
+    double *min;
+    double *max;
+    double *avg;
+} sigar_tsdb_range_t;
+
+/* opts NULL for 300 1s, 360 10s and 1440 1m points, 8 ifaces, 8 disks */
+SIGAR_DECLARE(int) sigar_tsdb_create(sigar_tsdb_t **tsdb,
+                                     const sigar_tsdb_opts_t *opts);
+
+SIGAR_DECLARE(int) sigar_tsdb_destroy(sigar_tsdb_t *tsdb);
+
+/* what sigar_sampler_tsdb_set does with each round */
+SIGAR_DECLARE(int) sigar_tsdb_add(sigar_tsdb_t *tsdb,
+                                  sigar_sampler_snapshot_t *snapshot);
+
+/*
+ * the points of series in tier with a timestamp within start and end,
+ * oldest first, skipping those the series had no value in.  name is
+ * the interface or disk for their series, NULL for the others, ENOENT
+ * if never seen.
+ */
+SIGAR_DECLARE(int) sigar_tsdb_range_get(sigar_tsdb_t *tsdb,
+                                        int tier,
+                                        int series,
+                                        const char *name,
+                                        sigar_int64_t start,
+                                        sigar_int64_t end,
+                                        sigar_tsdb_range_t *range);
+
+SIGAR_DECLARE(int) sigar_tsdb_range_destroy(sigar_tsdb_range_t *range);
+
+/*
+ * feeds every round into a tsdb the sampler owns, opts as for
+ * sigar_tsdb_create.  set before start, NULL opts for the defaults.
+ */
+SIGAR_DECLARE(int) sigar_sampler_tsdb_set(sigar_sampler_t *sampler,
+                                          const sigar_tsdb_opts_t *opts);
+
+/* NULL without sigar_sampler_tsdb_set, goes with the sampler */
+SIGAR_DECLARE(sigar_tsdb_t *)
+sigar_sampler_tsdb_get(sigar_sampler_t *sampler);
+
+#endif /* SIGAR_SAMPLER_H */
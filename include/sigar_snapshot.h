@@ -0,0 +1,115 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIGAR_SNAPSHOT_H
+#define SIGAR_SNAPSHOT_H
+
+/*
+ * recording of process, connection and disk snapshots.  a file is a
+ * sequence of frames, one per sigar_snapshot_write, each stored a
+ * column at a time with every value as a varint delta from the row
+ * before, followed by an index of the frames once the writer is
+ * closed.  readers map the file and decode any frame on its own.
+ */
+
+#define SIGAR_SNAPSHOT_PROC 0x01 /* sigar_proc_snapshot_get */
+#define SIGAR_SNAPSHOT_NET  0x02 /* sigar_net_connection_list_get */
+#define SIGAR_SNAPSHOT_DISK 0x04 /* sigar_disk_usage_list_get */
+
+#define SIGAR_SNAPSHOT_ALL \
+    (SIGAR_SNAPSHOT_PROC | \
+     SIGAR_SNAPSHOT_NET  | \
+     SIGAR_SNAPSHOT_DISK)
+
+typedef struct {
+    sigar_int64_t timestamp; /* millis */
+    int flags;               /* SIGAR_SNAPSHOT_* sections present */
+    sigar_proc_snapshot_t procs;
+    sigar_net_connection_list_t connections;
+    sigar_disk_usage_list_t disks;
+} sigar_snapshot_t;
+
+/*
+ * collects the sections in flags: every SIGAR_PROC_SNAPSHOT_ALL
+ * field and all tcp and udp connections.  a section the platform
+ * does not have is left out of snapshot->flags.
+ */
+SIGAR_DECLARE(int) sigar_snapshot_get(sigar_t *sigar, int flags,
+                                      sigar_snapshot_t *snapshot);
+
+/* sigar may be NULL, as for snapshots from sigar_snapshot_read */
+SIGAR_DECLARE(int) sigar_snapshot_destroy(sigar_t *sigar,
+                                          sigar_snapshot_t *snapshot);
+
+/*
+ * one frame as it would be written to a file, in memory for sending
+ * elsewhere.  *data is malloced, free when done.
+ */
+SIGAR_DECLARE(int) sigar_snapshot_encode(sigar_snapshot_t *snapshot,
+                                         unsigned char **data,
+                                         size_t *len);
+
+/* the frame at data, len may run past its end */
+SIGAR_DECLARE(int) sigar_snapshot_decode(const unsigned char *data,
+                                         size_t len,
+                                         sigar_snapshot_t *snapshot);
+
+typedef struct sigar_snapshot_writer_t sigar_snapshot_writer_t;
+
+/* truncates path */
+SIGAR_DECLARE(int)
+sigar_snapshot_writer_open(sigar_snapshot_writer_t **writer,
+                           const char *path);
+
+SIGAR_DECLARE(int) sigar_snapshot_write(sigar_snapshot_writer_t *writer,
+                                        sigar_snapshot_t *snapshot);
+
+/* appends the frame index, a file without one is scanned on open */
+SIGAR_DECLARE(int)
+sigar_snapshot_writer_close(sigar_snapshot_writer_t *writer);
+
+typedef struct sigar_snapshot_reader_t sigar_snapshot_reader_t;
+
+SIGAR_DECLARE(int)
+sigar_snapshot_reader_open(sigar_snapshot_reader_t **reader,
+                           const char *path);
+
+SIGAR_DECLARE(int)
+sigar_snapshot_reader_close(sigar_snapshot_reader_t *reader);
+
+SIGAR_DECLARE(unsigned long)
+sigar_snapshot_count(sigar_snapshot_reader_t *reader);
+
+/* index of the last frame at or before timestamp, -1 if none */
+SIGAR_DECLARE(long)
+sigar_snapshot_find(sigar_snapshot_reader_t *reader,
+                    sigar_int64_t timestamp);
+
+/* decodes frame index, sigar_snapshot_destroy when done */
+SIGAR_DECLARE(int) sigar_snapshot_read(sigar_snapshot_reader_t *reader,
+                                       unsigned long index,
+                                       sigar_snapshot_t *snapshot);
+
+/*
+ * serves sigar_proc_list_get, sigar_proc_snapshot_get,
+ * sigar_net_connection_list_get and sigar_disk_usage_list_get from
+ * frame index of reader instead of the system, until called with a
+ * NULL reader.  the frame is decoded up front, so the reader may be
+ * closed while the replay goes on.
+ */
+SIGAR_DECLARE(int) sigar_snapshot_replay_set(sigar_t *sigar,
+                                             sigar_snapshot_reader_t *reader,
+                                             unsigned long index);
+
+#endif /* SIGAR_SNAPSHOT_H */
@@ -46,6 +46,9 @@
 #define sigar_tolower(c) \
     (tolower(((unsigned char)(c))))
 
+#define sigar_toupper(c) \
+    (toupper(((unsigned char)(c))))
+
 #ifdef WIN32
 #define sigar_fileno _fileno
 #define sigar_isatty _isatty
@@ -81,12 +84,82 @@ SIGAR_INLINE char *sigar_skip_token(char *p);
 
 SIGAR_INLINE char *sigar_skip_multiple_token(char *p, int count);
 
+/*
+ * shared /proc tokenizer.
+ * keyed formats ("Key: value" lines, e.g. /proc/<pid>/status):
+ * the key includes whatever ends it (':' or ' ') and must start a
+ * line, value is left pointing just past it or NULL if missing.
+ */
+typedef struct {
+    const char *key;
+    int len;
+    char *value;
+} sigar_keyval_t;
+
+#define SIGAR_KEYVAL(key) { key, SSTRLEN(key), NULL }
+
+/* fills in every key's value, returns how many were found */
+int sigar_keyval_scan(char *buffer, sigar_keyval_t *keys, int num);
+
+/*
+ * column formats (whitespace separated, one row per line,
+ * e.g. /proc/diskstats): end bounds every read, so runs of
+ * blanks can be skipped a word at a time.
+ */
+char *sigar_scan_blanks(char *ptr, char *end);
+
+/* past the current field and the blanks after it */
+char *sigar_scan_field(char *ptr, char *end);
+
+/* start of the next line, or end */
+char *sigar_scan_eol(char *ptr, char *end);
+
+/* up to max decimal columns ('-' allowed, stored two's complement),
+ * stops at the first field that is not a number */
+int sigar_scan_columns(char **ptr, char *end,
+                       sigar_uint64_t *fields, int max);
+
+/* the same for unsigned counters only, faster on wide blank padded
+ * tables such as /proc/interrupts.  *ptr is left past the last one */
+int sigar_scan_counters(char **ptr, char *end,
+                        sigar_uint64_t *fields, int max);
+
+/* one hex field, stops at the first non hex digit */
+sigar_uint64_t sigar_scan_hex(char **ptr, char *end);
+
+/* exactly 32 hex digits (either case, unchecked) into 16 bytes */
+void sigar_hex_decode16(const char *hex, unsigned char *bin);
+
+/* the same as four 8 digit words, "0100007F" is 0x0100007f */
+void sigar_hex_decode128(const char *hex, sigar_uint32_t *words);
+
 char *sigar_getword(char **line, char stop);
 
 char *sigar_strcasestr(const char *s1, const char *s2);
 
 int sigar_file2str(const char *fname, char *buffer, int buflen);
 
+/* PROCP_FS_ROOT unless SIGAR_PROC_ROOT says otherwise,
+ * always ends in '/' */
+int sigar_procfs_root_set(const char *root);
+
+const char *sigar_procfs_root_get(void);
+
+/* fname is relative to the procfs root, e.g. "meminfo" */
+char *sigar_procfs_filename(char *buffer, int buflen,
+                            const char *fname, int fname_len);
+
+int sigar_procfs_file2str(const char *fname, int fname_len,
+                          char *buffer, int buflen);
+
+#define SIGAR_PROCFS_FILENAME(buffer, fname) \
+    sigar_procfs_filename(buffer, sizeof(buffer), \
+                          fname, SSTRLEN(fname))
+
+#define SIGAR_PROCFS_FILE2STR(fname, buffer) \
+    sigar_procfs_file2str(fname, SSTRLEN(fname), \
+                          buffer, sizeof(buffer))
+
 int sigar_proc_file2str(char *buffer, int buflen,
                         sigar_pid_t pid,
                         const char *fname,
@@ -117,6 +190,19 @@ int sigar_proc_fd_count(sigar_t *sigar, sigar_pid_t pid,
 int sigar_procfs_args_get(sigar_t *sigar, sigar_pid_t pid,
                           sigar_proc_args_t *procargs);
 
+/* entry is nul terminated and only valid during the call,
+ * anything but SIGAR_OK stops the read */
+typedef int (*sigar_procfs_entry_getter_t)(void *data, char *entry, int len);
+
+/*
+ * reads a file of sep separated entries, e.g. '\0' for cmdline and
+ * environ or '\n' for maps, in chunks through sigar->procfs_buf,
+ * which only grows to the longest entry.
+ */
+int sigar_procfs_entries_get(sigar_t *sigar, const char *fname, int sep,
+                             sigar_procfs_entry_getter_t getter,
+                             void *data);
+
 int sigar_mem_calc_ram(sigar_t *sigar, sigar_mem_t *mem);
 
 int sigar_statvfs(sigar_t *sigar,
@@ -164,6 +250,21 @@ char *sigar_get_self_path(sigar_t *sigar);
 int sigar_dlinfo_modules(sigar_t *sigar, sigar_proc_modules_t *procmods);
 #endif
 
+typedef struct sigar_pool_t sigar_pool_t;
+
+sigar_pool_t *sigar_pool_new(size_t size, unsigned int per_slab);
+
+void *sigar_pool_alloc(sigar_pool_t *pool);
+
+void sigar_pool_free(sigar_pool_t *pool, void *obj);
+
+/* bytes of each object, size rounded up to the alignment */
+size_t sigar_pool_size(sigar_pool_t *pool);
+
+size_t sigar_pool_bytes(sigar_pool_t *pool);
+
+void sigar_pool_destroy(sigar_pool_t *pool);
+
 typedef struct sigar_cache_entry_t sigar_cache_entry_t;
 
 struct sigar_cache_entry_t {
@@ -173,17 +274,35 @@ struct sigar_cache_entry_t {
     sigar_uint64_t last_access_time;
 };
 
+/* flat array of entries w/ linear probing instead of chained buckets */
+#define SIGAR_CACHE_OPEN_ADDRESSING 0x01
+
+/* expire a few buckets per access instead of sweeping the whole table */
+#define SIGAR_CACHE_INCREMENTAL_CLEANUP 0x02
+
+#define SIGAR_CACHE_CLEANUP_STEP 16
+
 typedef struct {
-    sigar_cache_entry_t **entries;
+    sigar_cache_entry_t **entries; /* chained buckets */
+    sigar_cache_entry_t *slots;    /* SIGAR_CACHE_OPEN_ADDRESSING */
     unsigned int count, size;
+    int flags;
     void (*free_value)(void *ptr);
+    sigar_pool_t *value_pool; /* not owned, values go back here if set */
     sigar_uint64_t entry_expire_period;
     sigar_uint64_t cleanup_period_millis;
     sigar_uint64_t last_cleanup_time;
+    unsigned int cleanup_cursor; /* SIGAR_CACHE_INCREMENTAL_CLEANUP */
+    int cleanup_active;
+    sigar_uint64_t evictions;
+    sigar_uint64_t hits, misses;
 } sigar_cache_t;
 
 sigar_cache_t *sigar_cache_new(int size);
 sigar_cache_t *sigar_expired_cache_new(int size, sigar_uint64_t cleanup_period_millis, sigar_uint64_t entry_expire_period);
+sigar_cache_t *sigar_cache_create(int size, int flags,
+                                  sigar_uint64_t cleanup_period_millis,
+                                  sigar_uint64_t entry_expire_period);
 void sigar_cache_dump(sigar_cache_t *table);
 
 sigar_cache_entry_t *sigar_cache_get(sigar_cache_t *table,
@@ -192,6 +311,21 @@ sigar_cache_entry_t *sigar_cache_get(sigar_cache_t *table,
 sigar_cache_entry_t *sigar_cache_find(sigar_cache_t *table,
                                       sigar_uint64_t key);
 
+void sigar_cache_remove(sigar_cache_t *table, sigar_uint64_t key);
+
 void sigar_cache_destroy(sigar_cache_t *table);
 
+/* every entry, in no particular order; the table must not change */
+void sigar_cache_walk(sigar_cache_t *table,
+                      void (*walker)(sigar_cache_entry_t *entry, void *data),
+                      void *data);
+
+/*
+ * zeroed value from table->value_pool if set, else malloc.  NULL if
+ * size is more than a pool object holds: it could not go back there.
+ */
+void *sigar_cache_value_new(sigar_cache_t *table, size_t size);
+
+void sigar_cache_stats(sigar_cache_t *table, sigar_cache_stats_t *stats);
+
 #endif /* SIGAR_UTIL_H */
@@ -150,9 +150,25 @@ static int sigar_thread_rusage(struct rusage *usage, int mode)
     return pthread_getrusage_np(pthread_self(), usage, mode);
 }
 
-static int sigar_perfstat_memory(perfstat_memory_total_t *memory)
+static int sigar_perfstat_memory(sigar_t *sigar,
+                                 perfstat_memory_total_t *memory)
 {
-    return perfstat_memory_total(NULL, memory, sizeof(*memory), 1);
+    perfstat_poll_t *poll = &sigar->perfstat;
+    sigar_uint64_t now = sigar_time_now_millis();
+
+    /* shared by mem_get and swap_get within the same poll */
+    if ((now - poll->memory_mtime) > SIGAR_BUFFER_EXPIRE) {
+        if (perfstat_memory_total(NULL, &poll->memory,
+                                  sizeof(poll->memory), 1) != 1)
+        {
+            return -1;
+        }
+        poll->memory_mtime = now;
+    }
+
+    memcpy(memory, &poll->memory, sizeof(*memory));
+
+    return 1;
 }
 
 static int sigar_perfstat_cpu(perfstat_cpu_total_t *cpu_total)
@@ -160,6 +176,78 @@ static int sigar_perfstat_cpu(perfstat_cpu_total_t *cpu_total)
     return perfstat_cpu_total(NULL, cpu_total, sizeof(*cpu_total), 1);
 }
 
+typedef int (*perfstat_list_func_t)(perfstat_id_t *, void *, int, int);
+
+/*
+ * fetch every element of a perfstat_* type with a single
+ * multi-element call into a buffer which is reused across polls.
+ * results are shared by all getters until SIGAR_BUFFER_EXPIRE.
+ */
+static int perfstat_list_get(perfstat_list_t *list,
+                             perfstat_list_func_t func,
+                             int elsize)
+{
+    perfstat_id_t id;
+    int total, num;
+    sigar_uint64_t now = sigar_time_now_millis();
+
+    if (list->data && ((now - list->mtime) <= SIGAR_BUFFER_EXPIRE)) {
+        return SIGAR_OK;
+    }
+
+    if ((total = func(NULL, NULL, elsize, 0)) < 0) {
+        return errno;
+    }
+
+    if (total > list->size) {
+        list->data = realloc(list->data, total * elsize);
+        list->size = total;
+    }
+
+    id.name[0] = '\0'; /* FIRST_CPU, FIRST_DISK, ... */
+
+    if (total == 0) {
+        num = 0;
+    }
+    else if ((num = func(&id, list->data, elsize, total)) < 0) {
+        list->number = 0;
+        return errno;
+    }
+
+    list->number = num;
+    list->mtime = now;
+
+    return SIGAR_OK;
+}
+
+#define PERFSTAT_LIST_GET(sigar, name, func, type) \
+    perfstat_list_get(&(sigar)->perfstat.name, \
+                      (perfstat_list_func_t)func, sizeof(type))
+
+static void perfstat_list_free(perfstat_list_t *list)
+{
+    if (list->data) {
+        free(list->data);
+    }
+    SIGAR_ZERO(list);
+}
+
+static void *perfstat_list_find(perfstat_list_t *list,
+                                const char *name, int elsize)
+{
+    int i;
+    char *ptr = (char *)list->data;
+
+    /* name is the first member of each perfstat_*_t */
+    for (i=0; i<list->number; i++, ptr += elsize) {
+        if (strEQ(ptr, name)) {
+            return ptr;
+        }
+    }
+
+    return NULL;
+}
+
 int sigar_os_open(sigar_t **sigar)
 {
     int status, i;
@@ -206,6 +294,8 @@ int sigar_os_open(sigar_t **sigar)
 
     (*sigar)->diskmap = NULL;
 
+    SIGAR_ZERO(&(*sigar)->perfstat);
+
     return SIGAR_OK;
 }
 
@@ -226,6 +316,10 @@ int sigar_os_close(sigar_t *sigar)
     if (sigar->diskmap) {
         sigar_cache_destroy(sigar->diskmap);
     }
+    perfstat_list_free(&sigar->perfstat.cpu);
+    perfstat_list_free(&sigar->perfstat.disk);
+    perfstat_list_free(&sigar->perfstat.netif);
+    perfstat_list_free(&sigar->perfstat.pagingspace);
     if (sigar->thrusage == PTHRDSINFO_RUSAGE_START) {
         struct rusage usage;
         sigar_thread_rusage(&usage,
@@ -254,7 +348,7 @@ int sigar_mem_get(sigar_t *sigar, sigar_mem_t *mem)
     perfstat_memory_total_t minfo;
     sigar_uint64_t kern;
 
-    if (sigar_perfstat_memory(&minfo) == 1) {
+    if (sigar_perfstat_memory(sigar, &minfo) == 1) {
         mem->total = PAGESHIFT(minfo.real_total);
         mem->free  = PAGESHIFT(minfo.real_free);
         kern = PAGESHIFT(minfo.numperm); /* number of pages in file cache */
@@ -424,23 +518,28 @@ static int sigar_swap_get_swapqry(sigar_t *sigar, sigar_swap_t *swap)
 int sigar_swap_get(sigar_t *sigar, sigar_swap_t *swap)
 {
     perfstat_memory_total_t minfo;
-    perfstat_pagingspace_t ps;
-    perfstat_id_t id;
-
-    id.name[0] = '\0';
+    perfstat_pagingspace_t *pss;
+    int i, status;
 
     SIGAR_ZERO(swap);
 
-    do {
-        if (perfstat_pagingspace(&id, &ps, sizeof(ps), 1) != 1) {
-            if (SIGAR_LOG_IS_DEBUG(sigar)) {
-                sigar_log_printf(sigar, SIGAR_LOG_DEBUG,
-                                 "[swap] dev=%s query failed: %s",
-                                 SWAP_DEV(ps),
-                                 sigar_strerror(sigar, errno));
-            }
-            continue;
+    status = PERFSTAT_LIST_GET(sigar, pagingspace,
+                               perfstat_pagingspace,
+                               perfstat_pagingspace_t);
+
+    if (status != SIGAR_OK) {
+        if (SIGAR_LOG_IS_DEBUG(sigar)) {
+            sigar_log_printf(sigar, SIGAR_LOG_DEBUG,
+                             "[swap] perfstat_pagingspace failed: %s",
+                             sigar_strerror(sigar, status));
         }
+    }
+
+    pss = (perfstat_pagingspace_t *)sigar->perfstat.pagingspace.data;
+
+    for (i=0; i<sigar->perfstat.pagingspace.number; i++) {
+        perfstat_pagingspace_t ps = pss[i];
+
         if (SIGAR_LOG_IS_DEBUG(sigar)) {
             sigar_log_printf(sigar, SIGAR_LOG_DEBUG,
                              "[swap] dev=%s: active=%s, "
@@ -455,11 +554,11 @@ int sigar_swap_get(sigar_t *sigar, sigar_swap_t *swap)
         /* convert MB sizes to bytes */
         swap->total += SWAP_MB_TO_BYTES(ps.mb_size);
         swap->used  += SWAP_MB_TO_BYTES(ps.mb_used);
-    } while (id.name[0] != '\0');
+    }
 
     swap->free = swap->total - swap->used;
 
-    if (sigar_perfstat_memory(&minfo) == 1) {
+    if (sigar_perfstat_memory(sigar, &minfo) == 1) {
         swap->page_in = minfo.pgins;
         swap->page_out = minfo.pgouts;
     }
@@ -520,44 +619,39 @@ int sigar_cpu_get(sigar_t *sigar, sigar_cpu_t *cpu)
 
 int sigar_cpu_list_get(sigar_t *sigar, sigar_cpu_list_t *cpulist)
 {
-    perfstat_cpu_t data;
-    int i, ncpu = _system_configuration.ncpus; /* this can change */
-    perfstat_id_t id;
+    perfstat_cpu_t *cpus;
+    int i, status;
+
+    status = PERFSTAT_LIST_GET(sigar, cpu, perfstat_cpu, perfstat_cpu_t);
+
+    if (status != SIGAR_OK) {
+        sigar_log_printf(sigar, SIGAR_LOG_ERROR,
+                         "perfstat_cpu failed: %s",
+                         sigar_strerror(sigar, status));
+        return status;
+    }
 
-    id.name[0] = '\0';
+    cpus = (perfstat_cpu_t *)sigar->perfstat.cpu.data;
 
     sigar_cpu_list_create(cpulist);
 
-    for (i=0; i<ncpu; i++) {
+    for (i=0; i<sigar->perfstat.cpu.number; i++) {
+        perfstat_cpu_t *data = &cpus[i];
         sigar_cpu_t *cpu;
 
         SIGAR_CPU_LIST_GROW(cpulist);
 
         cpu = &cpulist->data[cpulist->number++];
 
-        if (SIGAR_LOG_IS_DEBUG(sigar)) {
-            sigar_log_printf(sigar, SIGAR_LOG_DEBUG,
-                             "cpu%d perfstat_id='%s'",
-                             i, id.name);
-        }
-
-        if (perfstat_cpu(&id, &data, sizeof(data), 1) == 1) {
-            cpu->user  = SIGAR_TICK2MSEC(data.user);
-            cpu->nice  = SIGAR_FIELD_NOTIMPL; /* N/A */
-            cpu->sys   = SIGAR_TICK2MSEC(data.sys);
-            cpu->idle  = SIGAR_TICK2MSEC(data.idle);
-            cpu->wait  = SIGAR_TICK2MSEC(data.wait);
-            cpu->irq = 0; /*N/A*/
-            cpu->soft_irq = 0; /*N/A*/
-            cpu->stolen = 0; /*N/A*/
-            cpu->total = cpu->user + cpu->sys + cpu->idle + cpu->wait;
-        }
-        else {
-            sigar_log_printf(sigar, SIGAR_LOG_ERROR,
-                             "cpu%d perfstat_cpu(%s) failed: %s",
-                             i, id.name, sigar_strerror(sigar, errno));
-            SIGAR_ZERO(cpu);
-        }
+        cpu->user  = SIGAR_TICK2MSEC(data->user);
+        cpu->nice  = SIGAR_FIELD_NOTIMPL; /* N/A */
+        cpu->sys   = SIGAR_TICK2MSEC(data->sys);
+        cpu->idle  = SIGAR_TICK2MSEC(data->idle);
+        cpu->wait  = SIGAR_TICK2MSEC(data->wait);
+        cpu->irq = 0; /*N/A*/
+        cpu->soft_irq = 0; /*N/A*/
+        cpu->stolen = 0; /*N/A*/
+        cpu->total = cpu->user + cpu->sys + cpu->idle + cpu->wait;
     }
 
     return SIGAR_OK;
@@ -1226,23 +1320,16 @@ typedef struct {
 
 static int create_diskmap(sigar_t *sigar)
 {
-    int i, total, num;
+    int i, num, status;
     perfstat_disk_t *disk;
-    perfstat_id_t id;
 
-    total = perfstat_disk(NULL, NULL, sizeof(*disk), 0);
-    if (total < 1) {
+    status = PERFSTAT_LIST_GET(sigar, disk, perfstat_disk, perfstat_disk_t);
+    num = sigar->perfstat.disk.number;
+    if ((status != SIGAR_OK) || (num < 1)) {
         return ENOENT;
     }
 
-    disk = malloc(total * sizeof(*disk));
-    id.name[0] = '\0';
-
-    num = perfstat_disk(&id, disk, sizeof(*disk), total);
-    if (num < 1) {
-        free(disk);
-        return ENOENT;
-    }
+    disk = (perfstat_disk_t *)sigar->perfstat.disk.data;
 
     sigar->diskmap = sigar_cache_new(25);
 
@@ -1286,7 +1373,6 @@ static int create_diskmap(sigar_t *sigar)
         odm_free_list(dv, &info);
     }
 
-    free(disk);
     odm_terminate();
 
     return SIGAR_OK;
@@ -1295,21 +1381,27 @@ static int create_diskmap(sigar_t *sigar)
 int sigar_disk_usage_get(sigar_t *sigar, const char *name,
                          sigar_disk_usage_t *usage)
 {
-    perfstat_disk_t disk;
-    perfstat_id_t id;
+    perfstat_disk_t *disk;
+    int status;
+
+    status = PERFSTAT_LIST_GET(sigar, disk, perfstat_disk, perfstat_disk_t);
+
+    if (status != SIGAR_OK) {
+        return status;
+    }
 
-    SIGAR_SSTRCPY(id.name, name);
+    disk = perfstat_list_find(&sigar->perfstat.disk, name, sizeof(*disk));
 
-    if (perfstat_disk(&id, &disk, sizeof(disk), 1) != 1) {
+    if (!disk) {
         return ENXIO;
     }
 
-    usage->reads = disk.rblks;
-    usage->writes = disk.wblks;
-    usage->read_bytes  = disk.rblks * disk.bsize;
-    usage->write_bytes = disk.wblks * disk.bsize;
-    usage->queue       = disk.qdepth;
-    usage->time        = disk.time;
+    usage->reads = disk->rblks;
+    usage->writes = disk->wblks;
+    usage->read_bytes  = disk->rblks * disk->bsize;
+    usage->write_bytes = disk->wblks * disk->bsize;
+    usage->queue       = disk->qdepth;
+    usage->time        = disk->time;
     usage->rtime       = SIGAR_FIELD_NOTIMPL;
     usage->wtime       = SIGAR_FIELD_NOTIMPL;
 
@@ -1612,14 +1704,23 @@ int sigar_net_interface_stat_get(sigar_t *sigar,
                                  const char *name,
                                  sigar_net_interface_stat_t *ifstat)
 {
-    perfstat_id_t id;
-    perfstat_netinterface_t data;
+    perfstat_netinterface_t *ptr;
+    int status;
 
     sigar_log(sigar, SIGAR_LOG_DEBUG, "[ifstat] using libperfstat");
 
-    SIGAR_SSTRCPY(id.name, name);
+    status = PERFSTAT_LIST_GET(sigar, netif, perfstat_netinterface,
+                               perfstat_netinterface_t);
+
+    if (status != SIGAR_OK) {
+        return status;
+    }
+
+    ptr = perfstat_list_find(&sigar->perfstat.netif, name, sizeof(*ptr));
+
+    if (ptr) {
+        perfstat_netinterface_t data = *ptr;
 
-    if (perfstat_netinterface(&id, &data, sizeof(data), 1) == 1) {
         ifstat->rx_bytes      = data.ibytes;
         ifstat->rx_packets    = data.ipackets;
         ifstat->rx_errors     = data.ierrors;
@@ -1640,7 +1741,7 @@ int sigar_net_interface_stat_get(sigar_t *sigar,
         return SIGAR_OK;
     }
     else {
-        return errno;
+        return ENXIO;
     }
 }
 
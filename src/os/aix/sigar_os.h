@@ -24,6 +24,7 @@
 #include <dlfcn.h>
 #include <procinfo.h>
 #include <sys/resource.h>
+#include <libperfstat.h>
 
 enum {
     KOFFSET_LOADAVG,
@@ -44,6 +45,23 @@ typedef struct {
     char **devs;
 } swaps_t;
 
+/* perfstat_* array filled by one multi-element call per poll */
+typedef struct {
+    sigar_uint64_t mtime;
+    int number;
+    int size;
+    void *data;
+} perfstat_list_t;
+
+typedef struct {
+    sigar_uint64_t memory_mtime;
+    perfstat_memory_total_t memory;
+    perfstat_list_t cpu;
+    perfstat_list_t disk;
+    perfstat_list_t netif;
+    perfstat_list_t pagingspace;
+} perfstat_poll_t;
+
 typedef int (*proc_fd_func_t) (sigar_t *, sigar_pid_t, sigar_proc_fd_t *);
 
 struct sigar_t {
@@ -64,6 +82,7 @@ struct sigar_t {
     int aix_version;
     int thrusage;
     sigar_cache_t *diskmap; 
+    perfstat_poll_t perfstat;
 };
 
 #define HAVE_STRERROR_R
@@ -240,11 +240,19 @@ int sigar_os_open(sigar_t **sigar)
 
 #ifdef DARWIN
     (*sigar)->mach_port = mach_host_self();
+    memset(&(*sigar)->mach, 0, sizeof((*sigar)->mach));
 #  ifdef DARWIN_HAS_LIBPROC_H
     if (((*sigar)->libproc = dlopen("/usr/lib/libproc.dylib", 0))) {
         (*sigar)->proc_pidinfo = dlsym((*sigar)->libproc, "proc_pidinfo");
         (*sigar)->proc_pidfdinfo = dlsym((*sigar)->libproc, "proc_pidfdinfo");
+        (*sigar)->proc_pid_rusage = dlsym((*sigar)->libproc, "proc_pid_rusage");
     }
+    else {
+        (*sigar)->proc_pid_rusage = NULL;
+    }
+    (*sigar)->proc_port_index = NULL;
+    (*sigar)->proc_port_pool = NULL;
+    (*sigar)->proc_port_index_time = 0;
 #  endif
 #else
     (*sigar)->kmem = kvm_open(NULL, NULL, NULL, O_RDONLY, NULL);
@@ -274,6 +282,10 @@ int sigar_os_open(sigar_t **sigar)
     (*sigar)->last_pid = -1;
 
     (*sigar)->pinfo = NULL;
+    (*sigar)->procs = NULL;
+    (*sigar)->procs_size = 0;
+    (*sigar)->pcb_buf = NULL;
+    (*sigar)->pcb_size = 0;
 
     return SIGAR_OK;
 }
@@ -283,7 +295,26 @@ int sigar_os_close(sigar_t *sigar)
     if (sigar->pinfo) {
         free(sigar->pinfo);
     }
-#ifndef DARWIN
+    if (sigar->procs) {
+        free(sigar->procs);
+    }
+    if (sigar->pcb_buf) {
+        free(sigar->pcb_buf);
+    }
+#ifdef DARWIN
+    if (sigar->mach.cpus) {
+        free(sigar->mach.cpus);
+    }
+#  ifdef DARWIN_HAS_LIBPROC_H
+    if (sigar->proc_port_index) {
+        sigar_cache_destroy(sigar->proc_port_index);
+    }
+    if (sigar->proc_port_pool) {
+        sigar_pool_destroy(sigar->proc_port_pool);
+    }
+#  endif
+    mach_port_deallocate(mach_task_self(), sigar->mach_port);
+#else
     if (sigar->kmem) {
         kvm_close(sigar->kmem);
     }
@@ -326,21 +357,62 @@ static size_t sigar_argmax_get(sigar_t *sigar)
 #endif /* DARWIN */
 
 #if defined(DARWIN)
-static int sigar_vmstat(sigar_t *sigar, vm_statistics_data_t *vmstat)
+/* one host_statistics per SIGAR_BUFFER_EXPIRE for mem and swap together */
+static int sigar_vmstat(sigar_t *sigar, sigar_vmstat_t *vmstat)
 {
     kern_return_t status;
+    sigar_mach_t *mach = &sigar->mach;
     mach_msg_type_number_t count = sizeof(*vmstat) / sizeof(integer_t);
+    sigar_uint64_t timenow = sigar_time_now_millis();
 
-    status = host_statistics(sigar->mach_port, HOST_VM_INFO,
-                             (host_info_t)vmstat, &count);
-
-    if (status == KERN_SUCCESS) {
+    if (mach->vmstat_time &&
+        ((timenow - mach->vmstat_time) < SIGAR_BUFFER_EXPIRE))
+    {
+        memcpy(vmstat, &mach->vmstat, sizeof(*vmstat));
         return SIGAR_OK;
     }
-    else {
+
+#ifdef HOST_VM_INFO64
+    status = host_statistics64(sigar->mach_port, HOST_VM_INFO64,
+                               (host_info64_t)&mach->vmstat, &count);
+#else
+    status = host_statistics(sigar->mach_port, HOST_VM_INFO,
+                             (host_info_t)&mach->vmstat, &count);
+#endif
+
+    if (status != KERN_SUCCESS) {
+        mach->vmstat_time = 0;
         return errno;
     }
+
+    mach->vmstat_time = timenow;
+    memcpy(vmstat, &mach->vmstat, sizeof(*vmstat));
+
+    return SIGAR_OK;
 }
+
+/* unsigned natural_t math absorbs a wrap of the 32-bit tick counters */
+static void sigar_mach_ticks_update(sigar_mach_ticks_t *ticks,
+                                    natural_t *cpu_ticks)
+{
+    int i;
+
+    for (i=0; i<CPU_STATE_MAX; i++) {
+        ticks->total[i] += (natural_t)(cpu_ticks[i] - ticks->last[i]);
+        ticks->last[i] = cpu_ticks[i];
+    }
+}
+
+#define SIGAR_MACH_TICKS_COPY(cpu, ticks) \
+    cpu->user = SIGAR_TICK2MSEC((ticks)->total[CPU_STATE_USER]); \
+    cpu->sys  = SIGAR_TICK2MSEC((ticks)->total[CPU_STATE_SYSTEM]); \
+    cpu->idle = SIGAR_TICK2MSEC((ticks)->total[CPU_STATE_IDLE]); \
+    cpu->nice = SIGAR_TICK2MSEC((ticks)->total[CPU_STATE_NICE]); \
+    cpu->wait = 0; /*N/A*/ \
+    cpu->irq = 0; /*N/A*/ \
+    cpu->soft_irq = 0; /*N/A*/ \
+    cpu->stolen = 0; /*N/A*/ \
+    cpu->total = cpu->user + cpu->nice + cpu->sys + cpu->idle
 #elif defined(__FreeBSD__)
 static int sigar_vmstat(sigar_t *sigar, struct vmmeter *vmstat)
 {
@@ -434,7 +506,7 @@ int sigar_mem_get(sigar_t *sigar, sigar_mem_t *mem)
 {
     sigar_uint64_t kern = 0;
 #ifdef DARWIN
-    vm_statistics_data_t vmstat;
+    sigar_vmstat_t vmstat;
     uint64_t mem_total;
 #else
     unsigned long mem_total;
@@ -673,7 +745,7 @@ int sigar_swap_get(sigar_t *sigar, sigar_swap_t *swap)
 {
     int status;
 #if defined(DARWIN)
-    vm_statistics_data_t vmstat;
+    sigar_vmstat_t vmstat;
 
     if (sigar_swap_sysctl_get(sigar, swap) != SIGAR_OK) {
         status = sigar_swap_fs_get(sigar, swap); /* <= 10.3 */
@@ -759,15 +831,8 @@ int sigar_cpu_get(sigar_t *sigar, sigar_cpu_t *cpu)
         return errno;
     }
 
-    cpu->user = SIGAR_TICK2MSEC(cpuload.cpu_ticks[CPU_STATE_USER]);
-    cpu->sys  = SIGAR_TICK2MSEC(cpuload.cpu_ticks[CPU_STATE_SYSTEM]);
-    cpu->idle = SIGAR_TICK2MSEC(cpuload.cpu_ticks[CPU_STATE_IDLE]);
-    cpu->nice = SIGAR_TICK2MSEC(cpuload.cpu_ticks[CPU_STATE_NICE]);
-    cpu->wait = 0; /*N/A*/
-    cpu->irq = 0; /*N/A*/
-    cpu->soft_irq = 0; /*N/A*/
-    cpu->stolen = 0; /*N/A*/
-    cpu->total = cpu->user + cpu->nice + cpu->sys + cpu->idle;
+    sigar_mach_ticks_update(&sigar->mach.cpu, cpuload.cpu_ticks);
+    SIGAR_MACH_TICKS_COPY(cpu, &sigar->mach.cpu);
 
 #elif defined(__FreeBSD__) || (__OpenBSD__) || defined(__NetBSD__)
     int status;
@@ -872,27 +937,30 @@ int sigar_cpu_list_get(sigar_t *sigar, sigar_cpu_list_t *cpulist)
         return errno;
     }
 
+    if (sigar->mach.ncpus != ncpu) { /* first call or cpus changed */
+        sigar->mach.cpus =
+            realloc(sigar->mach.cpus, sizeof(*sigar->mach.cpus) * ncpu);
+        memset(sigar->mach.cpus, 0, sizeof(*sigar->mach.cpus) * ncpu);
+        sigar->mach.ncpus = ncpu;
+    }
+
     sigar_cpu_list_create(cpulist);
 
     for (i=0; i<ncpu; i++) {
+        sigar_mach_ticks_t *ticks = &sigar->mach.cpus[i];
         sigar_cpu_t *cpu;
 
         SIGAR_CPU_LIST_GROW(cpulist);
 
         cpu = &cpulist->data[cpulist->number++];
 
-        cpu->user = SIGAR_TICK2MSEC(cpuload[i].cpu_ticks[CPU_STATE_USER]);
-        cpu->sys  = SIGAR_TICK2MSEC(cpuload[i].cpu_ticks[CPU_STATE_SYSTEM]);
-        cpu->idle = SIGAR_TICK2MSEC(cpuload[i].cpu_ticks[CPU_STATE_IDLE]);
-        cpu->nice = SIGAR_TICK2MSEC(cpuload[i].cpu_ticks[CPU_STATE_NICE]);
-        cpu->wait = 0; /*N/A*/
-        cpu->irq = 0; /*N/A*/
-        cpu->soft_irq = 0; /*N/A*/
-        cpu->stolen = 0; /*N/A*/
-        cpu->total = cpu->user + cpu->nice + cpu->sys + cpu->idle;
+        sigar_mach_ticks_update(ticks, cpuload[i].cpu_ticks);
+        SIGAR_MACH_TICKS_COPY(cpu, ticks);
     }
 
-    vm_deallocate(mach_task_self(), (vm_address_t)cpuload, count);
+    /* count is in integer_t, the array came from our address space */
+    vm_deallocate(mach_task_self(), (vm_address_t)cpuload,
+                  count * sizeof(integer_t));
 
     return SIGAR_OK;
 #else
@@ -986,27 +1054,51 @@ static int proc_fdinfo_get(sigar_t *sigar, sigar_pid_t pid, int *num)
 #define KERN_PROC_PROC KERN_PROC_ALL
 #endif
 
-int sigar_os_proc_list_get(sigar_t *sigar,
-                           sigar_proc_list_t *proclist)
-{
 #if defined(DARWIN) || defined(SIGAR_FREEBSD5) || defined(__OpenBSD__) || defined(__NetBSD__)
+/*
+ * the whole KERN_PROC table into sigar->procs.  the buffer keeps its
+ * size, so a steady process count costs one sysctl instead of a
+ * sizing call, a malloc and the real call.
+ */
+static int sigar_kinfo_procs_get(sigar_t *sigar, int *num)
+{
     int mib[4] = { CTL_KERN, KERN_PROC, KERN_PROC_PROC, 0 };
-    int i, num;
-    size_t len;
-    struct kinfo_proc *proc;
+    size_t len = sigar->procs_size;
 
-    if (sysctl(mib, NMIB(mib), NULL, &len, NULL, 0) < 0) {
-        return errno;
+    while (!sigar->procs ||
+           (sysctl(mib, NMIB(mib), sigar->procs, &len, NULL, 0) < 0))
+    {
+        if (sigar->procs && (errno != ENOMEM)) {
+            return errno;
+        }
+
+        if (sysctl(mib, NMIB(mib), NULL, &len, NULL, 0) < 0) {
+            return errno;
+        }
+
+        len += len / 8; /* room for procs forked in between */
+        sigar->procs = realloc(sigar->procs, len);
+        sigar->procs_size = len;
     }
 
-    proc = malloc(len);
+    *num = len/sizeof(*sigar->procs);
 
-    if (sysctl(mib, NMIB(mib), proc, &len, NULL, 0) < 0) {
-        free(proc);
-        return errno;
+    return SIGAR_OK;
+}
+#endif
+
+int sigar_os_proc_list_get(sigar_t *sigar,
+                           sigar_proc_list_t *proclist)
+{
+#if defined(DARWIN) || defined(SIGAR_FREEBSD5) || defined(__OpenBSD__) || defined(__NetBSD__)
+    int i, num, status;
+    struct kinfo_proc *proc;
+
+    if ((status = sigar_kinfo_procs_get(sigar, &num)) != SIGAR_OK) {
+        return status;
     }
 
-    num = len/sizeof(*proc);
+    proc = sigar->procs;
 
     for (i=0; i<num; i++) {
         if (proc[i].KI_FLAG & P_SYSTEM) {
@@ -1019,8 +1111,6 @@ int sigar_os_proc_list_get(sigar_t *sigar,
         proclist->data[proclist->number++] = proc[i].KI_PID;
     }
 
-    free(proc);
-
     return SIGAR_OK;
 #else
     int i, num;
@@ -1117,6 +1207,38 @@ static mach_vm_size_t sigar_shared_region_size(cpu_type_t type)
 }
 #endif /* DARWIN */
 
+#if defined(DARWIN) && defined(DARWIN_HAS_LIBPROC_H)
+/* exclude the shared region from the virtual size */
+static void sigar_proc_mem_shared_adjust(sigar_t *sigar, sigar_pid_t pid,
+                                         sigar_proc_mem_t *procmem)
+{
+    struct proc_regioninfo pri;
+    int sz =
+        sigar->proc_pidinfo(pid, PROC_PIDREGIONINFO, 0, &pri, sizeof(pri));
+
+    if (sz == sizeof(pri)) {
+        if (pri.pri_share_mode == SM_EMPTY) {
+            mach_vm_size_t shared_size;
+#ifdef GLOBAL_SHARED_SIZE
+            shared_size = GLOBAL_SHARED_SIZE; /* 10.4 SDK */
+#else
+            cpu_type_t cpu_type;
+
+            if (sigar_proc_cpu_type(sigar, pid, &cpu_type) == SIGAR_OK) {
+                shared_size = sigar_shared_region_size(cpu_type);
+            }
+            else {
+                shared_size = SHARED_REGION_SIZE_I386; /* assume 32-bit x86|ppc */
+            }
+#endif
+            if (procmem->size > shared_size) {
+                procmem->size -= shared_size; /* SIGAR-123 */
+            }
+        }
+    }
+}
+#endif
+
 int sigar_proc_mem_get(sigar_t *sigar, sigar_pid_t pid,
                        sigar_proc_mem_t *procmem)
 {
@@ -1128,7 +1250,6 @@ int sigar_proc_mem_get(sigar_t *sigar, sigar_pid_t pid,
     mach_msg_type_number_t count;
 #  ifdef DARWIN_HAS_LIBPROC_H
     struct proc_taskinfo pti;
-    struct proc_regioninfo pri;
 
     if (sigar->libproc) {
         int sz =
@@ -1142,27 +1263,7 @@ int sigar_proc_mem_get(sigar_t *sigar, sigar_pid_t pid,
             procmem->major_faults = SIGAR_FIELD_NOTIMPL;
             procmem->share        = SIGAR_FIELD_NOTIMPL;
 
-            sz = sigar->proc_pidinfo(pid, PROC_PIDREGIONINFO, 0, &pri, sizeof(pri));
-            if (sz == sizeof(pri)) {
-                if (pri.pri_share_mode == SM_EMPTY) {
-                    mach_vm_size_t shared_size;
-#ifdef GLOBAL_SHARED_SIZE
-                    shared_size = GLOBAL_SHARED_SIZE; /* 10.4 SDK */
-#else
-                    cpu_type_t cpu_type;
-
-                    if (sigar_proc_cpu_type(sigar, pid, &cpu_type) == SIGAR_OK) {
-                        shared_size = sigar_shared_region_size(cpu_type);
-                    }
-                    else {
-                        shared_size = SHARED_REGION_SIZE_I386; /* assume 32-bit x86|ppc */
-                    }
-#endif
-                    if (procmem->size > shared_size) {
-                        procmem->size -= shared_size; /* SIGAR-123 */
-                    }
-                }
-            }
+            sigar_proc_mem_shared_adjust(sigar, pid, procmem);
             return SIGAR_OK;
         }
     }
@@ -1241,10 +1342,50 @@ int sigar_proc_mem_get(sigar_t *sigar, sigar_pid_t pid,
     return SIGAR_OK;
 }
 
+#if defined(DARWIN) && defined(DARWIN_HAS_LIBPROC_H) && defined(RUSAGE_INFO_V2)
+#define DARWIN_HAS_PROC_RUSAGE
+
+/* one call for the disk counters, cpu times and footprint */
+static int proc_rusage_get(sigar_t *sigar, sigar_pid_t pid,
+                           struct rusage_info_v2 *ri)
+{
+    if (!sigar->proc_pid_rusage) {
+        return SIGAR_ENOTIMPL;
+    }
+
+    if (sigar->proc_pid_rusage(pid, RUSAGE_INFO_V2, (void **)ri) != 0) {
+        return errno;
+    }
+
+    return SIGAR_OK;
+}
+
+static void proc_rusage_disk_io(struct rusage_info_v2 *ri,
+                                sigar_proc_cumulative_disk_io_t *io)
+{
+    io->bytes_read    = ri->ri_diskio_bytesread;
+    io->bytes_written = ri->ri_diskio_byteswritten;
+    io->bytes_total   = io->bytes_read + io->bytes_written;
+}
+#endif
+
 int sigar_proc_cumulative_disk_io_get(sigar_t *sigar, sigar_pid_t pid,
                            sigar_proc_cumulative_disk_io_t *proc_cumulative_disk_io)
 {
+#ifdef DARWIN_HAS_PROC_RUSAGE
+    struct rusage_info_v2 ri;
+    int status;
+
+    if ((status = proc_rusage_get(sigar, pid, &ri)) != SIGAR_OK) {
+        return status;
+    }
+
+    proc_rusage_disk_io(&ri, proc_cumulative_disk_io);
+
+    return SIGAR_OK;
+#else
     return SIGAR_ENOTIMPL;
+#endif
 }
 
 
@@ -1468,6 +1609,88 @@ static int sigar_proc_threads_get(sigar_t *sigar, sigar_pid_t pid,
 }
 #endif
 
+static char sigar_pinfo_state(int state)
+{
+    switch (state) {
+      case SIDL:
+        return 'D';
+      case SRUN:
+#ifdef SONPROC
+      case SONPROC:
+#endif
+        return 'R';
+      case SSLEEP:
+        return 'S';
+      case SSTOP:
+        return 'T';
+      case SZOMB:
+        return 'Z';
+      default:
+        return '?';
+    }
+}
+
+/* the KERN_PROC table already has every p_stat, one sysctl is enough */
+int sigar_os_proc_stat_get(sigar_t *sigar, sigar_proc_stat_t *procstat)
+{
+#if defined(DARWIN) || defined(SIGAR_FREEBSD5)
+    int i, num, status;
+    struct kinfo_proc *proc;
+
+    if ((status = sigar_kinfo_procs_get(sigar, &num)) != SIGAR_OK) {
+        return status;
+    }
+
+    proc = sigar->procs;
+
+    SIGAR_ZERO(procstat);
+    procstat->threads = SIGAR_FIELD_NOTIMPL;
+
+    for (i=0; i<num; i++) {
+        /* same processes as sigar_os_proc_list_get */
+        if (proc[i].KI_FLAG & P_SYSTEM) {
+            continue;
+        }
+        if (proc[i].KI_PID == 0) {
+            continue;
+        }
+
+        procstat->total++;
+
+        switch (sigar_pinfo_state(proc[i].KI_STAT)) {
+          case SIGAR_PROC_STATE_IDLE:
+            procstat->idle++;
+            break;
+          case SIGAR_PROC_STATE_RUN:
+            procstat->running++;
+            break;
+          case SIGAR_PROC_STATE_SLEEP:
+            procstat->sleeping++;
+            break;
+          case SIGAR_PROC_STATE_STOP:
+            procstat->stopped++;
+            break;
+          case SIGAR_PROC_STATE_ZOMBIE:
+            procstat->zombie++;
+            break;
+          default:
+            break;
+        }
+    }
+
+#ifdef DARWIN
+    /* p_stat is SRUN sleeping or not, only the census looks at threads */
+    procstat->running = SIGAR_FIELD_NOTIMPL;
+    procstat->sleeping = SIGAR_FIELD_NOTIMPL;
+    procstat->idle = SIGAR_FIELD_NOTIMPL;
+#endif
+
+    return SIGAR_OK;
+#else
+    return SIGAR_ENOTIMPL;
+#endif
+}
+
 int sigar_proc_state_get(sigar_t *sigar, sigar_pid_t pid,
                          sigar_proc_state_t *procstate)
 {
@@ -1508,32 +1731,151 @@ int sigar_proc_state_get(sigar_t *sigar, sigar_pid_t pid,
     }
 #endif
 
-    switch (state) {
-      case SIDL:
-        procstate->state = 'D';
-        break;
-      case SRUN:
-#ifdef SONPROC
-      case SONPROC:
+    procstate->state = sigar_pinfo_state(state);
+
+    return SIGAR_OK;
+}
+
+#ifdef DARWIN
+/*
+ * the KERN_PROC table from the shared buffer, plus a single
+ * PROC_PIDTASKALLINFO per pid: bsd info and task info (mem, times,
+ * threads) in one call instead of the per-getter sysctl,
+ * task_for_pid and thread walks.
+ */
+int sigar_os_proc_snapshot_get(sigar_t *sigar, int flags,
+                               sigar_proc_snapshot_t *snapshot)
+{
+#ifdef DARWIN_HAS_LIBPROC_H
+    int i, num, status;
+    struct kinfo_proc *proc;
+
+    if (!sigar->libproc) {
+        return SIGAR_ENOTIMPL;
+    }
+
+    if ((status = sigar_kinfo_procs_get(sigar, &num)) != SIGAR_OK) {
+        return status;
+    }
+
+    proc = sigar->procs;
+
+    for (i=0; i<num; i++) {
+        bsd_pinfo_t *pinfo = &proc[i];
+        sigar_proc_snapshot_entry_t *entry;
+        struct proc_taskallinfo tai;
+        struct proc_taskinfo *pti = &tai.ptinfo;
+        int has_tai = 0;
+#ifdef DARWIN_HAS_PROC_RUSAGE
+        struct rusage_info_v2 ri;
+        int has_ri = 0;
 #endif
-        procstate->state = 'R';
-        break;
-      case SSLEEP:
-        procstate->state = 'S';
-        break;
-      case SSTOP:
-        procstate->state = 'T';
-        break;
-      case SZOMB:
-        procstate->state = 'Z';
-        break;
-      default:
-        procstate->state = '?';
-        break;
+
+        if ((pinfo->KI_FLAG & P_SYSTEM) || (pinfo->KI_PID == 0)) {
+            continue;
+        }
+
+        if (flags & (SIGAR_PROC_SNAPSHOT_MEM|SIGAR_PROC_SNAPSHOT_TIME|
+                     SIGAR_PROC_SNAPSHOT_STATE))
+        {
+            has_tai =
+                (sigar->proc_pidinfo(pinfo->KI_PID, PROC_PIDTASKALLINFO, 0,
+                                     &tai, sizeof(tai)) == sizeof(tai));
+        }
+
+#ifdef DARWIN_HAS_PROC_RUSAGE
+        if ((flags & SIGAR_PROC_SNAPSHOT_DISK_IO) ||
+            (!has_tai && (flags & SIGAR_PROC_SNAPSHOT_TIME)))
+        {
+            has_ri = (proc_rusage_get(sigar, pinfo->KI_PID, &ri) == SIGAR_OK);
+        }
+#endif
+
+        SIGAR_PROC_SNAPSHOT_GROW(snapshot);
+        entry = &snapshot->data[snapshot->number++];
+        entry->pid = pinfo->KI_PID;
+        entry->flags = 0;
+
+        if (flags & SIGAR_PROC_SNAPSHOT_STATE) {
+            sigar_proc_state_t *procstate = &entry->state;
+
+            SIGAR_SSTRCPY(procstate->name, pinfo->KI_COMM);
+            procstate->state    = sigar_pinfo_state(pinfo->KI_STAT);
+            procstate->ppid     = pinfo->KI_PPID;
+            procstate->priority = pinfo->KI_PRI;
+            procstate->nice     = pinfo->KI_NICE;
+            procstate->tty      = SIGAR_FIELD_NOTIMPL;
+            procstate->processor = SIGAR_FIELD_NOTIMPL;
+            procstate->threads  = SIGAR_FIELD_NOTIMPL;
+
+            if (has_tai) {
+                if (tai.pbsd.pbi_name[0]) { /* p_comm stops at MAXCOMLEN */
+                    SIGAR_SSTRCPY(procstate->name, tai.pbsd.pbi_name);
+                }
+                procstate->threads = pti->pti_threadnum;
+                /* p_stat is SRUN sleeping or not, the task knows */
+                if ((procstate->state == SIGAR_PROC_STATE_RUN) &&
+                    (pti->pti_numrunning == 0))
+                {
+                    procstate->state = SIGAR_PROC_STATE_SLEEP;
+                }
+            }
+            entry->flags |= SIGAR_PROC_SNAPSHOT_STATE;
+        }
+
+#ifdef DARWIN_HAS_PROC_RUSAGE
+        if (has_ri) {
+            if (flags & SIGAR_PROC_SNAPSHOT_DISK_IO) {
+                proc_rusage_disk_io(&ri, &entry->disk_io);
+                entry->flags |= SIGAR_PROC_SNAPSHOT_DISK_IO;
+            }
+
+            if (!has_tai && (flags & SIGAR_PROC_SNAPSHOT_TIME)) {
+                sigar_proc_cpu_t *proctime = &entry->cpu;
+
+                proctime->user  = SIGAR_NSEC2MSEC(ri.ri_user_time);
+                proctime->sys   = SIGAR_NSEC2MSEC(ri.ri_system_time);
+                proctime->total = proctime->user + proctime->sys;
+                proctime->start_time = tv2msec(pinfo->KI_START);
+                entry->flags |= SIGAR_PROC_SNAPSHOT_TIME;
+            }
+        }
+#endif
+
+        if (!has_tai) {
+            continue; /* EPERM or gone */
+        }
+
+        if (flags & SIGAR_PROC_SNAPSHOT_MEM) {
+            sigar_proc_mem_t *procmem = &entry->mem;
+
+            procmem->size         = pti->pti_virtual_size;
+            procmem->resident     = pti->pti_resident_size;
+            procmem->page_faults  = pti->pti_faults;
+            procmem->minor_faults = SIGAR_FIELD_NOTIMPL;
+            procmem->major_faults = SIGAR_FIELD_NOTIMPL;
+            procmem->share        = SIGAR_FIELD_NOTIMPL;
+            sigar_proc_mem_shared_adjust(sigar, entry->pid, procmem);
+            entry->flags |= SIGAR_PROC_SNAPSHOT_MEM;
+        }
+
+        if (flags & SIGAR_PROC_SNAPSHOT_TIME) {
+            sigar_proc_cpu_t *proctime = &entry->cpu;
+
+            proctime->user  = SIGAR_NSEC2MSEC(pti->pti_total_user);
+            proctime->sys   = SIGAR_NSEC2MSEC(pti->pti_total_system);
+            proctime->total = proctime->user + proctime->sys;
+            proctime->start_time = tv2msec(pinfo->KI_START);
+            entry->flags |= SIGAR_PROC_SNAPSHOT_TIME;
+        }
     }
 
     return SIGAR_OK;
+#else
+    return SIGAR_ENOTIMPL;
+#endif
 }
+#endif
 
 #if defined(DARWIN)
 typedef struct {
@@ -2006,6 +2348,123 @@ int sigar_proc_modules_get(sigar_t *sigar, sigar_pid_t pid,
     return SIGAR_ENOTIMPL;
 }
 
+#ifdef DARWIN
+#include <sys/event.h>
+
+/*
+ * NOTE_EXIT on a kqueue of its own, which the caller can add to theirs;
+ * the pid is only looked up once, at the open.  the event is not
+ * consumed by a wait, exited remembers it for kill.
+ */
+struct sigar_proc_handle_t {
+    sigar_pid_t pid;
+    int fd;
+    int exited;
+};
+
+static int proc_handle_kevent(sigar_proc_handle_t *handle, int timeout)
+{
+    struct kevent ev;
+    struct timespec ts, *tsp = NULL;
+    int n;
+
+    if (handle->exited) {
+        return SIGAR_OK;
+    }
+
+    if (timeout >= 0) {
+        ts.tv_sec = timeout / 1000;
+        ts.tv_nsec = (timeout % 1000) * 1000000;
+        tsp = &ts;
+    }
+
+    while (((n = kevent(handle->fd, NULL, 0, &ev, 1, tsp)) < 0) &&
+           (errno == EINTR))
+    {
+        /* again */
+    }
+
+    if (n < 0) {
+        return errno;
+    }
+    if (n == 0) {
+        return ETIMEDOUT;
+    }
+    handle->exited = 1;
+
+    return SIGAR_OK;
+}
+
+int sigar_proc_handle_open(sigar_t *sigar, sigar_pid_t pid,
+                           sigar_proc_handle_t **handle_ptr)
+{
+    sigar_proc_handle_t *handle;
+    struct kevent ev;
+    int status;
+
+    *handle_ptr = NULL;
+
+    if (!(handle = malloc(sizeof(*handle)))) {
+        return ENOMEM;
+    }
+    handle->pid = pid;
+    handle->exited = 0;
+
+    if ((handle->fd = kqueue()) < 0) {
+        status = errno;
+        free(handle);
+        return status;
+    }
+    fcntl(handle->fd, F_SETFD, FD_CLOEXEC);
+
+    EV_SET(&ev, pid, EVFILT_PROC, EV_ADD | EV_ONESHOT, NOTE_EXIT, 0, NULL);
+    if (kevent(handle->fd, &ev, 1, NULL, 0, NULL) < 0) {
+        status = errno;
+        close(handle->fd);
+        free(handle);
+        return status;
+    }
+
+    *handle_ptr = handle;
+
+    return SIGAR_OK;
+}
+
+int sigar_proc_handle_close(sigar_t *sigar, sigar_proc_handle_t *handle)
+{
+    close(handle->fd);
+    free(handle);
+
+    return SIGAR_OK;
+}
+
+sigar_pid_t sigar_proc_handle_pid_get(sigar_proc_handle_t *handle)
+{
+    return handle->pid;
+}
+
+sigar_proc_waitable_t
+sigar_proc_handle_waitable_get(sigar_proc_handle_t *handle)
+{
+    return handle->fd;
+}
+
+int sigar_proc_handle_wait(sigar_proc_handle_t *handle, int timeout)
+{
+    return proc_handle_kevent(handle, timeout);
+}
+
+/* NOTE_EXIT comes before the pid can be reaped and handed out again */
+int sigar_proc_handle_kill(sigar_proc_handle_t *handle, int signum)
+{
+    if (proc_handle_kevent(handle, 0) == SIGAR_OK) {
+        return ESRCH;
+    }
+
+    return sigar_proc_kill(handle->pid, signum);
+}
+#endif
+
 #define SIGAR_MICROSEC2NANO(s) \
     ((sigar_uint64_t)(s) * (sigar_uint64_t)1000)
 
@@ -2050,6 +2509,86 @@ int sigar_thread_cpu_get(sigar_t *sigar,
     return SIGAR_OK;
 }
 
+#ifdef DARWIN
+static char thread_state_char(integer_t run_state)
+{
+    switch (run_state) {
+      case TH_STATE_RUNNING:
+        return SIGAR_PROC_STATE_RUN;
+      case TH_STATE_STOPPED:
+        return SIGAR_PROC_STATE_STOP;
+      case TH_STATE_UNINTERRUPTIBLE:
+        return SIGAR_PROC_STATE_IDLE;
+      case TH_STATE_HALTED:
+        return SIGAR_PROC_STATE_ZOMBIE;
+      default:
+        return SIGAR_PROC_STATE_SLEEP;
+    }
+}
+
+/* one task_threads walk, basic and identifier info per thread */
+int sigar_os_proc_thread_list_get(sigar_t *sigar, sigar_pid_t pid,
+                                  sigar_proc_thread_list_t *threads)
+{
+    task_port_t task, self = mach_task_self();
+    thread_act_array_t acts;
+    mach_msg_type_number_t i, count;
+    kern_return_t status;
+
+    status = task_for_pid(self, pid, &task);
+    if (status != KERN_SUCCESS) {
+        return errno;
+    }
+
+    status = task_threads(task, &acts, &count);
+    if (status != KERN_SUCCESS) {
+        if (task != self) {
+            mach_port_deallocate(self, task);
+        }
+        return errno;
+    }
+
+    for (i=0; i<count; i++) {
+        thread_basic_info_data_t info;
+        thread_identifier_info_data_t ident;
+        mach_msg_type_number_t n = THREAD_BASIC_INFO_COUNT;
+        sigar_proc_thread_t *thread;
+
+        if (thread_info(acts[i], THREAD_BASIC_INFO,
+                        (thread_info_t)&info, &n) == KERN_SUCCESS)
+        {
+            SIGAR_PROC_THREAD_LIST_GROW(threads);
+            thread = &threads->data[threads->number++];
+
+            n = THREAD_IDENTIFIER_INFO_COUNT;
+            if (thread_info(acts[i], THREAD_IDENTIFIER_INFO,
+                            (thread_info_t)&ident, &n) == KERN_SUCCESS)
+            {
+                thread->tid = (sigar_pid_t)ident.thread_id;
+            }
+            else {
+                thread->tid = (sigar_pid_t)acts[i];
+            }
+            thread->state = thread_state_char(info.run_state);
+            thread->processor = -1;
+            thread->cpu.user = tval2msec(info.user_time);
+            thread->cpu.sys  = tval2msec(info.system_time);
+            thread->cpu.total = thread->cpu.user + thread->cpu.sys;
+            thread->cpu.start_time = 0;
+        }
+
+        mach_port_deallocate(self, acts[i]);
+    }
+
+    vm_deallocate(self, (vm_address_t)acts, sizeof(*acts) * count);
+    if (task != self) {
+        mach_port_deallocate(self, task);
+    }
+
+    return SIGAR_OK;
+}
+#endif
+
 int sigar_os_fs_type_get(sigar_file_system_t *fsp)
 {
     char *type = fsp->sys_type_name;
@@ -3049,10 +3588,37 @@ static int net_connection_get(sigar_net_connection_walker_t *walker, int proto)
     return SIGAR_OK;
 }
 #else
+/* mibvar into sigar->pcb_buf, which only ever grows */
+static int net_pcblist_get(sigar_t *sigar, const char *mibvar, size_t *len)
+{
+    *len = sigar->pcb_size;
+
+    while (!sigar->pcb_buf ||
+           (sysctlbyname(mibvar, sigar->pcb_buf, len, NULL, 0) < 0))
+    {
+        if (sigar->pcb_buf && (errno != ENOMEM)) {
+            return errno;
+        }
+
+        if (sysctlbyname(mibvar, NULL, len, NULL, 0) < 0) {
+            return errno;
+        }
+
+        *len += *len / 8; /* room for sockets opened in between */
+        if (*len <= sigar->pcb_size) {
+            *len = sigar->pcb_size * 2;
+        }
+        sigar->pcb_buf = realloc(sigar->pcb_buf, *len);
+        sigar->pcb_size = *len;
+    }
+
+    return SIGAR_OK;
+}
+
 static int net_connection_get(sigar_net_connection_walker_t *walker, int proto)
 {
     int flags = walker->flags;
-    int type, istcp = 0;
+    int status, type, istcp = 0;
     char *buf;
     const char *mibvar;
     struct tcpcb *tp = NULL;
@@ -3077,17 +3643,10 @@ static int net_connection_get(sigar_net_connection_walker_t *walker, int proto)
         break;
     }
 
-    len = 0;
-    if (sysctlbyname(mibvar, 0, &len, 0, 0) < 0) {
-        return errno;
-    }
-    if ((buf = malloc(len)) == 0) {
-        return errno;
-    }
-    if (sysctlbyname(mibvar, buf, &len, 0, 0) < 0) {
-        free(buf);
-        return errno;
+    if ((status = net_pcblist_get(walker->sigar, mibvar, &len)) != SIGAR_OK) {
+        return status;
     }
+    buf = walker->sigar->pcb_buf;
 
     oxig = xig = (struct xinpgen *)buf;
     for (xig = (struct xinpgen *)((char *)xig + xig->xig_len);
@@ -3159,8 +3718,6 @@ static int net_connection_get(sigar_net_connection_walker_t *walker, int proto)
         }
     }
 
-    free(buf);
-
     return SIGAR_OK;
 }
 #endif
@@ -3538,18 +4095,38 @@ int sigar_proc_port_get(sigar_t *sigar, int protocol,
 
 #elif defined(DARWIN) && defined(DARWIN_HAS_LIBPROC_H)
 
-int sigar_proc_port_get(sigar_t *sigar, int protocol,
-                        unsigned long port, sigar_pid_t *pid)
+/* (protocol, port) -> pid, rebuilt from scratch once it gets this old */
+#define PROC_PORT_INDEX_EXPIRE (10 * SIGAR_MSEC)
+/* a miss forces a rebuild, but not more often than this */
+#define PROC_PORT_INDEX_MISS_EXPIRE (1 * SIGAR_MSEC)
+
+#define PROC_PORT_KEY(protocol, port) \
+    (((sigar_uint64_t)(protocol) << 32) | (port))
+
+/*
+ * one sweep over the socket fds of every process we may look at,
+ * keeping listening tcp and unconnected udp sockets by local port.
+ */
+static int proc_port_index_build(sigar_t *sigar)
 {
     sigar_proc_list_t pids;
-    int i, status, found=0;
+    int i, status;
 
-    if (!sigar->libproc) {
-        return SIGAR_ENOTIMPL;
+    if (sigar->proc_port_index) {
+        sigar_cache_destroy(sigar->proc_port_index);
+        sigar_pool_destroy(sigar->proc_port_pool);
     }
+    sigar->proc_port_index =
+        sigar_cache_create(SIGAR_PROC_LIST_MAX,
+                           SIGAR_CACHE_OPEN_ADDRESSING,
+                           SIGAR_FIELD_NOTIMPL, SIGAR_FIELD_NOTIMPL);
+    sigar->proc_port_pool =
+        sigar_pool_new(sizeof(sigar_pid_t), PID_CACHE_POOL_SLAB);
+    sigar->proc_port_index->value_pool = sigar->proc_port_pool;
 
     status = sigar_proc_list_get(sigar, &pids);
     if (status != SIGAR_OK) {
+        sigar->proc_port_index_time = 0;
         return status;
     }
 
@@ -3566,8 +4143,9 @@ int sigar_proc_port_get(sigar_t *sigar, int protocol,
         for (n=0; n<num; n++) {
             struct proc_fdinfo *fdp = &fdinfo[n];
             struct socket_fdinfo si;
-            int rsize, family;
-            unsigned long lport;
+            struct in_sockinfo *ini;
+            sigar_cache_entry_t *entry;
+            int rsize, family, protocol;
 
             if (fdp->proc_fdtype != PROX_FDTYPE_SOCKET) {
                 continue;
@@ -3577,28 +4155,97 @@ int sigar_proc_port_get(sigar_t *sigar, int protocol,
             if (rsize != sizeof(si)) {
                 continue;
             }
-            if (si.psi.soi_kind != SOCKINFO_TCP) {
+            family = si.psi.soi_family;
+            if (!((family == AF_INET) || (family == AF_INET6))) {
                 continue;
             }
-            if (si.psi.soi_proto.pri_tcp.tcpsi_state != TSI_S_LISTEN) {
-                continue;
+
+            if (si.psi.soi_kind == SOCKINFO_TCP) {
+                if (si.psi.soi_proto.pri_tcp.tcpsi_state != TSI_S_LISTEN) {
+                    continue;
+                }
+                ini = &si.psi.soi_proto.pri_tcp.tcpsi_ini;
+                protocol = SIGAR_NETCONN_TCP;
             }
-            family = si.psi.soi_family;
-            if (!((family == AF_INET) || (family == AF_INET6))) {
+            else if ((si.psi.soi_kind == SOCKINFO_IN) &&
+                     (si.psi.soi_protocol == IPPROTO_UDP))
+            {
+                ini = &si.psi.soi_proto.pri_in;
+                if (ini->insi_fport != 0) {
+                    continue;
+                }
+                protocol = SIGAR_NETCONN_UDP;
+            }
+            else {
                 continue;
             }
-            lport = ntohs(si.psi.soi_proto.pri_tcp.tcpsi_ini.insi_lport);
-            if (lport == port) {
-                *pid = pids.data[i];
-                found = 1;
-                break;
+
+            /* shared after fork, first one wins as before */
+            entry = sigar_cache_get(sigar->proc_port_index,
+                                    PROC_PORT_KEY(protocol,
+                                                  ntohs(ini->insi_lport)));
+            if (!entry->value) {
+                entry->value =
+                    sigar_cache_value_new(sigar->proc_port_index,
+                                          sizeof(sigar_pid_t));
+                *(sigar_pid_t *)entry->value = pids.data[i];
             }
         }
     }
 
     sigar_proc_list_destroy(sigar, &pids);
 
-    return found ? SIGAR_OK : ENOENT;
+    sigar->proc_port_index_time = sigar_time_now_millis();
+
+    return SIGAR_OK;
+}
+
+int sigar_proc_port_get(sigar_t *sigar, int protocol,
+                        unsigned long port, sigar_pid_t *pid)
+{
+    sigar_uint64_t timenow = sigar_time_now_millis();
+    sigar_cache_entry_t *entry;
+    int status;
+
+    if (!sigar->libproc) {
+        return SIGAR_ENOTIMPL;
+    }
+
+    if (!((protocol == SIGAR_NETCONN_TCP) ||
+          (protocol == SIGAR_NETCONN_UDP)))
+    {
+        return SIGAR_ENOTIMPL;
+    }
+
+    if (!sigar->proc_port_index_time ||
+        (timenow >= sigar->proc_port_index_time + PROC_PORT_INDEX_EXPIRE))
+    {
+        if ((status = proc_port_index_build(sigar)) != SIGAR_OK) {
+            return status;
+        }
+    }
+
+    entry = sigar_cache_find(sigar->proc_port_index,
+                             PROC_PORT_KEY(protocol, port));
+
+    if (!entry &&
+        (timenow >= sigar->proc_port_index_time + PROC_PORT_INDEX_MISS_EXPIRE))
+    {
+        /* socket newer than the index */
+        if ((status = proc_port_index_build(sigar)) != SIGAR_OK) {
+            return status;
+        }
+        entry = sigar_cache_find(sigar->proc_port_index,
+                                 PROC_PORT_KEY(protocol, port));
+    }
+
+    if (!entry) {
+        return ENOENT;
+    }
+
+    *pid = *(sigar_pid_t *)entry->value;
+
+    return SIGAR_OK;
 }
 
 #else
@@ -20,11 +20,14 @@
 #ifdef DARWIN
 #include <mach/port.h>
 #include <mach/host_info.h>
+#include <mach/machine.h>
+#include <mach/vm_statistics.h>
 #ifdef DARWIN_HAS_LIBPROC_H
 #include <mach-o/dyld.h>
 #include <libproc.h>
 typedef int (*proc_pidinfo_func_t)(int, int, uint64_t,  void *, int);
 typedef int (*proc_pidfdinfo_func_t)(int, int, int, void *, int); 
+typedef int (*proc_pid_rusage_func_t)(int, int, void **);
 #endif
 #else
 #include <kvm.h>
@@ -45,6 +48,29 @@ enum {
     KOFFSET_MAX
 };
 
+#ifdef DARWIN
+#ifdef HOST_VM_INFO64 /* 10.6+, 64-bit page counters */
+typedef vm_statistics64_data_t sigar_vmstat_t;
+#else
+typedef vm_statistics_data_t sigar_vmstat_t;
+#endif
+
+/* cpu_ticks are natural_t, totals are widened across wraps */
+typedef struct {
+    natural_t last[CPU_STATE_MAX];
+    sigar_uint64_t total[CPU_STATE_MAX];
+} sigar_mach_ticks_t;
+
+/* per sigar_t sampling state for the host_* calls */
+typedef struct {
+    sigar_vmstat_t vmstat; /* shared by mem and swap */
+    sigar_uint64_t vmstat_time; /* millis, 0 until the first query */
+    sigar_mach_ticks_t cpu;
+    sigar_mach_ticks_t *cpus;
+    natural_t ncpus;
+} sigar_mach_t;
+#endif
+
 #if defined(__OpenBSD__) || defined(__NetBSD__)
 typedef struct kinfo_proc2 bsd_pinfo_t;
 #else
@@ -57,14 +83,23 @@ struct sigar_t {
     time_t last_getprocs;
     sigar_pid_t last_pid;
     bsd_pinfo_t *pinfo;
+    struct kinfo_proc *procs; /* KERN_PROC table, reused between scans */
+    size_t procs_size;
+    char *pcb_buf; /* net.inet.*.pcblist, reused between walks */
+    size_t pcb_size;
     int lcpu;
     size_t argmax;
 #ifdef DARWIN
     mach_port_t mach_port;
+    sigar_mach_t mach;
 #  ifdef DARWIN_HAS_LIBPROC_H
     void *libproc;
     proc_pidinfo_func_t proc_pidinfo;
     proc_pidfdinfo_func_t proc_pidfdinfo;
+    proc_pid_rusage_func_t proc_pid_rusage; /* NULL before 10.9 */
+    sigar_cache_t *proc_port_index; /* (protocol, port) -> pid */
+    sigar_pool_t *proc_port_pool;
+    sigar_uint64_t proc_port_index_time;
 #  endif
 #else
     kvm_t *kmem;
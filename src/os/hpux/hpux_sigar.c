@@ -51,6 +51,11 @@ int sigar_os_open(sigar_t **sigar)
 
     (*sigar)->pinfo = NULL;
 
+    (*sigar)->procs = NULL;
+    (*sigar)->nprocs = (*sigar)->procs_size = 0;
+    (*sigar)->procs_time = 0;
+    (*sigar)->procs_index = NULL;
+
     (*sigar)->mib = -1;
     
     return SIGAR_OK;
@@ -62,6 +67,12 @@ int sigar_os_close(sigar_t *sigar)
     if (sigar->pinfo) {
         free(sigar->pinfo);
     }
+    if (sigar->procs) {
+        free(sigar->procs);
+    }
+    if (sigar->procs_index) {
+        sigar_cache_destroy(sigar->procs_index);
+    }
     if (sigar->mib >= 0) {
         close_mib(sigar->mib);
     } 
@@ -215,44 +226,115 @@ int sigar_loadavg_get(sigar_t *sigar,
     return SIGAR_OK;
 }
 
-#define PROC_ELTS 16
+#define PROC_ELTS 256
 
-int sigar_os_proc_list_get(sigar_t *sigar,
-                           sigar_proc_list_t *proclist)
+static void pstat_procs_index_free(void *ptr)
+{
+    /* values point into sigar->procs */
+}
+
+/*
+ * read the whole process table in large chunks into an arena which
+ * is reused across polls, indexed by pid so the per-process getters
+ * and sigar_proc_snapshot_get do not need a pstat_getproc each.
+ */
+static int sigar_pstat_procs_get(sigar_t *sigar)
 {
-    int num, idx=0;
-    struct pst_status proctab[PROC_ELTS];
+    int num, idx=0, i;
+    time_t timenow = time(NULL);
 
-    while ((num = pstat_getproc(proctab, sizeof(proctab[0]),
-                                PROC_ELTS, idx)) > 0)
+    if (sigar->procs_index &&
+        ((timenow - sigar->procs_time) < SIGAR_LAST_PROC_EXPIRE))
     {
-        int i;
+        return SIGAR_OK;
+    }
+
+    sigar->nprocs = 0;
 
-        for (i=0; i<num; i++) {
-            SIGAR_PROC_LIST_GROW(proclist);
-            proclist->data[proclist->number++] =
-                proctab[i].pst_pid;
+    for (;;) {
+        if ((sigar->procs_size - sigar->nprocs) < PROC_ELTS) {
+            sigar->procs_size += PROC_ELTS * 4;
+            sigar->procs =
+                realloc(sigar->procs,
+                        sizeof(*sigar->procs) * sigar->procs_size);
         }
 
-        idx = proctab[num-1].pst_idx + 1;
+        num = pstat_getproc(&sigar->procs[sigar->nprocs],
+                            sizeof(*sigar->procs),
+                            sigar->procs_size - sigar->nprocs, idx);
+        if (num <= 0) {
+            break;
+        }
+
+        sigar->nprocs += num;
+        idx = sigar->procs[sigar->nprocs-1].pst_idx + 1;
     }
 
-    if (proclist->number == 0) {
+    if (sigar->nprocs == 0) {
         return errno;
     }
 
+    if (sigar->procs_index) {
+        sigar_cache_destroy(sigar->procs_index);
+    }
+    sigar->procs_index = sigar_cache_new(sigar->nprocs);
+    sigar->procs_index->free_value = pstat_procs_index_free;
+
+    for (i=0; i<sigar->nprocs; i++) {
+        sigar_cache_entry_t *ent =
+            sigar_cache_get(sigar->procs_index, sigar->procs[i].pst_pid);
+        ent->value = &sigar->procs[i];
+    }
+
+    sigar->procs_time = timenow;
+
+    return SIGAR_OK;
+}
+
+int sigar_os_proc_list_get(sigar_t *sigar,
+                           sigar_proc_list_t *proclist)
+{
+    int i, status;
+
+    /* forced, a new list means a new poll */
+    sigar->procs_time = 0;
+
+    if ((status = sigar_pstat_procs_get(sigar)) != SIGAR_OK) {
+        return status;
+    }
+
+    for (i=0; i<sigar->nprocs; i++) {
+        SIGAR_PROC_LIST_GROW(proclist);
+        proclist->data[proclist->number++] =
+            sigar->procs[i].pst_pid;
+    }
+
     return SIGAR_OK;
 }
 
-static int sigar_pstat_getproc(sigar_t *sigar, sigar_pid_t pid)
+static int sigar_pstat_getproc(sigar_t *sigar, sigar_pid_t pid,
+                               struct pst_status **pinfo)
 {
-    int status, num;
     time_t timenow = time(NULL);
 
+    if (sigar->procs_index &&
+        ((timenow - sigar->procs_time) < SIGAR_LAST_PROC_EXPIRE))
+    {
+        sigar_cache_entry_t *ent =
+            sigar_cache_find(sigar->procs_index, pid);
+
+        if (ent && ent->value) {
+            *pinfo = (struct pst_status *)ent->value;
+            return SIGAR_OK;
+        }
+    }
+
     if (sigar->pinfo == NULL) {
         sigar->pinfo = malloc(sizeof(*sigar->pinfo));
     }
 
+    *pinfo = sigar->pinfo;
+
     if (sigar->last_pid == pid) {
         if ((timenow - sigar->last_getprocs) < SIGAR_LAST_PROC_EXPIRE) {
             return SIGAR_OK;
@@ -266,22 +348,17 @@ static int sigar_pstat_getproc(sigar_t *sigar, sigar_pid_t pid)
                       sizeof(*sigar->pinfo),
                       0, pid) == -1)
     {
+        sigar->last_pid = -1;
         return errno;
     }
 
     return SIGAR_OK;
 }
 
-int sigar_proc_mem_get(sigar_t *sigar, sigar_pid_t pid,
-                       sigar_proc_mem_t *procmem)
+static void pinfo_proc_mem_set(sigar_t *sigar, struct pst_status *pinfo,
+                               sigar_proc_mem_t *procmem)
 {
     int pagesize = sigar->pstatic.page_size;
-    int status = sigar_pstat_getproc(sigar, pid);
-    struct pst_status *pinfo = sigar->pinfo;
-
-    if (status != SIGAR_OK) {
-        return status;
-    }
 
     procmem->size = 
         pinfo->pst_vtsize + /* text */
@@ -293,7 +370,7 @@ int sigar_proc_mem_get(sigar_t *sigar, sigar_pid_t pid,
         pinfo->pst_viosize; /* I/O dev mapping */
 
     procmem->size *= pagesize;
-        
+
     procmem->resident = pinfo->pst_rssize * pagesize;
 
     procmem->share = pinfo->pst_vshmsize * pagesize;
@@ -303,6 +380,19 @@ int sigar_proc_mem_get(sigar_t *sigar, sigar_pid_t pid,
     procmem->page_faults =
         procmem->minor_faults +
         procmem->major_faults;
+}
+
+int sigar_proc_mem_get(sigar_t *sigar, sigar_pid_t pid,
+                       sigar_proc_mem_t *procmem)
+{
+    struct pst_status *pinfo;
+    int status = sigar_pstat_getproc(sigar, pid, &pinfo);
+
+    if (status != SIGAR_OK) {
+        return status;
+    }
+
+    pinfo_proc_mem_set(sigar, pinfo, procmem);
 
     return SIGAR_OK;
 }
@@ -311,8 +401,8 @@ int sigar_proc_cumulative_disk_io_get(sigar_t *sigar, sigar_pid_t pid,
                            sigar_proc_cumulative_disk_io_t *proc_cumulative_disk_io)
 {
 
-    int status = sigar_pstat_getproc(sigar, pid);
-    struct pst_status *pinfo = sigar->pinfo;
+    struct pst_status *pinfo;
+    int status = sigar_pstat_getproc(sigar, pid, &pinfo);
 
     if (status != SIGAR_OK) {
         return status;
@@ -329,8 +419,8 @@ int sigar_proc_cumulative_disk_io_get(sigar_t *sigar, sigar_pid_t pid,
 int sigar_proc_cred_get(sigar_t *sigar, sigar_pid_t pid,
                         sigar_proc_cred_t *proccred)
 {
-    int status = sigar_pstat_getproc(sigar, pid);
-    struct pst_status *pinfo = sigar->pinfo;
+    struct pst_status *pinfo;
+    int status = sigar_pstat_getproc(sigar, pid, &pinfo);
 
     if (status != SIGAR_OK) {
         return status;
@@ -344,36 +434,34 @@ int sigar_proc_cred_get(sigar_t *sigar, sigar_pid_t pid,
     return SIGAR_OK;
 }
 
-int sigar_proc_time_get(sigar_t *sigar, sigar_pid_t pid,
-                        sigar_proc_time_t *proctime)
+static void pinfo_proc_time_set(sigar_t *sigar, struct pst_status *pinfo,
+                                sigar_proc_time_t *proctime)
 {
-    int status = sigar_pstat_getproc(sigar, pid);
-    struct pst_status *pinfo = sigar->pinfo;
-
-    if (status != SIGAR_OK) {
-        return status;
-    }
-
     proctime->start_time = pinfo->pst_start;
     proctime->start_time *= SIGAR_MSEC;
     proctime->user = pinfo->pst_utime * SIGAR_MSEC;
     proctime->sys  = pinfo->pst_stime * SIGAR_MSEC;
     proctime->total = proctime->user + proctime->sys;
-
-    return SIGAR_OK;
 }
 
-int sigar_proc_state_get(sigar_t *sigar, sigar_pid_t pid,
-                         sigar_proc_state_t *procstate)
+int sigar_proc_time_get(sigar_t *sigar, sigar_pid_t pid,
+                        sigar_proc_time_t *proctime)
 {
-    int status = sigar_pstat_getproc(sigar, pid);
-    struct pst_status *pinfo = sigar->pinfo;
+    struct pst_status *pinfo;
+    int status = sigar_pstat_getproc(sigar, pid, &pinfo);
 
     if (status != SIGAR_OK) {
         return status;
     }
 
-        
+    pinfo_proc_time_set(sigar, pinfo, proctime);
+
+    return SIGAR_OK;
+}
+
+static void pinfo_proc_state_set(sigar_t *sigar, struct pst_status *pinfo,
+                                 sigar_proc_state_t *procstate)
+{
     SIGAR_SSTRCPY(procstate->name, pinfo->pst_ucomm);
     procstate->ppid = pinfo->pst_ppid;
     procstate->tty  = makedev(pinfo->pst_term.psd_major,
@@ -402,6 +490,59 @@ int sigar_proc_state_get(sigar_t *sigar, sigar_pid_t pid,
         procstate->state = 'D';
         break;
     }
+}
+
+int sigar_proc_state_get(sigar_t *sigar, sigar_pid_t pid,
+                         sigar_proc_state_t *procstate)
+{
+    struct pst_status *pinfo;
+    int status = sigar_pstat_getproc(sigar, pid, &pinfo);
+
+    if (status != SIGAR_OK) {
+        return status;
+    }
+
+    pinfo_proc_state_set(sigar, pinfo, procstate);
+
+    return SIGAR_OK;
+}
+
+int sigar_os_proc_snapshot_get(sigar_t *sigar, int flags,
+                               sigar_proc_snapshot_t *snapshot)
+{
+    int i, status;
+
+    sigar->procs_time = 0; /* same as sigar_os_proc_list_get */
+
+    if ((status = sigar_pstat_procs_get(sigar)) != SIGAR_OK) {
+        return status;
+    }
+
+    for (i=0; i<sigar->nprocs; i++) {
+        struct pst_status *pinfo = &sigar->procs[i];
+        sigar_proc_snapshot_entry_t *entry;
+
+        SIGAR_PROC_SNAPSHOT_GROW(snapshot);
+        entry = &snapshot->data[snapshot->number++];
+        entry->pid = pinfo->pst_pid;
+        entry->flags = 0;
+
+        if (flags & SIGAR_PROC_SNAPSHOT_STATE) {
+            pinfo_proc_state_set(sigar, pinfo, &entry->state);
+            entry->flags |= SIGAR_PROC_SNAPSHOT_STATE;
+        }
+
+        if (flags & SIGAR_PROC_SNAPSHOT_MEM) {
+            pinfo_proc_mem_set(sigar, pinfo, &entry->mem);
+            entry->flags |= SIGAR_PROC_SNAPSHOT_MEM;
+        }
+
+        if (flags & SIGAR_PROC_SNAPSHOT_TIME) {
+            pinfo_proc_time_set(sigar, pinfo,
+                                (sigar_proc_time_t *)&entry->cpu);
+            entry->flags |= SIGAR_PROC_SNAPSHOT_TIME;
+        }
+    }
 
     return SIGAR_OK;
 }
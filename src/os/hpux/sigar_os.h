@@ -40,6 +40,11 @@ struct sigar_t {
     time_t last_getprocs;
     sigar_pid_t last_pid;
     struct pst_status *pinfo;
+    /* every pst_status, read in PROC_ELTS chunks once per poll */
+    struct pst_status *procs;
+    int nprocs, procs_size;
+    time_t procs_time;
+    sigar_cache_t *procs_index; /* pid -> procs[] */
 
     int mib;
 };
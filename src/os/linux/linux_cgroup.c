@@ -0,0 +1,730 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * cgroup resource accounting, read from the cgroup's own files instead
+ * of summing its processes.  the unified (v2) hierarchy is used unless a
+ * v1 memory or cpuacct hierarchy is mounted, in which case each v1
+ * controller is read from its own mount.  a cgroup is known by the inode
+ * of its directory, which on v2 is the kernel's cgroup id.  v1 paths
+ * are taken from the memory (else cpuacct) hierarchy and assumed to be
+ * the same in the others, as systemd and container runtimes lay them out.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+
+#include "sigar.h"
+#include "sigar_private.h"
+#include "sigar_util.h"
+#include "sigar_os.h"
+
+#define PROC_MOUNTINFO "self/mountinfo"
+
+/* v1 memory.limit_in_bytes when unset, LONG_MAX rounded down to a page */
+#define CGROUP_V1_UNLIMITED 0x7FFFFFFFFFFFF000ULL
+
+/* entries only go stale when a cgroup is removed */
+#define CGROUP_ID_EXPIRE (60 * SIGAR_MSEC)
+
+typedef enum {
+    CGROUP_CPUACCT,
+    CGROUP_CPU,
+    CGROUP_MEMORY,
+    CGROUP_BLKIO,
+    CGROUP_PIDS,
+    CGROUP_PERF_EVENT,
+    CGROUP_MAX
+} cgroup_controller_e;
+
+static const char *cgroup_v1_names[] = {
+    "cpuacct", "cpu", "memory", "blkio", "pids", "perf_event"
+};
+
+struct linux_cgroup_t {
+    int status;              /* SIGAR_ENOTIMPL if nothing is mounted */
+    int unified;
+    char *root;              /* cgroup2 mount */
+    char *v1[CGROUP_MAX];    /* v1 mounts, NULL if not mounted */
+    int v1_id;               /* the hierarchy paths and ids come from */
+    sigar_cache_t *ids;      /* path hash -> sigar_uint64_t inode */
+    sigar_cache_t *stats;    /* inode -> cgroup_stat_entry_t */
+};
+
+typedef struct {
+    sigar_uint64_t time;
+    sigar_cgroup_stat_t stat;
+} cgroup_stat_entry_t;
+
+/* is name one of the comma separated words in list */
+static int cgroup_opt_has(const char *list, const char *name)
+{
+    size_t len = strlen(name);
+
+    while (list && *list) {
+        if (strnEQ(list, name, len) &&
+            ((list[len] == ',') || (list[len] == '\0')))
+        {
+            return 1;
+        }
+        if ((list = strchr(list, ','))) {
+            ++list;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * "36 25 0:30 / /sys/fs/cgroup/memory rw,nosuid - cgroup cgroup rw,memory"
+ * the mount point is the 5th field, type and options follow the " - "
+ */
+static void cgroup_mount_add(linux_cgroup_t *cgroup, char *line)
+{
+    char *fields[5], *type, *opts, *ptr = line;
+    int i;
+
+    for (i=0; i<5; i++) {
+        fields[i] = ptr;
+        if (!(ptr = strchr(ptr, ' '))) {
+            return;
+        }
+        *ptr++ = '\0';
+    }
+
+    if (!(type = strstr(ptr, " - "))) {
+        return;
+    }
+    type += 3;
+    if (!(ptr = strchr(type, ' '))) {
+        return;
+    }
+    *ptr++ = '\0';
+    /* skip the source */
+    if (!(opts = strchr(ptr, ' '))) {
+        return;
+    }
+    ++opts;
+    if ((ptr = strchr(opts, '\n'))) {
+        *ptr = '\0';
+    }
+
+    if (strEQ(type, "cgroup2")) {
+        if (!cgroup->root) {
+            cgroup->root = sigar_strdup(fields[4]);
+        }
+    }
+    else if (strEQ(type, "cgroup")) {
+        for (i=0; i<CGROUP_MAX; i++) {
+            if (!cgroup->v1[i] && cgroup_opt_has(opts, cgroup_v1_names[i])) {
+                cgroup->v1[i] = sigar_strdup(fields[4]);
+            }
+        }
+    }
+}
+
+/* where the files of controller live, NULL if it is not mounted */
+static const char *cgroup_base(linux_cgroup_t *cgroup, int controller)
+{
+    return cgroup->unified ? cgroup->root : cgroup->v1[controller];
+}
+
+static int cgroup_open(sigar_t *sigar, linux_cgroup_t **cgroupp)
+{
+    linux_cgroup_t *cgroup = sigar->cgroup;
+    char buffer[BUFSIZ];
+    FILE *fp;
+
+    if (cgroup) {
+        *cgroupp = cgroup;
+        return cgroup->status;
+    }
+
+    if (!(fp = fopen(SIGAR_PROCFS_FILENAME(buffer, PROC_MOUNTINFO), "r"))) {
+        return errno;
+    }
+
+    cgroup = sigar->cgroup = calloc(1, sizeof(*cgroup));
+
+    while (fgets(buffer, sizeof(buffer), fp)) {
+        cgroup_mount_add(cgroup, buffer);
+    }
+
+    fclose(fp);
+
+    if (cgroup->v1[CGROUP_MEMORY]) {
+        cgroup->v1_id = CGROUP_MEMORY;
+    }
+    else if (cgroup->v1[CGROUP_CPUACCT]) {
+        cgroup->v1_id = CGROUP_CPUACCT;
+    }
+    else {
+        cgroup->unified = 1;
+    }
+
+    cgroup->status =
+        cgroup_base(cgroup, cgroup->v1_id) ? SIGAR_OK : SIGAR_ENOTIMPL;
+    cgroup->ids = sigar_expired_cache_new(128, CGROUP_ID_EXPIRE,
+                                          CGROUP_ID_EXPIRE);
+    cgroup->stats = sigar_expired_cache_new(128, CGROUP_ID_EXPIRE,
+                                            CGROUP_ID_EXPIRE);
+
+    *cgroupp = cgroup;
+
+    return cgroup->status;
+}
+
+void linux_cgroup_close(sigar_t *sigar)
+{
+    linux_cgroup_t *cgroup = sigar->cgroup;
+    int i;
+
+    if (!cgroup) {
+        return;
+    }
+
+    if (cgroup->root) {
+        free(cgroup->root);
+    }
+    for (i=0; i<CGROUP_MAX; i++) {
+        if (cgroup->v1[i]) {
+            free(cgroup->v1[i]);
+        }
+    }
+    sigar_cache_destroy(cgroup->ids);
+    sigar_cache_destroy(cgroup->stats);
+    free(cgroup);
+    sigar->cgroup = NULL;
+}
+
+static int cgroup_file2str(linux_cgroup_t *cgroup, int controller,
+                           const char *path, const char *name,
+                           char *buffer, int buflen)
+{
+    const char *base = cgroup_base(cgroup, controller);
+    char file[SIGAR_PATH_MAX+1];
+
+    if (!base) {
+        return ENOENT;
+    }
+
+    if (strEQ(path, "/")) {
+        path = "";
+    }
+    snprintf(file, sizeof(file), "%s%s/%s", base, path, name);
+
+    return sigar_file2str(file, buffer, buflen);
+}
+
+/* fnv-1a, same as the interface name index */
+static sigar_uint64_t cgroup_path_hash(const char *path)
+{
+    sigar_uint64_t hash = 14695981039346656037ULL;
+
+    while (*path) {
+        hash ^= (unsigned char)*path++;
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+static int cgroup_id_get(linux_cgroup_t *cgroup, const char *path,
+                         sigar_uint64_t *id)
+{
+    sigar_cache_entry_t *entry;
+    sigar_uint64_t key = cgroup_path_hash(path);
+    const char *base = cgroup_base(cgroup, cgroup->v1_id);
+    char dir[SIGAR_PATH_MAX+1];
+    struct stat sb;
+
+    if ((entry = sigar_cache_find(cgroup->ids, key))) {
+        *id = *(sigar_uint64_t *)entry->value;
+        return SIGAR_OK;
+    }
+
+    snprintf(dir, sizeof(dir), "%s%s", base, path);
+    if (stat(dir, &sb) < 0) {
+        return errno;
+    }
+
+    entry = sigar_cache_get(cgroup->ids, key);
+    if (!entry->value) {
+        entry->value = sigar_cache_value_new(cgroup->ids, sizeof(*id));
+    }
+    *id = *(sigar_uint64_t *)entry->value = sb.st_ino;
+
+    return SIGAR_OK;
+}
+
+int linux_cgroup_perf_open(sigar_t *sigar, const char *path,
+                           int *fd, sigar_uint64_t *id)
+{
+    linux_cgroup_t *cgroup;
+    const char *base;
+    char dir[SIGAR_PATH_MAX+1];
+    int status;
+
+    if ((status = cgroup_open(sigar, &cgroup)) != SIGAR_OK) {
+        return status;
+    }
+
+    if (!(base = cgroup_base(cgroup, CGROUP_PERF_EVENT))) {
+        return SIGAR_ENOTIMPL;
+    }
+
+    if ((status = cgroup_id_get(cgroup, path, id)) != SIGAR_OK) {
+        return status;
+    }
+
+    snprintf(dir, sizeof(dir), "%s%s", base, strEQ(path, "/") ? "" : path);
+    if ((*fd = open(dir, O_RDONLY|O_DIRECTORY)) < 0) {
+        return errno;
+    }
+
+    return SIGAR_OK;
+}
+
+/*
+ * /proc/<pid>/cgroup, one "hierarchy:controllers:path" line per
+ * hierarchy; v2 is the "0::" line.
+ */
+int sigar_proc_cgroup_get(sigar_t *sigar, sigar_pid_t pid,
+                          sigar_proc_cgroup_t *proccgroup)
+{
+    linux_cgroup_t *cgroup;
+    char buffer[BUFSIZ], *line, *ptr;
+    int status;
+
+    if ((status = cgroup_open(sigar, &cgroup)) != SIGAR_OK) {
+        return status;
+    }
+
+    if ((status = SIGAR_PROC_FILE2STR(buffer, pid, "/cgroup")) != SIGAR_OK) {
+        return status;
+    }
+
+    for (line = buffer; line && *line; line = ptr) {
+        char *controllers, *path;
+
+        if ((ptr = strchr(line, '\n'))) {
+            *ptr++ = '\0';
+        }
+
+        if (!(controllers = strchr(line, ':')) ||
+            !(path = strchr(++controllers, ':')))
+        {
+            continue;
+        }
+        *path++ = '\0';
+
+        if (cgroup->unified ?
+            strnEQ(line, "0:", 2) && (*controllers == '\0') :
+            cgroup_opt_has(controllers, cgroup_v1_names[cgroup->v1_id]))
+        {
+            SIGAR_SSTRCPY(proccgroup->path, path);
+            return cgroup_id_get(cgroup, proccgroup->path, &proccgroup->id);
+        }
+    }
+
+    return ENOENT;
+}
+
+/* "max" is how v2 spells unlimited */
+static sigar_uint64_t cgroup_value(char *ptr)
+{
+    while (sigar_isspace(*ptr)) {
+        ++ptr;
+    }
+    if (strnEQ(ptr, "max", 3)) {
+        return SIGAR_FIELD_NOTIMPL;
+    }
+    return sigar_strtoull(ptr);
+}
+
+static sigar_uint64_t cgroup_file_value(linux_cgroup_t *cgroup,
+                                        int controller,
+                                        const char *path, const char *name)
+{
+    char buffer[64];
+
+    if (cgroup_file2str(cgroup, controller, path, name,
+                        buffer, sizeof(buffer)) != SIGAR_OK)
+    {
+        return SIGAR_FIELD_NOTIMPL;
+    }
+
+    return cgroup_value(buffer);
+}
+
+#define CGROUP_KEYVAL_GET(key, factor) \
+    ((key).value ? cgroup_value((key).value) / (factor) : SIGAR_FIELD_NOTIMPL)
+
+static void cgroup_v2_stat_get(linux_cgroup_t *cgroup, const char *path,
+                               sigar_cgroup_stat_t *stat)
+{
+    char buffer[BUFSIZ], *ptr;
+    sigar_keyval_t cpu[] = {
+        SIGAR_KEYVAL("usage_usec "),
+        SIGAR_KEYVAL("user_usec "),
+        SIGAR_KEYVAL("system_usec "),
+        SIGAR_KEYVAL("nr_periods "),
+        SIGAR_KEYVAL("nr_throttled "),
+        SIGAR_KEYVAL("throttled_usec ")
+    };
+    sigar_keyval_t mem[] = {
+        SIGAR_KEYVAL("anon "),
+        SIGAR_KEYVAL("file ")
+    };
+
+    if (cgroup_file2str(cgroup, CGROUP_CPU, path, "cpu.stat",
+                        buffer, sizeof(buffer)) == SIGAR_OK)
+    {
+        sigar_keyval_scan(buffer, cpu, sizeof(cpu)/sizeof(cpu[0]));
+        stat->cpu_total = CGROUP_KEYVAL_GET(cpu[0], 1000);
+        stat->cpu_user = CGROUP_KEYVAL_GET(cpu[1], 1000);
+        stat->cpu_sys = CGROUP_KEYVAL_GET(cpu[2], 1000);
+        stat->cpu_periods = CGROUP_KEYVAL_GET(cpu[3], 1);
+        stat->cpu_throttled = CGROUP_KEYVAL_GET(cpu[4], 1);
+        stat->cpu_throttled_time = CGROUP_KEYVAL_GET(cpu[5], 1000);
+    }
+
+    stat->mem_current =
+        cgroup_file_value(cgroup, CGROUP_MEMORY, path, "memory.current");
+    stat->mem_limit =
+        cgroup_file_value(cgroup, CGROUP_MEMORY, path, "memory.max");
+
+    if (cgroup_file2str(cgroup, CGROUP_MEMORY, path, "memory.stat",
+                        buffer, sizeof(buffer)) == SIGAR_OK)
+    {
+        sigar_keyval_scan(buffer, mem, sizeof(mem)/sizeof(mem[0]));
+        stat->mem_anon = CGROUP_KEYVAL_GET(mem[0], 1);
+        stat->mem_file = CGROUP_KEYVAL_GET(mem[1], 1);
+    }
+
+    /* "8:0 rbytes=1024 wbytes=0 rios=1 wios=0 dbytes=0 dios=0" per device */
+    if (cgroup_file2str(cgroup, CGROUP_BLKIO, path, "io.stat",
+                        buffer, sizeof(buffer)) == SIGAR_OK)
+    {
+        stat->io_read_bytes = stat->io_write_bytes =
+            stat->io_reads = stat->io_writes = 0;
+
+        for (ptr = buffer; (ptr = strchr(ptr, '=')); ) {
+            sigar_uint64_t *field = NULL;
+            char *key = ptr;
+
+            while ((key > buffer) && !sigar_isspace(key[-1])) {
+                --key;
+            }
+            if (strnEQ(key, "rbytes=", 7)) {
+                field = &stat->io_read_bytes;
+            }
+            else if (strnEQ(key, "wbytes=", 7)) {
+                field = &stat->io_write_bytes;
+            }
+            else if (strnEQ(key, "rios=", 5)) {
+                field = &stat->io_reads;
+            }
+            else if (strnEQ(key, "wios=", 5)) {
+                field = &stat->io_writes;
+            }
+
+            ++ptr;
+            if (field) {
+                *field += sigar_strtoull(ptr);
+            }
+        }
+    }
+}
+
+/*
+ * blkio.throttle.io_service_bytes and io_serviced, e.g.
+ * "8:0 Read 1024\n8:0 Write 0\n...\nTotal 1024"
+ */
+static void cgroup_v1_blkio_sum(char *buffer,
+                                sigar_uint64_t *reads,
+                                sigar_uint64_t *writes)
+{
+    char *ptr = buffer;
+
+    *reads = *writes = 0;
+
+    while ((ptr = strchr(ptr, ' '))) {
+        ++ptr;
+        if (strnEQ(ptr, "Read ", 5)) {
+            ptr += 5;
+            *reads += sigar_strtoull(ptr);
+        }
+        else if (strnEQ(ptr, "Write ", 6)) {
+            ptr += 6;
+            *writes += sigar_strtoull(ptr);
+        }
+    }
+}
+
+static void cgroup_v1_stat_get(sigar_t *sigar, linux_cgroup_t *cgroup,
+                               const char *path, sigar_cgroup_stat_t *stat)
+{
+    char buffer[BUFSIZ];
+    sigar_keyval_t cpuacct[] = {
+        SIGAR_KEYVAL("user "),
+        SIGAR_KEYVAL("system ")
+    };
+    sigar_keyval_t cpu[] = {
+        SIGAR_KEYVAL("nr_periods "),
+        SIGAR_KEYVAL("nr_throttled "),
+        SIGAR_KEYVAL("throttled_time ")
+    };
+    sigar_keyval_t mem[] = {
+        SIGAR_KEYVAL("total_rss "),
+        SIGAR_KEYVAL("total_cache ")
+    };
+
+    stat->cpu_total =
+        cgroup_file_value(cgroup, CGROUP_CPUACCT, path, "cpuacct.usage");
+    if (stat->cpu_total != SIGAR_FIELD_NOTIMPL) {
+        stat->cpu_total = SIGAR_NSEC2MSEC(stat->cpu_total);
+    }
+
+    /* USER_HZ ticks */
+    if (cgroup_file2str(cgroup, CGROUP_CPUACCT, path, "cpuacct.stat",
+                        buffer, sizeof(buffer)) == SIGAR_OK)
+    {
+        sigar_keyval_scan(buffer, cpuacct, 2);
+        if (cpuacct[0].value) {
+            stat->cpu_user = SIGAR_TICK2MSEC(cgroup_value(cpuacct[0].value));
+        }
+        if (cpuacct[1].value) {
+            stat->cpu_sys = SIGAR_TICK2MSEC(cgroup_value(cpuacct[1].value));
+        }
+    }
+
+    if (cgroup_file2str(cgroup, CGROUP_CPU, path, "cpu.stat",
+                        buffer, sizeof(buffer)) == SIGAR_OK)
+    {
+        sigar_keyval_scan(buffer, cpu, sizeof(cpu)/sizeof(cpu[0]));
+        stat->cpu_periods = CGROUP_KEYVAL_GET(cpu[0], 1);
+        stat->cpu_throttled = CGROUP_KEYVAL_GET(cpu[1], 1);
+        stat->cpu_throttled_time = CGROUP_KEYVAL_GET(cpu[2], 1000000);
+    }
+
+    stat->mem_current =
+        cgroup_file_value(cgroup, CGROUP_MEMORY, path,
+                          "memory.usage_in_bytes");
+    stat->mem_limit =
+        cgroup_file_value(cgroup, CGROUP_MEMORY, path,
+                          "memory.limit_in_bytes");
+    if (stat->mem_limit >= CGROUP_V1_UNLIMITED) {
+        stat->mem_limit = SIGAR_FIELD_NOTIMPL;
+    }
+
+    if (cgroup_file2str(cgroup, CGROUP_MEMORY, path, "memory.stat",
+                        buffer, sizeof(buffer)) == SIGAR_OK)
+    {
+        sigar_keyval_scan(buffer, mem, sizeof(mem)/sizeof(mem[0]));
+        stat->mem_anon = CGROUP_KEYVAL_GET(mem[0], 1);
+        stat->mem_file = CGROUP_KEYVAL_GET(mem[1], 1);
+    }
+
+    if (cgroup_file2str(cgroup, CGROUP_BLKIO, path,
+                        "blkio.throttle.io_service_bytes",
+                        buffer, sizeof(buffer)) == SIGAR_OK)
+    {
+        cgroup_v1_blkio_sum(buffer,
+                            &stat->io_read_bytes, &stat->io_write_bytes);
+    }
+
+    if (cgroup_file2str(cgroup, CGROUP_BLKIO, path,
+                        "blkio.throttle.io_serviced",
+                        buffer, sizeof(buffer)) == SIGAR_OK)
+    {
+        cgroup_v1_blkio_sum(buffer, &stat->io_reads, &stat->io_writes);
+    }
+}
+
+int sigar_cgroup_stat_get(sigar_t *sigar, const char *path,
+                          sigar_cgroup_stat_t *cgroupstat)
+{
+    linux_cgroup_t *cgroup;
+    sigar_cache_entry_t *entry;
+    cgroup_stat_entry_t *cached;
+    sigar_uint64_t id, timenow = sigar_time_now_millis();
+    sigar_uint64_t *field = (sigar_uint64_t *)cgroupstat;
+    int i, status;
+
+    if ((status = cgroup_open(sigar, &cgroup)) != SIGAR_OK) {
+        return status;
+    }
+
+    if ((status = cgroup_id_get(cgroup, path, &id)) != SIGAR_OK) {
+        return status;
+    }
+
+    entry = sigar_cache_get(cgroup->stats, id);
+    if ((cached = entry->value)) {
+        if ((timenow >= cached->time) &&
+            (timenow < cached->time + sigar->proc_cache_expire))
+        {
+            memcpy(cgroupstat, &cached->stat, sizeof(*cgroupstat));
+            return SIGAR_OK;
+        }
+    }
+    else {
+        cached = entry->value =
+            sigar_cache_value_new(cgroup->stats, sizeof(*cached));
+    }
+
+    /* all members are sigar_uint64_t */
+    for (i=0; i<sizeof(*cgroupstat)/sizeof(*field); i++) {
+        field[i] = SIGAR_FIELD_NOTIMPL;
+    }
+    cgroupstat->id = id;
+
+    if (cgroup->unified) {
+        cgroup_v2_stat_get(cgroup, path, cgroupstat);
+    }
+    else {
+        cgroup_v1_stat_get(sigar, cgroup, path, cgroupstat);
+    }
+
+    cgroupstat->pids_current =
+        cgroup_file_value(cgroup, CGROUP_PIDS, path, "pids.current");
+    cgroupstat->pids_limit =
+        cgroup_file_value(cgroup, CGROUP_PIDS, path, "pids.max");
+
+    cached->time = timenow;
+    memcpy(&cached->stat, cgroupstat, sizeof(*cgroupstat));
+
+    return SIGAR_OK;
+}
+
+/* psi is only in the cgroup2 hierarchy, mounted alongside v1 or not */
+int sigar_cgroup_pressure_get(sigar_t *sigar, const char *path,
+                              sigar_pressure_t *pressure)
+{
+    struct {
+        const char *name;
+        sigar_pressure_resource_t *resource;
+    } files[] = {
+        { "cpu.pressure",    &pressure->cpu },
+        { "memory.pressure", &pressure->memory },
+        { "io.pressure",     &pressure->io }
+    };
+    linux_cgroup_t *cgroup;
+    char file[SIGAR_PATH_MAX+1], buffer[BUFSIZ];
+    int i, status, found = 0;
+
+    if ((status = cgroup_open(sigar, &cgroup)) != SIGAR_OK) {
+        return status;
+    }
+    if (!cgroup->root) {
+        return SIGAR_ENOTIMPL;
+    }
+
+    if (strEQ(path, "/")) {
+        path = "";
+    }
+
+    linux_pressure_reset(pressure);
+
+    for (i=0; i<3; i++) {
+        snprintf(file, sizeof(file), "%s%s/%s",
+                 cgroup->root, path, files[i].name);
+
+        if ((status = sigar_file2str(file, buffer, sizeof(buffer))) ==
+            SIGAR_OK)
+        {
+            linux_pressure_parse(buffer, files[i].resource);
+            found++;
+        }
+        else if (status == ENOENT) {
+            status = SIGAR_ENOTIMPL; /* the root has none before 5.x */
+        }
+    }
+
+    return found ? SIGAR_OK : status;
+}
+
+static void cgroup_list_add(sigar_cgroup_list_t *cgroups, const char *path)
+{
+    SIGAR_CGROUP_LIST_GROW(cgroups);
+    cgroups->data[cgroups->number++] = sigar_strdup(path);
+}
+
+/* dir is base + path, path is what goes in the list */
+static void cgroup_list_walk(sigar_cgroup_list_t *cgroups,
+                             char *dir, size_t baselen)
+{
+    size_t len = strlen(dir);
+    struct dirent *ent;
+    DIR *dirp;
+
+    cgroup_list_add(cgroups, len > baselen ? dir + baselen : "/");
+
+    if (!(dirp = opendir(dir))) {
+        return;
+    }
+
+    while ((ent = readdir(dirp))) {
+        struct stat sb;
+
+        if ((ent->d_name[0] == '.') &&
+            ((ent->d_name[1] == '\0') ||
+             ((ent->d_name[1] == '.') && (ent->d_name[2] == '\0'))))
+        {
+            continue;
+        }
+
+        if (len + 1 + strlen(ent->d_name) >= SIGAR_PATH_MAX) {
+            continue;
+        }
+        dir[len] = '/';
+        strcpy(dir + len + 1, ent->d_name);
+
+        if ((ent->d_type == DT_DIR) ||
+            ((ent->d_type == DT_UNKNOWN) &&
+             (lstat(dir, &sb) == 0) && S_ISDIR(sb.st_mode)))
+        {
+            cgroup_list_walk(cgroups, dir, baselen);
+        }
+
+        dir[len] = '\0';
+    }
+
+    closedir(dirp);
+}
+
+int sigar_cgroup_list_get(sigar_t *sigar, sigar_cgroup_list_t *cgroups)
+{
+    linux_cgroup_t *cgroup;
+    char dir[SIGAR_PATH_MAX+1];
+    int status;
+
+    if ((status = cgroup_open(sigar, &cgroup)) != SIGAR_OK) {
+        return status;
+    }
+
+    SIGAR_SSTRCPY(dir, cgroup_base(cgroup, cgroup->v1_id));
+
+    sigar_cgroup_list_create(cgroups);
+    cgroup_list_walk(cgroups, dir, strlen(dir));
+
+    return SIGAR_OK;
+}
@@ -0,0 +1,516 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * hardware counters through perf_event_open.  a process gets one
+ * group per thread, inherited by the threads and children those
+ * start; a cgroup one group per cpu.  the counters of a group are
+ * read with a single read() of its leader.  which counters open is
+ * settled by the first group, a vm without a pmu ends up with the
+ * context switches only.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <unistd.h>
+
+#include "sigar.h"
+#include "sigar_private.h"
+#include "sigar_util.h"
+#include "sigar_os.h"
+
+#ifdef HAVE_LINUX_PERF_EVENT_H
+
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#ifndef PERF_FLAG_PID_CGROUP
+#define PERF_FLAG_PID_CGROUP (1UL << 2)
+#endif
+
+typedef enum {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_CACHE_MISSES,
+    PERF_CONTEXT_SWITCHES,
+    PERF_EVENT_MAX
+} linux_perf_event_e;
+
+static const struct {
+    sigar_uint32_t type;
+    sigar_uint64_t config;
+} perf_events[] = {
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+    { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES }
+};
+
+#define PERF_READ_FORMAT \
+    (PERF_FORMAT_GROUP | \
+     PERF_FORMAT_TOTAL_TIME_ENABLED | \
+     PERF_FORMAT_TOTAL_TIME_RUNNING)
+
+/* what a read() of a leader gives with PERF_READ_FORMAT */
+typedef struct {
+    sigar_uint64_t nr;
+    sigar_uint64_t time_enabled;
+    sigar_uint64_t time_running;
+    sigar_uint64_t values[PERF_EVENT_MAX];
+} perf_group_read_t;
+
+typedef struct {
+    int ngroups;
+    int nevents;                 /* opened in every group */
+    int events[PERF_EVENT_MAX];  /* linux_perf_event_e, in group order */
+    int *fds;                    /* PERF_EVENT_MAX per group, -1 if none */
+} perf_target_t;
+
+struct linux_perf_t {
+    sigar_cache_t *pids;    /* pid -> perf_target_t */
+    sigar_cache_t *cgroups; /* cgroup id -> perf_target_t */
+};
+
+static void perf_target_free(void *ptr)
+{
+    perf_target_t *target = ptr;
+    int i;
+
+    for (i=0; i<target->ngroups * PERF_EVENT_MAX; i++) {
+        if (target->fds[i] >= 0) {
+            close(target->fds[i]);
+        }
+    }
+    free(target->fds);
+    free(target);
+}
+
+static linux_perf_t *perf_get(sigar_t *sigar)
+{
+    linux_perf_t *perf = sigar->perf;
+
+    if (!perf) {
+        perf = sigar->perf = malloc(sizeof(*perf));
+        perf->pids = sigar_cache_new(16);
+        perf->pids->free_value = perf_target_free;
+        perf->cgroups = sigar_cache_new(16);
+        perf->cgroups->free_value = perf_target_free;
+    }
+
+    return perf;
+}
+
+void linux_perf_close(sigar_t *sigar)
+{
+    linux_perf_t *perf = sigar->perf;
+
+    if (!perf) {
+        return;
+    }
+
+    sigar_cache_destroy(perf->pids);
+    sigar_cache_destroy(perf->cgroups);
+    free(perf);
+    sigar->perf = NULL;
+}
+
+static int perf_event_fd(int event, pid_t pid, int cpu,
+                         int group_fd, unsigned long flags)
+{
+    struct perf_event_attr attr;
+    int fd;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = perf_events[event].type;
+    attr.config = perf_events[event].config;
+    attr.read_format = PERF_READ_FORMAT;
+    attr.inherit = (flags & PERF_FLAG_PID_CGROUP) ? 0 : 1;
+
+    fd = syscall(__NR_perf_event_open, &attr, pid, cpu, group_fd, flags);
+
+    if ((fd < 0) && ((errno == EACCES) || (errno == EPERM))) {
+        /* perf_event_paranoid 2 leaves us user space only */
+        attr.exclude_kernel = attr.exclude_hv = 1;
+        fd = syscall(__NR_perf_event_open, &attr,
+                     pid, cpu, group_fd, flags);
+    }
+
+    return fd;
+}
+
+/*
+ * the first group tries every counter and keeps those which open,
+ * the others open the same ones or not at all.  with errno set on
+ * failure.
+ */
+static int perf_group_open(perf_target_t *target, pid_t pid, int cpu,
+                           unsigned long flags)
+{
+    int *fds, i, leader = -1;
+
+    fds = realloc(target->fds,
+                  sizeof(*fds) * PERF_EVENT_MAX * (target->ngroups + 1));
+    if (!fds) {
+        errno = ENOMEM;
+        return -1;
+    }
+    target->fds = fds;
+    fds += PERF_EVENT_MAX * target->ngroups;
+
+    for (i=0; i<PERF_EVENT_MAX; i++) {
+        fds[i] = -1;
+    }
+
+    if (target->ngroups == 0) {
+        for (i=0; i<PERF_EVENT_MAX; i++) {
+            int fd = perf_event_fd(i, pid, cpu, leader, flags);
+
+            if (fd < 0) {
+                continue; /* e.g. ENOENT, no such counter here */
+            }
+            if (leader < 0) {
+                leader = fd;
+            }
+            fds[target->nevents] = fd;
+            target->events[target->nevents++] = i;
+        }
+        if (leader < 0) {
+            return -1;
+        }
+    }
+    else {
+        for (i=0; i<target->nevents; i++) {
+            int fd = perf_event_fd(target->events[i], pid, cpu,
+                                   leader, flags);
+
+            if (fd < 0) {
+                int status = errno;
+
+                while (i-- > 0) {
+                    close(fds[i]);
+                    fds[i] = -1;
+                }
+                errno = status;
+                return -1;
+            }
+            if (leader < 0) {
+                leader = fd;
+            }
+            fds[i] = fd;
+        }
+    }
+
+    target->ngroups++;
+
+    return SIGAR_OK;
+}
+
+static int perf_pid_open(sigar_t *sigar, sigar_pid_t pid,
+                         perf_target_t *target)
+{
+    char task[SIGAR_PATH_MAX+1];
+    struct dirent *ent;
+    DIR *dirp;
+    int status = ESRCH;
+
+    if (!(dirp = opendir(SIGAR_PROC_FILENAME(task, pid, "/task")))) {
+        /* no task dir, pre 2.6 or not ours to read */
+        if (perf_group_open(target, (pid_t)pid, -1, 0) < 0) {
+            return errno;
+        }
+        return SIGAR_OK;
+    }
+
+    while ((ent = readdir(dirp))) {
+        pid_t tid;
+
+        if (!sigar_isdigit(*ent->d_name)) {
+            continue;
+        }
+        tid = (pid_t)strtoul(ent->d_name, NULL, 10);
+
+        if (perf_group_open(target, tid, -1, 0) < 0) {
+            /* a thread which exited since is no reason to give up */
+            if ((target->ngroups == 0) && (errno != ESRCH)) {
+                status = errno;
+                break;
+            }
+        }
+    }
+
+    closedir(dirp);
+
+    return target->ngroups ? SIGAR_OK : status;
+}
+
+static int perf_cgroup_open(sigar_t *sigar, int cgroup_fd,
+                            perf_target_t *target)
+{
+    int cpu, ncpu = (int)sysconf(_SC_NPROCESSORS_CONF);
+    int status = ENODEV;
+
+    for (cpu=0; cpu<ncpu; cpu++) {
+        if (perf_group_open(target, cgroup_fd, cpu,
+                            PERF_FLAG_PID_CGROUP) < 0)
+        {
+            if (errno == ENODEV) {
+                continue; /* offline */
+            }
+            status = errno;
+            if (target->ngroups == 0) {
+                break;
+            }
+        }
+    }
+
+    return target->ngroups ? SIGAR_OK : status;
+}
+
+/* the groups summed, counters that did not open are NOTIMPL */
+static int perf_target_read(perf_target_t *target,
+                            sigar_proc_perf_t *procperf)
+{
+    sigar_uint64_t *fields[PERF_EVENT_MAX];
+    int i, nread = 0;
+
+    fields[PERF_CYCLES] = &procperf->cycles;
+    fields[PERF_INSTRUCTIONS] = &procperf->instructions;
+    fields[PERF_CACHE_MISSES] = &procperf->cache_misses;
+    fields[PERF_CONTEXT_SWITCHES] = &procperf->context_switches;
+
+    for (i=0; i<PERF_EVENT_MAX; i++) {
+        *fields[i] = SIGAR_FIELD_NOTIMPL;
+    }
+    for (i=0; i<target->nevents; i++) {
+        *fields[target->events[i]] = 0;
+    }
+    procperf->time_enabled = procperf->time_running = 0;
+
+    for (i=0; i<target->ngroups; i++) {
+        int leader = target->fds[i * PERF_EVENT_MAX];
+        perf_group_read_t group;
+        sigar_uint64_t n;
+        ssize_t len;
+
+        if (leader < 0) {
+            continue;
+        }
+
+        len = read(leader, &group, sizeof(group));
+        if (len < (ssize_t)(sizeof(sigar_uint64_t) * 3)) {
+            continue;
+        }
+        ++nread;
+
+        procperf->time_enabled += group.time_enabled;
+        procperf->time_running += group.time_running;
+
+        for (n=0; (n < group.nr) && (n < (sigar_uint64_t)target->nevents);
+             n++)
+        {
+            *fields[target->events[n]] += group.values[n];
+        }
+    }
+
+    return nread ? SIGAR_OK : errno;
+}
+
+static int perf_target_new(perf_target_t **target)
+{
+    if (!(*target = calloc(1, sizeof(**target)))) {
+        return ENOMEM;
+    }
+
+    return SIGAR_OK;
+}
+
+int sigar_proc_perf_open(sigar_t *sigar, sigar_pid_t pid)
+{
+    linux_perf_t *perf = perf_get(sigar);
+    sigar_cache_entry_t *entry;
+    perf_target_t *target;
+    int status;
+
+    entry = sigar_cache_get(perf->pids, pid);
+    if (entry->value) {
+        return SIGAR_OK;
+    }
+
+    if ((status = perf_target_new(&target)) == SIGAR_OK) {
+        if ((status = perf_pid_open(sigar, pid, target)) == SIGAR_OK) {
+            entry->value = target;
+            return SIGAR_OK;
+        }
+        perf_target_free(target);
+    }
+
+    sigar_cache_remove(perf->pids, pid);
+
+    return status;
+}
+
+int sigar_proc_perf_close(sigar_t *sigar, sigar_pid_t pid)
+{
+    if (sigar->perf) {
+        sigar_cache_remove(sigar->perf->pids, pid);
+    }
+
+    return SIGAR_OK;
+}
+
+int sigar_proc_perf_get(sigar_t *sigar, sigar_pid_t pid,
+                        sigar_proc_perf_t *procperf)
+{
+    sigar_cache_entry_t *entry;
+
+    if (!sigar->perf ||
+        !(entry = sigar_cache_find(sigar->perf->pids, pid)))
+    {
+        return ENOENT;
+    }
+
+    return perf_target_read(entry->value, procperf);
+}
+
+int sigar_proc_perf_cgroup_open(sigar_t *sigar, const char *path)
+{
+    linux_perf_t *perf = perf_get(sigar);
+    sigar_cache_entry_t *entry;
+    perf_target_t *target;
+    sigar_uint64_t id;
+    int fd, status;
+
+    if ((status = linux_cgroup_perf_open(sigar, path, &fd, &id)) !=
+        SIGAR_OK)
+    {
+        return status;
+    }
+
+    entry = sigar_cache_get(perf->cgroups, id);
+    if (entry->value) {
+        close(fd);
+        return SIGAR_OK;
+    }
+
+    if ((status = perf_target_new(&target)) == SIGAR_OK) {
+        /* the events hold the cgroup, not the fd */
+        status = perf_cgroup_open(sigar, fd, target);
+        if (status == SIGAR_OK) {
+            entry->value = target;
+        }
+        else {
+            perf_target_free(target);
+        }
+    }
+    close(fd);
+
+    if (status != SIGAR_OK) {
+        sigar_cache_remove(perf->cgroups, id);
+    }
+
+    return status;
+}
+
+/* the id as the cgroup is known by, ENOENT if it was not opened */
+static int perf_cgroup_find(sigar_t *sigar, const char *path,
+                            sigar_cache_entry_t **entry)
+{
+    sigar_uint64_t id;
+    int fd, status;
+
+    if (!sigar->perf) {
+        return ENOENT;
+    }
+
+    if ((status = linux_cgroup_perf_open(sigar, path, &fd, &id)) !=
+        SIGAR_OK)
+    {
+        return status;
+    }
+    close(fd);
+
+    if (!(*entry = sigar_cache_find(sigar->perf->cgroups, id))) {
+        return ENOENT;
+    }
+
+    return SIGAR_OK;
+}
+
+int sigar_proc_perf_cgroup_close(sigar_t *sigar, const char *path)
+{
+    sigar_cache_entry_t *entry;
+
+    if (perf_cgroup_find(sigar, path, &entry) == SIGAR_OK) {
+        sigar_cache_remove(sigar->perf->cgroups, entry->id);
+    }
+
+    return SIGAR_OK;
+}
+
+int sigar_proc_perf_cgroup_get(sigar_t *sigar, const char *path,
+                               sigar_proc_perf_t *procperf)
+{
+    sigar_cache_entry_t *entry;
+    int status;
+
+    if ((status = perf_cgroup_find(sigar, path, &entry)) != SIGAR_OK) {
+        return status;
+    }
+
+    return perf_target_read(entry->value, procperf);
+}
+
+#else /* !HAVE_LINUX_PERF_EVENT_H */
+
+void linux_perf_close(sigar_t *sigar)
+{
+}
+
+int sigar_proc_perf_open(sigar_t *sigar, sigar_pid_t pid)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+int sigar_proc_perf_close(sigar_t *sigar, sigar_pid_t pid)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+int sigar_proc_perf_get(sigar_t *sigar, sigar_pid_t pid,
+                        sigar_proc_perf_t *procperf)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+int sigar_proc_perf_cgroup_open(sigar_t *sigar, const char *path)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+int sigar_proc_perf_cgroup_close(sigar_t *sigar, const char *path)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+int sigar_proc_perf_cgroup_get(sigar_t *sigar, const char *path,
+                               sigar_proc_perf_t *procperf)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+#endif /* HAVE_LINUX_PERF_EVENT_H */
@@ -0,0 +1,1298 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * route and neighbour tables over NETLINK_ROUTE, ipv4 and ipv6 alike
+ * where /proc/net/route and /proc/net/arp only know ipv4.  the tables
+ * are dumped once and kept on the handle, a second socket joined to
+ * the route, neighbour and link groups carries every change after
+ * that, so a read with nothing pending costs one recv that returns
+ * EAGAIN.  the interface configs come from one link and address
+ * dump per read instead of an ioctl per attribute.  SIGAR_ENOTIMPL
+ * means use procfs.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "sigar.h"
+#include "sigar_private.h"
+#include "sigar_util.h"
+#include "sigar_os.h"
+
+#ifdef HAVE_LINUX_RTNETLINK_H
+
+#include <net/if.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/neighbour.h>
+
+#define RTNL_DISABLED -2
+
+/* dumps fill messages up to 32k on newer kernels */
+#define RTNL_BUFSIZ 32768
+
+/* past this many notifications in one drain a fresh dump is cheaper */
+#define RTNL_INCREMENTAL_MAX 64
+
+/* as /proc/net/route and /proc/net/arp report them */
+#define RTNL_RTF_UP      0x0001
+#define RTNL_RTF_GATEWAY 0x0002
+#define RTNL_RTF_HOST    0x0004
+#define RTNL_ATF_COM     0x02
+#define RTNL_ATF_PERM    0x04
+
+/* NUD_VALID in the kernel, not exported */
+#define RTNL_NUD_VALID \
+    (NUD_PERMANENT | NUD_NOARP | NUD_REACHABLE | \
+     NUD_PROBE | NUD_STALE | NUD_DELAY)
+
+/* what the kernel tells routes apart by, leads each table entry */
+typedef struct {
+    unsigned char family, dst_len, tos, table;
+    sigar_uint32_t priority;
+    int oif;
+    sigar_uint32_t dst[4];
+} rtnl_route_key_t;
+
+typedef struct {
+    rtnl_route_key_t key;
+    sigar_net_route_t route;
+} rtnl_route_t;
+
+typedef struct {
+    int family;
+    int ifindex;
+    sigar_uint32_t dst[4];
+} rtnl_neigh_key_t;
+
+typedef struct {
+    rtnl_neigh_key_t key;
+    sigar_arp_t arp;
+} rtnl_neigh_t;
+
+typedef struct {
+    char name[IFNAMSIZ];
+    int type; /* ARPHRD_* */
+} rtnl_link_t;
+
+/*
+ * entries in dump order, which is what procfs would show, with a key
+ * hash index so a dump or a burst of updates costs O(n) and not
+ * O(n^2).  removed entries are only marked until half of the table
+ * is dead, then compacted in one pass.
+ */
+typedef struct {
+    char *data;
+    char *dead;           /* per entry, removed but not compacted yet */
+    sigar_cache_t *index; /* key hash -> position + 1 */
+    unsigned long number, size, removed;
+    size_t entry_size, key_size;
+    int valid;
+} rtnl_table_t;
+
+struct linux_rtnl_t {
+    int fd;       /* dump requests */
+    int watch_fd; /* RTMGRP_* notifications, -1 means no caching */
+    sigar_uint32_t seq;
+    sigar_cache_t *links; /* ifindex -> rtnl_link_t */
+    int links_valid;
+    rtnl_table_t routes;  /* of rtnl_route_t */
+    rtnl_table_t neigh;   /* of rtnl_neigh_t */
+};
+
+#define RTNL_NDA(ndm) \
+    ((struct rtattr *)((char *)(ndm) + NLMSG_ALIGN(sizeof(struct ndmsg))))
+
+#define RTNL_ENTRY(table, i) \
+    ((table)->data + ((i) * (table)->entry_size))
+
+/* the values are positions, not pointers */
+static void rtnl_position_free(void *ptr)
+{
+}
+
+/* fnv-1a, the keys have no padding */
+static sigar_uint64_t rtnl_key_hash(rtnl_table_t *table, void *key)
+{
+    sigar_uint64_t hash = 14695981039346656037ULL;
+    const unsigned char *ptr = key;
+    size_t i;
+
+    for (i=0; i<table->key_size; i++) {
+        hash ^= ptr[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+static int rtnl_table_match(rtnl_table_t *table, unsigned long i, void *key)
+{
+    return !table->dead[i] &&
+        (memcmp(RTNL_ENTRY(table, i), key, table->key_size) == 0);
+}
+
+static long rtnl_table_find(rtnl_table_t *table, void *key)
+{
+    sigar_cache_entry_t *entry;
+    unsigned long i;
+
+    if (!table->index ||
+        !(entry = sigar_cache_find(table->index, rtnl_key_hash(table, key))))
+    {
+        return -1;
+    }
+
+    i = (unsigned long)entry->value - 1;
+    if (rtnl_table_match(table, i, key)) {
+        return i;
+    }
+
+    /* another key with the same hash holds the slot */
+    for (i=0; i<table->number; i++) {
+        if (rtnl_table_match(table, i, key)) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+static int rtnl_table_index(rtnl_table_t *table, unsigned long i)
+{
+    sigar_cache_entry_t *entry;
+
+    if (!table->index) {
+        table->index = sigar_cache_new(table->size + 1);
+        if (!table->index) {
+            return ENOMEM;
+        }
+        table->index->free_value = rtnl_position_free;
+    }
+
+    entry = sigar_cache_get(table->index,
+                            rtnl_key_hash(table, RTNL_ENTRY(table, i)));
+    if (!entry->value) {
+        entry->value = (void *)(i + 1);
+    }
+
+    return SIGAR_OK;
+}
+
+/* replaces the entry with the same key, else appends */
+static int rtnl_table_set(rtnl_table_t *table, void *entry)
+{
+    long i = rtnl_table_find(table, entry);
+
+    if (i >= 0) {
+        memcpy(RTNL_ENTRY(table, i), entry, table->entry_size);
+        return SIGAR_OK;
+    }
+
+    if (table->number >= table->size) {
+        unsigned long size = table->size ? table->size * 2 : 16;
+        char *data = realloc(table->data, size * table->entry_size);
+        char *dead;
+
+        if (!data) {
+            return ENOMEM;
+        }
+        table->data = data;
+        if (!(dead = realloc(table->dead, size))) {
+            return ENOMEM;
+        }
+        table->dead = dead;
+        table->size = size;
+    }
+
+    i = table->number++;
+    memcpy(RTNL_ENTRY(table, i), entry, table->entry_size);
+    table->dead[i] = 0;
+
+    return rtnl_table_index(table, i);
+}
+
+static void rtnl_table_clear(rtnl_table_t *table)
+{
+    if (table->index) {
+        sigar_cache_destroy(table->index);
+        table->index = NULL;
+    }
+    table->number = table->removed = 0;
+}
+
+/* drops the dead entries, the live ones keep their order */
+static int rtnl_table_compact(rtnl_table_t *table)
+{
+    unsigned long i, number = table->number;
+
+    rtnl_table_clear(table);
+
+    for (i=0; i<number; i++) {
+        if (table->dead[i]) {
+            continue;
+        }
+        if (i != table->number) {
+            memcpy(RTNL_ENTRY(table, table->number), RTNL_ENTRY(table, i),
+                   table->entry_size);
+            table->dead[table->number] = 0;
+        }
+        if (rtnl_table_index(table, table->number++) != SIGAR_OK) {
+            return ENOMEM;
+        }
+    }
+
+    return SIGAR_OK;
+}
+
+static int rtnl_table_remove(rtnl_table_t *table, void *key)
+{
+    sigar_cache_entry_t *entry;
+    long i = rtnl_table_find(table, key);
+
+    if (i < 0) {
+        return SIGAR_OK;
+    }
+
+    table->dead[i] = 1;
+    table->removed++;
+
+    entry = sigar_cache_find(table->index, rtnl_key_hash(table, key));
+    if (entry && ((unsigned long)entry->value == (unsigned long)(i + 1))) {
+        sigar_cache_remove(table->index, rtnl_key_hash(table, key));
+    }
+
+    if (table->removed > (table->number / 2)) {
+        return rtnl_table_compact(table);
+    }
+
+    return SIGAR_OK;
+}
+
+static void rtnl_table_free(rtnl_table_t *table)
+{
+    rtnl_table_clear(table);
+    if (table->data) {
+        free(table->data);
+        table->data = NULL;
+    }
+    if (table->dead) {
+        free(table->dead);
+        table->dead = NULL;
+    }
+    table->size = 0;
+    table->valid = 0;
+}
+
+static void rtnl_invalidate(linux_rtnl_t *rtnl)
+{
+    rtnl->links_valid = 0;
+    rtnl->routes.valid = 0;
+    rtnl->neigh.valid = 0;
+}
+
+static int rtnl_socket(unsigned int groups)
+{
+    struct sockaddr_nl addr;
+    int fd;
+
+    if ((fd = socket(AF_NETLINK, SOCK_RAW, NETLINK_ROUTE)) < 0) {
+        return -1;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    if (groups) {
+        memset(&addr, 0, sizeof(addr));
+        addr.nl_family = AF_NETLINK;
+        addr.nl_groups = groups;
+
+        if ((bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) ||
+            (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) < 0))
+        {
+            close(fd);
+            return -1;
+        }
+    }
+
+    return fd;
+}
+
+static int rtnl_open(sigar_t *sigar, linux_rtnl_t **rtnlp)
+{
+    linux_rtnl_t *rtnl = sigar->rtnl;
+
+    /* a SIGAR_PROC_NET mirror stands in for the whole network too */
+    if (linux_proc_mirrored(sigar) || sigar->proc_net) {
+        return SIGAR_ENOTIMPL;
+    }
+
+    if (!rtnl) {
+        rtnl = sigar->rtnl = calloc(1, sizeof(*rtnl));
+        if (!rtnl) {
+            return ENOMEM;
+        }
+        rtnl->fd = rtnl->watch_fd = -1;
+        rtnl->routes.entry_size = sizeof(rtnl_route_t);
+        rtnl->routes.key_size = sizeof(rtnl_route_key_t);
+        rtnl->neigh.entry_size = sizeof(rtnl_neigh_t);
+        rtnl->neigh.key_size = sizeof(rtnl_neigh_key_t);
+    }
+
+    if (rtnl->fd == RTNL_DISABLED) {
+        return SIGAR_ENOTIMPL;
+    }
+
+    if (rtnl->fd < 0) {
+        /* subscribed before the dump, nothing is missed in between */
+        rtnl->watch_fd =
+            rtnl_socket(RTMGRP_LINK | RTMGRP_NEIGH |
+                        RTMGRP_IPV4_ROUTE | RTMGRP_IPV6_ROUTE);
+        rtnl_invalidate(rtnl);
+
+        if ((rtnl->fd = rtnl_socket(0)) < 0) {
+            if (SIGAR_LOG_IS_DEBUG(sigar)) {
+                sigar_log_printf(sigar, SIGAR_LOG_DEBUG,
+                                 "[rtnetlink] falling back to procfs: %s",
+                                 sigar_strerror(sigar, errno));
+            }
+            if (rtnl->watch_fd >= 0) {
+                close(rtnl->watch_fd);
+                rtnl->watch_fd = -1;
+            }
+            rtnl->fd = RTNL_DISABLED;
+            return SIGAR_ENOTIMPL;
+        }
+    }
+
+    *rtnlp = rtnl;
+
+    return SIGAR_OK;
+}
+
+/* drops both sockets and the tables, the next read starts over */
+static void rtnl_reset(linux_rtnl_t *rtnl)
+{
+    if (rtnl->fd >= 0) {
+        close(rtnl->fd);
+        rtnl->fd = -1;
+    }
+    if (rtnl->watch_fd >= 0) {
+        close(rtnl->watch_fd);
+        rtnl->watch_fd = -1;
+    }
+    rtnl_invalidate(rtnl);
+}
+
+int linux_rtnetlink_probe(sigar_t *sigar)
+{
+    linux_rtnl_t *rtnl;
+
+    return rtnl_open(sigar, &rtnl);
+}
+
+void linux_rtnetlink_close(sigar_t *sigar)
+{
+    linux_rtnl_t *rtnl = sigar->rtnl;
+
+    if (!rtnl) {
+        return;
+    }
+
+    rtnl_reset(rtnl);
+    if (rtnl->links) {
+        sigar_cache_destroy(rtnl->links);
+    }
+    rtnl_table_free(&rtnl->routes);
+    rtnl_table_free(&rtnl->neigh);
+    free(rtnl);
+    sigar->rtnl = NULL;
+}
+
+static void rtnl_attrs(struct rtattr **tb, int max,
+                       struct rtattr *rta, int len)
+{
+    memset(tb, 0, sizeof(*tb) * (max + 1));
+
+    for (; RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+        if (rta->rta_type <= max) {
+            tb[rta->rta_type] = rta;
+        }
+    }
+}
+
+static sigar_uint32_t rtnl_u32(struct rtattr *rta)
+{
+    if (!rta || (RTA_PAYLOAD(rta) < sizeof(sigar_uint32_t))) {
+        return 0;
+    }
+    return *(sigar_uint32_t *)RTA_DATA(rta);
+}
+
+static void rtnl_address_set(sigar_net_address_t *address,
+                             int family, struct rtattr *rta)
+{
+    if (family == AF_INET6) {
+        address->family = SIGAR_AF_INET6;
+        memset(address->addr.in6, 0, sizeof(address->addr.in6));
+        if (rta && (RTA_PAYLOAD(rta) >= sizeof(address->addr.in6))) {
+            memcpy(address->addr.in6, RTA_DATA(rta),
+                   sizeof(address->addr.in6));
+        }
+    }
+    else {
+        sigar_net_address_set(*address, rtnl_u32(rta));
+    }
+}
+
+static void rtnl_mask_set(sigar_net_address_t *mask,
+                          int family, int len)
+{
+    if (family == AF_INET6) {
+        unsigned char *bytes = (unsigned char *)mask->addr.in6;
+        int i;
+
+        mask->family = SIGAR_AF_INET6;
+        memset(bytes, 0, sizeof(mask->addr.in6));
+        for (i=0; (i < 16) && (len > 0); i++, len -= 8) {
+            bytes[i] = (len >= 8) ? 0xff : (0xff << (8 - len)) & 0xff;
+        }
+    }
+    else {
+        sigar_net_address_set(*mask,
+                              len ? htonl(0xffffffff << (32 - len)) : 0);
+    }
+}
+
+static void rtnl_ifname_set(linux_rtnl_t *rtnl, int ifindex,
+                            char *ifname, size_t len)
+{
+    sigar_cache_entry_t *entry =
+        (ifindex && rtnl->links) ?
+        sigar_cache_find(rtnl->links, ifindex) : NULL;
+
+    if (entry && entry->value) {
+        strncpy(ifname, ((rtnl_link_t *)entry->value)->name, len);
+        ifname[len-1] = '\0';
+    }
+    else {
+        *ifname = '\0';
+    }
+}
+
+/*
+ * main table unicast routes as /proc/net/route lists them, mtu is
+ * advmss + 40 and irtt rtt / 8 for the same reason.  ENOENT means
+ * the message is no route of ours.
+ */
+static int rtnl_route_parse(linux_rtnl_t *rtnl, struct nlmsghdr *nlh,
+                            rtnl_route_t *entry)
+{
+    struct rtmsg *rtm = NLMSG_DATA(nlh);
+    struct rtattr *tb[RTA_MAX+1];
+    sigar_net_route_t *route = &entry->route;
+    struct rtattr *gateway;
+    int len = nlh->nlmsg_len - NLMSG_LENGTH(sizeof(*rtm));
+    int table, oif;
+
+    if ((len < 0) ||
+        ((rtm->rtm_family != AF_INET) && (rtm->rtm_family != AF_INET6)) ||
+        (rtm->rtm_type != RTN_UNICAST) ||
+        (rtm->rtm_flags & RTM_F_CLONED))
+    {
+        return ENOENT;
+    }
+
+    rtnl_attrs(tb, RTA_MAX, RTM_RTA(rtm), len);
+
+    table = tb[RTA_TABLE] ? rtnl_u32(tb[RTA_TABLE]) : rtm->rtm_table;
+    if (table != RT_TABLE_MAIN) {
+        return ENOENT;
+    }
+
+    gateway = tb[RTA_GATEWAY];
+    oif = rtnl_u32(tb[RTA_OIF]);
+
+    /* multipath, the first hop stands in for the rest */
+    if (!oif && tb[RTA_MULTIPATH] &&
+        (RTA_PAYLOAD(tb[RTA_MULTIPATH]) >= sizeof(struct rtnexthop)))
+    {
+        struct rtnexthop *nh = RTA_DATA(tb[RTA_MULTIPATH]);
+        struct rtattr *ntb[RTA_MAX+1];
+
+        oif = nh->rtnh_ifindex;
+        if (nh->rtnh_len > sizeof(*nh)) {
+            rtnl_attrs(ntb, RTA_MAX, RTNH_DATA(nh),
+                       nh->rtnh_len - sizeof(*nh));
+            gateway = ntb[RTA_GATEWAY];
+        }
+    }
+
+    memset(entry, 0, sizeof(*entry));
+    entry->key.family = rtm->rtm_family;
+    entry->key.dst_len = rtm->rtm_dst_len;
+    entry->key.tos = rtm->rtm_tos;
+    entry->key.table = table;
+    entry->key.priority = rtnl_u32(tb[RTA_PRIORITY]);
+    entry->key.oif = oif;
+    if (tb[RTA_DST]) {
+        memcpy(entry->key.dst, RTA_DATA(tb[RTA_DST]),
+               RTA_PAYLOAD(tb[RTA_DST]) < sizeof(entry->key.dst) ?
+               RTA_PAYLOAD(tb[RTA_DST]) : sizeof(entry->key.dst));
+    }
+
+    rtnl_address_set(&route->destination, rtm->rtm_family, tb[RTA_DST]);
+    rtnl_address_set(&route->gateway, rtm->rtm_family, gateway);
+    rtnl_mask_set(&route->mask, rtm->rtm_family, rtm->rtm_dst_len);
+
+    route->flags = RTNL_RTF_UP;
+    if (gateway) {
+        route->flags |= RTNL_RTF_GATEWAY;
+    }
+    if (rtm->rtm_dst_len == ((rtm->rtm_family == AF_INET6) ? 128 : 32)) {
+        route->flags |= RTNL_RTF_HOST;
+    }
+
+    route->metric = entry->key.priority;
+
+    if (tb[RTA_METRICS]) {
+        struct rtattr *mtb[RTAX_MAX+1];
+
+        rtnl_attrs(mtb, RTAX_MAX, RTA_DATA(tb[RTA_METRICS]),
+                   RTA_PAYLOAD(tb[RTA_METRICS]));
+
+        if (mtb[RTAX_ADVMSS]) {
+            route->mtu = rtnl_u32(mtb[RTAX_ADVMSS]) + 40;
+        }
+        route->window = rtnl_u32(mtb[RTAX_WINDOW]);
+        route->irtt = rtnl_u32(mtb[RTAX_RTT]) >> 3;
+    }
+
+    rtnl_ifname_set(rtnl, oif, route->ifname, sizeof(route->ifname));
+
+    return SIGAR_OK;
+}
+
+/* skips NUD_NOARP entries, as /proc/net/arp does */
+static int rtnl_neigh_parse(linux_rtnl_t *rtnl, struct nlmsghdr *nlh,
+                            rtnl_neigh_t *entry)
+{
+    struct ndmsg *ndm = NLMSG_DATA(nlh);
+    struct rtattr *tb[NDA_MAX+1];
+    sigar_arp_t *arp = &entry->arp;
+    sigar_cache_entry_t *link;
+    int len = nlh->nlmsg_len - NLMSG_LENGTH(sizeof(*ndm));
+
+    if ((len < 0) ||
+        ((ndm->ndm_family != AF_INET) && (ndm->ndm_family != AF_INET6)))
+    {
+        return ENOENT;
+    }
+
+    rtnl_attrs(tb, NDA_MAX, RTNL_NDA(ndm), len);
+
+    if (!tb[NDA_DST]) {
+        return ENOENT;
+    }
+
+    memset(entry, 0, sizeof(*entry));
+    entry->key.family = ndm->ndm_family;
+    entry->key.ifindex = ndm->ndm_ifindex;
+    memcpy(entry->key.dst, RTA_DATA(tb[NDA_DST]),
+           RTA_PAYLOAD(tb[NDA_DST]) < sizeof(entry->key.dst) ?
+           RTA_PAYLOAD(tb[NDA_DST]) : sizeof(entry->key.dst));
+
+    if (ndm->ndm_state & NUD_NOARP) {
+        return EINVAL; /* the key is set, for removal */
+    }
+
+    rtnl_address_set(&arp->address, ndm->ndm_family, tb[NDA_DST]);
+
+    arp->hwaddr.family = SIGAR_AF_LINK;
+    if (tb[NDA_LLADDR]) {
+        memcpy(arp->hwaddr.addr.mac, RTA_DATA(tb[NDA_LLADDR]),
+               RTA_PAYLOAD(tb[NDA_LLADDR]) < sizeof(arp->hwaddr.addr.mac) ?
+               RTA_PAYLOAD(tb[NDA_LLADDR]) : sizeof(arp->hwaddr.addr.mac));
+    }
+
+    if (ndm->ndm_state & RTNL_NUD_VALID) {
+        arp->flags |= RTNL_ATF_COM;
+    }
+    if (ndm->ndm_state & NUD_PERMANENT) {
+        arp->flags |= RTNL_ATF_PERM;
+    }
+
+    rtnl_ifname_set(rtnl, ndm->ndm_ifindex,
+                    arp->ifname, sizeof(arp->ifname));
+
+    link = rtnl->links ?
+        sigar_cache_find(rtnl->links, ndm->ndm_ifindex) : NULL;
+    SIGAR_SSTRCPY(arp->type,
+                  linux_hw_type((link && link->value) ?
+                                ((rtnl_link_t *)link->value)->type : -1));
+
+    return SIGAR_OK;
+}
+
+static void rtnl_link_add(linux_rtnl_t *rtnl, struct nlmsghdr *nlh)
+{
+    struct ifinfomsg *ifi = NLMSG_DATA(nlh);
+    struct rtattr *tb[IFLA_MAX+1];
+    sigar_cache_entry_t *entry;
+    rtnl_link_t *link;
+    int len = nlh->nlmsg_len - NLMSG_LENGTH(sizeof(*ifi));
+
+    if (len < 0) {
+        return;
+    }
+
+    rtnl_attrs(tb, IFLA_MAX, IFLA_RTA(ifi), len);
+
+    if (!tb[IFLA_IFNAME]) {
+        return;
+    }
+
+    entry = sigar_cache_get(rtnl->links, ifi->ifi_index);
+    if (!entry->value) {
+        entry->value = malloc(sizeof(*link));
+        if (!entry->value) {
+            return;
+        }
+    }
+
+    link = entry->value;
+    SIGAR_SSTRCPY(link->name, (char *)RTA_DATA(tb[IFLA_IFNAME]));
+    link->type = ifi->ifi_type;
+}
+
+static int rtnl_send(linux_rtnl_t *rtnl, int type, int family)
+{
+    struct {
+        struct nlmsghdr n;
+        union {
+            struct rtmsg r;
+            struct ndmsg nd;
+            struct ifinfomsg i;
+        } u;
+    } req;
+    struct sockaddr_nl addr;
+    int rv;
+
+    memset(&req, 0, sizeof(req));
+    req.n.nlmsg_type = type;
+    req.n.nlmsg_flags = NLM_F_REQUEST|NLM_F_DUMP;
+    req.n.nlmsg_seq = ++rtnl->seq;
+
+    switch (type) {
+      case RTM_GETROUTE:
+        req.n.nlmsg_len = NLMSG_LENGTH(sizeof(req.u.r));
+        req.u.r.rtm_family = family;
+        req.u.r.rtm_table = RT_TABLE_MAIN;
+        break;
+      case RTM_GETNEIGH:
+        req.n.nlmsg_len = NLMSG_LENGTH(sizeof(req.u.nd));
+        req.u.nd.ndm_family = family;
+        break;
+      default:
+        req.n.nlmsg_len = NLMSG_LENGTH(sizeof(req.u.i));
+        req.u.i.ifi_family = family;
+        break;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+
+    do {
+        rv = sendto(rtnl->fd, &req, req.n.nlmsg_len, 0,
+                    (struct sockaddr *)&addr, sizeof(addr));
+    } while ((rv < 0) && (errno == EINTR));
+
+    return (rv < 0) ? errno : SIGAR_OK;
+}
+
+/* a dump or notification message, into the tables it belongs to */
+static int rtnl_apply(linux_rtnl_t *rtnl, struct nlmsghdr *nlh)
+{
+    union {
+        rtnl_route_t route;
+        rtnl_neigh_t neigh;
+    } entry;
+    int status;
+
+    switch (nlh->nlmsg_type) {
+      case RTM_NEWLINK:
+        if (rtnl->links_valid) {
+            /* renamed or retyped, whatever rows name it are stale */
+            rtnl_invalidate(rtnl);
+        }
+        else if (rtnl->links) {
+            rtnl_link_add(rtnl, nlh);
+        }
+        return SIGAR_OK;
+      case RTM_DELLINK:
+        rtnl_invalidate(rtnl);
+        return SIGAR_OK;
+      case RTM_NEWROUTE:
+      case RTM_DELROUTE:
+        if (!rtnl->routes.valid ||
+            (rtnl_route_parse(rtnl, nlh, &entry.route) != SIGAR_OK))
+        {
+            return SIGAR_OK;
+        }
+        if (nlh->nlmsg_type == RTM_DELROUTE) {
+            return rtnl_table_remove(&rtnl->routes, &entry.route);
+        }
+        return rtnl_table_set(&rtnl->routes, &entry.route);
+      case RTM_NEWNEIGH:
+      case RTM_DELNEIGH:
+        if (!rtnl->neigh.valid) {
+            return SIGAR_OK;
+        }
+        status = rtnl_neigh_parse(rtnl, nlh, &entry.neigh);
+        if (status == ENOENT) {
+            return SIGAR_OK;
+        }
+        if ((status != SIGAR_OK) || (nlh->nlmsg_type == RTM_DELNEIGH)) {
+            return rtnl_table_remove(&rtnl->neigh, &entry.neigh);
+        }
+        return rtnl_table_set(&rtnl->neigh, &entry.neigh);
+      default:
+        return SIGAR_OK;
+    }
+}
+
+typedef int (*rtnl_handler_t)(linux_rtnl_t *rtnl, void *data,
+                              struct nlmsghdr *nlh);
+
+static int rtnl_table_add(linux_rtnl_t *rtnl, void *data,
+                          struct nlmsghdr *nlh)
+{
+    return rtnl_apply(rtnl, nlh);
+}
+
+/*
+ * reads the dump answering the last rtnl_send, each message goes to
+ * handler.  an error reply ends the dump but leaves the socket usable.
+ */
+static int rtnl_recv(linux_rtnl_t *rtnl,
+                     rtnl_handler_t handler, void *data)
+{
+    char buffer[RTNL_BUFSIZ];
+    int status;
+
+    while (1) {
+        struct nlmsghdr *nlh = (struct nlmsghdr *)buffer;
+        int len = recv(rtnl->fd, buffer, sizeof(buffer), 0);
+
+        if (len < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            status = errno;
+            rtnl_reset(rtnl);
+            return status;
+        }
+        if (len == 0) {
+            rtnl_reset(rtnl);
+            return EIO;
+        }
+
+        for (; NLMSG_OK(nlh, len); nlh = NLMSG_NEXT(nlh, len)) {
+            if (nlh->nlmsg_seq != rtnl->seq) {
+                continue;
+            }
+            if (nlh->nlmsg_type == NLMSG_DONE) {
+                return SIGAR_OK;
+            }
+            if (nlh->nlmsg_type == NLMSG_ERROR) {
+                struct nlmsgerr *err = NLMSG_DATA(nlh);
+                return err->error ? -err->error : EIO;
+            }
+            if ((status = handler(rtnl, data, nlh)) != SIGAR_OK) {
+                rtnl_reset(rtnl);
+                return status;
+            }
+        }
+    }
+}
+
+static int rtnl_dump(linux_rtnl_t *rtnl, int type, int family,
+                     rtnl_handler_t handler, void *data)
+{
+    int status = rtnl_send(rtnl, type, family);
+
+    if (status != SIGAR_OK) {
+        rtnl_reset(rtnl);
+        return status;
+    }
+
+    return rtnl_recv(rtnl, handler, data);
+}
+
+/*
+ * applies whatever changed since the last read.  a burst too long
+ * to be worth replaying, or one the socket buffer overflowed on,
+ * leaves the tables invalid to be dumped again.
+ */
+static void rtnl_drain(sigar_t *sigar, linux_rtnl_t *rtnl)
+{
+    char buffer[RTNL_BUFSIZ];
+    int updates = 0;
+
+    while (rtnl->watch_fd >= 0) {
+        struct nlmsghdr *nlh = (struct nlmsghdr *)buffer;
+        int len = recv(rtnl->watch_fd, buffer, sizeof(buffer), 0);
+
+        if (len < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == ENOBUFS) {
+                rtnl_invalidate(rtnl);
+                updates = RTNL_INCREMENTAL_MAX;
+                continue;
+            }
+            if ((errno != EAGAIN) && (errno != EWOULDBLOCK)) {
+                if (SIGAR_LOG_IS_DEBUG(sigar)) {
+                    sigar_log_printf(sigar, SIGAR_LOG_DEBUG,
+                                     "[rtnetlink] no longer caching: %s",
+                                     sigar_strerror(sigar, errno));
+                }
+                close(rtnl->watch_fd);
+                rtnl->watch_fd = -1;
+                rtnl_invalidate(rtnl);
+            }
+            return;
+        }
+
+        for (; NLMSG_OK(nlh, len); nlh = NLMSG_NEXT(nlh, len)) {
+            if (++updates > RTNL_INCREMENTAL_MAX) {
+                rtnl_invalidate(rtnl);
+                break;
+            }
+            if (rtnl_apply(rtnl, nlh) != SIGAR_OK) {
+                rtnl_invalidate(rtnl);
+            }
+        }
+    }
+}
+
+static int rtnl_links_load(linux_rtnl_t *rtnl)
+{
+    int status;
+
+    if (rtnl->links_valid) {
+        return SIGAR_OK;
+    }
+
+    if (rtnl->links) {
+        sigar_cache_destroy(rtnl->links);
+    }
+    rtnl->links = sigar_cache_new(64);
+
+    /* rows were named after the old links */
+    rtnl->routes.valid = rtnl->neigh.valid = 0;
+
+    status = rtnl_dump(rtnl, RTM_GETLINK, AF_UNSPEC, rtnl_table_add, NULL);
+    if (status != SIGAR_OK) {
+        return status;
+    }
+    rtnl->links_valid = 1;
+
+    return SIGAR_OK;
+}
+
+/*
+ * brings table up to date, dumping families in order.  a failure
+ * before the table was ever filled falls back to procfs.
+ */
+static int rtnl_table_load(sigar_t *sigar, int type,
+                           rtnl_table_t **tablep)
+{
+    static const int families[] = { AF_INET, AF_INET6, 0 };
+    const int *family;
+    linux_rtnl_t *rtnl;
+    rtnl_table_t *table;
+    int status;
+
+    if ((status = rtnl_open(sigar, &rtnl)) != SIGAR_OK) {
+        return status;
+    }
+
+    rtnl_drain(sigar, rtnl);
+
+    table = (type == RTM_GETROUTE) ? &rtnl->routes : &rtnl->neigh;
+    *tablep = table;
+
+    if (table->valid) {
+        return SIGAR_OK;
+    }
+
+    if ((status = rtnl_links_load(rtnl)) == SIGAR_OK) {
+        rtnl_table_clear(table);
+        table->valid = 1; /* so the dump goes through rtnl_apply */
+
+        for (family = families; *family; family++) {
+            status = rtnl_dump(rtnl, type, *family, rtnl_table_add, NULL);
+
+            /* no ipv6, same as a missing /proc/net/ipv6_route */
+            if ((status == EAFNOSUPPORT) && (*family == AF_INET6)) {
+                status = SIGAR_OK;
+            }
+            if (status != SIGAR_OK) {
+                break;
+            }
+        }
+    }
+
+    if (status != SIGAR_OK) {
+        table->valid = 0;
+        if (SIGAR_LOG_IS_DEBUG(sigar)) {
+            sigar_log_printf(sigar, SIGAR_LOG_DEBUG,
+                             "[rtnetlink] falling back to procfs: %s",
+                             sigar_strerror(sigar, status));
+        }
+        if (status != ENOMEM) {
+            rtnl_reset(rtnl);
+            rtnl->fd = RTNL_DISABLED;
+        }
+        return SIGAR_ENOTIMPL;
+    }
+
+    if (rtnl->watch_fd < 0) {
+        table->valid = 0; /* nothing to keep it current, dump every time */
+    }
+
+    return SIGAR_OK;
+}
+
+int linux_rtnetlink_route_list_get(sigar_t *sigar,
+                                   sigar_net_route_list_t *routelist)
+{
+    rtnl_table_t *table;
+    unsigned long i;
+    int status;
+
+    if ((status = rtnl_table_load(sigar, RTM_GETROUTE,
+                                  &table)) != SIGAR_OK)
+    {
+        return status;
+    }
+
+    SIGAR_LIST_CREATE(sigar, routelist, sigar_net_route_list_create);
+
+    for (i=0; i<table->number; i++) {
+        if (table->dead[i]) {
+            continue;
+        }
+        SIGAR_NET_ROUTE_LIST_GROW(routelist);
+        routelist->data[routelist->number++] =
+            ((rtnl_route_t *)RTNL_ENTRY(table, i))->route;
+    }
+
+    return SIGAR_OK;
+}
+
+int linux_rtnetlink_arp_list_get(sigar_t *sigar,
+                                 sigar_arp_list_t *arplist)
+{
+    rtnl_table_t *table;
+    unsigned long i;
+    int status;
+
+    if ((status = rtnl_table_load(sigar, RTM_GETNEIGH,
+                                  &table)) != SIGAR_OK)
+    {
+        return status;
+    }
+
+    SIGAR_LIST_CREATE(sigar, arplist, sigar_arp_list_create);
+
+    for (i=0; i<table->number; i++) {
+        if (table->dead[i]) {
+            continue;
+        }
+        SIGAR_ARP_LIST_GROW(arplist);
+        arplist->data[arplist->number++] =
+            ((rtnl_neigh_t *)RTNL_ENTRY(table, i))->arp;
+    }
+
+    return SIGAR_OK;
+}
+
+typedef struct {
+    sigar_net_interface_config_list_t *iflist;
+    sigar_cache_t *devices; /* ifindex -> position in iflist + 1 */
+} rtnl_ifconfig_t;
+
+static sigar_net_interface_config_t *
+rtnl_ifconfig_device(rtnl_ifconfig_t *ifc, int ifindex)
+{
+    sigar_cache_entry_t *entry = sigar_cache_find(ifc->devices, ifindex);
+
+    if (!entry) {
+        return NULL;
+    }
+
+    return &ifc->iflist->data[(unsigned long)entry->value - 1];
+}
+
+/* the same config SIOCGIF{FLAGS,HWADDR,MTU,METRIC,TXQLEN} would give */
+static int rtnl_ifconfig_link(linux_rtnl_t *rtnl, void *data,
+                              struct nlmsghdr *nlh)
+{
+    rtnl_ifconfig_t *ifc = data;
+    sigar_net_interface_config_list_t *iflist = ifc->iflist;
+    struct ifinfomsg *ifi = NLMSG_DATA(nlh);
+    struct rtattr *tb[IFLA_MAX+1];
+    sigar_net_interface_config_t *ifconfig;
+    int len = nlh->nlmsg_len - NLMSG_LENGTH(sizeof(*ifi));
+
+    if ((nlh->nlmsg_type != RTM_NEWLINK) || (len < 0)) {
+        return SIGAR_OK;
+    }
+
+    rtnl_attrs(tb, IFLA_MAX, IFLA_RTA(ifi), len);
+
+    if (!tb[IFLA_IFNAME]) {
+        return SIGAR_OK;
+    }
+
+    SIGAR_NET_IFCONFIG_LIST_GROW(iflist);
+    ifconfig = &iflist->data[iflist->number++];
+    SIGAR_ZERO(ifconfig);
+
+    sigar_cache_get(ifc->devices, ifi->ifi_index)->value =
+        (void *)iflist->number;
+
+    SIGAR_SSTRCPY(ifconfig->name, (char *)RTA_DATA(tb[IFLA_IFNAME]));
+    SIGAR_SSTRCPY(ifconfig->description, ifconfig->name);
+
+    /* the ioctl flags are a short */
+    ifconfig->flags = sigar_net_interface_flags_get(ifi->ifi_flags & 0xffff);
+
+    if (ifconfig->flags & SIGAR_IFF_LOOPBACK) {
+        sigar_net_address_set(ifconfig->destination, 0);
+        sigar_net_address_set(ifconfig->broadcast, 0);
+        sigar_hwaddr_set_null(ifconfig);
+        SIGAR_SSTRCPY(ifconfig->type, SIGAR_NIC_LOOPBACK);
+    }
+    else {
+        sigar_net_interface_type_set(ifconfig, ifi->ifi_type);
+        sigar_hwaddr_set_null(ifconfig);
+        if (tb[IFLA_ADDRESS]) {
+            memcpy(ifconfig->hwaddr.addr.mac, RTA_DATA(tb[IFLA_ADDRESS]),
+                   RTA_PAYLOAD(tb[IFLA_ADDRESS]) < IFHWADDRLEN ?
+                   RTA_PAYLOAD(tb[IFLA_ADDRESS]) : IFHWADDRLEN);
+        }
+    }
+
+    ifconfig->mtu = rtnl_u32(tb[IFLA_MTU]);
+    ifconfig->metric = 1; /* SIOCGIFMETRIC is always 0 on linux */
+    ifconfig->tx_queue_len =
+        tb[IFLA_TXQLEN] ? (int)rtnl_u32(tb[IFLA_TXQLEN]) : -1;
+
+    sigar_net_interface_ipv6_config_init(ifconfig);
+
+    return SIGAR_OK;
+}
+
+/* an address labelled other than its device, as SIOCGIFCONF has it */
+static sigar_net_interface_config_t *
+rtnl_ifconfig_alias(rtnl_ifconfig_t *ifc,
+                    sigar_net_interface_config_t *device,
+                    const char *label)
+{
+    sigar_net_interface_config_list_t *iflist = ifc->iflist;
+    sigar_net_interface_config_t *ifconfig;
+    unsigned long i, idx = device - iflist->data;
+
+    for (i=0; i<iflist->number; i++) {
+        if (strEQ(iflist->data[i].name, label)) {
+            return &iflist->data[i];
+        }
+    }
+
+    SIGAR_NET_IFCONFIG_LIST_GROW(iflist);
+    device = &iflist->data[idx]; /* may have moved */
+    ifconfig = &iflist->data[iflist->number++];
+
+    memcpy(ifconfig, device, sizeof(*ifconfig));
+    SIGAR_SSTRCPY(ifconfig->name, label);
+    SIGAR_SSTRCPY(ifconfig->description, label);
+    SIGAR_ZERO(&ifconfig->address);
+    SIGAR_ZERO(&ifconfig->netmask);
+    SIGAR_ZERO(&ifconfig->address6);
+    sigar_net_interface_ipv6_config_init(ifconfig);
+    if (!(ifconfig->flags & SIGAR_IFF_LOOPBACK)) {
+        SIGAR_ZERO(&ifconfig->destination);
+        SIGAR_ZERO(&ifconfig->broadcast);
+    }
+
+    return ifconfig;
+}
+
+/* RT_SCOPE_* into the /proc/net/if_inet6 scope */
+static int rtnl_scope6(int scope)
+{
+    switch (scope) {
+      case RT_SCOPE_HOST:
+        return SIGAR_IPV6_ADDR_LOOPBACK;
+      case RT_SCOPE_LINK:
+        return SIGAR_IPV6_ADDR_LINKLOCAL;
+      case RT_SCOPE_SITE:
+        return SIGAR_IPV6_ADDR_SITELOCAL;
+      default:
+        return SIGAR_IPV6_ADDR_ANY;
+    }
+}
+
+/* the first address of each family wins, as SIOCGIFADDR does */
+static int rtnl_ifconfig_addr(linux_rtnl_t *rtnl, void *data,
+                              struct nlmsghdr *nlh)
+{
+    rtnl_ifconfig_t *ifc = data;
+    struct ifaddrmsg *ifa = NLMSG_DATA(nlh);
+    struct rtattr *tb[IFA_MAX+1];
+    sigar_net_interface_config_t *ifconfig;
+    struct rtattr *local;
+    int len = nlh->nlmsg_len - NLMSG_LENGTH(sizeof(*ifa));
+
+    if ((nlh->nlmsg_type != RTM_NEWADDR) || (len < 0) ||
+        !(ifconfig = rtnl_ifconfig_device(ifc, ifa->ifa_index)))
+    {
+        return SIGAR_OK;
+    }
+
+    rtnl_attrs(tb, IFA_MAX, IFA_RTA(ifa), len);
+
+    if (!tb[IFA_ADDRESS]) {
+        return SIGAR_OK;
+    }
+
+    if (ifa->ifa_family == AF_INET6) {
+        if (!ifconfig->prefix6_length) {
+            rtnl_address_set(&ifconfig->address6, AF_INET6, tb[IFA_ADDRESS]);
+            ifconfig->prefix6_length = ifa->ifa_prefixlen;
+            ifconfig->scope6 = rtnl_scope6(ifa->ifa_scope);
+        }
+        return SIGAR_OK;
+    }
+    if (ifa->ifa_family != AF_INET) {
+        return SIGAR_OK;
+    }
+
+    if (tb[IFA_LABEL] &&
+        !strEQ((char *)RTA_DATA(tb[IFA_LABEL]), ifconfig->name))
+    {
+        ifconfig = rtnl_ifconfig_alias(ifc, ifconfig,
+                                       (char *)RTA_DATA(tb[IFA_LABEL]));
+    }
+
+    if (ifconfig->address.family == SIGAR_AF_INET) {
+        return SIGAR_OK;
+    }
+
+    /* IFA_ADDRESS is the peer of a point-to-point link */
+    local = tb[IFA_LOCAL] ? tb[IFA_LOCAL] : tb[IFA_ADDRESS];
+
+    rtnl_address_set(&ifconfig->address, AF_INET, local);
+    rtnl_mask_set(&ifconfig->netmask, AF_INET, ifa->ifa_prefixlen);
+
+    if (ifconfig->flags & SIGAR_IFF_LOOPBACK) {
+        rtnl_address_set(&ifconfig->destination, AF_INET, local);
+    }
+    else {
+        rtnl_address_set(&ifconfig->destination, AF_INET, tb[IFA_ADDRESS]);
+        rtnl_address_set(&ifconfig->broadcast, AF_INET, tb[IFA_BROADCAST]);
+    }
+
+    return SIGAR_OK;
+}
+
+int linux_rtnetlink_ifconfig_list_get(sigar_t *sigar,
+                                      sigar_net_interface_config_list_t *iflist)
+{
+    linux_rtnl_t *rtnl;
+    rtnl_ifconfig_t ifc;
+    int status;
+
+    if ((status = rtnl_open(sigar, &rtnl)) != SIGAR_OK) {
+        return status;
+    }
+
+    sigar_net_interface_config_list_create(iflist);
+
+    ifc.iflist = iflist;
+    ifc.devices = sigar_cache_new(SIGAR_NET_IFLIST_MAX);
+    ifc.devices->free_value = rtnl_position_free;
+
+    status = rtnl_dump(rtnl, RTM_GETLINK, AF_UNSPEC,
+                       rtnl_ifconfig_link, &ifc);
+    if (status == SIGAR_OK) {
+        status = rtnl_dump(rtnl, RTM_GETADDR, AF_UNSPEC,
+                           rtnl_ifconfig_addr, &ifc);
+    }
+
+    sigar_cache_destroy(ifc.devices);
+
+    if (status != SIGAR_OK) {
+        sigar_net_interface_config_list_destroy(sigar, iflist);
+        if (SIGAR_LOG_IS_DEBUG(sigar)) {
+            sigar_log_printf(sigar, SIGAR_LOG_DEBUG,
+                             "[rtnetlink] falling back to ioctl: %s",
+                             sigar_strerror(sigar, status));
+        }
+        return SIGAR_ENOTIMPL;
+    }
+
+    return SIGAR_OK;
+}
+
+#else
+
+int linux_rtnetlink_probe(sigar_t *sigar)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+int linux_rtnetlink_ifconfig_list_get(sigar_t *sigar,
+                                      sigar_net_interface_config_list_t *iflist)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+int linux_rtnetlink_route_list_get(sigar_t *sigar,
+                                   sigar_net_route_list_t *routelist)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+int linux_rtnetlink_arp_list_get(sigar_t *sigar,
+                                 sigar_arp_list_t *arplist)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+void linux_rtnetlink_close(sigar_t *sigar)
+{
+}
+
+#endif /* HAVE_LINUX_RTNETLINK_H */
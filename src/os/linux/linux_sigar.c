@@ -20,9 +20,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <poll.h>
 #include <sys/param.h>
 #include <sys/stat.h>
 #include <sys/times.h>
+#include <sys/syscall.h>
 #include <sys/utsname.h>
 
 #include "sigar.h"
@@ -32,19 +34,44 @@
 
 #define pageshift(x) ((x) << sigar->pagesize)
 
-#define PROC_MEMINFO PROC_FS_ROOT "meminfo"
-#define PROC_VMSTAT  PROC_FS_ROOT "vmstat"
-#define PROC_MTRR    PROC_FS_ROOT "mtrr"
-#define PROC_STAT    PROC_FS_ROOT "stat"
-#define PROC_UPTIME  PROC_FS_ROOT "uptime"
-#define PROC_LOADAVG PROC_FS_ROOT "loadavg"
+#define PROC_MEMINFO "meminfo"
+#define PROC_VMSTAT  "vmstat"
+#define PROC_MTRR    "mtrr"
+#define PROC_STAT    "stat"
+#define PROC_UPTIME  "uptime"
+#define PROC_LOADAVG "loadavg"
+#define PROC_INTERRUPTS "interrupts"
+#define PROC_SOFTIRQS   "softirqs"
 
 #define PROC_PSTAT   "/stat"
 #define PROC_PSTATUS "/status"
 
 #define SYS_BLOCK "/sys/block"
-#define PROC_PARTITIONS PROC_FS_ROOT "partitions"
-#define PROC_DISKSTATS  PROC_FS_ROOT "diskstats"
+#define SYS_CPU   "/sys/devices/system/cpu"
+#define SYS_NODE  "/sys/devices/system/node"
+#define PROC_PARTITIONS "partitions"
+#define PROC_DISKSTATS  "diskstats"
+
+/* fname is relative to the procfs root, see SIGAR_PROC_ROOT */
+static FILE *procfs_fopen(const char *fname, int len)
+{
+    char name[SIGAR_PATH_MAX+1];
+
+    SIGAR_INSTRUMENT_OPEN();
+    return fopen(sigar_procfs_filename(name, sizeof(name), fname, len), "r");
+}
+
+static int procfs_open(const char *fname, int len, int flags)
+{
+    char name[SIGAR_PATH_MAX+1];
+
+    SIGAR_INSTRUMENT_OPEN();
+    return open(sigar_procfs_filename(name, sizeof(name), fname, len), flags);
+}
+
+#define PROCFS_FOPEN(fname) procfs_fopen(fname, SSTRLEN(fname))
+
+#define PROCFS_OPEN(fname, flags) procfs_open(fname, SSTRLEN(fname), flags)
 
 /*
  * /proc/self/stat fields:
@@ -96,8 +123,7 @@ static int get_proc_signal_offset(void)
 {
     char buffer[BUFSIZ], *ptr=buffer;
     int fields = 0;
-    int status = sigar_file2str(PROCP_FS_ROOT "self/stat",
-                                buffer, sizeof(buffer));
+    int status = SIGAR_PROCFS_FILE2STR("self/stat", buffer);
 
     if (status != SIGAR_OK) {
         return 1;
@@ -122,42 +148,17 @@ sigar_pid_t sigar_pid_get(sigar_t *sigar)
     return sigar->pid;
 }
 
-static int sigar_boot_time_get(sigar_t *sigar)
-{
-    FILE *fp;
-    char buffer[BUFSIZ], *ptr;
-    int found = 0;
-
-    if (!(fp = fopen(PROC_STAT, "r"))) {
-        return errno;
-    }
-
-    while ((ptr = fgets(buffer, sizeof(buffer), fp))) {
-        if (strnEQ(ptr, "btime", 5)) {
-            if ((ptr = sigar_skip_token(ptr))) {
-                sigar->boot_time = sigar_strtoul(ptr);
-                found = 1;
-            }
-            break;
-        }
-    }
-
-    fclose(fp);
+static int system_stat_read(sigar_t *sigar);
 
-    if (!found) {
-        /* should never happen */
-        sigar->boot_time = time(NULL);
-    }
+static FILE *proc_net_procfs_open(sigar_t *sigar, const char *fname,
+                                  int (**close)(FILE *));
 
-    return SIGAR_OK;
-}
+static FILE *proc_net_mirror_open(sigar_t *sigar, const char *fname,
+                                  int (**close)(FILE *));
 
 int sigar_os_open(sigar_t **sigar)
 {
     int i, status;
-    int kernel_rev, has_nptl;
-    struct stat sb;
-    struct utsname name;
 
     *sigar = malloc(sizeof(**sigar));
 
@@ -167,54 +168,339 @@ int sigar_os_open(sigar_t **sigar)
         (*sigar)->pagesize++;
     }
 
-    status = sigar_boot_time_get(*sigar);
-    if (status != SIGAR_OK) {
-        return status;
-    }
-    
     (*sigar)->ticks = sysconf(_SC_CLK_TCK);
 
     (*sigar)->ram = -1;
 
     (*sigar)->proc_signal_offset = -1;
 
-    (*sigar)->last_proc_stat.pid = -1;
+    (*sigar)->proc_stat = NULL;
+    (*sigar)->proc_stat_pool = NULL;
+    (*sigar)->proc_attr = NULL;
+    (*sigar)->proc_attr_lru.prev = (*sigar)->proc_attr_lru.next =
+        &(*sigar)->proc_attr_lru;
+    (*sigar)->proc_attr_bytes = 0;
+    (*sigar)->proc_attr_max = 0;
+    (*sigar)->proc_dirfd = -1;
+    (*sigar)->proc_fd_buf = NULL;
+    (*sigar)->proc_pinned = NULL;
+    (*sigar)->proc_port_index = NULL;
+    (*sigar)->proc_port_pool = NULL;
+    (*sigar)->proc_port_index_time = 0;
+    (*sigar)->ifstat_list.number = (*sigar)->ifstat_list.size = 0;
+    (*sigar)->ifstat_index = NULL;
+    (*sigar)->ifstat_time = 0;
+    (*sigar)->ifconfig_list.number = (*sigar)->ifconfig_list.size = 0;
+    (*sigar)->ifconfig_index = NULL;
+    (*sigar)->ifconfig_time = 0;
+    (*sigar)->mounts.number = (*sigar)->mounts.size = 0;
+    (*sigar)->mounts_fd = -1;
+    (*sigar)->meminfo_time = 0;
+    (*sigar)->system_stat.cpulist.number =
+        (*sigar)->system_stat.cpulist.size = 0;
+    (*sigar)->system_stat_time = 0;
+    (*sigar)->system_stat_cpus = NULL;
+    (*sigar)->system_stat_cpus_size = 0;
+    (*sigar)->system_stat_buf = NULL;
+    (*sigar)->system_stat_buflen = 0;
+    (*sigar)->interrupts_buf = NULL;
+    (*sigar)->interrupts_buflen = 0;
+    (*sigar)->cpu_infos.number = (*sigar)->cpu_infos.size = 0;
+    (*sigar)->cpu_info_ncpu = 0;
+    (*sigar)->cpu_info_rollup = 0;
+    (*sigar)->cpu_info_cur_freq = -1;
+    (*sigar)->diskstats.number = (*sigar)->diskstats.size = 0;
+    (*sigar)->diskstats_index = NULL;
+    (*sigar)->diskstats_prev = NULL;
+    (*sigar)->diskstats_time = 0;
+    (*sigar)->taskstats_fd = -1;
+    (*sigar)->taskstats_family = -1;
+    (*sigar)->taskstats_seq = 0;
+    (*sigar)->cgroup = NULL;
+    (*sigar)->sock_diag_fd = -1;
+    (*sigar)->sock_diag_seq = 0;
+    (*sigar)->sock_diag_bytes = NULL;
+    (*sigar)->rtnl = NULL;
+    (*sigar)->perf = NULL;
+    (*sigar)->uring = NULL;
+    (*sigar)->proc_reads = NULL;
+    (*sigar)->proc_reads_number = 0;
+    (*sigar)->proc_reads_cursor = 0;
 
     (*sigar)->lcpu = -1;
 
-    if (stat(PROC_DISKSTATS, &sb) == 0) {
-        (*sigar)->iostat = IOSTAT_DISKSTATS;
+    /* hook for a mirrored or synthetic /proc, e.g. bench fixtures */
+    (*sigar)->proc_root = getenv("SIGAR_PROC_ROOT");
+    if ((status = sigar_procfs_root_set((*sigar)->proc_root)) != SIGAR_OK) {
+        free(*sigar);
+        return status;
+    }
+
+    /* hook for using mirrored /proc/net/tcp file */
+    (*sigar)->proc_net = getenv("SIGAR_PROC_NET");
+    (*sigar)->netns_dir = NULL;
+    (*sigar)->backend.proc_net_open = (*sigar)->proc_net ?
+        proc_net_mirror_open : proc_net_procfs_open;
+
+    /*
+     * capability probes, see linux_iostat() and friends, run once on
+     * first use of whatever needs them, so that opening a handle which only ever asks for
+     * memory does not stat /sys or read /proc/stat.
+     * sigar_open_ex() can ask for them up front instead.
+     */
+    (*sigar)->iostat = IOSTAT_UNKNOWN;
+    (*sigar)->backend.iostat_get = NULL;
+    (*sigar)->proc_fd_stat = -1;
+    (*sigar)->has_nptl = -1;
+    (*sigar)->boot_time = 0;
+
+    return SIGAR_OK;
+}
+
+static int get_iostat_sys(sigar_t *sigar,
+                          const char *dirname,
+                          sigar_disk_usage_t *disk,
+                          sigar_iodev_t **iodev,
+                          sigar_disk_usage_t *device_usage);
+
+static int get_iostat_proc_dstat(sigar_t *sigar,
+                                 const char *dirname,
+                                 sigar_disk_usage_t *disk,
+                                 sigar_iodev_t **iodev,
+                                 sigar_disk_usage_t *device_usage);
+
+static int get_iostat_procp(sigar_t *sigar,
+                            const char *dirname,
+                            sigar_disk_usage_t *disk,
+                            sigar_iodev_t **iodev,
+                            sigar_disk_usage_t *device_usage);
+
+static int get_iostat_none(sigar_t *sigar,
+                           const char *dirname,
+                           sigar_disk_usage_t *disk,
+                           sigar_iodev_t **iodev,
+                           sigar_disk_usage_t *device_usage)
+{
+    return ENOENT;
+}
+
+static linux_iostat_e linux_iostat(sigar_t *sigar)
+{
+    struct stat sb;
+    char fname[SIGAR_PATH_MAX+1];
+
+    if (sigar->iostat != IOSTAT_UNKNOWN) {
+        return sigar->iostat;
+    }
+
+    /*
+     * 2.2 has metrics /proc/stat, but wtf is the device mapping?
+     * 2.4 has /proc/partitions w/ the metrics.
+     * 2.6 has /proc/partitions w/o the metrics.
+     *     instead the metrics are within the /proc-like /sys filesystem.
+     *     also has /proc/diskstats
+     */
+    if (stat(SIGAR_PROCFS_FILENAME(fname, PROC_DISKSTATS), &sb) == 0) {
+        sigar->iostat = IOSTAT_DISKSTATS;
+        sigar->backend.iostat_get = get_iostat_proc_dstat;
     }
-    else if (stat(SYS_BLOCK, &sb) == 0) {
-        (*sigar)->iostat = IOSTAT_SYS;
+    else if (!sigar->proc_root && (stat(SYS_BLOCK, &sb) == 0)) {
+        sigar->iostat = IOSTAT_SYS;
+        sigar->backend.iostat_get = get_iostat_sys;
     }
-    else if (stat(PROC_PARTITIONS, &sb) == 0) {
+    else if (stat(SIGAR_PROCFS_FILENAME(fname, PROC_PARTITIONS), &sb) == 0) {
         /* XXX file exists does not mean is has the fields */
-        (*sigar)->iostat = IOSTAT_PARTITIONS;
+        sigar->iostat = IOSTAT_PARTITIONS;
+        sigar->backend.iostat_get = get_iostat_procp;
     }
     else {
-        (*sigar)->iostat = IOSTAT_NONE;
+        sigar->iostat = IOSTAT_NONE;
+        sigar->backend.iostat_get = get_iostat_none;
     }
 
-    /* hook for using mirrored /proc/net/tcp file */
-    (*sigar)->proc_net = getenv("SIGAR_PROC_NET");
+    return sigar->iostat;
+}
+
+static int linux_proc_fd_stat(sigar_t *sigar)
+{
+    struct stat sb;
+    char fname[SIGAR_PATH_MAX+1];
+
+    if (sigar->proc_fd_stat != -1) {
+        return sigar->proc_fd_stat;
+    }
+
+    /* older kernels say 0 for the fd dir, we have at least stdio open */
+    sigar->proc_fd_stat =
+        (stat(SIGAR_PROCFS_FILENAME(fname, "self/fd"), &sb) == 0) &&
+        (sb.st_size > 0);
+
+    return sigar->proc_fd_stat;
+}
+
+int linux_proc_mirrored(sigar_t *sigar)
+{
+    return sigar->proc_root != NULL;
+}
+
+static int linux_has_nptl(sigar_t *sigar)
+{
+    struct utsname name;
+    int kernel_rev;
+
+    if (sigar->has_nptl != -1) {
+        return sigar->has_nptl;
+    }
 
     uname(&name);
     /* 2.X.y.z -> just need X (unless there is ever a kernel version 3!) */
     kernel_rev = atoi(&name.release[2]);
     if (kernel_rev >= 6) {
-        has_nptl = 1;
+        sigar->has_nptl = 1;
+    }
+    else {
+        sigar->has_nptl = getenv("SIGAR_HAS_NPTL") ? 1 : 0;
+    }
+
+    return sigar->has_nptl;
+}
+
+static unsigned long linux_boot_time(sigar_t *sigar)
+{
+    if (sigar->boot_time) {
+        return sigar->boot_time;
+    }
+
+    if ((system_stat_read(sigar) == SIGAR_OK) &&
+        (sigar->system_stat.boot_time != SIGAR_FIELD_NOTIMPL))
+    {
+        sigar->boot_time = sigar->system_stat.boot_time;
+    }
+    else {
+        /* should never happen */
+        sigar->boot_time = time(NULL);
+    }
+
+    return sigar->boot_time;
+}
+
+int sigar_os_open_probe(sigar_t *sigar, int flags)
+{
+    if (flags & SIGAR_OPEN_PROC) {
+        (void)linux_has_nptl(sigar);
+        (void)linux_proc_fd_stat(sigar);
+        (void)linux_boot_time(sigar);
+        (void)linux_uring_open(sigar);
+    }
+    if (flags & SIGAR_OPEN_DISK) {
+        (void)linux_iostat(sigar);
+    }
+
+    return SIGAR_OK;
+}
+
+int sigar_os_capabilities_get(sigar_t *sigar, sigar_capabilities_t *caps)
+{
+    switch (linux_iostat(sigar)) {
+      case IOSTAT_DISKSTATS:
+        caps->disk_io = "diskstats";
+        break;
+      case IOSTAT_SYS:
+        caps->disk_io = "sysfs";
+        break;
+      case IOSTAT_PARTITIONS:
+        caps->disk_io = "partitions";
+        break;
+      default:
+        caps->disk_io = "none";
+        break;
+    }
+
+    if (sigar->proc_net) {
+        caps->net_conn = "mirror";
     }
     else {
-        has_nptl = getenv("SIGAR_HAS_NPTL") ? 1 : 0;
+        caps->net_conn = (linux_sock_diag_probe(sigar) == SIGAR_OK) ?
+            "sock_diag" : "procfs";
     }
-    (*sigar)->has_nptl = has_nptl;
+
+    caps->net_iface = (linux_rtnetlink_probe(sigar) == SIGAR_OK) ?
+        "rtnetlink" : "ioctl";
+
+    caps->proc_time = (linux_taskstats_probe(sigar) == SIGAR_OK) ?
+        "taskstats" : "procfs";
+
+    caps->proc_read = (linux_uring_open(sigar) == SIGAR_OK) ?
+        "io_uring" : "pread";
 
     return SIGAR_OK;
 }
 
 int sigar_os_close(sigar_t *sigar)
 {
+    if (sigar->proc_stat) {
+        sigar_cache_destroy(sigar->proc_stat);
+    }
+    if (sigar->proc_stat_pool) {
+        sigar_pool_destroy(sigar->proc_stat_pool);
+    }
+    if (sigar->proc_pinned) {
+        sigar_cache_destroy(sigar->proc_pinned);
+    }
+    if (sigar->proc_attr) {
+        sigar_cache_destroy(sigar->proc_attr);
+    }
+    if (sigar->proc_port_index) {
+        sigar_cache_destroy(sigar->proc_port_index);
+    }
+    if (sigar->proc_port_pool) {
+        sigar_pool_destroy(sigar->proc_port_pool);
+    }
+    if (sigar->ifstat_index) {
+        sigar_cache_destroy(sigar->ifstat_index);
+    }
+    sigar_net_interface_stat_list_destroy(sigar, &sigar->ifstat_list);
+    if (sigar->ifconfig_index) {
+        sigar_cache_destroy(sigar->ifconfig_index);
+    }
+    sigar_net_interface_config_list_destroy(sigar, &sigar->ifconfig_list);
+    if (sigar->diskstats_index) {
+        sigar_cache_destroy(sigar->diskstats_index);
+    }
+    if (sigar->diskstats_prev) {
+        sigar_cache_destroy(sigar->diskstats_prev);
+    }
+    sigar_disk_usage_list_destroy(sigar, &sigar->diskstats);
+    sigar_cpu_list_destroy(sigar, &sigar->system_stat.cpulist);
+    sigar_file_system_list_destroy(sigar, &sigar->mounts);
+    sigar_cpu_info_list_destroy(sigar, &sigar->cpu_infos);
+    if (sigar->mounts_fd >= 0) {
+        close(sigar->mounts_fd);
+    }
+    if (sigar->system_stat_cpus) {
+        free(sigar->system_stat_cpus);
+    }
+    if (sigar->system_stat_buf) {
+        free(sigar->system_stat_buf);
+    }
+    if (sigar->interrupts_buf) {
+        free(sigar->interrupts_buf);
+    }
+    if (sigar->proc_dirfd >= 0) {
+        close(sigar->proc_dirfd);
+    }
+    if (sigar->proc_fd_buf) {
+        free(sigar->proc_fd_buf);
+    }
+    linux_taskstats_close(sigar);
+    linux_sock_diag_close(sigar);
+    linux_rtnetlink_close(sigar);
+    linux_cgroup_close(sigar);
+    linux_perf_close(sigar);
+    linux_uring_close(sigar);
+    if (sigar->proc_reads) {
+        free(sigar->proc_reads);
+    }
     free(sigar);
     return SIGAR_OK;
 }
@@ -256,7 +542,7 @@ static int get_ram(sigar_t *sigar, sigar_mem_t *mem)
      * at least one configuration where that is not the
      * case.
      */
-    if (!(fp = fopen(PROC_MTRR, "r"))) {
+    if (!(fp = PROCFS_FOPEN(PROC_MTRR))) {
         return errno;
     }
 
@@ -295,51 +581,163 @@ static int get_ram(sigar_t *sigar, sigar_mem_t *mem)
     return SIGAR_OK;
 }
 
-#define MEMINFO_PARAM(a) a ":", SSTRLEN(a ":")
+static SIGAR_INLINE sigar_uint64_t sigar_meminfo_value(char *value)
+{
+    sigar_uint64_t val;
+    char *tok;
+
+    val = strtoull(value, &tok, 0);
+    while (*tok == ' ') {
+        ++tok;
+    }
+    if (*tok == 'k') {
+        val *= 1024;
+    }
+    else if (*tok == 'M') {
+        val *= (1024 * 1024);
+    }
+
+    return val;
+}
+
+static SIGAR_INLINE sigar_uint64_t sigar_meminfo(sigar_keyval_t *kv)
+{
+    return kv->value ? sigar_meminfo_value(kv->value) : 0;
+}
+
+typedef struct {
+    const char *key;
+    int len;
+    size_t offset;
+} meminfo_key_t;
+
+#define MEMINFO_KEY(key, member) \
+    { key ":", SSTRLEN(key ":"), sigar_offsetof(sigar_mem_ext_t, member) }
+
+/* in /proc/meminfo order, so a known line is a hit on the first try */
+static const meminfo_key_t meminfo_keys[] = {
+    MEMINFO_KEY("MemTotal", total),
+    MEMINFO_KEY("MemFree", free),
+    MEMINFO_KEY("MemAvailable", available), /* 3.14+ */
+    MEMINFO_KEY("Buffers", buffers),
+    MEMINFO_KEY("Cached", cached),
+    MEMINFO_KEY("SwapCached", swap_cached),
+    MEMINFO_KEY("Active", active),
+    MEMINFO_KEY("Inactive", inactive),
+    MEMINFO_KEY("SwapTotal", swap_total),
+    MEMINFO_KEY("SwapFree", swap_free),
+    MEMINFO_KEY("Dirty", dirty),
+    MEMINFO_KEY("Writeback", writeback),
+    MEMINFO_KEY("AnonPages", anon_pages),
+    MEMINFO_KEY("Mapped", mapped),
+    MEMINFO_KEY("Shmem", shmem),
+    MEMINFO_KEY("Slab", slab),
+    MEMINFO_KEY("SReclaimable", slab_reclaimable),
+    MEMINFO_KEY("SUnreclaim", slab_unreclaimable),
+    MEMINFO_KEY("PageTables", page_tables),
+    MEMINFO_KEY("CommitLimit", commit_limit),
+    MEMINFO_KEY("Committed_AS", committed_as),
+    MEMINFO_KEY("HugePages_Total", huge_pages_total),
+    MEMINFO_KEY("HugePages_Free", huge_pages_free),
+    MEMINFO_KEY("HugePages_Rsvd", huge_pages_rsvd),
+    MEMINFO_KEY("HugePages_Surp", huge_pages_surp),
+    MEMINFO_KEY("Hugepagesize", huge_page_size)
+};
+
+#define MEMINFO_KEYS (sizeof(meminfo_keys)/sizeof(meminfo_keys[0]))
 
-static SIGAR_INLINE sigar_uint64_t sigar_meminfo(char *buffer,
-                                                 char *attr, int len)
+/* one pass over the file, keys the kernel lacks stay NOTIMPL */
+static void meminfo_parse(sigar_mem_ext_t *memext, char *ptr)
 {
-    sigar_uint64_t val = 0;
-    char *ptr, *tok;
+    sigar_uint64_t *field = (sigar_uint64_t *)memext;
+    unsigned int i, next = 0;
 
-    if ((ptr = strstr(buffer, attr))) {
-        ptr += len;
-        val = strtoull(ptr, &tok, 0);
-        while (*tok == ' ') {
-            ++tok;
+    /* all members are sigar_uint64_t */
+    for (i=0; i<sizeof(*memext)/sizeof(*field); i++) {
+        field[i] = SIGAR_FIELD_NOTIMPL;
+    }
+
+    while (*ptr) {
+        char *line = ptr;
+
+        if ((ptr = strchr(line, '\n'))) {
+            ++ptr;
         }
-        if (*tok == 'k') {
-            val *= 1024;
+        else {
+            ptr = line + strlen(line);
         }
-        else if (*tok == 'M') {
-            val *= (1024 * 1024);
+
+        for (i=0; i<MEMINFO_KEYS; i++) {
+            const meminfo_key_t *key = &meminfo_keys[(next + i) % MEMINFO_KEYS];
+
+            if (strnEQ(line, key->key, key->len)) {
+                *(sigar_uint64_t *)((char *)memext + key->offset) =
+                    sigar_meminfo_value(line + key->len);
+                next = (next + i + 1) % MEMINFO_KEYS;
+                break;
+            }
         }
     }
-
-    return val;
 }
 
-int sigar_mem_get(sigar_t *sigar, sigar_mem_t *mem)
+/* long enough for sigar_mem_get + sigar_swap_get in one poll */
+#define MEMINFO_EXPIRE 10
+
+static int meminfo_read(sigar_t *sigar)
 {
-    sigar_uint64_t buffers, cached, kern;
+    sigar_uint64_t timenow = sigar_time_now_millis();
     char buffer[BUFSIZ];
+    int status;
 
-    int status = sigar_file2str(PROC_MEMINFO,
-                                buffer, sizeof(buffer));
+    if (sigar->meminfo_time &&
+        (timenow >= sigar->meminfo_time) &&
+        (timenow < sigar->meminfo_time + MEMINFO_EXPIRE))
+    {
+        return SIGAR_OK;
+    }
 
+    status = SIGAR_PROCFS_FILE2STR(PROC_MEMINFO, buffer);
     if (status != SIGAR_OK) {
         return status;
     }
 
-    mem->total  = sigar_meminfo(buffer, MEMINFO_PARAM("MemTotal"));
-    mem->free   = sigar_meminfo(buffer, MEMINFO_PARAM("MemFree"));
-    mem->used   = mem->total - mem->free;
+    meminfo_parse(&sigar->meminfo, buffer);
+    sigar->meminfo_time = timenow;
+
+    return SIGAR_OK;
+}
+
+int sigar_mem_ext_get(sigar_t *sigar, sigar_mem_ext_t *memext)
+{
+    int status = meminfo_read(sigar);
 
-    buffers = sigar_meminfo(buffer, MEMINFO_PARAM("Buffers"));
-    cached  = sigar_meminfo(buffer, MEMINFO_PARAM("Cached"));
+    if (status != SIGAR_OK) {
+        return status;
+    }
+
+    memcpy(memext, &sigar->meminfo, sizeof(*memext));
+
+    return SIGAR_OK;
+}
+
+/* NOTIMPL counts as 0 */
+#define MEMINFO_GET(field) \
+    ((sigar->meminfo.field == SIGAR_FIELD_NOTIMPL) ? 0 : sigar->meminfo.field)
+
+int sigar_mem_get(sigar_t *sigar, sigar_mem_t *mem)
+{
+    sigar_uint64_t kern;
+    int status = meminfo_read(sigar);
+
+    if (status != SIGAR_OK) {
+        return status;
+    }
+
+    mem->total  = MEMINFO_GET(total);
+    mem->free   = MEMINFO_GET(free);
+    mem->used   = mem->total - mem->free;
 
-    kern = buffers + cached;
+    kern = MEMINFO_GET(buffers) + MEMINFO_GET(cached);
     mem->actual_free = mem->free + kern;
     mem->actual_used = mem->used - kern;
 
@@ -355,37 +753,36 @@ int sigar_mem_get(sigar_t *sigar, sigar_mem_t *mem)
 int sigar_swap_get(sigar_t *sigar, sigar_swap_t *swap)
 {
     char buffer[BUFSIZ], *ptr;
-
-    /* XXX: we open/parse the same file here as sigar_mem_get */
-    int status = sigar_file2str(PROC_MEMINFO,
-                                buffer, sizeof(buffer));
+    sigar_keyval_t vmstat[] = {
+        SIGAR_KEYVAL("pswpin "),
+        SIGAR_KEYVAL("pswpout ")
+    };
+    int status = meminfo_read(sigar);
 
     if (status != SIGAR_OK) {
         return status;
     }
 
-    swap->total  = sigar_meminfo(buffer, MEMINFO_PARAM("SwapTotal"));
-    swap->free   = sigar_meminfo(buffer, MEMINFO_PARAM("SwapFree"));
+    swap->total  = MEMINFO_GET(swap_total);
+    swap->free   = MEMINFO_GET(swap_free);
     swap->used   = swap->total - swap->free;
 
     swap->page_in = swap->page_out = -1;
 
-    status = sigar_file2str(PROC_VMSTAT,
-                            buffer, sizeof(buffer));
+    status = SIGAR_PROCFS_FILE2STR(PROC_VMSTAT, buffer);
 
     if (status == SIGAR_OK) {
         /* 2.6+ kernel */
-        if ((ptr = strstr(buffer, "\npswpin"))) {
-            ptr = sigar_skip_token(ptr);
+        if (sigar_keyval_scan(buffer, vmstat, 2) == 2) {
+            ptr = vmstat[0].value;
             swap->page_in = sigar_strtoull(ptr);
-            ptr = sigar_skip_token(ptr);
+            ptr = vmstat[1].value;
             swap->page_out = sigar_strtoull(ptr);
         }
     }
     else {
         /* 2.2, 2.4 kernels */
-        status = sigar_file2str(PROC_STAT,
-                                buffer, sizeof(buffer));
+        status = SIGAR_PROCFS_FILE2STR(PROC_STAT, buffer);
         if (status != SIGAR_OK) {
             return status;
         }
@@ -400,98 +797,420 @@ int sigar_swap_get(sigar_t *sigar, sigar_swap_t *swap)
     return SIGAR_OK;
 }
 
+#define CPU_FIELDS 8
+
 static void get_cpu_metrics(sigar_t *sigar, sigar_cpu_t *cpu, char *line)
 {
-    char *ptr = sigar_skip_token(line); /* "cpu%d" */
+    sigar_uint64_t fields[CPU_FIELDS];
+    char *end = strchr(line, '\n');
+    char *ptr;
+    int num;
+
+    if (!end) {
+        end = line + strlen(line);
+    }
+    ptr = sigar_scan_field(line, end); /* "cpu%d" */
 
-    cpu->user += SIGAR_TICK2MSEC(sigar_strtoull(ptr));
-    cpu->nice += SIGAR_TICK2MSEC(sigar_strtoull(ptr));
-    cpu->sys  += SIGAR_TICK2MSEC(sigar_strtoull(ptr));
-    cpu->idle += SIGAR_TICK2MSEC(sigar_strtoull(ptr));
-    if (*ptr == ' ') {
+    if ((num = sigar_scan_columns(&ptr, end, fields, CPU_FIELDS)) < 4) {
+        return;
+    }
+
+    cpu->user += SIGAR_TICK2MSEC(fields[0]);
+    cpu->nice += SIGAR_TICK2MSEC(fields[1]);
+    cpu->sys  += SIGAR_TICK2MSEC(fields[2]);
+    cpu->idle += SIGAR_TICK2MSEC(fields[3]);
+    if (num >= 7) {
         /* 2.6+ kernels only */
-        cpu->wait += SIGAR_TICK2MSEC(sigar_strtoull(ptr));
-        cpu->irq += SIGAR_TICK2MSEC(sigar_strtoull(ptr));
-        cpu->soft_irq += SIGAR_TICK2MSEC(sigar_strtoull(ptr));
+        cpu->wait += SIGAR_TICK2MSEC(fields[4]);
+        cpu->irq += SIGAR_TICK2MSEC(fields[5]);
+        cpu->soft_irq += SIGAR_TICK2MSEC(fields[6]);
     }
-    if (*ptr == ' ') {
+    if (num >= 8) {
         /* 2.6.11+ kernels only */
-        cpu->stolen += SIGAR_TICK2MSEC(sigar_strtoull(ptr));
+        cpu->stolen += SIGAR_TICK2MSEC(fields[7]);
     }
     cpu->total =
         cpu->user + cpu->nice + cpu->sys + cpu->idle +
         cpu->wait + cpu->irq + cpu->soft_irq + cpu->stolen;
 }
 
-int sigar_cpu_get(sigar_t *sigar, sigar_cpu_t *cpu)
-{
-    char buffer[BUFSIZ];
-    int status = sigar_file2str(PROC_STAT, buffer, sizeof(buffer));
-
-    if (status != SIGAR_OK) {
-        return status;
-    }
-
-    SIGAR_ZERO(cpu);
-    get_cpu_metrics(sigar, cpu, buffer);
-
-    return SIGAR_OK;
-}
+/* counters only move once per tick, a re-read any sooner is wasted */
+#define SYSTEM_STAT_EXPIRE (SIGAR_MSEC / sigar->ticks)
 
-int sigar_cpu_list_get(sigar_t *sigar, sigar_cpu_list_t *cpulist)
+/* the whole of a procfs file in one read(2) loop, into a kept buffer */
+static int procfs_file_read(const char *fname, int namelen,
+                            char **buf, size_t *buflen, size_t *nread)
 {
-    FILE *fp;
-    char buffer[BUFSIZ], cpu_total[BUFSIZ], *ptr;
-    int core_rollup = sigar_cpu_core_rollup(sigar), i=0;
-    sigar_cpu_t *cpu;
+    size_t len = 0;
+    ssize_t num;
+    int fd = procfs_open(fname, namelen, O_RDONLY);
 
-    if (!(fp = fopen(PROC_STAT, "r"))) {
+    if (fd < 0) {
         return errno;
     }
 
-    /* skip first line */
-    (void)fgets(cpu_total, sizeof(cpu_total), fp);
-
-    sigar_cpu_list_create(cpulist);
+    if (!*buf) {
+        *buflen = BUFSIZ;
+        *buf = malloc(*buflen);
+    }
 
-    /* XXX: merge times of logical processors if hyperthreading */
-    while ((ptr = fgets(buffer, sizeof(buffer), fp))) {
-        if (!strnEQ(ptr, "cpu", 3)) {
-            break;
+    for (;;) {
+        if (len + 1 >= *buflen) {
+            *buflen *= 2;
+            *buf = realloc(*buf, *buflen);
         }
 
-        if (core_rollup && (i % sigar->lcpu)) {
-            /* merge times of logical processors */
-            cpu = &cpulist->data[cpulist->number-1];
+        SIGAR_INSTRUMENT_READ();
+        num = read(fd, *buf + len, *buflen - len - 1);
+
+        if (num < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            num = errno;
+            close(fd);
+            return (int)num;
         }
-        else {
-            SIGAR_CPU_LIST_GROW(cpulist);
-            cpu = &cpulist->data[cpulist->number++];
-            SIGAR_ZERO(cpu);
+        if (num == 0) {
+            break;
         }
-
-        get_cpu_metrics(sigar, cpu, ptr);
-
-        i++;
+        len += num;
     }
 
-    fclose(fp);
-
-    if (cpulist->number == 0) {
-        /* likely older kernel where cpu\d is not present */
-        cpu = &cpulist->data[cpulist->number++];
-        SIGAR_ZERO(cpu);
-        get_cpu_metrics(sigar, cpu, cpu_total);
+    close(fd);
+    (*buf)[len] = '\0';
+    if (nread) {
+        *nread = len;
     }
 
     return SIGAR_OK;
 }
 
-int sigar_uptime_get(sigar_t *sigar,
+#define PROCFS_FILE_READ(fname, buf, buflen, nread) \
+    procfs_file_read(fname, SSTRLEN(fname), buf, buflen, nread)
+
+/* the whole of /proc/stat, the buffer is kept for reuse */
+static int system_stat_file_read(sigar_t *sigar)
+{
+    return PROCFS_FILE_READ(PROC_STAT, &sigar->system_stat_buf,
+                            &sigar->system_stat_buflen, NULL);
+}
+
+static sigar_cpu_t *system_stat_cpu_add(sigar_t *sigar,
+                                        sigar_cpu_list_t *cpulist,
+                                        int num)
+{
+    sigar_cpu_t *cpu;
+
+    SIGAR_CPU_LIST_GROW(cpulist);
+
+    if (sigar->system_stat_cpus_size < cpulist->size) {
+        sigar->system_stat_cpus_size = cpulist->size;
+        sigar->system_stat_cpus =
+            realloc(sigar->system_stat_cpus,
+                    sizeof(*sigar->system_stat_cpus) * cpulist->size);
+    }
+
+    sigar->system_stat_cpus[cpulist->number] = num;
+    cpu = &cpulist->data[cpulist->number++];
+    SIGAR_ZERO(cpu);
+
+    return cpu;
+}
+
+static void system_stat_parse(sigar_t *sigar, sigar_system_stat_t *stat,
+                              char *ptr)
+{
+    sigar_cpu_list_t *cpulist = &stat->cpulist;
+    sigar_cpu_t *cpu;
+    char *line;
+
+    SIGAR_ZERO(&stat->cpu);
+    cpulist->number = 0;
+    stat->ctxt = stat->intr = stat->soft_irq = stat->processes =
+        stat->procs_running = stat->procs_blocked =
+        stat->boot_time = SIGAR_FIELD_NOTIMPL;
+
+    for (line = ptr; *line; line = ptr) {
+        if ((ptr = strchr(line, '\n'))) {
+            ++ptr;
+        }
+        else {
+            ptr = line + strlen(line);
+        }
+
+        if (strnEQ(line, "cpu", 3)) {
+            if (line[3] == ' ') {
+                get_cpu_metrics(sigar, &stat->cpu, line);
+            }
+            else {
+                cpu = system_stat_cpu_add(sigar, cpulist,
+                                          atoi(line + 3));
+                get_cpu_metrics(sigar, cpu, line);
+            }
+        }
+        else if (strnEQ(line, "intr ", 5)) {
+            /* the first column is the sum of the rest */
+            line += 5;
+            stat->intr = sigar_strtoull(line);
+        }
+        else if (strnEQ(line, "ctxt ", 5)) {
+            line += 5;
+            stat->ctxt = sigar_strtoull(line);
+        }
+        else if (strnEQ(line, "btime ", 6)) {
+            line += 6;
+            stat->boot_time = sigar_strtoull(line);
+        }
+        else if (strnEQ(line, "processes ", 10)) {
+            line += 10;
+            stat->processes = sigar_strtoull(line);
+        }
+        else if (strnEQ(line, "procs_running ", 14)) {
+            line += 14;
+            stat->procs_running = sigar_strtoull(line);
+        }
+        else if (strnEQ(line, "procs_blocked ", 14)) {
+            line += 14;
+            stat->procs_blocked = sigar_strtoull(line);
+        }
+        else if (strnEQ(line, "softirq ", 8)) {
+            line += 8;
+            stat->soft_irq = sigar_strtoull(line);
+        }
+    }
+
+    if (cpulist->number == 0) {
+        /* likely older kernel where cpu\d is not present */
+        cpu = system_stat_cpu_add(sigar, cpulist, 0);
+        memcpy(cpu, &stat->cpu, sizeof(*cpu));
+    }
+}
+
+/*
+ * sigar_cpu_get, sigar_cpu_list_get, sigar_proc_stat_get and the
+ * boot time are all views over this one snapshot.
+ */
+static int system_stat_read(sigar_t *sigar)
+{
+    sigar_uint64_t timenow = sigar_time_now_millis();
+    int status;
+
+    if (sigar->system_stat_time &&
+        (timenow >= sigar->system_stat_time) &&
+        (timenow < sigar->system_stat_time + SYSTEM_STAT_EXPIRE))
+    {
+        return SIGAR_OK;
+    }
+
+    if ((status = system_stat_file_read(sigar)) != SIGAR_OK) {
+        return status;
+    }
+
+    if (sigar->system_stat.cpulist.size == 0) {
+        sigar_cpu_list_create(&sigar->system_stat.cpulist);
+    }
+
+    system_stat_parse(sigar, &sigar->system_stat, sigar->system_stat_buf);
+    sigar->system_stat_time = timenow;
+
+    return SIGAR_OK;
+}
+
+int sigar_system_stat_get(sigar_t *sigar, sigar_system_stat_t *systemstat)
+{
+    sigar_cpu_list_t *cpulist = &systemstat->cpulist;
+    sigar_system_stat_t *stat = &sigar->system_stat;
+    int status = system_stat_read(sigar);
+
+    if (status != SIGAR_OK) {
+        return status;
+    }
+
+    memcpy(systemstat, stat, sizeof(*systemstat));
+
+    cpulist->size = cpulist->number = stat->cpulist.number;
+    cpulist->data = malloc(sizeof(*(cpulist->data)) * cpulist->size);
+    memcpy(cpulist->data, stat->cpulist.data,
+           sizeof(*(cpulist->data)) * cpulist->number);
+
+    return SIGAR_OK;
+}
+
+int sigar_cpu_get(sigar_t *sigar, sigar_cpu_t *cpu)
+{
+    int status = system_stat_read(sigar);
+
+    if (status != SIGAR_OK) {
+        return status;
+    }
+
+    memcpy(cpu, &sigar->system_stat.cpu, sizeof(*cpu));
+
+    return SIGAR_OK;
+}
+
+static void cpu_times_add(sigar_cpu_t *cpu, sigar_cpu_t *lcpu)
+{
+    cpu->user += lcpu->user;
+    cpu->nice += lcpu->nice;
+    cpu->sys += lcpu->sys;
+    cpu->idle += lcpu->idle;
+    cpu->wait += lcpu->wait;
+    cpu->irq += lcpu->irq;
+    cpu->soft_irq += lcpu->soft_irq;
+    cpu->stolen += lcpu->stolen;
+    cpu->total += lcpu->total;
+}
+
+int sigar_cpu_list_get(sigar_t *sigar, sigar_cpu_list_t *cpulist)
+{
+    sigar_cpu_list_t *lcpus = &sigar->system_stat.cpulist;
+    int core_rollup = sigar_cpu_core_rollup(sigar), status;
+    unsigned long i;
+    sigar_cpu_t *cpu;
+
+    if ((status = system_stat_read(sigar)) != SIGAR_OK) {
+        return status;
+    }
+
+    sigar_cpu_list_create(cpulist);
+
+    for (i=0; i<lcpus->number; i++) {
+        sigar_cpu_t *lcpu = &lcpus->data[i];
+
+        if (core_rollup && (i % sigar->lcpu)) {
+            /* merge times of logical processors */
+            cpu_times_add(&cpulist->data[cpulist->number-1], lcpu);
+        }
+        else {
+            SIGAR_CPU_LIST_GROW(cpulist);
+            cpu = &cpulist->data[cpulist->number++];
+            memcpy(cpu, lcpu, sizeof(*cpu));
+        }
+    }
+
+    return SIGAR_OK;
+}
+
+/*
+ *            CPU0       CPU1
+ *   0:         44          0   IO-APIC   2-edge      timer
+ * LOC:   12345678   23456789   Local timer interrupts
+ * ERR:          0
+ *
+ * /proc/softirqs is the same without descriptions.  on big boxes this
+ * is one %10u column per cpu on every row, sigar_scan_counters takes
+ * them a vector at a time.
+ */
+static int interrupts_parse(char *ptr, char *end,
+                            sigar_interrupt_list_t *interrupts)
+{
+    char *eol = sigar_scan_eol(ptr, end), *p;
+    unsigned long ncpu = 0;
+
+    for (p = sigar_scan_blanks(ptr, eol); strnEQ(p, "CPU", 3);
+         p = sigar_scan_field(p, eol))
+    {
+        ncpu++;
+    }
+    if (ncpu == 0) {
+        return SIGAR_ENOTIMPL;
+    }
+
+    sigar_interrupt_list_create(interrupts, ncpu);
+
+    for (ncpu = 0, p = sigar_scan_blanks(ptr, eol); strnEQ(p, "CPU", 3);
+         p = sigar_scan_field(p, eol))
+    {
+        interrupts->cpus[ncpu++] = (int)strtoul(p + 3, NULL, 10);
+    }
+
+    for (ptr = eol; ptr < end; ptr = eol) {
+        sigar_interrupt_t *irq;
+        sigar_uint64_t *counts;
+        char *colon;
+        size_t len;
+        int i, num;
+
+        eol = sigar_scan_eol(ptr, end);
+        ptr = sigar_scan_blanks(ptr, eol);
+        if (!(colon = memchr(ptr, ':', eol - ptr))) {
+            continue;
+        }
+
+        SIGAR_INTERRUPT_LIST_GROW(interrupts);
+        irq = &interrupts->data[interrupts->number];
+        counts = &interrupts->counts[interrupts->number * ncpu];
+        interrupts->number++;
+
+        len = colon - ptr;
+        if (len >= sizeof(irq->name)) {
+            len = sizeof(irq->name) - 1;
+        }
+        memcpy(irq->name, ptr, len);
+        irq->name[len] = '\0';
+
+        /* the vector may look past eol, never past a newline */
+        ptr = colon + 1;
+        num = sigar_scan_counters(&ptr, end, counts, (int)ncpu);
+
+        for (irq->total = 0, i = 0; i < num; i++) {
+            irq->total += counts[i];
+        }
+        if (num < (int)ncpu) {
+            /* ERR, MIS: one count for the system */
+            memset(counts, 0, sizeof(*counts) * ncpu);
+        }
+
+        ptr = sigar_scan_blanks(ptr, eol);
+        for (len = eol - ptr; len && sigar_isspace(ptr[len-1]); len--)
+            ;
+        if (len >= sizeof(irq->description)) {
+            len = sizeof(irq->description) - 1;
+        }
+        memcpy(irq->description, ptr, len);
+        irq->description[len] = '\0';
+    }
+
+    return SIGAR_OK;
+}
+
+int sigar_interrupts_get(sigar_t *sigar,
+                         sigar_interrupt_list_t *interrupts)
+{
+    size_t len;
+    int status = PROCFS_FILE_READ(PROC_INTERRUPTS, &sigar->interrupts_buf,
+                                  &sigar->interrupts_buflen, &len);
+
+    if (status != SIGAR_OK) {
+        return status;
+    }
+
+    return interrupts_parse(sigar->interrupts_buf,
+                            sigar->interrupts_buf + len, interrupts);
+}
+
+int sigar_softirqs_get(sigar_t *sigar,
+                       sigar_interrupt_list_t *softirqs)
+{
+    size_t len;
+    int status = PROCFS_FILE_READ(PROC_SOFTIRQS, &sigar->interrupts_buf,
+                                  &sigar->interrupts_buflen, &len);
+
+    if (status != SIGAR_OK) {
+        return status;
+    }
+
+    return interrupts_parse(sigar->interrupts_buf,
+                            sigar->interrupts_buf + len, softirqs);
+}
+
+int sigar_uptime_get(sigar_t *sigar,
                      sigar_uptime_t *uptime)
 {
     char buffer[BUFSIZ], *ptr = buffer;
-    int status = sigar_file2str(PROC_UPTIME, buffer, sizeof(buffer));
+    int status = SIGAR_PROCFS_FILE2STR(PROC_UPTIME, buffer);
 
     if (status != SIGAR_OK) {
         return status;
@@ -506,7 +1225,7 @@ int sigar_loadavg_get(sigar_t *sigar,
                       sigar_loadavg_t *loadavg)
 {
     char buffer[BUFSIZ], *ptr = buffer;
-    int status = sigar_file2str(PROC_LOADAVG, buffer, sizeof(buffer));
+    int status = SIGAR_PROCFS_FILE2STR(PROC_LOADAVG, buffer);
 
     if (status != SIGAR_OK) {
         return status;
@@ -519,6 +1238,91 @@ int sigar_loadavg_get(sigar_t *sigar,
     return SIGAR_OK;
 }
 
+static void pressure_stall_parse(char *line, sigar_pressure_stall_t *stall)
+{
+    char *ptr;
+
+    if ((ptr = strstr(line, "avg10="))) {
+        stall->avg10 = strtod(ptr + 6, NULL);
+    }
+    if ((ptr = strstr(line, "avg60="))) {
+        stall->avg60 = strtod(ptr + 6, NULL);
+    }
+    if ((ptr = strstr(line, "avg300="))) {
+        stall->avg300 = strtod(ptr + 7, NULL);
+    }
+    if ((ptr = strstr(line, "total="))) {
+        ptr += 6;
+        stall->total = sigar_strtoull(ptr);
+    }
+}
+
+/*
+ * "some avg10=0.00 avg60=0.00 avg300=0.00 total=0\n"
+ * "full avg10=0.00 avg60=0.00 avg300=0.00 total=0\n"
+ */
+void linux_pressure_parse(char *buffer, sigar_pressure_resource_t *resource)
+{
+    char *line, *ptr;
+
+    for (line = buffer; line && *line; line = ptr) {
+        if ((ptr = strchr(line, '\n'))) {
+            *ptr++ = '\0';
+        }
+
+        if (strnEQ(line, "some ", 5)) {
+            pressure_stall_parse(line, &resource->some);
+        }
+        else if (strnEQ(line, "full ", 5)) {
+            pressure_stall_parse(line, &resource->full);
+        }
+    }
+}
+
+static void pressure_stall_reset(sigar_pressure_stall_t *stall)
+{
+    stall->avg10 = stall->avg60 = stall->avg300 = SIGAR_FIELD_NOTIMPL;
+    stall->total = SIGAR_FIELD_NOTIMPL;
+}
+
+void linux_pressure_reset(sigar_pressure_t *pressure)
+{
+    pressure_stall_reset(&pressure->cpu.some);
+    pressure_stall_reset(&pressure->cpu.full);
+    pressure_stall_reset(&pressure->memory.some);
+    pressure_stall_reset(&pressure->memory.full);
+    pressure_stall_reset(&pressure->io.some);
+    pressure_stall_reset(&pressure->io.full);
+}
+
+int sigar_pressure_get(sigar_t *sigar,
+                       sigar_pressure_t *pressure)
+{
+    struct {
+        const char *name;
+        sigar_pressure_resource_t *resource;
+    } files[] = {
+        { "pressure/cpu",    &pressure->cpu },
+        { "pressure/memory", &pressure->memory },
+        { "pressure/io",     &pressure->io }
+    };
+    char buffer[BUFSIZ];
+    int i, found = 0;
+
+    linux_pressure_reset(pressure);
+
+    for (i=0; i<3; i++) {
+        if (sigar_procfs_file2str(files[i].name, strlen(files[i].name),
+                                  buffer, sizeof(buffer)) == SIGAR_OK)
+        {
+            linux_pressure_parse(buffer, files[i].resource);
+            found++;
+        }
+    }
+
+    return found ? SIGAR_OK : SIGAR_ENOTIMPL;
+}
+
 /*
  * seems the easiest/fastest way to tell if a process listed in /proc
  * is a thread is to check the "exit signal" flag in /proc/num/stat.
@@ -538,10 +1342,7 @@ static SIGAR_INLINE int proc_isthread(sigar_t *sigar, char *pidstr, int len)
     char buffer[BUFSIZ], *ptr=buffer;
     int fd, n, offset=sigar->proc_signal_offset;
 
-    /* sprintf(buffer, "/proc/%s/stat", pidstr) */
-    memcpy(ptr, PROCP_FS_ROOT, SSTRLEN(PROCP_FS_ROOT));
-    ptr += SSTRLEN(PROCP_FS_ROOT);
-
+    /* sprintf(buffer, "%s/stat", pidstr), relative to the procfs root */
     memcpy(ptr, pidstr, len);
     ptr += len;
 
@@ -550,11 +1351,12 @@ static SIGAR_INLINE int proc_isthread(sigar_t *sigar, char *pidstr, int len)
 
     *ptr = '\0';
 
-    if ((fd = open(buffer, O_RDONLY)) < 0) {
+    if ((fd = procfs_open(buffer, ptr - buffer, O_RDONLY)) < 0) {
         /* unlikely if pid was from readdir proc */
         return 0;
     }
 
+    SIGAR_INSTRUMENT_READ();
     n = read(fd, buffer, sizeof(buffer));
     close(fd);
 
@@ -602,10 +1404,11 @@ static SIGAR_INLINE int proc_isthread(sigar_t *sigar, char *pidstr, int len)
 int sigar_os_proc_list_get(sigar_t *sigar,
                            sigar_proc_list_t *proclist)
 {
-    DIR *dirp = opendir(PROCP_FS_ROOT);
+    DIR *dirp = opendir(sigar_procfs_root_get());
     struct dirent *ent, dbuf;
-    register const int threadbadhack = !sigar->has_nptl;
+    register const int threadbadhack = !linux_has_nptl(sigar);
 
+    SIGAR_INSTRUMENT_OPEN();
     if (!dirp) {
         return errno;
     }
@@ -642,343 +1445,1708 @@ int sigar_os_proc_list_get(sigar_t *sigar,
     return SIGAR_OK;
 }
 
-static int proc_stat_read(sigar_t *sigar, sigar_pid_t pid)
+int sigar_os_proc_stat_get(sigar_t *sigar, sigar_proc_stat_t *procstat)
 {
-    char buffer[BUFSIZ], *ptr=buffer, *tmp;
-    unsigned int len;
-    linux_proc_stat_t *pstat = &sigar->last_proc_stat;
+    char buffer[BUFSIZ], *ptr;
     int status;
+    sigar_proc_iter_t iter;
+    sigar_pid_t pid;
 
-    time_t timenow = time(NULL);
+    procstat->total = 0;
+    procstat->sleeping = SIGAR_FIELD_NOTIMPL;
+    procstat->zombie = SIGAR_FIELD_NOTIMPL;
+    procstat->stopped = SIGAR_FIELD_NOTIMPL;
 
-    /* 
-     * short-lived cache read/parse of last /proc/pid/stat
-     * as this info is spread out across a few functions.
-     */
-    if (pstat->pid == pid) {
-        if ((timenow - pstat->mtime) < SIGAR_LAST_PROC_EXPIRE) {
-            return SIGAR_OK;
-        }
+    if ((status = system_stat_read(sigar)) != SIGAR_OK) {
+        return status;
     }
 
-    pstat->pid = pid;
-    pstat->mtime = timenow;
-
-    status = SIGAR_PROC_FILE2STR(buffer, pid, PROC_PSTAT);
-
-    if (status != SIGAR_OK) {
-        return status;
+    if ((sigar->system_stat.procs_running == SIGAR_FIELD_NOTIMPL) ||
+        (sigar->system_stat.procs_blocked == SIGAR_FIELD_NOTIMPL))
+    {
+        return SIGAR_ENOTIMPL; /* 2.4 kernel */
     }
+    procstat->running = sigar->system_stat.procs_running;
+    procstat->idle = sigar->system_stat.procs_blocked;
 
-    if (!(ptr = strchr(ptr, '('))) {
-        return EINVAL;
+    /* "0.00 0.01 0.05 2/345 12345", runnable/total scheduling entities */
+    status = SIGAR_PROCFS_FILE2STR(PROC_LOADAVG, buffer);
+    if ((status == SIGAR_OK) && (ptr = strchr(buffer, '/'))) {
+        ++ptr;
+        procstat->threads = sigar_strtoull(ptr);
     }
-    if (!(tmp = strrchr(++ptr, ')'))) {
-        return EINVAL;
+    else {
+        procstat->threads = SIGAR_FIELD_NOTIMPL;
     }
-    len = tmp-ptr;
 
-    if (len >= sizeof(pstat->name)) {
-        len = sizeof(pstat->name)-1;
+    /* the kernel has no process count, but readdir alone is cheap */
+    iter.sigar = sigar;
+    if ((status = sigar_os_proc_iter_open(&iter)) != SIGAR_OK) {
+        return status;
     }
+    while (sigar_os_proc_iter_next(&iter, &pid) == SIGAR_OK) {
+        procstat->total++;
+    }
+    sigar_os_proc_iter_close(&iter);
 
-    /* (1,2) */
-    memcpy(pstat->name, ptr, len);
-    pstat->name[len] = '\0';
-    ptr = tmp+1;
-
-    SIGAR_SKIP_SPACE(ptr);
-    pstat->state = *ptr++; /* (3) */
-    SIGAR_SKIP_SPACE(ptr);
-
-    pstat->ppid = sigar_strtoul(ptr); /* (4) */
-    ptr = sigar_skip_token(ptr); /* (5) pgrp */
-    ptr = sigar_skip_token(ptr); /* (6) session */
-    pstat->tty = sigar_strtoul(ptr); /* (7) */
-    ptr = sigar_skip_token(ptr); /* (8) tty pgrp */
+    return SIGAR_OK;
+}
 
-    ptr = sigar_skip_token(ptr); /* (9) flags */
-    pstat->minor_faults = sigar_strtoull(ptr); /* (10) */
-    ptr = sigar_skip_token(ptr); /* (11) cmin flt */
-    pstat->major_faults = sigar_strtoull(ptr); /* (12) */
-    ptr = sigar_skip_token(ptr); /* (13) cmaj flt */
+int sigar_os_proc_iter_open(sigar_proc_iter_t *iter)
+{
+    sigar_t *sigar = iter->sigar;
+    DIR *dirp = opendir(sigar_procfs_root_get());
 
-    pstat->utime = SIGAR_TICK2MSEC(sigar_strtoull(ptr)); /* (14) */
-    pstat->stime = SIGAR_TICK2MSEC(sigar_strtoull(ptr)); /* (15) */
+    SIGAR_INSTRUMENT_OPEN();
+    if (!dirp) {
+        return errno;
+    }
 
-    ptr = sigar_skip_token(ptr); /* (16) cutime */
-    ptr = sigar_skip_token(ptr); /* (17) cstime */
+    if (!linux_has_nptl(sigar) && (sigar->proc_signal_offset == -1)) {
+        sigar->proc_signal_offset = get_proc_signal_offset();
+    }
 
-    pstat->priority = sigar_strtoul(ptr); /* (18) */
-    pstat->nice     = sigar_strtoul(ptr); /* (19) */
+    iter->os = dirp;
 
-    ptr = sigar_skip_token(ptr); /* (20) timeout */
-    ptr = sigar_skip_token(ptr); /* (21) it_real_value */
+    return SIGAR_OK;
+}
 
-    pstat->start_time  = sigar_strtoul(ptr); /* (22) */
-    pstat->start_time /= sigar->ticks;
-    pstat->start_time += sigar->boot_time; /* seconds */
-    pstat->start_time *= 1000; /* milliseconds */
+/* same filtering as sigar_os_proc_list_get, one readdir at a time */
+int sigar_os_proc_iter_next(sigar_proc_iter_t *iter, sigar_pid_t *pid)
+{
+    sigar_t *sigar = iter->sigar;
+    struct dirent *ent;
 
-    pstat->vsize = sigar_strtoull(ptr); /* (23) */
-    pstat->rss   = pageshift(sigar_strtoull(ptr)); /* (24) */
+    while ((ent = readdir((DIR *)iter->os))) {
+        if (!sigar_isdigit(*ent->d_name)) {
+            continue;
+        }
 
-    ptr = sigar_skip_token(ptr); /* (25) rlim */
-    ptr = sigar_skip_token(ptr); /* (26) startcode */
-    ptr = sigar_skip_token(ptr); /* (27) endcode */
-    ptr = sigar_skip_token(ptr); /* (28) startstack */
-    ptr = sigar_skip_token(ptr); /* (29) kstkesp */
-    ptr = sigar_skip_token(ptr); /* (30) kstkeip */
-    ptr = sigar_skip_token(ptr); /* (31) signal */
-    ptr = sigar_skip_token(ptr); /* (32) blocked */
-    ptr = sigar_skip_token(ptr); /* (33) sigignore */
-    ptr = sigar_skip_token(ptr); /* (34) sigcache */
-    ptr = sigar_skip_token(ptr); /* (35) wchan */
-    ptr = sigar_skip_token(ptr); /* (36) nswap */
-    ptr = sigar_skip_token(ptr); /* (37) cnswap */
-    ptr = sigar_skip_token(ptr); /* (38) exit_signal */
+        if (!linux_has_nptl(sigar) &&
+            proc_isthread(sigar, ent->d_name, strlen(ent->d_name)))
+        {
+            continue;
+        }
 
-    pstat->processor = sigar_strtoul(ptr); /* (39) */
+        *pid = strtoul(ent->d_name, NULL, 10);
+        return SIGAR_OK;
+    }
 
-    return SIGAR_OK;
+    return ENOENT;
 }
 
-int sigar_proc_mem_get(sigar_t *sigar, sigar_pid_t pid,
-                       sigar_proc_mem_t *procmem)
+void sigar_os_proc_iter_close(sigar_proc_iter_t *iter)
 {
-    char buffer[BUFSIZ], *ptr=buffer;
-    int status = proc_stat_read(sigar, pid);
-    linux_proc_stat_t *pstat = &sigar->last_proc_stat;
+    closedir((DIR *)iter->os);
+}
 
-    procmem->minor_faults = pstat->minor_faults;
-    procmem->major_faults = pstat->major_faults;
-    procmem->page_faults =
+static const struct {
+    const char *name;
+    int len;
+} proc_pin_files[] = {
+    { PROC_PSTAT, SSTRLEN(PROC_PSTAT) },
+    { "/statm", SSTRLEN("/statm") },
+    { "/io", SSTRLEN("/io") },
+    { PROC_PSTATUS, SSTRLEN(PROC_PSTATUS) }
+};
+
+static int proc_dir_open(sigar_t *sigar)
+{
+    if (sigar->proc_dirfd < 0) {
+        sigar->proc_dirfd = open(sigar_procfs_root_get(), O_RDONLY|O_DIRECTORY);
+        if (sigar->proc_dirfd >= 0) {
+            fcntl(sigar->proc_dirfd, F_SETFD, FD_CLOEXEC);
+        }
+    }
+
+    return sigar->proc_dirfd;
+}
+
+static void proc_file_path(char *path, sigar_pid_t pid, int which)
+{
+    char pid_buf[UITOA_BUFFER_SIZE];
+    char *pid_str;
+    int len = 0;
+
+    pid_str = sigar_uitoa(pid_buf, (unsigned int)pid, &len);
+    memcpy(path, pid_str, len);
+    memcpy(path + len, proc_pin_files[which].name,
+           proc_pin_files[which].len + 1);
+}
+
+/* opens "<pid>/<file>" relative to the /proc dirfd */
+static int proc_file_open(sigar_t *sigar, sigar_pid_t pid, int which)
+{
+    char path[UITOA_BUFFER_SIZE+32];
+    int fd;
+
+    proc_file_path(path, pid, which);
+
+    SIGAR_INSTRUMENT_OPEN();
+    fd = openat(sigar->proc_dirfd, path, O_RDONLY);
+    if (fd >= 0) {
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+
+    return fd;
+}
+
+static int proc_fd_read(sigar_t *sigar, int fd)
+{
+    ssize_t nread;
+
+    SIGAR_INSTRUMENT_READ();
+    nread = pread(fd, sigar->proc_buf, sizeof(sigar->proc_buf)-1, 0);
+
+    if (nread < 0) {
+        return errno;
+    }
+    if (nread == 0) {
+        return ESRCH; /* task is gone */
+    }
+    sigar->proc_buf[nread] = '\0';
+
+    return SIGAR_OK;
+}
+
+static void proc_pin_close(linux_proc_pin_t *pin)
+{
+    int i;
+
+    for (i=0; i<PROC_PIN_MAX; i++) {
+        if (pin->fd[i] >= 0) {
+            close(pin->fd[i]);
+            pin->fd[i] = -1;
+        }
+    }
+}
+
+static int proc_pin_open(sigar_t *sigar, sigar_pid_t pid,
+                         linux_proc_pin_t *pin)
+{
+    int i;
+
+    pin->start_time = 0;
+
+    for (i=0; i<PROC_PIN_MAX; i++) {
+        /* -1 if not readable, e.g. io of another user */
+        pin->fd[i] = proc_file_open(sigar, pid, i);
+    }
+
+    if (pin->fd[PROC_PIN_STAT] < 0) {
+        int status = (errno == ENOENT) ? ESRCH : errno;
+        proc_pin_close(pin);
+        return status;
+    }
+
+    return SIGAR_OK;
+}
+
+static void proc_pin_free(void *ptr)
+{
+    proc_pin_close((linux_proc_pin_t *)ptr);
+    free(ptr);
+}
+
+static linux_proc_pin_t *proc_pin_find(sigar_t *sigar, sigar_pid_t pid)
+{
+    sigar_cache_entry_t *entry;
+
+    if (!sigar->proc_pinned) {
+        return NULL;
+    }
+
+    entry = sigar_cache_find(sigar->proc_pinned, pid);
+
+    return entry ? (linux_proc_pin_t *)entry->value : NULL;
+}
+
+int sigar_proc_pin(sigar_t *sigar, sigar_pid_t pid)
+{
+    sigar_cache_entry_t *entry;
+    linux_proc_pin_t *pin;
+    int status;
+
+    if (proc_dir_open(sigar) < 0) {
+        return errno;
+    }
+
+    if (!sigar->proc_pinned) {
+        sigar->proc_pinned = sigar_cache_new(16);
+        sigar->proc_pinned->free_value = proc_pin_free;
+    }
+
+    entry = sigar_cache_get(sigar->proc_pinned, pid);
+    if (entry->value) {
+        return SIGAR_OK;
+    }
+
+    pin = malloc(sizeof(*pin));
+    if ((status = proc_pin_open(sigar, pid, pin)) != SIGAR_OK) {
+        free(pin);
+        sigar_cache_remove(sigar->proc_pinned, pid);
+        return status;
+    }
+    pin->handles = 0;
+    entry->value = pin;
+
+    return SIGAR_OK;
+}
+
+int sigar_proc_unpin(sigar_t *sigar, sigar_pid_t pid)
+{
+    linux_proc_pin_t *pin = proc_pin_find(sigar, pid);
+
+    /* kept for the handles, the last one closed drops it */
+    if (pin && !pin->handles) {
+        sigar_cache_remove(sigar->proc_pinned, pid);
+    }
+
+    return SIGAR_OK;
+}
+
+/*
+ * the pidfd is opened first, the pinned fds after it: if the process
+ * has not exited by then they are its files and not those of a
+ * process that got the pid next.  once it exits the getters say
+ * ESRCH instead of pinning whatever has the pid now.
+ */
+struct sigar_proc_handle_t {
+    sigar_pid_t pid;
+    int fd;
+    int pinned; /* the pin came with the handle */
+};
+
+#define proc_handle_exited(handle) \
+    (proc_handle_poll(handle, 0) == SIGAR_OK)
+
+static int proc_handle_poll(sigar_proc_handle_t *handle, int timeout)
+{
+    struct pollfd pfd;
+    int n;
+
+    pfd.fd = handle->fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    while (((n = poll(&pfd, 1, timeout)) < 0) && (errno == EINTR)) {
+        /* again */
+    }
+
+    if (n < 0) {
+        return errno;
+    }
+
+    return n ? SIGAR_OK : ETIMEDOUT;
+}
+
+int sigar_proc_handle_open(sigar_t *sigar, sigar_pid_t pid,
+                           sigar_proc_handle_t **handle_ptr)
+{
+#ifdef __NR_pidfd_open
+    sigar_proc_handle_t *handle;
+    linux_proc_pin_t *pin;
+    int status;
+
+    *handle_ptr = NULL;
+
+    if (!(handle = malloc(sizeof(*handle)))) {
+        return ENOMEM;
+    }
+    handle->pid = pid;
+
+    if ((handle->fd = syscall(__NR_pidfd_open, pid, 0)) < 0) {
+        status = (errno == ENOSYS) ? SIGAR_ENOTIMPL : errno;
+        free(handle);
+        return status;
+    }
+    fcntl(handle->fd, F_SETFD, FD_CLOEXEC);
+
+    handle->pinned = !proc_pin_find(sigar, pid);
+
+    if ((status = sigar_proc_pin(sigar, pid)) != SIGAR_OK) {
+        close(handle->fd);
+        free(handle);
+        return status;
+    }
+
+    pin = proc_pin_find(sigar, pid);
+    if (!handle->pinned && !pin->handles) {
+        /* opened before the pidfd, could be anyone's */
+        proc_pin_close(pin);
+        proc_pin_open(sigar, pid, pin);
+    }
+    pin->handles++;
+
+    if (proc_handle_exited(handle)) {
+        status = ESRCH;
+    }
+    else if (pin->fd[PROC_PIN_STAT] < 0) {
+        /* still held by handles on the exited one before it */
+        status = EBUSY;
+    }
+    if (status != SIGAR_OK) {
+        sigar_proc_handle_close(sigar, handle);
+        return status;
+    }
+
+    *handle_ptr = handle;
+
+    return SIGAR_OK;
+#else
+    *handle_ptr = NULL;
+
+    return SIGAR_ENOTIMPL;
+#endif
+}
+
+int sigar_proc_handle_close(sigar_t *sigar, sigar_proc_handle_t *handle)
+{
+    linux_proc_pin_t *pin = proc_pin_find(sigar, handle->pid);
+
+    if (pin && (--pin->handles == 0) && handle->pinned) {
+        sigar_cache_remove(sigar->proc_pinned, handle->pid);
+    }
+
+    close(handle->fd);
+    free(handle);
+
+    return SIGAR_OK;
+}
+
+sigar_pid_t sigar_proc_handle_pid_get(sigar_proc_handle_t *handle)
+{
+    return handle->pid;
+}
+
+sigar_proc_waitable_t
+sigar_proc_handle_waitable_get(sigar_proc_handle_t *handle)
+{
+    return handle->fd;
+}
+
+int sigar_proc_handle_wait(sigar_proc_handle_t *handle, int timeout)
+{
+    return proc_handle_poll(handle, timeout);
+}
+
+int sigar_proc_handle_kill(sigar_proc_handle_t *handle, int signum)
+{
+#ifdef __NR_pidfd_send_signal
+    if (syscall(__NR_pidfd_send_signal, handle->fd, signum, NULL, 0) == 0) {
+        return SIGAR_OK;
+    }
+    if (errno != ENOSYS) {
+        return errno;
+    }
+#endif
+    /* pidfd_open came later, this is only for seccomp filters */
+    if (proc_handle_exited(handle)) {
+        return ESRCH;
+    }
+
+    return sigar_proc_kill(handle->pid, signum);
+}
+
+/*
+ * read /proc/<pid>/<file> into sigar->proc_buf, through the pinned
+ * fd if there is one, else opened relative to the /proc dirfd.  the
+ * buffer is reused by the next read, so parse it before calling
+ * back into here.
+ */
+/*
+ * the next read of the batch linux_uring_read got ahead of the
+ * snapshot loop, which asks for them in the order they were queued
+ */
+static int proc_read_ahead(sigar_t *sigar, sigar_pid_t pid,
+                           int which, char **buffer)
+{
+    int i, n = sigar->proc_reads_number;
+
+    for (i=0; i<n; i++) {
+        int k = (sigar->proc_reads_cursor + i) % n;
+        linux_proc_read_t *file = &sigar->proc_reads[k];
+
+        if ((file->pid == pid) && (file->which == which)) {
+            sigar->proc_reads_cursor = (k + 1) % n;
+            if (file->status == SIGAR_OK) {
+                *buffer = file->data;
+            }
+            return file->status;
+        }
+    }
+
+    return SIGAR_ENOTIMPL;
+}
+
+static int proc_file_read(sigar_t *sigar, sigar_pid_t pid,
+                          int which, char **buffer)
+{
+    linux_proc_pin_t *pin;
+    int fd, status;
+
+    if (sigar->proc_reads_number &&
+        ((status = proc_read_ahead(sigar, pid, which,
+                                   buffer)) != SIGAR_ENOTIMPL))
+    {
+        return status;
+    }
+
+    pin = proc_pin_find(sigar, pid);
+    *buffer = sigar->proc_buf;
+
+    if (pin) {
+        if (pin->fd[which] >= 0) {
+            if (proc_fd_read(sigar, pin->fd[which]) == SIGAR_OK) {
+                return SIGAR_OK;
+            }
+            /* the task exited, the pid may have been reused since */
+            proc_pin_close(pin);
+        }
+        if (pin->handles && (pin->fd[PROC_PIN_STAT] < 0)) {
+            /* exited, the handle is not moved on to the next one */
+            return ESRCH;
+        }
+        if (pin->fd[PROC_PIN_STAT] < 0) {
+            if ((status = proc_pin_open(sigar, pid, pin)) != SIGAR_OK) {
+                return status;
+            }
+            if (pin->fd[which] >= 0) {
+                return proc_fd_read(sigar, pin->fd[which]);
+            }
+        }
+    }
+
+    if (proc_dir_open(sigar) < 0) {
+        return sigar_proc_file2str(sigar->proc_buf,
+                                   sizeof(sigar->proc_buf),
+                                   pid,
+                                   proc_pin_files[which].name,
+                                   proc_pin_files[which].len);
+    }
+
+    if ((fd = proc_file_open(sigar, pid, which)) < 0) {
+        return (errno == ENOENT) ? ESRCH : errno;
+    }
+
+    status = proc_fd_read(sigar, fd);
+    close(fd);
+
+    return status;
+}
+
+/* (4) .. (39) are all numeric */
+#define PROC_STAT_FIRST 4
+#define PROC_STAT_LAST  39
+#define PROC_STAT_NFIELDS (PROC_STAT_LAST - PROC_STAT_FIRST + 1)
+#define PROC_STAT_FIELD(fields, n) \
+    fields[(n) - PROC_STAT_FIRST]
+
+static int proc_stat_parse(sigar_t *sigar, char *buffer,
+                           linux_proc_stat_t *pstat)
+{
+    sigar_uint64_t fields[PROC_STAT_NFIELDS];
+    char *ptr=buffer, *tmp;
+    unsigned int len;
+    int i, num;
+
+    if (!(ptr = strchr(ptr, '('))) {
+        return EINVAL;
+    }
+    if (!(tmp = strrchr(++ptr, ')'))) {
+        return EINVAL;
+    }
+    len = tmp-ptr;
+
+    if (len >= sizeof(pstat->name)) {
+        len = sizeof(pstat->name)-1;
+    }
+
+    /* (1,2) */
+    memcpy(pstat->name, ptr, len);
+    pstat->name[len] = '\0';
+    ptr = tmp+1;
+
+    SIGAR_SKIP_SPACE(ptr);
+    pstat->state = *ptr++; /* (3) */
+
+    /*
+     * one pass over the rest, fields we do not use are converted
+     * and dropped.  a short line leaves the tail zeroed.
+     */
+    num = sigar_scan_columns(&ptr, ptr + strlen(ptr), fields, PROC_STAT_NFIELDS);
+    for (i=num; i<PROC_STAT_NFIELDS; i++) {
+        fields[i] = 0;
+    }
+
+    pstat->ppid = PROC_STAT_FIELD(fields, 4);
+    pstat->tty = PROC_STAT_FIELD(fields, 7);
+    pstat->minor_faults = PROC_STAT_FIELD(fields, 10);
+    pstat->major_faults = PROC_STAT_FIELD(fields, 12);
+    pstat->utime = SIGAR_TICK2MSEC(PROC_STAT_FIELD(fields, 14));
+    pstat->stime = SIGAR_TICK2MSEC(PROC_STAT_FIELD(fields, 15));
+    pstat->priority = PROC_STAT_FIELD(fields, 18);
+    pstat->nice = PROC_STAT_FIELD(fields, 19);
+
+    pstat->start_time = PROC_STAT_FIELD(fields, 22);
+    pstat->start_time /= sigar->ticks;
+    pstat->start_time += linux_boot_time(sigar); /* seconds */
+    pstat->start_time *= 1000; /* milliseconds */
+
+    pstat->vsize = PROC_STAT_FIELD(fields, 23);
+    pstat->rss = pageshift(PROC_STAT_FIELD(fields, 24));
+    pstat->processor = PROC_STAT_FIELD(fields, 39);
+
+    return SIGAR_OK;
+}
+
+/*
+ * procfs gives every task directory an inode of its own, so a pid
+ * reused after the stat was cached has another one.  0 once gone.
+ */
+static sigar_uint64_t proc_pid_ino(sigar_t *sigar, sigar_pid_t pid)
+{
+    char pid_buf[UITOA_BUFFER_SIZE];
+    char *pid_str;
+    int len = 0;
+    struct stat sb;
+
+    pid_str = sigar_uitoa(pid_buf, (unsigned int)pid, &len);
+
+    if ((proc_dir_open(sigar) < 0) ||
+        (fstatat(sigar->proc_dirfd, pid_str, &sb, 0) < 0))
+    {
+        return 0;
+    }
+
+    return sb.st_ino;
+}
+
+/* 
+ * short-lived per-pid cache read/parse of /proc/pid/stat
+ * as this info is spread out across a few functions.  max_age 0
+ * always reads, for passes that must see this round's counters.
+ */
+static int proc_stat_read_age(sigar_t *sigar, sigar_pid_t pid,
+                              sigar_uint64_t max_age,
+                              linux_proc_stat_t **pstat_ptr)
+{
+    char *buffer;
+    sigar_cache_entry_t *entry;
+    linux_proc_stat_t *pstat;
+    linux_proc_pin_t *pin;
+    sigar_uint64_t timenow = sigar_time_now_millis();
+    sigar_uint64_t start_time;
+    int status;
+
+    if (!sigar->proc_stat) {
+        sigar->proc_stat =
+            sigar_cache_create(SIGAR_PROC_LIST_MAX,
+                               PID_CACHE_FLAGS,
+                               PROC_STAT_CACHE_CLEANUP_PERIOD,
+                               PROC_STAT_CACHE_ENTRY_EXPIRE_PERIOD);
+        sigar->proc_stat_pool =
+            sigar_pool_new(sizeof(linux_proc_stat_t), PID_CACHE_POOL_SLAB);
+        sigar->proc_stat->value_pool = sigar->proc_stat_pool;
+    }
+
+    entry = sigar_cache_get(sigar->proc_stat, pid);
+
+    if (entry->value) {
+        pstat = (linux_proc_stat_t *)entry->value;
+
+        /*
+         * with proc events an exit drops the entry, without them the
+         * inode tells whether the pid still is the task that was read
+         */
+        if (((timenow - pstat->mtime) < max_age) &&
+            (sigar->proc_events ||
+             (pstat->ino && (pstat->ino == proc_pid_ino(sigar, pid)))))
+        {
+            *pstat_ptr = pstat;
+            return SIGAR_OK;
+        }
+    }
+    else {
+        pstat = entry->value =
+            sigar_cache_value_new(sigar->proc_stat, sizeof(*pstat));
+    }
+
+    /* stale until read and parsed ok */
+    pstat->mtime = 0;
+    start_time = pstat->start_time;
+
+    status = proc_file_read(sigar, pid, PROC_PIN_STAT, &buffer);
+
+    if (status != SIGAR_OK) {
+        return status;
+    }
+
+    pstat->pid = pid;
+    pstat->ino = sigar->proc_events ? 0 : proc_pid_ino(sigar, pid);
+
+    if ((status = proc_stat_parse(sigar, buffer, pstat)) != SIGAR_OK) {
+        return status;
+    }
+
+    if (start_time && (start_time != pstat->start_time)) {
+        if (SIGAR_LOG_IS_DEBUG(sigar)) {
+            sigar_log_printf(sigar, SIGAR_LOG_DEBUG,
+                             "[proc_stat] pid %d was reused", pid);
+        }
+    }
+
+    if ((pin = proc_pin_find(sigar, pid))) {
+        if (pin->start_time && (pin->start_time != pstat->start_time)) {
+            if (pin->handles) {
+                pstat->mtime = 0;
+                return ESRCH;
+            }
+            /* not the task we pinned, reopen so every file follows */
+            proc_pin_close(pin);
+            proc_pin_open(sigar, pid, pin);
+        }
+        pin->start_time = pstat->start_time;
+    }
+
+    pstat->mtime = timenow;
+    *pstat_ptr = pstat;
+
+    return SIGAR_OK;
+}
+
+#define proc_stat_read(sigar, pid, pstat_ptr) \
+    proc_stat_read_age(sigar, pid, (sigar)->proc_cache_expire, pstat_ptr)
+
+static int proc_statm_read(sigar_t *sigar, sigar_pid_t pid,
+                           sigar_proc_mem_t *procmem)
+{
+    char *ptr;
+    int status = proc_file_read(sigar, pid, PROC_PIN_STATM, &ptr);
+
+    if (status != SIGAR_OK) {
+        return status;
+    }
+
+    procmem->size     = pageshift(sigar_strtoull(ptr));
+    procmem->resident = pageshift(sigar_strtoull(ptr));
+    procmem->share    = pageshift(sigar_strtoull(ptr));
+
+    return SIGAR_OK;
+}
+
+static void proc_stat_mem_copy(linux_proc_stat_t *pstat,
+                               sigar_proc_mem_t *procmem)
+{
+    procmem->minor_faults = pstat->minor_faults;
+    procmem->major_faults = pstat->major_faults;
+    procmem->page_faults =
         procmem->minor_faults + procmem->major_faults;
+}
+
+static void proc_stat_time_copy(linux_proc_stat_t *pstat,
+                                sigar_proc_time_t *proctime)
+{
+    proctime->user = pstat->utime;
+    proctime->sys  = pstat->stime;
+    proctime->total = proctime->user + proctime->sys;
+    proctime->start_time = pstat->start_time;
+}
+
+static void proc_stat_state_copy(sigar_t *sigar,
+                                 linux_proc_stat_t *pstat,
+                                 sigar_proc_state_t *procstate)
+{
+    memcpy(procstate->name, pstat->name, sizeof(procstate->name));
+    procstate->state = pstat->state;
+
+    procstate->ppid     = pstat->ppid;
+    procstate->tty      = pstat->tty;
+    procstate->priority = pstat->priority;
+    procstate->nice     = pstat->nice;
+    procstate->processor = pstat->processor;
+
+    if (sigar_cpu_core_rollup(sigar)) {
+        procstate->processor /= sigar->lcpu;
+    }
+}
+
+/* the faults come from stat, the sizes from statm */
+#define PROC_MEM_F_STAT \
+    (SIGAR_PROC_MEM_F_MINOR_FAULTS | \
+     SIGAR_PROC_MEM_F_MAJOR_FAULTS | \
+     SIGAR_PROC_MEM_F_PAGE_FAULTS)
+
+#define PROC_MEM_F_STATM \
+    (SIGAR_PROC_MEM_F_SIZE | \
+     SIGAR_PROC_MEM_F_RESIDENT | \
+     SIGAR_PROC_MEM_F_SHARE)
+
+int sigar_proc_mem_get_ex(sigar_t *sigar, sigar_pid_t pid, int fields,
+                          sigar_proc_mem_t *procmem)
+{
+    if (fields & PROC_MEM_F_STAT) {
+        linux_proc_stat_t *pstat;
+        int status = proc_stat_read(sigar, pid, &pstat);
+
+        if (status != SIGAR_OK) {
+            return status;
+        }
+
+        proc_stat_mem_copy(pstat, procmem);
+    }
+
+    if (fields & PROC_MEM_F_STATM) {
+        return proc_statm_read(sigar, pid, procmem);
+    }
+
+    return SIGAR_OK;
+}
+
+int sigar_proc_mem_get(sigar_t *sigar, sigar_pid_t pid,
+                       sigar_proc_mem_t *procmem)
+{
+    return sigar_proc_mem_get_ex(sigar, pid, SIGAR_PROC_MEM_F_ALL, procmem);
+}
+
+/*
+ * smaps_rollup is one block of smaps style "Key:  N kB" lines, so the
+ * same line summer serves it and, on kernels before 4.14, every
+ * mapping of the full smaps streamed through stdio.
+ */
+static void proc_smaps_line(char *line, sigar_proc_mem_ext_t *memext)
+{
+    sigar_uint64_t *field = NULL;
+    char *ptr;
+
+    switch (*line) {
+      case 'A':
+        if (strnEQ(line, "Anonymous:", 10)) {
+            field = &memext->anon;
+        }
+        break;
+      case 'P':
+        if (strnEQ(line, "Pss:", 4)) {
+            field = &memext->pss;
+        }
+        else if (strnEQ(line, "Private_Clean:", 14) ||
+                 strnEQ(line, "Private_Dirty:", 14))
+        {
+            field = &memext->uss;
+        }
+        break;
+      case 'R':
+        if (strnEQ(line, "Rss:", 4)) {
+            field = &memext->rss;
+        }
+        break;
+      case 'S':
+        if (strnEQ(line, "Shared_Clean:", 13) ||
+            strnEQ(line, "Shared_Dirty:", 13))
+        {
+            field = &memext->shared;
+        }
+        else if (strnEQ(line, "Swap:", 5)) {
+            field = &memext->swap;
+        }
+        else if (strnEQ(line, "SwapPss:", 8)) {
+            field = &memext->swap_pss;
+        }
+        break;
+      default:
+        return; /* mapping header or a field we do not keep */
+    }
+
+    if (field && (ptr = strchr(line, ':'))) {
+        ++ptr;
+        *field += sigar_strtoull(ptr) * 1024;
+    }
+}
+
+/* "run_ns wait_ns timeslices\n" */
+static int proc_schedstat_add(const char *name,
+                              sigar_proc_sched_t *procsched)
+{
+    char buffer[128], *ptr = buffer;
+    int status = sigar_file2str(name, buffer, sizeof(buffer));
+
+    if (status != SIGAR_OK) {
+        return status;
+    }
+
+    procsched->run_time += sigar_strtoull(ptr);
+    procsched->wait_time += sigar_strtoull(ptr);
+    procsched->timeslices += sigar_strtoull(ptr);
+
+    return SIGAR_OK;
+}
+
+/* /proc/<pid>/schedstat is only the main thread's */
+int sigar_proc_sched_get(sigar_t *sigar, sigar_pid_t pid,
+                         sigar_proc_sched_t *procsched)
+{
+    char name[BUFSIZ];
+    struct dirent *ent;
+    size_t len;
+    DIR *dirp;
+    int found = 0;
+
+    procsched->run_time = procsched->wait_time = procsched->timeslices = 0;
+
+    (void)SIGAR_PROC_FILENAME(name, pid, "/task");
+
+    if (!(dirp = opendir(name))) {
+        (void)SIGAR_PROC_FILENAME(name, pid, "/schedstat");
+        return proc_schedstat_add(name, procsched);
+    }
+
+    len = strlen(name);
+
+    while ((ent = readdir(dirp))) {
+        if (!sigar_isdigit(*ent->d_name)) {
+            continue;
+        }
+        snprintf(name + len, sizeof(name) - len,
+                 "/%s/schedstat", ent->d_name);
+        if (proc_schedstat_add(name, procsched) == SIGAR_OK) {
+            found++;
+        }
+    }
+
+    closedir(dirp);
+
+    return found ? SIGAR_OK : ESRCH;
+}
+
+int sigar_proc_mem_ext_get(sigar_t *sigar, sigar_pid_t pid,
+                           sigar_proc_mem_ext_t *procmemext)
+{
+    char name[BUFSIZ], line[BUFSIZ];
+    FILE *fp;
+
+    (void)SIGAR_PROC_FILENAME(name, pid, "/smaps_rollup");
+
+    if (!(fp = fopen(name, "r"))) {
+        (void)SIGAR_PROC_FILENAME(name, pid, "/smaps");
+        if (!(fp = fopen(name, "r"))) {
+            return (errno == ENOENT) ? ESRCH : errno;
+        }
+    }
+
+    SIGAR_ZERO(procmemext);
+
+    while (fgets(line, sizeof(line), fp)) {
+        proc_smaps_line(line, procmemext);
+    }
+
+    fclose(fp);
+
+    procmemext->file = (procmemext->rss > procmemext->anon) ?
+        procmemext->rss - procmemext->anon : 0;
+
+    return SIGAR_OK;
+}
+
+static sigar_uint64_t keyval_strtoull(sigar_keyval_t *kv)
+{
+    char *ptr = kv->value;
+
+    if (!ptr) {
+        return SIGAR_FIELD_NOTIMPL;
+    }
+    return sigar_strtoull(ptr);
+}
+
+int sigar_proc_cumulative_disk_io_get(sigar_t *sigar, sigar_pid_t pid,
+                           sigar_proc_cumulative_disk_io_t *proc_cumulative_disk_io)
+{
+    char *buffer;
+    sigar_keyval_t keys[] = {
+        SIGAR_KEYVAL("read_bytes:"),
+        SIGAR_KEYVAL("write_bytes:")
+    };
+    int status = proc_file_read(sigar, pid, PROC_PIN_IO, &buffer);
     
-    status = SIGAR_PROC_FILE2STR(buffer, pid, "/statm");
+    if (status != SIGAR_OK) {
+        return status;
+    }
+
+    sigar_keyval_scan(buffer, keys, 2);
+
+    proc_cumulative_disk_io->bytes_read = keyval_strtoull(&keys[0]);
+    proc_cumulative_disk_io->bytes_written = keyval_strtoull(&keys[1]);
+    proc_cumulative_disk_io->bytes_total = proc_cumulative_disk_io->bytes_read + proc_cumulative_disk_io->bytes_written;
+
+    return SIGAR_OK;
+}
+
+#define NO_ID_MSG "[proc_cred] /proc/%lu" PROC_PSTATUS " missing "
+
+int sigar_proc_cred_get(sigar_t *sigar, sigar_pid_t pid,
+                        sigar_proc_cred_t *proccred)
+{
+    char *buffer, *ptr;
+    sigar_keyval_t keys[] = {
+        SIGAR_KEYVAL("Uid:"),
+        SIGAR_KEYVAL("Gid:")
+    };
+    int status = proc_file_read(sigar, pid, PROC_PIN_STATUS, &buffer);
+
+    if (status != SIGAR_OK) {
+        return status;
+    }
+
+    sigar_keyval_scan(buffer, keys, 2);
+
+    if ((ptr = keys[0].value)) {
+        proccred->uid  = sigar_strtoul(ptr);
+        proccred->euid = sigar_strtoul(ptr);
+    }
+    else {
+        sigar_log_printf(sigar, SIGAR_LOG_WARN,
+                         NO_ID_MSG "Uid", pid);
+        return ENOENT;
+    }
+
+    if ((ptr = keys[1].value)) {
+
+        proccred->gid  = sigar_strtoul(ptr);
+        proccred->egid = sigar_strtoul(ptr);
+    }
+    else {
+        sigar_log_printf(sigar, SIGAR_LOG_WARN,
+                         NO_ID_MSG "Gid", pid);
+        return ENOENT;
+    }
+
+    return SIGAR_OK;
+}
+
+int sigar_proc_time_get(sigar_t *sigar, sigar_pid_t pid,
+                        sigar_proc_time_t *proctime)
+{
+    linux_proc_stat_t *pstat;
+    int status = linux_taskstats_proc_time_get(sigar, pid, proctime);
+
+    if (status != SIGAR_ENOTIMPL) {
+        return status;
+    }
+
+    status = proc_stat_read(sigar, pid, &pstat);
+
+    if (status != SIGAR_OK) {
+        return status;
+    }
+
+    proc_stat_time_copy(pstat, proctime);
+
+    return SIGAR_OK;
+}
+
+static int proc_status_get(sigar_t *sigar, sigar_pid_t pid,
+                           sigar_proc_state_t *procstate)
+{
+    char *buffer;
+    sigar_keyval_t keys[] = {
+        SIGAR_KEYVAL("Threads:") /* 2.6+ kernel only */
+    };
+    int status = proc_file_read(sigar, pid, PROC_PIN_STATUS, &buffer);
 
     if (status != SIGAR_OK) {
         return status;
     }
 
-    procmem->size     = pageshift(sigar_strtoull(ptr));
-    procmem->resident = pageshift(sigar_strtoull(ptr));
-    procmem->share    = pageshift(sigar_strtoull(ptr));
+    sigar_keyval_scan(buffer, keys, 1);
+
+    procstate->threads = keyval_strtoull(&keys[0]);
 
     return SIGAR_OK;
 }
 
-SIGAR_INLINE sigar_uint64_t get_named_proc_token(char *buffer,
-                                                 char *token) {
-  char *ptr = strstr(buffer, token);
-  if (!ptr) {
-    return SIGAR_FIELD_NOTIMPL;
-  }
-  ptr = sigar_skip_token(ptr);
-  return sigar_strtoul(ptr);
+/* everything but the thread count is in stat */
+int sigar_proc_state_get_ex(sigar_t *sigar, sigar_pid_t pid, int fields,
+                            sigar_proc_state_t *procstate)
+{
+    int status;
+
+    if (fields & ~SIGAR_PROC_STATE_F_THREADS) {
+        linux_proc_stat_t *pstat;
+
+        if ((status = proc_stat_read(sigar, pid, &pstat)) != SIGAR_OK) {
+            return status;
+        }
+
+        proc_stat_state_copy(sigar, pstat, procstate);
+    }
+
+    if (fields & SIGAR_PROC_STATE_F_THREADS) {
+        status = proc_status_get(sigar, pid, procstate);
+
+        if (status != SIGAR_OK) {
+            if (fields == SIGAR_PROC_STATE_F_THREADS) {
+                return status;
+            }
+            procstate->threads = SIGAR_FIELD_NOTIMPL;
+        }
+    }
+
+    return SIGAR_OK;
 }
 
-int sigar_proc_cumulative_disk_io_get(sigar_t *sigar, sigar_pid_t pid,
-                           sigar_proc_cumulative_disk_io_t *proc_cumulative_disk_io)
+int sigar_proc_state_get(sigar_t *sigar, sigar_pid_t pid,
+                         sigar_proc_state_t *procstate)
 {
-    char buffer[BUFSIZ];
-    
-    int status = SIGAR_PROC_FILE2STR(buffer, pid, "/io");
-    
-    if (status != SIGAR_OK) {
-        return status;
+    return sigar_proc_state_get_ex(sigar, pid, SIGAR_PROC_STATE_F_ALL,
+                                   procstate);
+}
+
+/* cpu times only, one batched taskstats round trip for every pid */
+static int proc_snapshot_taskstats(sigar_t *sigar, sigar_proc_list_t *pids,
+                                   sigar_proc_snapshot_t *snapshot)
+{
+    sigar_proc_time_t *times = malloc(sizeof(*times) * pids->number);
+    int *statuses = malloc(sizeof(*statuses) * pids->number);
+    unsigned long i;
+    int status;
+
+    if (!times || !statuses) {
+        free(times);
+        free(statuses);
+        return ENOMEM;
     }
 
-    proc_cumulative_disk_io->bytes_read = get_named_proc_token(buffer, "\nread_bytes");
-    proc_cumulative_disk_io->bytes_written = get_named_proc_token(buffer, "\nwrite_bytes");
-    proc_cumulative_disk_io->bytes_total = proc_cumulative_disk_io->bytes_read + proc_cumulative_disk_io->bytes_written;
+    status = linux_taskstats_proc_time_list(sigar, pids->data, pids->number,
+                                            times, statuses);
 
-    return SIGAR_OK;
+    for (i=0; (status == SIGAR_OK) && (i<pids->number); i++) {
+        sigar_proc_snapshot_entry_t *entry;
+
+        if (statuses[i] != SIGAR_OK) {
+            continue; /* exited since the readdir */
+        }
+
+        SIGAR_PROC_SNAPSHOT_GROW(snapshot);
+        entry = &snapshot->data[snapshot->number++];
+        entry->pid = pids->data[i];
+        entry->flags = SIGAR_PROC_SNAPSHOT_TIME;
+        memcpy(&entry->cpu, &times[i], sizeof(times[i]));
+    }
+
+    free(times);
+    free(statuses);
+
+    return status;
 }
 
-#define NO_ID_MSG "[proc_cred] /proc/%lu" PROC_PSTATUS " missing "
+int sigar_os_proc_snapshot_entry_get(sigar_t *sigar, int flags,
+                                     sigar_proc_snapshot_entry_t *entry)
+{
+    linux_proc_stat_t *pstat;
+    sigar_pid_t pid = entry->pid;
+    int status;
 
-int sigar_proc_cred_get(sigar_t *sigar, sigar_pid_t pid,
-                        sigar_proc_cred_t *proccred)
+    /*
+     * one parse of stat per pid, statm and status only if asked.
+     * never the cached one: a pass sooner than proc_cache_expire after
+     * the last would see the same times and a cpu percent of 0
+     */
+    if ((status = proc_stat_read_age(sigar, pid, 0, &pstat)) != SIGAR_OK) {
+        return status; /* exited since the readdir */
+    }
+
+    entry->flags = 0;
+
+    if (flags & SIGAR_PROC_SNAPSHOT_STATE) {
+        proc_stat_state_copy(sigar, pstat, &entry->state);
+        if (!(SIGAR_PROC_SNAPSHOT_STATE_FIELDS_OF(flags) &
+              SIGAR_PROC_STATE_F_THREADS) ||
+            (proc_status_get(sigar, pid, &entry->state) != SIGAR_OK))
+        {
+            entry->state.threads = SIGAR_FIELD_NOTIMPL;
+        }
+        entry->flags |= SIGAR_PROC_SNAPSHOT_STATE;
+    }
+
+    if (flags & SIGAR_PROC_SNAPSHOT_MEM) {
+        proc_stat_mem_copy(pstat, &entry->mem);
+        if (!(SIGAR_PROC_SNAPSHOT_MEM_FIELDS_OF(flags) & PROC_MEM_F_STATM)) {
+            entry->mem.size = entry->mem.resident = entry->mem.share =
+                SIGAR_FIELD_NOTIMPL;
+            entry->flags |= SIGAR_PROC_SNAPSHOT_MEM;
+        }
+        else if (proc_statm_read(sigar, pid, &entry->mem) == SIGAR_OK) {
+            entry->flags |= SIGAR_PROC_SNAPSHOT_MEM;
+        }
+    }
+
+    if (flags & SIGAR_PROC_SNAPSHOT_TIME) {
+        proc_stat_time_copy(pstat, (sigar_proc_time_t *)&entry->cpu);
+        entry->flags |= SIGAR_PROC_SNAPSHOT_TIME;
+    }
+
+    if (flags & SIGAR_PROC_SNAPSHOT_CGROUP) {
+        sigar_proc_cgroup_t cgroup;
+
+        if (sigar_proc_cgroup_get(sigar, pid, &cgroup) == SIGAR_OK) {
+            entry->cgroup = cgroup.id;
+            entry->flags |= SIGAR_PROC_SNAPSHOT_CGROUP;
+        }
+    }
+
+    if ((flags & SIGAR_PROC_SNAPSHOT_MEM_EXT) &&
+        (sigar_proc_mem_ext_get(sigar, pid, &entry->mem_ext) == SIGAR_OK))
+    {
+        entry->flags |= SIGAR_PROC_SNAPSHOT_MEM_EXT;
+    }
+
+    if ((flags & SIGAR_PROC_SNAPSHOT_NET_IO) &&
+        (sigar_proc_net_io_get(sigar, pid, &entry->net_io) == SIGAR_OK))
+    {
+        entry->flags |= SIGAR_PROC_SNAPSHOT_NET_IO;
+    }
+
+    if ((flags & SIGAR_PROC_SNAPSHOT_DISK_IO) &&
+        (sigar_proc_cumulative_disk_io_get(sigar, pid,
+                                           &entry->disk_io) == SIGAR_OK))
+    {
+        entry->flags |= SIGAR_PROC_SNAPSHOT_DISK_IO;
+    }
+
+    if ((flags & SIGAR_PROC_SNAPSHOT_SCHED) &&
+        (sigar_proc_sched_get(sigar, pid, &entry->sched) == SIGAR_OK))
+    {
+        entry->flags |= SIGAR_PROC_SNAPSHOT_SCHED;
+    }
+
+    /* nothing asked for could be read, as if it had gone */
+    return entry->flags ? SIGAR_OK : ESRCH;
+}
+
+/*
+ * queues the files sigar_os_proc_snapshot_entry_get will read for the
+ * pids from start on, as many whole pids as fit in one ring batch,
+ * and returns the index of the first pid left out
+ */
+static unsigned long proc_snapshot_read_ahead(sigar_t *sigar,
+                                              sigar_proc_list_t *pids,
+                                              unsigned long start,
+                                              int flags)
 {
-    char buffer[BUFSIZ], *ptr;
-    int status = SIGAR_PROC_FILE2STR(buffer, pid, PROC_PSTATUS);
+    int files[PROC_PIN_MAX], nfiles = 0, n = 0, j;
+    unsigned long i;
 
-    if (status != SIGAR_OK) {
+    sigar->proc_reads_number = sigar->proc_reads_cursor = 0;
+
+    if (!sigar->proc_reads &&
+        !(sigar->proc_reads =
+          malloc(sizeof(*sigar->proc_reads) * LINUX_URING_BATCH)))
+    {
+        return pids->number;
+    }
+
+    files[nfiles++] = PROC_PIN_STAT;
+    if ((flags & SIGAR_PROC_SNAPSHOT_STATE) &&
+        (SIGAR_PROC_SNAPSHOT_STATE_FIELDS_OF(flags) &
+         SIGAR_PROC_STATE_F_THREADS))
+    {
+        files[nfiles++] = PROC_PIN_STATUS;
+    }
+    if ((flags & SIGAR_PROC_SNAPSHOT_MEM) &&
+        (SIGAR_PROC_SNAPSHOT_MEM_FIELDS_OF(flags) & PROC_MEM_F_STATM))
+    {
+        files[nfiles++] = PROC_PIN_STATM;
+    }
+    if (flags & SIGAR_PROC_SNAPSHOT_DISK_IO) {
+        files[nfiles++] = PROC_PIN_IO;
+    }
+
+    for (i=start;
+         (i<pids->number) && ((n + nfiles) <= LINUX_URING_BATCH);
+         i++)
+    {
+        sigar_pid_t pid = pids->data[i];
+
+        if (proc_pin_find(sigar, pid)) {
+            continue; /* reads through its own fds */
+        }
+
+        for (j=0; j<nfiles; j++) {
+            linux_proc_read_t *file = &sigar->proc_reads[n];
+
+            file->pid = pid;
+            file->which = files[j];
+            proc_file_path(file->path, pid, files[j]);
+            n++;
+        }
+    }
+
+    if (n && (linux_uring_read(sigar, sigar->proc_reads, n) == SIGAR_OK)) {
+        sigar->proc_reads_number = n;
+    }
+
+    return i;
+}
+
+int sigar_os_proc_snapshot_get(sigar_t *sigar, int flags,
+                               sigar_proc_snapshot_t *snapshot)
+{
+    sigar_proc_list_t *pids;
+    unsigned long i, ahead = 0;
+    int status, read_ahead;
+
+    if ((status = sigar_proc_list_get(sigar, NULL)) != SIGAR_OK) {
         return status;
     }
 
-    if ((ptr = strstr(buffer, "\nUid:"))) {
-        ptr = sigar_skip_token(ptr);
+    pids = sigar->pids;
 
-        proccred->uid  = sigar_strtoul(ptr);
-        proccred->euid = sigar_strtoul(ptr);
+    if (!(flags & (SIGAR_PROC_SNAPSHOT_STATE|SIGAR_PROC_SNAPSHOT_MEM|
+                   SIGAR_PROC_SNAPSHOT_CGROUP|SIGAR_PROC_SNAPSHOT_MEM_EXT|
+                   SIGAR_PROC_SNAPSHOT_NET_IO|SIGAR_PROC_SNAPSHOT_DISK_IO|
+                   SIGAR_PROC_SNAPSHOT_SCHED)) &&
+        (proc_snapshot_taskstats(sigar, pids, snapshot) == SIGAR_OK))
+    {
+        return SIGAR_OK;
     }
-    else {
-        sigar_log_printf(sigar, SIGAR_LOG_WARN,
-                         NO_ID_MSG "Uid", pid);
-        return ENOENT;
+
+    if (flags & SIGAR_PROC_SNAPSHOT_NET_IO) {
+        /* every socket in one dump rather than one per pid */
+        sigar->sock_diag_bytes = sigar_cache_new(SIGAR_PROC_LIST_MAX);
+        if (linux_sock_diag_tcp_bytes(sigar,
+                                      sigar->sock_diag_bytes) != SIGAR_OK)
+        {
+            flags &= ~SIGAR_PROC_SNAPSHOT_NET_IO;
+        }
     }
 
-    if ((ptr = strstr(ptr, "\nGid:"))) {
-        ptr = sigar_skip_token(ptr);
+    read_ahead = (proc_dir_open(sigar) >= 0) &&
+        (linux_uring_open(sigar) == SIGAR_OK);
 
-        proccred->gid  = sigar_strtoul(ptr);
-        proccred->egid = sigar_strtoul(ptr);
+    for (i=0; i<pids->number; i++) {
+        sigar_proc_snapshot_entry_t *entry;
+
+        if (read_ahead && (i == ahead)) {
+            ahead = proc_snapshot_read_ahead(sigar, pids, i, flags);
+        }
+
+        SIGAR_PROC_SNAPSHOT_GROW(snapshot);
+        entry = &snapshot->data[snapshot->number];
+        entry->pid = pids->data[i];
+
+        if (sigar_os_proc_snapshot_entry_get(sigar, flags,
+                                             entry) == SIGAR_OK)
+        {
+            snapshot->number++;
+        }
+    }
+    sigar->proc_reads_number = 0;
+
+    if (sigar->sock_diag_bytes) {
+        sigar_cache_destroy(sigar->sock_diag_bytes);
+        sigar->sock_diag_bytes = NULL;
+    }
+
+    return SIGAR_OK;
+}
+
+#define PROC_ATTR_ARGS 0x01
+#define PROC_ATTR_EXE  0x02
+
+static void proc_attr_unlink(linux_proc_attr_t *attr)
+{
+    attr->prev->next = attr->next;
+    attr->next->prev = attr->prev;
+}
+
+static void proc_attr_free(void *ptr)
+{
+    linux_proc_attr_t *attr = (linux_proc_attr_t *)ptr;
+
+    proc_attr_unlink(attr);
+    *attr->bytes_total -= attr->bytes;
+    if (attr->args) {
+        free(attr->args);
+    }
+    if (attr->name) {
+        free(attr->name);
+    }
+    if (attr->root) {
+        free(attr->root);
+    }
+    free(attr);
+}
+
+static void proc_stat_expire(sigar_cache_entry_t *entry, void *data)
+{
+    ((linux_proc_stat_t *)entry->value)->mtime = 0;
+}
+
+void sigar_os_proc_attr_forget(sigar_t *sigar, sigar_pid_t pid)
+{
+    /* exited or exec'd, the next getter reads its stat afresh */
+    if (sigar->proc_stat) {
+        if (pid == -1) {
+            sigar_cache_walk(sigar->proc_stat, proc_stat_expire, NULL);
+        }
+        else {
+            sigar_cache_remove(sigar->proc_stat, pid);
+        }
+    }
+    if (!sigar->proc_attr) {
+        return;
+    }
+    if (pid == -1) {
+        sigar_cache_destroy(sigar->proc_attr);
+        sigar->proc_attr = NULL;
     }
     else {
-        sigar_log_printf(sigar, SIGAR_LOG_WARN,
-                         NO_ID_MSG "Gid", pid);
-        return ENOENT;
+        sigar_cache_remove(sigar->proc_attr, pid);
     }
+}
 
+int sigar_proc_attr_cache_set(sigar_t *sigar, sigar_uint64_t max_bytes)
+{
+    sigar->proc_attr_max = max_bytes;
+    sigar_os_proc_attr_forget(sigar, -1);
     return SIGAR_OK;
 }
 
-int sigar_proc_time_get(sigar_t *sigar, sigar_pid_t pid,
-                        sigar_proc_time_t *proctime)
+/*
+ * the entry for pid, emptied if it held another task or program.
+ * exec keeps the pid and start time, without events to say so the
+ * binary it runs is what tells.  NULL when not caching.
+ */
+static linux_proc_attr_t *proc_attr_get(sigar_t *sigar, sigar_pid_t pid)
 {
-    int status = proc_stat_read(sigar, pid);
-    linux_proc_stat_t *pstat = &sigar->last_proc_stat;
+    sigar_cache_entry_t *entry;
+    linux_proc_attr_t *attr, *lru = &sigar->proc_attr_lru;
+    linux_proc_stat_t *pstat;
+    sigar_uint64_t ino = 0, dev = 0;
 
-    if (status != SIGAR_OK) {
+    if (!sigar->proc_attr_max ||
+        (proc_stat_read(sigar, pid, &pstat) != SIGAR_OK))
+    {
+        return NULL;
+    }
+
+    if (!sigar->proc_attr) {
+        sigar->proc_attr = sigar_cache_new(SIGAR_PROC_LIST_MAX);
+        sigar->proc_attr->free_value = proc_attr_free;
+    }
+
+    if (!sigar->proc_events) {
+        char name[BUFSIZ];
+        struct stat sb;
+
+        (void)SIGAR_PROC_FILENAME(name, pid, "/exe");
+        if (stat(name, &sb) == 0) {
+            ino = sb.st_ino;
+            dev = sb.st_dev;
+        }
+    }
+
+    entry = sigar_cache_find(sigar->proc_attr, pid);
+    if (entry && (attr = entry->value)) {
+        if ((attr->start_time == pstat->start_time) &&
+            (attr->exe_ino == ino) && (attr->exe_dev == dev))
+        {
+            proc_attr_unlink(attr);
+            attr->next = lru->next;
+            attr->prev = lru;
+            lru->next->prev = attr;
+            lru->next = attr;
+            return attr;
+        }
+        sigar_cache_remove(sigar->proc_attr, pid);
+    }
+
+    if (!(attr = calloc(1, sizeof(*attr)))) {
+        return NULL;
+    }
+    attr->bytes_total = &sigar->proc_attr_bytes;
+    attr->pid = pid;
+    attr->start_time = pstat->start_time;
+    attr->exe_ino = ino;
+    attr->exe_dev = dev;
+    attr->bytes = sizeof(*attr);
+    sigar->proc_attr_bytes += attr->bytes;
+
+    attr->next = lru->next;
+    attr->prev = lru;
+    lru->next->prev = attr;
+    lru->next = attr;
+
+    sigar_cache_get(sigar->proc_attr, pid)->value = attr;
+
+    return attr;
+}
+
+/*
+ * counts bytes more against the bound, dropping the least recent,
+ * attr too if it alone is over.  attr may be gone on return.
+ */
+static void proc_attr_grown(sigar_t *sigar, linux_proc_attr_t *attr,
+                            sigar_uint64_t bytes)
+{
+    linux_proc_attr_t *lru = &sigar->proc_attr_lru;
+
+    attr->bytes += bytes;
+    sigar->proc_attr_bytes += bytes;
+
+    while ((sigar->proc_attr_bytes > sigar->proc_attr_max) &&
+           (lru->prev != lru))
+    {
+        sigar_cache_remove(sigar->proc_attr, lru->prev->pid);
+    }
+}
+
+int sigar_os_proc_args_get(sigar_t *sigar, sigar_pid_t pid,
+                           sigar_proc_args_t *procargs)
+{
+    linux_proc_attr_t *attr = proc_attr_get(sigar, pid);
+    unsigned long i;
+    size_t len = 0;
+    char *ptr;
+    int status;
+
+    if (attr && (attr->flags & PROC_ATTR_ARGS)) {
+        for (i=0, ptr=attr->args; i<attr->argc; i++) {
+            SIGAR_PROC_ARGS_GROW(procargs);
+            procargs->data[procargs->number++] = sigar_strdup(ptr);
+            ptr += strlen(ptr) + 1;
+        }
+        return SIGAR_OK;
+    }
+
+    status = sigar_procfs_args_get(sigar, pid, procargs);
+
+    if ((status != SIGAR_OK) || !attr) {
         return status;
     }
 
-    proctime->user = pstat->utime;
-    proctime->sys  = pstat->stime;
-    proctime->total = proctime->user + proctime->sys;
-    proctime->start_time = pstat->start_time;
+    for (i=0; i<procargs->number; i++) {
+        len += strlen(procargs->data[i]) + 1;
+    }
+    if (!(attr->args = malloc(len ? len : 1))) {
+        return SIGAR_OK;
+    }
+    for (i=0, ptr=attr->args; i<procargs->number; i++) {
+        size_t n = strlen(procargs->data[i]) + 1;
+        memcpy(ptr, procargs->data[i], n);
+        ptr += n;
+    }
+    attr->argc = procargs->number;
+    attr->flags |= PROC_ATTR_ARGS;
+    proc_attr_grown(sigar, attr, len);
+
+    return SIGAR_OK;
+}
+
+static int proc_env_entry(void *data, char *entry, int len)
+{
+    sigar_proc_env_t *procenv = (sigar_proc_env_t *)data;
+    char *val;
+    int klen, status;
+
+    if (procenv->type == SIGAR_PROC_ENV_KEY) {
+        /* skip without looking for '=' unless the key matches */
+        if ((len <= procenv->klen) ||
+            (entry[procenv->klen] != '=') ||
+            memcmp(entry, procenv->key, procenv->klen))
+        {
+            return SIGAR_OK;
+        }
+        val = entry + procenv->klen;
+    }
+    else if (!(val = memchr(entry, '=', len))) {
+        /* not key=val format */
+        return !SIGAR_OK;
+    }
+
+    klen = val - entry;
+    *val++ = '\0';
+
+    status = procenv->env_getter(procenv->data,
+                                 entry, klen, val, len - klen - 1);
+
+    if (procenv->type == SIGAR_PROC_ENV_KEY) {
+        /* found it, the rest of environ is never read */
+        return !SIGAR_OK;
+    }
+
+    return status;
+}
+
+int sigar_proc_env_get(sigar_t *sigar, sigar_pid_t pid,
+                       sigar_proc_env_t *procenv)
+{
+    char name[BUFSIZ];
+
+    /* optimize if pid == $$ and type == ENV_KEY */
+    SIGAR_PROC_ENV_KEY_LOOKUP();
+
+    (void)SIGAR_PROC_FILENAME(name, pid, "/environ");
+
+    return sigar_procfs_entries_get(sigar, name, '\0',
+                                    proc_env_entry, procenv);
+}
+
+/* the kernel's getdents64 record, glibc has no wrapper before 2.30 */
+struct linux_dirent64 {
+    sigar_uint64_t d_ino;
+    sigar_int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[1];
+};
 
-    return SIGAR_OK;
-}
+/* big enough for ~20k fds per syscall instead of readdir's 32k bytes */
+#define PROC_FD_BUFSIZE (512 * 1024)
 
-static int proc_status_get(sigar_t *sigar, sigar_pid_t pid,
-                           sigar_proc_state_t *procstate)
+static int proc_fd_getdents_count(sigar_t *sigar, const char *name,
+                                  sigar_uint64_t *total)
 {
-    char buffer[BUFSIZ], *ptr;
-    int status = SIGAR_PROC_FILE2STR(buffer, pid, PROC_PSTATUS);
+    int fd, status = SIGAR_OK;
+    long nread;
 
-    if (status != SIGAR_OK) {
-        return status;
+    if (!sigar->proc_fd_buf &&
+        !(sigar->proc_fd_buf = malloc(PROC_FD_BUFSIZE)))
+    {
+        return ENOMEM;
     }
 
-    ptr = strstr(buffer, "\nThreads:");
-    if (ptr) {
-        /* 2.6+ kernel only */
-        ptr = sigar_skip_token(ptr);
-        procstate->threads = sigar_strtoul(ptr);
+    if ((fd = open(name, O_RDONLY|O_DIRECTORY)) < 0) {
+        return (errno == ENOENT) ? ESRCH : errno;
     }
-    else {
-        procstate->threads = SIGAR_FIELD_NOTIMPL;
-    }
-
-    return SIGAR_OK;
-}
 
-int sigar_proc_state_get(sigar_t *sigar, sigar_pid_t pid,
-                         sigar_proc_state_t *procstate)
-{
-    int status = proc_stat_read(sigar, pid);
-    linux_proc_stat_t *pstat = &sigar->last_proc_stat;
+    *total = 0;
 
-    if (status != SIGAR_OK) {
-        return status;
-    }
+    while ((nread = syscall(SYS_getdents64, fd,
+                            sigar->proc_fd_buf, PROC_FD_BUFSIZE)) > 0)
+    {
+        long pos = 0;
 
-    memcpy(procstate->name, pstat->name, sizeof(procstate->name));
-    procstate->state = pstat->state;
+        while (pos < nread) {
+            struct linux_dirent64 *ent =
+                (struct linux_dirent64 *)(sigar->proc_fd_buf + pos);
 
-    procstate->ppid     = pstat->ppid;
-    procstate->tty      = pstat->tty;
-    procstate->priority = pstat->priority;
-    procstate->nice     = pstat->nice;
-    procstate->processor = pstat->processor;
+            if (sigar_isdigit(*ent->d_name)) {
+                (*total)++;
+            }
+            pos += ent->d_reclen;
+        }
+    }
 
-    if (sigar_cpu_core_rollup(sigar)) {
-        procstate->processor /= sigar->lcpu;
+    if (nread < 0) {
+        status = errno;
     }
 
-    proc_status_get(sigar, pid, procstate);
+    close(fd);
 
-    return SIGAR_OK;
+    return status;
 }
 
-int sigar_os_proc_args_get(sigar_t *sigar, sigar_pid_t pid,
-                           sigar_proc_args_t *procargs)
+int sigar_proc_fd_get(sigar_t *sigar, sigar_pid_t pid,
+                      sigar_proc_fd_t *procfd)
 {
-    return sigar_procfs_args_get(sigar, pid, procargs);
+    char name[BUFSIZ];
+    struct stat sb;
+
+    (void)SIGAR_PROC_FILENAME(name, pid, "/fd");
+
+    if (linux_proc_fd_stat(sigar)) {
+        if (stat(name, &sb) != 0) {
+            return (errno == ENOENT) ? ESRCH : errno;
+        }
+        procfd->total = sb.st_size;
+        return SIGAR_OK;
+    }
+
+    return proc_fd_getdents_count(sigar, name, &procfd->total);
 }
 
-/* glibc 2.8 XXX use sysconf(_SC_ARG_MAX) */
-#ifndef ARG_MAX
-#define ARG_MAX 131072
-#endif
+#define PROC_SOCKET_LINK "socket:["
 
-int sigar_proc_env_get(sigar_t *sigar, sigar_pid_t pid,
-                       sigar_proc_env_t *procenv)
+/* byte counters of the tcp sockets among the open fds of pid */
+static int proc_net_io_sum(sigar_t *sigar, sigar_pid_t pid,
+                           sigar_cache_t *bytes,
+                           sigar_proc_net_io_t *procnetio)
 {
-    int fd;
-    char buffer[ARG_MAX]; /* XXX: ARG_MAX == 130k */
     char name[BUFSIZ];
-    size_t len;
-    char *ptr, *end;
-
-    /* optimize if pid == $$ and type == ENV_KEY */
-    SIGAR_PROC_ENV_KEY_LOOKUP();
+    DIR *dirp;
+    struct dirent *ent;
+    int fd;
 
-    (void)SIGAR_PROC_FILENAME(name, pid, "/environ");
+    (void)SIGAR_PROC_FILENAME(name, pid, "/fd");
 
-    if ((fd = open(name, O_RDONLY)) < 0) {
-        if (errno == ENOENT) {
-            return ESRCH;
-        }
+    if ((fd = open(name, O_RDONLY|O_DIRECTORY)) < 0) {
+        return (errno == ENOENT) ? ESRCH : errno;
+    }
+    if (!(dirp = fdopendir(fd))) {
+        close(fd);
         return errno;
     }
 
-    len = read(fd, buffer, sizeof(buffer));
-
-    close(fd);
-
-    buffer[len] = '\0';
-    ptr = buffer;
+    SIGAR_ZERO(procnetio);
 
-    end = buffer + len;
-    while (ptr < end) {
-        char *val = strchr(ptr, '=');
-        int klen, vlen, status;
-        char key[128]; /* XXX is there a max key size? */
+    while ((ent = readdir(dirp))) {
+        sigar_cache_entry_t *entry;
+        linux_sock_bytes_t *sb;
+        char link[64];
+        int len;
 
-        if (val == NULL) {
-            /* not key=val format */
-            break;
+        if (!sigar_isdigit(*ent->d_name)) {
+            continue;
         }
 
-        klen = val - ptr;
-        SIGAR_SSTRCPY(key, ptr);
-        key[klen] = '\0';
-        ++val;
-
-        vlen = strlen(val);
-        status = procenv->env_getter(procenv->data,
-                                     key, klen, val, vlen);
-
-        if (status != SIGAR_OK) {
-            /* not an error; just stop iterating */
-            break;
+        len = readlinkat(fd, ent->d_name, link, sizeof(link)-1);
+        if ((len <= SSTRLEN(PROC_SOCKET_LINK)) ||
+            !strnEQ(link, PROC_SOCKET_LINK, SSTRLEN(PROC_SOCKET_LINK)))
+        {
+            continue;
         }
+        link[len] = '\0';
 
-        ptr += (klen + 1 + vlen + 1);
+        entry = sigar_cache_find(bytes,
+                                 strtoull(link + SSTRLEN(PROC_SOCKET_LINK),
+                                          NULL, 10));
+        if (!entry) {
+            continue; /* not tcp, or opened after the dump */
+        }
+        sb = entry->value;
+        procnetio->bytes_sent += sb->sent;
+        procnetio->bytes_received += sb->received;
+        procnetio->sockets++;
     }
 
+    closedir(dirp);
+
+    procnetio->bytes_total =
+        procnetio->bytes_sent + procnetio->bytes_received;
+
     return SIGAR_OK;
 }
 
-int sigar_proc_fd_get(sigar_t *sigar, sigar_pid_t pid,
-                      sigar_proc_fd_t *procfd)
+int sigar_proc_net_io_get(sigar_t *sigar, sigar_pid_t pid,
+                          sigar_proc_net_io_t *procnetio)
 {
-    int status =
-        sigar_proc_fd_count(sigar, pid, &procfd->total);
+    sigar_cache_t *bytes;
+    int status;
+
+    if (sigar->sock_diag_bytes) {
+        /* dumped once by sigar_os_proc_snapshot_get */
+        return proc_net_io_sum(sigar, pid, sigar->sock_diag_bytes,
+                               procnetio);
+    }
+
+    bytes = sigar_cache_new(SIGAR_PROC_LIST_MAX);
+
+    status = linux_sock_diag_tcp_bytes(sigar, bytes);
+    if (status == SIGAR_OK) {
+        status = proc_net_io_sum(sigar, pid, bytes, procnetio);
+    }
+
+    sigar_cache_destroy(bytes);
 
     return status;
 }
@@ -986,6 +3154,7 @@ int sigar_proc_fd_get(sigar_t *sigar, sigar_pid_t pid,
 int sigar_proc_exe_get(sigar_t *sigar, sigar_pid_t pid,
                        sigar_proc_exe_t *procexe)
 {
+    linux_proc_attr_t *attr;
     int len;
     char name[BUFSIZ];
 
@@ -999,6 +3168,15 @@ int sigar_proc_exe_get(sigar_t *sigar, sigar_pid_t pid,
 
     procexe->cwd[len] = '\0';
 
+    /* cwd moves with chdir, the other two only with exec */
+    if ((attr = proc_attr_get(sigar, pid)) &&
+        (attr->flags & PROC_ATTR_EXE))
+    {
+        SIGAR_SSTRCPY(procexe->name, attr->name);
+        SIGAR_SSTRCPY(procexe->root, attr->root);
+        return SIGAR_OK;
+    }
+
     (void)SIGAR_PROC_FILENAME(name, pid, "/exe");
 
     if ((len = readlink(name, procexe->name,
@@ -1019,51 +3197,91 @@ int sigar_proc_exe_get(sigar_t *sigar, sigar_pid_t pid,
 
     procexe->root[len] = '\0';
 
+    if (attr && !attr->name &&
+        (attr->name = sigar_strdup(procexe->name)) &&
+        (attr->root = sigar_strdup(procexe->root)))
+    {
+        attr->flags |= PROC_ATTR_EXE;
+        proc_attr_grown(sigar, attr,
+                        strlen(attr->name) + strlen(attr->root) + 2);
+    }
+
     return SIGAR_OK;
 }
 
-int sigar_proc_modules_get(sigar_t *sigar, sigar_pid_t pid,
-                           sigar_proc_modules_t *procmods)
+typedef struct {
+    sigar_proc_modules_t *procmods;
+    sigar_cache_t *seen; /* inode -> dev + 1 of each module passed on */
+} proc_modules_walk_t;
+
+static void proc_modules_seen_free(void *ptr)
 {
-    FILE *fp;
-    char buffer[BUFSIZ], *ptr;
-    unsigned long inode, last_inode = 0;
+    /* values are devs, not allocations */
+}
 
-    (void)SIGAR_PROC_FILENAME(buffer, pid, "/maps");
+/*
+ * "start-end perms offset maj:min inode  path", a library shows up
+ * once per segment.  anonymous regions (inode 0) are dropped before
+ * the dev or path is looked at, every other file goes out once.
+ */
+static int proc_modules_line(void *data, char *line, int len)
+{
+    proc_modules_walk_t *walk = (proc_modules_walk_t *)data;
+    sigar_cache_entry_t *entry;
+    char *ptr, *dev, *end = line + len;
+    unsigned long inode;
+    sigar_uint64_t devno;
+
+    /* skip region, flags, offset */
+    dev = sigar_skip_multiple_token(line, 3);
+    SIGAR_SKIP_SPACE(dev);
+    ptr = sigar_skip_token(dev);
+    inode = sigar_strtoul(ptr);
+
+    if (inode == 0) {
+        return SIGAR_OK;
+    }
 
-    if (!(fp = fopen(buffer, "r"))) {
-        return errno;
+    devno = (strtoul(dev, &dev, 16) << 20);
+    if (*dev == ':') {
+        devno |= strtoul(dev + 1, NULL, 16);
     }
 
-    while ((ptr = fgets(buffer, sizeof(buffer), fp))) {
-        int len, status;
-        /* skip region, flags, offset, dev */
-        ptr = sigar_skip_multiple_token(ptr, 4);
-        inode = sigar_strtoul(ptr);
+    entry = sigar_cache_get(walk->seen, inode);
+    if (entry->value == (void *)(unsigned long)(devno + 1)) {
+        return SIGAR_OK; /* another segment of the same file */
+    }
+    entry->value = (void *)(unsigned long)(devno + 1);
 
-        if ((inode == 0) || (inode == last_inode)) {
-            last_inode = 0;
-            continue;
-        }
+    SIGAR_SKIP_SPACE(ptr);
+    if (ptr >= end) {
+        return SIGAR_OK;
+    }
 
-        last_inode = inode;
-        SIGAR_SKIP_SPACE(ptr);
-        len = strlen(ptr);
-        ptr[len-1] = '\0'; /* chop \n */
+    return walk->procmods->module_getter(walk->procmods->data,
+                                         ptr, end - ptr);
+}
 
-        status =
-            procmods->module_getter(procmods->data,
-                                    ptr, len-1);
+int sigar_proc_modules_get(sigar_t *sigar, sigar_pid_t pid,
+                           sigar_proc_modules_t *procmods)
+{
+    char name[BUFSIZ];
+    proc_modules_walk_t walk;
+    int status;
 
-        if (status != SIGAR_OK) {
-            /* not an error; just stop iterating */
-            break;
-        }
-    }
-    
-    fclose(fp);
+    (void)SIGAR_PROC_FILENAME(name, pid, "/maps");
 
-    return SIGAR_OK;
+    walk.procmods = procmods;
+    walk.seen = sigar_cache_new(128);
+    walk.seen->free_value = proc_modules_seen_free;
+
+    /* a module_getter that is done ends the read, see ptql Modules.* */
+    status = sigar_procfs_entries_get(sigar, name, '\n',
+                                      proc_modules_line, &walk);
+
+    sigar_cache_destroy(walk.seen);
+
+    return status;
 }
 
 int sigar_thread_cpu_get(sigar_t *sigar,
@@ -1085,6 +3303,64 @@ int sigar_thread_cpu_get(sigar_t *sigar,
     return SIGAR_OK;
 }
 
+/* one stat read per task, all through sigar->proc_buf */
+int sigar_os_proc_thread_list_get(sigar_t *sigar, sigar_pid_t pid,
+                                  sigar_proc_thread_list_t *threads)
+{
+    char name[BUFSIZ];
+    DIR *dirp;
+    struct dirent *ent;
+    linux_proc_stat_t pstat;
+
+    (void)SIGAR_PROC_FILENAME(name, pid, "/task");
+
+    if (!(dirp = opendir(name))) {
+        return (errno == ENOENT) ? ESRCH : errno;
+    }
+
+    while ((ent = readdir(dirp))) {
+        sigar_proc_thread_t *thread;
+        char path[UITOA_BUFFER_SIZE+8];
+        int fd, len = strlen(ent->d_name);
+
+        if (!sigar_isdigit(*ent->d_name) || (len > UITOA_BUFFER_SIZE)) {
+            continue;
+        }
+
+        memcpy(path, ent->d_name, len);
+        memcpy(path + len, PROC_PSTAT, sizeof(PROC_PSTAT));
+
+        SIGAR_INSTRUMENT_OPEN();
+        if ((fd = openat(dirfd(dirp), path, O_RDONLY)) < 0) {
+            continue; /* exited since the readdir */
+        }
+        if (proc_fd_read(sigar, fd) != SIGAR_OK) {
+            close(fd);
+            continue;
+        }
+        close(fd);
+
+        if (proc_stat_parse(sigar, sigar->proc_buf, &pstat) != SIGAR_OK) {
+            continue;
+        }
+
+        SIGAR_PROC_THREAD_LIST_GROW(threads);
+        thread = &threads->data[threads->number++];
+
+        thread->tid = strtoul(ent->d_name, NULL, 10);
+        thread->state = pstat.state;
+        thread->processor = pstat.processor;
+        if (sigar_cpu_core_rollup(sigar)) {
+            thread->processor /= sigar->lcpu;
+        }
+        proc_stat_time_copy(&pstat, (sigar_proc_time_t *)&thread->cpu);
+    }
+
+    closedir(dirp);
+
+    return SIGAR_OK;
+}
+
 #include <mntent.h>
 
 int sigar_os_fs_type_get(sigar_file_system_t *fsp)
@@ -1142,8 +3418,35 @@ int sigar_os_fs_type_get(sigar_file_system_t *fsp)
     return fsp->type;
 }
 
-int sigar_file_system_list_get(sigar_t *sigar,
-                               sigar_file_system_list_t *fslist)
+#define PROC_MOUNTINFO "self/mountinfo"
+
+/*
+ * the kernel flags mountinfo with POLLPRI|POLLERR once per change
+ * to the mount namespace, and a poll is enough to re-arm it.
+ * if it cannot be opened every call rereads the table.
+ */
+static int mounts_changed(sigar_t *sigar)
+{
+    struct pollfd pfd;
+
+    if (sigar->mounts_fd < 0) {
+        sigar->mounts_fd = PROCFS_OPEN(PROC_MOUNTINFO, O_RDONLY);
+        return 1;
+    }
+
+    pfd.fd = sigar->mounts_fd;
+    pfd.events = POLLPRI;
+    pfd.revents = 0;
+
+    if (poll(&pfd, 1, 0) < 0) {
+        return 1;
+    }
+
+    return (pfd.revents & (POLLPRI|POLLERR)) ? 1 : 0;
+}
+
+/* fs types are classified here, once per change */
+static int mounts_read(sigar_t *sigar, sigar_file_system_list_t *fslist)
 {
     struct mntent ent;
     char buf[1025]; /* buffer for strings within ent */
@@ -1154,7 +3457,10 @@ int sigar_file_system_list_get(sigar_t *sigar,
         return errno;
     }
 
-    sigar_file_system_list_create(fslist);
+    if (fslist->size == 0) {
+        sigar_file_system_list_create(fslist);
+    }
+    fslist->number = 0;
 
     while (getmntent_r(fp, &ent, buf, sizeof(buf))) {
         SIGAR_FILE_SYSTEM_LIST_GROW(fslist);
@@ -1174,13 +3480,49 @@ int sigar_file_system_list_get(sigar_t *sigar,
     return SIGAR_OK;
 }
 
+int sigar_file_system_list_get(sigar_t *sigar,
+                               sigar_file_system_list_t *fslist)
+{
+    sigar_file_system_list_t *mounts = &sigar->mounts;
+
+    if (mounts_changed(sigar) || (mounts->size == 0)) {
+        int status = mounts_read(sigar, mounts);
+
+        if (status != SIGAR_OK) {
+            sigar_file_system_list_destroy(sigar, mounts);
+            return status;
+        }
+    }
+
+    if (!SIGAR_LIST_PRESET(sigar, fslist)) {
+        fslist->size = 0;
+        fslist->data = NULL;
+    }
+    if (fslist->size < mounts->number || !fslist->data) {
+        fslist->size = mounts->number ? mounts->number : 1;
+        fslist->data = realloc(fslist->data,
+                               sizeof(*(fslist->data)) * fslist->size);
+    }
+    fslist->number = mounts->number;
+    memcpy(fslist->data, mounts->data,
+           sizeof(*(fslist->data)) * mounts->number);
+
+    return SIGAR_OK;
+}
+
 #define ST_MAJOR(sb) major((sb).st_rdev)
 #define ST_MINOR(sb) minor((sb).st_rdev)
 
+/* for caches whose values point into a list owned elsewhere */
+static void index_value_free(void *ptr)
+{
+}
+
 static int get_iostat_sys(sigar_t *sigar,
                           const char *dirname,
                           sigar_disk_usage_t *disk,
-                          sigar_iodev_t **iodev)
+                          sigar_iodev_t **iodev,
+                          sigar_disk_usage_t *device_usage)
 {
     char stat[1025], dev[1025];
     char *name, *ptr, *fsdev;
@@ -1221,7 +3563,134 @@ static int get_iostat_sys(sigar_t *sigar,
     disk->write_bytes = SIGAR_FIELD_NOTIMPL;
     disk->queue       = SIGAR_FIELD_NOTIMPL;
 
-    return SIGAR_OK;
+    return SIGAR_OK;
+}
+
+#define DISKSTATS_KEY(major, minor) \
+    (((sigar_uint64_t)(major) << 32) | (minor))
+
+/* reused while younger than this, e.g. one pass over every filesystem */
+#define DISKSTATS_EXPIRE 500
+
+#define DISKSTATS_FIELDS 11
+
+/* one pass over /proc/diskstats into sigar->diskstats */
+static int diskstats_read(sigar_t *sigar)
+{
+    sigar_disk_usage_list_t *disklist = &sigar->diskstats;
+    sigar_uint64_t timenow = sigar_time_now_millis();
+    char buffer[1025];
+    char *ptr;
+    unsigned long i;
+    FILE *fp;
+
+    if (sigar->diskstats_time &&
+        (timenow < sigar->diskstats_time + DISKSTATS_EXPIRE))
+    {
+        return SIGAR_OK;
+    }
+
+    if (!(fp = PROCFS_FOPEN(PROC_DISKSTATS))) {
+        return errno;
+    }
+
+    if (!disklist->size) {
+        sigar_disk_usage_list_create(disklist);
+    }
+    disklist->number = 0;
+
+    while ((ptr = fgets(buffer, sizeof(buffer), fp))) {
+        sigar_disk_usage_entry_t *entry;
+        sigar_disk_usage_t *disk;
+        sigar_uint64_t fields[DISKSTATS_FIELDS];
+        char *name, *end = ptr + strlen(ptr);
+        int num;
+
+        SIGAR_DISK_USAGE_LIST_GROW(disklist);
+        entry = &disklist->data[disklist->number];
+        disk = &entry->disk;
+        SIGAR_DISK_STATS_INIT(disk);
+
+        if (sigar_scan_columns(&ptr, end, fields, 2) != 2) {
+            continue;
+        }
+        entry->major = fields[0];
+        entry->minor = fields[1];
+
+        name = ptr = sigar_scan_blanks(ptr, end);
+        while ((ptr < end) && !sigar_isspace(*ptr)) {
+            ptr++;
+        }
+        if ((ptr == name) || (ptr == end)) {
+            continue;
+        }
+        *ptr++ = '\0';
+        SIGAR_SSTRCPY(entry->name, name);
+
+        num = sigar_scan_columns(&ptr, end, fields, DISKSTATS_FIELDS);
+
+        if (num == DISKSTATS_FIELDS) {
+            disk->reads       = fields[0];  /* reads issued */
+            disk->read_bytes  = fields[2];  /* sectors read */
+            disk->rtime       = fields[3];  /* millis spent reading */
+            disk->writes      = fields[4];  /* writes completed */
+            disk->write_bytes = fields[6];  /* sectors written */
+            disk->wtime       = fields[7];  /* millis spent writing */
+            disk->time        = fields[9];  /* millis spent doing I/Os */
+            disk->qtime       = fields[10]; /* weighted millis doing I/Os */
+        }
+        else if (num == 4) {
+            /* early 2.6 partitions: rio rsect wio wsect */
+            disk->reads       = fields[0];
+            disk->read_bytes  = fields[1];
+            disk->writes      = fields[2];
+            disk->write_bytes = fields[3];
+        }
+        else {
+            continue;
+        }
+
+        /* convert sectors to bytes (512 is fixed size in 2.6 kernels) */
+        disk->read_bytes  *= 512;
+        disk->write_bytes *= 512;
+
+        disklist->number++;
+    }
+
+    fclose(fp);
+
+    /* data may have moved, rebuild the (major, minor) index */
+    if (sigar->diskstats_index) {
+        sigar_cache_destroy(sigar->diskstats_index);
+    }
+    sigar->diskstats_index =
+        sigar_cache_create(disklist->size,
+                           SIGAR_CACHE_OPEN_ADDRESSING,
+                           SIGAR_FIELD_NOTIMPL, SIGAR_FIELD_NOTIMPL);
+    sigar->diskstats_index->free_value = index_value_free;
+
+    for (i=0; i<disklist->number; i++) {
+        sigar_disk_usage_entry_t *entry = &disklist->data[i];
+        sigar_cache_entry_t *ent =
+            sigar_cache_get(sigar->diskstats_index,
+                            DISKSTATS_KEY(entry->major, entry->minor));
+        ent->value = entry;
+    }
+
+    sigar->diskstats_time = timenow;
+
+    return SIGAR_OK;
+}
+
+static sigar_disk_usage_entry_t *diskstats_find(sigar_t *sigar,
+                                                unsigned long major,
+                                                unsigned long minor)
+{
+    sigar_cache_entry_t *ent =
+        sigar_cache_find(sigar->diskstats_index,
+                         DISKSTATS_KEY(major, minor));
+
+    return ent ? ent->value : NULL;
 }
 
 static int get_iostat_proc_dstat(sigar_t *sigar,
@@ -1230,11 +3699,9 @@ static int get_iostat_proc_dstat(sigar_t *sigar,
                                  sigar_iodev_t **iodev,
                                  sigar_disk_usage_t *device_usage)
 {
-    FILE *fp;
-    char buffer[1025];
-    char *ptr;
+    sigar_disk_usage_entry_t *entry;
     struct stat sb;
-    int status=ENOENT;
+    int status;
 
     SIGAR_DISK_STATS_INIT(device_usage);
 
@@ -1248,92 +3715,35 @@ static int get_iostat_proc_dstat(sigar_t *sigar,
 
     if (SIGAR_LOG_IS_DEBUG(sigar)) {
         sigar_log_printf(sigar, SIGAR_LOG_DEBUG,
-                         PROC_DISKSTATS " %s -> %s [%d,%d]",
+                         "diskstats %s -> %s [%d,%d]",
                          dirname, (*iodev)->name,
                          ST_MAJOR(sb), ST_MINOR(sb));
     }
 
-    if (!(fp = fopen(PROC_DISKSTATS, "r"))) {
-        return errno;
+    if ((status = diskstats_read(sigar)) != SIGAR_OK) {
+        return status;
     }
 
-    while ((ptr = fgets(buffer, sizeof(buffer), fp))) {
-        unsigned long major, minor;
-
-        major = sigar_strtoul(ptr);
-        minor = sigar_strtoul(ptr);
-
-        if ((major == ST_MAJOR(sb)) &&
-            ((minor == ST_MINOR(sb)) || (minor == 0)))
-        {
-            int num;
-            unsigned long
-                rio, rmerge, rsect, ruse,
-                wio, wmerge, wsect, wuse,
-                running, use, aveq;
-
-            ptr = sigar_skip_token(ptr); /* name */
-
-            num = sscanf(ptr,
-                         "%lu %lu %lu %lu "
-                         "%lu %lu %lu %lu "
-                         "%lu %lu %lu",
-                         &rio,     /* 1  # reads issued */
-                         &rmerge,  /* 2  # reads merged */
-                         &rsect,   /* 3  # sectors read */
-                         &ruse,    /* 4  # millis spent reading */
-                         &wio,     /* 5  # writes completed */
-                         &wmerge,  /* 6  # writes merged */
-                         &wsect,   /* 7  # sectors written */
-                         &wuse,    /* 8  # millis spent writing */
-                         &running, /* 9  # I/Os currently in progress */
-                         &use,     /* 10 # millis spent doing I/Os */
-                         &aveq);   /* 11 # of millis spent doing I/Os (weighted) */
-
-            if (num == 11) {
-                disk->rtime = ruse;
-                disk->wtime = wuse;
-                disk->time = use;
-                disk->qtime = aveq;
-            }
-            else if (num == 4) {
-                wio = rsect;
-                rsect = rmerge;
-                wsect = ruse;
-                disk->time = disk->qtime = SIGAR_FIELD_NOTIMPL;
-            }
-            else {
-                status = ENOENT;
-            }
-
-            disk->reads = rio;
-            disk->writes = wio;
-            disk->read_bytes  = rsect;
-            disk->write_bytes = wsect;
-
-            /* convert sectors to bytes (512 is fixed size in 2.6 kernels) */
-            disk->read_bytes  *= 512;
-            disk->write_bytes *= 512;
-
-            if (minor == ST_MINOR(sb)) {
-                status = SIGAR_OK;
-                break;
-            }
-            else if (minor == 0) {
-                memcpy(device_usage, disk, sizeof(*device_usage));
-            }
-        }
+    if (!(entry = diskstats_find(sigar, ST_MAJOR(sb), ST_MINOR(sb)))) {
+        return ENOENT;
     }
+    memcpy(disk, &entry->disk, sizeof(*disk));
 
-    fclose(fp);
+    /* whole disk, for 2.6 partitions without times */
+    if ((ST_MINOR(sb) != 0) &&
+        (entry = diskstats_find(sigar, ST_MAJOR(sb), 0)))
+    {
+        memcpy(device_usage, &entry->disk, sizeof(*device_usage));
+    }
 
-    return status;
+    return SIGAR_OK;
 }
 
 static int get_iostat_procp(sigar_t *sigar,
                             const char *dirname,
                             sigar_disk_usage_t *disk,
-                            sigar_iodev_t **iodev)
+                            sigar_iodev_t **iodev,
+                            sigar_disk_usage_t *device_usage)
 {
     FILE *fp;
     char buffer[1025];
@@ -1350,12 +3760,12 @@ static int get_iostat_procp(sigar_t *sigar,
 
     if (SIGAR_LOG_IS_DEBUG(sigar)) {
         sigar_log_printf(sigar, SIGAR_LOG_DEBUG,
-                         PROC_PARTITIONS " %s -> %s [%d,%d]",
+                         "partitions %s -> %s [%d,%d]",
                          dirname, (*iodev)->name,
                          ST_MAJOR(sb), ST_MINOR(sb));
     }
 
-    if (!(fp = fopen(PROC_PARTITIONS, "r"))) {
+    if (!(fp = PROCFS_FOPEN(PROC_PARTITIONS))) {
         return errno;
     }
 
@@ -1395,6 +3805,46 @@ static int get_iostat_procp(sigar_t *sigar,
     return ENOENT;
 }
 
+/* service_time and queue since prev, which becomes disk */
+static void disk_usage_delta(sigar_disk_usage_t *disk,
+                             sigar_disk_usage_t *prev,
+                             sigar_uint64_t snaptime)
+{
+    sigar_uint64_t interval, ios;
+    double tput, util;
+
+    disk->snaptime = snaptime;
+
+    if (prev->snaptime) {
+        interval = disk->snaptime - prev->snaptime;
+    }
+    else {
+        interval = disk->snaptime;
+    }
+
+    ios =
+        (disk->reads - prev->reads) +
+        (disk->writes - prev->writes);
+
+    if (disk->time == SIGAR_FIELD_NOTIMPL) {
+        disk->service_time = SIGAR_FIELD_NOTIMPL;
+    }
+    else {
+        tput = ((double)ios) * HZ / interval;
+        util = ((double)(disk->time - prev->time)) / interval * HZ;
+        disk->service_time = tput ? util / tput : 0.0;
+    }
+    if (disk->qtime == SIGAR_FIELD_NOTIMPL) {
+        disk->queue = SIGAR_FIELD_NOTIMPL;
+    }
+    else {
+        util = ((double)(disk->qtime - prev->qtime)) / interval;
+        disk->queue = util / 1000.0;
+    }
+
+    memcpy(prev, disk, sizeof(*prev));
+}
+
 int sigar_disk_usage_get(sigar_t *sigar, const char *name,
                          sigar_disk_usage_t *disk)
 {
@@ -1403,37 +3853,15 @@ int sigar_disk_usage_get(sigar_t *sigar, const char *name,
     sigar_disk_usage_t device_usage;
     SIGAR_DISK_STATS_INIT(disk);
 
-    /*
-     * 2.2 has metrics /proc/stat, but wtf is the device mapping?
-     * 2.4 has /proc/partitions w/ the metrics.
-     * 2.6 has /proc/partitions w/o the metrics.
-     *     instead the metrics are within the /proc-like /sys filesystem.
-     *     also has /proc/diskstats
-     */
-    switch (sigar->iostat) {
-      case IOSTAT_SYS:
-        status = get_iostat_sys(sigar, name, disk, &iodev);
-        break;
-      case IOSTAT_DISKSTATS:
-        status = get_iostat_proc_dstat(sigar, name, disk, &iodev, &device_usage);
-        break;
-      case IOSTAT_PARTITIONS:
-        status = get_iostat_procp(sigar, name, disk, &iodev);
-        break;
-      /*
-       * case IOSTAT_SOME_OTHER_WIERD_THING:
-       * break;
-       */
-      case IOSTAT_NONE:
-      default:
-        status = ENOENT;
-        break;
+    if (!sigar->backend.iostat_get) {
+        (void)linux_iostat(sigar);
     }
 
+    status = sigar->backend.iostat_get(sigar, name, disk,
+                                       &iodev, &device_usage);
+
     if ((status == SIGAR_OK) && iodev) {
         sigar_uptime_t uptime;
-        sigar_uint64_t interval, ios;
-        double tput, util;
         sigar_disk_usage_t *partition_usage=NULL;
 
         sigar_uptime_get(sigar, &uptime);
@@ -1446,36 +3874,8 @@ int sigar_disk_usage_get(sigar_t *sigar, const char *name,
             disk = &device_usage;
         }
 
-        disk->snaptime = uptime.uptime;
-
-        if (iodev->disk.snaptime) {
-            interval = disk->snaptime - iodev->disk.snaptime;
-        }
-        else {
-            interval = disk->snaptime;
-        }
-
-        ios =
-            (disk->reads - iodev->disk.reads) +
-            (disk->writes - iodev->disk.writes);
-
-        if (disk->time == SIGAR_FIELD_NOTIMPL) {
-            disk->service_time = SIGAR_FIELD_NOTIMPL;
-        }
-        else {
-            tput = ((double)ios) * HZ / interval;
-            util = ((double)(disk->time - iodev->disk.time)) / interval * HZ;
-            disk->service_time = tput ? util / tput : 0.0;
-        }
-        if (disk->qtime == SIGAR_FIELD_NOTIMPL) {
-            disk->queue = SIGAR_FIELD_NOTIMPL;
-        }
-        else {
-            util = ((double)(disk->qtime - iodev->disk.qtime)) / interval;
-            disk->queue = util / 1000.0;
-        }
+        disk_usage_delta(disk, &iodev->disk, uptime.uptime);
 
-        memcpy(&iodev->disk, disk, sizeof(iodev->disk));
         if (partition_usage) {
             partition_usage->service_time = disk->service_time;
             partition_usage->queue = disk->queue;
@@ -1485,6 +3885,57 @@ int sigar_disk_usage_get(sigar_t *sigar, const char *name,
     return status;
 }
 
+int sigar_disk_usage_list_get(sigar_t *sigar,
+                              sigar_disk_usage_list_t *disklist)
+{
+    sigar_disk_usage_list_t *snapshot = &sigar->diskstats;
+    sigar_uptime_t uptime;
+    unsigned long i;
+    int status;
+
+    if (sigar->replay) {
+        return sigar_replay_disk_usage_list_get(sigar, disklist);
+    }
+
+    if (linux_iostat(sigar) != IOSTAT_DISKSTATS) {
+        return SIGAR_ENOTIMPL;
+    }
+
+    sigar->diskstats_time = 0; /* always a fresh read */
+    if ((status = diskstats_read(sigar)) != SIGAR_OK) {
+        return status;
+    }
+
+    if (!sigar->diskstats_prev) {
+        sigar->diskstats_prev = sigar_cache_new(snapshot->size);
+    }
+
+    sigar_uptime_get(sigar, &uptime);
+
+    disklist->number = snapshot->number;
+    disklist->size = snapshot->number ? snapshot->number : 1;
+    disklist->data = malloc(sizeof(*(disklist->data)) * disklist->size);
+    memcpy(disklist->data, snapshot->data,
+           sizeof(*(disklist->data)) * disklist->number);
+
+    for (i=0; i<disklist->number; i++) {
+        sigar_disk_usage_entry_t *entry = &disklist->data[i];
+        sigar_cache_entry_t *ent =
+            sigar_cache_get(sigar->diskstats_prev,
+                            DISKSTATS_KEY(entry->major, entry->minor));
+
+        if (!ent->value) {
+            ent->value =
+                sigar_cache_value_new(sigar->diskstats_prev,
+                                      sizeof(sigar_disk_usage_t));
+        }
+
+        disk_usage_delta(&entry->disk, ent->value, uptime.uptime);
+    }
+
+    return SIGAR_OK;
+}
+
 int sigar_file_system_usage_get(sigar_t *sigar,
                                 const char *dirname,
                                 sigar_file_system_usage_t *fsusage)
@@ -1610,96 +4061,449 @@ static int get_cpu_info(sigar_t *sigar, sigar_cpu_info_t *info,
         }
     }
 
-    return found;
+    return found;
+}
+
+/* /proc/cpuinfo MHz will change w/ AMD + PowerNow */
+static void get_cpuinfo_max_freq(sigar_cpu_info_t *cpu_info, int num)
+{
+    int status;
+    char max_freq[PATH_MAX];
+    snprintf(max_freq, sizeof(max_freq),
+             "/sys/devices/system/cpu/cpu%d"
+             "/cpufreq/cpuinfo_max_freq", num);
+
+    status =
+        sigar_file2str(max_freq, max_freq, sizeof(max_freq)-1);
+
+    if (status == SIGAR_OK) {
+        cpu_info->mhz_max = atoi(max_freq) / 1000;
+    }
+}
+
+static void get_cpuinfo_min_freq(sigar_cpu_info_t *cpu_info, int num)
+{
+    int status;
+    char min_freq[PATH_MAX];
+    snprintf(min_freq, sizeof(min_freq),
+             "/sys/devices/system/cpu/cpu%d"
+             "/cpufreq/cpuinfo_min_freq", num);
+
+    status =
+        sigar_file2str(min_freq, min_freq, sizeof(min_freq)-1);
+
+    if (status == SIGAR_OK) {
+        cpu_info->mhz_min = atoi(min_freq) / 1000;
+    }
+}
+
+/* kHz the cpu runs at right now, -1 without cpufreq */
+static int get_cpuinfo_cur_freq(int num)
+{
+    char cur_freq[64];
+    char path[PATH_MAX];
+
+    snprintf(path, sizeof(path),
+             "/sys/devices/system/cpu/cpu%d"
+             "/cpufreq/scaling_cur_freq", num);
+
+    if (sigar_file2str(path, cur_freq, sizeof(cur_freq)-1) != SIGAR_OK) {
+        return -1;
+    }
+
+    return atoi(cur_freq);
+}
+
+static int cpu_infos_read(sigar_t *sigar, int core_rollup)
+{
+    sigar_cpu_info_list_t *cpu_infos = &sigar->cpu_infos;
+    FILE *fp;
+    int i=0;
+
+    if (!(fp = PROCFS_FOPEN("cpuinfo"))) {
+        return errno;
+    }
+
+    sigar_cpu_info_list_destroy(sigar, cpu_infos);
+    sigar_cpu_info_list_create(cpu_infos);
+
+    while (get_cpu_info(sigar, &cpu_infos->data[cpu_infos->number], fp)) {
+        sigar_cpu_info_t *info;
+
+        if (core_rollup && (i++ % sigar->lcpu)) {
+            continue; /* fold logical processors */
+        }
+
+        info = &cpu_infos->data[cpu_infos->number];
+        get_cpuinfo_max_freq(info, cpu_infos->number);
+        get_cpuinfo_min_freq(info, cpu_infos->number);
+
+        info->total_cores = sigar->ncpu;
+        info->cores_per_socket = sigar->lcpu;
+        info->total_sockets = sigar_cpu_socket_count(sigar);
+
+        ++cpu_infos->number;
+        SIGAR_CPU_INFO_LIST_GROW(cpu_infos);
+    }
+
+    fclose(fp);
+
+    sigar->cpu_info_ncpu = sigar->ncpu;
+    sigar->cpu_info_rollup = core_rollup;
+
+    return SIGAR_OK;
+}
+
+/*
+ * vendor, model, cache and topology do not change while we run, so
+ * the 100s of KB /proc/cpuinfo on a large box is parsed once; later
+ * calls only pick up the current clock from cpufreq.  without
+ * cpufreq, e.g. most vm guests, mhz stays what cpuinfo said first.
+ * read again when cpus are added or the core rollup is switched.
+ */
+int sigar_cpu_info_list_get(sigar_t *sigar,
+                            sigar_cpu_info_list_t *cpu_infos)
+{
+    sigar_cpu_info_list_t *cached = &sigar->cpu_infos;
+    int core_rollup = sigar_cpu_core_rollup(sigar), refresh;
+    unsigned long i;
+
+    (void)sigar_cpu_total_count(sigar);
+
+    refresh = cached->size &&
+        (sigar->cpu_info_ncpu == sigar->ncpu) &&
+        (sigar->cpu_info_rollup == core_rollup);
+
+    if (!refresh) {
+        int status = cpu_infos_read(sigar, core_rollup);
+
+        if (status != SIGAR_OK) {
+            sigar_cpu_info_list_destroy(sigar, cached);
+            return status;
+        }
+    }
+    else if (sigar->cpu_info_cur_freq != 0) {
+        for (i=0; i<cached->number; i++) {
+            int khz = get_cpuinfo_cur_freq((int)i);
+
+            if (khz < 0) {
+                if (sigar->cpu_info_cur_freq == -1) {
+                    sigar->cpu_info_cur_freq = 0; /* no cpufreq */
+                    break;
+                }
+                continue; /* offline, keep the last value */
+            }
+            sigar->cpu_info_cur_freq = 1;
+            cached->data[i].mhz = khz / 1000;
+        }
+    }
+
+    cpu_infos->number = cached->number;
+    cpu_infos->size = cached->number ? cached->number : 1;
+    cpu_infos->data = malloc(sizeof(*(cpu_infos->data)) * cpu_infos->size);
+    memcpy(cpu_infos->data, cached->data,
+           sizeof(*(cpu_infos->data)) * cached->number);
+
+    return SIGAR_OK;
+}
+
+typedef int (*sysfs_cpulist_func_t)(void *data, int num);
+
+/* walks a "0-3,8-11" style list, as found in online and cpulist */
+static int sysfs_cpulist_walk(const char *file,
+                              sysfs_cpulist_func_t func, void *data)
+{
+    char buffer[BUFSIZ], *ptr = buffer;
+    int status = sigar_file2str(file, buffer, sizeof(buffer));
+
+    if (status != SIGAR_OK) {
+        return status;
+    }
+
+    while (*ptr) {
+        unsigned long lo, hi;
+
+        if (!sigar_isdigit(*ptr)) {
+            ++ptr;
+            continue;
+        }
+
+        lo = hi = strtoul(ptr, &ptr, 10);
+        if (*ptr == '-') {
+            ++ptr;
+            hi = strtoul(ptr, &ptr, 10);
+        }
+
+        for (; lo <= hi; lo++) {
+            if ((status = func(data, (int)lo)) != SIGAR_OK) {
+                return status;
+            }
+        }
+    }
+
+    return SIGAR_OK;
+}
+
+static int sysfs_int_get(const char *file, int *value)
+{
+    char buffer[32];
+    int status = sigar_file2str(file, buffer, sizeof(buffer));
+
+    *value = (status == SIGAR_OK) ? atoi(buffer) : -1;
+
+    return status;
+}
+
+/* cpu numbers are the first member of every entry searched */
+static int cpu_num_compare(const void *key, const void *entry)
+{
+    return *(const int *)key - *(const int *)entry;
+}
+
+typedef struct {
+    int num;
+    int thread;
+} smt_sibling_t;
+
+static int smt_sibling_count(void *data, int num)
+{
+    smt_sibling_t *sibling = (smt_sibling_t *)data;
+
+    if (num < sibling->num) {
+        sibling->thread++;
+    }
+
+    return SIGAR_OK;
+}
+
+static int numa_topology_cpu_add(void *data, int num)
+{
+    sigar_numa_topology_t *topology = (sigar_numa_topology_t *)data;
+    sigar_cpu_topology_t *cpu;
+    smt_sibling_t sibling;
+    char file[SIGAR_PATH_MAX], *ptr;
+
+    SIGAR_NUMA_TOPOLOGY_GROW(topology);
+    cpu = &topology->data[topology->number++];
+    cpu->cpu = num;
+    cpu->node = 0;
+
+    ptr = file + snprintf(file, sizeof(file), SYS_CPU "/cpu%d/topology/", num);
+
+    strcpy(ptr, "physical_package_id");
+    (void)sysfs_int_get(file, &cpu->socket);
+    strcpy(ptr, "core_id");
+    (void)sysfs_int_get(file, &cpu->core);
+
+    sibling.num = num;
+    sibling.thread = 0;
+    strcpy(ptr, "thread_siblings_list");
+    (void)sysfs_cpulist_walk(file, smt_sibling_count, &sibling);
+    cpu->thread = sibling.thread;
+
+    return SIGAR_OK;
+}
+
+typedef struct {
+    sigar_numa_topology_t *topology;
+    int node;
+} numa_topology_node_t;
+
+static int numa_topology_cpu_set(void *data, int num)
+{
+    numa_topology_node_t *ctx = (numa_topology_node_t *)data;
+    sigar_cpu_topology_t *cpu =
+        bsearch(&num, ctx->topology->data, ctx->topology->number,
+                sizeof(*cpu), cpu_num_compare);
+
+    if (cpu) {
+        cpu->node = ctx->node;
+    }
+
+    return SIGAR_OK;
 }
 
-/* /proc/cpuinfo MHz will change w/ AMD + PowerNow */
-static void get_cpuinfo_max_freq(sigar_cpu_info_t *cpu_info, int num)
+static int numa_topology_node_add(void *data, int node)
 {
-    int status;
-    char max_freq[PATH_MAX];
-    snprintf(max_freq, sizeof(max_freq),
-             "/sys/devices/system/cpu/cpu%d"
-             "/cpufreq/cpuinfo_max_freq", num);
+    numa_topology_node_t ctx;
+    char file[SIGAR_PATH_MAX];
 
-    status =
-        sigar_file2str(max_freq, max_freq, sizeof(max_freq)-1);
+    ctx.topology = (sigar_numa_topology_t *)data;
+    ctx.node = node;
 
-    if (status == SIGAR_OK) {
-        cpu_info->mhz_max = atoi(max_freq) / 1000;
-    }
+    snprintf(file, sizeof(file), SYS_NODE "/node%d/cpulist", node);
+    (void)sysfs_cpulist_walk(file, numa_topology_cpu_set, &ctx);
+
+    return SIGAR_OK;
 }
 
-static void get_cpuinfo_min_freq(sigar_cpu_info_t *cpu_info, int num)
+int sigar_numa_topology_get(sigar_t *sigar,
+                            sigar_numa_topology_t *topology)
 {
     int status;
-    char min_freq[PATH_MAX];
-    snprintf(min_freq, sizeof(min_freq),
-             "/sys/devices/system/cpu/cpu%d"
-             "/cpufreq/cpuinfo_min_freq", num);
 
-    status =
-        sigar_file2str(min_freq, min_freq, sizeof(min_freq)-1);
+    sigar_numa_topology_create(topology);
 
-    if (status == SIGAR_OK) {
-        cpu_info->mhz_min = atoi(min_freq) / 1000;
+    status = sysfs_cpulist_walk(SYS_CPU "/online",
+                                numa_topology_cpu_add, topology);
+    if (status != SIGAR_OK) {
+        sigar_numa_topology_destroy(sigar, topology);
+        return status;
     }
+
+    /* ENOENT without CONFIG_NUMA, every cpu stays on node 0 */
+    (void)sysfs_cpulist_walk(SYS_NODE "/online",
+                             numa_topology_node_add, topology);
+
+    return SIGAR_OK;
 }
 
-int sigar_cpu_info_list_get(sigar_t *sigar,
-                            sigar_cpu_info_list_t *cpu_infos)
+static int numa_mem_node_add(void *data, int node)
 {
-    FILE *fp;
-    int core_rollup = sigar_cpu_core_rollup(sigar), i=0;
+    sigar_numa_mem_list_t *memlist = (sigar_numa_mem_list_t *)data;
+    sigar_numa_mem_t *mem;
+    char buffer[BUFSIZ], file[SIGAR_PATH_MAX];
+    /* "Node 0 MemTotal:       32823420 kB" */
+    sigar_keyval_t keys[] = {
+        SIGAR_KEYVAL(" MemTotal:"),
+        SIGAR_KEYVAL(" MemFree:"),
+        SIGAR_KEYVAL(" MemUsed:")
+    };
+    int i;
 
-    if (!(fp = fopen(PROC_FS_ROOT "cpuinfo", "r"))) {
-        return errno;
+    snprintf(file, sizeof(file), SYS_NODE "/node%d/meminfo", node);
+    if (sigar_file2str(file, buffer, sizeof(buffer)) != SIGAR_OK) {
+        return SIGAR_OK; /* went offline */
     }
 
-    (void)sigar_cpu_total_count(sigar);
-    sigar_cpu_info_list_create(cpu_infos);
+    for (i=0; i<sizeof(keys)/sizeof(keys[0]); i++) {
+        char *ptr = strstr(buffer, keys[i].key);
+        keys[i].value = ptr ? ptr + keys[i].len : NULL;
+    }
 
-    while (get_cpu_info(sigar, &cpu_infos->data[cpu_infos->number], fp)) {
-        sigar_cpu_info_t *info;
+    SIGAR_NUMA_MEM_LIST_GROW(memlist);
+    mem = &memlist->data[memlist->number++];
+    mem->node  = node;
+    mem->total = sigar_meminfo(&keys[0]);
+    mem->free  = sigar_meminfo(&keys[1]);
+    mem->used  = keys[2].value ?
+        sigar_meminfo(&keys[2]) : mem->total - mem->free;
 
-        if (core_rollup && (i++ % sigar->lcpu)) {
-            continue; /* fold logical processors */
+    return SIGAR_OK;
+}
+
+int sigar_numa_mem_list_get(sigar_t *sigar,
+                            sigar_numa_mem_list_t *memlist)
+{
+    int status;
+
+    sigar_numa_mem_list_create(memlist);
+
+    status = sysfs_cpulist_walk(SYS_NODE "/online",
+                                numa_mem_node_add, memlist);
+
+    if (status == ENOENT) {
+        /* no CONFIG_NUMA, node 0 is the whole machine */
+        sigar_mem_t sysmem;
+        sigar_numa_mem_t *mem = &memlist->data[memlist->number++];
+
+        if ((status = sigar_mem_get(sigar, &sysmem)) == SIGAR_OK) {
+            mem->node  = 0;
+            mem->total = sysmem.total;
+            mem->used  = sysmem.used;
+            mem->free  = sysmem.free;
         }
+    }
 
-        info = &cpu_infos->data[cpu_infos->number];
-        get_cpuinfo_max_freq(info, cpu_infos->number);
-        get_cpuinfo_min_freq(info, cpu_infos->number);
+    if (status != SIGAR_OK) {
+        sigar_numa_mem_list_destroy(sigar, memlist);
+    }
 
-        info->total_cores = sigar->ncpu;
-        info->cores_per_socket = sigar->lcpu;
-        info->total_sockets = sigar_cpu_socket_count(sigar);
+    return status;
+}
 
-        ++cpu_infos->number;
-        SIGAR_CPU_INFO_LIST_GROW(cpu_infos);
+typedef struct {
+    sigar_t *sigar;
+    sigar_cpu_list_t *cpulist;
+    sigar_cpu_t *cpu;
+} numa_cpu_node_t;
+
+static int numa_cpu_times_add(void *data, int num)
+{
+    numa_cpu_node_t *ctx = (numa_cpu_node_t *)data;
+    sigar_t *sigar = ctx->sigar;
+    int *lcpu =
+        bsearch(&num, sigar->system_stat_cpus,
+                sigar->system_stat.cpulist.number,
+                sizeof(*lcpu), cpu_num_compare);
+
+    if (lcpu) {
+        size_t i = lcpu - sigar->system_stat_cpus;
+        cpu_times_add(ctx->cpu, &sigar->system_stat.cpulist.data[i]);
     }
 
-    fclose(fp);
+    return SIGAR_OK;
+}
+
+static int numa_cpu_node_add(void *data, int node)
+{
+    numa_cpu_node_t *ctx = (numa_cpu_node_t *)data;
+    sigar_cpu_list_t *cpulist = ctx->cpulist;
+    char file[SIGAR_PATH_MAX];
+
+    while (cpulist->number <= (unsigned long)node) {
+        SIGAR_CPU_LIST_GROW(cpulist);
+        SIGAR_ZERO(&cpulist->data[cpulist->number]);
+        cpulist->number++;
+    }
+    ctx->cpu = &cpulist->data[node];
+
+    snprintf(file, sizeof(file), SYS_NODE "/node%d/cpulist", node);
+    (void)sysfs_cpulist_walk(file, numa_cpu_times_add, ctx);
 
     return SIGAR_OK;
 }
 
+int sigar_numa_cpu_list_get(sigar_t *sigar,
+                            sigar_cpu_list_t *cpulist)
+{
+    numa_cpu_node_t ctx;
+    int status = system_stat_read(sigar);
+
+    if (status != SIGAR_OK) {
+        return status;
+    }
+
+    sigar_cpu_list_create(cpulist);
+
+    ctx.sigar = sigar;
+    ctx.cpulist = cpulist;
+    status = sysfs_cpulist_walk(SYS_NODE "/online",
+                                numa_cpu_node_add, &ctx);
+
+    if (status == ENOENT) {
+        /* no CONFIG_NUMA, node 0 is the whole machine */
+        memcpy(&cpulist->data[cpulist->number++],
+               &sigar->system_stat.cpu, sizeof(sigar_cpu_t));
+        status = SIGAR_OK;
+    }
+
+    if (status != SIGAR_OK) {
+        sigar_cpu_list_destroy(sigar, cpulist);
+    }
+
+    return status;
+}
+
 static SIGAR_INLINE unsigned int hex2int(const char *x, int len)
 {
     int i;
     unsigned int j;
 
+    /* digits are 0x3N, letters of either case have 0x40 set */
     for (i=0, j=0; i<len; i++) {
         register int ch = x[i];
-        j <<= 4;
-        if (isdigit(ch)) {
-            j |= ch - '0';
-        }
-        else if (isupper(ch)) {
-            j |= ch - ('A' - 10);
-        }
-        else {
-            j |= ch - ('a' - 10);
-        }
+        j = (j << 4) | ((ch & 0xf) + ((ch >> 6) & 1) * 9);
     }
 
     return j;
@@ -1722,14 +4526,22 @@ int sigar_net_route_list_get(sigar_t *sigar,
     char net_addr[128], gate_addr[128], mask_addr[128];
     int flags;
     sigar_net_route_t *route;
+    int status;
+
+    if (!SIGAR_LIST_PRESET(sigar, routelist)) {
+        routelist->size = routelist->number = 0;
+    }
 
-    routelist->size = routelist->number = 0;
+    status = linux_rtnetlink_route_list_get(sigar, routelist);
+    if (status != SIGAR_ENOTIMPL) {
+        return status;
+    }
 
-    if (!(fp = fopen(PROC_FS_ROOT "net/route", "r"))) {
+    if (!(fp = PROCFS_FOPEN("net/route"))) {
         return errno;
     }
 
-    sigar_net_route_list_create(routelist);
+    SIGAR_LIST_CREATE(sigar, routelist, sigar_net_route_list_create);
 
     (void)fgets(buffer, sizeof(buffer), fp); /* skip header */
     while (fgets(buffer, sizeof(buffer), fp)) {
@@ -1762,22 +4574,33 @@ int sigar_net_route_list_get(sigar_t *sigar,
     return SIGAR_OK;
 }
 
-int sigar_net_interface_stat_get(sigar_t *sigar, const char *name,
-                                 sigar_net_interface_stat_t *ifstat)
+/* fnv-1a, the index only has to tell interface names apart */
+static sigar_uint64_t net_dev_hash(const char *name)
 {
-    int found = 0;
-    char buffer[BUFSIZ];
-    FILE *fp = fopen(PROC_FS_ROOT "net/dev", "r");
-    
-    if (!fp) {
-        return errno;
+    sigar_uint64_t hash = 14695981039346656037ULL;
+
+    while (*name) {
+        hash ^= (unsigned char)*name++;
+        hash *= 1099511628211ULL;
     }
 
+    return hash;
+}
+
+#define NET_DEV_FIELDS 16
+
+static void net_dev_parse(FILE *fp, sigar_net_interface_stat_list_t *iflist)
+{
+    char buffer[BUFSIZ];
+
     /* skip header */
     fgets(buffer, sizeof(buffer), fp);
     fgets(buffer, sizeof(buffer), fp);
 
     while (fgets(buffer, sizeof(buffer), fp)) {
+        sigar_net_interface_stat_entry_t *entry;
+        sigar_net_interface_stat_t *ifstat;
+        sigar_uint64_t fields[NET_DEV_FIELDS];
         char *ptr, *dev;
 
         dev = buffer;
@@ -1791,43 +4614,316 @@ int sigar_net_interface_stat_get(sigar_t *sigar, const char *name,
 
         *ptr++ = 0;
 
-        if (!strEQ(dev, name)) {
+        if (sigar_scan_columns(&ptr, ptr + strlen(ptr),
+                               fields, NET_DEV_FIELDS) != NET_DEV_FIELDS)
+        {
             continue;
         }
 
-        found = 1;
-        ifstat->rx_bytes    = sigar_strtoull(ptr);
-        ifstat->rx_packets  = sigar_strtoull(ptr);
-        ifstat->rx_errors   = sigar_strtoull(ptr);
-        ifstat->rx_dropped  = sigar_strtoull(ptr);
-        ifstat->rx_overruns = sigar_strtoull(ptr);
-        ifstat->rx_frame    = sigar_strtoull(ptr);
+        SIGAR_NET_IFSTAT_LIST_GROW(iflist);
+        entry = &iflist->data[iflist->number++];
+        SIGAR_SSTRCPY(entry->name, dev);
+        ifstat = &entry->stat;
+
+        ifstat->rx_bytes    = fields[0];
+        ifstat->rx_packets  = fields[1];
+        ifstat->rx_errors   = fields[2];
+        ifstat->rx_dropped  = fields[3];
+        ifstat->rx_overruns = fields[4];
+        ifstat->rx_frame    = fields[5];
 
         /* skip: compressed multicast */
-        ptr = sigar_skip_multiple_token(ptr, 2);
 
-        ifstat->tx_bytes      = sigar_strtoull(ptr);
-        ifstat->tx_packets    = sigar_strtoull(ptr);
-        ifstat->tx_errors     = sigar_strtoull(ptr);
-        ifstat->tx_dropped    = sigar_strtoull(ptr);
-        ifstat->tx_overruns   = sigar_strtoull(ptr);
-        ifstat->tx_collisions = sigar_strtoull(ptr);
-        ifstat->tx_carrier    = sigar_strtoull(ptr);
+        ifstat->tx_bytes      = fields[8];
+        ifstat->tx_packets    = fields[9];
+        ifstat->tx_errors     = fields[10];
+        ifstat->tx_dropped    = fields[11];
+        ifstat->tx_overruns   = fields[12];
+        ifstat->tx_collisions = fields[13];
+        ifstat->tx_carrier    = fields[14];
 
         ifstat->speed         = SIGAR_FIELD_NOTIMPL;
+    }
+}
 
-        break;
+/* one pass over /proc/net/dev into sigar->ifstat_list */
+static int net_dev_read(sigar_t *sigar)
+{
+    sigar_net_interface_stat_list_t *iflist = &sigar->ifstat_list;
+    unsigned long i;
+    FILE *fp = PROCFS_FOPEN("net/dev");
+
+    if (!fp) {
+        return errno;
+    }
+
+    if (!iflist->size) {
+        sigar_net_interface_stat_list_create(iflist);
+    }
+    iflist->number = 0;
+
+    net_dev_parse(fp, iflist);
+
+    fclose(fp);
+
+    /* data may have moved, rebuild the name index */
+    if (sigar->ifstat_index) {
+        sigar_cache_destroy(sigar->ifstat_index);
+    }
+    sigar->ifstat_index =
+        sigar_cache_create(iflist->size,
+                           SIGAR_CACHE_OPEN_ADDRESSING,
+                           SIGAR_FIELD_NOTIMPL, SIGAR_FIELD_NOTIMPL);
+    sigar->ifstat_index->free_value = index_value_free;
+
+    for (i=0; i<iflist->number; i++) {
+        sigar_cache_entry_t *ent =
+            sigar_cache_get(sigar->ifstat_index,
+                            net_dev_hash(iflist->data[i].name));
+        if (!ent->value) {
+            ent->value = &iflist->data[i];
+        }
+    }
+
+    sigar->ifstat_time = sigar_time_now_millis();
+
+    return SIGAR_OK;
+}
+
+static sigar_net_interface_stat_entry_t *net_dev_find(sigar_t *sigar,
+                                                      const char *name)
+{
+    sigar_net_interface_stat_list_t *iflist = &sigar->ifstat_list;
+    sigar_cache_entry_t *ent =
+        sigar_cache_find(sigar->ifstat_index, net_dev_hash(name));
+    unsigned long i;
+
+    if (ent && strEQ(((sigar_net_interface_stat_entry_t *)ent->value)->name,
+                     name))
+    {
+        return ent->value;
+    }
+    if (!ent) {
+        return NULL;
+    }
+
+    /* hash collision */
+    for (i=0; i<iflist->number; i++) {
+        if (strEQ(iflist->data[i].name, name)) {
+            return &iflist->data[i];
+        }
+    }
+
+    return NULL;
+}
+
+int sigar_net_interface_stat_get(sigar_t *sigar, const char *name,
+                                 sigar_net_interface_stat_t *ifstat)
+{
+    sigar_net_interface_stat_entry_t *entry;
+    sigar_uint64_t timenow = sigar_time_now_millis();
+    int status, cached = 0;
+
+    if (sigar->ifstat_time &&
+        (timenow < sigar->ifstat_time + sigar->net_ifstat_expire))
+    {
+        cached = 1;
+    }
+    else if ((status = net_dev_read(sigar)) != SIGAR_OK) {
+        return status;
+    }
+
+    entry = net_dev_find(sigar, name);
+
+    if (!entry && cached) {
+        /* may have shown up since the last read */
+        if ((status = net_dev_read(sigar)) != SIGAR_OK) {
+            return status;
+        }
+        entry = net_dev_find(sigar, name);
+    }
+
+    if (!entry) {
+        return ENXIO;
+    }
+
+    memcpy(ifstat, &entry->stat, sizeof(*ifstat));
+
+    return SIGAR_OK;
+}
+
+/* one rtnetlink dump into sigar->ifconfig_list */
+static int ifconfig_read(sigar_t *sigar)
+{
+    sigar_net_interface_config_list_t *iflist = &sigar->ifconfig_list;
+    unsigned long i;
+    int status;
+
+    sigar_net_interface_config_list_destroy(sigar, iflist);
+    sigar->ifconfig_time = 0;
+
+    if ((status = linux_rtnetlink_ifconfig_list_get(sigar, iflist)) !=
+        SIGAR_OK)
+    {
+        return status;
+    }
+
+    if (sigar->ifconfig_index) {
+        sigar_cache_destroy(sigar->ifconfig_index);
+    }
+    sigar->ifconfig_index =
+        sigar_cache_create(iflist->size,
+                           SIGAR_CACHE_OPEN_ADDRESSING,
+                           SIGAR_FIELD_NOTIMPL, SIGAR_FIELD_NOTIMPL);
+    sigar->ifconfig_index->free_value = index_value_free;
+
+    for (i=0; i<iflist->number; i++) {
+        sigar_cache_entry_t *ent =
+            sigar_cache_get(sigar->ifconfig_index,
+                            net_dev_hash(iflist->data[i].name));
+        if (!ent->value) {
+            ent->value = &iflist->data[i];
+        }
+    }
+
+    sigar->ifconfig_time = sigar_time_now_millis();
+
+    return SIGAR_OK;
+}
+
+static sigar_net_interface_config_t *ifconfig_find(sigar_t *sigar,
+                                                   const char *name)
+{
+    sigar_net_interface_config_list_t *iflist = &sigar->ifconfig_list;
+    sigar_cache_entry_t *ent =
+        sigar_cache_find(sigar->ifconfig_index, net_dev_hash(name));
+    unsigned long i;
+
+    if (ent && strEQ(((sigar_net_interface_config_t *)ent->value)->name,
+                     name))
+    {
+        return ent->value;
+    }
+    if (!ent) {
+        return NULL;
+    }
+
+    /* hash collision */
+    for (i=0; i<iflist->number; i++) {
+        if (strEQ(iflist->data[i].name, name)) {
+            return &iflist->data[i];
+        }
+    }
+
+    return NULL;
+}
+
+int sigar_os_net_interface_config_list_get(sigar_t *sigar,
+                                           sigar_net_interface_config_list_t *iflist)
+{
+    sigar_net_interface_config_list_t *cached = &sigar->ifconfig_list;
+    int status;
+
+    if ((status = ifconfig_read(sigar)) != SIGAR_OK) {
+        return status;
+    }
+
+    iflist->number = cached->number;
+    iflist->size = cached->number ? cached->number : 1;
+    iflist->data = malloc(sizeof(*(iflist->data)) * iflist->size);
+    memcpy(iflist->data, cached->data,
+           sizeof(*(iflist->data)) * cached->number);
+
+    return SIGAR_OK;
+}
+
+int sigar_os_net_interface_config_get(sigar_t *sigar, const char *name,
+                                      sigar_net_interface_config_t *ifconfig)
+{
+    sigar_net_interface_config_t *entry;
+    sigar_uint64_t timenow = sigar_time_now_millis();
+    int status, cached = 0;
+
+    if (sigar->ifconfig_time &&
+        (timenow < sigar->ifconfig_time + sigar->net_ifstat_expire))
+    {
+        cached = 1;
+    }
+    else if ((status = ifconfig_read(sigar)) != SIGAR_OK) {
+        return status;
+    }
+
+    entry = ifconfig_find(sigar, name);
+
+    if (!entry && cached) {
+        /* may have shown up since the last read */
+        if ((status = ifconfig_read(sigar)) != SIGAR_OK) {
+            return status;
+        }
+        entry = ifconfig_find(sigar, name);
+    }
+
+    if (!entry) {
+        return ENXIO;
+    }
+
+    memcpy(ifconfig, entry, sizeof(*ifconfig));
+
+    return SIGAR_OK;
+}
+
+/* fresh names, and the configs for the sigar_net_interface_config_get
+ * calls which tend to follow */
+int sigar_os_net_interface_list_get(sigar_t *sigar,
+                                    sigar_net_interface_list_t *iflist)
+{
+    sigar_net_interface_config_list_t *cached = &sigar->ifconfig_list;
+    unsigned long i;
+    int status;
+
+    if ((status = ifconfig_read(sigar)) != SIGAR_OK) {
+        return status;
+    }
+
+    sigar_net_interface_list_create(iflist);
+
+    for (i=0; i<cached->number; i++) {
+        SIGAR_NET_IFLIST_GROW(iflist);
+        iflist->data[iflist->number++] =
+            sigar_strdup(cached->data[i].name);
+    }
+
+    return SIGAR_OK;
+}
+
+int sigar_net_interface_stat_list_get(sigar_t *sigar,
+                                      sigar_net_interface_stat_list_t *iflist)
+{
+    sigar_net_interface_stat_list_t *snapshot = &sigar->ifstat_list;
+    int status;
+
+    if ((status = net_dev_read(sigar)) != SIGAR_OK) {
+        return status;
     }
 
-    fclose(fp);
+    iflist->number = snapshot->number;
+    iflist->size = snapshot->number ? snapshot->number : 1;
+    iflist->data = malloc(sizeof(*(iflist->data)) * iflist->size);
+    memcpy(iflist->data, snapshot->data,
+           sizeof(*(iflist->data)) * iflist->number);
 
-    return found ? SIGAR_OK : ENXIO;
+    return SIGAR_OK;
 }
 
 static SIGAR_INLINE void convert_hex_address(sigar_net_address_t *address,
                                              char *ptr, int len)
 {
-    if (len > HEX_ENT_LEN) {
+    if (len == HEX_ENT_LEN * 4) {
+        sigar_hex_decode128(ptr, address->addr.in6);
+
+        address->family = SIGAR_AF_INET6;
+    }
+    else if (len > HEX_ENT_LEN) {
         int i;
         for (i=0; i<=3; i++, ptr+=HEX_ENT_LEN) {
             address->addr.in6[i] = hex2int(ptr, HEX_ENT_LEN);
@@ -1872,11 +4968,6 @@ static int proc_net_walker(sigar_net_connection_walker_t *walker,
     return SIGAR_OK; /* continue loop */
 }
 
-#define SKIP_WHILE(p, c) while (*p == c) p++
-#define SKIP_PAST(p, c) \
-   while(*p && (*p != c)) p++; \
-   SKIP_WHILE(p, c)
-
 typedef struct {
     FILE *fp;
     int (*close)(FILE *);
@@ -1905,6 +4996,36 @@ static FILE *xproc_open(const char *command, xproc_t *xproc)
     }
 }
 
+static FILE *proc_net_procfs_open(sigar_t *sigar, const char *fname,
+                                  int (**close)(FILE *))
+{
+    *close = fclose;
+    return procfs_fopen(fname, strlen(fname));
+}
+
+static FILE *proc_net_mirror_open(sigar_t *sigar, const char *fname,
+                                  int (**close)(FILE *))
+{
+    char buffer[SIGAR_PATH_MAX+1];
+    xproc_t xproc;
+
+    snprintf(buffer, sizeof(buffer),
+             "%s/%s", sigar->proc_net, fname);
+
+    if (xproc_open(buffer, &xproc)) {
+        *close = xproc.close;
+        return xproc.fp;
+    }
+
+    if (SIGAR_LOG_IS_DEBUG(sigar)) {
+        sigar_log_printf(sigar, SIGAR_LOG_DEBUG,
+                         "[proc_net] cannot open %s",
+                         buffer);
+    }
+
+    return proc_net_procfs_open(sigar, fname, close);
+}
+
 static int proc_net_read(sigar_net_connection_walker_t *walker,
                          const char *fname,
                          int type)
@@ -1912,30 +5033,22 @@ static int proc_net_read(sigar_net_connection_walker_t *walker,
     FILE *fp = NULL;
     char buffer[8192];
     sigar_t *sigar = walker->sigar;
-    char *ptr = sigar->proc_net;
+    char *ptr;
     int flags = walker->flags;
     xproc_t xproc = { NULL, fclose };
 
-    if (ptr) {
+    if (sigar->netns_dir) {
+        /* no falling back to our own namespace */
         snprintf(buffer, sizeof(buffer),
-                 "%s/%s", ptr,
-                 fname + sizeof(PROC_FS_ROOT)-1);
-
-        if ((fp = xproc_open(buffer, &xproc))) {
-            if (SIGAR_LOG_IS_DEBUG(sigar)) {
-                sigar_log_printf(sigar, SIGAR_LOG_DEBUG,
-                                 "[proc_net] using %s",
-                                 buffer);
-            }
-        }
-        else if (SIGAR_LOG_IS_DEBUG(sigar)) {
-            sigar_log_printf(sigar, SIGAR_LOG_DEBUG,
-                             "[proc_net] cannot open %s",
-                             buffer);
+                 "%s/%s", sigar->netns_dir, fname);
+
+        if (!(fp = fopen(buffer, "r"))) {
+            return errno;
         }
     }
-
-    if (!(fp || (fp = fopen(fname, "r")))) {
+    else if (!(fp = sigar->backend.proc_net_open(sigar, fname,
+                                                 &xproc.close)))
+    {
         return errno;
     }
 
@@ -1943,37 +5056,26 @@ static int proc_net_read(sigar_net_connection_walker_t *walker,
 
     while ((ptr = fgets(buffer, sizeof(buffer), fp))) {
         sigar_net_connection_t conn;
-        char *laddr, *raddr;
-        int laddr_len=0, raddr_len=0;
+        sigar_uint64_t cols[3];
+        char *laddr, *raddr, *end = ptr + strlen(ptr);
+        int laddr_len, raddr_len;
         int more;
 
-        /* skip leading space */
-        SKIP_WHILE(ptr, ' ');
-
-        /* skip "%d: " */
-        SKIP_PAST(ptr, ' ');
+        /* skip leading space and "%d: " */
+        ptr = sigar_scan_blanks(ptr, end);
+        ptr = sigar_scan_field(ptr, end);
 
         laddr = ptr;
-        while (*ptr && (*ptr != ':')) {
-            laddr_len++;
-            ptr++;
-        }
-        SKIP_WHILE(ptr, ':');
-
-        conn.local_port = (strtoul(ptr, &ptr, 16) & 0xffff);
+        sigar_scan_hex(&ptr, end);
+        laddr_len = ptr - laddr;
+        ptr += (*ptr == ':');
+        conn.local_port = (sigar_scan_hex(&ptr, end) & 0xffff);
 
-        SKIP_WHILE(ptr, ' ');
-
-        raddr = ptr;
-        while (*ptr && (*ptr != ':')) {
-            raddr_len++;
-            ptr++;
-        }
-        SKIP_WHILE(ptr, ':');
-
-        conn.remote_port = (strtoul(ptr, &ptr, 16) & 0xffff);
-
-        SKIP_WHILE(ptr, ' ');
+        raddr = ptr = sigar_scan_blanks(ptr, end);
+        sigar_scan_hex(&ptr, end);
+        raddr_len = ptr - raddr;
+        ptr += (*ptr == ':');
+        conn.remote_port = (sigar_scan_hex(&ptr, end) & 0xffff);
 
         if (!((conn.remote_port && (flags & SIGAR_NETCONN_CLIENT)) ||
               (!conn.remote_port && (flags & SIGAR_NETCONN_SERVER))))
@@ -1990,26 +5092,24 @@ static int proc_net_read(sigar_net_connection_walker_t *walker,
                             raddr, raddr_len);
 
         /* SIGAR_TCP_* currently matches TCP_* in linux/tcp.h */
-        conn.state = hex2int(ptr, 2);
-        ptr += 2;
-        SKIP_WHILE(ptr, ' ');
-
-        conn.send_queue = hex2int(ptr, HEX_ENT_LEN);
-        ptr += HEX_ENT_LEN+1; /* tx + ':' */;
-
-        conn.receive_queue = hex2int(ptr, HEX_ENT_LEN);
-        ptr += HEX_ENT_LEN;
-        SKIP_WHILE(ptr, ' ');
-
-        SKIP_PAST(ptr, ' '); /* tr:tm->whem */
-        SKIP_PAST(ptr, ' '); /* retrnsmt */
+        ptr = sigar_scan_blanks(ptr, end);
+        conn.state = sigar_scan_hex(&ptr, end);
 
-        conn.uid = sigar_strtoul(ptr);
+        ptr = sigar_scan_blanks(ptr, end);
+        conn.send_queue = sigar_scan_hex(&ptr, end);
+        ptr += (*ptr == ':'); /* tx + ':' */
+        conn.receive_queue = sigar_scan_hex(&ptr, end);
 
-        SKIP_WHILE(ptr, ' ');
-        SKIP_PAST(ptr, ' '); /* timeout */
+        ptr = sigar_scan_blanks(ptr, end);
+        ptr = sigar_scan_field(ptr, end); /* tr:tm->whem */
+        ptr = sigar_scan_field(ptr, end); /* retrnsmt */
 
-        conn.inode = sigar_strtoul(ptr);
+        /* uid timeout inode */
+        if (sigar_scan_columns(&ptr, end, cols, 3) != 3) {
+            continue;
+        }
+        conn.uid = cols[0];
+        conn.inode = cols[2];
 
         more = walker->add_connection(walker, &conn);
         if (more != SIGAR_OK) {
@@ -2023,50 +5123,71 @@ static int proc_net_read(sigar_net_connection_walker_t *walker,
     return SIGAR_OK;
 }
 
-int sigar_net_connection_walk(sigar_net_connection_walker_t *walker)
+/* SIGAR_PROC_NET mirrors and other namespaces are procfs only */
+#define NET_SOCK_DIAG(walker, type, port, remote) \
+    (((walker)->sigar->proc_net || (walker)->sigar->netns_dir) ? \
+     SIGAR_ENOTIMPL : \
+     linux_sock_diag_walk(walker, type, port, remote))
+
+static int net_connection_walk(sigar_net_connection_walker_t *walker,
+                               unsigned long port, int remote)
 {
     int flags = walker->flags;
     int status;
 
     if (flags & SIGAR_NETCONN_TCP) {
-        status = proc_net_read(walker,
-                               PROC_FS_ROOT "net/tcp",
-                               SIGAR_NETCONN_TCP);
+        status = NET_SOCK_DIAG(walker, SIGAR_NETCONN_TCP, port, remote);
 
-        if (status != SIGAR_OK) {
-            return status;
-        }
+        if (status == SIGAR_ENOTIMPL) {
+            status = proc_net_read(walker,
+                                   "net/tcp",
+                                   SIGAR_NETCONN_TCP);
 
-        status = proc_net_read(walker,
-                               PROC_FS_ROOT "net/tcp6",
-                               SIGAR_NETCONN_TCP);
+            if (status != SIGAR_OK) {
+                return status;
+            }
 
-        if (!((status == SIGAR_OK) || (status == ENOENT))) {
+            status = proc_net_read(walker,
+                                   "net/tcp6",
+                                   SIGAR_NETCONN_TCP);
+
+            if (!((status == SIGAR_OK) || (status == ENOENT))) {
+                return status;
+            }
+        }
+        else if (status != SIGAR_OK) {
             return status;
         }
     }
 
     if (flags & SIGAR_NETCONN_UDP) {
-        status = proc_net_read(walker,
-                               PROC_FS_ROOT "net/udp",
-                               SIGAR_NETCONN_UDP);
+        status = NET_SOCK_DIAG(walker, SIGAR_NETCONN_UDP, port, remote);
 
-        if (status != SIGAR_OK) {
-            return status;
-        }
+        if (status == SIGAR_ENOTIMPL) {
+            status = proc_net_read(walker,
+                                   "net/udp",
+                                   SIGAR_NETCONN_UDP);
 
-        status = proc_net_read(walker,
-                               PROC_FS_ROOT "net/udp6",
-                               SIGAR_NETCONN_UDP);
+            if (status != SIGAR_OK) {
+                return status;
+            }
 
-        if (!((status == SIGAR_OK) || (status == ENOENT))) {
+            status = proc_net_read(walker,
+                                   "net/udp6",
+                                   SIGAR_NETCONN_UDP);
+
+            if (!((status == SIGAR_OK) || (status == ENOENT))) {
+                return status;
+            }
+        }
+        else if (status != SIGAR_OK) {
             return status;
         }
     }
 
     if (flags & SIGAR_NETCONN_RAW) {
         status = proc_net_read(walker,
-                               PROC_FS_ROOT "net/raw",
+                               "net/raw",
                                SIGAR_NETCONN_RAW);
         
         if (status != SIGAR_OK) {
@@ -2074,7 +5195,7 @@ int sigar_net_connection_walk(sigar_net_connection_walker_t *walker)
         }
 
         status = proc_net_read(walker,
-                               PROC_FS_ROOT "net/raw6",
+                               "net/raw6",
                                SIGAR_NETCONN_RAW);
 
         if (!((status == SIGAR_OK) || (status == ENOENT))) {
@@ -2087,6 +5208,161 @@ int sigar_net_connection_walk(sigar_net_connection_walker_t *walker)
     return SIGAR_OK;
 }
 
+int sigar_net_connection_walk(sigar_net_connection_walker_t *walker)
+{
+    return net_connection_walk(walker, 0, 0);
+}
+
+int sigar_net_connection_port_walk(sigar_net_connection_walker_t *walker,
+                                   unsigned long port, int remote)
+{
+    return net_connection_walk(walker, port, remote);
+}
+
+int sigar_os_net_stat_get(sigar_t *sigar, sigar_net_stat_t *netstat,
+                          int flags)
+{
+    if (sigar->proc_net || sigar->netns_dir) {
+        return SIGAR_ENOTIMPL; /* count what the files have */
+    }
+    return linux_sock_diag_net_stat(sigar, netstat, flags);
+}
+
+static int netns_inode_get(sigar_t *sigar, sigar_pid_t pid,
+                           sigar_uint64_t *inode)
+{
+    char name[BUFSIZ];
+    struct stat sb;
+
+    (void)SIGAR_PROC_FILENAME(name, pid, "/ns/net");
+
+    if (stat(name, &sb) < 0) {
+        return (errno == ENOENT) ? ESRCH : errno;
+    }
+    *inode = sb.st_ino;
+
+    return SIGAR_OK;
+}
+
+/* the pid may have gone, and been reused, since the list was taken */
+static int netns_check(sigar_t *sigar, sigar_netns_t *netns)
+{
+    sigar_uint64_t inode;
+    int status = netns_inode_get(sigar, netns->pid, &inode);
+
+    if (status != SIGAR_OK) {
+        return status;
+    }
+    return (inode == netns->inode) ? SIGAR_OK : ESRCH;
+}
+
+int sigar_netns_list_get(sigar_t *sigar, sigar_netns_list_t *netnslist)
+{
+    sigar_proc_list_t pids;
+    sigar_cache_t *seen;
+    unsigned long i;
+    int status;
+
+    if ((status = sigar_proc_list_get(sigar, &pids)) != SIGAR_OK) {
+        return status;
+    }
+
+    sigar_netns_list_create(netnslist);
+    /* inode to index + 1 */
+    seen = sigar_cache_new(SIGAR_NETNS_LIST_MAX);
+    seen->free_value = index_value_free;
+
+    for (i=0; i<pids.number; i++) {
+        sigar_pid_t pid = pids.data[i];
+        sigar_cache_entry_t *ent;
+        sigar_netns_t *netns;
+        sigar_uint64_t inode;
+
+        if (netns_inode_get(sigar, pid, &inode) != SIGAR_OK) {
+            continue;
+        }
+
+        ent = sigar_cache_get(seen, inode);
+        if (ent->value) {
+            netns = &netnslist->data[(unsigned long)ent->value - 1];
+            netns->processes++;
+            if (pid < netns->pid) {
+                netns->pid = pid;
+            }
+            continue;
+        }
+
+        SIGAR_NETNS_LIST_GROW(netnslist);
+        netns = &netnslist->data[netnslist->number++];
+        netns->inode = inode;
+        netns->pid = pid;
+        netns->processes = 1;
+        ent->value = (void *)netnslist->number;
+    }
+
+    sigar_cache_destroy(seen);
+    sigar_proc_list_destroy(sigar, &pids);
+
+    return SIGAR_OK;
+}
+
+int sigar_netns_net_interface_stat_list_get(sigar_t *sigar,
+                                            sigar_netns_t *netns,
+                                            sigar_net_interface_stat_list_t *iflist)
+{
+    char name[BUFSIZ];
+    FILE *fp;
+    int status;
+
+    (void)SIGAR_PROC_FILENAME(name, netns->pid, "/net/dev");
+
+    SIGAR_INSTRUMENT_OPEN();
+    if (!(fp = fopen(name, "r"))) {
+        return (errno == ENOENT) ? ESRCH : errno;
+    }
+
+    /* checked once open, that is the namespace the reads see */
+    if ((status = netns_check(sigar, netns)) != SIGAR_OK) {
+        fclose(fp);
+        return status;
+    }
+
+    sigar_net_interface_stat_list_create(iflist);
+    net_dev_parse(fp, iflist);
+    fclose(fp);
+
+    return SIGAR_OK;
+}
+
+int sigar_netns_net_stat_get(sigar_t *sigar, sigar_netns_t *netns,
+                             sigar_net_stat_t *netstat, int flags)
+{
+    char dir[BUFSIZ];
+    sigar_cache_t *net_listen = sigar->net_listen;
+    int status;
+
+    (void)SIGAR_PROC_FILENAME(dir, netns->pid, "");
+
+    /* its listen ports are not ours */
+    sigar->net_listen = sigar_cache_new(32);
+    sigar->netns_dir = dir;
+
+    status = sigar_net_stat_get(sigar, netstat, flags);
+
+    sigar->netns_dir = NULL;
+    sigar_cache_destroy(sigar->net_listen);
+    sigar->net_listen = net_listen;
+
+    if (status == SIGAR_OK) {
+        status = netns_check(sigar, netns);
+    }
+    else if (status == ENOENT) {
+        status = ESRCH;
+    }
+
+    return status;
+}
+
 int sigar_net_connection_list_get(sigar_t *sigar,
                                   sigar_net_connection_list_t *connlist,
                                   int flags)
@@ -2095,7 +5371,11 @@ int sigar_net_connection_list_get(sigar_t *sigar,
     sigar_net_connection_walker_t walker;
     net_conn_getter_t getter;
 
-    sigar_net_connection_list_create(connlist);
+    if (sigar->replay) {
+        return sigar_replay_net_connection_list_get(sigar, connlist, flags);
+    }
+
+    SIGAR_LIST_CREATE(sigar, connlist, sigar_net_connection_list_create);
 
     getter.conn = NULL;
     getter.connlist = connlist;
@@ -2132,7 +5412,7 @@ static int sigar_net_connection_get(sigar_t *sigar,
     walker.data = &getter;
     walker.add_connection = proc_net_walker;
 
-    status = sigar_net_connection_walk(&walker);
+    status = net_connection_walk(&walker, port, 0);
 
     return status;
 }
@@ -2145,7 +5425,7 @@ int sigar_net_interface_ipv6_config_get(sigar_t *sigar, const char *name,
     int status = SIGAR_ENOENT;
     int idx, prefix, scope, flags;
 
-    if (!(fp = fopen(PROC_FS_ROOT "net/if_inet6", "r"))) {
+    if (!(fp = PROCFS_FOPEN("net/if_inet6"))) {
         return errno;
     }
 
@@ -2161,12 +5441,13 @@ int sigar_net_interface_ipv6_config_get(sigar_t *sigar, const char *name,
     fclose(fp);
 
     if (status == SIGAR_OK) {
-        int i=0;
         unsigned char *addr6 = (unsigned char *)&(ifconfig->address6.addr.in6);
-        char *ptr = addr;
 
-        for (i=0; i<16; i++, ptr+=2) {
-            addr6[i] = (unsigned char)hex2int(ptr, 2);
+        if (strlen(addr) == 32) {
+            sigar_hex_decode16(addr, addr6);
+        }
+        else {
+            memset(addr6, 0, 16);
         }
 
         ifconfig->prefix6_length = prefix;
@@ -2186,7 +5467,7 @@ sigar_tcp_get(sigar_t *sigar,
     char buffer[1024], *ptr=buffer;
     int status = SIGAR_ENOENT;
 
-    if (!(fp = fopen(PROC_FS_ROOT "net/snmp", "r"))) {
+    if (!(fp = PROCFS_FOPEN("net/snmp"))) {
         return errno;
     }
 
@@ -2217,137 +5498,352 @@ sigar_tcp_get(sigar_t *sigar,
         tcp->out_rsts = sigar_strtoull(ptr);
     }
 
-    return status;
+    return status;
+}
+
+#define PROC_NFS_CLIENT "net/rpc/nfs"
+#define PROC_NFS_SERVER "net/rpc/nfsd"
+
+static void nfs_v2_parse(char *ptr, sigar_nfs_v2_t *nfs)
+{
+    ptr = sigar_skip_multiple_token(ptr, 2);
+
+    nfs->null = sigar_strtoull(ptr);
+    nfs->getattr = sigar_strtoull(ptr);
+    nfs->setattr = sigar_strtoull(ptr);
+    nfs->root = sigar_strtoull(ptr);
+    nfs->lookup = sigar_strtoull(ptr);
+    nfs->readlink = sigar_strtoull(ptr);
+    nfs->read = sigar_strtoull(ptr);
+    nfs->writecache = sigar_strtoull(ptr);
+    nfs->write = sigar_strtoull(ptr);
+    nfs->create = sigar_strtoull(ptr);
+    nfs->remove = sigar_strtoull(ptr);
+    nfs->rename = sigar_strtoull(ptr);
+    nfs->link = sigar_strtoull(ptr);
+    nfs->symlink = sigar_strtoull(ptr);
+    nfs->mkdir = sigar_strtoull(ptr);
+    nfs->rmdir = sigar_strtoull(ptr);
+    nfs->readdir = sigar_strtoull(ptr);
+    nfs->fsstat = sigar_strtoull(ptr);
+}
+
+static void nfs_v3_parse(char *ptr, sigar_nfs_v3_t *nfs)
+{
+    ptr = sigar_skip_multiple_token(ptr, 2);
+
+    nfs->null = sigar_strtoull(ptr);
+    nfs->getattr = sigar_strtoull(ptr);
+    nfs->setattr = sigar_strtoull(ptr);
+    nfs->lookup = sigar_strtoull(ptr);
+    nfs->access = sigar_strtoull(ptr);
+    nfs->readlink = sigar_strtoull(ptr);
+    nfs->read = sigar_strtoull(ptr);
+    nfs->write = sigar_strtoull(ptr);
+    nfs->create = sigar_strtoull(ptr);
+    nfs->mkdir = sigar_strtoull(ptr);
+    nfs->symlink = sigar_strtoull(ptr);
+    nfs->mknod = sigar_strtoull(ptr);
+    nfs->remove = sigar_strtoull(ptr);
+    nfs->rmdir = sigar_strtoull(ptr);
+    nfs->rename = sigar_strtoull(ptr);
+    nfs->link = sigar_strtoull(ptr);
+    nfs->readdir = sigar_strtoull(ptr);
+    nfs->readdirplus = sigar_strtoull(ptr);
+    nfs->fsstat = sigar_strtoull(ptr);
+    nfs->fsinfo = sigar_strtoull(ptr);
+    nfs->pathconf = sigar_strtoull(ptr);
+    nfs->commit = sigar_strtoull(ptr);
+}
+
+/* "proc4 N ..." on the client, "proc4ops N ..." on the server */
+static void nfs_v4_parse(char *ptr, sigar_nfs_rpc_t *rpc)
+{
+    unsigned long i, num;
+
+    ptr = sigar_skip_token(ptr);
+    num = sigar_strtoul(ptr);
+
+    if (num > SIGAR_NFS_V4_OPS_MAX) {
+        num = SIGAR_NFS_V4_OPS_MAX;
+    }
+
+    for (i=0; i<num; i++) {
+        rpc->v4[i] = sigar_strtoull(ptr);
+    }
+    rpc->v4_number = num;
+}
+
+/* every procN line of one side in a single pass */
+static int nfs_rpc_read(const char *file, int len, int server,
+                        sigar_nfs_rpc_t *rpc)
+{
+    char buffer[BUFSIZ];
+    FILE *fp = procfs_fopen(file, len);
+
+    SIGAR_ZERO(rpc);
+
+    if (!fp) {
+        return SIGAR_ENOTIMPL;
+    }
+
+    while (fgets(buffer, sizeof(buffer), fp)) {
+        if (strnEQ(buffer, "proc2 ", 6)) {
+            nfs_v2_parse(buffer, &rpc->v2);
+            rpc->versions |= SIGAR_NFS_V2;
+        }
+        else if (strnEQ(buffer, "proc3 ", 6)) {
+            nfs_v3_parse(buffer, &rpc->v3);
+            rpc->versions |= SIGAR_NFS_V3;
+        }
+        else if (server ?
+                 strnEQ(buffer, "proc4ops ", 9) :
+                 strnEQ(buffer, "proc4 ", 6))
+        {
+            nfs_v4_parse(buffer, rpc);
+            rpc->versions |= SIGAR_NFS_V4;
+        }
+    }
+
+    fclose(fp);
+
+    return SIGAR_OK;
+}
+
+#define NFS_RPC_READ(file, server, rpc) \
+    nfs_rpc_read(file, SSTRLEN(file), server, rpc)
+
+SIGAR_DECLARE(int) sigar_nfs_stats_get(sigar_t *sigar,
+                                       sigar_nfs_stats_t *nfs)
+{
+    int client = NFS_RPC_READ(PROC_NFS_CLIENT, 0, &nfs->client);
+    int server = NFS_RPC_READ(PROC_NFS_SERVER, 1, &nfs->server);
+
+    if ((client != SIGAR_OK) && (server != SIGAR_OK)) {
+        return SIGAR_ENOTIMPL;
+    }
+
+    return SIGAR_OK;
+}
+
+int sigar_nfs_client_v2_get(sigar_t *sigar,
+                            sigar_nfs_client_v2_t *nfs)
+{
+    sigar_nfs_rpc_t rpc;
+    int status = NFS_RPC_READ(PROC_NFS_CLIENT, 0, &rpc);
+
+    if (status != SIGAR_OK) {
+        return status;
+    }
+    if (!(rpc.versions & SIGAR_NFS_V2)) {
+        return ENOENT;
+    }
+
+    memcpy(nfs, &rpc.v2, sizeof(*nfs));
+
+    return SIGAR_OK;
+}
+
+int sigar_nfs_server_v2_get(sigar_t *sigar,
+                            sigar_nfs_server_v2_t *nfs)
+{
+    sigar_nfs_rpc_t rpc;
+    int status = NFS_RPC_READ(PROC_NFS_SERVER, 1, &rpc);
+
+    if (status != SIGAR_OK) {
+        return status;
+    }
+    if (!(rpc.versions & SIGAR_NFS_V2)) {
+        return ENOENT;
+    }
+
+    memcpy(nfs, &rpc.v2, sizeof(*nfs));
+
+    return SIGAR_OK;
 }
 
-static int sigar_proc_nfs_gets(char *file, char *tok,
-                               char *buffer, size_t size)
+int sigar_nfs_client_v3_get(sigar_t *sigar,
+                            sigar_nfs_client_v3_t *nfs)
 {
-    int status = ENOENT;
-    int len = strlen(tok);
-    FILE *fp = fopen(file, "r");
-    
-    if (!fp) {
-        return SIGAR_ENOTIMPL;
-    }
+    sigar_nfs_rpc_t rpc;
+    int status = NFS_RPC_READ(PROC_NFS_CLIENT, 0, &rpc);
 
-    while (fgets(buffer, size, fp)) {
-        if (strnEQ(buffer, tok, len)) {
-            status = SIGAR_OK;
-            break;
-        }
+    if (status != SIGAR_OK) {
+        return status;
+    }
+    if (!(rpc.versions & SIGAR_NFS_V3)) {
+        return ENOENT;
     }
 
-    fclose(fp);
+    memcpy(nfs, &rpc.v3, sizeof(*nfs));
 
-    return status;
+    return SIGAR_OK;
 }
 
-static int sigar_nfs_v2_get(char *file, sigar_nfs_v2_t *nfs)
+int sigar_nfs_server_v3_get(sigar_t *sigar,
+                            sigar_nfs_server_v3_t *nfs)
 {
-    char buffer[BUFSIZ], *ptr=buffer;
-    int status =
-        sigar_proc_nfs_gets(file,
-                            "proc2", buffer, sizeof(buffer));
+    sigar_nfs_rpc_t rpc;
+    int status = NFS_RPC_READ(PROC_NFS_SERVER, 1, &rpc);
 
     if (status != SIGAR_OK) {
         return status;
     }
+    if (!(rpc.versions & SIGAR_NFS_V3)) {
+        return ENOENT;
+    }
 
-    ptr = sigar_skip_multiple_token(ptr, 2);
-
-    nfs->null = sigar_strtoull(ptr);
-    nfs->getattr = sigar_strtoull(ptr);
-    nfs->setattr = sigar_strtoull(ptr);
-    nfs->root = sigar_strtoull(ptr);
-    nfs->lookup = sigar_strtoull(ptr);
-    nfs->readlink = sigar_strtoull(ptr);
-    nfs->read = sigar_strtoull(ptr);
-    nfs->writecache = sigar_strtoull(ptr);
-    nfs->write = sigar_strtoull(ptr);
-    nfs->create = sigar_strtoull(ptr);
-    nfs->remove = sigar_strtoull(ptr);
-    nfs->rename = sigar_strtoull(ptr);
-    nfs->link = sigar_strtoull(ptr);
-    nfs->symlink = sigar_strtoull(ptr);
-    nfs->mkdir = sigar_strtoull(ptr);
-    nfs->rmdir = sigar_strtoull(ptr);
-    nfs->readdir = sigar_strtoull(ptr);
-    nfs->fsstat = sigar_strtoull(ptr);
+    memcpy(nfs, &rpc.v3, sizeof(*nfs));
 
     return SIGAR_OK;
 }
 
-int sigar_nfs_client_v2_get(sigar_t *sigar,
-                            sigar_nfs_client_v2_t *nfs)
+#define NFS_MOUNT_OPS_MAX 32
+
+/* the next space separated token of ptr into buf */
+static char *nfs_token_copy(char *ptr, char *buf, size_t size)
 {
-    return sigar_nfs_v2_get(PROC_FS_ROOT "net/rpc/nfs",
-                            (sigar_nfs_v2_t *)nfs);
+    size_t len = 0;
+
+    while (sigar_isspace(*ptr)) {
+        ptr++;
+    }
+    while (*ptr && !sigar_isspace(*ptr)) {
+        if (len < size-1) {
+            buf[len++] = *ptr;
+        }
+        ptr++;
+    }
+    buf[len] = '\0';
+
+    return ptr;
 }
 
-int sigar_nfs_server_v2_get(sigar_t *sigar,
-                            sigar_nfs_server_v2_t *nfs)
+/*
+ * "device srv:/export mounted on /mnt with fstype nfs4 statvers=1.1",
+ * NULL unless it is an nfs mount
+ */
+static sigar_nfs_mount_t *nfs_mount_new(char *ptr,
+                                        sigar_nfs_mount_list_t *mounts)
 {
-    return sigar_nfs_v2_get(PROC_FS_ROOT "net/rpc/nfsd",
-                            (sigar_nfs_v2_t *)nfs);
+    sigar_nfs_mount_t mount;
+
+    ptr = nfs_token_copy(ptr + SSTRLEN("device"),
+                         mount.dev_name, sizeof(mount.dev_name));
+    ptr = sigar_skip_multiple_token(ptr, 2); /* mounted on */
+    ptr = nfs_token_copy(ptr, mount.dir_name, sizeof(mount.dir_name));
+    ptr = sigar_skip_multiple_token(ptr, 2); /* with fstype */
+    nfs_token_copy(ptr, mount.sys_type_name, sizeof(mount.sys_type_name));
+
+    if (!strnEQ(mount.sys_type_name, "nfs", 3)) {
+        return NULL;
+    }
+
+    mount.age = 0;
+    mount.number = 0;
+    mount.size = NFS_MOUNT_OPS_MAX;
+    mount.ops = malloc(sizeof(*mount.ops) * mount.size);
+
+    SIGAR_NFS_MOUNT_LIST_GROW(mounts);
+    memcpy(&mounts->data[mounts->number], &mount, sizeof(mount));
+
+    return &mounts->data[mounts->number++];
 }
 
-static int sigar_nfs_v3_get(char *file, sigar_nfs_v3_t *nfs)
+/* "READ: ops trans timeouts sent recv queue rtt execute [errors]" */
+static int nfs_mount_op_add(char *ptr, sigar_nfs_mount_t *mount)
 {
-    char buffer[BUFSIZ], *ptr=buffer;
-    int status =
-        sigar_proc_nfs_gets(file,
-                            "proc3", buffer, sizeof(buffer));
+    sigar_nfs_mount_op_t *op;
+    char *name = ptr, *colon = strchr(ptr, ':');
 
-    if (status != SIGAR_OK) {
-        return status;
+    if (!colon || (colon == name)) {
+        return !SIGAR_OK;
     }
 
-    ptr = sigar_skip_multiple_token(ptr, 2);
+    if (mount->number >= mount->size) {
+        mount->size += NFS_MOUNT_OPS_MAX;
+        mount->ops = realloc(mount->ops, sizeof(*mount->ops) * mount->size);
+    }
+    op = &mount->ops[mount->number++];
 
-    nfs->null = sigar_strtoull(ptr);
-    nfs->getattr = sigar_strtoull(ptr);
-    nfs->setattr = sigar_strtoull(ptr);
-    nfs->lookup = sigar_strtoull(ptr);
-    nfs->access = sigar_strtoull(ptr);
-    nfs->readlink = sigar_strtoull(ptr);
-    nfs->read = sigar_strtoull(ptr);
-    nfs->write = sigar_strtoull(ptr);
-    nfs->create = sigar_strtoull(ptr);
-    nfs->mkdir = sigar_strtoull(ptr);
-    nfs->symlink = sigar_strtoull(ptr);
-    nfs->mknod = sigar_strtoull(ptr);
-    nfs->remove = sigar_strtoull(ptr);
-    nfs->rmdir = sigar_strtoull(ptr);
-    nfs->rename = sigar_strtoull(ptr);
-    nfs->link = sigar_strtoull(ptr);
-    nfs->readdir = sigar_strtoull(ptr);
-    nfs->readdirplus = sigar_strtoull(ptr);
-    nfs->fsstat = sigar_strtoull(ptr);
-    nfs->fsinfo = sigar_strtoull(ptr);
-    nfs->pathconf = sigar_strtoull(ptr);
-    nfs->commit = sigar_strtoull(ptr);
+    *colon = '\0';
+    SIGAR_SSTRCPY(op->name, name);
+    ptr = colon + 1;
+
+    op->ops            = sigar_strtoull(ptr);
+    op->transmissions  = sigar_strtoull(ptr);
+    op->timeouts       = sigar_strtoull(ptr);
+    op->bytes_sent     = sigar_strtoull(ptr);
+    op->bytes_received = sigar_strtoull(ptr);
+    op->queue_time     = sigar_strtoull(ptr);
+    op->rtt            = sigar_strtoull(ptr);
+    op->execute_time   = sigar_strtoull(ptr);
+
+    while (sigar_isspace(*ptr)) {
+        ptr++;
+    }
+    if (sigar_isdigit(*ptr)) {
+        op->errors = sigar_strtoull(ptr);
+    }
+    else {
+        op->errors = SIGAR_FIELD_NOTIMPL; /* before linux 4.17 */
+    }
 
     return SIGAR_OK;
 }
 
-int sigar_nfs_client_v3_get(sigar_t *sigar,
-                            sigar_nfs_client_v3_t *nfs)
+SIGAR_DECLARE(int) sigar_nfs_mount_list_get(sigar_t *sigar,
+                                            sigar_nfs_mount_list_t *mounts)
 {
-    return sigar_nfs_v3_get(PROC_FS_ROOT "net/rpc/nfs",
-                            (sigar_nfs_v3_t *)nfs);
-}
+    char buffer[BUFSIZ];
+    sigar_nfs_mount_t *mount = NULL;
+    int in_ops = 0;
+    FILE *fp = PROCFS_FOPEN("self/mountstats");
 
-int sigar_nfs_server_v3_get(sigar_t *sigar,
-                            sigar_nfs_server_v3_t *nfs)
-{
-    return sigar_nfs_v3_get(PROC_FS_ROOT "net/rpc/nfsd",
-                            (sigar_nfs_v3_t *)nfs);
+    if (!fp) {
+        return errno;
+    }
+
+    sigar_nfs_mount_list_create(mounts);
+
+    while (fgets(buffer, sizeof(buffer), fp)) {
+        char *ptr = buffer;
+
+        if (strnEQ(buffer, "device ", 7)) {
+            mount = nfs_mount_new(buffer, mounts);
+            in_ops = 0;
+            continue;
+        }
+        if (!mount) {
+            continue;
+        }
+
+        while (sigar_isspace(*ptr)) {
+            ptr++;
+        }
+
+        if (in_ops) {
+            if (nfs_mount_op_add(ptr, mount) != SIGAR_OK) {
+                in_ops = 0; /* blank line after the last op */
+            }
+        }
+        else if (strnEQ(ptr, "age:", 4)) {
+            ptr += 4;
+            mount->age = sigar_strtoull(ptr);
+        }
+        else if (strnEQ(ptr, "per-op statistics", 17)) {
+            in_ops = 1;
+        }
+    }
+
+    fclose(fp);
+
+    return SIGAR_OK;
 }
 
 #include <net/if_arp.h>
 
-static char *get_hw_type(int type)
+char *linux_hw_type(int type)
 {
     switch (type) {
     case ARPHRD_AX25:
@@ -2412,13 +5908,20 @@ int sigar_arp_list_get(sigar_t *sigar,
     int flags, type, status;
     sigar_arp_t *arp;
 
-    arplist->size = arplist->number = 0;
+    if (!SIGAR_LIST_PRESET(sigar, arplist)) {
+        arplist->size = arplist->number = 0;
+    }
+
+    status = linux_rtnetlink_arp_list_get(sigar, arplist);
+    if (status != SIGAR_ENOTIMPL) {
+        return status;
+    }
 
-    if (!(fp = fopen(PROC_FS_ROOT "net/arp", "r"))) {
+    if (!(fp = PROCFS_FOPEN("net/arp"))) {
         return errno;
     }
 
-    sigar_arp_list_create(arplist);
+    SIGAR_LIST_CREATE(sigar, arplist, sigar_arp_list_create);
 
     (void)fgets(buffer, sizeof(buffer), fp); /* skip header */
     while (fgets(buffer, sizeof(buffer), fp)) {
@@ -2468,7 +5971,7 @@ int sigar_arp_list_get(sigar_t *sigar,
         }
         arp->hwaddr.family = SIGAR_AF_LINK;
 
-        SIGAR_SSTRCPY(arp->type, get_hw_type(type));
+        SIGAR_SSTRCPY(arp->type, linux_hw_type(type));
     }
 
     fclose(fp);
@@ -2476,38 +5979,42 @@ int sigar_arp_list_get(sigar_t *sigar,
     return SIGAR_OK;
 }
 
-int sigar_proc_port_get(sigar_t *sigar, int protocol,
-                        unsigned long port, sigar_pid_t *pid)
+/* socket inode -> pid, rebuilt from scratch once it gets this old */
+#define PROC_PORT_INDEX_EXPIRE (10 * SIGAR_MSEC)
+/* a miss forces a rebuild, but not more often than this */
+#define PROC_PORT_INDEX_MISS_EXPIRE (1 * SIGAR_MSEC)
+
+/* one pass over every /proc/<pid>/fd/ we are allowed to read */
+static int proc_port_index_build(sigar_t *sigar)
 {
-    int status;
-    sigar_net_connection_t netconn;
     DIR *dirp;
     struct dirent *ent, dbuf;
 
-    SIGAR_ZERO(&netconn);
-    *pid = 0;
-
-    status = sigar_net_connection_get(sigar, &netconn, port,
-                                      SIGAR_NETCONN_SERVER|protocol);
-
-    if (status != SIGAR_OK) {
-        return status;
-    }
-
-    if (netconn.local_port != port) {
-        return SIGAR_OK; /* XXX or ENOENT? */
+    if (sigar->proc_port_index) {
+        sigar_cache_destroy(sigar->proc_port_index);
+        sigar_pool_destroy(sigar->proc_port_pool);
     }
+    sigar->proc_port_index =
+        sigar_cache_create(SIGAR_PROC_LIST_MAX,
+                           SIGAR_CACHE_OPEN_ADDRESSING,
+                           SIGAR_FIELD_NOTIMPL, SIGAR_FIELD_NOTIMPL);
+    sigar->proc_port_pool =
+        sigar_pool_new(sizeof(sigar_pid_t), PID_CACHE_POOL_SLAB);
+    sigar->proc_port_index->value_pool = sigar->proc_port_pool;
 
-    if (!(dirp = opendir(PROCP_FS_ROOT))) {
+    if ((proc_dir_open(sigar) < 0) ||
+        !(dirp = opendir(sigar_procfs_root_get())))
+    {
+        sigar->proc_port_index_time = 0;
         return errno;
     }
 
     while (readdir_r(dirp, &dbuf, &ent) == 0) {
         DIR *fd_dirp;
         struct dirent *fd_ent, fd_dbuf;
-        struct stat sb;
-        char fd_name[BUFSIZ], pid_name[BUFSIZ];
-        int len, slen;
+        char fd_name[UITOA_BUFFER_SIZE+4];
+        sigar_pid_t pid;
+        int fd, len;
 
         if (ent == NULL) {
             break;
@@ -2517,34 +6024,30 @@ int sigar_proc_port_get(sigar_t *sigar, int protocol,
             continue;
         }
 
-        /* sprintf(pid_name, "/proc/%s", ent->d_name) */
-        memcpy(&pid_name[0], PROCP_FS_ROOT, SSTRLEN(PROCP_FS_ROOT));
-        len = SSTRLEN(PROCP_FS_ROOT);
-        pid_name[len++] = '/';
-
-        slen = strlen(ent->d_name);
-        memcpy(&pid_name[len], ent->d_name, slen);
-        len += slen;
-        pid_name[len] = '\0';
-        
-        if (stat(pid_name, &sb) < 0) {
+        /* sprintf(fd_name, "%s/fd", ent->d_name) */
+        len = strlen(ent->d_name);
+        if (len > UITOA_BUFFER_SIZE) {
             continue;
         }
-        if (sb.st_uid != netconn.uid) {
+        memcpy(&fd_name[0], ent->d_name, len);
+        memcpy(&fd_name[len], "/fd", 4);
+
+        SIGAR_INSTRUMENT_OPEN();
+        fd = openat(sigar->proc_dirfd, fd_name, O_RDONLY|O_DIRECTORY);
+        if (fd < 0) {
             continue;
         }
-
-        /* sprintf(fd_name, "%s/fd", pid_name) */
-        memcpy(&fd_name[0], pid_name, len);
-        memcpy(&fd_name[len], "/fd", 3);
-        fd_name[len+=3] = '\0';
-
-        if (!(fd_dirp = opendir(fd_name))) {
+        if (!(fd_dirp = fdopendir(fd))) {
+            close(fd);
             continue;
         }
 
+        pid = strtoul(ent->d_name, NULL, 10);
+
         while (readdir_r(fd_dirp, &fd_dbuf, &fd_ent) == 0) {
-            char fd_ent_name[BUFSIZ];
+            sigar_cache_entry_t *entry;
+            char link[64];
+            sigar_uint64_t inode;
 
             if (fd_ent == NULL) {
                 break;
@@ -2554,24 +6057,24 @@ int sigar_proc_port_get(sigar_t *sigar, int protocol,
                 continue;
             }
 
-            /* sprintf(fd_ent_name, "%s/%s", fd_name, fd_ent->d_name) */
-            slen = strlen(fd_ent->d_name);
-            memcpy(&fd_ent_name[0], fd_name, len);
-            fd_ent_name[len] = '/';
-            memcpy(&fd_ent_name[len+1], fd_ent->d_name, slen);
-            fd_ent_name[len+1+slen] = '\0';
-
-            if (stat(fd_ent_name, &sb) < 0) {
+            len = readlinkat(fd, fd_ent->d_name, link, sizeof(link)-1);
+            if ((len <= SSTRLEN(PROC_SOCKET_LINK)) ||
+                !strnEQ(link, PROC_SOCKET_LINK, SSTRLEN(PROC_SOCKET_LINK)))
+            {
                 continue;
             }
+            link[len] = '\0';
 
-            if (sb.st_ino == netconn.inode) {
-                closedir(fd_dirp);
-                closedir(dirp);
-                *pid = strtoul(ent->d_name, NULL, 10);
-                return SIGAR_OK;
+            inode = strtoull(link + SSTRLEN(PROC_SOCKET_LINK), NULL, 10);
+
+            /* shared after fork, first one wins as before */
+            entry = sigar_cache_get(sigar->proc_port_index, inode);
+            if (!entry->value) {
+                entry->value =
+                    sigar_cache_value_new(sigar->proc_port_index,
+                                          sizeof(sigar_pid_t));
+                *(sigar_pid_t *)entry->value = pid;
             }
-            
         }
 
         closedir(fd_dirp);
@@ -2579,9 +6082,145 @@ int sigar_proc_port_get(sigar_t *sigar, int protocol,
 
     closedir(dirp);
 
+    sigar->proc_port_index_time = sigar_time_now_millis();
+
+    return SIGAR_OK;
+}
+
+static int proc_port_inode_pid(sigar_t *sigar, sigar_uint64_t inode,
+                               sigar_pid_t *pid)
+{
+    sigar_uint64_t timenow = sigar_time_now_millis();
+    sigar_cache_entry_t *entry;
+    int status;
+
+    *pid = 0;
+
+    if (inode == 0) {
+        return SIGAR_OK; /* e.g. TIME_WAIT, nobody owns it */
+    }
+
+    if (!sigar->proc_port_index_time ||
+        (timenow >= sigar->proc_port_index_time + PROC_PORT_INDEX_EXPIRE))
+    {
+        if ((status = proc_port_index_build(sigar)) != SIGAR_OK) {
+            return status;
+        }
+    }
+
+    entry = sigar_cache_find(sigar->proc_port_index, inode);
+
+    if (!entry &&
+        (timenow >= sigar->proc_port_index_time + PROC_PORT_INDEX_MISS_EXPIRE))
+    {
+        /* socket newer than the index */
+        if ((status = proc_port_index_build(sigar)) != SIGAR_OK) {
+            return status;
+        }
+        entry = sigar_cache_find(sigar->proc_port_index, inode);
+    }
+
+    if (entry) {
+        *pid = *(sigar_pid_t *)entry->value;
+    }
+
+    return SIGAR_OK;
+}
+
+int sigar_os_net_connection_pid_refresh(sigar_t *sigar)
+{
+    return proc_port_index_build(sigar);
+}
+
+int sigar_os_net_connection_pid_get(sigar_t *sigar,
+                                    sigar_net_connection_t *conn,
+                                    sigar_pid_t *pid)
+{
+    return proc_port_inode_pid(sigar, conn->inode, pid);
+}
+
+int sigar_proc_port_get(sigar_t *sigar, int protocol,
+                        unsigned long port, sigar_pid_t *pid)
+{
+    int status;
+    sigar_net_connection_t netconn;
+
+    SIGAR_ZERO(&netconn);
+    *pid = 0;
+
+    status = sigar_net_connection_get(sigar, &netconn, port,
+                                      SIGAR_NETCONN_SERVER|protocol);
+
+    if (status != SIGAR_OK) {
+        return status;
+    }
+
+    if (netconn.local_port != port) {
+        return SIGAR_OK; /* XXX or ENOENT? */
+    }
+
+    return proc_port_inode_pid(sigar, netconn.inode, pid);
+}
+
+typedef struct {
+    unsigned long *ports;
+    sigar_uint64_t *inodes;
+    int num;
+} proc_port_list_getter_t;
+
+static int proc_port_list_walker(sigar_net_connection_walker_t *walker,
+                                 sigar_net_connection_t *conn)
+{
+    proc_port_list_getter_t *getter =
+        (proc_port_list_getter_t *)walker->data;
+    int i;
+
+    if (conn->remote_port != 0) {
+        return SIGAR_OK;
+    }
+
+    for (i=0; i<getter->num; i++) {
+        if ((getter->ports[i] == conn->local_port) &&
+            (getter->inodes[i] == 0))
+        {
+            getter->inodes[i] = conn->inode;
+        }
+    }
+
     return SIGAR_OK;
 }
 
+int sigar_proc_port_list_get(sigar_t *sigar, int protocol,
+                             unsigned long *ports, int num,
+                             sigar_pid_t *pids)
+{
+    int i, status;
+    sigar_net_connection_walker_t walker;
+    proc_port_list_getter_t getter;
+
+    getter.ports = ports;
+    getter.num = num;
+    getter.inodes = calloc(num ? num : 1, sizeof(*getter.inodes));
+    if (!getter.inodes) {
+        return ENOMEM;
+    }
+
+    walker.sigar = sigar;
+    walker.flags = SIGAR_NETCONN_SERVER|protocol;
+    walker.data = &getter;
+    walker.add_connection = proc_port_list_walker;
+
+    status = sigar_net_connection_walk(&walker);
+
+    for (i=0; (status == SIGAR_OK) && (i<num); i++) {
+        status = proc_port_inode_pid(sigar, getter.inodes[i], &pids[i]);
+    }
+
+    free(getter.inodes);
+
+    return status;
+}
+
 static void generic_vendor_parse(char *line, sigar_sys_info_t *info)
 {
     char *ptr;
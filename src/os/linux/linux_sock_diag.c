@@ -0,0 +1,588 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * tcp/udp connection tables over NETLINK_SOCK_DIAG, binary records
+ * instead of formatted /proc/net/{tcp,udp}{,6} lines, with the state
+ * and port filters evaluated in the kernel.  SIGAR_ENOTIMPL means
+ * nothing was handed to the walker yet and procfs should be used.
+ * the same dump with tcp_info attached gives the byte counters of
+ * every tcp socket for sigar_proc_net_io_get.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "sigar.h"
+#include "sigar_private.h"
+#include "sigar_util.h"
+#include "sigar_os.h"
+
+#ifdef HAVE_LINUX_INET_DIAG_H
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/sock_diag.h>
+#include <linux/inet_diag.h>
+#include <linux/tcp.h>
+
+#define SOCK_DIAG_DISABLED -2
+
+/* ESTABLISHED..CLOSING, leaves out the bound-only sockets
+ * newer kernels can dump which /proc/net/tcp never shows */
+#define SOCK_DIAG_TCP_STATES 0xffe
+
+#define SOCK_DIAG_OP(op, c, y, n) \
+    (op)->code = c; (op)->yes = y; (op)->no = n
+
+typedef struct {
+    struct nlmsghdr n;
+    struct inet_diag_req_v2 r;
+    struct nlattr a;
+    struct inet_diag_bc_op ops[9];
+} sock_diag_req_t;
+
+static int sock_diag_open(sigar_t *sigar)
+{
+    int fd;
+
+    if ((sigar->sock_diag_fd == SOCK_DIAG_DISABLED) ||
+        linux_proc_mirrored(sigar))
+    {
+        return SIGAR_ENOTIMPL;
+    }
+    if (sigar->sock_diag_fd >= 0) {
+        return SIGAR_OK;
+    }
+
+    if ((fd = socket(AF_NETLINK, SOCK_RAW, NETLINK_SOCK_DIAG)) < 0) {
+        if (SIGAR_LOG_IS_DEBUG(sigar)) {
+            sigar_log_printf(sigar, SIGAR_LOG_DEBUG,
+                             "[sock_diag] falling back to procfs: %s",
+                             sigar_strerror(sigar, errno));
+        }
+        sigar->sock_diag_fd = SOCK_DIAG_DISABLED;
+        return SIGAR_ENOTIMPL;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    sigar->sock_diag_fd = fd;
+
+    return SIGAR_OK;
+}
+
+int linux_sock_diag_probe(sigar_t *sigar)
+{
+    return sock_diag_open(sigar);
+}
+
+void linux_sock_diag_close(sigar_t *sigar)
+{
+    if (sigar->sock_diag_fd >= 0) {
+        close(sigar->sock_diag_fd);
+        sigar->sock_diag_fd = -1;
+    }
+}
+
+/*
+ * sport == port, or with remote set (sport == port || dport == port).
+ * the "no" offsets happen to line up for both programs: without
+ * remote they land past the end (reject), with it they land on the
+ * dport test.  the kernel's audit only accepts "no" targets that the
+ * "yes" chain also passes through, hence the JMP instead of a long yes.
+ */
+static int sock_diag_bytecode(struct inet_diag_bc_op *ops,
+                              unsigned long port, int remote)
+{
+    SOCK_DIAG_OP(&ops[0], INET_DIAG_BC_S_GE, 8, 20);
+    SOCK_DIAG_OP(&ops[1], 0, 0, port);
+    SOCK_DIAG_OP(&ops[2], INET_DIAG_BC_S_LE, 8, 12);
+    SOCK_DIAG_OP(&ops[3], 0, 0, port);
+
+    if (!remote) {
+        return 4 * sizeof(*ops);
+    }
+
+    /* local port matched, jump to the end */
+    SOCK_DIAG_OP(&ops[4], INET_DIAG_BC_JMP, 4, 20);
+    SOCK_DIAG_OP(&ops[5], INET_DIAG_BC_D_GE, 8, 20);
+    SOCK_DIAG_OP(&ops[6], 0, 0, port);
+    SOCK_DIAG_OP(&ops[7], INET_DIAG_BC_D_LE, 8, 12);
+    SOCK_DIAG_OP(&ops[8], 0, 0, port);
+
+    return 9 * sizeof(*ops);
+}
+
+static int sock_diag_send(sigar_t *sigar, int family, int protocol,
+                          int states, int ext,
+                          unsigned long port, int remote)
+{
+    sock_diag_req_t req;
+    struct sockaddr_nl addr;
+    int rv;
+
+    memset(&req, 0, sizeof(req));
+    req.n.nlmsg_len = NLMSG_LENGTH(sizeof(req.r));
+    req.n.nlmsg_type = SOCK_DIAG_BY_FAMILY;
+    req.n.nlmsg_flags = NLM_F_REQUEST|NLM_F_DUMP;
+    req.n.nlmsg_seq = ++sigar->sock_diag_seq;
+    req.r.sdiag_family = family;
+    req.r.sdiag_protocol = protocol;
+    req.r.idiag_states = states;
+    req.r.idiag_ext = ext;
+
+    if (port) {
+        int len = sock_diag_bytecode(req.ops, port, remote);
+        req.a.nla_type = INET_DIAG_REQ_BYTECODE;
+        req.a.nla_len = NLA_HDRLEN + len;
+        req.n.nlmsg_len += NLA_ALIGN(req.a.nla_len);
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+
+    do {
+        rv = sendto(sigar->sock_diag_fd, &req, req.n.nlmsg_len, 0,
+                    (struct sockaddr *)&addr, sizeof(addr));
+    } while ((rv < 0) && (errno == EINTR));
+
+    return (rv < 0) ? errno : SIGAR_OK;
+}
+
+static void sock_diag_conn_set(sigar_net_connection_t *conn,
+                               struct inet_diag_msg *msg)
+{
+    if (msg->idiag_family == AF_INET6) {
+        memcpy(conn->local_address.addr.in6, msg->id.idiag_src,
+               sizeof(conn->local_address.addr.in6));
+        memcpy(conn->remote_address.addr.in6, msg->id.idiag_dst,
+               sizeof(conn->remote_address.addr.in6));
+        conn->local_address.family =
+            conn->remote_address.family = SIGAR_AF_INET6;
+    }
+    else {
+        conn->local_address.addr.in = msg->id.idiag_src[0];
+        conn->remote_address.addr.in = msg->id.idiag_dst[0];
+        conn->local_address.family =
+            conn->remote_address.family = SIGAR_AF_INET;
+    }
+
+    /* SIGAR_TCP_* currently matches TCP_* in linux/tcp.h */
+    conn->state = msg->idiag_state;
+
+    /* procfs reports the accept backlog as rx and nothing as tx */
+    if ((conn->type == SIGAR_NETCONN_TCP) &&
+        (conn->state == SIGAR_TCP_LISTEN))
+    {
+        conn->send_queue = 0;
+    }
+    else {
+        conn->send_queue = msg->idiag_wqueue;
+    }
+    conn->receive_queue = msg->idiag_rqueue;
+    conn->uid = msg->idiag_uid;
+    conn->inode = msg->idiag_inode;
+}
+
+/*
+ * reads the dump answering the last sock_diag_send, each record goes
+ * to handler.  if the handler breaks the loop the rest of the dump is
+ * dropped along with the socket, same as proc_net_read stopping at
+ * that line and moving on to the next file.
+ */
+typedef int (*sock_diag_handler_t)(void *data, struct inet_diag_msg *msg,
+                                   int len);
+
+static int sock_diag_recv(sigar_t *sigar,
+                          sock_diag_handler_t handler, void *data)
+{
+    char buffer[8192];
+    int status;
+
+    while (1) {
+        struct nlmsghdr *nlh = (struct nlmsghdr *)buffer;
+        int len = recv(sigar->sock_diag_fd, buffer, sizeof(buffer), 0);
+
+        if (len < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            status = errno;
+            linux_sock_diag_close(sigar);
+            return status;
+        }
+        if (len == 0) {
+            linux_sock_diag_close(sigar);
+            return EIO;
+        }
+
+        for (; NLMSG_OK(nlh, len); nlh = NLMSG_NEXT(nlh, len)) {
+            if (nlh->nlmsg_seq != sigar->sock_diag_seq) {
+                continue;
+            }
+            if (nlh->nlmsg_type == NLMSG_DONE) {
+                return SIGAR_OK;
+            }
+            if (nlh->nlmsg_type == NLMSG_ERROR) {
+                struct nlmsgerr *err = NLMSG_DATA(nlh);
+                status = err->error ? -err->error : EIO;
+                linux_sock_diag_close(sigar);
+                return status;
+            }
+            if (nlh->nlmsg_type != SOCK_DIAG_BY_FAMILY) {
+                continue;
+            }
+
+            if (handler(data, NLMSG_DATA(nlh),
+                        nlh->nlmsg_len - NLMSG_LENGTH(0)) != SIGAR_OK)
+            {
+                linux_sock_diag_close(sigar);
+                return SIGAR_OK;
+            }
+        }
+    }
+}
+
+typedef struct {
+    sigar_net_connection_walker_t *walker;
+    int type;
+    int *count; /* bumped for every record handed to the walker */
+} sock_diag_conn_walk_t;
+
+static int sock_diag_conn_add(void *data, struct inet_diag_msg *msg,
+                              int len)
+{
+    sock_diag_conn_walk_t *walk = data;
+    sigar_net_connection_walker_t *walker = walk->walker;
+    int flags = walker->flags;
+    sigar_net_connection_t conn;
+
+    conn.local_port = ntohs(msg->id.idiag_sport);
+    conn.remote_port = ntohs(msg->id.idiag_dport);
+
+    if (!((conn.remote_port && (flags & SIGAR_NETCONN_CLIENT)) ||
+          (!conn.remote_port && (flags & SIGAR_NETCONN_SERVER))))
+    {
+        return SIGAR_OK;
+    }
+
+    conn.type = walk->type;
+    sock_diag_conn_set(&conn, msg);
+
+    (*walk->count)++;
+
+    return walker->add_connection(walker, &conn);
+}
+
+/* one family's dump */
+static int sock_diag_dump(sigar_net_connection_walker_t *walker,
+                          int type, int family, int states,
+                          unsigned long port, int remote,
+                          int *count)
+{
+    sigar_t *sigar = walker->sigar;
+    int protocol =
+        (type == SIGAR_NETCONN_TCP) ? IPPROTO_TCP : IPPROTO_UDP;
+    sock_diag_conn_walk_t walk;
+    int status;
+
+    status = sock_diag_send(sigar, family, protocol,
+                            states, 0, port, remote);
+    if (status != SIGAR_OK) {
+        linux_sock_diag_close(sigar);
+        return status;
+    }
+
+    walk.walker = walker;
+    walk.type = type;
+    walk.count = count;
+
+    return sock_diag_recv(sigar, sock_diag_conn_add, &walk);
+}
+
+int linux_sock_diag_walk(sigar_net_connection_walker_t *walker,
+                         int type, unsigned long port, int remote)
+{
+    sigar_t *sigar = walker->sigar;
+    int flags = walker->flags;
+    int states, status, count = 0;
+
+    if (type == SIGAR_NETCONN_TCP) {
+        states = SOCK_DIAG_TCP_STATES;
+
+        if (!(flags & SIGAR_NETCONN_CLIENT)) {
+            states = 1 << SIGAR_TCP_LISTEN;
+        }
+        else if (!(flags & SIGAR_NETCONN_SERVER)) {
+            states &= ~(1 << SIGAR_TCP_LISTEN);
+        }
+    }
+    else {
+        states = ~0;
+    }
+
+    if ((status = sock_diag_open(sigar)) != SIGAR_OK) {
+        return status;
+    }
+
+    status = sock_diag_dump(walker, type, AF_INET, states,
+                            port, remote, &count);
+
+    if (status != SIGAR_OK) {
+        if (count == 0) {
+            /* e.g. udp_diag not available */
+            if (SIGAR_LOG_IS_DEBUG(sigar)) {
+                sigar_log_printf(sigar, SIGAR_LOG_DEBUG,
+                                 "[sock_diag] falling back to procfs: %s",
+                                 sigar_strerror(sigar, status));
+            }
+            return SIGAR_ENOTIMPL;
+        }
+        return status;
+    }
+
+    if ((status = sock_diag_open(sigar)) != SIGAR_OK) {
+        return SIGAR_OK;
+    }
+
+    status = sock_diag_dump(walker, type, AF_INET6, states,
+                            port, remote, &count);
+
+    /* no ipv6, same as a missing /proc/net/tcp6 */
+    if ((status == ENOENT) || (status == EAFNOSUPPORT) ||
+        (status == EINVAL))
+    {
+        return SIGAR_OK;
+    }
+
+    return status;
+}
+
+typedef struct {
+    sigar_t *sigar;
+    sigar_net_stat_t *netstat;
+    int flags;
+} sock_diag_net_stat_t;
+
+/* state and ports only, the addresses are read for listeners alone */
+static int sock_diag_net_stat_add(void *data, struct inet_diag_msg *msg,
+                                  int len)
+{
+    sock_diag_net_stat_t *stat = data;
+    sigar_net_stat_t *netstat = stat->netstat;
+    int state = msg->idiag_state;
+
+    if (!((msg->id.idiag_dport && (stat->flags & SIGAR_NETCONN_CLIENT)) ||
+          (!msg->id.idiag_dport && (stat->flags & SIGAR_NETCONN_SERVER))))
+    {
+        return SIGAR_OK;
+    }
+    if (state >= SIGAR_TCP_UNKNOWN) {
+        return SIGAR_OK;
+    }
+
+    netstat->tcp_states[state]++;
+
+    if (state == SIGAR_TCP_LISTEN) {
+        sigar_net_connection_t conn;
+
+        conn.type = SIGAR_NETCONN_TCP;
+        conn.local_port = ntohs(msg->id.idiag_sport);
+        conn.remote_port = 0;
+        sock_diag_conn_set(&conn, msg);
+        sigar_net_listen_address_add(stat->sigar, &conn);
+    }
+    /* listeners come first in the dump, same as the walk relies on */
+    else if (sigar_cache_find(stat->sigar->net_listen,
+                              ntohs(msg->id.idiag_sport)))
+    {
+        netstat->tcp_inbound_total++;
+    }
+    else {
+        netstat->tcp_outbound_total++;
+    }
+
+    return SIGAR_OK;
+}
+
+int linux_sock_diag_net_stat(sigar_t *sigar, sigar_net_stat_t *netstat,
+                             int flags)
+{
+    static const int families[] = { AF_INET, AF_INET6 };
+    sock_diag_net_stat_t stat;
+    int i, states, status;
+
+    /* udp is not counted by the walk either */
+    if (flags & SIGAR_NETCONN_TCP) {
+        states = SOCK_DIAG_TCP_STATES;
+
+        if (!(flags & SIGAR_NETCONN_CLIENT)) {
+            states = 1 << SIGAR_TCP_LISTEN;
+        }
+        else if (!(flags & SIGAR_NETCONN_SERVER)) {
+            states &= ~(1 << SIGAR_TCP_LISTEN);
+        }
+    }
+    else {
+        return SIGAR_OK;
+    }
+
+    stat.sigar = sigar;
+    stat.netstat = netstat;
+    stat.flags = flags;
+
+    for (i=0; i<sizeof(families)/sizeof(families[0]); i++) {
+        if ((status = sock_diag_open(sigar)) != SIGAR_OK) {
+            return status;
+        }
+
+        status = sock_diag_send(sigar, families[i], IPPROTO_TCP,
+                                states, 0, 0, 0);
+        if (status == SIGAR_OK) {
+            status = sock_diag_recv(sigar, sock_diag_net_stat_add, &stat);
+        }
+        else {
+            linux_sock_diag_close(sigar);
+        }
+
+        if (status != SIGAR_OK) {
+            if ((i > 0) &&
+                ((status == ENOENT) || (status == EAFNOSUPPORT) ||
+                 (status == EINVAL)))
+            {
+                break;
+            }
+            return status;
+        }
+    }
+
+    netstat->all_inbound_total = netstat->tcp_inbound_total;
+    netstat->all_outbound_total = netstat->tcp_outbound_total;
+
+    return SIGAR_OK;
+}
+
+/* inode -> byte counters of the socket, from its INET_DIAG_INFO */
+static int sock_diag_bytes_add(void *data, struct inet_diag_msg *msg,
+                               int len)
+{
+    sigar_cache_t *bytes = data;
+    struct rtattr *rta = (struct rtattr *)(msg + 1);
+    sigar_cache_entry_t *entry;
+    linux_sock_bytes_t *sb;
+    struct tcp_info *info;
+
+    if (msg->idiag_inode == 0) {
+        return SIGAR_OK; /* e.g. TIME_WAIT, nobody owns it */
+    }
+
+    len -= NLMSG_ALIGN(sizeof(*msg));
+
+    for (; RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+        if (rta->rta_type != INET_DIAG_INFO) {
+            continue;
+        }
+        /* kernels before 4.2 stop short of the byte counters */
+        if (RTA_PAYLOAD(rta) <
+            sigar_offsetof(struct tcp_info, tcpi_bytes_received) +
+            sizeof(info->tcpi_bytes_received))
+        {
+            return SIGAR_OK;
+        }
+        info = RTA_DATA(rta);
+
+        entry = sigar_cache_get(bytes, msg->idiag_inode);
+        if (!(sb = entry->value)) {
+            entry->value = sb = sigar_cache_value_new(bytes, sizeof(*sb));
+        }
+        sb->sent = info->tcpi_bytes_acked;
+        sb->received = info->tcpi_bytes_received;
+        break;
+    }
+
+    return SIGAR_OK;
+}
+
+int linux_sock_diag_tcp_bytes(sigar_t *sigar, sigar_cache_t *bytes)
+{
+    static const int families[] = { AF_INET, AF_INET6 };
+    int i, status;
+
+    for (i=0; i<sizeof(families)/sizeof(families[0]); i++) {
+        if ((status = sock_diag_open(sigar)) != SIGAR_OK) {
+            return status;
+        }
+
+        /* listeners move no data */
+        status = sock_diag_send(sigar, families[i], IPPROTO_TCP,
+                                SOCK_DIAG_TCP_STATES &
+                                ~(1 << SIGAR_TCP_LISTEN),
+                                1 << (INET_DIAG_INFO - 1), 0, 0);
+        if (status == SIGAR_OK) {
+            status = sock_diag_recv(sigar, sock_diag_bytes_add, bytes);
+        }
+        else {
+            linux_sock_diag_close(sigar);
+        }
+
+        if (status != SIGAR_OK) {
+            /* no ipv6, same as a missing /proc/net/tcp6 */
+            if ((i > 0) &&
+                ((status == ENOENT) || (status == EAFNOSUPPORT) ||
+                 (status == EINVAL)))
+            {
+                return SIGAR_OK;
+            }
+            return status;
+        }
+    }
+
+    return SIGAR_OK;
+}
+
+#else /* !HAVE_LINUX_INET_DIAG_H */
+
+int linux_sock_diag_probe(sigar_t *sigar)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+int linux_sock_diag_walk(sigar_net_connection_walker_t *walker,
+                         int type, unsigned long port, int remote)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+void linux_sock_diag_close(sigar_t *sigar)
+{
+}
+
+int linux_sock_diag_tcp_bytes(sigar_t *sigar, sigar_cache_t *bytes)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+int linux_sock_diag_net_stat(sigar_t *sigar, sigar_net_stat_t *netstat,
+                             int flags)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+#endif /* HAVE_LINUX_INET_DIAG_H */
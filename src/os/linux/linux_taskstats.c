@@ -0,0 +1,433 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * per-process cpu times over the TASKSTATS generic netlink family,
+ * binary and in usecs instead of ticks parsed out of /proc/<pid>/stat.
+ * opt-in with SIGAR_PROC_TASKSTATS=1, anything that goes wrong here
+ * other than the process itself being gone falls back to procfs.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sigar.h"
+#include "sigar_private.h"
+#include "sigar_util.h"
+#include "sigar_os.h"
+
+#ifdef HAVE_LINUX_TASKSTATS_H
+
+#include <sys/socket.h>
+#include <linux/genetlink.h>
+#include <linux/netlink.h>
+#include <linux/taskstats.h>
+
+#define TASKSTATS_UNKNOWN -1
+#define TASKSTATS_DISABLED -2
+
+/* requests in flight per send, two per pid */
+#define TASKSTATS_BATCH 64
+
+#define NLA_DATA(na) \
+    ((void *)((char *)(na) + NLA_HDRLEN))
+
+#define NLA_NEXT(na) \
+    ((struct nlattr *)((char *)(na) + NLA_ALIGN((na)->nla_len)))
+
+#define NLA_OK(na, len) \
+    (((len) >= (int)sizeof(struct nlattr)) && \
+     ((na)->nla_len >= sizeof(struct nlattr)) && \
+     ((na)->nla_len <= (len)))
+
+#define GENLMSG_ATTRS(nlh) \
+    ((struct nlattr *)((char *)NLMSG_DATA(nlh) + GENL_HDRLEN))
+
+#define GENLMSG_ATTRLEN(nlh) \
+    ((int)(nlh)->nlmsg_len - NLMSG_HDRLEN - GENL_HDRLEN)
+
+typedef struct {
+    struct nlmsghdr n;
+    struct genlmsghdr g;
+    char buf[64];
+} taskstats_msg_t;
+
+static void taskstats_msg_init(taskstats_msg_t *msg, int type,
+                               int cmd, int version,
+                               sigar_uint32_t seq)
+{
+    memset(msg, 0, sizeof(*msg));
+    msg->n.nlmsg_len = NLMSG_LENGTH(GENL_HDRLEN);
+    msg->n.nlmsg_type = type;
+    msg->n.nlmsg_flags = NLM_F_REQUEST;
+    msg->n.nlmsg_seq = seq;
+    msg->n.nlmsg_pid = 0;
+    msg->g.cmd = cmd;
+    msg->g.version = version;
+}
+
+static void taskstats_msg_attr(taskstats_msg_t *msg, int type,
+                               const void *data, int len)
+{
+    struct nlattr *na =
+        (struct nlattr *)((char *)&msg->n + NLMSG_ALIGN(msg->n.nlmsg_len));
+
+    na->nla_type = type;
+    na->nla_len = NLA_HDRLEN + len;
+    memcpy(NLA_DATA(na), data, len);
+    msg->n.nlmsg_len = NLMSG_ALIGN(msg->n.nlmsg_len) + NLA_ALIGN(na->nla_len);
+}
+
+static int taskstats_send(int fd, void *buf, int len)
+{
+    struct sockaddr_nl addr;
+    char *ptr = buf;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+
+    while (len > 0) {
+        int rv = sendto(fd, ptr, len, 0,
+                        (struct sockaddr *)&addr, sizeof(addr));
+        if (rv < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno;
+        }
+        ptr += rv;
+        len -= rv;
+    }
+
+    return SIGAR_OK;
+}
+
+static int taskstats_family_get(int fd)
+{
+    taskstats_msg_t msg;
+    char reply[1024];
+    struct nlmsghdr *nlh = (struct nlmsghdr *)reply;
+    struct nlattr *na;
+    int len;
+
+    taskstats_msg_init(&msg, GENL_ID_CTRL, CTRL_CMD_GETFAMILY, 1, 0);
+    taskstats_msg_attr(&msg, CTRL_ATTR_FAMILY_NAME,
+                       TASKSTATS_GENL_NAME, sizeof(TASKSTATS_GENL_NAME));
+
+    if (taskstats_send(fd, &msg, msg.n.nlmsg_len) != SIGAR_OK) {
+        return -1;
+    }
+
+    len = recv(fd, reply, sizeof(reply), 0);
+    if ((len < 0) || !NLMSG_OK(nlh, len) ||
+        (nlh->nlmsg_type == NLMSG_ERROR))
+    {
+        return -1;
+    }
+
+    len = GENLMSG_ATTRLEN(nlh);
+    for (na = GENLMSG_ATTRS(nlh); NLA_OK(na, len);
+         len -= NLA_ALIGN(na->nla_len), na = NLA_NEXT(na))
+    {
+        if (na->nla_type == CTRL_ATTR_FAMILY_ID) {
+            return *(__u16 *)NLA_DATA(na);
+        }
+    }
+
+    return -1;
+}
+
+static int taskstats_open(sigar_t *sigar)
+{
+    struct sockaddr_nl addr;
+    int fd;
+
+    if ((sigar->taskstats_family == TASKSTATS_DISABLED) ||
+        linux_proc_mirrored(sigar))
+    {
+        return SIGAR_ENOTIMPL;
+    }
+    if (sigar->taskstats_fd >= 0) {
+        return SIGAR_OK;
+    }
+
+    if (!getenv("SIGAR_PROC_TASKSTATS") ||
+        ((fd = socket(AF_NETLINK, SOCK_RAW, NETLINK_GENERIC)) < 0))
+    {
+        sigar->taskstats_family = TASKSTATS_DISABLED;
+        return SIGAR_ENOTIMPL;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+
+    if ((bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) ||
+        ((sigar->taskstats_family = taskstats_family_get(fd)) < 0))
+    {
+        close(fd);
+        sigar->taskstats_family = TASKSTATS_DISABLED;
+        return SIGAR_ENOTIMPL;
+    }
+
+    sigar->taskstats_fd = fd;
+
+    return SIGAR_OK;
+}
+
+int linux_taskstats_probe(sigar_t *sigar)
+{
+    return taskstats_open(sigar);
+}
+
+void linux_taskstats_close(sigar_t *sigar)
+{
+    if (sigar->taskstats_fd >= 0) {
+        close(sigar->taskstats_fd);
+        sigar->taskstats_fd = -1;
+    }
+}
+
+static void taskstats_disable(sigar_t *sigar, int status)
+{
+    if (SIGAR_LOG_IS_DEBUG(sigar)) {
+        sigar_log_printf(sigar, SIGAR_LOG_DEBUG,
+                         "[taskstats] falling back to procfs: %s",
+                         sigar_strerror(sigar, status));
+    }
+    linux_taskstats_close(sigar);
+    sigar->taskstats_family = TASKSTATS_DISABLED;
+}
+
+/* copy out the nested stats, older kernels send a shorter struct */
+static int taskstats_reply_parse(struct nlmsghdr *nlh,
+                                 struct taskstats *stats)
+{
+    struct nlattr *na;
+    int len = GENLMSG_ATTRLEN(nlh);
+
+    for (na = GENLMSG_ATTRS(nlh); NLA_OK(na, len);
+         len -= NLA_ALIGN(na->nla_len), na = NLA_NEXT(na))
+    {
+        struct nlattr *nested;
+        int nlen;
+
+        if ((na->nla_type != TASKSTATS_TYPE_AGGR_PID) &&
+            (na->nla_type != TASKSTATS_TYPE_AGGR_TGID))
+        {
+            continue;
+        }
+
+        nlen = na->nla_len - NLA_HDRLEN;
+        for (nested = NLA_DATA(na); NLA_OK(nested, nlen);
+             nlen -= NLA_ALIGN(nested->nla_len), nested = NLA_NEXT(nested))
+        {
+            if (nested->nla_type == TASKSTATS_TYPE_STATS) {
+                int size = nested->nla_len - NLA_HDRLEN;
+
+                if (size > sizeof(*stats)) {
+                    size = sizeof(*stats);
+                }
+                memset(stats, 0, sizeof(*stats));
+                memcpy(stats, NLA_DATA(nested), size);
+                return SIGAR_OK;
+            }
+        }
+    }
+
+    return ENOENT;
+}
+
+/*
+ * for each pid ask for the thread group (so cpu time of all threads
+ * is summed) and the leader task (which carries the begin time), all
+ * requests are sent before any reply is read.
+ */
+static int taskstats_batch(sigar_t *sigar, sigar_pid_t *pids, int num,
+                           sigar_proc_time_t *times, int *statuses)
+{
+    taskstats_msg_t msg;
+    struct taskstats *tgid_stats, *pid_stats;
+    char reply[2048];
+    char req[sizeof(msg) * TASKSTATS_BATCH * 2];
+    int i, len = 0, pending, status;
+    sigar_uint32_t seq = ++sigar->taskstats_seq * (TASKSTATS_BATCH * 2);
+
+    if (!(tgid_stats = calloc(num * 2, sizeof(*tgid_stats)))) {
+        return ENOMEM;
+    }
+    pid_stats = tgid_stats + num;
+
+    for (i=0; i<num; i++) {
+        sigar_uint32_t id = pids[i];
+
+        taskstats_msg_init(&msg, sigar->taskstats_family,
+                           TASKSTATS_CMD_GET, TASKSTATS_GENL_VERSION,
+                           seq + (i*2));
+        taskstats_msg_attr(&msg, TASKSTATS_CMD_ATTR_TGID, &id, sizeof(id));
+        memcpy(req + len, &msg, msg.n.nlmsg_len);
+        len += NLMSG_ALIGN(msg.n.nlmsg_len);
+
+        taskstats_msg_init(&msg, sigar->taskstats_family,
+                           TASKSTATS_CMD_GET, TASKSTATS_GENL_VERSION,
+                           seq + (i*2) + 1);
+        taskstats_msg_attr(&msg, TASKSTATS_CMD_ATTR_PID, &id, sizeof(id));
+        memcpy(req + len, &msg, msg.n.nlmsg_len);
+        len += NLMSG_ALIGN(msg.n.nlmsg_len);
+
+        statuses[i] = SIGAR_OK;
+    }
+
+    if ((status = taskstats_send(sigar->taskstats_fd, req, len)) != SIGAR_OK) {
+        free(tgid_stats);
+        return status;
+    }
+
+    for (pending = num * 2; pending > 0;) {
+        struct nlmsghdr *nlh = (struct nlmsghdr *)reply;
+        int rlen = recv(sigar->taskstats_fd, reply, sizeof(reply), 0);
+
+        if (rlen < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            free(tgid_stats);
+            return errno;
+        }
+
+        for (; NLMSG_OK(nlh, rlen); nlh = NLMSG_NEXT(nlh, rlen)) {
+            sigar_uint32_t ix = nlh->nlmsg_seq - seq;
+
+            if (ix >= (sigar_uint32_t)(num * 2)) {
+                continue; /* stale reply from an earlier batch */
+            }
+            pending--;
+
+            if (nlh->nlmsg_type == NLMSG_ERROR) {
+                struct nlmsgerr *err = NLMSG_DATA(nlh);
+                status = -err->error;
+
+                if ((status == EPERM) || (status == EACCES)) {
+                    free(tgid_stats);
+                    return status;
+                }
+                statuses[ix/2] = status ? status : ESRCH;
+                continue;
+            }
+
+            status = taskstats_reply_parse(nlh, (ix % 2) ?
+                                           &pid_stats[ix/2] :
+                                           &tgid_stats[ix/2]);
+            if (status != SIGAR_OK) {
+                statuses[ix/2] = status;
+            }
+        }
+    }
+
+    for (i=0; i<num; i++) {
+        struct taskstats *ts = &tgid_stats[i];
+        sigar_uint64_t btime;
+
+        if (statuses[i] != SIGAR_OK) {
+            continue;
+        }
+
+#if TASKSTATS_VERSION >= 12
+        btime = pid_stats[i].version >= 12 ?
+            pid_stats[i].ac_btime64 : pid_stats[i].ac_btime;
+#else
+        btime = pid_stats[i].ac_btime;
+#endif
+
+        times[i].user = ts->ac_utime / 1000;
+        times[i].sys = ts->ac_stime / 1000;
+        times[i].total = times[i].user + times[i].sys;
+        times[i].start_time = btime * 1000;
+    }
+
+    free(tgid_stats);
+
+    return SIGAR_OK;
+}
+
+int linux_taskstats_proc_time_list(sigar_t *sigar, sigar_pid_t *pids,
+                                   int num, sigar_proc_time_t *times,
+                                   int *statuses)
+{
+    int i, status;
+
+    if ((status = taskstats_open(sigar)) != SIGAR_OK) {
+        return status;
+    }
+
+    for (i=0; i<num; i += TASKSTATS_BATCH) {
+        int n = num - i;
+
+        if (n > TASKSTATS_BATCH) {
+            n = TASKSTATS_BATCH;
+        }
+
+        status = taskstats_batch(sigar, pids + i, n,
+                                 times + i, statuses + i);
+        if (status == ENOMEM) {
+            return status; /* nothing wrong with taskstats itself */
+        }
+        else if (status != SIGAR_OK) {
+            /* unprivileged or the socket is hosed, procfs from now on */
+            taskstats_disable(sigar, status);
+            return SIGAR_ENOTIMPL;
+        }
+    }
+
+    return SIGAR_OK;
+}
+
+int linux_taskstats_proc_time_get(sigar_t *sigar, sigar_pid_t pid,
+                                  sigar_proc_time_t *proctime)
+{
+    int status, pid_status;
+
+    status = linux_taskstats_proc_time_list(sigar, &pid, 1,
+                                            proctime, &pid_status);
+
+    return (status == SIGAR_OK) ? pid_status : status;
+}
+
+#else /* !HAVE_LINUX_TASKSTATS_H */
+
+int linux_taskstats_probe(sigar_t *sigar)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+void linux_taskstats_close(sigar_t *sigar)
+{
+}
+
+int linux_taskstats_proc_time_list(sigar_t *sigar, sigar_pid_t *pids,
+                                   int num, sigar_proc_time_t *times,
+                                   int *statuses)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+int linux_taskstats_proc_time_get(sigar_t *sigar, sigar_pid_t pid,
+                                  sigar_proc_time_t *proctime)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+#endif /* HAVE_LINUX_TASKSTATS_H */
@@ -0,0 +1,363 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * batched /proc/<pid>/<file> reads over io_uring for the snapshot
+ * loop: each file is an openat, read, close chain on a direct
+ * descriptor, a whole batch of them goes in and comes back with one
+ * io_uring_enter rather than three syscalls a file.  procfs reads
+ * cannot be done nonblocking, so the kernel hands them to its io-wq
+ * workers: fewer transitions, but not faster on a box with few cores.
+ * opt-in with SIGAR_PROC_URING=1, probed on first use; whatever the
+ * ring cannot do is left SIGAR_ENOTIMPL for the pread path.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sigar.h"
+#include "sigar_private.h"
+#include "sigar_util.h"
+#include "sigar_os.h"
+
+#if defined(HAVE_LINUX_IO_URING_H)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+#if defined(HAVE_LINUX_IO_URING_H) && defined(__NR_io_uring_setup) && \
+    defined(IORING_FEAT_LINKED_FILE) && defined(__ATOMIC_ACQUIRE)
+
+/* stat, statm, io and status of any process fit */
+#define URING_BUFSIZ 4096
+
+/* sqes per file */
+#define URING_CHAIN 3
+
+#define URING_OP_OPEN  0
+#define URING_OP_READ  1
+#define URING_OP_CLOSE 2
+
+struct linux_uring_t {
+    int fd; /* -1 when the probe failed */
+    int fixed_bufs;
+    void *ring;
+    size_t ring_size;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+    unsigned int *sq_tail, *sq_mask, *sq_array;
+    unsigned int *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_cqe *cqes;
+    char *bufs; /* LINUX_URING_BATCH * URING_BUFSIZ */
+};
+
+static int uring_setup(linux_uring_t *uring)
+{
+    struct io_uring_params params;
+    struct iovec iov;
+    int fds[LINUX_URING_BATCH];
+    char *ring;
+    int i;
+
+    memset(&params, 0, sizeof(params));
+    uring->fd = syscall(__NR_io_uring_setup,
+                        LINUX_URING_BATCH * URING_CHAIN, &params);
+    if (uring->fd < 0) {
+        return errno; /* ENOSYS, or disabled by sysctl or seccomp */
+    }
+
+    /*
+     * a read on the direct descriptor its linked openat installs
+     * needs the file looked up at issue time, 5.18+
+     */
+    if (!(params.features & IORING_FEAT_LINKED_FILE) ||
+        !(params.features & IORING_FEAT_SINGLE_MMAP))
+    {
+        return SIGAR_ENOTIMPL;
+    }
+
+    uring->ring_size = params.sq_off.array +
+        params.sq_entries * sizeof(unsigned int);
+    if (uring->ring_size < (params.cq_off.cqes +
+                            params.cq_entries * sizeof(struct io_uring_cqe)))
+    {
+        uring->ring_size = params.cq_off.cqes +
+            params.cq_entries * sizeof(struct io_uring_cqe);
+    }
+    uring->ring = mmap(NULL, uring->ring_size, PROT_READ|PROT_WRITE,
+                       MAP_SHARED|MAP_POPULATE, uring->fd,
+                       IORING_OFF_SQ_RING);
+    if (uring->ring == MAP_FAILED) {
+        uring->ring = NULL;
+        return errno;
+    }
+
+    uring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    uring->sqes = mmap(NULL, uring->sqes_size, PROT_READ|PROT_WRITE,
+                       MAP_SHARED|MAP_POPULATE, uring->fd,
+                       IORING_OFF_SQES);
+    if (uring->sqes == MAP_FAILED) {
+        uring->sqes = NULL;
+        return errno;
+    }
+
+    ring = uring->ring;
+    uring->sq_tail  = (unsigned int *)(ring + params.sq_off.tail);
+    uring->sq_mask  = (unsigned int *)(ring + params.sq_off.ring_mask);
+    uring->sq_array = (unsigned int *)(ring + params.sq_off.array);
+    uring->cq_head  = (unsigned int *)(ring + params.cq_off.head);
+    uring->cq_tail  = (unsigned int *)(ring + params.cq_off.tail);
+    uring->cq_mask  = (unsigned int *)(ring + params.cq_off.ring_mask);
+    uring->cqes = (struct io_uring_cqe *)(ring + params.cq_off.cqes);
+
+    /* a sparse table, the openats fill it and the closes empty it */
+    for (i=0; i<LINUX_URING_BATCH; i++) {
+        fds[i] = -1;
+    }
+    if (syscall(__NR_io_uring_register, uring->fd, IORING_REGISTER_FILES,
+                fds, LINUX_URING_BATCH) < 0)
+    {
+        return errno;
+    }
+
+    if (!(uring->bufs = malloc(LINUX_URING_BATCH * URING_BUFSIZ))) {
+        return ENOMEM;
+    }
+
+    /* pinned reads if RLIMIT_MEMLOCK allows, plain ones otherwise */
+    iov.iov_base = uring->bufs;
+    iov.iov_len = LINUX_URING_BATCH * URING_BUFSIZ;
+    uring->fixed_bufs =
+        syscall(__NR_io_uring_register, uring->fd, IORING_REGISTER_BUFFERS,
+                &iov, 1) == 0;
+
+    return SIGAR_OK;
+}
+
+static void uring_free(linux_uring_t *uring)
+{
+    if (uring->sqes) {
+        munmap(uring->sqes, uring->sqes_size);
+    }
+    if (uring->ring) {
+        munmap(uring->ring, uring->ring_size);
+    }
+    if (uring->fd >= 0) {
+        close(uring->fd);
+    }
+    free(uring->bufs);
+    free(uring);
+}
+
+int linux_uring_open(sigar_t *sigar)
+{
+    linux_uring_t *uring;
+    int status;
+
+    if (sigar->uring) {
+        return sigar->uring->fd >= 0 ? SIGAR_OK : SIGAR_ENOTIMPL;
+    }
+
+    if (!(uring = sigar->uring = calloc(1, sizeof(*uring)))) {
+        return ENOMEM;
+    }
+    uring->fd = -1;
+
+    if (!getenv("SIGAR_PROC_URING")) {
+        return SIGAR_ENOTIMPL;
+    }
+
+    if ((status = uring_setup(uring)) != SIGAR_OK) {
+        if (SIGAR_LOG_IS_DEBUG(sigar)) {
+            sigar_log_printf(sigar, SIGAR_LOG_DEBUG,
+                             "[uring] not used: %s",
+                             sigar_strerror(sigar, status));
+        }
+        uring_free(uring);
+        /* keep an empty one so the probe is not repeated */
+        if ((uring = sigar->uring = calloc(1, sizeof(*uring)))) {
+            uring->fd = -1;
+        }
+        return SIGAR_ENOTIMPL;
+    }
+
+    return SIGAR_OK;
+}
+
+void linux_uring_close(sigar_t *sigar)
+{
+    if (sigar->uring) {
+        uring_free(sigar->uring);
+        sigar->uring = NULL;
+    }
+}
+
+static struct io_uring_sqe *uring_sqe(linux_uring_t *uring,
+                                      unsigned int tail, int opcode,
+                                      int slot, int op)
+{
+    unsigned int index = tail & *uring->sq_mask;
+    struct io_uring_sqe *sqe = &uring->sqes[index];
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->user_data = (sigar_uint64_t)slot * URING_CHAIN + op;
+    uring->sq_array[index] = index;
+
+    return sqe;
+}
+
+static void uring_complete(linux_uring_t *uring, linux_proc_read_t *reads,
+                           struct io_uring_cqe *cqe)
+{
+    int slot = (int)(cqe->user_data / URING_CHAIN);
+    int op = (int)(cqe->user_data % URING_CHAIN);
+    linux_proc_read_t *file = &reads[slot];
+    int res = cqe->res;
+
+    if (op == URING_OP_OPEN) {
+        if (res < 0) {
+            file->status = (res == -ENOENT) ? ESRCH : -res;
+        }
+    }
+    else if ((op == URING_OP_READ) && (file->status == SIGAR_ENOTIMPL)) {
+        if (res == 0) {
+            file->status = ESRCH; /* task is gone */
+        }
+        else if ((res > 0) && (res < URING_BUFSIZ-1)) {
+            file->data[res] = '\0';
+            file->status = SIGAR_OK;
+        }
+        else if ((res < 0) && (res != -ECANCELED)) {
+            file->status = -res;
+        }
+        /* else truncated, left for pread with the big buffer */
+    }
+}
+
+int linux_uring_read(sigar_t *sigar, linux_proc_read_t *reads, int number)
+{
+    linux_uring_t *uring = sigar->uring;
+    unsigned int tail, head;
+    int i, submit, pending, status = SIGAR_OK;
+
+    if (!uring || (uring->fd < 0) || (sigar->proc_dirfd < 0)) {
+        return SIGAR_ENOTIMPL;
+    }
+    if (number > LINUX_URING_BATCH) {
+        number = LINUX_URING_BATCH;
+    }
+
+    tail = *uring->sq_tail;
+
+    for (i=0; i<number; i++) {
+        linux_proc_read_t *file = &reads[i];
+        struct io_uring_sqe *sqe;
+
+        file->status = SIGAR_ENOTIMPL;
+        file->data = uring->bufs + (i * URING_BUFSIZ);
+
+        sqe = uring_sqe(uring, tail++, IORING_OP_OPENAT, i, URING_OP_OPEN);
+        sqe->fd = sigar->proc_dirfd;
+        sqe->addr = (sigar_uint64_t)(unsigned long)file->path;
+        sqe->open_flags = O_RDONLY; /* no O_CLOEXEC on a direct one */
+        sqe->file_index = i + 1;
+        sqe->flags = IOSQE_IO_LINK;
+
+        sqe = uring_sqe(uring, tail++,
+                        uring->fixed_bufs ?
+                        IORING_OP_READ_FIXED : IORING_OP_READ,
+                        i, URING_OP_READ);
+        sqe->fd = i;
+        sqe->addr = (sigar_uint64_t)(unsigned long)file->data;
+        sqe->len = URING_BUFSIZ-1;
+        sqe->off = 0;
+        sqe->buf_index = 0;
+        /* close whether or not the read went through */
+        sqe->flags = IOSQE_FIXED_FILE|IOSQE_IO_HARDLINK;
+
+        sqe = uring_sqe(uring, tail++, IORING_OP_CLOSE, i, URING_OP_CLOSE);
+        sqe->file_index = i + 1;
+    }
+
+    __atomic_store_n(uring->sq_tail, tail, __ATOMIC_RELEASE);
+
+    /*
+     * the submit count stays the whole batch: sqes the kernel has
+     * taken are not submitted again, any it has not, after an EINTR,
+     * go in with the next wait
+     */
+    submit = pending = number * URING_CHAIN;
+    head = *uring->cq_head;
+
+    while (pending > 0) {
+        unsigned int cq_tail =
+            __atomic_load_n(uring->cq_tail, __ATOMIC_ACQUIRE);
+
+        if (head == cq_tail) {
+            SIGAR_INSTRUMENT_READ();
+            if ((syscall(__NR_io_uring_enter, uring->fd, submit, pending,
+                         IORING_ENTER_GETEVENTS, NULL, 0) < 0) &&
+                (errno != EINTR))
+            {
+                status = errno;
+                break;
+            }
+            continue;
+        }
+
+        while ((head != cq_tail) && (pending > 0)) {
+            uring_complete(uring, reads,
+                           &uring->cqes[head & *uring->cq_mask]);
+            head++;
+            pending--;
+        }
+        __atomic_store_n(uring->cq_head, head, __ATOMIC_RELEASE);
+    }
+
+    if (status != SIGAR_OK) {
+        /* chains may still be in flight, stop using the ring */
+        linux_uring_close(sigar);
+        if ((sigar->uring = calloc(1, sizeof(*sigar->uring)))) {
+            sigar->uring->fd = -1;
+        }
+        for (i=0; i<number; i++) {
+            reads[i].status = SIGAR_ENOTIMPL;
+        }
+    }
+
+    return status;
+}
+
+#else
+
+int linux_uring_open(sigar_t *sigar)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+int linux_uring_read(sigar_t *sigar, linux_proc_read_t *reads, int number)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+void linux_uring_close(sigar_t *sigar)
+{
+}
+
+#endif
@@ -19,6 +19,7 @@
 
 #include <assert.h>
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <fcntl.h>
@@ -32,7 +33,7 @@
 
 typedef struct {
     sigar_pid_t pid;
-    time_t mtime;
+    sigar_uint64_t mtime; /* millis */
     sigar_uint64_t vsize;
     sigar_uint64_t rss;
     sigar_uint64_t minor_faults;
@@ -47,28 +48,260 @@ typedef struct {
     char name[SIGAR_PROC_NAME_LEN];
     char state;
     int processor;
+    sigar_uint64_t ino; /* of /proc/<pid> when read, 0 with proc events */
 } linux_proc_stat_t;
 
+/* /proc/<pid>/ files held open by sigar_proc_pin */
+typedef enum {
+    PROC_PIN_STAT,
+    PROC_PIN_STATM,
+    PROC_PIN_IO,
+    PROC_PIN_STATUS,
+    PROC_PIN_MAX
+} linux_proc_pin_e;
+
+typedef struct {
+    sigar_uint64_t start_time;
+    int fd[PROC_PIN_MAX];
+    /* sigar_proc_handle_t holding it, the fds are not reopened */
+    int handles;
+} linux_proc_pin_t;
+
+/* args and exe of a pid, see sigar_proc_attr_cache_set */
+typedef struct linux_proc_attr_t linux_proc_attr_t;
+
+struct linux_proc_attr_t {
+    /* lru, most recently used after the sentinel in sigar_t */
+    linux_proc_attr_t *prev, *next;
+    sigar_uint64_t *bytes_total;
+    sigar_pid_t pid;
+    sigar_uint64_t start_time;
+    sigar_uint64_t exe_ino, exe_dev;
+    int flags;
+    unsigned long argc;
+    char *args; /* argc nul terminated strings back to back */
+    char *name, *root;
+    sigar_uint64_t bytes;
+};
+
+/* linux_cgroup.c */
+typedef struct linux_cgroup_t linux_cgroup_t;
+
+typedef struct linux_rtnl_t linux_rtnl_t;
+
+typedef struct linux_perf_t linux_perf_t;
+
+typedef struct linux_uring_t linux_uring_t;
+
+/* files of one io_uring batch */
+#define LINUX_URING_BATCH 128
+
+/* one /proc/<pid>/<file> of a batch */
+typedef struct {
+    sigar_pid_t pid;
+    int which; /* linux_proc_pin_e */
+    int status; /* SIGAR_ENOTIMPL if the ring did not get it */
+    char *data; /* nul terminated, until the next batch */
+    char path[32]; /* "<pid>/<file>", relative to proc_dirfd */
+} linux_proc_read_t;
+
 typedef enum {
     IOSTAT_NONE,
     IOSTAT_PARTITIONS, /* 2.4 */
     IOSTAT_DISKSTATS, /* 2.6 */
-    IOSTAT_SYS /* 2.6 */
+    IOSTAT_SYS, /* 2.6 */
+    IOSTAT_UNKNOWN /* not probed yet */
 } linux_iostat_e;
 
+/* one get_iostat_* of linux_sigar.c */
+typedef int (*linux_iostat_get_t)(sigar_t *sigar,
+                                  const char *name,
+                                  sigar_disk_usage_t *disk,
+                                  sigar_iodev_t **iodev,
+                                  sigar_disk_usage_t *device_usage);
+
+/* /proc/net/<fname>, with how it is to be closed */
+typedef FILE *(*linux_proc_net_open_t)(sigar_t *sigar,
+                                       const char *fname,
+                                       int (**close)(FILE *));
+
+/*
+ * the implementation of each subsystem that has more than one, chosen
+ * once per handle: at open where nothing needs probing, else by the
+ * probe of the subsystem on first use or by sigar_open_ex.
+ */
+typedef struct {
+    linux_iostat_get_t iostat_get;       /* NULL until linux_iostat */
+    linux_proc_net_open_t proc_net_open; /* procfs or SIGAR_PROC_NET */
+} linux_backend_t;
+
 struct sigar_t {
     SIGAR_T_BASE;
     int pagesize;
     int ram;
     int proc_signal_offset;
-    linux_proc_stat_t last_proc_stat;
+    /* pid -> linux_proc_stat_t */
+    sigar_cache_t *proc_stat;
+    sigar_pool_t *proc_stat_pool;
+    /* /proc/<pid>/ files are opened relative to this */
+    int proc_dirfd;
+    char proc_buf[BUFSIZ];
+    /* stat of /proc/<pid>/fd has st_size = open fds (linux 6.2+) */
+    int proc_fd_stat;
+    char *proc_fd_buf; /* getdents64 batch otherwise, first use */
+    /* pid -> linux_proc_pin_t */
+    sigar_cache_t *proc_pinned;
+    /* pid -> linux_proc_attr_t, bounded by proc_attr_max */
+    sigar_cache_t *proc_attr;
+    linux_proc_attr_t proc_attr_lru;
+    sigar_uint64_t proc_attr_bytes;
+    sigar_uint64_t proc_attr_max;
+    /* socket inode -> sigar_pid_t, see sigar_proc_port_get */
+    sigar_cache_t *proc_port_index;
+    sigar_pool_t *proc_port_pool;
+    sigar_uint64_t proc_port_index_time;
+    /* last /proc/net/dev read, see sigar_net_interface_stat_get */
+    sigar_net_interface_stat_list_t ifstat_list;
+    sigar_cache_t *ifstat_index; /* name hash -> ifstat_list entry */
+    sigar_uint64_t ifstat_time;
+    /* last rtnetlink link and address dump, see ifconfig_read */
+    sigar_net_interface_config_list_t ifconfig_list;
+    sigar_cache_t *ifconfig_index; /* name hash -> ifconfig_list entry */
+    sigar_uint64_t ifconfig_time;
+    /* parsed mount table, reread when mounts_fd polls POLLPRI */
+    sigar_file_system_list_t mounts;
+    int mounts_fd; /* /proc/self/mountinfo, -1 until opened */
+    /* last /proc/meminfo read, see meminfo_read */
+    sigar_mem_ext_t meminfo;
+    sigar_uint64_t meminfo_time;
+    /* last /proc/stat read, see system_stat_read */
+    sigar_system_stat_t system_stat;
+    sigar_uint64_t system_stat_time;
+    int *system_stat_cpus; /* cpu number of each cpulist entry */
+    unsigned long system_stat_cpus_size;
+    char *system_stat_buf; /* grows to fit the intr line */
+    size_t system_stat_buflen;
+    /* /proc/interrupts or /proc/softirqs, kept for the next read */
+    char *interrupts_buf;
+    size_t interrupts_buflen;
+    /* /proc/cpuinfo as first read, see sigar_cpu_info_list_get */
+    sigar_cpu_info_list_t cpu_infos;
+    int cpu_info_ncpu;
+    int cpu_info_rollup;
+    int cpu_info_cur_freq; /* -1 until scaling_cur_freq was tried */
+    /* last /proc/diskstats read, see diskstats_read */
+    sigar_disk_usage_list_t diskstats;
+    sigar_cache_t *diskstats_index; /* (major, minor) -> diskstats entry */
+    sigar_cache_t *diskstats_prev;  /* (major, minor) -> sigar_disk_usage_t */
+    sigar_uint64_t diskstats_time;
+    /* linux_taskstats.c, -1 until opened */
+    int taskstats_fd;
+    int taskstats_family;
+    sigar_uint32_t taskstats_seq;
+    /* linux_cgroup.c, NULL until first used */
+    linux_cgroup_t *cgroup;
+    /* linux_sock_diag.c, -1 until opened */
+    int sock_diag_fd;
+    sigar_uint32_t sock_diag_seq;
+    sigar_cache_t *sock_diag_bytes; /* one dump for a whole snapshot */
+    /* linux_rtnetlink.c, NULL until first used */
+    linux_rtnl_t *rtnl;
+    /* linux_perf.c, NULL until first used */
+    linux_perf_t *perf;
+    /* linux_uring.c, NULL until probed */
+    linux_uring_t *uring;
+    /* the batch it read ahead of the snapshot loop */
+    linux_proc_read_t *proc_reads;
+    int proc_reads_number;
+    int proc_reads_cursor;
     int lcpu;
+    linux_backend_t backend;
     linux_iostat_e iostat;
     char *proc_net;
+    /* set by sigar_netns_net_stat_get, the /proc/<pid> to read net/ from */
+    const char *netns_dir;
+    /* SIGAR_PROC_ROOT, NULL for the real /proc */
+    char *proc_root;
     /* Native POSIX Thread Library 2.6+ kernel */
     int has_nptl;
 };
 
+/*
+ * a SIGAR_PROC_ROOT mirror, which the netlink backends cannot answer
+ * for: the kernel knows nothing of it, only of the live system
+ */
+int linux_proc_mirrored(sigar_t *sigar);
+
+/* linux_taskstats.c, SIGAR_ENOTIMPL means use procfs */
+int linux_taskstats_probe(sigar_t *sigar);
+
+int linux_taskstats_proc_time_get(sigar_t *sigar, sigar_pid_t pid,
+                                  sigar_proc_time_t *proctime);
+
+int linux_taskstats_proc_time_list(sigar_t *sigar, sigar_pid_t *pids,
+                                   int num, sigar_proc_time_t *times,
+                                   int *statuses);
+
+void linux_taskstats_close(sigar_t *sigar);
+
+/* linux_sock_diag.c, SIGAR_ENOTIMPL means use procfs */
+int linux_sock_diag_probe(sigar_t *sigar);
+
+int linux_sock_diag_walk(sigar_net_connection_walker_t *walker,
+                         int type, unsigned long port, int remote);
+
+void linux_sock_diag_close(sigar_t *sigar);
+
+typedef struct {
+    sigar_uint64_t sent;     /* tcpi_bytes_acked */
+    sigar_uint64_t received; /* tcpi_bytes_received */
+} linux_sock_bytes_t;
+
+/* socket inode -> linux_sock_bytes_t of every tcp socket */
+int linux_sock_diag_tcp_bytes(sigar_t *sigar, sigar_cache_t *bytes);
+
+/* sigar_net_stat_get counts without building a connection per socket */
+int linux_sock_diag_net_stat(sigar_t *sigar, sigar_net_stat_t *netstat,
+                             int flags);
+
+void linux_cgroup_close(sigar_t *sigar);
+
+/* /proc/pressure/<resource> and <cgroup>/<resource>.pressure */
+void linux_pressure_parse(char *buffer, sigar_pressure_resource_t *resource);
+
+void linux_pressure_reset(sigar_pressure_t *pressure);
+
+/* the perf_event hierarchy directory of path, for perf_event_open */
+int linux_cgroup_perf_open(sigar_t *sigar, const char *path,
+                           int *fd, sigar_uint64_t *id);
+
+/* linux_perf.c */
+void linux_perf_close(sigar_t *sigar);
+
+int linux_uring_open(sigar_t *sigar);
+
+/* fills reads[i].status and data, at most LINUX_URING_BATCH of them */
+int linux_uring_read(sigar_t *sigar, linux_proc_read_t *reads, int number);
+
+void linux_uring_close(sigar_t *sigar);
+
+/* linux_rtnetlink.c, SIGAR_ENOTIMPL means use procfs */
+int linux_rtnetlink_probe(sigar_t *sigar);
+
+int linux_rtnetlink_route_list_get(sigar_t *sigar,
+                                   sigar_net_route_list_t *routelist);
+
+int linux_rtnetlink_arp_list_get(sigar_t *sigar,
+                                 sigar_arp_list_t *arplist);
+
+int linux_rtnetlink_ifconfig_list_get(sigar_t *sigar,
+                                      sigar_net_interface_config_list_t *iflist);
+
+void linux_rtnetlink_close(sigar_t *sigar);
+
+/* ARPHRD_* as /proc/net/arp would name it */
+char *linux_hw_type(int type);
+
 #define HAVE_STRERROR_R
 #ifndef __USE_XOPEN2K
 /* use gnu version of strerror_r */
@@ -20,6 +20,146 @@
 #include "sigar_util.h"
 #include "sigar_os.h"
 
+/* the index borrows the kstat_t's, kstat_close frees them */
+static void kstat_index_value_free(void *ptr)
+{
+}
+
+/* fnv-1a, ks_name is at most KSTAT_STRLEN */
+static sigar_uint64_t kstat_name_hash(const char *name)
+{
+    sigar_uint64_t hash = 14695981039346656037ULL;
+
+    while (*name) {
+        hash ^= (unsigned char)*name++;
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+static sigar_cache_t *kstat_index_new(void)
+{
+    sigar_cache_t *index = sigar_cache_new(64);
+    index->free_value = kstat_index_value_free;
+    return index;
+}
+
+static void kstat_index_add(sigar_cache_t *index, kstat_t *ksp)
+{
+    sigar_cache_entry_t *ent =
+        sigar_cache_get(index, kstat_name_hash(ksp->ks_name));
+
+    if (!ent->value) {
+        ent->value = ksp; /* first in the chain wins, as w/ kstat_lookup */
+    }
+}
+
+void sigar_kstat_index_free(sigar_t *sigar)
+{
+    if (sigar->ks.io) {
+        sigar_cache_destroy(sigar->ks.io);
+        sigar->ks.io = NULL;
+    }
+    if (sigar->ks.net) {
+        sigar_cache_destroy(sigar->ks.net);
+        sigar->ks.net = NULL;
+    }
+    if (sigar->ks.cpu_vm) {
+        free(sigar->ks.cpu_vm);
+        sigar->ks.cpu_vm = NULL;
+    }
+    sigar->ks.ncpu_vm = sigar->ks.cpu_vm_size = 0;
+}
+
+/*
+ * kstat_chain_update frees the kstat_t of every entry that went away,
+ * so whatever the getters look up by name is resolved again right
+ * here, in a single pass of the chain, rather than on every call.
+ */
+static void kstat_index_build(sigar_t *sigar)
+{
+    kstat_t *ksp;
+
+    sigar_kstat_index_free(sigar);
+
+    sigar->ks.io = kstat_index_new();
+    sigar->ks.net = kstat_index_new();
+    sigar->ks.arcstats = NULL;
+
+    for (ksp = sigar->kc->kc_chain; ksp; ksp = ksp->ks_next) {
+        if (ksp->ks_type == KSTAT_TYPE_IO) {
+            kstat_index_add(sigar->ks.io, ksp);
+        }
+        else if (ksp->ks_type != KSTAT_TYPE_NAMED) {
+            continue;
+        }
+        else if (strEQ(ksp->ks_class, "net")) {
+            kstat_index_add(sigar->ks.net, ksp);
+        }
+        else if (strEQ(ksp->ks_module, "cpu") && strEQ(ksp->ks_name, "vm")) {
+            if (sigar->ks.ncpu_vm >= sigar->ks.cpu_vm_size) {
+                sigar->ks.cpu_vm_size += 16;
+                sigar->ks.cpu_vm =
+                    realloc(sigar->ks.cpu_vm,
+                            sizeof(*sigar->ks.cpu_vm) * sigar->ks.cpu_vm_size);
+            }
+            sigar->ks.cpu_vm[sigar->ks.ncpu_vm++] = ksp;
+        }
+        else if (!sigar->ks.arcstats &&
+                 strEQ(ksp->ks_module, "zfs") && (ksp->ks_instance == 0) &&
+                 strEQ(ksp->ks_name, "arcstats"))
+        {
+            sigar->ks.arcstats = ksp;
+        }
+    }
+}
+
+static kstat_t *kstat_index_lookup(sigar_t *sigar, sigar_cache_t *index,
+                                   const char *name, int type)
+{
+    sigar_cache_entry_t *ent;
+    kstat_t *ksp;
+
+    if (index &&
+        (ent = sigar_cache_find(index, kstat_name_hash(name))))
+    {
+        ksp = ent->value;
+        if (strEQ(ksp->ks_name, name)) {
+            return ksp;
+        }
+    }
+    else if (index) {
+        return NULL; /* every name of this kind is indexed */
+    }
+
+    for (ksp = sigar->kc->kc_chain; ksp; ksp = ksp->ks_next) {
+        if ((ksp->ks_type == type) && strEQ(ksp->ks_name, name)) {
+            return ksp;
+        }
+    }
+
+    return NULL;
+}
+
+kstat_t *sigar_kstat_io_lookup(sigar_t *sigar, const char *name)
+{
+    return kstat_index_lookup(sigar, sigar->ks.io, name, KSTAT_TYPE_IO);
+}
+
+kstat_t *sigar_kstat_net_lookup(sigar_t *sigar, const char *name)
+{
+    kstat_t *ksp =
+        kstat_index_lookup(sigar, sigar->ks.net, name, KSTAT_TYPE_NAMED);
+
+    if (!ksp) {
+        /* not every driver sets ks_class "net" */
+        ksp = kstat_lookup(sigar->kc, NULL, -1, (char *)name);
+    }
+
+    return ksp;
+}
+
 int sigar_get_kstats(sigar_t *sigar)
 {
     kstat_ctl_t *kc = sigar->kc;
@@ -90,6 +230,8 @@ int sigar_get_kstats(sigar_t *sigar)
     sigar->ks.syspages = kstat_lookup(kc, "unix", -1, "system_pages");
     sigar->ks.mempages = kstat_lookup(kc, "bunyip", -1, "mempages");
 
+    kstat_index_build(sigar);
+
     return SIGAR_OK;
 }
 
@@ -148,6 +290,7 @@ static char *kstat_keys_system[] = {
     "avenrun_1min",
     "avenrun_5min",
     "avenrun_15min",
+    "nproc",
     NULL
 };
 
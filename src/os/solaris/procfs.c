@@ -19,79 +19,246 @@
 #include "sigar_util.h"
 #include "sigar_os.h"
 
-#define my_pread(fd, ptr, type, offset) \
-    (pread(fd, ptr, sizeof(type), offset) == sizeof(type))
+static const struct {
+    const char *name;
+    int len;
+    size_t size;
+} proc_pin_files[] = {
+    { "/psinfo", SSTRLEN("/psinfo"), sizeof(psinfo_t) },
+    { "/usage", SSTRLEN("/usage"), sizeof(prusage_t) },
+    { "/status", SSTRLEN("/status"), sizeof(pstatus_t) }
+};
 
-int sigar_proc_psinfo_get(sigar_t *sigar, sigar_pid_t pid)
+static int proc_file_open(sigar_pid_t pid, int which)
 {
-    int fd, retval = SIGAR_OK;
     char buffer[BUFSIZ];
-    time_t timenow = time(NULL);
+    int fd;
 
-    if (sigar->pinfo == NULL) {
-        sigar->pinfo = malloc(sizeof(*sigar->pinfo));
+    (void)sigar_proc_filename(buffer, sizeof(buffer), pid,
+                              proc_pin_files[which].name,
+                              proc_pin_files[which].len);
+
+    if ((fd = open(buffer, O_RDONLY)) >= 0) {
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
     }
 
-    if (sigar->last_pid == pid) {
-        if ((timenow - sigar->last_getprocs) < SIGAR_LAST_PROC_EXPIRE) {
-            return SIGAR_OK;
+    return fd;
+}
+
+static int proc_fd_read(int fd, int which, void *ptr)
+{
+    size_t size = proc_pin_files[which].size;
+    ssize_t nread = pread(fd, ptr, size, 0);
+
+    if ((nread >= 0) && ((size_t)nread == size)) {
+        return SIGAR_OK;
+    }
+    if ((nread < 0) && (errno != ENOENT)) {
+        return errno;
+    }
+
+    return ESRCH; /* the process is gone */
+}
+
+static void proc_pin_close(solaris_proc_pin_t *pin)
+{
+    int i;
+
+    for (i=0; i<PROC_PIN_MAX; i++) {
+        if (pin->fd[i] >= 0) {
+            close(pin->fd[i]);
+            pin->fd[i] = -1;
         }
     }
+}
 
-    sigar->last_pid = pid;
-    sigar->last_getprocs = timenow;
+static int proc_pin_open(sigar_pid_t pid, solaris_proc_pin_t *pin)
+{
+    int i;
 
-    (void)SIGAR_PROC_FILENAME(buffer, pid, "/psinfo");
+    for (i=0; i<PROC_PIN_MAX; i++) {
+        /* -1 if not readable, usage and status are owner only */
+        pin->fd[i] = proc_file_open(pid, i);
+    }
 
-    if ((fd = open(buffer, O_RDONLY)) < 0) {
-        return ESRCH;
+    if (pin->fd[PROC_PIN_PSINFO] < 0) {
+        int status = (errno == ENOENT) ? ESRCH : errno;
+        proc_pin_close(pin);
+        return status;
     }
 
-    if (!my_pread(fd, sigar->pinfo, psinfo_t, 0)) {
-        retval = errno;
+    return SIGAR_OK;
+}
+
+static void proc_pin_free(void *ptr)
+{
+    proc_pin_close((solaris_proc_pin_t *)ptr);
+    free(ptr);
+}
+
+static solaris_proc_pin_t *proc_pin_find(sigar_t *sigar, sigar_pid_t pid)
+{
+    sigar_cache_entry_t *entry;
+
+    if (!sigar->proc_pinned) {
+        return NULL;
     }
 
-    close(fd);
+    entry = sigar_cache_find(sigar->proc_pinned, pid);
 
-    return retval;
+    return entry ? (solaris_proc_pin_t *)entry->value : NULL;
 }
 
-int sigar_proc_usage_get(sigar_t *sigar, prusage_t *prusage, sigar_pid_t pid)
+int sigar_proc_pin(sigar_t *sigar, sigar_pid_t pid)
 {
-    int fd, retval = SIGAR_OK;
-    char buffer[BUFSIZ];
+    sigar_cache_entry_t *entry;
+    solaris_proc_pin_t *pin;
+    int status;
 
-    (void)SIGAR_PROC_FILENAME(buffer, pid, "/usage");
+    if (!sigar->proc_pinned) {
+        sigar->proc_pinned = sigar_cache_new(16);
+        sigar->proc_pinned->free_value = proc_pin_free;
+    }
 
-    if ((fd = open(buffer, O_RDONLY)) < 0) {
-        return ESRCH;
+    entry = sigar_cache_get(sigar->proc_pinned, pid);
+    if (entry->value) {
+        return SIGAR_OK;
     }
 
-    if (!my_pread(fd, prusage, prusage_t, 0)) {
-        retval = errno;
+    pin = malloc(sizeof(*pin));
+    if ((status = proc_pin_open(pid, pin)) != SIGAR_OK) {
+        free(pin);
+        sigar_cache_remove(sigar->proc_pinned, pid);
+        return status;
     }
+    entry->value = pin;
 
+    return SIGAR_OK;
+}
+
+int sigar_proc_unpin(sigar_t *sigar, sigar_pid_t pid)
+{
+    if (sigar->proc_pinned) {
+        sigar_cache_remove(sigar->proc_pinned, pid);
+    }
+
+    return SIGAR_OK;
+}
+
+/*
+ * read /proc/<pid>/<file> into ptr, through the pinned fd if there
+ * is one, else opened for just this read.  the fd of an exited
+ * process fails with ENOENT rather than reading whoever got the pid
+ * next, so a failed read reopens every file of the pin together.
+ */
+static int proc_file_read(sigar_t *sigar, sigar_pid_t pid,
+                          int which, void *ptr)
+{
+    solaris_proc_pin_t *pin = proc_pin_find(sigar, pid);
+    int fd, status;
+
+    if (pin) {
+        if (pin->fd[which] >= 0) {
+            if (proc_fd_read(pin->fd[which], which, ptr) == SIGAR_OK) {
+                return SIGAR_OK;
+            }
+            proc_pin_close(pin);
+        }
+        if (pin->fd[PROC_PIN_PSINFO] < 0) {
+            if ((status = proc_pin_open(pid, pin)) != SIGAR_OK) {
+                return status;
+            }
+            if (pin->fd[which] >= 0) {
+                return proc_fd_read(pin->fd[which], which, ptr);
+            }
+        }
+    }
+
+    if ((fd = proc_file_open(pid, which)) < 0) {
+        return (errno == ENOENT) ? ESRCH : errno;
+    }
+
+    status = proc_fd_read(fd, which, ptr);
     close(fd);
 
-    return retval;
+    return status;
+}
+
+int sigar_proc_psinfo_get(sigar_t *sigar, sigar_pid_t pid)
+{
+    int status;
+    time_t timenow = time(NULL);
+
+    if (sigar->pinfo == NULL) {
+        sigar->pinfo = malloc(sizeof(*sigar->pinfo));
+    }
+
+    if (sigar->last_pid == pid) {
+        if ((timenow - sigar->last_getprocs) < SIGAR_LAST_PROC_EXPIRE) {
+            return SIGAR_OK;
+        }
+    }
+
+    status = proc_file_read(sigar, pid, PROC_PIN_PSINFO, sigar->pinfo);
+
+    if (status == SIGAR_OK) {
+        sigar->last_pid = pid;
+        sigar->last_getprocs = timenow;
+    }
+    else {
+        sigar->last_pid = -1;
+    }
+
+    return status;
+}
+
+int sigar_proc_usage_get(sigar_t *sigar, prusage_t *prusage, sigar_pid_t pid)
+{
+    return proc_file_read(sigar, pid, PROC_PIN_USAGE, prusage);
 }
 
 int sigar_proc_status_get(sigar_t *sigar, pstatus_t *pstatus, sigar_pid_t pid)
 {
-    int fd, retval = SIGAR_OK;
-    char buffer[BUFSIZ];
+    return proc_file_read(sigar, pid, PROC_PIN_STATUS, pstatus);
+}
 
-    (void)SIGAR_PROC_FILENAME(buffer, pid, "/status");
+int sigar_proc_sweep(sigar_t *sigar, int with_usage)
+{
+    sigar_proc_list_t *pids;
+    unsigned long i;
+    int status;
 
-    if ((fd = open(buffer, O_RDONLY)) < 0) {
-        return ESRCH;
+    if ((status = sigar_proc_list_get(sigar, NULL)) != SIGAR_OK) {
+        return status;
     }
 
-    if (!my_pread(fd, pstatus, pstatus_t, 0)) {
-        retval = errno;
+    pids = sigar->pids;
+
+    if (sigar->procs.size < pids->number) {
+        sigar->procs.size = pids->number + SIGAR_PROC_LIST_MAX;
+        sigar->procs.data =
+            realloc(sigar->procs.data,
+                    sizeof(*sigar->procs.data) * sigar->procs.size);
     }
 
-    close(fd);
+    sigar->procs.number = 0;
+
+    for (i=0; i<pids->number; i++) {
+        solaris_proc_t *proc = &sigar->procs.data[sigar->procs.number];
+        sigar_pid_t pid = pids->data[i];
+
+        if (proc_file_read(sigar, pid, PROC_PIN_PSINFO,
+                           &proc->psinfo) != SIGAR_OK)
+        {
+            continue; /* the process went away */
+        }
+
+        proc->has_usage = with_usage &&
+            (proc_file_read(sigar, pid, PROC_PIN_USAGE,
+                            &proc->usage) == SIGAR_OK);
+
+        sigar->procs.number++;
+    }
 
-    return retval;
+    return SIGAR_OK;
 }
@@ -69,12 +69,41 @@ int sigar_get_multi_kstats(sigar_t *sigar,
 
 void sigar_koffsets_lookup(kstat_t *ksp, int *offsets, int kidx);
 
+/* from the index, a linear walk only if two names share a hash */
+kstat_t *sigar_kstat_io_lookup(sigar_t *sigar, const char *name);
+
+kstat_t *sigar_kstat_net_lookup(sigar_t *sigar, const char *name);
+
+void sigar_kstat_index_free(sigar_t *sigar);
+
 int sigar_proc_psinfo_get(sigar_t *sigar, sigar_pid_t pid);
 
 int sigar_proc_usage_get(sigar_t *sigar, prusage_t *prusage, sigar_pid_t pid);
 
 int sigar_proc_status_get(sigar_t *sigar, pstatus_t *pstatus, sigar_pid_t pid);
 
+/* /proc/<pid>/ files held open by sigar_proc_pin */
+typedef enum {
+    PROC_PIN_PSINFO,
+    PROC_PIN_USAGE,
+    PROC_PIN_STATUS,
+    PROC_PIN_MAX
+} solaris_proc_pin_e;
+
+typedef struct {
+    int fd[PROC_PIN_MAX];
+} solaris_proc_pin_t;
+
+/* one process of sigar_proc_sweep */
+typedef struct {
+    psinfo_t psinfo;
+    prusage_t usage;
+    int has_usage; /* usage is owner only */
+} solaris_proc_t;
+
+/* psinfo, and usage if with_usage, of every process into sigar->procs */
+int sigar_proc_sweep(sigar_t *sigar, int with_usage);
+
 #define CPU_ONLINE(n) \
     (p_online(n, P_STATUS) == P_ONLINE)
 
@@ -83,6 +112,7 @@ typedef enum {
     KSTAT_SYSTEM_LOADAVG_1,
     KSTAT_SYSTEM_LOADAVG_2,
     KSTAT_SYSTEM_LOADAVG_3,
+    KSTAT_SYSTEM_NPROC,
     KSTAT_SYSTEM_MAX
 } kstat_system_off_e;
 
@@ -144,6 +174,12 @@ struct sigar_t {
         kstat_t *system;
         kstat_t *syspages;
         kstat_t *mempages;
+        kstat_t *arcstats;
+        /* resolved in one chain pass per kstat_chain_update */
+        kstat_t **cpu_vm;
+        unsigned int ncpu_vm, cpu_vm_size;
+        sigar_cache_t *io;  /* KSTAT_TYPE_IO by ks_name */
+        sigar_cache_t *net; /* class "net" by ks_name */
     } ks;
 
     struct {
@@ -174,6 +210,16 @@ struct sigar_t {
 
     sigar_cache_t *pargs;
 
+    /* pid -> solaris_proc_pin_t */
+    sigar_cache_t *proc_pinned;
+
+    /* filled by sigar_proc_sweep */
+    struct {
+        solaris_proc_t *data;
+        unsigned long number;
+        unsigned long size;
+    } procs;
+
     solaris_mib2_t mib2;
 };
 
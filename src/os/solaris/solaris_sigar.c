@@ -38,26 +38,6 @@
 #define PROC_ERRNO ((errno == ENOENT) ? ESRCH : errno)
 #define SIGAR_USR_UCB_PS "/usr/ucb/ps"
 
-
-/* like kstat_lookup but start w/ ksp->ks_next instead of kc->kc_chain */
-static kstat_t *
-kstat_next(kstat_t *ksp, char *ks_module, int ks_instance, char *ks_name)
-{
-    if (ksp) {
-        ksp = ksp->ks_next;
-    }
-    for (; ksp; ksp = ksp->ks_next) {
-        if ((ks_module == NULL ||
-             strcmp(ksp->ks_module, ks_module) == 0) &&
-            (ks_instance == -1 || ksp->ks_instance == ks_instance) &&
-            (ks_name == NULL || strcmp(ksp->ks_name, ks_name) == 0))
-            return ksp;
-    }
-
-    errno = ENOENT;
-    return NULL;
-}
-
 int sigar_os_open(sigar_t **sig)
 {
     kstat_ctl_t *kc;
@@ -115,6 +95,10 @@ int sigar_os_open(sigar_t **sig)
     sigar->ks.cpu_info = NULL;
     sigar->ks.cpuid = NULL;
     sigar->ks.lcpu = 0;
+    sigar->ks.arcstats = NULL;
+    sigar->ks.cpu_vm = NULL;
+    sigar->ks.ncpu_vm = sigar->ks.cpu_vm_size = 0;
+    sigar->ks.io = sigar->ks.net = NULL;
 
     sigar->koffsets.system[0] = -1;
     sigar->koffsets.mempages[0] = -1;
@@ -144,6 +128,10 @@ int sigar_os_open(sigar_t **sig)
 
     sigar->pargs = NULL;
 
+    sigar->proc_pinned = NULL;
+    sigar->procs.data = NULL;
+    sigar->procs.number = sigar->procs.size = 0;
+
     SIGAR_ZERO(&sigar->mib2);
     sigar->mib2.sd = -1;
 
@@ -162,6 +150,7 @@ int sigar_os_close(sigar_t *sigar)
         free(sigar->ks.cpu_info);
         free(sigar->ks.cpuid);
     }
+    sigar_kstat_index_free(sigar);
     if (sigar->pinfo) {
         free(sigar->pinfo);
     }
@@ -174,6 +163,12 @@ int sigar_os_close(sigar_t *sigar)
     if (sigar->pargs) {
         sigar_cache_destroy(sigar->pargs);
     }
+    if (sigar->proc_pinned) {
+        sigar_cache_destroy(sigar->proc_pinned);
+    }
+    if (sigar->procs.data) {
+        free(sigar->procs.data);
+    }
     free(sigar);
     return SIGAR_OK;
 }
@@ -221,7 +216,7 @@ int sigar_mem_get(sigar_t *sigar, sigar_mem_t *mem)
     /* http://bugs.opensolaris.org/bugdatabase/view_bug.do?bug_id=6821980 */
 
     /* ZFS ARC cache. see: http://opensolaris.org/jive/thread.jspa?messageID=393695 */
-    if ((ksp = kstat_lookup(sigar->kc, "zfs", 0, "arcstats")) &&
+    if ((ksp = sigar->ks.arcstats) &&
         (kstat_read(sigar->kc, ksp, NULL) != -1))
     {
         kstat_named_t *kn;
@@ -288,7 +283,7 @@ int sigar_swap_get(sigar_t *sigar, sigar_swap_t *swap)
     if (sigar_kstat_update(sigar) == -1) {
         return errno;
     }
-    if (!(ksp = kstat_lookup(sigar->kc, "cpu", -1, "vm"))) {
+    if (sigar->ks.ncpu_vm == 0) {
         swap->page_in = swap->page_out = SIGAR_FIELD_NOTIMPL;
         return SIGAR_OK;
     }
@@ -299,7 +294,9 @@ int sigar_swap_get(sigar_t *sigar, sigar_swap_t *swap)
      * they are in the raw cpu_stat struct, but thats not
      * binary compatible
      */
-    do {
+    for (i=0; i<(int)sigar->ks.ncpu_vm; i++) {
+        ksp = sigar->ks.cpu_vm[i];
+
         if (kstat_read(sigar->kc, ksp, NULL) < 0) {
             break;
         }
@@ -310,7 +307,7 @@ int sigar_swap_get(sigar_t *sigar, sigar_swap_t *swap)
         if ((kn = (kstat_named_t *)kstat_data_lookup(ksp, "pgout"))) {
             swap->page_out += kn->value.i64; /* vmstat -s | grep "page outs" */
         }
-    } while ((ksp = kstat_next(ksp, "cpu", -1, "vm")));
+    }
 
     return SIGAR_OK;
 }
@@ -582,6 +579,36 @@ int sigar_loadavg_get(sigar_t *sigar,
     return SIGAR_OK;
 }
 
+/* only the process count has a kstat, per state takes the census */
+int sigar_os_proc_stat_get(sigar_t *sigar, sigar_proc_stat_t *procstat)
+{
+    kstat_t *ksp;
+
+    if (sigar_kstat_update(sigar) == -1) {
+        return errno;
+    }
+
+    if (!(ksp = sigar->ks.system)) {
+        return SIGAR_ENOTIMPL;
+    }
+
+    if (kstat_read(sigar->kc, ksp, NULL) < 0) {
+        return SIGAR_ENOTIMPL;
+    }
+
+    sigar_koffsets_init_system(sigar, ksp);
+
+    procstat->total    = kSYSTEM(KSTAT_SYSTEM_NPROC);
+    procstat->sleeping = SIGAR_FIELD_NOTIMPL;
+    procstat->running  = SIGAR_FIELD_NOTIMPL;
+    procstat->zombie   = SIGAR_FIELD_NOTIMPL;
+    procstat->stopped  = SIGAR_FIELD_NOTIMPL;
+    procstat->idle     = SIGAR_FIELD_NOTIMPL;
+    procstat->threads  = SIGAR_FIELD_NOTIMPL;
+
+    return SIGAR_OK;
+}
+
 #define LIBPROC "/usr/lib/libproc.so"
 
 #define CHECK_PSYM(s) \
@@ -688,24 +715,16 @@ int sigar_os_proc_list_get(sigar_t *sigar,
     return sigar_proc_list_procfs_get(sigar, proclist);
 }
 
-int sigar_proc_mem_get(sigar_t *sigar, sigar_pid_t pid,
-                       sigar_proc_mem_t *procmem)
+static void psinfo_proc_mem_set(psinfo_t *pinfo, prusage_t *usage,
+                                sigar_proc_mem_t *procmem)
 {
-    int status = sigar_proc_psinfo_get(sigar, pid);
-    psinfo_t *pinfo = sigar->pinfo;
-    prusage_t usage;
-
-    if (status != SIGAR_OK) {
-        return status;
-    }
-
     procmem->size     = pinfo->pr_size << 10;
     procmem->resident = pinfo->pr_rssize << 10;
     procmem->share    = SIGAR_FIELD_NOTIMPL;
 
-    if (sigar_proc_usage_get(sigar, &usage, pid) == SIGAR_OK) {
-        procmem->minor_faults = usage.pr_minf;
-        procmem->major_faults = usage.pr_majf;
+    if (usage) {
+        procmem->minor_faults = usage->pr_minf;
+        procmem->major_faults = usage->pr_majf;
         procmem->page_faults =
             procmem->minor_faults +
             procmem->major_faults;
@@ -715,10 +734,35 @@ int sigar_proc_mem_get(sigar_t *sigar, sigar_pid_t pid,
         procmem->major_faults = SIGAR_FIELD_NOTIMPL;
         procmem->page_faults = SIGAR_FIELD_NOTIMPL;
     }
+}
+
+int sigar_proc_mem_get(sigar_t *sigar, sigar_pid_t pid,
+                       sigar_proc_mem_t *procmem)
+{
+    int status = sigar_proc_psinfo_get(sigar, pid);
+    prusage_t usage, *usagep = NULL;
+
+    if (status != SIGAR_OK) {
+        return status;
+    }
+
+    if (sigar_proc_usage_get(sigar, &usage, pid) == SIGAR_OK) {
+        usagep = &usage;
+    }
+
+    psinfo_proc_mem_set(sigar->pinfo, usagep, procmem);
 
     return SIGAR_OK;
 }
 
+static void usage_proc_disk_io_set(prusage_t *usage,
+                                   sigar_proc_cumulative_disk_io_t *proc_cumulative_disk_io)
+{
+   proc_cumulative_disk_io->bytes_read = SIGAR_FIELD_NOTIMPL;
+   proc_cumulative_disk_io->bytes_written = SIGAR_FIELD_NOTIMPL;
+   proc_cumulative_disk_io->bytes_total =  usage->pr_ioch;
+}
+
 int sigar_proc_cumulative_disk_io_get(sigar_t *sigar, sigar_pid_t pid, 
                            sigar_proc_cumulative_disk_io_t *proc_cumulative_disk_io)
 {
@@ -727,9 +771,7 @@ int sigar_proc_cumulative_disk_io_get(sigar_t *sigar, sigar_pid_t pid,
    if ((status = sigar_proc_usage_get(sigar, &usage, pid)) != SIGAR_OK) {
         return status;
    }
-   proc_cumulative_disk_io->bytes_read = SIGAR_FIELD_NOTIMPL;
-   proc_cumulative_disk_io->bytes_written = SIGAR_FIELD_NOTIMPL;
-   proc_cumulative_disk_io->bytes_total =  usage.pr_ioch;
+   usage_proc_disk_io_set(&usage, proc_cumulative_disk_io);
 
     return SIGAR_OK;
 }
@@ -755,51 +797,51 @@ int sigar_proc_cred_get(sigar_t *sigar, sigar_pid_t pid,
 #define TIMESTRUCT_2MSEC(t) \
     ((t.tv_sec * MILLISEC) + (t.tv_nsec / (NANOSEC/MILLISEC)))
 
-int sigar_proc_time_get(sigar_t *sigar, sigar_pid_t pid,
-                        sigar_proc_time_t *proctime)
+static int usage_proc_time_set(sigar_t *sigar, sigar_pid_t pid,
+                               prusage_t *usage,
+                               sigar_proc_time_t *proctime)
 {
-    prusage_t usage;
-    int status;
-
-    if ((status = sigar_proc_usage_get(sigar, &usage, pid)) != SIGAR_OK) {
-        return status;
-    }
-
-    proctime->start_time = usage.pr_create.tv_sec + sigar->boot_time;
+    proctime->start_time = usage->pr_create.tv_sec + sigar->boot_time;
     proctime->start_time *= MILLISEC;
 
-    if (usage.pr_utime.tv_sec < 0) {
+    if (usage->pr_utime.tv_sec < 0) {
         /* XXX wtf?  seen on solaris 10, only for the self process */
         pstatus_t pstatus;
+        int status = sigar_proc_status_get(sigar, &pstatus, pid);
 
-        status = sigar_proc_status_get(sigar, &pstatus, pid);
         if (status != SIGAR_OK) {
             return status;
         }
 
-        usage.pr_utime.tv_sec  = pstatus.pr_utime.tv_sec;
-        usage.pr_utime.tv_nsec = pstatus.pr_utime.tv_nsec;
-        usage.pr_stime.tv_sec  = pstatus.pr_stime.tv_sec;
-        usage.pr_stime.tv_nsec = pstatus.pr_stime.tv_nsec;
+        usage->pr_utime.tv_sec  = pstatus.pr_utime.tv_sec;
+        usage->pr_utime.tv_nsec = pstatus.pr_utime.tv_nsec;
+        usage->pr_stime.tv_sec  = pstatus.pr_stime.tv_sec;
+        usage->pr_stime.tv_nsec = pstatus.pr_stime.tv_nsec;
     }
 
-    proctime->user = TIMESTRUCT_2MSEC(usage.pr_utime);
-    proctime->sys  = TIMESTRUCT_2MSEC(usage.pr_stime);
+    proctime->user = TIMESTRUCT_2MSEC(usage->pr_utime);
+    proctime->sys  = TIMESTRUCT_2MSEC(usage->pr_stime);
     proctime->total = proctime->user + proctime->sys;
 
     return SIGAR_OK;
 }
 
-int sigar_proc_state_get(sigar_t *sigar, sigar_pid_t pid,
-                         sigar_proc_state_t *procstate)
+int sigar_proc_time_get(sigar_t *sigar, sigar_pid_t pid,
+                        sigar_proc_time_t *proctime)
 {
-    int status = sigar_proc_psinfo_get(sigar, pid);
-    psinfo_t *pinfo = sigar->pinfo;
+    prusage_t usage;
+    int status;
 
-    if (status != SIGAR_OK) {
+    if ((status = sigar_proc_usage_get(sigar, &usage, pid)) != SIGAR_OK) {
         return status;
     }
 
+    return usage_proc_time_set(sigar, pid, &usage, proctime);
+}
+
+static void psinfo_proc_state_set(psinfo_t *pinfo,
+                                  sigar_proc_state_t *procstate)
+{
     SIGAR_SSTRCPY(procstate->name, pinfo->pr_fname);
     procstate->ppid = pinfo->pr_ppid;
     procstate->tty  = pinfo->pr_ttydev;
@@ -826,6 +868,68 @@ int sigar_proc_state_get(sigar_t *sigar, sigar_pid_t pid,
         procstate->state = 'D';
         break;
     }
+}
+
+int sigar_proc_state_get(sigar_t *sigar, sigar_pid_t pid,
+                         sigar_proc_state_t *procstate)
+{
+    int status = sigar_proc_psinfo_get(sigar, pid);
+
+    if (status != SIGAR_OK) {
+        return status;
+    }
+
+    psinfo_proc_state_set(sigar->pinfo, procstate);
+
+    return SIGAR_OK;
+}
+
+/* psinfo and usage of every process in one sweep, no per-pid getters */
+int sigar_os_proc_snapshot_get(sigar_t *sigar, int flags,
+                               sigar_proc_snapshot_t *snapshot)
+{
+    int with_usage =
+        flags & (SIGAR_PROC_SNAPSHOT_MEM|SIGAR_PROC_SNAPSHOT_TIME|
+                 SIGAR_PROC_SNAPSHOT_DISK_IO);
+    unsigned long i;
+    int status;
+
+    if ((status = sigar_proc_sweep(sigar, with_usage)) != SIGAR_OK) {
+        return status;
+    }
+
+    for (i=0; i<sigar->procs.number; i++) {
+        solaris_proc_t *proc = &sigar->procs.data[i];
+        prusage_t *usage = proc->has_usage ? &proc->usage : NULL;
+        sigar_proc_snapshot_entry_t *entry;
+
+        SIGAR_PROC_SNAPSHOT_GROW(snapshot);
+        entry = &snapshot->data[snapshot->number++];
+        entry->pid = proc->psinfo.pr_pid;
+        entry->flags = 0;
+
+        if (flags & SIGAR_PROC_SNAPSHOT_STATE) {
+            psinfo_proc_state_set(&proc->psinfo, &entry->state);
+            entry->flags |= SIGAR_PROC_SNAPSHOT_STATE;
+        }
+
+        if (flags & SIGAR_PROC_SNAPSHOT_MEM) {
+            psinfo_proc_mem_set(&proc->psinfo, usage, &entry->mem);
+            entry->flags |= SIGAR_PROC_SNAPSHOT_MEM;
+        }
+
+        if ((flags & SIGAR_PROC_SNAPSHOT_TIME) && usage &&
+            (usage_proc_time_set(sigar, entry->pid, usage,
+                                 (sigar_proc_time_t *)&entry->cpu) == SIGAR_OK))
+        {
+            entry->flags |= SIGAR_PROC_SNAPSHOT_TIME;
+        }
+
+        if ((flags & SIGAR_PROC_SNAPSHOT_DISK_IO) && usage) {
+            usage_proc_disk_io_set(usage, &entry->disk_io);
+            entry->flags |= SIGAR_PROC_SNAPSHOT_DISK_IO;
+        }
+    }
 
     return SIGAR_OK;
 }
@@ -1630,18 +1734,9 @@ static int sigar_kstat_disk_usage_get(sigar_t *sigar, const char *name,
         return errno;
     }
 
-    for (ksp = sigar->kc->kc_chain;
-         ksp;
-         ksp = ksp->ks_next)
-    {
-        if (ksp->ks_type != KSTAT_TYPE_IO) {
-            continue;
-        }
-        if (strEQ(ksp->ks_name, name)) {
-            int status = io_kstat_read(sigar, disk, ksp);
-            *kio = ksp;
-            return status;
-        }
+    if ((ksp = sigar_kstat_io_lookup(sigar, name))) {
+        *kio = ksp;
+        return io_kstat_read(sigar, disk, ksp);
     }
 
     return ENXIO;
@@ -2104,7 +2199,7 @@ static int sigar_net_ifstat_get_any(sigar_t *sigar, const char *name,
         return errno;
     }
 
-    if (!(ksp = kstat_lookup(kc, NULL, -1, (char *)name))) {
+    if (!(ksp = sigar_kstat_net_lookup(sigar, name))) {
         return ENXIO;
     }
 
@@ -234,6 +234,66 @@ typedef struct {
 
 /* end undocumented structures */
 
+/*
+ * GetExtendedTcpTable/GetExtendedUdpTable owner pid rows, declared
+ * here since older sdk headers do not have tcpmib.h/udpmib.h
+ */
+#define SIGAR_TCP_TABLE_OWNER_PID_ALL 5
+#define SIGAR_UDP_TABLE_OWNER_PID     1
+
+typedef struct {
+    DWORD dwState;
+    DWORD dwLocalAddr;
+    DWORD dwLocalPort;
+    DWORD dwRemoteAddr;
+    DWORD dwRemotePort;
+    DWORD dwOwningPid;
+} SIGAR_MIB_TCPROW_OWNER_PID;
+
+typedef struct {
+    DWORD dwNumEntries;
+    SIGAR_MIB_TCPROW_OWNER_PID table[ANY_SIZE];
+} SIGAR_MIB_TCPTABLE_OWNER_PID;
+
+typedef struct {
+    UCHAR ucLocalAddr[16];
+    DWORD dwLocalScopeId;
+    DWORD dwLocalPort;
+    UCHAR ucRemoteAddr[16];
+    DWORD dwRemoteScopeId;
+    DWORD dwRemotePort;
+    DWORD dwState;
+    DWORD dwOwningPid;
+} SIGAR_MIB_TCP6ROW_OWNER_PID;
+
+typedef struct {
+    DWORD dwNumEntries;
+    SIGAR_MIB_TCP6ROW_OWNER_PID table[ANY_SIZE];
+} SIGAR_MIB_TCP6TABLE_OWNER_PID;
+
+typedef struct {
+    DWORD dwLocalAddr;
+    DWORD dwLocalPort;
+    DWORD dwOwningPid;
+} SIGAR_MIB_UDPROW_OWNER_PID;
+
+typedef struct {
+    DWORD dwNumEntries;
+    SIGAR_MIB_UDPROW_OWNER_PID table[ANY_SIZE];
+} SIGAR_MIB_UDPTABLE_OWNER_PID;
+
+typedef struct {
+    UCHAR ucLocalAddr[16];
+    DWORD dwLocalScopeId;
+    DWORD dwLocalPort;
+    DWORD dwOwningPid;
+} SIGAR_MIB_UDP6ROW_OWNER_PID;
+
+typedef struct {
+    DWORD dwNumEntries;
+    SIGAR_MIB_UDP6ROW_OWNER_PID table[ANY_SIZE];
+} SIGAR_MIB_UDP6TABLE_OWNER_PID;
+
 /* no longer in the standard header files */
 typedef struct {
     LARGE_INTEGER IdleTime;
@@ -255,6 +315,69 @@ typedef struct _UNICODE_STRING {
     PWSTR  Buffer;
 } UNICODE_STRING, *PUNICODE_STRING;
 
+/* SystemProcessInformation: one record per process, threads in tow */
+#define SystemProcessInformation 5
+
+#define SIGAR_STATUS_INFO_LENGTH_MISMATCH 0xC0000004
+
+/* KTHREAD_STATE / KWAIT_REASON values used to derive a process state */
+#define SIGAR_THREAD_STATE_RUNNING 2
+#define SIGAR_THREAD_STATE_WAITING 5
+#define SIGAR_THREAD_WAIT_SUSPENDED 5
+
+typedef struct {
+    LARGE_INTEGER KernelTime;
+    LARGE_INTEGER UserTime;
+    LARGE_INTEGER CreateTime;
+    ULONG WaitTime;
+    PVOID StartAddress;
+    HANDLE UniqueProcess; /* CLIENT_ID */
+    HANDLE UniqueThread;
+    LONG Priority;
+    LONG BasePriority;
+    ULONG ContextSwitches;
+    ULONG ThreadState;
+    ULONG WaitReason;
+} SIGAR_SYSTEM_THREAD_INFORMATION;
+
+typedef struct {
+    ULONG NextEntryOffset; /* 0 on the last record */
+    ULONG NumberOfThreads;
+    LARGE_INTEGER WorkingSetPrivateSize;
+    ULONG HardFaultCount;
+    ULONG NumberOfThreadsHighWatermark;
+    ULONGLONG CycleTime;
+    LARGE_INTEGER CreateTime;
+    LARGE_INTEGER UserTime;
+    LARGE_INTEGER KernelTime;
+    UNICODE_STRING ImageName;
+    LONG BasePriority;
+    HANDLE UniqueProcessId;
+    HANDLE InheritedFromUniqueProcessId;
+    ULONG HandleCount;
+    ULONG SessionId;
+    ULONG_PTR UniqueProcessKey;
+    SIZE_T PeakVirtualSize;
+    SIZE_T VirtualSize;
+    ULONG PageFaultCount;
+    SIZE_T PeakWorkingSetSize;
+    SIZE_T WorkingSetSize;
+    SIZE_T QuotaPeakPagedPoolUsage;
+    SIZE_T QuotaPagedPoolUsage;
+    SIZE_T QuotaPeakNonPagedPoolUsage;
+    SIZE_T QuotaNonPagedPoolUsage;
+    SIZE_T PagefileUsage;
+    SIZE_T PeakPagefileUsage;
+    SIZE_T PrivatePageCount;
+    LARGE_INTEGER ReadOperationCount;
+    LARGE_INTEGER WriteOperationCount;
+    LARGE_INTEGER OtherOperationCount;
+    LARGE_INTEGER ReadTransferCount;
+    LARGE_INTEGER WriteTransferCount;
+    LARGE_INTEGER OtherTransferCount;
+    SIGAR_SYSTEM_THREAD_INFORMATION Threads[1]; /* NumberOfThreads */
+} SIGAR_SYSTEM_PROCESS_INFORMATION;
+
 typedef struct _PEB_LDR_DATA {
     BYTE Reserved1[8];
     PVOID Reserved2[3];
@@ -416,6 +539,20 @@ typedef DWORD (CALLBACK *iphlpapi_get_udpx_table)(PMIB_UDPEXTABLE *,
                                                   DWORD,
                                                   DWORD);
 
+typedef DWORD (CALLBACK *iphlpapi_get_ext_tcp_table)(PVOID,
+                                                     PDWORD,
+                                                     BOOL,
+                                                     ULONG,
+                                                     int,
+                                                     ULONG);
+
+typedef DWORD (CALLBACK *iphlpapi_get_ext_udp_table)(PVOID,
+                                                     PDWORD,
+                                                     BOOL,
+                                                     ULONG,
+                                                     int,
+                                                     ULONG);
+
 typedef DWORD (CALLBACK *iphlpapi_get_tcp_stats)(PMIB_TCPSTATS);
 
 typedef DWORD (CALLBACK *iphlpapi_get_net_params)(PFIXED_INFO,
@@ -440,6 +577,11 @@ typedef BOOL (CALLBACK *advapi_query_service_status)(SC_HANDLE,
                                                      DWORD,
                                                      LPDWORD);
 
+/* Vista+, the PVOID is a SERVICE_NOTIFY */
+typedef DWORD (CALLBACK *advapi_notify_service_status)(SC_HANDLE,
+                                                       DWORD,
+                                                       PVOID);
+
 typedef DWORD (CALLBACK *iphlpapi_get_ipnet_table)(PMIB_IPNETTABLE,
                                                    PDWORD,
                                                    BOOL);
@@ -509,6 +651,8 @@ typedef struct {
     SIGAR_DLLFUNC(iphlpapi, get_udp_table);
     SIGAR_DLLFUNC(iphlpapi, get_tcpx_table);
     SIGAR_DLLFUNC(iphlpapi, get_udpx_table);
+    SIGAR_DLLFUNC(iphlpapi, get_ext_tcp_table);
+    SIGAR_DLLFUNC(iphlpapi, get_ext_udp_table);
     SIGAR_DLLFUNC(iphlpapi, get_tcp_stats);
     SIGAR_DLLFUNC(iphlpapi, get_net_params);
     SIGAR_DLLFUNC(iphlpapi, get_adapters_info);
@@ -523,6 +667,7 @@ typedef struct {
 
     SIGAR_DLLFUNC(advapi, convert_string_sid);
     SIGAR_DLLFUNC(advapi, query_service_status);
+    SIGAR_DLLFUNC(advapi, notify_service_status);
 
     sigar_dll_func_t end;
 } sigar_advapi_t;
@@ -573,10 +718,65 @@ typedef struct {
 typedef struct
 {
 	char *buffer;
-	DWORD size;
-	time_t create_time;
+	DWORD size;          /* kept from the last query, the next one starts at it */
+	sigar_uint64_t create_time; /* millis, 0 when it needs a query */
+	unsigned long generation;   /* bumped by every successful query */
 } buffer_t;
 
+typedef struct sigar_etw_t sigar_etw_t;
+
+/* who wants the kernel trace kept running */
+#define SIGAR_ETW_USER_API    0x01 /* sigar_proc_etw_set */
+#define SIGAR_ETW_USER_EVENTS 0x02 /* sigar_proc_events_create */
+
+/*
+ * every SERVICE_WIN32 service of the SCM with its state and pid,
+ * behind ptql Service.* queries.  enumerated again once older than
+ * SIGAR_SERVICES_EXPIRE, or as soon as a service is created or
+ * deleted where NotifyServiceStatusChange is there to tell us.
+ */
+typedef struct {
+    SC_HANDLE handle;
+    ENUM_SERVICE_STATUS_PROCESS *services; /* reused between enums */
+    DWORD size;
+    DWORD count;
+    sigar_uint64_t time; /* 0 when it needs an enum */
+    int walking;         /* a walk holds pointers into services */
+    sigar_cache_t *configs; /* name hash -> lpBinaryPathName */
+    void *notify;        /* SERVICE_NOTIFY while registered */
+} sigar_services_cache_t;
+
+/* state and pid of a service change with it, its path seldom does */
+#define SIGAR_SERVICES_EXPIRE (5 * SIGAR_MSEC)
+#define SIGAR_SERVICE_CONFIG_EXPIRE (300 * SIGAR_MSEC)
+
+/* a mounted volume, see volume_index_get */
+typedef struct {
+    char guid[MAX_PATH];     /* "\\?\Volume{...}\" */
+    char instance[MAX_PATH]; /* in LogicalDisk, "C:" or "HarddiskVolume3" */
+    char path[MAX_PATH];     /* drive letter, else first mount path */
+    DWORD number;            /* N of HarddiskVolumeN, -1 if not one */
+    DWORD disk;              /* PhysicalDisk of the first extent, or -1 */
+} win32_volume_t;
+
+/* pid -> instance in the Process perflib buffer, sorted by pid */
+typedef struct {
+    DWORD pid;
+    PERF_INSTANCE_DEFINITION *inst;
+} perf_proc_index_t;
+
+/*
+ * the implementation of each subsystem that depends on what the dlls
+ * export, chosen on first use instead of checking the function
+ * pointers of every one of them each call.  NULL until then.
+ */
+typedef struct {
+    int (*net_conn_tcp)(sigar_net_connection_walker_t *walker);
+    int (*net_conn_udp)(sigar_net_connection_walker_t *walker);
+    int (*proc_snapshot)(sigar_t *sigar, int flags,
+                         sigar_proc_snapshot_t *snapshot);
+} win32_backend_t;
+
 struct sigar_t {
     SIGAR_T_BASE;
     char *machine;
@@ -585,6 +785,16 @@ struct sigar_t {
     HKEY handle;
 	buffer_t** performanceBuffers;
 	buffer_t* processesBuffer;
+	buffer_t* sysprocBuffer; /* SystemProcessInformation records */
+	perf_proc_index_t *proc_index;
+	DWORD proc_index_number;
+	DWORD proc_index_size;
+	unsigned long proc_index_generation; /* of the Process buffer */
+	buffer_t* connBuffers[4]; /* GetExtended{Tcp,Udp}Table, v4 and v6 */
+    win32_volume_t *volumes; /* by volume GUID, rebuilt as they come and go */
+    DWORD volumes_number;
+    DWORD volumes_size;
+    sigar_uint64_t volumes_time;
     sigar_wtsapi_t wtsapi;
     sigar_iphlpapi_t iphlpapi;
     sigar_advapi_t advapi;
@@ -599,6 +809,11 @@ struct sigar_t {
     sigar_cache_t *netif_addr_rows;
     sigar_cache_t *netif_names; /* dwIndex -> net_interface_config.name */
     int netif_name_short;
+    void *wmi;     /* WMI connection, opened on first use */
+    int wmi_async; /* sigar_proc_wmi_async_set */
+    sigar_etw_t *etw; /* kernel trace, while anyone uses it */
+    sigar_services_cache_t services;
+    win32_backend_t backend;
 
     WORD ws_version;
     int ws_error;
@@ -630,6 +845,27 @@ int sigar_proc_args_wmi_get(sigar_t *sigar, sigar_pid_t pid,
 int sigar_proc_exe_wmi_get(sigar_t *sigar, sigar_pid_t pid,
                            sigar_proc_exe_t *procexe);
 
+void sigar_wmi_close(sigar_t *sigar);
+
+int sigar_etw_start(sigar_t *sigar, int user);
+
+void sigar_etw_stop(sigar_t *sigar, int user);
+
+/* process starts and exits, waiting up to timeout millis for one */
+int sigar_etw_events_take(sigar_t *sigar, int timeout,
+                          sigar_proc_event_list_t *list);
+
+/* ENOENT for pids that ran before the trace did */
+int sigar_etw_proc_disk_io_get(sigar_t *sigar, sigar_pid_t pid,
+                               sigar_proc_cumulative_disk_io_t *io);
+
+int sigar_etw_proc_net_io_get(sigar_t *sigar, sigar_pid_t pid,
+                              sigar_proc_net_io_t *procnetio);
+
+int sigar_etw_connection_pid_get(sigar_t *sigar,
+                                 sigar_net_connection_t *conn,
+                                 sigar_pid_t *pid);
+
 int sigar_parse_proc_args(sigar_t *sigar, WCHAR *buf,
                           sigar_proc_args_t *procargs);
 
@@ -646,6 +882,22 @@ int sigar_services_status_get(sigar_services_status_t *ss, DWORD state);
 
 void sigar_services_status_close(sigar_services_status_t *ss);
 
+/* the cached SCM table, services stay valid until the next call */
+int sigar_services_cache_get(sigar_t *sigar,
+                             ENUM_SERVICE_STATUS_PROCESS **services,
+                             DWORD *count);
+
+/* state is SERVICE_ACTIVE, SERVICE_INACTIVE or SERVICE_STATE_ALL */
+#define sigar_service_state_match(service, state) \
+    ((state) == SERVICE_STATE_ALL ? 1 : \
+     ((service)->ServiceStatusProcess.dwCurrentState == SERVICE_STOPPED) == \
+     ((state) == SERVICE_INACTIVE))
+
+/* lpBinaryPathName of the service, valid until the next call */
+int sigar_service_path_get(sigar_t *sigar, char *name, char **path);
+
+void sigar_services_cache_close(sigar_t *sigar);
+
 typedef struct sigar_services_walker_t sigar_services_walker_t;
 
 struct sigar_services_walker_t {
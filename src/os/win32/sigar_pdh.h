@@ -44,4 +44,43 @@
 #define PdhInstanceName(inst) \
     ((wchar_t *)((BYTE *)inst + inst->NameOffset))
 
+/*
+ * a PDH query kept open across samples: counters are added once,
+ * each tick is one sigar_pdh_query_collect and the values are
+ * formatted from that collection.  rate counters need two collects
+ * before they return data, PDH_INVALID_DATA until then.
+ * needs <windows.h>, include after sigar_os.h.
+ */
+
+#include <pdh.h>
+
+typedef struct {
+    HQUERY query;
+    DWORD number;
+    DWORD size;
+    HCOUNTER *counters;
+} sigar_pdh_query_t;
+
+SIGAR_DECLARE(int) sigar_pdh_query_open(sigar_pdh_query_t **query);
+
+SIGAR_DECLARE(int) sigar_pdh_query_close(sigar_pdh_query_t *query);
+
+/* path may use "*" wildcards for the array getter; *index for the getters */
+SIGAR_DECLARE(int) sigar_pdh_query_add(sigar_pdh_query_t *query,
+                                       LPCWSTR path, int *index);
+
+SIGAR_DECLARE(int) sigar_pdh_query_collect(sigar_pdh_query_t *query);
+
+SIGAR_DECLARE(int) sigar_pdh_query_value_get(sigar_pdh_query_t *query,
+                                             int index, double *value);
+
+/*
+ * every instance of a wildcard counter into the caller's buffer;
+ * *size is in bytes, PDH_MORE_DATA sets it to what is needed.
+ */
+SIGAR_DECLARE(int) sigar_pdh_query_array_get(sigar_pdh_query_t *query,
+                                             int index,
+                                             PDH_FMT_COUNTERVALUE_ITEM_W *items,
+                                             DWORD *size, DWORD *count);
+
 #endif /* SIGAR_PDH_H */
@@ -0,0 +1,675 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * process, thread, disk and tcp/ip events of a real-time kernel trace,
+ * consumed on a thread of its own into per-pid counters, a map of
+ * connections to the pids moving data on them and a queue of process
+ * starts and exits.  no process handle is ever opened: pids come with
+ * the events, disk i/o is charged to the pid of the issuing thread.
+ *
+ * windows 8 and later run a private system logger session; before
+ * that there is only the one "NT Kernel Logger", which fails with
+ * ERROR_ALREADY_EXISTS when someone else has it.
+ */
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <windows.h>
+#include <evntrace.h>
+#include <evntcons.h>
+
+#include "sigar.h"
+#include "sigar_private.h"
+#include "sigar_util.h"
+#include "sigar_os.h"
+
+/* the classic kernel event classes, not in every sdk */
+static const GUID etw_system_trace_guid =
+    { 0x9e814aad, 0x3204, 0x11d2,
+      { 0x9a, 0x82, 0x00, 0x60, 0x08, 0xa8, 0x69, 0x39 } };
+static const GUID etw_process_guid =
+    { 0x3d6fa8d0, 0xfe05, 0x11d0,
+      { 0x9d, 0xda, 0x00, 0xc0, 0x4f, 0xd7, 0xba, 0x7c } };
+static const GUID etw_thread_guid =
+    { 0x3d6fa8d1, 0xfe05, 0x11d0,
+      { 0x9d, 0xda, 0x00, 0xc0, 0x4f, 0xd7, 0xba, 0x7c } };
+static const GUID etw_disk_io_guid =
+    { 0x3d6fa8d4, 0xfe05, 0x11d0,
+      { 0x9d, 0xda, 0x00, 0xc0, 0x4f, 0xd7, 0xba, 0x7c } };
+static const GUID etw_tcpip_guid =
+    { 0x9a280ac0, 0xc8e0, 0x11d1,
+      { 0x84, 0xe2, 0x00, 0xc0, 0x4f, 0xb9, 0x98, 0xa2 } };
+
+#ifndef EVENT_TRACE_SYSTEM_LOGGER_MODE
+#define EVENT_TRACE_SYSTEM_LOGGER_MODE 0x02000000
+#endif
+
+#define ETW_ENABLE_FLAGS \
+    (EVENT_TRACE_FLAG_PROCESS | \
+     EVENT_TRACE_FLAG_THREAD  | \
+     EVENT_TRACE_FLAG_DISK_IO | \
+     EVENT_TRACE_FLAG_NETWORK_TCPIP)
+
+/* process and thread */
+#define ETW_START   1
+#define ETW_END     2
+#define ETW_DCSTART 3
+
+/* disk io */
+#define ETW_READ  10
+#define ETW_WRITE 11
+
+/* tcpip, ipv6 events are the ipv4 opcode + ETW_TCP_IPV6 */
+#define ETW_TCP_SEND       10
+#define ETW_TCP_RECV       11
+#define ETW_TCP_CONNECT    12
+#define ETW_TCP_DISCONNECT 13
+#define ETW_TCP_ACCEPT     15
+#define ETW_TCP_IPV6       16
+
+/* undelivered lifecycle events kept before they are given up */
+#define ETW_EVENTS_MAX (64 * 1024)
+#define ETW_EVENTS_CHUNK 256
+
+#define ETW_NAME_MAX 64
+
+typedef struct {
+    sigar_pid_t ppid;
+    int started;   /* seen from its start, the counts are whole */
+    sigar_uint64_t disk_read;
+    sigar_uint64_t disk_written;
+    sigar_uint64_t tcp_sent;
+    sigar_uint64_t tcp_received;
+} etw_proc_t;
+
+struct sigar_etw_t {
+    CRITICAL_SECTION lock;
+    HANDLE thread;       /* in ProcessTrace */
+    HANDLE wakeup;       /* set while events is not empty */
+    TRACEHANDLE session;
+    TRACEHANDLE trace;
+    EVENT_TRACE_PROPERTIES *props;
+    WCHAR name[ETW_NAME_MAX];
+    int users;           /* SIGAR_ETW_USER_* */
+    ULONG lost;          /* events and buffers the session dropped */
+    sigar_cache_t *procs;   /* pid -> etw_proc_t */
+    sigar_cache_t *threads; /* tid -> pid + 1 */
+    sigar_cache_t *conns;   /* etw_conn_key -> pid + 1 */
+    sigar_proc_event_list_t events;
+};
+
+static void etw_value_free(void *ptr)
+{
+}
+
+static DWORD etw_u32(const unsigned char *data, size_t offset)
+{
+    DWORD val;
+    memcpy(&val, data + offset, sizeof(val));
+    return val;
+}
+
+static WORD etw_port(const unsigned char *data, size_t offset)
+{
+    /* network byte order on the wire */
+    return (WORD)((data[offset] << 8) | data[offset + 1]);
+}
+
+/* what a connection is known by, the same from an event or the tables */
+static sigar_uint64_t etw_conn_key(const void *remote_address, size_t len,
+                                   WORD remote_port, WORD local_port)
+{
+    const unsigned char *ptr = remote_address;
+    sigar_uint32_t hash = 2166136261U;
+    size_t i;
+
+    for (i=0; i<len; i++) {
+        hash = (hash ^ ptr[i]) * 16777619U;
+    }
+
+    return ((sigar_uint64_t)local_port << 48) |
+        ((sigar_uint64_t)remote_port << 32) | hash;
+}
+
+static void etw_event_add(sigar_etw_t *etw, int type,
+                          sigar_pid_t pid, sigar_pid_t ppid, int exit_code)
+{
+    sigar_proc_event_list_t *list = &etw->events;
+    sigar_proc_event_t *event;
+
+    if (!(etw->users & SIGAR_ETW_USER_EVENTS)) {
+        return;
+    }
+
+    if (list->number >= ETW_EVENTS_MAX) {
+        /* the consumer has to look at every process again */
+        list->number = 0;
+        type = SIGAR_PROC_EVENT_OVERFLOW;
+        pid = ppid = -1;
+    }
+
+    if (list->number >= list->size) {
+        void *data = realloc(list->data,
+                             sizeof(*(list->data)) *
+                             (list->size + ETW_EVENTS_CHUNK));
+        if (!data) {
+            return;
+        }
+        list->data = data;
+        list->size += ETW_EVENTS_CHUNK;
+    }
+
+    event = &list->data[list->number++];
+    event->type = type;
+    event->pid = pid;
+    event->ppid = ppid;
+    event->exit_code = exit_code;
+
+    SetEvent(etw->wakeup);
+}
+
+static etw_proc_t *etw_proc_new(sigar_etw_t *etw, sigar_pid_t pid)
+{
+    sigar_cache_entry_t *entry = sigar_cache_get(etw->procs, pid);
+
+    if (!entry->value) {
+        entry->value = calloc(1, sizeof(etw_proc_t));
+    }
+    else {
+        memset(entry->value, 0, sizeof(etw_proc_t));
+    }
+
+    return entry->value;
+}
+
+static etw_proc_t *etw_proc_find(sigar_etw_t *etw, sigar_pid_t pid)
+{
+    sigar_cache_entry_t *entry = sigar_cache_find(etw->procs, pid);
+
+    return entry ? entry->value : NULL;
+}
+
+/* Process_TypeGroup1: UniqueProcessKey, ProcessId, ParentId, ... */
+static void etw_process_event(sigar_etw_t *etw, int opcode,
+                              const unsigned char *data, size_t len,
+                              size_t ptrsize)
+{
+    sigar_pid_t pid, ppid;
+    etw_proc_t *proc;
+
+    if (len < ptrsize + 16) {
+        return;
+    }
+
+    pid = etw_u32(data, ptrsize);
+    ppid = etw_u32(data, ptrsize + 4);
+
+    switch (opcode) {
+      case ETW_START:
+        if ((proc = etw_proc_new(etw, pid))) {
+            proc->ppid = ppid;
+            proc->started = 1;
+        }
+        /* a new process is a new program too */
+        etw_event_add(etw, SIGAR_PROC_EVENT_FORK, pid, ppid, 0);
+        etw_event_add(etw, SIGAR_PROC_EVENT_EXEC, pid, -1, 0);
+        break;
+      case ETW_DCSTART:
+        /* rundown of what ran before the session, counts start late */
+        if (!etw_proc_find(etw, pid) && (proc = etw_proc_new(etw, pid))) {
+            proc->ppid = ppid;
+        }
+        break;
+      case ETW_END:
+        sigar_cache_remove(etw->procs, pid);
+        etw_event_add(etw, SIGAR_PROC_EVENT_EXIT, pid, -1,
+                      (int)etw_u32(data, ptrsize + 12));
+        break;
+    }
+}
+
+/* Thread_TypeGroup1: ProcessId, TThreadId, ... */
+static void etw_thread_event(sigar_etw_t *etw, int opcode,
+                             const unsigned char *data, size_t len)
+{
+    DWORD pid, tid;
+
+    if (len < 8) {
+        return;
+    }
+
+    pid = etw_u32(data, 0);
+    tid = etw_u32(data, 4);
+
+    switch (opcode) {
+      case ETW_START:
+      case ETW_DCSTART:
+        sigar_cache_get(etw->threads, tid)->value =
+            (void *)(ULONG_PTR)(pid + 1);
+        break;
+      case ETW_END:
+        sigar_cache_remove(etw->threads, tid);
+        break;
+    }
+}
+
+/*
+ * DiskIo_TypeGroup1: DiskNumber, IrpFlags, TransferSize, Reserved,
+ * ByteOffset, FileObject, Irp, HighResResponseTime, IssuingThreadId.
+ * the header pid is often the system's, whoever completed the irp.
+ */
+static void etw_disk_event(sigar_etw_t *etw, int opcode,
+                           const unsigned char *data, size_t len,
+                           size_t ptrsize, EVENT_HEADER *header)
+{
+    size_t tid_offset = 32 + 2 * ptrsize;
+    sigar_cache_entry_t *entry;
+    etw_proc_t *proc;
+    DWORD size, tid;
+    sigar_pid_t pid = -1;
+
+    if (((opcode != ETW_READ) && (opcode != ETW_WRITE)) || (len < 12)) {
+        return;
+    }
+
+    size = etw_u32(data, 8);
+    tid = (len >= tid_offset + 4) ?
+        etw_u32(data, tid_offset) : header->ThreadId;
+
+    if ((entry = sigar_cache_find(etw->threads, tid))) {
+        pid = (sigar_pid_t)((ULONG_PTR)entry->value - 1);
+    }
+    else if (header->ProcessId != (ULONG)-1) {
+        pid = header->ProcessId;
+    }
+
+    if ((pid >= 0) && (proc = etw_proc_find(etw, pid))) {
+        if (opcode == ETW_READ) {
+            proc->disk_read += size;
+        }
+        else {
+            proc->disk_written += size;
+        }
+    }
+}
+
+/*
+ * TcpIp_TypeGroup1 and friends: PID, size, daddr, saddr, dport,
+ * sport.  daddr and dport are the remote end whichever way the data
+ * went, the ports are in network byte order.
+ */
+static void etw_tcpip_event(sigar_etw_t *etw, int opcode,
+                            const unsigned char *data, size_t len)
+{
+    size_t alen = 4;
+    sigar_uint64_t key;
+    etw_proc_t *proc;
+    sigar_pid_t pid;
+    DWORD size;
+
+    if (opcode > ETW_TCP_IPV6) {
+        opcode -= ETW_TCP_IPV6;
+        alen = 16;
+    }
+
+    if (len < 8 + 2 * alen + 4) {
+        return;
+    }
+
+    pid = etw_u32(data, 0);
+    size = etw_u32(data, 4);
+    key = etw_conn_key(data + 8, alen,
+                       etw_port(data, 8 + 2 * alen),
+                       etw_port(data, 8 + 2 * alen + 2));
+
+    switch (opcode) {
+      case ETW_TCP_SEND:
+      case ETW_TCP_RECV:
+        if ((proc = etw_proc_find(etw, pid))) {
+            if (opcode == ETW_TCP_SEND) {
+                proc->tcp_sent += size;
+            }
+            else {
+                proc->tcp_received += size;
+            }
+        }
+        /* fallthrough, also how connections from before are learned */
+      case ETW_TCP_CONNECT:
+      case ETW_TCP_ACCEPT:
+        sigar_cache_get(etw->conns, key)->value =
+            (void *)(ULONG_PTR)(pid + 1);
+        break;
+      case ETW_TCP_DISCONNECT:
+        sigar_cache_remove(etw->conns, key);
+        break;
+    }
+}
+
+static VOID WINAPI etw_event(PEVENT_RECORD record)
+{
+    sigar_etw_t *etw = (sigar_etw_t *)record->UserContext;
+    EVENT_HEADER *header = &record->EventHeader;
+    const unsigned char *data = record->UserData;
+    size_t len = record->UserDataLength;
+    size_t ptrsize =
+        (header->Flags & EVENT_HEADER_FLAG_32_BIT_HEADER) ? 4 : 8;
+    int opcode = header->EventDescriptor.Opcode;
+
+    if (!data) {
+        return;
+    }
+
+    EnterCriticalSection(&etw->lock);
+
+    if (IsEqualGUID(&header->ProviderId, &etw_disk_io_guid)) {
+        etw_disk_event(etw, opcode, data, len, ptrsize, header);
+    }
+    else if (IsEqualGUID(&header->ProviderId, &etw_tcpip_guid)) {
+        etw_tcpip_event(etw, opcode, data, len);
+    }
+    else if (IsEqualGUID(&header->ProviderId, &etw_thread_guid)) {
+        etw_thread_event(etw, opcode, data, len);
+    }
+    else if (IsEqualGUID(&header->ProviderId, &etw_process_guid)) {
+        etw_process_event(etw, opcode, data, len, ptrsize);
+    }
+
+    LeaveCriticalSection(&etw->lock);
+}
+
+static DWORD WINAPI etw_thread(LPVOID data)
+{
+    sigar_etw_t *etw = (sigar_etw_t *)data;
+
+    /* returns once CloseTrace is called on the handle */
+    ProcessTrace(&etw->trace, 1, NULL, NULL);
+
+    return 0;
+}
+
+/* the properties ControlTrace and StartTrace read and write back */
+static EVENT_TRACE_PROPERTIES *etw_props_reset(sigar_etw_t *etw)
+{
+    EVENT_TRACE_PROPERTIES *props = etw->props;
+    ULONG size = sizeof(*props) + sizeof(etw->name);
+
+    memset(props, 0, size);
+    props->Wnode.BufferSize = size;
+    props->LoggerNameOffset = sizeof(*props);
+
+    return props;
+}
+
+static ULONG etw_session_start(sigar_etw_t *etw, ULONG mode)
+{
+    EVENT_TRACE_PROPERTIES *props = etw_props_reset(etw);
+
+    props->Wnode.Flags = WNODE_FLAG_TRACED_GUID;
+    props->Wnode.ClientContext = 1; /* QueryPerformanceCounter stamps */
+    if (!(mode & EVENT_TRACE_SYSTEM_LOGGER_MODE)) {
+        props->Wnode.Guid = etw_system_trace_guid;
+    }
+    props->EnableFlags = ETW_ENABLE_FLAGS;
+    props->LogFileMode = EVENT_TRACE_REAL_TIME_MODE | mode;
+    props->FlushTimer = 1; /* seconds an event can wait in a buffer */
+
+    return StartTraceW(&etw->session, etw->name, props);
+}
+
+static ULONG etw_session_stop(sigar_etw_t *etw)
+{
+    return ControlTraceW(etw->session, etw->name, etw_props_reset(etw),
+                         EVENT_TRACE_CONTROL_STOP);
+}
+
+static void etw_free(sigar_etw_t *etw)
+{
+    if (etw->procs) {
+        sigar_cache_destroy(etw->procs);
+    }
+    if (etw->threads) {
+        sigar_cache_destroy(etw->threads);
+    }
+    if (etw->conns) {
+        sigar_cache_destroy(etw->conns);
+    }
+    if (etw->props) {
+        free(etw->props);
+    }
+    if (etw->wakeup) {
+        CloseHandle(etw->wakeup);
+    }
+    sigar_proc_event_list_destroy(&etw->events);
+    DeleteCriticalSection(&etw->lock);
+    free(etw);
+}
+
+int sigar_etw_start(sigar_t *sigar, int user)
+{
+    EVENT_TRACE_LOGFILEW logfile;
+    sigar_etw_t *etw;
+    ULONG status;
+
+    if (sigar->etw) {
+        sigar->etw->users |= user;
+        return SIGAR_OK;
+    }
+
+    if (!(etw = calloc(1, sizeof(*etw)))) {
+        return ENOMEM;
+    }
+
+    InitializeCriticalSection(&etw->lock);
+    etw->procs = sigar_cache_new(SIGAR_PROC_LIST_MAX);
+    etw->threads = sigar_cache_new(SIGAR_PROC_LIST_MAX * 4);
+    etw->threads->free_value = etw_value_free;
+    etw->conns = sigar_cache_new(SIGAR_PROC_LIST_MAX);
+    etw->conns->free_value = etw_value_free;
+    etw->props = malloc(sizeof(*etw->props) + sizeof(etw->name));
+    etw->wakeup = CreateEvent(NULL, TRUE, FALSE, NULL);
+    etw->users = user;
+
+    if (!etw->props || !etw->wakeup) {
+        etw_free(etw);
+        return ENOMEM;
+    }
+
+    /* one session per handle, named so a crashed one can be stopped */
+    _snwprintf(etw->name, ETW_NAME_MAX - 1, L"SIGAR Kernel Trace %lu %p",
+               GetCurrentProcessId(), (void *)sigar);
+
+    status = etw_session_start(etw, EVENT_TRACE_SYSTEM_LOGGER_MODE);
+    if (status == ERROR_ALREADY_EXISTS) {
+        etw_session_stop(etw);
+        status = etw_session_start(etw, EVENT_TRACE_SYSTEM_LOGGER_MODE);
+    }
+    if (status == ERROR_INVALID_PARAMETER) {
+        /* before windows 8, the one kernel logger there is */
+        wcscpy(etw->name, KERNEL_LOGGER_NAMEW);
+        status = etw_session_start(etw, 0);
+    }
+    if (status != ERROR_SUCCESS) {
+        etw_free(etw);
+        return status;
+    }
+
+    memset(&logfile, 0, sizeof(logfile));
+    logfile.LoggerName = etw->name;
+    logfile.ProcessTraceMode =
+        PROCESS_TRACE_MODE_REAL_TIME | PROCESS_TRACE_MODE_EVENT_RECORD;
+    logfile.EventRecordCallback = etw_event;
+    logfile.Context = etw;
+
+    etw->trace = OpenTraceW(&logfile);
+    if (etw->trace == (TRACEHANDLE)INVALID_HANDLE_VALUE) {
+        status = GetLastError();
+        etw_session_stop(etw);
+        etw_free(etw);
+        return status;
+    }
+
+    if (!(etw->thread = CreateThread(NULL, 0, etw_thread, etw, 0, NULL))) {
+        status = GetLastError();
+        CloseTrace(etw->trace);
+        etw_session_stop(etw);
+        etw_free(etw);
+        return status;
+    }
+
+    sigar->etw = etw;
+
+    return SIGAR_OK;
+}
+
+void sigar_etw_stop(sigar_t *sigar, int user)
+{
+    sigar_etw_t *etw = sigar->etw;
+
+    if (!etw || ((etw->users &= ~user) != 0)) {
+        return;
+    }
+
+    sigar->etw = NULL;
+
+    etw_session_stop(etw);
+    CloseTrace(etw->trace);
+    WaitForSingleObject(etw->thread, INFINITE);
+    CloseHandle(etw->thread);
+
+    etw_free(etw);
+}
+
+/* dropped by the session since the last call, a lifecycle gap */
+static int etw_lost(sigar_etw_t *etw)
+{
+    EVENT_TRACE_PROPERTIES *props = etw_props_reset(etw);
+    ULONG lost;
+
+    if (ControlTraceW(etw->session, etw->name, props,
+                      EVENT_TRACE_CONTROL_QUERY) != ERROR_SUCCESS)
+    {
+        return 0;
+    }
+
+    lost = props->EventsLost + props->RealTimeBuffersLost;
+    if (lost == etw->lost) {
+        return 0;
+    }
+
+    etw->lost = lost;
+    return 1;
+}
+
+int sigar_etw_events_take(sigar_t *sigar, int timeout,
+                          sigar_proc_event_list_t *list)
+{
+    sigar_etw_t *etw = sigar->etw;
+    int lost;
+
+    if (!etw) {
+        return SIGAR_ENOTIMPL;
+    }
+
+    if (WaitForSingleObject(etw->wakeup,
+                            timeout < 0 ? INFINITE : (DWORD)timeout) ==
+        WAIT_FAILED)
+    {
+        return GetLastError();
+    }
+
+    lost = etw_lost(etw);
+
+    EnterCriticalSection(&etw->lock);
+    if (lost) {
+        /* what the session dropped may have been a start or an exit */
+        etw->events.number = 0;
+        etw_event_add(etw, SIGAR_PROC_EVENT_OVERFLOW, -1, -1, 0);
+    }
+    *list = etw->events;
+    etw->events.number = etw->events.size = 0;
+    etw->events.data = NULL;
+    ResetEvent(etw->wakeup);
+    LeaveCriticalSection(&etw->lock);
+
+    return SIGAR_OK;
+}
+
+int sigar_etw_proc_disk_io_get(sigar_t *sigar, sigar_pid_t pid,
+                               sigar_proc_cumulative_disk_io_t *io)
+{
+    sigar_etw_t *etw = sigar->etw;
+    etw_proc_t *proc;
+    int status = ENOENT;
+
+    EnterCriticalSection(&etw->lock);
+    /* only what started under the trace has had all of its i/o seen */
+    if ((proc = etw_proc_find(etw, pid)) && proc->started) {
+        io->bytes_read = proc->disk_read;
+        io->bytes_written = proc->disk_written;
+        io->bytes_total = io->bytes_read + io->bytes_written;
+        status = SIGAR_OK;
+    }
+    LeaveCriticalSection(&etw->lock);
+
+    return status;
+}
+
+int sigar_etw_proc_net_io_get(sigar_t *sigar, sigar_pid_t pid,
+                              sigar_proc_net_io_t *procnetio)
+{
+    sigar_etw_t *etw = sigar->etw;
+    etw_proc_t *proc;
+    int status = SIGAR_NO_SUCH_PROCESS;
+
+    EnterCriticalSection(&etw->lock);
+    if ((proc = etw_proc_find(etw, pid))) {
+        procnetio->bytes_sent = proc->tcp_sent;
+        procnetio->bytes_received = proc->tcp_received;
+        procnetio->bytes_total =
+            procnetio->bytes_sent + procnetio->bytes_received;
+        procnetio->sockets = SIGAR_FIELD_NOTIMPL;
+        status = SIGAR_OK;
+    }
+    LeaveCriticalSection(&etw->lock);
+
+    return status;
+}
+
+int sigar_etw_connection_pid_get(sigar_t *sigar,
+                                 sigar_net_connection_t *conn,
+                                 sigar_pid_t *pid)
+{
+    sigar_etw_t *etw = sigar->etw;
+    sigar_cache_entry_t *entry;
+    sigar_uint64_t key;
+
+    if (conn->remote_address.family == SIGAR_AF_INET6) {
+        key = etw_conn_key(conn->remote_address.addr.in6, 16,
+                           (WORD)conn->remote_port, (WORD)conn->local_port);
+    }
+    else {
+        key = etw_conn_key(&conn->remote_address.addr.in, 4,
+                           (WORD)conn->remote_port, (WORD)conn->local_port);
+    }
+
+    EnterCriticalSection(&etw->lock);
+    entry = sigar_cache_find(etw->conns, key);
+    *pid = entry ? (sigar_pid_t)((ULONG_PTR)entry->value - 1) : 0;
+    LeaveCriticalSection(&etw->lock);
+
+    return SIGAR_OK;
+}
@@ -0,0 +1,131 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * persistent PDH queries for sampling arbitrary counters
+ */
+
+#include "sigar.h"
+#include "sigar_private.h"
+#include "sigar_os.h"
+#include "sigar_pdh.h"
+
+#include <pdhmsg.h>
+
+#pragma comment(lib, "pdh.lib")
+
+#define PDH_QUERY_COUNTERS 8
+
+#define PDH_QUERY_COUNTER(query, index) \
+    if (((index) < 0) || ((DWORD)(index) >= (query)->number)) { \
+        return PDH_INVALID_HANDLE; \
+    }
+
+SIGAR_DECLARE(int) sigar_pdh_query_open(sigar_pdh_query_t **query)
+{
+    PDH_STATUS status;
+    HQUERY handle;
+
+    if ((status = PdhOpenQuery(NULL, 0, &handle)) != ERROR_SUCCESS) {
+        return status;
+    }
+
+    *query = malloc(sizeof(**query));
+    (*query)->query = handle;
+    (*query)->number = 0;
+    (*query)->size = PDH_QUERY_COUNTERS;
+    (*query)->counters = malloc(sizeof(HCOUNTER) * (*query)->size);
+
+    return SIGAR_OK;
+}
+
+/* PdhCloseQuery removes the counters along with the query */
+SIGAR_DECLARE(int) sigar_pdh_query_close(sigar_pdh_query_t *query)
+{
+    PDH_STATUS status = PdhCloseQuery(query->query);
+
+    free(query->counters);
+    free(query);
+
+    return status;
+}
+
+SIGAR_DECLARE(int) sigar_pdh_query_add(sigar_pdh_query_t *query,
+                                       LPCWSTR path, int *index)
+{
+    PDH_STATUS status;
+    HCOUNTER counter;
+
+    status = PdhAddCounterW(query->query, path, 0, &counter);
+    if (status != ERROR_SUCCESS) {
+        return status;
+    }
+
+    if (query->number >= query->size) {
+        query->size *= 2;
+        query->counters =
+            realloc(query->counters, sizeof(HCOUNTER) * query->size);
+    }
+
+    *index = query->number;
+    query->counters[query->number++] = counter;
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int) sigar_pdh_query_collect(sigar_pdh_query_t *query)
+{
+    return PdhCollectQueryData(query->query);
+}
+
+SIGAR_DECLARE(int) sigar_pdh_query_value_get(sigar_pdh_query_t *query,
+                                             int index, double *value)
+{
+    PDH_FMT_COUNTERVALUE fmt;
+    PDH_STATUS status;
+
+    PDH_QUERY_COUNTER(query, index);
+
+    status = PdhGetFormattedCounterValue(query->counters[index],
+                                         PDH_FMT_DOUBLE | PDH_FMT_NOCAP100,
+                                         NULL, &fmt);
+    if (status != ERROR_SUCCESS) {
+        return status;
+    }
+    if ((fmt.CStatus != PDH_CSTATUS_VALID_DATA) &&
+        (fmt.CStatus != PDH_CSTATUS_NEW_DATA))
+    {
+        return fmt.CStatus;
+    }
+
+    *value = fmt.doubleValue;
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int) sigar_pdh_query_array_get(sigar_pdh_query_t *query,
+                                             int index,
+                                             PDH_FMT_COUNTERVALUE_ITEM_W *items,
+                                             DWORD *size, DWORD *count)
+{
+    PDH_STATUS status;
+
+    PDH_QUERY_COUNTER(query, index);
+
+    status = PdhGetFormattedCounterArrayW(query->counters[index],
+                                          PDH_FMT_DOUBLE | PDH_FMT_NOCAP100,
+                                          size, count, items);
+
+    return (status == ERROR_SUCCESS) ? SIGAR_OK : status;
+}
@@ -18,11 +18,12 @@
 
 #include "sigar.h"
 #include "sigar_private.h"
-#include "sigar_pdh.h"
 #include "sigar_os.h"
+#include "sigar_pdh.h"
 #include "sigar_util.h"
 #include "sigar_format.h"
 #include <shellapi.h>
+#include <winioctl.h>
 #ifndef MSVC
 #include <iphlpapi.h>
 #endif
@@ -38,6 +39,7 @@
 #define PERF_TITLE_PROC_KEY  "230"
 #define PERF_TITLE_CPU_KEY   "238"
 #define PERF_TITLE_DISK_KEY  "236"
+#define PERF_TITLE_PHYSICAL_DISK_KEY "234"
 
 typedef enum
 {
@@ -46,6 +48,8 @@ typedef enum
 	, PERF_COUNTER_PROC
 	, PERF_COUNTER_CPU
 	, PERF_COUNTER_DISK
+	, PERF_COUNTER_PHYSICAL_DISK
+	, PERF_COUNTER_MAX
 } perf_counter_keys_t;
 
 #define PERF_TITLE_CPU_USER    142
@@ -160,14 +164,16 @@ static DWORD buffer_init(buffer_t *buffer)
 		buffer->buffer = malloc(BUFFER_SIZE);
         buffer->size = BUFFER_SIZE;
 		buffer->create_time = 0;
+		buffer->generation = 0;
     }
 
-	return BUFFER_SIZE;
+	/* whatever fit last time, so a steady state needs one query */
+	return buffer->size;
 }
 
 static DWORD buffer_grow(buffer_t *buffer)
 {
-	buffer->size += BUFFER_SIZE;
+	buffer->size *= 2;
 
 	buffer->buffer =
 		realloc(buffer->buffer, buffer->size);
@@ -189,11 +195,44 @@ static char *get_counter_name(char *key)
     else if (strEQ(key, PERF_TITLE_DISK_KEY)) {
         return "LogicalDisk";
     }
+    else if (strEQ(key, PERF_TITLE_PHYSICAL_DISK_KEY)) {
+        return "PhysicalDisk";
+    }
     else {
         return key;
     }
 }
 
+static int perf_registry_open(sigar_t *sigar)
+{
+    LONG result;
+
+    if (sigar->handle) {
+        return SIGAR_OK;
+    }
+
+    if (USING_WIDE_S(sigar)) {
+        WCHAR wmachine[MAX_PATH+1];
+
+        SIGAR_A2W(sigar->machine, wmachine, sizeof(wmachine));
+
+        result = RegConnectRegistryW(wmachine,
+                                     HKEY_PERFORMANCE_DATA,
+                                     &sigar->handle);
+    }
+    else {
+        result = RegConnectRegistryA(sigar->machine,
+                                     HKEY_PERFORMANCE_DATA,
+                                     &sigar->handle);
+    }
+
+    if (result != ERROR_SUCCESS) {
+        sigar->handle = NULL;
+    }
+
+    return result;
+}
+
 static int get_performance_buffer_by_counter_key(sigar_t* sigar, char* counterKey, buffer_t** performanceBuffer)
 {
 	int i;
@@ -212,6 +251,9 @@ static int get_performance_buffer_by_counter_key(sigar_t* sigar, char* counterKe
 	}
 	else if (strEQ(counterKey, PERF_TITLE_DISK_KEY)) {
 		i = PERF_COUNTER_DISK;
+	}
+	else if (strEQ(counterKey, PERF_TITLE_PHYSICAL_DISK_KEY)) {
+		i = PERF_COUNTER_PHYSICAL_DISK;
 	} else {
 		return -1;
 	}
@@ -229,7 +271,7 @@ static PERF_OBJECT_TYPE *get_perf_object_inst(sigar_t *sigar,
     WCHAR wcounter_key[MAX_PATH+1];
     PERF_DATA_BLOCK *block;
     PERF_OBJECT_TYPE *object;
-	time_t timenow = time(NULL);
+	sigar_uint64_t timenow = sigar_time_now_millis();
 	buffer_t* performanceBuffer;
     *err = get_performance_buffer_by_counter_key(sigar, counter_key, &performanceBuffer);
 	
@@ -237,40 +279,47 @@ static PERF_OBJECT_TYPE *get_perf_object_inst(sigar_t *sigar,
 		return NULL;
 	}
 
-	if ((timenow - performanceBuffer->create_time) < SIGAR_BUFFER_EXPIRE) {
-		return PdhFirstObject(((PERF_DATA_BLOCK *)performanceBuffer->buffer));
+	if ((*err = perf_registry_open(sigar)) != SIGAR_OK) {
+		return NULL;
 	}
-	
-	
-	if (USING_WIDE()) {
-        SIGAR_A2W(counter_key, wcounter_key, sizeof(wcounter_key));
-    }
 
-	bytes = buffer_init(performanceBuffer);
-	
-    while ((retval = MyRegQueryValue()) != ERROR_SUCCESS) {
-        if (retval == ERROR_MORE_DATA) {
-			bytes = buffer_grow(performanceBuffer);
-        }
-        else {
-            *err = retval;
-            return NULL;
-        }
-    }
+	/* every getter shares the last query of this object type */
+	if (!performanceBuffer->create_time ||
+		((timenow - performanceBuffer->create_time) >= SIGAR_BUFFER_EXPIRE))
+	{
+		if (USING_WIDE()) {
+			SIGAR_A2W(counter_key, wcounter_key, sizeof(wcounter_key));
+		}
 
-	block = (PERF_DATA_BLOCK *)performanceBuffer->buffer;
-	
-    if (block->NumObjectTypes == 0) {
-        counter_key = get_counter_name(counter_key);
-        sigar_strerror_printf(sigar, "No %s counters defined (disabled?)",
-                              counter_key);
-        *err = -1;
-        return NULL;
-    }
-	
-	performanceBuffer->buffer = block;
-	performanceBuffer->create_time = time(NULL);
+		bytes = buffer_init(performanceBuffer);
 
+		while ((retval = MyRegQueryValue()) != ERROR_SUCCESS) {
+			if (retval == ERROR_MORE_DATA) {
+				bytes = buffer_grow(performanceBuffer);
+			}
+			else {
+				performanceBuffer->create_time = 0;
+				*err = retval;
+				return NULL;
+			}
+		}
+
+		block = (PERF_DATA_BLOCK *)performanceBuffer->buffer;
+
+		if (block->NumObjectTypes == 0) {
+			performanceBuffer->create_time = 0;
+			counter_key = get_counter_name(counter_key);
+			sigar_strerror_printf(sigar, "No %s counters defined (disabled?)",
+								  counter_key);
+			*err = -1;
+			return NULL;
+		}
+
+		performanceBuffer->create_time = timenow;
+		performanceBuffer->generation++;
+	}
+
+	block = (PERF_DATA_BLOCK *)performanceBuffer->buffer;
     object = PdhFirstObject(block);
 
     /* 
@@ -382,6 +431,8 @@ static sigar_iphlpapi_t sigar_iphlpapi = {
     { "GetUdpTable", NULL },
     { "AllocateAndGetTcpExTableFromStack", NULL },
     { "AllocateAndGetUdpExTableFromStack", NULL },
+    { "GetExtendedTcpTable", NULL },
+    { "GetExtendedUdpTable", NULL },
     { "GetTcpStatistics", NULL },
     { "GetNetworkParams", NULL },
     { "GetAdaptersInfo", NULL },
@@ -395,6 +446,7 @@ static sigar_advapi_t sigar_advapi = {
     NULL,
     { "ConvertStringSidToSidA", NULL },
     { "QueryServiceStatusEx", NULL },
+    { "NotifyServiceStatusChangeA", NULL },
     { NULL, NULL }
 };
 
@@ -569,6 +621,17 @@ static int sigar_enable_privilege(char *name)
     return status;
 }
 
+/* increase process visibility, the token is per process so once will do */
+static void enable_debug_privilege(void)
+{
+    static int enabled = 0;
+
+    if (!enabled) {
+        enabled = 1;
+        sigar_enable_privilege(SE_DEBUG_NAME);
+    }
+}
+
 static int netif_name_short(void)
 {
     char value[32767]; /* max size from msdn docs */
@@ -584,7 +647,6 @@ static int netif_name_short(void)
 
 int sigar_os_open(sigar_t **sigar_ptr)
 {
-    LONG result;
     HINSTANCE h;
     OSVERSIONINFO version;
     int i;
@@ -598,13 +660,22 @@ int sigar_os_open(sigar_t **sigar_ptr)
 	sigar->processesBuffer->buffer = NULL;
 	buffer_init(sigar->processesBuffer);
 
-	sigar->performanceBuffers = (buffer_t**)malloc(sizeof(buffer_t *) * 5);
-	for (i = 0; i < 5; i++)
+	sigar->sysprocBuffer = (buffer_t*) malloc(sizeof(buffer_t));
+	sigar->sysprocBuffer->buffer = NULL;
+	buffer_init(sigar->sysprocBuffer);
+
+	sigar->performanceBuffers = (buffer_t**)malloc(sizeof(buffer_t *) * PERF_COUNTER_MAX);
+	for (i = 0; i < PERF_COUNTER_MAX; i++)
 	{
 		sigar->performanceBuffers[i] = (buffer_t*)malloc(sizeof(buffer_t));
 		sigar->performanceBuffers[i]->buffer = NULL;
 		buffer_init(sigar->performanceBuffers[i]);
 	}
+
+	/* sized on first use */
+	for (i = 0; i < 4; i++) {
+		sigar->connBuffers[i] = NULL;
+	}
 	
     version.dwOSVersionInfoSize = sizeof(version);
     GetVersionEx(&version);
@@ -615,20 +686,8 @@ int sigar_os_open(sigar_t **sigar_ptr)
      */
     sigar->winnt = (version.dwMajorVersion == 4);
 
-    if (USING_WIDE_S(sigar)) {
-        WCHAR wmachine[MAX_PATH+1];
-
-        SIGAR_A2W(sigar->machine, wmachine, sizeof(wmachine));
-
-        result = RegConnectRegistryW(wmachine,
-                                     HKEY_PERFORMANCE_DATA,
-                                     &sigar->handle);
-    }
-    else {
-        result = RegConnectRegistryA(sigar->machine,
-                                     HKEY_PERFORMANCE_DATA,
-                                     &sigar->handle);
-    }
+    /* connected on the first perf query, see perf_registry_open */
+    sigar->handle = NULL;
 
     get_sysinfo(sigar);
 
@@ -641,26 +700,56 @@ int sigar_os_open(sigar_t **sigar_ptr)
     DLLMOD_COPY(kernel);
     DLLMOD_COPY(mpr);
 
-    sigar->log_level = -1; /* else below segfaults */
-    /* XXX init early for use by javasigar.c */
-    sigar_dllmod_init(sigar,
-                      (sigar_dll_module_t *)&sigar->advapi,
-                      FALSE);
+    sigar->log_level = -1;
 
     sigar->netif_mib_rows = NULL;
     sigar->netif_addr_rows = NULL;
     sigar->netif_adapters = NULL;
     sigar->netif_names = NULL;
     sigar->netif_name_short = netif_name_short();
+    sigar->wmi = NULL;
+    sigar->wmi_async = 0;
+    sigar->etw = NULL;
+    SIGAR_ZERO(&sigar->services);
+    SIGAR_ZERO(&sigar->backend);
 
     sigar->pinfo.pid = -1;
+    sigar->proc_index = NULL;
+    sigar->proc_index_number = sigar->proc_index_size = 0;
+    sigar->proc_index_generation = 0;
+    sigar->volumes = NULL;
+    sigar->volumes_number = sigar->volumes_size = 0;
+    sigar->volumes_time = 0;
     sigar->ws_version = 0;
     sigar->lcpu = -1;
 
-    /* increase process visibility */
-    sigar_enable_privilege(SE_DEBUG_NAME);
+    return SIGAR_OK;
+}
+
+static void proc_snapshot_backend_init(sigar_t *sigar);
 
-    return result;
+static void net_conn_backend_init(sigar_t *sigar);
+
+int sigar_os_open_probe(sigar_t *sigar, int flags)
+{
+    int status;
+
+    if (flags & (SIGAR_OPEN_PROC|SIGAR_OPEN_DISK)) {
+        if ((status = perf_registry_open(sigar)) != SIGAR_OK) {
+            return status;
+        }
+    }
+    if (flags & SIGAR_OPEN_PROC) {
+        DLLMOD_INIT(advapi, FALSE);
+        enable_debug_privilege();
+        proc_snapshot_backend_init(sigar);
+    }
+    if (flags & SIGAR_OPEN_NET) {
+        net_conn_backend_init(sigar);
+        (void)sigar_wsa_init(sigar);
+    }
+
+    return SIGAR_OK;
 }
 
 void dllmod_init_ntdll(sigar_t *sigar)
@@ -680,6 +769,9 @@ int sigar_os_close(sigar_t *sigar)
 {
     int retval, i;
 
+    sigar_etw_stop(sigar, SIGAR_ETW_USER_API | SIGAR_ETW_USER_EVENTS);
+    sigar_services_cache_close(sigar);
+
     DLLMOD_FREE(wtsapi);
     DLLMOD_FREE(iphlpapi);
     DLLMOD_FREE(advapi);
@@ -690,16 +782,38 @@ int sigar_os_close(sigar_t *sigar)
     DLLMOD_FREE(mpr);
 
 	buffer_free(sigar->processesBuffer);
+	buffer_free(sigar->sysprocBuffer);
+
+#ifdef MSVC
+    sigar_wmi_close(sigar);
+#endif
 	
 	if (sigar->performanceBuffers) {
-		for (i = 0; i < 5; i++)	{
+		for (i = 0; i < PERF_COUNTER_MAX; i++)	{
 			buffer_free(sigar->performanceBuffers[i]);
 		}
 
 		free(sigar->performanceBuffers);
 	}
 
-    retval = RegCloseKey(sigar->handle);
+	if (sigar->proc_index) {
+		free(sigar->proc_index);
+	}
+
+	if (sigar->volumes) {
+		free(sigar->volumes);
+	}
+
+	for (i = 0; i < 4; i++) {
+		buffer_free(sigar->connBuffers[i]);
+	}
+
+    if (sigar->handle) {
+        retval = RegCloseKey(sigar->handle);
+    }
+    else {
+        retval = ERROR_SUCCESS;
+    }
 
     if (sigar->ws_version != 0) {
         WSACleanup();
@@ -1226,7 +1340,7 @@ int sigar_os_proc_list_get(sigar_t *sigar,
 				size = buffer_init(sigar->processesBuffer);
 			}
 			else {
-				size = buffer_grow(sigar);
+				size = buffer_grow(sigar->processesBuffer);
 			}
 
 			if (!sigar_EnumProcesses((DWORD *)sigar->processesBuffer->buffer,
@@ -1260,9 +1374,98 @@ int sigar_os_proc_list_get(sigar_t *sigar,
 
 static HANDLE open_process(sigar_pid_t pid)
 {
+    enable_debug_privilege();
     return OpenProcess(PROCESS_DAC, 0, (DWORD)pid);
 }
 
+/*
+ * the process object outlives the exit while the handle is open, so
+ * the pid is not handed out again until it is closed
+ */
+struct sigar_proc_handle_t {
+    sigar_pid_t pid;
+    HANDLE proc;
+};
+
+SIGAR_DECLARE(int) sigar_proc_handle_open(sigar_t *sigar, sigar_pid_t pid,
+                                          sigar_proc_handle_t **handle_ptr)
+{
+    sigar_proc_handle_t *handle;
+    HANDLE proc;
+
+    *handle_ptr = NULL;
+
+    enable_debug_privilege();
+    proc = OpenProcess(SYNCHRONIZE|PROCESS_TERMINATE, FALSE, (DWORD)pid);
+    if (!proc) {
+        return GetLastError();
+    }
+
+    if (!(handle = malloc(sizeof(*handle)))) {
+        CloseHandle(proc);
+        return ENOMEM;
+    }
+    handle->pid = pid;
+    handle->proc = proc;
+
+    *handle_ptr = handle;
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int) sigar_proc_handle_close(sigar_t *sigar,
+                                           sigar_proc_handle_t *handle)
+{
+    CloseHandle(handle->proc);
+    free(handle);
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(sigar_pid_t)
+sigar_proc_handle_pid_get(sigar_proc_handle_t *handle)
+{
+    return handle->pid;
+}
+
+SIGAR_DECLARE(sigar_proc_waitable_t)
+sigar_proc_handle_waitable_get(sigar_proc_handle_t *handle)
+{
+    return handle->proc;
+}
+
+SIGAR_DECLARE(int) sigar_proc_handle_wait(sigar_proc_handle_t *handle,
+                                          int timeout)
+{
+    switch (WaitForSingleObject(handle->proc,
+                                timeout < 0 ? INFINITE : (DWORD)timeout))
+    {
+      case WAIT_OBJECT_0:
+        return SIGAR_OK;
+      case WAIT_TIMEOUT:
+        return ETIMEDOUT;
+      default:
+        return GetLastError();
+    }
+}
+
+/* any signal but 0 terminates, as with sigar_proc_kill */
+SIGAR_DECLARE(int) sigar_proc_handle_kill(sigar_proc_handle_t *handle,
+                                          int signum)
+{
+    if (WaitForSingleObject(handle->proc, 0) == WAIT_OBJECT_0) {
+        return ESRCH;
+    }
+    if (signum == 0) {
+        return SIGAR_OK;
+    }
+    if (!TerminateProcess(handle->proc, signum)) {
+        return GetLastError();
+    }
+
+    return SIGAR_OK;
+}
+
 /*
  * Pretty good explanation of counters:
  * http://www.semack.net/wiki/default.asp?db=SemackNetWiki&o=VirtualMemory
@@ -1290,10 +1493,17 @@ SIGAR_DECLARE(int) sigar_proc_mem_get(sigar_t *sigar, sigar_pid_t pid,
 SIGAR_DECLARE(int) sigar_proc_cumulative_disk_io_get(sigar_t *sigar, sigar_pid_t pid,
                                           sigar_proc_cumulative_disk_io_t *proc_cumulative_disk_io)
 {
-    int status = get_proc_info(sigar, pid);
+    int status;
     sigar_win32_pinfo_t *pinfo = &sigar->pinfo;
 
-    if (status != SIGAR_OK) {
+    if (sigar->etw &&
+        (sigar_etw_proc_disk_io_get(sigar, pid,
+                                    proc_cumulative_disk_io) == SIGAR_OK))
+    {
+        return SIGAR_OK;
+    }
+
+    if ((status = get_proc_info(sigar, pid)) != SIGAR_OK) {
         return status;
     }
 
@@ -1463,6 +1673,76 @@ SIGAR_DECLARE(int) sigar_proc_state_get(sigar_t *sigar, sigar_pid_t pid,
     return SIGAR_OK;
 }
 
+static int perf_proc_index_cmp(const void *a, const void *b)
+{
+    DWORD x = ((const perf_proc_index_t *)a)->pid;
+    DWORD y = ((const perf_proc_index_t *)b)->pid;
+
+    return x < y ? -1 : (x > y);
+}
+
+/*
+ * the Process object has an instance per process, looking one up
+ * by walking them all made a proc_*_get for each pid quadratic.
+ * rebuilt once per query of the buffer, which the index points into.
+ */
+static PERF_INSTANCE_DEFINITION *
+perf_proc_index_find(sigar_t *sigar, PERF_OBJECT_TYPE *object,
+                     DWORD pid_offset, sigar_pid_t pid)
+{
+    buffer_t *buffer = sigar->performanceBuffers[PERF_COUNTER_PROC];
+    perf_proc_index_t key, *found;
+
+    if (!pid_offset) {
+        return NULL;
+    }
+
+    if (!sigar->proc_index ||
+        (sigar->proc_index_generation != buffer->generation))
+    {
+        PERF_INSTANCE_DEFINITION *inst;
+        LONG i;
+
+        if (sigar->proc_index_size < (DWORD)object->NumInstances) {
+            void *index = realloc(sigar->proc_index,
+                                  sizeof(*sigar->proc_index) *
+                                  object->NumInstances);
+            if (!index) {
+                return NULL;
+            }
+            sigar->proc_index = index;
+            sigar->proc_index_size = object->NumInstances;
+        }
+
+        sigar->proc_index_number = 0;
+        for (i=0, inst = PdhFirstInstance(object);
+             i<object->NumInstances;
+             i++, inst = PdhNextInstance(inst))
+        {
+            PERF_COUNTER_BLOCK *counter_block = PdhGetCounterBlock(inst);
+            perf_proc_index_t *entry =
+                &sigar->proc_index[sigar->proc_index_number++];
+
+            entry->pid = *((DWORD *)((BYTE *)counter_block + pid_offset));
+            entry->inst = inst;
+        }
+
+        qsort(sigar->proc_index, sigar->proc_index_number,
+              sizeof(*sigar->proc_index), perf_proc_index_cmp);
+        sigar->proc_index_generation = buffer->generation;
+    }
+
+    if (!sigar->proc_index_number) {
+        return NULL;
+    }
+
+    key.pid = (DWORD)pid;
+    found = bsearch(&key, sigar->proc_index, sigar->proc_index_number,
+                    sizeof(*sigar->proc_index), perf_proc_index_cmp);
+
+    return found ? found->inst : NULL;
+}
+
 static int get_proc_info(sigar_t *sigar, sigar_pid_t pid)
 {
     PERF_OBJECT_TYPE *object;
@@ -1544,16 +1824,10 @@ static int get_proc_info(sigar_t *sigar, sigar_pid_t pid)
         }
     }
 
-    for (i=0, inst = PdhFirstInstance(object);
-         i<object->NumInstances;
-         i++, inst = PdhNextInstance(inst))
+    if ((inst = perf_proc_index_find(sigar, object,
+                                     perf_offsets[PERF_IX_PID], pid)))
     {
         PERF_COUNTER_BLOCK *counter_block = PdhGetCounterBlock(inst);
-        sigar_pid_t this_pid = PERF_VAL(PERF_IX_PID);
-
-        if (this_pid != pid) {
-            continue;
-        }
 
         pinfo->state = 'R'; /* XXX? */
         SIGAR_W2A(PdhInstanceName(inst),
@@ -1575,55 +1849,500 @@ static int get_proc_info(sigar_t *sigar, sigar_pid_t pid)
     return SIGAR_NO_SUCH_PROCESS;
 }
 
-static int sigar_remote_proc_args_get(sigar_t *sigar, sigar_pid_t pid,
-                                      sigar_proc_args_t *procargs)
-{
-    int status;
-    char cmdline[SIGAR_CMDLINE_MAX], *ptr = cmdline, *arg;
-    HANDLE proc = open_process(pid);
+#define PERF_VAL64(ix) \
+    perf_offsets[ix] ? \
+        *((sigar_uint64_t *)((BYTE *)counter_block + perf_offsets[ix])) : 0
 
-    if (proc) {
-        status = sigar_proc_args_peb_get(sigar, proc, procargs);
+typedef enum {
+    PERF_IX_SNAP_PID,
+    PERF_IX_SNAP_PPID,
+    PERF_IX_SNAP_PRIORITY,
+    PERF_IX_SNAP_THREAD_CNT,
+    PERF_IX_SNAP_MEM_VSIZE,
+    PERF_IX_SNAP_MEM_SIZE,
+    PERF_IX_SNAP_PAGE_FAULTS,
+    PERF_IX_SNAP_CPU_USER,
+    PERF_IX_SNAP_CPU_SYS,
+    PERF_IX_SNAP_START_TIME,
+    PERF_IX_SNAP_MAX
+} perf_snapshot_offsets_t;
 
-        CloseHandle(proc);
+/*
+ * every process instance in the one perflib buffer,
+ * rather than one get_proc_info() scan per pid.
+ */
+static int proc_snapshot_perflib_get(sigar_t *sigar, int flags,
+                                     sigar_proc_snapshot_t *snapshot)
+{
+    PERF_OBJECT_TYPE *object;
+    PERF_INSTANCE_DEFINITION *inst;
+    PERF_COUNTER_DEFINITION *counter;
+    DWORD i, err;
+    DWORD perf_offsets[PERF_IX_SNAP_MAX];
 
-        if (status == SIGAR_OK) {
-            return status;
-        }
-    }
+    memset(&perf_offsets, 0, sizeof(perf_offsets));
 
-    /* likely we are 32-bit, pid process is 64-bit */
-#ifdef MSVC
-    status = sigar_proc_args_wmi_get(sigar, pid, procargs);
-#endif
-    if (status == ERROR_NOT_FOUND) {
-        status = SIGAR_NO_SUCH_PROCESS;
-    }
-    return status;
-}
+    object = get_process_object(sigar, &err);
 
-int sigar_os_proc_args_get(sigar_t *sigar, sigar_pid_t pid,
-                          sigar_proc_args_t *procargs)
-{
-    if (pid == sigar->pid) {
-        return sigar_parse_proc_args(sigar, NULL, procargs);
-    }
-    else {
-        return sigar_remote_proc_args_get(sigar, pid, procargs);
+    if (object == NULL) {
+        return err;
     }
-}
 
-static int sigar_proc_env_parse(UCHAR *ptr, sigar_proc_env_t *procenv,
-                                int multi)
-{
-    while (*ptr) {
-        char *val;
-        int klen, vlen, status;
-        char key[128]; /* XXX is there a max key size? */
+    for (i=0, counter = PdhFirstCounter(object);
+         i<object->NumCounters;
+         i++, counter = PdhNextCounter(counter))
+    {
+        DWORD offset = counter->CounterOffset;
 
-        if (*ptr == '=') {
-            ptr += strlen(ptr)+1;
-            continue;
+        switch (counter->CounterNameTitleIndex) {
+          case PERF_TITLE_PID:
+            perf_offsets[PERF_IX_SNAP_PID] = offset;
+            break;
+          case PERF_TITLE_PPID:
+            perf_offsets[PERF_IX_SNAP_PPID] = offset;
+            break;
+          case PERF_TITLE_PRIORITY:
+            perf_offsets[PERF_IX_SNAP_PRIORITY] = offset;
+            break;
+          case PERF_TITLE_THREAD_CNT:
+            perf_offsets[PERF_IX_SNAP_THREAD_CNT] = offset;
+            break;
+          case PERF_TITLE_MEM_VSIZE:
+            perf_offsets[PERF_IX_SNAP_MEM_VSIZE] = offset;
+            break;
+          case PERF_TITLE_MEM_SIZE:
+            perf_offsets[PERF_IX_SNAP_MEM_SIZE] = offset;
+            break;
+          case PERF_TITLE_PAGE_FAULTS:
+            perf_offsets[PERF_IX_SNAP_PAGE_FAULTS] = offset;
+            break;
+          case PERF_TITLE_CPU_USER:
+            perf_offsets[PERF_IX_SNAP_CPU_USER] = offset;
+            break;
+          case PERF_TITLE_CPU_SYS:
+            perf_offsets[PERF_IX_SNAP_CPU_SYS] = offset;
+            break;
+          case PERF_TITLE_START_TIME:
+            perf_offsets[PERF_IX_SNAP_START_TIME] = offset;
+            break;
+        }
+    }
+
+    for (i=0, inst = PdhFirstInstance(object);
+         i<object->NumInstances;
+         i++, inst = PdhNextInstance(inst))
+    {
+        PERF_COUNTER_BLOCK *counter_block = PdhGetCounterBlock(inst);
+        sigar_pid_t pid = PERF_VAL(PERF_IX_SNAP_PID);
+        sigar_proc_snapshot_entry_t *entry;
+
+        if (pid == 0) {
+            continue; /* dont include the system Idle process */
+        }
+
+        SIGAR_PROC_SNAPSHOT_GROW(snapshot);
+        entry = &snapshot->data[snapshot->number++];
+        entry->pid = pid;
+        entry->flags = 0;
+
+        if (flags & SIGAR_PROC_SNAPSHOT_STATE) {
+            sigar_proc_state_t *procstate = &entry->state;
+
+            SIGAR_W2A(PdhInstanceName(inst),
+                      procstate->name, sizeof(procstate->name));
+            procstate->state = 'R'; /* XXX? */
+            procstate->ppid = PERF_VAL(PERF_IX_SNAP_PPID);
+            procstate->priority = PERF_VAL(PERF_IX_SNAP_PRIORITY);
+            procstate->nice = SIGAR_FIELD_NOTIMPL;
+            procstate->tty =  SIGAR_FIELD_NOTIMPL;
+            procstate->threads = PERF_VAL(PERF_IX_SNAP_THREAD_CNT);
+            procstate->processor = SIGAR_FIELD_NOTIMPL;
+            entry->flags |= SIGAR_PROC_SNAPSHOT_STATE;
+        }
+
+        if (flags & SIGAR_PROC_SNAPSHOT_MEM) {
+            sigar_proc_mem_t *procmem = &entry->mem;
+
+            procmem->size     = PERF_VAL(PERF_IX_SNAP_MEM_VSIZE);
+            procmem->resident = PERF_VAL(PERF_IX_SNAP_MEM_SIZE);
+            procmem->share    = SIGAR_FIELD_NOTIMPL;
+            procmem->page_faults  = PERF_VAL(PERF_IX_SNAP_PAGE_FAULTS);
+            procmem->minor_faults = SIGAR_FIELD_NOTIMPL;
+            procmem->major_faults = SIGAR_FIELD_NOTIMPL;
+            entry->flags |= SIGAR_PROC_SNAPSHOT_MEM;
+        }
+
+        if (flags & SIGAR_PROC_SNAPSHOT_TIME) {
+            sigar_proc_cpu_t *proctime = &entry->cpu;
+            /* PERF_ELAPSED_TIME counters hold the start FILETIME */
+            sigar_uint64_t start = PERF_VAL64(PERF_IX_SNAP_START_TIME);
+
+            proctime->user  = NS100_2MSEC(PERF_VAL64(PERF_IX_SNAP_CPU_USER));
+            proctime->sys   = NS100_2MSEC(PERF_VAL64(PERF_IX_SNAP_CPU_SYS));
+            proctime->total = proctime->user + proctime->sys;
+
+            if (start) {
+                FILETIME ft;
+                ft.dwHighDateTime = (DWORD)(start >> 32);
+                ft.dwLowDateTime  = (DWORD)(start & 0xFFFFFFFF);
+                proctime->start_time = sigar_FileTimeToTime(&ft) / 1000;
+            }
+            else {
+                proctime->start_time = 0;
+            }
+            entry->flags |= SIGAR_PROC_SNAPSHOT_TIME;
+        }
+    }
+
+    return SIGAR_OK;
+}
+
+/*
+ * one SystemProcessInformation call returns every process with its
+ * threads; the records are kept for SIGAR_BUFFER_EXPIRE like the
+ * perflib buffers, and the buffer keeps the size that last fit.
+ */
+static SIGAR_SYSTEM_PROCESS_INFORMATION *get_sysproc_info(sigar_t *sigar,
+                                                          DWORD *err)
+{
+    buffer_t *buffer = sigar->sysprocBuffer;
+    sigar_uint64_t timenow = sigar_time_now_millis();
+    ULONG needed = 0;
+    DWORD status;
+
+    if (buffer->create_time &&
+        ((timenow - buffer->create_time) < SIGAR_BUFFER_EXPIRE))
+    {
+        return (SIGAR_SYSTEM_PROCESS_INFORMATION *)buffer->buffer;
+    }
+
+    buffer_init(buffer);
+
+    while ((status =
+            sigar_NtQuerySystemInformation(SystemProcessInformation,
+                                           buffer->buffer,
+                                           buffer->size,
+                                           &needed)) ==
+           SIGAR_STATUS_INFO_LENGTH_MISMATCH)
+    {
+        /* leave room for processes started before the retry */
+        do {
+            buffer_grow(buffer);
+        } while (buffer->size < needed + BUFFER_SIZE);
+    }
+
+    if (status != 0) {
+        buffer->create_time = 0;
+        *err = status;
+        return NULL;
+    }
+
+    buffer->create_time = timenow;
+    buffer->generation++;
+
+    return (SIGAR_SYSTEM_PROCESS_INFORMATION *)buffer->buffer;
+}
+
+/* perflib has no process state, the thread records do */
+static char sysproc_state(SIGAR_SYSTEM_PROCESS_INFORMATION *proc)
+{
+    ULONG i, suspended = 0;
+
+    if (proc->NumberOfThreads == 0) {
+        return SIGAR_PROC_STATE_ZOMBIE; /* exited, handles still open */
+    }
+
+    for (i=0; i<proc->NumberOfThreads; i++) {
+        SIGAR_SYSTEM_THREAD_INFORMATION *thread = &proc->Threads[i];
+
+        if (thread->ThreadState != SIGAR_THREAD_STATE_WAITING) {
+            return SIGAR_PROC_STATE_RUN;
+        }
+        if (thread->WaitReason == SIGAR_THREAD_WAIT_SUSPENDED) {
+            suspended++;
+        }
+    }
+
+    return (suspended == proc->NumberOfThreads) ?
+        SIGAR_PROC_STATE_STOP : SIGAR_PROC_STATE_SLEEP;
+}
+
+/* same form as the perflib instance name: no .exe suffix */
+static void sysproc_name(SIGAR_SYSTEM_PROCESS_INFORMATION *proc,
+                         char *name, int len)
+{
+    int n = 0;
+
+    if (proc->ImageName.Buffer) {
+        n = WideCharToMultiByte(CP_ACP, 0,
+                                proc->ImageName.Buffer,
+                                proc->ImageName.Length / sizeof(WCHAR),
+                                name, len-1, NULL, NULL);
+    }
+    name[n] = '\0';
+
+    if ((n > 4) && strcaseEQ(&name[n-4], ".exe")) {
+        name[n-4] = '\0';
+    }
+}
+
+static int proc_snapshot_ntsys_get(sigar_t *sigar, int flags,
+                                   sigar_proc_snapshot_t *snapshot)
+{
+    SIGAR_SYSTEM_PROCESS_INFORMATION *proc;
+    DWORD err;
+
+    if (!(proc = get_sysproc_info(sigar, &err))) {
+        return err;
+    }
+
+    while (1) {
+        sigar_pid_t pid = (sigar_pid_t)(ULONG_PTR)proc->UniqueProcessId;
+
+        if (pid != 0) { /* dont include the system Idle process */
+            sigar_proc_snapshot_entry_t *entry;
+
+            SIGAR_PROC_SNAPSHOT_GROW(snapshot);
+            entry = &snapshot->data[snapshot->number++];
+            entry->pid = pid;
+            entry->flags = 0;
+
+            if (flags & SIGAR_PROC_SNAPSHOT_STATE) {
+                sigar_proc_state_t *procstate = &entry->state;
+
+                sysproc_name(proc, procstate->name, sizeof(procstate->name));
+                procstate->state = sysproc_state(proc);
+                procstate->ppid =
+                    (sigar_pid_t)(ULONG_PTR)proc->InheritedFromUniqueProcessId;
+                procstate->priority = proc->BasePriority;
+                procstate->nice = SIGAR_FIELD_NOTIMPL;
+                procstate->tty =  SIGAR_FIELD_NOTIMPL;
+                procstate->threads = proc->NumberOfThreads;
+                procstate->processor = SIGAR_FIELD_NOTIMPL;
+                entry->flags |= SIGAR_PROC_SNAPSHOT_STATE;
+            }
+
+            if (flags & SIGAR_PROC_SNAPSHOT_MEM) {
+                sigar_proc_mem_t *procmem = &entry->mem;
+
+                procmem->size     = proc->VirtualSize;
+                procmem->resident = proc->WorkingSetSize;
+                procmem->share    = SIGAR_FIELD_NOTIMPL;
+                procmem->page_faults  = proc->PageFaultCount;
+                procmem->minor_faults = SIGAR_FIELD_NOTIMPL;
+                procmem->major_faults = SIGAR_FIELD_NOTIMPL;
+                entry->flags |= SIGAR_PROC_SNAPSHOT_MEM;
+            }
+
+            if (flags & SIGAR_PROC_SNAPSHOT_TIME) {
+                sigar_proc_cpu_t *proctime = &entry->cpu;
+
+                proctime->user  = NS100_2MSEC(proc->UserTime.QuadPart);
+                proctime->sys   = NS100_2MSEC(proc->KernelTime.QuadPart);
+                proctime->total = proctime->user + proctime->sys;
+
+                if (proc->CreateTime.QuadPart) {
+                    FILETIME ft;
+                    ft.dwHighDateTime = proc->CreateTime.HighPart;
+                    ft.dwLowDateTime  = proc->CreateTime.LowPart;
+                    proctime->start_time = sigar_FileTimeToTime(&ft) / 1000;
+                }
+                else {
+                    proctime->start_time = 0;
+                }
+                entry->flags |= SIGAR_PROC_SNAPSHOT_TIME;
+            }
+
+            if (flags & SIGAR_PROC_SNAPSHOT_DISK_IO) {
+                sigar_proc_cumulative_disk_io_t *io = &entry->disk_io;
+
+                io->bytes_read    = proc->ReadTransferCount.QuadPart;
+                io->bytes_written = proc->WriteTransferCount.QuadPart;
+                io->bytes_total   = io->bytes_read + io->bytes_written;
+                entry->flags |= SIGAR_PROC_SNAPSHOT_DISK_IO;
+            }
+        }
+
+        if (proc->NextEntryOffset == 0) {
+            break;
+        }
+        proc = (SIGAR_SYSTEM_PROCESS_INFORMATION *)
+            ((BYTE *)proc + proc->NextEntryOffset);
+    }
+
+    return SIGAR_OK;
+}
+
+static void proc_snapshot_backend_init(sigar_t *sigar)
+{
+    DLLMOD_INIT(ntdll, FALSE);
+
+    sigar->backend.proc_snapshot = sigar_NtQuerySystemInformation ?
+        proc_snapshot_ntsys_get : proc_snapshot_perflib_get;
+}
+
+int sigar_os_proc_snapshot_get(sigar_t *sigar, int flags,
+                               sigar_proc_snapshot_t *snapshot)
+{
+    int status;
+
+    if (!sigar->backend.proc_snapshot) {
+        proc_snapshot_backend_init(sigar);
+    }
+
+    status = sigar->backend.proc_snapshot(sigar, flags, snapshot);
+
+    if ((status != SIGAR_OK) &&
+        (sigar->backend.proc_snapshot == proc_snapshot_ntsys_get))
+    {
+        /* a query that failed this time, rather than one there is not */
+        snapshot->number = 0;
+        status = proc_snapshot_perflib_get(sigar, flags, snapshot);
+    }
+
+    return status;
+}
+
+static char systhread_state(SIGAR_SYSTEM_THREAD_INFORMATION *thread)
+{
+    if (thread->ThreadState != SIGAR_THREAD_STATE_WAITING) {
+        return SIGAR_PROC_STATE_RUN;
+    }
+    if (thread->WaitReason == SIGAR_THREAD_WAIT_SUSPENDED) {
+        return SIGAR_PROC_STATE_STOP;
+    }
+    return SIGAR_PROC_STATE_SLEEP;
+}
+
+/* the threads ride along in the shared SystemProcessInformation buffer */
+int sigar_os_proc_thread_list_get(sigar_t *sigar, sigar_pid_t pid,
+                                  sigar_proc_thread_list_t *threads)
+{
+    SIGAR_SYSTEM_PROCESS_INFORMATION *proc;
+    DWORD err;
+    ULONG i;
+
+    DLLMOD_INIT(ntdll, FALSE);
+
+    if (!sigar_NtQuerySystemInformation) {
+        return SIGAR_ENOTIMPL;
+    }
+
+    if (!(proc = get_sysproc_info(sigar, &err))) {
+        return err;
+    }
+
+    while ((sigar_pid_t)(ULONG_PTR)proc->UniqueProcessId != pid) {
+        if (proc->NextEntryOffset == 0) {
+            return ESRCH;
+        }
+        proc = (SIGAR_SYSTEM_PROCESS_INFORMATION *)
+            ((BYTE *)proc + proc->NextEntryOffset);
+    }
+
+    for (i=0; i<proc->NumberOfThreads; i++) {
+        SIGAR_SYSTEM_THREAD_INFORMATION *info = &proc->Threads[i];
+        sigar_proc_thread_t *thread;
+
+        SIGAR_PROC_THREAD_LIST_GROW(threads);
+        thread = &threads->data[threads->number++];
+
+        thread->tid = (sigar_pid_t)(ULONG_PTR)info->UniqueThread;
+        thread->state = systhread_state(info);
+        thread->processor = -1;
+        thread->cpu.user  = NS100_2MSEC(info->UserTime.QuadPart);
+        thread->cpu.sys   = NS100_2MSEC(info->KernelTime.QuadPart);
+        thread->cpu.total = thread->cpu.user + thread->cpu.sys;
+
+        if (info->CreateTime.QuadPart) {
+            FILETIME ft;
+            ft.dwHighDateTime = info->CreateTime.HighPart;
+            ft.dwLowDateTime  = info->CreateTime.LowPart;
+            thread->cpu.start_time = sigar_FileTimeToTime(&ft) / 1000;
+        }
+        else {
+            thread->cpu.start_time = 0;
+        }
+    }
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int) sigar_proc_wmi_async_set(sigar_t *sigar, int enable)
+{
+    sigar->wmi_async = enable;
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int) sigar_proc_etw_set(sigar_t *sigar, int enable)
+{
+    if (!enable) {
+        sigar_etw_stop(sigar, SIGAR_ETW_USER_API);
+        return SIGAR_OK;
+    }
+
+    return sigar_etw_start(sigar, SIGAR_ETW_USER_API);
+}
+
+SIGAR_DECLARE(int) sigar_proc_net_io_get(sigar_t *sigar, sigar_pid_t pid,
+                                         sigar_proc_net_io_t *procnetio)
+{
+    if (!sigar->etw) {
+        return SIGAR_ENOTIMPL;
+    }
+
+    return sigar_etw_proc_net_io_get(sigar, pid, procnetio);
+}
+
+static int sigar_remote_proc_args_get(sigar_t *sigar, sigar_pid_t pid,
+                                      sigar_proc_args_t *procargs)
+{
+    int status;
+    char cmdline[SIGAR_CMDLINE_MAX], *ptr = cmdline, *arg;
+    HANDLE proc = open_process(pid);
+
+    if (proc) {
+        status = sigar_proc_args_peb_get(sigar, proc, procargs);
+
+        CloseHandle(proc);
+
+        if (status == SIGAR_OK) {
+            return status;
+        }
+    }
+
+    /* likely we are 32-bit, pid process is 64-bit */
+#ifdef MSVC
+    status = sigar_proc_args_wmi_get(sigar, pid, procargs);
+#endif
+    if (status == ERROR_NOT_FOUND) {
+        status = SIGAR_NO_SUCH_PROCESS;
+    }
+    return status;
+}
+
+int sigar_os_proc_args_get(sigar_t *sigar, sigar_pid_t pid,
+                          sigar_proc_args_t *procargs)
+{
+    if (pid == sigar->pid) {
+        return sigar_parse_proc_args(sigar, NULL, procargs);
+    }
+    else {
+        return sigar_remote_proc_args_get(sigar, pid, procargs);
+    }
+}
+
+static int sigar_proc_env_parse(UCHAR *ptr, sigar_proc_env_t *procenv,
+                                int multi)
+{
+    while (*ptr) {
+        char *val;
+        int klen, vlen, status;
+        char key[128]; /* XXX is there a max key size? */
+
+        if (*ptr == '=') {
+            ptr += strlen(ptr)+1;
+            continue;
         }
 
         val = strchr(ptr, '=');
@@ -2014,72 +2733,287 @@ SIGAR_DECLARE(int) sigar_file_system_list_get(sigar_t *sigar,
     return SIGAR_OK;
 }
 
-static PERF_INSTANCE_DEFINITION *get_disk_instance(sigar_t *sigar,
-                                                   DWORD *perf_offsets,
-                                                   DWORD *num, DWORD *err)
+/* LogicalDisk and PhysicalDisk share their counter titles */
+static PERF_OBJECT_TYPE *get_disk_object(sigar_t *sigar, char *counter_key,
+                                         DWORD *perf_offsets, DWORD *err)
 {
     PERF_OBJECT_TYPE *object =
-        get_perf_object(sigar, PERF_TITLE_DISK_KEY, err);
-    PERF_INSTANCE_DEFINITION *inst;
+        get_perf_object(sigar, counter_key, err);
     PERF_COUNTER_DEFINITION *counter;
     DWORD i, found=0;
 
-    if (!object) {
+    if (!object) {
+        return NULL;
+    }
+
+    memset(perf_offsets, 0, sizeof(*perf_offsets) * PERF_IX_DISK_MAX);
+
+    for (i=0, counter = PdhFirstCounter(object);
+         i<object->NumCounters;
+         i++, counter = PdhNextCounter(counter))
+    {
+        DWORD offset = counter->CounterOffset;
+
+        switch (counter->CounterNameTitleIndex) {
+          case PERF_TITLE_DISK_TIME:
+            perf_offsets[PERF_IX_DISK_TIME] = offset;
+            found = 1;
+            break;
+          case PERF_TITLE_DISK_READ_TIME:
+            perf_offsets[PERF_IX_DISK_READ_TIME] = offset;
+            found = 1;
+            break;
+          case PERF_TITLE_DISK_WRITE_TIME:
+            perf_offsets[PERF_IX_DISK_WRITE_TIME] = offset;
+            found = 1;
+            break;
+          case PERF_TITLE_DISK_READ:
+            perf_offsets[PERF_IX_DISK_READ] = offset;
+            found = 1;
+            break;
+          case PERF_TITLE_DISK_WRITE:
+            perf_offsets[PERF_IX_DISK_WRITE] = offset;
+            found = 1;
+            break;
+          case PERF_TITLE_DISK_READ_BYTES:
+            perf_offsets[PERF_IX_DISK_READ_BYTES] = offset;
+            found = 1;
+            break;
+          case PERF_TITLE_DISK_WRITE_BYTES:
+            perf_offsets[PERF_IX_DISK_WRITE_BYTES] = offset;
+            found = 1;
+            break;
+          case PERF_TITLE_DISK_QUEUE:
+            perf_offsets[PERF_IX_DISK_QUEUE] = offset;
+            found = 1;
+            break;
+        }
+    }
+
+    if (!found) {
+        *err = ENOENT;
+        return NULL;
+    }
+
+    return object;
+}
+
+static void disk_perf_set(DWORD *perf_offsets, PERF_INSTANCE_DEFINITION *inst,
+                          sigar_disk_usage_t *disk)
+{
+    PERF_COUNTER_BLOCK *counter_block = PdhGetCounterBlock(inst);
+
+    disk->time   = PERF_VAL(PERF_IX_DISK_TIME);
+    disk->rtime  = PERF_VAL(PERF_IX_DISK_READ_TIME);
+    disk->wtime  = PERF_VAL(PERF_IX_DISK_WRITE_TIME);
+    disk->reads  = PERF_VAL(PERF_IX_DISK_READ);
+    disk->writes = PERF_VAL(PERF_IX_DISK_WRITE);
+    disk->read_bytes  = PERF_VAL(PERF_IX_DISK_READ_BYTES);
+    disk->write_bytes = PERF_VAL(PERF_IX_DISK_WRITE_BYTES);
+    disk->queue = PERF_VAL(PERF_IX_DISK_QUEUE);
+}
+
+/* a volume is rescanned at most this often, or when a lookup misses */
+#define VOLUME_INDEX_EXPIRE (60 * SIGAR_MSEC)
+
+/* the disk holding the first extent, a striped volume has more */
+static DWORD volume_disk_get(const char *guid)
+{
+    char device[MAX_PATH];
+    VOLUME_DISK_EXTENTS extents;
+    HANDLE handle;
+    DWORD bytes, disk = (DWORD)-1;
+    size_t len;
+
+    /* the volume itself is the GUID path without its trailing '\' */
+    SIGAR_SSTRCPY(device, guid);
+    len = strlen(device);
+    if (len && (device[len-1] == '\\')) {
+        device[len-1] = '\0';
+    }
+
+    handle = CreateFile(device, 0, FILE_SHARE_READ|FILE_SHARE_WRITE,
+                        NULL, OPEN_EXISTING, 0, NULL);
+    if (handle == INVALID_HANDLE_VALUE) {
+        return disk;
+    }
+
+    if ((DeviceIoControl(handle, IOCTL_VOLUME_GET_VOLUME_DISK_EXTENTS,
+                         NULL, 0, &extents, sizeof(extents),
+                         &bytes, NULL) ||
+         (GetLastError() == ERROR_MORE_DATA)) &&
+        extents.NumberOfDiskExtents)
+    {
+        disk = extents.Extents[0].DiskNumber;
+    }
+
+    CloseHandle(handle);
+
+    return disk;
+}
+
+static void volume_device_set(win32_volume_t *vol)
+{
+    char name[MAX_PATH], device[MAX_PATH], *ptr;
+    size_t len;
+
+    vol->number = (DWORD)-1;
+
+    /* "\\?\Volume{...}\" -> "Volume{...}" for QueryDosDevice */
+    if (!strnEQ(vol->guid, "\\\\?\\", 4)) {
+        return;
+    }
+    SIGAR_SSTRCPY(name, vol->guid + 4);
+    len = strlen(name);
+    if (len && (name[len-1] == '\\')) {
+        name[len-1] = '\0';
+    }
+
+    if (!QueryDosDevice(name, device, sizeof(device)) ||
+        !strnEQ(device, "\\Device\\", 8))
+    {
+        return;
+    }
+    ptr = device + 8;
+
+    /* the instance of a volume without a drive letter */
+    if (vol->instance[0] == '\0') {
+        SIGAR_SSTRCPY(vol->instance, ptr);
+    }
+
+    if (strnEQ(ptr, "HarddiskVolume", 14)) {
+        vol->number = strtoul(ptr + 14, NULL, 10);
+    }
+}
+
+/*
+ * volume GUID -> the LogicalDisk instance and mount path of every
+ * mounted volume.  FindFirstVolume and friends are slow enough on a
+ * host with many mount points to not want them on every poll.
+ */
+static int volume_index_get(sigar_t *sigar, int refresh)
+{
+    sigar_uint64_t timenow = sigar_time_now_millis();
+    sigar_uint64_t expire = refresh ? SIGAR_BUFFER_EXPIRE : VOLUME_INDEX_EXPIRE;
+    char guid[MAX_PATH], *names;
+    DWORD names_size = MAX_PATH * 4;
+    HANDLE find;
+
+    if (sigar->volumes_time && ((timenow - sigar->volumes_time) < expire)) {
+        return SIGAR_OK;
+    }
+
+    sigar->volumes_time = timenow;
+    sigar->volumes_number = 0;
+
+    if ((find = FindFirstVolume(guid, sizeof(guid))) == INVALID_HANDLE_VALUE) {
+        return GetLastError();
+    }
+
+    names = malloc(names_size);
+
+    do {
+        win32_volume_t *vol;
+        char *ptr;
+        DWORD len;
+
+        while (!GetVolumePathNamesForVolumeName(guid, names,
+                                                names_size, &len))
+        {
+            if ((GetLastError() != ERROR_MORE_DATA) || (len <= names_size)) {
+                names[0] = '\0';
+                break;
+            }
+            names_size = len;
+            names = realloc(names, names_size);
+        }
+
+        if (names[0] == '\0') {
+            continue; /* not mounted anywhere */
+        }
+
+        if (sigar->volumes_number >= sigar->volumes_size) {
+            sigar->volumes_size += SIGAR_FS_MAX;
+            sigar->volumes =
+                realloc(sigar->volumes,
+                        sizeof(*sigar->volumes) * sigar->volumes_size);
+        }
+
+        vol = &sigar->volumes[sigar->volumes_number++];
+        SIGAR_SSTRCPY(vol->guid, guid);
+        SIGAR_SSTRCPY(vol->path, names);
+        vol->instance[0] = '\0';
+
+        /* a drive letter is what LogicalDisk names the instance after */
+        for (ptr = names; *ptr; ptr += strlen(ptr)+1) {
+            if ((strlen(ptr) == 3) && (ptr[1] == ':')) {
+                SIGAR_SSTRCPY(vol->path, ptr);
+                vol->instance[0] = ptr[0];
+                vol->instance[1] = ':';
+                vol->instance[2] = '\0';
+                break;
+            }
+        }
+
+        volume_device_set(vol);
+        vol->disk = volume_disk_get(guid);
+    } while (FindNextVolume(find, guid, sizeof(guid)));
+
+    free(names);
+    FindVolumeClose(find);
+
+    return SIGAR_OK;
+}
+
+static win32_volume_t *volume_find_instance(sigar_t *sigar,
+                                            const char *instance)
+{
+    DWORD i;
+
+    for (i=0; i<sigar->volumes_number; i++) {
+        if (strcaseEQ(sigar->volumes[i].instance, instance)) {
+            return &sigar->volumes[i];
+        }
+    }
+
+    return NULL;
+}
+
+/* the mounted volume dirname is on, NULL for network drives */
+static win32_volume_t *volume_find_dir(sigar_t *sigar, const char *dirname)
+{
+    char root[MAX_PATH], guid[MAX_PATH];
+    int refresh;
+
+    if (!GetVolumePathName(dirname, root, sizeof(root)) ||
+        !GetVolumeNameForVolumeMountPoint(root, guid, sizeof(guid)))
+    {
         return NULL;
     }
 
-    for (i=0, counter = PdhFirstCounter(object);
-         i<object->NumCounters;
-         i++, counter = PdhNextCounter(counter))
-    {
-        DWORD offset = counter->CounterOffset;
+    for (refresh=0; refresh<2; refresh++) {
+        DWORD i;
 
-        switch (counter->CounterNameTitleIndex) {
-          case PERF_TITLE_DISK_TIME:
-            perf_offsets[PERF_IX_DISK_TIME] = offset;
-            found = 1;
-            break;
-          case PERF_TITLE_DISK_READ_TIME:
-            perf_offsets[PERF_IX_DISK_READ_TIME] = offset;
-            found = 1;
-            break;
-          case PERF_TITLE_DISK_WRITE_TIME:
-            perf_offsets[PERF_IX_DISK_WRITE_TIME] = offset;
-            found = 1;
-            break;
-          case PERF_TITLE_DISK_READ:
-            perf_offsets[PERF_IX_DISK_READ] = offset;
-            found = 1;
-            break;
-          case PERF_TITLE_DISK_WRITE:
-            perf_offsets[PERF_IX_DISK_WRITE] = offset;
-            found = 1;
-            break;
-          case PERF_TITLE_DISK_READ_BYTES:
-            perf_offsets[PERF_IX_DISK_READ_BYTES] = offset;
-            found = 1;
-            break;
-          case PERF_TITLE_DISK_WRITE_BYTES:
-            perf_offsets[PERF_IX_DISK_WRITE_BYTES] = offset;
-            found = 1;
-            break;
-          case PERF_TITLE_DISK_QUEUE:
-            perf_offsets[PERF_IX_DISK_QUEUE] = offset;
-            found = 1;
-            break;
+        if (volume_index_get(sigar, refresh) != SIGAR_OK) {
+            return NULL;
         }
-    }
 
-    if (!found) {
-        *err = ENOENT;
-        return NULL;
+        for (i=0; i<sigar->volumes_number; i++) {
+            if (strcaseEQ(sigar->volumes[i].guid, guid)) {
+                return &sigar->volumes[i];
+            }
+        }
     }
 
-    if (num) {
-        *num = object->NumInstances;
-    }
+    return NULL;
+}
 
-    return PdhFirstInstance(object);
+static void disk_instance_name(PERF_INSTANCE_DEFINITION *inst,
+                               char *name, int len)
+{
+    wchar_t *wname = (wchar_t *)((BYTE *)inst + inst->NameOffset);
+
+    SIGAR_W2A(wname, name, len);
 }
 
 SIGAR_DECLARE(int) sigar_disk_usage_get(sigar_t *sigar,
@@ -2087,11 +3021,11 @@ SIGAR_DECLARE(int) sigar_disk_usage_get(sigar_t *sigar,
                                         sigar_disk_usage_t *disk)
 {
     DWORD i, err;
+    DWORD perf_offsets[PERF_IX_DISK_MAX];
     PERF_OBJECT_TYPE *object =
-        get_perf_object(sigar, PERF_TITLE_DISK_KEY, &err);
+        get_disk_object(sigar, PERF_TITLE_DISK_KEY, perf_offsets, &err);
     PERF_INSTANCE_DEFINITION *inst;
-    PERF_COUNTER_DEFINITION *counter;
-    DWORD perf_offsets[PERF_IX_DISK_MAX];
+    win32_volume_t *vol;
 
     SIGAR_DISK_STATS_INIT(disk);
 
@@ -2099,24 +3033,23 @@ SIGAR_DECLARE(int) sigar_disk_usage_get(sigar_t *sigar,
         return err;
     }
 
-    memset(&perf_offsets, 0, sizeof(perf_offsets));
-    inst = get_disk_instance(sigar, (DWORD*)&perf_offsets, 0, &err);
-
-    if (!inst) {
-        return err;
-    }
+    /* a mount point is its own instance, not that of its drive */
+    vol = volume_find_dir(sigar, dirname);
 
     for (i=0, inst = PdhFirstInstance(object);
          i<object->NumInstances;
          i++, inst = PdhNextInstance(inst))
     {
         char drive[MAX_PATH];
-        PERF_COUNTER_BLOCK *counter_block = PdhGetCounterBlock(inst);
-        wchar_t *name = (wchar_t *)((BYTE *)inst + inst->NameOffset);
 
-        SIGAR_W2A(name, drive, sizeof(drive));
+        disk_instance_name(inst, drive, sizeof(drive));
 
-        if (sigar_isdigit(*name)) {
+        if (vol) {
+            if (!strcaseEQ(drive, vol->instance)) {
+                continue;
+            }
+        }
+        else if (sigar_isdigit(*drive)) {
             char *ptr = strchr(drive, ' '); /* 2000 Server "0 C:" */
 
             if (ptr) {
@@ -2128,15 +3061,8 @@ SIGAR_DECLARE(int) sigar_disk_usage_get(sigar_t *sigar,
             }
         }
 
-        if (strnEQ(drive, dirname, 2)) {
-            disk->time   = PERF_VAL(PERF_IX_DISK_TIME);
-            disk->rtime  = PERF_VAL(PERF_IX_DISK_READ_TIME);
-            disk->wtime  = PERF_VAL(PERF_IX_DISK_WRITE_TIME);
-            disk->reads  = PERF_VAL(PERF_IX_DISK_READ);
-            disk->writes = PERF_VAL(PERF_IX_DISK_WRITE);
-            disk->read_bytes  = PERF_VAL(PERF_IX_DISK_READ_BYTES);
-            disk->write_bytes = PERF_VAL(PERF_IX_DISK_WRITE_BYTES);
-            disk->queue = PERF_VAL(PERF_IX_DISK_QUEUE);
+        if (vol || strnEQ(drive, dirname, 2)) {
+            disk_perf_set(perf_offsets, inst, disk);
             return SIGAR_OK;
         }
     }
@@ -2144,23 +3070,150 @@ SIGAR_DECLARE(int) sigar_disk_usage_get(sigar_t *sigar,
     return ENXIO;
 }
 
+/*
+ * every PhysicalDisk and LogicalDisk instance, each object read once.
+ * physical disks are "PhysicalDriveN" with major N and minor 0,
+ * volumes are named by mount path with the disk of their first
+ * extent as major and N of HarddiskVolumeN as minor.
+ */
 SIGAR_DECLARE(int)
-sigar_file_system_usage_get(sigar_t *sigar,
-                            const char *dirname,
-                            sigar_file_system_usage_t *fsusage)
+sigar_disk_usage_list_get(sigar_t *sigar,
+                          sigar_disk_usage_list_t *disklist)
+{
+    DWORD i, err;
+    DWORD perf_offsets[PERF_IX_DISK_MAX];
+    PERF_OBJECT_TYPE *object;
+    PERF_INSTANCE_DEFINITION *inst;
+    int refreshed = 0;
+
+    if (sigar->replay) {
+        return sigar_replay_disk_usage_list_get(sigar, disklist);
+    }
+
+    object = get_disk_object(sigar, PERF_TITLE_PHYSICAL_DISK_KEY,
+                             perf_offsets, &err);
+    if (!object) {
+        return err;
+    }
+
+    sigar_disk_usage_list_create(disklist);
+
+    for (i=0, inst = PdhFirstInstance(object);
+         i<object->NumInstances;
+         i++, inst = PdhNextInstance(inst))
+    {
+        sigar_disk_usage_entry_t *entry;
+        char name[MAX_PATH];
+
+        disk_instance_name(inst, name, sizeof(name));
+
+        /* "0 C: D:", anything else is _Total */
+        if (!sigar_isdigit(*name)) {
+            continue;
+        }
+
+        SIGAR_DISK_USAGE_LIST_GROW(disklist);
+        entry = &disklist->data[disklist->number++];
+        entry->major = strtoul(name, NULL, 10);
+        entry->minor = 0;
+        snprintf(entry->name, sizeof(entry->name),
+                 "PhysicalDrive%lu", entry->major);
+        SIGAR_DISK_STATS_INIT(&entry->disk);
+        disk_perf_set(perf_offsets, inst, &entry->disk);
+    }
+
+    object = get_disk_object(sigar, PERF_TITLE_DISK_KEY,
+                             perf_offsets, &err);
+    if (!object) {
+        return SIGAR_OK; /* the physical disks are still worth having */
+    }
+
+    volume_index_get(sigar, 0);
+
+    for (i=0, inst = PdhFirstInstance(object);
+         i<object->NumInstances;
+         i++, inst = PdhNextInstance(inst))
+    {
+        sigar_disk_usage_entry_t *entry;
+        win32_volume_t *vol;
+        char name[MAX_PATH];
+
+        disk_instance_name(inst, name, sizeof(name));
+
+        if (strEQ(name, "_Total")) {
+            continue;
+        }
+
+        vol = volume_find_instance(sigar, name);
+        if (!vol && !refreshed) {
+            /* mounted since the index was built */
+            refreshed = 1;
+            volume_index_get(sigar, 1);
+            vol = volume_find_instance(sigar, name);
+        }
+
+        SIGAR_DISK_USAGE_LIST_GROW(disklist);
+        entry = &disklist->data[disklist->number++];
+
+        if (vol) {
+            SIGAR_SSTRCPY(entry->name, vol->path);
+            entry->major = vol->disk;
+            entry->minor = vol->number;
+        }
+        else {
+            SIGAR_SSTRCPY(entry->name, name);
+            entry->major = entry->minor = (unsigned long)-1;
+        }
+
+        SIGAR_DISK_STATS_INIT(&entry->disk);
+        disk_perf_set(perf_offsets, inst, &entry->disk);
+    }
+
+    return SIGAR_OK;
+}
+
+typedef BOOL (WINAPI *set_thread_error_mode_func_t)(DWORD, LPDWORD);
+
+/*
+ * no handle needed, sigar_file_system_usage_list_get runs it on its
+ * own threads with a deadline for volumes that do not answer.
+ */
+int sigar_statvfs(sigar_t *sigar,
+                  const char *dirname,
+                  sigar_file_system_usage_t *fsusage)
 {
+    static set_thread_error_mode_func_t set_thread_error_mode = NULL;
+    static int set_thread_error_mode_init = 0;
     BOOL retval;
     ULARGE_INTEGER avail, total, free;
-    int status;
+    DWORD errmode;
+
+    /* 7+, concurrent SetErrorMode calls could leave the mode changed */
+    if (!set_thread_error_mode_init) {
+        set_thread_error_mode = (set_thread_error_mode_func_t)
+            GetProcAddress(GetModuleHandle("kernel32.dll"),
+                           "SetThreadErrorMode");
+        set_thread_error_mode_init = 1;
+    }
 
     /* prevent dialog box if A:\ drive is empty */
-    UINT errmode = SetErrorMode(SEM_FAILCRITICALERRORS);
+    if (set_thread_error_mode) {
+        set_thread_error_mode(SEM_FAILCRITICALERRORS, &errmode);
+    }
+    else {
+        errmode = SetErrorMode(SEM_FAILCRITICALERRORS);
+    }
 
     retval = GetDiskFreeSpaceEx(dirname,
                                 &avail, &total, &free);
 
     /* restore previous error mode */
-    SetErrorMode(errmode);
+    if (set_thread_error_mode) {
+        set_thread_error_mode(errmode, NULL);
+    }
+    else {
+        SetErrorMode(errmode);
+    }
 
     if (!retval) {
         return GetLastError();
@@ -2170,13 +3223,28 @@ sigar_file_system_usage_get(sigar_t *sigar,
     fsusage->free  = free.QuadPart / 1024;
     fsusage->avail = avail.QuadPart / 1024;
     fsusage->used  = fsusage->total - fsusage->free;
-    fsusage->use_percent = sigar_file_system_usage_calc_used(sigar, fsusage);
 
     /* N/A */
     fsusage->files      = SIGAR_FIELD_NOTIMPL;
     fsusage->free_files = SIGAR_FIELD_NOTIMPL;
 
-    status = sigar_disk_usage_get(sigar, dirname, &fsusage->disk);
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int)
+sigar_file_system_usage_get(sigar_t *sigar,
+                            const char *dirname,
+                            sigar_file_system_usage_t *fsusage)
+{
+    int status = sigar_statvfs(sigar, dirname, fsusage);
+
+    if (status != SIGAR_OK) {
+        return status;
+    }
+
+    fsusage->use_percent = sigar_file_system_usage_calc_used(sigar, fsusage);
+
+    (void)sigar_disk_usage_get(sigar, dirname, &fsusage->disk);
 
     return SIGAR_OK;
 }
@@ -2545,8 +3613,8 @@ static int sigar_get_netif_ipaddr(sigar_t *sigar,
     }
 }
 
-SIGAR_DECLARE(int) sigar_net_info_get(sigar_t *sigar,
-                                      sigar_net_info_t *netinfo)
+int sigar_os_net_info_get(sigar_t *sigar,
+                          sigar_net_info_t *netinfo)
 {
     PIP_ADAPTER_INFO adapter;
     FIXED_INFO *info;
@@ -3073,6 +4141,176 @@ sigar_net_interface_stat_get(sigar_t *sigar, const char *name,
 #define sigar_GetTcpTable \
     sigar->iphlpapi.get_tcp_table.func
 
+#define sigar_GetExtendedTcpTable \
+    sigar->iphlpapi.get_ext_tcp_table.func
+
+#define sigar_GetExtendedUdpTable \
+    sigar->iphlpapi.get_ext_udp_table.func
+
+/* sigar->connBuffers */
+#define CONN_TABLE_TCP  0
+#define CONN_TABLE_TCP6 1
+#define CONN_TABLE_UDP  2
+#define CONN_TABLE_UDP6 3
+
+#define CONN_TABLE_IS_INET6(table) ((table) & 1)
+
+/*
+ * owner pid rows for one protocol and family, read into the buffer
+ * left from the previous call, so a steady state is a single query.
+ */
+static void *conn_table_get(sigar_t *sigar, int table, DWORD *err)
+{
+    buffer_t *buffer = sigar->connBuffers[table];
+    ULONG af = CONN_TABLE_IS_INET6(table) ? AF_INET6 : AF_INET;
+    DWORD size, rc;
+
+    if (!buffer) {
+        buffer = sigar->connBuffers[table] = malloc(sizeof(*buffer));
+        buffer->buffer = NULL;
+    }
+
+    buffer_init(buffer);
+
+    while (1) {
+        size = buffer->size;
+
+        if (table < CONN_TABLE_UDP) {
+            rc = sigar_GetExtendedTcpTable(buffer->buffer, &size, FALSE, af,
+                                           SIGAR_TCP_TABLE_OWNER_PID_ALL, 0);
+        }
+        else {
+            rc = sigar_GetExtendedUdpTable(buffer->buffer, &size, FALSE, af,
+                                           SIGAR_UDP_TABLE_OWNER_PID, 0);
+        }
+
+        if (rc != ERROR_INSUFFICIENT_BUFFER) {
+            break;
+        }
+
+        /* leave room for connections opened before the retry */
+        do {
+            buffer_grow(buffer);
+        } while (buffer->size < size + BUFFER_SIZE);
+    }
+
+    if (rc != NO_ERROR) {
+        *err = rc;
+        return NULL;
+    }
+
+    return buffer->buffer;
+}
+
+static int net_conn_tcp_state(DWORD state)
+{
+    switch (state) {
+      case MIB_TCP_STATE_CLOSED:
+        return SIGAR_TCP_CLOSE;
+      case MIB_TCP_STATE_LISTEN:
+        return SIGAR_TCP_LISTEN;
+      case MIB_TCP_STATE_SYN_SENT:
+        return SIGAR_TCP_SYN_SENT;
+      case MIB_TCP_STATE_SYN_RCVD:
+        return SIGAR_TCP_SYN_RECV;
+      case MIB_TCP_STATE_ESTAB:
+        return SIGAR_TCP_ESTABLISHED;
+      case MIB_TCP_STATE_FIN_WAIT1:
+        return SIGAR_TCP_FIN_WAIT1;
+      case MIB_TCP_STATE_FIN_WAIT2:
+        return SIGAR_TCP_FIN_WAIT2;
+      case MIB_TCP_STATE_CLOSE_WAIT:
+        return SIGAR_TCP_CLOSE_WAIT;
+      case MIB_TCP_STATE_CLOSING:
+        return SIGAR_TCP_CLOSING;
+      case MIB_TCP_STATE_LAST_ACK:
+        return SIGAR_TCP_LAST_ACK;
+      case MIB_TCP_STATE_TIME_WAIT:
+        return SIGAR_TCP_TIME_WAIT;
+      case MIB_TCP_STATE_DELETE_TCB:
+      default:
+        return SIGAR_TCP_UNKNOWN;
+    }
+}
+
+static int net_conn_get_tcp_owner(sigar_net_connection_walker_t *walker)
+{
+    sigar_t *sigar = walker->sigar;
+    int flags = walker->flags;
+    SIGAR_MIB_TCPTABLE_OWNER_PID *tcp;
+    SIGAR_MIB_TCP6TABLE_OWNER_PID *tcp6;
+    DWORD err;
+    long i;
+
+    if (!(tcp = conn_table_get(sigar, CONN_TABLE_TCP, &err))) {
+        return err;
+    }
+
+    /* go in reverse to get LISTEN states first */
+    for (i = (long)tcp->dwNumEntries-1; i >= 0; i--) {
+        SIGAR_MIB_TCPROW_OWNER_PID *row = &tcp->table[i];
+        sigar_net_connection_t conn;
+
+        if (!(IS_TCP_SERVER(row->dwState, flags) ||
+              IS_TCP_CLIENT(row->dwState, flags)))
+        {
+            continue;
+        }
+
+        SIGAR_ZERO(&conn);
+
+        conn.local_port  = htons((WORD)row->dwLocalPort);
+        conn.remote_port = htons((WORD)row->dwRemotePort);
+
+        conn.type = SIGAR_NETCONN_TCP;
+
+        sigar_net_address_set(conn.local_address, row->dwLocalAddr);
+        sigar_net_address_set(conn.remote_address, row->dwRemoteAddr);
+
+        conn.send_queue = conn.receive_queue = SIGAR_FIELD_NOTIMPL;
+        conn.state = net_conn_tcp_state(row->dwState);
+
+        if (walker->add_connection(walker, &conn) != SIGAR_OK) {
+            return SIGAR_OK;
+        }
+    }
+
+    /* no ipv6 stack, nothing more to report */
+    if (!(tcp6 = conn_table_get(sigar, CONN_TABLE_TCP6, &err))) {
+        return SIGAR_OK;
+    }
+
+    for (i = (long)tcp6->dwNumEntries-1; i >= 0; i--) {
+        SIGAR_MIB_TCP6ROW_OWNER_PID *row = &tcp6->table[i];
+        sigar_net_connection_t conn;
+
+        if (!(IS_TCP_SERVER(row->dwState, flags) ||
+              IS_TCP_CLIENT(row->dwState, flags)))
+        {
+            continue;
+        }
+
+        SIGAR_ZERO(&conn);
+
+        conn.local_port  = htons((WORD)row->dwLocalPort);
+        conn.remote_port = htons((WORD)row->dwRemotePort);
+
+        conn.type = SIGAR_NETCONN_TCP;
+
+        sigar_net_address6_set(conn.local_address, row->ucLocalAddr);
+        sigar_net_address6_set(conn.remote_address, row->ucRemoteAddr);
+
+        conn.send_queue = conn.receive_queue = SIGAR_FIELD_NOTIMPL;
+        conn.state = net_conn_tcp_state(row->dwState);
+
+        if (walker->add_connection(walker, &conn) != SIGAR_OK) {
+            break;
+        }
+    }
+
+    return SIGAR_OK;
+}
+
 static int net_conn_get_tcp(sigar_net_connection_walker_t *walker)
 {
     sigar_t *sigar = walker->sigar;
@@ -3081,12 +4319,6 @@ static int net_conn_get_tcp(sigar_net_connection_walker_t *walker)
     DWORD rc, size=0;
     PMIB_TCPTABLE tcp;
 
-    DLLMOD_INIT(iphlpapi, FALSE);
-
-    if (!sigar_GetTcpTable) {
-        return SIGAR_ENOTIMPL;
-    }
-
     rc = sigar_GetTcpTable(NULL, &size, FALSE);
     if (rc != ERROR_INSUFFICIENT_BUFFER) {
         return GetLastError();
@@ -3122,46 +4354,8 @@ static int net_conn_get_tcp(sigar_net_connection_walker_t *walker)
 
         conn.send_queue = conn.receive_queue = SIGAR_FIELD_NOTIMPL;
 
-        switch (state) {
-          case MIB_TCP_STATE_CLOSED:
-            conn.state = SIGAR_TCP_CLOSE;
-            break;
-          case MIB_TCP_STATE_LISTEN:
-            conn.state = SIGAR_TCP_LISTEN;
-            break;
-          case MIB_TCP_STATE_SYN_SENT:
-            conn.state = SIGAR_TCP_SYN_SENT;
-            break;
-          case MIB_TCP_STATE_SYN_RCVD:
-            conn.state = SIGAR_TCP_SYN_RECV;
-            break;
-          case MIB_TCP_STATE_ESTAB:
-            conn.state = SIGAR_TCP_ESTABLISHED;
-            break;
-          case MIB_TCP_STATE_FIN_WAIT1:
-            conn.state = SIGAR_TCP_FIN_WAIT1;
-            break;
-          case MIB_TCP_STATE_FIN_WAIT2:
-            conn.state = SIGAR_TCP_FIN_WAIT2;
-            break;
-          case MIB_TCP_STATE_CLOSE_WAIT:
-            conn.state = SIGAR_TCP_CLOSE_WAIT;
-            break;
-          case MIB_TCP_STATE_CLOSING:
-            conn.state = SIGAR_TCP_CLOSING;
-            break;
-          case MIB_TCP_STATE_LAST_ACK:
-            conn.state = SIGAR_TCP_LAST_ACK;
-            break;
-          case MIB_TCP_STATE_TIME_WAIT:
-            conn.state = SIGAR_TCP_TIME_WAIT;
-            break;
-          case MIB_TCP_STATE_DELETE_TCB:
-          default:
-            conn.state = SIGAR_TCP_UNKNOWN;
-            break;
-        }
-
+        conn.state = net_conn_tcp_state(state);
+
         if (walker->add_connection(walker, &conn) != SIGAR_OK) {
             break;
         }
@@ -3180,6 +4374,71 @@ static int net_conn_get_tcp(sigar_net_connection_walker_t *walker)
 #define sigar_GetUdpTable \
     sigar->iphlpapi.get_udp_table.func
 
+static int net_conn_get_udp_owner(sigar_net_connection_walker_t *walker)
+{
+    sigar_t *sigar = walker->sigar;
+    int flags = walker->flags;
+    SIGAR_MIB_UDPTABLE_OWNER_PID *udp;
+    SIGAR_MIB_UDP6TABLE_OWNER_PID *udp6;
+    DWORD err, i;
+    sigar_net_connection_t conn;
+
+    /* the table has no remote end, every row is a server */
+    if (!(flags & SIGAR_NETCONN_SERVER)) {
+        return SIGAR_OK;
+    }
+
+    if (!(udp = conn_table_get(sigar, CONN_TABLE_UDP, &err))) {
+        return err;
+    }
+
+    for (i = 0; i < udp->dwNumEntries; i++) {
+        SIGAR_ZERO(&conn);
+
+        conn.local_port  = htons((WORD)udp->table[i].dwLocalPort);
+        conn.remote_port = 0;
+
+        conn.type = SIGAR_NETCONN_UDP;
+
+        sigar_net_address_set(conn.local_address,
+                              udp->table[i].dwLocalAddr);
+
+        sigar_net_address_set(conn.remote_address, 0);
+
+        conn.send_queue = conn.receive_queue = SIGAR_FIELD_NOTIMPL;
+
+        if (walker->add_connection(walker, &conn) != SIGAR_OK) {
+            return SIGAR_OK;
+        }
+    }
+
+    if (!(udp6 = conn_table_get(sigar, CONN_TABLE_UDP6, &err))) {
+        return SIGAR_OK;
+    }
+
+    for (i = 0; i < udp6->dwNumEntries; i++) {
+        SIGAR_ZERO(&conn);
+
+        conn.local_port  = htons((WORD)udp6->table[i].dwLocalPort);
+        conn.remote_port = 0;
+
+        conn.type = SIGAR_NETCONN_UDP;
+
+        sigar_net_address6_set(conn.local_address,
+                               udp6->table[i].ucLocalAddr);
+
+        conn.remote_address.family = SIGAR_AF_INET6;
+
+        conn.send_queue = conn.receive_queue = SIGAR_FIELD_NOTIMPL;
+
+        if (walker->add_connection(walker, &conn) != SIGAR_OK) {
+            break;
+        }
+    }
+
+    return SIGAR_OK;
+}
+
 static int net_conn_get_udp(sigar_net_connection_walker_t *walker)
 {
     sigar_t *sigar = walker->sigar;
@@ -3188,12 +4447,6 @@ static int net_conn_get_udp(sigar_net_connection_walker_t *walker)
     DWORD rc, size=0, i;
     PMIB_UDPTABLE udp;
 
-    DLLMOD_INIT(iphlpapi, FALSE);
-
-    if (!sigar_GetUdpTable) {
-        return SIGAR_ENOTIMPL;
-    }
-
     rc = sigar_GetUdpTable(NULL, &size, FALSE);
     if (rc != ERROR_INSUFFICIENT_BUFFER) {
         return GetLastError();
@@ -3235,13 +4488,48 @@ static int net_conn_get_udp(sigar_net_connection_walker_t *walker)
     return SIGAR_OK;
 }
 
+static int net_conn_get_none(sigar_net_connection_walker_t *walker)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+static void net_conn_backend_init(sigar_t *sigar)
+{
+    DLLMOD_INIT(iphlpapi, FALSE);
+
+    if (sigar_GetExtendedTcpTable) {
+        sigar->backend.net_conn_tcp = net_conn_get_tcp_owner;
+    }
+    else if (sigar_GetTcpTable) {
+        sigar->backend.net_conn_tcp = net_conn_get_tcp;
+    }
+    else {
+        sigar->backend.net_conn_tcp = net_conn_get_none;
+    }
+
+    if (sigar_GetExtendedUdpTable) {
+        sigar->backend.net_conn_udp = net_conn_get_udp_owner;
+    }
+    else if (sigar_GetUdpTable) {
+        sigar->backend.net_conn_udp = net_conn_get_udp;
+    }
+    else {
+        sigar->backend.net_conn_udp = net_conn_get_none;
+    }
+}
+
 SIGAR_DECLARE(int)
 sigar_net_connection_walk(sigar_net_connection_walker_t *walker)
 {
+    sigar_t *sigar = walker->sigar;
     int status;
 
+    if (!sigar->backend.net_conn_tcp) {
+        net_conn_backend_init(sigar);
+    }
+
     if (walker->flags & SIGAR_NETCONN_TCP) {
-        status = net_conn_get_tcp(walker);
+        status = sigar->backend.net_conn_tcp(walker);
 
         if (status != SIGAR_OK) {
             return status;
@@ -3249,7 +4537,7 @@ sigar_net_connection_walk(sigar_net_connection_walker_t *walker)
     }
 
     if (walker->flags & SIGAR_NETCONN_UDP) {
-        status = net_conn_get_udp(walker);
+        status = sigar->backend.net_conn_udp(walker);
 
         if (status != SIGAR_OK) {
             return status;
@@ -3259,6 +4547,34 @@ sigar_net_connection_walk(sigar_net_connection_walker_t *walker)
     return SIGAR_OK;
 }
 
+int sigar_os_capabilities_get(sigar_t *sigar, sigar_capabilities_t *caps)
+{
+    if (!sigar->backend.proc_snapshot) {
+        proc_snapshot_backend_init(sigar);
+    }
+    if (!sigar->backend.net_conn_tcp) {
+        net_conn_backend_init(sigar);
+    }
+
+    caps->disk_io = "perflib";
+
+    caps->proc_list =
+        (sigar->backend.proc_snapshot == proc_snapshot_ntsys_get) ?
+        "ntquery" : "perflib";
+
+    if (sigar->backend.net_conn_tcp == net_conn_get_tcp_owner) {
+        caps->net_conn = "iphlpapi_owner";
+    }
+    else if (sigar->backend.net_conn_tcp == net_conn_get_tcp) {
+        caps->net_conn = "iphlpapi";
+    }
+    else {
+        caps->net_conn = "none";
+    }
+
+    return SIGAR_OK;
+}
+
 #define sigar_GetTcpStatistics \
     sigar->iphlpapi.get_tcp_stats.func
 
@@ -3329,6 +4645,86 @@ sigar_nfs_server_v3_get(sigar_t *sigar,
 #define sigar_GetUdpExTable \
     sigar->iphlpapi.get_udpx_table.func
 
+static int proc_port_owner_get(sigar_t *sigar,
+                               int protocol,
+                               unsigned long port,
+                               sigar_pid_t *pid)
+{
+    DWORD err, i;
+
+    if (protocol == SIGAR_NETCONN_TCP) {
+        SIGAR_MIB_TCPTABLE_OWNER_PID *tcp;
+        SIGAR_MIB_TCP6TABLE_OWNER_PID *tcp6;
+
+        if (!(tcp = conn_table_get(sigar, CONN_TABLE_TCP, &err))) {
+            return err;
+        }
+
+        for (i=0; i<tcp->dwNumEntries; i++) {
+            if ((tcp->table[i].dwState == MIB_TCP_STATE_LISTEN) &&
+                (htons((WORD)tcp->table[i].dwLocalPort) == port))
+            {
+                *pid = tcp->table[i].dwOwningPid;
+                return SIGAR_OK;
+            }
+        }
+
+        if (!(tcp6 = conn_table_get(sigar, CONN_TABLE_TCP6, &err))) {
+            return ENOENT;
+        }
+
+        for (i=0; i<tcp6->dwNumEntries; i++) {
+            if ((tcp6->table[i].dwState == MIB_TCP_STATE_LISTEN) &&
+                (htons((WORD)tcp6->table[i].dwLocalPort) == port))
+            {
+                *pid = tcp6->table[i].dwOwningPid;
+                return SIGAR_OK;
+            }
+        }
+    }
+    else {
+        SIGAR_MIB_UDPTABLE_OWNER_PID *udp;
+        SIGAR_MIB_UDP6TABLE_OWNER_PID *udp6;
+
+        if (!(udp = conn_table_get(sigar, CONN_TABLE_UDP, &err))) {
+            return err;
+        }
+
+        for (i=0; i<udp->dwNumEntries; i++) {
+            if (htons((WORD)udp->table[i].dwLocalPort) == port) {
+                *pid = udp->table[i].dwOwningPid;
+                return SIGAR_OK;
+            }
+        }
+
+        if (!(udp6 = conn_table_get(sigar, CONN_TABLE_UDP6, &err))) {
+            return ENOENT;
+        }
+
+        for (i=0; i<udp6->dwNumEntries; i++) {
+            if (htons((WORD)udp6->table[i].dwLocalPort) == port) {
+                *pid = udp6->table[i].dwOwningPid;
+                return SIGAR_OK;
+            }
+        }
+    }
+
+    return ENOENT;
+}
+
+/* the trace sees the pid of every send, receive, connect and accept */
+int sigar_os_net_connection_pid_refresh(sigar_t *sigar)
+{
+    return sigar->etw ? SIGAR_OK : SIGAR_ENOTIMPL;
+}
+
+int sigar_os_net_connection_pid_get(sigar_t *sigar,
+                                    sigar_net_connection_t *conn,
+                                    sigar_pid_t *pid)
+{
+    return sigar_etw_connection_pid_get(sigar, conn, pid);
+}
+
 SIGAR_DECLARE(int) sigar_proc_port_get(sigar_t *sigar,
                                        int protocol,
                                        unsigned long port,
@@ -3338,6 +4734,13 @@ SIGAR_DECLARE(int) sigar_proc_port_get(sigar_t *sigar,
 
     DLLMOD_INIT(iphlpapi, FALSE);
 
+    if ((protocol == SIGAR_NETCONN_TCP) && sigar_GetExtendedTcpTable) {
+        return proc_port_owner_get(sigar, protocol, port, pid);
+    }
+    else if ((protocol == SIGAR_NETCONN_UDP) && sigar_GetExtendedUdpTable) {
+        return proc_port_owner_get(sigar, protocol, port, pid);
+    }
+
     if (protocol == SIGAR_NETCONN_TCP) {
         PMIB_TCPEXTABLE tcp;
 
@@ -3580,6 +4983,8 @@ static int sigar_who_registry(sigar_t *sigar,
     HKEY users;
     DWORD index=0, status;
 
+    DLLMOD_INIT(advapi, FALSE);
+
     if (!sigar_ConvertStringSidToSid) {
         return ENOENT;
     }
@@ -3887,49 +5292,278 @@ int sigar_os_sys_info_get(sigar_t *sigar,
     return SIGAR_OK;
 }
 
-#define sigar_QueryServiceStatusEx \
-    sigar->advapi.query_service_status.func
+#define sigar_NotifyServiceStatusChange \
+    sigar->advapi.notify_service_status.func
 
-int sigar_service_pid_get(sigar_t *sigar, char *name, sigar_pid_t *pid)
+#ifdef SERVICE_NOTIFY_STATUS_CHANGE
+/* an APC, run by the SleepEx in sigar_services_cache_get */
+static VOID CALLBACK services_notify(PVOID param)
 {
-    DWORD rc = ERROR_SUCCESS, len;
-    SC_HANDLE mgr;
-    HANDLE svc;
-    SERVICE_STATUS_PROCESS status;
+    SERVICE_NOTIFY *notify = param;
+    sigar_t *sigar = notify->pContext;
 
-    if (!sigar_QueryServiceStatusEx) {
-        return SIGAR_ENOTIMPL;
+    /* fired once, registered again with the next enum */
+    sigar->services.time = 0;
+    notify->pContext = NULL;
+}
+#endif
+
+static void services_notify_register(sigar_t *sigar)
+{
+#ifdef SERVICE_NOTIFY_STATUS_CHANGE
+    SERVICE_NOTIFY *notify = sigar->services.notify;
+
+    if (!sigar_NotifyServiceStatusChange) {
+        return;
+    }
+    if (notify && notify->pContext) {
+        return; /* still registered */
+    }
+    if (!notify) {
+        notify = sigar->services.notify = calloc(1, sizeof(*notify));
     }
 
-    mgr = OpenSCManager(NULL,
-                        SERVICES_ACTIVE_DATABASE,
-                        SC_MANAGER_ALL_ACCESS);
+    notify->dwVersion = SERVICE_NOTIFY_STATUS_CHANGE;
+    notify->pfnNotifyCallback = services_notify;
+    notify->pContext = sigar;
 
-    if (!mgr) {
-        return GetLastError();
+    if (sigar_NotifyServiceStatusChange(sigar->services.handle,
+                                        SERVICE_NOTIFY_CREATED|
+                                        SERVICE_NOTIFY_DELETED,
+                                        notify) != ERROR_SUCCESS)
+    {
+        notify->pContext = NULL; /* the ttl alone then */
     }
+#endif
+}
 
-    if (!(svc = OpenService(mgr, name, SERVICE_ALL_ACCESS))) {
-        CloseServiceHandle(mgr);
-        return GetLastError();
+static int services_enum(sigar_t *sigar)
+{
+    sigar_services_cache_t *cache = &sigar->services;
+    DWORD bytes, resume;
+
+    while (1) {
+        resume = 0;
+        if (EnumServicesStatusEx(cache->handle, SC_ENUM_PROCESS_INFO,
+                                 SERVICE_WIN32, SERVICE_STATE_ALL,
+                                 (LPBYTE)cache->services, cache->size,
+                                 &bytes, &cache->count, &resume, NULL))
+        {
+            return SIGAR_OK;
+        }
+        if (GetLastError() != ERROR_MORE_DATA) {
+            cache->count = 0;
+            return GetLastError();
+        }
+        /* bytes is what is left, ask for room to spare */
+        cache->size += bytes + 4096;
+        cache->services = realloc(cache->services, cache->size);
+    }
+}
+
+int sigar_services_cache_get(sigar_t *sigar,
+                             ENUM_SERVICE_STATUS_PROCESS **services,
+                             DWORD *count)
+{
+    sigar_services_cache_t *cache = &sigar->services;
+    sigar_uint64_t timenow = sigar_time_now_millis();
+    int status;
+
+    DLLMOD_INIT(advapi, FALSE);
+
+    if (!cache->handle) {
+        cache->handle =
+            OpenSCManager(NULL, NULL, SC_MANAGER_ENUMERATE_SERVICE);
+        if (!cache->handle) {
+            return GetLastError();
+        }
     }
 
-    if (sigar_QueryServiceStatusEx(svc,
-                                   SC_STATUS_PROCESS_INFO,
-                                   (LPBYTE)&status,
-                                   sizeof(status), &len))
+    /* let a pending create or delete notification through */
+    if (cache->notify) {
+        SleepEx(0, TRUE);
+    }
+
+    if (!cache->walking &&
+        (!cache->time || ((timenow - cache->time) >= SIGAR_SERVICES_EXPIRE)))
     {
-        *pid = status.dwProcessId;
+        if ((status = services_enum(sigar)) != SIGAR_OK) {
+            cache->time = 0;
+            return status;
+        }
+        cache->time = timenow;
+        services_notify_register(sigar);
+    }
+
+    *services = cache->services;
+    *count = cache->count;
+
+    return SIGAR_OK;
+}
+
+static sigar_uint64_t service_name_hash(const char *name)
+{
+    sigar_uint64_t hash = 0;
+
+    /* the SCM does not care about case, neither do we */
+    while (*name) {
+        hash = 31*hash + tolower((unsigned char)*name++);
+    }
+
+    return hash;
+}
+
+typedef struct {
+    char *name;
+    char *path;
+    int status;
+    sigar_uint64_t time;
+} service_config_t;
+
+static void service_config_free(void *ptr)
+{
+    service_config_t *config = ptr;
+
+    if (config->name) {
+        free(config->name);
+    }
+    if (config->path) {
+        free(config->path);
+    }
+    free(config);
+}
+
+#define QUERY_SC_SIZE 8192
+
+static int service_config_query(sigar_t *sigar, char *name,
+                                service_config_t *config)
+{
+    char buffer[QUERY_SC_SIZE];
+    LPQUERY_SERVICE_CONFIG qsc = (LPQUERY_SERVICE_CONFIG)buffer;
+    DWORD bytes;
+    int status;
+    SC_HANDLE handle =
+        OpenService(sigar->services.handle, name, SERVICE_QUERY_CONFIG);
+
+    if (!handle) {
+        return GetLastError();
+    }
+
+    if (QueryServiceConfig(handle, qsc, sizeof(buffer), &bytes)) {
+        config->path = sigar_strdup(qsc->lpBinaryPathName ?
+                                    qsc->lpBinaryPathName : "");
+        status = SIGAR_OK;
     }
     else {
-        *pid = -1;
-        rc = GetLastError();
+        status = GetLastError();
+    }
+
+    CloseServiceHandle(handle);
+
+    return status;
+}
+
+int sigar_service_path_get(sigar_t *sigar, char *name, char **path)
+{
+    sigar_services_cache_t *cache = &sigar->services;
+    sigar_uint64_t timenow = sigar_time_now_millis();
+    sigar_cache_entry_t *entry;
+    service_config_t *config;
+
+    if (!cache->handle) {
+        return ERROR_INVALID_HANDLE; /* sigar_services_cache_get first */
+    }
+
+    if (!cache->configs) {
+        cache->configs = sigar_cache_new(128);
+        cache->configs->free_value = service_config_free;
+    }
+
+    entry = sigar_cache_get(cache->configs, service_name_hash(name));
+    config = entry->value;
+
+    if (config &&
+        (!strcaseEQ(config->name, name) ||
+         ((timenow - config->time) >= SIGAR_SERVICE_CONFIG_EXPIRE)))
+    {
+        /* another name with the same hash, or gone stale */
+        service_config_free(config);
+        config = entry->value = NULL;
+    }
+
+    if (!config) {
+        config = entry->value = calloc(1, sizeof(*config));
+        config->name = sigar_strdup(name);
+        config->status = service_config_query(sigar, name, config);
+        config->time = timenow;
+    }
+
+    if (config->status != SIGAR_OK) {
+        return config->status;
+    }
+
+    *path = config->path;
+
+    return SIGAR_OK;
+}
+
+void sigar_services_cache_close(sigar_t *sigar)
+{
+    sigar_services_cache_t *cache = &sigar->services;
+
+    if (cache->handle) {
+        /* cancels the notification, then run any already queued */
+        CloseServiceHandle(cache->handle);
+        if (cache->notify) {
+            SleepEx(0, TRUE);
+        }
+    }
+    if (cache->notify) {
+        free(cache->notify);
+    }
+    if (cache->services) {
+        free(cache->services);
+    }
+    if (cache->configs) {
+        sigar_cache_destroy(cache->configs);
+    }
+
+    SIGAR_ZERO(cache);
+}
+
+/* from the SCM table, enumerated again for a name it does not have */
+int sigar_service_pid_get(sigar_t *sigar, char *name, sigar_pid_t *pid)
+{
+    ENUM_SERVICE_STATUS_PROCESS *services;
+    DWORD i, count;
+    int status, tries;
+
+    for (tries=0; tries<2; tries++) {
+        status = sigar_services_cache_get(sigar, &services, &count);
+        if (status != SIGAR_OK) {
+            return status;
+        }
+
+        for (i=0; i<count; i++) {
+            if (strcaseEQ(services[i].lpServiceName, name)) {
+                *pid = services[i].ServiceStatusProcess.dwProcessId;
+                return SIGAR_OK;
+            }
+        }
+
+        /* created since, unless the table is brand new */
+        if (sigar->services.walking ||
+            ((sigar_time_now_millis() - sigar->services.time) <
+             SIGAR_BUFFER_EXPIRE))
+        {
+            break;
+        }
+        sigar->services.time = 0;
     }
 
-    CloseServiceHandle(svc);
-    CloseServiceHandle(mgr);
+    *pid = -1;
 
-    return rc;
+    return ERROR_SERVICE_DOES_NOT_EXIST;
 }
 
 int sigar_services_status_get(sigar_services_status_t *ss, DWORD state)
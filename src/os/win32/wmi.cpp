@@ -25,12 +25,196 @@
 #include <wbemidl.h>
 #include "sigar.h"
 
+extern "C" {
+#include "sigar_private.h"
+#include "sigar_util.h"
+#include "sigar_os.h"
+}
+
 #pragma comment(lib, "wbemuuid.lib")
 
 #ifndef SIGAR_CMDLINE_MAX
 #define SIGAR_CMDLINE_MAX 4096<<2
 #endif
 
+/* one query for every process instead of a GetObject round trip per pid */
+#define WMI_PROC_QUERY \
+    L"SELECT ProcessId,CommandLine,ExecutablePath FROM Win32_Process"
+
+#define WMI_PROC_BATCH 64
+
+/* one allocation, strings follow the struct, so the cache can free() it */
+typedef struct {
+    WCHAR *cmdline; /* NULL when WMI would not say */
+    WCHAR *exe;
+} wmi_proc_t;
+
+static void wmi_proc_add(sigar_cache_t *procs, IWbemClassObject *obj)
+{
+    VARIANT pid, cmdline, exe;
+    sigar_cache_entry_t *entry;
+    wmi_proc_t *proc;
+    size_t cmdlen = 0, exelen = 0;
+    WCHAR *ptr;
+
+    VariantInit(&pid);
+    VariantInit(&cmdline);
+    VariantInit(&exe);
+
+    if (FAILED(obj->Get(L"ProcessId", 0, &pid, 0, 0)) ||
+        (pid.vt != VT_I4))
+    {
+        VariantClear(&pid);
+        return;
+    }
+
+    obj->Get(L"CommandLine", 0, &cmdline, 0, 0);
+    obj->Get(L"ExecutablePath", 0, &exe, 0, 0);
+
+    if (cmdline.vt == VT_BSTR) {
+        cmdlen = wcslen(cmdline.bstrVal) + 1;
+    }
+    if (exe.vt == VT_BSTR) {
+        exelen = wcslen(exe.bstrVal) + 1;
+    }
+
+    proc = (wmi_proc_t *)malloc(sizeof(*proc) +
+                                (cmdlen + exelen) * sizeof(WCHAR));
+    ptr = (WCHAR *)(proc + 1);
+
+    proc->cmdline = proc->exe = NULL;
+    if (cmdlen) {
+        proc->cmdline = ptr;
+        memcpy(ptr, cmdline.bstrVal, cmdlen * sizeof(WCHAR));
+        ptr += cmdlen;
+    }
+    if (exelen) {
+        proc->exe = ptr;
+        memcpy(ptr, exe.bstrVal, exelen * sizeof(WCHAR));
+    }
+
+    entry = sigar_cache_get(procs, (DWORD)pid.lVal);
+    if (entry->value) {
+        free(entry->value);
+    }
+    entry->value = proc;
+
+    VariantClear(&pid);
+    VariantClear(&cmdline);
+    VariantClear(&exe);
+}
+
+/*
+ * receives an ExecQueryAsync result set on a WMI thread.  it owns
+ * the cache being filled and its own lock, so the WMI object can
+ * go away while a call is still in flight.
+ */
+class WMIProcSink : public IWbemObjectSink {
+
+  public:
+    WMIProcSink();
+    ~WMIProcSink();
+    ULONG STDMETHODCALLTYPE AddRef();
+    ULONG STDMETHODCALLTYPE Release();
+    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void **ppv);
+    HRESULT STDMETHODCALLTYPE Indicate(LONG count,
+                                       IWbemClassObject **objs);
+    HRESULT STDMETHODCALLTYPE SetStatus(LONG flags, HRESULT hr,
+                                        BSTR param,
+                                        IWbemClassObject *obj);
+    int Take(sigar_cache_t **procs, HRESULT *hr);
+
+  private:
+    LONG ref;
+    CRITICAL_SECTION lock;
+    sigar_cache_t *procs;
+    HRESULT status;
+    int done;
+};
+
+WMIProcSink::WMIProcSink()
+{
+    ref = 1;
+    InitializeCriticalSection(&lock);
+    procs = sigar_cache_new(128);
+    status = S_OK;
+    done = 0;
+}
+
+WMIProcSink::~WMIProcSink()
+{
+    if (procs) {
+        sigar_cache_destroy(procs);
+    }
+    DeleteCriticalSection(&lock);
+}
+
+ULONG WMIProcSink::AddRef()
+{
+    return InterlockedIncrement(&ref);
+}
+
+ULONG WMIProcSink::Release()
+{
+    LONG n = InterlockedDecrement(&ref);
+    if (n == 0) {
+        delete this;
+    }
+    return n;
+}
+
+HRESULT WMIProcSink::QueryInterface(REFIID riid, void **ppv)
+{
+    if ((riid == IID_IUnknown) || (riid == IID_IWbemObjectSink)) {
+        *ppv = (IWbemObjectSink *)this;
+        AddRef();
+        return WBEM_S_NO_ERROR;
+    }
+    *ppv = NULL;
+    return E_NOINTERFACE;
+}
+
+HRESULT WMIProcSink::Indicate(LONG count, IWbemClassObject **objs)
+{
+    LONG i;
+
+    EnterCriticalSection(&lock);
+    for (i=0; i<count; i++) {
+        wmi_proc_add(procs, objs[i]);
+    }
+    LeaveCriticalSection(&lock);
+
+    return WBEM_S_NO_ERROR;
+}
+
+HRESULT WMIProcSink::SetStatus(LONG flags, HRESULT hr,
+                               BSTR param, IWbemClassObject *obj)
+{
+    if (flags == WBEM_STATUS_COMPLETE) {
+        EnterCriticalSection(&lock);
+        status = hr;
+        done = 1;
+        LeaveCriticalSection(&lock);
+    }
+    return WBEM_S_NO_ERROR;
+}
+
+/* hands over the finished result set, 0 while the query still runs */
+int WMIProcSink::Take(sigar_cache_t **result, HRESULT *hr)
+{
+    int finished;
+
+    EnterCriticalSection(&lock);
+    if ((finished = done)) {
+        *result = procs;
+        *hr = status;
+        procs = NULL;
+    }
+    LeaveCriticalSection(&lock);
+
+    return finished;
+}
+
 class WMI {
 
   public:
@@ -39,20 +223,31 @@ class WMI {
     HRESULT Open(LPCTSTR machine=NULL, LPCTSTR user=NULL, LPCTSTR pass=NULL);
     void Close();
     HRESULT GetProcStringProperty(DWORD pid, TCHAR *name, TCHAR *value, DWORD len);
-    HRESULT GetProcExecutablePath(DWORD pid, TCHAR *value);
-    HRESULT GetProcCommandLine(DWORD pid, TCHAR *value);
+    HRESULT GetProcExecutablePath(sigar_t *sigar, DWORD pid, TCHAR *value);
+    HRESULT GetProcCommandLine(sigar_t *sigar, DWORD pid, TCHAR *value);
     int GetLastError();
 
   private:
     IWbemServices *wbem;
     HRESULT result;
+    sigar_cache_t *procs;     /* pid -> wmi_proc_t from the last bulk query */
+    sigar_uint64_t procs_time;
+    WMIProcSink *sink;        /* async bulk query in flight */
     BSTR GetProcQuery(DWORD pid);
+    HRESULT QueryProcs();
+    HRESULT QueryProcsAsync();
+    void QueryProcsCollect();
+    HRESULT GetProcCached(sigar_t *sigar, DWORD pid, int exe,
+                          TCHAR *value, DWORD len);
 };
 
 WMI::WMI()
 {
     wbem = NULL;
     result = S_OK;
+    procs = NULL;
+    procs_time = 0;
+    sink = NULL;
     CoInitializeEx(NULL, COINIT_MULTITHREADED);
 }
 
@@ -74,6 +269,8 @@ int WMI::GetLastError()
         return ERROR_ACCESS_DENIED;
       case WBEM_E_NOT_SUPPORTED:
         return SIGAR_ENOTIMPL;
+      case E_PENDING:
+        return ERROR_IO_PENDING;
       default:
         return ERROR_INVALID_FUNCTION;
     }
@@ -132,6 +329,17 @@ HRESULT WMI::Open(LPCTSTR machine, LPCTSTR user, LPCTSTR pass)
 
 void WMI::Close()
 {
+    if (sink) {
+        if (wbem) {
+            wbem->CancelAsyncCall(sink);
+        }
+        sink->Release();
+        sink = NULL;
+    }
+    if (procs) {
+        sigar_cache_destroy(procs);
+        procs = NULL;
+    }
     if (wbem) {
         wbem->Release();
         wbem = NULL;
@@ -174,14 +382,191 @@ HRESULT WMI::GetProcStringProperty(DWORD pid, TCHAR *name, TCHAR *value, DWORD l
     return result;
 }
 
-HRESULT WMI::GetProcExecutablePath(DWORD pid, TCHAR *value)
+HRESULT WMI::QueryProcs()
+{
+    IEnumWbemClassObject *procenum;
+    IWbemClassObject *objs[WMI_PROC_BATCH];
+    sigar_cache_t *table;
+    ULONG i, num;
+
+    result = wbem->ExecQuery(bstr_t(L"WQL"),
+                             bstr_t(WMI_PROC_QUERY),
+                             WBEM_FLAG_FORWARD_ONLY |
+                             WBEM_FLAG_RETURN_IMMEDIATELY,
+                             NULL,
+                             &procenum);
+
+    if (FAILED(result)) {
+        return result;
+    }
+
+    table = sigar_cache_new(128);
+
+    /* WBEM_S_FALSE with num < WMI_PROC_BATCH on the last batch */
+    while (SUCCEEDED(result = procenum->Next(WBEM_INFINITE, WMI_PROC_BATCH,
+                                             objs, &num)) && num)
+    {
+        for (i=0; i<num; i++) {
+            wmi_proc_add(table, objs[i]);
+            objs[i]->Release();
+        }
+    }
+
+    procenum->Release();
+
+    if (FAILED(result)) {
+        sigar_cache_destroy(table);
+        return result;
+    }
+
+    if (procs) {
+        sigar_cache_destroy(procs);
+    }
+    procs = table;
+    procs_time = sigar_time_now_millis();
+
+    return result = S_OK;
+}
+
+HRESULT WMI::QueryProcsAsync()
+{
+    if (sink) {
+        return result = S_OK; /* already running */
+    }
+
+    sink = new WMIProcSink();
+
+    result = wbem->ExecQueryAsync(bstr_t(L"WQL"),
+                                  bstr_t(WMI_PROC_QUERY),
+                                  WBEM_FLAG_BIDIRECTIONAL,
+                                  NULL,
+                                  sink);
+
+    if (FAILED(result)) {
+        sink->Release();
+        sink = NULL;
+    }
+
+    return result;
+}
+
+/* swap in the async result set once the sink has all of it */
+void WMI::QueryProcsCollect()
 {
-    return GetProcStringProperty(pid, L"ExecutablePath", value, MAX_PATH);
+    sigar_cache_t *table;
+    HRESULT hr;
+
+    if (!sink || !sink->Take(&table, &hr)) {
+        return;
+    }
+
+    sink->Release();
+    sink = NULL;
+
+    if (FAILED(hr)) {
+        sigar_cache_destroy(table);
+        return;
+    }
+
+    if (procs) {
+        sigar_cache_destroy(procs);
+    }
+    procs = table;
+    procs_time = sigar_time_now_millis();
 }
 
-HRESULT WMI::GetProcCommandLine(DWORD pid, TCHAR *value)
+/*
+ * answer from the last bulk query while it is younger than
+ * sigar->proc_cache_expire.  synchronous mode re-runs the bulk query
+ * when it is stale and asks for one pid started since then; async
+ * mode never waits on WMI, it keeps serving the previous result set
+ * while a new one is fetched and returns E_PENDING for pids not in it.
+ */
+HRESULT WMI::GetProcCached(sigar_t *sigar, DWORD pid, int exe,
+                           TCHAR *value, DWORD len)
 {
-    return GetProcStringProperty(pid, L"CommandLine", value, SIGAR_CMDLINE_MAX);
+    sigar_uint64_t timenow = sigar_time_now_millis();
+    sigar_cache_entry_t *entry;
+    WCHAR *str;
+    int stale;
+
+    QueryProcsCollect();
+
+    stale = !procs || ((timenow - procs_time) >= sigar->proc_cache_expire);
+
+    if (stale) {
+        if (sigar->wmi_async) {
+            QueryProcsAsync();
+        }
+        else if (FAILED(QueryProcs())) {
+            return result;
+        }
+    }
+
+    entry = procs ? sigar_cache_find(procs, pid) : NULL;
+
+    if (!entry) {
+        if (sigar->wmi_async) {
+            if (!stale) {
+                QueryProcsAsync(); /* started since the last result set */
+            }
+            return result = E_PENDING;
+        }
+        return GetProcStringProperty(pid,
+                                     exe ? L"ExecutablePath" : L"CommandLine",
+                                     value, len);
+    }
+
+    str = exe ?
+        ((wmi_proc_t *)entry->value)->exe :
+        ((wmi_proc_t *)entry->value)->cmdline;
+
+    if (!str) {
+        return result = E_INVALIDARG;
+    }
+
+    lstrcpyn(value, str, len);
+
+    return result = S_OK;
+}
+
+HRESULT WMI::GetProcExecutablePath(sigar_t *sigar, DWORD pid, TCHAR *value)
+{
+    return GetProcCached(sigar, pid, TRUE, value, MAX_PATH);
+}
+
+HRESULT WMI::GetProcCommandLine(sigar_t *sigar, DWORD pid, TCHAR *value)
+{
+    return GetProcCached(sigar, pid, FALSE, value, SIGAR_CMDLINE_MAX);
+}
+
+/* the connection lives as long as the sigar_t */
+static WMI *wmi_get(sigar_t *sigar)
+{
+    WMI *wmi = (WMI *)sigar->wmi;
+
+    if (!wmi) {
+        sigar->wmi = wmi = new WMI();
+    }
+
+    return wmi;
+}
+
+/* a dropped connection (wmi service restart) gets one reconnect */
+static int wmi_retry(HRESULT hr)
+{
+    return (hr == RPC_E_DISCONNECTED) ||
+        (hr == WBEM_E_TRANSPORT_FAILURE) ||
+        (hr == HRESULT_FROM_WIN32(RPC_S_SERVER_UNAVAILABLE)) ||
+        (hr == HRESULT_FROM_WIN32(RPC_S_CALL_FAILED));
+}
+
+extern "C" void sigar_wmi_close(sigar_t *sigar)
+{
+    if (sigar->wmi) {
+        delete (WMI *)sigar->wmi;
+        sigar->wmi = NULL;
+    }
 }
 
 /* in peb.c */
@@ -193,22 +578,29 @@ extern "C" int sigar_proc_args_wmi_get(sigar_t *sigar, sigar_pid_t pid,
 {
     int status;
     TCHAR buf[SIGAR_CMDLINE_MAX];
-    WMI *wmi = new WMI();
+    WMI *wmi = wmi_get(sigar);
+    HRESULT hr;
 
     if (FAILED(wmi->Open())) {
         return wmi->GetLastError();
     }
 
-    if (FAILED(wmi->GetProcCommandLine(pid, buf))) {
+    if (FAILED(hr = wmi->GetProcCommandLine(sigar, pid, buf)) &&
+        wmi_retry(hr))
+    {
+        wmi->Close();
+        if (SUCCEEDED(wmi->Open())) {
+            hr = wmi->GetProcCommandLine(sigar, pid, buf);
+        }
+    }
+
+    if (FAILED(hr)) {
         status = wmi->GetLastError();
     }
     else {
         status = sigar_parse_proc_args(sigar, buf, procargs);
     }
 
-    wmi->Close();
-    delete wmi;
-
     return status;
 }
 
@@ -217,7 +609,8 @@ extern "C" int sigar_proc_exe_wmi_get(sigar_t *sigar, sigar_pid_t pid,
 {
     int status;
     TCHAR buf[MAX_PATH+1];
-    WMI *wmi = new WMI();
+    WMI *wmi = wmi_get(sigar);
+    HRESULT hr;
 
     if (FAILED(wmi->Open())) {
         return wmi->GetLastError();
@@ -225,7 +618,16 @@ extern "C" int sigar_proc_exe_wmi_get(sigar_t *sigar, sigar_pid_t pid,
 
     procexe->name[0] = '\0';
 
-    if (FAILED(wmi->GetProcExecutablePath(pid, buf))) {
+    if (FAILED(hr = wmi->GetProcExecutablePath(sigar, pid, buf)) &&
+        wmi_retry(hr))
+    {
+        wmi->Close();
+        if (SUCCEEDED(wmi->Open())) {
+            hr = wmi->GetProcExecutablePath(sigar, pid, buf);
+        }
+    }
+
+    if (FAILED(hr)) {
         status = wmi->GetLastError();
     }
     else {
@@ -236,8 +638,5 @@ extern "C" int sigar_proc_exe_wmi_get(sigar_t *sigar, sigar_pid_t pid,
                             NULL, NULL);
     }
 
-    wmi->Close();
-    delete wmi;
-
     return status;
 }
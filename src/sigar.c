@@ -22,6 +22,7 @@
 #ifndef WIN32
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <sys/time.h>
 #endif
 #if defined(__OpenBSD__) || defined(__FreeBSD__)
@@ -32,6 +33,9 @@
 #endif
 #if defined(HAVE_UTMPX_H)
 # include <utmpx.h>
+# ifdef __linux__
+#  include <paths.h> /* UTMPX_FILE is _GNU_SOURCE only */
+# endif
 #elif defined(HAVE_UTMP_H)
 # include <utmp.h>
 #endif
@@ -41,6 +45,7 @@
 #include "sigar_util.h"
 #include "sigar_os.h"
 #include "sigar_format.h"
+#include "sigar_fileinfo.h"
 
 SIGAR_DECLARE(int) sigar_open(sigar_t **sigar)
 {
@@ -57,24 +62,85 @@ SIGAR_DECLARE(int) sigar_open(sigar_t **sigar)
         (*sigar)->log_data = NULL;
         (*sigar)->ptql_re_impl = NULL;
         (*sigar)->ptql_re_data = NULL;
+        (*sigar)->ptql_cache = 0;
+        (*sigar)->proc_stat_census = 0;
+        (*sigar)->net_stat_walk = 0;
         (*sigar)->self_path = NULL;
+        (*sigar)->procfs_buf = NULL;
+        (*sigar)->procfs_len = 0;
         (*sigar)->fsdev = NULL;
         (*sigar)->pids = NULL;
         (*sigar)->proc_cpu = NULL;
         (*sigar)->net_listen = NULL;
-        (*sigar)->net_services_tcp = NULL;
-        (*sigar)->net_services_udp = NULL;
 	(*sigar)->proc_io = NULL;
+        (*sigar)->proc_cpu_pool = NULL;
+        (*sigar)->proc_io_pool = NULL;
+        (*sigar)->proc_cache_expire = SIGAR_PROC_CACHE_EXPIRE;
+        (*sigar)->net_ifstat_expire = SIGAR_NET_IFSTAT_EXPIRE;
+        (*sigar)->net_listen_time = 0;
+        (*sigar)->net_listen_expire = SIGAR_NET_LISTEN_EXPIRE;
+        (*sigar)->proc_scan_threads = 0;
+        (*sigar)->proc_scan_pool = NULL;
+        (*sigar)->fs_usage_hung = NULL;
+        (*sigar)->dir_usage = NULL;
+        (*sigar)->proc_top = NULL;
+        (*sigar)->user_names = NULL;
+        (*sigar)->group_names = NULL;
+        (*sigar)->cred_name_expire = SIGAR_CRED_NAME_EXPIRE;
+        (*sigar)->proc_events = NULL;
+        (*sigar)->instrument = NULL;
+        (*sigar)->replay = NULL;
+        (*sigar)->net_info_expire = SIGAR_NET_INFO_EXPIRE;
+        (*sigar)->resolver = NULL;
+        (*sigar)->who_cache = NULL;
+        (*sigar)->ptql_names = NULL;
+        (*sigar)->list_preset = NULL;
     }
 
     return status;
 }
 
+SIGAR_DECLARE(int) sigar_open_ex(sigar_t **sigar, int flags)
+{
+    int status = sigar_open(sigar);
+
+    if (status != SIGAR_OK) {
+        return status;
+    }
+
+#ifdef SIGAR_HAS_OS_OPEN_PROBE
+    if (flags && ((status = sigar_os_open_probe(*sigar, flags)) != SIGAR_OK)) {
+        sigar_close(*sigar);
+        *sigar = NULL;
+    }
+#endif
+
+    return status;
+}
+
+SIGAR_DECLARE(int) sigar_capabilities_get(sigar_t *sigar,
+                                          sigar_capabilities_t *caps)
+{
+    SIGAR_ZERO(caps);
+
+#ifdef SIGAR_HAS_OS_OPEN_PROBE
+    return sigar_os_capabilities_get(sigar, caps);
+#else
+    return SIGAR_OK;
+#endif
+}
+
 SIGAR_DECLARE(int) sigar_close(sigar_t *sigar)
 {
+    if (sigar->proc_events) {
+        sigar_proc_events_destroy(sigar->proc_events);
+    }
     if (sigar->ifconf_buf) {
         free(sigar->ifconf_buf);
     }
+    if (sigar->procfs_buf) {
+        free(sigar->procfs_buf);
+    }
     if (sigar->self_path) {
         free(sigar->self_path);
     }
@@ -91,17 +157,38 @@ SIGAR_DECLARE(int) sigar_close(sigar_t *sigar)
     if (sigar->net_listen) {
         sigar_cache_destroy(sigar->net_listen);
     }
-    if (sigar->net_services_tcp) {
-        sigar_cache_destroy(sigar->net_services_tcp);
-    }
-    if (sigar->net_services_udp) {
-        sigar_cache_destroy(sigar->net_services_udp);
-    }
     if (sigar->proc_io) {
         sigar_cache_destroy(sigar->proc_io);
     }
-
-
+    if (sigar->dir_usage) {
+        sigar_cache_destroy(sigar->dir_usage);
+    }
+    if (sigar->proc_top) {
+        free(sigar->proc_top->data);
+        free(sigar->proc_top);
+    }
+    if (sigar->user_names) {
+        sigar_cache_destroy(sigar->user_names);
+    }
+    if (sigar->group_names) {
+        sigar_cache_destroy(sigar->group_names);
+    }
+    /* after the caches, which hand their values back on destroy */
+    if (sigar->proc_cpu_pool) {
+        sigar_pool_destroy(sigar->proc_cpu_pool);
+    }
+    if (sigar->proc_io_pool) {
+        sigar_pool_destroy(sigar->proc_io_pool);
+    }
+    if (sigar->proc_scan_pool) {
+        sigar_handle_pool_destroy(sigar->proc_scan_pool);
+    }
+    sigar_fs_usage_hung_free(sigar);
+    sigar_instrument_free(sigar);
+    sigar_replay_free(sigar);
+    sigar_resolver_free(sigar);
+    sigar_who_cache_free(sigar);
+    sigar_ptql_names_free(sigar);
 
     return sigar_os_close(sigar);
 }
@@ -117,6 +204,104 @@ SIGAR_DECLARE(sigar_pid_t) sigar_pid_get(sigar_t *sigar)
 }
 #endif
 
+static sigar_cache_t *sigar_pid_cache_new(sigar_pool_t **pool,
+                                          size_t value_size)
+{
+    sigar_cache_t *cache =
+        sigar_cache_create(128, PID_CACHE_FLAGS,
+                           PID_CACHE_CLEANUP_PERIOD,
+                           PID_CACHE_ENTRY_EXPIRE_PERIOD);
+
+    if (!*pool) {
+        *pool = sigar_pool_new(value_size, PID_CACHE_POOL_SLAB);
+    }
+    cache->value_pool = *pool;
+
+    return cache;
+}
+
+#if !defined(__linux__) && !defined(SOLARIS) /* /proc fds kept open */
+SIGAR_DECLARE(int) sigar_proc_pin(sigar_t *sigar, sigar_pid_t pid)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+SIGAR_DECLARE(int) sigar_proc_unpin(sigar_t *sigar, sigar_pid_t pid)
+{
+    return SIGAR_ENOTIMPL;
+}
+#endif
+
+#if !defined(__linux__) && !defined(DARWIN) && !defined(WIN32)
+SIGAR_DECLARE(int) sigar_proc_handle_open(sigar_t *sigar, sigar_pid_t pid,
+                                          sigar_proc_handle_t **handle)
+{
+    *handle = NULL;
+    return SIGAR_ENOTIMPL;
+}
+
+SIGAR_DECLARE(int) sigar_proc_handle_close(sigar_t *sigar,
+                                           sigar_proc_handle_t *handle)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+SIGAR_DECLARE(sigar_pid_t)
+sigar_proc_handle_pid_get(sigar_proc_handle_t *handle)
+{
+    return -1;
+}
+
+SIGAR_DECLARE(sigar_proc_waitable_t)
+sigar_proc_handle_waitable_get(sigar_proc_handle_t *handle)
+{
+    return -1;
+}
+
+SIGAR_DECLARE(int) sigar_proc_handle_wait(sigar_proc_handle_t *handle,
+                                          int timeout)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+SIGAR_DECLARE(int) sigar_proc_handle_kill(sigar_proc_handle_t *handle,
+                                          int signum)
+{
+    return SIGAR_ENOTIMPL;
+}
+#endif
+
+#ifndef WIN32 /* WMI is the only backend with a slow args source */
+SIGAR_DECLARE(int) sigar_proc_wmi_async_set(sigar_t *sigar, int enable)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+SIGAR_DECLARE(int) sigar_proc_etw_set(sigar_t *sigar, int enable)
+{
+    return SIGAR_ENOTIMPL;
+}
+#endif
+
+#ifndef __linux__ /* linux resolves them all from one fd scan */
+SIGAR_DECLARE(int) sigar_proc_port_list_get(sigar_t *sigar,
+                                            int protocol,
+                                            unsigned long *ports, int num,
+                                            sigar_pid_t *pids)
+{
+    int i, status;
+
+    for (i=0; i<num; i++) {
+        status = sigar_proc_port_get(sigar, protocol, ports[i], &pids[i]);
+        if (status != SIGAR_OK) {
+            return status;
+        }
+    }
+
+    return SIGAR_OK;
+}
+#endif
+
 /* XXX: add clear() function */
 /* XXX: check for stale-ness using start_time */
 SIGAR_DECLARE(int) sigar_proc_cpu_get(sigar_t *sigar, sigar_pid_t pid,
@@ -129,7 +314,9 @@ SIGAR_DECLARE(int) sigar_proc_cpu_get(sigar_t *sigar, sigar_pid_t pid,
     int status;
 
     if (!sigar->proc_cpu) {
-        sigar->proc_cpu = sigar_expired_cache_new(128, PID_CACHE_CLEANUP_PERIOD, PID_CACHE_ENTRY_EXPIRE_PERIOD);
+        sigar->proc_cpu =
+            sigar_pid_cache_new(&sigar->proc_cpu_pool,
+                                sizeof(sigar_proc_cpu_t));
     }
 
     entry = sigar_cache_get(sigar->proc_cpu, pid);
@@ -137,8 +324,8 @@ SIGAR_DECLARE(int) sigar_proc_cpu_get(sigar_t *sigar, sigar_pid_t pid,
         prev = (sigar_proc_cpu_t *)entry->value;
     }
     else {
-        prev = entry->value = malloc(sizeof(*prev));
-        SIGAR_ZERO(prev);
+        prev = entry->value =
+            sigar_cache_value_new(sigar->proc_cpu, sizeof(*prev));
     }
 
     time_diff = time_now - prev->last_time;
@@ -178,539 +365,2281 @@ SIGAR_DECLARE(int) sigar_proc_cpu_get(sigar_t *sigar, sigar_pid_t pid,
 
     return SIGAR_OK;
 }
-void copy_cached_disk_io_into_disk_io( sigar_cached_proc_disk_io_t *cached,  sigar_proc_disk_io_t *proc_disk_io) {
-   proc_disk_io->bytes_read = cached->bytes_read_diff;
-   proc_disk_io->bytes_written = cached->bytes_written_diff;
-   proc_disk_io->bytes_total = cached->bytes_total_diff;
+int sigar_proc_snapshot_create(sigar_proc_snapshot_t *snapshot)
+{
+    snapshot->number = 0;
+    snapshot->size = SIGAR_PROC_SNAPSHOT_MAX;
+    snapshot->data = malloc(sizeof(*(snapshot->data)) *
+                            snapshot->size);
+    return SIGAR_OK;
 }
 
-sigar_uint64_t get_io_diff(sigar_uint64_t current_value, sigar_uint64_t prev_value,  sigar_uint64_t time_diff) {
-   double io_diff;
-   sigar_uint64_t int_io_diff;
-   if ( current_value == SIGAR_FIELD_NOTIMPL ) {
-      return SIGAR_FIELD_NOTIMPL;
-   }
-   io_diff = (( current_value - prev_value)/(double)time_diff)*SIGAR_MSEC;
-   int_io_diff = (sigar_uint64_t)io_diff;
-   if (int_io_diff >=0) {
-      return int_io_diff;
-   }
-   return 0;
+int sigar_proc_snapshot_grow(sigar_proc_snapshot_t *snapshot)
+{
+    snapshot->data = realloc(snapshot->data,
+                             sizeof(*(snapshot->data)) *
+                             (snapshot->size + SIGAR_PROC_SNAPSHOT_MAX));
+    snapshot->size += SIGAR_PROC_SNAPSHOT_MAX;
+
+    return SIGAR_OK;
 }
 
-void calculate_io_diff(sigar_proc_cumulative_disk_io_t * proc_disk_io, sigar_cached_proc_disk_io_t *cached,  sigar_uint64_t time_diff, int is_first_time) {
-   /*calculate avg diff /read/write/total per second*/
-   if (!is_first_time) {
-       cached->bytes_written_diff = get_io_diff(proc_disk_io->bytes_written, cached->bytes_written, time_diff);
-       cached->bytes_read_diff = get_io_diff(proc_disk_io->bytes_read, cached->bytes_read, time_diff);
-       cached->bytes_total_diff = get_io_diff(proc_disk_io->bytes_total, cached->bytes_total, time_diff);
-   }
-   else {
-       cached->bytes_total_diff =  cached->bytes_read_diff =  cached->bytes_written_diff = 0.0;
-   }
-   // now put in cache the current cumulative values
-   cached->bytes_written = proc_disk_io->bytes_written;
-   cached->bytes_read = proc_disk_io->bytes_read;
-   cached->bytes_total = proc_disk_io->bytes_total;
+SIGAR_DECLARE(int) sigar_proc_snapshot_destroy(sigar_t *sigar,
+                                               sigar_proc_snapshot_t *snapshot)
+{
+    if (snapshot->size) {
+        free(snapshot->data);
+        snapshot->number = snapshot->size = 0;
+    }
+
+    return SIGAR_OK;
 }
 
-SIGAR_DECLARE(int) sigar_proc_disk_io_get(sigar_t *sigar, sigar_pid_t pid,
-                                          sigar_proc_disk_io_t *proc_disk_io)
+/* per-pid getters, for backends without a bulk source */
+static void proc_snapshot_generic_entry_get(sigar_t *sigar, int flags,
+                                            sigar_proc_snapshot_entry_t *entry)
 {
-    sigar_cache_entry_t *entry;
-    sigar_cached_proc_disk_io_t *prev;
-    sigar_proc_cumulative_disk_io_t  cumulative_proc_disk_io;
-    sigar_uint64_t time_now = sigar_time_now_millis();
-    sigar_uint64_t time_diff;
-    int status, is_first_time;
+    entry->flags = 0;
 
-    if (!sigar->proc_io) {
-        sigar->proc_io =  sigar_expired_cache_new(128, PID_CACHE_CLEANUP_PERIOD, PID_CACHE_ENTRY_EXPIRE_PERIOD);
+    if ((flags & SIGAR_PROC_SNAPSHOT_STATE) &&
+        (sigar_proc_state_get_ex(sigar, entry->pid,
+                                 SIGAR_PROC_SNAPSHOT_STATE_FIELDS_OF(flags),
+                                 &entry->state) == SIGAR_OK))
+    {
+        entry->flags |= SIGAR_PROC_SNAPSHOT_STATE;
     }
 
-    entry = sigar_cache_get(sigar->proc_io, pid);
-    if (entry->value) {
-        prev = (sigar_cached_proc_disk_io_t *)entry->value;
+    if ((flags & SIGAR_PROC_SNAPSHOT_MEM) &&
+        (sigar_proc_mem_get_ex(sigar, entry->pid,
+                               SIGAR_PROC_SNAPSHOT_MEM_FIELDS_OF(flags),
+                               &entry->mem) == SIGAR_OK))
+    {
+        entry->flags |= SIGAR_PROC_SNAPSHOT_MEM;
     }
-    else {
-        prev = entry->value = malloc(sizeof(*prev));
-        SIGAR_ZERO(prev);
+
+    if ((flags & SIGAR_PROC_SNAPSHOT_TIME) &&
+        (sigar_proc_time_get(sigar, entry->pid,
+                             (sigar_proc_time_t *)&entry->cpu) == SIGAR_OK))
+    {
+        entry->flags |= SIGAR_PROC_SNAPSHOT_TIME;
     }
-    is_first_time = (prev->last_time == 0);
-    time_diff = time_now - prev->last_time;
 
-    if (time_diff < 1000) {
-        /* we were just called within < 1 second ago. */
-        copy_cached_disk_io_into_disk_io(prev, proc_disk_io);
-	if (time_diff < 0) {
-	   // something is wrong at least from now on the time will be ok
- 	   prev->last_time = time_now;
+    if (flags & SIGAR_PROC_SNAPSHOT_CGROUP) {
+        sigar_proc_cgroup_t cgroup;
+
+        if (sigar_proc_cgroup_get(sigar, entry->pid, &cgroup) == SIGAR_OK) {
+            entry->cgroup = cgroup.id;
+            entry->flags |= SIGAR_PROC_SNAPSHOT_CGROUP;
         }
-        return SIGAR_OK;
     }
-    prev->last_time = time_now;
 
+    if ((flags & SIGAR_PROC_SNAPSHOT_MEM_EXT) &&
+        (sigar_proc_mem_ext_get(sigar, entry->pid,
+                                &entry->mem_ext) == SIGAR_OK))
+    {
+        entry->flags |= SIGAR_PROC_SNAPSHOT_MEM_EXT;
+    }
 
-    status =
-        sigar_proc_cumulative_disk_io_get(sigar, pid,
-                            &cumulative_proc_disk_io);
-
-    if (status != SIGAR_OK) {
-        return status;
+    if ((flags & SIGAR_PROC_SNAPSHOT_NET_IO) &&
+        (sigar_proc_net_io_get(sigar, entry->pid,
+                               &entry->net_io) == SIGAR_OK))
+    {
+        entry->flags |= SIGAR_PROC_SNAPSHOT_NET_IO;
     }
-    calculate_io_diff(&cumulative_proc_disk_io, prev, time_diff,  is_first_time);
-    copy_cached_disk_io_into_disk_io(prev, proc_disk_io);
-    return SIGAR_OK;
-}
 
-void get_cache_info(sigar_cache_t * cache, char * name){
-   if (cache == NULL) {
-      return;
-   }
+    if ((flags & SIGAR_PROC_SNAPSHOT_DISK_IO) &&
+        (sigar_proc_cumulative_disk_io_get(sigar, entry->pid,
+                                           &entry->disk_io) == SIGAR_OK))
+    {
+        entry->flags |= SIGAR_PROC_SNAPSHOT_DISK_IO;
+    }
 
-   printf("******** %s *********\n", name);
-   sigar_cache_dump(cache);
+    if ((flags & SIGAR_PROC_SNAPSHOT_SCHED) &&
+        (sigar_proc_sched_get(sigar, entry->pid,
+                              &entry->sched) == SIGAR_OK))
+    {
+        entry->flags |= SIGAR_PROC_SNAPSHOT_SCHED;
+    }
 }
 
-SIGAR_DECLARE(int) sigar_dump_pid_cache_get(sigar_t *sigar, sigar_dump_pid_cache_t *info) {
-  
-  get_cache_info(sigar->proc_cpu, "proc cpu cache");
-  get_cache_info(sigar->proc_io, "proc io cache");
-  return SIGAR_OK;
+static int proc_snapshot_entry_get(sigar_t *sigar, int flags,
+                                   sigar_proc_snapshot_entry_t *entry)
+{
+#ifdef SIGAR_HAS_OS_PROC_SNAPSHOT_ENTRY
+    return sigar_os_proc_snapshot_entry_get(sigar, flags, entry);
+#else
+    proc_snapshot_generic_entry_get(sigar, flags, entry);
+    return entry->flags ? SIGAR_OK : ESRCH;
+#endif
 }
 
-SIGAR_DECLARE(int) sigar_proc_stat_get(sigar_t *sigar,
-                                       sigar_proc_stat_t *procstat)
+static int proc_snapshot_generic_get(sigar_t *sigar, int flags,
+                                     sigar_proc_snapshot_t *snapshot)
 {
-    int status, i;
     sigar_proc_list_t *pids;
-
-    SIGAR_ZERO(procstat);
-    procstat->threads = SIGAR_FIELD_NOTIMPL;
+    unsigned long i;
+    int status;
 
     if ((status = sigar_proc_list_get(sigar, NULL)) != SIGAR_OK) {
         return status;
     }
 
     pids = sigar->pids;
-    procstat->total = pids->number;
 
     for (i=0; i<pids->number; i++) {
-        sigar_proc_state_t state;
+        sigar_proc_snapshot_entry_t *entry;
 
-        status = sigar_proc_state_get(sigar, pids->data[i], &state);
-        if (status != SIGAR_OK) {
-            continue;
-        }
+        SIGAR_PROC_SNAPSHOT_GROW(snapshot);
+        entry = &snapshot->data[snapshot->number];
+        entry->pid = pids->data[i];
 
-        if (state.threads != SIGAR_FIELD_NOTIMPL) {
-            procstat->threads += state.threads;
-        }
+        proc_snapshot_generic_entry_get(sigar, flags, entry);
 
-        switch (state.state) {
-          case SIGAR_PROC_STATE_IDLE:
-            procstat->idle++;
-            break;
-          case SIGAR_PROC_STATE_RUN:
-            procstat->running++;
-            break;
-          case SIGAR_PROC_STATE_SLEEP:
-            procstat->sleeping++;
-            break;
-          case SIGAR_PROC_STATE_STOP:
-            procstat->stopped++;
-            break;
-          case SIGAR_PROC_STATE_ZOMBIE:
-            procstat->zombie++;
-            break;
-          default:
-            break;
-        }
+        if (entry->flags) {
+            snapshot->number++;
+        } /* else the process went away */
     }
 
     return SIGAR_OK;
 }
 
-SIGAR_DECLARE(int) sigar_sys_info_get(sigar_t *sigar,
-                                      sigar_sys_info_t *sysinfo)
+typedef struct {
+    int flags;
+    sigar_proc_list_t *pids;
+    sigar_proc_snapshot_entry_t *data;
+} proc_snapshot_walk_t;
+
+static int proc_snapshot_walk(sigar_t *sigar, void *data, int worker,
+                              unsigned long start, unsigned long end)
 {
-    SIGAR_ZERO(sysinfo);
+    proc_snapshot_walk_t *walk = data;
+    unsigned long i;
 
-#ifndef WIN32
-    sigar_sys_info_get_uname(sysinfo);
-#endif
+    for (i=start; i<end; i++) {
+        sigar_proc_snapshot_entry_t *entry = &walk->data[i];
 
-    sigar_os_sys_info_get(sigar, sysinfo);
+        entry->pid = walk->pids->data[i];
+        if (proc_snapshot_entry_get(sigar, walk->flags, entry) != SIGAR_OK) {
+            entry->flags = 0; /* gone, dropped below */
+        }
+    }
 
     return SIGAR_OK;
 }
 
-#ifndef WIN32
-
-#include <sys/utsname.h>
-
-int sigar_sys_info_get_uname(sigar_sys_info_t *sysinfo)
+/* every pid gets its slot up front so workers never grow the array */
+static int proc_snapshot_parallel_get(sigar_t *sigar, int flags,
+                                      sigar_proc_snapshot_t *snapshot)
 {
-    struct utsname name;
-
-    uname(&name);
-
-    SIGAR_SSTRCPY(sysinfo->version, name.release);
-    SIGAR_SSTRCPY(sysinfo->vendor_name, name.sysname);
-    SIGAR_SSTRCPY(sysinfo->name, name.sysname);
-    SIGAR_SSTRCPY(sysinfo->machine, name.machine);
-    SIGAR_SSTRCPY(sysinfo->arch, name.machine);
-    SIGAR_SSTRCPY(sysinfo->patch_level, "unknown");
+    proc_snapshot_walk_t walk;
+    unsigned long i, j;
+    int status;
 
-    return SIGAR_OK;
-}
+    if ((status = sigar_proc_list_get(sigar, NULL)) != SIGAR_OK) {
+        return status;
+    }
 
-SIGAR_DECLARE(int)
-sigar_proc_cred_name_get(sigar_t *sigar, sigar_pid_t pid,
-                         sigar_proc_cred_name_t *proccredname)
-{
-    sigar_proc_cred_t cred;
+    walk.flags = flags;
+    walk.pids = sigar->pids;
 
-    int status = sigar_proc_cred_get(sigar, pid, &cred);
+    while (snapshot->size < walk.pids->number) {
+        sigar_proc_snapshot_grow(snapshot);
+    }
+    walk.data = snapshot->data;
 
+    status = sigar_parallel_walk(sigar, walk.pids->number,
+                                 proc_snapshot_walk, &walk);
     if (status != SIGAR_OK) {
         return status;
     }
 
-    status = sigar_user_name_get(sigar, cred.uid,
-                                 proccredname->user,
-                                 sizeof(proccredname->user));
+    for (i=0, j=0; i<walk.pids->number; i++) {
+        if (walk.data[i].flags) {
+            if (i != j) {
+                walk.data[j] = walk.data[i];
+            }
+            j++;
+        }
+    }
+    snapshot->number = j;
 
-    if (status != SIGAR_OK) {
-        return status;
+    return SIGAR_OK;
+}
+
+/* same bookkeeping as sigar_proc_cpu_get, with the times already read */
+static void proc_cpu_calc(sigar_t *sigar, sigar_uint64_t key,
+                          sigar_proc_cpu_t *proccpu,
+                          sigar_uint64_t time_now)
+{
+    sigar_cache_entry_t *centry;
+    sigar_proc_cpu_t *prev;
+    sigar_uint64_t otime, time_diff;
+
+    if (!sigar->proc_cpu) {
+        sigar->proc_cpu =
+            sigar_pid_cache_new(&sigar->proc_cpu_pool,
+                                sizeof(sigar_proc_cpu_t));
     }
 
-    status = sigar_group_name_get(sigar, cred.gid,
-                                  proccredname->group,
-                                  sizeof(proccredname->group));
+    centry = sigar_cache_get(sigar->proc_cpu, key);
+    if (centry->value) {
+        prev = (sigar_proc_cpu_t *)centry->value;
+    }
+    else {
+        prev = centry->value =
+            sigar_cache_value_new(sigar->proc_cpu, sizeof(*prev));
+    }
 
-    return status;
-}
+    time_diff = time_now - prev->last_time;
+    otime = prev->total;
+    proccpu->last_time = time_now;
 
-#endif /* WIN32 */
+    if (time_diff == 0) {
+        proccpu->percent = prev->percent;
+        return;
+    }
 
-int sigar_proc_list_create(sigar_proc_list_t *proclist)
-{
-    proclist->number = 0;
-    proclist->size = SIGAR_PROC_LIST_MAX;
-    proclist->data = malloc(sizeof(*(proclist->data)) *
-                            proclist->size);
-    return SIGAR_OK;
+    if ((proccpu->total < otime) || (proccpu->start_time != prev->start_time)) {
+        otime = 0; /* pid was reused */
+    }
+
+    if (otime == 0) {
+        proccpu->percent = 0.0;
+    }
+    else {
+        proccpu->percent = (proccpu->total - otime) / (double)time_diff;
+    }
+
+    memcpy(prev, proccpu, sizeof(*prev));
 }
 
-int sigar_proc_list_grow(sigar_proc_list_t *proclist)
+#if defined(SIGAR_HAS_OS_PROC_SNAPSHOT) && \
+    !defined(SIGAR_HAS_OS_PROC_SNAPSHOT_DISK_IO)
+/* whatever the bulk source left out, one getter per pid */
+static void proc_snapshot_disk_io_fill(sigar_t *sigar,
+                                       sigar_proc_snapshot_t *snapshot)
 {
-    proclist->data = realloc(proclist->data,
-                             sizeof(*(proclist->data)) *
-                             (proclist->size + SIGAR_PROC_LIST_MAX));
-    proclist->size += SIGAR_PROC_LIST_MAX;
+    unsigned long i;
 
-    return SIGAR_OK;
+    for (i=0; i<snapshot->number; i++) {
+        sigar_proc_snapshot_entry_t *entry = &snapshot->data[i];
+
+        if (!(entry->flags & SIGAR_PROC_SNAPSHOT_DISK_IO) &&
+            (sigar_proc_cumulative_disk_io_get(sigar, entry->pid,
+                                               &entry->disk_io) == SIGAR_OK))
+        {
+            entry->flags |= SIGAR_PROC_SNAPSHOT_DISK_IO;
+        }
+    }
 }
+#endif
 
-SIGAR_DECLARE(int) sigar_proc_list_destroy(sigar_t *sigar,
-                                           sigar_proc_list_t *proclist)
+SIGAR_DECLARE(int) sigar_proc_snapshot_get(sigar_t *sigar, int flags,
+                                           sigar_proc_snapshot_t *snapshot)
 {
-    if (proclist->size) {
-        free(proclist->data);
-        proclist->number = proclist->size = 0;
+    int status;
+
+    if (sigar->replay) {
+        return sigar_replay_proc_snapshot_get(sigar, flags, snapshot);
     }
 
-    return SIGAR_OK;
-}
+    if (flags & SIGAR_PROC_SNAPSHOT_CPU) {
+        flags |= SIGAR_PROC_SNAPSHOT_TIME;
+    }
 
-SIGAR_DECLARE(int) sigar_proc_list_get(sigar_t *sigar,
-                                       sigar_proc_list_t *proclist)
-{
-    if (proclist == NULL) {
-        /* internal re-use */
-        if (sigar->pids == NULL) {
-            sigar->pids = malloc(sizeof(*sigar->pids));
-            sigar_proc_list_create(sigar->pids);
-        }
-        else {
-            sigar->pids->number = 0;
-        }
-        proclist = sigar->pids;
+    sigar_proc_snapshot_create(snapshot);
+
+#if defined(SIGAR_HAS_OS_PROC_SNAPSHOT_ENTRY) || \
+    !defined(SIGAR_HAS_OS_PROC_SNAPSHOT)
+    /* a bulk source beats splitting per-pid reads across threads */
+    if (sigar->proc_scan_threads > 1) {
+        status = proc_snapshot_parallel_get(sigar, flags, snapshot);
     }
-    else {
-        sigar_proc_list_create(proclist);
+    else
+#endif
+#ifdef SIGAR_HAS_OS_PROC_SNAPSHOT
+    status = sigar_os_proc_snapshot_get(sigar, flags, snapshot);
+    if (status == SIGAR_ENOTIMPL) {
+        snapshot->number = 0;
+        status = proc_snapshot_generic_get(sigar, flags, snapshot);
     }
+#  ifndef SIGAR_HAS_OS_PROC_SNAPSHOT_DISK_IO
+    else if ((status == SIGAR_OK) && (flags & SIGAR_PROC_SNAPSHOT_DISK_IO)) {
+        proc_snapshot_disk_io_fill(sigar, snapshot);
+    }
+#  endif
+#else
+    status = proc_snapshot_generic_get(sigar, flags, snapshot);
+#endif
 
-    return sigar_os_proc_list_get(sigar, proclist);
+    if (status != SIGAR_OK) {
+        sigar_proc_snapshot_destroy(sigar, snapshot);
+        return status;
+    }
+
+    if (flags & SIGAR_PROC_SNAPSHOT_CPU) {
+        sigar_uint64_t time_now = sigar_time_now_millis();
+        unsigned long i;
+
+        for (i=0; i<snapshot->number; i++) {
+            sigar_proc_snapshot_entry_t *entry = &snapshot->data[i];
+
+            if (entry->flags & SIGAR_PROC_SNAPSHOT_TIME) {
+                proc_cpu_calc(sigar, entry->pid, &entry->cpu, time_now);
+                entry->flags |= SIGAR_PROC_SNAPSHOT_CPU;
+            }
+        }
+    }
+
+    return SIGAR_OK;
 }
 
-int sigar_proc_args_create(sigar_proc_args_t *procargs)
+int sigar_proc_thread_list_create(sigar_proc_thread_list_t *threads)
 {
-    procargs->number = 0;
-    procargs->size = SIGAR_PROC_ARGS_MAX;
-    procargs->data = malloc(sizeof(*(procargs->data)) *
-                            procargs->size);
+    threads->number = 0;
+    threads->size = SIGAR_PROC_THREAD_LIST_MAX;
+    threads->data = malloc(sizeof(*(threads->data)) *
+                           threads->size);
     return SIGAR_OK;
 }
 
-int sigar_proc_args_grow(sigar_proc_args_t *procargs)
+int sigar_proc_thread_list_grow(sigar_proc_thread_list_t *threads)
 {
-    procargs->data = realloc(procargs->data,
-                             sizeof(*(procargs->data)) *
-                             (procargs->size + SIGAR_PROC_ARGS_MAX));
-    procargs->size += SIGAR_PROC_ARGS_MAX;
+    threads->data = realloc(threads->data,
+                            sizeof(*(threads->data)) *
+                            (threads->size + SIGAR_PROC_THREAD_LIST_MAX));
+    threads->size += SIGAR_PROC_THREAD_LIST_MAX;
 
     return SIGAR_OK;
 }
 
-SIGAR_DECLARE(int) sigar_proc_args_destroy(sigar_t *sigar,
-                                           sigar_proc_args_t *procargs)
+SIGAR_DECLARE(int) sigar_proc_thread_list_destroy(sigar_t *sigar,
+                                                  sigar_proc_thread_list_t *threads)
 {
-    unsigned int i;
-
-    if (procargs->size) {
-        for (i=0; i<procargs->number; i++) {
-            free(procargs->data[i]);
-        }
-        free(procargs->data);
-        procargs->number = procargs->size = 0;
+    if (threads->size) {
+        free(threads->data);
+        threads->number = threads->size = 0;
     }
 
     return SIGAR_OK;
 }
 
-SIGAR_DECLARE(int) sigar_proc_args_get(sigar_t *sigar,
-                                       sigar_pid_t pid,
-                                       sigar_proc_args_t *procargs)
+/* threads share the proc_cpu cache, out of the way of pids */
+#define PROC_THREAD_CPU_KEY(tid) \
+    ((sigar_uint64_t)(tid) | ((sigar_uint64_t)1 << 63))
+
+SIGAR_DECLARE(int) sigar_proc_thread_list_get(sigar_t *sigar, sigar_pid_t pid,
+                                              sigar_proc_thread_list_t *threads)
 {
+#ifdef SIGAR_HAS_OS_PROC_THREAD_LIST
+    sigar_uint64_t time_now;
+    unsigned long i;
     int status;
-    sigar_proc_args_create(procargs);
-    status = sigar_os_proc_args_get(sigar, pid, procargs);
+
+    sigar_proc_thread_list_create(threads);
+
+    status = sigar_os_proc_thread_list_get(sigar, pid, threads);
+
     if (status != SIGAR_OK) {
-        sigar_proc_args_destroy(sigar, procargs);
+        sigar_proc_thread_list_destroy(sigar, threads);
+        return status;
     }
-    return status;
+
+    time_now = sigar_time_now_millis();
+
+    for (i=0; i<threads->number; i++) {
+        sigar_proc_thread_t *thread = &threads->data[i];
+
+        proc_cpu_calc(sigar, PROC_THREAD_CPU_KEY(thread->tid),
+                      &thread->cpu, time_now);
+    }
+
+    return SIGAR_OK;
+#else
+    return SIGAR_ENOTIMPL;
+#endif
 }
 
-int sigar_file_system_list_create(sigar_file_system_list_t *fslist)
+static int proc_top_entry_cmp(const void *a, const void *b)
 {
-    fslist->number = 0;
-    fslist->size = SIGAR_FS_MAX;
-    fslist->data = malloc(sizeof(*(fslist->data)) *
-                          fslist->size);
-    return SIGAR_OK;
+    sigar_pid_t pa = ((const sigar_proc_snapshot_entry_t *)a)->pid;
+    sigar_pid_t pb = ((const sigar_proc_snapshot_entry_t *)b)->pid;
+
+    return pa < pb ? -1 : (pa > pb ? 1 : 0);
 }
 
-int sigar_file_system_list_grow(sigar_file_system_list_t *fslist)
+typedef struct {
+    double cpu;
+    double io;
+    double faults;
+} proc_top_rates_t;
+
+/* min-heap of indexes into score, the root is the smallest kept */
+static void proc_top_sift_down(unsigned long *heap, unsigned long number,
+                               unsigned long i, double *score)
 {
-    fslist->data = realloc(fslist->data,
-                           sizeof(*(fslist->data)) *
-                           (fslist->size + SIGAR_FS_MAX));
-    fslist->size += SIGAR_FS_MAX;
+    for (;;) {
+        unsigned long min = i, l = 2*i + 1, r = l + 1;
 
-    return SIGAR_OK;
+        if ((l < number) && (score[heap[l]] < score[heap[min]])) {
+            min = l;
+        }
+        if ((r < number) && (score[heap[r]] < score[heap[min]])) {
+            min = r;
+        }
+        if (min == i) {
+            return;
+        }
+        l = heap[i];
+        heap[i] = heap[min];
+        heap[min] = l;
+        i = min;
+    }
 }
 
-/* indexed with sigar_file_system_type_e */
-static const char *fstype_names[] = {
-    "unknown", "none", "local", "remote", "ram", "cdrom", "swap"
-};
+static void proc_top_sift_up(unsigned long *heap, unsigned long i,
+                             double *score)
+{
+    while (i > 0) {
+        unsigned long parent = (i - 1) / 2, tmp;
 
-static int sigar_common_fs_type_get(sigar_file_system_t *fsp)
+        if (score[heap[parent]] <= score[heap[i]]) {
+            return;
+        }
+        tmp = heap[i];
+        heap[i] = heap[parent];
+        heap[parent] = tmp;
+        i = parent;
+    }
+}
+
+#define PROC_TOP_FLAGS \
+    (SIGAR_PROC_SNAPSHOT_STATE | \
+     SIGAR_PROC_SNAPSHOT_MEM   | \
+     SIGAR_PROC_SNAPSHOT_TIME  | \
+     SIGAR_PROC_SNAPSHOT_DISK_IO | \
+     SIGAR_PROC_SNAPSHOT_STATE_FIELDS(SIGAR_PROC_STATE_F_NAME | \
+                                      SIGAR_PROC_STATE_F_STATE) | \
+     SIGAR_PROC_SNAPSHOT_MEM_FIELDS(SIGAR_PROC_MEM_F_SIZE | \
+                                    SIGAR_PROC_MEM_F_RESIDENT | \
+                                    SIGAR_PROC_MEM_F_PAGE_FAULTS))
+
+#define PROC_TOP_DELTA(now, prev) \
+    (((now) == SIGAR_FIELD_NOTIMPL) || ((prev) == SIGAR_FIELD_NOTIMPL) || \
+     ((now) < (prev)) ? 0 : (now) - (prev))
+
+/*
+ * one snapshot per call, sorted by pid (already the case with /proc)
+ * and merged against the previous round's sorted samples, so deltas
+ * need no per-pid cache lookups.  the n largest scores are selected
+ * with a bounded heap, only those n get sorted.
+ */
+SIGAR_DECLARE(int) sigar_proc_top_get(sigar_t *sigar, unsigned long n,
+                                      int sort_key,
+                                      sigar_proc_top_t *top)
 {
-    char *type = fsp->sys_type_name;
+    sigar_proc_snapshot_t snapshot;
+    sigar_proc_top_samples_t *prev;
+    sigar_proc_top_sample_t *samples;
+    proc_top_rates_t *rates;
+    sigar_int64_t now;
+    double *score, seconds;
+    unsigned long *heap, number = 0, i, j;
+    int status, sorted = 1;
+
+    if ((sort_key < SIGAR_PROC_TOP_CPU) ||
+        (sort_key > SIGAR_PROC_TOP_RESIDENT))
+    {
+        return EINVAL;
+    }
 
-    switch (*type) {
-      case 'n':
-        if (strnEQ(type, "nfs", 3)) {
-            fsp->type = SIGAR_FSTYPE_NETWORK;
+    top->number = top->size = top->procs = 0;
+    top->interval = 0;
+    top->data = NULL;
+
+    status = sigar_proc_snapshot_get(sigar, PROC_TOP_FLAGS, &snapshot);
+    if (status != SIGAR_OK) {
+        return status;
+    }
+    now = sigar_time_now_millis();
+
+    if (!sigar->proc_top) {
+        sigar->proc_top = calloc(1, sizeof(*sigar->proc_top));
+    }
+    prev = sigar->proc_top;
+
+    for (i=1; i<snapshot.number; i++) {
+        if (snapshot.data[i].pid < snapshot.data[i-1].pid) {
+            sorted = 0;
+            break;
         }
-        break;
-      case 's':
-        if (strEQ(type, "smbfs")) { /* samba */
-            fsp->type = SIGAR_FSTYPE_NETWORK;
+    }
+    if (!sorted) {
+        qsort(snapshot.data, snapshot.number, sizeof(*snapshot.data),
+              proc_top_entry_cmp);
+    }
+
+    samples = malloc(sizeof(*samples) * (snapshot.number + 1));
+    rates = malloc(sizeof(*rates) * (snapshot.number + 1));
+    score = malloc(sizeof(*score) * (snapshot.number + 1));
+    heap = malloc(sizeof(*heap) * (snapshot.number + 1));
+
+    if (prev->data && (now > prev->timestamp)) {
+        top->interval = now - prev->timestamp;
+    }
+    seconds = top->interval / (double)SIGAR_MSEC;
+
+    for (i=0, j=0; i<snapshot.number; i++) {
+        sigar_proc_snapshot_entry_t *entry = &snapshot.data[i];
+        sigar_proc_top_sample_t *sample = &samples[i];
+        proc_top_rates_t *rate = &rates[i];
+
+        sample->pid = entry->pid;
+        sample->start_time = sample->cpu_total = 0;
+        sample->faults = sample->io = SIGAR_FIELD_NOTIMPL;
+
+        if (entry->flags & SIGAR_PROC_SNAPSHOT_TIME) {
+            sample->start_time = entry->cpu.start_time;
+            sample->cpu_total = entry->cpu.total;
         }
-        else if (strEQ(type, "swap")) {
-            fsp->type = SIGAR_FSTYPE_SWAP;
+        if (entry->flags & SIGAR_PROC_SNAPSHOT_MEM) {
+            sample->faults = entry->mem.page_faults;
         }
-        break;
-      case 'a':
-        if (strEQ(type, "afs")) {
-            fsp->type = SIGAR_FSTYPE_NETWORK;
+        if (entry->flags & SIGAR_PROC_SNAPSHOT_DISK_IO) {
+            sample->io = entry->disk_io.bytes_total;
         }
-        break;
-      case 'i':
-        if (strEQ(type, "iso9660")) {
-            fsp->type = SIGAR_FSTYPE_CDROM;
+
+        rate->cpu = rate->io = rate->faults = 0;
+
+        while ((j < prev->number) && (prev->data[j].pid < sample->pid)) {
+            j++;
         }
-        break;
-      case 'c':
-        if (strEQ(type, "cvfs")) {
-            fsp->type = SIGAR_FSTYPE_LOCAL_DISK;
+
+        if (top->interval &&
+            (j < prev->number) &&
+            (prev->data[j].pid == sample->pid) &&
+            (prev->data[j].start_time == sample->start_time))
+        {
+            sigar_proc_top_sample_t *old = &prev->data[j];
+
+            rate->cpu = PROC_TOP_DELTA(sample->cpu_total, old->cpu_total) /
+                (double)top->interval;
+            rate->io = PROC_TOP_DELTA(sample->io, old->io) / seconds;
+            rate->faults =
+                PROC_TOP_DELTA(sample->faults, old->faults) / seconds;
+        } /* else new or reused pid, no rates yet */
+        if (sample->io == SIGAR_FIELD_NOTIMPL) {
+            rate->io = -1;
         }
-        else if (strEQ(type, "cifs")) {
-            fsp->type = SIGAR_FSTYPE_NETWORK;
+
+        switch (sort_key) {
+          case SIGAR_PROC_TOP_CPU:
+            score[i] = rate->cpu;
+            break;
+          case SIGAR_PROC_TOP_IO:
+            score[i] = rate->io;
+            break;
+          case SIGAR_PROC_TOP_FAULTS:
+            score[i] = rate->faults;
+            break;
+          case SIGAR_PROC_TOP_RESIDENT:
+            score[i] = (entry->flags & SIGAR_PROC_SNAPSHOT_MEM) ?
+                (double)entry->mem.resident : 0;
+            break;
         }
-        break;
-      case 'm':
-        if (strEQ(type, "msdos") || strEQ(type, "minix")) {
-            fsp->type = SIGAR_FSTYPE_LOCAL_DISK;
+
+        if ((n == 0) || (number < n)) {
+            heap[number] = i;
+            proc_top_sift_up(heap, number++, score);
         }
-        break;
-      case 'h':
-        if (strEQ(type, "hpfs")) {
-            fsp->type = SIGAR_FSTYPE_LOCAL_DISK;
+        else if (score[i] > score[heap[0]]) {
+            heap[0] = i;
+            proc_top_sift_down(heap, number, 0, score);
         }
-        break;
-      case 'v':
-        if (strEQ(type, "vxfs")) {
-            fsp->type = SIGAR_FSTYPE_LOCAL_DISK;
+    }
+
+    top->procs = snapshot.number;
+    top->number = top->size = number;
+    top->data = malloc(sizeof(*top->data) * (number + 1));
+
+    /* pop the smallest into the last free slot, largest ends up first */
+    while (number > 0) {
+        sigar_proc_snapshot_entry_t *entry = &snapshot.data[heap[0]];
+        proc_top_rates_t *rate = &rates[heap[0]];
+        sigar_proc_top_entry_t *result = &top->data[--number];
+
+        result->pid = entry->pid;
+        if (entry->flags & SIGAR_PROC_SNAPSHOT_STATE) {
+            result->state = entry->state.state;
+            SIGAR_SSTRCPY(result->name, entry->state.name);
         }
-        else if (strEQ(type, "vfat")) {
-            fsp->type = SIGAR_FSTYPE_LOCAL_DISK;
+        else {
+            result->state = '?';
+            result->name[0] = '\0';
         }
-        break;
-      case 'z': 
-        if (strEQ(type, "zfs")) { 
-            fsp->type = SIGAR_FSTYPE_LOCAL_DISK; 
-        } 
-        break;
+        if (entry->flags & SIGAR_PROC_SNAPSHOT_MEM) {
+            result->size = entry->mem.size;
+            result->resident = entry->mem.resident;
+        }
+        else {
+            result->size = result->resident = SIGAR_FIELD_NOTIMPL;
+        }
+        result->cpu_total = (entry->flags & SIGAR_PROC_SNAPSHOT_TIME) ?
+            entry->cpu.total : SIGAR_FIELD_NOTIMPL;
+        result->cpu_percent = rate->cpu;
+        result->io_rate = rate->io;
+        result->fault_rate = rate->faults;
+
+        heap[0] = heap[number];
+        proc_top_sift_down(heap, number, 0, score);
     }
 
-    return fsp->type;
+    free(prev->data);
+    prev->data = samples;
+    prev->number = snapshot.number;
+    prev->timestamp = now;
+
+    free(rates);
+    free(score);
+    free(heap);
+    sigar_proc_snapshot_destroy(sigar, &snapshot);
+
+    return SIGAR_OK;
 }
 
-void sigar_fs_type_get(sigar_file_system_t *fsp)
+SIGAR_DECLARE(int) sigar_proc_top_destroy(sigar_t *sigar,
+                                          sigar_proc_top_t *top)
 {
-    if (!(fsp->type ||                    /* already set */
-          sigar_os_fs_type_get(fsp) ||    /* try os specifics first */
-          sigar_common_fs_type_get(fsp))) /* try common ones last */
+    if (top->data) {
+        free(top->data);
+        top->data = NULL;
+    }
+    top->number = top->size = 0;
+
+    return SIGAR_OK;
+}
+
+static void proc_tree_usage_add(sigar_proc_tree_usage_t *sum,
+                                sigar_proc_tree_usage_t *usage)
+{
+    sum->processes += usage->processes;
+    sum->cpu_total += usage->cpu_total;
+    sum->cpu_percent += usage->cpu_percent;
+    sum->resident += usage->resident;
+    if ((sum->fds != SIGAR_FIELD_NOTIMPL) &&
+        (usage->fds != SIGAR_FIELD_NOTIMPL))
     {
-        fsp->type = SIGAR_FSTYPE_NONE;
+        sum->fds += usage->fds;
     }
+}
 
-    if (fsp->type >= SIGAR_FSTYPE_MAX) {
-        fsp->type = SIGAR_FSTYPE_NONE;
+/* with parent already set, children are linked lowest pid first */
+static void proc_tree_link(sigar_proc_tree_t *tree)
+{
+    unsigned long i = tree->number;
+
+    while (i-- > 0) {
+        sigar_proc_tree_entry_t *entry = &tree->data[i];
+
+        if (entry->parent != SIGAR_PROC_TREE_NONE) {
+            sigar_proc_tree_entry_t *parent = &tree->data[entry->parent];
+
+            entry->sibling = parent->child;
+            parent->child = i;
+        }
     }
+}
 
-    strcpy(fsp->type_name, fstype_names[fsp->type]);
+static void proc_tree_unlink(sigar_proc_tree_t *tree, unsigned long i)
+{
+    sigar_proc_tree_entry_t *parent = &tree->data[tree->data[i].parent];
+    unsigned long *link = &parent->child;
+
+    while (*link != i) {
+        link = &tree->data[*link].sibling;
+    }
+    *link = tree->data[i].sibling;
+
+    tree->data[i].parent = tree->data[i].sibling = SIGAR_PROC_TREE_NONE;
+}
+
+/* appends the subtree of root to order, breadth first */
+static unsigned long proc_tree_order(sigar_proc_tree_t *tree,
+                                     unsigned long root,
+                                     unsigned long *order,
+                                     unsigned long number,
+                                     char *seen)
+{
+    unsigned long next = number;
+
+    order[number++] = root;
+    seen[root] = 1;
+
+    while (next < number) {
+        unsigned long child = tree->data[order[next++]].child;
+
+        for (; child != SIGAR_PROC_TREE_NONE;
+             child = tree->data[child].sibling)
+        {
+            order[number++] = child;
+            seen[child] = 1;
+        }
+    }
+
+    return number;
+}
+
+int sigar_proc_tree_build(sigar_t *sigar, int snapshot_flags, int flags,
+                          sigar_proc_tree_t *tree)
+{
+    sigar_proc_snapshot_t snapshot;
+    unsigned long i, number, *order;
+    char *seen;
+    int status;
+
+    tree->number = tree->size = 0;
+    tree->data = NULL;
+
+    status = sigar_proc_snapshot_get(sigar, snapshot_flags, &snapshot);
+    if (status != SIGAR_OK) {
+        return status;
+    }
+
+    for (i=1; i<snapshot.number; i++) {
+        if (snapshot.data[i].pid < snapshot.data[i-1].pid) {
+            qsort(snapshot.data, snapshot.number, sizeof(*snapshot.data),
+                  proc_top_entry_cmp);
+            break;
+        }
+    }
+
+    tree->data = malloc(sizeof(*tree->data) * (snapshot.number + 1));
+    order = malloc(sizeof(*order) * (snapshot.number + 1));
+    seen = calloc(snapshot.number + 1, 1);
+    if (!tree->data || !order || !seen) {
+        free(tree->data);
+        free(order);
+        free(seen);
+        tree->data = NULL;
+        sigar_proc_snapshot_destroy(sigar, &snapshot);
+        return ENOMEM;
+    }
+    tree->number = tree->size = snapshot.number;
+
+    for (i=0; i<snapshot.number; i++) {
+        sigar_proc_snapshot_entry_t *proc = &snapshot.data[i];
+        sigar_proc_tree_entry_t *entry = &tree->data[i];
+        sigar_proc_tree_usage_t *self = &entry->self;
+
+        entry->pid = proc->pid;
+        entry->ppid = (proc->flags & SIGAR_PROC_SNAPSHOT_STATE) ?
+            proc->state.ppid : -1;
+        entry->child = entry->sibling = SIGAR_PROC_TREE_NONE;
+
+        memset(self, 0, sizeof(*self));
+        self->processes = 1;
+        if (proc->flags & SIGAR_PROC_SNAPSHOT_TIME) {
+            self->cpu_total = proc->cpu.total;
+        }
+        if (proc->flags & SIGAR_PROC_SNAPSHOT_CPU) {
+            self->cpu_percent = proc->cpu.percent;
+        }
+        if (proc->flags & SIGAR_PROC_SNAPSHOT_MEM) {
+            self->resident = proc->mem.resident;
+        }
+        self->fds = SIGAR_FIELD_NOTIMPL;
+        if (flags & SIGAR_PROC_TREE_FD) {
+            sigar_proc_fd_t procfd;
+
+            self->fds = 0; /* unreadable counts as none in the sums */
+            if (sigar_proc_fd_get(sigar, proc->pid, &procfd) == SIGAR_OK) {
+                self->fds = procfd.total;
+            }
+        }
+        memcpy(&entry->subtree, self, sizeof(*self));
+    }
+    sigar_proc_snapshot_destroy(sigar, &snapshot);
+
+    for (i=0; i<tree->number; i++) {
+        sigar_proc_tree_entry_t *entry = &tree->data[i];
+
+        entry->parent = (entry->ppid == entry->pid) ?
+            SIGAR_PROC_TREE_NONE : sigar_proc_tree_find(tree, entry->ppid);
+    }
+    proc_tree_link(tree);
+
+    number = 0;
+    for (i=0; i<tree->number; i++) {
+        if (tree->data[i].parent == SIGAR_PROC_TREE_NONE) {
+            number = proc_tree_order(tree, i, order, number, seen);
+        }
+    }
+
+    /* what was not reached hangs off a loop, pids reused mid-scan */
+    for (i=0; number < tree->number; i++) {
+        unsigned long loop = i, n;
+
+        if (seen[i]) {
+            continue;
+        }
+        for (n=0; n<tree->number; n++) {
+            loop = tree->data[loop].parent;
+        }
+        proc_tree_unlink(tree, loop);
+        number = proc_tree_order(tree, loop, order, number, seen);
+    }
+
+    /* children come after their parents in order */
+    i = number;
+    while (i-- > 0) {
+        sigar_proc_tree_entry_t *entry = &tree->data[order[i]];
+
+        if (entry->parent != SIGAR_PROC_TREE_NONE) {
+            proc_tree_usage_add(&tree->data[entry->parent].subtree,
+                                &entry->subtree);
+        }
+    }
+
+    free(order);
+    free(seen);
+
+    return SIGAR_OK;
+}
+
+#define PROC_TREE_FLAGS \
+    (SIGAR_PROC_SNAPSHOT_STATE | \
+     SIGAR_PROC_SNAPSHOT_MEM   | \
+     SIGAR_PROC_SNAPSHOT_CPU   | \
+     SIGAR_PROC_SNAPSHOT_STATE_FIELDS(SIGAR_PROC_STATE_F_PPID) | \
+     SIGAR_PROC_SNAPSHOT_MEM_FIELDS(SIGAR_PROC_MEM_F_RESIDENT))
+
+SIGAR_DECLARE(int) sigar_proc_tree_get(sigar_t *sigar, int flags,
+                                       sigar_proc_tree_t *tree)
+{
+    return sigar_proc_tree_build(sigar, PROC_TREE_FLAGS, flags, tree);
+}
+
+SIGAR_DECLARE(int) sigar_proc_tree_destroy(sigar_t *sigar,
+                                           sigar_proc_tree_t *tree)
+{
+    if (tree->data) {
+        free(tree->data);
+        tree->data = NULL;
+    }
+    tree->number = tree->size = 0;
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(unsigned long) sigar_proc_tree_find(sigar_proc_tree_t *tree,
+                                                  sigar_pid_t pid)
+{
+    unsigned long lo = 0, hi = tree->number;
+
+    while (lo < hi) {
+        unsigned long mid = lo + (hi - lo) / 2;
+
+        if (tree->data[mid].pid < pid) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+
+    if ((lo < tree->number) && (tree->data[lo].pid == pid)) {
+        return lo;
+    }
+
+    return SIGAR_PROC_TREE_NONE;
+}
+
+SIGAR_DECLARE(int) sigar_proc_tree_pids_get(sigar_proc_tree_t *tree,
+                                            sigar_pid_t pid,
+                                            sigar_proc_list_t *proclist)
+{
+    unsigned long root = sigar_proc_tree_find(tree, pid), i;
+
+    if (root == SIGAR_PROC_TREE_NONE) {
+        return ESRCH;
+    }
+
+    sigar_proc_list_create(proclist);
+
+    /* depth first without a stack, back up through parent */
+    for (i=root; ;) {
+        sigar_proc_tree_entry_t *entry = &tree->data[i];
+
+        SIGAR_PROC_LIST_GROW(proclist);
+        proclist->data[proclist->number++] = entry->pid;
+
+        if (entry->child != SIGAR_PROC_TREE_NONE) {
+            i = entry->child;
+            continue;
+        }
+        while ((i != root) &&
+               (tree->data[i].sibling == SIGAR_PROC_TREE_NONE))
+        {
+            i = tree->data[i].parent;
+        }
+        if (i == root) {
+            break;
+        }
+        i = tree->data[i].sibling;
+    }
+
+    return SIGAR_OK;
+}
+
+void copy_cached_disk_io_into_disk_io( sigar_cached_proc_disk_io_t *cached,  sigar_proc_disk_io_t *proc_disk_io) {
+   proc_disk_io->bytes_read = cached->bytes_read_diff;
+   proc_disk_io->bytes_written = cached->bytes_written_diff;
+   proc_disk_io->bytes_total = cached->bytes_total_diff;
+}
+
+sigar_uint64_t get_io_diff(sigar_uint64_t current_value, sigar_uint64_t prev_value,  sigar_uint64_t time_diff) {
+   double io_diff;
+   sigar_uint64_t int_io_diff;
+   if ( current_value == SIGAR_FIELD_NOTIMPL ) {
+      return SIGAR_FIELD_NOTIMPL;
+   }
+   io_diff = (( current_value - prev_value)/(double)time_diff)*SIGAR_MSEC;
+   int_io_diff = (sigar_uint64_t)io_diff;
+   if (int_io_diff >=0) {
+      return int_io_diff;
+   }
+   return 0;
+}
+
+void calculate_io_diff(sigar_proc_cumulative_disk_io_t * proc_disk_io, sigar_cached_proc_disk_io_t *cached,  sigar_uint64_t time_diff, int is_first_time) {
+   /*calculate avg diff /read/write/total per second*/
+   if (!is_first_time) {
+       cached->bytes_written_diff = get_io_diff(proc_disk_io->bytes_written, cached->bytes_written, time_diff);
+       cached->bytes_read_diff = get_io_diff(proc_disk_io->bytes_read, cached->bytes_read, time_diff);
+       cached->bytes_total_diff = get_io_diff(proc_disk_io->bytes_total, cached->bytes_total, time_diff);
+   }
+   else {
+       cached->bytes_total_diff =  cached->bytes_read_diff =  cached->bytes_written_diff = 0.0;
+   }
+   // now put in cache the current cumulative values
+   cached->bytes_written = proc_disk_io->bytes_written;
+   cached->bytes_read = proc_disk_io->bytes_read;
+   cached->bytes_total = proc_disk_io->bytes_total;
+}
+
+SIGAR_DECLARE(int) sigar_proc_disk_io_get(sigar_t *sigar, sigar_pid_t pid,
+                                          sigar_proc_disk_io_t *proc_disk_io)
+{
+    sigar_cache_entry_t *entry;
+    sigar_cached_proc_disk_io_t *prev;
+    sigar_proc_cumulative_disk_io_t  cumulative_proc_disk_io;
+    sigar_uint64_t time_now = sigar_time_now_millis();
+    sigar_uint64_t time_diff;
+    int status, is_first_time;
+
+    if (!sigar->proc_io) {
+        sigar->proc_io =
+            sigar_pid_cache_new(&sigar->proc_io_pool,
+                                sizeof(sigar_cached_proc_disk_io_t));
+    }
+
+    entry = sigar_cache_get(sigar->proc_io, pid);
+    if (entry->value) {
+        prev = (sigar_cached_proc_disk_io_t *)entry->value;
+    }
+    else {
+        prev = entry->value =
+            sigar_cache_value_new(sigar->proc_io, sizeof(*prev));
+    }
+    is_first_time = (prev->last_time == 0);
+    time_diff = time_now - prev->last_time;
+
+    if (time_diff < 1000) {
+        /* we were just called within < 1 second ago. */
+        copy_cached_disk_io_into_disk_io(prev, proc_disk_io);
+	if (time_diff < 0) {
+	   // something is wrong at least from now on the time will be ok
+ 	   prev->last_time = time_now;
+        }
+        return SIGAR_OK;
+    }
+    prev->last_time = time_now;
+
+
+    status =
+        sigar_proc_cumulative_disk_io_get(sigar, pid,
+                            &cumulative_proc_disk_io);
+
+    if (status != SIGAR_OK) {
+        return status;
+    }
+    calculate_io_diff(&cumulative_proc_disk_io, prev, time_diff,  is_first_time);
+    copy_cached_disk_io_into_disk_io(prev, proc_disk_io);
+    return SIGAR_OK;
 }
 
+SIGAR_DECLARE(int) sigar_proc_cache_expire_set(sigar_t *sigar,
+                                               sigar_uint64_t millis)
+{
+    sigar->proc_cache_expire = millis;
+    return SIGAR_OK;
+}
 
 SIGAR_DECLARE(int)
-sigar_file_system_list_destroy(sigar_t *sigar,
-                               sigar_file_system_list_t *fslist)
+sigar_net_interface_stat_expire_set(sigar_t *sigar, sigar_uint64_t millis)
 {
-    if (fslist->size) {
-        free(fslist->data);
-        fslist->number = fslist->size = 0;
+    sigar->net_ifstat_expire = millis;
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int) sigar_cred_name_expire_set(sigar_t *sigar,
+                                              sigar_uint64_t millis)
+{
+    sigar->cred_name_expire = millis;
+
+    /* entries carry their own expiry, start over with the new one */
+    if (sigar->user_names) {
+        sigar_cache_destroy(sigar->user_names);
+        sigar->user_names = NULL;
+    }
+    if (sigar->group_names) {
+        sigar_cache_destroy(sigar->group_names);
+        sigar->group_names = NULL;
+    }
+
+    return SIGAR_OK;
+}
+
+static sigar_cache_t **sigar_cache_named(sigar_t *sigar, const char *name)
+{
+    if (strEQ(name, "proc_cpu")) {
+        return &sigar->proc_cpu;
+    }
+    else if (strEQ(name, "proc_io")) {
+        return &sigar->proc_io;
+    }
+    else if (strEQ(name, "fsdev")) {
+        return &sigar->fsdev;
+    }
+    else if (strEQ(name, "net_listen")) {
+        return &sigar->net_listen;
+    }
+    else if (strEQ(name, "user_names")) {
+        return &sigar->user_names;
+    }
+    else if (strEQ(name, "group_names")) {
+        return &sigar->group_names;
+    }
+    return NULL;
+}
+
+SIGAR_DECLARE(int) sigar_cache_stats_get(sigar_t *sigar,
+                                         const char *name,
+                                         sigar_cache_stats_t *stats)
+{
+    sigar_cache_t **cache;
+
+    /* the services table is shared, see sigar_format.c */
+    if (strEQ(name, "net_services_tcp")) {
+        return sigar_net_services_stats(sigar, SIGAR_NETCONN_TCP, stats);
+    }
+    else if (strEQ(name, "net_services_udp")) {
+        return sigar_net_services_stats(sigar, SIGAR_NETCONN_UDP, stats);
+    }
+
+    if (!(cache = sigar_cache_named(sigar, name))) {
+        return ENOENT;
+    }
+
+    SIGAR_ZERO(stats);
+
+    if (*cache) {
+        sigar_cache_stats(*cache, stats);
+    }
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int) sigar_dump_pid_cache_get(sigar_t *sigar, sigar_dump_pid_cache_t *info) {
+  
+  SIGAR_ZERO(info);
+
+  if (sigar->proc_cpu) {
+      info->proc_cpu_count = sigar->proc_cpu->count;
+      info->proc_cpu_evictions = sigar->proc_cpu->evictions;
+  }
+  if (sigar->proc_io) {
+      info->proc_io_count = sigar->proc_io->count;
+      info->proc_io_evictions = sigar->proc_io->evictions;
+  }
+  return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int) sigar_proc_stat_census_set(sigar_t *sigar, int enable)
+{
+    sigar->proc_stat_census = enable;
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int) sigar_proc_stat_get(sigar_t *sigar,
+                                       sigar_proc_stat_t *procstat)
+{
+    int status;
+    sigar_proc_iter_t *iter;
+    sigar_pid_t pid;
+
+#ifdef SIGAR_HAS_OS_PROC_STAT
+    if (!sigar->proc_stat_census) {
+        status = sigar_os_proc_stat_get(sigar, procstat);
+        if (status != SIGAR_ENOTIMPL) {
+            return status;
+        }
+    }
+#endif
+
+    SIGAR_ZERO(procstat);
+    procstat->threads = SIGAR_FIELD_NOTIMPL;
+
+    if ((status = sigar_proc_iter_open(sigar, &iter)) != SIGAR_OK) {
+        return status;
+    }
+
+    while (sigar_proc_iter_next(iter, &pid) == SIGAR_OK) {
+        sigar_proc_state_t state;
+
+        procstat->total++;
+
+        status = sigar_proc_state_get(sigar, pid, &state);
+        if (status != SIGAR_OK) {
+            continue;
+        }
+
+        if (state.threads != SIGAR_FIELD_NOTIMPL) {
+            procstat->threads += state.threads;
+        }
+
+        switch (state.state) {
+          case SIGAR_PROC_STATE_IDLE:
+            procstat->idle++;
+            break;
+          case SIGAR_PROC_STATE_RUN:
+            procstat->running++;
+            break;
+          case SIGAR_PROC_STATE_SLEEP:
+            procstat->sleeping++;
+            break;
+          case SIGAR_PROC_STATE_STOP:
+            procstat->stopped++;
+            break;
+          case SIGAR_PROC_STATE_ZOMBIE:
+            procstat->zombie++;
+            break;
+          default:
+            break;
+        }
+    }
+
+    sigar_proc_iter_close(iter);
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int) sigar_sys_info_get(sigar_t *sigar,
+                                      sigar_sys_info_t *sysinfo)
+{
+    SIGAR_ZERO(sysinfo);
+
+#ifndef WIN32
+    sigar_sys_info_get_uname(sysinfo);
+#endif
+
+    sigar_os_sys_info_get(sigar, sysinfo);
+
+    return SIGAR_OK;
+}
+
+#ifndef WIN32
+
+#include <sys/utsname.h>
+
+int sigar_sys_info_get_uname(sigar_sys_info_t *sysinfo)
+{
+    struct utsname name;
+
+    uname(&name);
+
+    SIGAR_SSTRCPY(sysinfo->version, name.release);
+    SIGAR_SSTRCPY(sysinfo->vendor_name, name.sysname);
+    SIGAR_SSTRCPY(sysinfo->name, name.sysname);
+    SIGAR_SSTRCPY(sysinfo->machine, name.machine);
+    SIGAR_SSTRCPY(sysinfo->arch, name.machine);
+    SIGAR_SSTRCPY(sysinfo->patch_level, "unknown");
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int)
+sigar_proc_cred_name_get(sigar_t *sigar, sigar_pid_t pid,
+                         sigar_proc_cred_name_t *proccredname)
+{
+    sigar_proc_cred_t cred;
+
+    int status = sigar_proc_cred_get(sigar, pid, &cred);
+
+    if (status != SIGAR_OK) {
+        return status;
+    }
+
+    status = sigar_user_name_get(sigar, cred.uid,
+                                 proccredname->user,
+                                 sizeof(proccredname->user));
+
+    if (status != SIGAR_OK) {
+        return status;
+    }
+
+    status = sigar_group_name_get(sigar, cred.gid,
+                                  proccredname->group,
+                                  sizeof(proccredname->group));
+
+    return status;
+}
+
+#endif /* WIN32 */
+
+int sigar_proc_list_create(sigar_proc_list_t *proclist)
+{
+    proclist->number = 0;
+    proclist->size = SIGAR_PROC_LIST_MAX;
+    proclist->data = malloc(sizeof(*(proclist->data)) *
+                            proclist->size);
+    return SIGAR_OK;
+}
+
+int sigar_proc_list_grow(sigar_proc_list_t *proclist)
+{
+    proclist->data = realloc(proclist->data,
+                             sizeof(*(proclist->data)) *
+                             (proclist->size + SIGAR_PROC_LIST_MAX));
+    proclist->size += SIGAR_PROC_LIST_MAX;
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int) sigar_proc_list_destroy(sigar_t *sigar,
+                                           sigar_proc_list_t *proclist)
+{
+    if (proclist->size) {
+        free(proclist->data);
+        proclist->number = proclist->size = 0;
+    }
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int) sigar_proc_list_get(sigar_t *sigar,
+                                       sigar_proc_list_t *proclist)
+{
+    if (proclist == NULL) {
+        /* internal re-use */
+        if (sigar->pids == NULL) {
+            sigar->pids = malloc(sizeof(*sigar->pids));
+            sigar_proc_list_create(sigar->pids);
+        }
+        else {
+            sigar->pids->number = 0;
+        }
+        proclist = sigar->pids;
+    }
+    else {
+        SIGAR_LIST_CREATE(sigar, proclist, sigar_proc_list_create);
+    }
+
+    if (sigar->replay) {
+        return sigar_replay_proc_list_get(sigar, proclist);
+    }
+
+    if (sigar->proc_events) {
+        return sigar_proc_events_list_get(sigar, proclist);
+    }
+
+    return sigar_os_proc_list_get(sigar, proclist);
+}
+
+SIGAR_DECLARE(int) sigar_proc_iter_open(sigar_t *sigar,
+                                        sigar_proc_iter_t **iterp)
+{
+    sigar_proc_iter_t *iter = *iterp = calloc(1, sizeof(*iter));
+    int status;
+
+    if (!iter) {
+        return ENOMEM;
+    }
+    iter->sigar = sigar;
+
+#ifdef SIGAR_HAS_OS_PROC_ITER
+    status = sigar_os_proc_iter_open(iter);
+#else
+    /* native apis hand back the whole table in one buffer anyway */
+    sigar_proc_list_create(&iter->pids);
+    status = sigar_os_proc_list_get(sigar, &iter->pids);
+    if (status != SIGAR_OK) {
+        sigar_proc_list_destroy(sigar, &iter->pids);
+    }
+#endif
+
+    if (status != SIGAR_OK) {
+        free(iter);
+        *iterp = NULL;
+    }
+
+    return status;
+}
+
+SIGAR_DECLARE(int) sigar_proc_iter_next(sigar_proc_iter_t *iter,
+                                        sigar_pid_t *pid)
+{
+#ifdef SIGAR_HAS_OS_PROC_ITER
+    return sigar_os_proc_iter_next(iter, pid);
+#else
+    if (iter->next >= iter->pids.number) {
+        return ENOENT;
+    }
+    *pid = iter->pids.data[iter->next++];
+    return SIGAR_OK;
+#endif
+}
+
+SIGAR_DECLARE(int) sigar_proc_iter_close(sigar_proc_iter_t *iter)
+{
+#ifdef SIGAR_HAS_OS_PROC_ITER
+    sigar_os_proc_iter_close(iter);
+#else
+    sigar_proc_list_destroy(iter->sigar, &iter->pids);
+#endif
+    free(iter);
+    return SIGAR_OK;
+}
+
+int sigar_proc_args_create(sigar_proc_args_t *procargs)
+{
+    procargs->number = 0;
+    procargs->size = SIGAR_PROC_ARGS_MAX;
+    procargs->data = malloc(sizeof(*(procargs->data)) *
+                            procargs->size);
+    return SIGAR_OK;
+}
+
+int sigar_proc_args_grow(sigar_proc_args_t *procargs)
+{
+    procargs->data = realloc(procargs->data,
+                             sizeof(*(procargs->data)) *
+                             (procargs->size + SIGAR_PROC_ARGS_MAX));
+    procargs->size += SIGAR_PROC_ARGS_MAX;
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int) sigar_proc_args_destroy(sigar_t *sigar,
+                                           sigar_proc_args_t *procargs)
+{
+    unsigned int i;
+
+    if (procargs->size) {
+        for (i=0; i<procargs->number; i++) {
+            free(procargs->data[i]);
+        }
+        free(procargs->data);
+        procargs->number = procargs->size = 0;
+    }
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int) sigar_proc_args_get(sigar_t *sigar,
+                                       sigar_pid_t pid,
+                                       sigar_proc_args_t *procargs)
+{
+    int status;
+    sigar_proc_args_create(procargs);
+    status = sigar_os_proc_args_get(sigar, pid, procargs);
+    if (status != SIGAR_OK) {
+        sigar_proc_args_destroy(sigar, procargs);
+    }
+    return status;
+}
+
+int sigar_file_system_list_create(sigar_file_system_list_t *fslist)
+{
+    fslist->number = 0;
+    fslist->size = SIGAR_FS_MAX;
+    fslist->data = malloc(sizeof(*(fslist->data)) *
+                          fslist->size);
+    return SIGAR_OK;
+}
+
+int sigar_file_system_list_grow(sigar_file_system_list_t *fslist)
+{
+    fslist->data = realloc(fslist->data,
+                           sizeof(*(fslist->data)) *
+                           (fslist->size + SIGAR_FS_MAX));
+    fslist->size += SIGAR_FS_MAX;
+
+    return SIGAR_OK;
+}
+
+/* indexed with sigar_file_system_type_e */
+static const char *fstype_names[] = {
+    "unknown", "none", "local", "remote", "ram", "cdrom", "swap"
+};
+
+static int sigar_common_fs_type_get(sigar_file_system_t *fsp)
+{
+    char *type = fsp->sys_type_name;
+
+    switch (*type) {
+      case 'n':
+        if (strnEQ(type, "nfs", 3)) {
+            fsp->type = SIGAR_FSTYPE_NETWORK;
+        }
+        break;
+      case 's':
+        if (strEQ(type, "smbfs")) { /* samba */
+            fsp->type = SIGAR_FSTYPE_NETWORK;
+        }
+        else if (strEQ(type, "swap")) {
+            fsp->type = SIGAR_FSTYPE_SWAP;
+        }
+        break;
+      case 'a':
+        if (strEQ(type, "afs")) {
+            fsp->type = SIGAR_FSTYPE_NETWORK;
+        }
+        break;
+      case 'i':
+        if (strEQ(type, "iso9660")) {
+            fsp->type = SIGAR_FSTYPE_CDROM;
+        }
+        break;
+      case 'c':
+        if (strEQ(type, "cvfs")) {
+            fsp->type = SIGAR_FSTYPE_LOCAL_DISK;
+        }
+        else if (strEQ(type, "cifs")) {
+            fsp->type = SIGAR_FSTYPE_NETWORK;
+        }
+        break;
+      case 'm':
+        if (strEQ(type, "msdos") || strEQ(type, "minix")) {
+            fsp->type = SIGAR_FSTYPE_LOCAL_DISK;
+        }
+        break;
+      case 'h':
+        if (strEQ(type, "hpfs")) {
+            fsp->type = SIGAR_FSTYPE_LOCAL_DISK;
+        }
+        break;
+      case 'v':
+        if (strEQ(type, "vxfs")) {
+            fsp->type = SIGAR_FSTYPE_LOCAL_DISK;
+        }
+        else if (strEQ(type, "vfat")) {
+            fsp->type = SIGAR_FSTYPE_LOCAL_DISK;
+        }
+        break;
+      case 'z': 
+        if (strEQ(type, "zfs")) { 
+            fsp->type = SIGAR_FSTYPE_LOCAL_DISK; 
+        } 
+        break;
+    }
+
+    return fsp->type;
+}
+
+void sigar_fs_type_get(sigar_file_system_t *fsp)
+{
+    if (!(fsp->type ||                    /* already set */
+          sigar_os_fs_type_get(fsp) ||    /* try os specifics first */
+          sigar_common_fs_type_get(fsp))) /* try common ones last */
+    {
+        fsp->type = SIGAR_FSTYPE_NONE;
+    }
+
+    if (fsp->type >= SIGAR_FSTYPE_MAX) {
+        fsp->type = SIGAR_FSTYPE_NONE;
+    }
+
+    strcpy(fsp->type_name, fstype_names[fsp->type]);
+}
+
+
+SIGAR_DECLARE(int)
+sigar_file_system_list_destroy(sigar_t *sigar,
+                               sigar_file_system_list_t *fslist)
+{
+    if (fslist->size) {
+        free(fslist->data);
+        fslist->number = fslist->size = 0;
+    }
+
+    return SIGAR_OK;
+}
+
+/* what sigar_file_system_usage_get adds on top of statvfs */
+static void fs_usage_finish(sigar_t *sigar, sigar_file_system_t *fs,
+                            sigar_file_system_usage_t *usage)
+{
+    usage->use_percent = sigar_file_system_usage_calc_used(sigar, usage);
+
+    SIGAR_DISK_STATS_INIT(&usage->disk);
+    /* sigar_disk_usage_get stats the mount, only trust local disks */
+    if (fs->type == SIGAR_FSTYPE_LOCAL_DISK) {
+        (void)sigar_disk_usage_get(sigar, fs->dir_name, &usage->disk);
+    }
+}
+
+SIGAR_DECLARE(int)
+sigar_file_system_usage_list_get(sigar_t *sigar,
+                                 sigar_file_system_list_t *fslist,
+                                 int timeout,
+                                 sigar_file_system_usage_list_t *usagelist)
+{
+    unsigned long i;
+    int status;
+
+    usagelist->number = usagelist->size = 0;
+    usagelist->data = NULL;
+
+    if (timeout <= 0) {
+        return EINVAL;
+    }
+    if (!fslist->number) {
+        return SIGAR_OK;
+    }
+
+    usagelist->data = calloc(fslist->number, sizeof(*usagelist->data));
+    if (!usagelist->data) {
+        return ENOMEM;
+    }
+    usagelist->number = usagelist->size = fslist->number;
+
+    /* statvfs on worker threads, a dead mount only costs its timeout */
+    status = sigar_fs_usage_batch_get(sigar, fslist, timeout, usagelist);
+    if (status != SIGAR_OK) {
+        sigar_file_system_usage_list_destroy(sigar, usagelist);
+        return status;
+    }
+
+    for (i=0; i<fslist->number; i++) {
+        if (usagelist->data[i].status == SIGAR_OK) {
+            fs_usage_finish(sigar, &fslist->data[i],
+                            &usagelist->data[i].usage);
+        }
+    }
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int)
+sigar_file_system_usage_list_destroy(sigar_t *sigar,
+                                     sigar_file_system_usage_list_t *usagelist)
+{
+    if (usagelist->size) {
+        free(usagelist->data);
+        usagelist->number = usagelist->size = 0;
+    }
+
+    return SIGAR_OK;
+}
+
+int sigar_nfs_mount_list_create(sigar_nfs_mount_list_t *mounts)
+{
+    mounts->number = 0;
+    mounts->size = SIGAR_NFS_MOUNT_MAX;
+    mounts->data = malloc(sizeof(*(mounts->data)) *
+                          mounts->size);
+    return SIGAR_OK;
+}
+
+int sigar_nfs_mount_list_grow(sigar_nfs_mount_list_t *mounts)
+{
+    mounts->data = realloc(mounts->data,
+                           sizeof(*(mounts->data)) *
+                           (mounts->size + SIGAR_NFS_MOUNT_MAX));
+    mounts->size += SIGAR_NFS_MOUNT_MAX;
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int)
+sigar_nfs_mount_list_destroy(sigar_t *sigar,
+                             sigar_nfs_mount_list_t *mounts)
+{
+    unsigned long i;
+
+    if (mounts->size) {
+        for (i=0; i<mounts->number; i++) {
+            free(mounts->data[i].ops);
+        }
+        free(mounts->data);
+        mounts->number = mounts->size = 0;
+    }
+
+    return SIGAR_OK;
+}
+
+#ifndef __linux__ /* linux reads each side once, v4 and mounts included */
+static void nfs_rpc_get(sigar_t *sigar, int server, sigar_nfs_rpc_t *rpc)
+{
+    SIGAR_ZERO(rpc);
+
+    if ((server ?
+         sigar_nfs_server_v2_get(sigar, &rpc->v2) :
+         sigar_nfs_client_v2_get(sigar, &rpc->v2)) == SIGAR_OK)
+    {
+        rpc->versions |= SIGAR_NFS_V2;
+    }
+
+    if ((server ?
+         sigar_nfs_server_v3_get(sigar, &rpc->v3) :
+         sigar_nfs_client_v3_get(sigar, &rpc->v3)) == SIGAR_OK)
+    {
+        rpc->versions |= SIGAR_NFS_V3;
+    }
+}
+
+SIGAR_DECLARE(int)
+sigar_nfs_stats_get(sigar_t *sigar,
+                    sigar_nfs_stats_t *nfs)
+{
+    nfs_rpc_get(sigar, 0, &nfs->client);
+    nfs_rpc_get(sigar, 1, &nfs->server);
+
+    if (!(nfs->client.versions || nfs->server.versions)) {
+        return SIGAR_ENOTIMPL;
+    }
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int)
+sigar_nfs_mount_list_get(sigar_t *sigar,
+                         sigar_nfs_mount_list_t *mounts)
+{
+    return SIGAR_ENOTIMPL;
+}
+#endif
+
+#ifndef NFS_PROGRAM
+#define NFS_PROGRAM 100003
+#endif
+
+#ifndef NFS_VERSION
+#define NFS_VERSION 2
+#endif
+
+#define SIGAR_FS_PING_TIMEOUT 10000
+
+#ifndef WIN32
+/* "hostname:/mount" -> "hostname", NULL unless fs is nfs */
+static char *fs_ping_host(sigar_file_system_t *fs, char *host, size_t len)
+{
+    char *ptr;
+
+    if ((fs->type != SIGAR_FSTYPE_NETWORK) ||
+        !strEQ(fs->sys_type_name, "nfs") ||
+        !(ptr = strchr(fs->dev_name, ':')))
+    {
+        return NULL;
+    }
+
+    if ((size_t)(ptr - fs->dev_name) >= len) {
+        return NULL;
+    }
+    memcpy(host, fs->dev_name, ptr - fs->dev_name);
+    host[ptr - fs->dev_name] = '\0';
+
+    return host;
+}
+
+static void fs_ping_log(sigar_t *sigar, sigar_file_system_t *fs,
+                        char *host, int status)
+{
+    if (SIGAR_LOG_IS_DEBUG(sigar)) {
+        sigar_log_printf(sigar, SIGAR_LOG_DEBUG,
+                         "[fs_ping] %s -> %s: %s",
+                         fs->dir_name, host,
+                         ((status == SIGAR_OK) ?
+                          "OK" : sigar_rpc_strerror(status)));
+    }
+}
+#endif
+
+SIGAR_DECLARE(int)
+sigar_file_system_ping(sigar_t *sigar,
+                       sigar_file_system_t *fs)
+{
+    int status = SIGAR_OK;
+#ifndef WIN32
+    char name[SIGAR_FS_NAME_LEN], *host;
+
+    if ((host = fs_ping_host(fs, name, sizeof(name)))) {
+        int retval = sigar_rpc_ping_list(&host, 1,
+                                         SIGAR_NETCONN_UDP,
+                                         NFS_PROGRAM, NFS_VERSION,
+                                         SIGAR_FS_PING_TIMEOUT,
+                                         &status);
+        if (retval != SIGAR_OK) {
+            return retval;
+        }
+
+        fs_ping_log(sigar, fs, host, status);
+    }
+#endif
+    return status;
+}
+
+SIGAR_DECLARE(int)
+sigar_file_system_ping_list(sigar_t *sigar,
+                            sigar_file_system_list_t *fslist,
+                            int timeout,
+                            int *results)
+{
+#ifndef WIN32
+    char (*names)[SIGAR_FS_NAME_LEN];
+    char **hosts;
+    int *status, *index;
+    unsigned long i;
+    int num = 0, retval;
+
+    for (i=0; i<fslist->number; i++) {
+        results[i] = SIGAR_OK;
+    }
+    if (!fslist->number) {
+        return SIGAR_OK;
+    }
+
+    names = malloc(sizeof(*names) * fslist->number);
+    hosts = malloc(sizeof(*hosts) * fslist->number);
+    status = malloc(sizeof(*status) * fslist->number);
+    index = malloc(sizeof(*index) * fslist->number);
+
+    if (!names || !hosts || !status || !index) {
+        retval = ENOMEM;
+    }
+    else {
+        for (i=0; i<fslist->number; i++) {
+            if ((hosts[num] = fs_ping_host(&fslist->data[i],
+                                           names[num], sizeof(*names))))
+            {
+                index[num++] = (int)i;
+            }
+        }
+
+        retval = sigar_rpc_ping_list(hosts, num,
+                                     SIGAR_NETCONN_UDP,
+                                     NFS_PROGRAM, NFS_VERSION,
+                                     timeout, status);
+
+        if (retval == SIGAR_OK) {
+            int j;
+
+            for (j=0; j<num; j++) {
+                results[index[j]] = status[j];
+                fs_ping_log(sigar, &fslist->data[index[j]],
+                            hosts[j], status[j]);
+            }
+        }
+    }
+
+    free(names);
+    free(hosts);
+    free(status);
+    free(index);
+
+    return retval;
+#else
+    unsigned long i;
+
+    for (i=0; i<fslist->number; i++) {
+        results[i] = SIGAR_OK;
+    }
+
+    return SIGAR_OK;
+#endif
+}
+
+int sigar_cpu_info_list_create(sigar_cpu_info_list_t *cpu_infos)
+{
+    cpu_infos->number = 0;
+    cpu_infos->size = SIGAR_CPU_INFO_MAX;
+    cpu_infos->data = malloc(sizeof(*(cpu_infos->data)) *
+                             cpu_infos->size);
+    return SIGAR_OK;
+}
+
+int sigar_cpu_info_list_grow(sigar_cpu_info_list_t *cpu_infos)
+{
+    cpu_infos->data = realloc(cpu_infos->data,
+                              sizeof(*(cpu_infos->data)) *
+                              (cpu_infos->size + SIGAR_CPU_INFO_MAX));
+    cpu_infos->size += SIGAR_CPU_INFO_MAX;
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int)
+sigar_cpu_info_list_destroy(sigar_t *sigar,
+                            sigar_cpu_info_list_t *cpu_infos)
+{
+    if (cpu_infos->size) {
+        free(cpu_infos->data);
+        cpu_infos->number = cpu_infos->size = 0;
+    }
+
+    return SIGAR_OK;
+}
+
+int sigar_cpu_list_create(sigar_cpu_list_t *cpulist)
+{
+    cpulist->number = 0;
+    cpulist->size = SIGAR_CPU_INFO_MAX;
+    cpulist->data = malloc(sizeof(*(cpulist->data)) *
+                           cpulist->size);
+    return SIGAR_OK;
+}
+
+int sigar_cpu_list_grow(sigar_cpu_list_t *cpulist)
+{
+    cpulist->data = realloc(cpulist->data,
+                            sizeof(*(cpulist->data)) *
+                            (cpulist->size + SIGAR_CPU_INFO_MAX));
+    cpulist->size += SIGAR_CPU_INFO_MAX;
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int) sigar_cpu_list_destroy(sigar_t *sigar,
+                                          sigar_cpu_list_t *cpulist)
+{
+    if (cpulist->size) {
+        free(cpulist->data);
+        cpulist->number = cpulist->size = 0;
+    }
+
+    return SIGAR_OK;
+}
+
+int sigar_cgroup_list_create(sigar_cgroup_list_t *cgroups)
+{
+    cgroups->number = 0;
+    cgroups->size = SIGAR_CGROUP_LIST_MAX;
+    cgroups->data = malloc(sizeof(*(cgroups->data)) *
+                           cgroups->size);
+    return SIGAR_OK;
+}
+
+int sigar_cgroup_list_grow(sigar_cgroup_list_t *cgroups)
+{
+    cgroups->data = realloc(cgroups->data,
+                            sizeof(*(cgroups->data)) *
+                            (cgroups->size + SIGAR_CGROUP_LIST_MAX));
+    cgroups->size += SIGAR_CGROUP_LIST_MAX;
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int) sigar_cgroup_list_destroy(sigar_t *sigar,
+                                             sigar_cgroup_list_t *cgroups)
+{
+    unsigned long i;
+
+    if (cgroups->size) {
+        for (i=0; i<cgroups->number; i++) {
+            free(cgroups->data[i]);
+        }
+        free(cgroups->data);
+        cgroups->number = cgroups->size = 0;
+    }
+
+    return SIGAR_OK;
+}
+
+int sigar_netns_list_create(sigar_netns_list_t *netnslist)
+{
+    netnslist->number = 0;
+    netnslist->size = SIGAR_NETNS_LIST_MAX;
+    netnslist->data = malloc(sizeof(*(netnslist->data)) *
+                             netnslist->size);
+    return SIGAR_OK;
+}
+
+int sigar_netns_list_grow(sigar_netns_list_t *netnslist)
+{
+    netnslist->data = realloc(netnslist->data,
+                              sizeof(*(netnslist->data)) *
+                              (netnslist->size + SIGAR_NETNS_LIST_MAX));
+    netnslist->size += SIGAR_NETNS_LIST_MAX;
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int) sigar_netns_list_destroy(sigar_t *sigar,
+                                            sigar_netns_list_t *netnslist)
+{
+    if (netnslist->size) {
+        free(netnslist->data);
+        netnslist->number = netnslist->size = 0;
+    }
+
+    return SIGAR_OK;
+}
+
+#ifndef SIGAR_HAS_OS_PROC_ATTR
+SIGAR_DECLARE(int) sigar_proc_attr_cache_set(sigar_t *sigar,
+                                             sigar_uint64_t max_bytes)
+{
+    return SIGAR_ENOTIMPL;
+}
+#endif
+
+#ifndef SIGAR_HAS_OS_NETNS
+SIGAR_DECLARE(int) sigar_netns_list_get(sigar_t *sigar,
+                                        sigar_netns_list_t *netnslist)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+SIGAR_DECLARE(int)
+sigar_netns_net_interface_stat_list_get(sigar_t *sigar,
+                                        sigar_netns_t *netns,
+                                        sigar_net_interface_stat_list_t *iflist)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+SIGAR_DECLARE(int) sigar_netns_net_stat_get(sigar_t *sigar,
+                                            sigar_netns_t *netns,
+                                            sigar_net_stat_t *netstat,
+                                            int flags)
+{
+    return SIGAR_ENOTIMPL;
+}
+#endif
+
+#ifndef SIGAR_HAS_OS_CGROUP
+SIGAR_DECLARE(int) sigar_proc_cgroup_get(sigar_t *sigar, sigar_pid_t pid,
+                                         sigar_proc_cgroup_t *proccgroup)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+SIGAR_DECLARE(int) sigar_cgroup_list_get(sigar_t *sigar,
+                                         sigar_cgroup_list_t *cgroups)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+SIGAR_DECLARE(int) sigar_cgroup_stat_get(sigar_t *sigar, const char *path,
+                                         sigar_cgroup_stat_t *cgroupstat)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+SIGAR_DECLARE(int) sigar_cgroup_pressure_get(sigar_t *sigar,
+                                             const char *path,
+                                             sigar_pressure_t *pressure)
+{
+    return SIGAR_ENOTIMPL;
+}
+#endif
+
+#ifndef SIGAR_HAS_OS_INTERRUPTS
+SIGAR_DECLARE(int) sigar_interrupts_get(sigar_t *sigar,
+                                        sigar_interrupt_list_t *interrupts)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+SIGAR_DECLARE(int) sigar_softirqs_get(sigar_t *sigar,
+                                      sigar_interrupt_list_t *softirqs)
+{
+    return SIGAR_ENOTIMPL;
+}
+#endif
+
+#ifndef SIGAR_HAS_OS_PRESSURE
+SIGAR_DECLARE(int) sigar_pressure_get(sigar_t *sigar,
+                                      sigar_pressure_t *pressure)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+SIGAR_DECLARE(int) sigar_proc_sched_get(sigar_t *sigar, sigar_pid_t pid,
+                                        sigar_proc_sched_t *procsched)
+{
+    return SIGAR_ENOTIMPL;
+}
+#endif
+
+#ifndef SIGAR_HAS_OS_PROC_PERF
+SIGAR_DECLARE(int) sigar_proc_perf_open(sigar_t *sigar, sigar_pid_t pid)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+SIGAR_DECLARE(int) sigar_proc_perf_close(sigar_t *sigar, sigar_pid_t pid)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+SIGAR_DECLARE(int) sigar_proc_perf_get(sigar_t *sigar, sigar_pid_t pid,
+                                       sigar_proc_perf_t *procperf)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+SIGAR_DECLARE(int) sigar_proc_perf_cgroup_open(sigar_t *sigar,
+                                               const char *path)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+SIGAR_DECLARE(int) sigar_proc_perf_cgroup_close(sigar_t *sigar,
+                                                const char *path)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+SIGAR_DECLARE(int) sigar_proc_perf_cgroup_get(sigar_t *sigar,
+                                              const char *path,
+                                              sigar_proc_perf_t *procperf)
+{
+    return SIGAR_ENOTIMPL;
+}
+#endif
+
+#ifndef SIGAR_HAS_OS_PROC_FIELDS
+/* one native call fills every field, nothing to skip */
+SIGAR_DECLARE(int) sigar_proc_state_get_ex(sigar_t *sigar, sigar_pid_t pid,
+                                           int fields,
+                                           sigar_proc_state_t *procstate)
+{
+    return sigar_proc_state_get(sigar, pid, procstate);
+}
+
+SIGAR_DECLARE(int) sigar_proc_mem_get_ex(sigar_t *sigar, sigar_pid_t pid,
+                                         int fields,
+                                         sigar_proc_mem_t *procmem)
+{
+    return sigar_proc_mem_get(sigar, pid, procmem);
+}
+#endif
+
+#ifndef SIGAR_HAS_OS_PROC_MEM_EXT
+SIGAR_DECLARE(int) sigar_proc_mem_ext_get(sigar_t *sigar, sigar_pid_t pid,
+                                          sigar_proc_mem_ext_t *procmemext)
+{
+    return SIGAR_ENOTIMPL;
+}
+#endif
+
+#ifndef SIGAR_HAS_OS_PROC_NET_IO
+SIGAR_DECLARE(int) sigar_proc_net_io_get(sigar_t *sigar, sigar_pid_t pid,
+                                         sigar_proc_net_io_t *procnetio)
+{
+    return SIGAR_ENOTIMPL;
+}
+#endif
+
+#ifndef SIGAR_HAS_OS_MEM_EXT
+SIGAR_DECLARE(int) sigar_mem_ext_get(sigar_t *sigar, sigar_mem_ext_t *memext)
+{
+    sigar_uint64_t *field = (sigar_uint64_t *)memext;
+    sigar_mem_t mem;
+    sigar_swap_t swap;
+    int i, status;
+
+    if ((status = sigar_mem_get(sigar, &mem)) != SIGAR_OK) {
+        return status;
+    }
+
+    /* all members are sigar_uint64_t */
+    for (i=0; i<sizeof(*memext)/sizeof(*field); i++) {
+        field[i] = SIGAR_FIELD_NOTIMPL;
+    }
+
+    memext->total = mem.total;
+    memext->free = mem.free;
+    memext->available = mem.actual_free;
+
+    if (sigar_swap_get(sigar, &swap) == SIGAR_OK) {
+        memext->swap_total = swap.total;
+        memext->swap_free = swap.free;
+    }
+
+    return SIGAR_OK;
+}
+#endif
+
+#ifndef SIGAR_HAS_OS_SYSTEM_STAT
+SIGAR_DECLARE(int) sigar_system_stat_get(sigar_t *sigar,
+                                         sigar_system_stat_t *systemstat)
+{
+    int status;
+
+    if ((status = sigar_cpu_get(sigar, &systemstat->cpu)) != SIGAR_OK) {
+        return status;
+    }
+    if ((status = sigar_cpu_list_get(sigar, &systemstat->cpulist)) != SIGAR_OK) {
+        return status;
     }
 
+    systemstat->ctxt = SIGAR_FIELD_NOTIMPL;
+    systemstat->intr = SIGAR_FIELD_NOTIMPL;
+    systemstat->soft_irq = SIGAR_FIELD_NOTIMPL;
+    systemstat->processes = SIGAR_FIELD_NOTIMPL;
+    systemstat->procs_running = SIGAR_FIELD_NOTIMPL;
+    systemstat->procs_blocked = SIGAR_FIELD_NOTIMPL;
+    systemstat->boot_time = sigar->boot_time;
+
     return SIGAR_OK;
 }
-
-#ifndef NFS_PROGRAM
-#define NFS_PROGRAM 100003
-#endif
-
-#ifndef NFS_VERSION
-#define NFS_VERSION 2
 #endif
 
-SIGAR_DECLARE(int)
-sigar_file_system_ping(sigar_t *sigar,
-                       sigar_file_system_t *fs)
+SIGAR_DECLARE(int) sigar_system_stat_destroy(sigar_t *sigar,
+                                             sigar_system_stat_t *systemstat)
 {
-    int status = SIGAR_OK;
-#ifndef WIN32
-    char *ptr;
+    return sigar_cpu_list_destroy(sigar, &systemstat->cpulist);
+}
 
-    if ((fs->type == SIGAR_FSTYPE_NETWORK) &&
-        strEQ(fs->sys_type_name, "nfs") &&
-        (ptr = strchr(fs->dev_name, ':')))
-    {
-        *ptr = '\0'; /* "hostname:/mount" -> "hostname" */
+int sigar_interrupt_list_create(sigar_interrupt_list_t *interrupts,
+                                unsigned long ncpu)
+{
+    interrupts->number = 0;
+    interrupts->size = SIGAR_INTERRUPT_LIST_MAX;
+    interrupts->ncpu = ncpu;
+    interrupts->data = malloc(sizeof(*(interrupts->data)) *
+                              interrupts->size);
+    interrupts->cpus = malloc(sizeof(*(interrupts->cpus)) * (ncpu + 1));
+    interrupts->counts = malloc(sizeof(*(interrupts->counts)) *
+                                interrupts->size * (ncpu + 1));
+    return SIGAR_OK;
+}
 
-        status = sigar_rpc_ping(fs->dev_name,
-                                SIGAR_NETCONN_UDP,
-                                NFS_PROGRAM, NFS_VERSION);
+int sigar_interrupt_list_grow(sigar_interrupt_list_t *interrupts)
+{
+    interrupts->data = realloc(interrupts->data,
+                               sizeof(*(interrupts->data)) *
+                               (interrupts->size + SIGAR_INTERRUPT_LIST_MAX));
+    interrupts->size += SIGAR_INTERRUPT_LIST_MAX;
+    interrupts->counts = realloc(interrupts->counts,
+                                 sizeof(*(interrupts->counts)) *
+                                 interrupts->size * (interrupts->ncpu + 1));
 
-        if (SIGAR_LOG_IS_DEBUG(sigar)) {
-            sigar_log_printf(sigar, SIGAR_LOG_DEBUG,
-                             "[fs_ping] %s -> %s: %s",
-                             fs->dir_name, fs->dev_name,
-                             ((status == SIGAR_OK) ?
-                              "OK" : sigar_rpc_strerror(status)));
-        }
+    return SIGAR_OK;
+}
 
-        *ptr = ':'; /* "hostname" -> "hostname:/mount" */
+SIGAR_DECLARE(int)
+sigar_interrupt_list_destroy(sigar_t *sigar,
+                             sigar_interrupt_list_t *interrupts)
+{
+    if (interrupts->size) {
+        free(interrupts->data);
+        free(interrupts->cpus);
+        free(interrupts->counts);
+        interrupts->number = interrupts->size = interrupts->ncpu = 0;
     }
-#endif
-    return status;
+
+    return SIGAR_OK;
 }
 
-int sigar_cpu_info_list_create(sigar_cpu_info_list_t *cpu_infos)
+int sigar_numa_topology_create(sigar_numa_topology_t *topology)
 {
-    cpu_infos->number = 0;
-    cpu_infos->size = SIGAR_CPU_INFO_MAX;
-    cpu_infos->data = malloc(sizeof(*(cpu_infos->data)) *
-                             cpu_infos->size);
+    topology->number = 0;
+    topology->size = SIGAR_NUMA_TOPOLOGY_MAX;
+    topology->data = malloc(sizeof(*(topology->data)) *
+                            topology->size);
     return SIGAR_OK;
 }
 
-int sigar_cpu_info_list_grow(sigar_cpu_info_list_t *cpu_infos)
+int sigar_numa_topology_grow(sigar_numa_topology_t *topology)
 {
-    cpu_infos->data = realloc(cpu_infos->data,
-                              sizeof(*(cpu_infos->data)) *
-                              (cpu_infos->size + SIGAR_CPU_INFO_MAX));
-    cpu_infos->size += SIGAR_CPU_INFO_MAX;
+    topology->data = realloc(topology->data,
+                             sizeof(*(topology->data)) *
+                             (topology->size + SIGAR_NUMA_TOPOLOGY_MAX));
+    topology->size += SIGAR_NUMA_TOPOLOGY_MAX;
 
     return SIGAR_OK;
 }
 
 SIGAR_DECLARE(int)
-sigar_cpu_info_list_destroy(sigar_t *sigar,
-                            sigar_cpu_info_list_t *cpu_infos)
+sigar_numa_topology_destroy(sigar_t *sigar,
+                            sigar_numa_topology_t *topology)
 {
-    if (cpu_infos->size) {
-        free(cpu_infos->data);
-        cpu_infos->number = cpu_infos->size = 0;
+    if (topology->size) {
+        free(topology->data);
+        topology->number = topology->size = 0;
     }
 
     return SIGAR_OK;
 }
 
-int sigar_cpu_list_create(sigar_cpu_list_t *cpulist)
+int sigar_numa_mem_list_create(sigar_numa_mem_list_t *memlist)
 {
-    cpulist->number = 0;
-    cpulist->size = SIGAR_CPU_INFO_MAX;
-    cpulist->data = malloc(sizeof(*(cpulist->data)) *
-                           cpulist->size);
+    memlist->number = 0;
+    memlist->size = SIGAR_NUMA_MEM_LIST_MAX;
+    memlist->data = malloc(sizeof(*(memlist->data)) *
+                           memlist->size);
     return SIGAR_OK;
 }
 
-int sigar_cpu_list_grow(sigar_cpu_list_t *cpulist)
+int sigar_numa_mem_list_grow(sigar_numa_mem_list_t *memlist)
 {
-    cpulist->data = realloc(cpulist->data,
-                            sizeof(*(cpulist->data)) *
-                            (cpulist->size + SIGAR_CPU_INFO_MAX));
-    cpulist->size += SIGAR_CPU_INFO_MAX;
+    memlist->data = realloc(memlist->data,
+                            sizeof(*(memlist->data)) *
+                            (memlist->size + SIGAR_NUMA_MEM_LIST_MAX));
+    memlist->size += SIGAR_NUMA_MEM_LIST_MAX;
 
     return SIGAR_OK;
 }
 
-SIGAR_DECLARE(int) sigar_cpu_list_destroy(sigar_t *sigar,
-                                          sigar_cpu_list_t *cpulist)
+SIGAR_DECLARE(int)
+sigar_numa_mem_list_destroy(sigar_t *sigar,
+                            sigar_numa_mem_list_t *memlist)
 {
-    if (cpulist->size) {
-        free(cpulist->data);
-        cpulist->number = cpulist->size = 0;
+    if (memlist->size) {
+        free(memlist->data);
+        memlist->number = memlist->size = 0;
     }
 
     return SIGAR_OK;
 }
 
+#ifndef SIGAR_HAS_OS_NUMA
+SIGAR_DECLARE(int)
+sigar_numa_topology_get(sigar_t *sigar,
+                        sigar_numa_topology_t *topology)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+SIGAR_DECLARE(int)
+sigar_numa_mem_list_get(sigar_t *sigar,
+                        sigar_numa_mem_list_t *memlist)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+SIGAR_DECLARE(int)
+sigar_numa_cpu_list_get(sigar_t *sigar,
+                        sigar_cpu_list_t *cpulist)
+{
+    return SIGAR_ENOTIMPL;
+}
+#endif
+
 int sigar_net_route_list_create(sigar_net_route_list_t *routelist)
 {
     routelist->number = 0;
@@ -778,6 +2707,186 @@ sigar_net_interface_list_destroy(sigar_t *sigar,
     return SIGAR_OK;
 }
 
+int sigar_disk_usage_list_create(sigar_disk_usage_list_t *disklist)
+{
+    disklist->number = 0;
+    disklist->size = SIGAR_FS_MAX;
+    disklist->data = malloc(sizeof(*(disklist->data)) *
+                            disklist->size);
+    return SIGAR_OK;
+}
+
+int sigar_disk_usage_list_grow(sigar_disk_usage_list_t *disklist)
+{
+    disklist->data = realloc(disklist->data,
+                             sizeof(*(disklist->data)) *
+                             (disklist->size + SIGAR_FS_MAX));
+    disklist->size += SIGAR_FS_MAX;
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int)
+sigar_disk_usage_list_destroy(sigar_t *sigar,
+                              sigar_disk_usage_list_t *disklist)
+{
+    if (disklist->size) {
+        free(disklist->data);
+        disklist->number = disklist->size = 0;
+    }
+
+    return SIGAR_OK;
+}
+
+#if !defined(__linux__) && !defined(WIN32) /* /proc/diskstats, perflib */
+SIGAR_DECLARE(int)
+sigar_disk_usage_list_get(sigar_t *sigar,
+                          sigar_disk_usage_list_t *disklist)
+{
+    if (sigar->replay) {
+        return sigar_replay_disk_usage_list_get(sigar, disklist);
+    }
+
+    return SIGAR_ENOTIMPL;
+}
+#endif
+
+int sigar_net_interface_stat_list_create(sigar_net_interface_stat_list_t *iflist)
+{
+    iflist->number = 0;
+    iflist->size = SIGAR_NET_IFLIST_MAX;
+    iflist->data = malloc(sizeof(*(iflist->data)) *
+                          iflist->size);
+    return SIGAR_OK;
+}
+
+int sigar_net_interface_stat_list_grow(sigar_net_interface_stat_list_t *iflist)
+{
+    iflist->data = realloc(iflist->data,
+                           sizeof(*(iflist->data)) *
+                           (iflist->size + SIGAR_NET_IFLIST_MAX));
+    iflist->size += SIGAR_NET_IFLIST_MAX;
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int)
+sigar_net_interface_stat_list_destroy(sigar_t *sigar,
+                                      sigar_net_interface_stat_list_t *iflist)
+{
+    if (iflist->size) {
+        free(iflist->data);
+        iflist->number = iflist->size = 0;
+    }
+
+    return SIGAR_OK;
+}
+
+int sigar_net_interface_config_list_create(sigar_net_interface_config_list_t *iflist)
+{
+    iflist->number = 0;
+    iflist->size = SIGAR_NET_IFLIST_MAX;
+    iflist->data = malloc(sizeof(*(iflist->data)) *
+                          iflist->size);
+    return SIGAR_OK;
+}
+
+int sigar_net_interface_config_list_grow(sigar_net_interface_config_list_t *iflist)
+{
+    iflist->data = realloc(iflist->data,
+                           sizeof(*(iflist->data)) *
+                           (iflist->size + SIGAR_NET_IFLIST_MAX));
+    iflist->size += SIGAR_NET_IFLIST_MAX;
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int)
+sigar_net_interface_config_list_destroy(sigar_t *sigar,
+                                        sigar_net_interface_config_list_t *iflist)
+{
+    if (iflist->size) {
+        free(iflist->data);
+        iflist->number = iflist->size = 0;
+    }
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int)
+sigar_net_interface_config_list_get(sigar_t *sigar,
+                                    sigar_net_interface_config_list_t *iflist)
+{
+    sigar_net_interface_list_t names;
+    unsigned long i;
+    int status;
+
+#ifdef SIGAR_HAS_OS_NET_IFCONFIG_LIST
+    status = sigar_os_net_interface_config_list_get(sigar, iflist);
+    if (status != SIGAR_ENOTIMPL) {
+        return status;
+    }
+#endif
+
+    if ((status = sigar_net_interface_list_get(sigar, &names)) != SIGAR_OK) {
+        return status;
+    }
+
+    sigar_net_interface_config_list_create(iflist);
+
+    for (i=0; i<names.number; i++) {
+        SIGAR_NET_IFCONFIG_LIST_GROW(iflist);
+
+        if (sigar_net_interface_config_get(sigar, names.data[i],
+                                           &iflist->data[iflist->number]) !=
+            SIGAR_OK)
+        {
+            continue; /* e.g. went away since the list was read */
+        }
+        iflist->number++;
+    }
+
+    sigar_net_interface_list_destroy(sigar, &names);
+
+    return SIGAR_OK;
+}
+
+#ifndef __linux__ /* linux reads /proc/net/dev once for all of them */
+SIGAR_DECLARE(int)
+sigar_net_interface_stat_list_get(sigar_t *sigar,
+                                  sigar_net_interface_stat_list_t *iflist)
+{
+    sigar_net_interface_list_t names;
+    unsigned long i;
+    int status;
+
+    if ((status = sigar_net_interface_list_get(sigar, &names)) != SIGAR_OK) {
+        return status;
+    }
+
+    sigar_net_interface_stat_list_create(iflist);
+
+    for (i=0; i<names.number; i++) {
+        sigar_net_interface_stat_entry_t *entry;
+
+        SIGAR_NET_IFSTAT_LIST_GROW(iflist);
+        entry = &iflist->data[iflist->number];
+
+        if (sigar_net_interface_stat_get(sigar, names.data[i],
+                                         &entry->stat) != SIGAR_OK)
+        {
+            continue; /* e.g. went away since the list was read */
+        }
+        SIGAR_SSTRCPY(entry->name, names.data[i]);
+        iflist->number++;
+    }
+
+    sigar_net_interface_list_destroy(sigar, &names);
+
+    return SIGAR_OK;
+}
+#endif
+
 int sigar_net_connection_list_create(sigar_net_connection_list_t *connlist)
 {
     connlist->number = 0;
@@ -836,7 +2945,11 @@ sigar_net_connection_list_get(sigar_t *sigar,
     int status;
     sigar_net_connection_walker_t walker;
 
-    sigar_net_connection_list_create(connlist);
+    if (sigar->replay) {
+        return sigar_replay_net_connection_list_get(sigar, connlist, flags);
+    }
+
+    SIGAR_LIST_CREATE(sigar, connlist, sigar_net_connection_list_create);
 
     walker.sigar = sigar;
     walker.flags = flags;
@@ -853,8 +2966,8 @@ sigar_net_connection_list_get(sigar_t *sigar,
 }
 #endif
 
-static void sigar_net_listen_address_add(sigar_t *sigar,
-                                         sigar_net_connection_t *conn)
+void sigar_net_listen_address_add(sigar_t *sigar,
+                                  sigar_net_connection_t *conn)
 {
     sigar_cache_entry_t *entry =
         sigar_cache_get(sigar->net_listen, conn->local_port);
@@ -872,32 +2985,120 @@ static void sigar_net_listen_address_add(sigar_t *sigar,
            sizeof(conn->local_address));
 }
 
+/* a new table once the last is too old, ports no longer listening go */
+static int net_listen_refresh(sigar_t *sigar)
+{
+    sigar_uint64_t timenow = sigar_time_now_millis();
+    sigar_net_stat_t netstat;
+    int status;
+
+    if (sigar->net_listen && sigar->net_listen_time &&
+        (timenow < sigar->net_listen_time + sigar->net_listen_expire))
+    {
+        return SIGAR_OK;
+    }
+
+    if (sigar->net_listen) {
+        sigar_cache_destroy(sigar->net_listen);
+        sigar->net_listen = NULL;
+    }
+    sigar->net_listen_time = 0;
+
+    status = sigar_net_stat_get(sigar, &netstat,
+                                SIGAR_NETCONN_SERVER|SIGAR_NETCONN_TCP);
+
+    if (status == SIGAR_OK) {
+        sigar->net_listen_time = timenow;
+    }
+
+    return status;
+}
+
 SIGAR_DECLARE(int)
 sigar_net_listen_address_get(sigar_t *sigar,
                              unsigned long port,
                              sigar_net_address_t *address)
 {
-    if (!sigar->net_listen ||
-        !sigar_cache_find(sigar->net_listen, port))
-    {
-        sigar_net_stat_t netstat;
-        int status =
-            sigar_net_stat_get(sigar, &netstat,
-                               SIGAR_NETCONN_SERVER|SIGAR_NETCONN_TCP);
+    sigar_cache_entry_t *entry;
+    int status;
 
-        if (status != SIGAR_OK) {
-            return status;
-        }
+    if ((status = net_listen_refresh(sigar)) != SIGAR_OK) {
+        return status;
     }
 
-    if (sigar_cache_find(sigar->net_listen, port)) {
-        void *value = sigar_cache_get(sigar->net_listen, port)->value;
-        memcpy(address, value, sizeof(*address));
-        return SIGAR_OK;
-    }
-    else {
-        return ENOENT;
+    entry = sigar_cache_find(sigar->net_listen, port);
+    if (!(entry && entry->value)) {
+        return ENOENT;
+    }
+
+    memcpy(address, entry->value, sizeof(*address));
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int) sigar_net_listen_expire_set(sigar_t *sigar,
+                                               sigar_uint64_t millis)
+{
+    sigar->net_listen_expire = millis;
+    return SIGAR_OK;
+}
+
+static void net_listen_list_add(sigar_cache_entry_t *entry, void *data)
+{
+    sigar_net_listen_list_t *listens = data;
+    sigar_net_listen_t *listen;
+
+    if (!entry->value || (listens->number >= listens->size)) {
+        return;
+    }
+
+    listen = &listens->data[listens->number++];
+    listen->port = (unsigned long)entry->id;
+    memcpy(&listen->address, entry->value, sizeof(listen->address));
+}
+
+static int net_listen_compare(const void *a, const void *b)
+{
+    unsigned long pa = ((const sigar_net_listen_t *)a)->port;
+    unsigned long pb = ((const sigar_net_listen_t *)b)->port;
+
+    return (pa < pb) ? -1 : (pa > pb);
+}
+
+SIGAR_DECLARE(int) sigar_net_listen_list_get(sigar_t *sigar,
+                                             sigar_net_listen_list_t *listens)
+{
+    int status;
+
+    if ((status = net_listen_refresh(sigar)) != SIGAR_OK) {
+        return status;
+    }
+
+    listens->number = 0;
+    listens->size = sigar->net_listen->count ? sigar->net_listen->count : 1;
+    listens->data = malloc(sizeof(*listens->data) * listens->size);
+    if (!listens->data) {
+        listens->size = 0;
+        return ENOMEM;
+    }
+
+    sigar_cache_walk(sigar->net_listen, net_listen_list_add, listens);
+    qsort(listens->data, listens->number, sizeof(*listens->data),
+          net_listen_compare);
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int)
+sigar_net_listen_list_destroy(sigar_t *sigar,
+                              sigar_net_listen_list_t *listens)
+{
+    if (listens->size) {
+        free(listens->data);
+        listens->number = listens->size = 0;
     }
+
+    return SIGAR_OK;
 }
 
 typedef struct {
@@ -944,6 +3145,12 @@ static int net_stat_walker(sigar_net_connection_walker_t *walker,
     return SIGAR_OK;
 }
 
+SIGAR_DECLARE(int) sigar_net_stat_walk_set(sigar_t *sigar, int enable)
+{
+    sigar->net_stat_walk = enable;
+    return SIGAR_OK;
+}
+
 SIGAR_DECLARE(int)
 sigar_net_stat_get(sigar_t *sigar,
                    sigar_net_stat_t *netstat,
@@ -955,7 +3162,16 @@ sigar_net_stat_get(sigar_t *sigar,
     if (!sigar->net_listen) {
         sigar->net_listen = sigar_cache_new(32);
     }
-    
+
+#ifdef SIGAR_HAS_OS_NET_STAT
+    if (!sigar->net_stat_walk) {
+        SIGAR_ZERO(netstat);
+        if (sigar_os_net_stat_get(sigar, netstat, flags) == SIGAR_OK) {
+            return SIGAR_OK;
+        }
+    }
+#endif
+
     SIGAR_ZERO(netstat);
 
     getter.netstat = netstat;
@@ -1045,7 +3261,199 @@ sigar_net_stat_port_get(sigar_t *sigar,
                          name, port);
     }
 
+#ifdef SIGAR_HAS_NET_CONNECTION_PORT_WALK
+    return sigar_net_connection_port_walk(&walker, port, 1);
+#else
     return sigar_net_connection_walk(&walker);
+#endif
+}
+
+#define NET_AGGREGATE_MAX 64
+
+/* keys of remote addresses whose hashes collide step by this */
+#define NET_AGGREGATE_PROBE ((sigar_uint64_t)1 << 40)
+
+typedef struct {
+    sigar_net_connection_aggregate_t *aggregate;
+    sigar_cache_t *index; /* group key to index + 1 */
+    int group_by;
+    int status;
+} net_aggregate_getter_t;
+
+static void net_aggregate_index_free(void *ptr)
+{
+}
+
+static int net_aggregate_key(sigar_t *sigar,
+                             net_aggregate_getter_t *getter,
+                             sigar_net_connection_t *conn,
+                             sigar_net_connection_group_t *group,
+                             sigar_uint64_t *key)
+{
+    SIGAR_ZERO(group);
+
+    switch (getter->group_by) {
+      case SIGAR_NETCONN_GROUP_REMOTE_ADDRESS:
+        memcpy(&group->remote_address, &conn->remote_address,
+               sizeof(group->remote_address));
+        *key = ((sigar_uint64_t)conn->remote_address.family << 32) |
+            sigar_net_address_hash(&conn->remote_address);
+        break;
+      case SIGAR_NETCONN_GROUP_LOCAL_PORT:
+        *key = group->local_port = conn->local_port;
+        break;
+      case SIGAR_NETCONN_GROUP_STATE:
+        *key = group->state = conn->state;
+        break;
+      case SIGAR_NETCONN_GROUP_UID:
+        *key = group->uid = conn->uid;
+        break;
+#ifdef SIGAR_HAS_OS_NET_CONNECTION_PID
+      case SIGAR_NETCONN_GROUP_PID:
+        {
+            int status = sigar_os_net_connection_pid_get(sigar, conn,
+                                                         &group->pid);
+            if (status != SIGAR_OK) {
+                return status;
+            }
+        }
+        *key = group->pid;
+        break;
+#endif
+      default:
+        return SIGAR_ENOTIMPL;
+    }
+
+    return SIGAR_OK;
+}
+
+static int net_aggregate_walker(sigar_net_connection_walker_t *walker,
+                                sigar_net_connection_t *conn)
+{
+    net_aggregate_getter_t *getter =
+        (net_aggregate_getter_t *)walker->data;
+    sigar_net_connection_aggregate_t *aggregate = getter->aggregate;
+    sigar_net_connection_group_t key_group, *group;
+    sigar_cache_entry_t *entry;
+    sigar_uint64_t key;
+    int status;
+
+    status = net_aggregate_key(walker->sigar, getter, conn,
+                               &key_group, &key);
+    if (status != SIGAR_OK) {
+        getter->status = status;
+        return !SIGAR_OK; /* break loop */
+    }
+
+    for (;;) {
+        entry = sigar_cache_get(getter->index, key);
+        if (!entry->value) {
+            break;
+        }
+        group = &aggregate->data[(unsigned long)entry->value - 1];
+        if ((getter->group_by != SIGAR_NETCONN_GROUP_REMOTE_ADDRESS) ||
+            (sigar_net_address_equals(&group->remote_address,
+                                      &key_group.remote_address) ==
+             SIGAR_OK))
+        {
+            break;
+        }
+        key += NET_AGGREGATE_PROBE;
+    }
+
+    if (!entry->value) {
+        if (aggregate->number >= aggregate->size) {
+            group = realloc(aggregate->data, sizeof(*group) *
+                            (aggregate->size + NET_AGGREGATE_MAX));
+            if (!group) {
+                getter->status = ENOMEM;
+                return !SIGAR_OK;
+            }
+            aggregate->data = group;
+            aggregate->size += NET_AGGREGATE_MAX;
+        }
+        group = &aggregate->data[aggregate->number++];
+        memcpy(group, &key_group, sizeof(*group));
+        entry->value = (void *)aggregate->number;
+    }
+    else {
+        group = &aggregate->data[(unsigned long)entry->value - 1];
+    }
+
+    group->count++;
+    group->send_queue += conn->send_queue;
+    group->receive_queue += conn->receive_queue;
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int)
+sigar_net_connection_aggregate_get(sigar_t *sigar,
+                                   int flags,
+                                   int group_by,
+                                   sigar_net_connection_aggregate_t *aggregate)
+{
+    sigar_net_connection_walker_t walker;
+    net_aggregate_getter_t getter;
+    int status;
+
+    aggregate->number = 0;
+    aggregate->size = NET_AGGREGATE_MAX;
+    aggregate->data = malloc(sizeof(*aggregate->data) * aggregate->size);
+    if (!aggregate->data) {
+        aggregate->size = 0;
+        return ENOMEM;
+    }
+
+    getter.aggregate = aggregate;
+    getter.group_by = group_by;
+    getter.status = SIGAR_OK;
+    getter.index = sigar_cache_create(NET_AGGREGATE_MAX,
+                                      SIGAR_CACHE_OPEN_ADDRESSING,
+                                      SIGAR_FIELD_NOTIMPL,
+                                      SIGAR_FIELD_NOTIMPL);
+    getter.index->free_value = net_aggregate_index_free;
+
+    walker.sigar = sigar;
+    walker.flags = flags;
+    walker.data = &getter;
+    walker.add_connection = net_aggregate_walker;
+
+#ifdef SIGAR_HAS_OS_NET_CONNECTION_PID
+    /* once per call, not once per socket the index has not seen */
+    if ((group_by == SIGAR_NETCONN_GROUP_PID) &&
+        ((status = sigar_os_net_connection_pid_refresh(sigar)) != SIGAR_OK))
+    {
+        sigar_cache_destroy(getter.index);
+        sigar_net_connection_aggregate_destroy(sigar, aggregate);
+        return status;
+    }
+#endif
+
+    status = sigar_net_connection_walk(&walker);
+    if (status == SIGAR_OK) {
+        status = getter.status;
+    }
+
+    sigar_cache_destroy(getter.index);
+
+    if (status != SIGAR_OK) {
+        sigar_net_connection_aggregate_destroy(sigar, aggregate);
+    }
+
+    return status;
+}
+
+SIGAR_DECLARE(int)
+sigar_net_connection_aggregate_destroy(sigar_t *sigar,
+                                       sigar_net_connection_aggregate_t *aggregate)
+{
+    if (aggregate->size) {
+        free(aggregate->data);
+        aggregate->number = aggregate->size = 0;
+    }
+
+    return SIGAR_OK;
 }
 
 static int tcp_curr_estab_count(sigar_net_connection_walker_t *walker,
@@ -1065,6 +3473,21 @@ int sigar_tcp_curr_estab(sigar_t *sigar, sigar_tcp_t *tcp)
 {
     sigar_net_connection_walker_t walker;
 
+#ifdef SIGAR_HAS_OS_NET_STAT
+    sigar_net_stat_t netstat;
+
+    if (!sigar->net_stat_walk &&
+        (sigar_os_net_stat_get(sigar, &netstat,
+                               SIGAR_NETCONN_CLIENT|
+                               SIGAR_NETCONN_TCP) == SIGAR_OK))
+    {
+        tcp->curr_estab =
+            netstat.tcp_states[SIGAR_TCP_ESTABLISHED] +
+            netstat.tcp_states[SIGAR_TCP_CLOSE_WAIT];
+        return SIGAR_OK;
+    }
+#endif
+
     walker.sigar = sigar;
     walker.data = tcp;
     walker.add_connection = tcp_curr_estab_count;
@@ -1135,6 +3558,53 @@ SIGAR_DECLARE(int) sigar_who_list_destroy(sigar_t *sigar,
     return SIGAR_OK;
 }
 
+/*
+ * the utmp file is only parsed again once its stat changes, or with
+ * sigar_who_list_watch_set once the kernel says it was written to.
+ * a file changed within WHO_UTMP_RACY seconds of the read may change
+ * again with the same mtime and size, such a read is not reused.
+ */
+
+#if defined(HAVE_UTMPX_H)
+#  if defined(UTMPX_FILE)
+#    define WHO_UTMP_FILE UTMPX_FILE
+#  elif defined(_PATH_UTMPX)
+#    define WHO_UTMP_FILE _PATH_UTMPX
+#  elif defined(_PATH_UTMP)
+#    define WHO_UTMP_FILE _PATH_UTMP
+#  endif
+#elif defined(HAVE_UTMP_H) && defined(_PATH_UTMP)
+#  define WHO_UTMP_FILE _PATH_UTMP
+#endif
+
+#define WHO_UTMP_RACY 1
+
+struct sigar_who_cache_t {
+    sigar_who_list_t list;
+    int valid;
+    sigar_uint64_t dev;
+    sigar_uint64_t ino;
+    sigar_uint64_t size;
+    sigar_uint64_t mtime;
+    sigar_file_watch_t *watch;
+};
+
+void sigar_who_cache_free(sigar_t *sigar)
+{
+    sigar_who_cache_t *cache = sigar->who_cache;
+
+    if (!cache) {
+        return;
+    }
+
+    if (cache->watch) {
+        sigar_file_watch_destroy(cache->watch);
+    }
+    sigar_who_list_destroy(sigar, &cache->list);
+    free(cache);
+    sigar->who_cache = NULL;
+}
+
 #if defined(NETWARE)
 static char *getpass(const char *prompt)
 {
@@ -1237,6 +3707,11 @@ SIGAR_DECLARE(int) sigar_who_list_get(sigar_t *sigar,
     return SIGAR_OK;
 }
 
+SIGAR_DECLARE(int) sigar_who_list_watch_set(sigar_t *sigar, int watch)
+{
+    return SIGAR_ENOTIMPL;
+}
+
 SIGAR_DECLARE(int) sigar_resource_limit_get(sigar_t *sigar,
                                             sigar_resource_limit_t *rlimit)
 {
@@ -1269,9 +3744,168 @@ int sigar_who_list_get(sigar_t *sigar,
 {
     return SIGAR_ENOTIMPL;
 }
+
+SIGAR_DECLARE(int) sigar_who_list_watch_set(sigar_t *sigar, int watch)
+{
+    return SIGAR_ENOTIMPL;
+}
 #else
 
 #ifndef _AIX
+#ifdef WHO_UTMP_FILE
+static SIGAR_INLINE sigar_uint64_t who_utmp_mtime(struct stat *st)
+{
+#ifdef __linux__
+    return ((sigar_uint64_t)st->st_mtim.tv_sec * 1000000000) +
+        st->st_mtim.tv_nsec;
+#else
+    return st->st_mtime;
+#endif
+}
+
+static int who_cache_get(sigar_t *sigar, sigar_who_cache_t **cachep)
+{
+    if (!sigar->who_cache) {
+        sigar->who_cache = calloc(1, sizeof(*sigar->who_cache));
+        if (!sigar->who_cache) {
+            return ENOMEM;
+        }
+    }
+
+    *cachep = sigar->who_cache;
+
+    return SIGAR_OK;
+}
+
+/* anything from the watch, an overflow or a failed wait included,
+ * means the cached list can no longer be trusted */
+static int who_cache_changed(sigar_who_cache_t *cache)
+{
+    sigar_file_watch_event_list_t events;
+    int changed;
+
+    if (sigar_file_watch_wait(cache->watch, 0, &events) != SIGAR_OK) {
+        sigar_file_watch_destroy(cache->watch);
+        cache->watch = NULL;
+        return 1;
+    }
+
+    changed = events.number != 0;
+    sigar_file_watch_event_list_destroy(&events);
+
+    return changed;
+}
+
+static int who_list_copy(sigar_who_list_t *dest, sigar_who_list_t *src)
+{
+    dest->number = src->number;
+    dest->size = src->number > SIGAR_WHO_LIST_MAX ?
+        src->number : SIGAR_WHO_LIST_MAX;
+    dest->data = malloc(sizeof(*(dest->data)) * dest->size);
+    if (!dest->data) {
+        dest->number = dest->size = 0;
+        return ENOMEM;
+    }
+
+    memcpy(dest->data, src->data, sizeof(*(src->data)) * src->number);
+
+    return SIGAR_OK;
+}
+
+int sigar_who_list_get(sigar_t *sigar,
+                       sigar_who_list_t *wholist)
+{
+    sigar_who_cache_t *cache;
+    struct stat st;
+    int status, have_stat;
+
+    if ((status = who_cache_get(sigar, &cache)) != SIGAR_OK) {
+        return status;
+    }
+
+    if (cache->watch) {
+        if (who_cache_changed(cache)) {
+            cache->valid = 0;
+        }
+        else if (cache->valid) {
+            return who_list_copy(wholist, &cache->list);
+        }
+    }
+
+    /* taken before the read so a write during it is seen next time */
+    have_stat = stat(WHO_UTMP_FILE, &st) == 0;
+
+    if (cache->valid && have_stat &&
+        (cache->dev == (sigar_uint64_t)st.st_dev) &&
+        (cache->ino == (sigar_uint64_t)st.st_ino) &&
+        (cache->size == (sigar_uint64_t)st.st_size) &&
+        (cache->mtime == who_utmp_mtime(&st)))
+    {
+        return who_list_copy(wholist, &cache->list);
+    }
+
+    cache->valid = 0;
+    sigar_who_list_destroy(sigar, &cache->list);
+    sigar_who_list_create(&cache->list);
+
+    status = sigar_who_utmp(sigar, &cache->list);
+    if (status != SIGAR_OK) {
+        sigar_who_list_destroy(sigar, &cache->list);
+        return status;
+    }
+
+    if (have_stat) {
+        cache->dev = st.st_dev;
+        cache->ino = st.st_ino;
+        cache->size = st.st_size;
+        cache->mtime = who_utmp_mtime(&st);
+        cache->valid = cache->watch ||
+            ((time(NULL) - st.st_mtime) >= WHO_UTMP_RACY);
+    }
+
+    return who_list_copy(wholist, &cache->list);
+}
+
+SIGAR_DECLARE(int) sigar_who_list_watch_set(sigar_t *sigar, int watch)
+{
+    sigar_who_cache_t *cache;
+    int status, id;
+
+    if ((status = who_cache_get(sigar, &cache)) != SIGAR_OK) {
+        return status;
+    }
+
+    if (!watch) {
+        if (cache->watch) {
+            sigar_file_watch_destroy(cache->watch);
+            cache->watch = NULL;
+        }
+        return SIGAR_OK;
+    }
+
+    if (cache->watch) {
+        return SIGAR_OK;
+    }
+
+    if ((status = sigar_file_watch_create(&cache->watch)) != SIGAR_OK) {
+        cache->watch = NULL;
+        return status;
+    }
+
+    if ((status = sigar_file_watch_add(cache->watch, WHO_UTMP_FILE, &id)) !=
+        SIGAR_OK)
+    {
+        sigar_file_watch_destroy(cache->watch);
+        cache->watch = NULL;
+        return status;
+    }
+
+    /* whatever was read before the watch existed may be stale already */
+    cache->valid = 0;
+
+    return SIGAR_OK;
+}
+#else
 int sigar_who_list_get(sigar_t *sigar,
                        sigar_who_list_t *wholist)
 {
@@ -1287,7 +3921,18 @@ int sigar_who_list_get(sigar_t *sigar,
 
     return SIGAR_OK;
 }
-#endif
+
+SIGAR_DECLARE(int) sigar_who_list_watch_set(sigar_t *sigar, int watch)
+{
+    return SIGAR_ENOTIMPL;
+}
+#endif /* WHO_UTMP_FILE */
+#else
+SIGAR_DECLARE(int) sigar_who_list_watch_set(sigar_t *sigar, int watch)
+{
+    return SIGAR_ENOTIMPL;
+}
+#endif /* _AIX */
 
 static int sigar_get_default_gateway(sigar_t *sigar,
                                      sigar_net_info_t *netinfo)
@@ -1302,6 +3947,7 @@ static int sigar_get_default_gateway(sigar_t *sigar,
 
     for (i=0; i<routelist.number; i++) {
         if ((routelist.data[i].flags & SIGAR_RTF_GATEWAY) &&
+            (routelist.data[i].destination.family == SIGAR_AF_INET) &&
             (routelist.data[i].destination.addr.in == 0))
         {
             sigar_net_address_to_string(sigar,
@@ -1320,8 +3966,8 @@ static int sigar_get_default_gateway(sigar_t *sigar,
     return SIGAR_OK;
 }
 
-int sigar_net_info_get(sigar_t *sigar,
-                       sigar_net_info_t *netinfo)
+int sigar_os_net_info_get(sigar_t *sigar,
+                          sigar_net_info_t *netinfo)
 {
     int size;
     char buffer[BUFSIZ], *ptr;
@@ -1555,8 +4201,8 @@ static void hwaddr_arp_lookup(sigar_net_interface_config_t *ifconfig, int sock)
 #define ARPHRD_CISCO 513 /* Cisco HDLC. */
 #endif
 
-static void get_interface_type(sigar_net_interface_config_t *ifconfig,
-                               int family)
+void sigar_net_interface_type_set(sigar_net_interface_config_t *ifconfig,
+                                  int family)
 {
     char *type;
 
@@ -1640,6 +4286,40 @@ static void get_interface_type(sigar_net_interface_config_t *ifconfig,
 
 #endif
 
+sigar_uint64_t sigar_net_interface_flags_get(sigar_uint64_t flags)
+{
+#ifdef __linux__
+# ifndef IFF_DYNAMIC
+#  define IFF_DYNAMIC 0x8000 /* not in 2.2 kernel */
+# endif /* IFF_DYNAMIC */
+    int is_mcast = flags & IFF_MULTICAST;
+    int is_slave = flags & IFF_SLAVE;
+    int is_master = flags & IFF_MASTER;
+    int is_dynamic = flags & IFF_DYNAMIC;
+    /*
+     * XXX: should just define SIGAR_IFF_*
+     * and test IFF_* bits on given platform.
+     * this is the only diff between solaris/hpux/linux
+     * for the flags we care about.
+     *
+     */
+    flags &= ~(IFF_MULTICAST|IFF_SLAVE|IFF_MASTER);
+    if (is_mcast) {
+        flags |= SIGAR_IFF_MULTICAST;
+    }
+    if (is_slave) {
+        flags |= SIGAR_IFF_SLAVE;
+    }
+    if (is_master) {
+        flags |= SIGAR_IFF_MASTER;
+    }
+    if (is_dynamic) {
+        flags |= SIGAR_IFF_DYNAMIC;
+    }
+#endif
+    return flags;
+}
+
 int sigar_net_interface_config_get(sigar_t *sigar, const char *name,
                                    sigar_net_interface_config_t *ifconfig)
 {
@@ -1650,6 +4330,15 @@ int sigar_net_interface_config_get(sigar_t *sigar, const char *name,
         return sigar_net_interface_config_primary_get(sigar, ifconfig);
     }
 
+#ifdef SIGAR_HAS_OS_NET_IFCONFIG_LIST
+    {
+        int status = sigar_os_net_interface_config_get(sigar, name, ifconfig);
+        if (status != SIGAR_ENOTIMPL) {
+            return status;
+        }
+    }
+#endif
+
     SIGAR_ZERO(ifconfig);
 
     if ((sock = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
@@ -1673,37 +4362,7 @@ int sigar_net_interface_config_get(sigar_t *sigar, const char *name,
     }
     
     if (!ioctl(sock, SIOCGIFFLAGS, &ifr)) {
-        sigar_uint64_t flags = ifr.ifr_flags;
-#ifdef __linux__
-# ifndef IFF_DYNAMIC
-#  define IFF_DYNAMIC 0x8000 /* not in 2.2 kernel */
-# endif /* IFF_DYNAMIC */
-        int is_mcast = flags & IFF_MULTICAST;
-        int is_slave = flags & IFF_SLAVE;
-        int is_master = flags & IFF_MASTER;
-        int is_dynamic = flags & IFF_DYNAMIC;
-        /*
-         * XXX: should just define SIGAR_IFF_*
-         * and test IFF_* bits on given platform.
-         * this is the only diff between solaris/hpux/linux
-         * for the flags we care about.
-         *
-         */
-        flags &= ~(IFF_MULTICAST|IFF_SLAVE|IFF_MASTER);
-        if (is_mcast) {
-            flags |= SIGAR_IFF_MULTICAST;
-        }
-        if (is_slave) {
-            flags |= SIGAR_IFF_SLAVE;
-        }
-        if (is_master) {
-            flags |= SIGAR_IFF_MASTER;
-        }
-        if (is_dynamic) {
-            flags |= SIGAR_IFF_DYNAMIC;
-        }
-#endif
-        ifconfig->flags = flags;
+        ifconfig->flags = sigar_net_interface_flags_get(ifr.ifr_flags);
     }
     else {
         /* should always be able to get flags for existing device */
@@ -1733,8 +4392,8 @@ int sigar_net_interface_config_get(sigar_t *sigar, const char *name,
 
 #if defined(SIOCGIFHWADDR)
         if (!ioctl(sock, SIOCGIFHWADDR, &ifr)) {
-            get_interface_type(ifconfig,
-                               ifr.ifr_hwaddr.sa_family);
+            sigar_net_interface_type_set(ifconfig,
+                                         ifr.ifr_hwaddr.sa_family);
             sigar_net_address_mac_set(ifconfig->hwaddr,
                                       ifr.ifr_hwaddr.sa_data,
                                       IFHWADDRLEN);
@@ -1838,7 +4497,7 @@ static int proc_net_interface_list_get(sigar_t *sigar,
      * check /proc/net/dev for any ioctl missed.
      */
     char buffer[BUFSIZ];
-    FILE *fp = fopen("/proc/net/dev", "r");
+    FILE *fp = fopen(SIGAR_PROCFS_FILENAME(buffer, "net/dev"), "r");
 
     if (!fp) {
         return errno;
@@ -1884,9 +4543,17 @@ int sigar_net_interface_list_get(sigar_t *sigar,
     int n, lastlen=0;
     struct ifreq *ifr;
     struct ifconf ifc;
-    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    int sock;
+
+#ifdef SIGAR_HAS_OS_NET_IFCONFIG_LIST
+    if ((n = sigar_os_net_interface_list_get(sigar, iflist)) !=
+        SIGAR_ENOTIMPL)
+    {
+        return n;
+    }
+#endif
 
-    if (sock < 0) {
+    if ((sock = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
         return errno;
     } 
 
@@ -2108,7 +4775,8 @@ static struct hostent *sigar_gethostbyaddr(const char *addr,
 #define FQDN_SET(fqdn) \
     SIGAR_STRNCPY(name, fqdn, namelen)
 
-SIGAR_DECLARE(int) sigar_fqdn_get(sigar_t *sigar, char *name, int namelen)
+/* the lookup itself, sigar_fqdn_get answers from its cache */
+int sigar_fqdn_resolve(sigar_t *sigar, char *name, int namelen)
 {
     register int is_debug = SIGAR_LOG_IS_DEBUG(sigar);
     sigar_hostent_t data;
@@ -0,0 +1,220 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * an arena is a row of list buffers, one per *_get_ex call since the
+ * last reset.  the buffers are plain malloc blocks so the getters can
+ * keep growing them with their *_GROW reallocs; the arena only hands a
+ * buffer in before the call and takes back whatever came out.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sigar.h"
+#include "sigar_private.h"
+#include "sigar_util.h"
+#include "sigar_os.h"
+
+#define SIGAR_ARENA_SLOTS 8
+
+typedef struct {
+    void *data;
+    size_t bytes;
+} arena_slot_t;
+
+struct sigar_arena_t {
+    unsigned long number; /* slots taken since the reset */
+    unsigned long size;
+    arena_slot_t *slots;
+};
+
+SIGAR_DECLARE(int) sigar_arena_create(sigar_arena_t **arena)
+{
+    *arena = calloc(1, sizeof(**arena));
+    return *arena ? SIGAR_OK : ENOMEM;
+}
+
+SIGAR_DECLARE(int) sigar_arena_reset(sigar_arena_t *arena)
+{
+    arena->number = 0;
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int) sigar_arena_destroy(sigar_arena_t *arena)
+{
+    unsigned long i;
+
+    if (!arena) {
+        return SIGAR_OK;
+    }
+    for (i=0; i<arena->size; i++) {
+        free(arena->slots[i].data);
+    }
+    free(arena->slots);
+    free(arena);
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(sigar_uint64_t) sigar_arena_bytes(sigar_arena_t *arena)
+{
+    sigar_uint64_t bytes = 0;
+    unsigned long i;
+
+    for (i=0; i<arena->size; i++) {
+        bytes += arena->slots[i].bytes;
+    }
+
+    return bytes;
+}
+
+static arena_slot_t *arena_slot_take(sigar_arena_t *arena)
+{
+    if (arena->number == arena->size) {
+        unsigned long size = arena->size + SIGAR_ARENA_SLOTS;
+        arena_slot_t *slots =
+            realloc(arena->slots, sizeof(*slots) * size);
+
+        if (!slots) {
+            return NULL;
+        }
+        memset(slots + arena->size, 0,
+               sizeof(*slots) * SIGAR_ARENA_SLOTS);
+        arena->slots = slots;
+        arena->size = size;
+    }
+
+    return &arena->slots[arena->number++];
+}
+
+/*
+ * every sigar list starts with number, size and data, which is all
+ * the arena needs to know of one
+ */
+typedef struct {
+    unsigned long number;
+    unsigned long size;
+    void *data;
+} arena_list_t;
+
+typedef int (*arena_getter_t)(sigar_t *sigar, void *list, int flags);
+
+static int arena_list_get(sigar_t *sigar, sigar_arena_t *arena,
+                          arena_list_t *list, size_t elem,
+                          arena_getter_t getter, int flags)
+{
+    arena_slot_t *slot = arena_slot_take(arena);
+    int status;
+
+    if (!slot) {
+        return ENOMEM;
+    }
+
+    list->number = 0;
+    if (slot->bytes >= elem) {
+        list->size = slot->bytes / elem;
+        list->data = slot->data;
+        sigar->list_preset = list;
+    }
+    else {
+        /* nothing worth keeping, let the getter create it */
+        list->size = 0;
+        list->data = NULL;
+    }
+
+    status = getter(sigar, list, flags);
+    sigar->list_preset = NULL;
+
+    if (list->size) {
+        slot->data = list->data;
+        slot->bytes = list->size * elem;
+    }
+    else {
+        /* the getter destroyed it on the way out */
+        slot->data = NULL;
+        slot->bytes = 0;
+    }
+
+    return status;
+}
+
+static int arena_proc_list_get(sigar_t *sigar, void *list, int flags)
+{
+    return sigar_proc_list_get(sigar, list);
+}
+
+static int arena_file_system_list_get(sigar_t *sigar, void *list, int flags)
+{
+    return sigar_file_system_list_get(sigar, list);
+}
+
+static int arena_net_route_list_get(sigar_t *sigar, void *list, int flags)
+{
+    return sigar_net_route_list_get(sigar, list);
+}
+
+static int arena_net_connection_list_get(sigar_t *sigar, void *list,
+                                         int flags)
+{
+    return sigar_net_connection_list_get(sigar, list, flags);
+}
+
+static int arena_arp_list_get(sigar_t *sigar, void *list, int flags)
+{
+    return sigar_arp_list_get(sigar, list);
+}
+
+#define ARENA_LIST_GET(list, getter, flags) \
+    arena_list_get(sigar, arena, (arena_list_t *)(list), \
+                   sizeof(*(list)->data), getter, flags)
+
+SIGAR_DECLARE(int) sigar_proc_list_get_ex(sigar_t *sigar,
+                                          sigar_arena_t *arena,
+                                          sigar_proc_list_t *proclist)
+{
+    return ARENA_LIST_GET(proclist, arena_proc_list_get, 0);
+}
+
+SIGAR_DECLARE(int)
+sigar_file_system_list_get_ex(sigar_t *sigar,
+                              sigar_arena_t *arena,
+                              sigar_file_system_list_t *fslist)
+{
+    return ARENA_LIST_GET(fslist, arena_file_system_list_get, 0);
+}
+
+SIGAR_DECLARE(int) sigar_net_route_list_get_ex(sigar_t *sigar,
+                                               sigar_arena_t *arena,
+                                               sigar_net_route_list_t *routelist)
+{
+    return ARENA_LIST_GET(routelist, arena_net_route_list_get, 0);
+}
+
+SIGAR_DECLARE(int)
+sigar_net_connection_list_get_ex(sigar_t *sigar,
+                                 sigar_arena_t *arena,
+                                 sigar_net_connection_list_t *connlist,
+                                 int flags)
+{
+    return ARENA_LIST_GET(connlist, arena_net_connection_list_get, flags);
+}
+
+SIGAR_DECLARE(int) sigar_arp_list_get_ex(sigar_t *sigar,
+                                         sigar_arena_t *arena,
+                                         sigar_arp_list_t *arplist)
+{
+    return ARENA_LIST_GET(arplist, arena_arp_list_get, 0);
+}
@@ -29,26 +29,108 @@
 #define ENTRIES_SIZE(n) \
     (sizeof(sigar_cache_entry_t *) * (n))
 
+#define SLOTS_SIZE(n) \
+    (sizeof(sigar_cache_entry_t) * (n))
+
+/* open addressing slots reuse the chain pointer as the in-use marker */
+#define SLOT_USED ((sigar_cache_entry_t *)1)
+
+#define SLOT_IS_USED(slot) \
+    ((slot)->next == SLOT_USED)
+
+#define SLOTS_MIN 16
+
+#define IS_OPEN_ADDRESSING(t) \
+    (t->flags & SIGAR_CACHE_OPEN_ADDRESSING)
+
+#define U64_C(hi, lo) \
+    (((sigar_uint64_t)(hi) << 32) | (sigar_uint64_t)(lo))
+
 /* wrap free() for use w/ dmalloc */
 static void free_value(void *ptr)
 {
     free(ptr);
 }
 
-sigar_cache_t *sigar_expired_cache_new(int size, sigar_uint64_t cleanup_period_millis, sigar_uint64_t entry_expire_period)
+static void cache_value_free(sigar_cache_t *table, void *value)
+{
+    if (table->value_pool) {
+        sigar_pool_free(table->value_pool, value);
+    }
+    else {
+        table->free_value(value);
+    }
+}
+
+/*
+ * murmur3 64-bit finalizer, pids and uids are mostly sequential
+ * so the low bits alone would cluster badly under linear probing.
+ */
+static SIGAR_INLINE sigar_uint64_t sigar_cache_mix(sigar_uint64_t key)
+{
+    key ^= key >> 33;
+    key *= U64_C(0xff51afd7, 0xed558ccd);
+    key ^= key >> 33;
+    key *= U64_C(0xc4ceb9fe, 0x1a85ec53);
+    key ^= key >> 33;
+    return key;
+}
+
+static unsigned int slots_size(unsigned int n)
+{
+    unsigned int size = SLOTS_MIN;
+
+    while (size < n) {
+        size <<= 1;
+    }
+
+    return size;
+}
+
+static sigar_cache_entry_t *slots_new(unsigned int size)
+{
+    sigar_cache_entry_t *slots = malloc(SLOTS_SIZE(size));
+    memset(slots, '\0', SLOTS_SIZE(size));
+    return slots;
+}
+
+sigar_cache_t *sigar_cache_create(int size, int flags,
+                                  sigar_uint64_t cleanup_period_millis,
+                                  sigar_uint64_t entry_expire_period)
 {
     sigar_cache_t *table = malloc(sizeof(*table));
     table->count = 0;
-    table->size = size;
-    table->entries = malloc(ENTRIES_SIZE(size));
-    memset(table->entries, '\0', ENTRIES_SIZE(size));
+    table->flags = flags;
+    if (IS_OPEN_ADDRESSING(table)) {
+        /* keep the load factor at or below 1/2 for the initial size */
+        table->size = slots_size(size * 2);
+        table->slots = slots_new(table->size);
+        table->entries = NULL;
+    }
+    else {
+        table->size = size;
+        table->entries = malloc(ENTRIES_SIZE(size));
+        memset(table->entries, '\0', ENTRIES_SIZE(size));
+        table->slots = NULL;
+    }
     table->free_value = free_value;
+    table->value_pool = NULL;
     table->cleanup_period_millis = cleanup_period_millis;
     table->last_cleanup_time = sigar_time_now_millis();
     table->entry_expire_period = entry_expire_period;
+    table->cleanup_cursor = 0;
+    table->cleanup_active = 0;
+    table->evictions = 0;
+    table->hits = table->misses = 0;
     return table;
 }
 
+sigar_cache_t *sigar_expired_cache_new(int size, sigar_uint64_t cleanup_period_millis, sigar_uint64_t entry_expire_period)
+{
+    return sigar_cache_create(size, 0,
+                              cleanup_period_millis, entry_expire_period);
+}
+
 sigar_cache_t *sigar_cache_new(int size)
 {
     return sigar_expired_cache_new(size, SIGAR_FIELD_NOTIMPL, SIGAR_FIELD_NOTIMPL);
@@ -63,6 +145,20 @@ void sigar_cache_dump(sigar_cache_t *table)
     sigar_cache_entry_t **entries = table->entries;
     printf("table size %lu\n", (long)table->size); 
     printf("table count %lu\n", (long)table->count);
+
+    if (IS_OPEN_ADDRESSING(table)) {
+        for (i=0; i<table->size; i++) {
+            sigar_cache_entry_t *slot = &table->slots[i];
+
+            printf("|");
+            if (SLOT_IS_USED(slot)) {
+                printf(SIGAR_F_U64, (sigar_uint64_t)slot->id);
+            }
+        }
+        printf("\n");
+        fflush(stdout);
+        return;
+    }
     
     for (i=0; i<table->size; i++) {
         sigar_cache_entry_t *entry = *entries++;
@@ -107,68 +203,201 @@ static void sigar_cache_rehash(sigar_cache_t *table)
     free(table->entries);
     table->entries = new_entries;
     table->size = new_size;
+    /* bucket indexes changed, restart any cleanup round */
+    table->cleanup_cursor = 0;
 }
 
 #define SIGAR_CACHE_IX(t, k) \
     t->entries + (k % t->size)
 
+#define SLOT_HOME(t, k) \
+    ((unsigned int)sigar_cache_mix(k) & (t->size - 1))
+
+/* returns the matching slot, or the empty slot where key belongs */
+static sigar_cache_entry_t *slots_lookup(sigar_cache_t *table,
+                                         sigar_uint64_t key)
+{
+    unsigned int mask = table->size - 1;
+    unsigned int i = SLOT_HOME(table, key);
+
+    while (1) {
+        sigar_cache_entry_t *slot = &table->slots[i];
+
+        if (!SLOT_IS_USED(slot) || (slot->id == key)) {
+            return slot;
+        }
+        i = (i + 1) & mask;
+    }
+}
+
+static void slots_rehash(sigar_cache_t *table, unsigned int new_size)
+{
+    unsigned int i, size = table->size;
+    sigar_cache_entry_t *slots = table->slots;
+
+    table->slots = slots_new(new_size);
+    table->size = new_size;
+
+    for (i=0; i<size; i++) {
+        if (SLOT_IS_USED(&slots[i])) {
+            *slots_lookup(table, slots[i].id) = slots[i];
+        }
+    }
+
+    free(slots);
+    table->cleanup_cursor = 0;
+}
+
+/* backward shift deletion, no tombstones */
+static void slots_remove(sigar_cache_t *table, unsigned int i)
+{
+    unsigned int mask = table->size - 1, j = i;
+    sigar_cache_entry_t *slots = table->slots;
+
+    while (1) {
+        unsigned int home;
+
+        j = (j + 1) & mask;
+        if (!SLOT_IS_USED(&slots[j])) {
+            break;
+        }
+
+        home = SLOT_HOME(table, slots[j].id);
+
+        /* leave it if its home lies cyclically within (i, j] */
+        if ((i <= j) ?
+            ((i < home) && (home <= j)) :
+            ((i < home) || (home <= j)))
+        {
+            continue;
+        }
+
+        slots[i] = slots[j];
+        i = j;
+    }
+
+    slots[i].next = NULL;
+    slots[i].value = NULL;
+    table->count--;
+}
+
+#define ENTRY_EXPIRED(t, e, now) \
+    ((t)->entry_expire_period < ((now) - (e)->last_access_time))
+
+/* returns 1 if slot i expired, the next entry may have shifted into i */
+static int slot_expire(sigar_cache_t *table, unsigned int i,
+                       sigar_uint64_t current_time)
+{
+    sigar_cache_entry_t *slot = &table->slots[i];
+
+    if (!SLOT_IS_USED(slot) || !ENTRY_EXPIRED(table, slot, current_time)) {
+        return 0;
+    }
+
+    if (slot->value) {
+        cache_value_free(table, slot->value);
+    }
+    slots_remove(table, i);
+    table->evictions++;
+
+    return 1;
+}
+
+static void bucket_expire(sigar_cache_t *table, unsigned int i,
+                          sigar_uint64_t current_time)
+{
+    sigar_cache_entry_t *entry, *ptr, *entry_prev=NULL, **entry_in_table;
+
+    entry_in_table = &table->entries[i];
+    entry = *entry_in_table;
+
+    while (entry) {
+        ptr = entry->next;
+        if (ENTRY_EXPIRED(table, entry, current_time)) {
+            /* no one acess this entry for too long - we can delete it */
+            if (entry->value) {
+                cache_value_free(table, entry->value);
+            }
+            free(entry);
+            table->count--;
+            table->evictions++;
+            if (entry_prev != NULL) {
+                entry_prev->next = ptr;
+            }
+            else {
+                /* removing first entry - head of list should point to next entry */
+                *entry_in_table = ptr;
+            }
+        }
+        else {
+            /* entry not expired - advance entry_prev to current entry*/
+            entry_prev = entry;
+        }
+        entry = ptr;
+    }
+}
+
+static void sigar_cache_shrink(sigar_cache_t *table)
+{
+    if (IS_OPEN_ADDRESSING(table)) {
+        if ((table->size > SLOTS_MIN) && (table->count < (table->size/8))) {
+            slots_rehash(table, slots_size(table->count * 4));
+        }
+    }
+    else if (table->count < (table->size/4)) {
+        /* hash table (the array size) too big for the amount of values it contains perform rehash */
+        sigar_cache_rehash(table);
+    }
+}
+
 void sigar_perform_cleanup_if_necessary(sigar_cache_t *table) { 
     sigar_uint64_t current_time;
-	int i;
-	sigar_cache_entry_t **entries;
+    unsigned int i, end;
+
     if (table->cleanup_period_millis == SIGAR_FIELD_NOTIMPL) {
-		/* no cleanup for this cache) */
-		return;
+        /* no cleanup for this cache) */
+        return;
     }
     current_time = sigar_time_now_millis();
-    if ((current_time - table->last_cleanup_time) < table->cleanup_period_millis) {
-        /* not enough time has passed since last cleanup */
-        return;
-    }	
 
-    /* performing cleanup */    
-    entries = table->entries;
+    if (!table->cleanup_active) {
+        if ((current_time - table->last_cleanup_time) < table->cleanup_period_millis) {
+            /* not enough time has passed since last cleanup */
+            return;
+        }
+        table->cleanup_active = 1;
+        table->cleanup_cursor = 0;
+    }
 
-    table->last_cleanup_time = current_time;
-    
-    for (i=0; i<table->size; i++) {
-        sigar_cache_entry_t *entry, *ptr, *entry_prev=NULL, **entry_in_table;
-        entry_in_table = entries;
-        entry = *entries++;
+    end = table->size;
+    if (table->flags & SIGAR_CACHE_INCREMENTAL_CLEANUP) {
+        /* spread the sweep over many accesses */
+        if ((table->cleanup_cursor + SIGAR_CACHE_CLEANUP_STEP) < end) {
+            end = table->cleanup_cursor + SIGAR_CACHE_CLEANUP_STEP;
+        }
+    }
 
-        while (entry) {
-			sigar_uint64_t period_with_no_access = current_time - entry->last_access_time;
-            ptr = entry->next;            
-            if (table->entry_expire_period < period_with_no_access) {
-		       /* no one acess this entry for too long - we can delete it */
-	           if (entry->value) {
-                   table->free_value(entry->value);
-                } 
-                free(entry);
-		        table->count--;
-                if (entry_prev != NULL) {
-                   entry_prev->next = ptr;
-                }
-                else {
-                   /* removing first entry - head of list should point to next entry */               
-                   *entry_in_table = ptr;
-                } 
+    for (i=table->cleanup_cursor; i<end; i++) {
+        if (IS_OPEN_ADDRESSING(table)) {
+            while (slot_expire(table, i, current_time)) {
+                /* look at i again */
             }
-            else {
-              /* entry not expired - advance entry_prev to current entry*/
-              entry_prev = entry;
-	        }
-            entry = ptr;
+        }
+        else {
+            bucket_expire(table, i, current_time);
         }
     }
-    if (table->count < (table->size/4)) {
-	/* hash table (the array size) too big for the amount of values it contains perform rehash */
-        sigar_cache_rehash(table);
+
+    table->cleanup_cursor = end;
+    if (end < table->size) {
+        return;
     }
-}
 
-   
+    table->cleanup_active = 0;
+    table->last_cleanup_time = current_time;
 
+    sigar_cache_shrink(table);
+}
 
 sigar_cache_entry_t *sigar_cache_find(sigar_cache_t *table,
                                       sigar_uint64_t key)
@@ -176,19 +405,63 @@ sigar_cache_entry_t *sigar_cache_find(sigar_cache_t *table,
     sigar_cache_entry_t *entry, **ptr;
     sigar_perform_cleanup_if_necessary(table);
 
+    if (IS_OPEN_ADDRESSING(table)) {
+        entry = slots_lookup(table, key);
+        if (!SLOT_IS_USED(entry)) {
+            table->misses++;
+            return NULL;
+        }
+        table->hits++;
+        entry->last_access_time = sigar_time_now_millis();
+        return entry;
+    }
+
     for (ptr = SIGAR_CACHE_IX(table, key), entry = *ptr;
          entry;
          ptr = &entry->next, entry = *ptr)
     {
         if (entry->id == key) {
+            table->hits++;
             entry->last_access_time = sigar_time_now_millis();
             return entry;
         }
     }
 
+    table->misses++;
     return NULL;
 }
 
+/*
+ * open addressing entries live in the table itself, the returned
+ * pointer is only good until the next get/find on the same table.
+ */
+static sigar_cache_entry_t *slots_get(sigar_cache_t *table,
+                                      sigar_uint64_t key)
+{
+    sigar_cache_entry_t *slot = slots_lookup(table, key);
+
+    if (SLOT_IS_USED(slot)) {
+        table->hits++;
+    }
+    else {
+        table->misses++;
+        /* max load factor 3/4 */
+        if (((table->count + 1) * 4) > (table->size * 3)) {
+            slots_rehash(table, table->size * 2);
+            slot = slots_lookup(table, key);
+        }
+
+        table->count++;
+        slot->next = SLOT_USED;
+        slot->id = key;
+        slot->value = NULL;
+    }
+
+    slot->last_access_time = sigar_time_now_millis();
+
+    return slot;
+}
+
 /* create entry if it does not exist */
 sigar_cache_entry_t *sigar_cache_get(sigar_cache_t *table,
                                      sigar_uint64_t key)
@@ -196,16 +469,23 @@ sigar_cache_entry_t *sigar_cache_get(sigar_cache_t *table,
     sigar_cache_entry_t *entry, **ptr;
     sigar_perform_cleanup_if_necessary(table);
 
+    if (IS_OPEN_ADDRESSING(table)) {
+        return slots_get(table, key);
+    }
+
     for (ptr = SIGAR_CACHE_IX(table, key), entry = *ptr;
          entry;
          ptr = &entry->next, entry = *ptr)
     {
         if (entry->id == key) {
+            table->hits++;
             entry->last_access_time = sigar_time_now_millis();
             return entry;
         }
     }
 
+    table->misses++;
+
     if (++table->count > table->size) {
         sigar_cache_rehash(table);
 
@@ -225,6 +505,38 @@ sigar_cache_entry_t *sigar_cache_get(sigar_cache_t *table,
     return entry;
 }
 
+/* free the value and drop the entry, if there is one */
+void sigar_cache_remove(sigar_cache_t *table, sigar_uint64_t key)
+{
+    sigar_cache_entry_t *entry, **ptr;
+
+    if (IS_OPEN_ADDRESSING(table)) {
+        entry = slots_lookup(table, key);
+        if (SLOT_IS_USED(entry)) {
+            if (entry->value) {
+                cache_value_free(table, entry->value);
+            }
+            slots_remove(table, entry - table->slots);
+        }
+        return;
+    }
+
+    for (ptr = SIGAR_CACHE_IX(table, key), entry = *ptr;
+         entry;
+         ptr = &entry->next, entry = *ptr)
+    {
+        if (entry->id == key) {
+            *ptr = entry->next;
+            if (entry->value) {
+                cache_value_free(table, entry->value);
+            }
+            free(entry);
+            table->count--;
+            return;
+        }
+    }
+}
+
 void sigar_cache_destroy(sigar_cache_t *table)
 {
     int i;
@@ -234,13 +546,26 @@ void sigar_cache_destroy(sigar_cache_t *table)
     sigar_cache_dump(table);
 #endif
 
+    if (IS_OPEN_ADDRESSING(table)) {
+        for (i=0; i<table->size; i++) {
+            sigar_cache_entry_t *slot = &table->slots[i];
+
+            if (SLOT_IS_USED(slot) && slot->value) {
+                cache_value_free(table, slot->value);
+            }
+        }
+        free(table->slots);
+        free(table);
+        return;
+    }
+
     for (i=0; i<table->size; i++) {
         sigar_cache_entry_t *entry, *ptr;
         entry = *entries++;
 
         while (entry) {
             if (entry->value) {
-                table->free_value(entry->value);
+                cache_value_free(table, entry->value);
             }
             ptr = entry->next;
             free(entry);
@@ -251,3 +576,98 @@ void sigar_cache_destroy(sigar_cache_t *table)
     free(table->entries);
     free(table);
 }
+
+void sigar_cache_walk(sigar_cache_t *table,
+                      void (*walker)(sigar_cache_entry_t *entry, void *data),
+                      void *data)
+{
+    unsigned int i;
+
+    if (IS_OPEN_ADDRESSING(table)) {
+        for (i=0; i<table->size; i++) {
+            if (SLOT_IS_USED(&table->slots[i])) {
+                walker(&table->slots[i], data);
+            }
+        }
+        return;
+    }
+
+    for (i=0; i<table->size; i++) {
+        sigar_cache_entry_t *entry;
+
+        for (entry = table->entries[i]; entry; entry = entry->next) {
+            walker(entry, data);
+        }
+    }
+}
+
+void sigar_cache_stats(sigar_cache_t *table, sigar_cache_stats_t *stats)
+{
+    unsigned int i, probe;
+
+    stats->size = table->size;
+    stats->count = table->count;
+    stats->hits = table->hits;
+    stats->misses = table->misses;
+    stats->evictions = table->evictions;
+    stats->max_probe = 0;
+
+    if (IS_OPEN_ADDRESSING(table)) {
+        unsigned int mask = table->size - 1;
+
+        for (i=0; i<table->size; i++) {
+            sigar_cache_entry_t *slot = &table->slots[i];
+
+            if (!SLOT_IS_USED(slot)) {
+                continue;
+            }
+            /* distance from home slot, counting the home slot itself */
+            probe = ((i - SLOT_HOME(table, slot->id)) & mask) + 1;
+            if (probe > stats->max_probe) {
+                stats->max_probe = probe;
+            }
+        }
+
+        stats->bytes = sizeof(*table) + SLOTS_SIZE(table->size);
+    }
+    else {
+        for (i=0; i<table->size; i++) {
+            sigar_cache_entry_t *entry = table->entries[i];
+
+            for (probe=0; entry; entry = entry->next) {
+                probe++;
+            }
+            if (probe > stats->max_probe) {
+                stats->max_probe = probe;
+            }
+        }
+
+        stats->bytes = sizeof(*table) + ENTRIES_SIZE(table->size) +
+            (table->count * sizeof(sigar_cache_entry_t));
+    }
+
+    if (table->value_pool) {
+        stats->bytes += sigar_pool_bytes(table->value_pool);
+    }
+}
+
+void *sigar_cache_value_new(sigar_cache_t *table, size_t size)
+{
+    void *value;
+
+    if (table->value_pool) {
+        if (size > sigar_pool_size(table->value_pool)) {
+            return NULL;
+        }
+        value = sigar_pool_alloc(table->value_pool);
+    }
+    else {
+        value = malloc(size);
+    }
+
+    if (value) {
+        memset(value, '\0', size);
+    }
+
+    return value;
+}
@@ -232,6 +232,22 @@ SIGAR_DECLARE(int)sigar_file_attrs_mode_get(sigar_uint64_t permissions)
     return perms;
 }
 
+/* clears what sigar_file_attrs_list_get was not asked for */
+static void fileattrs_mask(sigar_file_attrs_t *fileattrs, int mask)
+{
+    if (!(mask & SIGAR_FILE_ATTR_PERMISSIONS)) fileattrs->permissions = 0;
+    if (!(mask & SIGAR_FILE_ATTR_TYPE))   fileattrs->type = SIGAR_FILETYPE_NOFILE;
+    if (!(mask & SIGAR_FILE_ATTR_UID))    fileattrs->uid = 0;
+    if (!(mask & SIGAR_FILE_ATTR_GID))    fileattrs->gid = 0;
+    if (!(mask & SIGAR_FILE_ATTR_INODE))  fileattrs->inode = 0;
+    if (!(mask & SIGAR_FILE_ATTR_DEVICE)) fileattrs->device = 0;
+    if (!(mask & SIGAR_FILE_ATTR_NLINK))  fileattrs->nlink = 0;
+    if (!(mask & SIGAR_FILE_ATTR_SIZE))   fileattrs->size = 0;
+    if (!(mask & SIGAR_FILE_ATTR_ATIME))  fileattrs->atime = 0;
+    if (!(mask & SIGAR_FILE_ATTR_MTIME))  fileattrs->mtime = 0;
+    if (!(mask & SIGAR_FILE_ATTR_CTIME))  fileattrs->ctime = 0;
+}
+
 #define IS_DOTDIR(dir) \
     ((dir[0] == '.') && (!dir[1] || ((dir[1] == '.') && !dir[2])))
 
@@ -264,6 +280,15 @@ int sigar_link_attrs_get(sigar_t *sigar,
     return SIGAR_ENOTIMPL;
 }
 
+int sigar_file_attrs_list_get(sigar_t *sigar,
+                              const char **paths,
+                              unsigned long n,
+                              int mask,
+                              sigar_file_attrs_result_t *results)
+{
+    return SIGAR_ENOTIMPL;
+}
+
 #elif defined(WIN32)
 
 #include <accctrl.h>
@@ -374,10 +399,12 @@ static int get_security_info(sigar_t *sigar,
     return SIGAR_OK;
 }
 
+/* the handle is only opened for INODE, DEVICE or NLINK, the acl read for PERMISSIONS */
 static int fileattrs_get(sigar_t *sigar,
                          const char *file,
                          sigar_file_attrs_t *fileattrs,
-                         int linkinfo)
+                         int linkinfo,
+                         int mask)
 {
     BY_HANDLE_FILE_INFORMATION info;
     WIN32_FILE_ATTRIBUTE_DATA attrs;
@@ -395,35 +422,42 @@ static int fileattrs_get(sigar_t *sigar,
 
     fillin_fileattrs(fileattrs, &attrs, linkinfo);
 
-    flags = fileattrs->type == SIGAR_FILETYPE_DIR ?
-        FILE_FLAG_BACKUP_SEMANTICS :
-        FILE_ATTRIBUTE_NORMAL;
+    if (mask & (SIGAR_FILE_ATTR_INODE |
+                SIGAR_FILE_ATTR_DEVICE |
+                SIGAR_FILE_ATTR_NLINK))
+    {
+        flags = fileattrs->type == SIGAR_FILETYPE_DIR ?
+            FILE_FLAG_BACKUP_SEMANTICS :
+            FILE_ATTRIBUTE_NORMAL;
+
+        /**
+         * We need to set dwDesiredAccess to 0 to work in cases where GENERIC_READ can fail.
+         *
+         * see: http://msdn.microsoft.com/en-us/library/aa363858(VS.85).aspx
+         */
+        handle = CreateFile(file,
+                            0,
+                            0,
+                            NULL,
+                            OPEN_EXISTING,
+                            flags,
+                            NULL);
+
+        if (handle != INVALID_HANDLE_VALUE) {
+            if (GetFileInformationByHandle(handle, &info)) {
+                fileattrs->inode =
+                    info.nFileIndexLow |
+                    (info.nFileIndexHigh << 32);
+                fileattrs->device = info.dwVolumeSerialNumber;
+                fileattrs->nlink  = info.nNumberOfLinks;
+            }
+            CloseHandle(handle);
+        }
+    }
 
-    /**
-     * We need to set dwDesiredAccess to 0 to work in cases where GENERIC_READ can fail.
-     *
-     * see: http://msdn.microsoft.com/en-us/library/aa363858(VS.85).aspx
-     */
-    handle = CreateFile(file,
-                        0,
-                        0,
-                        NULL,
-                        OPEN_EXISTING,
-                        flags,
-                        NULL);
- 
-    if (handle != INVALID_HANDLE_VALUE) {
-        if (GetFileInformationByHandle(handle, &info)) {
-            fileattrs->inode =
-                info.nFileIndexLow |
-                (info.nFileIndexHigh << 32);
-            fileattrs->device = info.dwVolumeSerialNumber;
-            fileattrs->nlink  = info.nNumberOfLinks;
-        }
-        CloseHandle(handle);
-    }
-
-    get_security_info(sigar, file, fileattrs);
+    if (mask & SIGAR_FILE_ATTR_PERMISSIONS) {
+        get_security_info(sigar, file, fileattrs);
+    }
 
     return SIGAR_OK;
 }
@@ -432,14 +466,33 @@ SIGAR_DECLARE(int) sigar_file_attrs_get(sigar_t *sigar,
                                         const char *file,
                                         sigar_file_attrs_t *fileattrs)
 {
-    return fileattrs_get(sigar, file, fileattrs, 0);
+    return fileattrs_get(sigar, file, fileattrs, 0, SIGAR_FILE_ATTR_ALL);
 }
 
 SIGAR_DECLARE(int) sigar_link_attrs_get(sigar_t *sigar,
                                         const char *file,
                                         sigar_file_attrs_t *fileattrs)
 {
-    return fileattrs_get(sigar, file, fileattrs, 1);
+    return fileattrs_get(sigar, file, fileattrs, 1, SIGAR_FILE_ATTR_ALL);
+}
+
+SIGAR_DECLARE(int)
+sigar_file_attrs_list_get(sigar_t *sigar,
+                          const char **paths,
+                          unsigned long n,
+                          int mask,
+                          sigar_file_attrs_result_t *results)
+{
+    unsigned long i;
+
+    for (i=0; i<n; i++) {
+        results[i].status =
+            fileattrs_get(sigar, paths[i], &results[i].attrs,
+                          mask & SIGAR_FILE_ATTR_LINK, mask);
+        fileattrs_mask(&results[i].attrs, mask);
+    }
+
+    return SIGAR_OK;
 }
 
 static __inline int file_type(char *file)
@@ -700,6 +753,258 @@ int sigar_link_attrs_get(sigar_t *sigar,
     }
 }
 
+/*
+ * sigar_file_attrs_list_get: statx where the kernel has it, asked for
+ * the mask only, so a network filesystem is not made to revalidate
+ * what nobody wants.  each path is looked up relative to its parent
+ * directory, kept open for the rest of the call, most recent first.
+ */
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+#include <linux/stat.h>
+
+#if defined(__NR_statx) && defined(STATX_TYPE)
+#define HAVE_FILE_ATTRS_STATX
+#endif
+#endif
+
+#ifndef AT_STATX_DONT_SYNC
+#define AT_STATX_DONT_SYNC 0x4000
+#endif
+#ifndef AT_NO_AUTOMOUNT
+#define AT_NO_AUTOMOUNT 0x800
+#endif
+
+#ifndef O_CLOEXEC
+#define O_CLOEXEC 0
+#endif
+
+#if defined(O_PATH)
+#define FILE_ATTRS_DIR_FLAGS (O_PATH | O_DIRECTORY | O_CLOEXEC)
+#elif defined(O_DIRECTORY)
+#define FILE_ATTRS_DIR_FLAGS (O_RDONLY | O_DIRECTORY | O_CLOEXEC)
+#else
+#define FILE_ATTRS_DIR_FLAGS (O_RDONLY | O_CLOEXEC)
+#endif
+
+#define FILE_ATTRS_DIRS 8
+
+typedef struct {
+    const char *path; /* into the caller's path, len bytes long */
+    size_t len;
+    int fd;
+} file_attrs_dir_t;
+
+typedef struct {
+    file_attrs_dir_t dirs[FILE_ATTRS_DIRS];
+    int number;
+    int statx;
+} file_attrs_ctx_t;
+
+#ifdef AT_FDCWD
+/* -1 rather than an error, the caller then takes the whole path */
+static int file_attrs_dir_open(file_attrs_ctx_t *ctx,
+                               const char *path, size_t len)
+{
+    file_attrs_dir_t dir;
+    char name[SIGAR_PATH_MAX+1];
+    int i;
+
+    for (i=0; i<ctx->number; i++) {
+        if ((ctx->dirs[i].len == len) &&
+            (memcmp(ctx->dirs[i].path, path, len) == 0))
+        {
+            dir = ctx->dirs[i];
+            memmove(&ctx->dirs[1], &ctx->dirs[0], i * sizeof(dir));
+            ctx->dirs[0] = dir;
+            return dir.fd;
+        }
+    }
+
+    if (len >= sizeof(name)) {
+        return -1;
+    }
+    memcpy(name, path, len);
+    name[len] = '\0';
+
+    if ((dir.fd = open(len ? name : "/", FILE_ATTRS_DIR_FLAGS)) < 0) {
+        return -1;
+    }
+    dir.path = path;
+    dir.len = len;
+
+    if (ctx->number == FILE_ATTRS_DIRS) {
+        close(ctx->dirs[--ctx->number].fd);
+    }
+    memmove(&ctx->dirs[1], &ctx->dirs[0], ctx->number * sizeof(dir));
+    ctx->dirs[0] = dir;
+    ctx->number++;
+
+    return dir.fd;
+}
+#endif
+
+#ifdef HAVE_FILE_ATTRS_STATX
+static unsigned int file_attrs_statx_mask(int mask)
+{
+    unsigned int want = 0;
+
+    if (mask & SIGAR_FILE_ATTR_PERMISSIONS) want |= STATX_MODE;
+    if (mask & SIGAR_FILE_ATTR_TYPE)   want |= STATX_TYPE;
+    if (mask & SIGAR_FILE_ATTR_UID)    want |= STATX_UID;
+    if (mask & SIGAR_FILE_ATTR_GID)    want |= STATX_GID;
+    if (mask & SIGAR_FILE_ATTR_INODE)  want |= STATX_INO;
+    if (mask & SIGAR_FILE_ATTR_NLINK)  want |= STATX_NLINK;
+    if (mask & SIGAR_FILE_ATTR_SIZE)   want |= STATX_SIZE;
+    if (mask & SIGAR_FILE_ATTR_ATIME)  want |= STATX_ATIME;
+    if (mask & SIGAR_FILE_ATTR_MTIME)  want |= STATX_MTIME;
+    if (mask & SIGAR_FILE_ATTR_CTIME)  want |= STATX_CTIME;
+
+    return want;
+}
+
+/* the device always comes back, only what stx_mask says is copied */
+static void copy_statx_info(sigar_file_attrs_t *fileattrs,
+                            struct statx *stx, int mask)
+{
+    if ((mask & SIGAR_FILE_ATTR_PERMISSIONS) && (stx->stx_mask & STATX_MODE)) {
+        fileattrs->permissions = sigar_unix_mode2perms(stx->stx_mode);
+    }
+    if ((mask & SIGAR_FILE_ATTR_TYPE) && (stx->stx_mask & STATX_TYPE)) {
+        fileattrs->type = filetype_from_mode(stx->stx_mode);
+    }
+    if ((mask & SIGAR_FILE_ATTR_UID) && (stx->stx_mask & STATX_UID)) {
+        fileattrs->uid = stx->stx_uid;
+    }
+    if ((mask & SIGAR_FILE_ATTR_GID) && (stx->stx_mask & STATX_GID)) {
+        fileattrs->gid = stx->stx_gid;
+    }
+    if ((mask & SIGAR_FILE_ATTR_INODE) && (stx->stx_mask & STATX_INO)) {
+        fileattrs->inode = stx->stx_ino;
+    }
+    if (mask & SIGAR_FILE_ATTR_DEVICE) {
+        fileattrs->device = makedev(stx->stx_dev_major, stx->stx_dev_minor);
+    }
+    if ((mask & SIGAR_FILE_ATTR_NLINK) && (stx->stx_mask & STATX_NLINK)) {
+        fileattrs->nlink = stx->stx_nlink;
+    }
+    if ((mask & SIGAR_FILE_ATTR_SIZE) && (stx->stx_mask & STATX_SIZE)) {
+        fileattrs->size = stx->stx_size;
+    }
+    if ((mask & SIGAR_FILE_ATTR_ATIME) && (stx->stx_mask & STATX_ATIME)) {
+        fileattrs->atime = stx->stx_atime.tv_sec;
+        fileattrs->atime *= 1000;
+    }
+    if ((mask & SIGAR_FILE_ATTR_MTIME) && (stx->stx_mask & STATX_MTIME)) {
+        fileattrs->mtime = stx->stx_mtime.tv_sec;
+        fileattrs->mtime *= 1000;
+    }
+    if ((mask & SIGAR_FILE_ATTR_CTIME) && (stx->stx_mask & STATX_CTIME)) {
+        fileattrs->ctime = stx->stx_ctime.tv_sec;
+        fileattrs->ctime *= 1000;
+    }
+}
+#endif
+
+static int file_attrs_lookup(file_attrs_ctx_t *ctx,
+                             const char *path, int mask,
+                             sigar_file_attrs_t *fileattrs)
+{
+    struct stat info;
+    int status;
+#ifdef AT_FDCWD
+    const char *name = path, *slash = strrchr(path, '/');
+    int dirfd = AT_FDCWD, flags = 0;
+
+    /* "dir/" is left whole, there is no name to take relative to it */
+    if (slash && slash[1]) {
+        int fd = file_attrs_dir_open(ctx, path, slash - path);
+        if (fd >= 0) {
+            dirfd = fd;
+            name = slash + 1;
+        }
+    }
+
+    if (mask & SIGAR_FILE_ATTR_LINK) {
+        flags |= AT_SYMLINK_NOFOLLOW;
+    }
+
+#ifdef HAVE_FILE_ATTRS_STATX
+    if (ctx->statx) {
+        struct statx stx;
+        int xflags = flags | AT_NO_AUTOMOUNT;
+
+        if (mask & SIGAR_FILE_ATTR_NOSYNC) {
+            xflags |= AT_STATX_DONT_SYNC;
+        }
+
+        if (syscall(__NR_statx, dirfd, name, xflags,
+                    file_attrs_statx_mask(mask), &stx) == 0)
+        {
+            copy_statx_info(fileattrs, &stx, mask);
+            return SIGAR_OK;
+        }
+        status = errno;
+        /* no statx in this kernel, or a seccomp filter refusing it */
+        if ((status != ENOSYS) && (status != EPERM)) {
+            return status;
+        }
+        if (fstatat(dirfd, name, &info, flags) != 0) {
+            return errno;
+        }
+        ctx->statx = 0;
+        copy_stat_info(fileattrs, &info);
+        fileattrs_mask(fileattrs, mask);
+        return SIGAR_OK;
+    }
+#endif
+
+    status = fstatat(dirfd, name, &info, flags);
+#else
+    status = (mask & SIGAR_FILE_ATTR_LINK) ?
+        lstat(path, &info) : stat(path, &info);
+#endif
+
+    if (status != 0) {
+        return errno;
+    }
+    copy_stat_info(fileattrs, &info);
+    fileattrs_mask(fileattrs, mask);
+
+    return SIGAR_OK;
+}
+
+int sigar_file_attrs_list_get(sigar_t *sigar,
+                              const char **paths,
+                              unsigned long n,
+                              int mask,
+                              sigar_file_attrs_result_t *results)
+{
+    file_attrs_ctx_t ctx;
+    unsigned long i;
+
+    ctx.number = 0;
+    ctx.statx = 1;
+
+    for (i=0; i<n; i++) {
+        SIGAR_ZERO(&results[i].attrs);
+        results[i].status =
+            file_attrs_lookup(&ctx, paths[i], mask, &results[i].attrs);
+    }
+
+    while (ctx.number) {
+        close(ctx.dirs[--ctx.number].fd);
+    }
+
+    return SIGAR_OK;
+}
+
 static int dir_stat_get(sigar_t *sigar,
                         const char *dir,
                         sigar_dir_stat_t *dirstats,
@@ -796,20 +1101,1191 @@ static int dir_stat_get(sigar_t *sigar,
     return SIGAR_OK;
 }
 
+/*
+ * sigar_dir_usage_walk: directories go on a shared stack that every
+ * walker pops from and pushes the subdirectories it finds back onto,
+ * so a walker done with a small subtree takes over part of a big one.
+ */
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sigar_private.h"
+#include "sigar_util.h"
+#include "sigar_os.h"
+
+#ifndef O_DIRECTORY
+#define O_DIRECTORY 0
 #endif
 
-SIGAR_DECLARE(int) sigar_dir_stat_get(sigar_t *sigar,
-                                      const char *dir,
-                                      sigar_dir_stat_t *dirstats)
+#define DIR_WALK_THREADS_MAX 64
+
+/* memo entries for directories not seen by a walk in this long go */
+#define DIR_USAGE_EXPIRE (60 * 60 * SIGAR_MSEC)
+
+/*
+ * a directory changed within this many seconds of being read may change
+ * again within the same mtime tick, such a listing is not memoised.
+ */
+#define DIR_USAGE_RACY 2
+
+typedef struct dir_walk_job_t {
+    struct dir_walk_job_t *next;
+    char path[1];
+} dir_walk_job_t;
+
+/* one directory's own entries, without what lives below its subdirs */
+typedef struct {
+    sigar_uint64_t dev;
+    sigar_uint64_t ino;
+    sigar_uint64_t mtime;
+    sigar_dir_stat_t stats;
+    unsigned long nchildren;
+    char *children; /* nchildren nul terminated subdir names */
+} dir_usage_memo_t;
+
+typedef struct {
+    sigar_t *sigar;
+    sigar_dir_usage_opts_t *opts;
+    sigar_int64_t deadline;
+    sigar_uint64_t entries;
+    dir_walk_job_t *jobs;
+    int busy;
+    int status;
+    sigar_dir_stat_t totals;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} dir_walk_t;
+
+static void dir_usage_memo_free(void *ptr)
 {
-    SIGAR_ZERO(dirstats);
-    return dir_stat_get(sigar, dir, dirstats, 0);
+    dir_usage_memo_t *memo = ptr;
+
+    if (memo->children) {
+        free(memo->children);
+    }
+    free(memo);
 }
 
-SIGAR_DECLARE(int) sigar_dir_usage_get(sigar_t *sigar,
-                                       const char *dir,
-                                       sigar_dir_usage_t *dirusage)
+static SIGAR_INLINE sigar_uint64_t dir_usage_memo_key(struct stat *st)
 {
-    SIGAR_ZERO(dirusage);
-    return dir_stat_get(sigar, dir, dirusage, 1);
+    /* the cache mixes the bits, dev and ino are checked on a hit */
+    return (sigar_uint64_t)st->st_ino ^
+        ((sigar_uint64_t)st->st_dev << 32);
+}
+
+static SIGAR_INLINE sigar_uint64_t dir_usage_mtime(struct stat *st)
+{
+#ifdef __linux__
+    return ((sigar_uint64_t)st->st_mtim.tv_sec * 1000000000) +
+        st->st_mtim.tv_nsec;
+#else
+    return st->st_mtime;
+#endif
+}
+
+static void dir_stat_add(sigar_dir_stat_t *total, sigar_dir_stat_t *stats)
+{
+    total->files += stats->files;
+    total->subdirs += stats->subdirs;
+    total->symlinks += stats->symlinks;
+    total->chrdevs += stats->chrdevs;
+    total->blkdevs += stats->blkdevs;
+    total->sockets += stats->sockets;
+    total->disk_usage += stats->disk_usage;
+}
+
+static dir_walk_job_t *dir_walk_job_new(const char *dir, int dlen,
+                                        const char *name)
+{
+    int nlen = strlen(name);
+    dir_walk_job_t *job;
+
+    if (dlen + 1 + nlen > SIGAR_PATH_MAX) {
+        return NULL;
+    }
+    job = malloc(sizeof(*job) + dlen + 1 + nlen);
+    if (!job) {
+        return NULL;
+    }
+
+    memcpy(job->path, dir, dlen);
+    job->path[dlen] = '/';
+    memcpy(job->path + dlen + 1, name, nlen + 1);
+
+    return job;
+}
+
+/* called locked */
+static dir_usage_memo_t *dir_usage_memo_find(sigar_t *sigar,
+                                             struct stat *st)
+{
+    sigar_cache_entry_t *entry;
+    dir_usage_memo_t *memo;
+
+    if (!sigar->dir_usage) {
+        return NULL;
+    }
+    entry = sigar_cache_find(sigar->dir_usage, dir_usage_memo_key(st));
+    if (!entry || !(memo = entry->value)) {
+        return NULL;
+    }
+    if ((memo->dev != (sigar_uint64_t)st->st_dev) ||
+        (memo->ino != (sigar_uint64_t)st->st_ino) ||
+        (memo->mtime != dir_usage_mtime(st)))
+    {
+        return NULL;
+    }
+
+    return memo;
+}
+
+/* called locked, takes children */
+static void dir_usage_memo_put(sigar_t *sigar, struct stat *st,
+                               sigar_dir_stat_t *stats,
+                               unsigned long nchildren, char *children)
+{
+    sigar_cache_entry_t *entry;
+    dir_usage_memo_t *memo;
+
+    if (!sigar->dir_usage) {
+        sigar->dir_usage =
+            sigar_expired_cache_new(1024, DIR_USAGE_EXPIRE,
+                                    DIR_USAGE_EXPIRE);
+        sigar->dir_usage->free_value = dir_usage_memo_free;
+    }
+
+    entry = sigar_cache_get(sigar->dir_usage, dir_usage_memo_key(st));
+    if ((memo = entry->value)) {
+        if (memo->children) {
+            free(memo->children);
+        }
+    }
+    else if (!(memo = entry->value = malloc(sizeof(*memo)))) {
+        if (children) {
+            free(children);
+        }
+        sigar_cache_remove(sigar->dir_usage, entry->id);
+        return;
+    }
+
+    memo->dev = st->st_dev;
+    memo->ino = st->st_ino;
+    memo->mtime = dir_usage_mtime(st);
+    memo->stats = *stats;
+    memo->nchildren = nchildren;
+    memo->children = children;
+}
+
+/*
+ * reads one directory into stats, queueing its subdirs on jobs.
+ * returns the number of entries looked at.
+ */
+static sigar_uint64_t dir_walk_read(dir_walk_t *walk, const char *dir,
+                                    sigar_dir_stat_t *stats,
+                                    dir_walk_job_t **jobs)
+{
+    int dlen = strlen(dir), fd;
+    int incremental = walk->opts->incremental;
+    sigar_uint64_t entries = 0;
+    unsigned long nchildren = 0;
+    size_t clen = 0, csize = 0;
+    char *children = NULL;
+    dir_walk_job_t *job;
+    struct dirent *ent;
+    struct stat st, info;
+    DIR *dirp;
+
+    /* "/" and "dir/" join their entries without an extra slash */
+    while ((dlen > 1) && (dir[dlen-1] == '/')) {
+        dlen--;
+    }
+    if ((dlen == 1) && (dir[0] == '/')) {
+        dlen = 0;
+    }
+
+    if ((fd = open(dir, O_RDONLY|O_DIRECTORY)) < 0) {
+        return 0;
+    }
+
+    if (incremental) {
+        dir_usage_memo_t *memo;
+
+        if (fstat(fd, &st) != 0) {
+            incremental = 0;
+        }
+        else {
+            pthread_mutex_lock(&walk->lock);
+            if ((memo = dir_usage_memo_find(walk->sigar, &st))) {
+                char *name = memo->children;
+                unsigned long i;
+
+                *stats = memo->stats;
+                for (i=0; i<memo->nchildren; i++) {
+                    if ((job = dir_walk_job_new(dir, dlen, name))) {
+                        job->next = *jobs;
+                        *jobs = job;
+                    }
+                    name += strlen(name) + 1;
+                }
+            }
+            pthread_mutex_unlock(&walk->lock);
+
+            if (memo) {
+                close(fd);
+                return 1;
+            }
+        }
+    }
+
+    if (!(dirp = fdopendir(fd))) {
+        close(fd);
+        return 0;
+    }
+
+    while ((ent = readdir(dirp))) {
+        /* skip '.' and '..' */
+        if (IS_DOTDIR(ent->d_name)) {
+            continue;
+        }
+
+        entries++;
+
+        if (fstatat(fd, ent->d_name, &info, AT_SYMLINK_NOFOLLOW) != 0) {
+            continue;
+        }
+
+        stats->disk_usage += info.st_size;
+
+        switch (filetype_from_mode(info.st_mode)) {
+          case SIGAR_FILETYPE_REG:
+            ++stats->files;
+            break;
+          case SIGAR_FILETYPE_DIR:
+            ++stats->subdirs;
+            if ((job = dir_walk_job_new(dir, dlen, ent->d_name))) {
+                job->next = *jobs;
+                *jobs = job;
+            }
+            if (incremental) {
+                size_t nlen = strlen(ent->d_name) + 1;
+                char *ptr;
+
+                if (clen + nlen > csize) {
+                    csize = (csize + nlen) * 2;
+                    if (!(ptr = realloc(children, csize))) {
+                        incremental = 0;
+                        break;
+                    }
+                    children = ptr;
+                }
+                memcpy(children + clen, ent->d_name, nlen);
+                clen += nlen;
+                nchildren++;
+            }
+            break;
+          case SIGAR_FILETYPE_LNK:
+            ++stats->symlinks;
+            break;
+          case SIGAR_FILETYPE_CHR:
+            ++stats->chrdevs;
+            break;
+          case SIGAR_FILETYPE_BLK:
+            ++stats->blkdevs;
+            break;
+          case SIGAR_FILETYPE_SOCK:
+            ++stats->sockets;
+            break;
+          default:
+            break;
+        }
+    }
+
+    closedir(dirp);
+
+    if (incremental &&
+        ((time(NULL) - st.st_mtime) >= DIR_USAGE_RACY))
+    {
+        pthread_mutex_lock(&walk->lock);
+        dir_usage_memo_put(walk->sigar, &st, stats, nchildren, children);
+        pthread_mutex_unlock(&walk->lock);
+    }
+    else if (children) {
+        free(children);
+    }
+
+    return entries;
+}
+
+/* called locked */
+static int dir_walk_over_budget(dir_walk_t *walk)
+{
+    sigar_dir_usage_opts_t *opts = walk->opts;
+
+    if (opts->max_entries && (walk->entries >= opts->max_entries)) {
+        return 1;
+    }
+    if (walk->deadline && (sigar_time_now_millis() >= walk->deadline)) {
+        return 1;
+    }
+
+    return 0;
 }
+
+static void *dir_walk_main(void *data)
+{
+    dir_walk_t *walk = data;
+
+    pthread_mutex_lock(&walk->lock);
+
+    for (;;) {
+        dir_walk_job_t *job, *jobs = NULL;
+        sigar_dir_stat_t stats;
+        sigar_uint64_t entries;
+
+        while (!walk->jobs && walk->busy) {
+            pthread_cond_wait(&walk->cond, &walk->lock);
+        }
+        if (!walk->jobs) {
+            break;
+        }
+        if (dir_walk_over_budget(walk)) {
+            /* whoever gets here first drops what is left */
+            walk->status = ETIMEDOUT;
+            while ((job = walk->jobs)) {
+                walk->jobs = job->next;
+                free(job);
+            }
+            pthread_cond_broadcast(&walk->cond);
+            break;
+        }
+
+        job = walk->jobs;
+        walk->jobs = job->next;
+        walk->busy++;
+        pthread_mutex_unlock(&walk->lock);
+
+        SIGAR_ZERO(&stats);
+        entries = dir_walk_read(walk, job->path, &stats, &jobs);
+        free(job);
+
+        pthread_mutex_lock(&walk->lock);
+        walk->busy--;
+        walk->entries += entries;
+        dir_stat_add(&walk->totals, &stats);
+        if (jobs) {
+            while ((job = jobs)) {
+                jobs = job->next;
+                job->next = walk->jobs;
+                walk->jobs = job;
+            }
+            pthread_cond_broadcast(&walk->cond);
+        }
+        else if (!walk->busy) {
+            pthread_cond_broadcast(&walk->cond);
+        }
+    }
+
+    pthread_mutex_unlock(&walk->lock);
+
+    return NULL;
+}
+
+static int dir_usage_walk(sigar_t *sigar, const char *dir,
+                          sigar_dir_usage_opts_t *opts,
+                          sigar_dir_usage_t *dirusage)
+{
+    int i, started = 0, threads = opts->threads - 1;
+    dir_walk_job_t *job;
+    pthread_t *tids = NULL;
+    dir_walk_t walk;
+    struct stat st;
+
+    if (stat(dir, &st) != 0) {
+        return errno;
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        return ENOTDIR;
+    }
+    if (!(job = malloc(sizeof(*job) + strlen(dir)))) {
+        return ENOMEM;
+    }
+    strcpy(job->path, dir);
+    job->next = NULL;
+
+    SIGAR_ZERO(&walk);
+    walk.sigar = sigar;
+    walk.opts = opts;
+    walk.jobs = job;
+    walk.status = SIGAR_OK;
+    if (opts->max_time) {
+        walk.deadline = sigar_time_now_millis() + opts->max_time;
+    }
+    pthread_mutex_init(&walk.lock, NULL);
+    pthread_cond_init(&walk.cond, NULL);
+
+    if (threads > DIR_WALK_THREADS_MAX) {
+        threads = DIR_WALK_THREADS_MAX;
+    }
+    if ((threads > 0) && !(tids = malloc(threads * sizeof(*tids)))) {
+        threads = 0;
+    }
+    for (i=0; i<threads; i++) {
+        if (pthread_create(&tids[started], NULL, dir_walk_main, &walk) == 0) {
+            started++;
+        }
+    }
+
+    dir_walk_main(&walk);
+
+    for (i=0; i<started; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    if (tids) {
+        free(tids);
+    }
+
+    pthread_cond_destroy(&walk.cond);
+    pthread_mutex_destroy(&walk.lock);
+
+    *dirusage = walk.totals;
+    dirusage->total =
+        dirusage->files +
+        dirusage->subdirs +
+        dirusage->symlinks +
+        dirusage->chrdevs +
+        dirusage->blkdevs +
+        dirusage->sockets;
+
+    return walk.status;
+}
+
+#endif
+
+SIGAR_DECLARE(int) sigar_dir_stat_get(sigar_t *sigar,
+                                      const char *dir,
+                                      sigar_dir_stat_t *dirstats)
+{
+    SIGAR_ZERO(dirstats);
+    return dir_stat_get(sigar, dir, dirstats, 0);
+}
+
+SIGAR_DECLARE(int) sigar_dir_usage_get(sigar_t *sigar,
+                                       const char *dir,
+                                       sigar_dir_usage_t *dirusage)
+{
+    SIGAR_ZERO(dirusage);
+    return dir_stat_get(sigar, dir, dirusage, 1);
+}
+
+SIGAR_DECLARE(int) sigar_dir_usage_walk(sigar_t *sigar,
+                                        const char *dir,
+                                        sigar_dir_usage_opts_t *opts,
+                                        sigar_dir_usage_t *dirusage)
+{
+    SIGAR_ZERO(dirusage);
+#if defined(NETWARE)
+    return SIGAR_ENOTIMPL;
+#elif defined(WIN32)
+    /* no walker here, the whole tree on the caller */
+    return dir_stat_get(sigar, dir, dirusage, 1);
+#else
+    return dir_usage_walk(sigar, dir, opts, dirusage);
+#endif
+}
+
+/*
+ * sigar_file_watch: the kernel tells us which files changed instead of
+ * stat-ing every one of them on a timer.  a file that goes away keeps
+ * its id, it is looked for again on each wait and reported as
+ * SIGAR_FILE_WATCH_CREATE once it is back.
+ */
+
+#if defined(__linux__)
+#  include <sys/inotify.h>
+#  include <poll.h>
+#  define HAVE_FILE_WATCH
+#elif defined(DARWIN) || defined(__FreeBSD__) || defined(__OpenBSD__) || \
+    defined(__NetBSD__)
+#  include <sys/event.h>
+#  define HAVE_FILE_WATCH
+#endif
+
+#ifdef HAVE_FILE_WATCH
+
+#define FILE_WATCH_MAX 16
+#define FILE_WATCH_EVENTS 64
+
+typedef struct {
+    char *name;  /* NULL for a free slot */
+    int wd;      /* inotify watch or kqueue'd fd, -1 while gone */
+    long event;  /* index in the current batch, -1 if none */
+} file_watch_entry_t;
+
+/* entries are locked, the kernel wait is not so adds need not wait */
+struct sigar_file_watch_t {
+    int fd;      /* inotify or kqueue */
+    pthread_mutex_t lock;
+    int number;
+    int size;
+    file_watch_entry_t *entries;
+#ifdef __linux__
+    sigar_cache_t *wds; /* wd -> id + 1 */
+#endif
+};
+
+static void file_watch_event_add(sigar_file_watch_t *watch,
+                                 sigar_file_watch_event_list_t *events,
+                                 int id, int flags)
+{
+    file_watch_entry_t *entry = id >= 0 ? &watch->entries[id] : NULL;
+    sigar_file_watch_event_t *event;
+
+    /* one event per file per batch */
+    if (entry && (entry->event >= 0)) {
+        events->data[entry->event].flags |= flags;
+        return;
+    }
+
+    if (events->number >= events->size) {
+        void *data = realloc(events->data,
+                             sizeof(*(events->data)) *
+                             (events->size + FILE_WATCH_EVENTS));
+        if (!data) {
+            return;
+        }
+        events->data = data;
+        events->size += FILE_WATCH_EVENTS;
+    }
+
+    if (entry) {
+        entry->event = events->number;
+    }
+    event = &events->data[events->number++];
+    event->id = id;
+    event->flags = flags;
+}
+
+#ifdef __linux__
+
+#define FILE_WATCH_MASK \
+    (IN_MODIFY | IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF)
+
+/* the wds values are ids, nothing to free */
+static void file_watch_id_free(void *ptr)
+{
+}
+
+static int file_watch_os_create(sigar_file_watch_t *watch)
+{
+    if ((watch->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0) {
+        return errno;
+    }
+    watch->wds = sigar_cache_new(FILE_WATCH_MAX);
+    watch->wds->free_value = file_watch_id_free;
+
+    return SIGAR_OK;
+}
+
+static void file_watch_os_destroy(sigar_file_watch_t *watch)
+{
+    sigar_cache_destroy(watch->wds);
+    close(watch->fd);
+}
+
+static int file_watch_os_arm(sigar_file_watch_t *watch, int id)
+{
+    file_watch_entry_t *entry = &watch->entries[id];
+    sigar_cache_entry_t *ent;
+    int wd = inotify_add_watch(watch->fd, entry->name, FILE_WATCH_MASK);
+
+    if (wd < 0) {
+        return errno;
+    }
+
+    ent = sigar_cache_get(watch->wds, wd);
+    if (ent->value && ((long)ent->value != (id + 1))) {
+        /* another name for a file that is already watched */
+        return EEXIST;
+    }
+    ent->value = (void *)(long)(id + 1);
+    entry->wd = wd;
+
+    return SIGAR_OK;
+}
+
+static void file_watch_os_disarm(sigar_file_watch_t *watch, int id)
+{
+    file_watch_entry_t *entry = &watch->entries[id];
+
+    inotify_rm_watch(watch->fd, entry->wd);
+    sigar_cache_remove(watch->wds, entry->wd);
+    entry->wd = -1;
+}
+
+static int file_watch_os_read(sigar_file_watch_t *watch, int timeout,
+                              sigar_file_watch_event_list_t *events)
+{
+    char buf[4096]
+        __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    struct pollfd pfd;
+    int status;
+
+    pfd.fd = watch->fd;
+    pfd.events = POLLIN;
+
+    if ((status = poll(&pfd, 1, timeout)) < 0) {
+        return errno == EINTR ? SIGAR_OK : errno;
+    }
+    if (status == 0) {
+        return SIGAR_OK;
+    }
+
+    pthread_mutex_lock(&watch->lock);
+
+    for (;;) {
+        ssize_t len = read(watch->fd, buf, sizeof(buf));
+        char *ptr;
+
+        if (len <= 0) {
+            /* drained */
+            pthread_mutex_unlock(&watch->lock);
+            return SIGAR_OK;
+        }
+
+        for (ptr = buf; ptr < buf + len; ) {
+            struct inotify_event *ev = (struct inotify_event *)ptr;
+            sigar_cache_entry_t *ent;
+            int id, flags = 0;
+
+            ptr += sizeof(*ev) + ev->len;
+
+            if (ev->mask & IN_Q_OVERFLOW) {
+                file_watch_event_add(watch, events, -1,
+                                     SIGAR_FILE_WATCH_OVERFLOW);
+                continue;
+            }
+            if (!(ent = sigar_cache_find(watch->wds, ev->wd))) {
+                continue; /* removed since */
+            }
+            id = (int)(long)ent->value - 1;
+
+            if (ev->mask & IN_MODIFY) {
+                flags |= SIGAR_FILE_WATCH_MODIFY;
+            }
+            if (ev->mask & IN_ATTRIB) {
+                flags |= SIGAR_FILE_WATCH_ATTRIB;
+            }
+            if (ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+                flags |= SIGAR_FILE_WATCH_DELETE;
+                /* the name may point at a new file by the next wait */
+                file_watch_os_disarm(watch, id);
+            }
+
+            if (flags) {
+                file_watch_event_add(watch, events, id, flags);
+            }
+        }
+    }
+}
+
+#else /* kqueue */
+
+#ifdef DARWIN
+#  define FILE_WATCH_OPEN_FLAGS O_EVTONLY
+#else
+#  define FILE_WATCH_OPEN_FLAGS O_RDONLY
+#endif
+
+#define FILE_WATCH_FFLAGS \
+    (NOTE_WRITE | NOTE_EXTEND | NOTE_ATTRIB | NOTE_DELETE | NOTE_RENAME | \
+     NOTE_REVOKE)
+
+static int file_watch_os_create(sigar_file_watch_t *watch)
+{
+    if ((watch->fd = kqueue()) < 0) {
+        return errno;
+    }
+
+    return SIGAR_OK;
+}
+
+static void file_watch_os_destroy(sigar_file_watch_t *watch)
+{
+    close(watch->fd);
+}
+
+static int file_watch_os_arm(sigar_file_watch_t *watch, int id)
+{
+    file_watch_entry_t *entry = &watch->entries[id];
+    struct kevent kev;
+    int fd = open(entry->name, FILE_WATCH_OPEN_FLAGS);
+
+    if (fd < 0) {
+        return errno;
+    }
+
+    EV_SET(&kev, fd, EVFILT_VNODE, EV_ADD | EV_CLEAR,
+           FILE_WATCH_FFLAGS, 0, (void *)(long)id);
+
+    if (kevent(watch->fd, &kev, 1, NULL, 0, NULL) < 0) {
+        int status = errno;
+        close(fd);
+        return status;
+    }
+
+    entry->wd = fd;
+
+    return SIGAR_OK;
+}
+
+static void file_watch_os_disarm(sigar_file_watch_t *watch, int id)
+{
+    file_watch_entry_t *entry = &watch->entries[id];
+
+    /* closing the fd drops its kevent */
+    close(entry->wd);
+    entry->wd = -1;
+}
+
+static int file_watch_os_read(sigar_file_watch_t *watch, int timeout,
+                              sigar_file_watch_event_list_t *events)
+{
+    struct kevent kevs[FILE_WATCH_EVENTS];
+    struct timespec ts, *tsp = NULL;
+    int i, n;
+
+    if (timeout >= 0) {
+        ts.tv_sec = timeout / 1000;
+        ts.tv_nsec = (timeout % 1000) * 1000000;
+        tsp = &ts;
+    }
+
+    for (;;) {
+        if ((n = kevent(watch->fd, NULL, 0, kevs, FILE_WATCH_EVENTS,
+                        tsp)) < 0)
+        {
+            return errno == EINTR ? SIGAR_OK : errno;
+        }
+
+        pthread_mutex_lock(&watch->lock);
+        for (i=0; i<n; i++) {
+            int id = (int)(long)kevs[i].udata, flags = 0;
+
+            if (watch->entries[id].wd != (int)kevs[i].ident) {
+                continue; /* removed since */
+            }
+            if (kevs[i].fflags & (NOTE_WRITE | NOTE_EXTEND)) {
+                flags |= SIGAR_FILE_WATCH_MODIFY;
+            }
+            if (kevs[i].fflags & NOTE_ATTRIB) {
+                flags |= SIGAR_FILE_WATCH_ATTRIB;
+            }
+            if (kevs[i].fflags & (NOTE_DELETE | NOTE_RENAME | NOTE_REVOKE)) {
+                flags |= SIGAR_FILE_WATCH_DELETE;
+                file_watch_os_disarm(watch, id);
+            }
+
+            if (flags) {
+                file_watch_event_add(watch, events, id, flags);
+            }
+        }
+        pthread_mutex_unlock(&watch->lock);
+
+        if (n < FILE_WATCH_EVENTS) {
+            return SIGAR_OK;
+        }
+
+        /* more may be queued, take them without blocking */
+        ts.tv_sec = ts.tv_nsec = 0;
+        tsp = &ts;
+    }
+}
+
+#endif
+
+SIGAR_DECLARE(int) sigar_file_watch_create(sigar_file_watch_t **watch)
+{
+    sigar_file_watch_t *w = calloc(1, sizeof(*w));
+    int status;
+
+    if (!w) {
+        return ENOMEM;
+    }
+    if ((status = file_watch_os_create(w)) != SIGAR_OK) {
+        free(w);
+        return status;
+    }
+    pthread_mutex_init(&w->lock, NULL);
+
+    *watch = w;
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int) sigar_file_watch_destroy(sigar_file_watch_t *watch)
+{
+    int i;
+
+    for (i=0; i<watch->number; i++) {
+        file_watch_entry_t *entry = &watch->entries[i];
+
+        if (entry->name) {
+            if (entry->wd >= 0) {
+                file_watch_os_disarm(watch, i);
+            }
+            free(entry->name);
+        }
+    }
+
+    file_watch_os_destroy(watch);
+    pthread_mutex_destroy(&watch->lock);
+
+    if (watch->entries) {
+        free(watch->entries);
+    }
+    free(watch);
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int) sigar_file_watch_add(sigar_file_watch_t *watch,
+                                        const char *file, int *id)
+{
+    file_watch_entry_t *entry;
+    int i, status = SIGAR_OK;
+
+    pthread_mutex_lock(&watch->lock);
+
+    /* reuse the first free slot, ids stay small */
+    for (i=0; i<watch->number; i++) {
+        if (!watch->entries[i].name) {
+            break;
+        }
+    }
+    if (i == watch->size) {
+        void *entries = realloc(watch->entries,
+                                sizeof(*(watch->entries)) *
+                                (watch->size + FILE_WATCH_MAX));
+        if (!entries) {
+            pthread_mutex_unlock(&watch->lock);
+            return ENOMEM;
+        }
+        watch->entries = entries;
+        watch->size += FILE_WATCH_MAX;
+    }
+
+    entry = &watch->entries[i];
+    entry->wd = -1;
+    entry->event = -1;
+
+    if (!(entry->name = sigar_strdup(file))) {
+        status = ENOMEM;
+    }
+    else if ((status = file_watch_os_arm(watch, i)) != SIGAR_OK) {
+        free(entry->name);
+        entry->name = NULL;
+    }
+    else {
+        if (i == watch->number) {
+            watch->number++;
+        }
+        *id = i;
+    }
+
+    pthread_mutex_unlock(&watch->lock);
+
+    return status;
+}
+
+SIGAR_DECLARE(int) sigar_file_watch_remove(sigar_file_watch_t *watch,
+                                           int id)
+{
+    file_watch_entry_t *entry;
+
+    pthread_mutex_lock(&watch->lock);
+
+    if ((id < 0) || (id >= watch->number) ||
+        !(entry = &watch->entries[id])->name)
+    {
+        pthread_mutex_unlock(&watch->lock);
+        return EINVAL;
+    }
+
+    if (entry->wd >= 0) {
+        file_watch_os_disarm(watch, id);
+    }
+    free(entry->name);
+    entry->name = NULL;
+
+    pthread_mutex_unlock(&watch->lock);
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int)
+sigar_file_watch_wait(sigar_file_watch_t *watch, int timeout,
+                      sigar_file_watch_event_list_t *events)
+{
+    int i, status;
+
+    events->number = events->size = 0;
+    events->data = NULL;
+
+    pthread_mutex_lock(&watch->lock);
+
+    /* files that went away, a new one may be in their place */
+    for (i=0; i<watch->number; i++) {
+        file_watch_entry_t *entry = &watch->entries[i];
+
+        if (entry->name && (entry->wd < 0) &&
+            (file_watch_os_arm(watch, i) == SIGAR_OK))
+        {
+            file_watch_event_add(watch, events, i,
+                                 SIGAR_FILE_WATCH_CREATE);
+        }
+    }
+
+    pthread_mutex_unlock(&watch->lock);
+
+    status = file_watch_os_read(watch, events->number ? 0 : timeout,
+                                events);
+
+    pthread_mutex_lock(&watch->lock);
+    for (i=0; i<watch->number; i++) {
+        watch->entries[i].event = -1;
+    }
+    pthread_mutex_unlock(&watch->lock);
+
+    if (status != SIGAR_OK) {
+        sigar_file_watch_event_list_destroy(events);
+    }
+
+    return status;
+}
+
+#else
+
+SIGAR_DECLARE(int) sigar_file_watch_create(sigar_file_watch_t **watch)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+SIGAR_DECLARE(int) sigar_file_watch_destroy(sigar_file_watch_t *watch)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+SIGAR_DECLARE(int) sigar_file_watch_add(sigar_file_watch_t *watch,
+                                        const char *file, int *id)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+SIGAR_DECLARE(int) sigar_file_watch_remove(sigar_file_watch_t *watch,
+                                           int id)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+SIGAR_DECLARE(int)
+sigar_file_watch_wait(sigar_file_watch_t *watch, int timeout,
+                      sigar_file_watch_event_list_t *events)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+#endif /* HAVE_FILE_WATCH */
+
+SIGAR_DECLARE(int)
+sigar_file_watch_event_list_destroy(sigar_file_watch_event_list_t *events)
+{
+    if (events->size) {
+        free(events->data);
+        events->number = events->size = 0;
+    }
+
+    return SIGAR_OK;
+}
+
+/*
+ * sigar_file_tail: the fd stays open across reads, new bytes are
+ * pread straight into the caller's buffer.  a rotated file is read
+ * to its end before the new one under the same name is opened, so
+ * nothing written before the rotation is lost.
+ */
+
+#if !defined(WIN32) && !defined(NETWARE)
+
+struct sigar_file_tail_t {
+    char *name;
+    int fd;      /* -1 while the name is missing after a rotation */
+    sigar_uint64_t inode;
+    sigar_uint64_t device;
+    sigar_uint64_t offset;
+};
+
+static int file_tail_fd_open(sigar_file_tail_t *tail, struct stat *st)
+{
+    int fd = open(tail->name, O_RDONLY);
+
+    if (fd < 0) {
+        return errno;
+    }
+    if (fstat(fd, st) != 0) {
+        int status = errno;
+        close(fd);
+        return status;
+    }
+
+    tail->fd = fd;
+    tail->inode = st->st_ino;
+    tail->device = st->st_dev;
+    tail->offset = 0;
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int) sigar_file_tail_open(sigar_t *sigar,
+                                        const char *file,
+                                        sigar_int64_t offset,
+                                        sigar_file_tail_t **tail)
+{
+    sigar_file_tail_t *t = calloc(1, sizeof(*t));
+    struct stat st;
+    int status;
+
+    if (!t) {
+        return ENOMEM;
+    }
+    if (!(t->name = sigar_strdup(file))) {
+        free(t);
+        return ENOMEM;
+    }
+    if ((status = file_tail_fd_open(t, &st)) != SIGAR_OK) {
+        free(t->name);
+        free(t);
+        return status;
+    }
+
+    if ((offset < 0) || ((sigar_uint64_t)offset > (sigar_uint64_t)st.st_size)) {
+        t->offset = st.st_size;
+    }
+    else {
+        t->offset = offset;
+    }
+
+    *tail = t;
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int) sigar_file_tail_close(sigar_file_tail_t *tail)
+{
+    if (tail->fd >= 0) {
+        close(tail->fd);
+    }
+    free(tail->name);
+    free(tail);
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(sigar_uint64_t)
+sigar_file_tail_offset(sigar_file_tail_t *tail)
+{
+    return tail->offset;
+}
+
+SIGAR_DECLARE(int) sigar_file_tail_read(sigar_t *sigar,
+                                        sigar_file_tail_t *tail,
+                                        char *buf, size_t len,
+                                        size_t *nread, int *flags)
+{
+    sigar_file_attrs_t attrs;
+    struct stat st;
+    ssize_t n;
+
+    *nread = 0;
+    *flags = 0;
+
+    if (tail->fd < 0) {
+        if (file_tail_fd_open(tail, &st) != SIGAR_OK) {
+            return SIGAR_OK;
+        }
+        *flags |= SIGAR_FILE_TAIL_ROTATED;
+    }
+
+    for (;;) {
+        if ((n = pread(tail->fd, buf, len, tail->offset)) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno;
+        }
+        if (n > 0) {
+            tail->offset += n;
+            *nread = n;
+            return SIGAR_OK;
+        }
+
+        /* at the end of what we have open, look for truncation... */
+        if ((fstat(tail->fd, &st) == 0) &&
+            ((sigar_uint64_t)st.st_size < tail->offset))
+        {
+            *flags |= SIGAR_FILE_TAIL_TRUNCATED;
+            tail->offset = 0;
+            continue;
+        }
+
+        /* ...and for another file under the name */
+        if ((sigar_file_attrs_get(sigar, tail->name, &attrs) != SIGAR_OK) ||
+            ((attrs.inode == tail->inode) && (attrs.device == tail->device)))
+        {
+            /* nothing new, or renamed away and not recreated yet */
+            return SIGAR_OK;
+        }
+
+        close(tail->fd);
+        if (file_tail_fd_open(tail, &st) != SIGAR_OK) {
+            /* gone again in between, the next read looks for it */
+            tail->fd = -1;
+            tail->offset = 0;
+            return SIGAR_OK;
+        }
+        *flags |= SIGAR_FILE_TAIL_ROTATED;
+    }
+}
+
+#else
+
+SIGAR_DECLARE(int) sigar_file_tail_open(sigar_t *sigar,
+                                        const char *file,
+                                        sigar_int64_t offset,
+                                        sigar_file_tail_t **tail)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+SIGAR_DECLARE(int) sigar_file_tail_close(sigar_file_tail_t *tail)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+SIGAR_DECLARE(sigar_uint64_t)
+sigar_file_tail_offset(sigar_file_tail_t *tail)
+{
+    return 0;
+}
+
+SIGAR_DECLARE(int) sigar_file_tail_read(sigar_t *sigar,
+                                        sigar_file_tail_t *tail,
+                                        char *buf, size_t len,
+                                        size_t *nread, int *flags)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+#endif
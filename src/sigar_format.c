@@ -23,9 +23,11 @@
 #include "sigar_util.h"
 #include "sigar_os.h"
 #include "sigar_format.h"
+#include "sigar_sampler.h"
 
 #include <errno.h>
 #include <stdio.h>
+#include <sys/stat.h>
 
 #ifndef WIN32
 #include <netinet/in.h>
@@ -35,23 +37,97 @@
 #endif
 #include <pwd.h>
 #include <grp.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
 
 /* sysconf(_SC_GET{PW,GR}_R_SIZE_MAX) */
 #define R_SIZE_MAX 2048
 
+/*
+ * getpw*_r/getgr*_r may be a network round trip (ldap, sssd), so
+ * answers are kept for sigar->cred_name_expire millis, including
+ * ENOENT, keyed by id in sigar->user_names and sigar->group_names.
+ */
+typedef struct {
+    sigar_int64_t expires;
+    int status;
+    char name[1];
+} cred_name_t;
+
+#define CRED_NAME_KEY(id) ((sigar_uint64_t)(unsigned int)(id))
+
+static int cred_name_find(sigar_t *sigar, sigar_cache_t *cache, int id,
+                          char *buf, int buflen)
+{
+    sigar_cache_entry_t *entry;
+    cred_name_t *cname;
+
+    if (!cache ||
+        !(entry = sigar_cache_find(cache, CRED_NAME_KEY(id))) ||
+        !(cname = entry->value) ||
+        (cname->expires < sigar_time_now_millis()))
+    {
+        return -1;
+    }
+
+    if (cname->status == SIGAR_OK) {
+        strncpy(buf, cname->name, buflen);
+        buf[buflen-1] = '\0';
+    }
+
+    return cname->status;
+}
+
+static void cred_name_put(sigar_t *sigar, sigar_cache_t **cache, int id,
+                          int status, const char *name)
+{
+    sigar_cache_entry_t *entry;
+    cred_name_t *cname;
+    size_t len = name ? strlen(name) : 0;
+
+    if (sigar->cred_name_expire == 0) {
+        return;
+    }
+
+    if (!*cache) {
+        *cache = sigar_expired_cache_new(512, sigar->cred_name_expire,
+                                         sigar->cred_name_expire);
+    }
+
+    entry = sigar_cache_get(*cache, CRED_NAME_KEY(id));
+    if (entry->value) {
+        free(entry->value);
+    }
+    entry->value = cname = malloc(sizeof(*cname) + len);
+
+    cname->expires = sigar_time_now_millis() + sigar->cred_name_expire;
+    cname->status = status;
+    memcpy(cname->name, name ? name : "", len + 1);
+}
+
 int sigar_user_name_get(sigar_t *sigar, int uid, char *buf, int buflen)
 {
     struct passwd *pw = NULL;
-    /* XXX cache lookup */
-
+    int status;
 # ifdef HAVE_GETPWUID_R
     struct passwd pwbuf;
     char buffer[R_SIZE_MAX];
+# endif
 
+    if ((status = cred_name_find(sigar, sigar->user_names,
+                                 uid, buf, buflen)) != -1)
+    {
+        return status;
+    }
+
+# ifdef HAVE_GETPWUID_R
     if (getpwuid_r(uid, &pwbuf, buffer, sizeof(buffer), &pw) != 0) {
-        return errno;
+        return errno; /* not cached, may be transient */
     }
     if (!pw) {
+        cred_name_put(sigar, &sigar->user_names, uid, ENOENT, NULL);
         return ENOENT;
     }
 # else
@@ -60,6 +136,8 @@ int sigar_user_name_get(sigar_t *sigar, int uid, char *buf, int buflen)
     }
 # endif
 
+    cred_name_put(sigar, &sigar->user_names, uid, SIGAR_OK, pw->pw_name);
+
     strncpy(buf, pw->pw_name, buflen);
     buf[buflen-1] = '\0';
 
@@ -69,12 +147,19 @@ int sigar_user_name_get(sigar_t *sigar, int uid, char *buf, int buflen)
 int sigar_group_name_get(sigar_t *sigar, int gid, char *buf, int buflen)
 {
     struct group *gr;
-    /* XXX cache lookup */
-
+    int status;
 # ifdef HAVE_GETGRGID_R
     struct group grbuf;
     char buffer[R_SIZE_MAX];
+# endif
 
+    if ((status = cred_name_find(sigar, sigar->group_names,
+                                 gid, buf, buflen)) != -1)
+    {
+        return status;
+    }
+
+# ifdef HAVE_GETGRGID_R
     if (getgrgid_r(gid, &grbuf, buffer, sizeof(buffer), &gr) != 0) {
         return errno;
     }
@@ -97,9 +182,61 @@ int sigar_group_name_get(sigar_t *sigar, int gid, char *buf, int buflen)
     }
     buf[buflen-1] = '\0';
 
+    cred_name_put(sigar, &sigar->group_names, gid, SIGAR_OK, buf);
+
+    return SIGAR_OK;
+}
+
+/* name:passwd:id:... as in /etc/passwd and /etc/group */
+static int cred_name_preload(sigar_t *sigar, sigar_cache_t **cache,
+                             const char *file)
+{
+    char line[1024];
+    FILE *fp;
+
+    if (!(fp = fopen(file, "r"))) {
+        return errno;
+    }
+
+    while (fgets(line, sizeof(line), fp)) {
+        char *name = line, *ptr, *id;
+
+        if ((*line == '#') || (*line == '+') || (*line == '-')) {
+            continue; /* comment or nis compat entry */
+        }
+        if (!(ptr = strchr(name, ':'))) {
+            continue;
+        }
+        *ptr = '\0';
+        if (!(id = strchr(ptr + 1, ':')) || !sigar_isdigit(*++id)) {
+            continue;
+        }
+
+        cred_name_put(sigar, cache, (int)strtoul(id, NULL, 10),
+                      SIGAR_OK, name);
+    }
+
+    fclose(fp);
+
     return SIGAR_OK;
 }
 
+SIGAR_DECLARE(int) sigar_cred_name_preload(sigar_t *sigar)
+{
+    int status;
+
+    if (sigar->cred_name_expire == 0) {
+        return SIGAR_OK;
+    }
+
+    status = cred_name_preload(sigar, &sigar->user_names, "/etc/passwd");
+    if (status != SIGAR_OK) {
+        return status;
+    }
+
+    return cred_name_preload(sigar, &sigar->group_names, "/etc/group");
+}
+
 int sigar_user_id_get(sigar_t *sigar, const char *name, int *uid)
 {
     /* XXX cache lookup */
@@ -122,6 +259,13 @@ int sigar_user_id_get(sigar_t *sigar, const char *name, int *uid)
     return SIGAR_OK;
 }
 
+#else
+
+SIGAR_DECLARE(int) sigar_cred_name_preload(sigar_t *sigar)
+{
+    return SIGAR_ENOTIMPL;
+}
+
 #endif /* WIN32 */
 
 static char *sigar_error_string(int err)
@@ -260,6 +404,194 @@ SIGAR_DECLARE(char *) sigar_format_size(sigar_uint64_t size, char *buf)
 }
 
 
+SIGAR_DECLARE(int) sigar_cpu_perc_list_destroy(sigar_cpu_perc_list_t *percs)
+{
+    if (percs->size) {
+        free(percs->data);
+        percs->number = percs->size = 0;
+    }
+    return SIGAR_OK;
+}
+
+typedef struct {
+    sigar_int64_t timestamp;
+    sigar_cpu_t cpu;
+    unsigned long ncpus;
+    unsigned long size;
+    sigar_cpu_t *cpus;
+} cpu_sample_t;
+
+struct sigar_cpu_sampler_t {
+    int flags;
+    int depth;
+    int number; /* samples held */
+    int newest;
+    cpu_sample_t *samples;
+};
+
+SIGAR_DECLARE(int) sigar_cpu_sampler_create(sigar_cpu_sampler_t **samplerp,
+                                            int flags, int depth)
+{
+    sigar_cpu_sampler_t *sampler;
+
+    if ((depth < 2) || !(flags & (SIGAR_SAMPLER_CPU|SIGAR_SAMPLER_CPU_LIST))) {
+        return EINVAL;
+    }
+
+    *samplerp = sampler = calloc(1, sizeof(*sampler));
+    if (!sampler) {
+        return ENOMEM;
+    }
+    sampler->samples = calloc(depth, sizeof(*sampler->samples));
+    if (!sampler->samples) {
+        free(sampler);
+        *samplerp = NULL;
+        return ENOMEM;
+    }
+
+    sampler->flags = flags;
+    sampler->depth = depth;
+    sampler->newest = -1;
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int) sigar_cpu_sampler_destroy(sigar_cpu_sampler_t *sampler)
+{
+    int i;
+
+    for (i=0; i<sampler->depth; i++) {
+        if (sampler->samples[i].cpus) {
+            free(sampler->samples[i].cpus);
+        }
+    }
+    free(sampler->samples);
+    free(sampler);
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int) sigar_cpu_sampler_add(sigar_cpu_sampler_t *sampler,
+                                         sigar_int64_t timestamp,
+                                         sigar_cpu_t *cpu,
+                                         sigar_cpu_list_t *cpulist)
+{
+    int next = (sampler->newest + 1) % sampler->depth;
+    cpu_sample_t *sample = &sampler->samples[next];
+
+    if (((sampler->flags & SIGAR_SAMPLER_CPU) && !cpu) ||
+        ((sampler->flags & SIGAR_SAMPLER_CPU_LIST) && !cpulist))
+    {
+        return EINVAL;
+    }
+
+    if (sampler->flags & SIGAR_SAMPLER_CPU_LIST) {
+        if (sample->size < cpulist->number) {
+            sigar_cpu_t *cpus =
+                realloc(sample->cpus, sizeof(*cpus) * cpulist->number);
+
+            if (!cpus) {
+                return ENOMEM;
+            }
+            sample->cpus = cpus;
+            sample->size = cpulist->number;
+        }
+        memcpy(sample->cpus, cpulist->data,
+               sizeof(*sample->cpus) * cpulist->number);
+        sample->ncpus = cpulist->number;
+    }
+    if (sampler->flags & SIGAR_SAMPLER_CPU) {
+        sample->cpu = *cpu;
+    }
+    sample->timestamp = timestamp;
+
+    sampler->newest = next;
+    if (sampler->number < sampler->depth) {
+        sampler->number++;
+    }
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int) sigar_cpu_sampler_update(sigar_t *sigar,
+                                            sigar_cpu_sampler_t *sampler)
+{
+    sigar_int64_t timestamp = sigar_time_now_millis();
+    sigar_cpu_t cpu;
+    sigar_cpu_list_t cpulist;
+    int status;
+
+    if (sampler->flags & SIGAR_SAMPLER_CPU) {
+        if ((status = sigar_cpu_get(sigar, &cpu)) != SIGAR_OK) {
+            return status;
+        }
+    }
+    if (!(sampler->flags & SIGAR_SAMPLER_CPU_LIST)) {
+        return sigar_cpu_sampler_add(sampler, timestamp, &cpu, NULL);
+    }
+
+    if ((status = sigar_cpu_list_get(sigar, &cpulist)) != SIGAR_OK) {
+        return status;
+    }
+    status = sigar_cpu_sampler_add(sampler, timestamp, &cpu, &cpulist);
+    sigar_cpu_list_destroy(sigar, &cpulist);
+
+    return status;
+}
+
+SIGAR_DECLARE(int) sigar_cpu_sampler_perc_get(sigar_cpu_sampler_t *sampler,
+                                              sigar_uint64_t window,
+                                              sigar_cpu_perc_t *total,
+                                              sigar_cpu_perc_list_t *percs)
+{
+    cpu_sample_t *curr, *prev;
+    unsigned long i, ncpus;
+    int n, ix;
+
+    if (sampler->number < 2) {
+        return ENOENT;
+    }
+
+    curr = &sampler->samples[sampler->newest];
+
+    /* walk back from the previous tick until the window is covered */
+    for (n=1; n<sampler->number; n++) {
+        ix = (sampler->newest - n + sampler->depth) % sampler->depth;
+        prev = &sampler->samples[ix];
+        if ((sigar_uint64_t)(curr->timestamp - prev->timestamp) >= window) {
+            break;
+        }
+    }
+
+    if (total && (sampler->flags & SIGAR_SAMPLER_CPU)) {
+        sigar_cpu_perc_calculate(&prev->cpu, &curr->cpu, total);
+    }
+
+    if (percs && (sampler->flags & SIGAR_SAMPLER_CPU_LIST)) {
+        /* cpus may have come or gone in between */
+        ncpus = curr->ncpus < prev->ncpus ? curr->ncpus : prev->ncpus;
+
+        if (percs->size < ncpus) {
+            sigar_cpu_perc_t *data =
+                realloc(percs->data, sizeof(*data) * ncpus);
+
+            if (!data) {
+                return ENOMEM;
+            }
+            percs->data = data;
+            percs->size = ncpus;
+        }
+
+        for (i=0; i<ncpus; i++) {
+            sigar_cpu_perc_calculate(&prev->cpus[i], &curr->cpus[i],
+                                     &percs->data[i]);
+        }
+        percs->number = ncpus;
+    }
+
+    return SIGAR_OK;
+}
+
 SIGAR_DECLARE(int) sigar_uptime_string(sigar_t *sigar, 
                                        sigar_uptime_t *uptime,
                                        char *buffer,
@@ -572,81 +904,399 @@ SIGAR_DECLARE(char *) sigar_net_interface_flags_to_string(sigar_uint64_t flags,
 #define NET_SERVICES_FILE "/etc/services"
 #endif
 
-static int net_services_parse(sigar_cache_t *names, char *type)
+/* how often the file's mtime is looked at */
+#define NET_SERVICES_CHECK (60 * SIGAR_MSEC)
+
+#define NET_SERVICES_KEY(port, udp) (((port) << 1) | (udp))
+
+/*
+ * one port -> name table for tcp and udp, shared by every sigar_t.
+ * entries are sorted by key for a binary search and names point
+ * into one string pool.  a table replaced after the file changed
+ * stays allocated, callers may still hold names from it.
+ */
+typedef struct {
+    sigar_uint32_t key;
+    char *name;
+} net_service_t;
+
+typedef struct net_services_t net_services_t;
+
+struct net_services_t {
+    net_services_t *retired;
+    time_t mtime;
+    sigar_uint64_t checked;
+    unsigned long number;
+    unsigned long protocols[2]; /* tcp, udp */
+    net_service_t *entries;
+    char *names;
+    sigar_uint64_t hits, misses;
+};
+
+static net_services_t *net_services = NULL;
+
+#ifdef WIN32
+static CRITICAL_SECTION net_services_mutex;
+static volatile LONG net_services_mutex_init = 0;
+
+static void net_services_lock(void)
 {
-    FILE *fp;
-    char buffer[8192], *ptr;
-    char *file;
+    if (InterlockedCompareExchange(&net_services_mutex_init, 1, 0) == 0) {
+        InitializeCriticalSection(&net_services_mutex);
+        net_services_mutex_init = 2;
+    }
+    else {
+        while (net_services_mutex_init != 2) {
+            Sleep(0);
+        }
+    }
+    EnterCriticalSection(&net_services_mutex);
+}
 
+#  define net_services_unlock() LeaveCriticalSection(&net_services_mutex)
+#else
+static pthread_mutex_t net_services_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+#  define net_services_lock() pthread_mutex_lock(&net_services_mutex)
+#  define net_services_unlock() pthread_mutex_unlock(&net_services_mutex)
+#endif
+
+static char *net_services_file(void)
+{
+    char *file;
 
     if (!(file = getenv("SIGAR_NET_SERVICES_FILE"))) {
         file = NET_SERVICES_FILE;
     }
 
-    if (!(fp = fopen(file, "r"))) {
+    return file;
+}
+
+static int net_services_mtime(time_t *mtime)
+{
+    struct stat sb;
+
+    if (stat(net_services_file(), &sb) != 0) {
         return errno;
     }
+    *mtime = sb.st_mtime;
 
-    while ((ptr = fgets(buffer, sizeof(buffer), fp))) {
-        int port;
-        char name[256], proto[56];
-        sigar_cache_entry_t *entry;
+    return SIGAR_OK;
+}
 
-        while (sigar_isspace(*ptr)) {
+/* maps the whole file, *size may be 0 */
+static int net_services_map(char **data, size_t *size, time_t *mtime)
+{
+#ifdef WIN32
+    FILE *fp;
+    struct stat sb;
+    char *file = net_services_file();
+
+    if (stat(file, &sb) != 0) {
+        return errno;
+    }
+    if (!(fp = fopen(file, "rb"))) {
+        return errno;
+    }
+    *data = malloc(sb.st_size + 1);
+    *size = fread(*data, 1, sb.st_size, fp);
+    *mtime = sb.st_mtime;
+    fclose(fp);
+#else
+    struct stat sb;
+    int fd = open(net_services_file(), O_RDONLY);
+
+    if (fd < 0) {
+        return errno;
+    }
+    if (fstat(fd, &sb) != 0) {
+        int status = errno;
+        close(fd);
+        return status;
+    }
+    *size = sb.st_size;
+    *mtime = sb.st_mtime;
+    *data = NULL;
+    if (*size) {
+        *data = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (*data == MAP_FAILED) {
+            int status = errno;
+            close(fd);
+            return status;
+        }
+    }
+    close(fd);
+#endif
+
+    return SIGAR_OK;
+}
+
+static void net_services_unmap(char *data, size_t size)
+{
+#ifdef WIN32
+    free(data);
+#else
+    if (size) {
+        munmap(data, size);
+    }
+#endif
+}
+
+static int net_service_compare(const void *v1, const void *v2)
+{
+    const net_service_t *s1 = v1, *s2 = v2;
+
+    if (s1->key != s2->key) {
+        return s1->key < s2->key ? -1 : 1;
+    }
+    /* pool order is file order, the first line for a port wins */
+    return s1->name < s2->name ? -1 : (s1->name > s2->name);
+}
+
+#define NET_SERVICES_ISSPACE(c) \
+    ((c) == ' ' || (c) == '\t' || (c) == '\r' || (c) == '\n')
+
+/* "name port/proto [aliases] [# comment]", tcp and udp in one pass */
+static int net_services_parse(net_services_t *table,
+                              const char *data, size_t size)
+{
+    const char *ptr = data, *end = data + size;
+    char *pool;
+    unsigned long i, j, size_entries = 0;
+
+    /* no name is longer than the file */
+    table->names = pool = malloc(size + 1);
+    if (!pool) {
+        return ENOMEM;
+    }
+
+    while (ptr < end) {
+        const char *name, *line_end;
+        unsigned long name_len, port = 0;
+        int udp, digits = 0;
+
+        if (!(line_end = memchr(ptr, '\n', end - ptr))) {
+            line_end = end;
+        }
+
+        while ((ptr < line_end) && NET_SERVICES_ISSPACE(*ptr)) {
             ++ptr;
         }
-        if ((*ptr == '#') || (*ptr == '\0')) {
+        name = ptr;
+        while ((ptr < line_end) && !NET_SERVICES_ISSPACE(*ptr)) {
+            ++ptr;
+        }
+        name_len = ptr - name;
+        if ((name_len == 0) || (*name == '#')) {
+            ptr = line_end + 1;
             continue;
         }
 
-        if (sscanf(ptr, "%s%d/%s", name, &port, proto) != 3) {
+        while ((ptr < line_end) && NET_SERVICES_ISSPACE(*ptr)) {
+            ++ptr;
+        }
+        while ((ptr < line_end) && sigar_isdigit(*ptr)) {
+            port = port * 10 + (*ptr++ - '0');
+            ++digits;
+        }
+        if (!digits || (digits > 5) || (port > 0xffff) ||
+            ((line_end - ptr) < 4) || (*ptr++ != '/'))
+        {
+            ptr = line_end + 1;
             continue;
         }
-        if (!strEQ(type, proto)) {
+
+        if (strnEQ(ptr, "tcp", 3)) {
+            udp = 0;
+        }
+        else if (strnEQ(ptr, "udp", 3)) {
+            udp = 1;
+        }
+        else {
+            ptr = line_end + 1;
             continue;
         }
+        ptr += 3;
+        if ((ptr < line_end) && !NET_SERVICES_ISSPACE(*ptr) && (*ptr != '#')) {
+            ptr = line_end + 1;
+            continue; /* e.g. tcp6 */
+        }
 
-        entry = sigar_cache_get(names, port);
-        if (!entry->value) {
-            entry->value = strdup(name);
+        if (table->number >= size_entries) {
+            net_service_t *entries;
+            size_entries = size_entries ? size_entries * 2 : 256;
+            entries = realloc(table->entries,
+                              size_entries * sizeof(*entries));
+            if (!entries) {
+                return ENOMEM;
+            }
+            table->entries = entries;
         }
+
+        memcpy(pool, name, name_len);
+        pool[name_len] = '\0';
+        table->entries[table->number].key = NET_SERVICES_KEY(port, udp);
+        table->entries[table->number].name = pool;
+        table->number++;
+        pool += name_len + 1;
+
+        ptr = line_end + 1;
     }
 
-    fclose(fp);
+    if (table->number) {
+        qsort(table->entries, table->number,
+              sizeof(*table->entries), net_service_compare);
+    }
+
+    /* drop duplicate ports, keeping the first */
+    for (i=0, j=0; i<table->number; i++) {
+        if (j && (table->entries[j-1].key == table->entries[i].key)) {
+            continue;
+        }
+        table->entries[j++] = table->entries[i];
+        table->protocols[table->entries[i].key & 1]++;
+    }
+    table->number = j;
+
     return SIGAR_OK;
 }
 
+static void net_services_free(net_services_t *table)
+{
+    if (table->entries) {
+        free(table->entries);
+    }
+    if (table->names) {
+        free(table->names);
+    }
+    free(table);
+}
+
+static net_services_t *net_services_load(void)
+{
+    net_services_t *table = calloc(1, sizeof(*table));
+    char *data;
+    size_t size;
+
+    if (!table) {
+        return NULL;
+    }
+
+    /* a missing file is an empty table, looked at again later */
+    if (net_services_map(&data, &size, &table->mtime) == SIGAR_OK) {
+        int status = net_services_parse(table, data, size);
+        net_services_unmap(data, size);
+        if (status != SIGAR_OK) {
+            net_services_free(table);
+            return NULL;
+        }
+    }
+    table->checked = sigar_time_now_millis();
+
+    return table;
+}
+
+/* called locked */
+static net_services_t *net_services_get(void)
+{
+    net_services_t *table = net_services;
+
+    if (table) {
+        sigar_uint64_t now = sigar_time_now_millis();
+        time_t mtime;
+
+        if ((now - table->checked) < NET_SERVICES_CHECK) {
+            return table;
+        }
+        table->checked = now;
+        if ((net_services_mtime(&mtime) != SIGAR_OK) ||
+            (mtime == table->mtime))
+        {
+            return table;
+        }
+    }
+
+    if ((table = net_services_load())) {
+        table->retired = net_services;
+        net_services = table;
+    }
+
+    return net_services;
+}
+
 SIGAR_DECLARE(char *)sigar_net_services_name_get(sigar_t *sigar,
                                                  int protocol, unsigned long port)
 {
-    sigar_cache_entry_t *entry;
-    sigar_cache_t **names;
-    char *pname;
+    net_services_t *table;
+    sigar_uint32_t key;
+    char *name = NULL;
 
     switch (protocol) {
       case SIGAR_NETCONN_TCP:
-        names = &sigar->net_services_tcp;
-        pname = "tcp";
+        key = NET_SERVICES_KEY(port, 0);
         break;
       case SIGAR_NETCONN_UDP:
-        names = &sigar->net_services_udp;
-        pname = "udp";
+        key = NET_SERVICES_KEY(port, 1);
         break;
       default:
         return NULL;
     }
 
-    if (*names == NULL) {
-        *names = sigar_cache_new(1024);
-        net_services_parse(*names, pname);
+    if (port > 0xffff) {
+        return NULL;
     }
 
-    if ((entry = sigar_cache_find(*names, port))) {
-        return (char *)entry->value;
+    net_services_lock();
+
+    if ((table = net_services_get())) {
+        unsigned long lo = 0, hi = table->number;
+
+        while (lo < hi) {
+            unsigned long mid = lo + (hi - lo) / 2;
+
+            if (table->entries[mid].key < key) {
+                lo = mid + 1;
+            }
+            else {
+                hi = mid;
+            }
+        }
+        if ((lo < table->number) && (table->entries[lo].key == key)) {
+            name = table->entries[lo].name;
+            table->hits++;
+        }
+        else {
+            table->misses++;
+        }
     }
-    else {
-        return NULL;
+
+    net_services_unlock();
+
+    return name;
+}
+
+int sigar_net_services_stats(sigar_t *sigar, int protocol,
+                             sigar_cache_stats_t *stats)
+{
+    net_services_t *table;
+
+    SIGAR_ZERO(stats);
+
+    net_services_lock();
+
+    if ((table = net_services)) {
+        int udp = (protocol == SIGAR_NETCONN_UDP);
+
+        stats->size = stats->count = table->protocols[udp];
+        stats->hits = table->hits;
+        stats->misses = table->misses;
+        stats->bytes = sizeof(*table) +
+            table->number * sizeof(*table->entries);
     }
+
+    net_services_unlock();
+
+    return SIGAR_OK;
 }
 
 SIGAR_DECLARE(int) sigar_cpu_perc_calculate(sigar_cpu_t *prev,
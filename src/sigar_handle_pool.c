@@ -0,0 +1,798 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef WIN32
+#include <pthread.h>
+#include <sys/time.h>
+#endif
+
+#include "sigar.h"
+#include "sigar_private.h"
+#include "sigar_util.h"
+#include "sigar_os.h"
+
+#ifdef WIN32
+typedef DWORD pool_thread_t;
+#  define POOL_SELF() GetCurrentThreadId()
+#  define POOL_THREAD_EQ(a, b) ((a) == (b))
+#else
+typedef pthread_t pool_thread_t;
+#  define POOL_SELF() pthread_self()
+#  define POOL_THREAD_EQ(a, b) pthread_equal(a, b)
+#endif
+
+typedef struct {
+    sigar_t *sigar;
+    pool_thread_t owner; /* thread that last put it back */
+} pool_handle_t;
+
+struct sigar_handle_pool_t {
+    int max;
+    int opened;
+    int idle;            /* handles[0..idle) are free, most recent last */
+    pool_handle_t *handles;
+#ifdef WIN32
+    CRITICAL_SECTION lock;
+    HANDLE available;    /* counts handles that may still be taken */
+#else
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+#endif
+};
+
+SIGAR_DECLARE(int) sigar_handle_pool_create(sigar_handle_pool_t **pool,
+                                            int max)
+{
+    sigar_handle_pool_t *p;
+
+    if (max <= 0) {
+        return EINVAL;
+    }
+
+    p = calloc(1, sizeof(*p));
+    if (!p) {
+        return ENOMEM;
+    }
+    p->handles = calloc(max, sizeof(*p->handles));
+    if (!p->handles) {
+        free(p);
+        return ENOMEM;
+    }
+    p->max = max;
+
+#ifdef WIN32
+    InitializeCriticalSection(&p->lock);
+    p->available = CreateSemaphore(NULL, max, max, NULL);
+#else
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->cond, NULL);
+#endif
+
+    *pool = p;
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int) sigar_handle_pool_destroy(sigar_handle_pool_t *pool)
+{
+    int i;
+
+    for (i=0; i<pool->idle; i++) {
+        sigar_close(pool->handles[i].sigar);
+    }
+
+#ifdef WIN32
+    CloseHandle(pool->available);
+    DeleteCriticalSection(&pool->lock);
+#else
+    pthread_cond_destroy(&pool->cond);
+    pthread_mutex_destroy(&pool->lock);
+#endif
+
+    free(pool->handles);
+    free(pool);
+
+    return SIGAR_OK;
+}
+
+#ifdef WIN32
+#  define POOL_LOCK(pool) EnterCriticalSection(&(pool)->lock)
+#  define POOL_UNLOCK(pool) LeaveCriticalSection(&(pool)->lock)
+#else
+#  define POOL_LOCK(pool) pthread_mutex_lock(&(pool)->lock)
+#  define POOL_UNLOCK(pool) pthread_mutex_unlock(&(pool)->lock)
+#endif
+
+/* takes an idle handle, called locked with idle > 0 */
+static sigar_t *pool_handle_take(sigar_handle_pool_t *pool)
+{
+    pool_thread_t self = POOL_SELF();
+    int i = pool->idle - 1, j;
+    sigar_t *sigar;
+
+    for (j=i; j>=0; j--) {
+        if (POOL_THREAD_EQ(pool->handles[j].owner, self)) {
+            i = j;
+            break;
+        }
+    }
+
+    sigar = pool->handles[i].sigar;
+    pool->handles[i] = pool->handles[--pool->idle];
+
+    return sigar;
+}
+
+SIGAR_DECLARE(int) sigar_handle_pool_get(sigar_handle_pool_t *pool,
+                                         sigar_t **sigar)
+{
+    int status;
+
+#ifdef WIN32
+    WaitForSingleObject(pool->available, INFINITE);
+    POOL_LOCK(pool);
+#else
+    POOL_LOCK(pool);
+    while ((pool->idle == 0) && (pool->opened == pool->max)) {
+        pthread_cond_wait(&pool->cond, &pool->lock);
+    }
+#endif
+
+    if (pool->idle > 0) {
+        *sigar = pool_handle_take(pool);
+        POOL_UNLOCK(pool);
+        return SIGAR_OK;
+    }
+
+    /* reserve the slot, sigar_open can take a while */
+    pool->opened++;
+    POOL_UNLOCK(pool);
+
+    if ((status = sigar_open(sigar)) != SIGAR_OK) {
+        POOL_LOCK(pool);
+        pool->opened--;
+#ifdef WIN32
+        ReleaseSemaphore(pool->available, 1, NULL);
+#else
+        pthread_cond_signal(&pool->cond);
+#endif
+        POOL_UNLOCK(pool);
+    }
+
+    return status;
+}
+
+SIGAR_DECLARE(void) sigar_handle_pool_put(sigar_handle_pool_t *pool,
+                                          sigar_t *sigar)
+{
+    pool_handle_t *handle;
+
+    POOL_LOCK(pool);
+
+    handle = &pool->handles[pool->idle++];
+    handle->sigar = sigar;
+    handle->owner = POOL_SELF();
+
+#ifdef WIN32
+    ReleaseSemaphore(pool->available, 1, NULL);
+#else
+    pthread_cond_signal(&pool->cond);
+#endif
+
+    POOL_UNLOCK(pool);
+}
+
+SIGAR_DECLARE(int) sigar_proc_scan_threads_set(sigar_t *sigar, int threads)
+{
+    if (threads < 0) {
+        return EINVAL;
+    }
+
+    /* handles are opened on the next scan, for the new size */
+    if (sigar->proc_scan_pool) {
+        sigar_handle_pool_destroy(sigar->proc_scan_pool);
+        sigar->proc_scan_pool = NULL;
+    }
+
+    sigar->proc_scan_threads = threads;
+
+    return SIGAR_OK;
+}
+
+typedef struct {
+    sigar_t *sigar;
+    sigar_parallel_func_t func;
+    void *data;
+    unsigned long number;
+    unsigned long next;
+    int status;
+#ifdef WIN32
+    CRITICAL_SECTION lock;
+#else
+    pthread_mutex_t lock;
+#endif
+} parallel_walk_t;
+
+typedef struct {
+    parallel_walk_t *walk;
+    int worker;
+} parallel_worker_t;
+
+#ifdef WIN32
+#  define WALK_LOCK(walk) EnterCriticalSection(&(walk)->lock)
+#  define WALK_UNLOCK(walk) LeaveCriticalSection(&(walk)->lock)
+#else
+#  define WALK_LOCK(walk) pthread_mutex_lock(&(walk)->lock)
+#  define WALK_UNLOCK(walk) pthread_mutex_unlock(&(walk)->lock)
+#endif
+
+static void parallel_walk_run(parallel_walk_t *walk, sigar_t *sigar,
+                              int worker)
+{
+    for (;;) {
+        unsigned long start, end;
+        int status;
+
+        WALK_LOCK(walk);
+        if ((walk->status != SIGAR_OK) || (walk->next >= walk->number)) {
+            WALK_UNLOCK(walk);
+            return;
+        }
+        start = walk->next;
+        walk->next += SIGAR_PARALLEL_CHUNK;
+        WALK_UNLOCK(walk);
+
+        end = start + SIGAR_PARALLEL_CHUNK;
+        if (end > walk->number) {
+            end = walk->number;
+        }
+
+        status = walk->func(sigar, walk->data, worker, start, end);
+
+        if (status != SIGAR_OK) {
+            WALK_LOCK(walk);
+            if (walk->status == SIGAR_OK) {
+                walk->status = status;
+            }
+            WALK_UNLOCK(walk);
+            return;
+        }
+    }
+}
+
+#ifdef WIN32
+static DWORD WINAPI parallel_worker_main(LPVOID data)
+#else
+static void *parallel_worker_main(void *data)
+#endif
+{
+    parallel_worker_t *worker = data;
+    parallel_walk_t *walk = worker->walk;
+    sigar_t *sigar;
+
+    if (sigar_handle_pool_get(walk->sigar->proc_scan_pool,
+                              &sigar) == SIGAR_OK)
+    {
+        /* settings a walk may depend on */
+        sigar->ptql_re_impl = walk->sigar->ptql_re_impl;
+        sigar->ptql_re_data = walk->sigar->ptql_re_data;
+        sigar->proc_cache_expire = walk->sigar->proc_cache_expire;
+
+        parallel_walk_run(walk, sigar, worker->worker);
+
+        sigar_handle_pool_put(walk->sigar->proc_scan_pool, sigar);
+    }
+    /* else the other workers pick up the slack */
+
+#ifdef WIN32
+    return 0;
+#else
+    return NULL;
+#endif
+}
+
+int sigar_parallel_walk(sigar_t *sigar, unsigned long number,
+                        sigar_parallel_func_t func, void *data)
+{
+    int i, started = 0, threads = sigar->proc_scan_threads - 1;
+    parallel_walk_t walk;
+    parallel_worker_t *workers;
+#ifdef WIN32
+    HANDLE *tids;
+#else
+    pthread_t *tids;
+#endif
+
+    walk.sigar = sigar;
+    walk.func = func;
+    walk.data = data;
+    walk.number = number;
+    walk.next = 0;
+    walk.status = SIGAR_OK;
+
+    /* no more threads than there are slices for them to take */
+    if ((unsigned long)threads >= (number / SIGAR_PARALLEL_CHUNK)) {
+        threads = (int)(number / SIGAR_PARALLEL_CHUNK);
+        if ((threads * SIGAR_PARALLEL_CHUNK) == number) {
+            threads--;
+        }
+    }
+
+    /* sized for the widest walk, handles only open when first taken */
+    if ((threads > 0) && !sigar->proc_scan_pool &&
+        (sigar_handle_pool_create(&sigar->proc_scan_pool,
+                                  sigar->proc_scan_threads - 1) != SIGAR_OK))
+    {
+        threads = 0;
+    }
+
+    workers = threads > 0 ? malloc(threads * sizeof(*workers)) : NULL;
+    tids = threads > 0 ? malloc(threads * sizeof(*tids)) : NULL;
+    if (!workers || !tids) {
+        threads = 0;
+    }
+
+#ifdef WIN32
+    InitializeCriticalSection(&walk.lock);
+#else
+    pthread_mutex_init(&walk.lock, NULL);
+#endif
+
+    for (i=0; i<threads; i++) {
+        workers[started].walk = &walk;
+        workers[started].worker = started + 1;
+#ifdef WIN32
+        tids[started] = CreateThread(NULL, 0, parallel_worker_main,
+                                     &workers[started], 0, NULL);
+        if (tids[started]) {
+            started++;
+        }
+#else
+        if (pthread_create(&tids[started], NULL, parallel_worker_main,
+                           &workers[started]) == 0)
+        {
+            started++;
+        }
+#endif
+    }
+
+    parallel_walk_run(&walk, sigar, 0);
+
+    for (i=0; i<started; i++) {
+#ifdef WIN32
+        WaitForSingleObject(tids[i], INFINITE);
+        CloseHandle(tids[i]);
+#else
+        pthread_join(tids[i], NULL);
+#endif
+    }
+
+#ifdef WIN32
+    DeleteCriticalSection(&walk.lock);
+#else
+    pthread_mutex_destroy(&walk.lock);
+#endif
+
+    if (workers) {
+        free(workers);
+    }
+    if (tids) {
+        free(tids);
+    }
+
+    return walk.status;
+}
+
+#define FS_USAGE_QUEUED    0
+#define FS_USAGE_RUNNING   1
+#define FS_USAGE_DONE      2
+#define FS_USAGE_CANCELLED 3
+
+typedef struct {
+    char *dir_name;
+    int state;
+    int status;
+    sigar_int64_t start;
+    sigar_file_system_usage_t usage;
+} fs_usage_job_t;
+
+/*
+ * shared by the caller and its workers, the last one out frees it.
+ * a worker stuck in statvfs on a dead mount can outlive the call,
+ * and the handle too, so none of this points back into either.
+ */
+typedef struct {
+    int refs;
+    unsigned long number;
+    unsigned long next;
+    fs_usage_job_t *jobs;
+#ifdef WIN32
+    CRITICAL_SECTION lock;
+    HANDLE cond; /* auto-reset, set by each job that finishes */
+#else
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+#endif
+} fs_usage_batch_t;
+
+/* a statvfs left running by an earlier call, see fs_usage_hung_find */
+typedef struct fs_usage_hung_t {
+    fs_usage_batch_t *batch;
+    unsigned long index;
+    struct fs_usage_hung_t *next;
+} fs_usage_hung_t;
+
+#ifdef WIN32
+#  define BATCH_LOCK(batch) EnterCriticalSection(&(batch)->lock)
+#  define BATCH_UNLOCK(batch) LeaveCriticalSection(&(batch)->lock)
+#  define BATCH_BROADCAST(batch) SetEvent((batch)->cond)
+#else
+#  define BATCH_LOCK(batch) pthread_mutex_lock(&(batch)->lock)
+#  define BATCH_UNLOCK(batch) pthread_mutex_unlock(&(batch)->lock)
+#  define BATCH_BROADCAST(batch) pthread_cond_broadcast(&(batch)->cond)
+#endif
+
+static void fs_usage_batch_release(fs_usage_batch_t *batch)
+{
+    unsigned long i;
+    int refs;
+
+    BATCH_LOCK(batch);
+    refs = --batch->refs;
+    BATCH_UNLOCK(batch);
+
+    if (refs) {
+        return;
+    }
+
+    for (i=0; i<batch->number; i++) {
+        if (batch->jobs[i].dir_name) {
+            free(batch->jobs[i].dir_name);
+        }
+    }
+#ifdef WIN32
+    CloseHandle(batch->cond);
+    DeleteCriticalSection(&batch->lock);
+#else
+    pthread_cond_destroy(&batch->cond);
+    pthread_mutex_destroy(&batch->lock);
+#endif
+    free(batch->jobs);
+    free(batch);
+}
+
+#ifdef WIN32
+static DWORD WINAPI fs_usage_worker_main(LPVOID data)
+#else
+static void *fs_usage_worker_main(void *data)
+#endif
+{
+    fs_usage_batch_t *batch = data;
+
+    BATCH_LOCK(batch);
+    for (;;) {
+        fs_usage_job_t *job;
+        sigar_file_system_usage_t usage;
+        int status;
+
+        while ((batch->next < batch->number) &&
+               (batch->jobs[batch->next].state != FS_USAGE_QUEUED))
+        {
+            batch->next++;
+        }
+        if (batch->next >= batch->number) {
+            break;
+        }
+
+        job = &batch->jobs[batch->next++];
+        job->state = FS_USAGE_RUNNING;
+        job->start = sigar_time_now_millis();
+        BATCH_UNLOCK(batch);
+
+        /* sigar_statvfs does not touch the handle */
+        status = sigar_statvfs(NULL, job->dir_name, &usage);
+
+        BATCH_LOCK(batch);
+        if (job->state == FS_USAGE_RUNNING) {
+            job->status = status;
+            job->usage = usage;
+        }
+        /* else the caller gave up on it, ETIMEDOUT stands */
+        job->state = FS_USAGE_DONE;
+        BATCH_BROADCAST(batch);
+    }
+    BATCH_UNLOCK(batch);
+
+    fs_usage_batch_release(batch);
+
+#ifdef WIN32
+    return 0;
+#else
+    return NULL;
+#endif
+}
+
+/* called locked */
+static int fs_usage_worker_start(fs_usage_batch_t *batch)
+{
+#ifdef WIN32
+    HANDLE thread;
+
+    batch->refs++;
+    thread = CreateThread(NULL, 0, fs_usage_worker_main, batch, 0, NULL);
+    if (!thread) {
+        batch->refs--;
+        return GetLastError();
+    }
+    CloseHandle(thread); /* detached */
+
+    return 0;
+#else
+    pthread_attr_t attr;
+    pthread_t tid;
+    int status;
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+    batch->refs++;
+    status = pthread_create(&tid, &attr, fs_usage_worker_main, batch);
+    if (status != 0) {
+        batch->refs--;
+    }
+
+    pthread_attr_destroy(&attr);
+
+    return status;
+#endif
+}
+
+/*
+ * forgets the statvfs calls that have since returned, then looks for
+ * one still running on dir_name: asking again would only park another
+ * thread behind it.
+ */
+static int fs_usage_hung_find(sigar_t *sigar, const char *dir_name)
+{
+    fs_usage_hung_t **prev = (fs_usage_hung_t **)&sigar->fs_usage_hung;
+    fs_usage_hung_t *hung;
+    int found = 0;
+
+    while ((hung = *prev)) {
+        fs_usage_job_t *job = &hung->batch->jobs[hung->index];
+        int done, match;
+
+        BATCH_LOCK(hung->batch);
+        done = (job->state == FS_USAGE_DONE);
+        BATCH_UNLOCK(hung->batch);
+        /* dir_name is only written before the workers start */
+        match = strEQ(job->dir_name, dir_name);
+
+        if (done) {
+            *prev = hung->next;
+            fs_usage_batch_release(hung->batch);
+            free(hung);
+            continue;
+        }
+        if (match) {
+            found = 1;
+        }
+        prev = &hung->next;
+    }
+
+    return found;
+}
+
+static void fs_usage_hung_add(sigar_t *sigar, fs_usage_batch_t *batch,
+                              unsigned long index)
+{
+    fs_usage_hung_t *hung = malloc(sizeof(*hung));
+
+    if (!hung) {
+        return;
+    }
+
+    /* called locked */
+    batch->refs++;
+    hung->batch = batch;
+    hung->index = index;
+    hung->next = sigar->fs_usage_hung;
+    sigar->fs_usage_hung = hung;
+}
+
+/* called locked, until a job finishes or ms have passed */
+static void fs_usage_batch_wait(fs_usage_batch_t *batch, sigar_int64_t ms)
+{
+#ifdef WIN32
+    /* a job finished while we were not waiting leaves the event set */
+    LeaveCriticalSection(&batch->lock);
+    WaitForSingleObject(batch->cond, (DWORD)ms);
+    EnterCriticalSection(&batch->lock);
+#else
+    struct timeval tv;
+    struct timespec ts;
+
+    gettimeofday(&tv, NULL);
+    ts.tv_sec = tv.tv_sec + (ms / 1000);
+    ts.tv_nsec = (tv.tv_usec * 1000) + ((ms % 1000) * 1000000);
+    if (ts.tv_nsec >= 1000000000) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+    pthread_cond_timedwait(&batch->cond, &batch->lock, &ts);
+#endif
+}
+
+/* runs the batch, returns once every job is done or out of time */
+static void fs_usage_batch_run(sigar_t *sigar, fs_usage_batch_t *batch,
+                               int threads, sigar_int64_t timeout)
+{
+    unsigned long i;
+    int workers = 0; /* started and not lost to a dead mount */
+
+    BATCH_LOCK(batch);
+
+    for (; workers<threads; workers++) {
+        if (fs_usage_worker_start(batch) != 0) {
+            break;
+        }
+    }
+
+    if (!workers) {
+        /* no threads to be had, no deadline either */
+        BATCH_UNLOCK(batch);
+        for (i=0; i<batch->number; i++) {
+            fs_usage_job_t *job = &batch->jobs[i];
+            if (job->state == FS_USAGE_QUEUED) {
+                job->status = sigar_statvfs(NULL, job->dir_name,
+                                            &job->usage);
+                job->state = FS_USAGE_DONE;
+            }
+        }
+        return;
+    }
+
+    for (;;) {
+        sigar_int64_t now = sigar_time_now_millis(), wakeup = now + timeout;
+        int queued = 0, running = 0, lost = 0;
+
+        for (i=0; i<batch->number; i++) {
+            fs_usage_job_t *job = &batch->jobs[i];
+
+            if (job->state == FS_USAGE_QUEUED) {
+                queued++;
+            }
+            else if (job->state == FS_USAGE_RUNNING) {
+                if (job->start + timeout <= now) {
+                    /* its worker is gone, until statvfs returns */
+                    job->state = FS_USAGE_CANCELLED;
+                    job->status = ETIMEDOUT;
+                    fs_usage_hung_add(sigar, batch, i);
+                    lost++;
+                }
+                else {
+                    running++;
+                    if (job->start + timeout < wakeup) {
+                        wakeup = job->start + timeout;
+                    }
+                }
+            }
+        }
+
+        if (!queued && !running) {
+            break;
+        }
+
+        /* replace the workers that were lost to dead mounts */
+        workers -= lost;
+        for (; (lost > 0) && (workers < queued); lost--) {
+            if (fs_usage_worker_start(batch) != 0) {
+                break;
+            }
+            workers++;
+        }
+        if (queued && (workers <= 0)) {
+            /* every worker is stuck and none can be added */
+            for (i=0; i<batch->number; i++) {
+                fs_usage_job_t *job = &batch->jobs[i];
+                if (job->state == FS_USAGE_QUEUED) {
+                    job->state = FS_USAGE_CANCELLED;
+                    job->status = ETIMEDOUT;
+                }
+            }
+            break;
+        }
+
+        fs_usage_batch_wait(batch, wakeup - now);
+    }
+
+    BATCH_UNLOCK(batch);
+}
+
+void sigar_fs_usage_hung_free(sigar_t *sigar)
+{
+    fs_usage_hung_t *hung = sigar->fs_usage_hung;
+
+    while (hung) {
+        fs_usage_hung_t *next = hung->next;
+        fs_usage_batch_release(hung->batch);
+        free(hung);
+        hung = next;
+    }
+    sigar->fs_usage_hung = NULL;
+}
+
+int sigar_fs_usage_batch_get(sigar_t *sigar,
+                             sigar_file_system_list_t *fslist,
+                             int timeout,
+                             sigar_file_system_usage_list_t *usagelist)
+{
+    unsigned long i;
+    fs_usage_batch_t *batch;
+    int threads;
+
+    batch = calloc(1, sizeof(*batch));
+    if (batch) {
+        batch->jobs = calloc(fslist->number, sizeof(*batch->jobs));
+    }
+    if (!batch || !batch->jobs) {
+        if (batch) {
+            free(batch);
+        }
+        return ENOMEM;
+    }
+#ifdef WIN32
+    InitializeCriticalSection(&batch->lock);
+    batch->cond = CreateEvent(NULL, FALSE, FALSE, NULL);
+#else
+    pthread_mutex_init(&batch->lock, NULL);
+    pthread_cond_init(&batch->cond, NULL);
+#endif
+    batch->refs = 1;
+    batch->number = fslist->number;
+
+    for (i=0, threads=0; i<fslist->number; i++) {
+        fs_usage_job_t *job = &batch->jobs[i];
+        char *dir_name = fslist->data[i].dir_name;
+
+        if (fs_usage_hung_find(sigar, dir_name)) {
+            job->state = FS_USAGE_CANCELLED;
+            job->status = ETIMEDOUT;
+        }
+        else if (!(job->dir_name = sigar_strdup(dir_name))) {
+            job->state = FS_USAGE_CANCELLED;
+            job->status = ENOMEM;
+        }
+        else if (threads < SIGAR_FS_USAGE_THREADS) {
+            threads++;
+        }
+    }
+
+    fs_usage_batch_run(sigar, batch, threads, timeout);
+
+    BATCH_LOCK(batch);
+    for (i=0; i<fslist->number; i++) {
+        usagelist->data[i].status = batch->jobs[i].status;
+        usagelist->data[i].usage = batch->jobs[i].usage;
+    }
+    BATCH_UNLOCK(batch);
+
+    fs_usage_batch_release(batch);
+
+    return SIGAR_OK;
+}
@@ -0,0 +1,340 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * call counts, latency and file access of the public getters.  with
+ * -DSIGAR_INSTRUMENT the library's own definitions are renamed (see
+ * sigar_instrument.h) and the symbols below take their place; a handle
+ * which never turns instrumentation on pays one branch per call.
+ * without it every function here is SIGAR_ENOTIMPL.
+ */
+
+#define SIGAR_INSTRUMENT_WRAPPERS
+
+#include <errno.h>
+
+#include "sigar.h"
+#include "sigar_private.h"
+#include "sigar_util.h"
+#include "sigar_os.h"
+
+#ifdef SIGAR_INSTRUMENT
+
+#ifndef WIN32
+#include <time.h>
+#endif
+
+/*
+ * log-linear buckets as in HdrHistogram: below 8ns one per value,
+ * then 8 per power of two, so a bucket is at most 1/8th wide.
+ * anything from 2^40ns (~18 minutes) on lands in the last one.
+ */
+#define HIST_SUB_BITS 3
+#define HIST_SUB      (1 << HIST_SUB_BITS)
+#define HIST_MAX_BITS 40
+#define HIST_BUCKETS  ((HIST_MAX_BITS - HIST_SUB_BITS + 1) * HIST_SUB)
+
+typedef struct {
+    sigar_uint64_t calls;
+    sigar_uint64_t errors;
+    sigar_uint64_t total_time;
+    sigar_uint64_t max_time;
+    sigar_uint64_t opens;
+    sigar_uint64_t reads;
+    sigar_uint64_t histogram[HIST_BUCKETS];
+} instrument_entry_t;
+
+struct sigar_instrument_t {
+    int enabled;
+    instrument_entry_t entries[SIGAR_INSTRUMENT_MAX];
+};
+
+#define SIGAR_INSTRUMENT_GETTER(name, params, args) #name,
+
+static const char *instrument_names[] = {
+    SIGAR_INSTRUMENT_GETTERS
+    NULL
+};
+
+#undef SIGAR_INSTRUMENT_GETTER
+
+SIGAR_INSTRUMENT_TLS sigar_instrument_frame_t *sigar_instrument_frame = NULL;
+
+static sigar_uint64_t instrument_now(void)
+{
+#ifdef WIN32
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER now;
+
+    if (!freq.QuadPart) {
+        QueryPerformanceFrequency(&freq);
+    }
+    QueryPerformanceCounter(&now);
+
+    return (sigar_uint64_t)(now.QuadPart *
+                            ((double)SIGAR_NSEC / freq.QuadPart));
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return SIGAR_SEC2NANO(ts.tv_sec) + ts.tv_nsec;
+#endif
+}
+
+static int hist_index(sigar_uint64_t value)
+{
+    int msb = 0, shift;
+
+    if (value < HIST_SUB) {
+        return (int)value;
+    }
+    if (value >> HIST_MAX_BITS) {
+        return HIST_BUCKETS - 1;
+    }
+
+#ifdef __GNUC__
+    msb = 63 - __builtin_clzll(value);
+#else
+    while (value >> (msb + 1)) {
+        msb++;
+    }
+#endif
+
+    shift = msb - HIST_SUB_BITS;
+
+    return ((shift + 1) * HIST_SUB) +
+        (int)((value >> shift) & (HIST_SUB - 1));
+}
+
+/* highest value which lands in the bucket */
+static sigar_uint64_t hist_value(int index)
+{
+    int shift, sub;
+
+    if (index < HIST_SUB) {
+        return index;
+    }
+
+    shift = (index / HIST_SUB) - 1;
+    sub = index % HIST_SUB;
+
+    return ((sigar_uint64_t)(HIST_SUB + sub + 1) << shift) - 1;
+}
+
+static sigar_uint64_t hist_percentile(instrument_entry_t *entry,
+                                      int percentile)
+{
+    sigar_uint64_t want, seen = 0;
+    int i;
+
+    if (entry->calls == 0) {
+        return 0;
+    }
+
+    want = ((entry->calls * percentile) + 99) / 100;
+
+    for (i=0; i<HIST_BUCKETS; i++) {
+        seen += entry->histogram[i];
+        if (seen >= want) {
+            sigar_uint64_t value = hist_value(i);
+            return value < entry->max_time ? value : entry->max_time;
+        }
+    }
+
+    return entry->max_time;
+}
+
+static void instrument_record(sigar_t *sigar, int id, int status,
+                              sigar_instrument_frame_t *frame,
+                              sigar_uint64_t start)
+{
+    instrument_entry_t *entry = &sigar->instrument->entries[id];
+    sigar_uint64_t elapsed = instrument_now() - start;
+
+    entry->calls++;
+    if (status != SIGAR_OK) {
+        entry->errors++;
+    }
+    entry->total_time += elapsed;
+    if (elapsed > entry->max_time) {
+        entry->max_time = elapsed;
+    }
+    entry->opens += frame->opens;
+    entry->reads += frame->reads;
+    entry->histogram[hist_index(elapsed)]++;
+}
+
+#define SIGAR_INSTRUMENT_GETTER(name, params, args) \
+SIGAR_DECLARE(int) sigar_##name params \
+{ \
+    sigar_instrument_frame_t frame, *prev; \
+    sigar_uint64_t start; \
+    int status; \
+\
+    if (!sigar->instrument || !sigar->instrument->enabled) { \
+        return sigar_##name##_uninstrumented args; \
+    } \
+\
+    frame.opens = frame.reads = 0; \
+    prev = sigar_instrument_frame; \
+    sigar_instrument_frame = &frame; \
+    start = instrument_now(); \
+\
+    status = sigar_##name##_uninstrumented args; \
+\
+    sigar_instrument_frame = prev; \
+    instrument_record(sigar, SIGAR_INSTRUMENT_ID_##name, \
+                      status, &frame, start); \
+\
+    return status; \
+}
+
+SIGAR_INSTRUMENT_GETTERS
+
+#undef SIGAR_INSTRUMENT_GETTER
+
+static void instrument_stats(sigar_t *sigar, int id,
+                             sigar_instrumentation_stats_t *stats)
+{
+    instrument_entry_t *entry;
+
+    SIGAR_ZERO(stats);
+
+    if (!sigar->instrument) {
+        return;
+    }
+
+    entry = &sigar->instrument->entries[id];
+
+    stats->calls      = entry->calls;
+    stats->errors     = entry->errors;
+    stats->total_time = entry->total_time;
+    stats->max_time   = entry->max_time;
+    stats->p50        = hist_percentile(entry, 50);
+    stats->p90        = hist_percentile(entry, 90);
+    stats->p99        = hist_percentile(entry, 99);
+    stats->opens      = entry->opens;
+    stats->reads      = entry->reads;
+}
+
+SIGAR_DECLARE(int) sigar_instrumentation_set(sigar_t *sigar, int enable)
+{
+    if (!enable) {
+        if (sigar->instrument) {
+            sigar->instrument->enabled = 0;
+        }
+        return SIGAR_OK;
+    }
+
+    if (!sigar->instrument) {
+        sigar->instrument = malloc(sizeof(*sigar->instrument));
+        if (!sigar->instrument) {
+            return ENOMEM;
+        }
+    }
+
+    SIGAR_ZERO(sigar->instrument);
+    sigar->instrument->enabled = 1;
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int)
+sigar_instrumentation_get(sigar_t *sigar,
+                          sigar_instrumentation_list_t *instrumentation)
+{
+    int i;
+
+    instrumentation->number = 0;
+    instrumentation->size = SIGAR_INSTRUMENT_MAX;
+    instrumentation->data =
+        malloc(sizeof(*(instrumentation->data)) * instrumentation->size);
+
+    if (!instrumentation->data) {
+        instrumentation->size = 0;
+        return ENOMEM;
+    }
+
+    for (i=0; i<SIGAR_INSTRUMENT_MAX; i++) {
+        sigar_instrumentation_t *entry =
+            &instrumentation->data[instrumentation->number++];
+
+        SIGAR_SSTRCPY(entry->name, instrument_names[i]);
+        instrument_stats(sigar, i, &entry->stats);
+    }
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int)
+sigar_instrumentation_stats_get(sigar_t *sigar,
+                                const char *name,
+                                sigar_instrumentation_stats_t *stats)
+{
+    int i;
+
+    for (i=0; i<SIGAR_INSTRUMENT_MAX; i++) {
+        if (strEQ(instrument_names[i], name)) {
+            instrument_stats(sigar, i, stats);
+            return SIGAR_OK;
+        }
+    }
+
+    return ENOENT;
+}
+
+#else
+
+SIGAR_DECLARE(int) sigar_instrumentation_set(sigar_t *sigar, int enable)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+SIGAR_DECLARE(int)
+sigar_instrumentation_get(sigar_t *sigar,
+                          sigar_instrumentation_list_t *instrumentation)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+SIGAR_DECLARE(int)
+sigar_instrumentation_stats_get(sigar_t *sigar,
+                                const char *name,
+                                sigar_instrumentation_stats_t *stats)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+#endif /* SIGAR_INSTRUMENT */
+
+SIGAR_DECLARE(int)
+sigar_instrumentation_list_destroy(sigar_t *sigar,
+                                   sigar_instrumentation_list_t *instrumentation)
+{
+    if (instrumentation->size) {
+        free(instrumentation->data);
+        instrumentation->number = instrumentation->size = 0;
+    }
+
+    return SIGAR_OK;
+}
+
+void sigar_instrument_free(sigar_t *sigar)
+{
+    if (sigar->instrument) {
+        free(sigar->instrument);
+        sigar->instrument = NULL;
+    }
+}
@@ -0,0 +1,136 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "sigar.h"
+#include "sigar_private.h"
+#include "sigar_util.h"
+
+#include <errno.h>
+
+/*
+ * fixed size object pool, objects are carved out of slabs and
+ * recycled through a free list, slabs are only released when the
+ * pool is destroyed.
+ */
+
+typedef union sigar_pool_slab_t sigar_pool_slab_t;
+
+union sigar_pool_slab_t {
+    sigar_pool_slab_t *next;
+    sigar_uint64_t align; /* objects follow the header */
+};
+
+struct sigar_pool_t {
+    size_t size;
+    unsigned int per_slab;
+    sigar_pool_slab_t *slabs;
+    void *free_list;
+    unsigned long nslabs;
+    unsigned long used;
+};
+
+#define POOL_ALIGN sizeof(sigar_uint64_t)
+
+#define POOL_NEXT(obj) \
+    (*(void **)(obj))
+
+sigar_pool_t *sigar_pool_new(size_t size, unsigned int per_slab)
+{
+    sigar_pool_t *pool = malloc(sizeof(*pool));
+
+    if (size < sizeof(void *)) {
+        size = sizeof(void *);
+    }
+    pool->size = (size + POOL_ALIGN - 1) & ~(POOL_ALIGN - 1);
+    pool->per_slab = per_slab ? per_slab : 1;
+    pool->slabs = NULL;
+    pool->free_list = NULL;
+    pool->nslabs = 0;
+    pool->used = 0;
+
+    return pool;
+}
+
+static int sigar_pool_grow(sigar_pool_t *pool)
+{
+    unsigned int i;
+    char *obj;
+    sigar_pool_slab_t *slab =
+        malloc(sizeof(*slab) + (pool->size * pool->per_slab));
+
+    if (!slab) {
+        return ENOMEM;
+    }
+
+    slab->next = pool->slabs;
+    pool->slabs = slab;
+    pool->nslabs++;
+
+    /* thread the new objects onto the free list, in address order */
+    obj = (char *)(slab + 1) + (pool->size * pool->per_slab);
+    for (i=0; i<pool->per_slab; i++) {
+        obj -= pool->size;
+        POOL_NEXT(obj) = pool->free_list;
+        pool->free_list = obj;
+    }
+
+    return SIGAR_OK;
+}
+
+void *sigar_pool_alloc(sigar_pool_t *pool)
+{
+    void *obj;
+
+    if (!pool->free_list && (sigar_pool_grow(pool) != SIGAR_OK)) {
+        return NULL;
+    }
+
+    obj = pool->free_list;
+    pool->free_list = POOL_NEXT(obj);
+    pool->used++;
+
+    return obj;
+}
+
+void sigar_pool_free(sigar_pool_t *pool, void *obj)
+{
+    POOL_NEXT(obj) = pool->free_list;
+    pool->free_list = obj;
+    pool->used--;
+}
+
+size_t sigar_pool_size(sigar_pool_t *pool)
+{
+    return pool->size;
+}
+
+size_t sigar_pool_bytes(sigar_pool_t *pool)
+{
+    return sizeof(*pool) +
+        pool->nslabs *
+        (sizeof(sigar_pool_slab_t) + (pool->size * pool->per_slab));
+}
+
+void sigar_pool_destroy(sigar_pool_t *pool)
+{
+    sigar_pool_slab_t *slab = pool->slabs;
+
+    while (slab) {
+        sigar_pool_slab_t *next = slab->next;
+        free(slab);
+        slab = next;
+    }
+
+    free(pool);
+}
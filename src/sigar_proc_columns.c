@@ -0,0 +1,626 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * every column of a sigar_proc_columns_t is a slice of one block, so
+ * a scan over a field touches only that field's cache lines.  the
+ * kernels are plain loops without branches on the values, which gcc,
+ * clang and msvc turn into vector code for whatever the build targets;
+ * no intrinsics, so nothing here is tied to one instruction set.
+ */
+
+#include <errno.h>
+#include <float.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sigar.h"
+#include "sigar_private.h"
+#include "sigar_util.h"
+
+enum {
+    COL_UINT,
+    COL_SINT,
+    COL_DOUBLE,
+    COL_CRED,
+    COL_FD
+};
+
+typedef struct {
+    int flags;     /* SIGAR_PROC_SNAPSHOT_* the field is read with */
+    size_t offset;
+    size_t size;
+    int kind;
+} proc_column_t;
+
+#define PROC_COLUMN(flags, field, kind) \
+    { flags, offsetof(sigar_proc_snapshot_entry_t, field), \
+      sizeof(((sigar_proc_snapshot_entry_t *)0)->field), kind }
+
+#define STATE_COLUMN(field, f) \
+    PROC_COLUMN(SIGAR_PROC_SNAPSHOT_STATE | \
+                SIGAR_PROC_SNAPSHOT_STATE_FIELDS(SIGAR_PROC_STATE_F_##f), \
+                state.field, COL_UINT)
+
+#define MEM_COLUMN(field, f) \
+    PROC_COLUMN(SIGAR_PROC_SNAPSHOT_MEM | \
+                SIGAR_PROC_SNAPSHOT_MEM_FIELDS(SIGAR_PROC_MEM_F_##f), \
+                mem.field, COL_UINT)
+
+/* in SIGAR_PROC_COL_* order */
+static const proc_column_t proc_columns[SIGAR_PROC_COL_MAX] = {
+    PROC_COLUMN(0, pid, COL_SINT),
+    PROC_COLUMN(SIGAR_PROC_SNAPSHOT_STATE |
+                SIGAR_PROC_SNAPSHOT_STATE_FIELDS(SIGAR_PROC_STATE_F_PPID),
+                state.ppid, COL_SINT),
+    STATE_COLUMN(threads, THREADS),
+    MEM_COLUMN(size, SIZE),
+    MEM_COLUMN(resident, RESIDENT),
+    MEM_COLUMN(share, SHARE),
+    MEM_COLUMN(page_faults, PAGE_FAULTS),
+    PROC_COLUMN(SIGAR_PROC_SNAPSHOT_TIME, cpu.start_time, COL_UINT),
+    PROC_COLUMN(SIGAR_PROC_SNAPSHOT_TIME, cpu.user, COL_UINT),
+    PROC_COLUMN(SIGAR_PROC_SNAPSHOT_TIME, cpu.sys, COL_UINT),
+    PROC_COLUMN(SIGAR_PROC_SNAPSHOT_TIME, cpu.total, COL_UINT),
+    PROC_COLUMN(SIGAR_PROC_SNAPSHOT_CPU, cpu.percent, COL_DOUBLE),
+    PROC_COLUMN(SIGAR_PROC_SNAPSHOT_CGROUP, cgroup, COL_UINT),
+    PROC_COLUMN(SIGAR_PROC_SNAPSHOT_DISK_IO, disk_io.bytes_read, COL_UINT),
+    PROC_COLUMN(SIGAR_PROC_SNAPSHOT_DISK_IO, disk_io.bytes_written, COL_UINT),
+    { 0, 0, 0, COL_CRED },
+    { 0, 0, 0, COL_FD }
+};
+
+/* SIGAR_PROC_SNAPSHOT_* bits an entry has when the field is valid */
+#define PROC_COLUMN_VALID(column) ((column)->flags & 0xffff)
+
+#define COLUMN_STRIDE(number) \
+    (((number) * sizeof(sigar_uint64_t) + SIGAR_PROC_COLUMNS_ALIGN - 1) & \
+     ~((size_t)SIGAR_PROC_COLUMNS_ALIGN - 1))
+
+#define GROUP_LIST_MAX 64
+
+static sigar_uint64_t proc_column_read(const proc_column_t *column,
+                                       sigar_proc_snapshot_entry_t *entry)
+{
+    char *field = (char *)entry + column->offset;
+
+    if (column->size == sizeof(int)) {
+        int value = *(int *)field;
+        return column->kind == COL_SINT ?
+            (sigar_uint64_t)(sigar_int64_t)value : (sigar_uint64_t)value;
+    }
+    else {
+        return *(sigar_uint64_t *)field;
+    }
+}
+
+static void proc_column_fill(sigar_t *sigar,
+                             sigar_proc_snapshot_t *snapshot,
+                             int col,
+                             sigar_proc_columns_t *cols)
+{
+    const proc_column_t *column = &proc_columns[col];
+    sigar_proc_snapshot_entry_t *entry = snapshot->data;
+    unsigned long i, n = snapshot->number;
+    int valid = PROC_COLUMN_VALID(column);
+
+    switch (column->kind) {
+      case COL_DOUBLE:
+        {
+            double *f64 = cols->f64[col];
+            for (i = 0; i < n; i++) {
+                f64[i] = ((entry[i].flags & valid) == valid) ?
+                    *(double *)((char *)&entry[i] + column->offset) : 0;
+            }
+        }
+        break;
+      case COL_CRED:
+        {
+            sigar_uint64_t *u64 = cols->u64[col];
+            for (i = 0; i < n; i++) {
+                sigar_proc_cred_t cred;
+                u64[i] = (sigar_proc_cred_get(sigar, entry[i].pid, &cred) ==
+                          SIGAR_OK) ? cred.uid : SIGAR_FIELD_NOTIMPL;
+            }
+        }
+        break;
+      case COL_FD:
+        {
+            sigar_uint64_t *u64 = cols->u64[col];
+            for (i = 0; i < n; i++) {
+                sigar_proc_fd_t procfd;
+                u64[i] = (sigar_proc_fd_get(sigar, entry[i].pid, &procfd) ==
+                          SIGAR_OK) ? procfd.total : 0;
+            }
+        }
+        break;
+      default:
+        {
+            sigar_uint64_t *u64 = cols->u64[col];
+            for (i = 0; i < n; i++) {
+                u64[i] = ((entry[i].flags & valid) == valid) ?
+                    proc_column_read(column, &entry[i]) : 0;
+            }
+        }
+        break;
+    }
+}
+
+SIGAR_DECLARE(int)
+sigar_proc_columns_snapshot_get(sigar_t *sigar,
+                                sigar_proc_snapshot_t *snapshot,
+                                int columns,
+                                sigar_proc_columns_t *cols)
+{
+    size_t stride = COLUMN_STRIDE(snapshot->number);
+    char *base;
+    int col, ncols = 0;
+
+    SIGAR_ZERO(cols);
+
+    columns &= SIGAR_PROC_COL(SIGAR_PROC_COL_MAX) - 1;
+    for (col = 0; col < SIGAR_PROC_COL_MAX; col++) {
+        if (columns & SIGAR_PROC_COL(col)) {
+            ncols++;
+        }
+    }
+
+    cols->block = malloc(stride * ncols + SIGAR_PROC_COLUMNS_ALIGN);
+    if (!cols->block) {
+        return ENOMEM;
+    }
+    base = (char *)(((size_t)cols->block + SIGAR_PROC_COLUMNS_ALIGN - 1) &
+                    ~((size_t)SIGAR_PROC_COLUMNS_ALIGN - 1));
+
+    cols->number = snapshot->number;
+    cols->columns = columns;
+
+    for (col = 0; col < SIGAR_PROC_COL_MAX; col++) {
+        if (!(columns & SIGAR_PROC_COL(col))) {
+            continue;
+        }
+        if (proc_columns[col].kind == COL_DOUBLE) {
+            cols->f64[col] = (double *)base;
+        }
+        else {
+            cols->u64[col] = (sigar_uint64_t *)base;
+        }
+        base += stride;
+
+        proc_column_fill(sigar, snapshot, col, cols);
+    }
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int) sigar_proc_columns_get(sigar_t *sigar, int columns,
+                                          sigar_proc_columns_t *cols)
+{
+    sigar_proc_snapshot_t snapshot;
+    int col, flags = 0, status;
+
+    for (col = 0; col < SIGAR_PROC_COL_MAX; col++) {
+        if (columns & SIGAR_PROC_COL(col)) {
+            flags |= proc_columns[col].flags;
+        }
+    }
+
+    if ((status = sigar_proc_snapshot_get(sigar, flags, &snapshot)) !=
+        SIGAR_OK)
+    {
+        return status;
+    }
+
+    status = sigar_proc_columns_snapshot_get(sigar, &snapshot, columns, cols);
+
+    sigar_proc_snapshot_destroy(sigar, &snapshot);
+
+    return status;
+}
+
+SIGAR_DECLARE(int) sigar_proc_columns_destroy(sigar_t *sigar,
+                                              sigar_proc_columns_t *cols)
+{
+    if (cols->block) {
+        free(cols->block);
+    }
+    SIGAR_ZERO(cols);
+
+    return SIGAR_OK;
+}
+
+static int column_check(sigar_proc_columns_t *cols, int column)
+{
+    if ((column < 0) || (column >= SIGAR_PROC_COL_MAX) ||
+        !(cols->columns & SIGAR_PROC_COL(column)))
+    {
+        return EINVAL;
+    }
+    return SIGAR_OK;
+}
+
+/* all ones for a counted row, so a masked value is an and */
+#define ROW_BITS(mask, i) ((sigar_uint64_t)0 - ((mask)[i] != 0))
+
+static sigar_uint64_t column_sum_u64(const sigar_uint64_t *v,
+                                     const unsigned char *mask,
+                                     unsigned long n)
+{
+    sigar_uint64_t sum = 0;
+    unsigned long i;
+
+    if (mask) {
+        for (i = 0; i < n; i++) {
+            sum += v[i] & ROW_BITS(mask, i);
+        }
+    }
+    else {
+        for (i = 0; i < n; i++) {
+            sum += v[i];
+        }
+    }
+
+    return sum;
+}
+
+/* four sums, floating point adds may not be reordered otherwise */
+static double column_sum_f64(const double *v,
+                             const unsigned char *mask,
+                             unsigned long n)
+{
+    double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    unsigned long i = 0, end = n & ~3UL;
+
+    if (mask) {
+        for (; i < end; i += 4) {
+            s0 += mask[i]   ? v[i]   : 0;
+            s1 += mask[i+1] ? v[i+1] : 0;
+            s2 += mask[i+2] ? v[i+2] : 0;
+            s3 += mask[i+3] ? v[i+3] : 0;
+        }
+        for (; i < n; i++) {
+            s0 += mask[i] ? v[i] : 0;
+        }
+    }
+    else {
+        for (; i < end; i += 4) {
+            s0 += v[i];
+            s1 += v[i+1];
+            s2 += v[i+2];
+            s3 += v[i+3];
+        }
+        for (; i < n; i++) {
+            s0 += v[i];
+        }
+    }
+
+    return (s0 + s1) + (s2 + s3);
+}
+
+SIGAR_DECLARE(int) sigar_proc_columns_sum(sigar_proc_columns_t *cols,
+                                          int column,
+                                          const unsigned char *mask,
+                                          double *sum)
+{
+    int status = column_check(cols, column);
+
+    if (status != SIGAR_OK) {
+        return status;
+    }
+
+    if (cols->f64[column]) {
+        *sum = column_sum_f64(cols->f64[column], mask, cols->number);
+    }
+    else {
+        *sum = (double)column_sum_u64(cols->u64[column], mask, cols->number);
+    }
+
+    return SIGAR_OK;
+}
+
+/*
+ * the largest value in one pass and its first row in another, which
+ * stops early; a single pass keeping the row does not vectorise.
+ */
+SIGAR_DECLARE(int) sigar_proc_columns_max(sigar_proc_columns_t *cols,
+                                          int column,
+                                          const unsigned char *mask,
+                                          unsigned long *row)
+{
+    unsigned long i, n = cols->number;
+    int status = column_check(cols, column);
+
+    if (status != SIGAR_OK) {
+        return status;
+    }
+
+    if (cols->f64[column]) {
+        const double *v = cols->f64[column];
+        double max = -DBL_MAX;
+
+        for (i = 0; i < n; i++) {
+            double value = (!mask || mask[i]) ? v[i] : -DBL_MAX;
+            max = value > max ? value : max;
+        }
+        for (i = 0; i < n; i++) {
+            if ((!mask || mask[i]) && (v[i] == max)) {
+                *row = i;
+                return SIGAR_OK;
+            }
+        }
+    }
+    else {
+        const sigar_uint64_t *v = cols->u64[column];
+        sigar_uint64_t max = 0;
+
+        /* skipped rows count as 0, no counted value is below that */
+        if (mask) {
+            for (i = 0; i < n; i++) {
+                sigar_uint64_t value = v[i] & ROW_BITS(mask, i);
+                max = value > max ? value : max;
+            }
+        }
+        else {
+            for (i = 0; i < n; i++) {
+                max = v[i] > max ? v[i] : max;
+            }
+        }
+        for (i = 0; i < n; i++) {
+            if ((!mask || mask[i]) && (v[i] == max)) {
+                *row = i;
+                return SIGAR_OK;
+            }
+        }
+    }
+
+    return ENOENT;
+}
+
+SIGAR_DECLARE(int) sigar_proc_columns_filter_gt(sigar_proc_columns_t *cols,
+                                                int column,
+                                                double threshold,
+                                                unsigned char *mask)
+{
+    unsigned long i, n = cols->number;
+    int status = column_check(cols, column);
+
+    if (status != SIGAR_OK) {
+        return status;
+    }
+
+    if (cols->f64[column]) {
+        const double *v = cols->f64[column];
+        for (i = 0; i < n; i++) {
+            mask[i] &= (v[i] > threshold);
+        }
+    }
+    else if (threshold >= 18446744073709551616.0) {
+        memset(mask, 0, n);
+    }
+    else if (threshold >= 0) {
+        /* an integer is above threshold when it is above its floor */
+        const sigar_uint64_t *v = cols->u64[column];
+        sigar_uint64_t floor = (sigar_uint64_t)threshold;
+        for (i = 0; i < n; i++) {
+            mask[i] &= (v[i] > floor);
+        }
+    }
+
+    return SIGAR_OK;
+}
+
+/* row a ranks above row b: the larger value, else the earlier row */
+static int column_row_above(const sigar_uint64_t *u64, const double *f64,
+                            unsigned long a, unsigned long b)
+{
+    if (f64) {
+        if (f64[a] != f64[b]) {
+            return f64[a] > f64[b];
+        }
+    }
+    else if (u64[a] != u64[b]) {
+        return u64[a] > u64[b];
+    }
+    return a < b;
+}
+
+/* a heap with the lowest ranked row at the top */
+static void column_heap_down(const sigar_uint64_t *u64, const double *f64,
+                             unsigned long *heap, unsigned long n,
+                             unsigned long i)
+{
+    for (;;) {
+        unsigned long low = i, child = 2 * i + 1;
+
+        if ((child < n) &&
+            column_row_above(u64, f64, heap[low], heap[child]))
+        {
+            low = child;
+        }
+        if ((child + 1 < n) &&
+            column_row_above(u64, f64, heap[low], heap[child + 1]))
+        {
+            low = child + 1;
+        }
+        if (low == i) {
+            return;
+        }
+        {
+            unsigned long row = heap[i];
+            heap[i] = heap[low];
+            heap[low] = row;
+        }
+        i = low;
+    }
+}
+
+static void column_heap_up(const sigar_uint64_t *u64, const double *f64,
+                           unsigned long *heap, unsigned long i)
+{
+    while (i > 0) {
+        unsigned long parent = (i - 1) / 2, row;
+
+        if (!column_row_above(u64, f64, heap[parent], heap[i])) {
+            return;
+        }
+        row = heap[i];
+        heap[i] = heap[parent];
+        heap[parent] = row;
+        i = parent;
+    }
+}
+
+SIGAR_DECLARE(int) sigar_proc_columns_top_k(sigar_proc_columns_t *cols,
+                                            int column,
+                                            const unsigned char *mask,
+                                            unsigned long k,
+                                            unsigned long *rows,
+                                            unsigned long *number)
+{
+    const sigar_uint64_t *u64;
+    const double *f64;
+    unsigned long i, n = 0;
+    int status = column_check(cols, column);
+
+    *number = 0;
+
+    if (status != SIGAR_OK) {
+        return status;
+    }
+    if (k == 0) {
+        return SIGAR_OK;
+    }
+
+    u64 = cols->u64[column];
+    f64 = cols->f64[column];
+
+    for (i = 0; i < cols->number; i++) {
+        if (mask && !mask[i]) {
+            continue;
+        }
+        if (n < k) {
+            rows[n] = i;
+            column_heap_up(u64, f64, rows, n++);
+        }
+        else if (column_row_above(u64, f64, i, rows[0])) {
+            rows[0] = i;
+            column_heap_down(u64, f64, rows, n, 0);
+        }
+    }
+
+    /* taking the lowest off the top to the end leaves largest first */
+    *number = n;
+    while (n > 1) {
+        unsigned long row = rows[0];
+        rows[0] = rows[--n];
+        rows[n] = row;
+        column_heap_down(u64, f64, rows, n, 0);
+    }
+
+    return SIGAR_OK;
+}
+
+static void group_index_free(void *ptr)
+{
+}
+
+SIGAR_DECLARE(int)
+sigar_proc_columns_group_sum(sigar_proc_columns_t *cols,
+                             int key,
+                             int column,
+                             const unsigned char *mask,
+                             sigar_proc_columns_group_list_t *groups)
+{
+    const sigar_uint64_t *keys, *u64;
+    const double *f64;
+    sigar_cache_t *index; /* key to index + 1 */
+    unsigned long i;
+    int status;
+
+    if (((status = column_check(cols, key)) != SIGAR_OK) ||
+        ((status = column_check(cols, column)) != SIGAR_OK))
+    {
+        return status;
+    }
+    if (!(keys = cols->u64[key])) {
+        return EINVAL;
+    }
+    u64 = cols->u64[column];
+    f64 = cols->f64[column];
+
+    groups->number = 0;
+    groups->size = GROUP_LIST_MAX;
+    groups->data = malloc(sizeof(*groups->data) * groups->size);
+    if (!groups->data) {
+        groups->size = 0;
+        return ENOMEM;
+    }
+
+    index = sigar_cache_create(GROUP_LIST_MAX,
+                               SIGAR_CACHE_OPEN_ADDRESSING,
+                               SIGAR_FIELD_NOTIMPL,
+                               SIGAR_FIELD_NOTIMPL);
+    index->free_value = group_index_free;
+
+    for (i = 0; i < cols->number; i++) {
+        sigar_proc_columns_group_t *group;
+        sigar_cache_entry_t *entry;
+
+        if (mask && !mask[i]) {
+            continue;
+        }
+
+        entry = sigar_cache_get(index, keys[i]);
+        if (!entry->value) {
+            if (groups->number >= groups->size) {
+                group = realloc(groups->data, sizeof(*group) *
+                                (groups->size + GROUP_LIST_MAX));
+                if (!group) {
+                    sigar_cache_destroy(index);
+                    sigar_proc_columns_group_list_destroy(groups);
+                    return ENOMEM;
+                }
+                groups->data = group;
+                groups->size += GROUP_LIST_MAX;
+            }
+            group = &groups->data[groups->number++];
+            group->key = keys[i];
+            group->count = 0;
+            group->sum = 0;
+            entry->value = (void *)groups->number;
+        }
+        else {
+            group = &groups->data[(unsigned long)entry->value - 1];
+        }
+
+        group->count++;
+        group->sum += f64 ? f64[i] : (double)u64[i];
+    }
+
+    sigar_cache_destroy(index);
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int)
+sigar_proc_columns_group_list_destroy(sigar_proc_columns_group_list_t *groups)
+{
+    if (groups->size) {
+        free(groups->data);
+        groups->number = groups->size = 0;
+    }
+
+    return SIGAR_OK;
+}
@@ -0,0 +1,736 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * process fork, exec and exit events from the kernel.  while they are
+ * open the handle keeps its pid list up to date from them instead of
+ * walking /proc or the process table on every sigar_proc_list_get.
+ * on win32 they come from the kernel trace of win32_etw.c.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sigar.h"
+#include "sigar_private.h"
+#include "sigar_util.h"
+#include "sigar_os.h"
+
+#if defined(__linux__) && defined(HAVE_LINUX_CN_PROC_H)
+#  include <unistd.h>
+#  include <poll.h>
+#  include <sys/socket.h>
+#  include <linux/netlink.h>
+#  include <linux/connector.h>
+#  include <linux/cn_proc.h>
+#  define HAVE_PROC_EVENTS
+#elif defined(DARWIN) || defined(__FreeBSD__) || defined(__OpenBSD__) || \
+    defined(__NetBSD__)
+#  include <unistd.h>
+#  include <sys/types.h>
+#  include <sys/event.h>
+#  include <sys/time.h>
+#  define HAVE_PROC_EVENTS
+#elif defined(WIN32)
+#  define HAVE_PROC_EVENTS
+#endif
+
+#ifdef HAVE_PROC_EVENTS
+
+#define PROC_EVENTS_CHUNK 256
+/* undelivered events kept before they are given up for an overflow */
+#define PROC_EVENTS_QUEUE_MAX (64 * 1024)
+
+typedef struct {
+    long index;           /* in alive, -1 while not seeded */
+    sigar_uint64_t serial;
+} proc_events_pid_t;
+
+struct sigar_proc_events_t {
+    sigar_t *sigar;
+    int fd;               /* netlink socket or kqueue, unused on win32 */
+    int seeded;           /* alive holds every pid */
+    sigar_uint64_t serial;
+    sigar_uint64_t base;  /* serial given to the pids of the last seed */
+    sigar_proc_list_t alive;
+    sigar_cache_t *pids;  /* pid -> proc_events_pid_t */
+    sigar_proc_event_list_t queue;
+};
+
+static int proc_events_os_create(sigar_proc_events_t *events);
+static void proc_events_os_destroy(sigar_proc_events_t *events);
+static void proc_events_os_watch(sigar_proc_events_t *events,
+                                 sigar_pid_t pid);
+static int proc_events_os_read(sigar_proc_events_t *events, int timeout);
+
+static void proc_event_list_add(sigar_proc_event_list_t *list,
+                                int type, sigar_pid_t pid,
+                                sigar_pid_t ppid, int exit_code)
+{
+    sigar_proc_event_t *event;
+
+    if (list->number >= list->size) {
+        void *data = realloc(list->data,
+                             sizeof(*(list->data)) *
+                             (list->size + PROC_EVENTS_CHUNK));
+        if (!data) {
+            return;
+        }
+        list->data = data;
+        list->size += PROC_EVENTS_CHUNK;
+    }
+
+    event = &list->data[list->number++];
+    event->type = type;
+    event->pid = pid;
+    event->ppid = ppid;
+    event->exit_code = exit_code;
+}
+
+/* drop what was queued, the caller has to look at every process again */
+static void proc_events_overflow(sigar_proc_events_t *events)
+{
+#ifdef SIGAR_HAS_OS_PROC_ATTR
+    /* an exec may have been among what was lost */
+    sigar_os_proc_attr_forget(events->sigar, -1);
+#endif
+    events->seeded = 0;
+    events->queue.number = 0;
+    proc_event_list_add(&events->queue, SIGAR_PROC_EVENT_OVERFLOW,
+                        -1, -1, 0);
+}
+
+static proc_events_pid_t *proc_events_pid(sigar_proc_events_t *events,
+                                          sigar_pid_t pid)
+{
+    sigar_cache_entry_t *entry = sigar_cache_get(events->pids, pid);
+    proc_events_pid_t *ppid = entry->value;
+
+    if (!ppid) {
+        entry->value = ppid =
+            sigar_cache_value_new(events->pids, sizeof(*ppid));
+        ppid->index = -1;
+        ppid->serial = events->base;
+    }
+
+    return ppid;
+}
+
+static void proc_events_alive_add(sigar_proc_events_t *events,
+                                  sigar_pid_t pid, proc_events_pid_t *ppid)
+{
+    sigar_proc_list_t *alive = &events->alive;
+
+    if (!events->seeded || (ppid->index >= 0)) {
+        return;
+    }
+    SIGAR_PROC_LIST_GROW(alive);
+    ppid->index = alive->number;
+    alive->data[alive->number++] = pid;
+}
+
+static void proc_events_forget(sigar_proc_events_t *events, sigar_pid_t pid)
+{
+    sigar_t *sigar = events->sigar;
+    sigar_cache_entry_t *entry = sigar_cache_find(events->pids, pid);
+
+    if (entry) {
+        proc_events_pid_t *ppid = entry->value;
+        sigar_proc_list_t *alive = &events->alive;
+
+        if (events->seeded && (ppid->index >= 0)) {
+            /* swap the last pid into the hole */
+            sigar_pid_t last = alive->data[--alive->number];
+
+            if (last != pid) {
+                alive->data[ppid->index] = last;
+                proc_events_pid(events, last)->index = ppid->index;
+            }
+        }
+        sigar_cache_remove(events->pids, pid);
+    }
+
+    if (sigar->proc_cpu) {
+        sigar_cache_remove(sigar->proc_cpu, pid);
+    }
+    if (sigar->proc_io) {
+        sigar_cache_remove(sigar->proc_io, pid);
+    }
+#ifdef SIGAR_HAS_OS_PROC_ATTR
+    sigar_os_proc_attr_forget(sigar, pid);
+#endif
+}
+
+static void proc_events_queue(sigar_proc_events_t *events,
+                              int type, sigar_pid_t pid,
+                              sigar_pid_t ppid, int exit_code)
+{
+    proc_events_pid_t *entry;
+
+    switch (type) {
+      case SIGAR_PROC_EVENT_FORK:
+        if (pid < 0) {
+            /* kqueue without NOTE_TRACK, a rescan finds the child */
+            events->seeded = 0;
+            break;
+        }
+        /* fallthrough */
+      case SIGAR_PROC_EVENT_EXEC:
+        /* a new or different program, ptql results are stale */
+#ifdef SIGAR_HAS_OS_PROC_ATTR
+        if (type == SIGAR_PROC_EVENT_EXEC) {
+            sigar_os_proc_attr_forget(events->sigar, pid);
+        }
+#endif
+        entry = proc_events_pid(events, pid);
+        entry->serial = ++events->serial;
+        proc_events_alive_add(events, pid, entry);
+        if (type == SIGAR_PROC_EVENT_FORK) {
+            proc_events_os_watch(events, pid);
+        }
+        break;
+      case SIGAR_PROC_EVENT_EXIT:
+        proc_events_forget(events, pid);
+        break;
+    }
+
+    if (events->queue.number >= PROC_EVENTS_QUEUE_MAX) {
+        proc_events_overflow(events);
+        return;
+    }
+    proc_event_list_add(&events->queue, type, pid, ppid, exit_code);
+}
+
+/* every pid from a scan of the os, once and again after an overflow */
+static int proc_events_seed(sigar_proc_events_t *events)
+{
+    sigar_t *sigar = events->sigar;
+    sigar_proc_list_t *alive = &events->alive;
+    unsigned long i;
+    int status;
+
+    alive->number = 0;
+    if ((status = sigar_os_proc_list_get(sigar, alive)) != SIGAR_OK) {
+        return status;
+    }
+
+    /* what is left over from before may have missed events */
+    sigar_cache_destroy(events->pids);
+    events->pids = sigar_cache_new(alive->number * 2 + 1);
+    events->base = ++events->serial;
+    events->seeded = 1;
+
+    for (i=0; i<alive->number; i++) {
+        proc_events_pid(events, alive->data[i])->index = i;
+        proc_events_os_watch(events, alive->data[i]);
+    }
+
+    return SIGAR_OK;
+}
+
+#ifdef __linux__
+
+#define PROC_EVENTS_RCVBUF (1024 * 1024)
+
+typedef struct {
+    struct nlmsghdr nlh;
+    struct cn_msg cn;
+    enum proc_cn_mcast_op op;
+} __attribute__ ((packed)) proc_events_listen_t;
+
+static int proc_events_os_create(sigar_proc_events_t *events)
+{
+    struct sockaddr_nl addr;
+    proc_events_listen_t msg;
+    int rcvbuf = PROC_EVENTS_RCVBUF;
+
+    if (events->sigar->proc_root) {
+        return SIGAR_ENOTIMPL; /* events would be for the real /proc */
+    }
+
+    events->fd = socket(PF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC,
+                        NETLINK_CONNECTOR);
+    if (events->fd < 0) {
+        return errno;
+    }
+    /* forks come in bursts, best effort */
+    setsockopt(events->fd, SOL_SOCKET, SO_RCVBUF,
+               &rcvbuf, sizeof(rcvbuf));
+
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = CN_IDX_PROC;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.nlh.nlmsg_len = sizeof(msg);
+    msg.nlh.nlmsg_type = NLMSG_DONE;
+    msg.nlh.nlmsg_pid = getpid();
+    msg.cn.id.idx = CN_IDX_PROC;
+    msg.cn.id.val = CN_VAL_PROC;
+    msg.cn.len = sizeof(msg.op);
+    msg.op = PROC_CN_MCAST_LISTEN;
+
+    /* needs CAP_NET_ADMIN in the initial namespaces */
+    if ((bind(events->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) ||
+        (send(events->fd, &msg, sizeof(msg), 0) < 0))
+    {
+        int status = errno;
+        close(events->fd);
+        return status;
+    }
+
+    return SIGAR_OK;
+}
+
+static void proc_events_os_destroy(sigar_proc_events_t *events)
+{
+    /* the kernel counts listeners, closing alone would leave it on */
+    proc_events_listen_t msg;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.nlh.nlmsg_len = sizeof(msg);
+    msg.nlh.nlmsg_type = NLMSG_DONE;
+    msg.nlh.nlmsg_pid = getpid();
+    msg.cn.id.idx = CN_IDX_PROC;
+    msg.cn.id.val = CN_VAL_PROC;
+    msg.cn.len = sizeof(msg.op);
+    msg.op = PROC_CN_MCAST_IGNORE;
+    send(events->fd, &msg, sizeof(msg), 0);
+
+    close(events->fd);
+}
+
+/* the connector reports every process */
+static void proc_events_os_watch(sigar_proc_events_t *events,
+                                 sigar_pid_t pid)
+{
+}
+
+static void proc_events_parse(sigar_proc_events_t *events,
+                              const void *data)
+{
+    struct proc_event event, *ev = &event;
+
+    /* cn_msg data sits 4 bytes off the 8 byte alignment of its u64s */
+    memcpy(&event, data, sizeof(event));
+
+    switch (ev->what) {
+      case PROC_EVENT_FORK:
+        /* new threads are forks too */
+        if (ev->event_data.fork.child_pid ==
+            ev->event_data.fork.child_tgid)
+        {
+            proc_events_queue(events, SIGAR_PROC_EVENT_FORK,
+                              ev->event_data.fork.child_tgid,
+                              ev->event_data.fork.parent_tgid, 0);
+        }
+        break;
+      case PROC_EVENT_EXEC:
+        proc_events_queue(events, SIGAR_PROC_EVENT_EXEC,
+                          ev->event_data.exec.process_tgid, -1, 0);
+        break;
+      case PROC_EVENT_EXIT:
+        if (ev->event_data.exit.process_pid ==
+            ev->event_data.exit.process_tgid)
+        {
+            proc_events_queue(events, SIGAR_PROC_EVENT_EXIT,
+                              ev->event_data.exit.process_tgid, -1,
+                              ev->event_data.exit.exit_code);
+        }
+        break;
+      default:
+        break;
+    }
+}
+
+static int proc_events_os_read(sigar_proc_events_t *events, int timeout)
+{
+    char buf[8192] __attribute__ ((aligned(NLMSG_ALIGNTO)));
+    struct pollfd pfd;
+    int status;
+
+    pfd.fd = events->fd;
+    pfd.events = POLLIN;
+
+    if ((status = poll(&pfd, 1, timeout)) < 0) {
+        return errno == EINTR ? SIGAR_OK : errno;
+    }
+    if (status == 0) {
+        return SIGAR_OK;
+    }
+
+    for (;;) {
+        struct sockaddr_nl addr;
+        socklen_t addrlen = sizeof(addr);
+        struct nlmsghdr *nlh;
+        ssize_t len = recvfrom(events->fd, buf, sizeof(buf), MSG_DONTWAIT,
+                               (struct sockaddr *)&addr, &addrlen);
+
+        if (len < 0) {
+            if (errno == ENOBUFS) {
+                /* the socket buffer filled up, events were dropped */
+                proc_events_overflow(events);
+                continue;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            return SIGAR_OK; /* drained */
+        }
+        if (addr.nl_pid != 0) {
+            continue; /* not from the kernel */
+        }
+
+        for (nlh = (struct nlmsghdr *)buf;
+             NLMSG_OK(nlh, len);
+             nlh = NLMSG_NEXT(nlh, len))
+        {
+            struct cn_msg *cn;
+
+            if ((nlh->nlmsg_type == NLMSG_ERROR) ||
+                (nlh->nlmsg_type == NLMSG_NOOP))
+            {
+                continue;
+            }
+            cn = NLMSG_DATA(nlh);
+            if ((cn->id.idx != CN_IDX_PROC) ||
+                (cn->id.val != CN_VAL_PROC) ||
+                (cn->len < sizeof(struct proc_event)))
+            {
+                continue;
+            }
+            proc_events_parse(events, cn->data);
+        }
+    }
+}
+
+#elif defined(WIN32)
+
+static int proc_events_os_create(sigar_proc_events_t *events)
+{
+    return sigar_etw_start(events->sigar, SIGAR_ETW_USER_EVENTS);
+}
+
+static void proc_events_os_destroy(sigar_proc_events_t *events)
+{
+    sigar_etw_stop(events->sigar, SIGAR_ETW_USER_EVENTS);
+}
+
+/* the trace sees every process, there is nothing to ask for */
+static void proc_events_os_watch(sigar_proc_events_t *events,
+                                 sigar_pid_t pid)
+{
+}
+
+static int proc_events_os_read(sigar_proc_events_t *events, int timeout)
+{
+    sigar_proc_event_list_t list;
+    unsigned long i;
+    int status;
+
+    status = sigar_etw_events_take(events->sigar, timeout, &list);
+    if (status != SIGAR_OK) {
+        return status;
+    }
+
+    for (i=0; i<list.number; i++) {
+        sigar_proc_event_t *event = &list.data[i];
+
+        if (event->type == SIGAR_PROC_EVENT_OVERFLOW) {
+            proc_events_overflow(events);
+        }
+        else {
+            proc_events_queue(events, event->type, event->pid,
+                              event->ppid, event->exit_code);
+        }
+    }
+
+    sigar_proc_event_list_destroy(&list);
+
+    return SIGAR_OK;
+}
+
+#else /* kqueue */
+
+#define PROC_EVENTS_KEVENTS 64
+
+#ifdef NOTE_EXITSTATUS
+#  define PROC_EVENTS_NOTE_EXIT (NOTE_EXIT | NOTE_EXITSTATUS)
+#else
+#  define PROC_EVENTS_NOTE_EXIT NOTE_EXIT
+#endif
+
+#ifdef NOTE_TRACK
+/* children are watched by the kernel from the fork on */
+#  define PROC_EVENTS_FFLAGS \
+    (PROC_EVENTS_NOTE_EXIT | NOTE_EXEC | NOTE_FORK | NOTE_TRACK)
+#else
+#  define PROC_EVENTS_FFLAGS \
+    (PROC_EVENTS_NOTE_EXIT | NOTE_EXEC | NOTE_FORK)
+#endif
+
+static int proc_events_os_create(sigar_proc_events_t *events)
+{
+    if ((events->fd = kqueue()) < 0) {
+        return errno;
+    }
+
+    return SIGAR_OK;
+}
+
+static void proc_events_os_destroy(sigar_proc_events_t *events)
+{
+    close(events->fd);
+}
+
+/* one at a time, a pid gone since the scan fails only itself */
+static void proc_events_os_watch(sigar_proc_events_t *events,
+                                 sigar_pid_t pid)
+{
+    struct kevent kev;
+
+    EV_SET(&kev, pid, EVFILT_PROC, EV_ADD | EV_CLEAR,
+           PROC_EVENTS_FFLAGS, 0, NULL);
+    kevent(events->fd, &kev, 1, NULL, 0, NULL);
+}
+
+static int proc_events_os_read(sigar_proc_events_t *events, int timeout)
+{
+    struct kevent kevs[PROC_EVENTS_KEVENTS];
+    struct timespec ts, *tsp = NULL;
+    int i, n;
+
+    if (timeout >= 0) {
+        ts.tv_sec = timeout / 1000;
+        ts.tv_nsec = (timeout % 1000) * 1000000;
+        tsp = &ts;
+    }
+
+    for (;;) {
+        if ((n = kevent(events->fd, NULL, 0, kevs, PROC_EVENTS_KEVENTS,
+                        tsp)) < 0)
+        {
+            return errno == EINTR ? SIGAR_OK : errno;
+        }
+
+        for (i=0; i<n; i++) {
+            sigar_pid_t pid = (sigar_pid_t)kevs[i].ident;
+            unsigned int fflags = kevs[i].fflags;
+
+#ifdef NOTE_TRACK
+            if (fflags & NOTE_TRACKERR) {
+                /* a child the kernel could not attach to */
+                proc_events_overflow(events);
+                continue;
+            }
+            if (fflags & NOTE_CHILD) {
+                proc_events_queue(events, SIGAR_PROC_EVENT_FORK,
+                                  pid, (sigar_pid_t)kevs[i].data, 0);
+            }
+            if (fflags & NOTE_FORK) {
+                /* reported again as NOTE_CHILD of the new pid */
+                fflags &= ~NOTE_FORK;
+            }
+#endif
+            if (fflags & NOTE_FORK) {
+                proc_events_queue(events, SIGAR_PROC_EVENT_FORK,
+                                  -1, pid, 0);
+            }
+            if (fflags & NOTE_EXEC) {
+                proc_events_queue(events, SIGAR_PROC_EVENT_EXEC,
+                                  pid, -1, 0);
+            }
+            if (fflags & NOTE_EXIT) {
+                proc_events_queue(events, SIGAR_PROC_EVENT_EXIT,
+                                  pid, -1, (int)kevs[i].data);
+            }
+        }
+
+        if (n < PROC_EVENTS_KEVENTS) {
+            return SIGAR_OK;
+        }
+
+        /* more may be queued, take them without blocking */
+        ts.tv_sec = ts.tv_nsec = 0;
+        tsp = &ts;
+    }
+}
+
+#endif
+
+SIGAR_DECLARE(int) sigar_proc_events_create(sigar_t *sigar,
+                                            sigar_proc_events_t **events)
+{
+    sigar_proc_events_t *e;
+    int status;
+
+    if (sigar->proc_events) {
+        return EBUSY;
+    }
+    if (!(e = calloc(1, sizeof(*e)))) {
+        return ENOMEM;
+    }
+    e->sigar = sigar;
+
+    if ((status = proc_events_os_create(e)) != SIGAR_OK) {
+        free(e);
+        return status;
+    }
+
+    /* listening before the scan, nothing falls in between */
+    sigar_proc_list_create(&e->alive);
+    e->pids = sigar_cache_new(SIGAR_PROC_LIST_MAX);
+
+    if ((status = proc_events_seed(e)) != SIGAR_OK) {
+        proc_events_os_destroy(e);
+        sigar_cache_destroy(e->pids);
+        sigar_proc_list_destroy(sigar, &e->alive);
+        free(e);
+        return status;
+    }
+
+#ifdef SIGAR_HAS_OS_PROC_ATTR
+    /* what was cached before could predate an exec no event will tell */
+    sigar_os_proc_attr_forget(sigar, -1);
+#endif
+    sigar->proc_events = *events = e;
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int) sigar_proc_events_destroy(sigar_proc_events_t *events)
+{
+    events->sigar->proc_events = NULL;
+
+    proc_events_os_destroy(events);
+    sigar_cache_destroy(events->pids);
+    sigar_proc_list_destroy(events->sigar, &events->alive);
+    sigar_proc_event_list_destroy(&events->queue);
+    free(events);
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int)
+sigar_proc_events_wait(sigar_proc_events_t *events, int timeout,
+                       sigar_proc_event_list_t *list)
+{
+    int status;
+
+    /* what sigar_proc_list_get took in since the last wait */
+    status = proc_events_os_read(events,
+                                 events->queue.number ? 0 : timeout);
+
+    if (status != SIGAR_OK) {
+        list->number = list->size = 0;
+        list->data = NULL;
+        return status;
+    }
+
+    *list = events->queue;
+    events->queue.number = events->queue.size = 0;
+    events->queue.data = NULL;
+
+    return SIGAR_OK;
+}
+
+int sigar_proc_events_list_get(sigar_t *sigar, sigar_proc_list_t *proclist)
+{
+    sigar_proc_events_t *events = sigar->proc_events;
+    int status;
+
+    if (!events) {
+        return SIGAR_ENOTIMPL;
+    }
+    if ((status = proc_events_os_read(events, 0)) != SIGAR_OK) {
+        return status;
+    }
+    if (!events->seeded &&
+        ((status = proc_events_seed(events)) != SIGAR_OK))
+    {
+        return status;
+    }
+
+    if (proclist->size < events->alive.number) {
+        proclist->data = realloc(proclist->data,
+                                 sizeof(*(proclist->data)) *
+                                 events->alive.number);
+        proclist->size = events->alive.number;
+    }
+    memcpy(proclist->data, events->alive.data,
+           sizeof(*(proclist->data)) * events->alive.number);
+    proclist->number = events->alive.number;
+
+    return SIGAR_OK;
+}
+
+sigar_uint64_t sigar_proc_events_serial(sigar_t *sigar, sigar_pid_t pid)
+{
+    sigar_proc_events_t *events = sigar->proc_events;
+    sigar_cache_entry_t *entry;
+
+    if (!events) {
+        return 0;
+    }
+    if ((entry = sigar_cache_find(events->pids, pid))) {
+        return ((proc_events_pid_t *)entry->value)->serial;
+    }
+
+    return events->base;
+}
+
+#else
+
+SIGAR_DECLARE(int) sigar_proc_events_create(sigar_t *sigar,
+                                            sigar_proc_events_t **events)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+SIGAR_DECLARE(int) sigar_proc_events_destroy(sigar_proc_events_t *events)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+SIGAR_DECLARE(int)
+sigar_proc_events_wait(sigar_proc_events_t *events, int timeout,
+                       sigar_proc_event_list_t *list)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+int sigar_proc_events_list_get(sigar_t *sigar, sigar_proc_list_t *proclist)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+sigar_uint64_t sigar_proc_events_serial(sigar_t *sigar, sigar_pid_t pid)
+{
+    return 0;
+}
+
+#endif /* HAVE_PROC_EVENTS */
+
+SIGAR_DECLARE(int)
+sigar_proc_event_list_destroy(sigar_proc_event_list_t *list)
+{
+    if (list->size) {
+        free(list->data);
+        list->number = list->size = 0;
+        list->data = NULL;
+    }
+
+    return SIGAR_OK;
+}
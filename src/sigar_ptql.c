@@ -121,6 +121,7 @@ typedef struct {
     unsigned int data_size;
     ptql_value_type_t type;
     ptql_branch_init_t init;
+    unsigned int field; /* SIGAR_PROC_*_F_* of the member, if any */
 } ptql_lookup_t;
 
 #define DATA_PTR(branch) \
@@ -179,11 +180,19 @@ struct ptql_branch_t {
     } match;
     any_value_t value;
     void (*value_free)(void *);
+    void *matcher;      /* ptql_str_matcher_t for literal string ops */
+    int source;         /* index into query->sources, -1 for ANY */
+    unsigned int cost;  /* evaluation order, cheapest first */
+    unsigned int order; /* position in the query, breaks cost ties */
+    int stable;         /* attribute does not change after exec */
+    int history;        /* needs the handle's own earlier samples */
+    int pred;           /* index into query->preds, -1 if not shared */
 };
 
 typedef struct {
     char *name;
     ptql_lookup_t *members;
+    unsigned int cost; /* relative price of one lookup for one pid */
 } ptql_entry_t;
 
 typedef struct {
@@ -192,8 +201,47 @@ typedef struct {
     ptql_branch_t *data;
 } ptql_branch_list_t;
 
+/*
+ * branches reading the same struct (State.Name and State.Ppid, say)
+ * share one source, fetched at most once per sigar_ptql_query_match.
+ */
+typedef struct {
+    ptql_get_t get;
+    unsigned int data_size;
+    unsigned int fields; /* of the branches, for the *_get_ex getters */
+    int parent;          /* fetched for the parent of the pid */
+    unsigned long gen;   /* query->gen when data was last fetched */
+    int status;
+    void *data;
+} ptql_source_t;
+
+/* Args branches of one query share a single sigar_proc_args_get */
+typedef struct {
+    unsigned long gen;
+    int status;
+    sigar_proc_args_t args;
+} ptql_args_source_t;
+
+/* result of a branch that several queries of a set have in common */
+typedef struct {
+    unsigned long gen;
+    int matched;
+} ptql_pred_t;
+
 struct sigar_ptql_query_t {
     ptql_branch_list_t branches;
+    int nsources;
+    ptql_source_t *sources;
+    int state_source;    /* source of the pid's own State, or -1 */
+    ptql_args_source_t *args; /* NULL without Args branches */
+    ptql_pred_t *preds;  /* shared with the rest of a query set */
+    unsigned long gen;
+    int cacheable;       /* every branch is stable */
+    int history;         /* some branch has history */
+    int defer_history;   /* a worker copy, history branches are skipped */
+    sigar_cache_t *results;   /* pid -> ptql_result_t */
+    sigar_proc_list_t cached; /* pids in results */
+    unsigned long serial;     /* sigar_ptql_query_find calls */
 #ifdef PTQL_DEBUG
     char *ptql;
 #endif
@@ -372,6 +420,19 @@ static ptql_op_dbl_t ptql_op_dbl[] = {
     ptql_op_dbl_le
 };
 
+/* sigar_rules.c compares its numbers with the same operators */
+int sigar_ptql_op_code(char *op)
+{
+    ptql_op_name_t code = ptql_op_code_get(op);
+
+    return code <= PTQL_OP_MAX_NSTR ? (int)code : -1;
+}
+
+int sigar_ptql_op_dbl_match(int op, double haystack, double needle)
+{
+    return ptql_op_dbl[op](NULL, haystack, needle);
+}
+
 static int ptql_op_str_eq(ptql_branch_t *branch,
                           char *haystack, char *needle)
 {
@@ -431,9 +492,11 @@ static int ptql_op_str_re(ptql_branch_t *branch,
 {
 #ifdef SIGAR_HAS_PCRE
     pcre *re = (pcre *)branch->value.ptr;
+    pcre_extra *extra =
+        branch->matcher ? PTQL_MATCHER(branch)->extra : NULL;
     int len = strlen(haystack);
     int rc =
-        pcre_exec(re, NULL, haystack, len, 0, 0, NULL, 0);
+        pcre_exec(re, extra, haystack, len, 0, 0, NULL, 0);
     return rc >= 0;
 #else
     return 0;
@@ -446,6 +509,175 @@ static int ptql_op_str_ct(ptql_branch_t *branch,
     return branch_strstr(branch, haystack, needle) != NULL;
 }
 
+/*
+ * string branches with a literal needle are compiled once at create
+ * time: the length is known, case-insensitive needles are folded
+ * upfront, and substring search is anchored on the first needle
+ * char with libc's vectorized strchr/strpbrk/strstr.
+ */
+typedef struct {
+    size_t len;
+    char anchor[3];     /* first needle char, both cases */
+#ifdef SIGAR_HAS_PCRE
+    pcre_extra *extra;
+#endif
+} ptql_str_matcher_t;
+
+#define PTQL_MATCHER(branch) \
+    ((ptql_str_matcher_t *)(branch)->matcher)
+
+static int ptql_op_str_eq_fast(ptql_branch_t *branch,
+                               char *haystack, char *needle)
+{
+    if (IS_ICASE(branch)) {
+        return strcasecmp(haystack, needle) == 0;
+    }
+    return (*haystack == *needle) && (strcmp(haystack, needle) == 0);
+}
+
+static int ptql_op_str_ne_fast(ptql_branch_t *branch,
+                               char *haystack, char *needle)
+{
+    return !ptql_op_str_eq_fast(branch, haystack, needle);
+}
+
+static int ptql_op_str_ew_fast(ptql_branch_t *branch,
+                               char *haystack, char *needle)
+{
+    size_t nlen = PTQL_MATCHER(branch)->len;
+    size_t hlen = strlen(haystack);
+
+    if (hlen < nlen) {
+        return 0;
+    }
+    haystack += hlen - nlen;
+    if (IS_ICASE(branch)) {
+        return strcasecmp(haystack, needle) == 0;
+    }
+    return memcmp(haystack, needle, nlen) == 0;
+}
+
+static int ptql_op_str_sw_fast(ptql_branch_t *branch,
+                               char *haystack, char *needle)
+{
+    size_t nlen = PTQL_MATCHER(branch)->len;
+
+    if (IS_ICASE(branch)) {
+        return strncasecmp(haystack, needle, nlen) == 0;
+    }
+    return (nlen == 0) ||
+        ((*haystack == *needle) && (strncmp(haystack, needle, nlen) == 0));
+}
+
+static int ptql_op_str_ct_fast(ptql_branch_t *branch,
+                               char *haystack, char *needle)
+{
+    ptql_str_matcher_t *matcher = PTQL_MATCHER(branch);
+
+    if (matcher->len == 0) {
+        return 1;
+    }
+
+    if (!IS_ICASE(branch)) {
+        if (matcher->len == 1) {
+            return strchr(haystack, *needle) != NULL;
+        }
+        return strstr(haystack, needle) != NULL;
+    }
+
+    while ((haystack = strpbrk(haystack, matcher->anchor))) {
+        if (strncasecmp(haystack, needle, matcher->len) == 0) {
+            return 1;
+        }
+        haystack++;
+    }
+
+    return 0;
+}
+
+static ptql_op_str_t ptql_op_str_fast[] = {
+    ptql_op_str_eq_fast,
+    ptql_op_str_ne_fast,
+    NULL, /* gt..le: plain strcmp already */
+    NULL,
+    NULL,
+    NULL,
+    ptql_op_str_ew_fast,
+    ptql_op_str_sw_fast,
+    NULL, /* re */
+    ptql_op_str_ct_fast
+};
+
+static void ptql_str_matcher_free(void *data)
+{
+    ptql_str_matcher_t *matcher = data;
+
+#if defined(SIGAR_HAS_PCRE) && defined(PCRE_STUDY_JIT_COMPILE)
+    if (matcher->extra) {
+        pcre_free_study(matcher->extra);
+    }
+#elif defined(SIGAR_HAS_PCRE)
+    if (matcher->extra) {
+        pcre_free(matcher->extra);
+    }
+#endif
+    free(matcher);
+}
+
+static int ptql_str_matcher_init(ptql_branch_t *branch)
+{
+    ptql_str_matcher_t *matcher;
+
+    if (branch->op_flags & PTQL_OP_FLAG_REF) {
+        return SIGAR_OK; /* needle is the other branch's data */
+    }
+
+    if (branch->op_name == PTQL_OP_RE) {
+#ifdef SIGAR_HAS_PCRE
+        const char *error;
+
+        if (!branch->value.ptr) {
+            return SIGAR_OK;
+        }
+        if (!(matcher = calloc(1, sizeof(*matcher)))) {
+            return ENOMEM;
+        }
+#  ifdef PCRE_STUDY_JIT_COMPILE
+        matcher->extra = pcre_study((pcre *)branch->value.ptr,
+                                    PCRE_STUDY_JIT_COMPILE, &error);
+#  else
+        matcher->extra = pcre_study((pcre *)branch->value.ptr, 0, &error);
+#  endif
+        branch->matcher = matcher;
+#endif
+        return SIGAR_OK;
+    }
+
+    if (!branch->value.str || !ptql_op_str_fast[branch->op_name]) {
+        return SIGAR_OK;
+    }
+
+    if (!(matcher = calloc(1, sizeof(*matcher)))) {
+        return ENOMEM;
+    }
+
+    matcher->len = strlen(branch->value.str);
+    if (IS_ICASE(branch)) {
+        char c = *branch->value.str;
+
+        matcher->anchor[0] = sigar_tolower(c);
+        matcher->anchor[1] = sigar_toupper(c);
+        if (matcher->anchor[0] == matcher->anchor[1]) {
+            matcher->anchor[1] = '\0';
+        }
+    }
+
+    branch->matcher = matcher;
+    branch->match.str = ptql_op_str_fast[branch->op_name];
+
+    return SIGAR_OK;
+}
+
 static ptql_op_str_t ptql_op_str[] = {
     ptql_op_str_eq,
     ptql_op_str_ne,
@@ -545,6 +777,10 @@ static int ptql_branch_list_destroy(ptql_branch_list_t *branches)
                 branch->data_free(branch->data.ptr);
             }
 
+            if (branch->matcher) {
+                ptql_str_matcher_free(branch->matcher);
+            }
+
             if (branch->lookup &&
                 ((branch->lookup->type == PTQL_VALUE_TYPE_STR) ||
                  (branch->lookup->type == PTQL_VALUE_TYPE_ANY)) &&
@@ -798,51 +1034,32 @@ static int ptql_branch_init_pid(ptql_parse_branch_t *parsed,
 }
 
 #ifdef WIN32
-#define QUERY_SC_SIZE 8192
-
-static int ptql_service_query_config(SC_HANDLE scm_handle,
-                                     char *name,
-                                     LPQUERY_SERVICE_CONFIG config)
-{
-    int status;
-    DWORD bytes;
-    SC_HANDLE handle =
-        OpenService(scm_handle, name, SERVICE_QUERY_CONFIG);
-
-    if (!handle) {
-        return GetLastError();
-    }
-
-    if (QueryServiceConfig(handle, config, QUERY_SC_SIZE, &bytes)) {
-        status = SIGAR_OK;
-    }
-    else {
-        status = GetLastError();
-    }
-
-    CloseServiceHandle(handle);
-    return status;
-}
-
+/* from the SCM table cached on the handle, see sigar_services_cache_get */
 static int sigar_services_walk(sigar_services_walker_t *walker,
                                ptql_branch_t *branch)
 {
-    sigar_services_status_t ss;
-    char buffer[QUERY_SC_SIZE];
+    sigar_t *sigar = walker->sigar;
+    ENUM_SERVICE_STATUS_PROCESS *services;
     char exe[SIGAR_CMDLINE_MAX];
-    LPQUERY_SERVICE_CONFIG config = (LPQUERY_SERVICE_CONFIG)buffer;
-    DWORD i, status;
+    DWORD i, count;
+    int status;
 
-    SIGAR_ZERO(&ss);
-    status = sigar_services_status_get(&ss, walker->flags);
+    status = sigar_services_cache_get(sigar, &services, &count);
     if (status != SIGAR_OK) {
         return status;
     }
-    for (i=0; i<ss.count; i++) {
+
+    /* add_service may look up pids, which must not re-enumerate */
+    sigar->services.walking++;
+
+    for (i=0; i<count; i++) {
         sigar_pid_t service_pid = 0;
-        int status;
-        char *value = NULL;
-        char *name = ss.services[i].lpServiceName;
+        char *value = NULL, *path;
+        char *name = services[i].lpServiceName;
+
+        if (!sigar_service_state_match(&services[i], walker->flags)) {
+            continue;
+        }
 
         if (branch == NULL) {
             /* no query, return all */
@@ -854,29 +1071,22 @@ static int sigar_services_walk(sigar_services_walker_t *walker,
 
         switch (branch->flags) {
           case PTQL_PID_SERVICE_DISPLAY:
-            value = ss.services[i].lpDisplayName;
+            value = services[i].lpDisplayName;
             break;
           case PTQL_PID_SERVICE_PATH:
           case PTQL_PID_SERVICE_EXE:
-            status = ptql_service_query_config(ss.handle, name, config);
-            if (status == SIGAR_OK) {
-                if (branch->flags == PTQL_PID_SERVICE_EXE) {
-                    value =
-                        sigar_service_exe_get(config->lpBinaryPathName,
-                                              exe, 1);
-                }
-                else {
-                    value = config->lpBinaryPathName;
-                }
+            if (sigar_service_path_get(sigar, name, &path) != SIGAR_OK) {
+                continue;
+            }
+            if (branch->flags == PTQL_PID_SERVICE_EXE) {
+                value = sigar_service_exe_get(path, exe, 1);
             }
             else {
-                continue;
+                value = path;
             }
             break;
           case PTQL_PID_SERVICE_PID:
-            sigar_service_pid_get(walker->sigar,
-                                  name,
-                                  &service_pid);
+            service_pid = services[i].ServiceStatusProcess.dwProcessId;
             break;
           case PTQL_PID_SERVICE_NAME:
           default:
@@ -884,7 +1094,7 @@ static int sigar_services_walk(sigar_services_walker_t *walker,
             break;
         }
 
-        if ((value && ptql_str_match(walker->sigar, branch, value)) ||
+        if ((value && ptql_str_match(sigar, branch, value)) ||
             (service_pid &&
              pid_branch_match(branch, service_pid, atoi(branch->data.str))))
         {
@@ -894,7 +1104,7 @@ static int sigar_services_walk(sigar_services_walker_t *walker,
         }
     }
 
-    sigar_services_status_close(&ss);
+    sigar->services.walking--;
 
     return SIGAR_OK;
 }
@@ -931,9 +1141,9 @@ static int ptql_pid_service_list_get(sigar_t *sigar,
     return sigar_services_walk(&walker, branch);
 }
 
-int sigar_services_query(char *ptql,
-                         sigar_ptql_error_t *error,
-                         sigar_services_walker_t *walker)
+static int services_query(char *ptql,
+                          sigar_ptql_error_t *error,
+                          sigar_services_walker_t *walker)
 {
     int status;
     sigar_ptql_query_t *query;
@@ -968,6 +1178,28 @@ int sigar_services_query(char *ptql,
 
     return status;
 }
+
+int sigar_services_query(char *ptql,
+                         sigar_ptql_error_t *error,
+                         sigar_services_walker_t *walker)
+{
+    int status;
+
+    if (walker->sigar) {
+        return services_query(ptql, error, walker);
+    }
+
+    /* the service table lives on a handle, borrow one */
+    if ((status = sigar_open(&walker->sigar)) != SIGAR_OK) {
+        walker->sigar = NULL;
+        return status;
+    }
+    status = services_query(ptql, error, walker);
+    sigar_close(walker->sigar);
+    walker->sigar = NULL;
+
+    return status;
+}
 #endif
 
 static int ptql_pid_port_get(sigar_t *sigar,
@@ -1093,6 +1325,104 @@ static int SIGAPI ptql_pid_match(sigar_t *sigar,
     return SIGAR_OK;
 }
 
+/*
+ * Tree.Root: the pid and everything below it.  ptql_proc_list_get
+ * lists the subtree from one sigar_proc_tree_get and matches against
+ * that; a lone sigar_ptql_query_match walks up the ppids instead.
+ */
+#define PTQL_TREE_DEPTH_MAX 1024
+
+typedef struct {
+    sigar_pid_t root;
+    int indexed;            /* pids is the subtree, while a find runs */
+    sigar_proc_list_t pids; /* sorted */
+} ptql_tree_t;
+
+static void ptql_tree_free(void *data)
+{
+    ptql_tree_t *tree = data;
+
+    sigar_proc_list_destroy(NULL, &tree->pids);
+    free(tree);
+}
+
+static int ptql_pid_cmp(const void *a, const void *b)
+{
+    sigar_pid_t pa = *(const sigar_pid_t *)a;
+    sigar_pid_t pb = *(const sigar_pid_t *)b;
+
+    return pa < pb ? -1 : (pa > pb ? 1 : 0);
+}
+
+static int SIGAPI ptql_tree_match(sigar_t *sigar,
+                                  sigar_pid_t pid,
+                                  void *data)
+{
+    ptql_branch_t *branch = data;
+    ptql_tree_t *tree = branch->data.ptr;
+    int depth;
+
+    if (tree->indexed) {
+        return bsearch(&pid, tree->pids.data, tree->pids.number,
+                       sizeof(pid), ptql_pid_cmp) ? SIGAR_OK : !SIGAR_OK;
+    }
+
+    for (depth=0; depth<PTQL_TREE_DEPTH_MAX; depth++) {
+        sigar_proc_state_t state;
+
+        if (pid == tree->root) {
+            return SIGAR_OK;
+        }
+        if ((sigar_proc_state_get_ex(sigar, pid, SIGAR_PROC_STATE_F_PPID,
+                                     &state) != SIGAR_OK) ||
+            (state.ppid == pid))
+        {
+            break;
+        }
+        pid = state.ppid;
+    }
+
+    return !SIGAR_OK;
+}
+
+static int ptql_branch_init_tree(ptql_parse_branch_t *parsed,
+                                 ptql_branch_t *branch,
+                                 sigar_ptql_error_t *error)
+{
+    ptql_tree_t *tree;
+    char *ptr;
+
+    if (!strEQ(parsed->attr, "Root")) {
+        return ptql_error(error, "Unsupported %s attribute: %s",
+                          parsed->name, parsed->attr);
+    }
+
+    if (branch->op_name != PTQL_OP_EQ) {
+        return ptql_error(error, "%s requires 'eq' operator",
+                          parsed->name);
+    }
+
+    if (!(tree = calloc(1, sizeof(*tree)))) {
+        return ptql_error(error, "Out of memory");
+    }
+    branch->data.ptr = tree;
+    branch->data_size = sizeof(*tree);
+    branch->data_free = ptql_tree_free;
+
+    if (strEQ(parsed->value, "$$")) {
+        tree->root = getpid();
+    }
+    else {
+        SIGAR_CLEAR_ERRNO();
+        tree->root = str2pid(parsed->value, ptr);
+        if (strtonum_failed(parsed->value, ptr)) {
+            return PTQL_ERRNAN;
+        }
+    }
+
+    return SIGAR_OK;
+}
+
 static int ptql_args_branch_init(ptql_parse_branch_t *parsed,
                                  ptql_branch_t *branch,
                                  sigar_ptql_error_t *error)
@@ -1115,25 +1445,17 @@ static int ptql_args_branch_init(ptql_parse_branch_t *parsed,
     return SIGAR_OK;
 }
 
-static int SIGAPI ptql_args_match(sigar_t *sigar,
-                                  sigar_pid_t pid,
-                                  void *data)
+static int ptql_args_list_match(sigar_t *sigar,
+                                ptql_branch_t *branch,
+                                sigar_proc_args_t *args)
 {
-    ptql_branch_t *branch =
-        (ptql_branch_t *)data;
-    int status, matched=0;
-    sigar_proc_args_t args;
-
-    status = sigar_proc_args_get(sigar, pid, &args);
-    if (status != SIGAR_OK) {
-        return status;
-    }
+    int matched=0;
 
     if (branch->op_flags & PTQL_OP_FLAG_GLOB) {
         int i;
-        for (i=0; i<args.number; i++) {
+        for (i=0; i<args->number; i++) {
             matched = 
-                ptql_str_match(sigar, branch, args.data[i]);
+                ptql_str_match(sigar, branch, args->data[i]);
 
             if (matched) {
                 break;
@@ -1145,19 +1467,42 @@ static int SIGAPI ptql_args_match(sigar_t *sigar,
 
         /* e.g. find last element of args: Args.-1.eq=weblogic.Server */
         if (num < 0) {
-            num += args.number;
+            num += args->number;
         }
-        if ((num >= 0) && (num < args.number)) {
+        if ((num >= 0) && (num < args->number)) {
             matched =
-                ptql_str_match(sigar, branch, args.data[num]);
+                ptql_str_match(sigar, branch, args->data[num]);
         }
     }
 
+    return matched;
+}
+
+static int SIGAPI ptql_args_match(sigar_t *sigar,
+                                  sigar_pid_t pid,
+                                  void *data)
+{
+    ptql_branch_t *branch =
+        (ptql_branch_t *)data;
+    int status, matched;
+    sigar_proc_args_t args;
+
+    status = sigar_proc_args_get(sigar, pid, &args);
+    if (status != SIGAR_OK) {
+        return status;
+    }
+
+    matched = ptql_args_list_match(sigar, branch, &args);
+
     sigar_proc_args_destroy(sigar, &args);
 
     return matched ? SIGAR_OK : !SIGAR_OK;
 }
 
+#define PTQL_IS_ARGS(branch) \
+    (((branch)->lookup->get == (ptql_get_t)ptql_args_match) && \
+     !((branch)->op_flags & PTQL_OP_FLAG_PARENT))
+
 typedef struct {
     sigar_t *sigar;
     ptql_branch_t *branch;
@@ -1317,6 +1662,10 @@ static int ptql_branch_init_port(ptql_parse_branch_t *parsed,
     PTQL_VALUE_TYPE_##type, \
     NULL
 
+/* members the backend can skip the reads of when nothing asks */
+#define PTQL_LOOKUP_FIELD(cname, member, type, field) \
+    PTQL_LOOKUP_ENTRY(cname, member, type), field
+
 /* XXX uid/pid can be larger w/ 64bit mode */
 #define PTQL_VALUE_TYPE_PID PTQL_VALUE_TYPE_UI32
 #define PTQL_VALUE_TYPE_UID PTQL_VALUE_TYPE_UI32
@@ -1352,13 +1701,16 @@ static ptql_lookup_t PTQL_CredName[] = {
     { NULL }
 };
 
+#define PTQL_MEM_FIELD(member, field) \
+    PTQL_LOOKUP_FIELD(proc_mem, member, UI64, SIGAR_PROC_MEM_F_##field)
+
 static ptql_lookup_t PTQL_Mem[] = {
-    { "Size",        PTQL_LOOKUP_ENTRY(proc_mem, size, UI64) },
-    { "Resident",    PTQL_LOOKUP_ENTRY(proc_mem, resident, UI64) },
-    { "Share",       PTQL_LOOKUP_ENTRY(proc_mem, share, UI64) },
-    { "MinorFaults", PTQL_LOOKUP_ENTRY(proc_mem, minor_faults, UI64) },
-    { "MajorFaults", PTQL_LOOKUP_ENTRY(proc_mem, major_faults, UI64) },
-    { "PageFaults",  PTQL_LOOKUP_ENTRY(proc_mem, page_faults, UI64) },
+    { "Size",        PTQL_MEM_FIELD(size, SIZE) },
+    { "Resident",    PTQL_MEM_FIELD(resident, RESIDENT) },
+    { "Share",       PTQL_MEM_FIELD(share, SHARE) },
+    { "MinorFaults", PTQL_MEM_FIELD(minor_faults, MINOR_FAULTS) },
+    { "MajorFaults", PTQL_MEM_FIELD(major_faults, MAJOR_FAULTS) },
+    { "PageFaults",  PTQL_MEM_FIELD(page_faults, PAGE_FAULTS) },
     { NULL }
 };
 
@@ -1376,15 +1728,24 @@ static ptql_lookup_t PTQL_Cred[] = {
     { NULL }
 };
 
+#define PTQL_STATE_FIELD(member, type, field) \
+    PTQL_LOOKUP_FIELD(proc_state, member, type, SIGAR_PROC_STATE_F_##field)
+
 static ptql_lookup_t PTQL_State[] = {
-    { "State",     PTQL_LOOKUP_ENTRY(proc_state, state, CHR) },
-    { "Name",      PTQL_LOOKUP_ENTRY(proc_state, name, STR) },
-    { "Ppid",      PTQL_LOOKUP_ENTRY(proc_state, ppid, PID) },
-    { "Tty",       PTQL_LOOKUP_ENTRY(proc_state, tty, UI32) },
-    { "Nice",      PTQL_LOOKUP_ENTRY(proc_state, nice, UI32) },
-    { "Priority",  PTQL_LOOKUP_ENTRY(proc_state, priority, UI32) },
-    { "Threads",   PTQL_LOOKUP_ENTRY(proc_state, threads, UI64) },
-    { "Processor", PTQL_LOOKUP_ENTRY(proc_state, processor, UI32) },
+    { "State",     PTQL_STATE_FIELD(state, CHR, STATE) },
+    { "Name",      PTQL_STATE_FIELD(name, STR, NAME) },
+    { "Ppid",      PTQL_STATE_FIELD(ppid, PID, PPID) },
+    { "Tty",       PTQL_STATE_FIELD(tty, UI32, TTY) },
+    { "Nice",      PTQL_STATE_FIELD(nice, UI32, NICE) },
+    { "Priority",  PTQL_STATE_FIELD(priority, UI32, PRIORITY) },
+    { "Threads",   PTQL_STATE_FIELD(threads, UI64, THREADS) },
+    { "Processor", PTQL_STATE_FIELD(processor, UI32, PROCESSOR) },
+    { NULL }
+};
+
+static ptql_lookup_t PTQL_Cgroup[] = {
+    { "Path", PTQL_LOOKUP_ENTRY(proc_cgroup, path, STR) },
+    { "Id",   PTQL_LOOKUP_ENTRY(proc_cgroup, id, UI64) },
     { NULL }
 };
 
@@ -1413,26 +1774,71 @@ static ptql_lookup_t PTQL_Pid[] = {
     { NULL, ptql_pid_match, 0, 0, PTQL_VALUE_TYPE_ANY, ptql_branch_init_pid }
 };
 
+static ptql_lookup_t PTQL_Tree[] = {
+    { NULL, ptql_tree_match, 0, 0, PTQL_VALUE_TYPE_ANY, ptql_branch_init_tree }
+};
+
 static ptql_lookup_t PTQL_Service[] = {
     { NULL, ptql_pid_match, 0, 0, PTQL_VALUE_TYPE_ANY, ptql_branch_init_service }
 };
 
+/*
+ * attributes that only change when a process execs, so a match result
+ * can be kept for as long as the pid lives.  Args and Env are what
+ * the kernel recorded at exec time.
+ */
+static const char *ptql_stable_attrs[] = {
+    "State.Name", "Exe.Name", "Time.StartTime", "Cpu.StartTime", NULL
+};
+
+static int ptql_branch_is_stable(ptql_parse_branch_t *parsed)
+{
+    int i;
+    size_t len = strlen(parsed->name);
+
+    if (parsed->op_flags & PTQL_OP_FLAG_PARENT) {
+        return 0; /* orphans are reparented */
+    }
+    if (strEQ(parsed->name, "Args") || strEQ(parsed->name, "Env")) {
+        return 1;
+    }
+
+    for (i=0; ptql_stable_attrs[i]; i++) {
+        const char *attr = ptql_stable_attrs[i];
+
+        if (strnEQ(attr, parsed->name, len) && (attr[len] == '.') &&
+            strEQ(attr + len + 1, parsed->attr))
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * costs are rough syscall counts on linux: one small /proc read for
+ * State/Time/Cpu, more for anything that parses status, lists fds or
+ * resolves names, and whole-buffer reads for Args/Env/Modules.
+ */
 static ptql_entry_t ptql_map[] = {
-    { "Time",     PTQL_Time },
-    { "Cpu",      PTQL_Cpu },
-    { "CredName", PTQL_CredName },
-    { "Mem",      PTQL_Mem },
-    { "Exe",      PTQL_Exe },
-    { "Cred",     PTQL_Cred },
-    { "State",    PTQL_State },
-    { "Fd",       PTQL_Fd },
-    { "Args",     PTQL_Args },
-    { "Modules",  PTQL_Modules },
-    { "Env",      PTQL_Env },
-    { "Port",     PTQL_Port },
-    { "Pid",      PTQL_Pid },
-    { "Service",  PTQL_Service },
-    { "Disk_IO",   PTQL_Disk_IO },
+    { "Time",     PTQL_Time,     2 },
+    { "Cpu",      PTQL_Cpu,      2 },
+    { "CredName", PTQL_CredName, 4 },
+    { "Mem",      PTQL_Mem,      3 },
+    { "Exe",      PTQL_Exe,      4 },
+    { "Cred",     PTQL_Cred,     3 },
+    { "State",    PTQL_State,    1 },
+    { "Fd",       PTQL_Fd,       5 },
+    { "Cgroup",   PTQL_Cgroup,   2 },
+    { "Args",     PTQL_Args,     7 },
+    { "Modules",  PTQL_Modules,  9 },
+    { "Env",      PTQL_Env,      8 },
+    { "Port",     PTQL_Port,     6 },
+    { "Pid",      PTQL_Pid,      0 },
+    { "Service",  PTQL_Service,  6 },
+    { "Tree",     PTQL_Tree,     0 },
+    { "Disk_IO",   PTQL_Disk_IO, 3 },
     { NULL }
 };
 
@@ -1512,11 +1918,14 @@ static int ptql_branch_add(ptql_parse_branch_t *parsed,
 
     PTQL_BRANCH_LIST_GROW(branches);
 
-    branch = &branches->data[branches->number++];
+    branch = &branches->data[branches->number];
     SIGAR_ZERO(branch);
     branch->data_free = data_free;
     branch->value_free = data_free;
     branch->op_flags = parsed->op_flags;
+    branch->source = -1;
+    branch->pred = -1;
+    branch->order = branches->number++;
 
     branch->op_name = ptql_op_code_get(parsed->op);
     if (branch->op_name == PTQL_OP_MAX) {
@@ -1552,8 +1961,21 @@ static int ptql_branch_add(ptql_parse_branch_t *parsed,
         }
     }
 
-    if (lookup->init) {
-        int status = lookup->init(parsed, branch, error);
+    /* equality is the most selective test, ne the least */
+    branch->cost = entry->cost * 4;
+    if (branch->op_name == PTQL_OP_NE) {
+        branch->cost += 2;
+    }
+    else if (branch->op_name != PTQL_OP_EQ) {
+        branch->cost += 1;
+    }
+    if (branch->op_flags & PTQL_OP_FLAG_PARENT) {
+        branch->cost += 1; /* another pid to read */
+    }
+    branch->stable = ptql_branch_is_stable(parsed);
+
+    if (lookup->init) {
+        int status = lookup->init(parsed, branch, error);
         if (status != SIGAR_OK) {
             return status;
         }
@@ -1665,6 +2087,9 @@ static int ptql_branch_add(ptql_parse_branch_t *parsed,
         if (!is_set) {
             branch->value.str = sigar_strdup(parsed->value);
         }
+        if (ptql_str_matcher_init(branch) != SIGAR_OK) {
+            return ptql_error(error, "Out of memory");
+        }
         break;
     }
 
@@ -1673,12 +2098,173 @@ static int ptql_branch_add(ptql_parse_branch_t *parsed,
 
 static int ptql_branch_compare(const void *b1, const void *b2)
 {
-    /* XXX can do better */
     ptql_branch_t *branch1 = (ptql_branch_t *)b1;
     ptql_branch_t *branch2 = (ptql_branch_t *)b2;
-    return
-        branch1->lookup->type -
-        branch2->lookup->type;
+
+    if (branch1->cost != branch2->cost) {
+        return branch1->cost < branch2->cost ? -1 : 1;
+    }
+    return branch1->order < branch2->order ? -1 : 1;
+}
+
+/* State and Mem read only the members the branches look at */
+static int ptql_source_fetch(sigar_t *sigar, ptql_source_t *source,
+                             sigar_pid_t pid)
+{
+    if (source->get == (ptql_get_t)sigar_proc_state_get) {
+        return sigar_proc_state_get_ex(sigar, pid, source->fields,
+                                       source->data);
+    }
+    if (source->get == (ptql_get_t)sigar_proc_mem_get) {
+        return sigar_proc_mem_get_ex(sigar, pid, source->fields,
+                                     source->data);
+    }
+
+    return source->get(sigar, pid, source->data);
+}
+
+static int ptql_sources_alloc(sigar_ptql_query_t *query)
+{
+    int i;
+
+    for (i=0; i<query->nsources; i++) {
+        ptql_source_t *source = &query->sources[i];
+
+        source->gen = 0;
+        source->data = malloc(source->data_size);
+        if (!source->data) {
+            return ENOMEM;
+        }
+    }
+
+    for (i=0; i<query->branches.number; i++) {
+        ptql_branch_t *branch = &query->branches.data[i];
+
+        if (branch->source >= 0) {
+            /* data_size stays 0, the source owns the buffer */
+            branch->data.ptr = query->sources[branch->source].data;
+        }
+    }
+
+    return SIGAR_OK;
+}
+
+static void ptql_sources_free(sigar_ptql_query_t *query)
+{
+    int i;
+
+    for (i=0; i<query->nsources; i++) {
+        if (query->sources[i].data) {
+            free(query->sources[i].data);
+        }
+    }
+    if (query->sources) {
+        free(query->sources);
+    }
+}
+
+static void ptql_args_free(ptql_args_source_t *args)
+{
+    if (args) {
+        sigar_proc_args_destroy(NULL, &args->args);
+        free(args);
+    }
+}
+
+static void ptql_results_free(sigar_ptql_query_t *query)
+{
+    if (query->results) {
+        sigar_cache_destroy(query->results);
+        query->results = NULL;
+    }
+    sigar_proc_list_destroy(NULL, &query->cached);
+}
+
+/* group the (sorted) branches by the struct each one reads */
+static int ptql_query_compile(sigar_ptql_query_t *query)
+{
+    int i, j;
+
+    query->sources =
+        calloc(query->branches.number, sizeof(*query->sources));
+    if (!query->sources) {
+        return ENOMEM;
+    }
+
+    query->cacheable = 1;
+
+    for (i=0; i<query->branches.number; i++) {
+        ptql_branch_t *branch = &query->branches.data[i];
+        ptql_lookup_t *lookup = branch->lookup;
+        int parent = (branch->op_flags & PTQL_OP_FLAG_PARENT) ? 1 : 0;
+
+        if (!branch->stable) {
+            query->cacheable = 0;
+        }
+        /* the percent is against the handle's previous sigar_proc_cpu_get */
+        if ((lookup->get == (ptql_get_t)sigar_proc_cpu_get) &&
+            (lookup->offset == sigar_offsetof(sigar_proc_cpu_t, percent)))
+        {
+            branch->history = query->history = 1;
+        }
+        if (PTQL_IS_ARGS(branch) && !query->args) {
+            query->args = calloc(1, sizeof(*query->args));
+            if (!query->args) {
+                return ENOMEM;
+            }
+        }
+
+        if (lookup->type == PTQL_VALUE_TYPE_ANY) {
+            continue;
+        }
+
+        for (j=0; j<query->nsources; j++) {
+            if ((query->sources[j].get == lookup->get) &&
+                (query->sources[j].parent == parent))
+            {
+                break;
+            }
+        }
+
+        if (j == query->nsources) {
+            query->sources[j].get = lookup->get;
+            query->sources[j].data_size = lookup->data_size;
+            query->sources[j].parent = parent;
+            query->nsources++;
+
+            if (!parent &&
+                (lookup->get == (ptql_get_t)sigar_proc_state_get))
+            {
+                query->state_source = j;
+            }
+        }
+        query->sources[j].fields |= lookup->field;
+
+        branch->source = j;
+    }
+
+    for (i=0; i<query->branches.number; i++) {
+        ptql_branch_t *branch = &query->branches.data[i];
+
+        if ((branch->op_flags & PTQL_OP_FLAG_REF) &&
+            query->branches.data[branch->value.ui32].history)
+        {
+            branch->history = 1;
+        }
+    }
+
+    if (query->state_source >= 0) {
+        /* the parent branches take their ppid from it */
+        for (i=0; i<query->branches.number; i++) {
+            if (query->branches.data[i].op_flags & PTQL_OP_FLAG_PARENT) {
+                query->sources[query->state_source].fields |=
+                    SIGAR_PROC_STATE_F_PPID;
+                break;
+            }
+        }
+    }
+
+    return ptql_sources_alloc(query);
 }
 
 SIGAR_DECLARE(int) sigar_ptql_query_create(sigar_ptql_query_t **queryp,
@@ -1689,10 +2275,12 @@ SIGAR_DECLARE(int) sigar_ptql_query_create(sigar_ptql_query_t **queryp,
     int status = SIGAR_OK;
     int has_ref = 0;
     sigar_ptql_query_t *query =
-        *queryp = malloc(sizeof(*query));
+        *queryp = calloc(1, sizeof(*query));
 
     (void)ptql_error(error, "Malformed query");
 
+    query->state_source = -1;
+
 #ifdef PTQL_DEBUG
     query->ptql = sigar_strdup(ptql);
 #endif
@@ -1738,11 +2326,20 @@ SIGAR_DECLARE(int) sigar_ptql_query_create(sigar_ptql_query_t **queryp,
         sigar_ptql_query_destroy(query);
         *queryp = NULL;
     }
-    else if (!has_ref && (query->branches.number > 1)) {
-        qsort(query->branches.data,
-              query->branches.number,
-              sizeof(query->branches.data[0]),
-              ptql_branch_compare);
+    else {
+        /* $N refs are positional, those queries run as written */
+        if (!has_ref && (query->branches.number > 1)) {
+            qsort(query->branches.data,
+                  query->branches.number,
+                  sizeof(query->branches.data[0]),
+                  ptql_branch_compare);
+        }
+
+        if ((status = ptql_query_compile(query)) != SIGAR_OK) {
+            sigar_ptql_query_destroy(query);
+            *queryp = NULL;
+            (void)ptql_error(error, "Out of memory");
+        }
     }
 
     if (status == SIGAR_OK) {
@@ -1757,10 +2354,22 @@ SIGAR_DECLARE(int) sigar_ptql_query_destroy(sigar_ptql_query_t *query)
     free(query->ptql);
 #endif
     ptql_branch_list_destroy(&query->branches);
+    ptql_sources_free(query);
+    ptql_results_free(query);
+    ptql_args_free(query->args);
     free(query);
     return SIGAR_OK;
 }
 
+SIGAR_DECLARE(int) sigar_ptql_cache_set(sigar_t *sigar, int enable)
+{
+    sigar->ptql_cache = enable;
+    if (!enable) {
+        sigar_ptql_names_free(sigar); /* not kept up while off */
+    }
+    return SIGAR_OK;
+}
+
 SIGAR_DECLARE(void) sigar_ptql_re_impl_set(sigar_t *sigar, void *data,
                                            sigar_ptql_re_impl_t impl)
 {
@@ -1768,30 +2377,83 @@ SIGAR_DECLARE(void) sigar_ptql_re_impl_set(sigar_t *sigar, void *data,
     sigar->ptql_re_impl = impl;
 }
 
-SIGAR_DECLARE(int) sigar_ptql_query_match(sigar_t *sigar,
-                                          sigar_ptql_query_t *query,
-                                          sigar_pid_t query_pid)
+/*
+ * gen identifies the pid being matched: sources, args and preds
+ * fetched under the same gen are reused, which is also how the
+ * queries of a set share them.
+ */
+static int ptql_query_match_gen(sigar_t *sigar,
+                                sigar_ptql_query_t *query,
+                                sigar_pid_t query_pid,
+                                unsigned long gen)
 {
-    int i;
+    sigar_pid_t ppid = 0;
+    int i, have_ppid = 0;
 
     for (i=0; i<query->branches.number; i++) {
         sigar_pid_t pid = query_pid;
         int status, matched=0;
         ptql_branch_t *branch = &query->branches.data[i];
         ptql_lookup_t *lookup = branch->lookup;
+        ptql_pred_t *pred = NULL;
 
-        if (branch->op_flags & PTQL_OP_FLAG_PARENT) {
-            sigar_proc_state_t state;
+        if (branch->history && query->defer_history) {
+            continue;
+        }
 
-            status = sigar_proc_state_get(sigar, pid, &state);
+        if (query->preds && (branch->pred >= 0)) {
+            pred = &query->preds[branch->pred];
+            if (pred->gen == gen) {
+                if (!pred->matched) {
+                    return 1;
+                }
+                continue;
+            }
+        }
+
+        if ((branch->op_flags & PTQL_OP_FLAG_PARENT) && !have_ppid) {
+            sigar_proc_state_t state, *statep = &state;
+
+            if (query->state_source >= 0) {
+                /* the pid's own State branches need it anyway */
+                ptql_source_t *source = &query->sources[query->state_source];
+
+                if (source->gen != gen) {
+                    source->status = ptql_source_fetch(sigar, source, pid);
+                    source->gen = gen;
+                }
+                status = source->status;
+                statep = (sigar_proc_state_t *)source->data;
+            }
+            else {
+                status = sigar_proc_state_get_ex(sigar, pid,
+                                                 SIGAR_PROC_STATE_F_PPID,
+                                                 &state);
+            }
             if (status != SIGAR_OK) {
                 return status;
             }
 
-            pid = state.ppid;
+            ppid = statep->ppid;
+            have_ppid = 1;
+        }
+        if (branch->op_flags & PTQL_OP_FLAG_PARENT) {
+            pid = ppid;
         }
 
-        if (lookup->type == PTQL_VALUE_TYPE_ANY) {
+        if (query->args && PTQL_IS_ARGS(branch)) {
+            ptql_args_source_t *args = query->args;
+
+            if (args->gen != gen) {
+                sigar_proc_args_destroy(sigar, &args->args);
+                args->status = sigar_proc_args_get(sigar, pid, &args->args);
+                args->gen = gen;
+            }
+            if (args->status == SIGAR_OK) {
+                matched = ptql_args_list_match(sigar, branch, &args->args);
+            }
+        }
+        else if (lookup->type == PTQL_VALUE_TYPE_ANY) {
             /* Args, Env, etc. */
             status = lookup->get(sigar, pid, branch);
             if (status == SIGAR_OK) {
@@ -1800,12 +2462,13 @@ SIGAR_DECLARE(int) sigar_ptql_query_match(sigar_t *sigar,
         }
         else {
             /* standard sigar_proc_*_get / structptr + offset */
-            if (!branch->data.ptr) {
-                branch->data_size = lookup->data_size;
-                branch->data.ptr = malloc(branch->data_size);
+            ptql_source_t *source = &query->sources[branch->source];
+
+            if (source->gen != gen) {
+                source->status = ptql_source_fetch(sigar, source, pid);
+                source->gen = gen;
             }
-            status = lookup->get(sigar, pid, branch->data.ptr);
-            if (status != SIGAR_OK) {
+            if ((status = source->status) != SIGAR_OK) {
                 return status;
             }
 
@@ -1825,6 +2488,11 @@ SIGAR_DECLARE(int) sigar_ptql_query_match(sigar_t *sigar,
             }
         }
 
+        if (pred) {
+            pred->gen = gen;
+            pred->matched = matched;
+        }
+
         if (!matched) {
             return 1;
         }
@@ -1833,144 +2501,1465 @@ SIGAR_DECLARE(int) sigar_ptql_query_match(sigar_t *sigar,
     return SIGAR_OK;
 }
 
-static int ptql_proc_list_get(sigar_t *sigar,
-                              sigar_ptql_query_t *query,
-                              sigar_proc_list_t **proclist)
+SIGAR_DECLARE(int) sigar_ptql_query_match(sigar_t *sigar,
+                                          sigar_ptql_query_t *query,
+                                          sigar_pid_t query_pid)
 {
-    int status;
-    int i;
+    return ptql_query_match_gen(sigar, query, query_pid, ++query->gen);
+}
 
-    *proclist = NULL;
+/*
+ * a pid seen for the first time may not have exec'd yet, so it is
+ * matched again on the next call before its result is kept, and once
+ * more whenever ptql_proc_identity moves.  with sigar_proc_events open
+ * an exec is seen as it happens instead.
+ */
+#define PTQL_RESULT_SETTLED 2
 
-    for (i=0; i<query->branches.number; i++) {
-        ptql_branch_t *branch = &query->branches.data[i];
+#define PTQL_RESULT_SETTLED_EVENTS 1
 
-        if (branch->op_flags & PTQL_OP_FLAG_PID) {
-            /* pre-filter pid list for Pid.* queries */
-            /* XXX multiple Pid.* may result in dups */
-            if (*proclist == NULL) {
-                *proclist = malloc(sizeof(**proclist));
-                SIGAR_ZERO(*proclist);
-                sigar_proc_list_create(*proclist);
-            }
-            status = ptql_pid_list_get(sigar, branch, *proclist);
-            if (status != SIGAR_OK) {
-                sigar_proc_list_destroy(sigar, *proclist);
-                free(*proclist);
-                return status;
-            }
-        }
-    }
+/*
+ * State.Name and Exe.Name of every pid, kept up across calls the way
+ * cached query results are: a pid is read when it first shows up and
+ * once more on the next call in case it had not exec'd yet, or again
+ * after an exec seen by sigar_proc_events or a move of its
+ * ptql_proc_identity.  names are hashed folded to lower case, so a
+ * bucket only holds candidates and each of them still goes through
+ * the whole query.
+ */
+#define PTQL_NAME_STATE 0
+#define PTQL_NAME_EXE   1
+#define PTQL_NAME_MAX   2
 
-    if (*proclist) {
-        return SIGAR_OK;
-    }
+typedef struct {
+    unsigned long serial; /* last update that listed the pid */
+    sigar_uint64_t exec;  /* sigar_proc_events_serial when read */
+    int evals;
+    int indexed;          /* in the bucket of hash */
+    sigar_uint64_t hash;
+    sigar_uint64_t identity; /* ptql_proc_identity when read */
+} ptql_name_pid_t;
 
-    status = sigar_proc_list_get(sigar, NULL);
-    if (status != SIGAR_OK) {
-        return status;
-    }
-    *proclist = sigar->pids;
-    return SIGAR_OK;
-}
+typedef struct {
+    sigar_cache_t *pids;      /* pid -> ptql_name_pid_t */
+    sigar_cache_t *buckets;   /* name hash -> sigar_proc_list_t */
+    sigar_proc_list_t listed; /* pids in pids */
+    unsigned long serial;
+} ptql_name_index_t;
+
+struct sigar_ptql_names_t {
+    ptql_name_index_t index[PTQL_NAME_MAX];
+};
 
-static int ptql_proc_list_destroy(sigar_t *sigar,
-                                  sigar_proc_list_t *proclist)
+static sigar_uint64_t ptql_name_hash(const char *name)
 {
-    if (proclist != sigar->pids) {
-        sigar_proc_list_destroy(sigar, proclist);
-        free(proclist);
+    sigar_uint64_t hash = 14695981039346656037ULL; /* fnv-1a */
+
+    while (*name) {
+        hash ^= (unsigned char)sigar_tolower(*name);
+        hash *= 1099511628211ULL;
+        name++;
     }
 
-    return SIGAR_OK;
+    return hash;
 }
 
-SIGAR_DECLARE(int) sigar_ptql_query_find_process(sigar_t *sigar,
-                                                 sigar_ptql_query_t *query,
-                                                 sigar_pid_t *pid)
+/*
+ * comm and start time of a pid, from the one stat read sigar keeps
+ * cached.  without sigar_proc_events an exec only shows as a new comm
+ * and a reused pid as a new start time, so a settled pid whose
+ * identity moved is read again.
+ */
+static int ptql_proc_identity(sigar_t *sigar, sigar_pid_t pid,
+                              sigar_uint64_t *identity)
 {
+    sigar_proc_state_t state;
+    sigar_proc_time_t ptime;
     int status;
-    int i, matches=0;
-    sigar_proc_list_t *pids;
 
-    status = ptql_proc_list_get(sigar, query, &pids);
-    if (status != SIGAR_OK) {
+    if ((status = sigar_proc_state_get_ex(sigar, pid,
+                                          SIGAR_PROC_STATE_F_NAME,
+                                          &state)) != SIGAR_OK)
+    {
+        return status;
+    }
+    if ((status = sigar_proc_time_get(sigar, pid, &ptime)) != SIGAR_OK) {
         return status;
     }
 
-    for (i=0; i<pids->number; i++) {
-        int query_status =
-            sigar_ptql_query_match(sigar, query, pids->data[i]);
+    *identity = ptql_name_hash(state.name) ^
+        (ptime.start_time * 1099511628211ULL);
 
-        if (query_status == SIGAR_OK) {
-            *pid = pids->data[i];
-            matches++;
+    return SIGAR_OK;
+}
+
+/*
+ * whether pid may have exec'd or been reused since exec and identity
+ * were last set, which they are updated to.  sigar_proc_events says so
+ * from its serials alone, ptql_proc_identity is only read without it.
+ */
+static int ptql_proc_moved(sigar_t *sigar, sigar_pid_t pid,
+                           sigar_uint64_t *exec, sigar_uint64_t *identity)
+{
+    sigar_uint64_t now = 0;
+
+    if (sigar->proc_events) {
+        now = sigar_proc_events_serial(sigar, pid);
+        if (*exec == now) {
+            return 0;
         }
-        else if (query_status == SIGAR_ENOTIMPL) {
-            /* let caller know query is invalid. */
-            status = query_status;
-            break;
-        } /* else ok, e.g. permission denied */
+        *exec = now;
+    }
+    else {
+        /* unreadable counts as a change, the read after then fails */
+        ptql_proc_identity(sigar, pid, &now);
+        if (*identity == now) {
+            return 0;
+        }
+        *identity = now;
     }
 
-    ptql_proc_list_destroy(sigar, pids);
+    return 1;
+}
 
-    if (status != SIGAR_OK) {
-        return status;
-    }
+static void ptql_name_bucket_free(void *ptr)
+{
+    sigar_proc_list_t *bucket = ptr;
 
-    if (matches == 1) {
-        return SIGAR_OK;
-    }
-    else if (matches == 0) {
-        sigar_strerror_set(sigar,
-                           "Query did not match any processes");
+    sigar_proc_list_destroy(NULL, bucket);
+    free(bucket);
+}
+
+static int ptql_name_read(sigar_t *sigar, int kind, sigar_pid_t pid,
+                          sigar_uint64_t *hash)
+{
+    int status;
+
+    if (kind == PTQL_NAME_STATE) {
+        sigar_proc_state_t state;
+
+        if ((status = sigar_proc_state_get_ex(sigar, pid,
+                                              SIGAR_PROC_STATE_F_NAME,
+                                              &state)) == SIGAR_OK)
+        {
+            *hash = ptql_name_hash(state.name);
+        }
     }
     else {
-        sigar_strerror_printf(sigar,
-                              "Query matched multiple processes (%d)",
-                              matches);
+        sigar_proc_exe_t exe;
+
+        if ((status = sigar_proc_exe_get(sigar, pid, &exe)) == SIGAR_OK) {
+            *hash = ptql_name_hash(exe.name);
+        }
     }
 
-    return -1;
+    return status;
 }
 
-SIGAR_DECLARE(int) sigar_ptql_query_find(sigar_t *sigar,
-                                         sigar_ptql_query_t *query,
-                                         sigar_proc_list_t *proclist)
+static void ptql_name_unindex(ptql_name_index_t *index, sigar_pid_t pid,
+                              ptql_name_pid_t *np)
 {
-    int status;
+    sigar_cache_entry_t *entry = sigar_cache_find(index->buckets, np->hash);
     int i;
-    sigar_proc_list_t *pids;
 
-    status = ptql_proc_list_get(sigar, query, &pids);
-    if (status != SIGAR_OK) {
-        return status;
-    }
+    np->indexed = 0;
 
-    sigar_proc_list_create(proclist);
+    if (!entry) {
+        return;
+    }
+    else {
+        sigar_proc_list_t *bucket = entry->value;
+
+        for (i=0; i<bucket->number; i++) {
+            if (bucket->data[i] == pid) {
+                memmove(&bucket->data[i], &bucket->data[i+1],
+                        sizeof(pid) * (bucket->number - i - 1));
+                bucket->number--;
+                break;
+            }
+        }
+
+        if (bucket->number == 0) {
+            sigar_cache_remove(index->buckets, np->hash);
+        }
+    }
+}
+
+static int ptql_name_index_add(ptql_name_index_t *index, sigar_pid_t pid,
+                               ptql_name_pid_t *np)
+{
+    sigar_cache_entry_t *entry = sigar_cache_get(index->buckets, np->hash);
+    sigar_proc_list_t *bucket = entry->value;
+
+    if (!bucket) {
+        if (!(bucket = malloc(sizeof(*bucket)))) {
+            return ENOMEM;
+        }
+        sigar_proc_list_create(bucket);
+        entry->value = bucket;
+    }
+
+    SIGAR_PROC_LIST_GROW(bucket);
+    bucket->data[bucket->number++] = pid;
+    np->indexed = 1;
+
+    return SIGAR_OK;
+}
+
+static void ptql_name_index_free(ptql_name_index_t *index)
+{
+    if (index->pids) {
+        sigar_cache_destroy(index->pids);
+        sigar_cache_destroy(index->buckets);
+        sigar_proc_list_destroy(NULL, &index->listed);
+        index->pids = index->buckets = NULL;
+    }
+}
+
+void sigar_ptql_names_free(sigar_t *sigar)
+{
+    int i;
+
+    if (!sigar->ptql_names) {
+        return;
+    }
+
+    for (i=0; i<PTQL_NAME_MAX; i++) {
+        ptql_name_index_free(&sigar->ptql_names->index[i]);
+    }
+    free(sigar->ptql_names);
+    sigar->ptql_names = NULL;
+}
+
+/* diff sigar->pids against the last update, reading only what is new */
+static int ptql_name_index_update(sigar_t *sigar, int kind,
+                                  ptql_name_index_t **indexp)
+{
+    ptql_name_index_t *index;
+    sigar_proc_list_t *pids = sigar->pids;
+    unsigned long serial;
+    int settled = sigar->proc_events ?
+        PTQL_RESULT_SETTLED_EVENTS : PTQL_RESULT_SETTLED;
+    int i, status = SIGAR_OK;
+
+    if (!sigar->ptql_names &&
+        !(sigar->ptql_names = calloc(1, sizeof(*sigar->ptql_names))))
+    {
+        return ENOMEM;
+    }
+    index = &sigar->ptql_names->index[kind];
+
+    if (!index->pids) {
+        index->pids = sigar_cache_new(pids->number * 2 + 1);
+        index->buckets = sigar_cache_new(pids->number + 1);
+        index->buckets->free_value = ptql_name_bucket_free;
+        sigar_proc_list_create(&index->listed);
+    }
+    serial = ++index->serial;
+
+    for (i=0; i<pids->number; i++) {
+        sigar_pid_t pid = pids->data[i];
+        sigar_cache_entry_t *entry = sigar_cache_get(index->pids, pid);
+        ptql_name_pid_t *np = entry->value;
+        sigar_uint64_t hash;
+        int read_status;
+
+        if (!np) {
+            entry->value = np =
+                sigar_cache_value_new(index->pids, sizeof(*np));
+        }
+        np->serial = serial;
+
+        /* re-keyed below once read again */
+        if (ptql_proc_moved(sigar, pid, &np->exec, &np->identity)) {
+            np->evals = 0;
+        }
+
+        if (np->evals >= settled) {
+            continue;
+        }
+        np->evals++;
+
+        read_status = ptql_name_read(sigar, kind, pid, &hash);
+        if (read_status == SIGAR_ENOTIMPL) {
+            status = read_status;
+            break;
+        }
+
+        if (np->indexed &&
+            ((read_status != SIGAR_OK) || (hash != np->hash)))
+        {
+            ptql_name_unindex(index, pid, np);
+        }
+        /* like a failed match, a pid that cannot be read is left out */
+        if ((read_status == SIGAR_OK) && !np->indexed) {
+            np->hash = hash;
+            if ((status = ptql_name_index_add(index, pid, np)) != SIGAR_OK) {
+                break;
+            }
+        }
+    }
+
+    if (status != SIGAR_OK) {
+        ptql_name_index_free(index);
+        return status;
+    }
+
+    for (i=0; i<index->listed.number; i++) {
+        sigar_pid_t pid = index->listed.data[i];
+        sigar_cache_entry_t *entry = sigar_cache_find(index->pids, pid);
+        ptql_name_pid_t *np = entry ? entry->value : NULL;
+
+        if (np && (np->serial != serial)) {
+            if (np->indexed) {
+                ptql_name_unindex(index, pid, np);
+            }
+            sigar_cache_remove(index->pids, pid);
+        }
+    }
+
+    index->listed.number = 0;
+    for (i=0; i<pids->number; i++) {
+        sigar_proc_list_t *listed = &index->listed;
+
+        SIGAR_PROC_LIST_GROW(listed);
+        listed->data[listed->number++] = pids->data[i];
+    }
+
+    *indexp = index;
+
+    return SIGAR_OK;
+}
+
+/* State.Name.eq or Exe.Name.eq of the pid itself with a literal value */
+static int ptql_name_branch_kind(ptql_branch_t *branch)
+{
+    ptql_lookup_t *lookup = branch->lookup;
+
+    if ((branch->op_name != PTQL_OP_EQ) ||
+        (branch->op_flags & (PTQL_OP_FLAG_PARENT | PTQL_OP_FLAG_REF)) ||
+        !branch->value.str)
+    {
+        return -1;
+    }
+
+    if (lookup == &PTQL_State[1]) {
+        return PTQL_NAME_STATE;
+    }
+    if (lookup == &PTQL_Exe[0]) {
+        return PTQL_NAME_EXE;
+    }
+
+    return -1;
+}
+
+/*
+ * the candidates for the query's first name branch, ENOENT when it has
+ * none or the index cannot be used and every pid has to be matched.
+ */
+static int ptql_name_list_get(sigar_t *sigar,
+                              sigar_ptql_query_t *query,
+                              sigar_proc_list_t *proclist)
+{
+    ptql_name_index_t *index;
+    sigar_cache_entry_t *entry;
+    int i, kind = -1, status;
+    char *name = NULL;
+
+    if (!sigar->ptql_cache) {
+        return ENOENT;
+    }
+
+    for (i=0; i<query->branches.number; i++) {
+        ptql_branch_t *branch = &query->branches.data[i];
+
+        if ((kind = ptql_name_branch_kind(branch)) >= 0) {
+            name = branch->value.str;
+            break;
+        }
+    }
+
+    if (kind < 0) {
+        return ENOENT;
+    }
+
+    if ((status = sigar_proc_list_get(sigar, NULL)) != SIGAR_OK) {
+        return status;
+    }
+
+    if ((status = ptql_name_index_update(sigar, kind, &index)) != SIGAR_OK) {
+        return ENOENT;
+    }
+
+    entry = sigar_cache_find(index->buckets, ptql_name_hash(name));
+    if (entry) {
+        sigar_proc_list_t *bucket = entry->value;
+
+        for (i=0; i<bucket->number; i++) {
+            SIGAR_PROC_LIST_GROW(proclist);
+            proclist->data[proclist->number++] = bucket->data[i];
+        }
+    }
+
+    return SIGAR_OK;
+}
+
+/* the subtree of the query's first Tree branch, ENOENT without one */
+static int ptql_tree_list_get(sigar_t *sigar,
+                              sigar_ptql_query_t *query,
+                              sigar_proc_list_t *proclist)
+{
+    sigar_proc_tree_t tree;
+    ptql_tree_t *branch_tree = NULL;
+    int i, status;
+
+    for (i=0; i<query->branches.number; i++) {
+        ptql_branch_t *branch = &query->branches.data[i];
+
+        if ((branch->lookup == PTQL_Tree) &&
+            !(branch->op_flags & PTQL_OP_FLAG_PARENT))
+        {
+            branch_tree = branch->data.ptr;
+            break;
+        }
+    }
+
+    if (!branch_tree) {
+        return ENOENT;
+    }
+
+    status = sigar_proc_tree_build(sigar, SIGAR_PROC_SNAPSHOT_STATE |
+                                   SIGAR_PROC_SNAPSHOT_STATE_FIELDS(
+                                       SIGAR_PROC_STATE_F_PPID), 0,
+                                   &tree);
+    if (status != SIGAR_OK) {
+        return status;
+    }
+
+    sigar_proc_list_destroy(NULL, &branch_tree->pids);
+    status = sigar_proc_tree_pids_get(&tree, branch_tree->root,
+                                      &branch_tree->pids);
+    sigar_proc_tree_destroy(sigar, &tree);
+
+    if (status != SIGAR_OK) {
+        sigar_proc_list_create(&branch_tree->pids); /* root is gone */
+    }
+    qsort(branch_tree->pids.data, branch_tree->pids.number,
+          sizeof(sigar_pid_t), ptql_pid_cmp);
+    branch_tree->indexed = 1;
+
+    for (i=0; i<branch_tree->pids.number; i++) {
+        SIGAR_PROC_LIST_GROW(proclist);
+        proclist->data[proclist->number++] = branch_tree->pids.data[i];
+    }
+
+    return SIGAR_OK;
+}
+
+static int ptql_proc_list_get(sigar_t *sigar,
+                              sigar_ptql_query_t *query,
+                              sigar_proc_list_t **proclist)
+{
+    int status;
+    int i;
+
+    *proclist = NULL;
+
+    for (i=0; i<query->branches.number; i++) {
+        ptql_branch_t *branch = &query->branches.data[i];
+
+        if (branch->op_flags & PTQL_OP_FLAG_PID) {
+            /* pre-filter pid list for Pid.* queries */
+            /* XXX multiple Pid.* may result in dups */
+            if (*proclist == NULL) {
+                *proclist = malloc(sizeof(**proclist));
+                SIGAR_ZERO(*proclist);
+                sigar_proc_list_create(*proclist);
+            }
+            status = ptql_pid_list_get(sigar, branch, *proclist);
+            if (status != SIGAR_OK) {
+                sigar_proc_list_destroy(sigar, *proclist);
+                free(*proclist);
+                return status;
+            }
+        }
+    }
+
+    if (*proclist) {
+        return SIGAR_OK;
+    }
+
+    /* likewise Tree.Root, or State.Name and Exe.Name from the index */
+    *proclist = malloc(sizeof(**proclist));
+    if (!*proclist) {
+        return ENOMEM;
+    }
+    sigar_proc_list_create(*proclist);
+
+    status = ptql_tree_list_get(sigar, query, *proclist);
+    if (status == ENOENT) {
+        status = ptql_name_list_get(sigar, query, *proclist);
+    }
+    if (status == SIGAR_OK) {
+        return SIGAR_OK;
+    }
+    sigar_proc_list_destroy(sigar, *proclist);
+    free(*proclist);
+    *proclist = NULL;
+
+    if (status != ENOENT) {
+        return status;
+    }
+
+    status = sigar_proc_list_get(sigar, NULL);
+    if (status != SIGAR_OK) {
+        return status;
+    }
+    *proclist = sigar->pids;
+    return SIGAR_OK;
+}
+
+static int ptql_proc_list_destroy(sigar_t *sigar,
+                                  sigar_ptql_query_t *query,
+                                  sigar_proc_list_t *proclist)
+{
+    int i;
+
+    /* lone matches walk the ppids again */
+    for (i=0; i<query->branches.number; i++) {
+        ptql_branch_t *branch = &query->branches.data[i];
+
+        if (branch->lookup == PTQL_Tree) {
+            ((ptql_tree_t *)branch->data.ptr)->indexed = 0;
+        }
+    }
+
+    if (proclist != sigar->pids) {
+        sigar_proc_list_destroy(sigar, proclist);
+        free(proclist);
+    }
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int) sigar_ptql_query_find_process(sigar_t *sigar,
+                                                 sigar_ptql_query_t *query,
+                                                 sigar_pid_t *pid)
+{
+    int status;
+    int i, matches=0;
+    sigar_proc_list_t *pids;
+
+    status = ptql_proc_list_get(sigar, query, &pids);
+    if (status != SIGAR_OK) {
+        return status;
+    }
 
     for (i=0; i<pids->number; i++) {
         int query_status =
             sigar_ptql_query_match(sigar, query, pids->data[i]);
 
         if (query_status == SIGAR_OK) {
-            SIGAR_PROC_LIST_GROW(proclist);
-            proclist->data[proclist->number++] = pids->data[i];
+            *pid = pids->data[i];
+            matches++;
         }
         else if (query_status == SIGAR_ENOTIMPL) {
             /* let caller know query is invalid. */
             status = query_status;
             break;
-        }
+        } /* else ok, e.g. permission denied */
     }
 
-    ptql_proc_list_destroy(sigar, pids);
+    ptql_proc_list_destroy(sigar, query, pids);
 
     if (status != SIGAR_OK) {
-        sigar_proc_list_destroy(sigar, proclist);
         return status;
     }
 
-    return SIGAR_OK;
+    if (matches == 1) {
+        return SIGAR_OK;
+    }
+    else if (matches == 0) {
+        sigar_strerror_set(sigar,
+                           "Query did not match any processes");
+    }
+    else {
+        sigar_strerror_printf(sigar,
+                              "Query matched multiple processes (%d)",
+                              matches);
+    }
+
+    return -1;
+}
+
+typedef struct {
+    sigar_ptql_query_t *query;
+    sigar_ptql_query_t *queries; /* one per worker, created on first use */
+    sigar_proc_list_t *pids;
+    char *matched;
+} ptql_find_walk_t;
+
+/*
+ * match fetches into the query's sources, so every worker gets a
+ * copy of the branches and sources with buffers of its own; the
+ * parsed values are shared read-only.  a worker handle only sees the
+ * pids of the slices it took, so history branches are skipped there
+ * and matched on the caller's handle once the walk is done.
+ */
+static int ptql_query_worker_init(sigar_ptql_query_t *query,
+                                  sigar_ptql_query_t *copy)
+{
+    int i;
+
+    *copy = *query;
+    copy->args = NULL;
+
+    copy->branches.size = query->branches.number;
+    copy->branches.data =
+        malloc(sizeof(*copy->branches.data) * query->branches.number);
+    copy->sources = calloc(query->nsources + 1, sizeof(*copy->sources));
+    if (!copy->branches.data || !copy->sources) {
+        return ENOMEM;
+    }
+
+    memcpy(copy->branches.data, query->branches.data,
+           sizeof(*copy->branches.data) * query->branches.number);
+    memcpy(copy->sources, query->sources,
+           sizeof(*copy->sources) * query->nsources);
+    for (i=0; i<copy->nsources; i++) {
+        copy->sources[i].data = NULL; /* still the query's */
+    }
+    copy->gen = 0;
+    copy->defer_history = query->history;
+
+    if (query->args) {
+        copy->args = calloc(1, sizeof(*copy->args));
+        if (!copy->args) {
+            return ENOMEM;
+        }
+    }
+
+    return ptql_sources_alloc(copy);
+}
+
+static void ptql_query_worker_free(sigar_ptql_query_t *copy)
+{
+    if (copy->branches.data) {
+        free(copy->branches.data);
+    }
+    ptql_args_free(copy->args);
+    /* NULL when init never got that far, nsources is still the query's */
+    if (copy->sources) {
+        ptql_sources_free(copy);
+    }
+}
+
+static int ptql_find_walk(sigar_t *sigar, void *data, int worker,
+                          unsigned long start, unsigned long end)
+{
+    ptql_find_walk_t *walk = data;
+    sigar_ptql_query_t *query = &walk->queries[worker];
+    unsigned long i;
+
+    if (!query->branches.data) {
+        int status = ptql_query_worker_init(walk->query, query);
+        if (status != SIGAR_OK) {
+            return status;
+        }
+    }
+
+    for (i=start; i<end; i++) {
+        int query_status =
+            sigar_ptql_query_match(sigar, query, walk->pids->data[i]);
+
+        if (query_status == SIGAR_ENOTIMPL) {
+            return query_status;
+        }
+        walk->matched[i] = (query_status == SIGAR_OK);
+    }
+
+    return SIGAR_OK;
+}
+
+static int ptql_query_find_parallel(sigar_t *sigar,
+                                    sigar_ptql_query_t *query,
+                                    sigar_proc_list_t *pids,
+                                    sigar_proc_list_t *proclist)
+{
+    ptql_find_walk_t walk;
+    int i, status;
+
+    walk.query = query;
+    walk.pids = pids;
+    walk.queries = calloc(sigar->proc_scan_threads, sizeof(*walk.queries));
+    walk.matched = calloc(pids->number, 1);
+    if (!walk.queries || !walk.matched) {
+        free(walk.queries);
+        free(walk.matched);
+        return ENOMEM;
+    }
+
+    status = sigar_parallel_walk(sigar, pids->number,
+                                 ptql_find_walk, &walk);
+
+    if (status == SIGAR_OK) {
+        /* in pid list order, same as the serial scan */
+        for (i=0; i<pids->number; i++) {
+            if (walk.matched[i] && query->history) {
+                /* the workers left these to the caller's own handle */
+                int query_status =
+                    sigar_ptql_query_match(sigar, query, pids->data[i]);
+
+                if (query_status == SIGAR_ENOTIMPL) {
+                    status = query_status;
+                    break;
+                }
+                walk.matched[i] = (query_status == SIGAR_OK);
+            }
+            if (walk.matched[i]) {
+                SIGAR_PROC_LIST_GROW(proclist);
+                proclist->data[proclist->number++] = pids->data[i];
+            }
+        }
+    }
+
+    for (i=0; i<sigar->proc_scan_threads; i++) {
+        ptql_query_worker_free(&walk.queries[i]);
+    }
+    free(walk.queries);
+    free(walk.matched);
+
+    return status;
+}
+
+/* append the pids that match to proclist, in pid list order */
+static int ptql_query_find_pids(sigar_t *sigar,
+                                sigar_ptql_query_t *query,
+                                sigar_proc_list_t *pids,
+                                sigar_proc_list_t *proclist)
+{
+    int i;
+
+    if (SIGAR_PARALLEL_SCAN(sigar, pids->number)) {
+        return ptql_query_find_parallel(sigar, query, pids, proclist);
+    }
+
+    for (i=0; i<pids->number; i++) {
+        int query_status =
+            sigar_ptql_query_match(sigar, query, pids->data[i]);
+
+        if (query_status == SIGAR_OK) {
+            SIGAR_PROC_LIST_GROW(proclist);
+            proclist->data[proclist->number++] = pids->data[i];
+        }
+        else if (query_status == SIGAR_ENOTIMPL) {
+            /* let caller know query is invalid. */
+            return query_status;
+        }
+    }
+
+    return SIGAR_OK;
+}
+
+typedef struct {
+    unsigned long serial; /* last find that listed the pid */
+    sigar_uint64_t exec;  /* sigar_proc_events_serial when matched */
+    sigar_uint64_t identity; /* ptql_proc_identity when matched */
+    int matched;
+    int evals;
+} ptql_result_t;
+
+#define PTQL_RESULT(query, pid) \
+    ((ptql_result_t *)sigar_cache_find(query->results, pid)->value)
+
+/*
+ * diff the pid list against the previous call: pids that appeared are
+ * matched, pids that went away are dropped, the rest keep their result.
+ */
+static int ptql_query_find_cached(sigar_t *sigar,
+                                  sigar_ptql_query_t *query,
+                                  sigar_proc_list_t *pids,
+                                  sigar_proc_list_t *proclist)
+{
+    sigar_proc_list_t pending, found;
+    sigar_proc_list_t *pendingp = &pending, *cached = &query->cached;
+    unsigned long serial = ++query->serial;
+    int settled = sigar->proc_events ?
+        PTQL_RESULT_SETTLED_EVENTS : PTQL_RESULT_SETTLED;
+    int i, j, status;
+
+    if (!query->results) {
+        query->results = sigar_cache_new(pids->number * 2 + 1);
+        sigar_proc_list_create(&query->cached);
+    }
+
+    sigar_proc_list_create(&pending);
+
+    for (i=0; i<pids->number; i++) {
+        sigar_cache_entry_t *entry =
+            sigar_cache_get(query->results, pids->data[i]);
+        ptql_result_t *result = entry->value;
+
+        if (!result) {
+            entry->value = result =
+                sigar_cache_value_new(query->results, sizeof(*result));
+        }
+        result->serial = serial;
+
+        if (ptql_proc_moved(sigar, pids->data[i],
+                            &result->exec, &result->identity))
+        {
+            result->evals = 0;
+        }
+
+        if (result->evals < settled) {
+            SIGAR_PROC_LIST_GROW(pendingp);
+            pending.data[pending.number++] = pids->data[i];
+        }
+    }
+
+    sigar_proc_list_create(&found);
+
+    status = ptql_query_find_pids(sigar, query, &pending, &found);
+
+    if (status == SIGAR_OK) {
+        /* found is the matching subsequence of pending */
+        for (i=0, j=0; i<pending.number; i++) {
+            ptql_result_t *result = PTQL_RESULT(query, pending.data[i]);
+
+            result->matched =
+                (j < found.number) && (found.data[j] == pending.data[i]);
+            if (result->matched) {
+                j++;
+            }
+            result->evals++;
+        }
+    }
+
+    sigar_proc_list_destroy(sigar, &found);
+    sigar_proc_list_destroy(sigar, &pending);
+
+    if (status != SIGAR_OK) {
+        ptql_results_free(query);
+        return status;
+    }
+
+    for (i=0; i<cached->number; i++) {
+        sigar_pid_t pid = cached->data[i];
+
+        if (PTQL_RESULT(query, pid)->serial != serial) {
+            sigar_cache_remove(query->results, pid);
+        }
+    }
+
+    cached->number = 0;
+    for (i=0; i<pids->number; i++) {
+        SIGAR_PROC_LIST_GROW(cached);
+        cached->data[cached->number++] = pids->data[i];
+
+        if (PTQL_RESULT(query, pids->data[i])->matched) {
+            SIGAR_PROC_LIST_GROW(proclist);
+            proclist->data[proclist->number++] = pids->data[i];
+        }
+    }
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int) sigar_ptql_query_find(sigar_t *sigar,
+                                         sigar_ptql_query_t *query,
+                                         sigar_proc_list_t *proclist)
+{
+    int status;
+    sigar_proc_list_t *pids;
+
+    status = ptql_proc_list_get(sigar, query, &pids);
+    if (status != SIGAR_OK) {
+        return status;
+    }
+
+    sigar_proc_list_create(proclist);
+
+    /* Pid.* queries already skip the scan */
+    if (sigar->ptql_cache && query->cacheable && (pids == sigar->pids)) {
+        status = ptql_query_find_cached(sigar, query, pids, proclist);
+    }
+    else {
+        if (query->results) {
+            ptql_results_free(query); /* stale once not kept up */
+        }
+        status = ptql_query_find_pids(sigar, query, pids, proclist);
+    }
+
+    ptql_proc_list_destroy(sigar, query, pids);
+
+    if (status != SIGAR_OK) {
+        sigar_proc_list_destroy(sigar, proclist);
+        return status;
+    }
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int) sigar_ptql_query_aggregate(sigar_t *sigar,
+                                              sigar_ptql_query_t *query,
+                                              int flags,
+                                              sigar_ptql_aggregate_t *result)
+{
+    int status, has_share = 0;
+    unsigned long i;
+    sigar_proc_list_t proclist;
+
+    SIGAR_ZERO(result);
+
+    status = sigar_ptql_query_find(sigar, query, &proclist);
+    if (status != SIGAR_OK) {
+        return status;
+    }
+
+    result->processes = proclist.number;
+
+    for (i=0; i<proclist.number; i++) {
+        sigar_pid_t pid = proclist.data[i];
+
+        if (flags & SIGAR_AGG_CPU) {
+            sigar_proc_cpu_t cpu;
+
+            if (sigar_proc_cpu_get(sigar, pid, &cpu) == SIGAR_OK) {
+                result->cpu.user    += cpu.user;
+                result->cpu.sys     += cpu.sys;
+                result->cpu.total   += cpu.total;
+                result->cpu.percent += cpu.percent;
+            }
+        }
+
+        if (flags & SIGAR_AGG_MEM) {
+            sigar_proc_mem_t mem;
+
+            if (sigar_proc_mem_get(sigar, pid, &mem) == SIGAR_OK) {
+                result->mem.size     += mem.size;
+                result->mem.resident += mem.resident;
+                if (mem.share != SIGAR_FIELD_NOTIMPL) {
+                    result->mem.share += mem.share;
+                    has_share = 1;
+                }
+                result->mem.minor_faults += mem.minor_faults;
+                result->mem.major_faults += mem.major_faults;
+                result->mem.page_faults  += mem.page_faults;
+            }
+        }
+    }
+
+    if (!has_share) {
+        result->mem.share = SIGAR_FIELD_NOTIMPL;
+    }
+
+    sigar_proc_list_destroy(sigar, &proclist);
+
+    return SIGAR_OK;
+}
+
+/*
+ * the queries of a set rebuilt as members sharing one table of
+ * sources, args and preds.  each scan worker builds a scan of its own.
+ */
+typedef struct {
+    int number;
+    sigar_ptql_query_t *members;
+    char *prefiltered;   /* Pid.* members, found on their own */
+    int nsources;
+    ptql_source_t *sources;
+    int npreds;
+    ptql_pred_t *preds;
+    ptql_branch_t **pred_branches;
+    ptql_args_source_t args;
+    unsigned long gen;
+} ptql_scan_t;
+
+struct sigar_ptql_query_set_t {
+    unsigned long number;
+    unsigned long size;
+    sigar_ptql_query_t **data;
+    ptql_scan_t *scan;
+};
+
+static int ptql_query_is_prefiltered(sigar_ptql_query_t *query)
+{
+    int i;
+
+    for (i=0; i<query->branches.number; i++) {
+        if (query->branches.data[i].op_flags & PTQL_OP_FLAG_PID) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static int ptql_query_has_ref(sigar_ptql_query_t *query)
+{
+    int i;
+
+    for (i=0; i<query->branches.number; i++) {
+        if (query->branches.data[i].op_flags & PTQL_OP_FLAG_REF) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/* would b1 and b2 give the same answer for any pid */
+static int ptql_branch_same(ptql_branch_t *b1, ptql_branch_t *b2)
+{
+    if ((b1->lookup != b2->lookup) ||
+        (b1->op_name != b2->op_name) ||
+        (b1->op_flags != b2->op_flags))
+    {
+        return 0;
+    }
+
+    if (b1->lookup->get == (ptql_get_t)ptql_env_match) {
+        if (!strEQ(b1->data.str, b2->data.str)) {
+            return 0; /* Env.KEY */
+        }
+    }
+    else if ((b1->lookup->type == PTQL_VALUE_TYPE_ANY) &&
+             !(b1->op_flags & PTQL_OP_FLAG_GLOB) &&
+             (b1->data.ui32 != b2->data.ui32))
+    {
+        return 0; /* Args.N, Modules.N */
+    }
+
+    switch (b1->lookup->type) {
+      case PTQL_VALUE_TYPE_UI64:
+        return b1->value.ui64 == b2->value.ui64;
+      case PTQL_VALUE_TYPE_UI32:
+        return b1->value.ui32 == b2->value.ui32;
+      case PTQL_VALUE_TYPE_DBL:
+        return b1->value.dbl == b2->value.dbl;
+      case PTQL_VALUE_TYPE_CHR:
+        return b1->value.chr[0] == b2->value.chr[0];
+      default:
+        if (!b1->value.str || !b2->value.str) {
+            return b1->value.str == b2->value.str;
+        }
+        return strEQ(b1->value.str, b2->value.str);
+    }
+}
+
+static void ptql_scan_free(ptql_scan_t *scan)
+{
+    int i;
+
+    for (i=0; scan->members && (i<scan->number); i++) {
+        if (scan->members[i].branches.data) {
+            free(scan->members[i].branches.data);
+        }
+    }
+    for (i=0; i<scan->nsources; i++) {
+        if (scan->sources[i].data) {
+            free(scan->sources[i].data);
+        }
+    }
+    sigar_proc_args_destroy(NULL, &scan->args.args);
+
+    free(scan->members);
+    free(scan->prefiltered);
+    free(scan->sources);
+    free(scan->preds);
+    free(scan->pred_branches);
+    free(scan);
+}
+
+static int ptql_scan_source_get(ptql_scan_t *scan, ptql_source_t *source)
+{
+    int i;
+
+    for (i=0; i<scan->nsources; i++) {
+        if ((scan->sources[i].get == source->get) &&
+            (scan->sources[i].parent == source->parent))
+        {
+            scan->sources[i].fields |= source->fields;
+            return i;
+        }
+    }
+
+    scan->sources[i].get = source->get;
+    scan->sources[i].data_size = source->data_size;
+    scan->sources[i].parent = source->parent;
+    scan->sources[i].fields = source->fields;
+    return scan->nsources++;
+}
+
+static int ptql_scan_pred_get(ptql_scan_t *scan, ptql_branch_t *branch)
+{
+    int i;
+
+    for (i=0; i<scan->npreds; i++) {
+        if (ptql_branch_same(scan->pred_branches[i], branch)) {
+            return i;
+        }
+    }
+
+    scan->pred_branches[i] = branch;
+    return scan->npreds++;
+}
+
+static int ptql_scan_build(sigar_ptql_query_set_t *set, ptql_scan_t **scanp)
+{
+    ptql_scan_t *scan;
+    unsigned long i, nbranches=0;
+    int j;
+
+    for (i=0; i<set->number; i++) {
+        nbranches += set->data[i]->branches.number;
+    }
+
+    *scanp = scan = calloc(1, sizeof(*scan));
+    if (!scan) {
+        return ENOMEM;
+    }
+    scan->number = set->number;
+    scan->members = calloc(set->number + 1, sizeof(*scan->members));
+    scan->prefiltered = calloc(set->number + 1, 1);
+    scan->sources = calloc(nbranches + 1, sizeof(*scan->sources));
+    scan->preds = calloc(nbranches + 1, sizeof(*scan->preds));
+    scan->pred_branches =
+        calloc(nbranches + 1, sizeof(*scan->pred_branches));
+
+    if (!scan->members || !scan->prefiltered || !scan->sources ||
+        !scan->preds || !scan->pred_branches)
+    {
+        return ENOMEM;
+    }
+
+    for (i=0; i<set->number; i++) {
+        sigar_ptql_query_t *query = set->data[i];
+        sigar_ptql_query_t *member = &scan->members[i];
+        int has_ref = ptql_query_has_ref(query);
+
+        if ((scan->prefiltered[i] = ptql_query_is_prefiltered(query))) {
+            continue;
+        }
+
+        member->branches.number = member->branches.size =
+            query->branches.number;
+        member->branches.data =
+            malloc(sizeof(*member->branches.data) * query->branches.number);
+        if (!member->branches.data) {
+            return ENOMEM;
+        }
+        memcpy(member->branches.data, query->branches.data,
+               sizeof(*member->branches.data) * query->branches.number);
+
+        member->state_source = -1;
+        if (query->state_source >= 0) {
+            member->state_source =
+                ptql_scan_source_get(scan,
+                                     &query->sources[query->state_source]);
+        }
+        if (query->args) {
+            member->args = &scan->args;
+        }
+        member->history = query->history;
+
+        for (j=0; j<member->branches.number; j++) {
+            ptql_branch_t *branch = &member->branches.data[j];
+
+            if (branch->source >= 0) {
+                branch->source =
+                    ptql_scan_source_get(scan,
+                                         &query->sources[branch->source]);
+            }
+            /* $N refs read another branch's data, which a shared
+             * pred may have skipped fetching */
+            if (!has_ref) {
+                branch->pred = ptql_scan_pred_get(scan, branch);
+            }
+        }
+    }
+
+    for (j=0; j<scan->nsources; j++) {
+        scan->sources[j].data = malloc(scan->sources[j].data_size);
+        if (!scan->sources[j].data) {
+            return ENOMEM;
+        }
+    }
+
+    for (i=0; i<set->number; i++) {
+        sigar_ptql_query_t *member = &scan->members[i];
+
+        member->nsources = scan->nsources;
+        member->sources = scan->sources;
+        member->preds = scan->preds;
+
+        for (j=0; j<member->branches.number; j++) {
+            ptql_branch_t *branch = &member->branches.data[j];
+
+            if (branch->source >= 0) {
+                branch->data.ptr = scan->sources[branch->source].data;
+            }
+        }
+    }
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int) sigar_ptql_query_set_create(sigar_ptql_query_set_t **setp)
+{
+    sigar_ptql_query_set_t *set =
+        *setp = calloc(1, sizeof(*set));
+
+    if (!set) {
+        return ENOMEM;
+    }
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int) sigar_ptql_query_set_add(sigar_ptql_query_set_t *set,
+                                            sigar_ptql_query_t *query)
+{
+    if (set->number >= set->size) {
+        unsigned long size = set->size ? set->size * 2 : 16;
+        sigar_ptql_query_t **data =
+            realloc(set->data, sizeof(*set->data) * size);
+
+        if (!data) {
+            return ENOMEM;
+        }
+        set->data = data;
+        set->size = size;
+    }
+
+    set->data[set->number++] = query;
+
+    if (set->scan) {
+        /* rebuilt with the new member on the next find */
+        ptql_scan_free(set->scan);
+        set->scan = NULL;
+    }
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int) sigar_ptql_query_set_destroy(sigar_ptql_query_set_t *set)
+{
+    if (set->scan) {
+        ptql_scan_free(set->scan);
+    }
+    free(set->data);
+    free(set);
+    return SIGAR_OK;
+}
+
+/* matched[] has one row of set->number flags per pid */
+static int ptql_scan_match(sigar_t *sigar, ptql_scan_t *scan,
+                           sigar_pid_t pid, char *matched)
+{
+    unsigned long gen = ++scan->gen;
+    int i;
+
+    for (i=0; i<scan->number; i++) {
+        int query_status;
+
+        if (scan->prefiltered[i]) {
+            continue;
+        }
+
+        query_status =
+            ptql_query_match_gen(sigar, &scan->members[i], pid, gen);
+
+        if (query_status == SIGAR_ENOTIMPL) {
+            return query_status;
+        }
+        matched[i] = (query_status == SIGAR_OK);
+    }
+
+    return SIGAR_OK;
+}
+
+/* history branches of a parallel scan are matched after it, see below */
+static void ptql_scan_history_defer(ptql_scan_t *scan, int defer)
+{
+    int i;
+
+    for (i=0; i<scan->number; i++) {
+        scan->members[i].defer_history = defer && scan->members[i].history;
+    }
+}
+
+static int ptql_scan_history_match(sigar_t *sigar, ptql_scan_t *scan,
+                                   sigar_proc_list_t *pids, char *matched)
+{
+    unsigned long i, n = scan->number;
+    int j;
+
+    for (i=0; i<pids->number; i++) {
+        unsigned long gen = 0;
+
+        for (j=0; j<scan->number; j++) {
+            int query_status;
+
+            if (!scan->members[j].history || !matched[i * n + j]) {
+                continue;
+            }
+            if (!gen) {
+                gen = ++scan->gen;
+            }
+
+            query_status =
+                ptql_query_match_gen(sigar, &scan->members[j],
+                                     pids->data[i], gen);
+            if (query_status == SIGAR_ENOTIMPL) {
+                return query_status;
+            }
+            matched[i * n + j] = (query_status == SIGAR_OK);
+        }
+    }
+
+    return SIGAR_OK;
+}
+
+typedef struct {
+    sigar_ptql_query_set_t *set;
+    ptql_scan_t **scans; /* one per worker, built on first use */
+    sigar_proc_list_t *pids;
+    char *matched;
+} ptql_set_walk_t;
+
+static int ptql_set_walk(sigar_t *sigar, void *data, int worker,
+                         unsigned long start, unsigned long end)
+{
+    ptql_set_walk_t *walk = data;
+    unsigned long i, n = walk->set->number;
+    int status;
+
+    if (!walk->scans[worker]) {
+        if ((status = ptql_scan_build(walk->set, &walk->scans[worker]))) {
+            return status;
+        }
+        ptql_scan_history_defer(walk->scans[worker], 1);
+    }
+
+    for (i=start; i<end; i++) {
+        status = ptql_scan_match(sigar, walk->scans[worker],
+                                 walk->pids->data[i],
+                                 walk->matched + i * n);
+        if (status != SIGAR_OK) {
+            return status;
+        }
+    }
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int) sigar_ptql_query_set_find(sigar_t *sigar,
+                                             sigar_ptql_query_set_t *set,
+                                             sigar_proc_list_t *proclists)
+{
+    sigar_proc_list_t *pids;
+    ptql_set_walk_t walk;
+    unsigned long i, j, n = set->number;
+    int status = SIGAR_OK;
+
+    if (!set->scan) {
+        if ((status = ptql_scan_build(set, &set->scan)) != SIGAR_OK) {
+            if (set->scan) {
+                ptql_scan_free(set->scan);
+                set->scan = NULL;
+            }
+            return status;
+        }
+    }
+
+    /* Pid.* queries skip the scan; done first as they can
+     * reuse sigar->pids */
+    for (i=0; i<n; i++) {
+        if (set->scan->prefiltered[i]) {
+            status = sigar_ptql_query_find(sigar, set->data[i], &proclists[i]);
+        }
+        else {
+            sigar_proc_list_create(&proclists[i]);
+        }
+        if (status != SIGAR_OK) {
+            break;
+        }
+    }
+
+    if (status == SIGAR_OK) {
+        status = sigar_proc_list_get(sigar, NULL);
+    }
+    if (status != SIGAR_OK) {
+        for (j=0; j<i; j++) {
+            sigar_proc_list_destroy(sigar, &proclists[j]);
+        }
+        return status;
+    }
+
+    pids = sigar->pids;
+    walk.set = set;
+    walk.pids = pids;
+    walk.matched = calloc(pids->number * n + 1, 1);
+    walk.scans = NULL;
+    if (!walk.matched) {
+        status = ENOMEM;
+    }
+    else if (SIGAR_PARALLEL_SCAN(sigar, pids->number)) {
+        walk.scans =
+            calloc(sigar->proc_scan_threads, sizeof(*walk.scans));
+        if (!walk.scans) {
+            status = ENOMEM;
+        }
+        else {
+            walk.scans[0] = set->scan; /* the caller's */
+            ptql_scan_history_defer(set->scan, 1);
+            status = sigar_parallel_walk(sigar, pids->number,
+                                         ptql_set_walk, &walk);
+            ptql_scan_history_defer(set->scan, 0);
+            if (status == SIGAR_OK) {
+                status = ptql_scan_history_match(sigar, set->scan,
+                                                 pids, walk.matched);
+            }
+            for (i=1; i<sigar->proc_scan_threads; i++) {
+                if (walk.scans[i]) {
+                    ptql_scan_free(walk.scans[i]);
+                }
+            }
+            free(walk.scans);
+        }
+    }
+    else {
+        for (i=0; i<pids->number; i++) {
+            status = ptql_scan_match(sigar, set->scan, pids->data[i],
+                                     walk.matched + i * n);
+            if (status != SIGAR_OK) {
+                break;
+            }
+        }
+    }
+
+    if (status == SIGAR_OK) {
+        /* in pid list order, same as sigar_ptql_query_find */
+        for (i=0; i<pids->number; i++) {
+            for (j=0; j<n; j++) {
+                if (walk.matched[i * n + j]) {
+                    sigar_proc_list_t *proclist = &proclists[j];
+
+                    SIGAR_PROC_LIST_GROW(proclist);
+                    proclist->data[proclist->number++] = pids->data[i];
+                }
+            }
+        }
+    }
+    else {
+        for (j=0; j<n; j++) {
+            sigar_proc_list_destroy(sigar, &proclists[j]);
+        }
+    }
+
+    free(walk.matched);
+
+    return status;
 }
@@ -0,0 +1,1138 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * wire layout, integers in the fixed parts are little endian:
+ *
+ *   message   "SGRQ" or "SGRS", request id, body length, body
+ *   request   item count, then per item its type, num and arg
+ *   response  item count, then per item its type, status and, when
+ *             the status is SIGAR_OK, the value
+ *
+ * counts, types, num and every integer field of a value are varints,
+ * doubles their 8 bits little endian, strings their length and
+ * bytes.  a list is its length then its entries, pids the zigzag
+ * varint of the delta from the one before, a snapshot the length of
+ * its frame then the frame as sigar_snapshot_encode writes it.
+ */
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifndef WIN32
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <unistd.h>
+#endif
+
+#include "sigar.h"
+#include "sigar_ptql.h"
+#include "sigar_remote.h"
+#include "sigar_private.h"
+#include "sigar_util.h"
+
+#define REMOTE_REQUEST  0x51524753 /* "SGRQ" */
+#define REMOTE_RESPONSE 0x53524753 /* "SGRS" */
+
+#define REMOTE_HEADER_LEN 12
+#define REMOTE_BODY_MAX   (64 * 1024 * 1024)
+#define REMOTE_READ_LEN   (64 * 1024)
+
+#define SIGAR_REMOTE_REQUEST_MAX 16
+
+enum {
+    FIELD_UINT,
+    FIELD_DOUBLE
+};
+
+typedef struct {
+    size_t offset;
+    int kind;
+} remote_field_t;
+
+#define FIELD(type, field, kind) \
+    { offsetof(type, field), kind }
+
+#define NFIELDS(fields) (sizeof(fields) / sizeof(*(fields)))
+
+#define CPU_FIELD(field) FIELD(sigar_cpu_t, field, FIELD_UINT)
+
+static const remote_field_t cpu_fields[] = {
+    CPU_FIELD(user),
+    CPU_FIELD(sys),
+    CPU_FIELD(nice),
+    CPU_FIELD(idle),
+    CPU_FIELD(wait),
+    CPU_FIELD(irq),
+    CPU_FIELD(soft_irq),
+    CPU_FIELD(stolen),
+    CPU_FIELD(total)
+};
+
+#define MEM_FIELD(field, kind) FIELD(sigar_mem_t, field, kind)
+
+static const remote_field_t mem_fields[] = {
+    MEM_FIELD(ram, FIELD_UINT),
+    MEM_FIELD(total, FIELD_UINT),
+    MEM_FIELD(used, FIELD_UINT),
+    MEM_FIELD(free, FIELD_UINT),
+    MEM_FIELD(actual_used, FIELD_UINT),
+    MEM_FIELD(actual_free, FIELD_UINT),
+    MEM_FIELD(used_percent, FIELD_DOUBLE),
+    MEM_FIELD(free_percent, FIELD_DOUBLE)
+};
+
+#define SWAP_FIELD(field) FIELD(sigar_swap_t, field, FIELD_UINT)
+
+static const remote_field_t swap_fields[] = {
+    SWAP_FIELD(total),
+    SWAP_FIELD(used),
+    SWAP_FIELD(free),
+    SWAP_FIELD(page_in),
+    SWAP_FIELD(page_out)
+};
+
+static const remote_field_t loadavg_fields[] = {
+    FIELD(sigar_loadavg_t, loadavg[0], FIELD_DOUBLE),
+    FIELD(sigar_loadavg_t, loadavg[1], FIELD_DOUBLE),
+    FIELD(sigar_loadavg_t, loadavg[2], FIELD_DOUBLE)
+};
+
+static const remote_field_t uptime_fields[] = {
+    FIELD(sigar_uptime_t, uptime, FIELD_DOUBLE)
+};
+
+#define IFSTAT_FIELD(field) \
+    FIELD(sigar_net_interface_stat_t, field, FIELD_UINT)
+
+static const remote_field_t ifstat_fields[] = {
+    IFSTAT_FIELD(rx_packets),
+    IFSTAT_FIELD(rx_bytes),
+    IFSTAT_FIELD(rx_errors),
+    IFSTAT_FIELD(rx_dropped),
+    IFSTAT_FIELD(rx_overruns),
+    IFSTAT_FIELD(rx_frame),
+    IFSTAT_FIELD(tx_packets),
+    IFSTAT_FIELD(tx_bytes),
+    IFSTAT_FIELD(tx_errors),
+    IFSTAT_FIELD(tx_dropped),
+    IFSTAT_FIELD(tx_overruns),
+    IFSTAT_FIELD(tx_collisions),
+    IFSTAT_FIELD(tx_carrier),
+    IFSTAT_FIELD(speed)
+};
+
+#define FSUSAGE_FIELD(field, kind) \
+    FIELD(sigar_file_system_usage_t, field, kind)
+
+static const remote_field_t fsusage_fields[] = {
+    FSUSAGE_FIELD(disk.reads, FIELD_UINT),
+    FSUSAGE_FIELD(disk.writes, FIELD_UINT),
+    FSUSAGE_FIELD(disk.write_bytes, FIELD_UINT),
+    FSUSAGE_FIELD(disk.read_bytes, FIELD_UINT),
+    FSUSAGE_FIELD(disk.rtime, FIELD_UINT),
+    FSUSAGE_FIELD(disk.wtime, FIELD_UINT),
+    FSUSAGE_FIELD(disk.qtime, FIELD_UINT),
+    FSUSAGE_FIELD(disk.time, FIELD_UINT),
+    FSUSAGE_FIELD(disk.snaptime, FIELD_UINT),
+    FSUSAGE_FIELD(disk.service_time, FIELD_DOUBLE),
+    FSUSAGE_FIELD(disk.queue, FIELD_DOUBLE),
+    FSUSAGE_FIELD(use_percent, FIELD_DOUBLE),
+    FSUSAGE_FIELD(total, FIELD_UINT),
+    FSUSAGE_FIELD(free, FIELD_UINT),
+    FSUSAGE_FIELD(used, FIELD_UINT),
+    FSUSAGE_FIELD(avail, FIELD_UINT),
+    FSUSAGE_FIELD(files, FIELD_UINT),
+    FSUSAGE_FIELD(free_files, FIELD_UINT)
+};
+
+/* the fields of a type whose value is a single struct */
+static const remote_field_t *remote_fields(int type, size_t *number)
+{
+    switch (type) {
+      case SIGAR_REMOTE_CPU:
+        *number = NFIELDS(cpu_fields);
+        return cpu_fields;
+      case SIGAR_REMOTE_MEM:
+        *number = NFIELDS(mem_fields);
+        return mem_fields;
+      case SIGAR_REMOTE_SWAP:
+        *number = NFIELDS(swap_fields);
+        return swap_fields;
+      case SIGAR_REMOTE_LOADAVG:
+        *number = NFIELDS(loadavg_fields);
+        return loadavg_fields;
+      case SIGAR_REMOTE_UPTIME:
+        *number = NFIELDS(uptime_fields);
+        return uptime_fields;
+      case SIGAR_REMOTE_NETIF_STAT:
+        *number = NFIELDS(ifstat_fields);
+        return ifstat_fields;
+      case SIGAR_REMOTE_FS_USAGE:
+        *number = NFIELDS(fsusage_fields);
+        return fsusage_fields;
+      default:
+        *number = 0;
+        return NULL;
+    }
+}
+
+typedef struct {
+    unsigned char *data;
+    size_t len;
+    size_t size;
+    int status;
+} remote_buf_t;
+
+typedef struct {
+    const unsigned char *ptr;
+    const unsigned char *end;
+    int status;
+} remote_cursor_t;
+
+struct sigar_remote_t {
+    int fd;
+    sigar_uint32_t id;
+    remote_buf_t out;
+    remote_buf_t in;
+};
+
+static void buf_reserve(remote_buf_t *buf, size_t len)
+{
+    unsigned char *data;
+    size_t size;
+
+    if ((buf->status != SIGAR_OK) || (buf->len + len <= buf->size)) {
+        return;
+    }
+
+    size = buf->size ? buf->size : 4096;
+    while (size < buf->len + len) {
+        size *= 2;
+    }
+
+    if (!(data = realloc(buf->data, size))) {
+        buf->status = ENOMEM;
+        return;
+    }
+
+    buf->data = data;
+    buf->size = size;
+}
+
+static void buf_put(remote_buf_t *buf, const void *ptr, size_t len)
+{
+    buf_reserve(buf, len);
+    if (buf->status == SIGAR_OK) {
+        memcpy(buf->data + buf->len, ptr, len);
+        buf->len += len;
+    }
+}
+
+static void buf_varint(remote_buf_t *buf, sigar_uint64_t val)
+{
+    unsigned char bytes[10];
+    size_t len = 0;
+
+    while (val >= 0x80) {
+        bytes[len++] = (unsigned char)(val | 0x80);
+        val >>= 7;
+    }
+    bytes[len++] = (unsigned char)val;
+
+    buf_put(buf, bytes, len);
+}
+
+static void le_set(unsigned char *ptr, sigar_uint64_t val, int len)
+{
+    int i;
+
+    for (i=0; i<len; i++) {
+        ptr[i] = (unsigned char)(val >> (i * 8));
+    }
+}
+
+static sigar_uint64_t le_get(const unsigned char *ptr, int len)
+{
+    sigar_uint64_t val = 0;
+    int i;
+
+    for (i=len-1; i>=0; i--) {
+        val = (val << 8) | ptr[i];
+    }
+
+    return val;
+}
+
+static void buf_le(remote_buf_t *buf, sigar_uint64_t val, int len)
+{
+    unsigned char bytes[8];
+
+    le_set(bytes, val, len);
+    buf_put(buf, bytes, len);
+}
+
+static void buf_free(remote_buf_t *buf)
+{
+    if (buf->data) {
+        free(buf->data);
+    }
+    memset(buf, 0, sizeof(*buf));
+}
+
+static sigar_uint64_t cursor_varint(remote_cursor_t *cursor)
+{
+    sigar_uint64_t val = 0;
+    int shift = 0;
+
+    while (cursor->ptr < cursor->end) {
+        unsigned char byte = *cursor->ptr++;
+
+        val |= (sigar_uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return val;
+        }
+        if ((shift += 7) > 63) {
+            break;
+        }
+    }
+
+    cursor->status = EINVAL;
+    return 0;
+}
+
+/* len bytes from the cursor, NULL past the end */
+static const unsigned char *cursor_bytes(remote_cursor_t *cursor,
+                                         sigar_uint64_t len)
+{
+    const unsigned char *ptr = cursor->ptr;
+
+    if ((cursor->status != SIGAR_OK) ||
+        (len > (sigar_uint64_t)(cursor->end - cursor->ptr)))
+    {
+        cursor->status = EINVAL;
+        return NULL;
+    }
+
+    cursor->ptr += len;
+    return ptr;
+}
+
+/* a count of entries each at least a byte long, checked against what is left */
+static unsigned long cursor_count(remote_cursor_t *cursor)
+{
+    sigar_uint64_t count = cursor_varint(cursor);
+
+    if (count > (sigar_uint64_t)(cursor->end - cursor->ptr)) {
+        cursor->status = EINVAL;
+        return 0;
+    }
+
+    return (unsigned long)count;
+}
+
+static sigar_uint64_t zigzag(sigar_uint64_t val)
+{
+    return (val << 1) ^ (sigar_uint64_t)((sigar_int64_t)val >> 63);
+}
+
+static sigar_uint64_t unzigzag(sigar_uint64_t val)
+{
+    return (val >> 1) ^ (sigar_uint64_t)-(sigar_int64_t)(val & 1);
+}
+
+static void fields_encode(remote_buf_t *buf,
+                          const remote_field_t *fields, size_t number,
+                          const void *value)
+{
+    size_t i;
+
+    for (i=0; i<number; i++) {
+        const char *field = (const char *)value + fields[i].offset;
+
+        if (fields[i].kind == FIELD_DOUBLE) {
+            sigar_uint64_t bits;
+            memcpy(&bits, field, sizeof(bits));
+            buf_le(buf, bits, 8);
+        }
+        else {
+            sigar_uint64_t val;
+            memcpy(&val, field, sizeof(val));
+            buf_varint(buf, val);
+        }
+    }
+}
+
+static void fields_decode(remote_cursor_t *cursor,
+                          const remote_field_t *fields, size_t number,
+                          void *value)
+{
+    size_t i;
+
+    for (i=0; (i<number) && (cursor->status == SIGAR_OK); i++) {
+        char *field = (char *)value + fields[i].offset;
+        sigar_uint64_t val;
+
+        if (fields[i].kind == FIELD_DOUBLE) {
+            const unsigned char *ptr = cursor_bytes(cursor, 8);
+            if (!ptr) {
+                return;
+            }
+            val = le_get(ptr, 8);
+        }
+        else {
+            val = cursor_varint(cursor);
+        }
+
+        memcpy(field, &val, sizeof(val));
+    }
+}
+
+static void message_begin(remote_buf_t *buf, sigar_uint32_t magic,
+                          sigar_uint32_t id, size_t *start)
+{
+    *start = buf->len;
+
+    /* the length is filled in by message_end, once the body is known */
+    buf_le(buf, magic, 4);
+    buf_le(buf, id, 4);
+    buf_le(buf, 0, 4);
+}
+
+static int message_end(remote_buf_t *buf, size_t start)
+{
+    size_t len;
+
+    if (buf->status != SIGAR_OK) {
+        return buf->status;
+    }
+
+    len = buf->len - start - REMOTE_HEADER_LEN;
+    if (len > REMOTE_BODY_MAX) {
+        buf->len = start;
+        return E2BIG;
+    }
+
+    le_set(buf->data + start + 8, len, 4);
+
+    return SIGAR_OK;
+}
+
+/*
+ * 1 with the body of the message at the front of buf, 0 when it has
+ * not all arrived yet, -1 for what is not a message of that magic.
+ */
+static int message_get(remote_buf_t *buf, sigar_uint32_t magic,
+                       sigar_uint32_t *id, remote_cursor_t *body)
+{
+    sigar_uint64_t len;
+
+    if (buf->len < REMOTE_HEADER_LEN) {
+        return 0;
+    }
+
+    len = le_get(buf->data + 8, 4);
+
+    if ((le_get(buf->data, 4) != magic) || (len > REMOTE_BODY_MAX)) {
+        return -1;
+    }
+    if (buf->len < REMOTE_HEADER_LEN + len) {
+        return 0;
+    }
+
+    *id = (sigar_uint32_t)le_get(buf->data + 4, 4);
+    body->ptr = buf->data + REMOTE_HEADER_LEN;
+    body->end = body->ptr + len;
+    body->status = SIGAR_OK;
+
+    return 1;
+}
+
+/* drops the message at the front of buf, body as from message_get */
+static void message_consume(remote_buf_t *buf, remote_cursor_t *body)
+{
+    size_t len = body->end - buf->data;
+
+    memmove(buf->data, buf->data + len, buf->len - len);
+    buf->len -= len;
+}
+
+SIGAR_DECLARE(int)
+sigar_remote_request_create(sigar_remote_request_t *request)
+{
+    request->number = 0;
+    request->size = SIGAR_REMOTE_REQUEST_MAX;
+    request->data = malloc(sizeof(*(request->data)) * request->size);
+
+    return request->data ? SIGAR_OK : ENOMEM;
+}
+
+SIGAR_DECLARE(int)
+sigar_remote_request_add(sigar_remote_request_t *request,
+                         int type, const char *arg, sigar_uint64_t num)
+{
+    sigar_remote_item_t *item;
+
+    if (request->number >= request->size) {
+        sigar_remote_item_t *data;
+        unsigned long size = request->size + SIGAR_REMOTE_REQUEST_MAX;
+
+        if (!(data = realloc(request->data, sizeof(*data) * size))) {
+            return ENOMEM;
+        }
+        request->data = data;
+        request->size = size;
+    }
+
+    item = &request->data[request->number];
+    item->type = type;
+    item->num = num;
+    item->arg = NULL;
+
+    if (arg && !(item->arg = sigar_strdup(arg))) {
+        return ENOMEM;
+    }
+
+    request->number++;
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int)
+sigar_remote_request_destroy(sigar_remote_request_t *request)
+{
+    unsigned long i;
+
+    for (i=0; i<request->number; i++) {
+        if (request->data[i].arg) {
+            free(request->data[i].arg);
+        }
+    }
+
+    if (request->size) {
+        free(request->data);
+        request->number = request->size = 0;
+    }
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int)
+sigar_remote_response_destroy(sigar_remote_response_t *response)
+{
+    unsigned long i;
+
+    for (i=0; i<response->number; i++) {
+        sigar_remote_result_t *result = &response->data[i];
+
+        if (result->status != SIGAR_OK) {
+            continue;
+        }
+
+        switch (result->type) {
+          case SIGAR_REMOTE_CPU_LIST:
+            if (result->value.cpulist.size) {
+                free(result->value.cpulist.data);
+            }
+            break;
+          case SIGAR_REMOTE_PTQL_FIND:
+            if (result->value.proclist.size) {
+                free(result->value.proclist.data);
+            }
+            break;
+          case SIGAR_REMOTE_SNAPSHOT:
+            sigar_snapshot_destroy(NULL, &result->value.snapshot);
+            break;
+        }
+    }
+
+    if (response->size) {
+        free(response->data);
+        response->number = response->size = 0;
+    }
+
+    return SIGAR_OK;
+}
+
+#ifndef WIN32
+
+/* runs the one getter of item, appending its type, status and value */
+static void remote_item_serve(sigar_t *sigar, remote_buf_t *buf,
+                              int type, const char *arg,
+                              sigar_uint64_t num)
+{
+    const remote_field_t *fields;
+    size_t nfields;
+    unsigned long i;
+    int status;
+    union {
+        sigar_cpu_t cpu;
+        sigar_cpu_list_t cpulist;
+        sigar_mem_t mem;
+        sigar_swap_t swap;
+        sigar_loadavg_t loadavg;
+        sigar_uptime_t uptime;
+        sigar_net_interface_stat_t ifstat;
+        sigar_file_system_usage_t fsusage;
+        sigar_proc_list_t proclist;
+        sigar_snapshot_t snapshot;
+    } value;
+
+    buf_varint(buf, type);
+
+    switch (type) {
+      case SIGAR_REMOTE_CPU:
+        status = sigar_cpu_get(sigar, &value.cpu);
+        break;
+      case SIGAR_REMOTE_MEM:
+        status = sigar_mem_get(sigar, &value.mem);
+        break;
+      case SIGAR_REMOTE_SWAP:
+        status = sigar_swap_get(sigar, &value.swap);
+        break;
+      case SIGAR_REMOTE_LOADAVG:
+        status = sigar_loadavg_get(sigar, &value.loadavg);
+        break;
+      case SIGAR_REMOTE_UPTIME:
+        status = sigar_uptime_get(sigar, &value.uptime);
+        break;
+      case SIGAR_REMOTE_NETIF_STAT:
+        status = arg ?
+            sigar_net_interface_stat_get(sigar, arg, &value.ifstat) :
+            EINVAL;
+        break;
+      case SIGAR_REMOTE_FS_USAGE:
+        status = arg ?
+            sigar_file_system_usage_get(sigar, arg, &value.fsusage) :
+            EINVAL;
+        break;
+      case SIGAR_REMOTE_CPU_LIST:
+        if ((status = sigar_cpu_list_get(sigar, &value.cpulist)) !=
+            SIGAR_OK)
+        {
+            break;
+        }
+
+        buf_varint(buf, SIGAR_OK);
+        buf_varint(buf, value.cpulist.number);
+        for (i=0; i<value.cpulist.number; i++) {
+            fields_encode(buf, cpu_fields, NFIELDS(cpu_fields),
+                          &value.cpulist.data[i]);
+        }
+        sigar_cpu_list_destroy(sigar, &value.cpulist);
+        return;
+      case SIGAR_REMOTE_PTQL_FIND:
+        {
+            sigar_ptql_query_t *query;
+            sigar_ptql_error_t error;
+            sigar_pid_t pid = 0;
+
+            if (!arg) {
+                status = EINVAL;
+                break;
+            }
+            if ((status = sigar_ptql_query_create(&query, (char *)arg,
+                                                  &error)) != SIGAR_OK)
+            {
+                break;
+            }
+            status = sigar_ptql_query_find(sigar, query, &value.proclist);
+            sigar_ptql_query_destroy(query);
+            if (status != SIGAR_OK) {
+                break;
+            }
+
+            buf_varint(buf, SIGAR_OK);
+            buf_varint(buf, value.proclist.number);
+            for (i=0; i<value.proclist.number; i++) {
+                buf_varint(buf, zigzag((sigar_uint64_t)
+                                       (value.proclist.data[i] - pid)));
+                pid = value.proclist.data[i];
+            }
+            sigar_proc_list_destroy(sigar, &value.proclist);
+        }
+        return;
+      case SIGAR_REMOTE_SNAPSHOT:
+        {
+            unsigned char *frame;
+            size_t len;
+
+            if ((status = sigar_snapshot_get(sigar, (int)num,
+                                             &value.snapshot)) != SIGAR_OK)
+            {
+                break;
+            }
+            status = sigar_snapshot_encode(&value.snapshot, &frame, &len);
+            sigar_snapshot_destroy(sigar, &value.snapshot);
+            if (status != SIGAR_OK) {
+                break;
+            }
+
+            buf_varint(buf, SIGAR_OK);
+            buf_varint(buf, len);
+            buf_put(buf, frame, len);
+            free(frame);
+        }
+        return;
+      default:
+        status = SIGAR_ENOTIMPL;
+        break;
+    }
+
+    buf_varint(buf, status);
+
+    if ((status == SIGAR_OK) &&
+        (fields = remote_fields(type, &nfields)))
+    {
+        fields_encode(buf, fields, nfields, &value);
+    }
+}
+
+/* the response to the request in body, appended to out */
+static int remote_request_serve(sigar_t *sigar, remote_buf_t *out,
+                                sigar_uint32_t id, remote_cursor_t *body)
+{
+    unsigned long i, count = cursor_count(body);
+    size_t start;
+
+    message_begin(out, REMOTE_RESPONSE, id, &start);
+    buf_varint(out, count);
+
+    for (i=0; (i<count) && (body->status == SIGAR_OK); i++) {
+        int type = (int)cursor_varint(body);
+        sigar_uint64_t num = cursor_varint(body);
+        sigar_uint64_t len = cursor_varint(body);
+        const unsigned char *ptr = cursor_bytes(body, len);
+        char *arg = NULL;
+
+        if (!ptr) {
+            break;
+        }
+        if (len) {
+            if (!(arg = malloc(len + 1))) {
+                out->status = ENOMEM;
+                break;
+            }
+            memcpy(arg, ptr, len);
+            arg[len] = '\0';
+        }
+
+        remote_item_serve(sigar, out, type, arg, num);
+
+        if (arg) {
+            free(arg);
+        }
+    }
+
+    if (body->status != SIGAR_OK) {
+        out->len = start;
+        return body->status;
+    }
+
+    return message_end(out, start);
+}
+
+static int remote_write(int fd, const unsigned char *data, size_t len)
+{
+    while (len) {
+        ssize_t n;
+#ifdef MSG_NOSIGNAL
+        n = send(fd, data, len, MSG_NOSIGNAL);
+        if ((n < 0) && (errno == ENOTSOCK)) {
+            n = write(fd, data, len);
+        }
+#else
+        n = write(fd, data, len);
+#endif
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno;
+        }
+        data += n;
+        len -= n;
+    }
+
+    return SIGAR_OK;
+}
+
+/* appends what one read gives, ECONNRESET for the other end closing */
+static int remote_fill(int fd, remote_buf_t *buf)
+{
+    ssize_t n;
+
+    buf_reserve(buf, REMOTE_READ_LEN);
+    if (buf->status != SIGAR_OK) {
+        return buf->status;
+    }
+
+    do {
+        n = read(fd, buf->data + buf->len, REMOTE_READ_LEN);
+    } while ((n < 0) && (errno == EINTR));
+
+    if (n < 0) {
+        return errno;
+    }
+    if (n == 0) {
+        return ECONNRESET;
+    }
+
+    buf->len += n;
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int) sigar_remote_serve(sigar_t *sigar, int fd)
+{
+    remote_buf_t in, out;
+    int status;
+
+    memset(&in, 0, sizeof(in));
+    memset(&out, 0, sizeof(out));
+
+    while (1) {
+        remote_cursor_t body;
+        sigar_uint32_t id;
+        int found;
+
+        /* answer everything already read before writing any of it */
+        while ((found = message_get(&in, REMOTE_REQUEST, &id, &body)) > 0) {
+            if ((status =
+                 remote_request_serve(sigar, &out, id, &body)) != SIGAR_OK)
+            {
+                goto done;
+            }
+            message_consume(&in, &body);
+        }
+        if (found < 0) {
+            status = EINVAL;
+            break;
+        }
+
+        if (out.len) {
+            if ((status = remote_write(fd, out.data, out.len)) != SIGAR_OK) {
+                break;
+            }
+            out.len = 0;
+        }
+
+        if ((status = remote_fill(fd, &in)) != SIGAR_OK) {
+            /* closed between requests is how a client says goodbye */
+            if ((status == ECONNRESET) && (in.len == 0)) {
+                status = SIGAR_OK;
+            }
+            break;
+        }
+    }
+
+ done:
+    buf_free(&in);
+    buf_free(&out);
+
+    return status;
+}
+
+SIGAR_DECLARE(int) sigar_remote_fdopen(sigar_remote_t **remote, int fd)
+{
+    if (!(*remote = calloc(1, sizeof(**remote)))) {
+        return ENOMEM;
+    }
+
+    (*remote)->fd = fd;
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int) sigar_remote_open(sigar_remote_t **remote,
+                                     const char *host, int port)
+{
+    struct addrinfo hints, *list, *ai;
+    char service[16];
+    int fd = -1, status;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    snprintf(service, sizeof(service), "%d", port ? port : SIGAR_REMOTE_PORT);
+
+    if ((status = getaddrinfo(host, service, &hints, &list)) != 0) {
+#ifdef EAI_SYSTEM
+        if (status == EAI_SYSTEM) {
+            return errno;
+        }
+#endif
+        return ENOENT;
+    }
+
+    status = ECONNREFUSED;
+    for (ai = list; ai; ai = ai->ai_next) {
+        if ((fd = socket(ai->ai_family, ai->ai_socktype,
+                         ai->ai_protocol)) < 0)
+        {
+            status = errno;
+            continue;
+        }
+        if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+            break;
+        }
+        status = errno;
+        close(fd);
+        fd = -1;
+    }
+
+    freeaddrinfo(list);
+
+    if (fd < 0) {
+        return status;
+    }
+
+    /* pipelined requests are small, do not hold them back */
+    status = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &status, sizeof(status));
+
+    if ((status = sigar_remote_fdopen(remote, fd)) != SIGAR_OK) {
+        close(fd);
+    }
+
+    return status;
+}
+
+SIGAR_DECLARE(int) sigar_remote_close(sigar_remote_t *remote)
+{
+    close(remote->fd);
+    buf_free(&remote->out);
+    buf_free(&remote->in);
+    free(remote);
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int) sigar_remote_send(sigar_remote_t *remote,
+                                     sigar_remote_request_t *request,
+                                     sigar_uint32_t *id)
+{
+    remote_buf_t *buf = &remote->out;
+    unsigned long i;
+    size_t start;
+    int status;
+
+    buf->len = 0;
+    buf->status = SIGAR_OK;
+
+    message_begin(buf, REMOTE_REQUEST, remote->id, &start);
+    buf_varint(buf, request->number);
+
+    for (i=0; i<request->number; i++) {
+        sigar_remote_item_t *item = &request->data[i];
+        size_t len = item->arg ? strlen(item->arg) : 0;
+
+        buf_varint(buf, item->type);
+        buf_varint(buf, item->num);
+        buf_varint(buf, len);
+        if (len) {
+            buf_put(buf, item->arg, len);
+        }
+    }
+
+    if ((status = message_end(buf, start)) != SIGAR_OK) {
+        return status;
+    }
+    if ((status = remote_write(remote->fd, buf->data, buf->len)) != SIGAR_OK) {
+        return status;
+    }
+
+    if (id) {
+        *id = remote->id;
+    }
+    remote->id++;
+
+    return SIGAR_OK;
+}
+
+static void remote_result_decode(remote_cursor_t *cursor,
+                                 sigar_remote_result_t *result)
+{
+    const remote_field_t *fields;
+    size_t nfields;
+    unsigned long i, number;
+
+    result->type = (int)cursor_varint(cursor);
+    result->status = (int)cursor_varint(cursor);
+
+    if ((cursor->status != SIGAR_OK) || (result->status != SIGAR_OK)) {
+        return;
+    }
+
+    switch (result->type) {
+      case SIGAR_REMOTE_CPU_LIST:
+        {
+            sigar_cpu_list_t *cpulist = &result->value.cpulist;
+
+            number = cursor_count(cursor);
+            cpulist->size = number ? number : 1;
+            if (!(cpulist->data =
+                  calloc(cpulist->size, sizeof(*cpulist->data))))
+            {
+                cpulist->size = 0;
+                cursor->status = ENOMEM;
+                return;
+            }
+            for (i=0; i<number; i++) {
+                fields_decode(cursor, cpu_fields, NFIELDS(cpu_fields),
+                              &cpulist->data[i]);
+            }
+            cpulist->number = number;
+        }
+        break;
+      case SIGAR_REMOTE_PTQL_FIND:
+        {
+            sigar_proc_list_t *proclist = &result->value.proclist;
+            sigar_pid_t pid = 0;
+
+            number = cursor_count(cursor);
+            proclist->size = number ? number : 1;
+            if (!(proclist->data =
+                  malloc(proclist->size * sizeof(*proclist->data))))
+            {
+                proclist->size = 0;
+                cursor->status = ENOMEM;
+                return;
+            }
+            for (i=0; i<number; i++) {
+                pid += (sigar_pid_t)unzigzag(cursor_varint(cursor));
+                proclist->data[i] = pid;
+            }
+            proclist->number = number;
+        }
+        break;
+      case SIGAR_REMOTE_SNAPSHOT:
+        {
+            sigar_uint64_t len = cursor_varint(cursor);
+            const unsigned char *frame = cursor_bytes(cursor, len);
+            int status;
+
+            if (!frame) {
+                return;
+            }
+            if ((status = sigar_snapshot_decode(frame, len,
+                                                &result->value.snapshot)) !=
+                SIGAR_OK)
+            {
+                cursor->status = status;
+            }
+        }
+        break;
+      default:
+        if ((fields = remote_fields(result->type, &nfields))) {
+            fields_decode(cursor, fields, nfields, &result->value);
+        }
+        else {
+            /* a type this client does not know, its value cannot be skipped */
+            cursor->status = SIGAR_ENOTIMPL;
+        }
+        break;
+    }
+}
+
+SIGAR_DECLARE(int) sigar_remote_recv(sigar_remote_t *remote,
+                                     sigar_remote_response_t *response)
+{
+    remote_cursor_t body;
+    sigar_uint32_t id;
+    unsigned long i, number;
+    int found, status;
+
+    SIGAR_ZERO(response);
+
+    while ((found = message_get(&remote->in, REMOTE_RESPONSE,
+                                &id, &body)) == 0)
+    {
+        if ((status = remote_fill(remote->fd, &remote->in)) != SIGAR_OK) {
+            return status;
+        }
+    }
+    if (found < 0) {
+        return EINVAL;
+    }
+
+    number = cursor_count(&body);
+    response->id = id;
+    response->size = number ? number : 1;
+    if (!(response->data = calloc(response->size, sizeof(*response->data)))) {
+        response->size = 0;
+        return ENOMEM;
+    }
+
+    for (i=0; (i<number) && (body.status == SIGAR_OK); i++) {
+        remote_result_decode(&body, &response->data[i]);
+        /* a result is only destroyed once it is counted */
+        response->number++;
+    }
+
+    message_consume(&remote->in, &body);
+
+    if (body.status != SIGAR_OK) {
+        status = body.status;
+        sigar_remote_response_destroy(response);
+        return status;
+    }
+
+    return SIGAR_OK;
+}
+
+#else
+
+SIGAR_DECLARE(int) sigar_remote_serve(sigar_t *sigar, int fd)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+SIGAR_DECLARE(int) sigar_remote_fdopen(sigar_remote_t **remote, int fd)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+SIGAR_DECLARE(int) sigar_remote_open(sigar_remote_t **remote,
+                                     const char *host, int port)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+SIGAR_DECLARE(int) sigar_remote_close(sigar_remote_t *remote)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+SIGAR_DECLARE(int) sigar_remote_send(sigar_remote_t *remote,
+                                     sigar_remote_request_t *request,
+                                     sigar_uint32_t *id)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+SIGAR_DECLARE(int) sigar_remote_recv(sigar_remote_t *remote,
+                                     sigar_remote_response_t *response)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+#endif
@@ -0,0 +1,301 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * sigar_fqdn_get and sigar_net_info_get answers, reused for
+ * sigar->net_info_expire.  an async refresh runs the whole fqdn
+ * search, reverse lookups included, on a detached thread with a
+ * handle of its own; the state it reports back to is refcounted so
+ * that sigar_close never has to wait on a hung name server.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef WIN32
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#include "sigar.h"
+#include "sigar_private.h"
+#include "sigar_util.h"
+#include "sigar_os.h"
+
+#ifdef WIN32
+typedef CRITICAL_SECTION resolver_lock_t;
+#  define RESOLVER_LOCK_INIT(lock)    InitializeCriticalSection(lock)
+#  define RESOLVER_LOCK(lock)         EnterCriticalSection(lock)
+#  define RESOLVER_UNLOCK(lock)       LeaveCriticalSection(lock)
+#  define RESOLVER_LOCK_DESTROY(lock) DeleteCriticalSection(lock)
+#else
+typedef pthread_mutex_t resolver_lock_t;
+#  define RESOLVER_LOCK_INIT(lock)    pthread_mutex_init(lock, NULL)
+#  define RESOLVER_LOCK(lock)         pthread_mutex_lock(lock)
+#  define RESOLVER_UNLOCK(lock)       pthread_mutex_unlock(lock)
+#  define RESOLVER_LOCK_DESTROY(lock) pthread_mutex_destroy(lock)
+#endif
+
+/* shared by the handle and a running lookup, under lock */
+typedef struct {
+    resolver_lock_t lock;
+    int refs;
+    int running;
+    char fqdn[SIGAR_FQDN_LEN];
+    sigar_uint64_t fqdn_time; /* 0 until a lookup succeeded */
+} fqdn_state_t;
+
+struct sigar_resolver_t {
+    int async;
+    fqdn_state_t *state;
+    sigar_net_info_t net_info;
+    sigar_uint64_t net_info_time;
+};
+
+static int resolver_get(sigar_t *sigar, sigar_resolver_t **resolverp)
+{
+    sigar_resolver_t *resolver = sigar->resolver;
+
+    if (!resolver) {
+        resolver = calloc(1, sizeof(*resolver));
+        if (!resolver) {
+            return ENOMEM;
+        }
+
+        resolver->state = calloc(1, sizeof(*resolver->state));
+        if (!resolver->state) {
+            free(resolver);
+            return ENOMEM;
+        }
+        RESOLVER_LOCK_INIT(&resolver->state->lock);
+        resolver->state->refs = 1;
+
+        sigar->resolver = resolver;
+    }
+
+    *resolverp = resolver;
+
+    return SIGAR_OK;
+}
+
+static void fqdn_state_release(fqdn_state_t *state)
+{
+    int refs;
+
+    RESOLVER_LOCK(&state->lock);
+    refs = --state->refs;
+    RESOLVER_UNLOCK(&state->lock);
+
+    if (refs == 0) {
+        RESOLVER_LOCK_DESTROY(&state->lock);
+        free(state);
+    }
+}
+
+#ifdef WIN32
+static DWORD WINAPI fqdn_refresh_main(LPVOID data)
+#else
+static void *fqdn_refresh_main(void *data)
+#endif
+{
+    fqdn_state_t *state = data;
+    char fqdn[SIGAR_FQDN_LEN];
+    sigar_t *sigar;
+    int status;
+
+    if ((status = sigar_open(&sigar)) == SIGAR_OK) {
+        status = sigar_fqdn_resolve(sigar, fqdn, sizeof(fqdn));
+        sigar_close(sigar);
+    }
+
+    RESOLVER_LOCK(&state->lock);
+    if (status == SIGAR_OK) {
+        SIGAR_SSTRCPY(state->fqdn, fqdn);
+        state->fqdn_time = sigar_time_now_millis();
+    }
+    state->running = 0;
+    RESOLVER_UNLOCK(&state->lock);
+
+    fqdn_state_release(state);
+
+    return 0;
+}
+
+/* with state->lock held */
+static int fqdn_refresh_start(fqdn_state_t *state)
+{
+#ifdef WIN32
+    HANDLE thread;
+#else
+    pthread_attr_t attr;
+    pthread_t thread;
+    int status;
+#endif
+
+    if (state->running) {
+        return SIGAR_OK;
+    }
+
+    state->refs++;
+    state->running = 1;
+
+#ifdef WIN32
+    thread = CreateThread(NULL, 0, fqdn_refresh_main, state, 0, NULL);
+    if (thread) {
+        CloseHandle(thread);
+        return SIGAR_OK;
+    }
+    state->refs--;
+    state->running = 0;
+    return GetLastError();
+#else
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    status = pthread_create(&thread, &attr, fqdn_refresh_main, state);
+    pthread_attr_destroy(&attr);
+
+    if (status != 0) {
+        state->refs--;
+        state->running = 0;
+    }
+    return status;
+#endif
+}
+
+SIGAR_DECLARE(int) sigar_fqdn_get(sigar_t *sigar, char *name, int namelen)
+{
+    sigar_resolver_t *resolver;
+    fqdn_state_t *state;
+    char fqdn[SIGAR_FQDN_LEN];
+    sigar_uint64_t timenow = sigar_time_now_millis();
+    int status;
+
+    if ((status = resolver_get(sigar, &resolver)) != SIGAR_OK) {
+        return status;
+    }
+    state = resolver->state;
+
+    RESOLVER_LOCK(&state->lock);
+
+    if (state->fqdn_time &&
+        (timenow < state->fqdn_time + sigar->net_info_expire))
+    {
+        SIGAR_STRNCPY(name, state->fqdn, namelen);
+        RESOLVER_UNLOCK(&state->lock);
+        return SIGAR_OK;
+    }
+
+    if (resolver->async) {
+        status = fqdn_refresh_start(state);
+
+        if (state->fqdn_time) {
+            SIGAR_STRNCPY(name, state->fqdn, namelen);
+            RESOLVER_UNLOCK(&state->lock);
+            return SIGAR_OK;
+        }
+        RESOLVER_UNLOCK(&state->lock);
+
+        if (status == SIGAR_OK) {
+            /* nothing found yet, only what needs no lookup */
+            if (gethostname(name, namelen - 1) != 0) {
+                return errno;
+            }
+            name[namelen - 1] = '\0';
+            return SIGAR_OK;
+        }
+        /* no thread, this one will have to wait */
+    }
+    else {
+        RESOLVER_UNLOCK(&state->lock);
+    }
+
+    if ((status = sigar_fqdn_resolve(sigar, fqdn, sizeof(fqdn))) !=
+        SIGAR_OK)
+    {
+        return status;
+    }
+
+    RESOLVER_LOCK(&state->lock);
+    SIGAR_SSTRCPY(state->fqdn, fqdn);
+    state->fqdn_time = sigar_time_now_millis();
+    RESOLVER_UNLOCK(&state->lock);
+
+    SIGAR_STRNCPY(name, fqdn, namelen);
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int) sigar_net_info_get(sigar_t *sigar,
+                                      sigar_net_info_t *netinfo)
+{
+    sigar_resolver_t *resolver;
+    sigar_uint64_t timenow = sigar_time_now_millis();
+    int status;
+
+    if ((status = resolver_get(sigar, &resolver)) != SIGAR_OK) {
+        return status;
+    }
+
+    if (!resolver->net_info_time ||
+        (timenow >= resolver->net_info_time + sigar->net_info_expire))
+    {
+        if ((status = sigar_os_net_info_get(sigar, &resolver->net_info)) !=
+            SIGAR_OK)
+        {
+            resolver->net_info_time = 0;
+            return status;
+        }
+        resolver->net_info_time = timenow;
+    }
+
+    memcpy(netinfo, &resolver->net_info, sizeof(*netinfo));
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int) sigar_net_info_expire_set(sigar_t *sigar,
+                                             sigar_uint64_t millis)
+{
+    sigar->net_info_expire = millis;
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int) sigar_fqdn_async_set(sigar_t *sigar, int async)
+{
+    sigar_resolver_t *resolver;
+    int status;
+
+    if ((status = resolver_get(sigar, &resolver)) != SIGAR_OK) {
+        return status;
+    }
+
+    resolver->async = async;
+
+    return SIGAR_OK;
+}
+
+void sigar_resolver_free(sigar_t *sigar)
+{
+    sigar_resolver_t *resolver = sigar->resolver;
+
+    if (!resolver) {
+        return;
+    }
+
+    /* a lookup still running frees the state once it is done */
+    fqdn_state_release(resolver->state);
+    free(resolver);
+    sigar->resolver = NULL;
+}
@@ -0,0 +1,707 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef WIN32
+#include <pthread.h>
+#endif
+
+#include "sigar.h"
+#include "sigar_rules.h"
+#include "sigar_private.h"
+#include "sigar_util.h"
+#include "sigar_os.h"
+
+#ifdef WIN32
+#define snprintf _snprintf
+typedef CRITICAL_SECTION rules_lock_t;
+#  define RULES_LOCK_INIT(lock)    InitializeCriticalSection(lock)
+#  define RULES_LOCK(lock)         EnterCriticalSection(lock)
+#  define RULES_UNLOCK(lock)       LeaveCriticalSection(lock)
+#  define RULES_LOCK_DESTROY(lock) DeleteCriticalSection(lock)
+#else
+typedef pthread_mutex_t rules_lock_t;
+#  define RULES_LOCK_INIT(lock)    pthread_mutex_init(lock, NULL)
+#  define RULES_LOCK(lock)         pthread_mutex_lock(lock)
+#  define RULES_UNLOCK(lock)       pthread_mutex_unlock(lock)
+#  define RULES_LOCK_DESTROY(lock) pthread_mutex_destroy(lock)
+#endif
+
+typedef enum {
+    RULE_CPU,
+    RULE_MEM,
+    RULE_SWAP,
+    RULE_NETIF,
+    RULE_DISK,
+    RULE_FS,
+    RULE_TCP,
+    RULE_PROC
+} rule_class_t;
+
+typedef enum {
+    RULE_U64,  /* sigar_uint64_t at offset */
+    RULE_DBL,  /* double at offset */
+    RULE_RATE, /* per second change of the sigar_uint64_t at offset */
+    RULE_PCT,  /* cpu ticks at offset, percent of all ticks */
+    RULE_PCT1, /* 0..1 double at offset, as a percent */
+    RULE_KB,   /* sigar_uint64_t KB at offset, in bytes */
+    RULE_STATE /* tcp_states[offset] */
+} rule_kind_t;
+
+typedef struct {
+    const char *klass;
+    rule_class_t klass_id;
+    const char *attr;
+    rule_kind_t kind;
+    size_t offset;
+} rule_attr_t;
+
+#define RULE_NETIF_STAT(attr, field) \
+    { "NetIf", RULE_NETIF, attr, RULE_RATE, \
+      offsetof(sigar_net_interface_stat_entry_t, stat.field) }
+
+#define RULE_DISK_STAT(attr, kind, field) \
+    { "Disk", RULE_DISK, attr, kind, \
+      offsetof(sigar_disk_usage_entry_t, disk.field) }
+
+#define RULE_TCP_STATE(attr, state) \
+    { "Tcp", RULE_TCP, attr, RULE_STATE, state }
+
+/* Proc offsets are unused, the attr picks the aggregate field */
+static const rule_attr_t rule_attrs[] = {
+    { "Cpu", RULE_CPU, "User", RULE_PCT, offsetof(sigar_cpu_t, user) },
+    { "Cpu", RULE_CPU, "Sys", RULE_PCT, offsetof(sigar_cpu_t, sys) },
+    { "Cpu", RULE_CPU, "Nice", RULE_PCT, offsetof(sigar_cpu_t, nice) },
+    { "Cpu", RULE_CPU, "Idle", RULE_PCT, offsetof(sigar_cpu_t, idle) },
+    { "Cpu", RULE_CPU, "Wait", RULE_PCT, offsetof(sigar_cpu_t, wait) },
+    { "Cpu", RULE_CPU, "Irq", RULE_PCT, offsetof(sigar_cpu_t, irq) },
+    { "Cpu", RULE_CPU, "SoftIrq", RULE_PCT, offsetof(sigar_cpu_t, soft_irq) },
+    { "Cpu", RULE_CPU, "Stolen", RULE_PCT, offsetof(sigar_cpu_t, stolen) },
+    { "Mem", RULE_MEM, "Used", RULE_U64, offsetof(sigar_mem_t, used) },
+    { "Mem", RULE_MEM, "Free", RULE_U64, offsetof(sigar_mem_t, free) },
+    { "Mem", RULE_MEM, "ActualUsed", RULE_U64,
+      offsetof(sigar_mem_t, actual_used) },
+    { "Mem", RULE_MEM, "ActualFree", RULE_U64,
+      offsetof(sigar_mem_t, actual_free) },
+    { "Mem", RULE_MEM, "UsedPercent", RULE_DBL,
+      offsetof(sigar_mem_t, used_percent) },
+    { "Mem", RULE_MEM, "FreePercent", RULE_DBL,
+      offsetof(sigar_mem_t, free_percent) },
+    { "Swap", RULE_SWAP, "Used", RULE_U64, offsetof(sigar_swap_t, used) },
+    { "Swap", RULE_SWAP, "Free", RULE_U64, offsetof(sigar_swap_t, free) },
+    RULE_NETIF_STAT("RxBytes", rx_bytes),
+    RULE_NETIF_STAT("RxPackets", rx_packets),
+    RULE_NETIF_STAT("RxErrors", rx_errors),
+    RULE_NETIF_STAT("RxDropped", rx_dropped),
+    RULE_NETIF_STAT("TxBytes", tx_bytes),
+    RULE_NETIF_STAT("TxPackets", tx_packets),
+    RULE_NETIF_STAT("TxErrors", tx_errors),
+    RULE_NETIF_STAT("TxDropped", tx_dropped),
+    RULE_DISK_STAT("Reads", RULE_RATE, reads),
+    RULE_DISK_STAT("Writes", RULE_RATE, writes),
+    RULE_DISK_STAT("ReadBytes", RULE_RATE, read_bytes),
+    RULE_DISK_STAT("WriteBytes", RULE_RATE, write_bytes),
+    RULE_DISK_STAT("Queue", RULE_DBL, queue),
+    RULE_DISK_STAT("ServiceTime", RULE_DBL, service_time),
+    { "FileSystem", RULE_FS, "UsePercent", RULE_PCT1,
+      offsetof(sigar_file_system_usage_t, use_percent) },
+    { "FileSystem", RULE_FS, "Used", RULE_KB,
+      offsetof(sigar_file_system_usage_t, used) },
+    { "FileSystem", RULE_FS, "Free", RULE_KB,
+      offsetof(sigar_file_system_usage_t, free) },
+    { "FileSystem", RULE_FS, "Avail", RULE_KB,
+      offsetof(sigar_file_system_usage_t, avail) },
+    { "FileSystem", RULE_FS, "FreeFiles", RULE_U64,
+      offsetof(sigar_file_system_usage_t, free_files) },
+    RULE_TCP_STATE("Established", SIGAR_TCP_ESTABLISHED),
+    RULE_TCP_STATE("SynSent", SIGAR_TCP_SYN_SENT),
+    RULE_TCP_STATE("SynRecv", SIGAR_TCP_SYN_RECV),
+    RULE_TCP_STATE("FinWait1", SIGAR_TCP_FIN_WAIT1),
+    RULE_TCP_STATE("FinWait2", SIGAR_TCP_FIN_WAIT2),
+    RULE_TCP_STATE("TimeWait", SIGAR_TCP_TIME_WAIT),
+    RULE_TCP_STATE("Close", SIGAR_TCP_CLOSE),
+    RULE_TCP_STATE("CloseWait", SIGAR_TCP_CLOSE_WAIT),
+    RULE_TCP_STATE("LastAck", SIGAR_TCP_LAST_ACK),
+    RULE_TCP_STATE("Listen", SIGAR_TCP_LISTEN),
+    RULE_TCP_STATE("Closing", SIGAR_TCP_CLOSING),
+    { "Tcp", RULE_TCP, "Inbound", RULE_U64,
+      offsetof(sigar_net_stat_t, tcp_inbound_total) },
+    { "Tcp", RULE_TCP, "Outbound", RULE_U64,
+      offsetof(sigar_net_stat_t, tcp_outbound_total) },
+    { "Proc", RULE_PROC, "Processes", RULE_U64, 0 },
+    { "Proc", RULE_PROC, "Rss", RULE_U64, 0 },
+    { "Proc", RULE_PROC, "Size", RULE_U64, 0 },
+    { "Proc", RULE_PROC, "Cpu", RULE_DBL, 0 },
+    { NULL }
+};
+
+#define RULE_FIELD_U64(ptr, offset) \
+    (*(sigar_uint64_t *)((char *)(ptr) + (offset)))
+
+#define RULE_FIELD_DBL(ptr, offset) \
+    (*(double *)((char *)(ptr) + (offset)))
+
+typedef struct {
+    int id;
+    const rule_attr_t *attr;
+    int op;
+    double needle;
+    char *instance;            /* NetIf, Disk and FileSystem */
+    sigar_ptql_query_t *query; /* Proc */
+    int firing;
+    int have_last;             /* RULE_RATE */
+    sigar_uint64_t last;
+    sigar_int64_t last_time;
+} rule_t;
+
+struct sigar_rules_t {
+    unsigned long number;
+    unsigned long size;
+    rule_t *data;
+    int next_id;
+    int have_cpu;
+    sigar_cpu_t last_cpu;
+    rules_lock_t lock;         /* pending, filled by the sampler */
+    sigar_rule_event_list_t pending;
+};
+
+/* looked up once per evaluation, for the rules that need them */
+typedef struct {
+    sigar_t *sigar;
+    int netstat_status;        /* -1 until fetched */
+    sigar_net_stat_t netstat;
+} rules_eval_t;
+
+#define RULES_LIST_MAX 16
+
+static int rule_error(sigar_ptql_error_t *error, const char *format,
+                      const char *arg)
+{
+    if (error != NULL) {
+        snprintf(error->message, sizeof(error->message), format, arg);
+        error->message[sizeof(error->message)-1] = '\0';
+    }
+
+    return SIGAR_PTQL_MALFORMED_QUERY;
+}
+
+static int rule_event_add(sigar_rule_event_list_t *events,
+                          sigar_rule_event_t *event)
+{
+    if (events->number >= events->size) {
+        unsigned long size = events->size + RULES_LIST_MAX;
+        sigar_rule_event_t *data =
+            realloc(events->data, sizeof(*data) * size);
+
+        if (!data) {
+            return ENOMEM;
+        }
+        events->data = data;
+        events->size = size;
+    }
+
+    memcpy(&events->data[events->number++], event, sizeof(*event));
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int) sigar_rules_create(sigar_rules_t **rulesp)
+{
+    sigar_rules_t *rules = calloc(1, sizeof(*rules));
+
+    if (!rules) {
+        return ENOMEM;
+    }
+
+    RULES_LOCK_INIT(&rules->lock);
+    *rulesp = rules;
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int) sigar_rules_destroy(sigar_rules_t *rules)
+{
+    unsigned long i;
+
+    for (i=0; i<rules->number; i++) {
+        rule_t *rule = &rules->data[i];
+
+        free(rule->instance);
+        if (rule->query) {
+            sigar_ptql_query_destroy(rule->query);
+        }
+    }
+
+    free(rules->data);
+    sigar_rule_event_list_destroy(&rules->pending);
+    RULES_LOCK_DESTROY(&rules->lock);
+    free(rules);
+
+    return SIGAR_OK;
+}
+
+/* "4G" -> 4294967296 */
+static int rule_value_parse(char *value, double *needle)
+{
+    char *ptr;
+    double num;
+
+    errno = 0;
+    num = strtod(value, &ptr);
+
+    if ((ptr == value) || (errno == ERANGE)) {
+        return !SIGAR_OK;
+    }
+
+    switch (*ptr) {
+      case 'T':
+        num *= 1024;
+      case 'G':
+        num *= 1024;
+      case 'M':
+        num *= 1024;
+      case 'K':
+        num *= 1024;
+        ptr++;
+        break;
+      default:
+        break;
+    }
+
+    if (*ptr != '\0') {
+        return !SIGAR_OK;
+    }
+
+    *needle = num;
+
+    return SIGAR_OK;
+}
+
+/* "Name.eq=eth0" or "Dir.eq=/var" */
+static int rule_instance_parse(rule_t *rule, char *qualifier,
+                               const char *name,
+                               sigar_ptql_error_t *error)
+{
+    size_t len = strlen(name);
+
+    if (!qualifier ||
+        !strnEQ(qualifier, name, len) ||
+        !strnEQ(qualifier + len, ".eq=", 4) ||
+        (qualifier[len + 4] == '\0'))
+    {
+        return rule_error(error, "Rule needs a %s.eq= qualifier", name);
+    }
+
+    if (!(rule->instance = sigar_strdup(qualifier + len + 4))) {
+        return ENOMEM;
+    }
+
+    return SIGAR_OK;
+}
+
+static int rule_parse(rule_t *rule, char *expr, sigar_ptql_error_t *error)
+{
+    char *qualifier, *eq, *op, *attr;
+    const rule_attr_t *entry;
+
+    if ((qualifier = strchr(expr, ','))) {
+        *qualifier++ = '\0';
+    }
+
+    if (!(eq = strchr(expr, '='))) {
+        return rule_error(error, "Missing '=' in rule '%s'", expr);
+    }
+    *eq++ = '\0';
+
+    if (!(attr = strchr(expr, '.')) || !(op = strchr(attr + 1, '.'))) {
+        return rule_error(error, "Rule '%s' is not Class.Attr.op", expr);
+    }
+    *attr++ = '\0';
+    *op++ = '\0';
+
+    for (entry = rule_attrs; entry->klass; entry++) {
+        if (strEQ(entry->klass, expr) && strEQ(entry->attr, attr)) {
+            break;
+        }
+    }
+    if (!entry->klass) {
+        return rule_error(error, "Unsupported rule attribute '%s'", attr);
+    }
+    rule->attr = entry;
+
+    if ((rule->op = sigar_ptql_op_code(op)) < 0) {
+        return rule_error(error, "Unsupported rule operator '%s'", op);
+    }
+
+    if (rule_value_parse(eq, &rule->needle) != SIGAR_OK) {
+        return rule_error(error, "Rule value '%s' is not a number", eq);
+    }
+
+    switch (entry->klass_id) {
+      case RULE_NETIF:
+      case RULE_DISK:
+        return rule_instance_parse(rule, qualifier, "Name", error);
+      case RULE_FS:
+        return rule_instance_parse(rule, qualifier, "Dir", error);
+      case RULE_PROC:
+        if (!qualifier) {
+            return rule_error(error, "Rule %s needs a ptql query", attr);
+        }
+        return sigar_ptql_query_create(&rule->query, qualifier, error);
+      default:
+        if (qualifier) {
+            return rule_error(error, "Unexpected '%s' in rule", qualifier);
+        }
+        return SIGAR_OK;
+    }
+}
+
+SIGAR_DECLARE(int) sigar_rules_add(sigar_rules_t *rules,
+                                   const char *expr,
+                                   int *id,
+                                   sigar_ptql_error_t *error)
+{
+    rule_t rule;
+    char *copy;
+    int status;
+
+    if (!(copy = sigar_strdup(expr))) {
+        return ENOMEM;
+    }
+
+    memset(&rule, 0, sizeof(rule));
+    status = rule_parse(&rule, copy, error);
+    free(copy);
+
+    if (status == SIGAR_OK && (rules->number >= rules->size)) {
+        unsigned long size = rules->size + RULES_LIST_MAX;
+        rule_t *data = realloc(rules->data, sizeof(*data) * size);
+
+        if (data) {
+            rules->data = data;
+            rules->size = size;
+        }
+        else {
+            status = ENOMEM;
+        }
+    }
+
+    if (status != SIGAR_OK) {
+        free(rule.instance);
+        if (rule.query) {
+            sigar_ptql_query_destroy(rule.query);
+        }
+        return status;
+    }
+
+    rule.id = rules->next_id++;
+    memcpy(&rules->data[rules->number++], &rule, sizeof(rule));
+
+    if (id) {
+        *id = rule.id;
+    }
+
+    return SIGAR_OK;
+}
+
+static int rule_rate(rule_t *rule, sigar_uint64_t counter,
+                     sigar_int64_t now, double *value)
+{
+    int status = ENOENT;
+
+    if (rule->have_last && (now > rule->last_time) &&
+        (counter >= rule->last))
+    {
+        *value = (double)(counter - rule->last) * SIGAR_MSEC /
+            (now - rule->last_time);
+        status = SIGAR_OK;
+    }
+
+    rule->last = counter;
+    rule->last_time = now;
+    rule->have_last = 1;
+
+    return status;
+}
+
+static int rule_snapshot_value(sigar_rules_t *rules, rule_t *rule,
+                               sigar_sampler_snapshot_t *snapshot,
+                               double *value)
+{
+    const rule_attr_t *attr = rule->attr;
+    unsigned long i;
+    void *data = NULL;
+
+    switch (attr->klass_id) {
+      case RULE_CPU:
+        if (!(snapshot->flags & SIGAR_SAMPLER_CPU) || !rules->have_cpu ||
+            (snapshot->cpu.total <= rules->last_cpu.total))
+        {
+            return ENOENT;
+        }
+        else {
+            sigar_uint64_t now = RULE_FIELD_U64(&snapshot->cpu, attr->offset);
+            sigar_uint64_t then =
+                RULE_FIELD_U64(&rules->last_cpu, attr->offset);
+
+            if (now < then) {
+                return ENOENT;
+            }
+            *value = (now - then) * 100.0 /
+                (snapshot->cpu.total - rules->last_cpu.total);
+            return SIGAR_OK;
+        }
+      case RULE_MEM:
+        if (snapshot->flags & SIGAR_SAMPLER_MEM) {
+            data = &snapshot->mem;
+        }
+        break;
+      case RULE_SWAP:
+        if (snapshot->flags & SIGAR_SAMPLER_SWAP) {
+            data = &snapshot->swap;
+        }
+        break;
+      case RULE_NETIF:
+        if (!(snapshot->flags & SIGAR_SAMPLER_NETIF)) {
+            break;
+        }
+        for (i=0; i<snapshot->iflist.number; i++) {
+            if (strEQ(snapshot->iflist.data[i].name, rule->instance)) {
+                data = &snapshot->iflist.data[i];
+                break;
+            }
+        }
+        break;
+      case RULE_DISK:
+        if (!(snapshot->flags & SIGAR_SAMPLER_DISK)) {
+            break;
+        }
+        for (i=0; i<snapshot->disklist.number; i++) {
+            if (strEQ(snapshot->disklist.data[i].name, rule->instance)) {
+                data = &snapshot->disklist.data[i];
+                break;
+            }
+        }
+        break;
+      default:
+        break;
+    }
+
+    if (!data) {
+        return ENOENT;
+    }
+
+    switch (attr->kind) {
+      case RULE_RATE:
+        return rule_rate(rule, RULE_FIELD_U64(data, attr->offset),
+                         snapshot->timestamp, value);
+      case RULE_DBL:
+        *value = RULE_FIELD_DBL(data, attr->offset);
+        return SIGAR_OK;
+      default:
+        *value = (double)RULE_FIELD_U64(data, attr->offset);
+        return SIGAR_OK;
+    }
+}
+
+static int rule_live_value(rules_eval_t *eval, rule_t *rule, double *value)
+{
+    const rule_attr_t *attr = rule->attr;
+    sigar_t *sigar = eval->sigar;
+    int status;
+
+    if (!sigar) {
+        return ENOENT;
+    }
+
+    switch (attr->klass_id) {
+      case RULE_FS:
+        {
+            sigar_file_system_usage_t fsusage;
+
+            status = sigar_file_system_usage_get(sigar, rule->instance,
+                                                 &fsusage);
+            if (status != SIGAR_OK) {
+                return status;
+            }
+
+            if (attr->kind == RULE_PCT1) {
+                /* use_percent is a fraction of 1 */
+                *value = RULE_FIELD_DBL(&fsusage, attr->offset) * 100;
+            }
+            else if (attr->kind == RULE_KB) {
+                *value = (double)RULE_FIELD_U64(&fsusage, attr->offset) * 1024;
+            }
+            else {
+                *value = (double)RULE_FIELD_U64(&fsusage, attr->offset);
+            }
+            return SIGAR_OK;
+        }
+      case RULE_TCP:
+        if (eval->netstat_status < 0) {
+            eval->netstat_status =
+                sigar_net_stat_get(sigar, &eval->netstat,
+                                   SIGAR_NETCONN_CLIENT |
+                                   SIGAR_NETCONN_SERVER |
+                                   SIGAR_NETCONN_TCP);
+        }
+        if (eval->netstat_status != SIGAR_OK) {
+            return eval->netstat_status;
+        }
+
+        if (attr->kind == RULE_STATE) {
+            *value = eval->netstat.tcp_states[attr->offset];
+        }
+        else {
+            *value = *(sigar_uint32_t *)((char *)&eval->netstat +
+                                         attr->offset);
+        }
+        return SIGAR_OK;
+      case RULE_PROC:
+        {
+            sigar_ptql_aggregate_t agg;
+
+            status = sigar_ptql_query_aggregate(sigar, rule->query,
+                                                SIGAR_AGG_CPU |
+                                                SIGAR_AGG_MEM,
+                                                &agg);
+            if (status != SIGAR_OK) {
+                return status;
+            }
+
+            if (strEQ(attr->attr, "Processes")) {
+                *value = (double)agg.processes;
+            }
+            else if (strEQ(attr->attr, "Rss")) {
+                *value = (double)agg.mem.resident;
+            }
+            else if (strEQ(attr->attr, "Size")) {
+                *value = (double)agg.mem.size;
+            }
+            else {
+                *value = agg.cpu.percent * 100;
+            }
+            return SIGAR_OK;
+        }
+      default:
+        return ENOENT;
+    }
+}
+
+SIGAR_DECLARE(int) sigar_rules_eval(sigar_t *sigar,
+                                    sigar_rules_t *rules,
+                                    sigar_sampler_snapshot_t *snapshot,
+                                    sigar_rule_event_list_t *events)
+{
+    rules_eval_t eval;
+    unsigned long i;
+    int status = SIGAR_OK;
+
+    events->number = events->size = 0;
+    events->data = NULL;
+
+    eval.sigar = sigar;
+    eval.netstat_status = -1;
+
+    for (i=0; i<rules->number; i++) {
+        rule_t *rule = &rules->data[i];
+        sigar_rule_event_t event;
+        double value;
+        int matched;
+
+        if (rule->attr->klass_id < RULE_FS) {
+            if (rule_snapshot_value(rules, rule, snapshot, &value) !=
+                SIGAR_OK)
+            {
+                continue;
+            }
+        }
+        else if (rule_live_value(&eval, rule, &value) != SIGAR_OK) {
+            continue;
+        }
+
+        matched = sigar_ptql_op_dbl_match(rule->op, value, rule->needle);
+        if (matched == rule->firing) {
+            continue;
+        }
+        rule->firing = matched;
+
+        event.id = rule->id;
+        event.firing = matched;
+        event.value = value;
+        event.timestamp = snapshot->timestamp;
+
+        if ((status = rule_event_add(events, &event)) != SIGAR_OK) {
+            break;
+        }
+    }
+
+    if (snapshot->flags & SIGAR_SAMPLER_CPU) {
+        memcpy(&rules->last_cpu, &snapshot->cpu, sizeof(rules->last_cpu));
+        rules->have_cpu = 1;
+    }
+
+    return status;
+}
+
+SIGAR_DECLARE(int)
+sigar_rule_event_list_destroy(sigar_rule_event_list_t *events)
+{
+    free(events->data);
+    events->data = NULL;
+    events->number = events->size = 0;
+
+    return SIGAR_OK;
+}
+
+void sigar_rules_sampler_eval(sigar_t *sigar, sigar_rules_t *rules,
+                              sigar_sampler_snapshot_t *snapshot)
+{
+    sigar_rule_event_list_t events;
+    unsigned long i;
+
+    if (sigar_rules_eval(sigar, rules, snapshot, &events) != SIGAR_OK ||
+        !events.number)
+    {
+        sigar_rule_event_list_destroy(&events);
+        return;
+    }
+
+    RULES_LOCK(&rules->lock);
+    for (i=0; i<events.number; i++) {
+        if (rule_event_add(&rules->pending, &events.data[i]) != SIGAR_OK) {
+            break;
+        }
+    }
+    RULES_UNLOCK(&rules->lock);
+
+    sigar_rule_event_list_destroy(&events);
+}
+
+SIGAR_DECLARE(int) sigar_rules_events_take(sigar_rules_t *rules,
+                                           sigar_rule_event_list_t *events)
+{
+    RULES_LOCK(&rules->lock);
+    memcpy(events, &rules->pending, sizeof(*events));
+    rules->pending.number = rules->pending.size = 0;
+    rules->pending.data = NULL;
+    RULES_UNLOCK(&rules->lock);
+
+    return SIGAR_OK;
+}
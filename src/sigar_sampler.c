@@ -0,0 +1,1028 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef WIN32
+#include <pthread.h>
+#include <sys/time.h>
+#endif
+
+#include "sigar.h"
+#include "sigar_sampler.h"
+#include "sigar_rules.h"
+#include "sigar_private.h"
+#include "sigar_util.h"
+#include "sigar_os.h"
+
+/*
+ * snapshots live in a fixed set of slots that are refilled in place
+ * and only freed by sigar_sampler_destroy, so a reader that bumps the
+ * refcount of a slot which has just been retired touches valid memory
+ * and simply retries when it sees the slot is no longer current.
+ * the sampler only refills a slot that is not current and has no
+ * readers; if every slot is held the round is skipped.
+ */
+#define SIGAR_SAMPLER_SLOTS 4
+
+#if defined(WIN32)
+typedef volatile LONG sampler_refs_t;
+#  define SAMPLER_INC(refs) InterlockedIncrement(refs)
+#  define SAMPLER_DEC(refs) InterlockedDecrement(refs)
+#  define SAMPLER_LOAD(refs) InterlockedCompareExchange(refs, 0, 0)
+#  define SAMPLER_PTR_LOAD(ptr) \
+    InterlockedCompareExchangePointer((PVOID volatile *)ptr, NULL, NULL)
+#  define SAMPLER_PTR_STORE(ptr, val) \
+    InterlockedExchangePointer((PVOID volatile *)ptr, val)
+#elif defined(__ATOMIC_SEQ_CST)
+typedef int sampler_refs_t;
+#  define SAMPLER_INC(refs) __atomic_add_fetch(refs, 1, __ATOMIC_SEQ_CST)
+#  define SAMPLER_DEC(refs) __atomic_sub_fetch(refs, 1, __ATOMIC_SEQ_CST)
+#  define SAMPLER_LOAD(refs) __atomic_load_n(refs, __ATOMIC_SEQ_CST)
+#  define SAMPLER_PTR_LOAD(ptr) __atomic_load_n(ptr, __ATOMIC_SEQ_CST)
+#  define SAMPLER_PTR_STORE(ptr, val) \
+    __atomic_store_n(ptr, val, __ATOMIC_SEQ_CST)
+#elif defined(__GNUC__)
+/* gcc before 4.7 */
+typedef volatile int sampler_refs_t;
+#  define SAMPLER_INC(refs) __sync_add_and_fetch(refs, 1)
+#  define SAMPLER_DEC(refs) __sync_sub_and_fetch(refs, 1)
+#  define SAMPLER_LOAD(refs) __sync_fetch_and_add(refs, 0)
+#  define SAMPLER_PTR_LOAD(ptr) \
+    __sync_val_compare_and_swap(ptr, NULL, NULL)
+#  define SAMPLER_PTR_STORE(ptr, val) \
+    do { \
+        __sync_synchronize(); \
+        *(ptr) = (val); \
+        __sync_synchronize(); \
+    } while (0)
+#else
+/* no atomics known for this compiler, fall back to one lock */
+#  define SAMPLER_LOCKED
+static pthread_mutex_t sampler_atomic_lock = PTHREAD_MUTEX_INITIALIZER;
+typedef int sampler_refs_t;
+#  define SAMPLER_INC(refs) sampler_atomic_add(refs, 1)
+#  define SAMPLER_DEC(refs) sampler_atomic_add(refs, -1)
+#  define SAMPLER_LOAD(refs) sampler_atomic_add(refs, 0)
+#  define SAMPLER_PTR_LOAD(ptr) sampler_atomic_ptr(ptr, NULL, 0)
+#  define SAMPLER_PTR_STORE(ptr, val) sampler_atomic_ptr(ptr, val, 1)
+#endif
+
+/* a sigar_sampler_perf_add target and its totals as of the last round */
+typedef struct {
+    sigar_pid_t pid;
+    char *cgroup; /* NULL for a pid */
+    sigar_uint64_t id;
+    sigar_proc_perf_t last;
+} sampler_perf_t;
+
+/*
+ * one per SIGAR_SAMPLER_* bit, touched only by the round; what
+ * sigar_sampler_schedule_get reads is copied out under the lock
+ */
+#define SAMPLER_COLLECTORS 10
+#define SAMPLER_PERIOD_MAX 64
+
+typedef struct {
+    sigar_uint64_t cost;
+    sigar_uint64_t runs;
+    unsigned long period;
+    unsigned long age; /* rounds since the last run */
+    sigar_int64_t collected;
+} sampler_sched_t;
+
+typedef struct {
+    /* first, so a snapshot pointer is also its slot */
+    sigar_sampler_snapshot_t snapshot;
+    sampler_refs_t refs;
+} sampler_slot_t;
+
+struct sigar_sampler_t {
+    sigar_t *sigar;
+    int flags;
+    int proc_flags;
+    sigar_uint64_t interval;
+    sigar_uint64_t generation;
+    sigar_uint64_t skipped;
+    sampler_slot_t slots[SIGAR_SAMPLER_SLOTS];
+    sampler_slot_t * volatile current;
+    sigar_shm_t *shm;
+    sigar_tsdb_t *tsdb;
+    sigar_rules_t *rules;
+    sampler_perf_t *perf;
+    unsigned long nperf;
+    /* totals as of the last round */
+    sigar_interrupt_list_t last_interrupts;
+    sigar_interrupt_list_t last_softirqs;
+    double budget;
+    sampler_sched_t sched[SAMPLER_COLLECTORS];
+    sigar_sampler_schedule_t schedule[SAMPLER_COLLECTORS];
+    int running;
+    int stop;
+#ifdef WIN32
+    HANDLE thread;
+    HANDLE wakeup;
+    CRITICAL_SECTION lock;
+#else
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+#endif
+};
+
+#ifdef SAMPLER_LOCKED
+static int sampler_atomic_add(sampler_refs_t *refs, int val)
+{
+    int retval;
+    pthread_mutex_lock(&sampler_atomic_lock);
+    retval = (*refs += val);
+    pthread_mutex_unlock(&sampler_atomic_lock);
+    return retval;
+}
+
+static sampler_slot_t *sampler_atomic_ptr(sampler_slot_t * volatile *ptr,
+                                          sampler_slot_t *val, int store)
+{
+    sampler_slot_t *retval;
+    pthread_mutex_lock(&sampler_atomic_lock);
+    if (store) {
+        *ptr = val;
+    }
+    retval = *ptr;
+    pthread_mutex_unlock(&sampler_atomic_lock);
+    return retval;
+}
+#endif
+
+static void sampler_snapshot_free(sigar_t *sigar,
+                                  sigar_sampler_snapshot_t *snapshot)
+{
+    sigar_cpu_list_destroy(sigar, &snapshot->cpulist);
+    sigar_net_interface_stat_list_destroy(sigar, &snapshot->iflist);
+    sigar_disk_usage_list_destroy(sigar, &snapshot->disklist);
+    sigar_proc_snapshot_destroy(sigar, &snapshot->procs);
+    if (snapshot->perfs.size) {
+        free(snapshot->perfs.data);
+        snapshot->perfs.number = snapshot->perfs.size = 0;
+    }
+    sigar_interrupt_list_destroy(sigar, &snapshot->interrupts);
+    sigar_interrupt_list_destroy(sigar, &snapshot->softirqs);
+}
+
+static int sampler_perf_read(sigar_t *sigar, sampler_perf_t *target,
+                             sigar_proc_perf_t *perf)
+{
+    if (target->cgroup) {
+        return sigar_proc_perf_cgroup_get(sigar, target->cgroup, perf);
+    }
+    else {
+        return sigar_proc_perf_get(sigar, target->pid, perf);
+    }
+}
+
+/* every target that could be read, as deltas against the last round */
+static int sampler_perf_collect(sigar_sampler_t *sampler,
+                                sigar_proc_perf_list_t *perfs)
+{
+    unsigned long i;
+
+    perfs->number = 0;
+    perfs->size = sampler->nperf ? sampler->nperf : 1;
+    if (!(perfs->data = malloc(sizeof(*perfs->data) * perfs->size))) {
+        perfs->size = 0;
+        return ENOMEM;
+    }
+
+    for (i=0; i<sampler->nperf; i++) {
+        sampler_perf_t *target = &sampler->perf[i];
+        sigar_proc_perf_entry_t *entry = &perfs->data[perfs->number];
+        sigar_uint64_t *now = (sigar_uint64_t *)&entry->perf;
+        sigar_uint64_t *last = (sigar_uint64_t *)&target->last;
+        int n;
+
+        if (sampler_perf_read(sampler->sigar, target,
+                              &entry->perf) != SIGAR_OK)
+        {
+            continue;
+        }
+
+        /* all members are sigar_uint64_t */
+        for (n=0; n<sizeof(entry->perf)/sizeof(*now); n++) {
+            sigar_uint64_t total = now[n];
+
+            if (total != SIGAR_FIELD_NOTIMPL) {
+                now[n] = (total >= last[n]) ? total - last[n] : 0;
+            }
+            last[n] = total;
+        }
+
+        if (target->cgroup) {
+            entry->id = target->id;
+            entry->cgroup = 1;
+        }
+        else {
+            entry->id = (sigar_uint64_t)target->pid;
+            entry->cgroup = 0;
+        }
+        perfs->number++;
+    }
+
+    return SIGAR_OK;
+}
+
+static int sampler_interrupts_copy(sigar_interrupt_list_t *to,
+                                   sigar_interrupt_list_t *from)
+{
+    unsigned long ncpu = from->ncpu;
+
+    sigar_interrupt_list_create(to, ncpu);
+    while (to->size < from->number) {
+        sigar_interrupt_list_grow(to);
+    }
+    to->number = from->number;
+    memcpy(to->data, from->data, sizeof(*to->data) * from->number);
+    memcpy(to->cpus, from->cpus, sizeof(*to->cpus) * ncpu);
+    memcpy(to->counts, from->counts,
+           sizeof(*to->counts) * from->number * ncpu);
+
+    return SIGAR_OK;
+}
+
+static sigar_uint64_t sampler_counter_delta(sigar_uint64_t now,
+                                            sigar_uint64_t last)
+{
+    return (now >= last) ? now - last : 0;
+}
+
+/* rows are matched by name, irqs come and go with their devices */
+static int sampler_interrupts_collect(sigar_sampler_t *sampler,
+                                      sigar_interrupt_list_t *now,
+                                      sigar_interrupt_list_t *last,
+                                      int softirqs)
+{
+    sigar_interrupt_list_t totals;
+    unsigned long ncpu, i, j, n;
+    int status = softirqs ?
+        sigar_softirqs_get(sampler->sigar, now) :
+        sigar_interrupts_get(sampler->sigar, now);
+
+    if (status != SIGAR_OK) {
+        return status;
+    }
+
+    sampler_interrupts_copy(&totals, now);
+    ncpu = now->ncpu;
+
+    if ((last->ncpu == ncpu) &&
+        (memcmp(last->cpus, now->cpus, sizeof(*now->cpus) * ncpu) == 0))
+    {
+        for (i=0; i<now->number; i++) {
+            sigar_interrupt_t *irq = &now->data[i];
+            sigar_uint64_t *counts = &now->counts[i * ncpu], *prev;
+
+            if ((i < last->number) && strEQ(last->data[i].name, irq->name)) {
+                j = i;
+            }
+            else {
+                for (j=0; j<last->number; j++) {
+                    if (strEQ(last->data[j].name, irq->name)) {
+                        break;
+                    }
+                }
+                if (j == last->number) {
+                    continue;
+                }
+            }
+
+            prev = &last->counts[j * ncpu];
+            for (n=0; n<ncpu; n++) {
+                counts[n] = sampler_counter_delta(counts[n], prev[n]);
+            }
+            irq->total = sampler_counter_delta(irq->total,
+                                               last->data[j].total);
+        }
+    }
+
+    sigar_interrupt_list_destroy(sampler->sigar, last);
+    *last = totals;
+
+    return SIGAR_OK;
+}
+
+#ifdef WIN32
+#  define SAMPLER_LOCK(sampler) EnterCriticalSection(&(sampler)->lock)
+#  define SAMPLER_UNLOCK(sampler) LeaveCriticalSection(&(sampler)->lock)
+#else
+#  define SAMPLER_LOCK(sampler) pthread_mutex_lock(&(sampler)->lock)
+#  define SAMPLER_UNLOCK(sampler) pthread_mutex_unlock(&(sampler)->lock)
+#endif
+
+/* nanos of cpu time used by the calling thread */
+static sigar_uint64_t sampler_cpu_now(sigar_t *sigar)
+{
+    sigar_thread_cpu_t cpu;
+#ifdef CLOCK_THREAD_CPUTIME_ID
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0) {
+        return ((sigar_uint64_t)ts.tv_sec * SIGAR_NSEC) + ts.tv_nsec;
+    }
+#endif
+    if (sigar_thread_cpu_get(sigar, 0, &cpu) == SIGAR_OK) {
+        return cpu.total;
+    }
+    return 0;
+}
+
+static int sampler_collector_run(sigar_sampler_t *sampler,
+                                 sigar_sampler_snapshot_t *snapshot,
+                                 int collector)
+{
+    sigar_t *sigar = sampler->sigar;
+
+    switch (collector) {
+      case SIGAR_SAMPLER_CPU:
+        return sigar_cpu_get(sigar, &snapshot->cpu);
+      case SIGAR_SAMPLER_CPU_LIST:
+        return sigar_cpu_list_get(sigar, &snapshot->cpulist);
+      case SIGAR_SAMPLER_MEM:
+        return sigar_mem_get(sigar, &snapshot->mem);
+      case SIGAR_SAMPLER_SWAP:
+        return sigar_swap_get(sigar, &snapshot->swap);
+      case SIGAR_SAMPLER_NETIF:
+        return sigar_net_interface_stat_list_get(sigar, &snapshot->iflist);
+      case SIGAR_SAMPLER_DISK:
+        return sigar_disk_usage_list_get(sigar, &snapshot->disklist);
+      case SIGAR_SAMPLER_PROC:
+        return sigar_proc_snapshot_get(sigar, sampler->proc_flags,
+                                       &snapshot->procs);
+      case SIGAR_SAMPLER_PERF:
+        return sampler_perf_collect(sampler, &snapshot->perfs);
+      case SIGAR_SAMPLER_INTERRUPTS:
+        return sampler_interrupts_collect(sampler, &snapshot->interrupts,
+                                          &sampler->last_interrupts, 0);
+      case SIGAR_SAMPLER_SOFTIRQS:
+        return sampler_interrupts_collect(sampler, &snapshot->softirqs,
+                                          &sampler->last_softirqs, 1);
+      default:
+        return SIGAR_ENOTIMPL;
+    }
+}
+
+/* nanos of cpu time a round may spend, 0 for no budget */
+static sigar_uint64_t sampler_round_budget(sigar_sampler_t *sampler)
+{
+    sigar_uint64_t budget = (sigar_uint64_t)(sampler->budget / 100 *
+                                             sampler->interval * SIGAR_USEC);
+
+    if ((budget == 0) && (sampler->budget > 0)) {
+        return 1;
+    }
+    return budget;
+}
+
+/* one period step per round, towards the expected cost fitting */
+static void sampler_schedule_adapt(sigar_sampler_t *sampler,
+                                   sigar_uint64_t budget)
+{
+    sigar_uint64_t load = 0, worst = 0;
+    int i, slower = -1, faster = -1;
+
+    for (i=0; i<SAMPLER_COLLECTORS; i++) {
+        sampler_sched_t *sched = &sampler->sched[i];
+
+        if (sampler->flags & (1 << i)) {
+            load += sched->cost / sched->period;
+        }
+    }
+
+    for (i=0; i<SAMPLER_COLLECTORS; i++) {
+        sampler_sched_t *sched = &sampler->sched[i];
+        sigar_uint64_t share, halved;
+
+        if (!(sampler->flags & (1 << i))) {
+            continue;
+        }
+        share = sched->cost / sched->period;
+
+        if (load > budget) {
+            if ((sched->period < SAMPLER_PERIOD_MAX) && (share > worst)) {
+                worst = share;
+                slower = i;
+            }
+        }
+        else if (sched->period > 1) {
+            /* leaving a quarter of the budget spare, not to flap */
+            halved = load - share + (sched->cost / (sched->period / 2));
+            if ((halved <= budget - (budget / 4)) &&
+                ((faster < 0) ||
+                 (sched->period > sampler->sched[faster].period)))
+            {
+                faster = i;
+            }
+        }
+    }
+
+    if (slower >= 0) {
+        sampler->sched[slower].period *= 2;
+    }
+    else if (faster >= 0) {
+        sampler->sched[faster].period /= 2;
+    }
+}
+
+static void sampler_collect(sigar_sampler_t *sampler,
+                            sigar_sampler_snapshot_t *snapshot)
+{
+    sigar_t *sigar = sampler->sigar;
+    sigar_uint64_t budget = sampler_round_budget(sampler);
+    sigar_uint64_t spent = 0;
+    int i;
+
+    sampler_snapshot_free(sigar, snapshot);
+    snapshot->flags = 0;
+    snapshot->timestamp = sigar_time_now_millis();
+
+    for (i=0; i<SAMPLER_COLLECTORS; i++) {
+        sampler_sched_t *sched = &sampler->sched[i];
+        int collector = 1 << i;
+        sigar_uint64_t start, cost;
+
+        if (!(sampler->flags & collector)) {
+            continue;
+        }
+
+        sched->age++;
+        if (budget) {
+            if (sched->age < sched->period) {
+                continue;
+            }
+            if (sched->runs && spent && (spent + sched->cost > budget) &&
+                (sched->age < sched->period * 2))
+            {
+                continue;
+            }
+        }
+
+        start = sampler_cpu_now(sigar);
+        if (sampler_collector_run(sampler, snapshot,
+                                  collector) == SIGAR_OK)
+        {
+            snapshot->flags |= collector;
+            sched->collected = snapshot->timestamp;
+        }
+        cost = sampler_cpu_now(sigar) - start;
+        spent += cost;
+
+        sched->cost = sched->runs ?
+            ((sched->cost * 3) + cost) / 4 : cost;
+        sched->runs++;
+        sched->age = 0;
+    }
+
+    if (budget) {
+        sampler_schedule_adapt(sampler, budget);
+    }
+
+    SAMPLER_LOCK(sampler);
+    for (i=0; i<SAMPLER_COLLECTORS; i++) {
+        sampler_sched_t *sched = &sampler->sched[i];
+        sigar_sampler_schedule_t *schedule = &sampler->schedule[i];
+
+        schedule->cost = sched->cost;
+        schedule->runs = sched->runs;
+        schedule->period = sched->period;
+        schedule->collected = sched->collected;
+    }
+    SAMPLER_UNLOCK(sampler);
+}
+
+/* one round, only ever called from one thread at a time */
+static void sampler_round(sigar_sampler_t *sampler)
+{
+    sampler_slot_t *current = SAMPLER_PTR_LOAD(&sampler->current);
+    sampler_slot_t *slot = NULL;
+    int i;
+
+    for (i=0; i<SIGAR_SAMPLER_SLOTS; i++) {
+        sampler_slot_t *candidate = &sampler->slots[i];
+
+        if ((candidate != current) && (SAMPLER_LOAD(&candidate->refs) == 0)) {
+            slot = candidate;
+            break;
+        }
+    }
+
+    if (!slot) {
+        sampler->skipped++;
+        return;
+    }
+
+    sampler_collect(sampler, &slot->snapshot);
+    slot->snapshot.generation = ++sampler->generation;
+
+    SAMPLER_PTR_STORE(&sampler->current, slot);
+
+    if (sampler->shm) {
+        sigar_shm_publish(sampler->shm, &slot->snapshot);
+    }
+
+    if (sampler->tsdb) {
+        sigar_tsdb_add(sampler->tsdb, &slot->snapshot);
+    }
+
+    if (sampler->rules) {
+        sigar_rules_sampler_eval(sampler->sigar, sampler->rules,
+                                 &slot->snapshot);
+    }
+}
+
+SIGAR_DECLARE(int) sigar_sampler_create(sigar_sampler_t **sampler,
+                                        int flags,
+                                        sigar_uint64_t interval)
+{
+    sigar_sampler_t *s;
+    int i, status;
+
+    s = calloc(1, sizeof(*s));
+    if (!s) {
+        return ENOMEM;
+    }
+
+    if ((status = sigar_open(&s->sigar)) != SIGAR_OK) {
+        free(s);
+        return status;
+    }
+
+    s->flags = flags;
+    s->proc_flags = SIGAR_PROC_SNAPSHOT_ALL;
+    s->interval = interval ? interval : 1000;
+    for (i=0; i<SAMPLER_COLLECTORS; i++) {
+        s->sched[i].period = s->schedule[i].period = 1;
+    }
+
+#ifdef WIN32
+    s->wakeup = CreateEvent(NULL, TRUE, FALSE, NULL);
+    InitializeCriticalSection(&s->lock);
+#else
+    pthread_mutex_init(&s->lock, NULL);
+    pthread_cond_init(&s->cond, NULL);
+#endif
+
+    *sampler = s;
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int) sigar_sampler_proc_flags_set(sigar_sampler_t *sampler,
+                                                int flags)
+{
+    if (sampler->running) {
+        return EBUSY;
+    }
+
+    sampler->proc_flags = flags;
+
+    return SIGAR_OK;
+}
+
+static int sampler_perf_add(sigar_sampler_t *sampler, sigar_pid_t pid,
+                            const char *path)
+{
+    sampler_perf_t *perf, *target;
+    int status;
+
+    if (sampler->running) {
+        return EBUSY;
+    }
+
+    perf = realloc(sampler->perf, sizeof(*perf) * (sampler->nperf + 1));
+    if (!perf) {
+        return ENOMEM;
+    }
+    sampler->perf = perf;
+    target = &perf[sampler->nperf];
+    SIGAR_ZERO(target);
+    target->pid = pid;
+
+    if (path) {
+        sigar_cgroup_stat_t cgroupstat;
+
+        status = sigar_proc_perf_cgroup_open(sampler->sigar, path);
+        if (status != SIGAR_OK) {
+            return status;
+        }
+        if (sigar_cgroup_stat_get(sampler->sigar, path,
+                                  &cgroupstat) == SIGAR_OK)
+        {
+            target->id = cgroupstat.id;
+        }
+        target->cgroup = sigar_strdup(path);
+    }
+    else if ((status = sigar_proc_perf_open(sampler->sigar, pid)) !=
+             SIGAR_OK)
+    {
+        return status;
+    }
+
+    /* the first round counts from here */
+    if (sampler_perf_read(sampler->sigar, target,
+                          &target->last) != SIGAR_OK)
+    {
+        SIGAR_ZERO(&target->last);
+    }
+    sampler->nperf++;
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int) sigar_sampler_perf_add(sigar_sampler_t *sampler,
+                                          sigar_pid_t pid)
+{
+    return sampler_perf_add(sampler, pid, NULL);
+}
+
+SIGAR_DECLARE(int) sigar_sampler_perf_cgroup_add(sigar_sampler_t *sampler,
+                                                 const char *path)
+{
+    return sampler_perf_add(sampler, 0, path);
+}
+
+SIGAR_DECLARE(int) sigar_sampler_shm_set(sigar_sampler_t *sampler,
+                                         const char *name,
+                                         sigar_uint64_t size)
+{
+    if (sampler->running) {
+        return EBUSY;
+    }
+
+    if (sampler->shm) {
+        sigar_shm_destroy(sampler->shm);
+        sampler->shm = NULL;
+    }
+
+    if (!name) {
+        return SIGAR_OK;
+    }
+
+    return sigar_shm_create(&sampler->shm, name, size);
+}
+
+SIGAR_DECLARE(int) sigar_sampler_tsdb_set(sigar_sampler_t *sampler,
+                                          const sigar_tsdb_opts_t *opts)
+{
+    sigar_tsdb_t *tsdb;
+    int status;
+
+    if (sampler->running) {
+        return EBUSY;
+    }
+
+    if ((status = sigar_tsdb_create(&tsdb, opts)) != SIGAR_OK) {
+        return status;
+    }
+
+    if (sampler->tsdb) {
+        sigar_tsdb_destroy(sampler->tsdb);
+    }
+    sampler->tsdb = tsdb;
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(sigar_tsdb_t *)
+sigar_sampler_tsdb_get(sigar_sampler_t *sampler)
+{
+    return sampler->tsdb;
+}
+
+SIGAR_DECLARE(int) sigar_sampler_budget_set(sigar_sampler_t *sampler,
+                                            double percent)
+{
+    int i;
+
+    if (sampler->running) {
+        return EBUSY;
+    }
+    if (percent < 0) {
+        return EINVAL;
+    }
+
+    sampler->budget = percent;
+    for (i=0; i<SAMPLER_COLLECTORS; i++) {
+        sampler->sched[i].period = sampler->schedule[i].period = 1;
+    }
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int)
+sigar_sampler_schedule_get(sigar_sampler_t *sampler,
+                           int collector,
+                           sigar_sampler_schedule_t *schedule)
+{
+    int i;
+
+    for (i=0; i<SAMPLER_COLLECTORS; i++) {
+        if (collector == (1 << i)) {
+            break;
+        }
+    }
+    if ((i == SAMPLER_COLLECTORS) || !(sampler->flags & collector)) {
+        return EINVAL;
+    }
+
+    SAMPLER_LOCK(sampler);
+    memcpy(schedule, &sampler->schedule[i], sizeof(*schedule));
+    SAMPLER_UNLOCK(sampler);
+
+    if (schedule->collected) {
+        sigar_int64_t now = sigar_time_now_millis();
+
+        schedule->staleness = (now > schedule->collected) ?
+            (sigar_uint64_t)(now - schedule->collected) : 0;
+    }
+    else {
+        schedule->staleness = SIGAR_FIELD_NOTIMPL;
+    }
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int) sigar_sampler_rules_set(sigar_sampler_t *sampler,
+                                           sigar_rules_t *rules)
+{
+    if (sampler->running) {
+        return EBUSY;
+    }
+
+    sampler->rules = rules;
+
+    return SIGAR_OK;
+}
+
+#ifdef WIN32
+
+static DWORD WINAPI sampler_main(LPVOID data)
+{
+    sigar_sampler_t *sampler = data;
+
+    while (WaitForSingleObject(sampler->wakeup,
+                               (DWORD)sampler->interval) == WAIT_TIMEOUT)
+    {
+        sampler_round(sampler);
+    }
+
+    return 0;
+}
+
+SIGAR_DECLARE(int) sigar_sampler_start(sigar_sampler_t *sampler)
+{
+    if (sampler->running) {
+        return SIGAR_OK;
+    }
+
+    sampler_round(sampler);
+
+    ResetEvent(sampler->wakeup);
+    sampler->thread = CreateThread(NULL, 0, sampler_main, sampler, 0, NULL);
+    if (!sampler->thread) {
+        return GetLastError();
+    }
+    sampler->running = 1;
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int) sigar_sampler_stop(sigar_sampler_t *sampler)
+{
+    if (!sampler->running) {
+        return SIGAR_OK;
+    }
+
+    SetEvent(sampler->wakeup);
+    WaitForSingleObject(sampler->thread, INFINITE);
+    CloseHandle(sampler->thread);
+    sampler->running = 0;
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int) sigar_sampler_wait(sigar_sampler_t *sampler,
+                                      sigar_uint64_t generation,
+                                      int timeout)
+{
+    sigar_int64_t deadline = sigar_time_now_millis() + timeout;
+
+    for (;;) {
+        sampler_slot_t *current = SAMPLER_PTR_LOAD(&sampler->current);
+
+        if (current && (current->snapshot.generation > generation)) {
+            return SIGAR_OK;
+        }
+        if (sigar_time_now_millis() >= deadline) {
+            return ETIMEDOUT;
+        }
+        Sleep(10);
+    }
+}
+
+#else
+
+static void *sampler_main(void *data)
+{
+    sigar_sampler_t *sampler = data;
+    struct timespec deadline;
+    struct timeval now;
+    sigar_uint64_t next;
+
+    pthread_mutex_lock(&sampler->lock);
+
+    while (!sampler->stop) {
+        gettimeofday(&now, NULL);
+        next = ((sigar_uint64_t)now.tv_sec * SIGAR_MSEC) +
+            (now.tv_usec / SIGAR_MSEC) + sampler->interval;
+        deadline.tv_sec = next / SIGAR_MSEC;
+        deadline.tv_nsec = (next % SIGAR_MSEC) * SIGAR_USEC;
+
+        while (!sampler->stop &&
+               (pthread_cond_timedwait(&sampler->cond, &sampler->lock,
+                                       &deadline) != ETIMEDOUT))
+        {
+            /* woken up early, by stop or a waiter broadcast */
+        }
+        if (sampler->stop) {
+            break;
+        }
+
+        pthread_mutex_unlock(&sampler->lock);
+        sampler_round(sampler);
+        pthread_mutex_lock(&sampler->lock);
+
+        pthread_cond_broadcast(&sampler->cond);
+    }
+
+    pthread_mutex_unlock(&sampler->lock);
+
+    return NULL;
+}
+
+SIGAR_DECLARE(int) sigar_sampler_start(sigar_sampler_t *sampler)
+{
+    int status;
+
+    if (sampler->running) {
+        return SIGAR_OK;
+    }
+
+    sampler_round(sampler);
+
+    sampler->stop = 0;
+    status = pthread_create(&sampler->thread, NULL, sampler_main, sampler);
+    if (status != 0) {
+        return status;
+    }
+    sampler->running = 1;
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int) sigar_sampler_stop(sigar_sampler_t *sampler)
+{
+    if (!sampler->running) {
+        return SIGAR_OK;
+    }
+
+    pthread_mutex_lock(&sampler->lock);
+    sampler->stop = 1;
+    pthread_cond_broadcast(&sampler->cond);
+    pthread_mutex_unlock(&sampler->lock);
+
+    pthread_join(sampler->thread, NULL);
+    sampler->running = 0;
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int) sigar_sampler_wait(sigar_sampler_t *sampler,
+                                      sigar_uint64_t generation,
+                                      int timeout)
+{
+    struct timespec deadline;
+    struct timeval now;
+    sigar_uint64_t end;
+    int status = SIGAR_OK;
+
+    gettimeofday(&now, NULL);
+    end = ((sigar_uint64_t)now.tv_sec * SIGAR_MSEC) +
+        (now.tv_usec / SIGAR_MSEC) + timeout;
+    deadline.tv_sec = end / SIGAR_MSEC;
+    deadline.tv_nsec = (end % SIGAR_MSEC) * SIGAR_USEC;
+
+    pthread_mutex_lock(&sampler->lock);
+
+    for (;;) {
+        sampler_slot_t *current = SAMPLER_PTR_LOAD(&sampler->current);
+
+        if (current && (current->snapshot.generation > generation)) {
+            status = SIGAR_OK;
+            break;
+        }
+        if (status == ETIMEDOUT) {
+            break;
+        }
+        status = pthread_cond_timedwait(&sampler->cond, &sampler->lock,
+                                        &deadline);
+    }
+
+    pthread_mutex_unlock(&sampler->lock);
+
+    return status;
+}
+
+#endif
+
+SIGAR_DECLARE(int) sigar_sampler_destroy(sigar_sampler_t *sampler)
+{
+    int i;
+
+    sigar_sampler_stop(sampler);
+
+    if (sampler->shm) {
+        sigar_shm_destroy(sampler->shm);
+    }
+
+    if (sampler->tsdb) {
+        sigar_tsdb_destroy(sampler->tsdb);
+    }
+
+    for (i=0; i<SIGAR_SAMPLER_SLOTS; i++) {
+        sampler_snapshot_free(sampler->sigar, &sampler->slots[i].snapshot);
+    }
+
+    for (i=0; i<(int)sampler->nperf; i++) {
+        if (sampler->perf[i].cgroup) {
+            free(sampler->perf[i].cgroup);
+        }
+    }
+    if (sampler->perf) {
+        free(sampler->perf);
+    }
+    sigar_interrupt_list_destroy(sampler->sigar, &sampler->last_interrupts);
+    sigar_interrupt_list_destroy(sampler->sigar, &sampler->last_softirqs);
+
+#ifdef WIN32
+    CloseHandle(sampler->wakeup);
+    DeleteCriticalSection(&sampler->lock);
+#else
+    pthread_cond_destroy(&sampler->cond);
+    pthread_mutex_destroy(&sampler->lock);
+#endif
+
+    sigar_close(sampler->sigar);
+    free(sampler);
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(sigar_sampler_snapshot_t *)
+sigar_sampler_snapshot_acquire(sigar_sampler_t *sampler)
+{
+    for (;;) {
+        sampler_slot_t *slot = SAMPLER_PTR_LOAD(&sampler->current);
+
+        if (!slot) {
+            return NULL;
+        }
+
+        SAMPLER_INC(&slot->refs);
+        if (SAMPLER_PTR_LOAD(&sampler->current) == slot) {
+            return &slot->snapshot;
+        }
+        /* retired between the load and the increment */
+        SAMPLER_DEC(&slot->refs);
+    }
+}
+
+SIGAR_DECLARE(void)
+sigar_sampler_snapshot_release(sigar_sampler_t *sampler,
+                               sigar_sampler_snapshot_t *snapshot)
+{
+    sampler_slot_t *slot = (sampler_slot_t *)snapshot;
+
+    SAMPLER_DEC(&slot->refs);
+}
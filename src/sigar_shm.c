@@ -0,0 +1,546 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * sampler rounds in a named shared memory segment.  one process
+ * writes, with a seqlock around each round; readers copy the data
+ * out, check the sequence did not move while they did and only then
+ * parse their private copy, so a reader never sees a half written
+ * round and the writer never waits for one.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifndef WIN32
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
+#endif
+
+#include "sigar.h"
+#include "sigar_sampler.h"
+#include "sigar_private.h"
+#include "sigar_util.h"
+#include "sigar_os.h"
+
+#if defined(WIN32)
+#  define SHM_FENCE() MemoryBarrier()
+#  define SHM_YIELD() SwitchToThread()
+#elif defined(__ATOMIC_SEQ_CST)
+#  define SHM_FENCE() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#  define SHM_YIELD() sched_yield()
+#elif defined(__GNUC__)
+/* gcc before 4.7 */
+#  define SHM_FENCE() __sync_synchronize()
+#  define SHM_YIELD() sched_yield()
+#else
+/* no barrier known for this compiler, a lock would not cross processes */
+#  define SHM_UNSUPPORTED
+#endif
+
+#define SHM_MAGIC   0x48534753 /* "SGSH" */
+#define SHM_VERSION 2
+#define SHM_RETRIES 100
+
+#define SHM_ALIGN(n) (((n) + 7) & ~((sigar_uint64_t)7))
+
+/* record sizes, a reader built against other structs refuses to attach */
+enum {
+    SHM_LAYOUT_ROUND,
+    SHM_LAYOUT_CPU,
+    SHM_LAYOUT_MEM,
+    SHM_LAYOUT_SWAP,
+    SHM_LAYOUT_NETIF,
+    SHM_LAYOUT_DISK,
+    SHM_LAYOUT_PROC,
+    SHM_LAYOUT_PERF,
+    SHM_LAYOUT_MAX
+};
+
+typedef struct {
+    sigar_uint32_t magic;
+    sigar_uint32_t version;
+    sigar_uint64_t size;      /* of the whole segment */
+    sigar_uint64_t layout[SHM_LAYOUT_MAX];
+    volatile sigar_uint32_t seq; /* odd while a round is written */
+    sigar_uint32_t pad;
+    sigar_uint64_t used;      /* bytes of round data */
+} shm_header_t;
+
+/* followed by the cpu, netif, disk, proc and perf arrays, in that order */
+typedef struct {
+    sigar_uint64_t generation;
+    sigar_int64_t timestamp;
+    sigar_uint64_t flags;
+    sigar_uint64_t ncpu;
+    sigar_uint64_t nnetif;
+    sigar_uint64_t ndisk;
+    sigar_uint64_t nproc;
+    sigar_uint64_t nperf;
+    sigar_cpu_t cpu;
+    sigar_mem_t mem;
+    sigar_swap_t swap;
+} shm_round_t;
+
+#define SHM_DATA_OFFSET SHM_ALIGN(sizeof(shm_header_t))
+
+struct sigar_shm_t {
+    shm_header_t *header;
+    sigar_uint64_t size;
+    int writer;
+    char *copy;               /* reader side copy of the round */
+    char name[SIGAR_PATH_MAX+1];
+#ifdef WIN32
+    HANDLE mapping;
+#endif
+};
+
+static void shm_layout_set(sigar_uint64_t *layout)
+{
+    layout[SHM_LAYOUT_ROUND] = sizeof(shm_round_t);
+    layout[SHM_LAYOUT_CPU]   = sizeof(sigar_cpu_t);
+    layout[SHM_LAYOUT_MEM]   = sizeof(sigar_mem_t);
+    layout[SHM_LAYOUT_SWAP]  = sizeof(sigar_swap_t);
+    layout[SHM_LAYOUT_NETIF] = sizeof(sigar_net_interface_stat_entry_t);
+    layout[SHM_LAYOUT_DISK]  = sizeof(sigar_disk_usage_entry_t);
+    layout[SHM_LAYOUT_PROC]  = sizeof(sigar_proc_snapshot_entry_t);
+    layout[SHM_LAYOUT_PERF]  = sizeof(sigar_proc_perf_entry_t);
+}
+
+/* posix wants a leading slash, windows object names must not have one */
+static void shm_name_set(sigar_shm_t *shm, const char *name)
+{
+#ifdef WIN32
+    if (*name == '/') {
+        name++;
+    }
+    SIGAR_SSTRCPY(shm->name, name);
+#else
+    snprintf(shm->name, sizeof(shm->name), "%s%s",
+             (*name == '/') ? "" : "/", name);
+#endif
+}
+
+#ifdef SHM_UNSUPPORTED
+
+int sigar_shm_create(sigar_shm_t **shm, const char *name,
+                     sigar_uint64_t size)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+int sigar_shm_publish(sigar_shm_t *shm, sigar_sampler_snapshot_t *snapshot)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+SIGAR_DECLARE(int) sigar_shm_attach(sigar_shm_t **shm, const char *name)
+{
+    return SIGAR_ENOTIMPL;
+}
+
+#else
+
+static int shm_map(sigar_shm_t *shm, int writer)
+{
+#ifdef WIN32
+    LARGE_INTEGER size;
+
+    if (writer) {
+        size.QuadPart = shm->size;
+        shm->mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL,
+                                          PAGE_READWRITE,
+                                          size.HighPart, size.LowPart,
+                                          shm->name);
+    }
+    else {
+        shm->mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, shm->name);
+    }
+    if (!shm->mapping) {
+        return GetLastError();
+    }
+
+    shm->header =
+        MapViewOfFile(shm->mapping,
+                      writer ? FILE_MAP_WRITE : FILE_MAP_READ,
+                      0, 0, 0);
+    if (!shm->header) {
+        int status = GetLastError();
+        CloseHandle(shm->mapping);
+        return status;
+    }
+
+    if (!writer) {
+        MEMORY_BASIC_INFORMATION info;
+
+        VirtualQuery(shm->header, &info, sizeof(info));
+        shm->size = info.RegionSize;
+    }
+#else
+    int fd, status;
+    void *addr;
+
+    if (writer) {
+        fd = shm_open(shm->name, O_RDWR|O_CREAT|O_TRUNC, 0644);
+    }
+    else {
+        fd = shm_open(shm->name, O_RDONLY, 0);
+    }
+    if (fd < 0) {
+        return errno;
+    }
+
+    if (writer) {
+        if (ftruncate(fd, (off_t)shm->size) != 0) {
+            status = errno;
+            close(fd);
+            shm_unlink(shm->name);
+            return status;
+        }
+    }
+    else {
+        struct stat sb;
+
+        if (fstat(fd, &sb) != 0) {
+            status = errno;
+            close(fd);
+            return status;
+        }
+        shm->size = sb.st_size;
+    }
+
+    if (shm->size < SHM_DATA_OFFSET) {
+        close(fd);
+        return EINVAL;
+    }
+
+    addr = mmap(NULL, shm->size,
+                writer ? (PROT_READ|PROT_WRITE) : PROT_READ,
+                MAP_SHARED, fd, 0);
+    status = errno;
+    close(fd); /* the mapping holds its own reference */
+
+    if (addr == MAP_FAILED) {
+        if (writer) {
+            shm_unlink(shm->name);
+        }
+        return status;
+    }
+
+    shm->header = addr;
+#endif
+
+    return SIGAR_OK;
+}
+
+int sigar_shm_create(sigar_shm_t **shm, const char *name,
+                     sigar_uint64_t size)
+{
+    sigar_shm_t *s;
+    shm_header_t *header;
+    int status;
+
+    if (!(s = calloc(1, sizeof(*s)))) {
+        return ENOMEM;
+    }
+
+    shm_name_set(s, name);
+    s->writer = 1;
+    s->size = SHM_ALIGN(size ? size : SIGAR_SHM_SIZE_DEFAULT);
+
+    if ((status = shm_map(s, 1)) != SIGAR_OK) {
+        free(s);
+        return status;
+    }
+
+    header = s->header;
+    memset(header, 0, SHM_DATA_OFFSET);
+    header->version = SHM_VERSION;
+    header->size = s->size;
+    shm_layout_set(header->layout);
+    SHM_FENCE();
+    /* last, readers that see it also see the rest of the header */
+    header->magic = SHM_MAGIC;
+
+    *shm = s;
+
+    return SIGAR_OK;
+}
+
+/* the round with whatever sections fit, flags says which made it */
+static sigar_uint64_t shm_round_write(shm_header_t *header,
+                                      sigar_sampler_snapshot_t *snapshot)
+{
+    char *data = (char *)header + SHM_DATA_OFFSET;
+    sigar_uint64_t room = header->size - SHM_DATA_OFFSET;
+    sigar_uint64_t used = SHM_ALIGN(sizeof(shm_round_t));
+    shm_round_t *round = (shm_round_t *)data;
+    sigar_uint64_t bytes;
+
+    round->generation = snapshot->generation;
+    round->timestamp  = snapshot->timestamp;
+    round->flags      = snapshot->flags &
+        ~(SIGAR_SAMPLER_INTERRUPTS | SIGAR_SAMPLER_SOFTIRQS);
+    round->ncpu = round->nnetif = round->ndisk = round->nproc = 0;
+    round->nperf = 0;
+    round->cpu  = snapshot->cpu;
+    round->mem  = snapshot->mem;
+    round->swap = snapshot->swap;
+
+#define SHM_SECTION(flag, list, count) \
+    if (round->flags & flag) { \
+        bytes = SHM_ALIGN(sizeof(*snapshot->list.data) * \
+                          snapshot->list.number); \
+        if (used + bytes <= room) { \
+            memcpy(data + used, snapshot->list.data, \
+                   sizeof(*snapshot->list.data) * snapshot->list.number); \
+            round->count = snapshot->list.number; \
+            used += bytes; \
+        } \
+        else { \
+            round->flags &= ~flag; /* no room */ \
+        } \
+    }
+
+    SHM_SECTION(SIGAR_SAMPLER_CPU_LIST, cpulist, ncpu);
+    SHM_SECTION(SIGAR_SAMPLER_NETIF, iflist, nnetif);
+    SHM_SECTION(SIGAR_SAMPLER_DISK, disklist, ndisk);
+    SHM_SECTION(SIGAR_SAMPLER_PROC, procs, nproc);
+    SHM_SECTION(SIGAR_SAMPLER_PERF, perfs, nperf);
+
+#undef SHM_SECTION
+
+    return used;
+}
+
+int sigar_shm_publish(sigar_shm_t *shm, sigar_sampler_snapshot_t *snapshot)
+{
+    shm_header_t *header = shm->header;
+
+    if (header->size - SHM_DATA_OFFSET < sizeof(shm_round_t)) {
+        return ENOSPC;
+    }
+
+    header->seq++;
+    SHM_FENCE();
+
+    header->used = shm_round_write(header, snapshot);
+
+    SHM_FENCE();
+    header->seq++;
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int) sigar_shm_attach(sigar_shm_t **shm, const char *name)
+{
+    sigar_shm_t *s;
+    sigar_uint64_t layout[SHM_LAYOUT_MAX];
+    int status;
+
+    if (!(s = calloc(1, sizeof(*s)))) {
+        return ENOMEM;
+    }
+
+    shm_name_set(s, name);
+
+    if ((status = shm_map(s, 0)) != SIGAR_OK) {
+        free(s);
+        return status;
+    }
+
+    shm_layout_set(layout);
+
+    if (s->header->magic != SHM_MAGIC) {
+        /* still being set up */
+        status = EAGAIN;
+    }
+    else if ((s->header->version != SHM_VERSION) ||
+             (memcmp(s->header->layout, layout, sizeof(layout)) != 0) ||
+             (s->header->size > s->size))
+    {
+        status = EINVAL;
+    }
+    else if (!(s->copy = malloc(s->size - SHM_DATA_OFFSET))) {
+        status = ENOMEM;
+    }
+
+    if (status != SIGAR_OK) {
+        sigar_shm_detach(s);
+        return status;
+    }
+
+    *shm = s;
+
+    return SIGAR_OK;
+}
+
+#endif /* SHM_UNSUPPORTED */
+
+void sigar_shm_destroy(sigar_shm_t *shm)
+{
+    int writer = shm->writer;
+    char name[sizeof(shm->name)];
+
+    SIGAR_SSTRCPY(name, shm->name);
+    sigar_shm_detach(shm);
+
+#ifndef WIN32
+    /* windows drops the segment with its last handle */
+    if (writer) {
+        shm_unlink(name);
+    }
+#else
+    (void)writer;
+#endif
+}
+
+SIGAR_DECLARE(int) sigar_shm_detach(sigar_shm_t *shm)
+{
+    if (shm->header) {
+#ifdef WIN32
+        UnmapViewOfFile(shm->header);
+        CloseHandle(shm->mapping);
+#else
+        munmap((void *)shm->header, shm->size);
+#endif
+    }
+    if (shm->copy) {
+        free(shm->copy);
+    }
+    free(shm);
+
+    return SIGAR_OK;
+}
+
+#define SHM_LIST_COPY(list, count, from) \
+    (list).number = (list).size = (unsigned long)(count); \
+    if ((count) == 0) { \
+        (list).data = NULL; \
+    } \
+    else if (((list).data = malloc(sizeof(*(list).data) * (count)))) { \
+        memcpy((list).data, from, sizeof(*(list).data) * (count)); \
+        from += SHM_ALIGN(sizeof(*(list).data) * (count)); \
+    } \
+    else { \
+        (list).number = (list).size = 0; \
+        status = ENOMEM; \
+    }
+
+SIGAR_DECLARE(int) sigar_shm_snapshot_get(sigar_shm_t *shm,
+                                          sigar_sampler_snapshot_t *snapshot)
+{
+#ifdef SHM_UNSUPPORTED
+    return SIGAR_ENOTIMPL;
+#else
+    shm_header_t *header = shm->header;
+    sigar_uint64_t room = shm->size - SHM_DATA_OFFSET;
+    sigar_uint64_t used = 0, need;
+    shm_round_t *round = (shm_round_t *)shm->copy;
+    char *ptr;
+    int tries, status = SIGAR_OK;
+
+    for (tries=0; ; tries++) {
+        sigar_uint32_t seq;
+
+        if (tries == SHM_RETRIES) {
+            return EAGAIN;
+        }
+
+        seq = header->seq;
+        if (seq == 0) {
+            return ENOENT; /* nothing published yet */
+        }
+        if (seq & 1) {
+            SHM_YIELD();
+            continue;
+        }
+        SHM_FENCE();
+
+        used = header->used;
+        if ((used >= sizeof(shm_round_t)) && (used <= room)) {
+            memcpy(shm->copy, (char *)header + SHM_DATA_OFFSET, used);
+        }
+
+        SHM_FENCE();
+        if ((header->seq == seq) && (used >= sizeof(shm_round_t)) &&
+            (used <= room))
+        {
+            break;
+        }
+    }
+
+    /* the copy is consistent, but do not trust its counts with memory */
+    need = SHM_ALIGN(sizeof(shm_round_t)) +
+        SHM_ALIGN(sizeof(sigar_cpu_t) * round->ncpu) +
+        SHM_ALIGN(sizeof(sigar_net_interface_stat_entry_t) * round->nnetif) +
+        SHM_ALIGN(sizeof(sigar_disk_usage_entry_t) * round->ndisk) +
+        SHM_ALIGN(sizeof(sigar_proc_snapshot_entry_t) * round->nproc) +
+        SHM_ALIGN(sizeof(sigar_proc_perf_entry_t) * round->nperf);
+    if (need > used) {
+        return EINVAL;
+    }
+
+    SIGAR_ZERO(snapshot);
+    snapshot->generation = round->generation;
+    snapshot->timestamp  = round->timestamp;
+    snapshot->flags      = (int)round->flags;
+    snapshot->cpu  = round->cpu;
+    snapshot->mem  = round->mem;
+    snapshot->swap = round->swap;
+
+    ptr = shm->copy + SHM_ALIGN(sizeof(shm_round_t));
+    SHM_LIST_COPY(snapshot->cpulist, round->ncpu, ptr);
+    SHM_LIST_COPY(snapshot->iflist, round->nnetif, ptr);
+    SHM_LIST_COPY(snapshot->disklist, round->ndisk, ptr);
+    SHM_LIST_COPY(snapshot->procs, round->nproc, ptr);
+    SHM_LIST_COPY(snapshot->perfs, round->nperf, ptr);
+
+    if (status != SIGAR_OK) {
+        sigar_shm_snapshot_destroy(shm, snapshot);
+    }
+
+    return status;
+#endif
+}
+
+SIGAR_DECLARE(int)
+sigar_shm_snapshot_destroy(sigar_shm_t *shm,
+                           sigar_sampler_snapshot_t *snapshot)
+{
+    if (snapshot->cpulist.data) {
+        free(snapshot->cpulist.data);
+    }
+    if (snapshot->iflist.data) {
+        free(snapshot->iflist.data);
+    }
+    if (snapshot->disklist.data) {
+        free(snapshot->disklist.data);
+    }
+    if (snapshot->procs.data) {
+        free(snapshot->procs.data);
+    }
+    if (snapshot->perfs.data) {
+        free(snapshot->perfs.data);
+    }
+    SIGAR_ZERO(snapshot);
+
+    return SIGAR_OK;
+}
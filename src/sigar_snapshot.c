@@ -0,0 +1,1196 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * file layout, integers in the fixed parts are little endian:
+ *
+ *   "SGSN" version
+ *   frame*       "SGFR" body length, timestamp, body
+ *   index        offset and timestamp of every frame
+ *   trailer      index offset, frame count, "SGIX" version
+ *
+ * a body is the section flags then, per section, the row count and
+ * its columns.  integer columns hold the zigzag varint of the delta
+ * from the row before, doubles the varint of the xor of their bits
+ * with the row before and strings their length and bytes.  a pid or
+ * counter that moves little between rows costs a byte or two.
+ */
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifndef WIN32
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "sigar.h"
+#include "sigar_snapshot.h"
+#include "sigar_private.h"
+#include "sigar_util.h"
+#include "sigar_os.h"
+
+#define SNAPSHOT_MAGIC   0x4e534753 /* "SGSN" */
+#define SNAPSHOT_FRAME   0x52464753 /* "SGFR" */
+#define SNAPSHOT_INDEX   0x58494753 /* "SGIX" */
+#define SNAPSHOT_VERSION 3
+
+#define SNAPSHOT_HEADER_LEN  8
+#define SNAPSHOT_FRAME_LEN   16
+#define SNAPSHOT_INDEX_LEN   16
+#define SNAPSHOT_TRAILER_LEN 24
+
+enum {
+    COL_UINT,
+    COL_SINT,
+    COL_DOUBLE,
+    COL_STRING
+};
+
+typedef struct {
+    size_t offset;
+    size_t size;
+    int kind;
+} snapshot_column_t;
+
+#define COLUMN(type, field, kind) \
+    { offsetof(type, field), sizeof(((type *)0)->field), kind }
+
+#define PROC_COLUMN(field, kind) \
+    COLUMN(sigar_proc_snapshot_entry_t, field, kind)
+
+static const snapshot_column_t proc_columns[] = {
+    PROC_COLUMN(pid, COL_SINT),
+    PROC_COLUMN(flags, COL_SINT),
+    PROC_COLUMN(state.name, COL_STRING),
+    PROC_COLUMN(state.state, COL_UINT),
+    PROC_COLUMN(state.ppid, COL_SINT),
+    PROC_COLUMN(state.tty, COL_SINT),
+    PROC_COLUMN(state.priority, COL_SINT),
+    PROC_COLUMN(state.nice, COL_SINT),
+    PROC_COLUMN(state.processor, COL_SINT),
+    PROC_COLUMN(state.threads, COL_UINT),
+    PROC_COLUMN(mem.size, COL_UINT),
+    PROC_COLUMN(mem.resident, COL_UINT),
+    PROC_COLUMN(mem.share, COL_UINT),
+    PROC_COLUMN(mem.minor_faults, COL_UINT),
+    PROC_COLUMN(mem.major_faults, COL_UINT),
+    PROC_COLUMN(mem.page_faults, COL_UINT),
+    PROC_COLUMN(cpu.start_time, COL_UINT),
+    PROC_COLUMN(cpu.user, COL_UINT),
+    PROC_COLUMN(cpu.sys, COL_UINT),
+    PROC_COLUMN(cpu.total, COL_UINT),
+    PROC_COLUMN(cpu.last_time, COL_UINT),
+    PROC_COLUMN(cpu.percent, COL_DOUBLE),
+    PROC_COLUMN(cgroup, COL_UINT),
+    PROC_COLUMN(mem_ext.rss, COL_UINT),
+    PROC_COLUMN(mem_ext.pss, COL_UINT),
+    PROC_COLUMN(mem_ext.uss, COL_UINT),
+    PROC_COLUMN(mem_ext.shared, COL_UINT),
+    PROC_COLUMN(mem_ext.anon, COL_UINT),
+    PROC_COLUMN(mem_ext.file, COL_UINT),
+    PROC_COLUMN(mem_ext.swap, COL_UINT),
+    PROC_COLUMN(mem_ext.swap_pss, COL_UINT),
+    PROC_COLUMN(net_io.bytes_sent, COL_UINT),
+    PROC_COLUMN(net_io.bytes_received, COL_UINT),
+    PROC_COLUMN(net_io.bytes_total, COL_UINT),
+    PROC_COLUMN(net_io.sockets, COL_UINT),
+    PROC_COLUMN(disk_io.bytes_read, COL_UINT),
+    PROC_COLUMN(disk_io.bytes_written, COL_UINT),
+    PROC_COLUMN(disk_io.bytes_total, COL_UINT),
+    PROC_COLUMN(sched.run_time, COL_UINT),
+    PROC_COLUMN(sched.wait_time, COL_UINT),
+    PROC_COLUMN(sched.timeslices, COL_UINT)
+};
+
+#define CONN_COLUMN(field, kind) \
+    COLUMN(sigar_net_connection_t, field, kind)
+
+static const snapshot_column_t conn_columns[] = {
+    CONN_COLUMN(local_port, COL_UINT),
+    CONN_COLUMN(local_address.family, COL_UINT),
+    CONN_COLUMN(local_address.addr.in6[0], COL_UINT),
+    CONN_COLUMN(local_address.addr.in6[1], COL_UINT),
+    CONN_COLUMN(local_address.addr.in6[2], COL_UINT),
+    CONN_COLUMN(local_address.addr.in6[3], COL_UINT),
+    CONN_COLUMN(remote_port, COL_UINT),
+    CONN_COLUMN(remote_address.family, COL_UINT),
+    CONN_COLUMN(remote_address.addr.in6[0], COL_UINT),
+    CONN_COLUMN(remote_address.addr.in6[1], COL_UINT),
+    CONN_COLUMN(remote_address.addr.in6[2], COL_UINT),
+    CONN_COLUMN(remote_address.addr.in6[3], COL_UINT),
+    CONN_COLUMN(uid, COL_UINT),
+    CONN_COLUMN(inode, COL_UINT),
+    CONN_COLUMN(type, COL_SINT),
+    CONN_COLUMN(state, COL_SINT),
+    CONN_COLUMN(send_queue, COL_UINT),
+    CONN_COLUMN(receive_queue, COL_UINT)
+};
+
+#define DISK_COLUMN(field, kind) \
+    COLUMN(sigar_disk_usage_entry_t, field, kind)
+
+static const snapshot_column_t disk_columns[] = {
+    DISK_COLUMN(name, COL_STRING),
+    DISK_COLUMN(major, COL_UINT),
+    DISK_COLUMN(minor, COL_UINT),
+    DISK_COLUMN(disk.reads, COL_UINT),
+    DISK_COLUMN(disk.writes, COL_UINT),
+    DISK_COLUMN(disk.write_bytes, COL_UINT),
+    DISK_COLUMN(disk.read_bytes, COL_UINT),
+    DISK_COLUMN(disk.rtime, COL_UINT),
+    DISK_COLUMN(disk.wtime, COL_UINT),
+    DISK_COLUMN(disk.qtime, COL_UINT),
+    DISK_COLUMN(disk.time, COL_UINT),
+    DISK_COLUMN(disk.snaptime, COL_UINT),
+    DISK_COLUMN(disk.service_time, COL_DOUBLE),
+    DISK_COLUMN(disk.queue, COL_DOUBLE)
+};
+
+#define NCOLUMNS(columns) (sizeof(columns) / sizeof(*(columns)))
+
+typedef struct {
+    unsigned char *data;
+    size_t len;
+    size_t size;
+    int status;
+} snapshot_buf_t;
+
+typedef struct {
+    const unsigned char *ptr;
+    const unsigned char *end;
+    int status;
+} snapshot_cursor_t;
+
+struct sigar_snapshot_writer_t {
+    FILE *fp;
+    sigar_uint64_t offset;
+    snapshot_buf_t buf;
+    snapshot_buf_t index;
+    unsigned long number;
+};
+
+struct sigar_snapshot_reader_t {
+    const unsigned char *map;
+    sigar_uint64_t size;
+    unsigned long number;
+    sigar_uint64_t *offsets;
+    sigar_int64_t *timestamps;
+#ifdef WIN32
+    HANDLE file;
+    HANDLE mapping;
+#endif
+};
+
+struct sigar_replay_t {
+    sigar_snapshot_t frame;
+};
+
+static void buf_reserve(snapshot_buf_t *buf, size_t len)
+{
+    unsigned char *data;
+    size_t size;
+
+    if ((buf->status != SIGAR_OK) || (buf->len + len <= buf->size)) {
+        return;
+    }
+
+    size = buf->size ? buf->size : 4096;
+    while (size < buf->len + len) {
+        size *= 2;
+    }
+
+    if (!(data = realloc(buf->data, size))) {
+        buf->status = ENOMEM;
+        return;
+    }
+
+    buf->data = data;
+    buf->size = size;
+}
+
+static void buf_put(snapshot_buf_t *buf, const void *ptr, size_t len)
+{
+    buf_reserve(buf, len);
+    if (buf->status == SIGAR_OK) {
+        memcpy(buf->data + buf->len, ptr, len);
+        buf->len += len;
+    }
+}
+
+static void buf_varint(snapshot_buf_t *buf, sigar_uint64_t val)
+{
+    unsigned char bytes[10];
+    size_t len = 0;
+
+    while (val >= 0x80) {
+        bytes[len++] = (unsigned char)(val | 0x80);
+        val >>= 7;
+    }
+    bytes[len++] = (unsigned char)val;
+
+    buf_put(buf, bytes, len);
+}
+
+static void le_set(unsigned char *ptr, sigar_uint64_t val, int len)
+{
+    int i;
+
+    for (i=0; i<len; i++) {
+        ptr[i] = (unsigned char)(val >> (i * 8));
+    }
+}
+
+static sigar_uint64_t le_get(const unsigned char *ptr, int len)
+{
+    sigar_uint64_t val = 0;
+    int i;
+
+    for (i=len-1; i>=0; i--) {
+        val = (val << 8) | ptr[i];
+    }
+
+    return val;
+}
+
+static void buf_le(snapshot_buf_t *buf, sigar_uint64_t val, int len)
+{
+    unsigned char bytes[8];
+
+    le_set(bytes, val, len);
+    buf_put(buf, bytes, len);
+}
+
+static sigar_uint64_t cursor_varint(snapshot_cursor_t *cursor)
+{
+    sigar_uint64_t val = 0;
+    int shift = 0;
+
+    while (cursor->ptr < cursor->end) {
+        unsigned char byte = *cursor->ptr++;
+
+        val |= (sigar_uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return val;
+        }
+        if ((shift += 7) > 63) {
+            break;
+        }
+    }
+
+    cursor->status = EINVAL;
+    return 0;
+}
+
+static sigar_uint64_t zigzag(sigar_uint64_t val)
+{
+    return (val << 1) ^ (sigar_uint64_t)((sigar_int64_t)val >> 63);
+}
+
+static sigar_uint64_t unzigzag(sigar_uint64_t val)
+{
+    return (val >> 1) ^ (0 - (val & 1));
+}
+
+/* fields of any width widened to 64 bits and back */
+static sigar_uint64_t field_get(const char *field, size_t size, int is_signed)
+{
+    switch (size) {
+      case 1: {
+          unsigned char val;
+          memcpy(&val, field, 1);
+          return is_signed ? (sigar_uint64_t)(signed char)val : val;
+      }
+      case 2: {
+          unsigned short val;
+          memcpy(&val, field, 2);
+          return is_signed ? (sigar_uint64_t)(short)val : val;
+      }
+      case 4: {
+          sigar_uint32_t val;
+          memcpy(&val, field, 4);
+          return is_signed ?
+              (sigar_uint64_t)(sigar_int64_t)(int)val : val;
+      }
+      default: {
+          sigar_uint64_t val;
+          memcpy(&val, field, 8);
+          return val;
+      }
+    }
+}
+
+static void field_set(char *field, size_t size, sigar_uint64_t val)
+{
+    switch (size) {
+      case 1: {
+          unsigned char v = (unsigned char)val;
+          memcpy(field, &v, 1);
+          break;
+      }
+      case 2: {
+          unsigned short v = (unsigned short)val;
+          memcpy(field, &v, 2);
+          break;
+      }
+      case 4: {
+          sigar_uint32_t v = (sigar_uint32_t)val;
+          memcpy(field, &v, 4);
+          break;
+      }
+      default:
+        memcpy(field, &val, 8);
+        break;
+    }
+}
+
+static void columns_encode(snapshot_buf_t *buf,
+                           const snapshot_column_t *columns,
+                           size_t ncolumns,
+                           const void *rows, size_t rowsize,
+                           unsigned long number)
+{
+    size_t i;
+    unsigned long j;
+
+    buf_varint(buf, number);
+
+    for (i=0; i<ncolumns; i++) {
+        const snapshot_column_t *column = &columns[i];
+        sigar_uint64_t prev = 0;
+
+        for (j=0; j<number; j++) {
+            const char *field =
+                (const char *)rows + (j * rowsize) + column->offset;
+            sigar_uint64_t val;
+
+            switch (column->kind) {
+              case COL_STRING: {
+                  const char *nul = memchr(field, '\0', column->size);
+                  size_t len = nul ? (size_t)(nul - field) : column->size - 1;
+
+                  buf_varint(buf, len);
+                  buf_put(buf, field, len);
+                  break;
+              }
+              case COL_DOUBLE:
+                memcpy(&val, field, sizeof(val));
+                buf_varint(buf, val ^ prev);
+                prev = val;
+                break;
+              default:
+                val = field_get(field, column->size,
+                                column->kind == COL_SINT);
+                buf_varint(buf, zigzag(val - prev));
+                prev = val;
+                break;
+            }
+        }
+    }
+}
+
+/* rows come back zeroed, so padding is as predictable as the fields */
+static void *columns_decode(snapshot_cursor_t *cursor,
+                            const snapshot_column_t *columns,
+                            size_t ncolumns,
+                            size_t rowsize,
+                            unsigned long *number)
+{
+    sigar_uint64_t rows = cursor_varint(cursor);
+    char *data;
+    size_t i;
+    unsigned long j;
+
+    *number = 0;
+
+    /* every row takes at least a byte per column */
+    if ((cursor->status != SIGAR_OK) ||
+        (rows > (sigar_uint64_t)(cursor->end - cursor->ptr)))
+    {
+        cursor->status = EINVAL;
+        return NULL;
+    }
+    if (rows == 0) {
+        return NULL;
+    }
+
+    if (!(data = calloc((size_t)rows, rowsize))) {
+        cursor->status = ENOMEM;
+        return NULL;
+    }
+
+    for (i=0; i<ncolumns; i++) {
+        const snapshot_column_t *column = &columns[i];
+        sigar_uint64_t prev = 0;
+
+        for (j=0; (j<rows) && (cursor->status == SIGAR_OK); j++) {
+            char *field = data + (j * rowsize) + column->offset;
+            sigar_uint64_t val = cursor_varint(cursor);
+
+            switch (column->kind) {
+              case COL_STRING:
+                if ((val >= column->size) ||
+                    (val > (sigar_uint64_t)(cursor->end - cursor->ptr)))
+                {
+                    cursor->status = EINVAL;
+                    break;
+                }
+                memcpy(field, cursor->ptr, (size_t)val);
+                cursor->ptr += val;
+                break;
+              case COL_DOUBLE:
+                prev ^= val;
+                memcpy(field, &prev, sizeof(prev));
+                break;
+              default:
+                prev += unzigzag(val);
+                field_set(field, column->size, prev);
+                break;
+            }
+        }
+    }
+
+    if (cursor->status != SIGAR_OK) {
+        free(data);
+        return NULL;
+    }
+
+    *number = (unsigned long)rows;
+
+    return data;
+}
+
+#define LIST_DECODE(cursor, columns, list) \
+    (list).data = columns_decode(cursor, columns, NCOLUMNS(columns), \
+                                 sizeof(*(list).data), &(list).number); \
+    (list).size = (list).number
+
+static void frame_encode(snapshot_buf_t *buf, sigar_snapshot_t *snapshot)
+{
+    int flags = snapshot->flags & SIGAR_SNAPSHOT_ALL;
+
+    buf_varint(buf, flags);
+
+    if (flags & SIGAR_SNAPSHOT_PROC) {
+        columns_encode(buf, proc_columns, NCOLUMNS(proc_columns),
+                       snapshot->procs.data, sizeof(*snapshot->procs.data),
+                       snapshot->procs.number);
+    }
+    if (flags & SIGAR_SNAPSHOT_NET) {
+        columns_encode(buf, conn_columns, NCOLUMNS(conn_columns),
+                       snapshot->connections.data,
+                       sizeof(*snapshot->connections.data),
+                       snapshot->connections.number);
+    }
+    if (flags & SIGAR_SNAPSHOT_DISK) {
+        columns_encode(buf, disk_columns, NCOLUMNS(disk_columns),
+                       snapshot->disks.data, sizeof(*snapshot->disks.data),
+                       snapshot->disks.number);
+    }
+}
+
+static int frame_decode(const unsigned char *body, sigar_uint64_t len,
+                        sigar_snapshot_t *snapshot)
+{
+    snapshot_cursor_t cursor;
+
+    cursor.ptr = body;
+    cursor.end = body + len;
+    cursor.status = SIGAR_OK;
+
+    snapshot->flags = (int)cursor_varint(&cursor) & SIGAR_SNAPSHOT_ALL;
+
+    if ((cursor.status == SIGAR_OK) &&
+        (snapshot->flags & SIGAR_SNAPSHOT_PROC))
+    {
+        LIST_DECODE(&cursor, proc_columns, snapshot->procs);
+    }
+    if ((cursor.status == SIGAR_OK) &&
+        (snapshot->flags & SIGAR_SNAPSHOT_NET))
+    {
+        LIST_DECODE(&cursor, conn_columns, snapshot->connections);
+    }
+    if ((cursor.status == SIGAR_OK) &&
+        (snapshot->flags & SIGAR_SNAPSHOT_DISK))
+    {
+        LIST_DECODE(&cursor, disk_columns, snapshot->disks);
+    }
+
+    if (cursor.status != SIGAR_OK) {
+        sigar_snapshot_destroy(NULL, snapshot);
+    }
+
+    return cursor.status;
+}
+
+SIGAR_DECLARE(int) sigar_snapshot_get(sigar_t *sigar, int flags,
+                                      sigar_snapshot_t *snapshot)
+{
+    int status;
+
+    SIGAR_ZERO(snapshot);
+    snapshot->timestamp = sigar_time_now_millis();
+
+    if (flags & SIGAR_SNAPSHOT_PROC) {
+        status = sigar_proc_snapshot_get(sigar, SIGAR_PROC_SNAPSHOT_ALL,
+                                         &snapshot->procs);
+        if (status == SIGAR_OK) {
+            snapshot->flags |= SIGAR_SNAPSHOT_PROC;
+        }
+        else if (status != SIGAR_ENOTIMPL) {
+            return status;
+        }
+    }
+
+    if (flags & SIGAR_SNAPSHOT_NET) {
+        status = sigar_net_connection_list_get(sigar, &snapshot->connections,
+                                               SIGAR_NETCONN_CLIENT |
+                                               SIGAR_NETCONN_SERVER |
+                                               SIGAR_NETCONN_TCP |
+                                               SIGAR_NETCONN_UDP);
+        if (status == SIGAR_OK) {
+            snapshot->flags |= SIGAR_SNAPSHOT_NET;
+        }
+        else if (status != SIGAR_ENOTIMPL) {
+            sigar_snapshot_destroy(sigar, snapshot);
+            return status;
+        }
+    }
+
+    if (flags & SIGAR_SNAPSHOT_DISK) {
+        status = sigar_disk_usage_list_get(sigar, &snapshot->disks);
+        if (status == SIGAR_OK) {
+            snapshot->flags |= SIGAR_SNAPSHOT_DISK;
+        }
+        else if (status != SIGAR_ENOTIMPL) {
+            sigar_snapshot_destroy(sigar, snapshot);
+            return status;
+        }
+    }
+
+    return SIGAR_OK;
+}
+
+/* does not need the sigar, snapshots from a reader have none */
+SIGAR_DECLARE(int) sigar_snapshot_destroy(sigar_t *sigar,
+                                          sigar_snapshot_t *snapshot)
+{
+    if (snapshot->procs.size) {
+        free(snapshot->procs.data);
+    }
+    if (snapshot->connections.size) {
+        free(snapshot->connections.data);
+    }
+    if (snapshot->disks.size) {
+        free(snapshot->disks.data);
+    }
+    SIGAR_ZERO(snapshot);
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int)
+sigar_snapshot_writer_open(sigar_snapshot_writer_t **writer,
+                           const char *path)
+{
+    sigar_snapshot_writer_t *w;
+    unsigned char header[SNAPSHOT_HEADER_LEN];
+
+    if (!(w = calloc(1, sizeof(*w)))) {
+        return ENOMEM;
+    }
+
+    if (!(w->fp = fopen(path, "wb"))) {
+        int status = errno;
+        free(w);
+        return status;
+    }
+
+    le_set(header, SNAPSHOT_MAGIC, 4);
+    le_set(header + 4, SNAPSHOT_VERSION, 4);
+
+    if (fwrite(header, sizeof(header), 1, w->fp) != 1) {
+        int status = errno;
+        fclose(w->fp);
+        free(w);
+        return status;
+    }
+
+    w->offset = sizeof(header);
+    *writer = w;
+
+    return SIGAR_OK;
+}
+
+/* a whole frame, header and body, from the start of buf */
+static int frame_put(snapshot_buf_t *buf, sigar_snapshot_t *snapshot)
+{
+    buf->len = 0;
+    buf->status = SIGAR_OK;
+
+    /* the length is filled in below, once the body is known */
+    buf_le(buf, SNAPSHOT_FRAME, 4);
+    buf_le(buf, 0, 4);
+    buf_le(buf, (sigar_uint64_t)snapshot->timestamp, 8);
+    frame_encode(buf, snapshot);
+
+    if (buf->status != SIGAR_OK) {
+        return buf->status;
+    }
+    if (buf->len - SNAPSHOT_FRAME_LEN > 0xffffffff) {
+        return E2BIG;
+    }
+    le_set(buf->data + 4, buf->len - SNAPSHOT_FRAME_LEN, 4);
+
+    return SIGAR_OK;
+}
+
+/* frame points at len bytes, of which the frame may use fewer */
+static int frame_get(const unsigned char *frame, sigar_uint64_t len,
+                     sigar_snapshot_t *snapshot)
+{
+    sigar_uint64_t body;
+
+    if (len < SNAPSHOT_FRAME_LEN) {
+        return EINVAL;
+    }
+
+    body = le_get(frame + 4, 4);
+
+    if ((le_get(frame, 4) != SNAPSHOT_FRAME) ||
+        (SNAPSHOT_FRAME_LEN + body > len))
+    {
+        return EINVAL;
+    }
+
+    snapshot->timestamp = (sigar_int64_t)le_get(frame + 8, 8);
+
+    return frame_decode(frame + SNAPSHOT_FRAME_LEN, body, snapshot);
+}
+
+SIGAR_DECLARE(int) sigar_snapshot_encode(sigar_snapshot_t *snapshot,
+                                         unsigned char **data,
+                                         size_t *len)
+{
+    snapshot_buf_t buf;
+    int status;
+
+    memset(&buf, 0, sizeof(buf));
+
+    if ((status = frame_put(&buf, snapshot)) != SIGAR_OK) {
+        if (buf.data) {
+            free(buf.data);
+        }
+        return status;
+    }
+
+    *data = buf.data;
+    *len = buf.len;
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int) sigar_snapshot_decode(const unsigned char *data,
+                                         size_t len,
+                                         sigar_snapshot_t *snapshot)
+{
+    SIGAR_ZERO(snapshot);
+
+    return frame_get(data, len, snapshot);
+}
+
+SIGAR_DECLARE(int) sigar_snapshot_write(sigar_snapshot_writer_t *writer,
+                                        sigar_snapshot_t *snapshot)
+{
+    snapshot_buf_t *buf = &writer->buf;
+    int status;
+
+    if ((status = frame_put(buf, snapshot)) != SIGAR_OK) {
+        return status;
+    }
+
+    buf_le(&writer->index, writer->offset, 8);
+    buf_le(&writer->index, (sigar_uint64_t)snapshot->timestamp, 8);
+    if (writer->index.status != SIGAR_OK) {
+        return writer->index.status;
+    }
+
+    if (fwrite(buf->data, buf->len, 1, writer->fp) != 1) {
+        writer->index.len -= SNAPSHOT_INDEX_LEN;
+        return errno;
+    }
+
+    writer->offset += buf->len;
+    writer->number++;
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int)
+sigar_snapshot_writer_close(sigar_snapshot_writer_t *writer)
+{
+    unsigned char trailer[SNAPSHOT_TRAILER_LEN];
+    int status = SIGAR_OK;
+
+    le_set(trailer, writer->offset, 8);
+    le_set(trailer + 8, writer->number, 8);
+    le_set(trailer + 16, SNAPSHOT_INDEX, 4);
+    le_set(trailer + 20, SNAPSHOT_VERSION, 4);
+
+    if ((writer->index.len &&
+         (fwrite(writer->index.data, writer->index.len, 1,
+                 writer->fp) != 1)) ||
+        (fwrite(trailer, sizeof(trailer), 1, writer->fp) != 1))
+    {
+        status = errno;
+    }
+
+    if ((fclose(writer->fp) != 0) && (status == SIGAR_OK)) {
+        status = errno;
+    }
+
+    if (writer->buf.data) {
+        free(writer->buf.data);
+    }
+    if (writer->index.data) {
+        free(writer->index.data);
+    }
+    free(writer);
+
+    return status;
+}
+
+static int reader_index_alloc(sigar_snapshot_reader_t *reader,
+                              unsigned long number)
+{
+    reader->offsets = malloc(sizeof(*reader->offsets) * (number + 1));
+    reader->timestamps = malloc(sizeof(*reader->timestamps) * (number + 1));
+
+    return (reader->offsets && reader->timestamps) ? SIGAR_OK : ENOMEM;
+}
+
+/* the trailer written by sigar_snapshot_writer_close */
+static int reader_index_load(sigar_snapshot_reader_t *reader)
+{
+    const unsigned char *trailer;
+    sigar_uint64_t offset, number;
+    unsigned long i;
+    int status;
+
+    if (reader->size < SNAPSHOT_HEADER_LEN + SNAPSHOT_TRAILER_LEN) {
+        return ENOENT;
+    }
+
+    trailer = reader->map + reader->size - SNAPSHOT_TRAILER_LEN;
+    offset = le_get(trailer, 8);
+    number = le_get(trailer + 8, 8);
+
+    if ((le_get(trailer + 16, 4) != SNAPSHOT_INDEX) ||
+        (offset < SNAPSHOT_HEADER_LEN) ||
+        (offset > reader->size - SNAPSHOT_TRAILER_LEN) ||
+        (number != (reader->size - SNAPSHOT_TRAILER_LEN - offset) /
+                   SNAPSHOT_INDEX_LEN))
+    {
+        return ENOENT;
+    }
+
+    if ((status = reader_index_alloc(reader, (unsigned long)number)) !=
+        SIGAR_OK)
+    {
+        return status;
+    }
+
+    for (i=0; i<number; i++) {
+        const unsigned char *entry =
+            reader->map + offset + (i * SNAPSHOT_INDEX_LEN);
+
+        reader->offsets[i] = le_get(entry, 8);
+        reader->timestamps[i] = (sigar_int64_t)le_get(entry + 8, 8);
+
+        if (reader->offsets[i] + SNAPSHOT_FRAME_LEN > offset) {
+            return EINVAL;
+        }
+    }
+
+    reader->number = (unsigned long)number;
+
+    return SIGAR_OK;
+}
+
+/* no index, the writer did not get to close, walk the frames instead */
+static int reader_index_scan(sigar_snapshot_reader_t *reader)
+{
+    sigar_uint64_t offset = SNAPSHOT_HEADER_LEN;
+    unsigned long number = 0, size = 0;
+
+    while (offset + SNAPSHOT_FRAME_LEN <= reader->size) {
+        const unsigned char *frame = reader->map + offset;
+        sigar_uint64_t len = le_get(frame + 4, 4);
+
+        if ((le_get(frame, 4) != SNAPSHOT_FRAME) ||
+            (offset + SNAPSHOT_FRAME_LEN + len > reader->size))
+        {
+            break; /* torn last frame */
+        }
+
+        if (number == size) {
+            sigar_uint64_t *offsets;
+            sigar_int64_t *timestamps;
+
+            size = size ? size * 2 : 64;
+            offsets = realloc(reader->offsets, sizeof(*offsets) * size);
+            if (offsets) {
+                reader->offsets = offsets;
+            }
+            timestamps =
+                realloc(reader->timestamps, sizeof(*timestamps) * size);
+            if (timestamps) {
+                reader->timestamps = timestamps;
+            }
+            if (!offsets || !timestamps) {
+                return ENOMEM;
+            }
+        }
+
+        reader->offsets[number] = offset;
+        reader->timestamps[number] = (sigar_int64_t)le_get(frame + 8, 8);
+        number++;
+
+        offset += SNAPSHOT_FRAME_LEN + len;
+    }
+
+    reader->number = number;
+
+    return SIGAR_OK;
+}
+
+static int reader_map(sigar_snapshot_reader_t *reader, const char *path)
+{
+#ifdef WIN32
+    LARGE_INTEGER size;
+
+    reader->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+                               OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (reader->file == INVALID_HANDLE_VALUE) {
+        reader->file = NULL;
+        return GetLastError();
+    }
+    if (!GetFileSizeEx(reader->file, &size)) {
+        return GetLastError();
+    }
+    reader->size = size.QuadPart;
+    if (reader->size < SNAPSHOT_HEADER_LEN) {
+        return EINVAL;
+    }
+
+    reader->mapping = CreateFileMapping(reader->file, NULL, PAGE_READONLY,
+                                        0, 0, NULL);
+    if (!reader->mapping) {
+        return GetLastError();
+    }
+    reader->map = MapViewOfFile(reader->mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!reader->map) {
+        return GetLastError();
+    }
+#else
+    struct stat sb;
+    void *map;
+    int fd, status;
+
+    if ((fd = open(path, O_RDONLY)) < 0) {
+        return errno;
+    }
+    if (fstat(fd, &sb) != 0) {
+        status = errno;
+        close(fd);
+        return status;
+    }
+    if (sb.st_size < SNAPSHOT_HEADER_LEN) {
+        close(fd);
+        return EINVAL;
+    }
+
+    map = mmap(NULL, sb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    status = errno;
+    close(fd);
+    if (map == MAP_FAILED) {
+        return status;
+    }
+
+    reader->map = map;
+    reader->size = sb.st_size;
+#endif
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int)
+sigar_snapshot_reader_open(sigar_snapshot_reader_t **reader,
+                           const char *path)
+{
+    sigar_snapshot_reader_t *r;
+    int status;
+
+    if (!(r = calloc(1, sizeof(*r)))) {
+        return ENOMEM;
+    }
+
+    if ((status = reader_map(r, path)) == SIGAR_OK) {
+        if ((le_get(r->map, 4) != SNAPSHOT_MAGIC) ||
+            (le_get(r->map + 4, 4) != SNAPSHOT_VERSION))
+        {
+            status = EINVAL;
+        }
+        else if ((status = reader_index_load(r)) == ENOENT) {
+            if (r->offsets) {
+                free(r->offsets);
+                r->offsets = NULL;
+            }
+            if (r->timestamps) {
+                free(r->timestamps);
+                r->timestamps = NULL;
+            }
+            status = reader_index_scan(r);
+        }
+    }
+
+    if (status != SIGAR_OK) {
+        sigar_snapshot_reader_close(r);
+        return status;
+    }
+
+    *reader = r;
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int)
+sigar_snapshot_reader_close(sigar_snapshot_reader_t *reader)
+{
+#ifdef WIN32
+    if (reader->map) {
+        UnmapViewOfFile(reader->map);
+    }
+    if (reader->mapping) {
+        CloseHandle(reader->mapping);
+    }
+    if (reader->file) {
+        CloseHandle(reader->file);
+    }
+#else
+    if (reader->map) {
+        munmap((void *)reader->map, reader->size);
+    }
+#endif
+    if (reader->offsets) {
+        free(reader->offsets);
+    }
+    if (reader->timestamps) {
+        free(reader->timestamps);
+    }
+    free(reader);
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(unsigned long)
+sigar_snapshot_count(sigar_snapshot_reader_t *reader)
+{
+    return reader->number;
+}
+
+/* frames are in write order, timestamps are not expected to go back */
+SIGAR_DECLARE(long)
+sigar_snapshot_find(sigar_snapshot_reader_t *reader,
+                    sigar_int64_t timestamp)
+{
+    long lo = 0, hi = (long)reader->number - 1, found = -1;
+
+    while (lo <= hi) {
+        long mid = lo + ((hi - lo) / 2);
+
+        if (reader->timestamps[mid] <= timestamp) {
+            found = mid;
+            lo = mid + 1;
+        }
+        else {
+            hi = mid - 1;
+        }
+    }
+
+    return found;
+}
+
+SIGAR_DECLARE(int) sigar_snapshot_read(sigar_snapshot_reader_t *reader,
+                                       unsigned long index,
+                                       sigar_snapshot_t *snapshot)
+{
+    sigar_uint64_t offset;
+
+    SIGAR_ZERO(snapshot);
+
+    if (index >= reader->number) {
+        return ENOENT;
+    }
+
+    offset = reader->offsets[index];
+    if (offset > reader->size) {
+        return EINVAL;
+    }
+
+    return frame_get(reader->map + offset, reader->size - offset, snapshot);
+}
+
+SIGAR_DECLARE(int) sigar_snapshot_replay_set(sigar_t *sigar,
+                                             sigar_snapshot_reader_t *reader,
+                                             unsigned long index)
+{
+    sigar_replay_t *replay;
+    int status;
+
+    if (!reader) {
+        sigar_replay_free(sigar);
+        return SIGAR_OK;
+    }
+
+    if (!(replay = malloc(sizeof(*replay)))) {
+        return ENOMEM;
+    }
+
+    if ((status = sigar_snapshot_read(reader, index,
+                                      &replay->frame)) != SIGAR_OK)
+    {
+        free(replay);
+        return status;
+    }
+
+    sigar_replay_free(sigar);
+    sigar->replay = replay;
+
+    return SIGAR_OK;
+}
+
+void sigar_replay_free(sigar_t *sigar)
+{
+    if (sigar->replay) {
+        sigar_snapshot_destroy(sigar, &sigar->replay->frame);
+        free(sigar->replay);
+        sigar->replay = NULL;
+    }
+}
+
+int sigar_replay_proc_list_get(sigar_t *sigar, sigar_proc_list_t *proclist)
+{
+    sigar_proc_snapshot_t *procs = &sigar->replay->frame.procs;
+    unsigned long i;
+
+    if (!(sigar->replay->frame.flags & SIGAR_SNAPSHOT_PROC)) {
+        return SIGAR_ENOTIMPL;
+    }
+
+    for (i=0; i<procs->number; i++) {
+        SIGAR_PROC_LIST_GROW(proclist);
+        proclist->data[proclist->number++] = procs->data[i].pid;
+    }
+
+    return SIGAR_OK;
+}
+
+int sigar_replay_proc_snapshot_get(sigar_t *sigar, int flags,
+                                   sigar_proc_snapshot_t *snapshot)
+{
+    sigar_proc_snapshot_t *procs = &sigar->replay->frame.procs;
+    unsigned long i;
+
+    if (!(sigar->replay->frame.flags & SIGAR_SNAPSHOT_PROC)) {
+        return SIGAR_ENOTIMPL;
+    }
+
+    if (flags & SIGAR_PROC_SNAPSHOT_CPU) {
+        flags |= SIGAR_PROC_SNAPSHOT_TIME;
+    }
+
+    sigar_proc_snapshot_create(snapshot);
+
+    for (i=0; i<procs->number; i++) {
+        sigar_proc_snapshot_entry_t *entry;
+
+        SIGAR_PROC_SNAPSHOT_GROW(snapshot);
+        entry = &snapshot->data[snapshot->number++];
+        memcpy(entry, &procs->data[i], sizeof(*entry));
+        /* only what was asked for, as far as it was recorded */
+        entry->flags &= flags;
+    }
+
+    return SIGAR_OK;
+}
+
+int sigar_replay_net_connection_list_get(sigar_t *sigar,
+                                         sigar_net_connection_list_t *connlist,
+                                         int flags)
+{
+    sigar_net_connection_list_t *conns = &sigar->replay->frame.connections;
+    unsigned long i;
+
+    if (!(sigar->replay->frame.flags & SIGAR_SNAPSHOT_NET)) {
+        return SIGAR_ENOTIMPL;
+    }
+
+    SIGAR_LIST_CREATE(sigar, connlist, sigar_net_connection_list_create);
+
+    for (i=0; i<conns->number; i++) {
+        sigar_net_connection_t *conn = &conns->data[i];
+
+        if (!(conn->type & flags)) {
+            continue;
+        }
+        if (!((conn->remote_port && (flags & SIGAR_NETCONN_CLIENT)) ||
+              (!conn->remote_port && (flags & SIGAR_NETCONN_SERVER))))
+        {
+            continue;
+        }
+
+        SIGAR_NET_CONNLIST_GROW(connlist);
+        memcpy(&connlist->data[connlist->number++], conn, sizeof(*conn));
+    }
+
+    return SIGAR_OK;
+}
+
+int sigar_replay_disk_usage_list_get(sigar_t *sigar,
+                                     sigar_disk_usage_list_t *disklist)
+{
+    sigar_disk_usage_list_t *disks = &sigar->replay->frame.disks;
+    unsigned long i;
+
+    if (!(sigar->replay->frame.flags & SIGAR_SNAPSHOT_DISK)) {
+        return SIGAR_ENOTIMPL;
+    }
+
+    sigar_disk_usage_list_create(disklist);
+
+    for (i=0; i<disks->number; i++) {
+        SIGAR_DISK_USAGE_LIST_GROW(disklist);
+        memcpy(&disklist->data[disklist->number++], &disks->data[i],
+               sizeof(*disklist->data));
+    }
+
+    return SIGAR_OK;
+}
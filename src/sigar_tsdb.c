@@ -0,0 +1,569 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * every series of a tier is a column of the same ring, so one round
+ * writes the same index in each of them.  a tier folds step samples
+ * into its open point as they come, min, max and a running sum, and
+ * moves on once the point is full: no pass over history, and all the
+ * memory is taken by sigar_tsdb_create.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef WIN32
+#include <pthread.h>
+#endif
+
+#include "sigar.h"
+#include "sigar_sampler.h"
+#include "sigar_private.h"
+#include "sigar_util.h"
+#include "sigar_os.h"
+
+#ifdef WIN32
+typedef CRITICAL_SECTION tsdb_lock_t;
+#  define TSDB_LOCK_INIT(lock)    InitializeCriticalSection(lock)
+#  define TSDB_LOCK(lock)         EnterCriticalSection(lock)
+#  define TSDB_UNLOCK(lock)       LeaveCriticalSection(lock)
+#  define TSDB_LOCK_DESTROY(lock) DeleteCriticalSection(lock)
+#else
+typedef pthread_mutex_t tsdb_lock_t;
+#  define TSDB_LOCK_INIT(lock)    pthread_mutex_init(lock, NULL)
+#  define TSDB_LOCK(lock)         pthread_mutex_lock(lock)
+#  define TSDB_UNLOCK(lock)       pthread_mutex_unlock(lock)
+#  define TSDB_LOCK_DESTROY(lock) pthread_mutex_destroy(lock)
+#endif
+
+#define TSDB_HOST_SERIES  SIGAR_TSDB_NETIF_RX_BYTES
+#define TSDB_NETIF_SERIES (SIGAR_TSDB_DISK_READS - SIGAR_TSDB_NETIF_RX_BYTES)
+#define TSDB_DISK_SERIES  (SIGAR_TSDB_SERIES_MAX - SIGAR_TSDB_DISK_READS)
+
+/* no sample of the series went into the point, values are never < 0 */
+#define TSDB_NONE -1.0
+
+typedef struct {
+    unsigned long step;
+    unsigned long points;
+    unsigned long head;     /* next point written */
+    unsigned long number;   /* points in the ring */
+    unsigned long samples;  /* folded into the open point so far */
+    sigar_int64_t *timestamp;
+    double *min;            /* [series][points] */
+    double *max;
+    double *avg;
+    /* the open point, one of each per series */
+    double *open_min;
+    double *open_max;
+    double *open_sum;
+    unsigned long *open_count;
+} tsdb_tier_t;
+
+/* counters are kept as rates, against the sample before */
+typedef struct {
+    char name[SIGAR_FS_INFO_LEN];
+    int used;
+    int have_last;
+    sigar_int64_t last_time;
+    sigar_uint64_t last[TSDB_NETIF_SERIES];
+} tsdb_device_t;
+
+struct sigar_tsdb_t {
+    tsdb_lock_t lock;
+    int nseries;
+    int ifaces_max;
+    int disks_max;
+    int ntiers;
+    tsdb_tier_t tiers[SIGAR_TSDB_TIERS_MAX];
+    tsdb_device_t *ifaces;
+    tsdb_device_t *disks;
+    int have_cpu;
+    sigar_cpu_t last_cpu;
+    double *value; /* this round, TSDB_NONE where not sampled */
+};
+
+static const sigar_tsdb_opts_t tsdb_opts_default = {
+    3, {
+        { 1, 300 },   /* 5 minutes of 1s samples */
+        { 10, 360 },  /* an hour of 10s */
+        { 60, 1440 }  /* a day of 60s */
+    },
+    8, 8
+};
+
+static void tsdb_tier_free(tsdb_tier_t *tier)
+{
+    free(tier->timestamp);
+    free(tier->min);
+    free(tier->max);
+    free(tier->avg);
+    free(tier->open_min);
+    free(tier->open_max);
+    free(tier->open_sum);
+    free(tier->open_count);
+}
+
+static int tsdb_tier_init(tsdb_tier_t *tier, int nseries,
+                          const sigar_tsdb_tier_t *opts)
+{
+    size_t values = (size_t)nseries * opts->points;
+
+    tier->step = opts->step;
+    tier->points = opts->points;
+
+    tier->timestamp = malloc(sizeof(*tier->timestamp) * opts->points);
+    tier->min = malloc(sizeof(*tier->min) * values);
+    tier->max = malloc(sizeof(*tier->max) * values);
+    tier->avg = malloc(sizeof(*tier->avg) * values);
+    tier->open_min = malloc(sizeof(*tier->open_min) * nseries);
+    tier->open_max = malloc(sizeof(*tier->open_max) * nseries);
+    tier->open_sum = malloc(sizeof(*tier->open_sum) * nseries);
+    tier->open_count = calloc(nseries, sizeof(*tier->open_count));
+
+    if (!(tier->timestamp && tier->min && tier->max && tier->avg &&
+          tier->open_min && tier->open_max && tier->open_sum &&
+          tier->open_count))
+    {
+        return ENOMEM;
+    }
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int) sigar_tsdb_create(sigar_tsdb_t **tsdbp,
+                                     const sigar_tsdb_opts_t *opts)
+{
+    sigar_tsdb_t *tsdb;
+    int i, status = SIGAR_OK;
+
+    if (!opts) {
+        opts = &tsdb_opts_default;
+    }
+
+    if ((opts->ntiers < 1) || (opts->ntiers > SIGAR_TSDB_TIERS_MAX) ||
+        (opts->ifaces_max < 0) || (opts->disks_max < 0))
+    {
+        return EINVAL;
+    }
+    for (i=0; i<opts->ntiers; i++) {
+        if (!opts->tiers[i].step || !opts->tiers[i].points) {
+            return EINVAL;
+        }
+    }
+
+    if (!(tsdb = calloc(1, sizeof(*tsdb)))) {
+        return ENOMEM;
+    }
+    TSDB_LOCK_INIT(&tsdb->lock);
+
+    tsdb->ifaces_max = opts->ifaces_max;
+    tsdb->disks_max = opts->disks_max;
+    tsdb->nseries = TSDB_HOST_SERIES +
+        (opts->ifaces_max * TSDB_NETIF_SERIES) +
+        (opts->disks_max * TSDB_DISK_SERIES);
+    tsdb->ntiers = opts->ntiers;
+
+    for (i=0; (i<opts->ntiers) && (status == SIGAR_OK); i++) {
+        status = tsdb_tier_init(&tsdb->tiers[i], tsdb->nseries,
+                                &opts->tiers[i]);
+    }
+
+    tsdb->ifaces = calloc(opts->ifaces_max + 1, sizeof(*tsdb->ifaces));
+    tsdb->disks = calloc(opts->disks_max + 1, sizeof(*tsdb->disks));
+    tsdb->value = malloc(sizeof(*tsdb->value) * tsdb->nseries);
+
+    if ((status != SIGAR_OK) ||
+        !tsdb->ifaces || !tsdb->disks || !tsdb->value)
+    {
+        sigar_tsdb_destroy(tsdb);
+        return ENOMEM;
+    }
+
+    *tsdbp = tsdb;
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int) sigar_tsdb_destroy(sigar_tsdb_t *tsdb)
+{
+    int i;
+
+    TSDB_LOCK_DESTROY(&tsdb->lock);
+
+    for (i=0; i<tsdb->ntiers; i++) {
+        tsdb_tier_free(&tsdb->tiers[i]);
+    }
+    free(tsdb->ifaces);
+    free(tsdb->disks);
+    free(tsdb->value);
+    free(tsdb);
+
+    return SIGAR_OK;
+}
+
+/* the slot of name, a free one the first time, -1 once all are taken */
+static int tsdb_device_slot(tsdb_device_t *devices, int max,
+                            unsigned long hint, const char *name)
+{
+    int i;
+
+    /* lists tend to come in the same order every round */
+    if ((hint < (unsigned long)max) && devices[hint].used &&
+        strEQ(devices[hint].name, name))
+    {
+        return (int)hint;
+    }
+
+    for (i=0; i<max; i++) {
+        if (!devices[i].used) {
+            SIGAR_SSTRCPY(devices[i].name, name);
+            devices[i].used = 1;
+            return i;
+        }
+        if (strEQ(devices[i].name, name)) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+static int tsdb_device_find(tsdb_device_t *devices, int max,
+                            const char *name)
+{
+    int i;
+
+    for (i=0; (i<max) && devices[i].used; i++) {
+        if (strEQ(devices[i].name, name)) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/* per second rates of counters into value, none after a reset */
+static void tsdb_device_rates(tsdb_device_t *device, sigar_int64_t now,
+                              sigar_uint64_t *counters, int num,
+                              double *value)
+{
+    double secs = (double)(now - device->last_time) / SIGAR_MSEC;
+    int i;
+
+    for (i=0; i<num; i++) {
+        if (device->have_last && (secs > 0) &&
+            (counters[i] >= device->last[i]))
+        {
+            value[i] = (double)(counters[i] - device->last[i]) / secs;
+        }
+    }
+
+    memcpy(device->last, counters, sizeof(*counters) * num);
+    device->last_time = now;
+    device->have_last = 1;
+}
+
+static void tsdb_cpu_values(sigar_tsdb_t *tsdb, sigar_cpu_t *cpu,
+                            double *value)
+{
+    sigar_cpu_t *last = &tsdb->last_cpu;
+
+    if (tsdb->have_cpu && (cpu->total > last->total)) {
+        double total = (double)(cpu->total - last->total);
+
+#define TSDB_CPU_PCT(field, series) \
+        if (cpu->field >= last->field) \
+            value[series] = ((cpu->field - last->field) * 100.0) / total
+
+        TSDB_CPU_PCT(user, SIGAR_TSDB_CPU_USER);
+        TSDB_CPU_PCT(sys, SIGAR_TSDB_CPU_SYS);
+        TSDB_CPU_PCT(nice, SIGAR_TSDB_CPU_NICE);
+        TSDB_CPU_PCT(idle, SIGAR_TSDB_CPU_IDLE);
+        TSDB_CPU_PCT(wait, SIGAR_TSDB_CPU_WAIT);
+        TSDB_CPU_PCT(irq, SIGAR_TSDB_CPU_IRQ);
+        TSDB_CPU_PCT(soft_irq, SIGAR_TSDB_CPU_SOFT_IRQ);
+        TSDB_CPU_PCT(stolen, SIGAR_TSDB_CPU_STOLEN);
+#undef TSDB_CPU_PCT
+    }
+
+    memcpy(last, cpu, sizeof(*last));
+    tsdb->have_cpu = 1;
+}
+
+static void tsdb_tier_add(tsdb_tier_t *tier, int nseries,
+                          double *value, sigar_int64_t timestamp)
+{
+    int i;
+
+    for (i=0; i<nseries; i++) {
+        double v = value[i];
+
+        if (v == TSDB_NONE) {
+            continue;
+        }
+        if (!tier->open_count[i]) {
+            tier->open_min[i] = tier->open_max[i] = tier->open_sum[i] = v;
+        }
+        else {
+            if (v < tier->open_min[i]) {
+                tier->open_min[i] = v;
+            }
+            if (v > tier->open_max[i]) {
+                tier->open_max[i] = v;
+            }
+            tier->open_sum[i] += v;
+        }
+        tier->open_count[i]++;
+    }
+
+    if (++tier->samples < tier->step) {
+        return;
+    }
+
+    /* the point is full, move it to the ring */
+    for (i=0; i<nseries; i++) {
+        size_t idx = ((size_t)i * tier->points) + tier->head;
+
+        if (tier->open_count[i]) {
+            tier->min[idx] = tier->open_min[i];
+            tier->max[idx] = tier->open_max[i];
+            tier->avg[idx] = tier->open_sum[i] / tier->open_count[i];
+            tier->open_count[i] = 0;
+        }
+        else {
+            tier->min[idx] = tier->max[idx] = tier->avg[idx] = TSDB_NONE;
+        }
+    }
+
+    tier->timestamp[tier->head] = timestamp;
+    tier->head = (tier->head + 1) % tier->points;
+    if (tier->number < tier->points) {
+        tier->number++;
+    }
+    tier->samples = 0;
+}
+
+SIGAR_DECLARE(int) sigar_tsdb_add(sigar_tsdb_t *tsdb,
+                                  sigar_sampler_snapshot_t *snapshot)
+{
+    double *value = tsdb->value;
+    sigar_int64_t now = snapshot->timestamp;
+    unsigned long i;
+    int j;
+
+    TSDB_LOCK(&tsdb->lock);
+
+    for (j=0; j<tsdb->nseries; j++) {
+        value[j] = TSDB_NONE;
+    }
+
+    if (snapshot->flags & SIGAR_SAMPLER_CPU) {
+        tsdb_cpu_values(tsdb, &snapshot->cpu, value);
+    }
+
+    if (snapshot->flags & SIGAR_SAMPLER_MEM) {
+        value[SIGAR_TSDB_MEM_USED] = (double)snapshot->mem.used;
+        value[SIGAR_TSDB_MEM_ACTUAL_USED] =
+            (double)snapshot->mem.actual_used;
+        value[SIGAR_TSDB_MEM_ACTUAL_FREE] =
+            (double)snapshot->mem.actual_free;
+    }
+
+    if (snapshot->flags & SIGAR_SAMPLER_SWAP) {
+        value[SIGAR_TSDB_SWAP_USED] = (double)snapshot->swap.used;
+    }
+
+    if (snapshot->flags & SIGAR_SAMPLER_NETIF) {
+        for (i=0; i<snapshot->iflist.number; i++) {
+            sigar_net_interface_stat_entry_t *entry =
+                &snapshot->iflist.data[i];
+            sigar_uint64_t counters[TSDB_NETIF_SERIES];
+            int slot = tsdb_device_slot(tsdb->ifaces, tsdb->ifaces_max,
+                                        i, entry->name);
+
+            if (slot < 0) {
+                continue;
+            }
+
+            counters[0] = entry->stat.rx_bytes;
+            counters[1] = entry->stat.rx_packets;
+            counters[2] = entry->stat.tx_bytes;
+            counters[3] = entry->stat.tx_packets;
+            counters[4] = entry->stat.rx_errors;
+            counters[5] = entry->stat.tx_errors;
+
+            tsdb_device_rates(&tsdb->ifaces[slot], now,
+                              counters, TSDB_NETIF_SERIES,
+                              &value[TSDB_HOST_SERIES +
+                                     (slot * TSDB_NETIF_SERIES)]);
+        }
+    }
+
+    if (snapshot->flags & SIGAR_SAMPLER_DISK) {
+        int base = TSDB_HOST_SERIES + (tsdb->ifaces_max * TSDB_NETIF_SERIES);
+
+        for (i=0; i<snapshot->disklist.number; i++) {
+            sigar_disk_usage_entry_t *entry = &snapshot->disklist.data[i];
+            sigar_uint64_t counters[TSDB_DISK_SERIES];
+            int slot = tsdb_device_slot(tsdb->disks, tsdb->disks_max,
+                                        i, entry->name);
+
+            if (slot < 0) {
+                continue;
+            }
+
+            counters[0] = entry->disk.reads;
+            counters[1] = entry->disk.writes;
+            counters[2] = entry->disk.read_bytes;
+            counters[3] = entry->disk.write_bytes;
+
+            tsdb_device_rates(&tsdb->disks[slot], now,
+                              counters, TSDB_DISK_SERIES,
+                              &value[base + (slot * TSDB_DISK_SERIES)]);
+        }
+    }
+
+    for (j=0; j<tsdb->ntiers; j++) {
+        tsdb_tier_add(&tsdb->tiers[j], tsdb->nseries, value, now);
+    }
+
+    TSDB_UNLOCK(&tsdb->lock);
+
+    return SIGAR_OK;
+}
+
+/* the column of series, ENOENT for a device never seen */
+static int tsdb_column(sigar_tsdb_t *tsdb, int series, const char *name,
+                       int *column)
+{
+    int slot;
+
+    if ((series < 0) || (series >= SIGAR_TSDB_SERIES_MAX)) {
+        return EINVAL;
+    }
+
+    if (series < TSDB_HOST_SERIES) {
+        *column = series;
+        return SIGAR_OK;
+    }
+
+    if (!name) {
+        return EINVAL;
+    }
+
+    if (series < SIGAR_TSDB_DISK_READS) {
+        if ((slot = tsdb_device_find(tsdb->ifaces, tsdb->ifaces_max,
+                                     name)) < 0)
+        {
+            return ENOENT;
+        }
+        *column = TSDB_HOST_SERIES + (slot * TSDB_NETIF_SERIES) +
+            (series - SIGAR_TSDB_NETIF_RX_BYTES);
+    }
+    else {
+        if ((slot = tsdb_device_find(tsdb->disks, tsdb->disks_max,
+                                     name)) < 0)
+        {
+            return ENOENT;
+        }
+        *column = TSDB_HOST_SERIES +
+            (tsdb->ifaces_max * TSDB_NETIF_SERIES) +
+            (slot * TSDB_DISK_SERIES) + (series - SIGAR_TSDB_DISK_READS);
+    }
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int) sigar_tsdb_range_get(sigar_tsdb_t *tsdb,
+                                        int tier,
+                                        int series,
+                                        const char *name,
+                                        sigar_int64_t start,
+                                        sigar_int64_t end,
+                                        sigar_tsdb_range_t *range)
+{
+    tsdb_tier_t *t;
+    unsigned long i, oldest;
+    size_t base;
+    int column, status;
+
+    range->number = 0;
+    range->timestamp = NULL;
+    range->min = range->max = range->avg = NULL;
+
+    if ((tier < 0) || (tier >= tsdb->ntiers)) {
+        return EINVAL;
+    }
+
+    TSDB_LOCK(&tsdb->lock);
+
+    if ((status = tsdb_column(tsdb, series, name, &column)) != SIGAR_OK) {
+        TSDB_UNLOCK(&tsdb->lock);
+        return status;
+    }
+
+    t = &tsdb->tiers[tier];
+
+    if (t->number) {
+        /* one block, the caller frees it with sigar_tsdb_range_destroy */
+        char *block = malloc((sizeof(*range->timestamp) +
+                              (sizeof(double) * 3)) * t->number);
+
+        if (!block) {
+            TSDB_UNLOCK(&tsdb->lock);
+            return ENOMEM;
+        }
+        range->timestamp = (sigar_int64_t *)block;
+        range->min = (double *)(block +
+                                (sizeof(*range->timestamp) * t->number));
+        range->max = range->min + t->number;
+        range->avg = range->max + t->number;
+    }
+
+    oldest = (t->head + t->points - t->number) % t->points;
+    base = (size_t)column * t->points;
+
+    for (i=0; i<t->number; i++) {
+        unsigned long idx = (oldest + i) % t->points;
+        sigar_int64_t timestamp = t->timestamp[idx];
+
+        if ((timestamp < start) || (timestamp > end) ||
+            (t->avg[base + idx] == TSDB_NONE))
+        {
+            continue;
+        }
+
+        range->timestamp[range->number] = timestamp;
+        range->min[range->number] = t->min[base + idx];
+        range->max[range->number] = t->max[base + idx];
+        range->avg[range->number] = t->avg[base + idx];
+        range->number++;
+    }
+
+    TSDB_UNLOCK(&tsdb->lock);
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(int) sigar_tsdb_range_destroy(sigar_tsdb_range_t *range)
+{
+    free(range->timestamp);
+    range->timestamp = NULL;
+    range->min = range->max = range->avg = NULL;
+    range->number = 0;
+
+    return SIGAR_OK;
+}
@@ -72,6 +72,440 @@ SIGAR_INLINE char *sigar_skip_multiple_token(char *p, int count)
     return p;
 }
 
+int sigar_keyval_scan(char *buffer, sigar_keyval_t *keys, int num)
+{
+    char *from = buffer;
+    int i, found = 0;
+
+    /*
+     * keys are usually listed in file order, so each search resumes
+     * where the last hit was and only wraps to the start on a miss.
+     * strstr is vectorized in any libc worth having, a per-line loop
+     * over the keys is not.
+     */
+    for (i=0; i<num; i++) {
+        char *start = from, *ptr;
+
+        keys[i].value = NULL;
+
+        for (;;) {
+            ptr = start;
+            while ((ptr = strstr(ptr, keys[i].key))) {
+                if ((ptr == buffer) || (ptr[-1] == '\n')) {
+                    break;
+                }
+                ptr += keys[i].len;
+            }
+            if (ptr || (start == buffer)) {
+                break;
+            }
+            start = buffer;
+        }
+
+        if (ptr) {
+            keys[i].value = from = ptr + keys[i].len;
+            found++;
+        }
+    }
+
+    return found;
+}
+
+#define SCAN_BLANK(c) (((c) == ' ') || ((c) == '\t'))
+
+/* eight spaces, the padding most /proc columns are aligned with */
+#define SCAN_BLANK_WORD 0x2020202020202020ULL
+
+char *sigar_scan_blanks(char *ptr, char *end)
+{
+    while ((end - ptr) >= (int)sizeof(sigar_uint64_t)) {
+        sigar_uint64_t word;
+
+        memcpy(&word, ptr, sizeof(word));
+        if (word != SCAN_BLANK_WORD) {
+            break;
+        }
+        ptr += sizeof(word);
+    }
+
+    while ((ptr < end) && SCAN_BLANK(*ptr)) {
+        ptr++;
+    }
+
+    return ptr;
+}
+
+char *sigar_scan_field(char *ptr, char *end)
+{
+    while ((ptr < end) && *ptr && !sigar_isspace(*ptr)) {
+        ptr++;
+    }
+
+    return sigar_scan_blanks(ptr, end);
+}
+
+char *sigar_scan_eol(char *ptr, char *end)
+{
+    char *nl = memchr(ptr, '\n', end - ptr);
+
+    return nl ? nl + 1 : end;
+}
+
+int sigar_scan_columns(char **ptr, char *end,
+                       sigar_uint64_t *fields, int max)
+{
+    char *p = *ptr;
+    int num = 0;
+
+    while (num < max) {
+        sigar_uint64_t val = 0;
+        char *start;
+        int neg;
+
+        p = sigar_scan_blanks(p, end);
+        neg = (p < end) && (*p == '-');
+        start = (p += neg);
+
+        while ((p < end) && ((unsigned char)(*p - '0') < 10)) {
+            val = (val * 10) + (*p++ - '0');
+        }
+        if (p == start) {
+            p -= neg;
+            break;
+        }
+
+        fields[num++] = neg ? (sigar_uint64_t)-(sigar_int64_t)val : val;
+    }
+
+    *ptr = p;
+
+    return num;
+}
+
+sigar_uint64_t sigar_scan_hex(char **ptr, char *end)
+{
+    char *p = *ptr;
+    sigar_uint64_t val = 0;
+
+    while (p < end) {
+        int c = (unsigned char)*p;
+
+        if ((unsigned)(c - '0') < 10) {
+            c -= '0';
+        }
+        else if ((unsigned)((c | 0x20) - 'a') < 6) {
+            c = (c | 0x20) - 'a' + 10;
+        }
+        else {
+            break;
+        }
+        val = (val << 4) | c;
+        p++;
+    }
+
+    *ptr = p;
+
+    return val;
+}
+
+/*
+ * 32 hex digits at a time for the ipv6 addresses of /proc/net/tcp6,
+ * udp6, raw6 and if_inet6.  x86_64 and aarch64 always have sse2 and neon, 32-bit x86
+ * asks the cpu once; everything else takes the scalar loop.
+ */
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)
+#  define SIGAR_HEX_SSE2
+#  define SIGAR_HEX_SSE2_TARGET
+#elif defined(__i386__) && defined(__GNUC__)
+#  define SIGAR_HEX_SSE2
+#  define SIGAR_HEX_SSE2_RUNTIME
+#  define SIGAR_HEX_SSE2_TARGET __attribute__((target("sse2")))
+#elif defined(__aarch64__) || defined(__ARM_NEON)
+#  define SIGAR_HEX_NEON
+#endif
+
+#if defined(SIGAR_HEX_SSE2)
+#include <emmintrin.h>
+#elif defined(SIGAR_HEX_NEON)
+#include <arm_neon.h>
+#endif
+
+#if defined(SIGAR_HEX_SSE2_RUNTIME) || \
+    (!defined(SIGAR_HEX_SSE2) && !defined(SIGAR_HEX_NEON))
+static SIGAR_INLINE int hex_nibble(int c)
+{
+    /* '0'-'9' are 0x3N, 'A'-'F' and 'a'-'f' have 0x40 set */
+    return (c & 0xf) + ((c >> 6) & 1) * 9;
+}
+
+static void hex_decode16_scalar(const char *hex, unsigned char *bin)
+{
+    int i;
+
+    for (i=0; i<16; i++) {
+        bin[i] = (unsigned char)((hex_nibble(hex[2*i]) << 4) |
+                                  hex_nibble(hex[2*i + 1]));
+    }
+}
+#endif
+
+#ifdef SIGAR_HEX_SSE2
+static SIGAR_HEX_SSE2_TARGET __m128i hex_pairs_sse2(__m128i c)
+{
+    __m128i nine = _mm_set1_epi8(9);
+    __m128i alpha = _mm_cmpgt_epi8(c, _mm_set1_epi8('9'));
+    __m128i nib = _mm_add_epi8(_mm_and_si128(c, _mm_set1_epi8(0xf)),
+                               _mm_and_si128(alpha, nine));
+
+    /* each 16-bit lane is hi | lo << 8, make it hi << 4 | lo */
+    return _mm_or_si128(_mm_and_si128(_mm_slli_epi16(nib, 4),
+                                      _mm_set1_epi16(0xf0)),
+                        _mm_srli_epi16(nib, 8));
+}
+
+static SIGAR_HEX_SSE2_TARGET void hex_decode16_sse2(const char *hex,
+                                                    unsigned char *bin)
+{
+    __m128i lo = hex_pairs_sse2(_mm_loadu_si128((const __m128i *)hex));
+    __m128i hi = hex_pairs_sse2(_mm_loadu_si128((const __m128i *)(hex + 16)));
+
+    _mm_storeu_si128((__m128i *)bin, _mm_packus_epi16(lo, hi));
+}
+#endif
+
+#ifdef SIGAR_HEX_NEON
+static void hex_decode16_neon(const char *hex, unsigned char *bin)
+{
+    /* val[0] the high digit of each byte, val[1] the low one */
+    uint8x16x2_t c = vld2q_u8((const uint8_t *)hex);
+    uint8x16_t nine = vdupq_n_u8(9), mask = vdupq_n_u8(0xf);
+    uint8x16_t digit = vdupq_n_u8('9');
+    uint8x16_t hi = vaddq_u8(vandq_u8(c.val[0], mask),
+                             vandq_u8(vcgtq_u8(c.val[0], digit), nine));
+    uint8x16_t lo = vaddq_u8(vandq_u8(c.val[1], mask),
+                             vandq_u8(vcgtq_u8(c.val[1], digit), nine));
+
+    vst1q_u8(bin, vorrq_u8(vshlq_n_u8(hi, 4), lo));
+}
+#endif
+
+void sigar_hex_decode16(const char *hex, unsigned char *bin)
+{
+#if defined(SIGAR_HEX_SSE2_RUNTIME)
+    if (__builtin_cpu_supports("sse2")) {
+        hex_decode16_sse2(hex, bin);
+        return;
+    }
+    hex_decode16_scalar(hex, bin);
+#elif defined(SIGAR_HEX_SSE2)
+    hex_decode16_sse2(hex, bin);
+#elif defined(SIGAR_HEX_NEON)
+    hex_decode16_neon(hex, bin);
+#else
+    hex_decode16_scalar(hex, bin);
+#endif
+}
+
+void sigar_hex_decode128(const char *hex, sigar_uint32_t *words)
+{
+    unsigned char bin[16];
+    int i;
+
+    sigar_hex_decode16(hex, bin);
+
+    for (i=0; i<4; i++) {
+        const unsigned char *b = &bin[i*4];
+
+        words[i] = ((sigar_uint32_t)b[0] << 24) | ((sigar_uint32_t)b[1] << 16) |
+            ((sigar_uint32_t)b[2] << 8) | (sigar_uint32_t)b[3];
+    }
+}
+
+/*
+ * the counter tables (/proc/interrupts, /proc/softirqs) are one %10u
+ * column per cpu, mostly blanks.  sse2 finds the blanks and the digits
+ * of 16 bytes at once, and up to 8 digits are converted as one word on
+ * little endian; a field the vector does not settle takes the loop.
+ */
+#if defined(SIGAR_HEX_SSE2) && defined(__GNUC__)
+#  define SIGAR_SCAN_SSE2
+#endif
+
+#if (defined(__BYTE_ORDER__) && \
+     (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)) || \
+    defined(_M_X64) || defined(_M_IX86)
+#  define SIGAR_SCAN_SWAR
+#endif
+
+#ifdef SIGAR_SCAN_SWAR
+/* len (1-8) digits at ptr, with 8 bytes readable from ptr */
+static SIGAR_INLINE sigar_uint64_t scan_digits8(const char *ptr, int len)
+{
+    sigar_uint64_t val;
+
+    memcpy(&val, ptr, sizeof(val));
+    /* '0'-'9' to 0-9, what follows the digits is shifted out */
+    val = (val ^ 0x3030303030303030ULL) << ((8 - len) * 8);
+    val = ((val & 0x0F0F0F0F0F0F0F0FULL) * 2561) >> 8;
+    val = ((val & 0x00FF00FF00FF00FFULL) * 6553601) >> 16;
+    return ((val & 0x0000FFFF0000FFFFULL) * 42949672960001ULL) >> 32;
+}
+#endif
+
+static SIGAR_INLINE sigar_uint64_t scan_decimal(const char *ptr, int len,
+                                                const char *end)
+{
+    sigar_uint64_t val = 0;
+
+#ifdef SIGAR_SCAN_SWAR
+    if (len <= 8) {
+        if ((end - ptr) >= 8) {
+            return scan_digits8(ptr, len);
+        }
+    }
+    else {
+        for (; len > 8; len--) {
+            val = (val * 10) + (*ptr++ - '0');
+        }
+        return (val * 100000000) + scan_digits8(ptr, 8);
+    }
+#else
+    (void)end;
+#endif
+
+    while (len-- > 0) {
+        val = (val * 10) + (*ptr++ - '0');
+    }
+
+    return val;
+}
+
+#ifdef SIGAR_SCAN_SSE2
+static SIGAR_HEX_SSE2_TARGET void scan_masks_sse2(const char *ptr,
+                                                  unsigned *blank,
+                                                  unsigned *digit)
+{
+    __m128i c = _mm_loadu_si128((const __m128i *)ptr);
+    __m128i d = _mm_sub_epi8(c, _mm_set1_epi8('0'));
+
+    *blank = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(c, _mm_set1_epi8(' ')));
+    /* signed, bytes past 0x7f never land on 0-9 */
+    *digit = (unsigned)_mm_movemask_epi8(
+        _mm_and_si128(_mm_cmpgt_epi8(d, _mm_set1_epi8(-1)),
+                      _mm_cmplt_epi8(d, _mm_set1_epi8(10))));
+}
+#endif
+
+#ifdef SIGAR_SCAN_SSE2
+/*
+ * whole 16 byte blocks, so the next load never waits on the parse; a
+ * number running into the next block is carried over.  returns where
+ * the loop should go on, a tab, the end, or past the last number.
+ */
+static SIGAR_HEX_SSE2_TARGET char *scan_counters_sse2(char *p, char *end,
+                                                      sigar_uint64_t *fields,
+                                                      int max, int *count,
+                                                      char **after)
+{
+    char *run = NULL;
+    int num = *count;
+
+    while ((num < max) && ((end - p) >= 16)) {
+        unsigned blank, digit, other, starts, ends;
+        int stop;
+
+        scan_masks_sse2(p, &blank, &digit);
+        other = ~(blank | digit) & 0xffff;
+        stop = other ? __builtin_ctz(other) : 16;
+        digit &= (1U << stop) - 1;
+        starts = digit & ~(digit << 1);
+        ends = digit & ~(digit >> 1);
+
+        if (run) {
+            if (digit & 1) {
+                starts &= ~1U; /* still going */
+            }
+            else {
+                fields[num++] = scan_decimal(run, (int)(p - run), end);
+                *after = p;
+                run = NULL;
+            }
+        }
+
+        while (ends && (num < max)) {
+            int last = __builtin_ctz(ends);
+            char *from = run;
+
+            if (!from) {
+                from = p + __builtin_ctz(starts);
+                starts &= starts - 1;
+            }
+            if ((last == 15) && (stop == 16)) {
+                run = from; /* may go on in the next block */
+                break;
+            }
+            fields[num++] = scan_decimal(from, (int)(p + last + 1 - from), end);
+            *after = p + last + 1;
+            run = NULL;
+            ends &= ends - 1;
+        }
+
+        if ((stop < 16) || (num == max)) {
+            break;
+        }
+        p += 16;
+    }
+
+    *count = num;
+
+    if (run) {
+        return run;
+    }
+
+    return ((num == max) || ((end - p) >= 16)) ? *after : p;
+}
+#endif
+
+/* *ptr is left just past the last counter */
+int sigar_scan_counters(char **ptr, char *end,
+                        sigar_uint64_t *fields, int max)
+{
+    char *p = *ptr, *start, *after = *ptr;
+    int num = 0;
+#ifdef SIGAR_SCAN_SSE2
+#  ifdef SIGAR_HEX_SSE2_RUNTIME
+    int sse2 = __builtin_cpu_supports("sse2");
+#  else
+    int sse2 = 1;
+#  endif
+#endif
+
+    while (num < max) {
+#ifdef SIGAR_SCAN_SSE2
+        if (sse2) {
+            p = scan_counters_sse2(p, end, fields, max, &num, &after);
+            if (num == max) {
+                break;
+            }
+        }
+#endif
+        p = sigar_scan_blanks(p, end);
+        start = p;
+        while ((p < end) && ((unsigned char)(*p - '0') < 10)) {
+            p++;
+        }
+        if (p == start) {
+            break;
+        }
+        fields[num++] = scan_decimal(start, (int)(p - start), end);
+        after = p;
+    }
+
+    *ptr = after;
+
+    return num;
+}
+
 char *sigar_getword(char **line, char stop)
 {
     char *pos = *line;
@@ -98,6 +532,73 @@ char *sigar_getword(char **line, char stop)
     return res;
 }
 
+/*
+ * the procfs helpers below take no handle, so the root is process
+ * wide.  it only changes when SIGAR_PROC_ROOT does, every handle
+ * opened with the same environment writes the same value.
+ */
+static char procfs_root[SIGAR_PATH_MAX+1] = PROCP_FS_ROOT;
+static int procfs_root_len = SSTRLEN(PROCP_FS_ROOT);
+
+int sigar_procfs_root_set(const char *root)
+{
+    char buffer[sizeof(procfs_root)];
+    int len;
+
+    if (!root || !*root) {
+        root = PROCP_FS_ROOT;
+    }
+
+    len = strlen(root);
+    if (len + 1 >= (int)sizeof(buffer)) {
+        return ENAMETOOLONG;
+    }
+
+    memcpy(buffer, root, len);
+    if (buffer[len-1] != '/') {
+        buffer[len++] = '/';
+    }
+    buffer[len] = '\0';
+
+    if (strcmp(buffer, procfs_root) != 0) {
+        memcpy(procfs_root, buffer, len+1);
+        procfs_root_len = len;
+    }
+
+    return SIGAR_OK;
+}
+
+const char *sigar_procfs_root_get(void)
+{
+    return procfs_root;
+}
+
+char *sigar_procfs_filename(char *buffer, int buflen,
+                            const char *fname, int fname_len)
+{
+    assert(buflen >= procfs_root_len + fname_len + 1);
+
+    memcpy(buffer, procfs_root, procfs_root_len);
+    memcpy(buffer + procfs_root_len, fname, fname_len);
+    buffer[procfs_root_len + fname_len] = '\0';
+
+    return buffer;
+}
+
+int sigar_procfs_file2str(const char *fname, int fname_len,
+                          char *buffer, int buflen)
+{
+    char name[SIGAR_PATH_MAX+1];
+
+    if (procfs_root_len + fname_len >= (int)sizeof(name)) {
+        return ENAMETOOLONG;
+    }
+
+    return sigar_file2str(sigar_procfs_filename(name, sizeof(name),
+                                                fname, fname_len),
+                          buffer, buflen);
+}
+
 /* avoiding sprintf */
 
 char *sigar_proc_filename(char *buffer, int buflen,
@@ -111,10 +612,10 @@ char *sigar_proc_filename(char *buffer, int buflen,
     char *pid_str = sigar_uitoa(pid_buf, pid, &len);
 
     assert((unsigned int)buflen >=
-           (SSTRLEN(PROCP_FS_ROOT) + UITOA_BUFFER_SIZE + fname_len + 1));
+           (procfs_root_len + UITOA_BUFFER_SIZE + fname_len + 1));
 
-    memcpy(ptr, PROCP_FS_ROOT, SSTRLEN(PROCP_FS_ROOT));
-    ptr += SSTRLEN(PROCP_FS_ROOT);
+    memcpy(ptr, procfs_root, procfs_root_len);
+    ptr += procfs_root_len;
 
     memcpy(ptr, pid_str, len);
     ptr += len;
@@ -153,12 +654,13 @@ int sigar_proc_file2str(char *buffer, int buflen,
 int sigar_proc_list_procfs_get(sigar_t *sigar,
                                sigar_proc_list_t *proclist)
 {
-    DIR *dirp = opendir("/proc");
+    DIR *dirp = opendir(procfs_root);
     struct dirent *ent;
 #ifdef HAVE_READDIR_R
     struct dirent dbuf;
 #endif
 
+    SIGAR_INSTRUMENT_OPEN();
     if (!dirp) {
         return errno;
     }
@@ -226,67 +728,133 @@ int sigar_proc_fd_count(sigar_t *sigar, sigar_pid_t pid,
     return SIGAR_OK;
 }
 
-int sigar_procfs_args_get(sigar_t *sigar, sigar_pid_t pid,
-                          sigar_proc_args_t *procargs)
-{
-    char buffer[9086], *buf=NULL, *ptr;
-    int fd, len, total=0;
+#define SIGAR_PROCFS_CHUNK 4096
 
-    (void)SIGAR_PROC_FILENAME(buffer, pid, "/cmdline");
+int sigar_procfs_entries_get(sigar_t *sigar, const char *fname, int sep,
+                             sigar_procfs_entry_getter_t getter,
+                             void *data)
+{
+    int fd, len, have = 0, status = SIGAR_OK, done = 0;
 
-    if ((fd = open(buffer, O_RDONLY)) < 0) {
+    SIGAR_INSTRUMENT_OPEN();
+    if ((fd = open(fname, O_RDONLY)) < 0) {
         if (errno == ENOENT) {
             return ESRCH;
         }
         return errno;
     }
 
-    buffer[0] = '\0';
+    if (!sigar->procfs_buf) {
+        sigar->procfs_len = SIGAR_PROCFS_CHUNK;
+        sigar->procfs_buf = malloc(sigar->procfs_len);
+    }
 
-    /* XXX: possible to get rid of some mallocs here.
-     * but, unlikely this will be called often so it
-     * might not even matter much.
-     */
-    while ((len = read(fd, buffer, sizeof(buffer)-1)) > 0) {
+    while (!done) {
+        char *ptr, *end, *nul;
+
+        /* one entry is bigger than the buffer, room for the nul */
+        if (have >= sigar->procfs_len - 1) {
+            char *buf = realloc(sigar->procfs_buf, sigar->procfs_len * 2);
+            if (!buf) {
+                status = ENOMEM;
+                break;
+            }
+            sigar->procfs_buf = buf;
+            sigar->procfs_len *= 2;
+        }
+        if (!sigar->procfs_buf) {
+            status = ENOMEM;
+            break;
+        }
+
+        SIGAR_INSTRUMENT_READ();
+        len = read(fd, sigar->procfs_buf + have,
+                   sigar->procfs_len - 1 - have);
+
+        if (len < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            status = errno;
+            break;
+        }
         if (len == 0) {
+            /* last entry without a terminator */
+            if (have) {
+                sigar->procfs_buf[have] = '\0';
+                getter(data, sigar->procfs_buf, have);
+            }
             break;
         }
-        buf = realloc(buf, total+len+1);
-        memcpy(buf+total, buffer, len);
-        total += len;
-    }
 
-    close(fd);
+        have += len;
+        ptr = sigar->procfs_buf;
+        end = ptr + have;
 
-    /* e.g. /proc/2/cmdline */
-    if (total == 0) {
-        procargs->number = 0;
-        return SIGAR_OK;
+        while ((nul = memchr(ptr, sep, end - ptr))) {
+            *nul = '\0';
+            if (getter(data, ptr, nul - ptr) != SIGAR_OK) {
+                done = 1;
+                break;
+            }
+            ptr = nul + 1;
+        }
+
+        /* carry a partial entry over to the next read */
+        have = end - ptr;
+        if (have && (ptr != sigar->procfs_buf)) {
+            memmove(sigar->procfs_buf, ptr, have);
+        }
     }
 
-    buf[total] = '\0';
-    ptr = buf;
+    close(fd);
 
-    while (total > 0) {
-        int alen = strlen(ptr)+1;
-        char *arg = malloc(alen);
+    return status;
+}
 
-        SIGAR_PROC_ARGS_GROW(procargs);
-        memcpy(arg, ptr, alen);
+typedef struct {
+    sigar_proc_args_t *procargs;
+    int status;
+} procfs_args_t;
 
-        procargs->data[procargs->number++] = arg;
+static int procfs_args_entry(void *data, char *entry, int len)
+{
+    procfs_args_t *args = (procfs_args_t *)data;
+    sigar_proc_args_t *procargs = args->procargs;
+    char *arg = malloc(len + 1);
 
-        total -= alen;
-        if (total > 0) {
-            ptr += alen;
-        }
+    if (!arg) {
+        args->status = ENOMEM;
+        return !SIGAR_OK;
     }
 
-    free(buf);
+    memcpy(arg, entry, len + 1);
+
+    SIGAR_PROC_ARGS_GROW(procargs);
+    procargs->data[procargs->number++] = arg;
 
     return SIGAR_OK;
 }
 
+int sigar_procfs_args_get(sigar_t *sigar, sigar_pid_t pid,
+                          sigar_proc_args_t *procargs)
+{
+    char name[BUFSIZ];
+    procfs_args_t args;
+    int status;
+
+    (void)SIGAR_PROC_FILENAME(name, pid, "/cmdline");
+
+    args.procargs = procargs;
+    args.status = SIGAR_OK;
+
+    /* e.g. /proc/2/cmdline is empty, leaving procargs->number 0 */
+    status = sigar_procfs_entries_get(sigar, name, '\0',
+                                      procfs_args_entry, &args);
+
+    return status == SIGAR_OK ? args.status : status;
+}
+
 #endif /* WIN32 */
 
 /* from httpd/server/util.c */
@@ -754,6 +1322,8 @@ int sigar_cpu_mhz_from_model(char *model)
 #if defined(_AIX) || defined(SIGAR_HPUX) || defined(__OpenBSD__) || defined(__NetBSD__)
 #include <sys/socket.h>
 #endif
+#include <poll.h>
+#include <unistd.h>
 
 static enum clnt_stat get_sockaddr(struct sockaddr_in *addr, char *host)
 {
@@ -827,18 +1397,507 @@ SIGAR_DECLARE(int) sigar_rpc_ping(char *host,
 
     return rpc_stat;
 }
-#endif
 
-int sigar_file2str(const char *fname, char *buffer, int buflen)
-{
-    int len, status;
-    int fd = open(fname, O_RDONLY);
+/*
+ * sigar_rpc_ping_list: a portmapper GETPORT and then a NULL call to
+ * every host at once, over one non-blocking udp socket, or a
+ * connection per host for tcp.  udp requests are sent again every
+ * RPC_PING_RESEND millis, as clntudp does, until the shared deadline.
+ */
 
-    if (fd < 0) {
-        return ENOENT;
-    }
+#define RPC_PING_RESEND 500
+#define RPC_PING_BUFSIZ 512
 
-    if ((len = read(fd, buffer, buflen)) < 0) {
+enum {
+    RPC_PING_PMAP,    /* waiting on the portmapper */
+    RPC_PING_CONNECT, /* tcp connect in progress */
+    RPC_PING_CALL,    /* waiting on the NULL call */
+    RPC_PING_DONE
+};
+
+typedef struct {
+    struct sockaddr_in addr;
+    int state;
+    int fd; /* tcp only */
+    sigar_int64_t sent;
+    unsigned int len;
+    char buf[RPC_PING_BUFSIZ]; /* tcp reply so far */
+} rpc_ping_t;
+
+static unsigned int rpc_ping_encode(char *buf, unsigned int size,
+                                    u_long xid,
+                                    u_long program, u_long version,
+                                    u_long proc,
+                                    xdrproc_t xargs, void *args)
+{
+    struct rpc_msg msg;
+    XDR xdr;
+    unsigned int len = 0;
+
+    msg.rm_xid = xid;
+    msg.rm_direction = CALL;
+    msg.rm_call.cb_rpcvers = RPC_MSG_VERSION;
+    msg.rm_call.cb_prog = program;
+    msg.rm_call.cb_vers = version;
+    msg.rm_call.cb_proc = proc;
+    msg.rm_call.cb_cred.oa_flavor = AUTH_NONE;
+    msg.rm_call.cb_cred.oa_base = NULL;
+    msg.rm_call.cb_cred.oa_length = 0;
+    msg.rm_call.cb_verf = msg.rm_call.cb_cred;
+
+    xdrmem_create(&xdr, buf, size, XDR_ENCODE);
+    if (xdr_callmsg(&xdr, &msg) && xargs(&xdr, args)) {
+        len = xdr_getpos(&xdr);
+    }
+    XDR_DESTROY(&xdr);
+
+    return len;
+}
+
+static enum clnt_stat rpc_ping_decode(char *buf, unsigned int len,
+                                      u_long *port)
+{
+    struct rpc_msg msg;
+    char verf[MAX_AUTH_BYTES];
+    u_long result = 0;
+    enum clnt_stat status;
+    XDR xdr;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.acpted_rply.ar_verf.oa_base = verf;
+    msg.acpted_rply.ar_results.where = (caddr_t)&result;
+    msg.acpted_rply.ar_results.proc =
+        port ? (xdrproc_t)xdr_u_long : (xdrproc_t)xdr_void;
+
+    xdrmem_create(&xdr, buf, len, XDR_DECODE);
+
+    if (!xdr_replymsg(&xdr, &msg)) {
+        status = RPC_CANTDECODERES;
+    }
+    else if (msg.rm_reply.rp_stat == MSG_ACCEPTED) {
+        switch (msg.acpted_rply.ar_stat) {
+          case SUCCESS:
+            status = RPC_SUCCESS;
+            break;
+          case PROG_UNAVAIL:
+            status = RPC_PROGUNAVAIL;
+            break;
+          case PROG_MISMATCH:
+            status = RPC_PROGVERSMISMATCH;
+            break;
+          case PROC_UNAVAIL:
+            status = RPC_PROCUNAVAIL;
+            break;
+          case GARBAGE_ARGS:
+            status = RPC_CANTDECODEARGS;
+            break;
+          default:
+            status = RPC_SYSTEMERROR;
+            break;
+        }
+    }
+    else {
+        status = msg.rjcted_rply.rj_stat == RPC_MISMATCH ?
+            RPC_VERSMISMATCH : RPC_AUTHERROR;
+    }
+
+    XDR_DESTROY(&xdr);
+
+    if (port) {
+        *port = result;
+    }
+
+    return status;
+}
+
+/* GETPORT goes over udp, as pmap_getport does for either protocol */
+static int rpc_ping_send_pmap(int sock, rpc_ping_t *ping, u_long xid,
+                              int protocol,
+                              u_long program, u_long version)
+{
+    char buf[RPC_PING_BUFSIZ];
+    struct sockaddr_in addr;
+    struct pmap args;
+    unsigned int len;
+
+    args.pm_prog = program;
+    args.pm_vers = version;
+    args.pm_prot =
+        protocol == SIGAR_NETCONN_UDP ? IPPROTO_UDP : IPPROTO_TCP;
+    args.pm_port = 0;
+
+    len = rpc_ping_encode(buf, sizeof(buf), xid,
+                          PMAPPROG, PMAPVERS, PMAPPROC_GETPORT,
+                          (xdrproc_t)xdr_pmap, &args);
+
+    memcpy(&addr, &ping->addr, sizeof(addr));
+    addr.sin_port = htons(PMAPPORT);
+
+    if (sendto(sock, buf, len, 0,
+               (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        return errno;
+    }
+
+    return SIGAR_OK;
+}
+
+static int rpc_ping_send_call(int sock, rpc_ping_t *ping, u_long xid,
+                              u_long program, u_long version)
+{
+    char buf[RPC_PING_BUFSIZ + 4];
+    unsigned int len;
+
+    if (ping->fd < 0) {
+        len = rpc_ping_encode(buf, RPC_PING_BUFSIZ, xid,
+                              program, version, NULLPROC,
+                              (xdrproc_t)xdr_void, NULL);
+
+        if (sendto(sock, buf, len, 0,
+                   (struct sockaddr *)&ping->addr,
+                   sizeof(ping->addr)) < 0)
+        {
+            return errno;
+        }
+    }
+    else {
+        /* a single, last, record fragment */
+        sigar_uint32_t mark;
+
+        len = rpc_ping_encode(buf + 4, RPC_PING_BUFSIZ, xid,
+                              program, version, NULLPROC,
+                              (xdrproc_t)xdr_void, NULL);
+        mark = htonl(0x80000000 | len);
+        memcpy(buf, &mark, sizeof(mark));
+
+        if (send(ping->fd, buf, len + 4, 0) != (ssize_t)(len + 4)) {
+            return errno ? errno : EIO;
+        }
+    }
+
+    return SIGAR_OK;
+}
+
+static void rpc_ping_done(rpc_ping_t *ping, int *result, int status)
+{
+    if (ping->fd >= 0) {
+        close(ping->fd);
+        ping->fd = -1;
+    }
+    ping->state = RPC_PING_DONE;
+    *result = status;
+}
+
+/* the portmapper answered, start the call itself */
+static void rpc_ping_start_call(int sock, rpc_ping_t *ping, int *result,
+                                u_long xid, u_long port, int protocol,
+                                u_long program, u_long version,
+                                sigar_int64_t now)
+{
+    ping->addr.sin_port = htons((unsigned short)port);
+
+    if (protocol == SIGAR_NETCONN_UDP) {
+        ping->state = RPC_PING_CALL;
+        ping->sent = now;
+        if (rpc_ping_send_call(sock, ping, xid, program, version) !=
+            SIGAR_OK)
+        {
+            rpc_ping_done(ping, result, RPC_CANTSEND);
+        }
+        return;
+    }
+
+    if ((ping->fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+        rpc_ping_done(ping, result, RPC_SYSTEMERROR);
+        return;
+    }
+    fcntl(ping->fd, F_SETFL, fcntl(ping->fd, F_GETFL) | O_NONBLOCK);
+
+    if ((connect(ping->fd, (struct sockaddr *)&ping->addr,
+                 sizeof(ping->addr)) < 0) &&
+        (errno != EINPROGRESS))
+    {
+        rpc_ping_done(ping, result, RPC_CANTSEND);
+        return;
+    }
+    ping->state = RPC_PING_CONNECT;
+}
+
+/* a datagram on the shared socket, to whichever host it belongs */
+static void rpc_ping_udp_reply(int sock, rpc_ping_t *pings, int num,
+                               int *results, u_long xid_base,
+                               int protocol,
+                               u_long program, u_long version,
+                               sigar_int64_t now)
+{
+    char buf[RPC_PING_BUFSIZ];
+    ssize_t len;
+
+    while ((len = recv(sock, buf, sizeof(buf), 0)) >= 4) {
+        sigar_uint32_t xid;
+        u_long i, port;
+        rpc_ping_t *ping;
+        enum clnt_stat status;
+
+        memcpy(&xid, buf, sizeof(xid));
+        xid = ntohl(xid) - xid_base;
+        i = xid >> 1;
+
+        if (i >= (u_long)num) {
+            continue;
+        }
+        ping = &pings[i];
+
+        if ((xid & 1) == 0) {
+            if (ping->state != RPC_PING_PMAP) {
+                continue;
+            }
+            status = rpc_ping_decode(buf, len, &port);
+            if (status != RPC_SUCCESS) {
+                rpc_ping_done(ping, &results[i], RPC_PMAPFAILURE);
+            }
+            else if (port == 0) {
+                rpc_ping_done(ping, &results[i], RPC_PROGNOTREGISTERED);
+            }
+            else {
+                rpc_ping_start_call(sock, ping, &results[i],
+                                    xid_base + (i << 1) + 1, port,
+                                    protocol, program, version, now);
+            }
+        }
+        else if (ping->state == RPC_PING_CALL) {
+            rpc_ping_done(ping, &results[i],
+                          rpc_ping_decode(buf, len, NULL));
+        }
+    }
+}
+
+static void rpc_ping_tcp_reply(rpc_ping_t *ping, int *result)
+{
+    ssize_t len = recv(ping->fd, ping->buf + ping->len,
+                       sizeof(ping->buf) - ping->len, 0);
+    sigar_uint32_t mark;
+
+    if (len <= 0) {
+        if ((len < 0) && (errno == EAGAIN || errno == EINTR)) {
+            return;
+        }
+        rpc_ping_done(ping, result, RPC_CANTRECV);
+        return;
+    }
+    ping->len += len;
+
+    if (ping->len < 4) {
+        return;
+    }
+    memcpy(&mark, ping->buf, sizeof(mark));
+    mark = ntohl(mark) & 0x7fffffff;
+
+    if (mark + 4 > sizeof(ping->buf)) {
+        rpc_ping_done(ping, result, RPC_CANTDECODERES);
+    }
+    else if (ping->len >= mark + 4) {
+        rpc_ping_done(ping, result,
+                      rpc_ping_decode(ping->buf + 4, mark, NULL));
+    }
+}
+
+SIGAR_DECLARE(int) sigar_rpc_ping_list(char **hosts,
+                                       int num,
+                                       int protocol,
+                                       unsigned long program,
+                                       unsigned long version,
+                                       int timeout,
+                                       int *results)
+{
+    rpc_ping_t *pings;
+    struct pollfd *fds;
+    sigar_int64_t now = sigar_time_now_millis();
+    sigar_int64_t deadline = now + timeout;
+    u_long xid_base;
+    int i, sock, pending = 0;
+
+    if (num <= 0) {
+        return SIGAR_OK;
+    }
+
+    if ((protocol != SIGAR_NETCONN_UDP) && (protocol != SIGAR_NETCONN_TCP)) {
+        for (i=0; i<num; i++) {
+            results[i] = RPC_UNKNOWNPROTO;
+        }
+        return SIGAR_OK;
+    }
+
+    if ((sock = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
+        return errno;
+    }
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) | O_NONBLOCK);
+
+    pings = malloc(sizeof(*pings) * num);
+    fds = malloc(sizeof(*fds) * (num + 1));
+    if (!pings || !fds) {
+        free(pings);
+        free(fds);
+        close(sock);
+        return ENOMEM;
+    }
+
+    /* two xids a host, even for GETPORT, odd for the call */
+    xid_base = (u_long)(getpid() ^ now) & 0x3fffffff;
+
+    for (i=0; i<num; i++) {
+        rpc_ping_t *ping = &pings[i];
+        enum clnt_stat status;
+
+        ping->fd = -1;
+        ping->len = 0;
+
+        /* name lookups block, what is left of the budget is shared */
+        if (sigar_time_now_millis() >= deadline) {
+            rpc_ping_done(ping, &results[i], RPC_TIMEDOUT);
+            continue;
+        }
+
+        if ((status = get_sockaddr(&ping->addr, hosts[i])) != RPC_SUCCESS) {
+            rpc_ping_done(ping, &results[i], status);
+            continue;
+        }
+
+        ping->state = RPC_PING_PMAP;
+        ping->sent = sigar_time_now_millis();
+        if (rpc_ping_send_pmap(sock, ping, xid_base + (i << 1),
+                               protocol, program, version) != SIGAR_OK)
+        {
+            rpc_ping_done(ping, &results[i], RPC_CANTSEND);
+            continue;
+        }
+        pending++;
+    }
+
+    while (pending && ((now = sigar_time_now_millis()) < deadline)) {
+        int nfds = 1, wait = (int)(deadline - now);
+
+        fds[0].fd = sock;
+        fds[0].events = POLLIN;
+        fds[0].revents = 0;
+        pending = 0;
+
+        for (i=0; i<num; i++) {
+            rpc_ping_t *ping = &pings[i];
+
+            if (ping->state == RPC_PING_DONE) {
+                continue;
+            }
+            pending++;
+
+            if (ping->fd >= 0) {
+                fds[nfds].fd = ping->fd;
+                fds[nfds].events =
+                    ping->state == RPC_PING_CONNECT ? POLLOUT : POLLIN;
+                fds[nfds].revents = 0;
+                nfds++;
+                continue;
+            }
+
+            if (now >= ping->sent + RPC_PING_RESEND) {
+                u_long xid = xid_base + (i << 1);
+
+                ping->sent = now;
+                if (ping->state == RPC_PING_PMAP) {
+                    rpc_ping_send_pmap(sock, ping, xid,
+                                       protocol, program, version);
+                }
+                else {
+                    rpc_ping_send_call(sock, ping, xid + 1,
+                                       program, version);
+                }
+            }
+            if (ping->sent + RPC_PING_RESEND - now < wait) {
+                wait = (int)(ping->sent + RPC_PING_RESEND - now);
+            }
+        }
+
+        if (!pending) {
+            break;
+        }
+
+        if (poll(fds, nfds, wait) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        now = sigar_time_now_millis();
+
+        if (fds[0].revents) {
+            rpc_ping_udp_reply(sock, pings, num, results, xid_base,
+                               protocol, program, version, now);
+        }
+
+        for (i=1; i<nfds; i++) {
+            rpc_ping_t *ping = NULL;
+            int j, err = 0;
+            socklen_t errlen = sizeof(err);
+
+            if (!fds[i].revents) {
+                continue;
+            }
+            for (j=0; j<num; j++) {
+                if (pings[j].fd == fds[i].fd) {
+                    ping = &pings[j];
+                    break;
+                }
+            }
+            if (!ping) {
+                continue;
+            }
+
+            if (ping->state == RPC_PING_CONNECT) {
+                getsockopt(ping->fd, SOL_SOCKET, SO_ERROR, &err, &errlen);
+                if (err) {
+                    rpc_ping_done(ping, &results[j], RPC_CANTSEND);
+                    continue;
+                }
+                ping->state = RPC_PING_CALL;
+                if (rpc_ping_send_call(sock, ping,
+                                       xid_base + (j << 1) + 1,
+                                       program, version) != SIGAR_OK)
+                {
+                    rpc_ping_done(ping, &results[j], RPC_CANTSEND);
+                }
+            }
+            else {
+                rpc_ping_tcp_reply(ping, &results[j]);
+            }
+        }
+    }
+
+    for (i=0; i<num; i++) {
+        if (pings[i].state != RPC_PING_DONE) {
+            rpc_ping_done(&pings[i], &results[i], RPC_TIMEDOUT);
+        }
+    }
+
+    free(pings);
+    free(fds);
+    close(sock);
+
+    return SIGAR_OK;
+}
+#endif
+
+int sigar_file2str(const char *fname, char *buffer, int buflen)
+{
+    int len, status;
+    int fd = open(fname, O_RDONLY);
+
+    SIGAR_INSTRUMENT_OPEN();
+    if (fd < 0) {
+        return ENOENT;
+    }
+
+    SIGAR_INSTRUMENT_READ();
+    if ((len = read(fd, buffer, buflen)) < 0) {
         status = errno;
     }
     else {
@@ -978,13 +2037,572 @@ int sigar_dlinfo_modules(sigar_t *sigar, sigar_proc_modules_t *procmods)
 }
 #endif
 
+/*
+ * sigar_log_impl_ring: a single producer, single consumer ring.
+ * sigar_log_printf only parses the format to copy out its arguments
+ * (strings into the entry itself), sigar_log_ring_drain formats them
+ * one conversion at a time.  formats we cannot take apart, more than
+ * LOG_RING_ARGS arguments or strings which do not fit are formatted
+ * right away into the entry instead.
+ */
+#define LOG_RING_ARGS 8
+#define LOG_RING_TEXT 256
+#define LOG_RING_MAX  (1 << 16)
+
+#if defined(WIN32)
+typedef volatile LONG log_ring_pos_t;
+#  define LOG_RING_LOAD(pos) InterlockedCompareExchange(pos, 0, 0)
+#  define LOG_RING_STORE(pos, val) InterlockedExchange(pos, val)
+#elif defined(__ATOMIC_SEQ_CST)
+typedef unsigned int log_ring_pos_t;
+#  define LOG_RING_LOAD(pos) __atomic_load_n(pos, __ATOMIC_ACQUIRE)
+#  define LOG_RING_STORE(pos, val) \
+    __atomic_store_n(pos, val, __ATOMIC_RELEASE)
+#elif defined(__GNUC__)
+typedef volatile unsigned int log_ring_pos_t;
+#  define LOG_RING_LOAD(pos) __sync_fetch_and_add(pos, 0)
+#  define LOG_RING_STORE(pos, val) \
+    do { \
+        __sync_synchronize(); \
+        *(pos) = (val); \
+    } while (0)
+#else
+/* no atomics known for this compiler, drain from the logging thread */
+typedef volatile unsigned int log_ring_pos_t;
+#  define LOG_RING_LOAD(pos) (*(pos))
+#  define LOG_RING_STORE(pos, val) (*(pos) = (val))
+#endif
+
+#ifndef va_copy
+#  ifdef __va_copy
+#    define va_copy __va_copy
+#  else
+#    define va_copy(dst, src) ((dst) = (src))
+#  endif
+#endif
+
+enum {
+    LOG_LEN_NONE,
+    LOG_LEN_HH,
+    LOG_LEN_H,
+    LOG_LEN_L,
+    LOG_LEN_LL,
+    LOG_LEN_Z,
+    LOG_LEN_LD
+};
+
+typedef struct {
+    const char *flags;
+    int flags_len;
+    const char *width;  /* NULL for '*' */
+    int width_len;
+    int width_arg;
+    int has_prec;
+    const char *prec;
+    int prec_len;
+    int prec_arg;
+    int length;
+    char conv;
+    const char *end;
+} log_spec_t;
+
+typedef union {
+    sigar_int64_t i;
+    sigar_uint64_t u;
+    double d;
+    long double ld;
+    const void *p;
+    int off;
+} log_arg_t;
+
+typedef struct {
+    int level;
+    const char *format; /* NULL once text holds the message */
+    int nargs;
+    log_arg_t args[LOG_RING_ARGS];
+    char text[LOG_RING_TEXT]; /* %s arguments or the message */
+} log_ring_entry_t;
+
+struct sigar_log_ring_t {
+    unsigned int size;
+    log_ring_pos_t head; /* next entry to fill */
+    log_ring_pos_t tail; /* next entry to drain */
+    sigar_uint64_t dropped;
+    log_ring_entry_t *entries;
+};
+
+/* ptr points at a '%' which does not start "%%" */
+static int log_spec_parse(const char *ptr, log_spec_t *spec)
+{
+    memset(spec, 0, sizeof(*spec));
+
+    spec->flags = ++ptr;
+    while (*ptr && strchr("-+ #0", *ptr)) {
+        ptr++;
+    }
+    spec->flags_len = ptr - spec->flags;
+
+    if (*ptr == '*') {
+        spec->width_arg = 1;
+        ptr++;
+    }
+    else {
+        spec->width = ptr;
+        while (sigar_isdigit(*ptr)) {
+            ptr++;
+        }
+        spec->width_len = ptr - spec->width;
+    }
+
+    if (*ptr == '.') {
+        spec->has_prec = 1;
+        ptr++;
+        if (*ptr == '*') {
+            spec->prec_arg = 1;
+            ptr++;
+        }
+        else {
+            spec->prec = ptr;
+            while (sigar_isdigit(*ptr)) {
+                ptr++;
+            }
+            spec->prec_len = ptr - spec->prec;
+        }
+    }
+
+    switch (*ptr) {
+      case 'h':
+        if (*++ptr == 'h') {
+            spec->length = LOG_LEN_HH;
+            ptr++;
+        }
+        else {
+            spec->length = LOG_LEN_H;
+        }
+        break;
+      case 'l':
+        if (*++ptr == 'l') {
+            spec->length = LOG_LEN_LL;
+            ptr++;
+        }
+        else {
+            spec->length = LOG_LEN_L;
+        }
+        break;
+      case 'z':
+        spec->length = LOG_LEN_Z;
+        ptr++;
+        break;
+      case 'L':
+        spec->length = LOG_LEN_LD;
+        ptr++;
+        break;
+    }
+
+    if (!*ptr || !strchr("diouxXcspeEfFgGaA", *ptr)) {
+        return -1; /* %n, %I64d, %ls and friends */
+    }
+    spec->conv = *ptr++;
+    spec->end = ptr;
+
+    if (((spec->conv == 'c') || (spec->conv == 's') ||
+         (spec->conv == 'p')) && (spec->length != LOG_LEN_NONE))
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+static int log_ring_capture(log_ring_entry_t *entry,
+                            const char *format, va_list args)
+{
+    const char *ptr = format;
+    int n = 0, text = 0;
+
+    while ((ptr = strchr(ptr, '%'))) {
+        log_spec_t spec;
+        log_arg_t *arg;
+
+        if (ptr[1] == '%') {
+            ptr += 2;
+            continue;
+        }
+        if (log_spec_parse(ptr, &spec) < 0) {
+            return -1;
+        }
+        if (n + spec.width_arg + spec.prec_arg >= LOG_RING_ARGS) {
+            return -1;
+        }
+        if (spec.width_arg) {
+            entry->args[n++].i = va_arg(args, int);
+        }
+        if (spec.prec_arg) {
+            entry->args[n++].i = va_arg(args, int);
+        }
+
+        arg = &entry->args[n++];
+
+        switch (spec.conv) {
+          case 'd':
+          case 'i':
+            switch (spec.length) {
+              case LOG_LEN_HH:
+                arg->i = (signed char)va_arg(args, int);
+                break;
+              case LOG_LEN_H:
+                arg->i = (short)va_arg(args, int);
+                break;
+              case LOG_LEN_L:
+                arg->i = va_arg(args, long);
+                break;
+              case LOG_LEN_LL:
+                arg->i = va_arg(args, long long);
+                break;
+              case LOG_LEN_Z:
+                arg->i = va_arg(args, size_t);
+                break;
+              case LOG_LEN_NONE:
+                arg->i = va_arg(args, int);
+                break;
+              default:
+                return -1;
+            }
+            break;
+          case 'o':
+          case 'u':
+          case 'x':
+          case 'X':
+            switch (spec.length) {
+              case LOG_LEN_HH:
+                arg->u = (unsigned char)va_arg(args, unsigned int);
+                break;
+              case LOG_LEN_H:
+                arg->u = (unsigned short)va_arg(args, unsigned int);
+                break;
+              case LOG_LEN_L:
+                arg->u = va_arg(args, unsigned long);
+                break;
+              case LOG_LEN_LL:
+                arg->u = va_arg(args, unsigned long long);
+                break;
+              case LOG_LEN_Z:
+                arg->u = va_arg(args, size_t);
+                break;
+              case LOG_LEN_NONE:
+                arg->u = va_arg(args, unsigned int);
+                break;
+              default:
+                return -1;
+            }
+            break;
+          case 'c':
+            arg->i = va_arg(args, int);
+            break;
+          case 'p':
+            arg->p = va_arg(args, void *);
+            break;
+          case 's':
+            {
+                const char *str = va_arg(args, const char *);
+                int len;
+
+                if (!str) {
+                    str = "(null)";
+                }
+                len = strlen(str) + 1;
+                if (text + len > LOG_RING_TEXT) {
+                    return -1;
+                }
+                memcpy(&entry->text[text], str, len);
+                arg->off = text;
+                text += len;
+            }
+            break;
+          default:
+            if (spec.length == LOG_LEN_LD) {
+                arg->ld = va_arg(args, long double);
+            }
+            else if (spec.length == LOG_LEN_NONE) {
+                arg->d = va_arg(args, double);
+            }
+            else {
+                return -1;
+            }
+            break;
+        }
+
+        ptr = spec.end;
+    }
+
+    entry->nargs = n;
+    entry->format = format;
+
+    return 0;
+}
+
+/* formats one conversion of entry at args[*n] onto buffer */
+static int log_spec_format(log_ring_entry_t *entry, log_spec_t *spec,
+                           int *n, char *buffer, int buflen)
+{
+    char fmt[64];
+    int len = 0, width = 0, prec = -1;
+    log_arg_t *arg;
+
+    if (spec->width_arg) {
+        width = (int)entry->args[(*n)++].i;
+    }
+    if (spec->prec_arg) {
+        prec = (int)entry->args[(*n)++].i;
+    }
+    arg = &entry->args[(*n)++];
+
+    if ((spec->flags_len + spec->width_len + spec->prec_len) >
+        (int)sizeof(fmt) - 32)
+    {
+        return 0;
+    }
+
+    fmt[len++] = '%';
+    memcpy(&fmt[len], spec->flags, spec->flags_len);
+    len += spec->flags_len;
+    if (spec->width_arg) {
+        len += sprintf(&fmt[len], "%d", width);
+    }
+    else {
+        memcpy(&fmt[len], spec->width, spec->width_len);
+        len += spec->width_len;
+    }
+    if (spec->prec_arg) {
+        if (prec >= 0) {
+            len += sprintf(&fmt[len], ".%d", prec);
+        }
+    }
+    else if (spec->has_prec) {
+        fmt[len++] = '.';
+        memcpy(&fmt[len], spec->prec, spec->prec_len);
+        len += spec->prec_len;
+    }
+
+    switch (spec->conv) {
+      case 'd':
+      case 'i':
+      case 'o':
+      case 'u':
+      case 'x':
+      case 'X':
+        fmt[len++] = 'l';
+        fmt[len++] = 'l';
+        break;
+    }
+    if (spec->length == LOG_LEN_LD) {
+        fmt[len++] = 'L';
+    }
+    fmt[len++] = spec->conv;
+    fmt[len] = '\0';
+
+    switch (spec->conv) {
+      case 'd':
+      case 'i':
+        len = snprintf(buffer, buflen, fmt, (long long)arg->i);
+        break;
+      case 'o':
+      case 'u':
+      case 'x':
+      case 'X':
+        len = snprintf(buffer, buflen, fmt, (unsigned long long)arg->u);
+        break;
+      case 'c':
+        len = snprintf(buffer, buflen, fmt, (int)arg->i);
+        break;
+      case 'p':
+        len = snprintf(buffer, buflen, fmt, arg->p);
+        break;
+      case 's':
+        len = snprintf(buffer, buflen, fmt, &entry->text[arg->off]);
+        break;
+      default:
+        len = (spec->length == LOG_LEN_LD) ?
+            snprintf(buffer, buflen, fmt, arg->ld) :
+            snprintf(buffer, buflen, fmt, arg->d);
+        break;
+    }
+
+    if (len < 0) {
+        return 0;
+    }
+    return len < buflen ? len : buflen - 1;
+}
+
+static void log_ring_format(log_ring_entry_t *entry,
+                            char *buffer, int buflen)
+{
+    const char *ptr = entry->format, *pct;
+    int len = 0, n = 0;
+
+    while ((len < buflen - 1) && (pct = strchr(ptr, '%'))) {
+        log_spec_t spec;
+        int chunk = pct - ptr;
+
+        if (chunk > buflen - 1 - len) {
+            chunk = buflen - 1 - len;
+        }
+        memcpy(&buffer[len], ptr, chunk);
+        len += chunk;
+
+        if (pct[1] == '%') {
+            if (len < buflen - 1) {
+                buffer[len++] = '%';
+            }
+            ptr = pct + 2;
+            continue;
+        }
+
+        log_spec_parse(pct, &spec); /* parsed fine in capture */
+        len += log_spec_format(entry, &spec, &n,
+                               &buffer[len], buflen - len);
+        ptr = spec.end;
+    }
+
+    if (len < buflen - 1) {
+        int rest = strlen(ptr);
+        if (rest > buflen - 1 - len) {
+            rest = buflen - 1 - len;
+        }
+        memcpy(&buffer[len], ptr, rest);
+        len += rest;
+    }
+
+    buffer[len] = '\0';
+}
+
+/* NULL when full */
+static log_ring_entry_t *log_ring_next(sigar_log_ring_t *ring)
+{
+    unsigned int head = LOG_RING_LOAD(&ring->head);
+
+    if (head - LOG_RING_LOAD(&ring->tail) >= ring->size) {
+        ring->dropped++;
+        return NULL;
+    }
+
+    return &ring->entries[head & (ring->size - 1)];
+}
+
+static void log_ring_push(sigar_log_ring_t *ring)
+{
+    LOG_RING_STORE(&ring->head, LOG_RING_LOAD(&ring->head) + 1);
+}
+
+static void log_ring_vprintf(sigar_log_ring_t *ring, int level,
+                             const char *format, va_list args)
+{
+    log_ring_entry_t *entry = log_ring_next(ring);
+    va_list copy;
+
+    if (!entry) {
+        return;
+    }
+
+    entry->level = level;
+
+    va_copy(copy, args);
+    if (log_ring_capture(entry, format, copy) < 0) {
+        entry->format = NULL;
+        vsnprintf(entry->text, sizeof(entry->text), format, args);
+    }
+    va_end(copy);
+
+    log_ring_push(ring);
+}
+
+SIGAR_DECLARE(int) sigar_log_ring_create(sigar_log_ring_t **ring,
+                                         unsigned int size)
+{
+    unsigned int n = 1;
+
+    while ((n < size) && (n < LOG_RING_MAX)) {
+        n <<= 1;
+    }
+
+    *ring = calloc(1, sizeof(**ring));
+    if (!*ring) {
+        return ENOMEM;
+    }
+
+    (*ring)->size = n;
+    (*ring)->entries = malloc(n * sizeof(*(*ring)->entries));
+    if (!(*ring)->entries) {
+        free(*ring);
+        *ring = NULL;
+        return ENOMEM;
+    }
+
+    return SIGAR_OK;
+}
+
+SIGAR_DECLARE(void) sigar_log_ring_destroy(sigar_log_ring_t *ring)
+{
+    free(ring->entries);
+    free(ring);
+}
+
+SIGAR_DECLARE(void) sigar_log_impl_ring(sigar_t *sigar, void *data,
+                                        int level, char *message)
+{
+    sigar_log_ring_t *ring = (sigar_log_ring_t *)data;
+    log_ring_entry_t *entry = log_ring_next(ring);
+
+    if (!entry) {
+        return;
+    }
+
+    entry->level = level;
+    entry->format = NULL;
+    SIGAR_SSTRCPY(entry->text, message);
+
+    log_ring_push(ring);
+}
+
+SIGAR_DECLARE(int) sigar_log_ring_drain(sigar_log_ring_t *ring,
+                                        sigar_t *sigar,
+                                        sigar_log_impl_t impl,
+                                        void *data)
+{
+    unsigned int tail = LOG_RING_LOAD(&ring->tail);
+    unsigned int head = LOG_RING_LOAD(&ring->head);
+    int count = 0;
+    char buffer[8192];
+
+    for (; tail != head; tail++, count++) {
+        log_ring_entry_t *entry = &ring->entries[tail & (ring->size - 1)];
+
+        if (entry->format) {
+            log_ring_format(entry, buffer, sizeof(buffer));
+            impl(sigar, data, entry->level, buffer);
+        }
+        else {
+            impl(sigar, data, entry->level, entry->text);
+        }
+
+        LOG_RING_STORE(&ring->tail, tail + 1);
+    }
+
+    return count;
+}
+
+SIGAR_DECLARE(sigar_uint64_t) sigar_log_ring_dropped(sigar_log_ring_t *ring)
+{
+    return ring->dropped;
+}
+
 SIGAR_DECLARE(void) sigar_log_printf(sigar_t *sigar, int level,
                                      const char *format, ...)
 {
     va_list args;
     char buffer[8192];
 
-    if (level > sigar->log_level) {
+    if ((level > SIGAR_LOG_MAX_LEVEL) || (level > sigar->log_level)) {
         return;
     }
 
@@ -993,6 +2611,13 @@ SIGAR_DECLARE(void) sigar_log_printf(sigar_t *sigar, int level,
     }
 
     va_start(args, format);
+    if (sigar->log_impl == sigar_log_impl_ring) {
+        /* formatted when drained */
+        log_ring_vprintf((sigar_log_ring_t *)sigar->log_data,
+                         level, format, args);
+        va_end(args);
+        return;
+    }
     vsnprintf(buffer, sizeof(buffer), format, args);
     va_end(args);
 
@@ -1001,7 +2626,7 @@ SIGAR_DECLARE(void) sigar_log_printf(sigar_t *sigar, int level,
 
 SIGAR_DECLARE(void) sigar_log(sigar_t *sigar, int level, char *message)
 {
-    if (level > sigar->log_level) {
+    if ((level > SIGAR_LOG_MAX_LEVEL) || (level > sigar->log_level)) {
         return;
     }
 
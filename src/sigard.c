@@ -0,0 +1,166 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * serves sigar_remote requests, a child with its own sigar_t per
+ * connection.  -i answers on stdin instead, as started by inetd.
+ *
+ *   sigard [-b address] [-p port] [-i]
+ */
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <unistd.h>
+
+#include "sigar.h"
+#include "sigar_remote.h"
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: sigard [-b address] [-p port] [-i]\n");
+    exit(2);
+}
+
+static int serve(int fd)
+{
+    sigar_t *sigar;
+    int status;
+
+    if ((status = sigar_open(&sigar)) != SIGAR_OK) {
+        fprintf(stderr, "sigard: sigar_open: %s\n", strerror(status));
+        return status;
+    }
+
+    if ((status = sigar_remote_serve(sigar, fd)) != SIGAR_OK) {
+        fprintf(stderr, "sigard: %s\n", sigar_strerror(sigar, status));
+    }
+
+    sigar_close(sigar);
+
+    return status;
+}
+
+static int listen_on(const char *address, const char *port)
+{
+    struct addrinfo hints, *list, *ai;
+    int fd = -1, on = 1, status;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+
+    if ((status = getaddrinfo(address, port, &hints, &list)) != 0) {
+        fprintf(stderr, "sigard: %s\n", gai_strerror(status));
+        return -1;
+    }
+
+    for (ai = list; ai; ai = ai->ai_next) {
+        if ((fd = socket(ai->ai_family, ai->ai_socktype,
+                         ai->ai_protocol)) < 0)
+        {
+            continue;
+        }
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        if ((bind(fd, ai->ai_addr, ai->ai_addrlen) == 0) &&
+            (listen(fd, 128) == 0))
+        {
+            break;
+        }
+        close(fd);
+        fd = -1;
+    }
+
+    freeaddrinfo(list);
+
+    if (fd < 0) {
+        fprintf(stderr, "sigard: listen on %s: %s\n", port, strerror(errno));
+    }
+
+    return fd;
+}
+
+int main(int argc, char **argv)
+{
+    const char *address = NULL;
+    char port[16];
+    int opt, fd, inetd = 0;
+
+    snprintf(port, sizeof(port), "%d", SIGAR_REMOTE_PORT);
+
+    while ((opt = getopt(argc, argv, "b:p:i")) != -1) {
+        switch (opt) {
+          case 'b':
+            address = optarg;
+            break;
+          case 'p':
+            snprintf(port, sizeof(port), "%s", optarg);
+            break;
+          case 'i':
+            inetd = 1;
+            break;
+          default:
+            usage();
+        }
+    }
+
+    /* a client going away shows up as EPIPE, not a dead daemon */
+    signal(SIGPIPE, SIG_IGN);
+
+    if (inetd) {
+        return serve(0) == SIGAR_OK ? 0 : 1;
+    }
+
+    if ((fd = listen_on(address, port)) < 0) {
+        return 1;
+    }
+
+    /* children are not waited for */
+    signal(SIGCHLD, SIG_IGN);
+
+    while (1) {
+        int client = accept(fd, NULL, NULL), on = 1;
+        pid_t pid;
+
+        if (client < 0) {
+            if (errno != EINTR) {
+                perror("sigard: accept");
+            }
+            continue;
+        }
+
+        setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+        if ((pid = fork()) == 0) {
+            close(fd);
+            _exit(serve(client) == SIGAR_OK ? 0 : 1);
+        }
+        if (pid < 0) {
+            perror("sigard: fork");
+        }
+
+        close(client);
+    }
+
+    return 0;
+}
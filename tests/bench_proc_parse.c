@@ -0,0 +1,304 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * ns per parse for the shared /proc tokenizer vs. the strstr and
+ * sscanf/strtoull code it replaced, and for the 32 digit tcp6 address
+ * decode vs. the per digit loop, and for a 128 cpu /proc/interrupts
+ * row with sigar_scan_counters vs. sigar_scan_columns, on fixed sample
+ * buffers:
+ *   ./bench_proc_parse [rounds]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "sigar.h"
+#include "sigar_private.h"
+#include "sigar_util.h"
+
+static const char status_sample[] =
+	"Name:\tbench_proc_parse\n"
+	"Umask:\t0022\n"
+	"State:\tR (running)\n"
+	"Tgid:\t4242\n"
+	"Ngid:\t0\n"
+	"Pid:\t4242\n"
+	"PPid:\t4000\n"
+	"TracerPid:\t0\n"
+	"Uid:\t1000\t1000\t1000\t1000\n"
+	"Gid:\t1000\t1000\t1000\t1000\n"
+	"FDSize:\t256\n"
+	"Groups:\t4 24 27 30 46 100 118 1000\n"
+	"VmPeak:\t  223844 kB\n"
+	"VmSize:\t  223844 kB\n"
+	"VmLck:\t       0 kB\n"
+	"VmHWM:\t    6012 kB\n"
+	"VmRSS:\t    6012 kB\n"
+	"VmData:\t    1204 kB\n"
+	"VmStk:\t     132 kB\n"
+	"VmExe:\t      20 kB\n"
+	"VmLib:\t    3680 kB\n"
+	"VmPTE:\t      76 kB\n"
+	"VmSwap:\t       0 kB\n"
+	"Threads:\t1\n"
+	"SigQ:\t0/63414\n"
+	"SigPnd:\t0000000000000000\n"
+	"Cpus_allowed_list:\t0-7\n"
+	"voluntary_ctxt_switches:\t3\n"
+	"nonvoluntary_ctxt_switches:\t1\n";
+
+static const char diskstats_sample[] =
+	" 259       0 nvme0n1 493014 118206 32236574 98260 1254961 1044817 "
+	"68501954 1519127 0 1002140 1643513 0 0 0 0 77712 26124\n";
+
+static const char tcp6_sample[] =
+	"0000000000000000FFFF00000100007F";
+
+static sigar_int64_t bench_ns(sigar_int64_t start, sigar_uint64_t ops) {
+	sigar_int64_t millis = sigar_time_now_millis() - start;
+	if (millis <= 0) {
+		millis = 1;
+	}
+	return (millis * 1000000) / (sigar_int64_t)ops;
+}
+
+/* what sigar_proc_cred_get and proc_status_get used to do */
+static sigar_uint64_t legacy_status(char *buffer) {
+	sigar_uint64_t sum = 0;
+	char *ptr;
+
+	if ((ptr = strstr(buffer, "\nUid:"))) {
+		ptr = sigar_skip_token(ptr);
+		sum += sigar_strtoul(ptr);
+		sum += sigar_strtoul(ptr);
+	}
+	if ((ptr = strstr(ptr, "\nGid:"))) {
+		ptr = sigar_skip_token(ptr);
+		sum += sigar_strtoul(ptr);
+		sum += sigar_strtoul(ptr);
+	}
+	if ((ptr = strstr(buffer, "\nThreads:"))) {
+		ptr = sigar_skip_token(ptr);
+		sum += sigar_strtoul(ptr);
+	}
+
+	return sum;
+}
+
+static sigar_uint64_t keyval_status(char *buffer) {
+	sigar_keyval_t keys[] = {
+		SIGAR_KEYVAL("Uid:"),
+		SIGAR_KEYVAL("Gid:"),
+		SIGAR_KEYVAL("Threads:")
+	};
+	sigar_uint64_t sum = 0;
+	char *ptr;
+	int i;
+
+	sigar_keyval_scan(buffer, keys, 3);
+
+	for (i = 0; i < 2; i++) {
+		if ((ptr = keys[i].value)) {
+			sum += sigar_strtoul(ptr);
+			sum += sigar_strtoul(ptr);
+		}
+	}
+	if ((ptr = keys[2].value)) {
+		sum += sigar_strtoul(ptr);
+	}
+
+	return sum;
+}
+
+static sigar_uint64_t legacy_diskstats(char *buffer) {
+	unsigned long major, minor, f[11];
+	char *ptr = buffer;
+
+	major = sigar_strtoul(ptr);
+	minor = sigar_strtoul(ptr);
+	ptr = sigar_skip_token(ptr);
+
+	sscanf(ptr, "%lu %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu",
+	       &f[0], &f[1], &f[2], &f[3], &f[4], &f[5],
+	       &f[6], &f[7], &f[8], &f[9], &f[10]);
+
+	return major + minor + f[0] + f[10];
+}
+
+static sigar_uint64_t scan_diskstats(char *buffer, char *end) {
+	sigar_uint64_t f[13];
+	char *ptr = buffer;
+
+	sigar_scan_columns(&ptr, end, f, 2);
+	ptr = sigar_scan_field(sigar_scan_blanks(ptr, end), end);
+	sigar_scan_columns(&ptr, end, &f[2], 11);
+
+	return f[0] + f[1] + f[2] + f[12];
+}
+
+/* what convert_hex_address used to do, one hex2int per word */
+static sigar_uint64_t legacy_hex6(const char *hex) {
+	sigar_uint32_t words[4];
+	int i, n;
+
+	for (i = 0; i < 4; i++, hex += 8) {
+		unsigned int j = 0;
+		for (n = 0; n < 8; n++) {
+			int ch = hex[n];
+			j <<= 4;
+			if (isdigit(ch)) {
+				j |= ch - '0';
+			}
+			else if (isupper(ch)) {
+				j |= ch - ('A' - 10);
+			}
+			else {
+				j |= ch - ('a' - 10);
+			}
+		}
+		words[i] = j;
+	}
+
+	return (sigar_uint64_t)words[0] + words[1] + words[2] + words[3];
+}
+
+static sigar_uint64_t decode_hex6(const char *hex) {
+	sigar_uint32_t words[4];
+
+	sigar_hex_decode128(hex, words);
+
+	return (sigar_uint64_t)words[0] + words[1] + words[2] + words[3];
+}
+
+#define IRQ_NCPU 128
+
+/* "  24:" then a %10u column per cpu, as the kernel pads them */
+static char *irq_row(size_t *len) {
+	char *row = malloc(8 + IRQ_NCPU * 11 + 64), *ptr = row;
+	int cpu;
+
+	ptr += sprintf(ptr, "  24:");
+	for (cpu = 0; cpu < IRQ_NCPU; cpu++) {
+		ptr += sprintf(ptr, " %10u", (cpu * 2654435761U) >> (cpu % 24));
+	}
+	ptr += sprintf(ptr, "   IR-PCI-MSI 524288-edge      eth0-TxRx-0\n");
+	*len = ptr - row;
+
+	return row;
+}
+
+static sigar_uint64_t irq_columns(char *row, char *end) {
+	sigar_uint64_t counts[IRQ_NCPU];
+	char *ptr = row + 5;
+
+	sigar_scan_columns(&ptr, end, counts, IRQ_NCPU);
+
+	return counts[0] + counts[IRQ_NCPU - 1] + counts[IRQ_NCPU / 2];
+}
+
+static sigar_uint64_t irq_counters(char *row, char *end) {
+	sigar_uint64_t counts[IRQ_NCPU];
+	char *ptr = row + 5;
+
+	sigar_scan_counters(&ptr, end, counts, IRQ_NCPU);
+
+	return counts[0] + counts[IRQ_NCPU - 1] + counts[IRQ_NCPU / 2];
+}
+
+int main(int argc, char **argv) {
+	int rounds = argc > 1 ? atoi(argv[1]) : 20;
+	sigar_uint64_t ops = (sigar_uint64_t)rounds * 50000, i, check = 0;
+	char status[sizeof(status_sample)], disk[sizeof(diskstats_sample)];
+	char *disk_end = disk + sizeof(disk) - 1;
+	char tcp6[sizeof(tcp6_sample)];
+	size_t irq_len;
+	char *irq = irq_row(&irq_len), *irq_end = irq + irq_len;
+	sigar_int64_t start;
+
+	memcpy(status, status_sample, sizeof(status));
+	memcpy(disk, diskstats_sample, sizeof(disk));
+	memcpy(tcp6, tcp6_sample, sizeof(tcp6));
+
+	if ((legacy_status(status) != keyval_status(status)) ||
+	    (legacy_diskstats(disk) != scan_diskstats(disk, disk_end)) ||
+	    (legacy_hex6(tcp6) != decode_hex6(tcp6)) ||
+	    (irq_columns(irq, irq_end) != irq_counters(irq, irq_end)))
+	{
+		fprintf(stderr, "parsers disagree\n");
+		return 1;
+	}
+
+	start = sigar_time_now_millis();
+	for (i = 0; i < ops; i++) {
+		check += legacy_status(status);
+	}
+	printf("status   strstr    %6lld ns/parse\n",
+	       (long long)bench_ns(start, ops));
+
+	start = sigar_time_now_millis();
+	for (i = 0; i < ops; i++) {
+		check += keyval_status(status);
+	}
+	printf("status   keyval    %6lld ns/parse\n",
+	       (long long)bench_ns(start, ops));
+
+	start = sigar_time_now_millis();
+	for (i = 0; i < ops; i++) {
+		check += legacy_diskstats(disk);
+	}
+	printf("diskstat sscanf    %6lld ns/parse\n",
+	       (long long)bench_ns(start, ops));
+
+	start = sigar_time_now_millis();
+	for (i = 0; i < ops; i++) {
+		check += scan_diskstats(disk, disk_end);
+	}
+	printf("diskstat columns   %6lld ns/parse\n",
+	       (long long)bench_ns(start, ops));
+
+	start = sigar_time_now_millis();
+	for (i = 0; i < ops; i++) {
+		check += legacy_hex6(tcp6);
+	}
+	printf("tcp6     hex2int   %6lld ns/parse\n",
+	       (long long)bench_ns(start, ops));
+
+	start = sigar_time_now_millis();
+	for (i = 0; i < ops; i++) {
+		check += decode_hex6(tcp6);
+	}
+	printf("tcp6     decode128 %6lld ns/parse\n",
+	       (long long)bench_ns(start, ops));
+
+	start = sigar_time_now_millis();
+	for (i = 0; i < ops; i++) {
+		check += irq_columns(irq, irq_end);
+	}
+	printf("irq row  columns   %6lld ns/parse\n",
+	       (long long)bench_ns(start, ops));
+
+	start = sigar_time_now_millis();
+	for (i = 0; i < ops; i++) {
+		check += irq_counters(irq, irq_end);
+	}
+	printf("irq row  counters  %6lld ns/parse\n",
+	       (long long)bench_ns(start, ops));
+
+	free(irq);
+
+	return check ? 0 : 1;
+}
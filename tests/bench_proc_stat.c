@@ -0,0 +1,185 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * ns per process to read and parse /proc/<pid>/stat, the path
+ * behind sigar_proc_time_get (plain, sigar_proc_pin, taskstats) vs.
+ * the original file2str reader:
+ *   ./bench_proc_stat [rounds]
+ */
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "sigar.h"
+#include "sigar_private.h"
+#include "sigar_util.h"
+
+typedef struct {
+	sigar_uint64_t ppid, minor_faults, major_faults, utime, stime;
+	sigar_uint64_t start_time, vsize, rss;
+	int tty, priority, nice, processor;
+	char state;
+	char name[SIGAR_PROC_NAME_LEN];
+} legacy_proc_stat_t;
+
+static char *legacy_skip_token(char *p) {
+	while (sigar_isspace(*p)) p++;
+	while (*p && !sigar_isspace(*p)) p++;
+	return p;
+}
+
+/* proc_stat_read as it was: path formatting, open, sigar_skip_token */
+static int legacy_proc_stat_read(sigar_pid_t pid, legacy_proc_stat_t *pstat) {
+	char buffer[BUFSIZ], *ptr = buffer, *tmp;
+	unsigned int len;
+	int i, status = SIGAR_PROC_FILE2STR(buffer, pid, "/stat");
+
+	if (status != SIGAR_OK) {
+		return status;
+	}
+	if (!(ptr = strchr(ptr, '(')) || !(tmp = strrchr(++ptr, ')'))) {
+		return -1;
+	}
+	len = tmp - ptr;
+	if (len >= sizeof(pstat->name)) {
+		len = sizeof(pstat->name) - 1;
+	}
+	memcpy(pstat->name, ptr, len);
+	pstat->name[len] = '\0';
+	ptr = tmp + 1;
+
+	SIGAR_SKIP_SPACE(ptr);
+	pstat->state = *ptr++;
+	SIGAR_SKIP_SPACE(ptr);
+
+	pstat->ppid = sigar_strtoul(ptr);
+	ptr = legacy_skip_token(ptr);
+	ptr = legacy_skip_token(ptr);
+	pstat->tty = sigar_strtoul(ptr);
+	ptr = legacy_skip_token(ptr);
+	ptr = legacy_skip_token(ptr);
+	pstat->minor_faults = sigar_strtoull(ptr);
+	ptr = legacy_skip_token(ptr);
+	pstat->major_faults = sigar_strtoull(ptr);
+	ptr = legacy_skip_token(ptr);
+	pstat->utime = sigar_strtoull(ptr);
+	pstat->stime = sigar_strtoull(ptr);
+	ptr = legacy_skip_token(ptr);
+	ptr = legacy_skip_token(ptr);
+	pstat->priority = sigar_strtoul(ptr);
+	pstat->nice = sigar_strtoul(ptr);
+	ptr = legacy_skip_token(ptr);
+	ptr = legacy_skip_token(ptr);
+	pstat->start_time = sigar_strtoul(ptr);
+	pstat->vsize = sigar_strtoull(ptr);
+	pstat->rss = sigar_strtoull(ptr);
+	for (i = 25; i <= 38; i++) {
+		ptr = legacy_skip_token(ptr);
+	}
+	pstat->processor = sigar_strtoul(ptr);
+
+	return SIGAR_OK;
+}
+
+static sigar_uint64_t now_nsec(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (sigar_uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+int main(int argc, char **argv) {
+	sigar_t *sigar, *taskstats;
+	sigar_proc_list_t pids;
+	sigar_uint64_t start, legacy_ns, sigar_ns, pinned_ns, taskstats_ns, n;
+	unsigned long i;
+	int r, rounds = argc > 1 ? atoi(argv[1]) : 20;
+
+	if (sigar_open(&sigar) != SIGAR_OK) {
+		fprintf(stderr, "sigar_open failed\n");
+		return 1;
+	}
+	/* every sigar_proc_time_get reads and parses the file */
+	sigar_proc_cache_expire_set(sigar, 0);
+
+	if (sigar_proc_list_get(sigar, &pids) != SIGAR_OK) {
+		fprintf(stderr, "sigar_proc_list_get failed\n");
+		return 1;
+	}
+	n = (sigar_uint64_t)rounds * pids.number;
+	if (n == 0) {
+		n = 1;
+	}
+
+	start = now_nsec();
+	for (r = 0; r < rounds; r++) {
+		for (i = 0; i < pids.number; i++) {
+			legacy_proc_stat_t pstat;
+			legacy_proc_stat_read(pids.data[i], &pstat);
+		}
+	}
+	legacy_ns = now_nsec() - start;
+
+	start = now_nsec();
+	for (r = 0; r < rounds; r++) {
+		for (i = 0; i < pids.number; i++) {
+			sigar_proc_time_t ptime;
+			sigar_proc_time_get(sigar, pids.data[i], &ptime);
+		}
+	}
+	sigar_ns = now_nsec() - start;
+
+	for (i = 0; i < pids.number; i++) {
+		sigar_proc_pin(sigar, pids.data[i]);
+	}
+	start = now_nsec();
+	for (r = 0; r < rounds; r++) {
+		for (i = 0; i < pids.number; i++) {
+			sigar_proc_time_t ptime;
+			sigar_proc_time_get(sigar, pids.data[i], &ptime);
+		}
+	}
+	pinned_ns = now_nsec() - start;
+
+	/* falls back to procfs if taskstats is not usable */
+	setenv("SIGAR_PROC_TASKSTATS", "1", 1);
+	sigar_open(&taskstats);
+	start = now_nsec();
+	for (r = 0; r < rounds; r++) {
+		for (i = 0; i < pids.number; i++) {
+			sigar_proc_time_t ptime;
+			sigar_proc_time_get(taskstats, pids.data[i], &ptime);
+		}
+	}
+	taskstats_ns = now_nsec() - start;
+	sigar_close(taskstats);
+
+	printf("%lu processes x %d rounds\n", pids.number, rounds);
+	printf("%-24s %8.0f ns/process\n", "file2str + skip_token",
+	       (double)legacy_ns / n);
+	printf("%-24s %8.0f ns/process\n", "sigar_proc_time_get",
+	       (double)sigar_ns / n);
+	printf("%-24s %8.0f ns/process\n", "pinned",
+	       (double)pinned_ns / n);
+	printf("%-24s %8.0f ns/process\n", "SIGAR_PROC_TASKSTATS=1",
+	       (double)taskstats_ns / n);
+
+	sigar_proc_list_destroy(sigar, &pids);
+	sigar_close(sigar);
+
+	return 0;
+}
@@ -0,0 +1,658 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * cost of every sigar.h getter, cold (first call on a new handle) and
+ * warm (the same handle again, caches filled), plus ptql and
+ * sigar_cache_t microbenchmarks.  ns, syscalls and bytes allocated per
+ * call are written as JSON to compare between releases:
+ *   ./bench_sigar_api [iterations] > bench.json
+ *
+ * with glibc the syscalls are counted by the wrappers below, which
+ * libsigar's calls into libc resolve to.  calls libc makes on its own
+ * behalf, e.g. the reads under fgets, are not seen, so stdio readers
+ * count their fopen and fclose only.  elsewhere syscalls and bytes
+ * are -1.
+ *
+ * SIGAR_PROC_ROOT runs it against a procfs_fixture tree instead.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "sigar.h"
+#include "sigar_private.h"
+#include "sigar_util.h"
+#include "sigar_ptql.h"
+
+static sigar_uint64_t bench_syscalls, bench_bytes;
+
+#if defined(__GLIBC__) && defined(__linux__)
+
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+
+#define BENCH_COUNTING 1
+
+#define BENCH_REAL(name, ret, params) \
+	static ret (*real) params; \
+	if (!real) { \
+		real = (ret (*) params)dlsym(RTLD_NEXT, #name); \
+	}
+
+#define BENCH_SHIM(ret, name, params, args) \
+	ret name params { \
+		BENCH_REAL(name, ret, params); \
+		bench_syscalls++; \
+		return real args; \
+	}
+
+int open(const char *path, int flags, ...) {
+	mode_t mode = 0;
+	BENCH_REAL(open, int, (const char *, int, ...));
+
+	if (flags & O_CREAT) {
+		va_list ap;
+		va_start(ap, flags);
+		mode = va_arg(ap, mode_t);
+		va_end(ap);
+	}
+	bench_syscalls++;
+	return real(path, flags, mode);
+}
+
+int openat(int dirfd, const char *path, int flags, ...) {
+	mode_t mode = 0;
+	BENCH_REAL(openat, int, (int, const char *, int, ...));
+
+	if (flags & O_CREAT) {
+		va_list ap;
+		va_start(ap, flags);
+		mode = va_arg(ap, mode_t);
+		va_end(ap);
+	}
+	bench_syscalls++;
+	return real(dirfd, path, flags, mode);
+}
+
+BENCH_SHIM(ssize_t, read, (int fd, void *buf, size_t len), (fd, buf, len))
+BENCH_SHIM(ssize_t, pread, (int fd, void *buf, size_t len, off_t off),
+           (fd, buf, len, off))
+BENCH_SHIM(int, close, (int fd), (fd))
+BENCH_SHIM(ssize_t, readlink, (const char *path, char *buf, size_t len),
+           (path, buf, len))
+BENCH_SHIM(ssize_t, readlinkat,
+           (int dirfd, const char *path, char *buf, size_t len),
+           (dirfd, path, buf, len))
+BENCH_SHIM(int, stat, (const char *path, struct stat *sb), (path, sb))
+BENCH_SHIM(int, lstat, (const char *path, struct stat *sb), (path, sb))
+BENCH_SHIM(int, fstat, (int fd, struct stat *sb), (fd, sb))
+BENCH_SHIM(int, fstatat,
+           (int dirfd, const char *path, struct stat *sb, int flags),
+           (dirfd, path, sb, flags))
+BENCH_SHIM(int, statvfs, (const char *path, struct statvfs *sb), (path, sb))
+BENCH_SHIM(int, socket, (int domain, int type, int protocol),
+           (domain, type, protocol))
+BENCH_SHIM(ssize_t, send, (int fd, const void *buf, size_t len, int flags),
+           (fd, buf, len, flags))
+BENCH_SHIM(ssize_t, sendto,
+           (int fd, const void *buf, size_t len, int flags,
+            const struct sockaddr *addr, socklen_t addrlen),
+           (fd, buf, len, flags, addr, addrlen))
+BENCH_SHIM(ssize_t, recv, (int fd, void *buf, size_t len, int flags),
+           (fd, buf, len, flags))
+BENCH_SHIM(ssize_t, recvfrom,
+           (int fd, void *buf, size_t len, int flags,
+            struct sockaddr *addr, socklen_t *addrlen),
+           (fd, buf, len, flags, addr, addrlen))
+BENCH_SHIM(int, poll, (struct pollfd *fds, nfds_t n, int timeout),
+           (fds, n, timeout))
+BENCH_SHIM(FILE *, fopen, (const char *path, const char *mode),
+           (path, mode))
+BENCH_SHIM(int, fclose, (FILE *fp), (fp))
+BENCH_SHIM(DIR *, opendir, (const char *path), (path))
+BENCH_SHIM(DIR *, fdopendir, (int fd), (fd))
+BENCH_SHIM(int, closedir, (DIR *dirp), (dirp))
+
+int ioctl(int fd, unsigned long request, ...) {
+	void *arg;
+	va_list ap;
+	BENCH_REAL(ioctl, int, (int, unsigned long, ...));
+
+	va_start(ap, request);
+	arg = va_arg(ap, void *);
+	va_end(ap);
+	bench_syscalls++;
+	return real(fd, request, arg);
+}
+
+/* glibc's own entry points, dlsym itself may allocate */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+void *malloc(size_t size) {
+	bench_bytes += size;
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size) {
+	bench_bytes += n * size;
+	return __libc_calloc(n, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+	bench_bytes += size;
+	return __libc_realloc(ptr, size);
+}
+
+#else
+#define BENCH_COUNTING 0
+#endif
+
+typedef struct {
+	sigar_t *sigar;
+	sigar_pid_t pid;
+	char ifname[SIGAR_INET6_ADDRSTRLEN];
+	sigar_ptql_query_t *query;
+	sigar_cache_t *cache;
+	sigar_uint64_t key;
+} bench_t;
+
+typedef int (*bench_func_t)(bench_t *b);
+
+#define BENCH_GET(name, type) \
+	static int bench_##name(bench_t *b) { \
+		type value; \
+		return sigar_##name(b->sigar, &value); \
+	}
+
+#define BENCH_PID_GET(name, type) \
+	static int bench_##name(bench_t *b) { \
+		type value; \
+		return sigar_##name(b->sigar, b->pid, &value); \
+	}
+
+#define BENCH_LIST(name, type, destroy) \
+	static int bench_##name(bench_t *b) { \
+		type value; \
+		int status = sigar_##name(b->sigar, &value); \
+		if (status == SIGAR_OK) { \
+			sigar_##destroy(b->sigar, &value); \
+		} \
+		return status; \
+	}
+
+BENCH_GET(mem_get, sigar_mem_t)
+BENCH_GET(swap_get, sigar_swap_t)
+BENCH_GET(mem_ext_get, sigar_mem_ext_t)
+BENCH_GET(cpu_get, sigar_cpu_t)
+BENCH_LIST(cpu_list_get, sigar_cpu_list_t, cpu_list_destroy)
+BENCH_LIST(system_stat_get, sigar_system_stat_t, system_stat_destroy)
+BENCH_LIST(cpu_info_list_get, sigar_cpu_info_list_t, cpu_info_list_destroy)
+BENCH_LIST(numa_topology_get, sigar_numa_topology_t, numa_topology_destroy)
+BENCH_LIST(numa_mem_list_get, sigar_numa_mem_list_t, numa_mem_list_destroy)
+BENCH_LIST(numa_cpu_list_get, sigar_cpu_list_t, cpu_list_destroy)
+BENCH_GET(uptime_get, sigar_uptime_t)
+BENCH_GET(loadavg_get, sigar_loadavg_t)
+BENCH_GET(resource_limit_get, sigar_resource_limit_t)
+BENCH_LIST(proc_list_get, sigar_proc_list_t, proc_list_destroy)
+BENCH_GET(proc_stat_get, sigar_proc_stat_t)
+BENCH_PID_GET(proc_mem_get, sigar_proc_mem_t)
+BENCH_PID_GET(proc_mem_ext_get, sigar_proc_mem_ext_t)
+BENCH_PID_GET(proc_disk_io_get, sigar_proc_disk_io_t)
+BENCH_PID_GET(proc_cumulative_disk_io_get, sigar_proc_cumulative_disk_io_t)
+BENCH_PID_GET(proc_net_io_get, sigar_proc_net_io_t)
+BENCH_PID_GET(proc_cred_get, sigar_proc_cred_t)
+BENCH_PID_GET(proc_cred_name_get, sigar_proc_cred_name_t)
+BENCH_PID_GET(proc_time_get, sigar_proc_time_t)
+BENCH_PID_GET(proc_cpu_get, sigar_proc_cpu_t)
+BENCH_PID_GET(proc_state_get, sigar_proc_state_t)
+BENCH_PID_GET(proc_cgroup_get, sigar_proc_cgroup_t)
+BENCH_LIST(cgroup_list_get, sigar_cgroup_list_t, cgroup_list_destroy)
+BENCH_PID_GET(proc_fd_get, sigar_proc_fd_t)
+BENCH_PID_GET(proc_exe_get, sigar_proc_exe_t)
+BENCH_LIST(file_system_list_get, sigar_file_system_list_t,
+           file_system_list_destroy)
+BENCH_LIST(disk_usage_list_get, sigar_disk_usage_list_t,
+           disk_usage_list_destroy)
+BENCH_GET(net_info_get, sigar_net_info_t)
+BENCH_LIST(net_route_list_get, sigar_net_route_list_t,
+           net_route_list_destroy)
+BENCH_GET(net_interface_config_primary_get, sigar_net_interface_config_t)
+BENCH_LIST(net_interface_stat_list_get, sigar_net_interface_stat_list_t,
+           net_interface_stat_list_destroy)
+BENCH_LIST(net_interface_list_get, sigar_net_interface_list_t,
+           net_interface_list_destroy)
+BENCH_GET(tcp_get, sigar_tcp_t)
+BENCH_GET(nfs_client_v2_get, sigar_nfs_client_v2_t)
+BENCH_GET(nfs_server_v2_get, sigar_nfs_server_v2_t)
+BENCH_GET(nfs_client_v3_get, sigar_nfs_client_v3_t)
+BENCH_GET(nfs_server_v3_get, sigar_nfs_server_v3_t)
+BENCH_LIST(arp_list_get, sigar_arp_list_t, arp_list_destroy)
+BENCH_LIST(who_list_get, sigar_who_list_t, who_list_destroy)
+BENCH_GET(sys_info_get, sigar_sys_info_t)
+BENCH_GET(dump_pid_cache_get, sigar_dump_pid_cache_t)
+
+static int bench_proc_snapshot_get(bench_t *b) {
+	sigar_proc_snapshot_t snapshot;
+	int status = sigar_proc_snapshot_get(b->sigar, SIGAR_PROC_SNAPSHOT_ALL,
+	                                     &snapshot);
+	if (status == SIGAR_OK) {
+		sigar_proc_snapshot_destroy(b->sigar, &snapshot);
+	}
+	return status;
+}
+
+static int bench_proc_top_get(bench_t *b) {
+	sigar_proc_top_t top;
+	int status = sigar_proc_top_get(b->sigar, 10, SIGAR_PROC_TOP_CPU, &top);
+	if (status == SIGAR_OK) {
+		sigar_proc_top_destroy(b->sigar, &top);
+	}
+	return status;
+}
+
+static int bench_proc_args_get(bench_t *b) {
+	sigar_proc_args_t args;
+	int status = sigar_proc_args_get(b->sigar, b->pid, &args);
+	if (status == SIGAR_OK) {
+		sigar_proc_args_destroy(b->sigar, &args);
+	}
+	return status;
+}
+
+static int bench_env_getter(void *data, const char *key, int klen,
+                            char *val, int vlen) {
+	(*(int *)data)++;
+	return SIGAR_OK;
+}
+
+static int bench_proc_env_get(bench_t *b) {
+	sigar_proc_env_t procenv;
+	int count = 0;
+
+	procenv.type = SIGAR_PROC_ENV_ALL;
+	procenv.env_getter = bench_env_getter;
+	procenv.data = &count;
+	return sigar_proc_env_get(b->sigar, b->pid, &procenv);
+}
+
+static int bench_module_getter(void *data, char *name, int len) {
+	(*(int *)data)++;
+	return SIGAR_OK;
+}
+
+static int bench_proc_modules_get(bench_t *b) {
+	sigar_proc_modules_t procmods;
+	int count = 0;
+
+	procmods.module_getter = bench_module_getter;
+	procmods.data = &count;
+	return sigar_proc_modules_get(b->sigar, b->pid, &procmods);
+}
+
+static int bench_thread_cpu_get(bench_t *b) {
+	sigar_thread_cpu_t cpu;
+	return sigar_thread_cpu_get(b->sigar, 0, &cpu);
+}
+
+static int bench_proc_thread_list_get(bench_t *b) {
+	sigar_proc_thread_list_t threads;
+	int status = sigar_proc_thread_list_get(b->sigar, b->pid, &threads);
+	if (status == SIGAR_OK) {
+		sigar_proc_thread_list_destroy(b->sigar, &threads);
+	}
+	return status;
+}
+
+static int bench_cgroup_stat_get(bench_t *b) {
+	sigar_cgroup_stat_t stat;
+	return sigar_cgroup_stat_get(b->sigar, "/", &stat);
+}
+
+static int bench_file_system_usage_get(bench_t *b) {
+	sigar_file_system_usage_t fsusage;
+	return sigar_file_system_usage_get(b->sigar, "/", &fsusage);
+}
+
+static int bench_file_system_usage_list_get(bench_t *b) {
+	sigar_file_system_list_t fslist;
+	sigar_file_system_usage_list_t usagelist;
+	int status = sigar_file_system_list_get(b->sigar, &fslist);
+
+	if (status != SIGAR_OK) {
+		return status;
+	}
+	status = sigar_file_system_usage_list_get(b->sigar, &fslist, 1000,
+	                                          &usagelist);
+	if (status == SIGAR_OK) {
+		sigar_file_system_usage_list_destroy(b->sigar, &usagelist);
+	}
+	sigar_file_system_list_destroy(b->sigar, &fslist);
+	return status;
+}
+
+static int bench_net_interface_config_get(bench_t *b) {
+	sigar_net_interface_config_t ifconfig;
+	return sigar_net_interface_config_get(b->sigar, b->ifname, &ifconfig);
+}
+
+static int bench_net_interface_stat_get(bench_t *b) {
+	sigar_net_interface_stat_t ifstat;
+	return sigar_net_interface_stat_get(b->sigar, b->ifname, &ifstat);
+}
+
+static int bench_net_connection_list_get(bench_t *b) {
+	sigar_net_connection_list_t connlist;
+	int status = sigar_net_connection_list_get(b->sigar, &connlist,
+	                                           SIGAR_NETCONN_CLIENT |
+	                                           SIGAR_NETCONN_SERVER |
+	                                           SIGAR_NETCONN_TCP |
+	                                           SIGAR_NETCONN_UDP);
+	if (status == SIGAR_OK) {
+		sigar_net_connection_list_destroy(b->sigar, &connlist);
+	}
+	return status;
+}
+
+static int bench_net_stat_get(bench_t *b) {
+	sigar_net_stat_t netstat;
+	return sigar_net_stat_get(b->sigar, &netstat,
+	                          SIGAR_NETCONN_CLIENT | SIGAR_NETCONN_SERVER |
+	                          SIGAR_NETCONN_TCP);
+}
+
+static int bench_proc_port_get(bench_t *b) {
+	sigar_pid_t pid;
+	int status = sigar_proc_port_get(b->sigar, SIGAR_NETCONN_TCP, 22, &pid);
+	/* nothing listening is still a full lookup */
+	return status == ENOENT ? SIGAR_OK : status;
+}
+
+static int bench_cache_stats_get(bench_t *b) {
+	sigar_cache_stats_t stats;
+	return sigar_cache_stats_get(b->sigar, "proc_cpu", &stats);
+}
+
+static int bench_ptql_query_find(bench_t *b) {
+	sigar_proc_list_t proclist;
+	int status = sigar_ptql_query_find(b->sigar, b->query, &proclist);
+	if (status == SIGAR_OK) {
+		sigar_proc_list_destroy(b->sigar, &proclist);
+	}
+	return status;
+}
+
+static int bench_ptql_query_find_cached(bench_t *b) {
+	int status;
+
+	sigar_ptql_cache_set(b->sigar, 1);
+	status = bench_ptql_query_find(b);
+	sigar_ptql_cache_set(b->sigar, 0);
+	return status;
+}
+
+static int bench_ptql_query_match(bench_t *b) {
+	return sigar_ptql_query_match(b->sigar, b->query, b->pid);
+}
+
+/* pids are handed out mostly in order, see bench_sigar_cache */
+static int bench_cache_get(bench_t *b) {
+	sigar_cache_get(b->cache, (b->key++ % 32768) * 3 + 300);
+	return SIGAR_OK;
+}
+
+static int bench_cache_find(bench_t *b) {
+	sigar_cache_find(b->cache, (b->key++ % 32768) * 3 + 300);
+	return SIGAR_OK;
+}
+
+typedef struct {
+	const char *name;
+	bench_func_t func;
+	int cold; /* a new handle means something for it */
+} bench_entry_t;
+
+#define BENCH_ENTRY(name) { #name, bench_##name, 1 }
+#define BENCH_MICRO(name) { #name, bench_##name, 0 }
+
+static bench_entry_t bench_entries[] = {
+	BENCH_ENTRY(mem_get),
+	BENCH_ENTRY(swap_get),
+	BENCH_ENTRY(mem_ext_get),
+	BENCH_ENTRY(cpu_get),
+	BENCH_ENTRY(cpu_list_get),
+	BENCH_ENTRY(system_stat_get),
+	BENCH_ENTRY(cpu_info_list_get),
+	BENCH_ENTRY(numa_topology_get),
+	BENCH_ENTRY(numa_mem_list_get),
+	BENCH_ENTRY(numa_cpu_list_get),
+	BENCH_ENTRY(uptime_get),
+	BENCH_ENTRY(loadavg_get),
+	BENCH_ENTRY(resource_limit_get),
+	BENCH_ENTRY(proc_list_get),
+	BENCH_ENTRY(proc_stat_get),
+	BENCH_ENTRY(proc_mem_get),
+	BENCH_ENTRY(proc_mem_ext_get),
+	BENCH_ENTRY(proc_disk_io_get),
+	BENCH_ENTRY(proc_cumulative_disk_io_get),
+	BENCH_ENTRY(proc_net_io_get),
+	BENCH_ENTRY(proc_cred_get),
+	BENCH_ENTRY(proc_cred_name_get),
+	BENCH_ENTRY(proc_time_get),
+	BENCH_ENTRY(proc_cpu_get),
+	BENCH_ENTRY(proc_state_get),
+	BENCH_ENTRY(proc_cgroup_get),
+	BENCH_ENTRY(cgroup_list_get),
+	BENCH_ENTRY(cgroup_stat_get),
+	BENCH_ENTRY(proc_snapshot_get),
+	BENCH_ENTRY(proc_top_get),
+	BENCH_ENTRY(proc_args_get),
+	BENCH_ENTRY(proc_env_get),
+	BENCH_ENTRY(proc_fd_get),
+	BENCH_ENTRY(proc_exe_get),
+	BENCH_ENTRY(proc_modules_get),
+	BENCH_ENTRY(thread_cpu_get),
+	BENCH_ENTRY(proc_thread_list_get),
+	BENCH_ENTRY(file_system_list_get),
+	BENCH_ENTRY(file_system_usage_get),
+	BENCH_ENTRY(file_system_usage_list_get),
+	BENCH_ENTRY(disk_usage_list_get),
+	BENCH_ENTRY(net_info_get),
+	BENCH_ENTRY(net_route_list_get),
+	BENCH_ENTRY(net_interface_config_get),
+	BENCH_ENTRY(net_interface_config_primary_get),
+	BENCH_ENTRY(net_interface_stat_get),
+	BENCH_ENTRY(net_interface_stat_list_get),
+	BENCH_ENTRY(net_interface_list_get),
+	BENCH_ENTRY(net_connection_list_get),
+	BENCH_ENTRY(net_stat_get),
+	BENCH_ENTRY(tcp_get),
+	BENCH_ENTRY(nfs_client_v2_get),
+	BENCH_ENTRY(nfs_server_v2_get),
+	BENCH_ENTRY(nfs_client_v3_get),
+	BENCH_ENTRY(nfs_server_v3_get),
+	BENCH_ENTRY(arp_list_get),
+	BENCH_ENTRY(who_list_get),
+	BENCH_ENTRY(proc_port_get),
+	BENCH_ENTRY(sys_info_get),
+	BENCH_ENTRY(dump_pid_cache_get),
+	BENCH_ENTRY(cache_stats_get),
+	BENCH_ENTRY(ptql_query_find),
+	BENCH_ENTRY(ptql_query_find_cached),
+	BENCH_ENTRY(ptql_query_match),
+	BENCH_MICRO(cache_get),
+	BENCH_MICRO(cache_find),
+	{ NULL, NULL, 0 }
+};
+
+/* at most this many new handles per getter, opening one is not cheap */
+#define BENCH_COLD_MAX 10
+
+typedef struct {
+	sigar_uint64_t calls, ns, syscalls, bytes;
+	int status;
+} bench_result_t;
+
+static sigar_uint64_t now_nsec(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (sigar_uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void bench_run(bench_t *b, bench_func_t func, int calls,
+                      bench_result_t *result) {
+	sigar_uint64_t start, syscalls = bench_syscalls, bytes = bench_bytes;
+	int i;
+
+	start = now_nsec();
+	for (i = 0; i < calls; i++) {
+		result->status = func(b);
+	}
+	result->ns += now_nsec() - start;
+	result->syscalls += bench_syscalls - syscalls;
+	result->bytes += bench_bytes - bytes;
+	result->calls += calls;
+}
+
+static void bench_print(const char *name, bench_result_t *result) {
+	double calls = result->calls ? (double)result->calls : 1.0;
+
+	printf("\"%s\": {\"ns\": %.0f, ", name, result->ns / calls);
+	if (BENCH_COUNTING) {
+		printf("\"syscalls\": %.2f, \"bytes\": %.0f}",
+		       result->syscalls / calls, result->bytes / calls);
+	}
+	else {
+		printf("\"syscalls\": -1, \"bytes\": -1}");
+	}
+}
+
+static void bench_setup(bench_t *b) {
+	sigar_net_interface_config_t ifconfig;
+
+	if (sigar_net_interface_config_primary_get(b->sigar,
+	                                           &ifconfig) == SIGAR_OK) {
+		SIGAR_SSTRCPY(b->ifname, ifconfig.name);
+	}
+	else {
+		SIGAR_SSTRCPY(b->ifname, "lo");
+	}
+	b->pid = sigar_pid_get(b->sigar);
+
+	/* a procfs_fixture tree has none of our pids */
+	if (getenv("SIGAR_PROC_ROOT")) {
+		sigar_proc_list_t pids;
+
+		if (sigar_proc_list_get(b->sigar, &pids) == SIGAR_OK) {
+			if (pids.number) {
+				b->pid = pids.data[0];
+			}
+			sigar_proc_list_destroy(b->sigar, &pids);
+		}
+	}
+}
+
+int main(int argc, char **argv) {
+	int iterations = argc > 1 ? atoi(argv[1]) : 100;
+	int cold = iterations < BENCH_COLD_MAX ? iterations : BENCH_COLD_MAX;
+	sigar_ptql_error_t error;
+	sigar_proc_list_t pids;
+	bench_entry_t *entry;
+	bench_t b;
+	int i;
+
+	memset(&b, 0, sizeof(b));
+	if (sigar_open(&b.sigar) != SIGAR_OK) {
+		fprintf(stderr, "sigar_open failed\n");
+		return 1;
+	}
+	bench_setup(&b);
+	if (sigar_ptql_query_create(&b.query, "State.Name.eq=bench_sigar_api",
+	                            &error) != SIGAR_OK) {
+		fprintf(stderr, "ptql: %s\n", error.message);
+		return 1;
+	}
+	b.cache = sigar_cache_new(128);
+	for (i = 0; i < 32768; i++) {
+		sigar_cache_get(b.cache, (sigar_uint64_t)i * 3 + 300);
+	}
+	if (sigar_proc_list_get(b.sigar, &pids) != SIGAR_OK) {
+		pids.number = 0;
+	}
+
+	printf("{\n\"iterations\": %d,\n"
+	       "\"processes\": %lu,\n\"counting\": %s,\n\"results\": [\n",
+	       iterations, pids.number,
+	       BENCH_COUNTING ? "true" : "false");
+	if (pids.number) {
+		sigar_proc_list_destroy(b.sigar, &pids);
+	}
+
+	for (entry = bench_entries; entry->name; entry++) {
+		bench_result_t warm, first;
+
+		memset(&warm, 0, sizeof(warm));
+		memset(&first, 0, sizeof(first));
+
+		if (entry->cold) {
+			bench_t fresh = b;
+
+			for (i = 0; i < cold; i++) {
+				if (sigar_open(&fresh.sigar) != SIGAR_OK) {
+					continue;
+				}
+				bench_run(&fresh, entry->func, 1, &first);
+				sigar_close(fresh.sigar);
+			}
+		}
+
+		/* once untimed so the caches are filled */
+		entry->func(&b);
+		bench_run(&b, entry->func, iterations, &warm);
+
+		printf("{\"name\": \"%s\", \"status\": %d, ",
+		       entry->name, warm.status);
+		if (entry->cold) {
+			bench_print("cold", &first);
+			printf(", ");
+		}
+		bench_print("warm", &warm);
+		printf("}%s\n", entry[1].name ? "," : "");
+	}
+
+	printf("]\n}\n");
+
+	sigar_cache_destroy(b.cache);
+	sigar_ptql_query_destroy(b.query);
+	sigar_close(b.sigar);
+
+	return 0;
+}
@@ -0,0 +1,112 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * lookup/insert throughput of the sigar_cache_t engines
+ * for pid-sized key sets, e.g.:
+ *   ./bench_sigar_cache [rounds]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "sigar.h"
+#include "sigar_private.h"
+#include "sigar_util.h"
+
+static sigar_uint64_t bench_key(unsigned int i) {
+	/* pids are handed out mostly in order */
+	return (sigar_uint64_t)i * 3 + 300;
+}
+
+static double ops_per_sec(sigar_uint64_t ops, sigar_int64_t millis) {
+	if (millis <= 0) {
+		millis = 1;
+	}
+	return ops / (millis / 1000.0);
+}
+
+static void bench_cache(const char *name, int flags,
+                        unsigned int keys, int rounds) {
+	sigar_cache_t *cache;
+	sigar_int64_t start, insert_ms, lookup_ms, random_ms;
+	unsigned int i, *order = malloc(sizeof(*order) * keys);
+	int r;
+
+	/* fixed shuffle so runs are comparable */
+	srand(42);
+	for (i = 0; i < keys; i++) {
+		order[i] = i;
+	}
+	for (i = keys - 1; i > 0; i--) {
+		unsigned int j = rand() % (i + 1), tmp = order[i];
+		order[i] = order[j];
+		order[j] = tmp;
+	}
+
+	/* same number of lookups for every key set size */
+	rounds = (int)(((sigar_uint64_t)rounds * 100000) / keys);
+
+	cache = sigar_cache_create(128, flags,
+	                           SIGAR_FIELD_NOTIMPL, SIGAR_FIELD_NOTIMPL);
+
+	start = sigar_time_now_millis();
+	for (i = 0; i < keys; i++) {
+		sigar_cache_get(cache, bench_key(i));
+	}
+	insert_ms = sigar_time_now_millis() - start;
+
+	start = sigar_time_now_millis();
+	for (r = 0; r < rounds; r++) {
+		for (i = 0; i < keys; i++) {
+			if (!sigar_cache_find(cache, bench_key(i))) {
+				fprintf(stderr, "%s: lost key %u\n", name, i);
+				exit(1);
+			}
+		}
+	}
+	lookup_ms = sigar_time_now_millis() - start;
+
+	start = sigar_time_now_millis();
+	for (r = 0; r < rounds; r++) {
+		for (i = 0; i < keys; i++) {
+			sigar_cache_find(cache, bench_key(order[i]));
+		}
+	}
+	random_ms = sigar_time_now_millis() - start;
+
+	printf("%-16s %7u keys  insert %11.0f/s  "
+	       "lookup %11.0f/s  random %11.0f/s\n",
+	       name, keys,
+	       ops_per_sec(keys, insert_ms),
+	       ops_per_sec((sigar_uint64_t)keys * rounds, lookup_ms),
+	       ops_per_sec((sigar_uint64_t)keys * rounds, random_ms));
+
+	sigar_cache_destroy(cache);
+	free(order);
+}
+
+int main(int argc, char **argv) {
+	unsigned int sizes[] = { 1000, 10000, 100000 };
+	int rounds = argc > 1 ? atoi(argv[1]) : 20;
+	unsigned int i;
+
+	for (i = 0; i < sizeof(sizes)/sizeof(sizes[0]); i++) {
+		bench_cache("chained", 0, sizes[i], rounds);
+		bench_cache("open-addressing", SIGAR_CACHE_OPEN_ADDRESSING,
+		            sizes[i], rounds);
+	}
+
+	return 0;
+}
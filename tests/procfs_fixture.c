@@ -0,0 +1,389 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * writes a synthetic /proc with N pids, M tcp sockets, K disks and
+ * J interfaces for measuring how the linux collectors scale:
+ *   ./procfs_fixture /tmp/proc 50000 500000 64 16
+ *   SIGAR_PROC_ROOT=/tmp/proc ./bench_sigar_api 10
+ *
+ * the same arguments always write the same tree.  sockets are dealt
+ * out round robin, so every pid has an fd per socket it owns, and
+ * every tenth socket is a listener.  netlink (sock_diag, taskstats,
+ * the proc connector) is not used with SIGAR_PROC_ROOT, so what is
+ * measured is the procfs parsing.  sysfs, statvfs and ioctls still
+ * see the real host.
+ */
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#define FIXTURE_PID_BASE 1000
+#define FIXTURE_INODE_BASE 100000
+#define FIXTURE_CPUS 4
+
+static char fixture_root[4096];
+
+static const char *fixture_path(const char *fmt, va_list ap) {
+	static char path[sizeof(fixture_root) + 256];
+	int len = snprintf(path, sizeof(path), "%s/", fixture_root);
+
+	vsnprintf(path + len, sizeof(path) - len, fmt, ap);
+	return path;
+}
+
+static void fixture_dir(const char *fmt, ...) {
+	const char *path;
+	va_list ap;
+
+	va_start(ap, fmt);
+	path = fixture_path(fmt, ap);
+	va_end(ap);
+
+	if ((mkdir(path, 0755) < 0) && (errno != EEXIST)) {
+		perror(path);
+		exit(1);
+	}
+}
+
+static FILE *fixture_file(const char *fmt, ...) {
+	const char *path;
+	va_list ap;
+	FILE *fp;
+
+	va_start(ap, fmt);
+	path = fixture_path(fmt, ap);
+	va_end(ap);
+
+	if (!(fp = fopen(path, "w"))) {
+		perror(path);
+		exit(1);
+	}
+	return fp;
+}
+
+static void fixture_link(const char *target, const char *fmt, ...) {
+	const char *path;
+	va_list ap;
+
+	va_start(ap, fmt);
+	path = fixture_path(fmt, ap);
+	va_end(ap);
+
+	unlink(path);
+	if (symlink(target, path) < 0) {
+		perror(path);
+		exit(1);
+	}
+}
+
+static void fixture_system(long pids, long disks) {
+	FILE *fp;
+	int i;
+
+	fp = fixture_file("stat");
+	fprintf(fp, "cpu  %d 0 %d %d 100 0 10 0 0 0\n",
+	        FIXTURE_CPUS * 5000, FIXTURE_CPUS * 1000, FIXTURE_CPUS * 90000);
+	for (i = 0; i < FIXTURE_CPUS; i++) {
+		fprintf(fp, "cpu%d 5000 0 1000 90000 25 0 2 0 0 0\n", i);
+	}
+	fprintf(fp, "intr 0\nctxt 1000000\nbtime 1700000000\n"
+	        "processes %ld\nprocs_running 1\nprocs_blocked 0\n"
+	        "softirq 0 0 0 0 0 0 0 0 0 0 0\n", pids);
+	fclose(fp);
+
+	fp = fixture_file("meminfo");
+	fprintf(fp,
+	        "MemTotal:       16384000 kB\n"
+	        "MemFree:         8192000 kB\n"
+	        "MemAvailable:   12288000 kB\n"
+	        "Buffers:          512000 kB\n"
+	        "Cached:          3072000 kB\n"
+	        "SwapCached:            0 kB\n"
+	        "Active:          4096000 kB\n"
+	        "Inactive:        2048000 kB\n"
+	        "Dirty:              1024 kB\n"
+	        "Slab:             256000 kB\n"
+	        "SReclaimable:     128000 kB\n"
+	        "Shmem:             64000 kB\n"
+	        "SwapTotal:       2048000 kB\n"
+	        "SwapFree:        2048000 kB\n");
+	fclose(fp);
+
+	fp = fixture_file("vmstat");
+	fprintf(fp, "nr_free_pages 2048000\npswpin 0\npswpout 0\n");
+	fclose(fp);
+
+	fp = fixture_file("uptime");
+	fprintf(fp, "100000.00 380000.00\n");
+	fclose(fp);
+
+	fp = fixture_file("loadavg");
+	fprintf(fp, "0.50 0.40 0.30 1/%ld %ld\n",
+	        pids, FIXTURE_PID_BASE + pids - 1);
+	fclose(fp);
+
+	fp = fixture_file("cpuinfo");
+	for (i = 0; i < FIXTURE_CPUS; i++) {
+		fprintf(fp,
+		        "processor\t: %d\n"
+		        "vendor_id\t: GenuineIntel\n"
+		        "model name\t: Fixture CPU @ 2.00GHz\n"
+		        "cpu MHz\t\t: 2000.000\n"
+		        "cache size\t: 32768 KB\n"
+		        "physical id\t: 0\n"
+		        "siblings\t: %d\n"
+		        "core id\t\t: %d\n"
+		        "cpu cores\t: %d\n\n",
+		        i, FIXTURE_CPUS, i, FIXTURE_CPUS);
+	}
+	fclose(fp);
+
+	fp = fixture_file("diskstats");
+	for (i = 0; i < disks; i++) {
+		fprintf(fp, "   8 %7d disk%d %d 0 %d 100 %d 0 %d 200 0 300 300\n",
+		        i * 16, i, 1000 + i, 8000 + i, 500 + i, 4000 + i);
+	}
+	fclose(fp);
+
+	fp = fixture_file("partitions");
+	fprintf(fp, "major minor  #blocks  name\n\n");
+	for (i = 0; i < disks; i++) {
+		fprintf(fp, "   8 %8d %10d disk%d\n", i * 16, 1048576, i);
+	}
+	fclose(fp);
+}
+
+static void fixture_net(long pids, long sockets, long ifaces) {
+	static const char *empty[] = { "tcp6", "udp", "udp6", "raw", "raw6" };
+	FILE *fp;
+	long i;
+
+	fixture_dir("net");
+
+	fp = fixture_file("net/tcp");
+	fprintf(fp, "  sl  local_address rem_address   st tx_queue rx_queue "
+	        "tr tm->when retrnsmt   uid  timeout inode\n");
+	for (i = 0; i < sockets; i++) {
+		int listen = (i % 10) == 0;
+
+		fprintf(fp, "%4ld: 0100007F:%04lX %08X:%04lX %s "
+		        "00000000:00000000 00:00000000 00000000     0        0 "
+		        "%ld 1 0000000000000000 100 0 0 10 0\n",
+		        i, 1024 + (i % 60000),
+		        listen ? 0 : 0x0100007F, listen ? 0 : 1024 + ((i + 1) % 60000),
+		        listen ? "0A" : "01",
+		        FIXTURE_INODE_BASE + i);
+	}
+	fclose(fp);
+
+	for (i = 0; i < (long)(sizeof(empty) / sizeof(*empty)); i++) {
+		fp = fixture_file("net/%s", empty[i]);
+		fprintf(fp, "  sl  local_address rem_address   st tx_queue rx_queue "
+		        "tr tm->when retrnsmt   uid  timeout inode\n");
+		fclose(fp);
+	}
+
+	fp = fixture_file("net/dev");
+	fprintf(fp,
+	        "Inter-|   Receive                                                |"
+	        "  Transmit\n"
+	        " face |bytes    packets errs drop fifo frame compressed multicast|"
+	        "bytes    packets errs drop fifo colls carrier compressed\n");
+	for (i = 0; i < ifaces; i++) {
+		fprintf(fp, "  eth%ld: %ld %ld 0 0 0 0 0 0 %ld %ld 0 0 0 0 0 0\n",
+		        i, 1000000 * (i + 1), 1000 * (i + 1),
+		        2000000 * (i + 1), 2000 * (i + 1));
+	}
+	fclose(fp);
+
+	fp = fixture_file("net/route");
+	fprintf(fp, "Iface\tDestination\tGateway \tFlags\tRefCnt\tUse\tMetric\t"
+	        "Mask\t\tMTU\tWindow\tIRTT\n");
+	if (ifaces) {
+		fprintf(fp, "eth0\t00000000\t0100000A\t0003\t0\t0\t0\t"
+		        "00000000\t0\t0\t0\n");
+	}
+	fclose(fp);
+
+	fp = fixture_file("net/arp");
+	fprintf(fp, "IP address       HW type     Flags       HW address"
+	        "            Mask     Device\n");
+	fclose(fp);
+
+	fp = fixture_file("net/if_inet6");
+	fclose(fp);
+
+	fp = fixture_file("net/snmp");
+	fprintf(fp, "Tcp: RtoAlgorithm RtoMin RtoMax MaxConn ActiveOpens "
+	        "PassiveOpens AttemptFails EstabResets CurrEstab InSegs OutSegs "
+	        "RetransSegs InErrs OutRsts InCsumErrors\n"
+	        "Tcp: 1 200 120000 -1 %ld %ld 0 0 %ld 0 0 0 0 0 0\n",
+	        sockets, sockets / 10, sockets - sockets / 10);
+	fclose(fp);
+}
+
+static void fixture_pid(long pid, long index, long pids, long sockets) {
+	char target[64];
+	FILE *fp;
+	long ppid = index ? FIXTURE_PID_BASE : 0;
+	long rss = 256 + (index % 1024);
+	long i, fd;
+
+	fixture_dir("%ld", pid);
+	fixture_dir("%ld/fd", pid);
+	fixture_dir("%ld/task", pid);
+	fixture_dir("%ld/task/%ld", pid, pid);
+
+	/* the exit_signal 17 says process, not thread */
+	fp = fixture_file("%ld/stat", pid);
+	fprintf(fp, "%ld (proc%ld) S %ld %ld %ld 0 -1 4194560 100 0 0 0 "
+	        "%ld %ld 0 0 20 0 1 0 %ld %ld %ld 18446744073709551615 "
+	        "1 1 0 0 0 0 0 0 0 0 0 0 17 %ld 0 0 0 0 0\n",
+	        pid, index, ppid, pid, pid,
+	        index % 1000, index % 100, 1000 + index,
+	        rss * 4096 * 4, rss, index % FIXTURE_CPUS);
+	fclose(fp);
+
+	/* the task stat is the same process */
+	fixture_link("../../stat", "%ld/task/%ld/stat", pid, pid);
+
+	fp = fixture_file("%ld/statm", pid);
+	fprintf(fp, "%ld %ld %ld 10 0 %ld 0\n", rss * 4, rss, rss / 2, rss);
+	fclose(fp);
+
+	fp = fixture_file("%ld/status", pid);
+	fprintf(fp,
+	        "Name:\tproc%ld\n"
+	        "State:\tS (sleeping)\n"
+	        "Tgid:\t%ld\n"
+	        "Pid:\t%ld\n"
+	        "PPid:\t%ld\n"
+	        "Uid:\t0\t0\t0\t0\n"
+	        "Gid:\t0\t0\t0\t0\n"
+	        "VmRSS:\t%ld kB\n"
+	        "Threads:\t1\n"
+	        "voluntary_ctxt_switches:\t%ld\n"
+	        "nonvoluntary_ctxt_switches:\t0\n",
+	        index, pid, pid, ppid, rss * 4, index);
+	fclose(fp);
+
+	fp = fixture_file("%ld/io", pid);
+	fprintf(fp, "rchar: %ld\nwchar: %ld\nsyscr: 10\nsyscw: 10\n"
+	        "read_bytes: %ld\nwrite_bytes: %ld\ncancelled_write_bytes: 0\n",
+	        index * 4096, index * 2048, index * 512, index * 256);
+	fclose(fp);
+
+	fp = fixture_file("%ld/cmdline", pid);
+	fprintf(fp, "/usr/bin/proc%ld%c--fixture%c", index, '\0', '\0');
+	fclose(fp);
+
+	fp = fixture_file("%ld/environ", pid);
+	fprintf(fp, "PATH=/usr/bin%cFIXTURE=%ld%c", '\0', index, '\0');
+	fclose(fp);
+
+	fp = fixture_file("%ld/maps", pid);
+	fprintf(fp,
+	        "00400000-00452000 r-xp 00000000 08:01 1000 /usr/bin/proc%ld\n"
+	        "7f0000000000-7f0000200000 r-xp 00000000 08:01 2000 "
+	        "/lib/libc.so.6\n"
+	        "7ffc00000000-7ffc00021000 rw-p 00000000 00:00 0 [stack]\n",
+	        index);
+	fclose(fp);
+
+	fp = fixture_file("%ld/smaps_rollup", pid);
+	fprintf(fp,
+	        "00400000-7ffc00021000 ---p 00000000 00:00 0 [rollup]\n"
+	        "Rss:            %8ld kB\n"
+	        "Pss:            %8ld kB\n"
+	        "Shared_Clean:   %8ld kB\n"
+	        "Shared_Dirty:          0 kB\n"
+	        "Private_Clean:         0 kB\n"
+	        "Private_Dirty:  %8ld kB\n"
+	        "Anonymous:      %8ld kB\n"
+	        "Swap:                  0 kB\n"
+	        "SwapPss:               0 kB\n",
+	        rss * 4, rss * 3, rss * 2, rss * 2, rss * 2);
+	fclose(fp);
+
+	fp = fixture_file("%ld/cgroup", pid);
+	fprintf(fp, "0::/fixture/%ld\n", index % 16);
+	fclose(fp);
+
+	fixture_link("/usr/bin/true", "%ld/exe", pid);
+	fixture_link("/", "%ld/cwd", pid);
+	fixture_link("/", "%ld/root", pid);
+
+	for (fd = 0; fd < 3; fd++) {
+		fixture_link("/dev/null", "%ld/fd/%ld", pid, fd);
+	}
+	for (i = index; i < sockets; i += pids, fd++) {
+		snprintf(target, sizeof(target), "socket:[%ld]",
+		         FIXTURE_INODE_BASE + i);
+		fixture_link(target, "%ld/fd/%ld", pid, fd);
+	}
+}
+
+int main(int argc, char **argv) {
+	long pids, sockets, disks, ifaces, i;
+	char self[32];
+	FILE *fp;
+
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s dir [pids [sockets [disks [interfaces]]]]\n",
+		        argv[0]);
+		return 1;
+	}
+
+	snprintf(fixture_root, sizeof(fixture_root), "%s", argv[1]);
+	pids = argc > 2 ? atol(argv[2]) : 1000;
+	sockets = argc > 3 ? atol(argv[3]) : 10000;
+	disks = argc > 4 ? atol(argv[4]) : 8;
+	ifaces = argc > 5 ? atol(argv[5]) : 4;
+
+	if (pids < 1) {
+		pids = 1;
+	}
+
+	if ((mkdir(fixture_root, 0755) < 0) && (errno != EEXIST)) {
+		perror(fixture_root);
+		return 1;
+	}
+
+	fixture_system(pids, disks);
+	fixture_net(pids, sockets, ifaces);
+
+	for (i = 0; i < pids; i++) {
+		fixture_pid(FIXTURE_PID_BASE + i, i, pids, sockets);
+	}
+
+	/* self is the first pid, with a mount table for the cgroup code */
+	snprintf(self, sizeof(self), "%d", FIXTURE_PID_BASE);
+	fixture_link(self, "self");
+	fp = fixture_file("%d/mountinfo", FIXTURE_PID_BASE);
+	fprintf(fp, "1 0 0:1 / / rw,relatime - rootfs rootfs rw\n"
+	        "2 1 0:2 / /proc rw,relatime - proc proc rw\n");
+	fclose(fp);
+
+	printf("%s: %ld pids, %ld sockets, %ld disks, %ld interfaces\n",
+	       fixture_root, pids, sockets, disks, ifaces);
+
+	return 0;
+}
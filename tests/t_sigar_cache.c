@@ -0,0 +1,259 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "sigar.h"
+#include "sigar_private.h"
+#include "sigar_util.h"
+#include "sigar_tests.h"
+
+#define KEYS 10000
+
+/* pid-like keys: mostly increasing with gaps */
+static sigar_uint64_t test_key(int i) {
+	return (sigar_uint64_t)i * 7 + (i % 3);
+}
+
+static int test_cache_engine(int flags) {
+	sigar_cache_t *cache;
+	sigar_cache_entry_t *entry;
+	sigar_cache_stats_t stats;
+	unsigned int kept = 0;
+	int i;
+
+	cache = sigar_cache_create(16, flags,
+	                           SIGAR_FIELD_NOTIMPL, 60 * 1000);
+
+	for (i = 0; i < KEYS; i++) {
+		entry = sigar_cache_get(cache, test_key(i));
+		assert(entry != NULL);
+		assert(entry->id == test_key(i));
+		assert(entry->value == NULL);
+		entry->value = malloc(sizeof(int));
+		*(int *)entry->value = i;
+	}
+	assert(cache->count == KEYS);
+
+	for (i = 0; i < KEYS; i++) {
+		entry = sigar_cache_find(cache, test_key(i));
+		assert(entry != NULL);
+		assert(*(int *)entry->value == i);
+		/* existing entries are returned, not re-created */
+		assert(sigar_cache_get(cache, test_key(i))->value != NULL);
+	}
+	assert(cache->count == KEYS);
+	assert(sigar_cache_find(cache, test_key(KEYS) + 1) == NULL);
+
+	/* age out every other entry, then let one sweep run */
+	for (i = 0; i < KEYS; i += 2) {
+		sigar_cache_find(cache, test_key(i))->last_access_time = 0;
+	}
+	cache->cleanup_period_millis = 0;
+	sigar_cache_find(cache, test_key(1));
+	if (flags & SIGAR_CACHE_INCREMENTAL_CLEANUP) {
+		/* only the first few buckets were swept */
+		assert(cache->cleanup_active);
+		assert(cache->count > KEYS / 2);
+	}
+	while (cache->cleanup_active) {
+		sigar_cache_find(cache, test_key(1));
+	}
+	cache->cleanup_period_millis = SIGAR_FIELD_NOTIMPL;
+	assert(cache->evictions == KEYS / 2);
+
+	for (i = 0; i < KEYS; i++) {
+		entry = sigar_cache_find(cache, test_key(i));
+		if (i % 2) {
+			assert(entry != NULL);
+			assert(*(int *)entry->value == i);
+			kept++;
+		}
+		else {
+			assert(entry == NULL);
+		}
+	}
+	assert(cache->count == kept);
+
+	sigar_cache_stats(cache, &stats);
+	assert(stats.count == kept);
+	assert(stats.size == cache->size);
+	assert(stats.evictions == KEYS / 2);
+	assert(stats.hits > 0);
+	assert(stats.misses >= KEYS);
+	assert(stats.max_probe >= 1);
+	assert(stats.bytes > 0);
+
+	sigar_cache_destroy(cache);
+
+	return 0;
+}
+
+TEST(test_sigar_cache_chained) {
+	return test_cache_engine(0);
+}
+
+TEST(test_sigar_cache_open_addressing) {
+	return test_cache_engine(SIGAR_CACHE_OPEN_ADDRESSING);
+}
+
+TEST(test_sigar_cache_incremental) {
+	test_cache_engine(SIGAR_CACHE_INCREMENTAL_CLEANUP);
+	return test_cache_engine(SIGAR_CACHE_OPEN_ADDRESSING |
+	                         SIGAR_CACHE_INCREMENTAL_CLEANUP);
+}
+
+TEST(test_sigar_cache_pool) {
+	sigar_pool_t *pool = sigar_pool_new(sizeof(sigar_proc_cpu_t), 64);
+	sigar_cache_t *cache;
+	sigar_cache_entry_t *entry;
+	size_t bytes;
+	int i;
+
+	cache = sigar_cache_create(16, SIGAR_CACHE_OPEN_ADDRESSING |
+	                           SIGAR_CACHE_INCREMENTAL_CLEANUP,
+	                           SIGAR_FIELD_NOTIMPL, 60 * 1000);
+	cache->value_pool = pool;
+
+	for (i = 0; i < KEYS; i++) {
+		sigar_proc_cpu_t *cpu;
+
+		entry = sigar_cache_get(cache, test_key(i));
+		cpu = entry->value = sigar_cache_value_new(cache, sizeof(*cpu));
+		assert(cpu != NULL);
+		assert(((size_t)cpu % sizeof(sigar_uint64_t)) == 0);
+		assert(cpu->total == 0);
+		cpu->total = i;
+	}
+	bytes = sigar_pool_bytes(pool);
+
+	/* expired values go back to the pool and are reused */
+	for (i = 0; i < KEYS; i++) {
+		sigar_cache_find(cache, test_key(i))->last_access_time = 0;
+	}
+	cache->cleanup_period_millis = 0;
+	do {
+		sigar_cache_find(cache, 0);
+	} while (cache->cleanup_active);
+	cache->cleanup_period_millis = SIGAR_FIELD_NOTIMPL;
+	assert(cache->count == 0);
+
+	for (i = 0; i < KEYS; i++) {
+		entry = sigar_cache_get(cache, test_key(i));
+		entry->value = sigar_cache_value_new(cache, sizeof(sigar_proc_cpu_t));
+	}
+	assert(sigar_pool_bytes(pool) == bytes);
+
+	/* more than a pool object holds is refused, not overrun */
+	assert(sigar_pool_size(pool) >= sizeof(sigar_proc_cpu_t));
+	assert(sigar_cache_value_new(cache, sigar_pool_size(pool) + 1) == NULL);
+
+	sigar_cache_destroy(cache);
+	sigar_pool_destroy(pool);
+
+	return 0;
+}
+
+TEST(test_sigar_cache_stats_get) {
+	sigar_cache_stats_t stats;
+	sigar_proc_cpu_t cpu;
+
+	assert(ENOENT == sigar_cache_stats_get(t, "no_such_cache", &stats));
+
+	assert(SIGAR_OK == sigar_cache_stats_get(t, "net_listen", &stats));
+
+	if (SIGAR_OK == sigar_proc_cpu_get(t, sigar_pid_get(t), &cpu)) {
+		assert(SIGAR_OK == sigar_cache_stats_get(t, "proc_cpu", &stats));
+		assert(stats.count >= 1);
+		assert(stats.misses >= 1);
+		assert(stats.bytes > 0);
+	}
+
+	return 0;
+}
+
+TEST(test_sigar_instrumentation_get) {
+	sigar_instrumentation_list_t list;
+	sigar_instrumentation_stats_t stats;
+	sigar_mem_t mem;
+	int i, status;
+
+	status = sigar_instrumentation_set(t, 1);
+	if (status == SIGAR_ENOTIMPL) {
+		/* built without -DSIGAR_INSTRUMENT */
+		assert(SIGAR_ENOTIMPL == sigar_instrumentation_get(t, &list));
+		return 0;
+	}
+	assert(SIGAR_OK == status);
+
+	for (i = 0; i < 10; i++) {
+		assert(SIGAR_OK == sigar_mem_get(t, &mem));
+	}
+
+	assert(ENOENT == sigar_instrumentation_stats_get(t, "no_such_get", &stats));
+
+	assert(SIGAR_OK == sigar_instrumentation_stats_get(t, "mem_get", &stats));
+	assert(stats.calls == 10);
+	assert(stats.errors == 0);
+	assert(stats.max_time > 0);
+	assert(stats.p50 <= stats.p90);
+	assert(stats.p90 <= stats.p99);
+	assert(stats.p99 <= stats.max_time);
+	assert(stats.total_time >= stats.max_time);
+#if defined(SIGAR_TEST_OS_LINUX)
+	assert(stats.opens >= 10);
+#endif
+
+	/* once off, calls go straight through */
+	assert(SIGAR_OK == sigar_instrumentation_set(t, 0));
+	assert(SIGAR_OK == sigar_mem_get(t, &mem));
+	assert(SIGAR_OK == sigar_instrumentation_stats_get(t, "mem_get", &stats));
+	assert(stats.calls == 10);
+
+	assert(SIGAR_OK == sigar_instrumentation_get(t, &list));
+	assert(list.number > 0);
+	for (i = 0; i < (int)list.number; i++) {
+		if (strcmp(list.data[i].name, "mem_get") == 0) {
+			assert(list.data[i].stats.calls == 10);
+		}
+		else {
+			assert(list.data[i].stats.calls == 0);
+		}
+	}
+	sigar_instrumentation_list_destroy(t, &list);
+
+	return 0;
+}
+
+int main() {
+	sigar_t *t;
+	int err = 0;
+
+	assert(SIGAR_OK == sigar_open(&t));
+
+	test_sigar_cache_chained(t);
+	test_sigar_cache_open_addressing(t);
+	test_sigar_cache_incremental(t);
+	test_sigar_cache_pool(t);
+	test_sigar_cache_stats_get(t);
+	test_sigar_instrumentation_get(t);
+
+	sigar_close(t);
+
+	return err ? -1 : 0;
+}
@@ -39,10 +39,14 @@
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
+#if defined(SIGAR_TEST_OS_LINUX)
+#include <unistd.h>
+#endif
 
 #include "sigar.h"
 #include "sigar_private.h"
 #include "sigar_format.h"
+#include "sigar_sampler.h"
 #include "sigar_tests.h"
 
 TEST(test_sigar_cpu_get) {
@@ -105,6 +109,98 @@ TEST(test_sigar_cpu_list_get) {
 	return 0;
 }
 
+TEST(test_sigar_system_stat_get) {
+	sigar_system_stat_t systemstat;
+	sigar_cpu_list_t cpulist;
+	sigar_cpu_t cpu;
+	size_t i;
+	int ret;
+
+	if (SIGAR_OK != (ret = sigar_system_stat_get(t, &systemstat))) {
+		switch (ret) {
+			/* track the expected error code */
+		default:
+			fprintf(stderr, "ret = %d (%s)\n", ret, sigar_strerror(t, ret));
+			assert(ret == SIGAR_OK); 
+			break;
+		}
+	}
+
+	assert(IS_IMPL_U64(systemstat.cpu.total));
+	assert(systemstat.cpulist.number > 0);
+	assert(systemstat.boot_time > 0);
+#if defined(SIGAR_TEST_OS_LINUX)
+	assert(IS_IMPL_U64(systemstat.ctxt));
+	assert(IS_IMPL_U64(systemstat.intr));
+	assert(IS_IMPL_U64(systemstat.processes));
+	assert(IS_IMPL_U64(systemstat.procs_running));
+	assert(systemstat.procs_running >= 1); /* us */
+#endif
+
+	for (i = 0; i < systemstat.cpulist.number; i++) {
+		assert(IS_IMPL_U64(systemstat.cpulist.data[i].total));
+	}
+
+	/* the getters are views over the same read */
+	assert(SIGAR_OK == sigar_cpu_get(t, &cpu));
+	assert(cpu.total >= systemstat.cpu.total);
+	assert(SIGAR_OK == sigar_cpu_list_get(t, &cpulist));
+	assert(cpulist.number <= systemstat.cpulist.number);
+	sigar_cpu_list_destroy(t, &cpulist);
+
+	sigar_system_stat_destroy(t, &systemstat);
+
+	return 0;
+}
+
+TEST(test_sigar_numa_get) {
+	sigar_numa_topology_t topology;
+	sigar_numa_mem_list_t memlist;
+	sigar_cpu_list_t cpulist;
+	size_t i;
+	int ret;
+
+	if (SIGAR_OK != (ret = sigar_numa_topology_get(t, &topology))) {
+		assert(ret == SIGAR_ENOTIMPL);
+		return 0;
+	}
+
+	assert(topology.number > 0);
+	for (i = 0; i < topology.number; i++) {
+		sigar_cpu_topology_t *cpu = &topology.data[i];
+
+		assert(cpu->cpu >= 0);
+		assert(cpu->node >= 0);
+		assert(cpu->thread >= 0);
+		if (i > 0) {
+			assert(cpu->cpu > topology.data[i - 1].cpu);
+		}
+	}
+
+	assert(SIGAR_OK == sigar_numa_mem_list_get(t, &memlist));
+	assert(memlist.number > 0);
+	for (i = 0; i < memlist.number; i++) {
+		sigar_numa_mem_t *mem = &memlist.data[i];
+
+		assert(mem->node >= 0);
+		assert(mem->free <= mem->total);
+		assert(mem->used <= mem->total);
+	}
+
+	assert(SIGAR_OK == sigar_numa_cpu_list_get(t, &cpulist));
+	assert(cpulist.number > 0);
+	for (i = 0; i < topology.number; i++) {
+		assert((unsigned long)topology.data[i].node < cpulist.number);
+		assert(cpulist.data[topology.data[i].node].total > 0);
+	}
+
+	sigar_cpu_list_destroy(t, &cpulist);
+	sigar_numa_mem_list_destroy(t, &memlist);
+	sigar_numa_topology_destroy(t, &topology);
+
+	return 0;
+}
+
 TEST(test_sigar_cpu_info_get) {
 	sigar_cpu_info_list_t cpuinfo;
 	size_t i;
@@ -131,6 +227,244 @@ TEST(test_sigar_cpu_info_get) {
 	return 0;
 }
 
+/* the second call is served from what the first one parsed */
+TEST(test_sigar_cpu_info_get_again) {
+	sigar_cpu_info_list_t first, again;
+	size_t i;
+
+	assert(SIGAR_OK == sigar_cpu_info_list_get(t, &first));
+	assert(SIGAR_OK == sigar_cpu_info_list_get(t, &again));
+	assert(first.number == again.number);
+	assert(first.data != again.data);
+
+	for (i = 0; i < first.number; i++) {
+		assert(strcmp(first.data[i].vendor, again.data[i].vendor) == 0);
+		assert(strcmp(first.data[i].model, again.data[i].model) == 0);
+		assert(first.data[i].cache_size == again.data[i].cache_size);
+		assert(first.data[i].mhz_max == again.data[i].mhz_max);
+		assert(first.data[i].total_cores == again.data[i].total_cores);
+		assert(IS_IMPL_INT(again.data[i].mhz));
+	}
+
+	sigar_cpu_info_list_destroy(t, &first);
+	sigar_cpu_info_list_destroy(t, &again);
+
+	return 0;
+}
+
+TEST(test_sigar_cpu_sampler) {
+	sigar_cpu_sampler_t *sampler;
+	sigar_cpu_perc_t perc;
+	sigar_cpu_perc_list_t percs;
+	sigar_cpu_list_t cpulist;
+	sigar_cpu_t cpu;
+	int i;
+
+	assert(SIGAR_OK == sigar_cpu_sampler_create(&sampler,
+	       SIGAR_SAMPLER_CPU | SIGAR_SAMPLER_CPU_LIST, 4));
+	memset(&percs, 0, sizeof(percs));
+
+	assert(ENOENT == sigar_cpu_sampler_perc_get(sampler, 0, &perc, &percs));
+
+	/* one second ticks, user time is 1, 2, 3 ... 6 of every 10 */
+	memset(&cpu, 0, sizeof(cpu));
+	cpulist.number = cpulist.size = 1;
+	cpulist.data = &cpu;
+	for (i = 0; i < 6; i++) {
+		cpu.user += i + 1;
+		cpu.idle += 10 - (i + 1);
+		assert(SIGAR_OK == sigar_cpu_sampler_add(sampler, i * 1000,
+		                                         &cpu, &cpulist));
+	}
+
+	assert(SIGAR_OK == sigar_cpu_sampler_perc_get(sampler, 0, &perc, &percs));
+	assert(perc.user > 0.59 && perc.user < 0.61);
+	assert(percs.number == 1);
+	assert(percs.data[0].user > 0.59 && percs.data[0].user < 0.61);
+
+	/* back to the 3000 sample: (5 + 6) / 20 */
+	assert(SIGAR_OK == sigar_cpu_sampler_perc_get(sampler, 2000, &perc, NULL));
+	assert(perc.user > 0.54 && perc.user < 0.56);
+
+	/* longer than the ring holds, uses the oldest: (4 + 5 + 6) / 30 */
+	assert(SIGAR_OK == sigar_cpu_sampler_perc_get(sampler, 60000, &perc, NULL));
+	assert(perc.user > 0.49 && perc.user < 0.51);
+
+	sigar_cpu_sampler_destroy(sampler);
+
+	/* live samples */
+	assert(SIGAR_OK == sigar_cpu_sampler_create(&sampler,
+	       SIGAR_SAMPLER_CPU | SIGAR_SAMPLER_CPU_LIST, 2));
+	assert(SIGAR_OK == sigar_cpu_sampler_update(t, sampler));
+	for (i = 0; i < 20000000; i++) {
+		cpu.user += i; /* burn a little cpu */
+	}
+	assert(SIGAR_OK == sigar_cpu_sampler_update(t, sampler));
+	assert(SIGAR_OK == sigar_cpu_sampler_perc_get(sampler, 0, &perc, &percs));
+	assert(perc.combined >= 0 && perc.combined <= 1);
+	assert(SIGAR_OK == sigar_cpu_list_get(t, &cpulist));
+	assert(percs.number == cpulist.number);
+	sigar_cpu_list_destroy(t, &cpulist);
+
+	sigar_cpu_perc_list_destroy(&percs);
+	sigar_cpu_sampler_destroy(sampler);
+
+	return 0;
+}
+
+#if defined(SIGAR_TEST_OS_LINUX)
+static void check_interrupt_list(sigar_interrupt_list_t *list) {
+	unsigned long i, j;
+
+	assert(list->ncpu > 0);
+	assert(list->number <= list->size);
+	for (i = 0; i < list->number; i++) {
+		sigar_uint64_t sum = 0;
+
+		assert(list->data[i].name[0]);
+		for (j = 0; j < list->ncpu; j++) {
+			sum += list->counts[i * list->ncpu + j];
+		}
+		/* or a system wide row */
+		assert(sum == list->data[i].total || sum == 0);
+	}
+}
+
+TEST(test_sigar_interrupts_get) {
+	sigar_interrupt_list_t list;
+	unsigned long i;
+	int found = 0;
+
+	if (SIGAR_OK == sigar_interrupts_get(t, &list)) {
+		check_interrupt_list(&list);
+		sigar_interrupt_list_destroy(t, &list);
+	}
+
+	if (SIGAR_OK != sigar_softirqs_get(t, &list)) {
+		return 0;
+	}
+	check_interrupt_list(&list);
+	for (i = 0; i < list.number; i++) {
+		if (strcmp(list.data[i].name, "NET_RX") == 0) {
+			assert(list.data[i].description[0] == '\0');
+			found = 1;
+		}
+	}
+	assert(found);
+	sigar_interrupt_list_destroy(t, &list);
+
+	return 0;
+}
+
+#define FIXTURE_NCPU 40
+
+static sigar_uint64_t fixture_count(int row, int cpu) {
+	/* 1 to 10 digits, so every width takes its turn */
+	static const sigar_uint64_t scale[] = {
+		1, 10, 100, 1000, 10000, 100000, 1000000, 10000000,
+		100000000, 1000000000
+	};
+
+	if ((row * 7 + cpu) % 4 == 0) {
+		return 0;
+	}
+	return ((row + cpu + 1) * scale[(row + cpu) % 10]) % 4294967296ULL;
+}
+
+/* wide enough rows, odd cpu numbers and padding for the vector path */
+TEST(test_sigar_interrupts_fixture) {
+	char dir[] = "/tmp/sigar_irqXXXXXX", path[256];
+	sigar_interrupt_list_t list;
+	sigar_t *fx;
+	FILE *fp;
+	int row, cpu;
+
+	assert(mkdtemp(dir));
+	snprintf(path, sizeof(path), "%s/interrupts", dir);
+	assert((fp = fopen(path, "w")));
+	fprintf(fp, "     ");
+	for (cpu = 0; cpu < FIXTURE_NCPU; cpu++) {
+		/* cpu 3 is offline */
+		fprintf(fp, "      CPU%-4d", cpu < 3 ? cpu : cpu + 1);
+	}
+	fprintf(fp, "\n");
+	for (row = 0; row < 20; row++) {
+		fprintf(fp, "%4d:", row);
+		for (cpu = 0; cpu < FIXTURE_NCPU; cpu++) {
+			fprintf(fp, row == 5 ? "\t%lu" : " %10lu",
+			        (unsigned long)fixture_count(row, cpu));
+		}
+		fprintf(fp, "   IR-PCI-MSI %d-edge      eth0-TxRx-%d  \n",
+		        524288 + row, row);
+	}
+	fprintf(fp, " NMI:");
+	for (cpu = 0; cpu < FIXTURE_NCPU; cpu++) {
+		fprintf(fp, " %10d", cpu);
+	}
+	fprintf(fp, "   Non-maskable interrupts\n");
+	fprintf(fp, " ERR:        123\n MIS:          0\n");
+	fclose(fp);
+
+	snprintf(path, sizeof(path), "%s/softirqs", dir);
+	assert((fp = fopen(path, "w")));
+	fprintf(fp, "                    CPU0       CPU1\n"
+	            "          HI:          1 4294967295\n"
+	            "      NET_RX:   12345678          9\n");
+	fclose(fp);
+
+	setenv("SIGAR_PROC_ROOT", dir, 1);
+	assert(SIGAR_OK == sigar_open(&fx));
+	unsetenv("SIGAR_PROC_ROOT");
+
+	assert(SIGAR_OK == sigar_interrupts_get(fx, &list));
+	assert(list.ncpu == FIXTURE_NCPU);
+	assert(list.cpus[2] == 2 && list.cpus[3] == 4);
+	assert(list.cpus[FIXTURE_NCPU - 1] == FIXTURE_NCPU);
+	assert(list.number == 23);
+	for (row = 0; row < 20; row++) {
+		sigar_uint64_t total = 0;
+		char name[16], description[64];
+
+		snprintf(name, sizeof(name), "%d", row);
+		snprintf(description, sizeof(description),
+		         "IR-PCI-MSI %d-edge      eth0-TxRx-%d", 524288 + row, row);
+		assert(strcmp(list.data[row].name, name) == 0);
+		assert(strcmp(list.data[row].description, description) == 0);
+		for (cpu = 0; cpu < FIXTURE_NCPU; cpu++) {
+			assert(list.counts[row * FIXTURE_NCPU + cpu] ==
+			       fixture_count(row, cpu));
+			total += fixture_count(row, cpu);
+		}
+		assert(list.data[row].total == total);
+	}
+	assert(strcmp(list.data[20].name, "NMI") == 0);
+	assert(list.counts[20 * FIXTURE_NCPU + 39] == 39);
+	assert(strcmp(list.data[20].description, "Non-maskable interrupts") == 0);
+	assert(strcmp(list.data[21].name, "ERR") == 0);
+	assert(list.data[21].total == 123);
+	assert(list.counts[21 * FIXTURE_NCPU] == 0);
+	assert(list.data[21].description[0] == '\0');
+	sigar_interrupt_list_destroy(fx, &list);
+
+	assert(SIGAR_OK == sigar_softirqs_get(fx, &list));
+	assert(list.ncpu == 2 && list.number == 2);
+	assert(strcmp(list.data[0].name, "HI") == 0);
+	assert(list.counts[1] == 4294967295ULL);
+	assert(list.data[1].total == 12345687);
+	sigar_interrupt_list_destroy(fx, &list);
+
+	sigar_close(fx);
+
+	snprintf(path, sizeof(path), "%s/interrupts", dir);
+	unlink(path);
+	snprintf(path, sizeof(path), "%s/softirqs", dir);
+	unlink(path);
+	rmdir(dir);
+
+	return 0;
+}
+#endif
+
 int main() {
 	sigar_t *t;
 	int err = 0;
@@ -139,7 +473,15 @@ int main() {
 
 	test_sigar_cpu_get(t);
 	test_sigar_cpu_list_get(t);
+	test_sigar_system_stat_get(t);
+	test_sigar_numa_get(t);
 	test_sigar_cpu_info_get(t);
+	test_sigar_cpu_info_get_again(t);
+	test_sigar_cpu_sampler(t);
+#if defined(SIGAR_TEST_OS_LINUX)
+	test_sigar_interrupts_get(t);
+	test_sigar_interrupts_fixture(t);
+#endif
 
 	sigar_close(t);
 
@@ -39,11 +39,17 @@
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
+#include <time.h>
 #if defined(MSVC)
 #include <WinError.h>
 #endif
+#if !defined(_WIN32)
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #include "sigar.h"
+#include "sigar_fileinfo.h"
 #include "sigar_private.h"
 #include "sigar_format.h"
 #include "sigar_tests.h"
@@ -149,6 +155,540 @@ TEST(test_sigar_file_system_list_get) {
 	return 0;
 }
 
+TEST(test_sigar_file_system_list_reuse) {
+	sigar_file_system_list_t first, second;
+	size_t i;
+
+	/* a second call may be served from the cached table, it must match */
+	assert(SIGAR_OK == sigar_file_system_list_get(t, &first));
+	assert(SIGAR_OK == sigar_file_system_list_get(t, &second));
+	assert(first.number == second.number);
+
+	for (i = 0; i < first.number; i++) {
+		assert(strcmp(first.data[i].dir_name, second.data[i].dir_name) == 0);
+		assert(first.data[i].type == second.data[i].type);
+		assert(strcmp(first.data[i].type_name, second.data[i].type_name) == 0);
+	}
+
+	/* the caller owns its copy */
+	first.data[0].dir_name[0] = '\0';
+	sigar_file_system_list_destroy(t, &first);
+	assert(second.data[0].dir_name[0] != '\0');
+	sigar_file_system_list_destroy(t, &second);
+
+	assert(SIGAR_OK == sigar_file_system_list_get(t, &first));
+	assert(first.data[0].dir_name[0] != '\0');
+	sigar_file_system_list_destroy(t, &first);
+
+	return 0;
+}
+
+TEST(test_sigar_file_system_usage_list_get) {
+	sigar_file_system_list_t fslist;
+	sigar_file_system_usage_list_t usagelist;
+	size_t i;
+
+	assert(SIGAR_OK == sigar_file_system_list_get(t, &fslist));
+
+	assert(EINVAL == sigar_file_system_usage_list_get(t, &fslist, 0, &usagelist));
+
+	assert(SIGAR_OK == sigar_file_system_usage_list_get(t, &fslist, 5000, &usagelist));
+	assert(usagelist.number == fslist.number);
+
+	for (i = 0; i < usagelist.number; i++) {
+		sigar_file_system_usage_entry_t *entry = &usagelist.data[i];
+		sigar_file_system_usage_t fsusage;
+
+		if (entry->status != SIGAR_OK) {
+			fprintf(stderr, "sigar_file_system_usage_list_get(%s) status = %d (%s)\n",
+					fslist.data[i].dir_name,
+					entry->status, sigar_strerror(t, entry->status));
+			continue;
+		}
+
+		assert(IS_IMPL_U64(entry->usage.total));
+		assert(IS_IMPL_U64(entry->usage.free));
+		assert(IS_IMPL_U64(entry->usage.used));
+		assert(IS_IMPL_U64(entry->usage.avail));
+		assert(entry->usage.use_percent >= 0);
+
+		/* same mount, same size as the one at a time call */
+		if (SIGAR_OK == sigar_file_system_usage_get(t, fslist.data[i].dir_name, &fsusage)) {
+			assert(fsusage.total == entry->usage.total);
+		}
+	}
+
+	assert(SIGAR_OK == sigar_file_system_usage_list_destroy(t, &usagelist));
+	sigar_file_system_list_destroy(t, &fslist);
+
+	return 0;
+}
+
+TEST(test_sigar_disk_usage_list_get) {
+	sigar_disk_usage_list_t disklist;
+	size_t i;
+	int ret, pass;
+
+	/* the second pass has deltas against the first */
+	for (pass = 0; pass < 2; pass++) {
+		ret = sigar_disk_usage_list_get(t, &disklist);
+		if (ret == SIGAR_ENOTIMPL) {
+			return 0;
+		}
+		assert(ret == SIGAR_OK);
+
+		for (i = 0; i < disklist.number; i++) {
+			sigar_disk_usage_entry_t *entry = &disklist.data[i];
+
+			assert(entry->name[0] != '\0');
+			assert(IS_IMPL_U64(entry->disk.reads));
+			assert(IS_IMPL_U64(entry->disk.writes));
+			assert(IS_IMPL_U64(entry->disk.read_bytes));
+			assert(IS_IMPL_U64(entry->disk.write_bytes));
+			assert(IS_IMPL_U64(entry->disk.snaptime));
+		}
+
+		assert(SIGAR_OK == sigar_disk_usage_list_destroy(t, &disklist));
+	}
+
+	return 0;
+}
+
+#if !defined(_WIN32)
+TEST(test_sigar_file_system_ping_list) {
+	sigar_file_system_list_t fslist;
+	char *hosts[] = { "127.0.0.1", "127.0.0.1", "127.0.0.1", "127.0.0.1" };
+	int results[4], *fsresults;
+	time_t start;
+	size_t i;
+
+	/* no answer from any of them still takes one budget, not four */
+	start = time(NULL);
+	assert(SIGAR_OK == sigar_rpc_ping_list(hosts, 4, SIGAR_NETCONN_UDP,
+	                                       100003, 3, 500, results));
+	assert(time(NULL) - start <= 2);
+	assert(results[0] == results[3]);
+
+	assert(SIGAR_OK == sigar_rpc_ping_list(hosts, 1, SIGAR_NETCONN_TCP + 42,
+	                                       100003, 3, 500, results));
+	assert(results[0] != SIGAR_OK);
+
+	assert(SIGAR_OK == sigar_file_system_list_get(t, &fslist));
+	fsresults = malloc(sizeof(*fsresults) * (fslist.number + 1));
+	assert(SIGAR_OK == sigar_file_system_ping_list(t, &fslist, 500, fsresults));
+	for (i = 0; i < fslist.number; i++) {
+		if (fslist.data[i].type != SIGAR_FSTYPE_NETWORK) {
+			assert(fsresults[i] == SIGAR_OK);
+		}
+	}
+	free(fsresults);
+	sigar_file_system_list_destroy(t, &fslist);
+
+	return 0;
+}
+#endif
+
+#if !defined(_WIN32)
+TEST(test_sigar_dir_usage_walk) {
+	char dir[] = "/tmp/sigar-dir-usage-XXXXXX";
+	char path[256];
+	sigar_dir_usage_t serial, walked;
+	sigar_dir_usage_opts_t opts;
+	FILE *fp;
+	int i, j;
+
+	assert(mkdtemp(dir));
+
+	/* 4 subdirs of 8 files each */
+	for (i = 0; i < 4; i++) {
+		snprintf(path, sizeof(path), "%s/d%d", dir, i);
+		assert(mkdir(path, 0700) == 0);
+		for (j = 0; j < 8; j++) {
+			snprintf(path, sizeof(path), "%s/d%d/f%d", dir, i, j);
+			assert((fp = fopen(path, "w")));
+			fputs("sigar", fp);
+			fclose(fp);
+		}
+	}
+
+	assert(SIGAR_OK == sigar_dir_usage_get(t, dir, &serial));
+	assert(serial.subdirs == 4);
+	assert(serial.files == 32);
+
+	memset(&opts, 0, sizeof(opts));
+	opts.threads = 4;
+	assert(SIGAR_OK == sigar_dir_usage_walk(t, dir, &opts, &walked));
+	assert(walked.total == serial.total);
+	assert(walked.files == serial.files);
+	assert(walked.disk_usage == serial.disk_usage);
+
+	opts.incremental = 1;
+	for (i = 0; i < 2; i++) {
+		assert(SIGAR_OK == sigar_dir_usage_walk(t, dir, &opts, &walked));
+		assert(walked.total == serial.total);
+		assert(walked.disk_usage == serial.disk_usage);
+	}
+
+	/* the top directory alone is over budget */
+	opts.max_entries = 1;
+	assert(ETIMEDOUT == sigar_dir_usage_walk(t, dir, &opts, &walked));
+	assert(walked.total < serial.total);
+
+	assert(ENOENT == sigar_dir_usage_walk(t, "/nonexistent-sigar-dir", &opts, &walked));
+
+	for (i = 0; i < 4; i++) {
+		for (j = 0; j < 8; j++) {
+			snprintf(path, sizeof(path), "%s/d%d/f%d", dir, i, j);
+			unlink(path);
+		}
+		snprintf(path, sizeof(path), "%s/d%d", dir, i);
+		rmdir(path);
+	}
+	rmdir(dir);
+
+	return 0;
+}
+
+static int file_watch_flags(sigar_file_watch_t *watch, int id) {
+	sigar_file_watch_event_list_t events;
+	size_t i;
+	int flags = 0;
+
+	assert(SIGAR_OK == sigar_file_watch_wait(watch, 1000, &events));
+	for (i = 0; i < events.number; i++) {
+		if (events.data[i].id == id) {
+			flags |= events.data[i].flags;
+		}
+	}
+	sigar_file_watch_event_list_destroy(&events);
+
+	return flags;
+}
+
+TEST(test_sigar_file_watch) {
+	char dir[] = "/tmp/sigar-file-watch-XXXXXX";
+	char path[256];
+	sigar_file_watch_t *watch;
+	sigar_file_watch_event_list_t events;
+	FILE *fp;
+	int id, ret;
+
+	if (SIGAR_ENOTIMPL == (ret = sigar_file_watch_create(&watch))) {
+		return 0;
+	}
+	assert(SIGAR_OK == ret);
+
+	assert(mkdtemp(dir));
+	snprintf(path, sizeof(path), "%s/watched.log", dir);
+	assert((fp = fopen(path, "w")));
+	fclose(fp);
+
+	assert(SIGAR_OK == sigar_file_watch_add(watch, path, &id));
+	assert(ENOENT == sigar_file_watch_add(watch, "/nonexistent-sigar-file", &ret));
+
+	/* nothing happened yet */
+	assert(SIGAR_OK == sigar_file_watch_wait(watch, 0, &events));
+	assert(events.number == 0);
+	sigar_file_watch_event_list_destroy(&events);
+
+	assert((fp = fopen(path, "a")));
+	fputs("line\n", fp);
+	fclose(fp);
+	assert(file_watch_flags(watch, id) & SIGAR_FILE_WATCH_MODIFY);
+
+	/* rotated away and back */
+	unlink(path);
+	assert(file_watch_flags(watch, id) & SIGAR_FILE_WATCH_DELETE);
+	assert((fp = fopen(path, "w")));
+	fclose(fp);
+	assert(file_watch_flags(watch, id) & SIGAR_FILE_WATCH_CREATE);
+
+	assert(SIGAR_OK == sigar_file_watch_remove(watch, id));
+	assert(EINVAL == sigar_file_watch_remove(watch, id));
+	assert(SIGAR_OK == sigar_file_watch_destroy(watch));
+
+	unlink(path);
+	rmdir(dir);
+
+	return 0;
+}
+
+static void file_tail_append(const char *path, const char *mode, const char *data) {
+	FILE *fp;
+
+	assert((fp = fopen(path, mode)));
+	fputs(data, fp);
+	fclose(fp);
+}
+
+TEST(test_sigar_file_tail) {
+	char dir[] = "/tmp/sigar-file-tail-XXXXXX";
+	char path[256], rotated[256], buf[64];
+	sigar_file_tail_t *tail;
+	size_t nread;
+	int flags;
+
+	assert(mkdtemp(dir));
+	snprintf(path, sizeof(path), "%s/access.log", dir);
+	snprintf(rotated, sizeof(rotated), "%s/access.log.1", dir);
+	file_tail_append(path, "w", "before\n");
+
+	/* from the end, what was there is skipped */
+	assert(SIGAR_OK == sigar_file_tail_open(t, path, -1, &tail));
+	assert(sigar_file_tail_offset(tail) == 7);
+	assert(SIGAR_OK == sigar_file_tail_read(t, tail, buf, sizeof(buf), &nread, &flags));
+	assert(nread == 0);
+
+	file_tail_append(path, "a", "one\n");
+	assert(SIGAR_OK == sigar_file_tail_read(t, tail, buf, sizeof(buf), &nread, &flags));
+	assert(nread == 4 && flags == 0);
+	assert(memcmp(buf, "one\n", 4) == 0);
+
+	/* truncated, read again from the start */
+	file_tail_append(path, "w", "ab\n");
+	assert(SIGAR_OK == sigar_file_tail_read(t, tail, buf, sizeof(buf), &nread, &flags));
+	assert(flags & SIGAR_FILE_TAIL_TRUNCATED);
+	assert(nread == 3 && memcmp(buf, "ab\n", 3) == 0);
+
+	/* rotated, the old file is drained before the new one is read */
+	assert(rename(path, rotated) == 0);
+	file_tail_append(rotated, "a", "late\n");
+	file_tail_append(path, "w", "new\n");
+
+	assert(SIGAR_OK == sigar_file_tail_read(t, tail, buf, sizeof(buf), &nread, &flags));
+	assert(flags == 0);
+	assert(nread == 5 && memcmp(buf, "late\n", 5) == 0);
+
+	assert(SIGAR_OK == sigar_file_tail_read(t, tail, buf, sizeof(buf), &nread, &flags));
+	assert(flags & SIGAR_FILE_TAIL_ROTATED);
+	assert(nread == 4 && memcmp(buf, "new\n", 4) == 0);
+	assert(sigar_file_tail_offset(tail) == 4);
+
+	assert(SIGAR_OK == sigar_file_tail_close(tail));
+
+	assert(ENOENT == sigar_file_tail_open(t, "/nonexistent-sigar-file", 0, &tail));
+
+	unlink(path);
+	unlink(rotated);
+	rmdir(dir);
+
+	return 0;
+}
+
+/* more directories than the call keeps open, so some are reopened */
+#define FILE_ATTRS_SUBDIRS 10
+
+TEST(test_sigar_file_attrs_list_get) {
+	char dir[] = "/tmp/sigar-file-attrs-XXXXXX";
+	char subdirs[FILE_ATTRS_SUBDIRS][256];
+	/* room for any subdir and "/f" */
+	char files[FILE_ATTRS_SUBDIRS][sizeof(subdirs[0]) + 2];
+	char link[256], missing[256], trailing[256];
+	const char *paths[2 * FILE_ATTRS_SUBDIRS + 5];
+	sigar_file_attrs_result_t results[2 * FILE_ATTRS_SUBDIRS + 5];
+	sigar_file_attrs_t attrs;
+	unsigned long n = 0, i;
+	FILE *fp;
+
+	assert(mkdtemp(dir));
+	for (i = 0; i < FILE_ATTRS_SUBDIRS; i++) {
+		snprintf(subdirs[i], sizeof(subdirs[i]), "%s/d%d", dir, (int)i);
+		assert(0 == mkdir(subdirs[i], 0700));
+		snprintf(files[i], sizeof(files[i]), "%s/f", subdirs[i]);
+		assert((fp = fopen(files[i], "w")));
+		fprintf(fp, "%*s", (int)(i + 1) * 10, "x");
+		fclose(fp);
+	}
+	snprintf(link, sizeof(link), "%s/l", dir);
+	assert(0 == symlink(files[0], link));
+	snprintf(missing, sizeof(missing), "%s/nothere", dir);
+	snprintf(trailing, sizeof(trailing), "%s/", dir);
+
+	/* back and forth between the directories */
+	for (i = 0; i < FILE_ATTRS_SUBDIRS; i++) {
+		paths[n++] = files[i];
+	}
+	for (i = 0; i < FILE_ATTRS_SUBDIRS; i++) {
+		paths[n++] = files[FILE_ATTRS_SUBDIRS - 1 - i];
+	}
+	paths[n++] = link;
+	paths[n++] = missing;
+	paths[n++] = trailing;
+	paths[n++] = "/";
+	paths[n++] = ".";
+
+	assert(SIGAR_OK == sigar_file_attrs_list_get(t, paths, n,
+	                                             SIGAR_FILE_ATTR_ALL |
+	                                             SIGAR_FILE_ATTR_NOSYNC,
+	                                             results));
+	for (i = 0; i < n; i++) {
+		if (paths[i] == missing) {
+			assert(results[i].status == ENOENT);
+			continue;
+		}
+		assert(results[i].status == SIGAR_OK);
+		assert(SIGAR_OK == sigar_file_attrs_get(t, paths[i], &attrs));
+		assert(results[i].attrs.type == attrs.type);
+		assert(results[i].attrs.permissions == attrs.permissions);
+		assert(results[i].attrs.uid == attrs.uid);
+		assert(results[i].attrs.gid == attrs.gid);
+		assert(results[i].attrs.inode == attrs.inode);
+		assert(results[i].attrs.device == attrs.device);
+		assert(results[i].attrs.nlink == attrs.nlink);
+		assert(results[i].attrs.size == attrs.size);
+		assert(results[i].attrs.mtime == attrs.mtime);
+	}
+	/* followed to the file */
+	assert(results[2 * FILE_ATTRS_SUBDIRS].attrs.type == SIGAR_FILETYPE_REG);
+	assert(results[2 * FILE_ATTRS_SUBDIRS].attrs.size == 10);
+	assert(results[n - 3].attrs.type == SIGAR_FILETYPE_DIR);
+
+	/* only what was asked for, the link itself */
+	assert(SIGAR_OK == sigar_file_attrs_list_get(t, paths, n,
+	                                             SIGAR_FILE_ATTR_TYPE |
+	                                             SIGAR_FILE_ATTR_SIZE |
+	                                             SIGAR_FILE_ATTR_LINK,
+	                                             results));
+	for (i = 0; i < FILE_ATTRS_SUBDIRS; i++) {
+		assert(results[i].status == SIGAR_OK);
+		assert(results[i].attrs.type == SIGAR_FILETYPE_REG);
+		assert(results[i].attrs.size == (i + 1) * 10);
+		assert(results[i].attrs.inode == 0);
+		assert(results[i].attrs.nlink == 0);
+		assert(results[i].attrs.permissions == 0);
+		assert(results[i].attrs.device == 0);
+		assert(results[i].attrs.mtime == 0);
+	}
+	assert(results[2 * FILE_ATTRS_SUBDIRS].attrs.type == SIGAR_FILETYPE_LNK);
+	assert(results[2 * FILE_ATTRS_SUBDIRS + 1].status == ENOENT);
+
+	unlink(link);
+	for (i = 0; i < FILE_ATTRS_SUBDIRS; i++) {
+		unlink(files[i]);
+		rmdir(subdirs[i]);
+	}
+	rmdir(dir);
+
+	return 0;
+}
+#endif
+
+#if defined(SIGAR_TEST_OS_LINUX)
+static void nfs_root_write(const char *dir, const char *name,
+                           const char *content) {
+	char path[256];
+	FILE *fp;
+
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	assert((fp = fopen(path, "w")));
+	fputs(content, fp);
+	fclose(fp);
+}
+
+static const char *nfs_root_files[] = {
+	"net/rpc/nfs", "net/rpc/nfsd", "self/mountstats"
+};
+
+static const char *nfs_root_dirs[] = {
+	"net/rpc", "net", "self"
+};
+
+TEST(test_sigar_nfs_proc_root) {
+	char dir[] = "/tmp/sigar-nfs-root-XXXXXX";
+	char path[256];
+	sigar_t *fx;
+	sigar_nfs_stats_t stats;
+	sigar_nfs_client_v3_t v3;
+	sigar_nfs_server_v2_t v2;
+	sigar_nfs_mount_list_t mounts;
+	sigar_nfs_mount_t *mount;
+	size_t i;
+
+	assert(mkdtemp(dir));
+	snprintf(path, sizeof(path), "%s/net", dir);
+	assert(mkdir(path, 0700) == 0);
+	snprintf(path, sizeof(path), "%s/net/rpc", dir);
+	assert(mkdir(path, 0700) == 0);
+	snprintf(path, sizeof(path), "%s/self", dir);
+	assert(mkdir(path, 0700) == 0);
+
+	nfs_root_write(dir, "net/rpc/nfs",
+	               "net 0 0 0 0\n"
+	               "rpc 100 0 100\n"
+	               "proc3 22 1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16 17 18 19 20 21 22\n"
+	               "proc4 3 7 8 9\n");
+	nfs_root_write(dir, "net/rpc/nfsd",
+	               "rc 0 0 0\n"
+	               "proc2 18 1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16 17 18\n"
+	               "proc4ops 2 0 42\n");
+	nfs_root_write(dir, "self/mountstats",
+	               "device proc mounted on /proc with fstype proc\n"
+	               "device srv:/export mounted on /mnt/export with fstype nfs4 statvers=1.1\n"
+	               "\topts:\trw,vers=4.2\n"
+	               "\tage:\t120\n"
+	               "\tper-op statistics\n"
+	               "\t        NULL: 1 1 0 44 24 0 0 1 0\n"
+	               "\t        READ: 10 11 1 1000 2000 3 40 50 2\n"
+	               "\t       WRITE: 5 5 0 500 100 1 20 25\n"
+	               "\n"
+	               "device /dev/sda1 mounted on / with fstype ext4\n");
+
+	setenv("SIGAR_PROC_ROOT", dir, 1);
+	assert(SIGAR_OK == sigar_open(&fx));
+	unsetenv("SIGAR_PROC_ROOT");
+
+	assert(SIGAR_OK == sigar_nfs_stats_get(fx, &stats));
+	assert(stats.client.versions == (SIGAR_NFS_V3 | SIGAR_NFS_V4));
+	assert(stats.client.v3.null == 1);
+	assert(stats.client.v3.commit == 22);
+	assert(stats.client.v4_number == 3);
+	assert(stats.client.v4[2] == 9);
+	assert(stats.server.versions == (SIGAR_NFS_V2 | SIGAR_NFS_V4));
+	assert(stats.server.v2.fsstat == 18);
+	assert(stats.server.v4_number == 2);
+	assert(stats.server.v4[1] == 42);
+
+	assert(SIGAR_OK == sigar_nfs_client_v3_get(fx, &v3));
+	assert(v3.read == 7);
+	assert(SIGAR_OK == sigar_nfs_server_v2_get(fx, &v2));
+	assert(v2.lookup == 5);
+	assert(ENOENT == sigar_nfs_server_v3_get(fx, (sigar_nfs_server_v3_t *)&v3));
+
+	assert(SIGAR_OK == sigar_nfs_mount_list_get(fx, &mounts));
+	assert(mounts.number == 1);
+	mount = &mounts.data[0];
+	assert(strcmp(mount->dev_name, "srv:/export") == 0);
+	assert(strcmp(mount->dir_name, "/mnt/export") == 0);
+	assert(strcmp(mount->sys_type_name, "nfs4") == 0);
+	assert(mount->age == 120);
+	assert(mount->number == 3);
+	assert(strcmp(mount->ops[1].name, "READ") == 0);
+	assert(mount->ops[1].bytes_received == 2000);
+	assert(mount->ops[1].execute_time == 50);
+	assert(mount->ops[1].errors == 2);
+	assert(mount->ops[2].errors == SIGAR_FIELD_NOTIMPL);
+	assert(SIGAR_OK == sigar_nfs_mount_list_destroy(fx, &mounts));
+
+	sigar_close(fx);
+
+	/* the root is process wide, put the real one back for t */
+	assert(SIGAR_OK == sigar_open(&fx));
+	sigar_close(fx);
+
+	for (i = 0; i < sizeof(nfs_root_files) / sizeof(*nfs_root_files); i++) {
+		snprintf(path, sizeof(path), "%s/%s", dir, nfs_root_files[i]);
+		unlink(path);
+	}
+	for (i = 0; i < sizeof(nfs_root_dirs) / sizeof(*nfs_root_dirs); i++) {
+		snprintf(path, sizeof(path), "%s/%s", dir, nfs_root_dirs[i]);
+		rmdir(path);
+	}
+	rmdir(dir);
+
+	return 0;
+}
+#endif
+
 int main() {
 	sigar_t *t;
 	int err = 0;
@@ -156,6 +696,19 @@ int main() {
 	assert(SIGAR_OK == sigar_open(&t));
 
 	test_sigar_file_system_list_get(t);
+	test_sigar_file_system_list_reuse(t);
+	test_sigar_file_system_usage_list_get(t);
+	test_sigar_disk_usage_list_get(t);
+#if !defined(_WIN32)
+	test_sigar_file_system_ping_list(t);
+	test_sigar_dir_usage_walk(t);
+	test_sigar_file_watch(t);
+	test_sigar_file_tail(t);
+	test_sigar_file_attrs_list_get(t);
+#endif
+#if defined(SIGAR_TEST_OS_LINUX)
+	test_sigar_nfs_proc_root(t);
+#endif
 
 	sigar_close(t);
 
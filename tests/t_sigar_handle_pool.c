@@ -0,0 +1,132 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#ifndef WIN32
+#include <pthread.h>
+#endif
+
+#include "sigar.h"
+#include "sigar_tests.h"
+
+TEST(test_sigar_handle_pool_get) {
+	sigar_handle_pool_t *pool;
+	sigar_t *a, *b, *c;
+	sigar_mem_t mem;
+
+	assert(SIGAR_OK != sigar_handle_pool_create(&pool, 0));
+	assert(SIGAR_OK == sigar_handle_pool_create(&pool, 2));
+
+	assert(SIGAR_OK == sigar_handle_pool_get(pool, &a));
+	assert(SIGAR_OK == sigar_handle_pool_get(pool, &b));
+	assert(a != b);
+	assert(SIGAR_OK == sigar_mem_get(a, &mem));
+	assert(SIGAR_OK == sigar_mem_get(b, &mem));
+
+	/* idle handles are reused, not reopened */
+	sigar_handle_pool_put(pool, a);
+	assert(SIGAR_OK == sigar_handle_pool_get(pool, &c));
+	assert(c == a);
+
+	sigar_handle_pool_put(pool, b);
+	sigar_handle_pool_put(pool, c);
+
+	assert(SIGAR_OK == sigar_handle_pool_destroy(pool));
+
+	return 0;
+}
+
+#ifndef WIN32
+#define WORKERS 4
+#define HANDLES 2
+
+static pthread_mutex_t seen_lock = PTHREAD_MUTEX_INITIALIZER;
+static sigar_t *seen[WORKERS];
+static int nseen = 0;
+
+static void handle_seen(sigar_t *sigar) {
+	int i;
+
+	pthread_mutex_lock(&seen_lock);
+	for (i = 0; i < nseen; i++) {
+		if (seen[i] == sigar) {
+			break;
+		}
+	}
+	if (i == nseen) {
+		seen[nseen++] = sigar;
+	}
+	pthread_mutex_unlock(&seen_lock);
+}
+
+static void *pool_worker(void *data) {
+	sigar_handle_pool_t *pool = data;
+	int i;
+
+	for (i = 0; i < 200; i++) {
+		sigar_t *sigar;
+		sigar_proc_stat_t procstat;
+
+		assert(SIGAR_OK == sigar_handle_pool_get(pool, &sigar));
+		handle_seen(sigar);
+		assert(SIGAR_OK == sigar_proc_stat_get(sigar, &procstat));
+		assert(procstat.total > 0);
+		sigar_handle_pool_put(pool, sigar);
+	}
+
+	return NULL;
+}
+
+TEST(test_sigar_handle_pool_workers) {
+	sigar_handle_pool_t *pool;
+	pthread_t workers[WORKERS];
+	int i;
+
+	assert(SIGAR_OK == sigar_handle_pool_create(&pool, HANDLES));
+
+	for (i = 0; i < WORKERS; i++) {
+		assert(0 == pthread_create(&workers[i], NULL, pool_worker, pool));
+	}
+	for (i = 0; i < WORKERS; i++) {
+		pthread_join(workers[i], NULL);
+	}
+
+	/* more workers than handles, they waited their turn */
+	assert(nseen > 0);
+	assert(nseen <= HANDLES);
+
+	assert(SIGAR_OK == sigar_handle_pool_destroy(pool));
+
+	return 0;
+}
+#endif
+
+int main() {
+	sigar_t *t;
+	int err = 0;
+
+	assert(SIGAR_OK == sigar_open(&t));
+
+	test_sigar_handle_pool_get(t);
+#ifndef WIN32
+	test_sigar_handle_pool_workers(t);
+#endif
+
+	sigar_close(t);
+
+	return err ? -1 : 0;
+}
@@ -69,6 +69,33 @@ TEST(test_sigar_loadavg_get) {
 	return 0;
 }
 
+static void check_pressure_stall(sigar_pressure_stall_t *stall) {
+	if (stall->avg10 != SIGAR_FIELD_NOTIMPL) {
+		assert(stall->avg10 >= 0 && stall->avg10 <= 100);
+		assert(stall->avg60 >= 0 && stall->avg60 <= 100);
+		assert(stall->avg300 >= 0 && stall->avg300 <= 100);
+	}
+}
+
+TEST(test_sigar_pressure_get) {
+	sigar_pressure_t pressure;
+	int ret;
+
+	if (SIGAR_OK == (ret = sigar_pressure_get(t, &pressure))) {
+		check_pressure_stall(&pressure.cpu.some);
+		check_pressure_stall(&pressure.cpu.full);
+		check_pressure_stall(&pressure.memory.some);
+		check_pressure_stall(&pressure.memory.full);
+		check_pressure_stall(&pressure.io.some);
+		check_pressure_stall(&pressure.io.full);
+	} else {
+		/* kernels before 4.20 or without CONFIG_PSI */
+		assert(ret == SIGAR_ENOTIMPL);
+	}
+
+	return 0;
+}
+
 int main() {
 	sigar_t *t;
 	int err = 0;
@@ -76,6 +103,7 @@ int main() {
 	assert(SIGAR_OK == sigar_open(&t));
 
 	test_sigar_loadavg_get(t);
+	test_sigar_pressure_get(t);
 
 	sigar_close(t);
 
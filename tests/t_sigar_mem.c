@@ -62,6 +62,35 @@ TEST(test_sigar_mem_get) {
 	return 0;
 }
 
+TEST(test_sigar_mem_ext_get) {
+	sigar_mem_ext_t memext;
+	sigar_mem_t mem;
+	sigar_swap_t swap;
+
+	assert(SIGAR_OK == sigar_mem_ext_get(t, &memext));
+
+	assert(IS_IMPL_U64(memext.total));
+	assert(IS_IMPL_U64(memext.free));
+	assert(memext.free <= memext.total);
+	assert(IS_IMPL_U64(memext.swap_total));
+#if defined(SIGAR_TEST_OS_LINUX)
+	assert(IS_IMPL_U64(memext.available));
+	assert(memext.available <= memext.total);
+	assert(IS_IMPL_U64(memext.cached));
+	assert(IS_IMPL_U64(memext.buffers));
+	assert(IS_IMPL_U64(memext.slab));
+	assert(IS_IMPL_U64(memext.committed_as));
+#endif
+
+	/* the classic getters agree with it */
+	assert(SIGAR_OK == sigar_mem_get(t, &mem));
+	assert(mem.total == memext.total);
+	assert(SIGAR_OK == sigar_swap_get(t, &swap));
+	assert(swap.total == memext.swap_total);
+
+	return 0;
+}
+
 int main() {
 	sigar_t *t;
 	int err = 0;
@@ -69,6 +98,7 @@ int main() {
 	assert(SIGAR_OK == sigar_open(&t));
 
 	test_sigar_mem_get(t);
+	test_sigar_mem_ext_get(t);
 
 	sigar_close(t);
 
@@ -45,6 +45,14 @@
 #include "sigar_format.h"
 #include "sigar_tests.h"
 
+#if defined(SIGAR_TEST_OS_LINUX)
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/stat.h>
+#endif
+
 TEST(test_sigar_net_connections_get) {
 	sigar_net_connection_list_t connlist;
 	size_t i;
@@ -84,6 +92,484 @@ TEST(test_sigar_net_connections_get) {
 	return 0;
 }
 
+#if defined(SIGAR_TEST_OS_LINUX)
+/* a listener of our own has to show up whichever backend is used */
+TEST(test_sigar_net_connections_listen) {
+	sigar_net_connection_list_t connlist;
+	sigar_net_stat_t netstat;
+	sigar_net_address_t address;
+	struct sockaddr_in sin;
+	socklen_t len = sizeof(sin);
+	sigar_pid_t pid, pids[3];
+	unsigned long port, ports[3];
+	size_t i;
+	int fd, found = 0;
+
+	assert((fd = socket(AF_INET, SOCK_STREAM, 0)) >= 0);
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	assert(bind(fd, (struct sockaddr *)&sin, sizeof(sin)) == 0);
+	assert(listen(fd, 8) == 0);
+	assert(getsockname(fd, (struct sockaddr *)&sin, &len) == 0);
+	port = ntohs(sin.sin_port);
+
+	assert(SIGAR_OK == sigar_net_connection_list_get(t, &connlist,
+				SIGAR_NETCONN_SERVER | SIGAR_NETCONN_TCP));
+	for (i = 0; i < connlist.number; i++) {
+		sigar_net_connection_t *con = &connlist.data[i];
+
+		assert(con->remote_port == 0);
+		if (con->local_port == port) {
+			assert(con->state == SIGAR_TCP_LISTEN);
+			assert(con->local_address.family == SIGAR_AF_INET);
+			assert(con->local_address.addr.in == htonl(INADDR_LOOPBACK));
+			assert(con->uid == getuid());
+			assert(con->send_queue == 0);
+			found++;
+		}
+	}
+	assert(found == 1);
+	assert(SIGAR_OK == sigar_net_connection_list_destroy(t, &connlist));
+
+	/* client only must not see it */
+	assert(SIGAR_OK == sigar_net_connection_list_get(t, &connlist,
+				SIGAR_NETCONN_CLIENT | SIGAR_NETCONN_TCP));
+	for (i = 0; i < connlist.number; i++) {
+		assert(connlist.data[i].remote_port != 0);
+	}
+	assert(SIGAR_OK == sigar_net_connection_list_destroy(t, &connlist));
+
+	assert(SIGAR_OK == sigar_proc_port_get(t, SIGAR_NETCONN_TCP, port, &pid));
+	assert(pid == getpid());
+
+	/* port 0 never listens */
+	ports[0] = port;
+	ports[1] = 0;
+	ports[2] = port;
+	assert(SIGAR_OK == sigar_proc_port_list_get(t, SIGAR_NETCONN_TCP,
+				ports, 3, pids));
+	assert(pids[0] == getpid());
+	assert(pids[1] == 0);
+	assert(pids[2] == getpid());
+
+	/* served from the inode index this time */
+	assert(SIGAR_OK == sigar_proc_port_get(t, SIGAR_NETCONN_TCP, port, &pid));
+	assert(pid == getpid());
+
+	address.family = SIGAR_AF_INET;
+	address.addr.in = htonl(INADDR_LOOPBACK);
+	assert(SIGAR_OK == sigar_net_stat_port_get(t, &netstat,
+				SIGAR_NETCONN_SERVER | SIGAR_NETCONN_CLIENT |
+				SIGAR_NETCONN_TCP, &address, port));
+	assert(netstat.tcp_inbound_total == 1);
+	assert(netstat.tcp_states[SIGAR_TCP_LISTEN] == 1);
+
+	close(fd);
+
+	return 0;
+}
+
+TEST(test_sigar_net_stat_get) {
+	sigar_net_stat_t summary, walked;
+	sigar_net_address_t address;
+	sigar_tcp_t tcp;
+	struct sockaddr_in sin;
+	socklen_t len = sizeof(sin);
+	int lfd, cfd, afd, flags =
+		SIGAR_NETCONN_SERVER | SIGAR_NETCONN_CLIENT | SIGAR_NETCONN_TCP;
+
+	/* a listener and both ends of one connection to it */
+	assert((lfd = socket(AF_INET, SOCK_STREAM, 0)) >= 0);
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	assert(bind(lfd, (struct sockaddr *)&sin, sizeof(sin)) == 0);
+	assert(listen(lfd, 8) == 0);
+	assert(getsockname(lfd, (struct sockaddr *)&sin, &len) == 0);
+	assert((cfd = socket(AF_INET, SOCK_STREAM, 0)) >= 0);
+	assert(connect(cfd, (struct sockaddr *)&sin, sizeof(sin)) == 0);
+	assert((afd = accept(lfd, NULL, NULL)) >= 0);
+
+	assert(SIGAR_OK == sigar_net_stat_get(t, &summary, flags));
+	assert(summary.tcp_states[SIGAR_TCP_LISTEN] >= 1);
+	assert(summary.tcp_states[SIGAR_TCP_ESTABLISHED] >= 2);
+	assert(summary.tcp_inbound_total >= 1);
+	assert(summary.tcp_outbound_total >= 1);
+	assert(summary.all_inbound_total == summary.tcp_inbound_total);
+	assert(SIGAR_OK == sigar_net_listen_address_get(t, ntohs(sin.sin_port),
+				&address));
+	assert(address.addr.in == htonl(INADDR_LOOPBACK));
+
+	/* server only */
+	assert(SIGAR_OK == sigar_net_stat_get(t, &summary,
+				SIGAR_NETCONN_SERVER | SIGAR_NETCONN_TCP));
+	assert(summary.tcp_states[SIGAR_TCP_LISTEN] >= 1);
+	assert(summary.tcp_states[SIGAR_TCP_ESTABLISHED] == 0);
+
+	assert(SIGAR_OK == sigar_tcp_curr_estab(t, &tcp));
+	assert(tcp.curr_estab >= 2);
+
+	/* the opt-in walk sees the same sockets */
+	assert(SIGAR_OK == sigar_net_stat_walk_set(t, 1));
+	assert(SIGAR_OK == sigar_net_stat_get(t, &walked, flags));
+	assert(walked.tcp_states[SIGAR_TCP_LISTEN] >= 1);
+	assert(walked.tcp_states[SIGAR_TCP_ESTABLISHED] >= 2);
+	assert(walked.tcp_inbound_total >= 1);
+	assert(SIGAR_OK == sigar_net_stat_walk_set(t, 0));
+
+	close(afd);
+	close(cfd);
+	close(lfd);
+
+	return 0;
+}
+
+TEST(test_sigar_net_services_name_get) {
+	char file[] = "/tmp/sigar-services-XXXXXX";
+	const char *services =
+		"# comment\n"
+		"http\t\t80/tcp\t\twww # WorldWideWeb\n"
+		"http 80/udp\n"
+		"later 80/tcp\n"
+		"six 99/tcp6\n"
+		"last 7/udp";
+	sigar_cache_stats_t stats;
+	sigar_t *other;
+	char *name;
+	int fd;
+
+	assert((fd = mkstemp(file)) >= 0);
+	assert(write(fd, services, strlen(services)) == (ssize_t)strlen(services));
+	close(fd);
+	/* the table is loaded on first use in the process */
+	setenv("SIGAR_NET_SERVICES_FILE", file, 1);
+
+	name = sigar_net_services_name_get(t, SIGAR_NETCONN_TCP, 80);
+	assert(name && 0 == strcmp(name, "http"));
+	name = sigar_net_services_name_get(t, SIGAR_NETCONN_UDP, 7);
+	assert(name && 0 == strcmp(name, "last"));
+	assert(NULL == sigar_net_services_name_get(t, SIGAR_NETCONN_TCP, 7));
+	assert(NULL == sigar_net_services_name_get(t, SIGAR_NETCONN_TCP, 99));
+	assert(NULL == sigar_net_services_name_get(t, SIGAR_NETCONN_RAW, 80));
+
+	/* shared by every handle */
+	assert(SIGAR_OK == sigar_open(&other));
+	assert(name == sigar_net_services_name_get(other, SIGAR_NETCONN_UDP, 7));
+	sigar_close(other);
+
+	assert(SIGAR_OK == sigar_cache_stats_get(t, "net_services_tcp", &stats));
+	assert(stats.count == 1);
+	assert(stats.hits == 3);
+	assert(SIGAR_OK == sigar_cache_stats_get(t, "net_services_udp", &stats));
+	assert(stats.count == 2);
+
+	unlink(file);
+
+	return 0;
+}
+
+/* the procfs tables as used without sock_diag, ipv6 in either case */
+TEST(test_sigar_net_connections_proc_net) {
+	char dir[] = "/tmp/sigar-proc-net-XXXXXX";
+	char path[256], addr[SIGAR_INET6_ADDRSTRLEN];
+	const char *header =
+		"  sl  local_address rem_address   st tx_queue rx_queue tr "
+		"tm->when retrnsmt   uid  timeout inode\n";
+	const char *tcp =
+		"   0: 0100007F:0277 00000000:0000 0A 00000000:00000000 "
+		"00:00000000 00000000     0        0 12345 1 0 100 0 0 10 0\n";
+	const char *tcp6 =
+		"   0: 00000000000000000000000001000000:1F90 "
+		"0000000000000000FFFF00000100007F:D431 01 00000010:00000020 "
+		"00:00000000 00000000  1000        0 23456 1 0 20 4 30 10 -1\n"
+		"   1: b80d0120000000000000000001000000:0016 "
+		"B80D0120000000000000000002000000:C350 01 00000000:00000000 "
+		"00:00000000 00000000  1000        0 23457 1 0 20 4 30 10 -1\n";
+	sigar_net_connection_list_t connlist;
+	sigar_t *fx;
+	FILE *fp;
+	int seen = 0;
+	unsigned long i;
+
+	assert(mkdtemp(dir));
+	snprintf(path, sizeof(path), "%s/net", dir);
+	assert(mkdir(path, 0700) == 0);
+	snprintf(path, sizeof(path), "%s/net/tcp", dir);
+	assert((fp = fopen(path, "w")));
+	fprintf(fp, "%s%s", header, tcp);
+	fclose(fp);
+	snprintf(path, sizeof(path), "%s/net/tcp6", dir);
+	assert((fp = fopen(path, "w")));
+	fprintf(fp, "%s%s", header, tcp6);
+	fclose(fp);
+
+	setenv("SIGAR_PROC_NET", dir, 1);
+	assert(SIGAR_OK == sigar_open(&fx));
+	unsetenv("SIGAR_PROC_NET");
+
+	assert(SIGAR_OK == sigar_net_connection_list_get(fx, &connlist,
+		SIGAR_NETCONN_SERVER | SIGAR_NETCONN_CLIENT | SIGAR_NETCONN_TCP));
+	assert(connlist.number == 3);
+
+	for (i = 0; i < connlist.number; i++) {
+		sigar_net_connection_t *conn = &connlist.data[i];
+
+		assert(SIGAR_OK == sigar_net_address_to_string(fx,
+		                   &conn->local_address, addr));
+		if (conn->inode == 12345) {
+			assert(conn->local_address.family == SIGAR_AF_INET);
+			assert(strcmp(addr, "127.0.0.1") == 0);
+			assert(conn->local_port == 631);
+			assert(conn->state == SIGAR_TCP_LISTEN);
+			seen |= 1;
+		}
+		else if (conn->inode == 23456) {
+			assert(conn->local_address.family == SIGAR_AF_INET6);
+			assert(strcmp(addr, "::1") == 0);
+			assert(conn->local_port == 8080);
+			assert(conn->remote_port == 54321);
+			assert(conn->send_queue == 16);
+			assert(conn->receive_queue == 32);
+			assert(conn->uid == 1000);
+			assert(SIGAR_OK == sigar_net_address_to_string(fx,
+			                   &conn->remote_address, addr));
+			assert(strcmp(addr, "::ffff:127.0.0.1") == 0);
+			seen |= 2;
+		}
+		else {
+			assert(conn->inode == 23457);
+			assert(strcmp(addr, "2001:db8::1") == 0);
+			assert(SIGAR_OK == sigar_net_address_to_string(fx,
+			                   &conn->remote_address, addr));
+			assert(strcmp(addr, "2001:db8::2") == 0);
+			seen |= 4;
+		}
+	}
+	assert(seen == 7);
+	sigar_net_connection_list_destroy(fx, &connlist);
+	sigar_close(fx);
+
+	snprintf(path, sizeof(path), "%s/net/tcp", dir);
+	unlink(path);
+	snprintf(path, sizeof(path), "%s/net/tcp6", dir);
+	unlink(path);
+	snprintf(path, sizeof(path), "%s/net", dir);
+	rmdir(path);
+	rmdir(dir);
+
+	return 0;
+}
+
+TEST(test_sigar_net_listen) {
+	sigar_net_listen_list_t listens;
+	sigar_net_address_t address;
+	struct sockaddr_in sin;
+	socklen_t len = sizeof(sin);
+	unsigned long i, port, other;
+	int lfd, ofd, seen = 0;
+
+	assert((lfd = socket(AF_INET, SOCK_STREAM, 0)) >= 0);
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	assert(bind(lfd, (struct sockaddr *)&sin, sizeof(sin)) == 0);
+	assert(listen(lfd, 8) == 0);
+	assert(getsockname(lfd, (struct sockaddr *)&sin, &len) == 0);
+	port = ntohs(sin.sin_port);
+
+	/* a fresh table */
+	assert(SIGAR_OK == sigar_net_listen_expire_set(t, 0));
+	assert(SIGAR_OK == sigar_net_listen_address_get(t, port, &address));
+	assert(address.addr.in == htonl(INADDR_LOOPBACK));
+	assert(SIGAR_OK == sigar_net_listen_expire_set(t, 60 * 1000));
+
+	assert(SIGAR_OK == sigar_net_listen_list_get(t, &listens));
+	for (i = 0; i < listens.number; i++) {
+		if (i > 0) {
+			assert(listens.data[i - 1].port < listens.data[i].port);
+		}
+		if (listens.data[i].port == port) {
+			seen++;
+		}
+	}
+	assert(seen == 1);
+	assert(SIGAR_OK == sigar_net_listen_list_destroy(t, &listens));
+
+	/* misses are answered from the table until it expires */
+	assert((ofd = socket(AF_INET, SOCK_STREAM, 0)) >= 0);
+	sin.sin_port = 0;
+	assert(bind(ofd, (struct sockaddr *)&sin, sizeof(sin)) == 0);
+	assert(listen(ofd, 8) == 0);
+	len = sizeof(sin);
+	assert(getsockname(ofd, (struct sockaddr *)&sin, &len) == 0);
+	other = ntohs(sin.sin_port);
+	assert(ENOENT == sigar_net_listen_address_get(t, other, &address));
+	close(lfd);
+	assert(SIGAR_OK == sigar_net_listen_address_get(t, port, &address));
+
+	assert(SIGAR_OK == sigar_net_listen_expire_set(t, 0));
+	assert(SIGAR_OK == sigar_net_listen_address_get(t, other, &address));
+	assert(ENOENT == sigar_net_listen_address_get(t, port, &address));
+
+	close(ofd);
+	assert(SIGAR_OK == sigar_net_listen_expire_set(t, 5 * 1000));
+
+	return 0;
+}
+
+TEST(test_sigar_net_connection_aggregate) {
+	sigar_net_connection_aggregate_t aggregate;
+	struct sockaddr_in sin;
+	socklen_t len = sizeof(sin);
+	unsigned long i, port, seen;
+	int lfd, cfd, afd, flags =
+		SIGAR_NETCONN_SERVER | SIGAR_NETCONN_CLIENT | SIGAR_NETCONN_TCP;
+
+	assert((lfd = socket(AF_INET, SOCK_STREAM, 0)) >= 0);
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	assert(bind(lfd, (struct sockaddr *)&sin, sizeof(sin)) == 0);
+	assert(listen(lfd, 8) == 0);
+	assert(getsockname(lfd, (struct sockaddr *)&sin, &len) == 0);
+	port = ntohs(sin.sin_port);
+	assert((cfd = socket(AF_INET, SOCK_STREAM, 0)) >= 0);
+	assert(connect(cfd, (struct sockaddr *)&sin, sizeof(sin)) == 0);
+	assert((afd = accept(lfd, NULL, NULL)) >= 0);
+
+	/* the listener and the accepted end */
+	assert(SIGAR_OK == sigar_net_connection_aggregate_get(t, flags,
+				SIGAR_NETCONN_GROUP_LOCAL_PORT, &aggregate));
+	for (i = 0, seen = 0; i < aggregate.number; i++) {
+		if (aggregate.data[i].local_port == port) {
+			seen = aggregate.data[i].count;
+		}
+		if (i > 0) {
+			assert(aggregate.data[i].local_port !=
+			       aggregate.data[0].local_port);
+		}
+	}
+	assert(seen == 2);
+	assert(SIGAR_OK == sigar_net_connection_aggregate_destroy(t, &aggregate));
+
+	/* both ends of the connection */
+	assert(SIGAR_OK == sigar_net_connection_aggregate_get(t,
+				SIGAR_NETCONN_CLIENT | SIGAR_NETCONN_TCP,
+				SIGAR_NETCONN_GROUP_REMOTE_ADDRESS, &aggregate));
+	for (i = 0, seen = 0; i < aggregate.number; i++) {
+		sigar_net_address_t *address = &aggregate.data[i].remote_address;
+
+		if ((address->family == SIGAR_AF_INET) &&
+		    (address->addr.in == htonl(INADDR_LOOPBACK)))
+		{
+			seen += aggregate.data[i].count;
+		}
+	}
+	assert(seen >= 2);
+	assert(SIGAR_OK == sigar_net_connection_aggregate_destroy(t, &aggregate));
+
+	assert(SIGAR_OK == sigar_net_connection_aggregate_get(t, flags,
+				SIGAR_NETCONN_GROUP_STATE, &aggregate));
+	for (i = 0, seen = 0; i < aggregate.number; i++) {
+		if (aggregate.data[i].state == SIGAR_TCP_LISTEN) {
+			seen = aggregate.data[i].count;
+		}
+	}
+	assert(seen >= 1);
+	assert(SIGAR_OK == sigar_net_connection_aggregate_destroy(t, &aggregate));
+
+	assert(SIGAR_OK == sigar_net_connection_aggregate_get(t, flags,
+				SIGAR_NETCONN_GROUP_PID, &aggregate));
+	for (i = 0, seen = 0; i < aggregate.number; i++) {
+		if (aggregate.data[i].pid == getpid()) {
+			seen = aggregate.data[i].count;
+		}
+	}
+	assert(seen == 3);
+	assert(SIGAR_OK == sigar_net_connection_aggregate_destroy(t, &aggregate));
+
+	assert(SIGAR_OK == sigar_net_connection_aggregate_get(t, flags,
+				SIGAR_NETCONN_GROUP_UID, &aggregate));
+	for (i = 0, seen = 0; i < aggregate.number; i++) {
+		if (aggregate.data[i].uid == getuid()) {
+			seen = aggregate.data[i].count;
+		}
+	}
+	assert(seen >= 3);
+	assert(SIGAR_OK == sigar_net_connection_aggregate_destroy(t, &aggregate));
+
+	assert(SIGAR_ENOTIMPL == sigar_net_connection_aggregate_get(t, flags,
+				0, &aggregate));
+
+	close(afd);
+	close(cfd);
+	close(lfd);
+
+	return 0;
+}
+
+/* our own namespace, read through the /proc/<pid>/net of its lowest pid */
+TEST(test_sigar_netns) {
+	sigar_netns_list_t netnslist;
+	sigar_netns_t *self = NULL, gone;
+	sigar_net_interface_stat_list_t iflist;
+	sigar_net_stat_t netstat;
+	struct sockaddr_in sin;
+	struct stat sb;
+	unsigned long i, lo = 0;
+	int lfd;
+
+	assert(stat("/proc/self/ns/net", &sb) == 0);
+
+	assert((lfd = socket(AF_INET, SOCK_STREAM, 0)) >= 0);
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	assert(bind(lfd, (struct sockaddr *)&sin, sizeof(sin)) == 0);
+	assert(listen(lfd, 8) == 0);
+
+	assert(SIGAR_OK == sigar_netns_list_get(t, &netnslist));
+	for (i = 0; i < netnslist.number; i++) {
+		/* one entry per namespace */
+		if (i > 0) {
+			assert(netnslist.data[i].inode != netnslist.data[0].inode);
+		}
+		if (netnslist.data[i].inode == (sigar_uint64_t)sb.st_ino) {
+			self = &netnslist.data[i];
+		}
+	}
+	assert(self != NULL);
+	assert(self->processes >= 1);
+	assert(self->pid <= getpid());
+
+	assert(SIGAR_OK == sigar_netns_net_interface_stat_list_get(t, self, &iflist));
+	for (i = 0; i < iflist.number; i++) {
+		if (0 == strcmp(iflist.data[i].name, "lo")) {
+			lo++;
+		}
+	}
+	assert(lo == 1);
+	assert(SIGAR_OK == sigar_net_interface_stat_list_destroy(t, &iflist));
+
+	assert(SIGAR_OK == sigar_netns_net_stat_get(t, self, &netstat,
+				SIGAR_NETCONN_SERVER | SIGAR_NETCONN_TCP));
+	assert(netstat.tcp_states[SIGAR_TCP_LISTEN] >= 1);
+
+	/* a pid no longer in the namespace */
+	gone = *self;
+	gone.inode++;
+	assert(ESRCH == sigar_netns_net_interface_stat_list_get(t, &gone, &iflist));
+	assert(ESRCH == sigar_netns_net_stat_get(t, &gone, &netstat,
+				SIGAR_NETCONN_SERVER | SIGAR_NETCONN_TCP));
+
+	assert(SIGAR_OK == sigar_netns_list_destroy(t, &netnslist));
+	close(lfd);
+
+	return 0;
+}
+#endif
+
 int main() {
 	sigar_t *t;
 	int err = 0;
@@ -91,6 +577,15 @@ int main() {
 	assert(SIGAR_OK == sigar_open(&t));
 
 	test_sigar_net_connections_get(t);
+#if defined(SIGAR_TEST_OS_LINUX)
+	test_sigar_net_connections_listen(t);
+	test_sigar_net_stat_get(t);
+	test_sigar_net_connections_proc_net(t);
+	test_sigar_net_services_name_get(t);
+	test_sigar_net_listen(t);
+	test_sigar_net_connection_aggregate(t);
+	test_sigar_netns(t);
+#endif
 
 	sigar_close(t);
 
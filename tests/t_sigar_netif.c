@@ -122,6 +122,128 @@ TEST(test_sigar_net_iflist_get) {
 	return 0;
 }
 
+TEST(test_sigar_net_ifstat_list_get) {
+	sigar_net_interface_stat_list_t iflist;
+	sigar_net_interface_stat_t ifstat;
+	size_t i;
+
+	assert(SIGAR_OK == sigar_net_interface_stat_list_get(t, &iflist));
+	assert(iflist.number > 0);
+
+	for (i = 0; i < iflist.number; i++) {
+		sigar_net_interface_stat_entry_t *entry = &iflist.data[i];
+
+		assert(entry->name[0] != '\0');
+		assert(IS_IMPL_U64(entry->stat.rx_bytes));
+		assert(IS_IMPL_U64(entry->stat.tx_bytes));
+
+		/* answered from the same read */
+		assert(SIGAR_OK == sigar_net_interface_stat_get(t, entry->name, &ifstat));
+		assert(ifstat.rx_bytes >= entry->stat.rx_bytes);
+		assert(ifstat.tx_packets >= entry->stat.tx_packets);
+	}
+
+	assert(SIGAR_OK != sigar_net_interface_stat_get(t, "sigar-no-such-if", &ifstat));
+
+	assert(SIGAR_OK == sigar_net_interface_stat_list_destroy(t, &iflist));
+
+	/* always re-read */
+	assert(SIGAR_OK == sigar_net_interface_stat_expire_set(t, 0));
+	assert(SIGAR_OK == sigar_net_interface_stat_list_get(t, &iflist));
+	for (i = 0; i < iflist.number; i++) {
+		assert(SIGAR_OK == sigar_net_interface_stat_get(t, iflist.data[i].name, &ifstat));
+	}
+	assert(SIGAR_OK == sigar_net_interface_stat_list_destroy(t, &iflist));
+
+	return 0;
+}
+
+TEST(test_sigar_net_ifconfig_list_get) {
+	sigar_net_interface_config_list_t configs;
+	sigar_net_interface_config_t missing;
+	sigar_net_interface_list_t names;
+	size_t i;
+
+	assert(SIGAR_OK == sigar_net_interface_config_list_get(t, &configs));
+	assert(SIGAR_OK == sigar_net_interface_list_get(t, &names));
+	assert(configs.number > 0);
+	assert(SIGAR_OK != sigar_net_interface_config_get(t, "sigar-no-such-if", &missing));
+
+	for (i = 0; i < configs.number; i++) {
+		sigar_net_interface_config_t *listed = &configs.data[i];
+		sigar_net_interface_config_t config;
+
+		assert(strlen(listed->name) > 0);
+
+		/* served from the same read, unless it went away */
+		if (SIGAR_OK != sigar_net_interface_config_get(t, listed->name, &config)) {
+			continue;
+		}
+		assert(strcmp(config.name, listed->name) == 0);
+		assert(config.flags == listed->flags);
+		assert(config.mtu == listed->mtu);
+	}
+
+	assert(SIGAR_OK == sigar_net_interface_list_destroy(t, &names));
+	assert(SIGAR_OK == sigar_net_interface_config_list_destroy(t, &configs));
+
+	return 0;
+}
+
+TEST(test_sigar_net_route_list_get) {
+	sigar_net_route_list_t routes, again;
+	size_t i;
+
+	assert(SIGAR_OK == sigar_net_route_list_get(t, &routes));
+
+	for (i = 0; i < routes.number; i++) {
+		sigar_net_route_t *route = &routes.data[i];
+
+		assert(route->flags & SIGAR_RTF_UP);
+		assert((route->destination.family == SIGAR_AF_INET) ||
+		       (route->destination.family == SIGAR_AF_INET6));
+		assert(route->mask.family == route->destination.family);
+		assert(strlen(route->ifname) < sizeof(route->ifname));
+	}
+
+	/* nothing changed in between, the same table comes back */
+	assert(SIGAR_OK == sigar_net_route_list_get(t, &again));
+	assert(again.number == routes.number);
+	for (i = 0; i < routes.number; i++) {
+		assert(again.data[i].destination.family ==
+		       routes.data[i].destination.family);
+		assert(again.data[i].flags == routes.data[i].flags);
+		assert(strcmp(again.data[i].ifname, routes.data[i].ifname) == 0);
+	}
+
+	assert(SIGAR_OK == sigar_net_route_list_destroy(t, &again));
+	assert(SIGAR_OK == sigar_net_route_list_destroy(t, &routes));
+
+	return 0;
+}
+
+TEST(test_sigar_arp_list_get) {
+	sigar_arp_list_t arps, again;
+	size_t i;
+
+	assert(SIGAR_OK == sigar_arp_list_get(t, &arps));
+
+	for (i = 0; i < arps.number; i++) {
+		sigar_arp_t *arp = &arps.data[i];
+
+		assert((arp->address.family == SIGAR_AF_INET) ||
+		       (arp->address.family == SIGAR_AF_INET6));
+		assert(arp->hwaddr.family == SIGAR_AF_LINK);
+		assert(strlen(arp->type) > 0);
+	}
+
+	assert(SIGAR_OK == sigar_arp_list_get(t, &again));
+	assert(SIGAR_OK == sigar_arp_list_destroy(t, &again));
+	assert(SIGAR_OK == sigar_arp_list_destroy(t, &arps));
+
+	return 0;
+}
+
 int main() {
 	sigar_t *t;
 	int err = 0;
@@ -129,6 +251,10 @@ int main() {
 	assert(SIGAR_OK == sigar_open(&t));
 
 	test_sigar_net_iflist_get(t);
+	test_sigar_net_ifstat_list_get(t);
+	test_sigar_net_ifconfig_list_get(t);
+	test_sigar_net_route_list_get(t);
+	test_sigar_arp_list_get(t);
 
 	sigar_close(t);
 
@@ -39,13 +39,25 @@
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
+#include <time.h>
 #if defined(MSVC)
 #include <WinError.h>
 #endif
 
+#if defined(SIGAR_TEST_OS_LINUX)
+#include <signal.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#endif
+
 #include "sigar.h"
 #include "sigar_private.h"
+#include "sigar_util.h"
 #include "sigar_format.h"
+#include "sigar_ptql.h"
 #include "sigar_tests.h"
 
 #ifdef HAVE_VALGRIND_VALGRIND_H
@@ -60,6 +72,20 @@ TEST(test_sigar_proc_stat_get) {
 	assert(SIGAR_OK == sigar_proc_stat_get(t, &proc_stat));
 	assert(proc_stat.total > 0);
 
+	assert(SIGAR_OK == sigar_proc_stat_census_set(t, 1));
+	assert(SIGAR_OK == sigar_proc_stat_get(t, &proc_stat));
+	assert(proc_stat.total > 0);
+	/* at least this process is running */
+	assert(proc_stat.running > 0);
+	assert(SIGAR_OK == sigar_proc_stat_census_set(t, 0));
+
+#if defined(SIGAR_TEST_OS_LINUX)
+	assert(SIGAR_OK == sigar_proc_stat_get(t, &proc_stat));
+	assert(proc_stat.running > 0);
+	assert(IS_IMPL_U64(proc_stat.threads));
+	assert(proc_stat.threads >= proc_stat.total);
+#endif
+
 	return 0;
 }
 
@@ -184,6 +210,1573 @@ TEST(test_sigar_proc_list_get) {
 	return 0;
 }
 
+TEST(test_sigar_proc_iter) {
+	sigar_proc_iter_t *iter;
+	sigar_pid_t pid, self = sigar_pid_get(t);
+	size_t count = 0;
+	int found = 0;
+
+	assert(SIGAR_OK == sigar_proc_iter_open(t, &iter));
+
+	while (SIGAR_OK == sigar_proc_iter_next(iter, &pid)) {
+		if (pid == self) {
+			found++;
+		}
+		count++;
+	}
+
+	assert(count > 0);
+	assert(found == 1);
+	/* stays at the end */
+	assert(ENOENT == sigar_proc_iter_next(iter, &pid));
+
+	assert(SIGAR_OK == sigar_proc_iter_close(iter));
+
+	return 0;
+}
+
+TEST(test_sigar_proc_snapshot_get) {
+	sigar_proc_snapshot_t snapshot;
+	sigar_pid_t self = sigar_pid_get(t);
+	int found = 0;
+	size_t i;
+
+	assert(SIGAR_OK == sigar_proc_snapshot_get(t, SIGAR_PROC_SNAPSHOT_ALL, &snapshot));
+	assert(snapshot.number > 0);
+	assert(snapshot.number <= snapshot.size);
+
+	for (i = 0; i < snapshot.number; i++) {
+		sigar_proc_snapshot_entry_t *entry = &snapshot.data[i];
+
+		assert(entry->flags != 0);
+
+		if (entry->flags & SIGAR_PROC_SNAPSHOT_TIME) {
+			assert(entry->cpu.total == entry->cpu.user + entry->cpu.sys);
+		}
+		if (entry->flags & SIGAR_PROC_SNAPSHOT_CPU) {
+			assert(entry->flags & SIGAR_PROC_SNAPSHOT_TIME);
+			assert(entry->cpu.percent >= 0.0);
+		}
+		if (entry->pid == self) {
+			found = 1;
+			assert(entry->flags & SIGAR_PROC_SNAPSHOT_STATE);
+			assert(entry->flags & SIGAR_PROC_SNAPSHOT_MEM);
+			assert(IS_IMPL_U64(entry->mem.resident));
+		}
+	}
+	assert(found);
+
+	sigar_proc_snapshot_destroy(t, &snapshot);
+
+	/* only what was asked for */
+	assert(SIGAR_OK == sigar_proc_snapshot_get(t, SIGAR_PROC_SNAPSHOT_MEM, &snapshot));
+	for (i = 0; i < snapshot.number; i++) {
+		assert(!(snapshot.data[i].flags & ~SIGAR_PROC_SNAPSHOT_MEM));
+	}
+	sigar_proc_snapshot_destroy(t, &snapshot);
+
+	/* opt-in disk counters, as sigar_proc_cumulative_disk_io_get has them */
+	found = 0;
+	assert(SIGAR_OK == sigar_proc_snapshot_get(t, SIGAR_PROC_SNAPSHOT_DISK_IO, &snapshot));
+	for (i = 0; i < snapshot.number; i++) {
+		sigar_proc_snapshot_entry_t *entry = &snapshot.data[i];
+		sigar_proc_cumulative_disk_io_t io;
+
+		assert(!(entry->flags & ~SIGAR_PROC_SNAPSHOT_DISK_IO));
+		if (entry->flags & SIGAR_PROC_SNAPSHOT_DISK_IO) {
+			assert(entry->disk_io.bytes_total ==
+			       entry->disk_io.bytes_read + entry->disk_io.bytes_written);
+		}
+		if ((entry->pid == self) &&
+		    (sigar_proc_cumulative_disk_io_get(t, self, &io) == SIGAR_OK))
+		{
+			assert(entry->flags & SIGAR_PROC_SNAPSHOT_DISK_IO);
+			assert(entry->disk_io.bytes_read <= io.bytes_read);
+			found = 1;
+		}
+	}
+	sigar_proc_snapshot_destroy(t, &snapshot);
+
+	return 0;
+}
+
+#if defined(SIGAR_TEST_OS_LINUX)
+static int proc_snapshot_find(sigar_proc_snapshot_t *snapshot, sigar_pid_t pid,
+                              sigar_proc_snapshot_entry_t *found) {
+	size_t i;
+
+	for (i = 0; i < snapshot->number; i++) {
+		if (snapshot->data[i].pid == pid) {
+			*found = snapshot->data[i];
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/* rounds closer than proc_cache_expire still see new times */
+TEST(test_sigar_proc_snapshot_fresh) {
+	sigar_proc_snapshot_t snapshot;
+	sigar_proc_snapshot_entry_t first, second;
+	pid_t child;
+
+	if ((child = fork()) == 0) {
+		for (;;) {
+			/* spin */
+		}
+	}
+	assert(child > 0);
+	/* a total of 0 reads as a new pid, with no percent */
+	usleep(100 * 1000);
+
+	assert(SIGAR_OK == sigar_proc_snapshot_get(t, SIGAR_PROC_SNAPSHOT_CPU, &snapshot));
+	assert(proc_snapshot_find(&snapshot, child, &first));
+	sigar_proc_snapshot_destroy(t, &snapshot);
+
+	usleep(700 * 1000);
+
+	assert(SIGAR_OK == sigar_proc_snapshot_get(t, SIGAR_PROC_SNAPSHOT_CPU, &snapshot));
+	assert(proc_snapshot_find(&snapshot, child, &second));
+	sigar_proc_snapshot_destroy(t, &snapshot);
+
+	kill(child, SIGKILL);
+	waitpid(child, NULL, 0);
+
+	assert(second.cpu.total > first.cpu.total);
+	assert(second.cpu.percent > 0.0);
+
+	return 0;
+}
+
+static void proc_fixture_stat(const char *root, const char *name,
+                              unsigned long start) {
+	char path[512];
+	FILE *fp;
+
+	snprintf(path, sizeof(path), "%s/4242", root);
+	assert(0 == mkdir(path, 0755));
+	snprintf(path, sizeof(path), "%s/4242/stat", root);
+	assert((fp = fopen(path, "w")) != NULL);
+	fprintf(fp, "4242 (%s) S 1 4242 4242 0 -1 0 0 0 0 0 1 1 0 0 20 0 1 0 "
+	        "%lu 0 0 0 0 0 0 0 0 0 0 0 0 0 17 0 0 0 0 0 0\n", name, start);
+	fclose(fp);
+}
+
+/* a pid reused within proc_cache_expire is not the cached task */
+TEST(test_sigar_proc_stat_reused) {
+	sigar_t *fixture;
+	sigar_proc_state_t state;
+	char root[] = "/tmp/sigar_reusedXXXXXX", path[512], moved[512];
+
+	assert(mkdtemp(root) != NULL);
+	proc_fixture_stat(root, "before", 100);
+
+	assert(0 == setenv("SIGAR_PROC_ROOT", root, 1));
+	assert(SIGAR_OK == sigar_open(&fixture));
+	assert(SIGAR_OK == sigar_proc_state_get(fixture, 4242, &state));
+	assert(strcmp(state.name, "before") == 0);
+
+	/* kept aside so the new directory cannot get its inode */
+	snprintf(path, sizeof(path), "%s/4242", root);
+	snprintf(moved, sizeof(moved), "%s/gone", root);
+	assert(0 == rename(path, moved));
+	proc_fixture_stat(root, "after", 200);
+
+	assert(SIGAR_OK == sigar_proc_state_get(fixture, 4242, &state));
+	assert(strcmp(state.name, "after") == 0);
+
+	sigar_close(fixture);
+	assert(0 == unsetenv("SIGAR_PROC_ROOT"));
+	assert(SIGAR_OK == sigar_procfs_root_set(NULL));
+
+	snprintf(path, sizeof(path), "%s/4242/stat", root);
+	unlink(path);
+	snprintf(path, sizeof(path), "%s/4242", root);
+	rmdir(path);
+	snprintf(path, sizeof(path), "%s/gone/stat", root);
+	unlink(path);
+	rmdir(moved);
+	rmdir(root);
+
+	return 0;
+}
+
+/* a pid whose every requested read failed is not in the snapshot */
+TEST(test_sigar_proc_snapshot_unread) {
+	sigar_t *fixture;
+	sigar_proc_snapshot_t snapshot;
+	char root[] = "/tmp/sigar_unreadXXXXXX", path[512];
+
+	assert(mkdtemp(root) != NULL);
+	proc_fixture_stat(root, "nosched", 100);
+
+	assert(0 == setenv("SIGAR_PROC_ROOT", root, 1));
+	assert(SIGAR_OK == sigar_open(&fixture));
+	/* there is no schedstat to read */
+	assert(SIGAR_OK == sigar_proc_snapshot_get(fixture,
+	                                           SIGAR_PROC_SNAPSHOT_SCHED,
+	                                           &snapshot));
+	assert(snapshot.number == 0);
+	sigar_proc_snapshot_destroy(fixture, &snapshot);
+
+	assert(SIGAR_OK == sigar_proc_snapshot_get(fixture,
+	                                           SIGAR_PROC_SNAPSHOT_STATE |
+	                                           SIGAR_PROC_SNAPSHOT_SCHED,
+	                                           &snapshot));
+	assert(snapshot.number == 1);
+	assert(snapshot.data[0].flags == SIGAR_PROC_SNAPSHOT_STATE);
+	sigar_proc_snapshot_destroy(fixture, &snapshot);
+
+	sigar_close(fixture);
+	assert(0 == unsetenv("SIGAR_PROC_ROOT"));
+	assert(SIGAR_OK == sigar_procfs_root_set(NULL));
+
+	snprintf(path, sizeof(path), "%s/4242/stat", root);
+	unlink(path);
+	snprintf(path, sizeof(path), "%s/4242", root);
+	rmdir(path);
+	rmdir(root);
+
+	return 0;
+}
+#endif
+
+TEST(test_sigar_proc_fields) {
+	sigar_pid_t self = sigar_pid_get(t);
+	sigar_proc_state_t full_state, state;
+	sigar_proc_mem_t full_mem, mem;
+	sigar_proc_snapshot_t snapshot;
+	int found = 0;
+	size_t i;
+
+	assert(SIGAR_OK == sigar_proc_state_get(t, self, &full_state));
+	assert(SIGAR_OK == sigar_proc_state_get_ex(t, self,
+	                                           SIGAR_PROC_STATE_F_NAME |
+	                                           SIGAR_PROC_STATE_F_PPID,
+	                                           &state));
+	assert(strcmp(state.name, full_state.name) == 0);
+	assert(state.ppid == full_state.ppid);
+
+	assert(SIGAR_OK == sigar_proc_state_get_ex(t, self,
+	                                           SIGAR_PROC_STATE_F_ALL,
+	                                           &state));
+	assert(state.threads == full_state.threads);
+
+	assert(SIGAR_OK == sigar_proc_mem_get(t, self, &full_mem));
+	assert(SIGAR_OK == sigar_proc_mem_get_ex(t, self,
+	                                         SIGAR_PROC_MEM_F_RESIDENT,
+	                                         &mem));
+	assert(mem.resident > 0);
+
+#if defined(SIGAR_TEST_OS_LINUX)
+	/* faults alone come from stat, statm is never opened */
+	mem.size = SIGAR_FIELD_NOTIMPL;
+	assert(SIGAR_OK == sigar_proc_mem_get_ex(t, self,
+	                                         SIGAR_PROC_MEM_F_PAGE_FAULTS,
+	                                         &mem));
+	assert(mem.size == SIGAR_FIELD_NOTIMPL);
+	assert(mem.page_faults >= full_mem.page_faults);
+	assert(mem.page_faults == mem.minor_faults + mem.major_faults);
+
+	state.threads = 0;
+	assert(SIGAR_OK == sigar_proc_state_get_ex(t, self,
+	                                           SIGAR_PROC_STATE_F_THREADS,
+	                                           &state));
+	assert(state.threads >= 1);
+#endif
+
+	/* narrowed snapshot columns */
+	assert(SIGAR_OK == sigar_proc_snapshot_get(t,
+		SIGAR_PROC_SNAPSHOT_STATE | SIGAR_PROC_SNAPSHOT_MEM |
+		SIGAR_PROC_SNAPSHOT_STATE_FIELDS(SIGAR_PROC_STATE_F_NAME) |
+		SIGAR_PROC_SNAPSHOT_MEM_FIELDS(SIGAR_PROC_MEM_F_MINOR_FAULTS),
+		&snapshot));
+	for (i = 0; i < snapshot.number; i++) {
+		sigar_proc_snapshot_entry_t *entry = &snapshot.data[i];
+
+		assert(!(entry->flags &
+		         ~(SIGAR_PROC_SNAPSHOT_STATE | SIGAR_PROC_SNAPSHOT_MEM)));
+		if (entry->pid == self) {
+			found = 1;
+			assert(entry->flags & SIGAR_PROC_SNAPSHOT_STATE);
+			assert(strcmp(entry->state.name, full_state.name) == 0);
+#if defined(SIGAR_TEST_OS_LINUX)
+			assert(entry->state.threads == SIGAR_FIELD_NOTIMPL);
+			assert(entry->mem.resident == SIGAR_FIELD_NOTIMPL);
+#endif
+		}
+	}
+	assert(found);
+	sigar_proc_snapshot_destroy(t, &snapshot);
+
+	return 0;
+}
+
+TEST(test_sigar_proc_top_get) {
+	sigar_proc_top_t top;
+	volatile unsigned long spin;
+	size_t i;
+
+	assert(SIGAR_OK != sigar_proc_top_get(t, 5, -1, &top));
+
+	assert(SIGAR_OK == sigar_proc_top_get(t, 5, SIGAR_PROC_TOP_CPU, &top));
+	assert(top.number > 0);
+	assert(top.number <= 5);
+	assert(top.procs >= top.number);
+	sigar_proc_top_destroy(t, &top);
+
+	/* burn some cpu so the second round has a delta */
+	for (spin = 0; spin < 50000000; spin++);
+
+	assert(SIGAR_OK == sigar_proc_top_get(t, 5, SIGAR_PROC_TOP_CPU, &top));
+	assert(top.interval > 0);
+	for (i = 0; i < top.number; i++) {
+		assert(top.data[i].cpu_percent >= 0.0);
+		assert(top.data[i].fault_rate >= 0.0);
+		if (i > 0) {
+			assert(top.data[i].cpu_percent <= top.data[i-1].cpu_percent);
+		}
+	}
+	sigar_proc_top_destroy(t, &top);
+
+	/* n of 0 is every process */
+	assert(SIGAR_OK == sigar_proc_top_get(t, 0, SIGAR_PROC_TOP_RESIDENT, &top));
+	assert(top.number == top.procs);
+	assert(top.number > 0);
+	for (i = 1; i < top.number; i++) {
+		if (IS_IMPL_U64(top.data[i].resident)) {
+			assert(top.data[i].resident <= top.data[i-1].resident);
+		}
+	}
+	sigar_proc_top_destroy(t, &top);
+
+	return 0;
+}
+
+TEST(test_sigar_proc_thread_list_get) {
+	sigar_pid_t self = sigar_pid_get(t);
+	sigar_proc_thread_list_t threads;
+	sigar_uint64_t total = 0;
+	unsigned long i;
+	int found = 0, ret;
+	volatile unsigned long spin = 0;
+
+	ret = sigar_proc_thread_list_get(t, self, &threads);
+	if (ret == SIGAR_ENOTIMPL) {
+		return 0;
+	}
+	assert(SIGAR_OK == ret);
+	assert(threads.number > 0);
+
+	for (i = 0; i < threads.number; i++) {
+		sigar_proc_thread_t *thread = &threads.data[i];
+
+		assert(thread->cpu.total == thread->cpu.user + thread->cpu.sys);
+		assert(thread->cpu.percent >= 0.0);
+#if defined(SIGAR_TEST_OS_LINUX)
+		/* the main thread's tid is the pid */
+		if (thread->tid == self) {
+			assert(thread->state == SIGAR_PROC_STATE_RUN);
+			total = thread->cpu.total;
+			found++;
+		}
+#endif
+	}
+#if defined(SIGAR_TEST_OS_LINUX)
+	assert(found == 1);
+#endif
+	assert(SIGAR_OK == sigar_proc_thread_list_destroy(t, &threads));
+
+	while (spin < 20000000) {
+		spin++;
+	}
+
+	assert(SIGAR_OK == sigar_proc_thread_list_get(t, self, &threads));
+	for (i = 0; i < threads.number; i++) {
+		if (threads.data[i].tid == self) {
+			assert(threads.data[i].cpu.total >= total);
+		}
+	}
+	assert(SIGAR_OK == sigar_proc_thread_list_destroy(t, &threads));
+
+	assert(SIGAR_OK != sigar_proc_thread_list_get(t, 0x7ffffffe, &threads));
+
+	return 0;
+}
+
+TEST(test_sigar_proc_scan_threads_set) {
+	sigar_proc_snapshot_t serial, parallel;
+	sigar_proc_list_t found;
+	sigar_proc_state_t state;
+	sigar_ptql_query_t *query;
+	sigar_ptql_error_t error;
+	sigar_pid_t self = sigar_pid_get(t);
+	char ptql[64];
+	size_t i, j;
+	int seen = 0;
+
+	assert(SIGAR_OK != sigar_proc_scan_threads_set(t, -1));
+
+	assert(SIGAR_OK == sigar_proc_snapshot_get(t, SIGAR_PROC_SNAPSHOT_ALL, &serial));
+	assert(SIGAR_OK == sigar_proc_scan_threads_set(t, 4));
+	assert(SIGAR_OK == sigar_proc_snapshot_get(t, SIGAR_PROC_SNAPSHOT_ALL, &parallel));
+
+	/* pid list order is kept, give or take processes coming and going */
+	assert(parallel.number > 0);
+	for (i = 0, j = 0; i < parallel.number; i++) {
+		assert(parallel.data[i].flags != 0);
+		while ((j < serial.number) && (serial.data[j].pid != parallel.data[i].pid)) {
+			j++;
+		}
+		if (j < serial.number) {
+			seen++;
+		}
+		if (parallel.data[i].pid == self) {
+			assert(parallel.data[i].flags & SIGAR_PROC_SNAPSHOT_STATE);
+			assert(parallel.data[i].flags & SIGAR_PROC_SNAPSHOT_MEM);
+		}
+	}
+	assert(seen > 0);
+	sigar_proc_snapshot_destroy(t, &serial);
+	sigar_proc_snapshot_destroy(t, &parallel);
+
+	/* State.Ppid has to look at every pid */
+	assert(SIGAR_OK == sigar_proc_state_get(t, self, &state));
+	snprintf(ptql, sizeof(ptql), "State.Ppid.eq=%d", (int)state.ppid);
+	assert(SIGAR_OK == sigar_ptql_query_create(&query, ptql, &error));
+	assert(SIGAR_OK == sigar_ptql_query_find(t, query, &found));
+	for (i = 0, seen = 0; i < found.number; i++) {
+		if (found.data[i] == self) {
+			seen = 1;
+		}
+	}
+	assert(seen);
+	sigar_proc_list_destroy(t, &found);
+	sigar_ptql_query_destroy(query);
+
+	assert(SIGAR_OK == sigar_proc_scan_threads_set(t, 0));
+
+	return 0;
+}
+
+TEST(test_sigar_proc_cache_expire_set) {
+	sigar_pid_t self = sigar_pid_get(t);
+	sigar_proc_time_t first, second;
+	sigar_proc_mem_t proc_mem;
+
+	/* interleaved getters on one pid share the cached parse */
+	assert(SIGAR_OK == sigar_proc_cache_expire_set(t, 60 * 1000));
+	assert(SIGAR_OK == sigar_proc_time_get(t, self, &first));
+	assert(SIGAR_OK == sigar_proc_mem_get(t, self, &proc_mem));
+	assert(SIGAR_OK == sigar_proc_time_get(t, self, &second));
+	assert(first.start_time == second.start_time);
+#if defined(SIGAR_TEST_OS_LINUX)
+	assert(first.total == second.total);
+#endif
+
+	/* no caching at all */
+	assert(SIGAR_OK == sigar_proc_cache_expire_set(t, 0));
+	assert(SIGAR_OK == sigar_proc_time_get(t, self, &second));
+	assert(first.start_time == second.start_time);
+	assert(second.total >= first.total);
+
+	assert(SIGAR_OK == sigar_proc_cache_expire_set(t, SIGAR_PROC_CACHE_EXPIRE));
+
+	return 0;
+}
+
+TEST(test_sigar_cred_name_expire_set) {
+	sigar_pid_t self = sigar_pid_get(t);
+	sigar_proc_cred_name_t first, second;
+	sigar_cache_stats_t stats;
+	int ret;
+
+	assert(SIGAR_OK == sigar_cred_name_expire_set(t, 60 * 1000));
+	ret = sigar_cred_name_preload(t);
+	assert(ret == SIGAR_OK || ret == SIGAR_ENOTIMPL);
+
+	if (SIGAR_OK != sigar_proc_cred_name_get(t, self, &first)) {
+		/* no name service in this sandbox */
+		return 0;
+	}
+	assert(SIGAR_OK == sigar_proc_cred_name_get(t, self, &second));
+	assert(0 == strcmp(first.user, second.user));
+	assert(0 == strcmp(first.group, second.group));
+
+	assert(SIGAR_OK == sigar_cache_stats_get(t, "user_names", &stats));
+	assert(stats.count > 0);
+	assert(stats.hits > 0);
+
+	/* every lookup goes to the name service */
+	assert(SIGAR_OK == sigar_cred_name_expire_set(t, 0));
+	assert(SIGAR_OK == sigar_proc_cred_name_get(t, self, &second));
+	assert(0 == strcmp(first.user, second.user));
+	assert(SIGAR_OK == sigar_cache_stats_get(t, "user_names", &stats));
+	assert(stats.count == 0);
+
+	assert(SIGAR_OK == sigar_cred_name_expire_set(t, SIGAR_CRED_NAME_EXPIRE));
+
+	return 0;
+}
+
+TEST(test_sigar_proc_pin) {
+	sigar_pid_t self = sigar_pid_get(t);
+	sigar_proc_time_t first, second;
+	sigar_proc_state_t state;
+	sigar_proc_mem_t proc_mem;
+#if defined(SIGAR_TEST_OS_LINUX)
+	pid_t child;
+#endif
+
+	if (SIGAR_ENOTIMPL == sigar_proc_pin(t, self)) {
+		return 0;
+	}
+	/* pinning twice is fine */
+	assert(SIGAR_OK == sigar_proc_pin(t, self));
+
+	assert(SIGAR_OK == sigar_proc_cache_expire_set(t, 0));
+	assert(SIGAR_OK == sigar_proc_time_get(t, self, &first));
+	assert(SIGAR_OK == sigar_proc_mem_get(t, self, &proc_mem));
+	assert(SIGAR_OK == sigar_proc_state_get(t, self, &state));
+	assert(SIGAR_OK == sigar_proc_time_get(t, self, &second));
+	assert(first.start_time == second.start_time);
+	assert(second.total >= first.total);
+	assert(proc_mem.resident > 0);
+	assert(state.ppid > 0);
+	assert(SIGAR_OK == sigar_proc_unpin(t, self));
+	assert(SIGAR_OK == sigar_proc_time_get(t, self, &second));
+
+#if defined(SIGAR_TEST_OS_LINUX)
+	/* a pinned process going away is reported, not read stale */
+	if ((child = fork()) == 0) {
+		pause();
+		_exit(0);
+	}
+	assert(child > 0);
+	assert(SIGAR_OK == sigar_proc_pin(t, child));
+	assert(SIGAR_OK == sigar_proc_time_get(t, child, &first));
+	kill(child, SIGKILL);
+	waitpid(child, NULL, 0);
+	assert(SIGAR_OK != sigar_proc_time_get(t, child, &second));
+	assert(SIGAR_OK == sigar_proc_unpin(t, child));
+#endif
+
+	assert(SIGAR_OK == sigar_proc_cache_expire_set(t, SIGAR_PROC_CACHE_EXPIRE));
+
+	return 0;
+}
+
+TEST(test_sigar_proc_handle) {
+	sigar_proc_handle_t *handle;
+	sigar_proc_time_t proc_time;
+	sigar_proc_state_t state;
+	int status;
+#if defined(SIGAR_TEST_OS_LINUX)
+	pid_t child;
+#endif
+
+	status = sigar_proc_handle_open(t, sigar_pid_get(t), &handle);
+	if (status == SIGAR_ENOTIMPL) {
+		return 0;
+	}
+	assert(status == SIGAR_OK);
+	assert(sigar_proc_handle_pid_get(handle) == sigar_pid_get(t));
+	assert(ETIMEDOUT == sigar_proc_handle_wait(handle, 0));
+	assert(SIGAR_OK == sigar_proc_handle_kill(handle, 0));
+	assert(SIGAR_OK == sigar_proc_handle_close(t, handle));
+
+#if defined(SIGAR_TEST_OS_LINUX)
+	if ((child = fork()) == 0) {
+		pause();
+		_exit(0);
+	}
+	assert(child > 0);
+	assert(SIGAR_OK == sigar_proc_handle_open(t, child, &handle));
+	assert(sigar_proc_handle_waitable_get(handle) >= 0);
+	assert(SIGAR_OK == sigar_proc_cache_expire_set(t, 0));
+	assert(SIGAR_OK == sigar_proc_time_get(t, child, &proc_time));
+	assert(SIGAR_OK == sigar_proc_state_get(t, child, &state));
+	assert(ETIMEDOUT == sigar_proc_handle_wait(handle, 10));
+
+	assert(SIGAR_OK == sigar_proc_handle_kill(handle, SIGKILL));
+	assert(SIGAR_OK == sigar_proc_handle_wait(handle, -1));
+	assert(child == waitpid(child, NULL, 0));
+
+	/* reaped, nothing the pid may be given to next is looked at */
+	assert(ESRCH == sigar_proc_handle_kill(handle, SIGKILL));
+	assert(ESRCH == sigar_proc_time_get(t, child, &proc_time));
+	assert(ESRCH == sigar_proc_state_get(t, child, &state));
+	assert(SIGAR_OK == sigar_proc_handle_close(t, handle));
+	assert(ESRCH == sigar_proc_handle_open(t, child, &handle));
+	assert(SIGAR_OK == sigar_proc_cache_expire_set(t, SIGAR_PROC_CACHE_EXPIRE));
+#endif
+
+	return 0;
+}
+
+#if defined(SIGAR_TEST_OS_LINUX)
+typedef struct {
+	int number;
+	int big;
+	char last[16];
+} proc_env_count_t;
+
+static int proc_env_count(void *data, const char *key, int klen,
+                          char *val, int vlen) {
+	proc_env_count_t *count = data;
+
+	count->number++;
+	if (0 == strcmp(key, "BIG")) {
+		count->big = vlen;
+	}
+	if (0 == strcmp(key, "LAST")) {
+		SIGAR_SSTRCPY(count->last, val);
+	}
+
+	return SIGAR_OK;
+}
+
+TEST(test_sigar_proc_env_get) {
+	static char big[3 * 4096 + 5];
+	char *envp[] = { "FIRST=1", big, "LAST=end", NULL };
+	sigar_proc_env_t procenv;
+	sigar_proc_args_t args;
+	proc_env_count_t count;
+	sigar_pid_t child;
+	int i;
+
+	/* longer than one read chunk */
+	memcpy(big, "BIG=", 4);
+	memset(big + 4, 'x', sizeof(big) - 5);
+
+	if ((child = fork()) == 0) {
+		execle("/bin/sleep", "sleep", "30", (char *)NULL, envp);
+		_exit(1);
+	}
+	assert(child > 0);
+
+	for (i = 0; i < 200; i++) {
+		assert(SIGAR_OK == sigar_proc_args_get(t, child, &args));
+		if ((args.number == 2) && (0 == strcmp(args.data[0], "sleep"))) {
+			break;
+		}
+		sigar_proc_args_destroy(t, &args);
+		usleep(10 * 1000);
+	}
+	if (i == 200) {
+		/* no /bin/sleep */
+		kill(child, SIGKILL);
+		waitpid(child, NULL, 0);
+		return 0;
+	}
+	assert(0 == strcmp(args.data[1], "30"));
+	sigar_proc_args_destroy(t, &args);
+
+	memset(&count, 0, sizeof(count));
+	procenv.type = SIGAR_PROC_ENV_ALL;
+	procenv.env_getter = proc_env_count;
+	procenv.data = &count;
+	assert(SIGAR_OK == sigar_proc_env_get(t, child, &procenv));
+	assert(count.number == 3);
+	assert(count.big == (int)sizeof(big) - 5);
+	assert(0 == strcmp(count.last, "end"));
+
+	/* only the match reaches the getter */
+	memset(&count, 0, sizeof(count));
+	procenv.type = SIGAR_PROC_ENV_KEY;
+	procenv.key = "LAST";
+	procenv.klen = 4;
+	assert(SIGAR_OK == sigar_proc_env_get(t, child, &procenv));
+	assert(count.number == 1);
+	assert(0 == strcmp(count.last, "end"));
+
+	procenv.key = "LAS";
+	procenv.klen = 3;
+	memset(&count, 0, sizeof(count));
+	assert(SIGAR_OK == sigar_proc_env_get(t, child, &procenv));
+	assert(count.number == 0);
+
+	kill(child, SIGKILL);
+	waitpid(child, NULL, 0);
+
+	return 0;
+}
+
+TEST(test_sigar_proc_mem_ext_get) {
+	sigar_pid_t self = sigar_pid_get(t);
+	sigar_proc_mem_ext_t memext;
+	sigar_proc_snapshot_t snapshot;
+	unsigned long i;
+	int found = 0;
+
+	assert(SIGAR_OK == sigar_proc_mem_ext_get(t, self, &memext));
+	assert(memext.rss > 0);
+	assert(memext.pss > 0);
+	assert(memext.pss <= memext.rss);
+	assert(memext.uss <= memext.pss);
+	assert(memext.uss + memext.shared == memext.rss);
+	assert(memext.anon + memext.file == memext.rss);
+
+	assert(ESRCH == sigar_proc_mem_ext_get(t, 0x7ffffffe, &memext));
+
+	/* opt-in snapshot column */
+	assert(SIGAR_OK == sigar_proc_snapshot_get(t, SIGAR_PROC_SNAPSHOT_MEM_EXT,
+				&snapshot));
+	for (i = 0; i < snapshot.number; i++) {
+		sigar_proc_snapshot_entry_t *entry = &snapshot.data[i];
+
+		if (entry->pid == self) {
+			assert(entry->flags & SIGAR_PROC_SNAPSHOT_MEM_EXT);
+			assert(entry->mem_ext.pss > 0);
+			found++;
+		}
+	}
+	assert(found == 1);
+	assert(SIGAR_OK == sigar_proc_snapshot_destroy(t, &snapshot));
+
+	return 0;
+}
+
+TEST(test_sigar_proc_net_io_get) {
+	static char buf[64 * 1024];
+	sigar_pid_t self = sigar_pid_get(t);
+	sigar_proc_net_io_t netio;
+	sigar_proc_snapshot_t snapshot;
+	struct sockaddr_in addr;
+	socklen_t addrlen = sizeof(addr);
+	int lfd, cfd, afd, status, found = 0;
+	ssize_t n, total = 0;
+	unsigned long i;
+
+	/* a loopback connection moving a known amount each way */
+	lfd = socket(AF_INET, SOCK_STREAM, 0);
+	assert(lfd >= 0);
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	assert(0 == bind(lfd, (struct sockaddr *)&addr, sizeof(addr)));
+	assert(0 == listen(lfd, 1));
+	assert(0 == getsockname(lfd, (struct sockaddr *)&addr, &addrlen));
+	cfd = socket(AF_INET, SOCK_STREAM, 0);
+	assert(0 == connect(cfd, (struct sockaddr *)&addr, sizeof(addr)));
+	afd = accept(lfd, NULL, NULL);
+	assert(afd >= 0);
+
+	assert(sizeof(buf) == send(cfd, buf, sizeof(buf), 0));
+	while (total < (ssize_t)sizeof(buf)) {
+		n = recv(afd, buf, sizeof(buf), 0);
+		assert(n > 0);
+		total += n;
+	}
+
+	status = sigar_proc_net_io_get(t, self, &netio);
+	if (status == SIGAR_OK) {
+		assert(netio.sockets >= 2);
+		assert(netio.bytes_sent >= sizeof(buf));
+		assert(netio.bytes_received >= sizeof(buf));
+		assert(netio.bytes_total == netio.bytes_sent + netio.bytes_received);
+
+		assert(ESRCH == sigar_proc_net_io_get(t, 0x7ffffffe, &netio));
+
+		assert(SIGAR_OK == sigar_proc_snapshot_get(t, SIGAR_PROC_SNAPSHOT_NET_IO,
+					&snapshot));
+		for (i = 0; i < snapshot.number; i++) {
+			sigar_proc_snapshot_entry_t *entry = &snapshot.data[i];
+
+			if (entry->pid == self) {
+				assert(entry->flags & SIGAR_PROC_SNAPSHOT_NET_IO);
+				assert(entry->net_io.bytes_received >= sizeof(buf));
+				found++;
+			}
+		}
+		assert(found == 1);
+		assert(SIGAR_OK == sigar_proc_snapshot_destroy(t, &snapshot));
+	}
+	else {
+		/* no sock_diag or a kernel without tcp_info byte counters */
+		assert(status == SIGAR_ENOTIMPL);
+	}
+
+	close(afd);
+	close(cfd);
+	close(lfd);
+
+	return 0;
+}
+
+typedef struct {
+	int number;
+	int self;
+	int stop_at;
+	char names[64][256];
+} proc_modules_seen_t;
+
+static int proc_modules_collect(void *data, char *name, int len) {
+	proc_modules_seen_t *seen = data;
+	int i;
+
+	assert(len == (int)strlen(name));
+	for (i = 0; i < seen->number && i < 64; i++) {
+		/* every file once, not once per segment */
+		assert(0 != strcmp(seen->names[i], name));
+	}
+	if (seen->number < 64) {
+		SIGAR_SSTRCPY(seen->names[seen->number], name);
+	}
+	if (strstr(name, "t_sigar_proc")) {
+		seen->self++;
+	}
+
+	return ++seen->number == seen->stop_at ? !SIGAR_OK : SIGAR_OK;
+}
+
+TEST(test_sigar_proc_modules_get) {
+	sigar_proc_modules_t procmods;
+	proc_modules_seen_t seen;
+
+	memset(&seen, 0, sizeof(seen));
+	procmods.module_getter = proc_modules_collect;
+	procmods.data = &seen;
+	assert(SIGAR_OK == sigar_proc_modules_get(t, sigar_pid_get(t), &procmods));
+	assert(seen.number > 1);
+	assert(seen.self == 1);
+
+	/* the getter ends the walk */
+	memset(&seen, 0, sizeof(seen));
+	seen.stop_at = 1;
+	assert(SIGAR_OK == sigar_proc_modules_get(t, sigar_pid_get(t), &procmods));
+	assert(seen.number == 1);
+
+	return 0;
+}
+
+TEST(test_sigar_proc_fd_get) {
+	sigar_pid_t self = sigar_pid_get(t);
+	sigar_proc_fd_t before, after;
+	int fds[64];
+	int i;
+
+	assert(SIGAR_OK == sigar_proc_fd_get(t, self, &before));
+	assert(before.total >= 3);
+
+	for (i = 0; i < 64; i++) {
+		assert((fds[i] = dup(0)) >= 0);
+	}
+	assert(SIGAR_OK == sigar_proc_fd_get(t, self, &after));
+	assert(after.total == before.total + 64);
+
+	for (i = 0; i < 64; i++) {
+		close(fds[i]);
+	}
+	assert(SIGAR_OK == sigar_proc_fd_get(t, self, &after));
+	assert(after.total == before.total);
+
+	assert(ESRCH == sigar_proc_fd_get(t, 0x7ffffffe, &after));
+
+	return 0;
+}
+
+static int proc_list_has(sigar_proc_list_t *pids, sigar_pid_t pid) {
+	unsigned long i;
+
+	for (i = 0; i < pids->number; i++) {
+		if (pids->data[i] == pid) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+TEST(test_sigar_proc_events) {
+	sigar_proc_events_t *events;
+	sigar_proc_event_list_t list;
+	sigar_proc_list_t pids;
+	sigar_pid_t self = sigar_pid_get(t), child;
+	int status, fds[2], forked = 0, exited = 0;
+	unsigned long i;
+	char c;
+
+	if ((status = sigar_proc_events_create(t, &events)) != SIGAR_OK) {
+		return 0; /* not root or not the initial namespace */
+	}
+	assert(EBUSY == sigar_proc_events_create(t, &events));
+
+	assert(0 == pipe(fds));
+	if ((child = fork()) == 0) {
+		close(fds[1]);
+		read(fds[0], &c, 1);
+		_exit(3);
+	}
+	assert(child > 0);
+	close(fds[0]);
+
+	/* fork events are sent before fork returns */
+	assert(SIGAR_OK == sigar_proc_list_get(t, &pids));
+	assert(proc_list_has(&pids, self));
+	assert(proc_list_has(&pids, child));
+	sigar_proc_list_destroy(t, &pids);
+
+	close(fds[1]);
+	assert(child == waitpid(child, NULL, 0));
+
+	assert(SIGAR_OK == sigar_proc_list_get(t, &pids));
+	assert(!proc_list_has(&pids, child));
+	sigar_proc_list_destroy(t, &pids);
+
+	assert(SIGAR_OK == sigar_proc_events_wait(events, 1000, &list));
+	for (i = 0; i < list.number; i++) {
+		sigar_proc_event_t *event = &list.data[i];
+
+		if (event->type == SIGAR_PROC_EVENT_OVERFLOW) {
+			forked = exited = 1; /* busy box, nothing to check */
+			break;
+		}
+		if (event->pid != child) {
+			continue;
+		}
+		if (event->type == SIGAR_PROC_EVENT_FORK) {
+			assert(event->ppid == self);
+			assert(!exited);
+			forked = 1;
+		}
+		else if (event->type == SIGAR_PROC_EVENT_EXIT) {
+			assert(WIFEXITED(event->exit_code));
+			assert(WEXITSTATUS(event->exit_code) == 3);
+			exited = 1;
+		}
+	}
+	assert(forked && exited);
+	sigar_proc_event_list_destroy(&list);
+
+	/* nothing happened since, a timeout */
+	assert(SIGAR_OK == sigar_proc_events_wait(events, 0, &list));
+	sigar_proc_event_list_destroy(&list);
+
+	assert(SIGAR_OK == sigar_proc_events_destroy(events));
+	/* free again for the next one */
+	assert(SIGAR_OK == sigar_proc_events_create(t, &events));
+	assert(SIGAR_OK == sigar_proc_events_destroy(events));
+
+	return 0;
+}
+
+TEST(test_sigar_proc_taskstats) {
+	sigar_t *ts;
+	sigar_pid_t self = sigar_pid_get(t);
+	sigar_proc_time_t procfs, taskstats;
+	sigar_proc_snapshot_t snapshot;
+	unsigned long i;
+	volatile unsigned long spin = 0;
+
+	/* falls back to procfs when unprivileged, either way it must agree */
+	setenv("SIGAR_PROC_TASKSTATS", "1", 1);
+	assert(SIGAR_OK == sigar_open(&ts));
+	unsetenv("SIGAR_PROC_TASKSTATS");
+
+	while (spin < 50000000) {
+		spin++;
+	}
+
+	assert(SIGAR_OK == sigar_proc_time_get(t, self, &procfs));
+	assert(SIGAR_OK == sigar_proc_time_get(ts, self, &taskstats));
+	assert(taskstats.start_time + 1000 >= procfs.start_time);
+	assert(taskstats.start_time <= procfs.start_time + 1000);
+	/* procfs is tick granular */
+	assert(taskstats.total + 100 >= procfs.total);
+	assert(SIGAR_OK != sigar_proc_time_get(ts, 999999999, &taskstats));
+
+	assert(SIGAR_OK == sigar_proc_snapshot_get(ts, SIGAR_PROC_SNAPSHOT_TIME,
+	                                           &snapshot));
+	assert(snapshot.number > 0);
+	for (i = 0; i < snapshot.number; i++) {
+		assert(snapshot.data[i].flags & SIGAR_PROC_SNAPSHOT_TIME);
+	}
+	sigar_proc_snapshot_destroy(ts, &snapshot);
+
+	sigar_close(ts);
+
+	return 0;
+}
+
+TEST(test_sigar_proc_uring) {
+	sigar_t *ur;
+	sigar_pid_t self = sigar_pid_get(t);
+	sigar_proc_snapshot_t batched;
+	sigar_proc_state_t state;
+	int round, found;
+	unsigned long i;
+
+	/* wherever io_uring is missing or refused this is the pread path */
+	setenv("SIGAR_PROC_URING", "1", 1);
+	assert(SIGAR_OK == sigar_open_ex(&ur, SIGAR_OPEN_PROC));
+	unsetenv("SIGAR_PROC_URING");
+
+	/* the second round finds stat cached, only the rest is batched */
+	for (round = 0; round < 2; round++) {
+		found = 0;
+		assert(SIGAR_OK == sigar_proc_snapshot_get(ur,
+			SIGAR_PROC_SNAPSHOT_ALL | SIGAR_PROC_SNAPSHOT_DISK_IO,
+			&batched));
+		assert(batched.number > 0);
+
+		for (i = 0; i < batched.number; i++) {
+			sigar_proc_snapshot_entry_t *entry = &batched.data[i];
+
+			if (entry->pid != self) {
+				continue;
+			}
+			found = 1;
+			assert(entry->flags & SIGAR_PROC_SNAPSHOT_STATE);
+			assert(entry->flags & SIGAR_PROC_SNAPSHOT_MEM);
+			assert(entry->flags & SIGAR_PROC_SNAPSHOT_DISK_IO);
+			assert(SIGAR_OK == sigar_proc_state_get(t, self, &state));
+			assert(strcmp(entry->state.name, state.name) == 0);
+			assert(entry->state.ppid == state.ppid);
+			assert(entry->state.threads >= 1);
+			assert(entry->mem.resident > 0);
+		}
+		assert(found);
+		sigar_proc_snapshot_destroy(ur, &batched);
+	}
+
+	/* nothing read ahead is left over for the single getters */
+	assert(SIGAR_OK == sigar_proc_state_get(ur, self, &state));
+	assert(SIGAR_OK != sigar_proc_state_get(ur, 999999999, &state));
+
+	sigar_close(ur);
+
+	return 0;
+}
+
+static void proc_root_write(const char *dir, const char *name,
+                            const char *content) {
+	char path[256];
+	FILE *fp;
+
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	assert((fp = fopen(path, "w")));
+	fputs(content, fp);
+	fclose(fp);
+}
+
+static const char *proc_root_files[] = {
+	"4242/stat", "4242/statm", "4243/stat", "4243/statm",
+	"stat", "loadavg", "meminfo"
+};
+
+TEST(test_sigar_proc_root) {
+	char dir[] = "/tmp/sigar-proc-root-XXXXXX";
+	char path[256];
+	sigar_t *fx;
+	sigar_proc_list_t pids;
+	sigar_proc_state_t state;
+	sigar_proc_mem_t mem;
+	sigar_loadavg_t loadavg;
+	sigar_mem_t m;
+	unsigned long i;
+
+	assert(mkdtemp(dir));
+	snprintf(path, sizeof(path), "%s/4242", dir);
+	assert(mkdir(path, 0700) == 0);
+	snprintf(path, sizeof(path), "%s/4243", dir);
+	assert(mkdir(path, 0700) == 0);
+
+	proc_root_write(dir, "stat",
+	                "cpu  100 0 100 1000 0 0 0 0 0 0\n"
+	                "cpu0 100 0 100 1000 0 0 0 0 0 0\n"
+	                "btime 1700000000\nprocs_running 1\nprocs_blocked 0\n");
+	proc_root_write(dir, "loadavg", "0.50 0.25 0.10 1/2 4243\n");
+	proc_root_write(dir, "meminfo",
+	                "MemTotal:  1024 kB\nMemFree:  512 kB\n");
+	proc_root_write(dir, "4242/stat",
+	                "4242 (fixture) S 1 4242 4242 0 -1 0 0 0 0 0 "
+	                "10 5 0 0 20 0 1 0 100 8192 2 0 "
+	                "0 0 0 0 0 0 0 0 0 0 0 0 17 0 0 0 0 0 0\n");
+	proc_root_write(dir, "4242/statm", "2 1 1 1 0 1 0\n");
+	proc_root_write(dir, "4243/stat",
+	                "4243 (fixture2) R 4242 4243 4243 0 -1 0 0 0 0 0 "
+	                "10 5 0 0 20 0 1 0 100 8192 2 0 "
+	                "0 0 0 0 0 0 0 0 0 0 0 0 17 0 0 0 0 0 0\n");
+	proc_root_write(dir, "4243/statm", "2 1 1 1 0 1 0\n");
+
+	setenv("SIGAR_PROC_ROOT", dir, 1);
+	assert(SIGAR_OK == sigar_open(&fx));
+	unsetenv("SIGAR_PROC_ROOT");
+
+	assert(SIGAR_OK == sigar_proc_list_get(fx, &pids));
+	assert(pids.number == 2);
+	for (i = 0; i < pids.number; i++) {
+		assert(pids.data[i] == 4242 || pids.data[i] == 4243);
+	}
+	sigar_proc_list_destroy(fx, &pids);
+
+	assert(SIGAR_OK == sigar_proc_state_get(fx, 4243, &state));
+	assert(strcmp(state.name, "fixture2") == 0);
+	assert(state.ppid == 4242);
+	assert(SIGAR_OK == sigar_proc_mem_get(fx, 4242, &mem));
+	assert(ESRCH == sigar_proc_state_get(fx, sigar_pid_get(fx), &state));
+
+	assert(SIGAR_OK == sigar_loadavg_get(fx, &loadavg));
+	assert(loadavg.loadavg[0] == 0.5);
+	assert(SIGAR_OK == sigar_mem_get(fx, &m));
+	assert(m.total == 1024 * 1024);
+
+	sigar_close(fx);
+
+	/* the root is process wide, put the real one back for t */
+	assert(SIGAR_OK == sigar_open(&fx));
+	sigar_close(fx);
+
+	for (i = 0; i < sizeof(proc_root_files) / sizeof(*proc_root_files); i++) {
+		snprintf(path, sizeof(path), "%s/%s", dir, proc_root_files[i]);
+		unlink(path);
+	}
+	snprintf(path, sizeof(path), "%s/4242", dir);
+	rmdir(path);
+	snprintf(path, sizeof(path), "%s/4243", dir);
+	rmdir(path);
+	rmdir(dir);
+
+	return 0;
+}
+#endif
+
+TEST(test_sigar_proc_cgroup_get) {
+	sigar_pid_t self = sigar_pid_get(t);
+	sigar_proc_cgroup_t cgroup;
+	sigar_cgroup_stat_t cgroupstat;
+	sigar_cgroup_list_t cgroups;
+	sigar_proc_snapshot_t snapshot;
+	int status, found = 0;
+	size_t i;
+
+	status = sigar_proc_cgroup_get(t, self, &cgroup);
+	if (status == SIGAR_ENOTIMPL) {
+		return 0; /* no cgroup fs mounted */
+	}
+	assert(status == SIGAR_OK);
+	assert(cgroup.path[0] == '/');
+	assert(cgroup.id > 0);
+
+	assert(SIGAR_OK == sigar_cgroup_stat_get(t, cgroup.path, &cgroupstat));
+	assert(cgroupstat.id == cgroup.id);
+	if (IS_IMPL_U64(cgroupstat.cpu_total) && IS_IMPL_U64(cgroupstat.cpu_user)) {
+		assert(cgroupstat.cpu_user <= cgroupstat.cpu_total + 100);
+	}
+	if (IS_IMPL_U64(cgroupstat.pids_current)) {
+		assert(cgroupstat.pids_current >= 1); /* us */
+	}
+	assert(SIGAR_OK != sigar_cgroup_stat_get(t, "/no/such/cgroup", &cgroupstat));
+
+	assert(SIGAR_OK == sigar_cgroup_list_get(t, &cgroups));
+	assert(cgroups.number > 0);
+	assert(strcmp(cgroups.data[0], "/") == 0);
+	for (i = 0; i < cgroups.number; i++) {
+		if (strcmp(cgroups.data[i], cgroup.path) == 0) {
+			found = 1;
+		}
+	}
+	assert(found);
+	sigar_cgroup_list_destroy(t, &cgroups);
+
+	assert(SIGAR_OK == sigar_proc_snapshot_get(t, SIGAR_PROC_SNAPSHOT_CGROUP,
+	                                           &snapshot));
+	for (i = 0, found = 0; i < snapshot.number; i++) {
+		if (snapshot.data[i].pid == self) {
+			assert(snapshot.data[i].flags & SIGAR_PROC_SNAPSHOT_CGROUP);
+			assert(snapshot.data[i].cgroup == cgroup.id);
+			found = 1;
+		}
+	}
+	assert(found);
+	sigar_proc_snapshot_destroy(t, &snapshot);
+
+	return 0;
+}
+
+#if defined(SIGAR_TEST_OS_LINUX)
+TEST(test_sigar_proc_perf) {
+	sigar_pid_t self = sigar_pid_get(t);
+	sigar_proc_perf_t first, second;
+	int status, i;
+
+	assert(ENOENT == sigar_proc_perf_get(t, self, &first));
+
+	status = sigar_proc_perf_open(t, self);
+	if (status != SIGAR_OK) {
+		/* no perf_event_open here, or not allowed to */
+		return 0;
+	}
+	/* opening twice is fine */
+	assert(SIGAR_OK == sigar_proc_perf_open(t, self));
+
+	assert(SIGAR_OK == sigar_proc_perf_get(t, self, &first));
+	for (i = 0; i < 5; i++) {
+		usleep(1000); /* a context switch each */
+	}
+	assert(SIGAR_OK == sigar_proc_perf_get(t, self, &second));
+
+	assert(second.time_enabled >= first.time_enabled);
+	assert(second.time_running <= second.time_enabled);
+	if (IS_IMPL_U64(second.context_switches)) {
+		assert(second.context_switches >= first.context_switches + 5);
+	}
+	if (IS_IMPL_U64(second.instructions)) {
+		assert(second.instructions > first.instructions);
+	}
+
+	assert(SIGAR_OK == sigar_proc_perf_close(t, self));
+	assert(ENOENT == sigar_proc_perf_get(t, self, &second));
+	assert(SIGAR_OK != sigar_proc_perf_open(t, 0x7ffffff0));
+
+	return 0;
+}
+
+TEST(test_sigar_proc_sched_get) {
+	sigar_pid_t self = sigar_pid_get(t);
+	sigar_proc_sched_t first, second;
+	sigar_proc_snapshot_t snapshot;
+	sigar_proc_cgroup_t cgroup;
+	sigar_pressure_t pressure;
+	clock_t start;
+	int status, found = 0;
+	size_t i;
+
+	status = sigar_proc_sched_get(t, self, &first);
+	if (status != SIGAR_OK) {
+		/* no CONFIG_SCHEDSTATS */
+		return 0;
+	}
+	for (start = clock(); clock() - start < CLOCKS_PER_SEC / 20;) {
+		;
+	}
+	assert(SIGAR_OK == sigar_proc_sched_get(t, self, &second));
+	assert(second.run_time > first.run_time);
+	assert(second.timeslices >= first.timeslices);
+	assert(SIGAR_OK != sigar_proc_sched_get(t, 0x7ffffff0, &second));
+
+	assert(SIGAR_OK == sigar_proc_snapshot_get(t, SIGAR_PROC_SNAPSHOT_SCHED, &snapshot));
+	for (i = 0; i < snapshot.number; i++) {
+		sigar_proc_snapshot_entry_t *entry = &snapshot.data[i];
+
+		assert(!(entry->flags & ~SIGAR_PROC_SNAPSHOT_SCHED));
+		if (entry->pid == self) {
+			assert(entry->flags & SIGAR_PROC_SNAPSHOT_SCHED);
+			assert(entry->sched.run_time >= second.run_time);
+			found = 1;
+		}
+	}
+	assert(found);
+	sigar_proc_snapshot_destroy(t, &snapshot);
+
+	/* psi per cgroup needs cgroup2, which may not be mounted */
+	if ((sigar_proc_cgroup_get(t, self, &cgroup) == SIGAR_OK) &&
+	    (sigar_cgroup_pressure_get(t, cgroup.path, &pressure) == SIGAR_OK))
+	{
+		assert(pressure.cpu.some.avg10 == SIGAR_FIELD_NOTIMPL ||
+		       pressure.cpu.some.avg10 >= 0);
+	}
+
+	return 0;
+}
+#endif
+
+TEST(test_sigar_open_ex) {
+	sigar_t *eager;
+	sigar_pid_t self = sigar_pid_get(t);
+	sigar_proc_time_t lazy_time, eager_time;
+	sigar_proc_fd_t procfd;
+	sigar_proc_list_t pids;
+	sigar_uptime_t uptime;
+	sigar_capabilities_t lazy_caps, eager_caps;
+
+	assert(SIGAR_OK == sigar_open_ex(&eager, SIGAR_OPEN_ALL));
+
+	/* probed up front or on first use, the answers are the same */
+	assert(SIGAR_OK == sigar_proc_time_get(t, self, &lazy_time));
+	assert(SIGAR_OK == sigar_proc_time_get(eager, self, &eager_time));
+	assert(lazy_time.start_time == eager_time.start_time);
+	assert(SIGAR_OK == sigar_uptime_get(eager, &uptime));
+	assert(uptime.uptime > 0);
+	assert(SIGAR_OK == sigar_proc_list_get(eager, &pids));
+	assert(pids.number > 0);
+	sigar_proc_list_destroy(eager, &pids);
+	if (SIGAR_OK == sigar_proc_fd_get(eager, self, &procfd)) {
+		assert(procfd.total > 0);
+	}
+
+
+	/* the same host picks the same implementations */
+	assert(SIGAR_OK == sigar_capabilities_get(t, &lazy_caps));
+	assert(SIGAR_OK == sigar_capabilities_get(eager, &eager_caps));
+#ifdef SIGAR_TEST_OS_LINUX
+	assert(lazy_caps.disk_io && lazy_caps.net_conn && lazy_caps.proc_read);
+	assert(strcmp(lazy_caps.disk_io, eager_caps.disk_io) == 0);
+	assert(strcmp(lazy_caps.net_conn, eager_caps.net_conn) == 0);
+	assert(strcmp(lazy_caps.proc_time, eager_caps.proc_time) == 0);
+	assert(!lazy_caps.proc_list);
+#endif
+	sigar_close(eager);
+
+	/* nothing declared is a plain sigar_open */
+	assert(SIGAR_OK == sigar_open_ex(&eager, 0));
+	assert(SIGAR_OK == sigar_proc_time_get(eager, self, &eager_time));
+	assert(lazy_time.start_time == eager_time.start_time);
+	sigar_close(eager);
+
+	return 0;
+}
+
+TEST(test_sigar_arena) {
+	sigar_arena_t *arena;
+	sigar_proc_list_t pids;
+	sigar_file_system_list_t fslist;
+	sigar_net_route_list_t routes;
+	sigar_pid_t *pid_data;
+	unsigned long pid_size;
+	sigar_uint64_t bytes;
+	int fs_status, route_status;
+	int poll;
+
+	assert(SIGAR_OK == sigar_arena_create(&arena));
+	assert(sigar_arena_bytes(arena) == 0);
+
+	for (poll=0; poll<3; poll++) {
+		sigar_arena_reset(arena);
+
+		assert(SIGAR_OK == sigar_proc_list_get_ex(t, arena, &pids));
+		assert(pids.number > 0);
+		assert(pids.number <= pids.size);
+		fs_status = sigar_file_system_list_get_ex(t, arena, &fslist);
+		if (fs_status == SIGAR_OK) {
+			assert(fslist.number <= fslist.size);
+		}
+		route_status = sigar_net_route_list_get_ex(t, arena, &routes);
+		if (route_status == SIGAR_OK) {
+			assert(routes.number <= routes.size);
+		}
+
+		if (poll == 0) {
+			pid_data = pids.data;
+			pid_size = pids.size;
+			bytes = sigar_arena_bytes(arena);
+			assert(bytes >= pids.size * sizeof(*pids.data));
+		}
+		else if (pids.size == pid_size) {
+			/* same call order, the last poll's buffer came back */
+			assert(pids.data == pid_data);
+		}
+	}
+
+	if (pids.size == pid_size) {
+		assert(sigar_arena_bytes(arena) >= bytes);
+	}
+
+	/* the lists are the arena's, no *_destroy */
+	sigar_arena_destroy(arena);
+
+	return 0;
+}
+
+#if defined(SIGAR_TEST_OS_LINUX)
+static int proc_list_contains(sigar_proc_list_t *pids, sigar_pid_t pid) {
+	unsigned long i;
+
+	for (i = 0; i < pids->number; i++) {
+		if (pids->data[i] == pid) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+TEST(test_sigar_proc_tree_get) {
+	sigar_pid_t self = sigar_pid_get(t);
+	sigar_proc_tree_t tree;
+	sigar_proc_tree_entry_t *me, *kid, *grandkid;
+	sigar_proc_list_t pids;
+	sigar_ptql_query_t *query;
+	sigar_ptql_error_t error;
+	char ptql[64];
+	int hold[2], report[2];
+	pid_t child, grandchild;
+	unsigned long i;
+	char c;
+
+	/* self -> child -> grandchild, kept until hold is closed */
+	assert(0 == pipe(hold));
+	assert(0 == pipe(report));
+	if ((child = fork()) == 0) {
+		close(hold[1]);
+		if ((grandchild = fork()) == 0) {
+			if (read(hold[0], &c, 1) < 0) {
+				_exit(1);
+			}
+			_exit(0);
+		}
+		if (write(report[1], &grandchild, sizeof(grandchild)) < 0 ||
+		    read(hold[0], &c, 1) < 0)
+		{
+			_exit(1);
+		}
+		waitpid(grandchild, NULL, 0);
+		_exit(0);
+	}
+	assert(child > 0);
+	close(hold[0]);
+	assert(read(report[0], &grandchild, sizeof(grandchild)) ==
+	       sizeof(grandchild));
+
+	assert(SIGAR_OK == sigar_proc_tree_get(t, SIGAR_PROC_TREE_FD, &tree));
+	for (i = 1; i < tree.number; i++) {
+		assert(tree.data[i-1].pid < tree.data[i].pid);
+	}
+	assert(SIGAR_PROC_TREE_NONE != sigar_proc_tree_find(&tree, self));
+	me = &tree.data[sigar_proc_tree_find(&tree, self)];
+	kid = &tree.data[sigar_proc_tree_find(&tree, child)];
+	grandkid = &tree.data[sigar_proc_tree_find(&tree, grandchild)];
+
+	assert(&tree.data[kid->parent] == me);
+	assert(&tree.data[grandkid->parent] == kid);
+	assert(kid->child == (unsigned long)(grandkid - tree.data));
+	assert(grandkid->child == SIGAR_PROC_TREE_NONE);
+	assert(grandkid->subtree.processes == 1);
+	assert(kid->subtree.processes == 2);
+	assert(me->subtree.processes >= 3);
+	assert(kid->subtree.resident ==
+	       kid->self.resident + grandkid->self.resident);
+	assert(me->subtree.fds >= me->self.fds + kid->self.fds);
+	assert(me->self.fds > 0);
+
+	assert(SIGAR_OK == sigar_proc_tree_pids_get(&tree, child, &pids));
+	assert(pids.number == 2);
+	assert(pids.data[0] == child && pids.data[1] == grandchild);
+	sigar_proc_list_destroy(t, &pids);
+
+	assert(SIGAR_OK == sigar_proc_tree_pids_get(&tree, self, &pids));
+	assert(pids.data[0] == self);
+	assert(proc_list_contains(&pids, grandchild));
+	sigar_proc_list_destroy(t, &pids);
+
+	assert(ESRCH == sigar_proc_tree_pids_get(&tree, 0x7ffffff0, &pids));
+	sigar_proc_tree_destroy(t, &tree);
+
+	/* without the fds */
+	assert(SIGAR_OK == sigar_proc_tree_get(t, 0, &tree));
+	me = &tree.data[sigar_proc_tree_find(&tree, self)];
+	assert(me->self.fds == SIGAR_FIELD_NOTIMPL);
+	assert(me->subtree.fds == SIGAR_FIELD_NOTIMPL);
+	sigar_proc_tree_destroy(t, &tree);
+
+	snprintf(ptql, sizeof(ptql), "Tree.Root.eq=%d", (int)child);
+	assert(SIGAR_OK == sigar_ptql_query_create(&query, ptql, &error));
+	assert(SIGAR_OK == sigar_ptql_query_find(t, query, &pids));
+	assert(pids.number == 2);
+	assert(proc_list_contains(&pids, child));
+	assert(proc_list_contains(&pids, grandchild));
+	sigar_proc_list_destroy(t, &pids);
+	assert(SIGAR_OK == sigar_ptql_query_match(t, query, grandchild));
+	assert(SIGAR_OK != sigar_ptql_query_match(t, query, self));
+	sigar_ptql_query_destroy(query);
+
+	snprintf(ptql, sizeof(ptql), "Tree.Root.eq=$$,Pid.Pid.eq=%d",
+	         (int)grandchild);
+	assert(SIGAR_OK == sigar_ptql_query_create(&query, ptql, &error));
+	assert(SIGAR_OK == sigar_ptql_query_find(t, query, &pids));
+	assert(pids.number == 1 && pids.data[0] == grandchild);
+	sigar_proc_list_destroy(t, &pids);
+	sigar_ptql_query_destroy(query);
+
+	snprintf(ptql, sizeof(ptql), "Tree.Root.ne=%d", (int)child);
+	assert(SIGAR_PTQL_MALFORMED_QUERY ==
+	       sigar_ptql_query_create(&query, ptql, &error));
+
+	close(hold[1]);
+	close(report[0]);
+	close(report[1]);
+	assert(child == waitpid(child, NULL, 0));
+
+	return 0;
+}
+
+/* the cache answers until the child execs, seen by its exe inode */
+TEST(test_sigar_proc_attr_cache) {
+	sigar_proc_args_t args, again;
+	sigar_proc_exe_t exe, exe_again;
+	sigar_pid_t child;
+	char self_exe[SIGAR_PATH_MAX+1], name[64], link[SIGAR_PATH_MAX+1];
+	int fds[2], i;
+	ssize_t len;
+	unsigned long n;
+
+	assert(SIGAR_OK == sigar_proc_attr_cache_set(t, 1024 * 1024));
+
+	assert(0 == pipe(fds));
+	if ((child = fork()) == 0) {
+		char c;
+
+		close(fds[1]);
+		read(fds[0], &c, 1);
+		execl("/bin/sleep", "sleep", "5", (char *)NULL);
+		_exit(127);
+	}
+	assert(child > 0);
+	close(fds[0]);
+
+	assert(SIGAR_OK == sigar_proc_args_get(t, child, &args));
+	assert(args.number > 0);
+	assert(SIGAR_OK == sigar_proc_exe_get(t, child, &exe));
+	strcpy(self_exe, exe.name);
+
+	/* from the cache, the same */
+	assert(SIGAR_OK == sigar_proc_args_get(t, child, &again));
+	assert(again.number == args.number);
+	for (n = 0; n < args.number; n++) {
+		assert(0 == strcmp(again.data[n], args.data[n]));
+	}
+	assert(SIGAR_OK == sigar_proc_args_destroy(t, &again));
+	assert(SIGAR_OK == sigar_proc_exe_get(t, child, &exe_again));
+	assert(0 == strcmp(exe_again.name, exe.name));
+	assert(0 == strcmp(exe_again.cwd, exe.cwd));
+
+	close(fds[1]);
+	snprintf(name, sizeof(name), "/proc/%d/exe", (int)child);
+	for (i = 0; i < 500; i++) {
+		if (((len = readlink(name, link, sizeof(link) - 1)) > 0) &&
+		    (link[len] = '\0', strcmp(link, self_exe) != 0))
+		{
+			break;
+		}
+		usleep(10 * 1000);
+	}
+	assert(i < 500);
+
+	assert(SIGAR_OK == sigar_proc_args_get(t, child, &again));
+	assert(again.number == 2);
+	assert(0 == strcmp(again.data[0], "sleep"));
+	assert(SIGAR_OK == sigar_proc_args_destroy(t, &again));
+	assert(SIGAR_OK == sigar_proc_exe_get(t, child, &exe_again));
+	assert(0 != strcmp(exe_again.name, self_exe));
+
+	/* a bound too small for any entry still answers */
+	assert(SIGAR_OK == sigar_proc_attr_cache_set(t, 1));
+	assert(SIGAR_OK == sigar_proc_args_get(t, child, &again));
+	assert(again.number == 2);
+	assert(SIGAR_OK == sigar_proc_args_destroy(t, &again));
+	assert(SIGAR_OK == sigar_proc_args_get(t, child, &again));
+	assert(again.number == 2);
+	assert(SIGAR_OK == sigar_proc_args_destroy(t, &again));
+
+	assert(SIGAR_OK == sigar_proc_args_destroy(t, &args));
+	assert(SIGAR_OK == sigar_proc_attr_cache_set(t, 0));
+
+	kill(child, SIGKILL);
+	assert(child == waitpid(child, NULL, 0));
+
+	return 0;
+}
+#endif
+
 int main() {
 	sigar_t *t;
 	int err = 0;
@@ -192,6 +1785,39 @@ int main() {
 
 	test_sigar_proc_stat_get(t);
 	test_sigar_proc_list_get(t);
+	test_sigar_proc_iter(t);
+	test_sigar_proc_snapshot_get(t);
+#if defined(SIGAR_TEST_OS_LINUX)
+	test_sigar_proc_snapshot_fresh(t);
+	test_sigar_proc_stat_reused(t);
+	test_sigar_proc_snapshot_unread(t);
+#endif
+	test_sigar_proc_fields(t);
+	test_sigar_proc_top_get(t);
+	test_sigar_proc_thread_list_get(t);
+	test_sigar_proc_scan_threads_set(t);
+	test_sigar_proc_cache_expire_set(t);
+	test_sigar_cred_name_expire_set(t);
+	test_sigar_proc_pin(t);
+	test_sigar_proc_handle(t);
+	test_sigar_proc_cgroup_get(t);
+	test_sigar_open_ex(t);
+	test_sigar_arena(t);
+#if defined(SIGAR_TEST_OS_LINUX)
+	test_sigar_proc_env_get(t);
+	test_sigar_proc_mem_ext_get(t);
+	test_sigar_proc_net_io_get(t);
+	test_sigar_proc_modules_get(t);
+	test_sigar_proc_fd_get(t);
+	test_sigar_proc_taskstats(t);
+	test_sigar_proc_uring(t);
+	test_sigar_proc_events(t);
+	test_sigar_proc_root(t);
+	test_sigar_proc_tree_get(t);
+	test_sigar_proc_perf(t);
+	test_sigar_proc_sched_get(t);
+	test_sigar_proc_attr_cache(t);
+#endif
 
 	sigar_close(t);
 
@@ -0,0 +1,243 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#ifndef WIN32
+#include <unistd.h>
+#endif
+
+#include "sigar.h"
+#include "sigar_tests.h"
+
+#define SYNTHETIC_PROCS 37
+
+#define SYNTHETIC_COLUMNS \
+	(SIGAR_PROC_COL(SIGAR_PROC_COL_PID) | \
+	 SIGAR_PROC_COL(SIGAR_PROC_COL_RESIDENT) | \
+	 SIGAR_PROC_COL(SIGAR_PROC_COL_CPU_PERCENT) | \
+	 SIGAR_PROC_COL(SIGAR_PROC_COL_CGROUP))
+
+#define ALIGNED(ptr) \
+	((((size_t)(ptr)) & (SIGAR_PROC_COLUMNS_ALIGN - 1)) == 0)
+
+/* odd row count, so the kernels run their tails too */
+static void synthetic_snapshot(sigar_proc_snapshot_t *snapshot) {
+	unsigned long i;
+
+	snapshot->number = snapshot->size = SYNTHETIC_PROCS;
+	snapshot->data = calloc(SYNTHETIC_PROCS, sizeof(*snapshot->data));
+	assert(snapshot->data);
+
+	for (i = 0; i < SYNTHETIC_PROCS; i++) {
+		sigar_proc_snapshot_entry_t *entry = &snapshot->data[i];
+
+		entry->pid = 100 + i;
+		entry->flags = SIGAR_PROC_SNAPSHOT_MEM | SIGAR_PROC_SNAPSHOT_TIME |
+			SIGAR_PROC_SNAPSHOT_CPU | SIGAR_PROC_SNAPSHOT_CGROUP;
+		entry->mem.resident = (i % 10) * 1000;
+		entry->cpu.percent = (i % 7) * 0.5;
+		entry->cgroup = i % 3;
+	}
+	/* no mem read for this one, its resident is left as 0 */
+	snapshot->data[5].flags &= ~SIGAR_PROC_SNAPSHOT_MEM;
+	snapshot->data[5].mem.resident = 123456;
+}
+
+TEST(test_sigar_proc_columns_kernels) {
+	sigar_proc_snapshot_t snapshot;
+	sigar_proc_columns_t cols;
+	sigar_proc_columns_group_list_t groups;
+	unsigned char mask[SYNTHETIC_PROCS];
+	unsigned long rows[4], number, row, i;
+	double sum, expect;
+
+	synthetic_snapshot(&snapshot);
+
+	assert(SIGAR_OK == sigar_proc_columns_snapshot_get(t, &snapshot,
+	                                                   SYNTHETIC_COLUMNS,
+	                                                   &cols));
+	free(snapshot.data);
+
+	assert(cols.number == SYNTHETIC_PROCS);
+	assert(cols.columns == SYNTHETIC_COLUMNS);
+	assert(cols.u64[SIGAR_PROC_COL_PID] && ALIGNED(cols.u64[SIGAR_PROC_COL_PID]));
+	assert(cols.u64[SIGAR_PROC_COL_RESIDENT] &&
+	       ALIGNED(cols.u64[SIGAR_PROC_COL_RESIDENT]));
+	assert(cols.f64[SIGAR_PROC_COL_CPU_PERCENT] &&
+	       ALIGNED(cols.f64[SIGAR_PROC_COL_CPU_PERCENT]));
+	assert(!cols.u64[SIGAR_PROC_COL_CPU_PERCENT]);
+	assert(!cols.u64[SIGAR_PROC_COL_SIZE] && !cols.f64[SIGAR_PROC_COL_SIZE]);
+	assert(cols.u64[SIGAR_PROC_COL_PID][36] == 136);
+	assert(cols.u64[SIGAR_PROC_COL_RESIDENT][5] == 0);
+
+	/* not filled */
+	assert(EINVAL == sigar_proc_columns_sum(&cols, SIGAR_PROC_COL_SIZE,
+	                                        NULL, &sum));
+	assert(EINVAL == sigar_proc_columns_sum(&cols, SIGAR_PROC_COL_MAX,
+	                                        NULL, &sum));
+
+	for (expect = 0, i = 0; i < SYNTHETIC_PROCS; i++) {
+		expect += (i == 5) ? 0 : (i % 10) * 1000;
+	}
+	assert(SIGAR_OK == sigar_proc_columns_sum(&cols, SIGAR_PROC_COL_RESIDENT,
+	                                          NULL, &sum));
+	assert(sum == expect);
+
+	/* resident above 4500: 5000 to 9000 of each ten, bar row 5 */
+	memset(mask, 1, sizeof(mask));
+	assert(SIGAR_OK == sigar_proc_columns_filter_gt(&cols,
+	                                                SIGAR_PROC_COL_RESIDENT,
+	                                                4500, mask));
+	for (expect = 0, number = 0, i = 0; i < SYNTHETIC_PROCS; i++) {
+		assert(mask[i] == ((i != 5) && ((i % 10) >= 5)));
+		if (mask[i]) {
+			expect += (i % 7) * 0.5;
+			number++;
+		}
+	}
+	assert(SIGAR_OK == sigar_proc_columns_sum(&cols,
+	                                          SIGAR_PROC_COL_CPU_PERCENT,
+	                                          mask, &sum));
+	assert(sum == expect);
+
+	/* chained, cpu above 2.0 as well */
+	assert(SIGAR_OK == sigar_proc_columns_filter_gt(&cols,
+	                                                SIGAR_PROC_COL_CPU_PERCENT,
+	                                                2.0, mask));
+	for (i = 0; i < SYNTHETIC_PROCS; i++) {
+		assert(mask[i] == ((i != 5) && ((i % 10) >= 5) && ((i % 7) > 4)));
+	}
+
+	/* 9000 first at row 9; cpu 3.0 first at row 6 */
+	assert(SIGAR_OK == sigar_proc_columns_max(&cols, SIGAR_PROC_COL_RESIDENT,
+	                                          NULL, &row));
+	assert(row == 9);
+	assert(SIGAR_OK == sigar_proc_columns_max(&cols,
+	                                          SIGAR_PROC_COL_CPU_PERCENT,
+	                                          NULL, &row));
+	assert(row == 6);
+	memset(mask, 0, sizeof(mask));
+	assert(ENOENT == sigar_proc_columns_max(&cols, SIGAR_PROC_COL_RESIDENT,
+	                                        mask, &row));
+	mask[3] = mask[4] = 1;
+	assert(SIGAR_OK == sigar_proc_columns_max(&cols, SIGAR_PROC_COL_RESIDENT,
+	                                          mask, &row));
+	assert(row == 4);
+
+	/* 9000 at rows 9, 19, 29, then 8000 at 8 */
+	assert(SIGAR_OK == sigar_proc_columns_top_k(&cols, SIGAR_PROC_COL_RESIDENT,
+	                                            NULL, 4, rows, &number));
+	assert(number == 4);
+	assert(rows[0] == 9 && rows[1] == 19 && rows[2] == 29 && rows[3] == 8);
+
+	assert(SIGAR_OK == sigar_proc_columns_top_k(&cols, SIGAR_PROC_COL_RESIDENT,
+	                                            mask, 4, rows, &number));
+	assert(number == 2);
+	assert(rows[0] == 4 && rows[1] == 3);
+
+	assert(SIGAR_OK == sigar_proc_columns_group_sum(&cols,
+	                                                SIGAR_PROC_COL_CGROUP,
+	                                                SIGAR_PROC_COL_RESIDENT,
+	                                                NULL, &groups));
+	assert(groups.number == 3);
+	for (row = 0; row < groups.number; row++) {
+		sigar_uint64_t count = 0;
+
+		assert(groups.data[row].key == row);
+		for (expect = 0, i = 0; i < SYNTHETIC_PROCS; i++) {
+			if ((i % 3) == row) {
+				expect += (i == 5) ? 0 : (i % 10) * 1000;
+				count++;
+			}
+		}
+		assert(groups.data[row].count == count);
+		assert(groups.data[row].sum == expect);
+	}
+	assert(SIGAR_OK == sigar_proc_columns_group_list_destroy(&groups));
+
+	/* the key has to be a u64 column */
+	assert(EINVAL == sigar_proc_columns_group_sum(&cols,
+	                                              SIGAR_PROC_COL_CPU_PERCENT,
+	                                              SIGAR_PROC_COL_RESIDENT,
+	                                              NULL, &groups));
+
+	assert(SIGAR_OK == sigar_proc_columns_destroy(t, &cols));
+
+	return 0;
+}
+
+TEST(test_sigar_proc_columns_get) {
+	sigar_proc_columns_t cols;
+	sigar_proc_columns_group_list_t groups;
+	unsigned long i, row = 0, found = 0;
+	sigar_uint64_t total = 0;
+	double sum;
+	int columns =
+		SIGAR_PROC_COL(SIGAR_PROC_COL_PID) |
+		SIGAR_PROC_COL(SIGAR_PROC_COL_RESIDENT) |
+		SIGAR_PROC_COL(SIGAR_PROC_COL_CPU_TOTAL) |
+		SIGAR_PROC_COL(SIGAR_PROC_COL_UID);
+
+	assert(SIGAR_OK == sigar_proc_columns_get(t, columns, &cols));
+	assert(cols.number > 0);
+
+	for (i = 0; i < cols.number; i++) {
+		total += cols.u64[SIGAR_PROC_COL_RESIDENT][i];
+		if (cols.u64[SIGAR_PROC_COL_PID][i] == (sigar_uint64_t)sigar_pid_get(t)) {
+			row = i;
+			found++;
+		}
+	}
+	assert(found == 1);
+	assert(cols.u64[SIGAR_PROC_COL_RESIDENT][row] > 0);
+
+	assert(SIGAR_OK == sigar_proc_columns_sum(&cols, SIGAR_PROC_COL_RESIDENT,
+	                                          NULL, &sum));
+	assert(sum == (double)total);
+
+	assert(SIGAR_OK == sigar_proc_columns_group_sum(&cols, SIGAR_PROC_COL_UID,
+	                                                SIGAR_PROC_COL_RESIDENT,
+	                                                NULL, &groups));
+	for (found = 0, i = 0; i < groups.number; i++) {
+		found += groups.data[i].count;
+		if (groups.data[i].key == cols.u64[SIGAR_PROC_COL_UID][row]) {
+			assert(groups.data[i].sum >=
+			       cols.u64[SIGAR_PROC_COL_RESIDENT][row]);
+		}
+	}
+	assert(found == cols.number);
+	assert(SIGAR_OK == sigar_proc_columns_group_list_destroy(&groups));
+
+	assert(SIGAR_OK == sigar_proc_columns_destroy(t, &cols));
+
+	return 0;
+}
+
+int main() {
+	sigar_t *t;
+	int err = 0;
+
+	assert(SIGAR_OK == sigar_open(&t));
+
+	test_sigar_proc_columns_kernels(t);
+	test_sigar_proc_columns_get(t);
+
+	sigar_close(t);
+
+	return err ? -1 : 0;
+}
@@ -0,0 +1,564 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#ifndef WIN32
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <unistd.h>
+#endif
+
+#include "sigar.h"
+#include "sigar_ptql.h"
+#include "sigar_tests.h"
+
+static int ptql_match(sigar_t *t, const char *ptql, sigar_pid_t pid) {
+	sigar_ptql_query_t *query;
+	sigar_ptql_error_t error;
+	char buf[512];
+	int status;
+
+	snprintf(buf, sizeof(buf), "%s", ptql);
+	assert(SIGAR_OK == sigar_ptql_query_create(&query, buf, &error));
+	status = sigar_ptql_query_match(t, query, pid);
+	sigar_ptql_query_destroy(query);
+
+	return status;
+}
+
+TEST(test_sigar_ptql_query_match) {
+	sigar_pid_t self = sigar_pid_get(t);
+	sigar_proc_state_t state, pstate;
+	sigar_proc_cgroup_t cgroup;
+	char ptql[512];
+
+	assert(SIGAR_OK == sigar_proc_state_get(t, self, &state));
+	assert(SIGAR_OK == sigar_proc_state_get(t, state.ppid, &pstate));
+
+	/* costly branch written first, cheap ones sharing one State read */
+	snprintf(ptql, sizeof(ptql),
+	         "Mem.Size.gt=0,State.Name.eq=%s,State.Ppid.eq=%d",
+	         state.name, (int)state.ppid);
+	assert(SIGAR_OK == ptql_match(t, ptql, self));
+
+	snprintf(ptql, sizeof(ptql),
+	         "State.Name.eq=%s,State.Ppid.ne=%d",
+	         state.name, (int)state.ppid);
+	assert(SIGAR_OK != ptql_match(t, ptql, self));
+
+	/* the parent's State next to the pid's own */
+	snprintf(ptql, sizeof(ptql),
+	         "State.Name.Peq=%s,State.Ppid.eq=%d,State.Name.eq=%s",
+	         pstate.name, (int)state.ppid, state.name);
+	assert(SIGAR_OK == ptql_match(t, ptql, self));
+
+	snprintf(ptql, sizeof(ptql),
+	         "State.Ppid.Peq=%d", (int)pstate.ppid);
+	assert(SIGAR_OK == ptql_match(t, ptql, self));
+
+	if (SIGAR_OK == sigar_proc_cgroup_get(t, self, &cgroup)) {
+		snprintf(ptql, sizeof(ptql), "Cgroup.Path.sw=%s", cgroup.path);
+		assert(SIGAR_OK == ptql_match(t, ptql, self));
+		snprintf(ptql, sizeof(ptql), "Cgroup.Path.eq=%s/no/such", cgroup.path);
+		assert(SIGAR_OK != ptql_match(t, ptql, self));
+	}
+
+	return 0;
+}
+
+TEST(test_sigar_ptql_query_str) {
+	sigar_pid_t self = sigar_pid_get(t);
+	sigar_proc_state_t state;
+	char ptql[512], upper[SIGAR_PROC_NAME_LEN];
+	size_t i, len;
+
+	assert(SIGAR_OK == sigar_proc_state_get(t, self, &state));
+	len = strlen(state.name);
+	assert(len > 2);
+	for (i = 0; i <= len; i++) {
+		upper[i] = toupper((unsigned char)state.name[i]);
+	}
+
+	snprintf(ptql, sizeof(ptql), "State.Name.sw=%.2s", state.name);
+	assert(SIGAR_OK == ptql_match(t, ptql, self));
+	snprintf(ptql, sizeof(ptql), "State.Name.ew=%s", state.name + len - 2);
+	assert(SIGAR_OK == ptql_match(t, ptql, self));
+	snprintf(ptql, sizeof(ptql), "State.Name.ct=%.2s", state.name + 1);
+	assert(SIGAR_OK == ptql_match(t, ptql, self));
+	snprintf(ptql, sizeof(ptql), "State.Name.ct=%.1s", state.name + 1);
+	assert(SIGAR_OK == ptql_match(t, ptql, self));
+	snprintf(ptql, sizeof(ptql), "State.Name.ne=%s", state.name);
+	assert(SIGAR_OK != ptql_match(t, ptql, self));
+
+	/* needle longer than the haystack */
+	snprintf(ptql, sizeof(ptql), "State.Name.ew=x%s", state.name);
+	assert(SIGAR_OK != ptql_match(t, ptql, self));
+	snprintf(ptql, sizeof(ptql), "State.Name.sw=%sx", state.name);
+	assert(SIGAR_OK != ptql_match(t, ptql, self));
+	snprintf(ptql, sizeof(ptql), "State.Name.ct=%s%s", state.name, state.name);
+	assert(SIGAR_OK != ptql_match(t, ptql, self));
+
+	if (strcmp(upper, state.name) != 0) {
+		snprintf(ptql, sizeof(ptql), "State.Name.eq=%s", upper);
+		assert(SIGAR_OK != ptql_match(t, ptql, self));
+		snprintf(ptql, sizeof(ptql), "State.Name.Ieq=%s", upper);
+		assert(SIGAR_OK == ptql_match(t, ptql, self));
+		snprintf(ptql, sizeof(ptql), "State.Name.Isw=%.2s", upper);
+		assert(SIGAR_OK == ptql_match(t, ptql, self));
+		snprintf(ptql, sizeof(ptql), "State.Name.Iew=%s", upper + len - 2);
+		assert(SIGAR_OK == ptql_match(t, ptql, self));
+		snprintf(ptql, sizeof(ptql), "State.Name.Ict=%s", upper + 1);
+		assert(SIGAR_OK == ptql_match(t, ptql, self));
+		snprintf(ptql, sizeof(ptql), "State.Name.Ict=%sx", upper + 1);
+		assert(SIGAR_OK != ptql_match(t, ptql, self));
+	}
+
+	return 0;
+}
+
+TEST(test_sigar_ptql_query_reuse) {
+	sigar_ptql_query_t *query;
+	sigar_ptql_error_t error;
+	sigar_pid_t self = sigar_pid_get(t);
+	sigar_proc_state_t state;
+	char ptql[512];
+
+	assert(SIGAR_OK == sigar_proc_state_get(t, self, &state));
+
+	snprintf(ptql, sizeof(ptql), "State.Ppid.eq=%d,State.Name.eq=%s",
+	         (int)state.ppid, state.name);
+	assert(SIGAR_OK == sigar_ptql_query_create(&query, ptql, &error));
+
+	/* fetched data is per match, never carried over to the next pid */
+	assert(SIGAR_OK == sigar_ptql_query_match(t, query, self));
+	assert(SIGAR_OK != sigar_ptql_query_match(t, query, state.ppid));
+	assert(SIGAR_OK == sigar_ptql_query_match(t, query, self));
+
+	sigar_ptql_query_destroy(query);
+
+	snprintf(ptql, sizeof(ptql), "State.Bogus.eq=1");
+	assert(SIGAR_OK != sigar_ptql_query_create(&query, ptql, &error));
+
+	return 0;
+}
+
+static int proc_list_has(sigar_proc_list_t *proclist, sigar_pid_t pid) {
+	unsigned long i;
+
+	for (i = 0; i < proclist->number; i++) {
+		if (proclist->data[i] == pid) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+TEST(test_sigar_ptql_query_cache) {
+	sigar_ptql_query_t *query;
+	sigar_ptql_error_t error;
+	sigar_proc_list_t proclist;
+	sigar_pid_t self = sigar_pid_get(t);
+	sigar_proc_state_t state;
+	char ptql[512];
+	int i;
+#ifndef WIN32
+	int fds[2];
+	pid_t child;
+	char c;
+#endif
+
+	assert(SIGAR_OK == sigar_proc_state_get(t, self, &state));
+	assert(SIGAR_OK == sigar_ptql_cache_set(t, 1));
+
+	/* State.Name is cached, State.State is matched every time */
+	snprintf(ptql, sizeof(ptql), "State.Name.eq=%s", state.name);
+	assert(SIGAR_OK == sigar_ptql_query_create(&query, ptql, &error));
+	for (i = 0; i < 3; i++) {
+		assert(SIGAR_OK == sigar_ptql_query_find(t, query, &proclist));
+		assert(proc_list_has(&proclist, self));
+		sigar_proc_list_destroy(t, &proclist);
+	}
+	sigar_ptql_query_destroy(query);
+
+	snprintf(ptql, sizeof(ptql), "State.Name.eq=%s,State.State.ne=Z",
+	         state.name);
+	assert(SIGAR_OK == sigar_ptql_query_create(&query, ptql, &error));
+	for (i = 0; i < 2; i++) {
+		assert(SIGAR_OK == sigar_ptql_query_find(t, query, &proclist));
+		assert(proc_list_has(&proclist, self));
+		sigar_proc_list_destroy(t, &proclist);
+	}
+	sigar_ptql_query_destroy(query);
+
+	snprintf(ptql, sizeof(ptql), "State.Name.ne=%s", state.name);
+	assert(SIGAR_OK == sigar_ptql_query_create(&query, ptql, &error));
+	for (i = 0; i < 3; i++) {
+		assert(SIGAR_OK == sigar_ptql_query_find(t, query, &proclist));
+		assert(!proc_list_has(&proclist, self));
+		sigar_proc_list_destroy(t, &proclist);
+	}
+	sigar_ptql_query_destroy(query);
+
+#ifndef WIN32
+	/* a child settled before its exec is matched again after it */
+	assert(0 == pipe(fds));
+	if ((child = fork()) == 0) {
+		close(fds[1]);
+		if (read(fds[0], &c, 1) < 0) {
+			_exit(1);
+		}
+		execlp("sleep", "sleep", "10", (char *)NULL);
+		_exit(1);
+	}
+	assert(child > 0);
+	close(fds[0]);
+
+	assert(SIGAR_OK == sigar_ptql_query_create(&query,
+	                                           "Args.0.eq=sleep",
+	                                           &error));
+	for (i = 0; i < 3; i++) {
+		assert(SIGAR_OK == sigar_ptql_query_find(t, query, &proclist));
+		assert(!proc_list_has(&proclist, child));
+		sigar_proc_list_destroy(t, &proclist);
+	}
+
+	close(fds[1]);
+	for (i = 0; i < 50; i++) {
+		int found;
+
+		usleep(100 * 1000);
+		assert(SIGAR_OK == sigar_ptql_query_find(t, query, &proclist));
+		found = proc_list_has(&proclist, child);
+		sigar_proc_list_destroy(t, &proclist);
+		if (found) {
+			break;
+		}
+	}
+	assert(i < 50);
+	sigar_ptql_query_destroy(query);
+
+	kill(child, SIGKILL);
+	assert(child == waitpid(child, NULL, 0));
+#endif
+
+	assert(SIGAR_OK == sigar_ptql_cache_set(t, 0));
+
+	return 0;
+}
+
+/* single pid results, tested with and without the name index */
+static int ptql_find_count(sigar_t *t, const char *ptql, sigar_pid_t pid) {
+	sigar_ptql_query_t *query;
+	sigar_ptql_error_t error;
+	sigar_proc_list_t proclist;
+	char buf[SIGAR_PATH_MAX+64];
+	int found;
+
+	snprintf(buf, sizeof(buf), "%s", ptql);
+	assert(SIGAR_OK == sigar_ptql_query_create(&query, buf, &error));
+	assert(SIGAR_OK == sigar_ptql_query_find(t, query, &proclist));
+	found = proc_list_has(&proclist, pid) ? (int)proclist.number : -1;
+	sigar_proc_list_destroy(t, &proclist);
+	sigar_ptql_query_destroy(query);
+
+	return found;
+}
+
+TEST(test_sigar_ptql_query_names) {
+	sigar_pid_t self = sigar_pid_get(t);
+	sigar_proc_state_t state;
+	sigar_proc_exe_t exe;
+	char ptql[SIGAR_PATH_MAX+32], upper[SIGAR_PROC_NAME_LEN];
+	int i, exe_ok;
+#ifndef WIN32
+	int fds[2];
+	pid_t child;
+	char c;
+#endif
+
+	assert(SIGAR_OK == sigar_proc_state_get(t, self, &state));
+	exe_ok = (sigar_proc_exe_get(t, self, &exe) == SIGAR_OK);
+	for (i = 0; state.name[i]; i++) {
+		upper[i] = toupper((unsigned char)state.name[i]);
+	}
+	upper[i] = '\0';
+
+	assert(SIGAR_OK == sigar_ptql_cache_set(t, 1));
+
+	for (i = 0; i < 3; i++) {
+		snprintf(ptql, sizeof(ptql), "State.Name.eq=%s", state.name);
+		assert(ptql_find_count(t, ptql, self) == 1);
+		snprintf(ptql, sizeof(ptql), "State.Name.Ieq=%s", upper);
+		assert(ptql_find_count(t, ptql, self) == 1);
+		snprintf(ptql, sizeof(ptql), "State.Name.eq=%s", upper);
+		assert(ptql_find_count(t, ptql, self) == -1);
+		snprintf(ptql, sizeof(ptql), "State.Name.eq=%s,Pid.Pid.ne=$$",
+		         state.name);
+		assert(ptql_find_count(t, ptql, self) == -1);
+		if (exe_ok) {
+			snprintf(ptql, sizeof(ptql), "Exe.Name.eq=%s", exe.name);
+			assert(ptql_find_count(t, ptql, self) == 1);
+		}
+	}
+
+#ifndef WIN32
+	/* a fork shows up under the same name and goes once reaped */
+	assert(0 == pipe(fds));
+	if ((child = fork()) == 0) {
+		close(fds[1]);
+		if (read(fds[0], &c, 1) < 0) {
+			_exit(1);
+		}
+		_exit(0);
+	}
+	assert(child > 0);
+	close(fds[0]);
+
+	snprintf(ptql, sizeof(ptql), "State.Name.eq=%s", state.name);
+	assert(ptql_find_count(t, ptql, child) == 2);
+	assert(ptql_find_count(t, ptql, self) == 2);
+
+	close(fds[1]);
+	assert(child == waitpid(child, NULL, 0));
+	assert(ptql_find_count(t, ptql, self) == 1);
+
+	/* and is indexed under its new name once it execs */
+	assert(0 == pipe(fds));
+	if ((child = fork()) == 0) {
+		close(fds[1]);
+		if (read(fds[0], &c, 1) < 0) {
+			_exit(1);
+		}
+		execlp("sleep", "sleep", "10", (char *)NULL);
+		_exit(1);
+	}
+	assert(child > 0);
+	close(fds[0]);
+
+	for (i = 0; i < 3; i++) {
+		assert(ptql_find_count(t, "State.Name.eq=sleep", child) == -1);
+	}
+	close(fds[1]);
+	for (i = 0; i < 50; i++) {
+		usleep(100 * 1000);
+		if (ptql_find_count(t, "State.Name.eq=sleep", child) > 0) {
+			break;
+		}
+	}
+	assert(i < 50);
+	assert(ptql_find_count(t, ptql, child) == -1);
+
+	kill(child, SIGKILL);
+	assert(child == waitpid(child, NULL, 0));
+#endif
+
+	assert(SIGAR_OK == sigar_ptql_cache_set(t, 0));
+
+	snprintf(ptql, sizeof(ptql), "State.Name.eq=%s", state.name);
+	assert(ptql_find_count(t, ptql, self) == 1);
+
+	return 0;
+}
+
+TEST(test_sigar_ptql_query_set) {
+	sigar_ptql_query_set_t *set;
+	sigar_ptql_query_t *queries[5];
+	sigar_ptql_error_t error;
+	sigar_proc_list_t proclists[5];
+	sigar_pid_t self = sigar_pid_get(t);
+	sigar_proc_state_t state;
+	char ptql[5][512];
+	int i, j, threads;
+
+	assert(SIGAR_OK == sigar_proc_state_get(t, self, &state));
+
+	/* the first three share State.Name.eq */
+	snprintf(ptql[0], sizeof(ptql[0]), "State.Name.eq=%s", state.name);
+	snprintf(ptql[1], sizeof(ptql[1]), "State.Name.eq=%s,Args.0.ct=%s",
+	         state.name, state.name);
+	snprintf(ptql[2], sizeof(ptql[2]),
+	         "State.Name.eq=%s,Args.*.ct=%s,State.Ppid.eq=%d",
+	         state.name, state.name, (int)state.ppid);
+	snprintf(ptql[3], sizeof(ptql[3]), "State.Name.ne=%s", state.name);
+	snprintf(ptql[4], sizeof(ptql[4]), "Pid.Pid.eq=%d", (int)self);
+
+	assert(SIGAR_OK == sigar_ptql_query_set_create(&set));
+	for (i = 0; i < 5; i++) {
+		assert(SIGAR_OK ==
+		       sigar_ptql_query_create(&queries[i], ptql[i], &error));
+		assert(SIGAR_OK == sigar_ptql_query_set_add(set, queries[i]));
+	}
+
+	/* serial, then split across workers */
+	for (threads = 1; threads <= 4; threads += 3) {
+		assert(SIGAR_OK == sigar_proc_scan_threads_set(t, threads));
+
+		for (j = 0; j < 2; j++) {
+			assert(SIGAR_OK ==
+			       sigar_ptql_query_set_find(t, set, proclists));
+
+			assert(proc_list_has(&proclists[0], self));
+			assert(proc_list_has(&proclists[1], self));
+			assert(proc_list_has(&proclists[2], self));
+			assert(!proc_list_has(&proclists[3], self));
+			assert(proclists[4].number == 1);
+			assert(proclists[4].data[0] == self);
+
+			/* a process can't be in both a query and its negation */
+			for (i = 0; i < proclists[0].number; i++) {
+				assert(!proc_list_has(&proclists[3],
+				                      proclists[0].data[i]));
+			}
+
+			for (i = 0; i < 5; i++) {
+				sigar_proc_list_destroy(t, &proclists[i]);
+			}
+		}
+	}
+	assert(SIGAR_OK == sigar_proc_scan_threads_set(t, 0));
+
+	sigar_ptql_query_set_destroy(set);
+	for (i = 0; i < 5; i++) {
+		sigar_ptql_query_destroy(queries[i]);
+	}
+
+	return 0;
+}
+
+/* Cpu.Percent is against the caller's history, split across workers or not */
+TEST(test_sigar_ptql_query_cpu_parallel) {
+#ifndef WIN32
+	sigar_ptql_query_set_t *set;
+	sigar_ptql_query_t *query;
+	sigar_ptql_error_t error;
+	sigar_proc_list_t proclist;
+	pid_t self = getpid(), spinner, idle[64];
+	int fds[2], i, threads;
+	char c;
+
+	/* enough pids for every worker to get a slice */
+	assert(0 == pipe(fds));
+	for (i = 0; i < 64; i++) {
+		if ((idle[i] = fork()) == 0) {
+			close(fds[1]);
+			if (read(fds[0], &c, 1) < 0) {
+				_exit(1);
+			}
+			_exit(0);
+		}
+		assert(idle[i] > 0);
+	}
+	close(fds[0]);
+	if ((spinner = fork()) == 0) {
+		close(fds[1]);
+		while (getppid() == self) {
+		}
+		_exit(0);
+	}
+	assert(spinner > 0);
+
+	assert(SIGAR_OK == sigar_proc_cache_expire_set(t, 0));
+	assert(SIGAR_OK ==
+	       sigar_ptql_query_create(&query, "Cpu.Percent.gt=0.2", &error));
+	assert(SIGAR_OK == sigar_ptql_query_set_create(&set));
+	assert(SIGAR_OK == sigar_ptql_query_set_add(set, query));
+	usleep(100 * 1000);
+
+	for (threads = 1; threads <= 4; threads += 3) {
+		assert(SIGAR_OK == sigar_proc_scan_threads_set(t, threads));
+
+		assert(SIGAR_OK == sigar_ptql_query_find(t, query, &proclist));
+		sigar_proc_list_destroy(t, &proclist);
+		usleep(300 * 1000);
+		assert(SIGAR_OK == sigar_ptql_query_find(t, query, &proclist));
+		assert(proc_list_has(&proclist, spinner));
+		sigar_proc_list_destroy(t, &proclist);
+
+		usleep(300 * 1000);
+		assert(SIGAR_OK == sigar_ptql_query_set_find(t, set, &proclist));
+		assert(proc_list_has(&proclist, spinner));
+		sigar_proc_list_destroy(t, &proclist);
+	}
+	assert(SIGAR_OK == sigar_proc_scan_threads_set(t, 0));
+
+	sigar_ptql_query_set_destroy(set);
+	sigar_ptql_query_destroy(query);
+
+	kill(spinner, SIGKILL);
+	assert(spinner == waitpid(spinner, NULL, 0));
+	close(fds[1]);
+	for (i = 0; i < 64; i++) {
+		assert(idle[i] == waitpid(idle[i], NULL, 0));
+	}
+#endif
+
+	return 0;
+}
+
+TEST(test_sigar_ptql_query_aggregate) {
+	sigar_ptql_query_t *query;
+	sigar_ptql_error_t error;
+	sigar_ptql_aggregate_t agg;
+	sigar_proc_mem_t mem;
+	sigar_pid_t self = sigar_pid_get(t);
+	char ptql[512];
+
+	snprintf(ptql, sizeof(ptql), "Pid.Pid.eq=%d", (int)self);
+	assert(SIGAR_OK == sigar_ptql_query_create(&query, ptql, &error));
+
+	assert(SIGAR_OK == sigar_ptql_query_aggregate(t, query,
+	                                              SIGAR_AGG_CPU |
+	                                              SIGAR_AGG_MEM,
+	                                              &agg));
+	assert(agg.processes == 1);
+	assert(agg.cpu.total == agg.cpu.user + agg.cpu.sys);
+	assert(SIGAR_OK == sigar_proc_mem_get(t, self, &mem));
+	assert(agg.mem.size > 0);
+	assert(agg.mem.resident > 0);
+
+	/* only what was asked for is summed */
+	assert(SIGAR_OK == sigar_ptql_query_aggregate(t, query,
+	                                              SIGAR_AGG_CPU, &agg));
+	assert(agg.processes == 1);
+	assert(agg.mem.size == 0);
+
+	sigar_ptql_query_destroy(query);
+
+	return 0;
+}
+
+int main() {
+	sigar_t *t;
+	int err = 0;
+
+	assert(SIGAR_OK == sigar_open(&t));
+
+	test_sigar_ptql_query_match(t);
+	test_sigar_ptql_query_str(t);
+	test_sigar_ptql_query_reuse(t);
+	test_sigar_ptql_query_cache(t);
+	test_sigar_ptql_query_names(t);
+	test_sigar_ptql_query_set(t);
+	test_sigar_ptql_query_cpu_parallel(t);
+	test_sigar_ptql_query_aggregate(t);
+
+	sigar_close(t);
+
+	return err ? -1 : 0;
+}
@@ -0,0 +1,208 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#ifndef WIN32
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "sigar.h"
+#include "sigar_remote.h"
+#include "sigar_tests.h"
+
+#ifndef WIN32
+static pid_t remote_server(int *fd) {
+	int fds[2];
+	pid_t pid;
+
+	assert(0 == socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+
+	if ((pid = fork()) == 0) {
+		sigar_t *sigar;
+		int status;
+
+		close(fds[0]);
+		assert(SIGAR_OK == sigar_open(&sigar));
+		status = sigar_remote_serve(sigar, fds[1]);
+		sigar_close(sigar);
+		_exit(status == SIGAR_OK ? 0 : 1);
+	}
+	assert(pid > 0);
+
+	close(fds[1]);
+	*fd = fds[0];
+
+	return pid;
+}
+
+static void remote_batch_check(sigar_t *t, sigar_remote_response_t *response) {
+	sigar_remote_result_t *result = response->data;
+	sigar_mem_t mem;
+	sigar_cpu_list_t cpulist;
+	unsigned long i;
+	int found = 0;
+
+	assert(response->number == 8);
+
+	assert(result[0].type == SIGAR_REMOTE_CPU);
+	assert(result[0].status == SIGAR_OK);
+	assert(result[0].value.cpu.total > 0);
+
+	assert(SIGAR_OK == sigar_mem_get(t, &mem));
+	assert(result[1].type == SIGAR_REMOTE_MEM);
+	assert(result[1].status == SIGAR_OK);
+	assert(result[1].value.mem.total == mem.total);
+	assert(result[1].value.mem.used_percent > 0);
+
+	assert(result[2].status == SIGAR_OK);
+	assert(result[2].value.uptime.uptime > 0);
+
+	assert(SIGAR_OK == sigar_cpu_list_get(t, &cpulist));
+	assert(result[3].type == SIGAR_REMOTE_CPU_LIST);
+	assert(result[3].status == SIGAR_OK);
+	assert(result[3].value.cpulist.number == cpulist.number);
+	assert(result[3].value.cpulist.data[0].total > 0);
+	assert(SIGAR_OK == sigar_cpu_list_destroy(t, &cpulist));
+
+	assert(result[4].type == SIGAR_REMOTE_PTQL_FIND);
+	assert(result[4].status == SIGAR_OK);
+	for (i = 0; i < result[4].value.proclist.number; i++) {
+		if (result[4].value.proclist.data[i] == getpid()) {
+			found = 1;
+		}
+	}
+	assert(found);
+
+	assert(result[5].type == SIGAR_REMOTE_FS_USAGE);
+	if (result[5].status == SIGAR_OK) {
+		assert(result[5].value.fsusage.total > 0);
+	}
+
+	/* no interface name, a type the server does not know */
+	assert(result[6].status == EINVAL);
+	assert(result[7].type == 99);
+	assert(result[7].status == SIGAR_ENOTIMPL);
+}
+
+TEST(test_sigar_remote_batch) {
+	sigar_remote_request_t batch, snap;
+	sigar_remote_response_t response;
+	sigar_remote_t *remote;
+	sigar_uint32_t ids[3];
+	char ptql[64];
+	unsigned long i;
+	int fd, status, found = 0;
+	pid_t pid = remote_server(&fd);
+
+	snprintf(ptql, sizeof(ptql), "Pid.Pid.eq=%d", (int)getpid());
+
+	assert(SIGAR_OK == sigar_remote_request_create(&batch));
+	assert(SIGAR_OK == sigar_remote_request_add(&batch, SIGAR_REMOTE_CPU, NULL, 0));
+	assert(SIGAR_OK == sigar_remote_request_add(&batch, SIGAR_REMOTE_MEM, NULL, 0));
+	assert(SIGAR_OK == sigar_remote_request_add(&batch, SIGAR_REMOTE_UPTIME, NULL, 0));
+	assert(SIGAR_OK == sigar_remote_request_add(&batch, SIGAR_REMOTE_CPU_LIST, NULL, 0));
+	assert(SIGAR_OK == sigar_remote_request_add(&batch, SIGAR_REMOTE_PTQL_FIND, ptql, 0));
+	assert(SIGAR_OK == sigar_remote_request_add(&batch, SIGAR_REMOTE_FS_USAGE, "/", 0));
+	assert(SIGAR_OK == sigar_remote_request_add(&batch, SIGAR_REMOTE_NETIF_STAT, NULL, 0));
+	assert(SIGAR_OK == sigar_remote_request_add(&batch, 99, NULL, 0));
+
+	assert(SIGAR_OK == sigar_remote_request_create(&snap));
+	assert(SIGAR_OK == sigar_remote_request_add(&snap, SIGAR_REMOTE_SNAPSHOT, NULL,
+	                                            SIGAR_SNAPSHOT_PROC));
+
+	assert(SIGAR_OK == sigar_remote_fdopen(&remote, fd));
+
+	/* all three out before the first answer is read */
+	assert(SIGAR_OK == sigar_remote_send(remote, &batch, &ids[0]));
+	assert(SIGAR_OK == sigar_remote_send(remote, &snap, &ids[1]));
+	assert(SIGAR_OK == sigar_remote_send(remote, &batch, &ids[2]));
+	assert(ids[0] != ids[1] && ids[1] != ids[2]);
+
+	assert(SIGAR_OK == sigar_remote_recv(remote, &response));
+	assert(response.id == ids[0]);
+	remote_batch_check(t, &response);
+	assert(SIGAR_OK == sigar_remote_response_destroy(&response));
+
+	assert(SIGAR_OK == sigar_remote_recv(remote, &response));
+	assert(response.id == ids[1]);
+	assert(response.number == 1);
+	assert(response.data[0].status == SIGAR_OK);
+	assert(response.data[0].value.snapshot.flags & SIGAR_SNAPSHOT_PROC);
+	assert(response.data[0].value.snapshot.timestamp > 0);
+	for (i = 0; i < response.data[0].value.snapshot.procs.number; i++) {
+		if (response.data[0].value.snapshot.procs.data[i].pid == getpid()) {
+			found = 1;
+		}
+	}
+	assert(found);
+	assert(SIGAR_OK == sigar_remote_response_destroy(&response));
+
+	assert(SIGAR_OK == sigar_remote_recv(remote, &response));
+	assert(response.id == ids[2]);
+	remote_batch_check(t, &response);
+	assert(SIGAR_OK == sigar_remote_response_destroy(&response));
+
+	/* closing is the end of the conversation, not an error */
+	assert(SIGAR_OK == sigar_remote_close(remote));
+	assert(pid == waitpid(pid, &status, 0));
+	assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+	assert(SIGAR_OK == sigar_remote_request_destroy(&batch));
+	assert(SIGAR_OK == sigar_remote_request_destroy(&snap));
+
+	return 0;
+}
+
+/* garbage is refused by the server, not answered */
+TEST(test_sigar_remote_malformed) {
+	sigar_remote_response_t response;
+	sigar_remote_t *remote;
+	int fd, status;
+	pid_t pid = remote_server(&fd);
+
+	assert(12 == write(fd, "GET / HTTP/1", 12));
+
+	assert(SIGAR_OK == sigar_remote_fdopen(&remote, fd));
+	assert(SIGAR_OK != sigar_remote_recv(remote, &response));
+	assert(SIGAR_OK == sigar_remote_close(remote));
+
+	assert(pid == waitpid(pid, &status, 0));
+	assert(WIFEXITED(status) && WEXITSTATUS(status) == 1);
+
+	return 0;
+}
+#endif
+
+int main() {
+	sigar_t *t;
+	int err = 0;
+
+	assert(SIGAR_OK == sigar_open(&t));
+
+#ifndef WIN32
+	test_sigar_remote_batch(t);
+	test_sigar_remote_malformed(t);
+#endif
+
+	sigar_close(t);
+
+	return err ? -1 : 0;
+}
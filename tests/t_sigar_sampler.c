@@ -0,0 +1,639 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#ifndef WIN32
+#include <pthread.h>
+#endif
+
+#include "sigar.h"
+#include "sigar_sampler.h"
+#include "sigar_rules.h"
+#include "sigar_tests.h"
+
+#define INTERVAL 20
+
+TEST(test_sigar_sampler_snapshot) {
+	sigar_sampler_t *sampler;
+	sigar_sampler_snapshot_t *snapshot, *next;
+	sigar_uint64_t generation;
+
+	assert(SIGAR_OK == sigar_sampler_create(&sampler,
+	                                        SIGAR_SAMPLER_MEM |
+	                                        SIGAR_SAMPLER_CPU_LIST |
+	                                        SIGAR_SAMPLER_PROC,
+	                                        INTERVAL));
+	assert(NULL == sigar_sampler_snapshot_acquire(sampler));
+
+	assert(SIGAR_OK == sigar_sampler_proc_flags_set(sampler,
+	                                                SIGAR_PROC_SNAPSHOT_STATE));
+	assert(SIGAR_OK == sigar_sampler_start(sampler));
+	/* only before start */
+	assert(SIGAR_OK != sigar_sampler_proc_flags_set(sampler,
+	                                                SIGAR_PROC_SNAPSHOT_ALL));
+
+	/* the first round is in place once start returns */
+	snapshot = sigar_sampler_snapshot_acquire(sampler);
+	assert(snapshot != NULL);
+	assert(snapshot->generation >= 1);
+	assert(snapshot->flags & SIGAR_SAMPLER_MEM);
+	assert(snapshot->mem.total > 0);
+	assert(!(snapshot->flags & SIGAR_SAMPLER_SWAP));
+	if (snapshot->flags & SIGAR_SAMPLER_CPU_LIST) {
+		assert(snapshot->cpulist.number > 0);
+	}
+	if (snapshot->flags & SIGAR_SAMPLER_PROC) {
+		assert(snapshot->procs.number > 0);
+		assert(snapshot->procs.data[0].flags == SIGAR_PROC_SNAPSHOT_STATE);
+	}
+	generation = snapshot->generation;
+
+	assert(SIGAR_OK == sigar_sampler_wait(sampler, generation, 5000));
+	next = sigar_sampler_snapshot_acquire(sampler);
+	assert(next != NULL);
+	assert(next != snapshot);
+	assert(next->generation > generation);
+	/* a held snapshot is never refilled under its reader */
+	assert(snapshot->generation == generation);
+	assert(snapshot->mem.total > 0);
+
+	sigar_sampler_snapshot_release(sampler, next);
+	sigar_sampler_snapshot_release(sampler, snapshot);
+
+	assert(SIGAR_OK == sigar_sampler_stop(sampler));
+	snapshot = sigar_sampler_snapshot_acquire(sampler);
+	assert(snapshot != NULL);
+	generation = snapshot->generation;
+	sigar_sampler_snapshot_release(sampler, snapshot);
+	/* nothing more is published once stopped */
+	assert(ETIMEDOUT == sigar_sampler_wait(sampler, generation, INTERVAL * 3));
+
+	assert(SIGAR_OK == sigar_sampler_destroy(sampler));
+
+	return 0;
+}
+
+TEST(test_sigar_sampler_shm) {
+	sigar_sampler_t *sampler, *small;
+	sigar_shm_t *shm, *small_shm;
+	sigar_sampler_snapshot_t snapshot;
+	sigar_uint64_t generation;
+	char name[64], small_name[64];
+
+	snprintf(name, sizeof(name), "sigar-test-%lu",
+	         (unsigned long)sigar_pid_get(t));
+	snprintf(small_name, sizeof(small_name), "sigar-test-small-%lu",
+	         (unsigned long)sigar_pid_get(t));
+
+	assert(SIGAR_OK != sigar_shm_attach(&shm, name));
+
+	assert(SIGAR_OK == sigar_sampler_create(&sampler,
+	                                        SIGAR_SAMPLER_MEM |
+	                                        SIGAR_SAMPLER_CPU_LIST |
+	                                        SIGAR_SAMPLER_PROC,
+	                                        INTERVAL));
+	assert(SIGAR_OK == sigar_sampler_proc_flags_set(sampler,
+	                                                SIGAR_PROC_SNAPSHOT_STATE));
+	assert(SIGAR_OK == sigar_sampler_shm_set(sampler, name, 0));
+
+	/* the segment exists before the first round is published */
+	assert(SIGAR_OK == sigar_shm_attach(&shm, name));
+	assert(ENOENT == sigar_shm_snapshot_get(shm, &snapshot));
+
+	assert(SIGAR_OK == sigar_sampler_start(sampler));
+	/* only before start */
+	assert(SIGAR_OK != sigar_sampler_shm_set(sampler, NULL, 0));
+
+	assert(SIGAR_OK == sigar_shm_snapshot_get(shm, &snapshot));
+	assert(snapshot.generation >= 1);
+	assert(snapshot.flags & SIGAR_SAMPLER_MEM);
+	assert(snapshot.mem.total > 0);
+	if (snapshot.flags & SIGAR_SAMPLER_CPU_LIST) {
+		assert(snapshot.cpulist.number > 0);
+	}
+	if (snapshot.flags & SIGAR_SAMPLER_PROC) {
+		assert(snapshot.procs.number > 0);
+		assert(snapshot.procs.data[0].flags == SIGAR_PROC_SNAPSHOT_STATE);
+	}
+	generation = snapshot.generation;
+	assert(SIGAR_OK == sigar_shm_snapshot_destroy(shm, &snapshot));
+
+	assert(SIGAR_OK == sigar_sampler_wait(sampler, generation, 5000));
+	assert(SIGAR_OK == sigar_shm_snapshot_get(shm, &snapshot));
+	assert(snapshot.generation > generation);
+	assert(SIGAR_OK == sigar_shm_snapshot_destroy(shm, &snapshot));
+
+	/* a process list that does not fit is left out, the rest is not */
+	assert(SIGAR_OK == sigar_sampler_create(&small,
+	                                        SIGAR_SAMPLER_MEM |
+	                                        SIGAR_SAMPLER_PROC,
+	                                        INTERVAL));
+	assert(SIGAR_OK == sigar_sampler_shm_set(small, small_name, 1024));
+	assert(SIGAR_OK == sigar_sampler_start(small));
+	assert(SIGAR_OK == sigar_shm_attach(&small_shm, small_name));
+	assert(SIGAR_OK == sigar_shm_snapshot_get(small_shm, &snapshot));
+	assert(snapshot.flags & SIGAR_SAMPLER_MEM);
+	assert(!(snapshot.flags & SIGAR_SAMPLER_PROC));
+	assert(snapshot.procs.number == 0);
+	assert(SIGAR_OK == sigar_shm_snapshot_destroy(small_shm, &snapshot));
+	assert(SIGAR_OK == sigar_shm_detach(small_shm));
+	assert(SIGAR_OK == sigar_sampler_destroy(small));
+
+	assert(SIGAR_OK == sigar_sampler_destroy(sampler));
+
+	/* the last round stays readable for those still attached */
+	assert(SIGAR_OK == sigar_shm_snapshot_get(shm, &snapshot));
+	assert(snapshot.mem.total > 0);
+	assert(SIGAR_OK == sigar_shm_snapshot_destroy(shm, &snapshot));
+	assert(SIGAR_OK == sigar_shm_detach(shm));
+
+	assert(SIGAR_OK != sigar_shm_attach(&shm, name));
+
+	return 0;
+}
+
+#ifndef WIN32
+#define READERS 4
+
+static void *sampler_reader(void *data) {
+	sigar_sampler_t *sampler = data;
+	sigar_uint64_t last = 0;
+	int i;
+
+	for (i = 0; i < 20000; i++) {
+		sigar_sampler_snapshot_t *snapshot =
+			sigar_sampler_snapshot_acquire(sampler);
+
+		assert(snapshot != NULL);
+		/* generations only ever move forward */
+		assert(snapshot->generation >= last);
+		assert(snapshot->flags & SIGAR_SAMPLER_MEM);
+		assert(snapshot->mem.total > 0);
+		last = snapshot->generation;
+		sigar_sampler_snapshot_release(sampler, snapshot);
+	}
+
+	return NULL;
+}
+
+TEST(test_sigar_sampler_readers) {
+	sigar_sampler_t *sampler;
+	pthread_t readers[READERS];
+	int i;
+
+	assert(SIGAR_OK == sigar_sampler_create(&sampler,
+	                                        SIGAR_SAMPLER_MEM |
+	                                        SIGAR_SAMPLER_CPU,
+	                                        1));
+	assert(SIGAR_OK == sigar_sampler_start(sampler));
+
+	for (i = 0; i < READERS; i++) {
+		assert(0 == pthread_create(&readers[i], NULL,
+		                           sampler_reader, sampler));
+	}
+	for (i = 0; i < READERS; i++) {
+		pthread_join(readers[i], NULL);
+	}
+
+	assert(SIGAR_OK == sigar_sampler_destroy(sampler));
+
+	return 0;
+}
+#endif
+
+TEST(test_sigar_tsdb) {
+	sigar_tsdb_opts_t opts;
+	sigar_tsdb_t *tsdb;
+	sigar_tsdb_range_t range;
+	sigar_sampler_snapshot_t snapshot;
+	sigar_net_interface_stat_entry_t ifaces[1];
+	int i;
+
+	memset(&opts, 0, sizeof(opts));
+	opts.ntiers = 2;
+	opts.tiers[0].step = 1;
+	opts.tiers[0].points = 4;
+	opts.tiers[1].step = 2;
+	opts.tiers[1].points = 3;
+	opts.ifaces_max = 1;
+	opts.disks_max = 0;
+	assert(SIGAR_OK == sigar_tsdb_create(&tsdb, &opts));
+
+	memset(&snapshot, 0, sizeof(snapshot));
+	memset(ifaces, 0, sizeof(ifaces));
+	strcpy(ifaces[0].name, "eth0");
+	snapshot.iflist.number = snapshot.iflist.size = 1;
+	snapshot.iflist.data = ifaces;
+
+	/* 6 rounds a second apart, mem going up by 10 every round */
+	for (i = 1; i <= 6; i++) {
+		snapshot.timestamp = i * 1000;
+		snapshot.flags = SIGAR_SAMPLER_MEM | SIGAR_SAMPLER_NETIF |
+			SIGAR_SAMPLER_CPU;
+		snapshot.mem.used = i * 10;
+		snapshot.cpu.user = i * 25;
+		snapshot.cpu.idle = i * 75;
+		snapshot.cpu.total = i * 100;
+		ifaces[0].stat.rx_bytes = i * 1000;
+		assert(SIGAR_OK == sigar_tsdb_add(tsdb, &snapshot));
+	}
+
+	/* the ring keeps the latest 4 */
+	assert(SIGAR_OK == sigar_tsdb_range_get(tsdb, 0, SIGAR_TSDB_MEM_USED,
+	                                        NULL, 0, 10000, &range));
+	assert(range.number == 4);
+	assert(range.timestamp[0] == 3000 && range.avg[0] == 30);
+	assert(range.timestamp[3] == 6000 && range.avg[3] == 60);
+	sigar_tsdb_range_destroy(&range);
+
+	/* pairs folded into min, max and avg */
+	assert(SIGAR_OK == sigar_tsdb_range_get(tsdb, 1, SIGAR_TSDB_MEM_USED,
+	                                        NULL, 0, 10000, &range));
+	assert(range.number == 3);
+	assert(range.min[0] == 10 && range.max[0] == 20 && range.avg[0] == 15);
+	assert(range.timestamp[2] == 6000 && range.avg[2] == 55);
+	sigar_tsdb_range_destroy(&range);
+
+	assert(SIGAR_OK == sigar_tsdb_range_get(tsdb, 1, SIGAR_TSDB_MEM_USED,
+	                                        NULL, 3000, 5000, &range));
+	assert(range.number == 1);
+	assert(range.timestamp[0] == 4000);
+	sigar_tsdb_range_destroy(&range);
+
+	/* rates and percents start with the second round */
+	assert(SIGAR_OK == sigar_tsdb_range_get(tsdb, 1, SIGAR_TSDB_NETIF_RX_BYTES,
+	                                        "eth0", 0, 10000, &range));
+	assert(range.number == 3);
+	assert(range.avg[0] == 1000);
+	sigar_tsdb_range_destroy(&range);
+
+	assert(SIGAR_OK == sigar_tsdb_range_get(tsdb, 0, SIGAR_TSDB_CPU_USER,
+	                                        NULL, 0, 10000, &range));
+	assert(range.number == 4);
+	assert(range.avg[0] == 25);
+	sigar_tsdb_range_destroy(&range);
+
+	/* no value for swap was ever added */
+	assert(SIGAR_OK == sigar_tsdb_range_get(tsdb, 0, SIGAR_TSDB_SWAP_USED,
+	                                        NULL, 0, 10000, &range));
+	assert(range.number == 0);
+	sigar_tsdb_range_destroy(&range);
+
+	assert(ENOENT == sigar_tsdb_range_get(tsdb, 0, SIGAR_TSDB_NETIF_TX_BYTES,
+	                                      "eth1", 0, 10000, &range));
+	assert(EINVAL == sigar_tsdb_range_get(tsdb, 2, SIGAR_TSDB_MEM_USED,
+	                                      NULL, 0, 10000, &range));
+	assert(EINVAL == sigar_tsdb_range_get(tsdb, 0, SIGAR_TSDB_SERIES_MAX,
+	                                      NULL, 0, 10000, &range));
+
+	assert(SIGAR_OK == sigar_tsdb_destroy(tsdb));
+
+	return 0;
+}
+
+TEST(test_sigar_sampler_tsdb) {
+	sigar_sampler_t *sampler;
+	sigar_sampler_snapshot_t *snapshot;
+	sigar_tsdb_range_t range;
+	sigar_uint64_t generation;
+
+	assert(SIGAR_OK == sigar_sampler_create(&sampler,
+	                                        SIGAR_SAMPLER_MEM |
+	                                        SIGAR_SAMPLER_CPU,
+	                                        INTERVAL));
+	assert(NULL == sigar_sampler_tsdb_get(sampler));
+	assert(SIGAR_OK == sigar_sampler_tsdb_set(sampler, NULL));
+	assert(SIGAR_OK == sigar_sampler_start(sampler));
+	assert(EBUSY == sigar_sampler_tsdb_set(sampler, NULL));
+
+	snapshot = sigar_sampler_snapshot_acquire(sampler);
+	generation = snapshot->generation;
+	sigar_sampler_snapshot_release(sampler, snapshot);
+	assert(SIGAR_OK == sigar_sampler_wait(sampler, generation + 1, 5000));
+
+	assert(SIGAR_OK == sigar_tsdb_range_get(sigar_sampler_tsdb_get(sampler),
+	                                        0, SIGAR_TSDB_MEM_USED, NULL,
+	                                        0, (sigar_int64_t)1 << 62,
+	                                        &range));
+	assert(range.number >= 2);
+	assert(range.avg[0] > 0);
+	assert(range.timestamp[0] < range.timestamp[1]);
+	sigar_tsdb_range_destroy(&range);
+
+	assert(SIGAR_OK == sigar_sampler_destroy(sampler));
+
+	return 0;
+}
+
+TEST(test_sigar_rules) {
+	sigar_rules_t *rules;
+	sigar_rule_event_list_t events;
+	sigar_sampler_snapshot_t snapshot;
+	sigar_net_interface_stat_entry_t ifentry;
+	sigar_ptql_error_t error;
+	int used, rx, tcp;
+
+	assert(SIGAR_OK == sigar_rules_create(&rules));
+	assert(SIGAR_OK == sigar_rules_add(rules, "Mem.Used.gt=1G", &used,
+	                                   &error));
+	assert(SIGAR_OK == sigar_rules_add(rules,
+	                                   "NetIf.RxBytes.ge=100,Name.eq=eth0",
+	                                   &rx, &error));
+	assert(SIGAR_OK == sigar_rules_add(rules, "Tcp.Listen.ge=0", &tcp,
+	                                   &error));
+	assert(used != rx && rx != tcp);
+
+	assert(SIGAR_PTQL_MALFORMED_QUERY ==
+	       sigar_rules_add(rules, "Mem.Bogus.gt=1", NULL, &error));
+	assert(SIGAR_PTQL_MALFORMED_QUERY ==
+	       sigar_rules_add(rules, "Mem.Used.like=1", NULL, &error));
+	assert(SIGAR_PTQL_MALFORMED_QUERY ==
+	       sigar_rules_add(rules, "Mem.Used.gt=1X", NULL, &error));
+	assert(SIGAR_PTQL_MALFORMED_QUERY ==
+	       sigar_rules_add(rules, "NetIf.RxBytes.gt=1", NULL, &error));
+	assert(SIGAR_PTQL_MALFORMED_QUERY ==
+	       sigar_rules_add(rules, "Proc.Rss.gt=1", NULL, &error));
+	assert(SIGAR_PTQL_MALFORMED_QUERY ==
+	       sigar_rules_add(rules, "Swap.Used.gt=1,Name.eq=x", NULL, &error));
+
+	memset(&snapshot, 0, sizeof(snapshot));
+	memset(&ifentry, 0, sizeof(ifentry));
+	strcpy(ifentry.name, "eth0");
+	snapshot.flags = SIGAR_SAMPLER_MEM | SIGAR_SAMPLER_NETIF;
+	snapshot.iflist.number = snapshot.iflist.size = 1;
+	snapshot.iflist.data = &ifentry;
+
+	/* below the threshold and no rate yet, no sigar for Tcp */
+	snapshot.timestamp = 1000;
+	snapshot.mem.used = 1024;
+	assert(SIGAR_OK == sigar_rules_eval(NULL, rules, &snapshot, &events));
+	assert(events.number == 0);
+	sigar_rule_event_list_destroy(&events);
+
+	snapshot.timestamp = 2000;
+	snapshot.mem.used = (sigar_uint64_t)2 << 30;
+	ifentry.stat.rx_bytes = 400;
+	assert(SIGAR_OK == sigar_rules_eval(NULL, rules, &snapshot, &events));
+	assert(events.number == 2);
+	assert(events.data[0].id == used && events.data[0].firing == 1);
+	assert(events.data[1].id == rx && events.data[1].firing == 1);
+	assert(events.data[1].value == 400);
+	assert(events.data[1].timestamp == 2000);
+	sigar_rule_event_list_destroy(&events);
+
+	/* still over, nothing changed */
+	snapshot.timestamp = 4000;
+	ifentry.stat.rx_bytes = 800;
+	assert(SIGAR_OK == sigar_rules_eval(NULL, rules, &snapshot, &events));
+	assert(events.number == 0);
+	sigar_rule_event_list_destroy(&events);
+
+	snapshot.timestamp = 5000;
+	snapshot.mem.used = 1024;
+	ifentry.stat.rx_bytes = 850;
+	assert(SIGAR_OK == sigar_rules_eval(NULL, rules, &snapshot, &events));
+	assert(events.number == 2);
+	assert(events.data[0].id == used && events.data[0].firing == 0);
+	assert(events.data[1].id == rx && events.data[1].firing == 0);
+	sigar_rule_event_list_destroy(&events);
+
+	/* Tcp needs a handle */
+	assert(SIGAR_OK == sigar_rules_eval(t, rules, &snapshot, &events));
+	if (events.number) {
+		assert(events.number == 1);
+		assert(events.data[0].id == tcp && events.data[0].firing == 1);
+	}
+	sigar_rule_event_list_destroy(&events);
+
+	assert(SIGAR_OK == sigar_rules_destroy(rules));
+
+	return 0;
+}
+
+TEST(test_sigar_sampler_rules) {
+	sigar_sampler_t *sampler;
+	sigar_sampler_snapshot_t *snapshot;
+	sigar_rules_t *rules;
+	sigar_rule_event_list_t events;
+	sigar_ptql_error_t error;
+	sigar_uint64_t generation;
+	int id;
+
+	assert(SIGAR_OK == sigar_rules_create(&rules));
+	assert(SIGAR_OK == sigar_rules_add(rules, "Mem.Used.gt=0", &id, &error));
+	assert(SIGAR_OK == sigar_rules_add(rules,
+	                                   "Proc.Processes.gt=0,Pid.Pid.eq=$$",
+	                                   NULL, &error));
+
+	assert(SIGAR_OK == sigar_sampler_create(&sampler, SIGAR_SAMPLER_MEM,
+	                                        INTERVAL));
+	assert(SIGAR_OK == sigar_sampler_rules_set(sampler, rules));
+	assert(SIGAR_OK == sigar_sampler_start(sampler));
+	assert(EBUSY == sigar_sampler_rules_set(sampler, NULL));
+
+	snapshot = sigar_sampler_snapshot_acquire(sampler);
+	generation = snapshot->generation;
+	sigar_sampler_snapshot_release(sampler, snapshot);
+	assert(SIGAR_OK == sigar_sampler_wait(sampler, generation + 1, 5000));
+
+	/* Mem fires in the first round and stays on */
+	assert(SIGAR_OK == sigar_rules_events_take(rules, &events));
+	assert(events.number >= 1);
+	assert(events.data[0].id == id && events.data[0].firing == 1);
+	sigar_rule_event_list_destroy(&events);
+
+	assert(SIGAR_OK == sigar_sampler_destroy(sampler));
+
+	assert(SIGAR_OK == sigar_rules_events_take(rules, &events));
+	sigar_rule_event_list_destroy(&events);
+	assert(SIGAR_OK == sigar_rules_destroy(rules));
+
+	return 0;
+}
+
+#ifndef WIN32
+TEST(test_sigar_sampler_perf) {
+	sigar_sampler_t *sampler;
+	sigar_sampler_snapshot_t *snapshot;
+	sigar_uint64_t generation, first;
+	sigar_pid_t self = sigar_pid_get(t);
+	clock_t start;
+	volatile unsigned long spin = 0;
+
+	assert(SIGAR_OK == sigar_sampler_create(&sampler, SIGAR_SAMPLER_PERF,
+	                                        INTERVAL));
+	if (SIGAR_OK != sigar_sampler_perf_add(sampler, self)) {
+		/* no perf_event_open here, or not allowed to */
+		assert(SIGAR_OK == sigar_sampler_destroy(sampler));
+		return 0;
+	}
+	/* enabled time only goes by while we are on a cpu */
+	start = clock();
+	while (clock() < start + CLOCKS_PER_SEC / 3) {
+		spin++;
+	}
+	assert(SIGAR_OK == sigar_sampler_start(sampler));
+	assert(EBUSY == sigar_sampler_perf_add(sampler, self));
+
+	/* the first round counts from the add */
+	snapshot = sigar_sampler_snapshot_acquire(sampler);
+	generation = snapshot->generation;
+	assert(snapshot->flags & SIGAR_SAMPLER_PERF);
+	assert(snapshot->perfs.number == 1);
+	assert(snapshot->perfs.data[0].id == (sigar_uint64_t)self);
+	assert(snapshot->perfs.data[0].cgroup == 0);
+	first = snapshot->perfs.data[0].perf.time_enabled;
+	assert(first >= 100 * 1000000ULL);
+	sigar_sampler_snapshot_release(sampler, snapshot);
+
+	/* the next ones from the round before */
+	assert(SIGAR_OK == sigar_sampler_wait(sampler, generation, 5000));
+	snapshot = sigar_sampler_snapshot_acquire(sampler);
+	assert(snapshot->perfs.number == 1);
+	assert(snapshot->perfs.data[0].perf.time_enabled < first);
+	sigar_sampler_snapshot_release(sampler, snapshot);
+
+	assert(SIGAR_OK == sigar_sampler_destroy(sampler));
+
+	return 0;
+}
+#endif
+
+TEST(test_sigar_sampler_interrupts) {
+	sigar_sampler_t *sampler;
+	sigar_sampler_snapshot_t *snapshot;
+	sigar_uint64_t generation, timer = 0;
+	unsigned long i;
+
+	assert(SIGAR_OK == sigar_sampler_create(&sampler,
+	       SIGAR_SAMPLER_INTERRUPTS | SIGAR_SAMPLER_SOFTIRQS, INTERVAL));
+	assert(SIGAR_OK == sigar_sampler_start(sampler));
+
+	snapshot = sigar_sampler_snapshot_acquire(sampler);
+	generation = snapshot->generation;
+	if (!(snapshot->flags & SIGAR_SAMPLER_SOFTIRQS)) {
+		/* no /proc/softirqs */
+		sigar_sampler_snapshot_release(sampler, snapshot);
+		assert(SIGAR_OK == sigar_sampler_destroy(sampler));
+		return 0;
+	}
+	/* since boot */
+	for (i = 0; i < snapshot->softirqs.number; i++) {
+		if (strcmp(snapshot->softirqs.data[i].name, "TIMER") == 0) {
+			timer = snapshot->softirqs.data[i].total;
+		}
+	}
+	sigar_sampler_snapshot_release(sampler, snapshot);
+
+	/* then since the round before */
+	assert(SIGAR_OK == sigar_sampler_wait(sampler, generation, 5000));
+	snapshot = sigar_sampler_snapshot_acquire(sampler);
+	assert(snapshot->flags & SIGAR_SAMPLER_SOFTIRQS);
+	for (i = 0; i < snapshot->softirqs.number; i++) {
+		if (strcmp(snapshot->softirqs.data[i].name, "TIMER") == 0) {
+			assert(snapshot->softirqs.data[i].total <= timer);
+		}
+	}
+	sigar_sampler_snapshot_release(sampler, snapshot);
+
+	assert(SIGAR_OK == sigar_sampler_destroy(sampler));
+
+	return 0;
+}
+
+TEST(test_sigar_sampler_budget) {
+	sigar_sampler_t *sampler;
+	sigar_sampler_snapshot_t *snapshot;
+	sigar_sampler_schedule_t schedule;
+	sigar_uint64_t generation = 0;
+	int i, sat_out = 0;
+
+	assert(SIGAR_OK == sigar_sampler_create(&sampler,
+	       SIGAR_SAMPLER_MEM | SIGAR_SAMPLER_PROC, INTERVAL));
+	assert(SIGAR_OK == sigar_sampler_schedule_get(sampler,
+	                                              SIGAR_SAMPLER_PROC,
+	                                              &schedule));
+	assert(schedule.runs == 0);
+	assert(schedule.period == 1);
+	assert(schedule.staleness == SIGAR_FIELD_NOTIMPL);
+	assert(EINVAL == sigar_sampler_schedule_get(sampler,
+	                                            SIGAR_SAMPLER_SWAP,
+	                                            &schedule));
+	assert(EINVAL == sigar_sampler_schedule_get(sampler,
+	       SIGAR_SAMPLER_MEM | SIGAR_SAMPLER_PROC, &schedule));
+	assert(EINVAL == sigar_sampler_budget_set(sampler, -1));
+
+	/* far less than any collector costs, so they all slow down */
+	assert(SIGAR_OK == sigar_sampler_budget_set(sampler, 0.000001));
+	assert(SIGAR_OK == sigar_sampler_start(sampler));
+	assert(EBUSY == sigar_sampler_budget_set(sampler, 0));
+
+	for (i = 0; i < 12; i++) {
+		assert(SIGAR_OK == sigar_sampler_wait(sampler, generation, 5000));
+		snapshot = sigar_sampler_snapshot_acquire(sampler);
+		generation = snapshot->generation;
+		if (!(snapshot->flags & SIGAR_SAMPLER_PROC)) {
+			sat_out++;
+		}
+		sigar_sampler_snapshot_release(sampler, snapshot);
+	}
+	assert(SIGAR_OK == sigar_sampler_stop(sampler));
+	assert(sat_out > 0);
+
+	assert(SIGAR_OK == sigar_sampler_schedule_get(sampler,
+	                                              SIGAR_SAMPLER_PROC,
+	                                              &schedule));
+	assert(schedule.runs > 0);
+	assert(schedule.period > 1);
+	assert(schedule.collected > 0);
+	assert(schedule.staleness != SIGAR_FIELD_NOTIMPL);
+
+	assert(SIGAR_OK == sigar_sampler_schedule_get(sampler,
+	                                              SIGAR_SAMPLER_MEM,
+	                                              &schedule));
+	assert(schedule.runs > 0);
+
+	assert(SIGAR_OK == sigar_sampler_destroy(sampler));
+
+	return 0;
+}
+
+int main() {
+	sigar_t *t;
+	int err = 0;
+
+	assert(SIGAR_OK == sigar_open(&t));
+
+	test_sigar_sampler_snapshot(t);
+	test_sigar_sampler_shm(t);
+	test_sigar_tsdb(t);
+	test_sigar_sampler_tsdb(t);
+	test_sigar_rules(t);
+	test_sigar_sampler_rules(t);
+#ifndef WIN32
+	test_sigar_sampler_readers(t);
+	test_sigar_sampler_perf(t);
+#endif
+	test_sigar_sampler_interrupts(t);
+	test_sigar_sampler_budget(t);
+
+	sigar_close(t);
+
+	return err ? -1 : 0;
+}
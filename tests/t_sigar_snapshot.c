@@ -0,0 +1,324 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#ifndef WIN32
+#include <unistd.h>
+#endif
+
+#include "sigar.h"
+#include "sigar_snapshot.h"
+#include "sigar_tests.h"
+
+#define SNAPSHOT_FILE "t_sigar_snapshot.dat"
+
+#define SYNTHETIC_PROCS 3
+#define SYNTHETIC_CONNS 2
+
+static sigar_proc_snapshot_entry_t synthetic_procs[SYNTHETIC_PROCS];
+static sigar_net_connection_t synthetic_conns[SYNTHETIC_CONNS];
+static sigar_disk_usage_entry_t synthetic_disk;
+
+/* values that need more than a byte, go negative or are NOTIMPL */
+static void synthetic_snapshot(sigar_snapshot_t *snapshot,
+                               sigar_int64_t timestamp) {
+	int i;
+
+	memset(synthetic_procs, 0, sizeof(synthetic_procs));
+	for (i = 0; i < SYNTHETIC_PROCS; i++) {
+		sigar_proc_snapshot_entry_t *entry = &synthetic_procs[i];
+
+		entry->pid = 4242 + i;
+		entry->flags = SIGAR_PROC_SNAPSHOT_ALL |
+		               SIGAR_PROC_SNAPSHOT_DISK_IO |
+		               SIGAR_PROC_SNAPSHOT_SCHED;
+		snprintf(entry->state.name, sizeof(entry->state.name),
+		         "proc-%d", i);
+		entry->state.state = SIGAR_PROC_STATE_SLEEP;
+		entry->state.ppid = 1;
+		entry->state.tty = -1;
+		entry->state.nice = -5 + i;
+		entry->state.threads = 7;
+		entry->mem.size = 123456789ULL * (i + 1);
+		entry->mem.resident = SIGAR_FIELD_NOTIMPL;
+		entry->cpu.start_time = 1700000000000ULL;
+		entry->cpu.total = 1000 - i;
+		entry->cpu.percent = 0.25 * i;
+		entry->mem_ext.pss = SIGAR_FIELD_NOTIMPL;
+		entry->disk_io.bytes_read = 1ULL << (32 + i);
+		entry->disk_io.bytes_written = 4096;
+		entry->disk_io.bytes_total =
+			entry->disk_io.bytes_read + entry->disk_io.bytes_written;
+		entry->sched.run_time = 987654321ULL * (i + 1);
+		entry->sched.wait_time = 1000 * i;
+		entry->sched.timeslices = 300 - i;
+	}
+	/* the longest name there is room for */
+	memset(synthetic_procs[2].state.name, 'x',
+	       sizeof(synthetic_procs[2].state.name) - 1);
+
+	memset(synthetic_conns, 0, sizeof(synthetic_conns));
+	synthetic_conns[0].type = SIGAR_NETCONN_TCP;
+	synthetic_conns[0].state = SIGAR_TCP_LISTEN;
+	synthetic_conns[0].local_port = 22;
+	synthetic_conns[0].local_address.family = SIGAR_AF_INET;
+	synthetic_conns[0].local_address.addr.in = 0x0100007f;
+	synthetic_conns[1].type = SIGAR_NETCONN_TCP;
+	synthetic_conns[1].state = SIGAR_TCP_ESTABLISHED;
+	synthetic_conns[1].local_port = 40000;
+	synthetic_conns[1].remote_port = 443;
+	synthetic_conns[1].remote_address.family = SIGAR_AF_INET6;
+	synthetic_conns[1].remote_address.addr.in6[0] = 0x20010db8;
+	synthetic_conns[1].remote_address.addr.in6[3] = 0xffffffff;
+	synthetic_conns[1].send_queue = 17;
+
+	memset(&synthetic_disk, 0, sizeof(synthetic_disk));
+	strcpy(synthetic_disk.name, "sda");
+	synthetic_disk.major = 8;
+	synthetic_disk.disk.reads = 99999;
+	synthetic_disk.disk.service_time = 1.5;
+	synthetic_disk.disk.queue = SIGAR_FIELD_NOTIMPL;
+
+	memset(snapshot, 0, sizeof(*snapshot));
+	snapshot->timestamp = timestamp;
+	snapshot->flags = SIGAR_SNAPSHOT_ALL;
+	snapshot->procs.number = snapshot->procs.size = SYNTHETIC_PROCS;
+	snapshot->procs.data = synthetic_procs;
+	snapshot->connections.number =
+		snapshot->connections.size = SYNTHETIC_CONNS;
+	snapshot->connections.data = synthetic_conns;
+	snapshot->disks.number = snapshot->disks.size = 1;
+	snapshot->disks.data = &synthetic_disk;
+}
+
+static void synthetic_check(sigar_snapshot_t *snapshot) {
+	int i;
+
+	assert(snapshot->flags == SIGAR_SNAPSHOT_ALL);
+	assert(snapshot->procs.number == SYNTHETIC_PROCS);
+	/* rows come back zeroed, padding included */
+	assert(memcmp(snapshot->procs.data, synthetic_procs,
+	              sizeof(synthetic_procs)) == 0);
+	for (i = 0; i < SYNTHETIC_PROCS; i++) {
+		assert(snapshot->procs.data[i].state.nice == -5 + i);
+	}
+	assert(snapshot->connections.number == SYNTHETIC_CONNS);
+	assert(memcmp(snapshot->connections.data, synthetic_conns,
+	              sizeof(synthetic_conns)) == 0);
+	assert(snapshot->disks.number == 1);
+	assert(memcmp(snapshot->disks.data, &synthetic_disk,
+	              sizeof(synthetic_disk)) == 0);
+}
+
+static long file_size(const char *path) {
+	FILE *fp = fopen(path, "rb");
+	long size;
+
+	assert(fp != NULL);
+	fseek(fp, 0, SEEK_END);
+	size = ftell(fp);
+	fclose(fp);
+
+	return size;
+}
+
+TEST(test_sigar_snapshot_write_read) {
+	sigar_snapshot_writer_t *writer;
+	sigar_snapshot_reader_t *reader;
+	sigar_snapshot_t synthetic, live, snapshot;
+	unsigned long raw;
+
+	assert(SIGAR_OK == sigar_snapshot_get(t, SIGAR_SNAPSHOT_ALL, &live));
+	assert(live.flags & SIGAR_SNAPSHOT_PROC);
+	assert(live.procs.number > 0);
+
+	assert(SIGAR_OK == sigar_snapshot_writer_open(&writer, SNAPSHOT_FILE));
+	synthetic_snapshot(&synthetic, 1000);
+	assert(SIGAR_OK == sigar_snapshot_write(writer, &synthetic));
+	synthetic.timestamp = 2000;
+	assert(SIGAR_OK == sigar_snapshot_write(writer, &synthetic));
+	live.timestamp = 3000;
+	assert(SIGAR_OK == sigar_snapshot_write(writer, &live));
+	assert(SIGAR_OK == sigar_snapshot_writer_close(writer));
+
+	raw = sizeof(*live.procs.data) * live.procs.number;
+	/* well under the structs themselves */
+	assert(file_size(SNAPSHOT_FILE) < (long)(raw / 2));
+
+	assert(SIGAR_OK == sigar_snapshot_reader_open(&reader, SNAPSHOT_FILE));
+	assert(sigar_snapshot_count(reader) == 3);
+	assert(sigar_snapshot_find(reader, 500) == -1);
+	assert(sigar_snapshot_find(reader, 1000) == 0);
+	assert(sigar_snapshot_find(reader, 2500) == 1);
+	assert(sigar_snapshot_find(reader, 9999) == 2);
+
+	/* any frame on its own, in any order */
+	assert(SIGAR_OK == sigar_snapshot_read(reader, 2, &snapshot));
+	assert(snapshot.timestamp == 3000);
+	assert(snapshot.flags == live.flags);
+	assert(snapshot.procs.number == live.procs.number);
+	assert(snapshot.procs.data[0].pid == live.procs.data[0].pid);
+	assert(strcmp(snapshot.procs.data[0].state.name,
+	              live.procs.data[0].state.name) == 0);
+	assert(snapshot.procs.data[0].mem.size == live.procs.data[0].mem.size);
+	assert(snapshot.connections.number == live.connections.number);
+	assert(snapshot.disks.number == live.disks.number);
+	sigar_snapshot_destroy(NULL, &snapshot);
+
+	assert(SIGAR_OK == sigar_snapshot_read(reader, 0, &snapshot));
+	assert(snapshot.timestamp == 1000);
+	synthetic_check(&snapshot);
+	sigar_snapshot_destroy(NULL, &snapshot);
+
+	assert(ENOENT == sigar_snapshot_read(reader, 3, &snapshot));
+
+	assert(SIGAR_OK == sigar_snapshot_reader_close(reader));
+	sigar_snapshot_destroy(t, &live);
+
+	return 0;
+}
+
+#ifndef WIN32
+TEST(test_sigar_snapshot_unclosed) {
+	sigar_snapshot_writer_t *writer;
+	sigar_snapshot_reader_t *reader;
+	sigar_snapshot_t synthetic, snapshot;
+	long size, frame;
+
+	assert(SIGAR_OK == sigar_snapshot_writer_open(&writer, SNAPSHOT_FILE));
+	synthetic_snapshot(&synthetic, 1000);
+	assert(SIGAR_OK == sigar_snapshot_write(writer, &synthetic));
+	synthetic.timestamp = 2000;
+	assert(SIGAR_OK == sigar_snapshot_write(writer, &synthetic));
+	assert(SIGAR_OK == sigar_snapshot_writer_close(writer));
+
+	/* drop the index and trailer, as if the writer had died */
+	size = file_size(SNAPSHOT_FILE) - 24 - (2 * 16);
+	assert(0 == truncate(SNAPSHOT_FILE, size));
+	frame = (size - 8) / 2;
+
+	assert(SIGAR_OK == sigar_snapshot_reader_open(&reader, SNAPSHOT_FILE));
+	assert(sigar_snapshot_count(reader) == 2);
+	assert(SIGAR_OK == sigar_snapshot_read(reader, 1, &snapshot));
+	assert(snapshot.timestamp == 2000);
+	synthetic_check(&snapshot);
+	sigar_snapshot_destroy(NULL, &snapshot);
+	assert(SIGAR_OK == sigar_snapshot_reader_close(reader));
+
+	/* a torn last frame is left out */
+	assert(0 == truncate(SNAPSHOT_FILE, size - (frame / 2)));
+	assert(SIGAR_OK == sigar_snapshot_reader_open(&reader, SNAPSHOT_FILE));
+	assert(sigar_snapshot_count(reader) == 1);
+	assert(SIGAR_OK == sigar_snapshot_reader_close(reader));
+
+	return 0;
+}
+#endif
+
+TEST(test_sigar_snapshot_replay) {
+	sigar_snapshot_writer_t *writer;
+	sigar_snapshot_reader_t *reader;
+	sigar_snapshot_t synthetic;
+	sigar_proc_list_t pids;
+	sigar_proc_snapshot_t procs;
+	sigar_net_connection_list_t conns;
+	sigar_disk_usage_list_t disks;
+
+	assert(SIGAR_OK == sigar_snapshot_writer_open(&writer, SNAPSHOT_FILE));
+	synthetic_snapshot(&synthetic, 1000);
+	assert(SIGAR_OK == sigar_snapshot_write(writer, &synthetic));
+	assert(SIGAR_OK == sigar_snapshot_writer_close(writer));
+
+	assert(SIGAR_OK == sigar_snapshot_reader_open(&reader, SNAPSHOT_FILE));
+	assert(SIGAR_OK != sigar_snapshot_replay_set(t, reader, 1));
+	assert(SIGAR_OK == sigar_snapshot_replay_set(t, reader, 0));
+	assert(SIGAR_OK == sigar_snapshot_reader_close(reader));
+
+	assert(SIGAR_OK == sigar_proc_list_get(t, &pids));
+	assert(pids.number == SYNTHETIC_PROCS);
+	assert(pids.data[0] == 4242);
+	sigar_proc_list_destroy(t, &pids);
+
+	assert(SIGAR_OK == sigar_proc_snapshot_get(t, SIGAR_PROC_SNAPSHOT_MEM,
+	                                           &procs));
+	assert(procs.number == SYNTHETIC_PROCS);
+	assert(procs.data[1].flags == SIGAR_PROC_SNAPSHOT_MEM);
+	assert(procs.data[1].mem.size == synthetic_procs[1].mem.size);
+	sigar_proc_snapshot_destroy(t, &procs);
+
+	assert(SIGAR_OK == sigar_proc_snapshot_get(t,
+	                                           SIGAR_PROC_SNAPSHOT_DISK_IO |
+	                                           SIGAR_PROC_SNAPSHOT_SCHED,
+	                                           &procs));
+	assert(procs.number == SYNTHETIC_PROCS);
+	assert(procs.data[2].flags ==
+	       (SIGAR_PROC_SNAPSHOT_DISK_IO | SIGAR_PROC_SNAPSHOT_SCHED));
+	assert(procs.data[2].disk_io.bytes_read ==
+	       synthetic_procs[2].disk_io.bytes_read);
+	assert(procs.data[2].disk_io.bytes_total ==
+	       synthetic_procs[2].disk_io.bytes_total);
+	assert(procs.data[2].sched.run_time ==
+	       synthetic_procs[2].sched.run_time);
+	assert(procs.data[2].sched.timeslices ==
+	       synthetic_procs[2].sched.timeslices);
+	sigar_proc_snapshot_destroy(t, &procs);
+
+	assert(SIGAR_OK == sigar_net_connection_list_get(t, &conns,
+	                                                 SIGAR_NETCONN_SERVER |
+	                                                 SIGAR_NETCONN_TCP));
+	assert(conns.number == 1);
+	assert(conns.data[0].local_port == 22);
+	sigar_net_connection_list_destroy(t, &conns);
+	assert(SIGAR_OK == sigar_net_connection_list_get(t, &conns,
+	                                                 SIGAR_NETCONN_CLIENT |
+	                                                 SIGAR_NETCONN_UDP));
+	assert(conns.number == 0);
+	sigar_net_connection_list_destroy(t, &conns);
+
+	assert(SIGAR_OK == sigar_disk_usage_list_get(t, &disks));
+	assert(disks.number == 1);
+	assert(strcmp(disks.data[0].name, "sda") == 0);
+	sigar_disk_usage_list_destroy(t, &disks);
+
+	/* back to the live system */
+	assert(SIGAR_OK == sigar_snapshot_replay_set(t, NULL, 0));
+	assert(SIGAR_OK == sigar_proc_list_get(t, &pids));
+	assert(pids.number > 0);
+	assert(pids.data[0] != 4242 || pids.number != SYNTHETIC_PROCS);
+	sigar_proc_list_destroy(t, &pids);
+
+	return 0;
+}
+
+int main() {
+	sigar_t *t;
+	int err = 0;
+
+	assert(SIGAR_OK == sigar_open(&t));
+
+	test_sigar_snapshot_write_read(t);
+#ifndef WIN32
+	test_sigar_snapshot_unclosed(t);
+#endif
+	test_sigar_snapshot_replay(t);
+
+	remove(SNAPSHOT_FILE);
+	sigar_close(t);
+
+	return err ? -1 : 0;
+}
@@ -63,6 +63,150 @@ TEST(test_sigar_sys_info_get) {
 	return 0;
 }
 
+TEST(test_sigar_fqdn_get) {
+	char fqdn[SIGAR_FQDN_LEN], again[SIGAR_FQDN_LEN];
+	sigar_net_info_t netinfo, netinfo2;
+	sigar_t *async;
+	int i;
+
+	/* the second answer comes from the cache */
+	assert(SIGAR_OK == sigar_fqdn_get(t, fqdn, sizeof(fqdn)));
+	assert(SIGAR_OK == sigar_fqdn_get(t, again, sizeof(again)));
+	assert(strcmp(fqdn, again) == 0);
+	assert(strlen(fqdn) > 0);
+
+	assert(SIGAR_OK == sigar_net_info_get(t, &netinfo));
+	assert(SIGAR_OK == sigar_net_info_get(t, &netinfo2));
+	assert(strcmp(netinfo.host_name, netinfo2.host_name) == 0);
+	assert(strcmp(netinfo.default_gateway, netinfo2.default_gateway) == 0);
+
+	/* never blocks, and the handle may go while a lookup runs */
+	assert(SIGAR_OK == sigar_open(&async));
+	assert(SIGAR_OK == sigar_fqdn_async_set(async, 1));
+	assert(SIGAR_OK == sigar_net_info_expire_set(async, 0));
+	for (i = 0; i < 3; i++) {
+		assert(SIGAR_OK == sigar_fqdn_get(async, again, sizeof(again)));
+		assert(strlen(again) > 0);
+	}
+	sigar_close(async);
+
+	return 0;
+}
+
+static void who_list_assert_equal(sigar_who_list_t *a, sigar_who_list_t *b) {
+	unsigned long i;
+
+	assert(a->number == b->number);
+	for (i = 0; i < a->number; i++) {
+		assert(strcmp(a->data[i].user, b->data[i].user) == 0);
+		assert(strcmp(a->data[i].device, b->data[i].device) == 0);
+		assert(a->data[i].time == b->data[i].time);
+	}
+}
+
+TEST(test_sigar_who_list_get) {
+	sigar_who_list_t first, second;
+	int ret;
+
+	ret = sigar_who_list_get(t, &first);
+	if (ret == SIGAR_ENOTIMPL) {
+		return 0;
+	}
+	assert(ret == SIGAR_OK);
+
+	/* the second list may come from the cache, it must match */
+	assert(SIGAR_OK == sigar_who_list_get(t, &second));
+	who_list_assert_equal(&first, &second);
+
+	/* and be the caller's own to grow */
+	SIGAR_WHO_LIST_GROW((&second));
+	sigar_who_list_destroy(t, &second);
+
+	ret = sigar_who_list_watch_set(t, 1);
+	assert(ret == SIGAR_OK || ret == SIGAR_ENOTIMPL || ret == ENOENT);
+	if (ret == SIGAR_OK) {
+		assert(SIGAR_OK == sigar_who_list_get(t, &second));
+		who_list_assert_equal(&first, &second);
+		sigar_who_list_destroy(t, &second);
+		assert(SIGAR_OK == sigar_who_list_get(t, &second));
+		who_list_assert_equal(&first, &second);
+		sigar_who_list_destroy(t, &second);
+		assert(SIGAR_OK == sigar_who_list_watch_set(t, 0));
+	}
+
+	sigar_who_list_destroy(t, &first);
+
+	return 0;
+}
+
+typedef struct {
+	int count;
+	int level[8];
+	char message[8][128];
+} log_capture_t;
+
+static void log_capture(sigar_t *sigar, void *data, int level, char *message) {
+	log_capture_t *capture = (log_capture_t *)data;
+
+	assert(capture->count < 8);
+	capture->level[capture->count] = level;
+	strncpy(capture->message[capture->count], message, 127);
+	capture->message[capture->count][127] = '\0';
+	capture->count++;
+}
+
+TEST(test_sigar_log_ring) {
+	sigar_log_ring_t *ring;
+	log_capture_t capture;
+	char name[16], expect[128];
+
+	assert(SIGAR_OK == sigar_log_ring_create(&ring, 3)); /* 4 entries */
+
+	sigar_log_impl_set(t, ring, sigar_log_impl_ring);
+	sigar_log_level_set(t, SIGAR_LOG_INFO);
+
+	/* the string is copied, not referenced */
+	strcpy(name, "eth0");
+	sigar_log_printf(t, SIGAR_LOG_INFO,
+	                 "[%s] %d %02hhx %lld %5.2f %-4s| %*d %%", name,
+	                 -42, 0x1ff, 1234567890123LL, 3.14159, "ab", 3, 7);
+	strcpy(name, "XXXX");
+	sigar_log_printf(t, SIGAR_LOG_DEBUG, "not logged");
+	sigar_log(t, SIGAR_LOG_ERROR, "plain");
+	sigar_log_printf(t, SIGAR_LOG_WARN, "%p %c%u", NULL, 'z', 5u);
+	/* wide strings are formatted right away */
+	sigar_log_printf(t, SIGAR_LOG_INFO, "%ls now", L"wide");
+	sigar_log_printf(t, SIGAR_LOG_INFO, "full");
+
+	assert(sigar_log_ring_dropped(ring) == 1);
+
+	memset(&capture, 0, sizeof(capture));
+	assert(4 == sigar_log_ring_drain(ring, t, log_capture, &capture));
+	assert(0 == sigar_log_ring_drain(ring, t, log_capture, &capture));
+	assert(capture.count == 4);
+
+	snprintf(expect, sizeof(expect),
+	         "[%s] %d %02hhx %lld %5.2f %-4s| %*d %%", "eth0",
+	         -42, 0x1ff, 1234567890123LL, 3.14159, "ab", 3, 7);
+	assert(capture.level[0] == SIGAR_LOG_INFO);
+	assert(strcmp(capture.message[0], expect) == 0);
+
+	assert(capture.level[1] == SIGAR_LOG_ERROR);
+	assert(strcmp(capture.message[1], "plain") == 0);
+
+	snprintf(expect, sizeof(expect), "%p %c%u", NULL, 'z', 5u);
+	assert(strcmp(capture.message[2], expect) == 0);
+
+	assert(capture.level[3] == SIGAR_LOG_INFO);
+	assert(strcmp(capture.message[3], "wide now") == 0);
+
+	sigar_log_level_set(t, -1);
+	sigar_log_impl_set(t, NULL, NULL);
+	sigar_log_ring_destroy(ring);
+
+	return 0;
+}
+
 int main() {
 	sigar_t *t;
 	int err = 0;
@@ -70,6 +214,9 @@ int main() {
 	assert(SIGAR_OK == sigar_open(&t));
 
 	test_sigar_sys_info_get(t);
+	test_sigar_fqdn_get(t);
+	test_sigar_who_list_get(t);
+	test_sigar_log_ring(t);
 
 	sigar_close(t);
 